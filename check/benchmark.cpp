@@ -0,0 +1,695 @@
+/** @file benchmark.cpp
+ *
+ *  Running the timings with repetitions and recording their statistics. */
+
+/*
+ *  GiNaC Copyright (C) 1999-2014 Johannes Gutenberg University Mainz, Germany
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#ifdef HAVE_RUSAGE
+#include <sys/resource.h>
+#include <sys/time.h>
+#endif
+
+#include "benchmark.h"
+#include "timer.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <fstream>
+#include <iostream>
+#include <locale>
+#include <new>
+#include <sstream>
+#include <stdexcept>
+using namespace std;
+
+//////////
+// Counting allocations
+//////////
+
+static unsigned long allocation_count = 0;
+static unsigned long allocation_bytes = 0;
+
+static inline void count_allocation(size_t size)
+{
+#ifdef GINAC_THREADSAFE_REFCOUNT
+	__sync_fetch_and_add(&allocation_count, 1);
+	__sync_fetch_and_add(&allocation_bytes, size);
+#else
+	++allocation_count;
+	allocation_bytes += size;
+#endif
+}
+
+// Exception specifications of the replaced operators
+#if __cplusplus >= 201103L
+#define THROWS_BAD_ALLOC
+#define THROWS_NOTHING noexcept
+#else
+#define THROWS_BAD_ALLOC throw(bad_alloc)
+#define THROWS_NOTHING throw()
+#endif
+
+static void * counted_new(size_t size)
+{
+	count_allocation(size);
+	for (;;) {
+		void * p = malloc(size ? size : 1);
+		if (p)
+			return p;
+		new_handler handler = set_new_handler(0);
+		set_new_handler(handler);
+		if (!handler)
+			throw bad_alloc();
+		handler();
+	}
+}
+
+void * operator new(size_t size) THROWS_BAD_ALLOC
+{
+	return counted_new(size);
+}
+
+void * operator new[](size_t size) THROWS_BAD_ALLOC
+{
+	return counted_new(size);
+}
+
+void * operator new(size_t size, const nothrow_t &) THROWS_NOTHING
+{
+	try {
+		return counted_new(size);
+	} catch (const bad_alloc &) {
+		return 0;
+	}
+}
+
+void * operator new[](size_t size, const nothrow_t &) THROWS_NOTHING
+{
+	try {
+		return counted_new(size);
+	} catch (const bad_alloc &) {
+		return 0;
+	}
+}
+
+void operator delete(void * p) THROWS_NOTHING
+{
+	free(p);
+}
+
+void operator delete[](void * p) THROWS_NOTHING
+{
+	free(p);
+}
+
+void operator delete(void * p, const nothrow_t &) THROWS_NOTHING
+{
+	free(p);
+}
+
+void operator delete[](void * p, const nothrow_t &) THROWS_NOTHING
+{
+	free(p);
+}
+
+//////////
+// Settings
+//////////
+
+static string getenv_string(const char * name)
+{
+	const char * value = getenv(name);
+	return value ? value : "";
+}
+
+/** Parse a comma separated list of numbers. */
+static vector<unsigned> parse_list(const string & s)
+{
+	vector<unsigned> v;
+	istringstream in(s);
+	string item;
+	while (getline(in, item, ','))
+		if (!item.empty())
+			v.push_back(atoi(item.c_str()));
+	return v;
+}
+
+benchmark_options::benchmark_options()
+ : filter(getenv_string("GINAC_BENCHMARK_FILTER")),
+   repetitions(1), warmups(0), min_time(0.1),
+   output(getenv_string("GINAC_BENCHMARK_OUTPUT")),
+   format(getenv_string("GINAC_BENCHMARK_FORMAT")),
+   label(getenv_string("GINAC_BENCHMARK_LABEL"))
+{
+	const string r = getenv_string("GINAC_BENCHMARK_REPETITIONS");
+	if (!r.empty())
+		repetitions = atoi(r.c_str());
+	const string w = getenv_string("GINAC_BENCHMARK_WARMUPS");
+	if (!w.empty())
+		warmups = atoi(w.c_str());
+	const string t = getenv_string("GINAC_BENCHMARK_MIN_TIME");
+	if (!t.empty())
+		min_time = atof(t.c_str());
+	const string s = getenv_string("GINAC_BENCHMARK_SCALING");
+	scaling = !s.empty() && s != "0";
+	sizes = parse_list(getenv_string("GINAC_BENCHMARK_SIZES"));
+	threads = parse_list(getenv_string("GINAC_BENCHMARK_THREADS"));
+}
+
+benchmark_options & benchmark_settings()
+{
+	static benchmark_options settings;
+	return settings;
+}
+
+void parse_benchmark_options(int & argc, char ** argv)
+{
+	benchmark_options & settings = benchmark_settings();
+	if (argc > 0) {
+		settings.program = argv[0];
+		const string::size_type slash = settings.program.find_last_of("/\\");
+		if (slash != string::npos)
+			settings.program.erase(0, slash + 1);
+		const string::size_type exe = settings.program.rfind(".exe");
+		if (exe != string::npos && exe + 4 == settings.program.size())
+			settings.program.erase(exe);
+	}
+
+	static const string prefix = "--benchmark-";
+	int kept = 1;
+	for (int i = 1; i < argc; ++i) {
+		const string arg = argv[i];
+		if (arg.compare(0, prefix.size(), prefix) != 0) {
+			argv[kept++] = argv[i];
+			continue;
+		}
+		const string::size_type eq = arg.find('=');
+		if (eq == string::npos)
+			throw invalid_argument("missing value of option " + arg);
+		const string option = arg.substr(prefix.size(), eq - prefix.size());
+		const string value = arg.substr(eq + 1);
+		if (option == "filter")
+			settings.filter = value;
+		else if (option == "repetitions")
+			settings.repetitions = atoi(value.c_str());
+		else if (option == "warmups")
+			settings.warmups = atoi(value.c_str());
+		else if (option == "min-time")
+			settings.min_time = atof(value.c_str());
+		else if (option == "output")
+			settings.output = value;
+		else if (option == "format")
+			settings.format = value;
+		else if (option == "label")
+			settings.label = value;
+		else if (option == "scaling")
+			settings.scaling = (value != "0");
+		else if (option == "sizes") {
+			settings.sizes = parse_list(value);
+			settings.scaling = true;
+		} else if (option == "threads")
+			settings.threads = parse_list(value);
+		else
+			throw invalid_argument("unknown option " + arg);
+	}
+	argc = kept;
+	argv[argc] = 0;
+}
+
+//////////
+// Selecting benchmarks
+//////////
+
+/** Match s against a pattern with the wildcards * and ?. */
+static bool glob_match(const char * p, const char * s)
+{
+	for (; *p; ++p, ++s) {
+		if (*p == '*') {
+			for (; *s; ++s)
+				if (glob_match(p + 1, s))
+					return true;
+			return glob_match(p + 1, s);
+		}
+		if (!*s || (*p != '?' && *p != *s))
+			return false;
+	}
+	return !*s;
+}
+
+static bool selected(const string & program, const string & name)
+{
+	const string & filter = benchmark_settings().filter;
+	if (filter.empty())
+		return true;
+	const string qualified = program + '/' + name;
+	string::size_type begin = 0;
+	while (begin <= filter.size()) {
+		string::size_type end = filter.find(',', begin);
+		if (end == string::npos)
+			end = filter.size();
+		const string pattern = filter.substr(begin, end - begin);
+		if (!pattern.empty() && (glob_match(pattern.c_str(), name.c_str()) ||
+		                         glob_match(pattern.c_str(), qualified.c_str())))
+			return true;
+		begin = end + 1;
+	}
+	return false;
+}
+
+string benchmark_name(const string & family, unsigned n)
+{
+	ostringstream name;
+	name << family << '_' << n;
+	return name.str();
+}
+
+//////////
+// Statistics
+//////////
+
+benchmark_statistics::benchmark_statistics(const vector<double> & samples)
+ : median(0), mean(0), stddev(0), min(0)
+{
+	const size_t n = samples.size();
+	if (n == 0)
+		return;
+	vector<double> sorted(samples);
+	sort(sorted.begin(), sorted.end());
+	min = sorted[0];
+	median = (n % 2) ? sorted[n/2] : (sorted[n/2 - 1] + sorted[n/2]) / 2;
+	for (size_t i = 0; i < n; ++i)
+		mean += sorted[i];
+	mean /= n;
+	if (n > 1) {
+		double sum = 0;
+		for (size_t i = 0; i < n; ++i)
+			sum += (sorted[i] - mean) * (sorted[i] - mean);
+		stddev = sqrt(sum / (n - 1));
+	}
+}
+
+benchmark_result::benchmark_result()
+ : size(0), threads(0), skipped(false), failures(0), warmups(0), runs(0),
+   allocations(0), allocated_bytes(0), peak_rss(0)
+{
+}
+
+double benchmark_result::time() const
+{
+	return benchmark_statistics(cpu).median;
+}
+
+ostream & operator<<(ostream & os, const benchmark_result & r)
+{
+	if (r.skipped)
+		return os << "skipped";
+	return os << r.time() << 's';
+}
+
+//////////
+// Recording results
+//////////
+
+static string json_string(const string & s)
+{
+	ostringstream os;
+	os << '"';
+	for (string::const_iterator i = s.begin(); i != s.end(); ++i) {
+		const unsigned char c = *i;
+		if (c == '"' || c == '\\')
+			os << '\\' << c;
+		else if (c < 0x20) {
+			static const char hex[] = "0123456789abcdef";
+			os << "\\u00" << hex[c >> 4] << hex[c & 15];
+		} else
+			os << c;
+	}
+	os << '"';
+	return os.str();
+}
+
+static string csv_string(const string & s)
+{
+	if (s.find_first_of(",\"\n") == string::npos)
+		return s;
+	string quoted = "\"";
+	for (string::const_iterator i = s.begin(); i != s.end(); ++i) {
+		if (*i == '"')
+			quoted += '"';
+		quoted += *i;
+	}
+	return quoted + '"';
+}
+
+/** Columns of the CSV files.  Records of benchmarks leave the scaling
+ *  columns empty, records of scaling fits the columns of the timings. */
+static const char * const csv_columns[] = {
+	"program", "benchmark", "label", "size", "threads",
+	"failures", "repetitions", "warmups", "runs",
+	"cpu_median", "cpu_mean", "cpu_stddev", "cpu_min",
+	"wall_median", "wall_mean", "wall_stddev", "wall_min",
+	"allocations", "allocated_bytes", "peak_rss_kb",
+	"scaling_exponent", "scaling_points", 0
+};
+
+/** A record for the output file, as a list of fields. */
+class output_record {
+public:
+	output_record(const string & benchmark)
+	{
+		text("program", benchmark_settings().program);
+		text("benchmark", benchmark);
+		text("label", benchmark_settings().label);
+	}
+
+	void text(const char * name, const string & value)
+	{
+		fields.push_back(field(name, value, true));
+	}
+
+	template <typename T>
+	void number(const char * name, const T & value)
+	{
+		ostringstream os;
+		os.imbue(locale::classic());
+		os.precision(9);
+		os << value;
+		fields.push_back(field(name, os.str(), false));
+	}
+
+	/** Append the record to the output file, if there is one. */
+	void write() const;
+
+private:
+	struct field {
+		field(const char * n, const string & v, bool t) : name(n), value(v), is_text(t) {}
+		const char * name;
+		string value;
+		bool is_text;
+	};
+	vector<field> fields;
+};
+
+void output_record::write() const
+{
+	const benchmark_options & settings = benchmark_settings();
+	if (settings.output.empty())
+		return;
+
+	string format = settings.format;
+	if (format.empty()) {
+		const string::size_type dot = settings.output.rfind('.');
+		format = (dot != string::npos && settings.output.substr(dot) == ".csv") ? "csv" : "json";
+	}
+	if (format != "csv" && format != "json")
+		throw invalid_argument("unknown benchmark output format " + format);
+	const bool csv = (format == "csv");
+
+	// A new CSV file starts with the names of the columns
+	bool header = false;
+	if (csv) {
+		ifstream existing(settings.output.c_str());
+		header = !existing || existing.peek() == ifstream::traits_type::eof();
+	}
+
+	ofstream out(settings.output.c_str(), ios::app);
+	if (!out)
+		throw runtime_error("cannot open benchmark output file " + settings.output);
+	if (csv) {
+		if (header) {
+			for (size_t c = 0; csv_columns[c]; ++c)
+				out << (c ? "," : "") << csv_columns[c];
+			out << '\n';
+		}
+		for (size_t c = 0; csv_columns[c]; ++c) {
+			out << (c ? "," : "");
+			for (size_t i = 0; i < fields.size(); ++i)
+				if (!strcmp(fields[i].name, csv_columns[c]))
+					out << (fields[i].is_text ? csv_string(fields[i].value) : fields[i].value);
+		}
+		out << '\n';
+	} else {
+		for (size_t i = 0; i < fields.size(); ++i)
+			out << (i ? ", \"" : "{\"") << fields[i].name << "\": "
+			    << (fields[i].is_text ? json_string(fields[i].value) : fields[i].value);
+		out << "}\n";
+	}
+}
+
+static void record(const benchmark_result & r)
+{
+	const benchmark_statistics cpu(r.cpu), wall(r.wall);
+	output_record rec(r.name);
+	if (r.size)
+		rec.number("size", r.size);
+	if (r.threads)
+		rec.number("threads", r.threads);
+	rec.number("failures", r.failures);
+	rec.number("repetitions", r.cpu.size());
+	rec.number("warmups", r.warmups);
+	rec.number("runs", r.runs);
+	rec.number("cpu_median", cpu.median);
+	rec.number("cpu_mean", cpu.mean);
+	rec.number("cpu_stddev", cpu.stddev);
+	rec.number("cpu_min", cpu.min);
+	rec.number("wall_median", wall.median);
+	rec.number("wall_mean", wall.mean);
+	rec.number("wall_stddev", wall.stddev);
+	rec.number("wall_min", wall.min);
+	rec.number("allocations", r.allocations);
+	rec.number("allocated_bytes", r.allocated_bytes);
+	rec.number("peak_rss_kb", r.peak_rss);
+	rec.write();
+}
+
+//////////
+// Running benchmarks
+//////////
+
+static double wall_clock()
+{
+#ifdef HAVE_RUSAGE
+	struct timeval tv;
+	gettimeofday(&tv, 0);
+	return tv.tv_sec + tv.tv_usec * 1e-6;
+#else
+	return double(std::time(0));
+#endif
+}
+
+static long peak_rss()
+{
+#ifdef HAVE_RUSAGE
+	struct rusage usage;
+	getrusage(RUSAGE_SELF, &usage);
+	return usage.ru_maxrss;
+#else
+	return 0;
+#endif
+}
+
+/** Time b, the benchmark of size and number of threads given (0 if none). */
+static benchmark_result measure(const string & name, benchmark & b, unsigned size, unsigned threads)
+{
+	const benchmark_options & settings = benchmark_settings();
+	benchmark_result r;
+	r.name = name;
+	r.size = size;
+	r.threads = threads;
+	if (!selected(settings.program, name)) {
+		r.skipped = true;
+		return r;
+	}
+
+	for (unsigned i = 0; i < settings.warmups && !r.failures; ++i) {
+		b.prepare();
+		r.failures += b.run();
+		++r.warmups;
+	}
+
+	// Only the runs are timed, not their preparation
+	timer cpu_timer;
+	unsigned long allocations = 0, allocated_bytes = 0;
+	for (unsigned rep = 0; rep < max(settings.repetitions, 1u) && !r.failures; ++rep) {
+		unsigned long runs = 0;
+		double cpu = 0, wall = 0;
+		do {
+			b.prepare();
+			const unsigned long count0 = allocation_count, bytes0 = allocation_bytes;
+			const double wall0 = wall_clock();
+			cpu_timer.start();
+			r.failures += b.run();
+			cpu += cpu_timer.read();
+			cpu_timer.stop();
+			wall += wall_clock() - wall0;
+			allocations += allocation_count - count0;
+			allocated_bytes += allocation_bytes - bytes0;
+			++runs;
+		} while (cpu < settings.min_time && !r.failures);
+		r.runs += runs;
+		r.cpu.push_back(cpu / runs);
+		r.wall.push_back(wall / runs);
+	}
+	if (r.runs) {
+		r.allocations = double(allocations) / r.runs;
+		r.allocated_bytes = double(allocated_bytes) / r.runs;
+	}
+	r.peak_rss = peak_rss();
+
+	record(r);
+	return r;
+}
+
+benchmark_result run_benchmark(const string & name, benchmark & b)
+{
+	return measure(name, b, 0, 0);
+}
+
+//////////
+// Sweeps
+//////////
+
+scaling_fit::scaling_fit() : exponent(0), coefficient(0), points(0)
+{
+}
+
+scaling_fit fit_scaling(const vector<unsigned> & sizes, const vector<benchmark_result> & results)
+{
+	// least squares fit of log(time) = log(coefficient) + exponent*log(size)
+	vector<double> x, y;
+	for (size_t i = 0; i < sizes.size() && i < results.size(); ++i) {
+		if (results[i].skipped || sizes[i] == 0 || !(results[i].time() > 0))
+			continue;
+		x.push_back(log(double(sizes[i])));
+		y.push_back(log(results[i].time()));
+	}
+	scaling_fit fit;
+	fit.points = x.size();
+	if (fit.points < 2)
+		return fit;
+	const double xbar = benchmark_statistics(x).mean, ybar = benchmark_statistics(y).mean;
+	double sxy = 0, sxx = 0;
+	for (size_t i = 0; i < x.size(); ++i) {
+		sxy += (x[i] - xbar) * (y[i] - ybar);
+		sxx += (x[i] - xbar) * (x[i] - xbar);
+	}
+	if (sxx == 0) {
+		fit.points = 1;
+		return fit;
+	}
+	fit.exponent = sxy / sxx;
+	fit.coefficient = exp(ybar - fit.exponent * xbar);
+	return fit;
+}
+
+/** Print a row of the report of a sweep. */
+template <typename T>
+static void print_row(const string & title, const vector<T> & values)
+{
+	cout << '\t' << title << ':';
+	for (size_t i = title.size() + 1; i < 8; ++i)
+		cout << ' ';
+	for (size_t i = 0; i < values.size(); ++i)
+		cout << '\t' << values[i];
+	cout << endl;
+}
+
+unsigned run_scaling(const string & family, const string & parameter,
+                     scalable_benchmark & b, const vector<unsigned> & default_sizes)
+{
+	const benchmark_options & settings = benchmark_settings();
+	if (!settings.scaling)
+		return 0;
+	const vector<unsigned> & sizes = settings.sizes.empty() ? default_sizes : settings.sizes;
+
+	cout << "\tscaling with " << parameter << flush;
+	unsigned failures = 0;
+	vector<benchmark_result> results;
+	for (size_t i = 0; i < sizes.size(); ++i) {
+		b.resize(sizes[i]);
+		results.push_back(measure(benchmark_name(family, sizes[i]), b, sizes[i], 0));
+		failures += results.back().failures;
+		cout << '.' << flush;
+		if (failures)
+			break;
+	}
+	cout << endl;
+
+	const scaling_fit fit = fit_scaling(sizes, results);
+	print_row(parameter, sizes);
+	print_row("time", results);
+	cout << "\tfit:    \t";
+	if (fit.points < 2)
+		cout << "-" << endl;
+	else
+		cout << parameter << '^' << fit.exponent << endl;
+
+	if (fit.points >= 2) {
+		output_record rec(family);
+		rec.number("scaling_exponent", fit.exponent);
+		rec.number("scaling_points", fit.points);
+		rec.write();
+	}
+	return failures;
+}
+
+unsigned run_thread_sweep(const string & name, benchmark & b, unsigned (*set_threads)(unsigned))
+{
+	const vector<unsigned> & threads = benchmark_settings().threads;
+	if (threads.empty())
+		return 0;
+
+	cout << "\tthreads" << flush;
+	// CPU time adds up the threads, so speedups are of the wall clock time
+	unsigned failures = 0;
+	vector<benchmark_result> results;
+	vector<double> wall, speedups;
+	for (size_t i = 0; i < threads.size(); ++i) {
+		ostringstream tname;
+		tname << name << "_t" << threads[i];
+		const unsigned previous = set_threads(threads[i]);
+		try {
+			results.push_back(measure(tname.str(), b, 0, threads[i]));
+		} catch (...) {
+			set_threads(previous);
+			throw;
+		}
+		set_threads(previous);
+		failures += results.back().failures;
+		wall.push_back(benchmark_statistics(results.back().wall).median);
+		speedups.push_back(wall.back() > 0 ? wall[0] / wall.back() : 0);
+		cout << '.' << flush;
+		if (failures)
+			break;
+	}
+	cout << endl;
+
+	print_row("threads", threads);
+	print_row("cpu", results);
+	print_row("wall/s", wall);
+	print_row("speedup", speedups);
+	return failures;
+}
@@ -0,0 +1,243 @@
+/** @file benchmark.h
+ *
+ *  Running the timings with repetitions and recording their statistics. */
+
+/*
+ *  GiNaC Copyright (C) 1999-2014 Johannes Gutenberg University Mainz, Germany
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#ifndef GINAC_CHECK_BENCHMARK_H
+#define GINAC_CHECK_BENCHMARK_H
+
+#include <cstddef>
+#include <iosfwd>
+#include <string>
+#include <vector>
+
+/** Settings of the benchmarks of a timing program.  They are taken from the
+ *  environment variables
+ *
+ *    GINAC_BENCHMARK_FILTER       comma separated list of patterns (with the
+ *                                 wildcards * and ?) of the benchmarks to
+ *                                 run, as "program/benchmark" or "benchmark"
+ *    GINAC_BENCHMARK_REPETITIONS  number of timed repetitions (default 1)
+ *    GINAC_BENCHMARK_WARMUPS      number of untimed runs before them (default 0)
+ *    GINAC_BENCHMARK_MIN_TIME     CPU time in seconds each repetition runs a
+ *                                 benchmark at least (default 0.1)
+ *    GINAC_BENCHMARK_OUTPUT       file the records are appended to
+ *    GINAC_BENCHMARK_FORMAT       "json" (one object per line) or "csv",
+ *                                 by default from the extension of the file
+ *    GINAC_BENCHMARK_LABEL        label of the records, like a commit id
+ *    GINAC_BENCHMARK_SCALING      if not empty or 0, time benchmarks also
+ *                                 for several problem sizes and fit the
+ *                                 exponent of their growth
+ *    GINAC_BENCHMARK_SIZES        comma separated list of problem sizes
+ *                                 instead of those of the programs (implies
+ *                                 GINAC_BENCHMARK_SCALING)
+ *    GINAC_BENCHMARK_THREADS      comma separated list of numbers of threads
+ *                                 to time benchmarks with parallel parts with
+ *
+ *  and may be overridden by the options --benchmark-filter=... and so on. */
+struct benchmark_options {
+	benchmark_options();
+
+	std::string program;
+	std::string filter;
+	unsigned repetitions;
+	unsigned warmups;
+	double min_time;
+	std::string output;
+	std::string format;
+	std::string label;
+	bool scaling;
+	std::vector<unsigned> sizes;
+	std::vector<unsigned> threads;
+};
+
+/** The settings used by run_benchmark(). */
+benchmark_options & benchmark_settings();
+
+/** Take the program name and the --benchmark-... options from the command
+ *  line and remove these options, leaving the program's own arguments. */
+void parse_benchmark_options(int & argc, char ** argv);
+
+/** The name of the benchmark of size n of a family, as in "vandermonde_8". */
+std::string benchmark_name(const std::string & family, unsigned n);
+
+/** Outcome of a benchmark.  The times are per run, in seconds, one for
+ *  each repetition. */
+struct benchmark_result {
+	benchmark_result();
+
+	std::string name;
+	unsigned size;            ///< problem size, 0 if not part of a scaling sweep
+	unsigned threads;         ///< number of threads, 0 if not part of a thread sweep
+	bool skipped;             ///< not selected by the filter
+	unsigned failures;        ///< failures reported by the runs
+	unsigned warmups;         ///< untimed runs
+	unsigned long runs;       ///< timed runs, of all repetitions
+	std::vector<double> cpu;  ///< CPU time of a run, for each repetition
+	std::vector<double> wall; ///< wall clock time of a run, for each repetition
+	double allocations;       ///< calls of operator new per timed run
+	double allocated_bytes;   ///< bytes requested from operator new per timed run
+	long peak_rss;            ///< peak resident set size of the process in kB (0 if unknown)
+
+	/** The median CPU time of a run. */
+	double time() const;
+};
+
+/** Prints the median CPU time of a run, or "skipped". */
+std::ostream & operator<<(std::ostream & os, const benchmark_result & r);
+
+/** Median, mean, standard deviation and minimum of samples. */
+struct benchmark_statistics {
+	explicit benchmark_statistics(const std::vector<double> & samples);
+
+	double median;
+	double mean;
+	double stddev;
+	double min;
+};
+
+/** Something to be timed. */
+class benchmark {
+public:
+	virtual ~benchmark() {}
+
+	/** Called before every run, without being timed. */
+	virtual void prepare() {}
+
+	/** Run once and return the number of failures. */
+	virtual unsigned run() = 0;
+};
+
+/** Run b, unless the filter excludes it, and record the result in the
+ *  output file.  Every repetition runs b until min_time has elapsed (and at
+ *  least once).  It stops at the first failure. */
+benchmark_result run_benchmark(const std::string & name, benchmark & b);
+
+/** Benchmark of a function without arguments. */
+template <typename R>
+class function_benchmark : public benchmark {
+public:
+	function_benchmark(R (*f_)()) : f(f_) {}
+	unsigned run() { return f(); }
+private:
+	R (*f)();
+};
+
+/** Benchmark of a function with one argument. */
+template <typename R, typename P, typename A>
+class bound_benchmark : public benchmark {
+public:
+	bound_benchmark(R (*f_)(P), const A & a_) : f(f_), a(a_) {}
+	unsigned run() { return f(a); }
+private:
+	R (*f)(P);
+	const A & a;
+};
+
+/** Benchmark f(), which returns the number of failures. */
+template <typename R>
+benchmark_result run_benchmark(const std::string & name, R (*f)())
+{
+	function_benchmark<R> b(f);
+	return run_benchmark(name, static_cast<benchmark &>(b));
+}
+
+/** Benchmark f(a), which returns the number of failures. */
+template <typename R, typename P, typename A>
+benchmark_result run_benchmark(const std::string & name, R (*f)(P), const A & a)
+{
+	bound_benchmark<R, P, A> b(f, a);
+	return run_benchmark(name, static_cast<benchmark &>(b));
+}
+
+/** Power law time = coefficient*size^exponent fitted to the times of
+ *  benchmarks of several sizes. */
+struct scaling_fit {
+	scaling_fit();
+
+	double exponent;
+	double coefficient;
+	unsigned points;  ///< number of sizes fitted, less than 2 means no fit
+};
+
+/** Fit a power law to the median CPU times of benchmarks of the sizes
+ *  given, by least squares of their logarithms. */
+scaling_fit fit_scaling(const std::vector<unsigned> & sizes, const std::vector<benchmark_result> & results);
+
+/** Something to be timed for several problem sizes. */
+class scalable_benchmark : public benchmark {
+public:
+	/** Set the problem size of the next runs. */
+	virtual void resize(unsigned n) = 0;
+};
+
+/** If scaling is enabled, time b for the sizes of the settings, or else the
+ *  default ones, as benchmarks family_n.  Print the times and the fitted
+ *  exponent of the growth with the parameter and record the fit.  Return
+ *  the number of failures. */
+unsigned run_scaling(const std::string & family, const std::string & parameter,
+                     scalable_benchmark & b, const std::vector<unsigned> & default_sizes);
+
+/** Time b as benchmarks name_tN for the numbers of threads N of the
+ *  settings, which are put into effect with set_threads() (one of GiNaC's
+ *  set_..._threads() functions) and then restored.  Print the times and
+ *  the speedups of the wall clock time.  Return the number of failures. */
+unsigned run_thread_sweep(const std::string & name, benchmark & b, unsigned (*set_threads)(unsigned));
+
+/** Scalable benchmark of a function of the size. */
+template <typename R>
+class sized_function_benchmark : public scalable_benchmark {
+public:
+	sized_function_benchmark(R (*f_)(unsigned)) : f(f_), n(0) {}
+	void resize(unsigned n_) { n = n_; }
+	unsigned run() { return f(n); }
+private:
+	R (*f)(unsigned);
+	unsigned n;
+};
+
+/** Time f(n) for the sizes n of the settings or else the default ones. */
+template <typename R, std::size_t N>
+unsigned run_scaling(const std::string & family, const std::string & parameter,
+                     R (*f)(unsigned), const unsigned (&default_sizes)[N])
+{
+	sized_function_benchmark<R> b(f);
+	return run_scaling(family, parameter, b,
+	                   std::vector<unsigned>(default_sizes, default_sizes + N));
+}
+
+/** Time f() for the numbers of threads of the settings. */
+template <typename R>
+unsigned run_thread_sweep(const std::string & name, R (*f)(), unsigned (*set_threads)(unsigned))
+{
+	function_benchmark<R> b(f);
+	return run_thread_sweep(name, b, set_threads);
+}
+
+/** Time f(a) for the numbers of threads of the settings. */
+template <typename R, typename P, typename A>
+unsigned run_thread_sweep(const std::string & name, R (*f)(P), const A & a,
+                          unsigned (*set_threads)(unsigned))
+{
+	bound_benchmark<R, P, A> b(f, a);
+	return run_thread_sweep(name, b, set_threads);
+}
+
+#endif // ndef GINAC_CHECK_BENCHMARK_H
@@ -34,7 +34,7 @@ extern const ex
 dense_univariate_poly(const symbol & x, unsigned degree);
 
 static unsigned check_matrix_solve(unsigned m, unsigned n, unsigned p,
-								   unsigned degree)
+								   unsigned degree, unsigned algo = solve_algo::automatic)
 {
 	const symbol a("a");
 	matrix A(m,n);
@@ -68,11 +68,12 @@ static unsigned check_matrix_solve(unsigned m, unsigned n, unsigned p,
 	matrix sol(n,p);
 	// Solve the system A*X==B:
 	try {
-		sol = A.solve(X, B);
+		sol = A.solve(X, B, algo);
 	} catch (const exception & err) {  // catch runtime_error
 		// Presumably, the coefficient matrix A was degenerate
 		string errwhat = err.what();
-		if (errwhat == "matrix::solve(): inconsistent linear system")
+		if (errwhat == "matrix::solve(): inconsistent linear system" ||
+		    errwhat == "sparse_matrix::solve(): inconsistent linear system")
 			return 0;
 		else
 			clog << "caught exception: " << errwhat << endl;
@@ -164,6 +165,96 @@ static unsigned check_inifcns_lsolve(unsigned n)
 	return result;
 }
 
+static unsigned check_sparse_lsolve(unsigned n)
+{
+	unsigned result = 0;
+	const symbol a("a");
+
+	// a large system with three unknowns per equation, which lsolve()
+	// solves without setting up a dense matrix
+	vector<symbol> x;
+	for (unsigned i=0; i<n; ++i) {
+		ostringstream buf;
+		buf << "x" << i << ends;
+		x.push_back(symbol(buf.str()));
+	}
+	lst eqns, vars;
+	for (unsigned i=0; i<n; ++i) {
+		ex lhs = (rand()%19-9)*x[(i*7)%n] + (rand()%19+1)*x[i] + a*x[(i+1)%n];
+		eqns.append(lhs == rand()%201-100);
+		vars.append(x[i]);
+	}
+	const ex sol = lsolve(eqns, vars);
+	if (sol.nops() != n) {
+		clog << "sparse system was not solved: " << sol << endl;
+		return 1;
+	}
+	for (unsigned i=0; i<n; ++i) {
+		if (!(eqns.op(i).lhs().subs(sol) - eqns.op(i).rhs()).normal().is_zero()) {
+			clog << "sparse system: equation " << eqns.op(i) << " is not satisfied by "
+			     << sol << endl;
+			++result;
+			break;
+		}
+	}
+	return result;
+}
+
+enum lu_entry_kind { lu_polynomial, lu_float, lu_fraction };
+
+static ex random_entry(const symbol & a, unsigned degree, lu_entry_kind kind)
+{
+	switch (kind) {
+		case lu_float:
+			return (dense_univariate_poly(a, 0)/RAND_MAX).evalf();
+		case lu_fraction:
+			return dense_univariate_poly(a, degree)/(a + rand()%3 + 1);
+		default:
+			return dense_univariate_poly(a, degree);
+	}
+}
+
+static unsigned check_lu_solve(unsigned n, unsigned p, unsigned degree,
+                               lu_entry_kind kind = lu_polynomial)
+{
+	const bool inexact = (kind == lu_float);
+	const symbol a("a");
+	matrix A(n,n);
+	for (unsigned ro=0; ro<n; ++ro)
+		for (unsigned co=0; co<n; ++co)
+			A.set(ro,co,random_entry(a,degree,kind));
+	// the coefficient matrix must not be degenerate
+	if (A.determinant().is_zero())
+		return 0;
+	const lu_decomposition lu = A.lu_decompose();
+
+	if (inexact ? abs(ex_to<numeric>(lu.determinant() - A.determinant())) > 1e-10*abs(ex_to<numeric>(A.determinant()))
+	            : !(lu.determinant() - A.determinant()).normal().is_zero()) {
+		clog << "LU decomposition of " << A << " gives the determinant "
+		     << lu.determinant() << endl;
+		return 1;
+	}
+
+	// solve for several right hand sides, one after another
+	for (unsigned k=0; k<p; ++k) {
+		matrix B(n,1);
+		for (unsigned ro=0; ro<n; ++ro)
+			B.set(ro,0,random_entry(a,degree,kind));
+		const matrix X = lu.solve(B);
+		for (unsigned ro=0; ro<n; ++ro) {
+			ex e = -B(ro,0);
+			for (unsigned co=0; co<n; ++co)
+				e += A(ro,co)*X(co,0);
+			if (inexact ? abs(ex_to<numeric>(e)) > 1e-10 : !e.normal().is_zero()) {
+				clog << "LU decomposition of " << A << " solves" << endl
+				     << "A*X == " << B << " with X == " << X << endl;
+				return 1;
+			}
+		}
+	}
+	return 0;
+}
+
 unsigned check_lsolve()
 {
 	unsigned result = 0;
@@ -190,6 +281,25 @@ unsigned check_lsolve()
 	for (unsigned n=1; n<8; ++n)
 		result += check_matrix_solve(n, n, 1, 2);
 	cout << '.' << flush;
+	// solve some of them with the sparse elimination
+	for (unsigned n=1; n<14; ++n) {
+		result += check_matrix_solve(n, n, 1, 0, solve_algo::sparse);
+		result += check_matrix_solve(n+1, n, 1, 0, solve_algo::sparse);
+		result += check_matrix_solve(n, n+1, n/3+1, 0, solve_algo::sparse);
+	}
+	for (unsigned n=1; n<8; ++n)
+		result += check_matrix_solve(n, n, 1, 2, solve_algo::sparse);
+	cout << '.' << flush;
+	// solve with an LU decomposition for several right hand sides
+	for (unsigned n=1; n<14; ++n) {
+		result += check_lu_solve(n, 4, 0);
+		result += check_lu_solve(n, 4, 0, lu_float);
+	}
+	for (unsigned n=1; n<7; ++n) {
+		result += check_lu_solve(n, 3, 2);
+		result += check_lu_solve(n, 3, 1, lu_fraction);
+	}
+	cout << '.' << flush;
 	
 	// check lsolve, the wrapper function around matrix::solve()
 	result += check_inifcns_lsolve(2);  cout << '.' << flush;
@@ -197,6 +307,7 @@ unsigned check_lsolve()
 	result += check_inifcns_lsolve(4);  cout << '.' << flush;
 	result += check_inifcns_lsolve(5);  cout << '.' << flush;
 	result += check_inifcns_lsolve(6);  cout << '.' << flush;
+	result += check_sparse_lsolve(60);  cout << '.' << flush;
 		
 	return result;
 }
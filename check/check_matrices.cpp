@@ -153,15 +153,101 @@ static unsigned compare_matrix_determinants()
 		ex det_laplace = A.determinant(determinant_algo::laplace);
 		ex det_divfree = A.determinant(determinant_algo::divfree);
 		ex det_bareiss = A.determinant(determinant_algo::bareiss);
+		ex det_modular = A.determinant(determinant_algo::modular);
 		if ((det_gauss-det_laplace).normal() != 0 ||
 			(det_bareiss-det_laplace).normal() != 0 ||
-			(det_divfree-det_laplace).normal() != 0) {
+			(det_divfree-det_laplace).normal() != 0 ||
+			(det_modular-det_laplace).normal() != 0) {
 			clog << "Determinant of " << size << "x" << size << " matrix "
 			     << endl << A << endl
 			     << "is inconsistent between different algorithms:" << endl
 			     << "Gauss elimination:   " << det_gauss << endl
 			     << "Minor elimination:   " << det_laplace << endl
 			     << "Division-free elim.: " << det_divfree << endl
+			     << "Fraction-free elim.: " << det_bareiss << endl
+			     << "Modular evaluation:  " << det_modular << endl;
+			++result;
+		}
+	}
+	
+	return result;
+}
+
+/* determinants of sparse symbolic matrices by elimination with all pivot
+ * strategies, recording the sizes of the intermediate expressions. */
+static unsigned pivot_strategy_determinants()
+{
+	unsigned result = 0;
+	symbol a("a"), b("b");
+	const unsigned strategies[] = { pivot_strategy::first_nonzero, pivot_strategy::min_terms,
+	                                pivot_strategy::markowitz, pivot_strategy::min_fill };
+	const unsigned previous = get_pivot_strategy();
+	const bool recording = set_elimination_statistics(true);
+	
+	for (unsigned size=2; size<7; ++size) {
+		matrix A(size,size);
+		for (unsigned ro=0; ro<size; ++ro)
+			for (unsigned co=0; co<size; ++co)
+				if (rand()%2 == 0)
+					A.set(ro,co,sparse_tree(a, b, a, rand()%3, false, true, false));
+		const ex det_laplace = A.determinant(determinant_algo::laplace);
+		for (unsigned k=0; k<4; ++k) {
+			set_pivot_strategy(strategies[k]);
+			const ex det_gauss = A.determinant(determinant_algo::gauss);
+			const ex det_divfree = A.determinant(determinant_algo::divfree);
+			const ex det_bareiss = A.determinant(determinant_algo::bareiss);
+			const elimination_statistics stats = get_elimination_statistics();
+			if ((det_gauss-det_laplace).normal() != 0 ||
+			    (det_divfree-det_laplace).normal() != 0 ||
+			    (det_bareiss-det_laplace).normal() != 0) {
+				clog << "Determinant of " << size << "x" << size << " matrix "
+				     << endl << A << endl
+				     << "with pivot strategy " << strategies[k]
+				     << " is inconsistent between different algorithms:" << endl
+				     << "Gauss elimination:   " << det_gauss << endl
+				     << "Minor elimination:   " << det_laplace << endl
+				     << "Division-free elim.: " << det_divfree << endl
+				     << "Fraction-free elim.: " << det_bareiss << endl;
+				++result;
+			} else if (!det_laplace.is_zero() &&
+			           (stats.terms.size() != size-1 || stats.nonzeros.size() != size-1)) {
+				clog << "Fraction-free elimination of " << size << "x" << size
+				     << " matrix " << A << " recorded " << stats.terms.size()
+				     << " steps" << endl;
+				++result;
+			}
+		}
+	}
+	
+	set_elimination_statistics(recording);
+	set_pivot_strategy(previous);
+	return result;
+}
+
+/* determinants of dense multivariate polynomial matrices with large rational
+ * coefficients, modulo primes and by fraction-free elimination. */
+static unsigned modular_matrix_determinants()
+{
+	unsigned result = 0;
+	symbol a("a"), b("b"), c("c");
+	
+	for (unsigned size=2; size<7; ++size) {
+		matrix A(size,size);
+		for (unsigned co=0; co<size; ++co) {
+			for (unsigned ro=0; ro<size; ++ro) {
+				ex elem = 0;
+				for (unsigned t=0; t<3; ++t)
+					elem += numeric(rand()%2001-1000, rand()%7+1)
+					      * pow(a,rand()%3) * pow(b,rand()%2) * pow(c,rand()%2);
+				A.set(ro,co,elem*pow(numeric(10),13));
+			}
+		}
+		ex det_modular = A.determinant(determinant_algo::modular);
+		ex det_bareiss = A.determinant(determinant_algo::bareiss);
+		if (!(det_modular-det_bareiss).expand().is_zero()) {
+			clog << "Determinant of " << size << "x" << size << " matrix "
+			     << endl << A << endl
+			     << "modulo primes:       " << det_modular << endl
 			     << "Fraction-free elim.: " << det_bareiss << endl;
 			++result;
 		}
@@ -170,6 +256,143 @@ static unsigned compare_matrix_determinants()
 	return result;
 }
 
+/* determinants of matrices with an own symbol in each entry, where the dense
+ * grid of evaluation points would be too large, so the modular algorithm
+ * interpolates sparsely. */
+static unsigned sparse_modular_matrix_determinants()
+{
+	unsigned result = 0;
+	
+	for (unsigned size=5; size<7; ++size) {
+		matrix A(size,size);
+		for (unsigned ro=0; ro<size; ++ro) {
+			for (unsigned co=0; co<size; ++co) {
+				std::string name = "x";
+				name += char('0' + ro);
+				name += char('0' + co);
+				symbol x(name);
+				A.set(ro,co,x + numeric(rand()%201-100, rand()%5+1));
+			}
+		}
+		ex det_modular = A.determinant(determinant_algo::modular);
+		ex det_laplace = A.determinant(determinant_algo::laplace);
+		if (!(det_modular-det_laplace).expand().is_zero()) {
+			clog << "Determinant of " << size << "x" << size << " matrix "
+			     << endl << A << endl
+			     << "modulo primes:       " << det_modular << endl
+			     << "Minor elimination:   " << det_laplace << endl;
+			++result;
+		}
+	}
+	
+	return result;
+}
+
+/* determinants, inverses and ranks of matrices of rational and floating
+ * point numbers, compared with exact elimination on expressions. */
+static unsigned numeric_matrix_algorithms()
+{
+	unsigned result = 0;
+	
+	for (unsigned size=2; size<13; ++size) {
+		matrix A(size,size), F(size,size);
+		for (unsigned ro=0; ro<size; ++ro) {
+			for (unsigned co=0; co<size; ++co) {
+				ex elem = numeric(rand()%201-100, rand()%5+1);
+				A.set(ro,co,elem);
+				F.set(ro,co,elem.evalf());
+			}
+		}
+		ex det = A.determinant();
+		ex det_gauss = A.determinant(determinant_algo::gauss);
+		if (det != det_gauss) {
+			clog << "Determinant of rational " << size << "x" << size
+			     << " matrix " << endl << A << endl
+			     << "is " << det << " instead of " << det_gauss << endl;
+			++result;
+		}
+		if (det.is_zero())
+			continue;
+		matrix B = A.inverse();
+		matrix C = A.mul(B);
+		for (unsigned ro=0; ro<size; ++ro)
+			for (unsigned co=0; co<size; ++co)
+				if (C(ro,co) != (ro==co?1:0)) {
+					clog << "Inverse of rational " << size << "x" << size
+					     << " matrix " << endl << A << endl
+					     << "erroneously returned: " << endl << B << endl;
+					++result;
+					ro = co = size;
+				}
+		ex det_float = F.determinant();
+		if (abs(ex_to<numeric>(det_float - det.evalf()))
+		    > abs(ex_to<numeric>(det.evalf()))*numeric(1,1000000)) {
+			clog << "Determinant of float " << size << "x" << size
+			     << " matrix " << endl << F << endl
+			     << "is " << det_float << " instead of " << det.evalf() << endl;
+			++result;
+		}
+		// Rows 0 and 1 replaced by multiples of row 2 drop the rank by 2
+		if (size > 2) {
+			matrix R(A);
+			for (unsigned co=0; co<size; ++co) {
+				R.set(0,co,3*A(2,co));
+				R.set(1,co,numeric(-1,7)*A(2,co));
+			}
+			if (R.rank() != size-2 || A.rank() != size) {
+				clog << "Rank of " << size << "x" << size << " matrix "
+				     << endl << R << endl << "is " << R.rank()
+				     << " instead of " << size-2 << endl;
+				++result;
+			}
+		}
+	}
+	
+	return result;
+}
+
+/* characteristic polynomials of matrices with functions, polynomials and
+ * fractions inside, compared with the determinant of M - lambda*1. */
+static unsigned symbolic_matrix_charpoly()
+{
+	unsigned result = 0;
+	symbol a("a"), b("b"), c("c"), lambda("lambda");
+	const unsigned previous = get_matrix_threads();
+	
+	for (unsigned size=2; size<6; ++size) {
+		for (unsigned kind=0; kind<3; ++kind) {
+			// with several threads if possible
+			set_matrix_threads(size%2 ? 3 : 1);
+			matrix A(size,size);
+			for (unsigned ro=0; ro<size; ++ro) {
+				for (unsigned co=0; co<size; ++co) {
+					ex elem = 0;
+					if (rand()%3)
+						elem = sparse_tree(a, b, c, 1+rand()%2, kind==1, true, false);
+					if (kind==2)
+						elem = elem/(a+co+1);
+					A.set(ro,co,elem);
+				}
+			}
+			matrix M(A);
+			for (unsigned d=0; d<size; ++d)
+				M.set(d,d,M(d,d)-lambda);
+			ex p = A.charpoly(lambda);
+			ex q = M.determinant(determinant_algo::laplace);
+			if (!(p-q).normal().is_zero()) {
+				clog << "characteristic polynomial of " << size << "x" << size
+				     << " matrix " << endl << A << endl
+				     << "erroneously returned " << p << endl
+				     << "instead of " << q << endl;
+				++result;
+			}
+		}
+	}
+	set_matrix_threads(previous);
+	
+	return result;
+}
+
 static unsigned symbolic_matrix_inverse()
 {
 	unsigned result = 0;
@@ -217,6 +440,11 @@ unsigned check_matrices()
 	result += rational_matrix_determinants();  cout << '.' << flush;
 	result += funny_matrix_determinants();  cout << '.' << flush;
 	result += compare_matrix_determinants();  cout << '.' << flush;
+	result += pivot_strategy_determinants();  cout << '.' << flush;
+	result += modular_matrix_determinants();  cout << '.' << flush;
+	result += sparse_modular_matrix_determinants();  cout << '.' << flush;
+	result += numeric_matrix_algorithms();  cout << '.' << flush;
+	result += symbolic_matrix_charpoly();  cout << '.' << flush;
 	result += symbolic_matrix_inverse();  cout << '.' << flush;
 	
 	return result;
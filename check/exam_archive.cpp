@@ -25,8 +25,437 @@ using namespace GiNaC;
 
 #include <fstream>
 #include <iostream>
+#include <sstream>
+#include <stdexcept>
 using namespace std;
 
+static unsigned exam_archive_indexed()
+{
+	unsigned result = 0;
+
+	symbol x("x"), y("y");
+	ex e1 = pow(x + y, 7).expand() + sin(x/3);
+	ex e2 = lst(x*y, 42, pow(y, -2), 2.5 + I*x);
+
+	archive ar;
+	ar.archive_ex(e1, "first");
+	ar.archive_ex(e2, "second");
+	ar.save_indexed("exam_indexed.gar");
+
+	archive loaded;
+	loaded.load_indexed("exam_indexed.gar");
+	if (loaded.num_expressions() != 2) {
+		clog << "indexed archive holds " << loaded.num_expressions()
+		     << " expressions instead of 2" << endl;
+		++result;
+	}
+	ex f2 = loaded.unarchive_ex(lst(x, y), "second");
+	if (!f2.is_equal(e2)) {
+		clog << "indexed archive returned " << f2 << " instead of " << e2 << endl;
+		++result;
+	}
+	std::string name;
+	ex f1 = loaded.unarchive_ex(lst(x, y), name, 0);
+	if (name != "first" || !(f1 - e1).expand().is_zero()) {
+		clog << "indexed archive returned " << name << " = " << f1
+		     << " instead of first = " << e1 << endl;
+		++result;
+	}
+
+	// An expression added to a loaded archive must survive a round trip
+	// through the stream format together with the loaded ones.
+	loaded.archive_ex(e1 * x, "third");
+	stringstream s;
+	s << loaded;
+	archive copy;
+	s >> copy;
+	ex f3 = copy.unarchive_ex(lst(x, y), "third");
+	ex g2 = copy.unarchive_ex(lst(x, y), "second");
+	if (!(f3 - e1 * x).expand().is_zero() || !g2.is_equal(e2)) {
+		clog << "re-archiving an indexed archive returned " << f3 << " and "
+		     << g2 << " instead of " << e1 * x << " and " << e2 << endl;
+		++result;
+	}
+
+	return result;
+}
+
+static unsigned exam_archive_streamed()
+{
+	unsigned result = 0;
+
+	symbol x("x"), y("y");
+	ex e1 = lst(x*y, 42, pow(y, -2), 2.5 + I*x);
+	ex e2 = pow(x + y, 9).expand() + cos(x*y);
+	ex e3 = e2 + x*y;
+
+	// The first expression is archived in memory, the others are written
+	// node by node
+	archive ar;
+	ar.archive_ex(e1, "first");
+	{
+		std::ofstream fout("exam_streamed.gar", std::ios_base::binary);
+		ar.start_indexed(fout);
+		ar.archive_ex(e2, "second");
+		ar.archive_ex(e3, "third");
+		ar.finish_indexed();
+	}
+	if (ar.num_expressions() != 0) {
+		clog << "finish_indexed() did not clear the archive" << endl;
+		++result;
+	}
+
+	archive loaded;
+	loaded.load_indexed("exam_streamed.gar");
+	ex f1 = loaded.unarchive_ex(lst(x, y), "first");
+	ex f2 = loaded.unarchive_ex(lst(x, y), "second");
+	ex f3 = loaded.unarchive_ex(lst(x, y), "third");
+	if (!f1.is_equal(e1) || !(f2 - e2).expand().is_zero() || !(f3 - e3).expand().is_zero()) {
+		clog << "streamed archive returned " << f1 << ", " << f2 << ", " << f3
+		     << " instead of " << e1 << ", " << e2 << ", " << e3 << endl;
+		++result;
+	}
+
+	return result;
+}
+
+static unsigned exam_archive_compressed()
+{
+	unsigned result = 0;
+
+	// Large enough to be split into several blocks
+	symbol x("x"), y("y"), z("z");
+	ex e1 = pow(x + y + z + 1, 25).expand();
+	ex e2 = lst(x*y, 42, pow(y, -2), 2.5 + I*x);
+
+	archive ar;
+	ar.archive_ex(e1, "first");
+	ar.archive_ex(e2, "second");
+	try {
+		ar.save_indexed("exam_compressed.gar", true);
+	} catch (const std::runtime_error &) {
+		// GiNaC was built without compression support
+		return result;
+	}
+
+	archive loaded;
+	loaded.load_indexed("exam_compressed.gar");
+	ex f2 = loaded.unarchive_ex(lst(x, y, z), "second");
+	ex f1 = loaded.unarchive_ex(lst(x, y, z), "first");
+	if (!f2.is_equal(e2) || !(f1 - e1).is_zero()) {
+		clog << "compressed archive returned " << f2 << " instead of " << e2
+		     << " or did not return the expansion of " << pow(x + y + z + 1, 25) << endl;
+		++result;
+	}
+
+	return result;
+}
+
+static unsigned exam_archive_parallel()
+{
+	unsigned result = 0;
+
+	// A sum with shared subexpressions, symbols and numbers
+	symbol x("x"), y("y");
+	ex shared = sin(x + y) / 3;
+	exvector terms;
+	for (int i = 1; i <= 40; ++i)
+		terms.push_back(pow(x, i) * shared + numeric(i, 7) * pow(y + i, 2) + cos(shared * i));
+	ex e = add(terms);
+
+	stringstream s;
+	s << archive(e, "e");
+	archive ar;
+	s >> ar;
+
+	const unsigned previous = set_unarchive_threads(4);
+	ex f = ar.unarchive_ex(lst(x, y), "e");
+	set_unarchive_threads(previous);
+	if (!f.is_equal(e)) {
+		clog << "parallel unarchiving returned " << f << " instead of " << e << endl;
+		++result;
+	}
+
+	// Unknown symbols must be created once, not once per thread
+	archive ar2;
+	s.clear();
+	s.seekg(0);
+	s >> ar2;
+	set_unarchive_threads(4);
+	ex g = ar2.unarchive_ex(lst(), "e");
+	set_unarchive_threads(previous);
+	exset syms;
+	for (const_preorder_iterator i = g.preorder_begin(); i != g.preorder_end(); ++i)
+		if (is_a<symbol>(*i))
+			syms.insert(*i);
+	if (syms.size() != 2) {
+		clog << "parallel unarchiving created " << syms.size()
+		     << " symbols instead of 2" << endl;
+		++result;
+	}
+
+	return result;
+}
+
+static unsigned exam_archive_sharing()
+{
+	unsigned result = 0;
+
+	// Subexpressions archived once must be unarchived once
+	symbol x("x"), y("y");
+	ex s = sin(x + y);
+	ex e = lst(s, s * 2, x);
+
+	stringstream ss;
+	ss << archive(e, "e");
+	archive ar;
+	ss >> ar;
+	ex f = ar.unarchive_ex(lst(x, y), "e");
+	if (!f.is_equal(e)) {
+		clog << "archive returned " << f << " instead of " << e << endl;
+		++result;
+	} else if (!are_ex_trivially_equal(f.op(0), f.op(1).op(0))) {
+		clog << "subexpression " << s << " is not shared after unarchiving" << endl;
+		++result;
+	} else if (!are_ex_trivially_equal(f.op(2), x)) {
+		clog << "symbol " << x << " was copied instead of shared" << endl;
+		++result;
+	}
+
+	return result;
+}
+
+static unsigned exam_serialize()
+{
+	unsigned result = 0;
+
+	symbol x("x"), y("y"), z("z");
+	ex e1 = pow(x + y, 5).expand() + sin(z) / 3;
+	ex e2 = lst(z * x, numeric(5, 7), 2.5 + I*y);
+
+	// Two expressions in one buffer, x and y are in the table
+	std::string buf;
+	serialize(e1, buf, lst(x, y));
+	serialize(e2, buf, lst(x, y));
+
+	// The receiving side has other symbols of the same names
+	symbol x2("x"), y2("y");
+	lst syms(x2, y2);
+	std::size_t pos = 0;
+	ex f1 = deserialize(buf, pos, syms);
+	ex f2 = deserialize(buf, pos, syms);
+	if (pos != buf.size()) {
+		clog << "deserialize() read " << pos << " of " << buf.size() << " bytes" << endl;
+		++result;
+	}
+	if (syms.nops() != 3) {
+		clog << "deserialize() left the symbols " << syms << " instead of x, y, z" << endl;
+		return ++result;
+	}
+
+	// z must be the same symbol in both expressions
+	lst subs_lst(x == x2, y == y2, z == syms.op(2));
+	ex g1 = e1.subs(subs_lst), g2 = e2.subs(subs_lst);
+	if (!(f1 - g1).expand().is_zero() || !f2.is_equal(g2)) {
+		clog << "deserialize() returned " << f1 << " and " << f2 << " instead of "
+		     << g1 << " and " << g2 << endl;
+		++result;
+	}
+
+	return result;
+}
+
+/* A sum split into shards, expanded shard by shard as if by other processes
+ * and added up in a reduction tree, gives the serial result. */
+static ex expand_term(const ex & e)
+{
+	return e.expand();
+}
+
+static unsigned exam_shards()
+{
+	unsigned result = 0;
+
+	symbol x("x"), y("y");
+	ex e = 3;
+	for (int k = 1; k <= 20; ++k)
+		e += pow(x + k*y, 3) - k * pow(x, 3) + sin(x + k);
+	const ex expected = e.map(expand_term);
+
+	std::vector<std::string> shards;
+	serialize_shards(e, 5, shards, lst(x, y));
+	if (shards.size() != 5) {
+		clog << "serialize_shards() made " << shards.size() << " shards instead of 5" << endl;
+		return ++result;
+	}
+
+	// Each "process" has its own symbols of the same names
+	pointer_to_map_function expander(expand_term);
+	std::vector<std::string> mapped;
+	for (std::size_t k = 0; k < shards.size(); ++k) {
+		symbol xk("x"), yk("y");
+		lst syms(xk, yk);
+		mapped.push_back(map_shard(shards[k], expander, syms));
+	}
+	lst syms(x, y);
+	std::vector<std::string> left(mapped.begin(), mapped.begin() + 2);
+	std::vector<std::string> right(mapped.begin() + 2, mapped.end());
+	std::vector<std::string> tree;
+	tree.push_back(combine_shards(left, syms));
+	tree.push_back(combine_shards(right, syms));
+	const ex sum = sum_shards(tree, syms);
+	if (!sum.is_equal(expected)) {
+		clog << "expanding the shards gave " << sum << " instead of " << expected << endl;
+		++result;
+	}
+
+	// Something which is not a sum is the first shard
+	serialize_shards(sin(x), 2, shards, syms);
+	if (!sum_shards(shards, syms).is_equal(sin(x))) {
+		clog << "the shards of sin(x) add up to " << sum_shards(shards, syms) << endl;
+		++result;
+	}
+
+	return result;
+}
+
+static unsigned cached_evaluations = 0;
+
+DECLARE_FUNCTION_1P(cached_fcn)
+
+static ex cached_fcn_eval(const ex & x)
+{
+	++cached_evaluations;
+	return cached_fcn(x).hold();
+}
+
+REGISTER_FUNCTION(cached_fcn, eval_func(cached_fcn_eval).remember(16));
+
+static unsigned exam_caches()
+{
+	unsigned result = 0;
+
+	symbol x("x"), y("y");
+	const std::size_t old_limit = set_factor_cache_size(100);
+	factor(pow(x, 4) - pow(y, 4));
+	for (int i = 0; i < 5; ++i)
+		cached_fcn(i);
+	bernoulli(40);
+	save_caches("exam_caches.dat", lst(x, y));
+
+	// A fresh start: the caches are empty
+	set_factor_cache_size(0);
+	set_factor_cache_size(100);
+	function::clear_remember(cached_fcn_SERIAL::serial);
+	if (!load_caches("exam_caches.dat", lst(x, y))) {
+		clog << "load_caches() did not load the caches just saved" << endl;
+		++result;
+	}
+	if (get_factor_cache_statistics().size != 3) {
+		clog << "the factor cache holds " << get_factor_cache_statistics().size
+		     << " factors instead of 3 after loading" << endl;
+		++result;
+	}
+	cached_evaluations = 0;
+	for (int i = 0; i < 5; ++i)
+		cached_fcn(i);
+	if (cached_evaluations != 0) {
+		clog << "cached_fcn() was evaluated " << cached_evaluations
+		     << " times after loading its remember table" << endl;
+		++result;
+	}
+	if (!bernoulli(40).is_equal(numeric("-261082718496449122051/13530"))) {
+		clog << "bernoulli(40) is " << bernoulli(40) << " after loading" << endl;
+		++result;
+	}
+	set_factor_cache_size(old_limit);
+
+	// Caches of other versions are ignored
+	std::string contents;
+	{
+		std::ifstream fin("exam_caches.dat", std::ios_base::binary);
+		std::ostringstream buf;
+		buf << fin.rdbuf();
+		contents = buf.str();
+	}
+	contents[contents.find(GINACLIB_VERSION)] = 'x';
+	{
+		std::ofstream fout("exam_caches.dat", std::ios_base::binary);
+		fout << contents;
+	}
+	if (load_caches("exam_caches.dat") || load_caches("exam_no_caches.dat")) {
+		clog << "load_caches() loaded a file of another version or none at all" << endl;
+		++result;
+	}
+
+	return result;
+}
+
+static unsigned exam_archive_statistics()
+{
+	unsigned result = 0;
+
+	symbol x("x"), y("y");
+	archive ar;
+	ar.archive_ex(sin(x+y) + cos(x+y), "e");
+	archive_statistics stats = ar.get_statistics();
+	if (stats.dedup_hits == 0 || stats.bytes_written != 0) {
+		clog << "archive statistics report " << stats.dedup_hits
+		     << " deduplicated subexpressions and " << stats.bytes_written
+		     << " bytes written after archiving" << endl;
+		++result;
+	}
+
+	stringstream s;
+	s << ar;
+	stats = ar.get_statistics();
+	if (stats.bytes_written != s.str().size()) {
+		clog << "archive statistics report " << stats.bytes_written
+		     << " bytes written instead of " << s.str().size() << endl;
+		++result;
+	}
+
+	archive copy;
+	s >> copy;
+	archive_statistics copy_stats = copy.get_statistics();
+	if (copy_stats.nodes != stats.nodes || copy_stats.atoms != stats.atoms) {
+		clog << "archive read from stream has " << copy_stats.nodes << " nodes and "
+		     << copy_stats.atoms << " atoms instead of " << stats.nodes
+		     << " and " << stats.atoms << endl;
+		++result;
+	}
+
+	return result;
+}
+
+static unsigned exam_archive_listing()
+{
+	unsigned result = 0;
+
+	symbol x("x"), y("y");
+	archive ar;
+	ar.archive_ex(lst(x, x, y), "list");
+	ar.archive_ex(sin(x), "sine");
+	if (ar.get_name(1) != "sine" || ar.count_nodes(0) != 3 || ar.count_nodes(1) != 2) {
+		clog << "archive lists " << ar.get_name(1) << " and counts "
+		     << ar.count_nodes(0) << " and " << ar.count_nodes(1)
+		     << " nodes instead of sine, 3 and 2" << endl;
+		++result;
+	}
+
+	ar.save_indexed("exam_listing.gar");
+	archive loaded;
+	loaded.load_indexed("exam_listing.gar");
+	if (loaded.get_name(0) != "list" || loaded.count_nodes(0) != 3 || loaded.count_nodes(1) != 2) {
+		clog << "indexed archive lists " << loaded.get_name(0) << " and counts "
+		     << loaded.count_nodes(0) << " and " << loaded.count_nodes(1)
+		     << " nodes instead of list, 3 and 2" << endl;
+		++result;
+	}
+
+	return result;
+}
+
 unsigned exam_archive()
 {
 	unsigned result = 0;
@@ -73,6 +502,17 @@ unsigned exam_archive()
 		++result;
 	}
 
+	result += exam_archive_indexed(); cout << '.' << flush;
+	result += exam_archive_streamed(); cout << '.' << flush;
+	result += exam_archive_compressed(); cout << '.' << flush;
+	result += exam_archive_parallel(); cout << '.' << flush;
+	result += exam_archive_sharing(); cout << '.' << flush;
+	result += exam_serialize(); cout << '.' << flush;
+	result += exam_shards(); cout << '.' << flush;
+	result += exam_caches(); cout << '.' << flush;
+	result += exam_archive_statistics(); cout << '.' << flush;
+	result += exam_archive_listing(); cout << '.' << flush;
+
 	return result;
 }
 
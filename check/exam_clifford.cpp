@@ -263,7 +263,7 @@ static unsigned clifford_check4()
 
 	symbol dim("D");
 	varidx mu(symbol("mu"), dim), nu(symbol("nu"), dim), rho(symbol("rho"), dim),
-	       sig(symbol("sig"), dim), lam(symbol("lam"), dim);
+	       sig(symbol("sig"), dim), lam(symbol("lam"), dim), kap(symbol("kap"), dim);
 	ex e, t1, t2;
 
 	e = dirac_gamma(mu) * dirac_gamma(nu) * dirac_gamma(rho) * dirac_gamma(mu.toggle_variance());
@@ -286,6 +286,12 @@ static unsigned clifford_check4()
 	t2 = dirac_trace(e.simplify_indexed());
 	result += check_equal((t1 - t2).expand(), 0);
 
+	e = dirac_gamma(kap) * dirac_gamma(mu) * dirac_gamma(nu) * dirac_gamma(rho) * dirac_gamma(sig)
+	  * dirac_gamma(mu.toggle_variance()) * dirac_gamma(lam) * dirac_gamma(nu.toggle_variance());
+	t1 = dirac_trace(e).simplify_indexed();
+	t2 = dirac_trace(e.simplify_indexed());
+	result += check_equal((t1 - t2).expand(), 0);
+
 	return result;
 }
 
@@ -552,6 +558,84 @@ static unsigned clifford_check8()
 	return result;
 }
 
+static unsigned clifford_check9()
+{
+	// traces of large sums, taken by several threads if possible
+
+	unsigned result = 0;
+
+	symbol dim("D");
+	varidx mu(symbol("mu"), dim), nu(symbol("nu"), dim), rho(symbol("rho"), dim),
+	       sig(symbol("sig"), dim);
+	const int n = 40;
+	ex e, t1, t2;
+	for (int k = 1; k <= n; ++k)
+		e += symbol() * dirac_gamma(mu) * dirac_gamma(nu) * dirac_gamma(rho) * dirac_gamma(sig)
+		   + k * dirac_gamma(mu) * dirac_gamma(mu.toggle_variance());
+
+	t1 = dirac_trace(e);
+	const unsigned previous = set_trace_threads(4);
+	t2 = dirac_trace(e);
+	set_trace_threads(previous);
+	result += check_equal((t1 - t2).expand(), 0);
+
+	return result;
+}
+
+static unsigned clifford_check10()
+{
+	// expansion of products of sums of Dirac matrices
+
+	unsigned result = 0;
+
+	symbol dim("D"), a("a"), b("b"), m("m");
+	varidx mu(symbol("mu"), dim), nu(symbol("nu"), dim);
+	ex e;
+
+	e = (a * dirac_gamma(mu) + m * dirac_ONE()) * (dirac_gamma(nu) - b * dirac_gamma(mu));
+	result += check_equal(e.expand(),
+		a * dirac_gamma(mu) * dirac_gamma(nu) - a * b * dirac_gamma(mu) * dirac_gamma(mu)
+		+ m * dirac_gamma(nu) - m * b * dirac_gamma(mu));
+
+	// the dummy indices of the factors must be renamed apart
+	e = (dirac_gamma(mu) * dirac_gamma(mu.toggle_variance()) + a * dirac_ONE())
+	  * (dirac_gamma(mu) * dirac_gamma(mu.toggle_variance()) + b * dirac_ONE());
+	result += check_equal_simplify(e.expand(), (dim + a) * (dim + b) * dirac_ONE());
+
+	return result;
+}
+
+static unsigned clifford_check11()
+{
+	// Moebius maps for a diagonal metric, computed with blades
+
+	unsigned result = 0;
+
+	realsymbol t("t"), x("x"), y("y");
+	idx mu(symbol("mu"), 3);
+	ex G = diag_matrix(lst(1, 1, -1));
+	ex e = clifford_unit(mu, G), e0 = e.subs(mu == 0), e1 = e.subs(mu == 1);
+	ex Q = t*t + x*x - y*y;
+
+	// inversion
+	result += check_equal_lst(clifford_moebius_map(0, dirac_ONE(), dirac_ONE(), 0, lst(t, x, y), e),
+	                          lst(t/Q, x/Q, y/Q));
+
+	// shift by a vector given as a sum over a dummy index
+	result += check_equal_lst(clifford_moebius_map(dirac_ONE(), lst_to_clifford(lst(1, 2, 3), e), 0, dirac_ONE(), lst(t, x, y), e),
+	                          lst(t + 1, x + 2, y + 3));
+
+	// rotation by pi in the plane of e0 and e1
+	result += check_equal_lst(clifford_moebius_map(e0*e1, 0, 0, e0*e1, lst(t, x, y), e),
+	                          lst(-t, -x, y));
+
+	// a vector with a scalar part
+	ex v = clifford_moebius_map(dirac_ONE(), 2*dirac_ONE(), 0, dirac_ONE(), lst(t, x, y, 0), e);
+	result += check_equal_lst(v, lst(t + 2, x, y, 0));
+
+	return result;
+}
+
 unsigned exam_clifford()
 {
 	unsigned result = 0;
@@ -618,6 +702,9 @@ unsigned exam_clifford()
 	result += clifford_check7(-2*delta_tensor(xi, chi), dim); cout << '.' << flush;
 
 	result += clifford_check8(); cout << '.' << flush;
+	result += clifford_check9(); cout << '.' << flush;
+	result += clifford_check10(); cout << '.' << flush;
+	result += clifford_check11(); cout << '.' << flush;
 
 	return result;
 }
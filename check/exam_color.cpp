@@ -129,6 +129,14 @@ static unsigned color_check3()
 	e = color_T(a) * color_T(b) * color_T(c);
 	result += check_equal(color_trace(e), color_h(a, b, c) / 4);
 
+	// contracted generators
+	e = color_T(a) * color_T(b) * color_T(a) * color_T(b);
+	result += check_equal_simplify(color_trace(e), numeric(-2, 3));
+	e = color_T(a) * color_T(a) * color_T(b) * color_T(b);
+	result += check_equal_simplify(color_trace(e), numeric(16, 3));
+	e = color_T(a) * color_T(b) * color_T(c) * color_T(a) * color_T(b) * color_T(c);
+	result += check_equal_simplify(color_trace(e), numeric(10, 9));
+
 	e = color_ONE(0) * color_ONE(1) / 9;
 	result += check_equal(color_trace(e, 0), color_ONE(1) / 3);
 	result += check_equal(color_trace(e, 1), color_ONE(0) / 3);
@@ -141,6 +149,16 @@ static unsigned color_check3()
 	result += check_equal_simplify(color_trace(e, 2), e);
 	result += check_equal_simplify(color_trace(e, lst(0, 1)), 2);
 
+	// traces of large sums, taken by several threads if possible
+	e = 0;
+	for (int k = 1; k <= 40; ++k)
+		e += symbol() * color_T(a) * color_T(b) * color_T(c) + k * color_T(a) * color_T(b);
+	ex t1 = color_trace(e);
+	const unsigned previous = set_trace_threads(4);
+	ex t2 = color_trace(e);
+	set_trace_threads(previous);
+	result += check_equal((t1 - t2).expand(), 0);
+
 	return result;
 }
 
@@ -26,6 +26,9 @@
 #include <cln/integer_io.h>
 #include <cln/random.h>
 #include <cln/numtheory.h>
+#include <cln/modinteger.h>
+#include <cln/rational.h>
+#include <cln/rational_io.h>
 using namespace cln;
 #include <iostream>
 #include <limits>
@@ -88,6 +91,56 @@ static void run_test(const cln::cl_I& limit, const std::size_t ntimes)
 		run_test_once(limit);
 }
 
+/// Make a few random fractions with numerators and denominators < limit,
+/// add their images modulo primes to rational_cra until it is stable, and
+/// check that the result is the original fractions.  Continue until the
+/// product of the primes exceeds 2*limit^2, and reconstruct them with
+/// rational_reconstruct and these bounds, too.
+static void run_rational_test_once(const cln::cl_I& limit)
+{
+	const std::size_t n = 4;
+	std::vector<cln::cl_RA> x(n);
+	for (std::size_t i = 0; i < n; ++i)
+		x[i] = (random_I(2*limit + 1) - limit)/(random_I(limit) + 1);
+
+	cln::rational_cra cra(n);
+	std::vector<cln::cl_I> residues(n);
+	cln::cl_I p = cln::cl_I(1) << 31;
+	bool stable = false;
+	while (!stable || cra.modulus() <= 2*limit*limit) {
+		p = nextprobprime(p + 1);
+		cln::cl_modint_ring R = find_modint_ring(p);
+		bool divides = false;
+		for (std::size_t i = 0; i < n; ++i) {
+			const cln::cl_MI d = R->canonhom(denominator(x[i]));
+			if (zerop(d))
+				divides = true;
+			else
+				residues[i] = R->retract(R->canonhom(numerator(x[i]))/d);
+		}
+		if (divides)
+			continue;
+		if (cra.add_image(residues, p) && !stable) {
+			stable = true;
+			for (std::size_t i = 0; i < n; ++i)
+				if (cra.result()[i] != x[i]) {
+					std::cerr << "Expected x = " << x[i] << ", got " <<
+						cra.result()[i] << " instead" << std::endl;
+					throw std::logic_error("bug in rational_cra?");
+				}
+		}
+	}
+
+	for (std::size_t i = 0; i < n; ++i) {
+		cln::cl_RA y;
+		if (!rational_reconstruct(y, cra.images()[i], cra.modulus(), limit, limit) || y != x[i]) {
+			std::cerr << "Expected x = " << x[i] << ", got " <<
+				y << " instead" << std::endl;
+			throw std::logic_error("bug in rational_reconstruct?");
+		}
+	}
+}
+
 int main(int argc, char** argv)
 {
 	typedef std::map<cln::cl_I, std::size_t> map_t;
@@ -107,6 +160,12 @@ int main(int argc, char** argv)
 	for (map_t::const_iterator i = the_map.begin(); i != the_map.end(); ++i)
 		run_test(i->first, i->second);
 
+	std::cout << "and rational reconstruction " << std::flush;
+
+	for (map_t::const_iterator i = the_map.begin(); i != the_map.end(); ++i)
+		for (std::size_t k = 0; k < i->second/16; ++k)
+			run_rational_test_once(i->first);
+
 	return 0;
 }
 
@@ -259,6 +259,65 @@ static unsigned exam_differentiation7()
 	return 0;
 }
 
+// Shared subexpressions must be differentiated only once, otherwise this
+// takes 2^40 steps
+static unsigned exam_differentiation8()
+{
+	unsigned result = 0;
+	symbol x("x"), y("y"), z("z");
+	ex e = x;
+	numeric e_val = 2, dx_val = 1, dy_val = 0;
+	for (int i = 0; i < 40; ++i) {
+		e = e + x*y*e;
+		// e + x*y*e at x==2, y==3, and its derivatives
+		dx_val = 7*dx_val + 3*e_val;
+		dy_val = 7*dy_val + 2*e_val;
+		e_val = 7*e_val;
+	}
+
+	exmap at;
+	at[x] = 2;
+	at[y] = 3;
+	const ex dx = e.diff(x);
+	if (!dx.subs(at).is_equal(dx_val)) {
+		clog << "derivative of a shared expression by " << x
+		     << " has the value " << dx.subs(at) << " instead of " << dx_val << endl;
+		++result;
+	}
+
+	const exvector g = e.gradient(lst(x, y, z));
+	if (g.size() != 3 || !g[0].subs(at).is_equal(dx_val)
+	    || !g[1].subs(at).is_equal(dy_val) || !g[2].is_zero()) {
+		clog << "gradient of a shared expression has wrong values" << endl;
+		++result;
+	}
+
+	return result;
+}
+
+// The gradient must agree with diff() for all kinds of objects
+static unsigned exam_differentiation9()
+{
+	unsigned result = 0;
+	symbol x("x"), y("y");
+	const ex e = pow(x, y)*sin(x*y) + exp(x)/(1 + y*y) + pow(x + y, 3)*log(y);
+	const lst l(x, y);
+	const exvector g = gradient(e, l);
+	exmap at;
+	at[x] = numeric(7, 10);
+	at[y] = numeric(13, 10);
+	for (size_t i = 0; i < l.nops(); ++i) {
+		const ex d = e.diff(ex_to<symbol>(l.op(i)));
+		const ex diff_val = (g[i] - d).subs(at).evalf();
+		if (!is_a<numeric>(diff_val) || abs(ex_to<numeric>(diff_val)) > numeric(1, 1000000000)) {
+			clog << "gradient of " << e << " has " << g[i] << " by " << l.op(i)
+			     << " instead of " << d << endl;
+			++result;
+		}
+	}
+	return result;
+}
+
 unsigned exam_differentiation()
 {
 	unsigned result = 0;
@@ -272,6 +331,8 @@ unsigned exam_differentiation()
 	result += exam_differentiation5();  cout << '.' << flush;
 	result += exam_differentiation6();  cout << '.' << flush;
 	result += exam_differentiation7();  cout << '.' << flush;
+	result += exam_differentiation8();  cout << '.' << flush;
+	result += exam_differentiation9();  cout << '.' << flush;
 	
 	return result;
 }
@@ -23,6 +23,7 @@
 #include "ginac.h"
 using namespace GiNaC;
 
+#include <cstdlib> // for srand()
 #include <iostream>
 using namespace std;
 
@@ -184,6 +185,257 @@ static unsigned exam_factor3()
 	return result;
 }
 
+// Degrees high enough for Karatsuba multiplication
+static unsigned exam_factor4()
+{
+	unsigned result = 0;
+	symbol x("x");
+	ex e1 = pow(x, 40) + 2*pow(x, 9) - x + 3;
+	ex e2 = pow(x, 36) - 5*pow(x, 4) + x + 1;
+	ex ee = expand(e1*e2);
+	ex answer = factor(ee);
+	if ( answer.expand() != ee || !is_a<mul>(answer) ) {
+		clog << "factorization of " << ee << " gave wrong result: " << answer << endl;
+		++result;
+	}
+	return result;
+}
+
+// Many modular factors of the same degree (equal degree factorization)
+static unsigned exam_factor5()
+{
+	unsigned result = 0;
+	symbol x("x");
+	ex e = 1;
+	for (int i = 1; i <= 10; ++i)
+		e *= (x - i)*(pow(x, 2) + i);
+	ex ee = expand(e);
+	ex answer = factor(ee);
+	if ( answer.expand() != ee || answer.nops() != 20 ) {
+		clog << "factorization of " << ee << " gave wrong result: " << answer << endl;
+		++result;
+	}
+	return result;
+}
+
+// Swinnerton-Dyer polynomial: irreducible, but it has 16 factors modulo any
+// prime, too many to try all factor combinations
+static unsigned exam_factor6()
+{
+	unsigned result = 0;
+	symbol x("x");
+	ex e = pow(x, 2) - 2;
+	const int primes[] = { 3, 5, 7, 11 };
+	for (int i = 0; i < 4; ++i)
+		e = expand(e.subs(x == x - sqrt(ex(primes[i])))*e.subs(x == x + sqrt(ex(primes[i]))));
+	ex answer = factor(e);
+	if ( !answer.is_equal(e) ) {
+		clog << "factorization of " << e << " gave wrong result: " << answer << endl;
+		++result;
+	}
+	ex ee = expand(e*e.subs(x == x + 1));
+	answer = factor(ee);
+	unsigned nfactors = 0;
+	for (size_t i = 0; i < answer.nops(); ++i)
+		if (answer.op(i).degree(x) == 32)
+			++nfactors;
+	if ( answer.expand() != ee || nfactors != 2 ) {
+		clog << "factorization of " << ee << " gave wrong result: " << answer << endl;
+		++result;
+	}
+	return result;
+}
+
+/* Trials of primes and evaluation points run concurrently if possible, the
+   result must not depend on the number of threads. */
+static unsigned exam_factor7()
+{
+	unsigned result = 0;
+	ex e[2];
+	e[0] = expand((pow(x, 6) - 3*pow(x, 2) + 7)*(2*pow(x, 5) + x + 1)*(pow(x, 4) + 5*x - 11));
+	e[1] = expand((pow(x, 2)*y + 3*x*z - pow(y, 3) + 1)*(x*y*z - 2*pow(z, 2) + x + 5)*(pow(x, 3) - y*z + 2));
+	for (int i = 0; i < 2; ++i) {
+		const unsigned previous = set_factor_threads(1);
+		srand(1);
+		ex answer1 = factor(e[i]);
+		set_factor_threads(4);
+		srand(1);
+		ex answer4 = factor(e[i]);
+		set_factor_threads(previous);
+		unsigned nfactors = 0;
+		for (size_t j = 0; j < answer4.nops(); ++j)
+			if (!is_a<numeric>(answer4.op(j)))
+				++nfactors;
+		if ( !answer4.is_equal(answer1) || nfactors != 3 || answer4.expand() != e[i] ) {
+			clog << "factorization of " << e[i] << " with 4 threads gave " << answer4
+			     << " instead of " << answer1 << endl;
+			++result;
+		}
+	}
+	return result;
+}
+
+/* Known irreducible factors are divided out before factorizing. */
+static unsigned exam_factor8()
+{
+	unsigned result = 0;
+	const std::size_t previous = set_factor_cache_size(100);
+	reset_factor_cache_statistics();
+
+	const ex f1 = pow(x, 2)*y + 3*x - pow(y, 2) + 1;
+	const ex f2 = x*y*z - 2*z + 7;
+	const ex f3 = pow(y, 3) - x*z + 2;
+	ex e[4];
+	e[0] = expand(f1*f2);
+	e[1] = expand(f2*f3*(x-y));
+	e[2] = expand(-3*f1);
+	e[3] = expand(f1*f3);
+	for (int i = 0; i < 4; ++i) {
+		ex answer = factor(e[i]);
+		if ( answer.expand() != e[i] || (i != 2 && !is_a<mul>(answer)) ) {
+			clog << "factorization of " << e[i] << " gave wrong result: " << answer << endl;
+			++result;
+		}
+	}
+
+	// the last three polynomials have known factors
+	const factor_cache_statistics stats = get_factor_cache_statistics();
+	if ( stats.hits < 3 || stats.size < 4 ) {
+		clog << "factor cache had " << stats.hits << " hits in " << stats.lookups
+		     << " lookups and " << stats.size << " factors (should be at least 3 hits and 4 factors)" << endl;
+		++result;
+	}
+
+	// f1 is now known to be irreducible and is not factored again
+	reset_factor_cache_statistics();
+	const ex again = factor(expand(f1));
+	const factor_cache_statistics known = get_factor_cache_statistics();
+	if ( again != expand(f1) || known.hits != 1 || known.factorizations != 0 ) {
+		clog << "factorization of the known irreducible " << f1 << " gave " << again
+		     << " with " << known.hits << " hits and " << known.factorizations
+		     << " factorizations (should be 1 hit and no factorizations)" << endl;
+		++result;
+	}
+	set_factor_cache_size(previous);
+	return result;
+}
+
+static unsigned exam_factor9()
+{
+	// sparse factors in many variables are lifted using their skeletons
+	unsigned result = 0;
+	symbol x("x"), y("y"), z("z"), u("u"), v("v"), w("w");
+	ex f[3];
+	f[0] = pow(x, 3)*y*z + pow(w, 2)*v - 2*u*x + 1;
+	f[1] = pow(x, 2)*u*v - pow(y, 3)*w + 3*z + x;
+	f[2] = x*pow(z, 2)*w - pow(u, 2)*y + 5*v - 7;
+	const ex e[2] = { expand(f[0]*f[1]), expand(f[0]*f[1]*f[2]) };
+	for (int i = 0; i < 2; ++i) {
+		ex answer = factor(e[i]);
+		size_t nfactors = 0;
+		if ( is_a<mul>(answer) ) {
+			for (size_t j = 0; j < answer.nops(); ++j)
+				if ( !is_a<numeric>(answer.op(j)) )
+					++nfactors;
+		}
+		if ( nfactors != size_t(i + 2) || answer.expand() != e[i] ) {
+			clog << "factorization of " << e[i] << " gave wrong result: " << answer << endl;
+			++result;
+		}
+	}
+	return result;
+}
+
+static unsigned exam_factor10()
+{
+	// factor_list() returns the factors without multiplying them
+	unsigned result = 0;
+	symbol x("x"), y("y");
+	const ex e = expand(-6*pow(x, 3)*pow(x+1, 2)*(x*x+y)*pow(y-1, 2)*(x-y));
+	vector<pair<ex, unsigned> > factors;
+	const ex content = factor_list(e, factors);
+	ex prod = content;
+	unsigned degree = 0;
+	for (size_t i = 0; i < factors.size(); ++i) {
+		if ( is_a<numeric>(factors[i].first) || is_a<mul>(factors[i].first) ) {
+			clog << "factor_list(" << e << ") gave bad factor " << factors[i].first << endl;
+			++result;
+		}
+		prod *= pow(factors[i].first, factors[i].second);
+		degree += factors[i].second;
+	}
+	if ( !is_a<numeric>(content) || factors.size() != 5 || degree != 9 ||
+	     !(prod.expand() - e).is_zero() ) {
+		clog << "factor_list(" << e << ") gave wrong result: " << content;
+		for (size_t i = 0; i < factors.size(); ++i)
+			clog << ", " << factors[i].first << "^" << factors[i].second;
+		clog << endl;
+		++result;
+	}
+	return result;
+}
+
+static unsigned exam_factor11()
+{
+	// with a low threshold, the modular divisions are done by Newton
+	// iteration, which must give the same factors as classical division
+	unsigned result = 0;
+	symbol x("x"), y("y");
+	const ex e[3] = {
+		expand((pow(x, 9) - 3*pow(x, 4) + 7*x - 1)*(pow(x, 7) + 5*pow(x, 3) - 2)*pow(x*x + x + 1, 2)),
+		expand((pow(x, 12) + pow(x, 11)*2 - 13)*(pow(x, 10) - 4*x + 9)),
+		expand((pow(x, 4)*y - 3*x + pow(y, 3) + 2)*(pow(x, 5) - x*pow(y, 2) + 1))
+	};
+	ex classical[3];
+	for (int i = 0; i < 3; ++i)
+		classical[i] = factor(e[i]);
+	const unsigned previous = set_factor_division_threshold(1);
+	for (int i = 0; i < 3; ++i) {
+		const ex newton = factor(e[i]);
+		if ( newton != classical[i] || newton.expand() != e[i] ) {
+			clog << "factorization of " << e[i] << " with Newton division gave " << newton
+			     << " instead of " << classical[i] << endl;
+			++result;
+		}
+	}
+	set_factor_division_threshold(previous);
+	return result;
+}
+
+static unsigned exam_factor12()
+{
+	// factors with large and non-monic coefficients need many quadratic
+	// Hensel steps; more than ten modular factors are lifted by a factor
+	// tree with halves of different size
+	unsigned result = 0;
+	symbol x("x"), y("y");
+	ex many = 1;
+	for (int k = 1; k <= 11; ++k)
+		many *= k*x - (1000003 + k);
+	const ex e[3] = {
+		expand((123456789*pow(x, 5) - pow(ex(7), 15)*pow(x, 2) + 7*numeric(1000000007))*
+		       (3*pow(x, 4) + pow(ex(5), 20)*x - 5)*(7*pow(x, 3) - 65537*x + 99991)),
+		expand(many),
+		expand((pow(ex(2), 31)*pow(x, 2)*y - 3*pow(y, 2) + numeric("12345678901")*x + 1)*
+		       (pow(x, 3)*pow(y, 2) - 65537*y + 7*x - 99991))
+	};
+	const size_t expected[3] = { 3, 11, 2 };
+	for (int i = 0; i < 3; ++i) {
+		const ex answer = factor(e[i]);
+		size_t nfactors = 0;
+		if ( is_a<mul>(answer) ) {
+			for (size_t j = 0; j < answer.nops(); ++j)
+				if ( !is_a<numeric>(answer.op(j)) )
+					++nfactors;
+		}
+		if ( nfactors != expected[i] || answer.expand() != e[i] ) {
+			clog << "factorization of " << e[i] << " gave wrong result: " << answer << endl;
+			++result;
+		}
+	}
+	return result;
+}
+
 static unsigned check_factorization(const exvector& factors)
 {
 	ex e = (new mul(factors))->setflag(status_flags::dynallocated);
@@ -220,6 +472,15 @@ unsigned exam_factor()
 	result += exam_factor1(); cout << '.' << flush;
 	result += exam_factor2(); cout << '.' << flush;
 	result += exam_factor3(); cout << '.' << flush;
+	result += exam_factor4(); cout << '.' << flush;
+	result += exam_factor5(); cout << '.' << flush;
+	result += exam_factor6(); cout << '.' << flush;
+	result += exam_factor7(); cout << '.' << flush;
+	result += exam_factor8(); cout << '.' << flush;
+	result += exam_factor9(); cout << '.' << flush;
+	result += exam_factor10(); cout << '.' << flush;
+	result += exam_factor11(); cout << '.' << flush;
+	result += exam_factor12(); cout << '.' << flush;
 	result += factor_integer_content_bug();
 	cout << '.' << flush;
 
@@ -284,6 +284,82 @@ unsigned exam_hashmap()
 	}
 	cout << '.' << flush;
 
+	// Test many erasures and reinsertions, which must leave no trace
+	exhashmap<unsigned> M7;
+	const unsigned K = 5000;
+	for (unsigned round = 0; round < 4; ++round) {
+		for (unsigned i = round % 2; i < K; i += 2)
+			M7[pow(x, i)] = i;
+		for (unsigned i = 1 - round % 2; i < K; i += 2)
+			M7.erase(pow(x, i));
+	}
+	if (M7.size() != K/2) {
+		clog << "After erasures and reinsertions, size() returns " << M7.size() << " instead of " << K/2 << endl;
+		++result;
+	}
+	n = 0;
+	for (exhashmap<unsigned>::const_iterator i = M7.begin(); i != M7.end(); ++i, ++n) {
+		if (i->second % 2 != 1 || !i->first.is_equal(pow(x, i->second))) {
+			clog << "After erasures and reinsertions, iteration found " << i->first << " -> " << i->second << endl;
+			++result;
+			break;
+		}
+	}
+	if (n != K/2) {
+		clog << "After erasures and reinsertions, iteration found " << n << " values instead of " << K/2 << endl;
+		++result;
+	}
+	for (unsigned i = 0; i < K; ++i) {
+		if (M7.count(pow(x, i)) != i % 2) {
+			clog << "After erasures and reinsertions, count(x^" << i << ") returns " << M7.count(pow(x, i)) << endl;
+			++result;
+			break;
+		}
+	}
+	cout << '.' << flush;
+
+	// Test the concurrent map
+	concurrent_exhashmap<ex> C1;
+	for (unsigned i = 0; i < N; ++i)
+		C1.insert(make_pair(pow(y, i), ex(i)));
+	if (C1.insert(make_pair(pow(y, 3), ex(42))) || C1.size() != N) {
+		clog << "Reinsertion into concurrent map changed it" << endl;
+		++result;
+	}
+	C1.assign(make_pair(pow(y, 3), ex(42)));
+	ex value;
+	if (!C1.find(pow(y, 3), value) || !value.is_equal(42)) {
+		clog << "Concurrent map found " << value << " instead of 42 for y^3" << endl;
+		++result;
+	}
+	if (C1.erase(pow(y, 5)) != 1 || C1.erase(pow(y, 5)) != 0 || C1.count(pow(y, 5)) || C1.size() != N-1) {
+		clog << "Erasure from concurrent map failed" << endl;
+		++result;
+	}
+	C1.clear();
+	if (!C1.empty()) {
+		clog << "Cleared concurrent map is not empty" << endl;
+		++result;
+	}
+
+	// Bounded size: entries used all the time are kept
+	const unsigned bound = 64;
+	concurrent_exhashmap<ex> C2(bound, 4);
+	for (unsigned i = 0; i < 20*bound; ++i) {
+		C2.insert(make_pair(pow(y, i), ex(i)));
+		C2.find(y, value);
+		if (C2.size() > bound) {
+			clog << "Concurrent map grew to " << C2.size() << " entries beyond its bound " << bound << endl;
+			++result;
+			break;
+		}
+	}
+	if (!C2.find(y, value) || !value.is_equal(1)) {
+		clog << "Concurrent map evicted the entry used all the time" << endl;
+		++result;
+	}
+	cout << '.' << flush;
+
 	return result;
 }
 
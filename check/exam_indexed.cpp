@@ -206,6 +206,44 @@ static unsigned symmetry_check()
 	return result;
 }
 
+static unsigned many_indices_check()
+{
+	// (anti)symmetric and cyclic objects with up to ten indices
+
+	unsigned result = 0;
+
+	symbol A("A");
+	exvector ix;
+	for (int n = 0; n < 10; ++n)
+		ix.push_back(idx(symbol(), 10));
+
+	for (size_t n = 2; n <= ix.size(); ++n) {
+		exvector v(ix.begin(), ix.begin() + n), w(v.rbegin(), v.rend());
+		int sign = (n * (n - 1) / 2) % 2 ? -1 : 1;
+		result += check_equal(indexed(A, sy_symm(), w) - indexed(A, sy_symm(), v), 0);
+		result += check_equal(indexed(A, sy_anti(), w) - sign * indexed(A, sy_anti(), v), 0);
+
+		// rotate the smallest index to the back
+		w.assign(v.begin() + 1, v.end());
+		w.push_back(v[0]);
+		result += check_equal(indexed(A, sy_cycl(), w) - indexed(A, sy_cycl(), v), 0);
+		sign = (n - 1) % 2 ? -1 : 1;
+		result += check_equal(indexed(A, sy_anti(), w) - sign * indexed(A, sy_anti(), v), 0);
+
+		// repeated index
+		w[n - 1] = w[0];
+		result += check_equal(indexed(A, sy_anti(), w), 0);
+	}
+
+	// pairs of indices
+	exvector v(ix.begin(), ix.begin() + 4), w;
+	w.push_back(ix[2]); w.push_back(ix[3]); w.push_back(ix[1]); w.push_back(ix[0]);
+	symmetry R = sy_anti(sy_symm(0, 1), sy_symm(2, 3));
+	result += check_equal(indexed(A, R, w) + indexed(A, R, v), 0);
+
+	return result;
+}
+
 static unsigned scalar_product_check()
 {
 	// check scalar product replacement
@@ -226,6 +264,32 @@ static unsigned scalar_product_check()
 	e = indexed(A, i, i) * indexed(B, j, j); // GiNaC 0.8.0 had a bug here
 	result += check_equal_simplify(e, e, sp);
 
+	// redefinition, and products for one dimension only
+	idx k(symbol("k"), 4);
+	sp.add(A, A, 5);
+	sp.add(B, C, 3, 7);
+	result += check_equal_simplify(indexed(A, i) * indexed(A, i), 5, sp);
+	result += check_equal_simplify(indexed(C, i) * indexed(B, i), 7, sp);
+	e = indexed(B, k) * indexed(C, k);
+	result += check_equal_simplify(e, e, sp);
+
+	// many momenta
+	const int n = 40;
+	exvector p;
+	for (int a = 0; a < n; ++a)
+		p.push_back(symbol());
+	scalar_products sp2;
+	for (int a = 0; a < n; ++a)
+		for (int b = a; b < n; ++b)
+			sp2.add(p[b], p[a], a * b + 1);
+	e = 0;
+	ex value = 0;
+	for (int a = 0; a < n; ++a) {
+		e += indexed(p[a], i) * indexed(p[n - 1 - a], i);
+		value += a * (n - 1 - a) + 1;
+	}
+	result += check_equal_simplify(e, value, sp2);
+
 	return result;
 }
 
@@ -388,6 +452,143 @@ static unsigned dummy_check()
 		++result;
 	}
 
+	// expanding products of sums renames the dummy indices apart
+	symbol a("a"), b("b"), s("s");
+	scalar_products sp;
+	sp.add(p, q, s);
+	e = ((indexed(p, i) * indexed(q, i) + a) * (indexed(p, i) * indexed(q, i) + b)).expand();
+	result += check_equal_simplify(e, ((s + a) * (s + b)).expand(), sp);
+	e = ((a + b) * (indexed(p, i) * indexed(q, i) + a) * indexed(p, i) * indexed(q, i)).expand();
+	result += check_equal_simplify(e, ((a + b) * (s + a) * s).expand(), sp);
+
+	// indices in a noncommutative product
+	e = ((dirac_gamma(mu) * dirac_gamma(mu.toggle_variance()) + a * dirac_ONE())
+	  * (indexed(p, mu) * indexed(q, mu.toggle_variance()) + b)).expand();
+	result += check_equal_simplify(e, ((4 + a) * (s + b) * dirac_ONE()).expand(), sp);
+
+	return result;
+}
+
+static unsigned canonical_dummy_check()
+{
+	// terms equal up to renaming of dummy indices and slot symmetries
+
+	unsigned result = 0;
+
+	symbol A("A"), B("B"), C("C"), p("p"), q("q");
+	idx i(symbol("i"), 3), j(symbol("j"), 3), k(symbol("k"), 3), l(symbol("l"), 3),
+	    m(symbol("m"), 3), n(symbol("n"), 3);
+	ex e;
+
+	e = indexed(A, sy_symm(), i, j) * indexed(p, i) * indexed(q, j)
+	  - indexed(A, sy_symm(), k, l) * indexed(p, l) * indexed(q, k);
+	result += check_equal_simplify(e, 0);
+
+	e = indexed(B, sy_anti(), i, j) * indexed(C, i, j)
+	  + indexed(B, sy_anti(), k, l) * indexed(C, l, k);
+	result += check_equal_simplify(e, 0);
+
+	e = indexed(A, sy_symm(), i, j) * indexed(B, sy_anti(), j, k) * indexed(C, k, l, m, n) * indexed(p, l) * indexed(q, m) * indexed(q, n) * indexed(p, i)
+	  + indexed(A, sy_symm(), n, m) * indexed(B, sy_anti(), l, m) * indexed(C, l, k, j, i) * indexed(p, k) * indexed(q, j) * indexed(q, i) * indexed(p, n);
+	result += check_equal_simplify(e, 0);
+
+	return result;
+}
+
+static unsigned contraction_chain_check()
+{
+	// contractions in products with many indexed factors
+
+	unsigned result = 0;
+
+	symbol A("A"), B("B"), d("d");
+	const int n = 30;
+	exvector ix;
+	for (int k = 0; k < n; ++k)
+		ix.push_back(idx(symbol(), d));
+
+	// closed chain of deltas, in a scrambled order
+	ex e = 1;
+	for (int k = 0; k < n; ++k) {
+		const int l = (7 * k) % n;
+		e *= delta_tensor(ix[l], ix[(l + 1) % n]);
+	}
+	result += check_equal_simplify(e, d);
+
+	// open chain of deltas between two other objects
+	e = indexed(A, ix[0]) * indexed(B, ix[n-1]);
+	for (int k = n - 2; k >= 0; --k)
+		e *= delta_tensor(ix[k], ix[k + 1]);
+	result += check_equal_simplify(e - indexed(A, ix[n-1]) * indexed(B, ix[n-1]), 0);
+
+	return result;
+}
+
+/* Compare the components from indexed_components() with those from
+ * substituting the values of the free indices and summing explicitly. */
+static unsigned check_components(const ex & e, const exvector & free)
+{
+	unsigned result = 0;
+	exvector c = indexed_components(e, free);
+	std::vector<unsigned> counter(free.size(), 0);
+	for (size_t n=0; n<c.size(); ++n) {
+		lst values;
+		for (size_t k=0; k<free.size(); ++k)
+			values.append(free[k].op(0) == counter[k]);
+		ex r = expand_dummy_sum(e.subs(values));
+		if (!(c[n] - r).expand().is_zero()) {
+			clog << "component " << values << " of " << e << " erroneously returned "
+			     << c[n] << " instead of " << r << endl;
+			++result;
+		}
+		for (size_t k=free.size(); k-- > 0; ) {
+			if (++counter[k] < unsigned(ex_to<numeric>(ex_to<idx>(free[k]).get_dim()).to_int()))
+				break;
+			counter[k] = 0;
+		}
+	}
+	return result;
+}
+
+static unsigned components_check()
+{
+	unsigned result = 0;
+	symbol a("a"), b("b"), A("A");
+	symbol mu_sym("mu"), nu_sym("nu"), rho_sym("rho"), sigma_sym("sigma");
+	varidx mu(mu_sym, 4), nu(nu_sym, 4), rho(rho_sym, 4), sigma(sigma_sym, 4);
+	symbol i_sym("i"), j_sym("j"), k_sym("k");
+	idx i(i_sym, 3), j(j_sym, 3), k(k_sym, 3);
+
+	matrix F(4, 4), p(4, 1), q(4, 1);
+	for (unsigned r=0; r<4; ++r) {
+		for (unsigned s=0; s<4; ++s)
+			F(r, s) = r == s ? ex(a) : ex(numeric(int(r) - int(s)) * b);
+		p(r, 0) = pow(a, r) + 1;
+		q(r, 0) = numeric(r) * b - a;
+	}
+
+	exvector free;
+	free.push_back(mu.toggle_variance());
+	ex e = lorentz_g(mu.toggle_variance(), nu.toggle_variance()) * indexed(F, nu, rho) * indexed(p, rho.toggle_variance())
+	     + a * b * indexed(q, mu.toggle_variance());
+	result += check_components(e, free);
+
+	free.clear();
+	free.push_back(nu);
+	free.push_back(mu);
+	e = lorentz_eps(mu, nu, rho, sigma) * indexed(p, rho.toggle_variance()) * indexed(q, sigma.toggle_variance());
+	result += check_components(e, free);
+
+	free.clear();
+	e = indexed(p, mu) * indexed(p, mu.toggle_variance()) - indexed(F, nu, nu.toggle_variance());
+	result += check_components(e, free);
+
+	free.clear();
+	free.push_back(i);
+	free.push_back(k);
+	e = delta_tensor(i, j) * indexed(A, j, k) - pow(a, 2) * indexed(A, k, i);
+	result += check_components(e, free);
+
 	return result;
 }
 
@@ -401,10 +602,14 @@ unsigned exam_indexed()
 	result += metric_check();  cout << '.' << flush;
 	result += epsilon_check();  cout << '.' << flush;
 	result += symmetry_check();  cout << '.' << flush;
+	result += many_indices_check();  cout << '.' << flush;
 	result += scalar_product_check();  cout << '.' << flush;
 	result += edyn_check();  cout << '.' << flush;
 	result += spinor_check(); cout << '.' << flush;
 	result += dummy_check(); cout << '.' << flush;
+	result += canonical_dummy_check(); cout << '.' << flush;
+	result += contraction_chain_check(); cout << '.' << flush;
+	result += components_check(); cout << '.' << flush;
 	
 	return result;
 }
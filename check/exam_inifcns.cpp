@@ -24,7 +24,11 @@
 #include "ginac.h"
 using namespace GiNaC;
 
+#include <cmath>
+#include <complex>
 #include <iostream>
+#include <stdexcept>
+#include <vector>
 using namespace std;
 
 /* Assorted tests on other transcendental functions. */
@@ -172,6 +176,7 @@ static unsigned inifcns_consist_gamma()
 static unsigned inifcns_consist_psi()
 {
 	using GiNaC::log;
+	using GiNaC::lgamma;
 	using GiNaC::tgamma;
 
 	unsigned result = 0;
@@ -187,6 +192,40 @@ static unsigned inifcns_consist_psi()
 		     << e << " instead of 2*log(2)" << endl;
 		++result;
 	}
+
+	// Numerical evaluation, compared with the closed forms
+	const numeric eps(1, 10000000000L);
+	const ex pairs[][2] = {
+		{ psi(numeric(1.0)), -Euler },
+		{ psi(numeric(-2.5)), psi(numeric(-5,2)) },
+		{ psi(1, numeric(0.5)), pow(Pi,2)/2 },
+		{ psi(2, numeric(-1.5)), psi(2, numeric(-3,2)) },
+		{ psi(3, numeric(3.0)), psi(3, 3) },
+		{ psi(numeric(0.3) + numeric(0.2)*I),
+		  psi(numeric(13,10) + I/5) - 1/(numeric(3,10) + I/5) }
+	};
+	for (size_t i=0; i<sizeof(pairs)/sizeof(pairs[0]); ++i) {
+		const ex value = pairs[i][0].evalf();
+		const ex expected = pairs[i][1].evalf();
+		if (!is_a<numeric>(value)
+		 || abs(ex_to<numeric>(value) - ex_to<numeric>(expected)) > eps) {
+			clog << pairs[i][0] << " erroneously evaluated to " << value
+			     << " instead of " << expected << endl;
+			++result;
+		}
+	}
+
+	// At most the precision of a double, tgamma and lgamma take another path
+	const long saved_digits = Digits;
+	Digits = 15;
+	if (abs(ex_to<numeric>(tgamma(numeric(4.5)).evalf())
+	        - ex_to<numeric>(tgamma(numeric(9,2)).evalf())) > eps
+	 || abs(ex_to<numeric>(lgamma(numeric(0.25)).evalf())
+	        - ex_to<numeric>(log(tgamma(numeric(1,4))).evalf())) > eps) {
+		clog << "tgamma(4.5) or lgamma(0.25) erroneously evaluated with Digits=15" << endl;
+		++result;
+	}
+	Digits = saved_digits;
 	
 	return result;
 }
@@ -343,6 +382,124 @@ static unsigned inifcns_consist_various()
 	return result;
 }
 
+static unsigned inifcns_consist_evalf_adaptive()
+{
+	unsigned result = 0;
+	const long digitsbuf = Digits;
+	Digits = 20;
+
+	exvector es;
+	// cancellation in a sum
+	es.push_back(exp(pow(ex(10), -25)) - 1);
+	es.push_back(sqrt(pow(ex(10), 24)+1) - pow(ex(10), 12));
+	// a large argument needs more digits
+	es.push_back(sin(pow(ex(10), 22)));
+	es.push_back(pow(Pi, 2) / 6);
+
+	for (exvector::const_iterator e = es.begin(); e != es.end(); ++e) {
+		Digits = 100;
+		const numeric exact = ex_to<numeric>(e->evalf());
+		Digits = 20;
+		const ex value = evalf_adaptive(*e, 15);
+		if (!is_exactly_a<numeric>(value) ||
+		    abs(ex_to<numeric>(value) - exact) > abs(exact) * numeric(1, 10).power(14)) {
+			clog << "evalf_adaptive(" << *e << ", 15) erroneously returned "
+			     << value << " (instead of " << exact << ")" << endl;
+			++result;
+		}
+	}
+	if (Digits != 20) {
+		clog << "evalf_adaptive() did not restore Digits" << endl;
+		++result;
+	}
+
+	Digits = digitsbuf;
+	return result;
+}
+
+static unsigned inifcns_consist_evalf_double()
+{
+	unsigned result = 0;
+	symbol x("x"), y("y");
+	evalf_double_map values;
+	values[x] = 0.7;
+	values[y] = std::complex<double>(-1.3, 0.4);
+	exmap m;
+	m[x] = numeric(7, 10);
+	m[y] = numeric(-13, 10) + I*numeric(2, 5);
+
+	exvector es;
+	es.push_back(3*x*x - y/5 + Pi);
+	es.push_back(pow(y, 7) * pow(x, -3) + sqrt(x - 2));
+	es.push_back(pow(x, y) + pow(y, x));
+	es.push_back(exp(y) * log(y) - sin(x*y) / cos(y) + tan(x));
+	es.push_back(asin(y) + acos(x) + atan(y) + atan2(x, -x));
+	es.push_back(sinh(y) + cosh(x) * tanh(y) + asinh(y) + acosh(y) + atanh(x));
+	es.push_back(abs(y) + csgn(y) + step(x) + conjugate(y) + real_part(y) * imag_part(y));
+	es.push_back(tgamma(x) + lgamma(x + 3) + Li(3, x) + Li(2, -5*x));
+	// evaluated by evalf()
+	es.push_back(zeta(x + 3) + Li(2, y) + tgamma(y));
+
+	for (exvector::const_iterator e = es.begin(); e != es.end(); ++e) {
+		const numeric exact = ex_to<numeric>(e->subs(m).evalf());
+		const std::complex<double> value = evalf_double(*e, values);
+		const std::complex<double> expected(exact.real().to_double(), exact.imag().to_double());
+		if (!(std::abs(value - expected) <= 1e-13 * std::abs(expected))) {
+			clog << "evalf_double(" << *e << ") erroneously returned " << value
+			     << " (instead of " << expected << ")" << endl;
+			++result;
+		}
+	}
+
+	try {
+		evalf_double(x + y);
+		clog << "evalf_double() without values of the symbols did not throw" << endl;
+		++result;
+	} catch (const std::invalid_argument &) {
+	}
+
+	return result;
+}
+
+static unsigned inifcns_consist_fsolve_all()
+{
+	unsigned result = 0;
+	symbol x("x"), p("p");
+
+	const lst r = fsolve_all(x*x*x==2*x, x, -10, 10);
+	if (r.nops() != 3 || abs(ex_to<numeric>(r.op(0)) + sqrt(numeric(2))) > numeric(1e-14) ||
+	    !r.op(1).is_zero() || abs(ex_to<numeric>(r.op(2)) - sqrt(numeric(2))) > numeric(1e-14)) {
+		clog << "fsolve_all(x^3==2*x, x, -10, 10) erroneously returned " << r << endl;
+		++result;
+	}
+	// The sign changes at the poles are no roots
+	const lst t = fsolve_all(tan(x), x, -4, 4, 64);
+	if (t.nops() != 3) {
+		clog << "fsolve_all(tan(x), x, -4, 4) erroneously returned " << t << endl;
+		++result;
+	}
+
+	// sin(x)==p has the roots asin(p) and Pi-asin(p) in [-1, 4]
+	const double pi = std::acos(-1.0);
+	prepared_fsolve solver(sin(x)==p, x, lst(p));
+	std::vector<std::vector<double> > values;
+	for (int i = 0; i < 50; ++i)
+		values.push_back(std::vector<double>(1, (i - 25) / 26.0));
+	const unsigned threads = set_fsolve_threads(3);
+	const std::vector<std::vector<double> > roots = solver.roots(-1, 4, values);
+	set_fsolve_threads(threads);
+	for (std::size_t i = 0; i < values.size(); ++i) {
+		const double a = std::asin(values[i][0]);
+		if (roots[i].size() != 2 || std::fabs(roots[i][0] - a) > 1e-14 ||
+		    std::fabs(roots[i][1] - (pi - a)) > 1e-14) {
+			clog << "prepared_fsolve did not find the roots of sin(x)==" << values[i][0] << endl;
+			++result;
+		}
+	}
+
+	return result;
+}
+
 unsigned exam_inifcns()
 {
 	unsigned result = 0;
@@ -357,6 +514,9 @@ unsigned exam_inifcns()
 	result += inifcns_consist_exp();  cout << '.' << flush;
 	result += inifcns_consist_log();  cout << '.' << flush;
 	result += inifcns_consist_various();  cout << '.' << flush;
+	result += inifcns_consist_evalf_adaptive();  cout << '.' << flush;
+	result += inifcns_consist_evalf_double();  cout << '.' << flush;
+	result += inifcns_consist_fsolve_all();  cout << '.' << flush;
 	
 	return result;
 }
@@ -116,6 +116,165 @@ static unsigned inifcns_test_S()
 }
 
 
+// S and Li evaluated alternately at two precisions, reusing the lookup tables
+static unsigned inifcns_test_S_Digits()
+{
+	int digitsbuf = Digits;
+	unsigned result = 0;
+
+	Digits = 40;
+	prepare_polylog_tables(6, 4);
+	const ex x = numeric(3, 10);
+	const ex s40 = S(2, 3, x).evalf();
+	const ex li40 = Li(5, numeric(2, 5)).evalf();
+	Digits = 15;
+	const ex s15 = S(2, 3, x).evalf();
+	const ex li15 = Li(5, numeric(2, 5)).evalf();
+	Digits = 40;
+	const ex s40again = S(2, 3, x).evalf();
+	const ex li40again = Li(5, numeric(2, 5)).evalf();
+
+	if (!s40again.is_equal(s40) || !li40again.is_equal(li40)) {
+		clog << "S(2,3," << x << ") and Li(5,2/5) changed after switching Digits:" << endl;
+		clog << s40 << " vs. " << s40again << endl;
+		clog << li40 << " vs. " << li40again << endl;
+		result++;
+	}
+	if (abs(s40-s15) > pow(10, -13) || abs(li40-li15) > pow(10, -13)) {
+		clog << "S(2,3," << x << ") and Li(5,2/5) differ between Digits=15 and 40:" << endl;
+		clog << s15 << " vs. " << s40 << endl;
+		clog << li15 << " vs. " << li40 << endl;
+		result++;
+	}
+	cout << "." << flush;
+
+	Digits = digitsbuf;
+
+	return result;
+}
+
+
+// G, Li, S and H evaluated at many points at once and one by one
+static unsigned inifcns_test_polylog_evalf()
+{
+	int digitsbuf = Digits;
+	Digits = 20;
+	ex prec = 5 * pow(10, -(ex)Digits);
+	unsigned result = 0;
+
+	exvector fs;
+	fs.push_back(G(lst(numeric(1,2), 0, 1), 0));
+	fs.push_back(G(lst(numeric(-1,3), 2), lst(1, -1), 0));
+	fs.push_back(Li(3, 0));
+	fs.push_back(S(2, 2, 0));
+	fs.push_back(H(lst(1, 2), 0));
+	exvector points;
+	for (int i = 1; i <= 12; ++i)
+		points.push_back(numeric(i, 13));
+
+	const unsigned previous = set_polylog_threads(4);
+	for (exvector::const_iterator f = fs.begin(); f != fs.end(); ++f) {
+		const exvector values = polylog_evalf(*f, points);
+		for (std::size_t i = 0; i < points.size(); ++i) {
+			ex e = *f;
+			e.let_op(e.nops()-1) = points[i];
+			const ex value = e.evalf();
+			if (abs(values[i] - value) > prec) {
+				clog << "polylog_evalf() of " << e << " erroneously returned "
+				     << values[i] << " (instead of " << value << ")" << endl;
+				result++;
+			}
+		}
+		cout << "." << flush;
+	}
+	set_polylog_threads(previous);
+
+	Digits = digitsbuf;
+
+	return result;
+}
+
+static unsigned inifcns_test_Li_double()
+{
+	int digitsbuf = Digits;
+	Digits = 20;
+	const numeric tol = numeric(1, 1000000) * numeric(1, 10000000);
+	unsigned result = 0;
+
+	// dyadic rationals, so that the conversion to double is exact
+	const numeric xs[] = { numeric(-15,2), numeric(-1), numeric(-3,4), numeric(-5,16),
+	                       numeric(0), numeric(3,1024), numeric(1,2), numeric(11,16),
+	                       numeric(255,256), numeric(1) };
+	for (int n = 1; n <= 6; ++n) {
+		for (std::size_t i = 0; i < sizeof(xs)/sizeof(xs[0]); ++i) {
+			if (n == 1 && xs[i] == 1)
+				continue;
+			double value, error;
+			if (!Li_double(n, xs[i].to_double(), value, error)) {
+				clog << "Li_double(" << n << "," << xs[i] << ") erroneously failed" << endl;
+				result++;
+				continue;
+			}
+			const numeric exact = ex_to<numeric>(Li(n, xs[i]).evalf());
+			if (abs(exact - value) > abs(exact) * tol) {
+				clog << "Li_double(" << n << "," << xs[i] << ") erroneously returned "
+				     << value << " (instead of " << exact << ")" << endl;
+				result++;
+			}
+		}
+		cout << "." << flush;
+	}
+
+	// complex values are refused
+	double value, error;
+	if (Li_double(2, 2.0, value, error)) {
+		clog << "Li_double(2,2) erroneously succeeded" << endl;
+		result++;
+	}
+
+	Digits = digitsbuf;
+
+	return result;
+}
+
+static unsigned inifcns_test_reduction_cache()
+{
+	int digitsbuf = Digits;
+	Digits = 20;
+	ex prec = 5 * pow(10, -(ex)Digits);
+	unsigned result = 0;
+
+	reset_polylog_reduction_statistics();
+	const ex g = G(lst(numeric(1,3), 2, numeric(1,2), -1, 3), 1);
+	const ex h = H(lst(2, -1, 3), numeric(1,3));
+	const ex g1 = g.evalf(), h1 = h.evalf();
+	const polylog_reduction_statistics first = get_polylog_reduction_statistics();
+	if (first.lookups == 0 || first.hits == 0 || first.size == 0) {
+		clog << "reductions of " << g << " and " << h << " were not remembered: "
+		     << first.lookups << " lookups, " << first.hits << " hits" << endl;
+		result++;
+	}
+
+	// the second evaluation is done from the tables
+	const ex g2 = g.evalf(), h2 = h.evalf();
+	const polylog_reduction_statistics second = get_polylog_reduction_statistics();
+	if (second.hits <= first.hits) {
+		clog << "repeated evaluation of " << g << " and " << h << " did not hit the tables" << endl;
+		result++;
+	}
+	if (abs(g1 - g2) > prec || abs(h1 - h2) > prec) {
+		clog << "remembered reductions of " << g << " and " << h << " gave " << g2 << ", " << h2
+		     << " (instead of " << g1 << ", " << h1 << ")" << endl;
+		result++;
+	}
+	cout << "." << flush;
+
+	Digits = digitsbuf;
+
+	return result;
+}
+
+
 ////////////////////////////////////////////////////////////////////////////////
 ////////////////////////////////////////////////////////////////////////////////
 //  H/Li exam
@@ -401,6 +560,10 @@ unsigned exam_inifcns_nstdsums(void)
 	
 	result += inifcns_test_zeta();
 	result += inifcns_test_S();
+	result += inifcns_test_S_Digits();
+	result += inifcns_test_polylog_evalf();
+	result += inifcns_test_Li_double();
+	result += inifcns_test_reduction_cache();
 	result += inifcns_test_HLi();
 	result += inifcns_test_LiG();
 	result += inifcns_test_legacy();
@@ -100,6 +100,32 @@ static unsigned matrix_determinants()
 		++result;
 	}
 	
+	// check sparse tridiagonal 8x8 matrix with an own symbol in every
+	// nonzero entry, whose grid of evaluation points is too large for the
+	// modular algorithm, against the three term recurrence
+	const unsigned n = 8;
+	matrix m8(n, n);
+	ex previous = 1, current = 1;
+	for (unsigned k = 0; k < n; ++k) {
+		const symbol diag;
+		m8(k, k) = diag;
+		ex next = diag*current;
+		if (k > 0) {
+			const symbol upper, lower;
+			m8(k-1, k) = upper;
+			m8(k, k-1) = lower;
+			next -= upper*lower*previous;
+		}
+		previous = current;
+		current = next.expand();
+	}
+	det = m8.determinant();
+	if (!(det - current).expand().is_zero()) {
+		clog << "determinant of 8x8 matrix " << m8
+		     << " erroneously returned " << det << endl;
+		++result;
+	}
+
 	// check characteristic polynomial
 	m3.set(0,0,a).set(0,1,-2).set(0,2,2);
 	m3.set(1,0,3).set(1,1,a-1).set(1,2,2);
@@ -285,6 +311,215 @@ static unsigned matrix_rank()
 	return result;	
 }
 
+/* Products of larger matrices, by several threads if possible. */
+static unsigned matrix_mul()
+{
+	unsigned result = 0;
+	symbol a("a"), b("b");
+	const unsigned r = 40, n = 35, c = 30;
+	matrix A(r,n), B(n,c);
+	for (unsigned i=0; i<r; ++i)
+		for (unsigned k=0; k<n; ++k)
+			A(i,k) = (i*k)%3 ? numeric(int(i)-int(k),3)*a + pow(b,k%3) : ex(0);
+	for (unsigned k=0; k<n; ++k)
+		for (unsigned j=0; j<c; ++j)
+			B(k,j) = numeric(int(k+j)%5-2)*b + pow(a,j%2);
+	
+	const unsigned previous = set_matrix_threads(4);
+	matrix P = A.mul(B);
+	set_matrix_threads(1);
+	matrix Q = A.mul(B);
+	set_matrix_threads(previous);
+	
+	for (unsigned i=0; i<r; ++i) {
+		for (unsigned j=0; j<c; ++j) {
+			ex e = 0;
+			for (unsigned k=0; k<n; ++k)
+				e += A(i,k)*B(k,j);
+			if (!(P(i,j) - e).expand().is_zero() || !P(i,j).is_equal(Q(i,j))) {
+				clog << "entry (" << i << "," << j << ") of a product "
+				     << "erroneously returned " << P(i,j) << " and "
+				     << Q(i,j) << " (should be " << e << ")" << endl;
+				++result;
+			}
+		}
+	}
+	
+	return result;
+}
+
+/* Matrices up to 4x4 have closed forms for determinant, inverse and product,
+ * which must agree with the general algorithms. */
+static unsigned matrix_small()
+{
+	unsigned result = 0;
+	symbol a("a"), b("b"), c("c");
+	const ex entries[] = { a, 2*b, 0, numeric(1,3), a*b - c, 1, 3, c,
+	                       -a, 0, b, pow(c,2), 5, a + c, 0, 2 };
+	
+	for (unsigned n=2; n<=4; ++n) {
+		matrix m(n,n);
+		for (unsigned i=0; i<n; ++i)
+			for (unsigned j=0; j<n; ++j)
+				m(i,j) = entries[(3*i + j) % 16];
+		
+		ex det = m.determinant();
+		ex det_bareiss = m.determinant(determinant_algo::bareiss);
+		ex det_laplace = m.determinant(determinant_algo::laplace);
+		if (!(det - det_bareiss).expand().is_zero() ||
+		    !(det - det_laplace).expand().is_zero()) {
+			clog << "determinant of " << m << " erroneously returned "
+			     << det << " (should be " << det_laplace << ")" << endl;
+			++result;
+			continue;
+		}
+		
+		matrix m_i = m.inverse();
+		matrix id = m_i.mul(m);
+		for (unsigned i=0; i<n; ++i) {
+			for (unsigned j=0; j<n; ++j) {
+				if (!normal(id(i,j) - (i==j ? 1 : 0)).is_zero()) {
+					clog << "inversion of " << m << " erroneously returned "
+					     << m_i << endl;
+					++result;
+					i = j = n;
+				}
+			}
+		}
+		
+		matrix p = m.mul(m_i.mul(m));
+		for (unsigned i=0; i<n; ++i) {
+			for (unsigned j=0; j<n; ++j) {
+				ex e = 0;
+				for (unsigned k=0; k<n; ++k)
+					e += m(i,k)*m(k,j);
+				if (!normal(p(i,j) - e).is_zero()) {
+					clog << "entry (" << i << "," << j << ") of the square of "
+					     << m << " erroneously returned " << p(i,j) << endl;
+					++result;
+				}
+			}
+		}
+	}
+	
+	matrix s(3,3);
+	s(0,0) = a; s(0,1) = b; s(0,2) = a + b;
+	s(1,0) = 1; s(1,1) = c; s(1,2) = 1 + c;
+	s(2,0) = 2; s(2,1) = 3; s(2,2) = 5;
+	if (!s.determinant().is_zero()) {
+		clog << "determinant of the singular matrix " << s
+		     << " erroneously returned " << s.determinant() << endl;
+		++result;
+	}
+	try {
+		s.inverse();
+		clog << "inversion of the singular matrix " << s
+		     << " erroneously succeeded" << endl;
+		++result;
+	} catch (const std::runtime_error & e) {
+		// ok
+	}
+	
+	return result;
+}
+
+static unsigned matrix_bareiss_threads()
+{
+	unsigned result = 0;
+	symbol a("a"), b("b");
+	const unsigned n = 10;
+	matrix A(n,n), B(n,1), X(n,1);
+	for (unsigned i=0; i<n; ++i) {
+		for (unsigned k=0; k<n; ++k)
+			A(i,k) = (i+2*k)%4 ? numeric(int(i*k)%7-3)*a + numeric(int(i+k)%5-2)*b
+			                   : ex(int(i)-int(k));
+		B(i,0) = pow(b,i%3);
+		X(i,0) = symbol();
+	}
+	
+	const unsigned previous = set_matrix_threads(4);
+	const ex det4 = A.determinant(determinant_algo::bareiss);
+	const matrix sol4 = A.solve(X, B, solve_algo::bareiss);
+	set_matrix_threads(1);
+	const ex det1 = A.determinant(determinant_algo::bareiss);
+	const matrix sol1 = A.solve(X, B, solve_algo::bareiss);
+	set_matrix_threads(previous);
+	
+	if (!(det4 - det1).normal().is_zero() || det1.is_zero()) {
+		clog << "determinant of " << A << " with four threads erroneously returned "
+		     << det4 << " (should be " << det1 << ")" << endl;
+		++result;
+	}
+	for (unsigned i=0; i<n; ++i) {
+		if (!(sol4(i,0) - sol1(i,0)).normal().is_zero()) {
+			clog << "solving with four threads erroneously returned x" << i
+			     << " == " << sol4(i,0) << " (should be " << sol1(i,0) << ")" << endl;
+			++result;
+			break;
+		}
+	}
+	
+	return result;
+}
+
+static unsigned matrix_in_place()
+{
+	unsigned result = 0;
+	symbol a("a"), b("b");
+	matrix A(4,4), B(4,2), X(4,2);
+	A = a, 1, 0, b,
+	    2, a/b, 1, 0,
+	    0, 1, b, a,
+	    1, 0, a, 1;
+	B = 1, a,
+	    b, 0,
+	    0, 1,
+	    a*b, 2;
+	for (unsigned i=0; i<4; ++i)
+		for (unsigned j=0; j<2; ++j)
+			X(i,j) = symbol();
+	
+	const unsigned algos[] = { determinant_algo::gauss, determinant_algo::bareiss,
+	                           determinant_algo::divfree, determinant_algo::laplace };
+	for (unsigned k=0; k<4; ++k) {
+		matrix tmp = A;
+		const ex det = tmp.determinant_in_place(algos[k]);
+		if (!(det - A.determinant(algos[k])).normal().is_zero()) {
+			clog << "determinant_in_place(" << algos[k] << ") of " << A
+			     << " erroneously returned " << det << endl;
+			++result;
+		}
+	}
+	
+	const unsigned solve_algos[] = { solve_algo::gauss, solve_algo::bareiss,
+	                                 solve_algo::divfree };
+	for (unsigned k=0; k<3; ++k) {
+		matrix tmp = A, tmp_rhs = B;
+		const matrix sol = tmp.solve_in_place(X, tmp_rhs, solve_algos[k]);
+		const ex d = A.mul(sol).sub(B);
+		for (size_t i=0; i<d.nops(); ++i) {
+			if (!d.op(i).normal().is_zero()) {
+				clog << "solve_in_place(" << solve_algos[k] << ") erroneously returned "
+				     << sol << endl;
+				++result;
+				break;
+			}
+		}
+	}
+	
+	matrix tmp = A;
+	const ex d = tmp.inverse_in_place().mul(A).sub(ex_to<matrix>(unit_matrix(4)));
+	for (size_t i=0; i<d.nops(); ++i) {
+		if (!d.op(i).normal().is_zero()) {
+			clog << "inverse_in_place() of " << A << " is wrong" << endl;
+			++result;
+			break;
+		}
+	}
+	
+	return result;
+}
+
 static unsigned matrix_misc()
 {
 	unsigned result = 0;
@@ -349,6 +584,10 @@ unsigned exam_matrices()
 	result += matrix_solve2();  cout << '.' << flush;
 	result += matrix_evalm();  cout << "." << flush;
 	result += matrix_rank();  cout << "." << flush;
+	result += matrix_mul();  cout << '.' << flush;
+	result += matrix_small();  cout << '.' << flush;
+	result += matrix_bareiss_threads();  cout << '.' << flush;
+	result += matrix_in_place();  cout << '.' << flush;
 	result += matrix_misc();  cout << '.' << flush;
 	
 	return result;
@@ -21,9 +21,20 @@
  */
 
 #include "ginac.h"
+#include "polynomial/cra_garner.h"
 using namespace GiNaC;
 
+#include <algorithm>
+#include <cmath>
+#include <complex>
+#include <cstdlib>
 #include <iostream>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+#include <dirent.h>
+#include <unistd.h>
 using namespace std;
 
 #define VECSIZE 30
@@ -89,6 +100,23 @@ static unsigned exam_expand_power()
 	return result;
 }
 
+/* Products of monomials with negative and cancelling exponents between the
+ * terms of two sums. */
+static unsigned exam_expand_monomials()
+{
+	unsigned result = 0;
+	symbol x("x"), y("y"), z("z");
+
+	const ex e = ((x + 1/x + y*z) * (x - 1/x + sin(y))).expand();
+	const ex expected = pow(x, 2) - pow(x, -2) + x*sin(y) + sin(y)/x + x*y*z - y*z/x + y*z*sin(y);
+	if (!e.is_equal(expected)) {
+		clog << "(x+1/x+y*z)*(x-1/x+sin(y)) expanded to " << e << " instead of " << expected << endl;
+		++result;
+	}
+
+	return result;
+}
+
 static unsigned exam_sqrfree()
 {
 	unsigned result = 0;
@@ -128,6 +156,15 @@ static unsigned exam_sqrfree()
 		     << e2 << endl;
 		++result;
 	}
+
+	// square free in x, but not in y
+	e1 = pow(y,2)*(x+y)*(x-1);
+	e2 = sqrfree(expand(e1),lst(x,y));
+	if (!(e1 - e2).expand().is_zero() || !e2.has(pow(y,2))) {
+		clog << "sqrfree(expand(" << e1 << "),[x,y]) erroneously returned "
+		     << e2 << endl;
+		++result;
+	}
 	
 	return result;
 }
@@ -298,6 +335,2224 @@ static unsigned exam_subs_algebraic()
 	return result;
 }
 
+/* Objects allocated from the pool must behave like any others, including
+ * those which outlive the pool_allocation_guard. */
+static unsigned exam_pool_allocation()
+{
+	unsigned result = 0;
+	symbol x("x"), y("y");
+
+	const ex ref = expand(pow(x + y + 1, 6));
+	ex e;
+	{
+		pool_allocation_guard guard;
+		if (!get_pool_allocation()) {
+			clog << "pool_allocation_guard did not switch on pool allocation" << endl;
+			++result;
+		}
+		e = expand(pow(x + y + 1, 6));
+		for (int i = 0; i < 10; ++i)
+			e = expand(e * (x - y) / (x - y));
+	}
+	if (get_pool_allocation()) {
+		clog << "pool_allocation_guard did not restore previous setting" << endl;
+		++result;
+	}
+	if (e != ref) {
+		clog << "expand((x+y+1)^6) with pool allocation erroneously returned " << e << endl;
+		++result;
+	}
+
+	return result;
+}
+
+/* With hash-consing switched on, equal expressions built independently of
+ * each other must end up as the same object. */
+static unsigned exam_hash_consing()
+{
+	unsigned result = 0;
+	symbol x("x"), y("y");
+
+	const ex ref = expand(pow(x + y + 1, 6));
+	const bool previous = set_hash_consing(true);
+	reset_hash_consing_statistics();
+
+	ex e1 = sin(x + 2*y);
+	ex e2 = sin(x + 2*y);
+	if (!are_ex_trivially_equal(e1, e2)) {
+		clog << "hash-consing did not unify two instances of " << e1 << endl;
+		++result;
+	}
+	hash_consing_statistics stats = get_hash_consing_statistics();
+	if (stats.hits == 0 || stats.lookups < stats.hits || stats.size == 0) {
+		clog << "implausible hash-consing statistics: " << stats.lookups << " lookups, "
+		     << stats.hits << " hits, " << stats.size << " objects" << endl;
+		++result;
+	}
+
+	ex e = expand(pow(x + y + 1, 6));
+	if (e != ref) {
+		clog << "expand((x+y+1)^6) with hash-consing erroneously returned " << e << endl;
+		++result;
+	}
+
+	// Modifying a hash-consed object must not affect the other instances.
+	ex l1 = exprseq(x, y);
+	ex l2 = exprseq(x, y);
+	l1.let_op(0) = y;
+	if (!l2.op(0).is_equal(x)) {
+		clog << "modifying a hash-consed exprseq changed another one into " << l2 << endl;
+		++result;
+	}
+
+	set_hash_consing(false);
+	if (get_hash_consing_statistics().size != 0) {
+		clog << "switching off hash-consing did not empty the table" << endl;
+		++result;
+	}
+	set_hash_consing(previous);
+
+	return result;
+}
+
+/* Long sums and products combine their terms through a hash table.  The
+ * result must be the same as for short ones. */
+static unsigned exam_combine_many_terms()
+{
+	unsigned result = 0;
+	const int n = 100;
+	exvector x;
+	for (int i = 0; i < n; ++i)
+		x.push_back(symbol());
+
+	exvector v;
+	ex squares;
+	for (int i = 0; i < 3*n; ++i)
+		v.push_back(i < 2*n ? x[i % n] : -2*x[i % n]);
+	for (int i = 0; i < n/2; ++i) {
+		v.push_back(pow(x[i], 2));
+		squares += pow(x[i], 2);
+	}
+	ex e = add(v);
+	if (!e.is_equal(squares)) {
+		clog << "sum of " << v.size() << " terms erroneously returned " << e << endl;
+		++result;
+	}
+
+	v.clear();
+	ex cubes = 1;
+	for (int i = 0; i < 3*n; ++i)
+		v.push_back(x[i % n]);
+	for (int i = 0; i < n; ++i)
+		cubes *= pow(x[i], 3);
+	e = mul(v);
+	if (!e.is_equal(cubes)) {
+		clog << "product of " << v.size() << " factors erroneously returned " << e << endl;
+		++result;
+	}
+
+	return result;
+}
+
+/* Products of polynomials are expanded in packed form.  The result must
+ * agree with the unexpanded product at some points, and non-polynomial
+ * factors must not get in the way. */
+static unsigned exam_expand_polynomial_product()
+{
+	unsigned result = 0;
+	symbol x("x"), y("y"), z("z");
+	exmap point;
+	point[x] = 3;
+	point[y] = numeric(-5, 7);
+	point[z] = 11;
+
+	const ex factors[] = {
+		pow(x + y + 2*z + 1, 5) * pow(x - y + numeric(1, 3), 4),
+		(x*y*z + pow(x, 3) - 2) * (pow(y, 2) - z) * (x + pow(z, 7)),
+		(x + 1) * (x - 1) * (y + 1) * (y - 1) * 3*z,
+		(sin(x) + y) * (y + 1),
+		(pow(x, numeric(1, 2)) + y) * (x + y)
+	};
+	for (size_t i = 0; i < sizeof(factors)/sizeof(factors[0]); ++i) {
+		const ex e = expand(factors[i]);
+		if (!(e - factors[i]).subs(point).is_zero()) {
+			clog << "expand(" << factors[i] << ") erroneously returned " << e << endl;
+			++result;
+		}
+		if (!e.is_equal(expand(e))) {
+			clog << "expand(" << factors[i] << ") returned " << e << ", which is not fully expanded" << endl;
+			++result;
+		}
+	}
+
+	return result;
+}
+
+/* add_builder and mul_builder give the same sums and products as += and *=. */
+static unsigned exam_builders()
+{
+	unsigned result = 0;
+	symbol x("x"), y("y");
+
+	ex sum;
+	add_builder b;
+	for (int i = 0; i < 200; ++i) {
+		const ex t = (i % 3 + 1) * pow(x, i % 17) * pow(y, i % 5) + numeric(i, 7)
+		             - sin(x) * i + sqrt(ex(2)) * pow(y, i % 2) * sqrt(ex(2));
+		sum += t;
+		b += t;
+		if (i % 4 == 0) {
+			sum -= 2 * t;
+			b -= 2 * t;
+		}
+	}
+	if (!b.result().is_equal(sum)) {
+		clog << "add_builder gave " << b.result() << " instead of " << sum << endl;
+		++result;
+	}
+	b.clear();
+	b += x;
+	b -= x;
+	if (!b.result().is_zero()) {
+		clog << "add_builder gave " << b.result() << " for x-x" << endl;
+		++result;
+	}
+
+	ex prod = 1;
+	mul_builder m;
+	for (int i = 0; i < 50; ++i) {
+		const ex f = pow(x, i % 3 - 1) * pow(y + i % 4, 2) * (i + 1) * pow(sqrt(ex(3)), i)
+		             * pow(x * y + 1, numeric(1, 2));
+		prod *= f;
+		m *= f;
+	}
+	if (!m.result().is_equal(prod)) {
+		clog << "mul_builder gave " << m.result() << " instead of " << prod << endl;
+		++result;
+	}
+	m.clear();
+	m *= pow(x, 2);
+	m *= pow(x, -2);
+	if (!m.result().is_equal(1)) {
+		clog << "mul_builder gave " << m.result() << " for x^2*x^(-2)" << endl;
+		++result;
+	}
+
+	return result;
+}
+
+/* disk_add_builder gives the same sums as add_builder when it writes runs
+ * to disk and merges them in several passes. */
+struct streamed_terms {
+	ex last_rest;
+	unsigned count;
+	bool ordered;
+};
+
+static void check_term_order(const ex & rest, const numeric & coeff, void * data)
+{
+	streamed_terms & s = *static_cast<streamed_terms *>(data);
+	if (s.count > 0 && !is_exactly_a<numeric>(rest) && !ex_is_less()(s.last_rest, rest))
+		s.ordered = false;
+	s.last_rest = rest;
+	++s.count;
+}
+
+static unsigned exam_disk_add_builder()
+{
+	unsigned result = 0;
+	symbol x("x"), y("y");
+
+	add_builder b;
+	disk_add_builder d(7);
+	numeric sin_coeff;
+	for (int i = 0; i < 1000; ++i) {
+		const ex t = (i % 3 - 1) * pow(x, i % 17) * pow(y, i % 5) + numeric(i, 7)
+		             - sin(x + i % 11) * i + pow(y, numeric(1, 2 + i % 3));
+		b += t;
+		d += t;
+		if (i % 11 == 0)
+			sin_coeff -= i;
+	}
+	if (d.runs() <= 64) {
+		clog << "disk_add_builder with 7 terms in memory wrote only " << d.runs() << " runs" << endl;
+		++result;
+	}
+	const ex expected = b.result();
+	const ex sum = d.result();
+	if (!sum.is_equal(expected)) {
+		clog << "disk_add_builder gave " << sum << " instead of " << expected << endl;
+		++result;
+	}
+
+	streamed_terms s;
+	s.count = 0;
+	s.ordered = true;
+	// Terms may be added after reading, here one cancels
+	d.add_term(sin(x), -sin_coeff);
+	d.for_each_term(check_term_order, &s);
+	if (!s.ordered || s.count != expected.nops() - 1) {
+		clog << "disk_add_builder streamed " << s.count << " terms instead of "
+		     << expected.nops() - 1 << (s.ordered ? "" : ", out of order") << endl;
+		++result;
+	}
+
+	d.clear();
+	d += x;
+	d -= x;
+	if (!d.result().is_zero()) {
+		clog << "disk_add_builder gave " << d.result() << " for x-x" << endl;
+		++result;
+	}
+
+	return result;
+}
+
+/* The backends of set_polynomial_backend() give the same products and
+ * quotients. */
+static unsigned exam_polynomial_backend()
+{
+	unsigned result = 0;
+	symbol x("x"), y("y"), z("z");
+
+	const ex p = expand(pow(x + 2*y + z - 1, 8));
+	const ex q = expand(pow(x - y + numeric(1, 3)*z + 2, 9) + pow(y, 10));
+	const unsigned previous = set_polynomial_backend(polynomial_backend::heap);
+	const ex ref = expand(p * q);
+
+	const unsigned backends[] = { polynomial_backend::kronecker, polynomial_backend::automatic };
+	for (size_t i = 0; i < sizeof(backends) / sizeof(backends[0]); ++i) {
+		set_polynomial_backend(backends[i]);
+		const ex pq = expand(p * q);
+		if (!pq.is_equal(ref)) {
+			clog << "expand() with backend " << backends[i] << " differs by "
+			     << (pq - ref).expand() << endl;
+			++result;
+		}
+		ex quo;
+		if (!divide(ref, q, quo) || !quo.is_equal(p)) {
+			clog << "divide() with backend " << backends[i] << " didn't find the quotient "
+			     << p << endl;
+			++result;
+		}
+		if (divide(ref + x*pow(z, 17), q, quo) || divide(ref, q + 1, quo)) {
+			clog << "divide() with backend " << backends[i] << " divided an indivisible polynomial" << endl;
+			++result;
+		}
+	}
+	set_polynomial_backend(previous);
+
+	return result;
+}
+
+/* Products of large polynomials may be expanded by several threads, which
+ * must not change the result. */
+static unsigned exam_expand_threads()
+{
+	unsigned result = 0;
+	symbol x("x"), y("y"), z("z");
+
+	const ex p = expand(pow(x + y + z + 1, 10));
+	const ex q = expand(pow(x - 2*y + numeric(1, 3)*z + 1, 10));
+	const ex ref = expand(p * q);
+
+	const unsigned previous = set_expand_threads(4);
+	if (get_expand_threads() != 4) {
+		clog << "set_expand_threads(4) was ignored" << endl;
+		++result;
+	}
+	const ex e = expand(p * q);
+	set_expand_threads(previous);
+
+	if (!e.is_equal(ref)) {
+		clog << "expand() with four threads returned " << (e - ref).expand()
+		     << " more than with a single one" << endl;
+		++result;
+	}
+
+	return result;
+}
+
+/* Powers of sums of monomials are expanded by enumerating the terms of the
+ * multinomial expansion directly.  This must agree with the unexpanded
+ * power, also when some of the products of the monomials cancel. */
+static unsigned exam_expand_multinomial()
+{
+	unsigned result = 0;
+	symbol x("x"), y("y"), z("z");
+	exmap point;
+	point[x] = numeric(2, 3);
+	point[y] = -7;
+	point[z] = 5;
+
+	const ex powers[] = {
+		pow(x + y + z, 3),
+		pow(x + 2*y - numeric(1, 4)*z + 3, 7),
+		pow(x*y + pow(x, -1) + pow(y, 2)*z - 1, 5),
+		pow(x + pow(x, -1), 6),
+		pow(x + y + z + 1, 12)
+	};
+	for (size_t i = 0; i < sizeof(powers)/sizeof(powers[0]); ++i) {
+		const ex e = expand(powers[i]);
+		if (!(e - powers[i]).subs(point).is_zero()) {
+			clog << "expand(" << powers[i] << ") erroneously returned " << e << endl;
+			++result;
+		}
+		if (!e.is_equal(expand(e))) {
+			clog << "expand(" << powers[i] << ") returned " << e << ", which is not fully expanded" << endl;
+			++result;
+		}
+	}
+
+	const ex e = expand(pow(x + y + z + 1, 12));
+	if (e.nops() != 455) {
+		clog << "expand(pow(x+y+z+1, 12)) has " << e.nops() << " terms instead of 455" << endl;
+		++result;
+	}
+
+	return result;
+}
+
+/* Sums and products constructed from an epvector that is handed over by
+ * std::auto_ptr take the vector over where possible.  Nested sums and
+ * numeric terms must still be flattened and combined. */
+static unsigned exam_construct_from_epvector()
+{
+	unsigned result = 0;
+	symbol x("x"), y("y");
+
+	std::auto_ptr<epvector> vp(new epvector);
+	vp->push_back(expair(x, 1));
+	vp->push_back(expair(y, 2));
+	vp->push_back(expair(x, 3));
+	ex e = (new add(vp, 5))->setflag(status_flags::dynallocated);
+	if (!e.is_equal(4*x + 2*y + 5)) {
+		clog << "add from x, 2*y, 3*x and 5 returned " << e << endl;
+		++result;
+	}
+
+	vp.reset(new epvector);
+	vp->push_back(expair(x, 1));
+	vp->push_back(expair(x + y, 2));
+	vp->push_back(expair(3, 1));
+	e = (new add(vp, 0))->setflag(status_flags::dynallocated);
+	if (!e.is_equal(3*x + 2*y + 3)) {
+		clog << "add from x, 2*(x+y) and 3 returned " << e << endl;
+		++result;
+	}
+
+	vp.reset(new epvector);
+	vp->push_back(expair(x, 2));
+	vp->push_back(expair(x*y, 1));
+	vp->push_back(expair(y, -1));
+	e = (new mul(vp, 3))->setflag(status_flags::dynallocated);
+	if (!e.is_equal(3*pow(x, 3))) {
+		clog << "mul from x^2, x*y, y^(-1) and 3 returned " << e << endl;
+		++result;
+	}
+
+	return result;
+}
+
+/* compile_ex() compiles in memory without an external compiler. */
+static unsigned exam_compile_ex_jit()
+{
+	unsigned result = 0;
+	symbol x("x"), y("y");
+	const compile_ex_backend previous = set_compile_ex_backend(compile_ex_jit);
+
+	const ex f = sin(x)*pow(x, -3) + Pi*exp(-x/2) + sqrt(x);
+	const ex g = pow(x, y) + atan2(y, x) - 3*pow(x, 5)*cosh(y);
+	FUNCP_1P fp;
+	FUNCP_2P gp;
+	try {
+		compile_ex(f, x, fp);
+		compile_ex(g, x, y, gp);
+	} catch (const std::runtime_error&) {
+		// neither the JIT nor an external compiler is available
+		set_compile_ex_backend(previous);
+		return 0;
+	}
+	for (int i = 1; i <= 5; ++i) {
+		const double xv = 0.37*i, yv = 1.9 - 0.41*i;
+		const double fv = ex_to<numeric>(f.subs(x == xv).evalf()).to_double();
+		const double gv = ex_to<numeric>(g.subs(lst(x == xv, y == yv)).evalf()).to_double();
+		if (std::fabs(fp(xv) - fv) > 1e-12*std::fabs(fv) || std::fabs(gp(xv, yv) - gv) > 1e-12*std::fabs(gv)) {
+			clog << "compiled " << f << " or " << g << " at x=" << xv << ", y=" << yv
+			     << " gave " << fp(xv) << ", " << gp(xv, yv)
+			     << " instead of " << fv << ", " << gv << endl;
+			++result;
+		}
+	}
+
+	set_compile_ex_backend(previous);
+	return result;
+}
+
+/* The batch signatures of compile_ex() evaluate many points per call. */
+static unsigned exam_compile_ex_vec()
+{
+	unsigned result = 0;
+	symbol x("x"), y("y");
+	const ex f = pow(x, 2)*(y + 3) - x*y/2;
+
+	FUNCP_VEC fp;
+	FUNCP_VEC_FLOAT fpf;
+	try {
+		compile_ex(f, lst(x, y), fp);
+		compile_ex(f, lst(x, y), fpf);
+	} catch (const std::runtime_error&) {
+		// no external compiler available
+		return 0;
+	}
+
+	const std::size_t n = 37;
+	std::vector<double> xs(n), ys(n), out(n);
+	std::vector<float> xsf(n), ysf(n), outf(n);
+	for (std::size_t i = 0; i < n; ++i) {
+		xs[i] = xsf[i] = 0.25*i;
+		ys[i] = ysf[i] = 1.5 - 0.125*i;
+	}
+	const double* in[] = { &xs[0], &ys[0] };
+	const float* inf[] = { &xsf[0], &ysf[0] };
+	fp(n, in, &out[0]);
+	fpf(n, inf, &outf[0]);
+	for (std::size_t i = 0; i < n; ++i) {
+		const double v = xs[i]*xs[i]*(ys[i] + 3) - xs[i]*ys[i]/2;
+		if (std::fabs(out[i] - v) > 1e-12*(1 + std::fabs(v)) || std::fabs(outf[i] - v) > 1e-5*(1 + std::fabs(v))) {
+			clog << "compiled " << f << " at point " << i << " gave " << out[i] << ", " << outf[i]
+			     << " instead of " << v << endl;
+			++result;
+		}
+	}
+
+	return result;
+}
+
+/* Fresh directory for the module cache, below $TMPDIR or /tmp. */
+static std::string make_cache_dir()
+{
+	const char* tmpdir = std::getenv("TMPDIR");
+	const std::string pattern = std::string((tmpdir && *tmpdir) ? tmpdir : "/tmp") + "/ginac-cache-XXXXXX";
+	std::vector<char> name(pattern.begin(), pattern.end());
+	name.push_back('\0');
+	if (!mkdtemp(&name[0]))
+		return std::string();
+	return std::string(&name[0]);
+}
+
+/* Remove the module cache directory and the files in it. */
+static void remove_cache_dir(const std::string& dir)
+{
+	if (DIR* d = opendir(dir.c_str())) {
+		while (struct dirent* entry = readdir(d)) {
+			const std::string name = entry->d_name;
+			if (name != "." && name != "..")
+				unlink((dir + "/" + name).c_str());
+		}
+		closedir(d);
+	}
+	rmdir(dir.c_str());
+}
+
+/* A second compilation of the same expression loads the cached module. */
+static unsigned exam_compile_ex_cache()
+{
+	unsigned result = 0;
+	symbol x("x");
+	const ex f = 3*pow(x, 7) + 1;
+	const std::string dir = make_cache_dir();
+	if (dir.empty()) {
+		clog << "could not create a directory for the compile_ex() cache" << endl;
+		return 1;
+	}
+
+	const std::string previous_dir = set_compile_ex_cache_dir(dir);
+	const compile_ex_backend previous = set_compile_ex_backend(compile_ex_external);
+	reset_compile_ex_cache_statistics();
+	FUNCP_1P fp1, fp2;
+	try {
+		compile_ex(f, x, fp1);
+		compile_ex(f, x, fp2);
+	} catch (const std::runtime_error&) {
+		// no external compiler available
+		set_compile_ex_backend(previous);
+		set_compile_ex_cache_dir(previous_dir);
+		remove_cache_dir(dir);
+		return 0;
+	}
+	set_compile_ex_backend(previous);
+	set_compile_ex_cache_dir(previous_dir);
+
+	const compile_ex_cache_statistics stats = get_compile_ex_cache_statistics();
+	if (stats.lookups != 2 || stats.hits != 1) {
+		clog << "compiling " << f << " twice made " << stats.lookups << " cache lookups with "
+		     << stats.hits << " hits instead of 2 with 1" << endl;
+		++result;
+	}
+	if (fp1(0.5) != fp2(0.5) || std::fabs(fp2(0.5) - (3*std::pow(0.5, 7) + 1)) > 1e-15) {
+		clog << "cached module for " << f << " gave " << fp2(0.5) << " at x=0.5" << endl;
+		++result;
+	}
+
+	remove_cache_dir(dir);
+	return result;
+}
+
+/* Large batches are compiled as several translation units. */
+static unsigned exam_compile_ex_units()
+{
+	unsigned result = 0;
+	symbol x("x"), y("y");
+	const int n = 600;
+	lst exprs;
+	for (int i = 0; i < n; ++i)
+		exprs.append(pow(x, i % 7)*(y + i) - sin(i*x));
+
+	const compile_ex_backend previous = set_compile_ex_backend(compile_ex_external);
+	const unsigned previous_jobs = set_compile_ex_jobs(3);
+	FUNCP_CUBA fp;
+	try {
+		compile_ex(exprs, lst(x, y), fp);
+	} catch (const std::runtime_error&) {
+		// no external compiler available
+		set_compile_ex_backend(previous);
+		set_compile_ex_jobs(previous_jobs);
+		return 0;
+	}
+	set_compile_ex_backend(previous);
+	set_compile_ex_jobs(previous_jobs);
+
+	const int ndim = 2, ncomp = n;
+	const double a[] = { 0.75, -1.25 };
+	std::vector<double> f(n);
+	fp(&ndim, a, &ncomp, &f[0]);
+	for (int i = 0; i < n; ++i) {
+		const double v = std::pow(a[0], i % 7)*(a[1] + i) - std::sin(i*a[0]);
+		if (std::fabs(f[i] - v) > 1e-12*(1 + std::fabs(v))) {
+			clog << "compiled " << exprs.op(i) << " gave " << f[i] << " instead of " << v << endl;
+			++result;
+		}
+	}
+
+	return result;
+}
+
+/* compile_ex() produces code for complex and arbitrary precision numbers. */
+static unsigned exam_compile_ex_complex()
+{
+	unsigned result = 0;
+	symbol x("x"), y("y");
+	const lst exprs(pow(x, 2) + 2*I*y - 1/x, exp(y)*sqrt(x) + sin(x*y));
+
+	FUNCP_COMPLEX fp;
+	FUNCP_CL_N fpn;
+	try {
+		compile_ex(exprs, lst(x, y), fp);
+		compile_ex(exprs, lst(x, y), fpn);
+	} catch (const std::runtime_error&) {
+		// no external compiler available
+		return 0;
+	}
+
+	const numeric xv(numeric(3, 4) + numeric(1, 2)*I), yv(numeric(-5, 4) + numeric(1, 8)*I);
+	const std::complex<double> a[] = {
+		std::complex<double>(0.75, 0.5), std::complex<double>(-1.25, 0.125)
+	};
+	std::complex<double> f[2];
+	fp(a, f);
+	const long digitsbuf = Digits;
+	Digits = 40;
+	const cln::cl_N an[] = { xv.evalf().to_cl_N(), yv.evalf().to_cl_N() };
+	cln::cl_N fn[2];
+	fpn(an, fn);
+	for (int i = 0; i < 2; ++i) {
+		const numeric v = ex_to<numeric>(exprs.op(i).subs(lst(x == xv, y == yv)).evalf());
+		const std::complex<double> vd(v.real().to_double(), v.imag().to_double());
+		if (std::abs(f[i] - vd) > 1e-13*std::abs(vd)) {
+			clog << "compiled " << exprs.op(i) << " gave " << f[i] << " instead of " << v << endl;
+			++result;
+		}
+		if (abs(numeric(fn[i]) - v) > numeric(1, 10).power(35)*abs(v)) {
+			clog << "compiled " << exprs.op(i) << " in CLN gave " << numeric(fn[i]) << " instead of " << v << endl;
+			++result;
+		}
+	}
+	Digits = digitsbuf;
+
+	return result;
+}
+
+/* compile_ex_jacobian() computes the values and all first derivatives. */
+static unsigned exam_compile_ex_jacobian()
+{
+	unsigned result = 0;
+	symbol x("x"), y("y"), z("z");
+	const ex s = sin(x*y);
+	const lst exprs(s + pow(x, 3)*exp(y) - pow(s, 2)/z, atan2(y, x) + log(z)*sqrt(x + y));
+	const lst syms(x, y, z);
+
+	FUNCP_CUBA fp;
+	try {
+		compile_ex_jacobian(exprs, syms, fp);
+	} catch (const std::runtime_error&) {
+		// no external compiler available
+		return 0;
+	}
+
+	const int ndim = 3, ncomp = 8;
+	const double a[] = { 0.6, 1.3, 2.2 };
+	double f[8];
+	fp(&ndim, a, &ncomp, f);
+	const lst point(x == a[0], y == a[1], z == a[2]);
+	for (int i = 0; i < 2; ++i) {
+		for (int j = -1; j < 3; ++j) {
+			const ex e = j < 0 ? exprs.op(i) : exprs.op(i).diff(ex_to<symbol>(syms.op(j)));
+			const double v = ex_to<numeric>(e.subs(point).evalf()).to_double();
+			const double fv = j < 0 ? f[i] : f[2 + 3*i + j];
+			if (std::fabs(fv - v) > 1e-13*(1 + std::fabs(v))) {
+				clog << "compiled " << e << " gave " << fv << " instead of " << v << endl;
+				++result;
+			}
+		}
+	}
+
+	return result;
+}
+
+/* The bytecode evaluator agrees with evalf() and computes shared subexpressions once. */
+static unsigned exam_bytecode_evaluator()
+{
+	unsigned result = 0;
+	symbol x("x"), y("y");
+	const ex s = sin(x + y);
+	const lst exprs(pow(s, 2) + exp(s)/3 - Pi*pow(x, -3), atan2(y, x) + sqrt(x)*cosh(x + y) + pow(y, numeric(3, 2)));
+
+	bytecode_evaluator bc(exprs, lst(x, y));
+	const bytecode_evaluator bc0(lst(exprs.op(0)), lst(x, y)), bc1(lst(exprs.op(1)), lst(x, y));
+	if (bc.instructions() >= bc0.instructions() + bc1.instructions()) {
+		clog << "bytecode of " << exprs << " does not share x+y" << endl;
+		++result;
+	}
+	for (int i = 1; i <= 5; ++i) {
+		const double args[] = { 0.37*i, 1.9 + 0.41*i };
+		double values[2];
+		bc.evaluate(args, values);
+		for (int k = 0; k < 2; ++k) {
+			const double v = ex_to<numeric>(exprs.op(k).subs(lst(x == args[0], y == args[1])).evalf()).to_double();
+			if (std::fabs(values[k] - v) > 1e-13*std::fabs(v)) {
+				clog << "bytecode of " << exprs.op(k) << " at x=" << args[0] << ", y=" << args[1]
+				     << " gave " << values[k] << " instead of " << v << endl;
+				++result;
+			}
+		}
+	}
+
+	bytecode_evaluator f(lst(pow(x, 7) - 2*x), lst(x));
+	if (f(1.5) != std::pow(1.5, 7) - 3) {
+		clog << "bytecode of x^7-2*x at x=1.5 gave " << f(1.5) << endl;
+		++result;
+	}
+
+	try {
+		bytecode_evaluator g(lst(zeta(x)), lst(x));
+		clog << "bytecode of zeta(x) did not throw" << endl;
+		++result;
+	} catch (const std::invalid_argument&) {
+	}
+
+	return result;
+}
+
+/* Shared subexpressions are printed once into temporaries. */
+static unsigned exam_print_csrc_cse()
+{
+	unsigned result = 0;
+	symbol x("x"), y("y");
+	const ex s = sin(x + y);
+	const lst exprs(pow(s, 2) + exp(s), cos(x + y)*s);
+	std::vector<std::string> lhs;
+	lhs.push_back("f[0]");
+	lhs.push_back("f[1]");
+
+	std::ostringstream os;
+	const csrc_cse_statistics stats = print_csrc_cse(exprs, lhs, print_csrc_double(os));
+	const std::string code = os.str();
+	// x+y and sin(x+y) are computed once
+	if (stats.temporaries != 2 || stats.ops_after >= stats.ops_before
+	 || code.find("double cse0 = ") == std::string::npos || code.find("f[1] = ") == std::string::npos) {
+		clog << "print_csrc_cse() of " << exprs << " gave " << stats.temporaries << " temporaries, "
+		     << stats.ops_before << " -> " << stats.ops_after << " operations:" << endl << code;
+		++result;
+	}
+
+	return result;
+}
+
+/* Polynomials are printed in Horner form with shared power chains. */
+static unsigned exam_print_csrc_horner()
+{
+	unsigned result = 0;
+	symbol x("x"), y("y"), z("z");
+	const ex p = expand(pow(1 + 2*x + y - z, 6));
+	const lst exprs(p, expand(p*pow(x, 5)));
+	std::vector<std::string> lhs;
+	lhs.push_back("f[0]");
+	lhs.push_back("f[1]");
+
+	std::ostringstream plain, horner;
+	const csrc_cse_statistics before = print_csrc_cse(exprs, lhs, print_csrc_double(plain));
+	const csrc_cse_statistics after = print_csrc_cse(exprs, lhs, print_csrc_double(horner), csrc_options::horner);
+	if (after.ops_before != before.ops_before || after.ops_after >= before.ops_after
+	 || horner.str().find("pow(") != std::string::npos) {
+		clog << "print_csrc_cse() in Horner form took " << after.ops_after << " operations instead of "
+		     << before.ops_after << " (" << before.ops_before << " without elimination):" << endl
+		     << horner.str();
+		++result;
+	}
+
+	return result;
+}
+
+/* Deeply nested expressions and huge sums are printed as several statements. */
+static unsigned exam_print_csrc_large()
+{
+	unsigned result = 0;
+	symbol x("x");
+	ex e = x;
+	for (int i = 1; i <= 3000; ++i)
+		e = sin(e) + i;
+	exvector terms;
+	for (int i = 1; i <= 2000; ++i)
+		terms.push_back(pow(x, i)/i);
+	const lst exprs(e, add(terms));
+	std::vector<std::string> lhs;
+	lhs.push_back("f[0]");
+	lhs.push_back("f[1]");
+
+	std::ostringstream os;
+	print_csrc_cse(exprs, lhs, print_csrc_double(os));
+	const std::string code = os.str();
+	int depth = 0, max_depth = 0;
+	for (std::string::const_iterator c = code.begin(); c != code.end(); ++c) {
+		if (*c == '(')
+			max_depth = std::max(max_depth, ++depth);
+		else if (*c == ')')
+			--depth;
+	}
+	if (max_depth > 300 || code.find("+=") == std::string::npos) {
+		clog << "print_csrc_cse() nested parentheses " << max_depth << " deep"
+		     << (code.find("+=") == std::string::npos ? " and did not split the sum" : "") << endl;
+		++result;
+	}
+
+	return result;
+}
+
+/* The profile counts the operations done while profiling is enabled, and
+ * nothing else. */
+static unsigned exam_profile()
+{
+	unsigned result = 0;
+	symbol x("x"), y("y");
+
+	reset_profile_statistics();
+	const bool previous = set_profiling(true);
+	ex e = expand(pow(x + y, 6) * (x - y));
+	ex g = gcd(e, expand(pow(x + y, 3)));
+	ex s = e.subs(y == 1);
+	set_profiling(false);
+	profile_statistics stats = get_profile_statistics();
+	const vector<allocation_statistics> allocations = get_allocation_statistics();
+	expand(pow(x + 2*y, 6));
+	set_profiling(previous);
+
+	if (!g.is_equal(expand(pow(x + y, 3))) &&
+	    !g.is_equal(-expand(pow(x + y, 3)))) {
+		clog << "gcd() gave " << g << " while profiling" << endl;
+		++result;
+	}
+	if (stats.calls[profile_expand] < 2 || stats.calls[profile_gcd] != 1 ||
+	    stats.calls[profile_eval] == 0 || stats.events[profile_gcd_called] == 0 ||
+	    stats.events[profile_allocations] == 0 || stats.calls[profile_subs] != 1) {
+		clog << "profile counted " << stats.calls[profile_expand] << " expand() calls, "
+		     << stats.calls[profile_gcd] << " gcd() calls, "
+		     << stats.calls[profile_subs] << " subs() calls, "
+		     << stats.calls[profile_eval] << " evaluations, "
+		     << stats.events[profile_gcd_called] << " GCD computations and "
+		     << stats.events[profile_allocations] << " allocations" << endl;
+		++result;
+	}
+	unsigned long expand_births = 0;
+	for (vector<allocation_statistics>::const_iterator i = allocations.begin(); i != allocations.end(); ++i)
+		if (i->phase == profile_expand)
+			expand_births += i->born;
+	if (expand_births == 0) {
+		clog << "no objects created by expand() were counted" << endl;
+		++result;
+	}
+	if (get_profile_statistics().calls[profile_expand] != stats.calls[profile_expand]) {
+		clog << "expand() was profiled while profiling was disabled" << endl;
+		++result;
+	}
+
+	return result;
+}
+
+/* The trace lists the operations done while tracing is enabled, in the
+ * Trace Event Format. */
+static unsigned exam_trace()
+{
+	unsigned result = 0;
+	symbol x("x"), y("y");
+
+	clear_trace();
+	const bool previous = set_tracing(true);
+	ex e = normal((pow(x, 2) - pow(y, 2)) / (x + y));
+	set_tracing(previous);
+	ostringstream os;
+	write_trace(os);
+
+	if (!e.is_equal(x - y)) {
+		clog << "normal() gave " << e << " while tracing" << endl;
+		++result;
+	}
+	const string trace = os.str();
+	if (trace.find("{\"traceEvents\":[") != 0 ||
+	    trace.find("\"name\":\"normal\"") == string::npos ||
+	    trace.find("\"name\":\"gcd\"") == string::npos) {
+		clog << "trace of normal() is missing events:" << endl << trace;
+		++result;
+	}
+	ostringstream empty;
+	write_trace(empty);
+	if (empty.str().find("\"name\"") != string::npos) {
+		clog << "write_trace() kept the events written before" << endl;
+		++result;
+	}
+
+	return result;
+}
+
+/* A computation stops at its next safe point when its budget is exceeded,
+ * and the expressions involved are left intact. */
+static unsigned exam_budget()
+{
+	unsigned result = 0;
+	symbol x("x"), y("y"), z("z");
+	const ex p = pow(1 + x + y + z, 30);
+
+	cancellation_token stop;
+	stop.cancel();
+	try {
+		computation_budget budget(&stop);
+		ex e = p.expand();
+		clog << "expand() ignored the cancellation" << endl;
+		++result;
+	} catch (const computation_aborted & e) {
+		if (e.reason() != computation_aborted::cancelled) {
+			clog << "cancelled expand() gave the reason " << e.reason() << endl;
+			++result;
+		}
+	}
+
+	try {
+		computation_budget budget(0, 0, 1e-9);
+		ex e = p.expand();
+		clog << "expand() ignored the time limit" << endl;
+		++result;
+	} catch (const computation_aborted & e) {
+		if (e.reason() != computation_aborted::time_exceeded) {
+			clog << "expand() out of time gave the reason " << e.reason() << endl;
+			++result;
+		}
+	}
+
+	stop.reset();
+	computation_budget budget(&stop);
+	if (!p.is_equal(pow(1 + x + y + z, 30)) ||
+	    expand(p).nops() != 5456) {
+		clog << "expand() failed after an aborted computation" << endl;
+		++result;
+	}
+
+	return result;
+}
+
+/* Elements of lists are found by op() and let_op() in any order, also after
+ * the list was changed or copied. */
+static unsigned exam_lst_positions()
+{
+	unsigned result = 0;
+	const int n = 200;
+
+	lst l;
+	for (int i = 0; i < n; ++i)
+		l.append(i);
+	for (int i = 0; i < n; ++i)
+		result += !l.op(i).is_equal(i);
+	for (int i = n - 1; i >= 0; --i)
+		result += !l.op(i).is_equal(i);
+	for (int i = 0; i < n; ++i)
+		result += !l.op((i * 37) % n).is_equal((i * 37) % n);
+	if (result) {
+		clog << "lst::op() returned wrong elements" << endl;
+		return result;
+	}
+
+	l.op(n - 1);
+	lst copy = l;
+	copy.let_op(n - 1) = -1;
+	if (!l.op(n - 1).is_equal(n - 1) || !copy.op(n - 1).is_equal(-1)) {
+		clog << "let_op() on a copy of a lst changed the wrong element" << endl;
+		++result;
+	}
+
+	l.op(0);
+	l.prepend(-1);
+	l.op(n);
+	l.remove_first();
+	l.remove_last();
+	l.append(n);
+	if (!l.op(0).is_equal(0) || !l.op(n - 1).is_equal(n) || !l.op(n - 2).is_equal(n - 2)) {
+		clog << "lst::op() was wrong after changing the list: " << l.op(0)
+		     << ", " << l.op(n - 2) << ", " << l.op(n - 1) << endl;
+		++result;
+	}
+
+	return result;
+}
+
+/* The terms of e of degree at most n in s, from the full expansion. */
+static ex truncated_reference(const ex & e, const symbol & s, int n)
+{
+	const ex expanded = e.expand();
+	ex r;
+	for (int k = expanded.ldegree(s); k <= n; ++k)
+		r += expanded.coeff(s, k) * pow(s, k);
+	return r;
+}
+
+/* expand_truncated() gives the terms of low degree of the expansion. */
+static unsigned exam_expand_truncated()
+{
+	unsigned result = 0;
+	symbol eps("eps"), x("x"), y("y"), t("t");
+
+	const ex cases[] = {
+		pow(1 + eps + x, 5) * pow(1 + eps, 3),
+		pow(1 + eps + x, 2) * pow(y - 2*eps, 2) * (3 + eps*y),
+		pow(1 + eps, 4) * sin(eps + pow(eps, 3)) * pow(1 + eps, -2),
+		pow(1/eps + 1 + eps, 4) * (x + eps)
+	};
+	for (size_t i = 0; i < sizeof(cases) / sizeof(cases[0]); ++i) {
+		for (int n = 0; n <= 3; ++n) {
+			const ex r = expand_truncated(cases[i], eps, n);
+			const ex ref = truncated_reference(cases[i], eps, n);
+			if (!(r - ref).expand().is_zero()) {
+				clog << "expand_truncated(" << cases[i] << ", eps, " << n << ") gave "
+				     << r << " instead of " << ref << endl;
+				++result;
+			}
+		}
+	}
+
+	// Total degree in several symbols, found by scaling them with t
+	const ex e = pow(1 + eps + x, 4) * pow(2 - eps + y, 3) * pow(1 + x*eps, 2);
+	const ex scaled = e.subs(lst(eps == t*eps, x == t*x));
+	const ex r = expand_truncated(e, lst(eps, x), 3);
+	const ex ref = truncated_reference(scaled, t, 3).subs(t == 1);
+	if (!(r - ref).expand().is_zero()) {
+		clog << "expand_truncated(" << e << ", {eps,x}, 3) gave " << r
+		     << " instead of " << ref << endl;
+		++result;
+	}
+
+	return result;
+}
+
+/* Whether all coefficients of the polynomial e are divisible by p. */
+static bool coefficients_divisible(const ex & e, long p)
+{
+	const ex expanded = e.expand();
+	const size_t n = is_a<add>(expanded) ? expanded.nops() : 1;
+	for (size_t i = 0; i < n; ++i) {
+		const ex t = is_a<add>(expanded) ? expanded.op(i) : expanded;
+		const numeric c = is_a<numeric>(t) ? ex_to<numeric>(t) : ex_to<numeric>(t.op(t.nops() - 1));
+		if (!mod(c.numer(), p).is_zero())
+			return false;
+	}
+	return true;
+}
+
+/* expand_modular() agrees with expand() modulo p, and two primes give the
+ * integer coefficients by Chinese remaindering. */
+static unsigned exam_expand_modular()
+{
+	unsigned result = 0;
+	symbol x("x"), y("y"), z("z");
+	const long p1 = 2147483647, p2 = 2147483629;
+
+	const ex cases[] = {
+		pow(1 + x + y, 20),
+		pow(x/3 + 1, 5) * (y - 2),
+		pow(x + y, 3) * pow(x - y + z, 4) - pow(x*y, 2) * 7,
+		pow(sin(x) + y, 3) * (y + 1),
+		pow(x + 1, 2) * pow(x, -1) * (z + 5)
+	};
+	for (size_t i = 0; i < sizeof(cases) / sizeof(cases[0]); ++i) {
+		const ex r = expand_modular(cases[i], p1);
+		if (!coefficients_divisible(r - cases[i], p1)) {
+			clog << "expand_modular(" << cases[i] << ", " << p1 << ") gave " << r << endl;
+			++result;
+		}
+	}
+
+	const ex e = pow(3*x + 2*y - 5, 12);
+	const ex r1 = expand_modular(e, p1), r2 = expand_modular(e, p2);
+	const ex expanded = e.expand();
+	std::vector<cln::cl_I> moduli(2);
+	moduli[0] = p1;
+	moduli[1] = p2;
+	const numeric m = numeric(p1) * numeric(p2);
+	for (int i = 0; i <= 12; ++i) {
+		for (int j = 0; i + j <= 12; ++j) {
+			std::vector<cln::cl_I> residues(2);
+			residues[0] = cln::the<cln::cl_I>(ex_to<numeric>(r1.coeff(x, i).coeff(y, j)).to_cl_N());
+			residues[1] = cln::the<cln::cl_I>(ex_to<numeric>(r2.coeff(x, i).coeff(y, j)).to_cl_N());
+			numeric c(cln::integer_cra(residues, moduli));
+			if (c > m / 2)
+				c = c - m;
+			if (!expanded.coeff(x, i).coeff(y, j).is_equal(c)) {
+				clog << "coefficient of x^" << i << "*y^" << j << " of " << e
+				     << " reconstructed as " << c << endl;
+				++result;
+			}
+		}
+	}
+
+	return result;
+}
+
+/* Deeply nested expressions are printed like shallow ones. */
+static unsigned exam_print_deep()
+{
+	unsigned result = 0;
+	symbol x("x"), y("y");
+	const int depth = 3000;
+
+	ex e = x;
+	for (int i = 0; i < depth; ++i)
+		e = sin(e);
+	std::string expected;
+	for (int i = 0; i < depth; ++i)
+		expected += "sin(";
+	expected += "x";
+	expected += std::string(depth, ')');
+	expected = "{" + expected + ",y," + expected + "}";
+
+	std::ostringstream os;
+	os << lst(e, y, e);
+	if (os.str() != expected) {
+		clog << "printing a deeply nested expression gave "
+		     << os.str().substr(0, 100) << "..." << endl;
+		++result;
+	}
+
+	std::ostringstream tex;
+	tex << latex << lst(e, y);
+	const std::string t = tex.str();
+	if (t.find("\\sin") == std::string::npos ||
+	    std::count(t.begin(), t.end(), '(') != std::count(t.begin(), t.end(), ')')) {
+		clog << "printing a deeply nested expression in LaTeX went wrong" << endl;
+		++result;
+	}
+
+	return result;
+}
+
+static unsigned exam_print_dag()
+{
+	unsigned result = 0;
+	symbol x("x");
+	const int depth = 40;
+
+	// The tree of e has about 2^depth nodes, its DAG about 3*depth.
+	ex e = x;
+	for (int i = 0; i < depth; ++i)
+		e = sin(e)*cos(e);
+
+	std::ostringstream os;
+	print_dag c(os);
+	e.print(c);
+	if (c.repeats < depth || c.nodes > 10*depth || os.str().size() > 100000) {
+		clog << "printing a DAG of " << depth << " levels gave " << c.nodes
+		     << " objects, " << c.repeats << " repeated" << endl;
+		++result;
+	}
+	if (c.bytes < c.nodes*sizeof(basic)) {
+		clog << "the footprint of " << c.nodes << " objects is only "
+		     << c.bytes << " bytes" << endl;
+		++result;
+	}
+
+	return result;
+}
+
+static unsigned exam_subs_index()
+{
+	unsigned result = 0;
+	const int n = 50;
+	symbol x("x");
+	exvector a, b, c, d;
+	for (int i = 0; i < n; ++i) {
+		a.push_back(symbol()); b.push_back(symbol());
+		c.push_back(symbol()); d.push_back(symbol());
+	}
+
+	// Large enough to be indexed
+	exmap m;
+	for (int i = 0; i < n; ++i) {
+		m[a[i]*b[i]] = c[i];
+		m[d[i]] = i;
+	}
+	m[sin(wild(0))] = cos(wild(0));
+
+	ex e1 = 0, e2 = 0, expected1 = 0, expected2 = 0;
+	for (int i = 0; i < n; ++i) {
+		e1 += d[i]*sin(a[i]);
+		expected1 += i*cos(a[i]);
+		e2 += a[i]*b[i]*x + pow(a[i], 2)*pow(b[i], 2) + d[i]*sin(a[i]);
+		expected2 += c[i]*x + pow(c[i], 2) + i*cos(a[i]);
+	}
+
+	ex f1 = e1.subs(m);
+	if (!(f1 - expected1).is_zero()) {
+		clog << "substitution with a large map gave " << f1 << endl;
+		++result;
+	}
+	ex f2 = e2.subs(m, subs_options::algebraic);
+	if (!(f2 - expected2).expand().is_zero()) {
+		clog << "algebraic substitution with a large map gave " << f2 << endl;
+		++result;
+	}
+
+	return result;
+}
+
+/** Replaces x by y, with the results depending on the argument only. */
+struct pure_replace : public map_function {
+	pure_replace(const ex & x_, const ex & y_) : x(x_), y(y_) {}
+	ex operator()(const ex & e) { return e.is_equal(x) ? y : e.map(*this); }
+	bool is_pure() const { return true; }
+	ex x, y;
+};
+
+static unsigned exam_expand_shared()
+{
+	unsigned result = 0;
+	symbol x("x");
+	const unsigned options = expand_options::expand_function_args;
+
+	ex e1 = sin(x) + cos(x)*(x + 1);
+	ex e2 = sin(e1) + cos(e1)*(x + 1);
+	ex e1_expanded = sin(x) + x*cos(x) + cos(x);
+	ex e2_expanded = sin(e1_expanded) + x*cos(e1_expanded) + cos(e1_expanded);
+	if (!e2.expand(options).is_equal(e2_expanded)) {
+		clog << "expansion of " << e2 << " gave " << e2.expand(options)
+		     << " instead of " << e2_expanded << endl;
+		++result;
+	}
+
+	// Each level refers to the previous one twice, so the expansion takes
+	// 2^depth steps unless the shared levels are expanded only once
+	const int depth = 60;
+	ex e = x;
+	for (int i = 0; i < depth; ++i)
+		e = sin(e) + cos(e)*(x + 1);
+	std::ostringstream os;
+	print_dag c(os);
+	e.expand(options).print(c);
+	if (c.nodes > 20*depth) {
+		clog << "expansion of a shared expression gave " << c.nodes
+		     << " different objects" << endl;
+		++result;
+	}
+
+	return result;
+}
+
+static unsigned exam_symbol_mask()
+{
+	unsigned result = 0;
+
+	// More symbols than bits, so that some of them share a bit
+	std::vector<symbol> s;
+	for (int i = 0; i < 40; ++i) {
+		std::ostringstream name;
+		name << "s" << i;
+		s.push_back(symbol(name.str()));
+	}
+	ex e = 0;
+	for (int i = 0; i < 20; ++i)
+		e += pow(s[i], 2) * sin(s[i]) + s[i];
+
+	for (int i = 0; i < 40; ++i) {
+		const bool in = i < 20;
+		if (e.has(s[i]) != in || e.degree(s[i]) != (in ? 2 : 0)
+		    || !e.coeff(s[i], 0).is_equal(in ? e.subs(s[i] == 0) : e)
+		    || e.diff(s[i]).is_zero() == in || e.subs(s[i] == 1).is_equal(e) == in) {
+			clog << "symbol " << s[i] << " is " << (in ? "" : "not ")
+			     << "in " << e << ", but was treated otherwise" << endl;
+			++result;
+		}
+	}
+
+	// The bits of symbols 20 to 31 are not used, so nothing is rebuilt
+	if (!are_ex_trivially_equal(e.subs(s[25] == 1), e)) {
+		clog << "substitution of an absent symbol rebuilt " << e << endl;
+		++result;
+	}
+
+	// The masks of the results must be calculated afresh
+	ex f = e.subs(s[0] == s[25]);
+	if (!f.has(s[25]) || f.has(s[0]) || f.degree(s[25]) != 2) {
+		clog << e << " with " << s[0] << " replaced by " << s[25]
+		     << " gave " << f << endl;
+		++result;
+	}
+
+	return result;
+}
+
+static unsigned exam_pattern_net()
+{
+	unsigned result = 0;
+	symbol x("x"), y("y");
+
+	exvector patterns;
+	patterns.push_back(sin(wild(0)));
+	patterns.push_back(pow(wild(0), 2));
+	patterns.push_back(pow(x, wild(0)));
+	patterns.push_back(sin(x) + wild(0));
+	patterns.push_back(wild(0) * cos(wild(1)));
+	patterns.push_back(sin(x + 1));
+	patterns.push_back(lst(wild(0), y, wild(0)));
+	patterns.push_back(wild(1));
+	pattern_net net;
+	for (size_t i = 0; i < patterns.size(); ++i)
+		net.add(patterns[i]);
+
+	exvector subjects;
+	subjects.push_back(sin(y));
+	subjects.push_back(sin(x + 1));
+	subjects.push_back(pow(x + y, 2));
+	subjects.push_back(pow(x, 3));
+	subjects.push_back(pow(x, y));
+	subjects.push_back(sin(x) + y + 2);
+	subjects.push_back(3 * cos(x + y));
+	subjects.push_back(lst(x, y, x));
+	subjects.push_back(lst(x, y, y));
+	subjects.push_back(x);
+
+	for (size_t k = 0; k < subjects.size(); ++k) {
+		const ex & e = subjects[k];
+		// The last pattern matches anything
+		unsigned expected = 0;
+		exmap expected_repls;
+		while (!e.match(patterns[expected], expected_repls))
+			++expected;
+		exmap repls;
+		unsigned found = net.match(e, repls);
+		if (found != expected || repls != expected_repls) {
+			clog << e << " matched pattern " << found << " of the net instead of "
+			     << patterns[expected] << endl;
+			++result;
+		}
+	}
+
+	std::vector<unsigned> candidates;
+	net.candidates(sin(x + 2), candidates);
+	if (candidates.size() != 2 || candidates[0] != 0 || candidates[1] != 7) {
+		clog << "sin(x+2) could match " << candidates.size()
+		     << " patterns of the net instead of 2" << endl;
+		++result;
+	}
+
+	return result;
+}
+
+static unsigned exam_collect_coeffs()
+{
+	unsigned result = 0;
+	symbol x("x"), y("y"), a("a");
+
+	const ex e = (pow(1 + x + y + a, 4) + sin(a) / x).expand();
+	const exp_coeff_map c = collect_coeffs(e, lst(x, y));
+	if (c.size() != 16) {
+		clog << "collect_coeffs(" << e << ") found " << c.size()
+		     << " coefficients instead of 16" << endl;
+		++result;
+	}
+	for (exp_coeff_map::const_iterator i = c.begin(); i != c.end(); ++i) {
+		const ex expected = e.coeff(x, i->first[0]).coeff(y, i->first[1]);
+		if (i->first.size() != 2 || !(i->second - expected).expand().is_zero()) {
+			clog << "coefficient of x^" << i->first[0] << "*y^" << i->first[1]
+			     << " in " << e << " is " << i->second << " instead of "
+			     << expected << endl;
+			++result;
+		}
+	}
+
+	const ex d = e.collect(lst(x, y), true);
+	if (!(d - e).expand().is_zero()) {
+		clog << "distributed collect of " << e << " gave " << d << endl;
+		++result;
+	}
+
+	return result;
+}
+
+static unsigned exam_deep_operations()
+{
+	unsigned result = 0;
+	symbol x("x"), y("y");
+
+	// Continued fraction c = 1/(1+x*c), and its value and derivative at x==1
+	const int depth = 5000;
+	ex e = x;
+	numeric c = 1, d = 1;
+	for (int i = 0; i < depth; ++i) {
+		e = 1/(1 + x*e);
+		const numeric next = 1/(1 + c);
+		d = -(c + d) * next * next;
+		c = next;
+	}
+
+	if (!e.subs(x == 1).is_equal(c) || !e.expand().subs(x == 1).is_equal(c)) {
+		clog << "substitution in or expansion of a deep continued fraction went wrong" << endl;
+		++result;
+	}
+	if (!e.diff(x).subs(x == 1).is_equal(d)) {
+		clog << "derivative of a deep continued fraction went wrong" << endl;
+		++result;
+	}
+	const ex f = e.subs(x == y);
+	if (!f.has(pow(y, 2)) || f.has(pow(y, 3)) || f.has(x)) {
+		clog << "search in a deep continued fraction went wrong" << endl;
+		++result;
+	}
+
+	return result;
+}
+
+static unsigned exam_subs_shared()
+{
+	unsigned result = 0;
+	symbol x("x"), y("y");
+
+	// Each level refers to the previous one twice
+	ex ex_x = x, ex_y = y;
+	for (int i = 0; i < 8; ++i) {
+		ex_x = ex_x + sin(ex_x);
+		ex_y = ex_y + sin(ex_y);
+	}
+	pure_replace replace_x(x, y);
+	ex f = ex_x.subs(x == y);
+	ex g = ex_x.map(replace_x);
+	if (!f.is_equal(ex_y) || !g.is_equal(ex_y)) {
+		clog << "substitution in a shared expression gave " << f
+		     << " and " << g << " instead of " << ex_y << endl;
+		++result;
+	}
+
+	// The tree of this one is too large to be substituted node by node,
+	// and the sharing must be kept
+	const int depth = 60;
+	ex e = x;
+	for (int i = 0; i < depth; ++i)
+		e = e + sin(e);
+	ex h[2] = { e.subs(x == y), e.map(replace_x) };
+	for (int k = 0; k < 2; ++k) {
+		std::ostringstream os;
+		print_dag c(os);
+		h[k].print(c);
+		if (c.nodes > 10*depth) {
+			clog << "substitution in a shared expression gave " << c.nodes
+			     << " different objects" << endl;
+			++result;
+		}
+	}
+
+	return result;
+}
+
+static unsigned exam_memory_usage()
+{
+	unsigned result = 0;
+	symbol x("x");
+	const int depth = 40;
+
+	// The tree of e has about 2^depth nodes, its DAG about 3*depth.
+	ex e = x;
+	for (int i = 0; i < depth; ++i)
+		e = sin(e)*cos(e);
+
+	memory_statistics s = e.memory_usage();
+	if (s.total.nodes > 10*depth || s.classes["function"].nodes != 2*depth) {
+		clog << "memory use of a DAG of " << depth << " levels counted "
+		     << s.total.nodes << " objects, " << s.classes["function"].nodes
+		     << " functions" << endl;
+		++result;
+	}
+
+	std::size_t nodes = 0, bytes = 0;
+	for (std::map<std::string, memory_statistics::totals>::const_iterator i = s.classes.begin(); i != s.classes.end(); ++i) {
+		nodes += i->second.nodes;
+		bytes += i->second.bytes;
+	}
+	if (nodes != s.total.nodes || bytes != s.total.bytes || bytes < nodes*sizeof(basic)) {
+		clog << "memory use of " << s.total.nodes << " objects with "
+		     << s.total.bytes << " bytes is inconsistent" << endl;
+		++result;
+	}
+
+	// Objects shared with expressions counted before are not counted again
+	const memory_statistics::totals before = s.total;
+	s.add(e);
+	s.add(e.op(0));
+	if (s.total.nodes != before.nodes || s.total.bytes != before.bytes) {
+		clog << "adding shared expressions to " << before.nodes << " objects gave "
+		     << s.total.nodes << " objects" << endl;
+		++result;
+	}
+	s.add(pow(e, 2));
+	if (s.total.nodes <= before.nodes || s.total.nodes > before.nodes + 3) {
+		clog << "adding shared expressions to " << before.nodes << " objects gave "
+		     << s.total.nodes << " objects" << endl;
+		++result;
+	}
+
+	return result;
+}
+
+static unsigned exam_share_common_subexpressions()
+{
+	unsigned result = 0;
+	symbol x("x"), y("y");
+
+	// Build the same subexpressions independently, so that they are copies
+	ex e = 0;
+	e += sin(pow(x+1, 3));
+	e += cos(pow(x+1, 3));
+	e += exp(pow(x+1, 3) * y);
+	e += log(pow(x+1, 3) * y);
+	memory_statistics before = e.memory_usage();
+	if (before.classes["power"].nodes != 4) {
+		clog << "test expression " << e << " has " << before.classes["power"].nodes
+		     << " powers instead of 4 copies" << endl;
+		++result;
+	}
+
+	std::size_t saved = 0;
+	const ex r = share_common_subexpressions(e, &saved);
+	memory_statistics after = r.memory_usage();
+	if (!r.is_equal(e)) {
+		clog << "share_common_subexpressions(" << e << ") returned " << r << endl;
+		++result;
+	}
+	if (after.classes["power"].nodes != 1 || after.classes["mul"].nodes != 1) {
+		clog << "share_common_subexpressions(" << e << ") kept "
+		     << after.classes["power"].nodes << " powers and "
+		     << after.classes["mul"].nodes << " products" << endl;
+		++result;
+	}
+	if (saved == 0 || saved != before.total.bytes - after.total.bytes) {
+		clog << "share_common_subexpressions(" << e << ") reported " << saved
+		     << " bytes saved, but memory use went from " << before.total.bytes
+		     << " to " << after.total.bytes << " bytes" << endl;
+		++result;
+	}
+
+	// Nothing is left to share the second time
+	const ex r2 = share_common_subexpressions(r, &saved);
+	if (saved != 0 || !r2.is_equal(r)) {
+		clog << "sharing " << r << " again saved " << saved << " bytes" << endl;
+		++result;
+	}
+
+	return result;
+}
+
+static unsigned exam_eval_deferral()
+{
+	unsigned result = 0;
+	symbol x("x"), y("y");
+
+	ex e, p;
+	{
+		eval_deferral defer;
+		p = pow(x, 0);
+		{
+			eval_deferral nested;
+		}
+		for (int k = 0; k < 10; ++k)
+			e += sin(k*Pi) * pow(y, k) + pow(x, 2) - x*x;
+		e = e * p + y;
+	}
+	if (!is_a<power>(p)) {
+		clog << "pow(x, 0) was evaluated to " << p << " although evaluation was deferred" << endl;
+		++result;
+	}
+	if (!pow(x, 0).is_equal(1)) {
+		clog << "pow(x, 0) was not evaluated after the deferral ended" << endl;
+		++result;
+	}
+
+	ex expected;
+	for (int k = 0; k < 10; ++k)
+		expected += sin(k*Pi) * pow(y, k) + pow(x, 2) - x*x;
+	expected = expected * pow(x, 0) + y;
+	e = e.eval();
+	if (!e.is_equal(y) || !e.is_equal(expected)) {
+		clog << "tree built with deferred evaluation evaluated to " << e
+		     << " instead of " << expected << endl;
+		++result;
+	}
+
+	return result;
+}
+
+/** Print context registered only when this test runs, after the print
+ *  methods of other contexts have been looked up. */
+class print_angle : public print_dflt
+{
+	GINAC_DECLARE_PRINT_CONTEXT(print_angle, print_dflt)
+public:
+	print_angle(std::ostream & os) : print_dflt(os) {}
+};
+
+GINAC_IMPLEMENT_PRINT_CONTEXT(print_angle, print_dflt)
+
+print_angle::print_angle() : print_dflt(std::cout) {}
+
+static void print_symbol_angle(const symbol & s, const print_angle & c, unsigned level)
+{
+	c.s << '<' << s.get_name() << '>';
+}
+
+static unsigned exam_print_dispatch()
+{
+	unsigned result = 0;
+	symbol x("x");
+	const ex e = 2*x + sin(x);
+
+	std::ostringstream dflt, before, after;
+	e.print(print_dflt(dflt));
+	e.print(print_angle(before));
+	set_print_func<symbol, print_angle>(print_symbol_angle);
+	e.print(print_angle(after));
+
+	if (before.str() != dflt.str()) {
+		clog << e << " was printed as " << before.str()
+		     << " with a context inheriting the print methods" << endl;
+		++result;
+	}
+	if (after.str() != "sin(<x>)+2*<x>" && after.str() != "2*<x>+sin(<x>)") {
+		clog << e << " was printed as " << after.str()
+		     << " after changing the print method of symbols" << endl;
+		++result;
+	}
+
+	std::ostringstream again;
+	e.print(print_dflt(again));
+	if (again.str() != dflt.str()) {
+		clog << e << " was printed as " << again.str()
+		     << " after changing the print method of another context" << endl;
+		++result;
+	}
+
+	return result;
+}
+
+/** Large sums and products are sorted by the hash values of their terms
+ *  first, which must give the same order as sorting small ones. */
+static unsigned exam_canonical_order()
+{
+	unsigned result = 0;
+	const int n = 100;
+	symbol x("x"), y("y");
+
+	exvector terms, factors;
+	for (int i = n; i > 0; --i) {
+		terms.push_back(pow(x, i) * pow(y, i % 7));
+		factors.push_back(x + i);
+	}
+	const ex s = add(terms), p = mul(factors);
+	if (s.nops() != n || p.nops() != n) {
+		clog << "a sum and a product of " << n << " different terms have "
+		     << s.nops() << " and " << p.nops() << " operands" << endl;
+		++result;
+	}
+	for (int i = 1; i < n; ++i) {
+		if (s.op(i-1).compare(s.op(i)) >= 0 || p.op(i-1).compare(p.op(i)) >= 0) {
+			clog << "the terms of a large sum or product are not sorted" << endl;
+			++result;
+			break;
+		}
+	}
+
+	// Equal terms are still combined
+	terms.insert(terms.end(), terms.begin(), terms.begin() + n/2);
+	const ex s2 = add(terms);
+	if (s2.nops() != n || !(s2 - s - add(exvector(terms.begin(), terms.begin() + n/2))).is_zero()) {
+		clog << "a large sum with duplicate terms gave " << s2.nops() << " operands" << endl;
+		++result;
+	}
+
+	return result;
+}
+
+static unsigned remember_evaluations = 0;
+
+DECLARE_FUNCTION_1P(remember_cyclic)
+DECLARE_FUNCTION_1P(remember_lru)
+DECLARE_FUNCTION_1P(remember_lfu)
+
+static ex remember_cyclic_eval(const ex & x)
+{
+	++remember_evaluations;
+	return remember_cyclic(x).hold();
+}
+
+static ex remember_lru_eval(const ex & x)
+{
+	++remember_evaluations;
+	return remember_lru(x).hold();
+}
+
+static ex remember_lfu_eval(const ex & x)
+{
+	++remember_evaluations;
+	return remember_lfu(x).hold();
+}
+
+REGISTER_FUNCTION(remember_cyclic, eval_func(remember_cyclic_eval).
+                                   remember(1, 4, remember_strategies::delete_cyclic));
+REGISTER_FUNCTION(remember_lru, eval_func(remember_lru_eval).
+                                remember(1, 4, remember_strategies::delete_lru));
+REGISTER_FUNCTION(remember_lfu, eval_func(remember_lfu_eval).
+                                remember(1, 4, remember_strategies::delete_lfu));
+
+/** Evaluate f at the given arguments and return the number of evaluations
+ *  that were not found in the remember table. */
+static unsigned remember_misses(ex (*f)(const ex &), const char * args)
+{
+	remember_evaluations = 0;
+	for (const char * a = args; *a; ++a)
+		f(*a - '0');
+	return remember_evaluations;
+}
+
+static ex remember_cyclic_at(const ex & x) { return remember_cyclic(x); }
+static ex remember_lru_at(const ex & x) { return remember_lru(x); }
+static ex remember_lfu_at(const ex & x) { return remember_lfu(x); }
+
+static unsigned exam_remember_strategies()
+{
+	// remember tables with one slot of four entries
+	unsigned result = 0;
+
+	struct {
+		ex (*f)(const ex &);
+		const char * args;
+		unsigned misses;
+	} cases[] = {
+		// 5 replaces 1, then 1 replaces 2
+		{ remember_cyclic_at, "12341512", 7 },
+		// 5 replaces 2, the least recently used one
+		{ remember_lru_at, "12341512", 6 },
+		// 5 replaces 3, 3 replaces 4 (no hits, older than 5)
+		{ remember_lfu_at, "1234112534", 7 },
+	};
+	for (size_t i = 0; i < sizeof(cases) / sizeof(cases[0]); ++i) {
+		unsigned misses = remember_misses(cases[i].f, cases[i].args);
+		if (misses != cases[i].misses) {
+			clog << "evaluating " << cases[i].f(0) << " at " << cases[i].args << " missed the remember table "
+			     << misses << " times instead of " << cases[i].misses << endl;
+			++result;
+		}
+	}
+
+	return result;
+}
+
+static unsigned exam_remember_statistics()
+{
+	unsigned result = 0;
+	const unsigned serial = remember_cyclic_SERIAL::serial;
+
+	function::clear_remember(serial);
+	remember_table_statistics before = function::get_remember_statistics(serial);
+	remember_misses(remember_cyclic_at, "12341512");
+	remember_table_statistics after = function::get_remember_statistics(serial);
+	if (after.lookups - before.lookups != 8 || after.hits - before.hits != 1
+	 || after.evictions - before.evictions != 3 || after.entries != 4 || after.memory == 0) {
+		clog << "remember table statistics show " << after.lookups - before.lookups << " lookups, "
+		     << after.hits - before.hits << " hits, " << after.evictions - before.evictions
+		     << " evictions and " << after.entries << " entries instead of 8, 1, 3 and 4" << endl;
+		++result;
+	}
+
+	// Two entries per slot
+	function::set_remember(serial, 1, 2, remember_strategies::delete_cyclic);
+	if (function::get_remember_statistics(serial).entries != 0) {
+		clog << "resizing the remember table did not clear it" << endl;
+		++result;
+	}
+	unsigned misses = remember_misses(remember_cyclic_at, "12313");
+	if (misses != 4) {
+		clog << "remember table with two entries missed " << misses << " times instead of 4" << endl;
+		++result;
+	}
+
+	// Not remembering at all
+	function::set_remember(serial, 0);
+	before = function::get_remember_statistics(serial);
+	misses = remember_misses(remember_cyclic_at, "11");
+	after = function::get_remember_statistics(serial);
+	if (misses != 2 || after.lookups != before.lookups) {
+		clog << "switching the remember table off failed" << endl;
+		++result;
+	}
+
+	function::set_remember(serial, 1, 4, remember_strategies::delete_cyclic);
+	remember_misses(remember_cyclic_at, "1234");
+	const std::size_t used = function::get_remember_memory_used();
+	function::set_remember_memory_limit(used - 1);
+	if (function::get_remember_memory_used() >= used) {
+		clog << "memory limit of remember tables was not enforced" << endl;
+		++result;
+	}
+	remember_misses(remember_cyclic_at, "5678");
+	if (function::get_remember_memory_used() > used - 1) {
+		clog << "remember tables grew beyond their memory limit" << endl;
+		++result;
+	}
+	function::set_remember_memory_limit(0);
+
+	return result;
+}
+
+static unsigned remember_evalf_evaluations = 0;
+
+DECLARE_FUNCTION_1P(remember_evalf_test)
+
+static ex remember_evalf_test_evalf(const ex & x)
+{
+	++remember_evalf_evaluations;
+	if (is_exactly_a<numeric>(x))
+		return (ex_to<numeric>(x) / 3).evalf();
+	return remember_evalf_test(x).hold();
+}
+
+REGISTER_FUNCTION(remember_evalf_test, evalf_func(remember_evalf_test_evalf).
+                                       remember_evalf(16, 2, remember_strategies::delete_lru));
+
+static unsigned exam_remember_evalf()
+{
+	unsigned result = 0;
+	symbol x("x");
+
+	remember_evalf_evaluations = 0;
+	ex first = remember_evalf_test(2).evalf();
+	ex second = remember_evalf_test(2).evalf();
+	remember_evalf_test(x).evalf();
+	remember_evalf_test(x).evalf();
+	if (remember_evalf_evaluations != 3 || !first.is_equal(second)) {
+		clog << "evalf() of a function with remember_evalf() was evaluated "
+		     << remember_evalf_evaluations << " times instead of 3" << endl;
+		++result;
+	}
+
+	// Changing the precision forgets the results
+	const long digits = Digits;
+	Digits = digits + 10;
+	remember_evalf_evaluations = 0;
+	ex precise = remember_evalf_test(2).evalf();
+	Digits = digits;
+	ex again = remember_evalf_test(2).evalf();
+	if (remember_evalf_evaluations != 2 || precise.is_equal(again) || !again.is_equal(first)) {
+		clog << "remembered results of evalf() were used after Digits changed" << endl;
+		++result;
+	}
+
+	return result;
+}
+
+/* Numerical integrals of real integrands which can be compiled are computed
+ * in doubles with gauss_kronrod(), others fall back to adaptivesimpson(). */
+static unsigned exam_integral_evalf()
+{
+	unsigned result = 0;
+	symbol x("x");
+
+	const ex e = integral(x, 0, 1, exp(x)).evalf();
+	const ex d = gauss_kronrod(x, -2, 3, sin(x)*sin(x));
+	const ex d_exact = (numeric(5, 2) - (sin(ex(6)) + sin(ex(4)))/4).evalf();
+	if (!is_a<numeric>(e) || abs(ex_to<numeric>(e - (exp(ex(1)) - 1).evalf())) > 1e-8
+	 || abs(ex_to<numeric>(d - d_exact)) > 1e-8) {
+		clog << "numerical integration returned " << e << " and " << d
+		     << " instead of exp(1)-1 and " << d_exact << endl;
+		++result;
+	}
+
+	// Refining many intervals at once in several threads
+	const unsigned previous = set_integration_threads(4);
+	const ex osc = gauss_kronrod(x, 0, 100, cos(10*x)*exp(-x/10), 1e-12);
+	set_integration_threads(previous);
+	const ex osc_exact = ((numeric(1, 10) - exp(ex(-10))*(cos(ex(1000))/10 - 10*sin(ex(1000))))
+	                      / (numeric(1, 100) + 100)).evalf();
+	if (abs(ex_to<numeric>(osc - osc_exact)) > 1e-10) {
+		clog << "numerical integration with four threads returned " << osc
+		     << " instead of " << osc_exact << endl;
+		++result;
+	}
+
+	// Complex integrand
+	const ex c = integral(x, -2, -1, sqrt(x)).evalf();
+	const ex c_exact = (numeric(2, 3)*(2*sqrt(ex(2)) - 1)*I).evalf();
+	if (!is_a<numeric>(c) || abs(ex_to<numeric>(c - c_exact)) > 1e-6) {
+		clog << "numerical integration of sqrt(x) from -2 to -1 returned " << c << endl;
+		++result;
+	}
+
+	return result;
+}
+
+/* Tasks which submit tasks themselves, and an algorithm with more slices
+ * than workers. */
+struct sum_task {
+	int depth;
+	ex sum;
+};
+
+static void * run_sum_task(void * arg)
+{
+	sum_task & t = *static_cast<sum_task *>(arg);
+	if (t.depth == 0) {
+		t.sum = 1;
+		return 0;
+	}
+	vector<sum_task> sub(3);
+	for (size_t k = 0; k < sub.size(); ++k)
+		sub[k].depth = t.depth - 1;
+	run_tasks(run_sum_task, sub);
+	t.sum = 0;
+	for (size_t k = 0; k < sub.size(); ++k)
+		t.sum += sub[k].sum;
+	return 0;
+}
+
+static unsigned exam_tasks()
+{
+	unsigned result = 0;
+	const unsigned previous = get_task_threads();
+
+	const unsigned workers[] = { 2, 0 };
+	for (size_t i = 0; i < sizeof(workers) / sizeof(workers[0]); ++i) {
+		set_task_threads(workers[i]);
+		vector<sum_task> tasks(4);
+		for (size_t k = 0; k < tasks.size(); ++k)
+			tasks[k].depth = 3;
+		run_tasks(run_sum_task, tasks);
+		for (size_t k = 0; k < tasks.size(); ++k) {
+			if (!tasks[k].sum.is_equal(27)) {
+				clog << "nested tasks with " << workers[i] << " workers counted "
+				     << tasks[k].sum << " instead of 27" << endl;
+				++result;
+			}
+		}
+	}
+
+	symbol x("x"), y("y");
+	ex e = 0;
+	for (int k = 1; k <= 40; ++k)
+		e += (x + k) / (y - k) - sin(y + k * x) / (x - k);
+	const ex e1 = e.normal();
+	set_task_threads(1);
+	const unsigned previous_normal = set_normal_threads(8);
+	const ex e8 = e.normal();
+	set_normal_threads(previous_normal);
+	if (!normal(e1 - e8).is_zero()) {
+		clog << "normal() in 8 slices on 1 worker returned " << e8 << " instead of " << e1 << endl;
+		++result;
+	}
+
+	set_task_threads(previous);
+	return result;
+}
+
+/* Computations in the background, which report their progress and can be
+ * cancelled. */
+static void log_progress(const char * phase, const char *, long, const char *, long, void * data)
+{
+	static_cast<vector<string> *>(data)->push_back(phase);
+}
+
+static vector<pair<void (*)(void *), void *> > deferred_tasks;
+
+static void defer_task(void (*run)(void *), void * work)
+{
+	deferred_tasks.push_back(make_pair(run, work));
+}
+
+static void run_deferred_tasks()
+{
+	for (size_t k = 0; k < deferred_tasks.size(); ++k)
+		deferred_tasks[k].first(deferred_tasks[k].second);
+	deferred_tasks.clear();
+}
+
+static unsigned exam_async()
+{
+	unsigned result = 0;
+	symbol x("x"), y("y");
+	const ex a = expand((x + y + 1) * pow(x - y, 3));
+	const ex b = expand((x + y + 1) * (x + 2*y));
+
+	vector<string> phases;
+	const async_result g = async_gcd(a, b, log_progress, &phases);
+	const async_result f = async_factor(a);
+	const async_result s = async_series(1/sin(x), x == 0, 4);
+	if (!expand(g.get() - (x + y + 1)).is_zero()) {
+		clog << "async_gcd(" << a << ", " << b << ") returned " << g.get() << endl;
+		++result;
+	}
+	if (find(phases.begin(), phases.end(), string("gcd")) == phases.end()) {
+		clog << "async_gcd() didn't report the gcd phase" << endl;
+		++result;
+	}
+	if (!f.ready() || !f.get().is_equal(factor(a))) {
+		clog << "async_factor(" << a << ") returned " << f.get() << endl;
+		++result;
+	}
+	const ex s_exact = series(1/sin(x), x == 0, 4);
+	if (!series_to_poly(s.get()).is_equal(series_to_poly(s_exact))) {
+		clog << "async_series(1/sin(x)) returned " << s.get() << " instead of " << s_exact << endl;
+		++result;
+	}
+
+	// Errors are rethrown by get()
+	const async_result bad = async_gcd(x + sin(x), x);
+	try {
+		bad.get();
+		clog << "async_gcd() of a non-polynomial didn't throw" << endl;
+		++result;
+	} catch (const invalid_argument &) {
+	}
+
+	// Cancelled before a task ran, or by dropping the last handle
+	const task_executor previous = set_task_executor(defer_task);
+	const async_result c = async_gcd(a, b);
+	async_gcd(a, b);
+	set_task_executor(previous);
+	if (!deferred_tasks.empty()) {
+		c.cancel();
+		if (c.ready()) {
+			clog << "async_gcd() was done before its task ran" << endl;
+			++result;
+		}
+		run_deferred_tasks();
+		try {
+			c.get();
+			clog << "cancelled async_gcd() returned" << endl;
+			++result;
+		} catch (const computation_aborted & e) {
+			if (e.reason() != computation_aborted::cancelled) {
+				clog << "cancelled async_gcd() threw " << e.what() << endl;
+				++result;
+			}
+		}
+	}
+
+	return result;
+}
+
+/* parallel_map() gives the same result as map(), and passes the exceptions
+ * of the map function on. */
+struct throw_at_zero : public map_function {
+	ex operator()(const ex & e)
+	{
+		if (e.is_zero())
+			throw std::domain_error("zero");
+		return e + 1;
+	}
+};
+
+static ex normal_term(const ex & e)
+{
+	return e.normal();
+}
+
+static unsigned exam_parallel_map()
+{
+	unsigned result = 0;
+	symbol x("x"), y("y");
+
+	ex sum = 0;
+	for (int k = 1; k <= 200; ++k)
+		sum += pow(x + k, 2) / (x - y * k) + k * (1 + y) / (1 - y);
+	const ex expected = sum.map(normal_term);
+	const ex mapped = sum.parallel_map(normal_term);
+	if (!mapped.is_equal(expected)) {
+		clog << "parallel_map(normal) returned " << mapped << " instead of " << expected << endl;
+		++result;
+	}
+
+	lst l;
+	for (int k = 0; k < 50; ++k)
+		l.append(k);
+	throw_at_zero f;
+	try {
+		ex(l).parallel_map(f);
+		clog << "parallel_map() didn't pass on the exception of the map function" << endl;
+		++result;
+	} catch (const std::domain_error &) {
+	}
+	l.remove_first();
+	const ex shifted = ex(l).parallel_map(f);
+	if (!is_a<lst>(shifted) || shifted.nops() != 49 || !shifted.op(48).is_equal(50)) {
+		clog << "parallel_map() of a list returned " << shifted << endl;
+		++result;
+	}
+
+	return result;
+}
+
+/* A prepared integral is compiled once and then evaluated for many values
+ * of its parameters. */
+static unsigned exam_prepared_integral()
+{
+	unsigned result = 0;
+	symbol x("x"), s("s"), t("t");
+
+	prepared_integral laplace(x, 0, t, exp(-s*x), lst(s, t));
+	if (!laplace.is_compiled()) {
+		clog << "integral of exp(-s*x) from 0 to t was not compiled" << endl;
+		++result;
+	}
+	for (int i = 1; i <= 10; ++i) {
+		const numeric sv(i, 3), tv(11 - i);
+		const ex value = laplace.evaluate(lst(sv, tv));
+		const ex exact = ((1 - exp(-sv*tv))/sv).evalf();
+		if (!is_a<numeric>(value) || abs(ex_to<numeric>(value - exact)) > 1e-8) {
+			clog << "prepared integral of exp(-s*x) at s=" << sv << ", t=" << tv
+			     << " returned " << value << " instead of " << exact << endl;
+			++result;
+		}
+	}
+	const double args[2] = { 1, 2 };
+	if (std::fabs(laplace.evaluate(args) - (1 - std::exp(-2.0))) > 1e-8) {
+		clog << "prepared integral of exp(-x) from 0 to 2 returned " << laplace.evaluate(args) << endl;
+		++result;
+	}
+
+	// Integrands which can't be compiled are integrated with adaptivesimpson()
+	prepared_integral dilog(x, 0, 1, s*Li2(x), lst(s));
+	const ex value = dilog.evaluate(lst(2));
+	const ex exact = (2*(pow(Pi, 2)/6 - 1)).evalf();
+	if (dilog.is_compiled() || !is_a<numeric>(value) || abs(ex_to<numeric>(value - exact)) > 1e-6) {
+		clog << "prepared integral of 2*Li2(x) from 0 to 1 returned " << value << " instead of " << exact << endl;
+		++result;
+	}
+
+	return result;
+}
+
+/* The registry keeps the options of the functions in blocks of growing
+ * size.  Functions registered late must be found beyond the first block. */
+static unsigned exam_function_registry()
+{
+	unsigned result = 0;
+	symbol x("x");
+
+	const unsigned count = 300;
+	vector<unsigned> serials;
+	for (unsigned i = 0; i < count; ++i) {
+		ostringstream name;
+		name << "registry_test" << i;
+		serials.push_back(function::register_new(function_options(name.str(), 1)));
+	}
+	for (unsigned i = 0; i < count; ++i) {
+		ostringstream name;
+		name << "registry_test" << i;
+		ostringstream printed;
+		printed << function(serials[i], x);
+		if (function::find_function(name.str(), 1) != serials[i]
+		 || printed.str() != name.str() + "(x)") {
+			clog << "function " << name.str() << " was registered as " << printed.str() << endl;
+			++result;
+			break;
+		}
+	}
+	if (function::get_registered_functions().size() != serials.back() + 1) {
+		clog << "get_registered_functions() returned "
+		     << function::get_registered_functions().size() << " functions instead of "
+		     << serials.back() + 1 << endl;
+		++result;
+	}
+
+	return result;
+}
+
+DECLARE_FUNCTION_1P(lazy_test)
+
+static ex lazy_test_eval(const ex & x)
+{
+	if (x.is_zero())
+		return 1;
+	return lazy_test(x).hold();
+}
+
+REGISTER_LAZY_FUNCTION(lazy_test, eval_func(lazy_test_eval).
+                                  latex_name("\\lambda"));
+
+/* The options of functions registered with REGISTER_LAZY_FUNCTION are only
+ * built when they are needed, but the functions behave like the others. */
+static unsigned exam_lazy_functions()
+{
+	unsigned result = 0;
+	symbol x("x");
+
+	if (function::find_function("lazy_test", 1) != lazy_test_SERIAL::serial
+	 || function::find_function("Li2", 1) != Li2_SERIAL::serial) {
+		clog << "lazily registered functions were not found by name" << endl;
+		++result;
+	}
+
+	ostringstream latex;
+	latex << ::latex << lazy_test(x);
+	if (!ex(lazy_test(0)).is_equal(1) || latex.str() != "\\lambda(x)") {
+		clog << "lazy_test(0) = " << lazy_test(0) << " and lazy_test(x) printed as " << latex.str()
+		     << " instead of 1 and \\lambda(x)" << endl;
+		++result;
+	}
+
+	symtab table;
+	table["x"] = x;
+	parser reader(table);
+	const ex e = reader("lazy_test(x)+atanh(x)");
+	archive a;
+	a.archive_ex(e, "e");
+	if (!e.is_equal(lazy_test(x) + atanh(x)) || !a.unarchive_ex(lst(x), "e").is_equal(e)) {
+		clog << "parsing or unarchiving lazy_test(x)+atanh(x) gave " << e << endl;
+		++result;
+	}
+
+	return result;
+}
+
 unsigned exam_misc()
 {
 	unsigned result = 0;
@@ -307,11 +2562,62 @@ unsigned exam_misc()
 	result += exam_expand_subs();  cout << '.' << flush;
 	result += exam_expand_subs2();  cout << '.' << flush;
 	result += exam_expand_power(); cout << '.' << flush;
+	result += exam_expand_monomials(); cout << '.' << flush;
 	result += exam_sqrfree(); cout << '.' << flush;
 	result += exam_operator_semantics(); cout << '.' << flush;
 	result += exam_subs(); cout << '.' << flush;
 	result += exam_joris(); cout << '.' << flush;
 	result += exam_subs_algebraic(); cout << '.' << flush;
+	result += exam_pool_allocation(); cout << '.' << flush;
+	result += exam_hash_consing(); cout << '.' << flush;
+	result += exam_combine_many_terms(); cout << '.' << flush;
+	result += exam_expand_polynomial_product(); cout << '.' << flush;
+	result += exam_expand_threads(); cout << '.' << flush;
+	result += exam_polynomial_backend(); cout << '.' << flush;
+	result += exam_builders(); cout << '.' << flush;
+	result += exam_disk_add_builder(); cout << '.' << flush;
+	result += exam_expand_multinomial(); cout << '.' << flush;
+	result += exam_construct_from_epvector(); cout << '.' << flush;
+	result += exam_compile_ex_jit(); cout << '.' << flush;
+	result += exam_compile_ex_vec(); cout << '.' << flush;
+	result += exam_compile_ex_cache(); cout << '.' << flush;
+	result += exam_compile_ex_units(); cout << '.' << flush;
+	result += exam_compile_ex_complex(); cout << '.' << flush;
+	result += exam_compile_ex_jacobian(); cout << '.' << flush;
+	result += exam_bytecode_evaluator(); cout << '.' << flush;
+	result += exam_print_csrc_cse(); cout << '.' << flush;
+	result += exam_print_csrc_horner(); cout << '.' << flush;
+	result += exam_print_csrc_large(); cout << '.' << flush;
+	result += exam_profile(); cout << '.' << flush;
+	result += exam_trace(); cout << '.' << flush;
+	result += exam_budget(); cout << '.' << flush;
+	result += exam_lst_positions(); cout << '.' << flush;
+	result += exam_expand_truncated(); cout << '.' << flush;
+	result += exam_expand_modular(); cout << '.' << flush;
+	result += exam_print_deep(); cout << '.' << flush;
+	result += exam_print_dag(); cout << '.' << flush;
+	result += exam_subs_index(); cout << '.' << flush;
+	result += exam_subs_shared(); cout << '.' << flush;
+	result += exam_expand_shared(); cout << '.' << flush;
+	result += exam_symbol_mask(); cout << '.' << flush;
+	result += exam_pattern_net(); cout << '.' << flush;
+	result += exam_collect_coeffs(); cout << '.' << flush;
+	result += exam_deep_operations(); cout << '.' << flush;
+	result += exam_memory_usage(); cout << '.' << flush;
+	result += exam_share_common_subexpressions(); cout << '.' << flush;
+	result += exam_eval_deferral(); cout << '.' << flush;
+	result += exam_print_dispatch(); cout << '.' << flush;
+	result += exam_canonical_order(); cout << '.' << flush;
+	result += exam_remember_strategies(); cout << '.' << flush;
+	result += exam_remember_statistics(); cout << '.' << flush;
+	result += exam_remember_evalf(); cout << '.' << flush;
+	result += exam_function_registry(); cout << '.' << flush;
+	result += exam_lazy_functions(); cout << '.' << flush;
+	result += exam_integral_evalf(); cout << '.' << flush;
+	result += exam_prepared_integral(); cout << '.' << flush;
+	result += exam_tasks(); cout << '.' << flush;
+	result += exam_async(); cout << '.' << flush;
+	result += exam_parallel_map(); cout << '.' << flush;
 	
 	return result;
 }
@@ -21,6 +21,7 @@
  *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
  */
 
+#include <cln/numtheory.h>
 #include <cln/random.h>
 #include <iostream>
 #include <map>
@@ -29,6 +30,10 @@
 #include "polynomial/upoly.h"
 #include "polynomial/upoly_io.h"
 #include "polynomial/mod_gcd.h"
+#include "polynomial/gcd_euclid.h"
+#include "polynomial/half_gcd.h"
+#include "polynomial/sparse_interp.h"
+#include "polynomial/subproduct_tree.h"
 #include "ginac.h"
 using namespace GiNaC;
 
@@ -62,6 +67,245 @@ static void run_test_once(const std::size_t deg)
 	}
 }
 
+// gcd_euclid() must give the same result over Z/p with the word sized
+// arithmetic as with cln::cl_MI
+static void run_word_test_once(const std::size_t deg)
+{
+	static const cln::cl_I p = cln::nextprobprime(cln::cl_I(1) << 30);
+	static const cln::cl_modint_ring R = cln::find_modint_ring(p);
+	static const zp_word_ring W(cln::cl_I_to_long(p));
+
+	const upoly c = make_random_upoly(deg/2);
+	const upoly a = make_random_upoly(deg);
+	const upoly b = make_random_upoly(deg);
+	upoly ac, bc;
+	ac.assign(a.size() + c.size() - 1, 0);
+	bc.assign(b.size() + c.size() - 1, 0);
+	for (std::size_t i = 0; i < c.size(); ++i) {
+		for (std::size_t j = 0; j < a.size(); ++j)
+			ac[i + j] = ac[i + j] + c[i]*a[j];
+		for (std::size_t j = 0; j < b.size(); ++j)
+			bc[i + j] = bc[i + j] + c[i]*b[j];
+	}
+
+	umodpoly am(ac.size()), bm(bc.size()), gm;
+	make_umodpoly(am, ac, R);
+	make_umodpoly(bm, bc, R);
+	gcd_euclid(gm, am, bm);
+
+	uwordpoly aw(ac.size()), bw(bc.size()), gw;
+	for (std::size_t i = 0; i < ac.size(); ++i)
+		aw[i] = zp_word(W, ac[i]);
+	for (std::size_t i = 0; i < bc.size(); ++i)
+		bw[i] = zp_word(W, bc[i]);
+	canonicalize(aw);
+	canonicalize(bw);
+	gcd_euclid(gw, aw, bw);
+
+	bool same = (gm.size() == gw.size());
+	for (std::size_t i = 0; same && i < gm.size(); ++i)
+		same = (R->retract(gm[i]) == cln::cl_I(gw[i].retract()));
+	if (!same || gm.size() < c.size()) {
+		std::cerr << "a = " << am << std::endl;
+		std::cerr << "b = " << bm << std::endl;
+		std::cerr << "gcd_euclid(a, b) = " << gm << " with cln::cl_MI, "
+		          << gw << " with zp_word" << std::endl;
+		throw std::logic_error("bug in zp_word arithmetic");
+	}
+}
+
+// Classical Euclidean algorithm, to check half_gcd() against
+template<typename T> static void euclid_reference(T& c, T a, T b)
+{
+	T r;
+	while (!b.empty()) {
+		remainder_in_field(r, a, b);
+		a.swap(b);
+		b.swap(r);
+	}
+	normalize_in_field(a);
+	c.swap(a);
+}
+
+static zp_word to_field(const zp_word& sample, const cln::cl_I& x)
+{
+	return zp_word(*sample.ring(), x);
+}
+
+static cln::cl_MI to_field(const cln::cl_MI& sample, const cln::cl_I& x)
+{
+	return sample.ring()->canonhom(x);
+}
+
+// Polynomials of degree n over Z/p with a common factor of degree n/3
+template<typename T> static void
+make_hgcd_input(T& a, T& b, const std::size_t n, const typename T::value_type& sample)
+{
+	upoly c = make_random_upoly(n/3), u = make_random_upoly(n - n/3);
+	upoly v = make_random_upoly(n - n/3 - 1);
+	// make some of the quotients in the remainder sequence non-linear
+	for (std::size_t i = n/2; i < v.size(); i += 3)
+		v[i] = 0;
+	a.assign(n + 1, sample - sample);
+	b.assign(n, sample - sample);
+	for (std::size_t i = 0; i < c.size(); ++i) {
+		for (std::size_t j = 0; j < u.size(); ++j)
+			a[i + j] = a[i + j] + to_field(sample, c[i]*u[j]);
+		for (std::size_t j = 0; j < v.size(); ++j)
+			b[i + j] = b[i + j] + to_field(sample, c[i]*v[j]);
+	}
+	canonicalize(a);
+	canonicalize(b);
+}
+
+static void run_half_gcd_test()
+{
+	// word sized prime, zp_word arithmetic
+	const cln::cl_I p = cln::nextprobprime(cln::cl_I(1) << 30);
+	const zp_word_ring W(cln::cl_I_to_long(p));
+	uwordpoly aw, bw, gw, gw_check;
+	make_hgcd_input(aw, bw, 1500, zp_word(W, 1L));
+	half_gcd(gw, aw, bw);
+	euclid_reference(gw_check, aw, bw);
+	if (gw != gw_check || gw.size() < 500) {
+		std::cerr << "half_gcd(a, b) = " << gw << std::endl;
+		std::cerr << "euclid(a, b) = " << gw_check << std::endl;
+		throw std::logic_error("bug in half_gcd (zp_word)");
+	}
+
+	// large prime, cln::cl_MI arithmetic
+	const cln::cl_I q = cln::nextprobprime(cln::cl_I(1) << 40);
+	const cln::cl_modint_ring Rq = cln::find_modint_ring(q);
+	umodpoly a, b, g, g_check;
+	make_hgcd_input(a, b, 700, Rq->one());
+	half_gcd(g, a, b);
+	euclid_reference(g_check, a, b);
+	if (g != g_check || g.size() < 233) {
+		std::cerr << "half_gcd(a, b) = " << g << std::endl;
+		std::cerr << "euclid(a, b) = " << g_check << std::endl;
+		throw std::logic_error("bug in half_gcd (cl_MI)");
+	}
+}
+
+// Evaluation at n points through a subproduct tree must agree with Horner's
+// scheme, and interpolation must reproduce the values
+template<typename T> static void
+run_subproduct_tree_test_once(const std::size_t n, const typename T::value_type& sample)
+{
+	typedef typename T::value_type E;
+	const E zero = sample - sample;
+	T points, values, values_check;
+	for (std::size_t i = 0; i < n; ++i)
+		points.push_back(to_field(sample, cln::cl_I(i*7919 + 3)));
+	const subproduct_tree<E> tree(points, zero);
+
+	const upoly c = make_random_upoly(2*n + 5);
+	T f;
+	for (std::size_t i = 0; i < c.size(); ++i)
+		f.push_back(to_field(sample, c[i]));
+	tree.evaluate(f, values);
+	for (std::size_t i = 0; i < n; ++i) {
+		E s = zero;
+		for (std::size_t k = f.size(); k-- > 0; )
+			s = s*points[i] + f[k];
+		if (s != values[i]) {
+			std::cerr << "f = " << f << std::endl;
+			std::cerr << "f(" << points[i] << ") = " << s << ", not "
+			          << values[i] << std::endl;
+			throw std::logic_error("bug in subproduct_tree::evaluate");
+		}
+	}
+
+	const upoly v = make_random_upoly(n - 1);
+	values.clear();
+	for (std::size_t i = 0; i < n; ++i)
+		values.push_back(to_field(sample, v[i]));
+	tree.interpolate(values, f);
+	tree.evaluate(f, values_check);
+	if (f.size() != n || values != values_check) {
+		std::cerr << "values = " << values << std::endl;
+		std::cerr << "interpolated polynomial = " << f << std::endl;
+		throw std::logic_error("bug in subproduct_tree::interpolate");
+	}
+}
+
+static void run_subproduct_tree_test()
+{
+	const cln::cl_I p = cln::nextprobprime(cln::cl_I(1) << 30);
+	const zp_word_ring W(cln::cl_I_to_long(p));
+	const std::size_t sizes[] = { 1, 2, 5, 63, 64, 65, 300, 1000 };
+	for (std::size_t k = 0; k < sizeof(sizes)/sizeof(sizes[0]); ++k)
+		run_subproduct_tree_test_once<uwordpoly>(sizes[k], zp_word(W, 1L));
+
+	const cln::cl_I q = cln::nextprobprime(cln::cl_I(1) << 40);
+	const cln::cl_modint_ring Rq = cln::find_modint_ring(q);
+	run_subproduct_tree_test_once<umodpoly>(200, Rq->one());
+}
+
+// Black box of a polynomial with random terms in several variables
+class random_sparse_box : public zp_black_box {
+public:
+	random_sparse_box(const zp_word_ring& R_, std::size_t nvars, std::size_t nterms, unsigned maxdeg)
+	  : R(R_)
+	{
+		for (std::size_t j = 0; j < nterms; ++j) {
+			exponent_vector e(nvars);
+			for (std::size_t v = 0; v < nvars; ++v)
+				e[v] = cln::cl_I_to_uint(cln::random_I(maxdeg + 1));
+			const zp_word c(R, cln::random_I(cln::cl_I(R.modulus)));
+			term_map::iterator i = terms.find(e);
+			if (i == terms.end())
+				terms.insert(std::make_pair(e, c));
+			else
+				i->second = i->second + c;
+		}
+	}
+	zp_word value(const std::vector<zp_word>& point)
+	{
+		zp_word s(R, 0L);
+		for (term_map::const_iterator i = terms.begin(); i != terms.end(); ++i) {
+			zp_word t = i->second;
+			for (std::size_t v = 0; v < point.size(); ++v)
+				for (unsigned k = 0; k < i->first[v]; ++k)
+					t = t*point[v];
+			s = s + t;
+		}
+		return s;
+	}
+	typedef std::map<exponent_vector, zp_word> term_map;
+	term_map terms;
+private:
+	const zp_word_ring& R;
+};
+
+// Zippel's algorithm must find the terms of a sparse polynomial, and
+// the coefficients must be found again from its monomials
+static void run_sparse_interp_test()
+{
+	const cln::cl_I p = cln::nextprobprime(cln::cl_I(1) << 30);
+	const zp_word_ring W(cln::cl_I_to_long(p));
+	for (std::size_t nvars = 1; nvars <= 8; ++nvars) {
+		random_sparse_box f(W, nvars, 40, 10);
+		zp_sparse_poly g;
+		if (!zippel_interpolate(g, f, std::vector<unsigned>(nvars, 10), W, nvars))
+			throw std::logic_error("zippel_interpolate failed");
+		random_sparse_box::term_map found;
+		for (std::size_t j = 0; j < g.monomials.size(); ++j)
+			found[g.monomials[j]] = g.coeffs[j];
+		for (random_sparse_box::term_map::iterator i = f.terms.begin(); i != f.terms.end(); )
+			if (zerop(i->second))
+				f.terms.erase(i++);
+			else
+				++i;
+		if (found != f.terms)
+			throw std::logic_error("bug in zippel_interpolate");
+
+		std::vector<zp_word> c;
+		if (!skeleton_interpolate(c, f, g.monomials, W, 1) || c != g.coeffs)
+			throw std::logic_error("bug in skeleton_interpolate");
+	}
+}
+
 int main(int argc, char** argv)
 {
 	std::cout << "examining modular gcd. ";
@@ -75,6 +319,11 @@ int main(int argc, char** argv)
 		for (std::size_t k = 0; k < i->second; ++k)
 			run_test_once(i->first);
 	}
+	for (std::size_t k = 0; k < 32; ++k)
+		run_word_test_once(40);
+	run_half_gcd_test();
+	run_subproduct_tree_test();
+	run_sparse_interp_test();
 	return 0;
 }
 
@@ -167,6 +167,144 @@ static unsigned exam_normal4()
 	return result;
 }
 
+/* Remembered normal forms must give the same results as fresh ones. */
+static unsigned exam_normal_cache()
+{
+	unsigned result = 0;
+	const bool previous = set_normal_caching(true);
+	reset_normal_cache_statistics();
+
+	ex p = (x+1)/(y-1) + (y+1)/(x-1);
+	ex e = p * (z+w) / (pow(x,2) - 1);
+	ex d = e.normal();
+	result += check_normal(e, d);
+
+	// Only the new term should be normalized from scratch
+	ex e2 = e + 1/z;
+	ex d2 = e2.normal();
+	normal_cache_statistics stats = get_normal_cache_statistics();
+	if (stats.hits == 0 || stats.size == 0) {
+		clog << "normal form cache was not used: " << stats.lookups << " lookups, "
+		     << stats.hits << " hits, size " << stats.size << endl;
+		++result;
+	}
+
+	// Subexpressions with temporary symbols in their normal form (here for
+	// sin(x)) must not be remembered, the symbols differ from call to call
+	ex s = sin(x) + 1;
+	ex f1 = s / (x+1);
+	ex f2 = s * sin(x) / (sin(x) - 1);
+	ex n1 = f1.normal();
+	ex n2 = f2.normal();
+
+	set_normal_caching(false);
+	if (get_normal_cache_statistics().size != 0) {
+		clog << "normal form cache was not emptied when switched off" << endl;
+		++result;
+	}
+	result += check_normal(e2, d2);
+	result += check_normal(f1, n1);
+	result += check_normal(f2, n2);
+	set_normal_caching(previous);
+
+	return result;
+}
+
+/* Sums of many fractions, normalized by several threads if possible. */
+static unsigned exam_normal_threads()
+{
+	unsigned result = 0;
+	const unsigned previous = set_normal_threads(4);
+
+	// Telescoping sum, sin(x) occurs in all terms and has to be replaced
+	// by the same temporary symbol everywhere
+	const int n = 40;
+	ex t = sin(x);
+	ex e = 0;
+	for (int k=1; k<=n; k++)
+		e += 1/((t+k)*(t+k+1));
+	ex d = n/((t+1)*(t+n+1));
+	ex en = e.normal();
+	if (!is_exactly_a<numeric>(en.numer()) || !(en - d).normal().is_zero()) {
+		clog << "normal form of " << e << " erroneously returned "
+		     << en << " (should be " << d << ")" << endl;
+		++result;
+	}
+
+	e = 0;
+	for (int k=1; k<=n; k++)
+		e += (x+k)/(y-k) - (y+k*x)/(x-k);
+	ex e1 = e.normal();
+	set_normal_threads(1);
+	result += check_normal(e, e1);
+	set_normal_threads(previous);
+
+	return result;
+}
+
+/* Partial fractions of a: each term must be a polynomial in x divided by a
+ * power of a square-free factor, of lower degree than the factor, and the
+ * terms must add up to a. */
+static unsigned check_parfrac(const ex & a, int nterms)
+{
+	unsigned result = 0;
+	ex d = sqrfree_parfrac(a, x);
+	ex terms = is_exactly_a<add>(d) ? d : lst(d);
+	int fractions = 0;
+	for (size_t i=0; i<terms.nops(); ++i) {
+		ex nd = terms.op(i).numer_denom();
+		if (nd.op(1).degree(x) == 0)
+			continue;
+		++fractions;
+		ex base = is_exactly_a<power>(nd.op(1)) ? nd.op(1).op(0) : nd.op(1);
+		if (nd.op(0).degree(x) >= base.degree(x)) {
+			clog << "partial fraction " << terms.op(i) << " of " << a
+			     << " has a numerator of too large degree" << endl;
+			++result;
+		}
+	}
+	if (fractions != nterms) {
+		clog << "partial fraction decomposition of " << a << " erroneously returned "
+		     << d << " (" << fractions << " fractions instead of " << nterms << ")" << endl;
+		++result;
+	}
+	if (!(d - a).normal().is_zero()) {
+		clog << "partial fraction decomposition of " << a << " erroneously returned "
+		     << d << endl;
+		++result;
+	}
+	return result;
+}
+
+static unsigned exam_parfrac()
+{
+	unsigned result = 0;
+
+	result += check_parfrac((x+2)/((x-1)*(x+1)), 1);  // x^2-1 is square-free
+	result += check_parfrac(pow(x, 5)/(pow(x-1, 3)*(x+3)), 4);
+	result += check_parfrac((x*x+y)/(pow(x*x+1, 2)*(x*x-x+2)), 3);
+	result += check_parfrac(1/(2*pow(x-y, 2)*(3*x+z)), 3);
+
+	// Many factors of different multiplicity, with and without threads
+	ex den = 1;
+	for (int k=1; k<=3; ++k)
+		den *= pow(x*x + k*x + y, k);
+	ex a = (pow(x, 5) - z) / den;
+	const unsigned previous = set_normal_threads(4);
+	result += check_parfrac(a, 6);
+	ex d4 = sqrfree_parfrac(a, x);
+	set_normal_threads(1);
+	ex d1 = sqrfree_parfrac(a, x);
+	set_normal_threads(previous);
+	if (!(d4 - d1).normal().is_zero()) {
+		clog << "partial fraction decomposition of " << a << " with threads returned "
+		     << d4 << " instead of " << d1 << endl;
+		++result;
+	}
+
+	return result;
+}
+
 /* Test content(), integer_content(), primpart(). */
 static unsigned check_content(const ex & e, const ex & x, const ex & ic, const ex & c, const ex & pp)
 {
@@ -218,6 +356,119 @@ static unsigned exam_content()
 	return result;
 }
 
+/* collect_common_factors() pulls out the factors shared by all terms. */
+static unsigned exam_collect_common_factors()
+{
+	unsigned result = 0;
+	symbol a("a"), b("b");
+
+	ex e;
+	for (int k = 1; k <= 20; ++k)
+		e += pow(a, 2 + k % 3) * pow(x + y, 3) * sin(z) * pow(b, k) * (k + w);
+	const ex r = collect_common_factors(e);
+	const ex factors[] = { pow(a, 2), pow(x + y, 3), sin(z), b };
+	bool found = is_a<mul>(r);
+	for (size_t i = 0; found && i < sizeof(factors) / sizeof(factors[0]); ++i) {
+		found = false;
+		for (size_t j = 0; j < r.nops(); ++j)
+			if (r.op(j).is_equal(factors[i]))
+				found = true;
+	}
+	if (!found || !(r - e).expand().is_zero()) {
+		clog << "collect_common_factors(" << e << ") erroneously returned " << r << endl;
+		++result;
+	}
+
+	// Common factors which only a GCD finds
+	const ex f = 6*x*y*(x + 1) + 4*pow(x, 2)*z;
+	const ex g = collect_common_factors(f);
+	if (!(g - 2*x*(3*y*(x + 1) + 2*x*z)).expand().is_zero() || !is_a<mul>(g) || g.nops() != 3) {
+		clog << "collect_common_factors(" << f << ") erroneously returned " << g << endl;
+		++result;
+	}
+
+	return result;
+}
+
+static unsigned check_zero_test(const ex & e, bool zero)
+{
+	unsigned result = 0;
+	const unsigned options[] = { zero_test_options::modular, zero_test_options::rational_points };
+	for (unsigned i = 0; i < 2; ++i) {
+		if (zero_test(e, 1e-20, options[i]) != zero) {
+			clog << "zero_test(" << e << ", " << options[i] << ") erroneously returned "
+			     << !zero << endl;
+			++result;
+		}
+	}
+	return result;
+}
+
+static unsigned exam_temporary_symbols()
+{
+	unsigned result = 0;
+
+	// Temporary symbols are recycled, but behave like new ones
+	ex t1 = symbol::temporary(), t2 = symbol::temporary();
+	if (t1.is_equal(t2)) {
+		clog << "symbol::temporary() returned the same symbol twice" << endl;
+		++result;
+	}
+	const std::string name2 = ex_to<symbol>(t2).get_name();
+	t1 = t2 = 0;
+	symbol s;
+	ex t3 = symbol::temporary();
+	if (t3.compare(s) <= 0 || ex_to<symbol>(t3).get_name() == name2) {
+		clog << "recycled temporary symbol " << t3 << " is not new" << endl;
+		++result;
+	}
+
+	// normal() with replaced subexpressions doesn't depend on the recycling
+	const ex e = (sin(x) + 1) / (sin(x)*sin(x) - 1) + y / sqrt(x);
+	const ex n1 = normal(e), n2 = normal(e);
+	if (!n1.is_equal(n2) || !normal(n1 - (1/(sin(x) - 1) + y / sqrt(x))).is_zero()) {
+		clog << "normal(" << e << ") returned " << n1 << " and " << n2 << endl;
+		++result;
+	}
+
+	return result;
+}
+
+static unsigned exam_zero_test()
+{
+	unsigned result = 0;
+
+	// Rational functions
+	result += check_zero_test(pow(x + y, 5) - (x + y) * pow(x + y, 4), true);
+	result += check_zero_test(1/(x - y) + 1/(y - x), true);
+	result += check_zero_test((pow(x, 3) - pow(y, 3)) / (x - y) - x*x - x*y - y*y, true);
+	result += check_zero_test(1/(x - y) + 1/(y - x) + pow(x, 20) * z - z * pow(x, 20) + ex(1)/1000003, false);
+	result += check_zero_test(pow(x + y, 5) - pow(x, 5) - pow(y, 5), false);
+	result += check_zero_test(1/(x*x + 1) - 1/(x*x + 1 + pow(z, 40)), false);
+	result += check_zero_test(ex(1000003) * 1000033 * x, false);
+
+	// The imaginary unit and other atoms
+	result += check_zero_test((x + I) * (x - I) - x*x - 1, true);
+	result += check_zero_test((x + I) * (x + I) - x*x - 1, false);
+	result += check_zero_test(pow(sin(x) + 1, 2) - pow(sin(x), 2) - 2*sin(x) - 1, true);
+	result += check_zero_test(sqrt(x) * sqrt(x) * y - sqrt(x) * y * sqrt(x), true);
+	result += check_zero_test(sin(x) - sin(y), false);
+
+	// Large expression, whose normal() would be expensive
+	ex a, b = 1;
+	for (int i = 1; i <= 12; ++i) {
+		a += 1 / (x + i*y + z);
+		b *= x + i*y + z;
+	}
+	ex c = 0;
+	for (int i = 1; i <= 12; ++i)
+		c += (b / (x + i*y + z)).expand();
+	result += check_zero_test(a - c / b, true);
+	result += check_zero_test(a - c / b + pow(y, 12) / b, false);
+
+	return result;
+}
+
 unsigned exam_normalization()
 {
 	unsigned result = 0;
@@ -228,7 +479,13 @@ unsigned exam_normalization()
 	result += exam_normal2(); cout << '.' << flush;
 	result += exam_normal3(); cout << '.' << flush;
 	result += exam_normal4(); cout << '.' << flush;
+	result += exam_normal_cache(); cout << '.' << flush;
+	result += exam_normal_threads(); cout << '.' << flush;
+	result += exam_parfrac(); cout << '.' << flush;
 	result += exam_content(); cout << '.' << flush;
+	result += exam_collect_common_factors(); cout << '.' << flush;
+	result += exam_temporary_symbols(); cout << '.' << flush;
+	result += exam_zero_test(); cout << '.' << flush;
 	
 	return result;
 }
@@ -25,7 +25,9 @@
 using namespace GiNaC;
 
 #include <iostream>
+#include <limits>
 #include <sstream>
+#include <vector>
 using namespace std;
 
 /* Simple and maybe somewhat pointless consistency tests of assorted tests and
@@ -381,6 +383,137 @@ static unsigned exam_numeric6()
 	return result;
 }
 
+/* Sums and products of small integers are computed with machine integers.
+ * Check that this agrees with the general arithmetic at the boundary where
+ * the operands or the results no longer fit into a machine word. */
+static unsigned exam_numeric7()
+{
+	unsigned result = 0;
+
+	const numeric big = numeric(2).power(100);
+	const numeric half_word = numeric(2).power(std::numeric_limits<long>::digits/2);
+	const numeric values[] = {
+		numeric(0), numeric(1), numeric(-1), numeric(12345),
+		half_word - 1, -(half_word - 1), half_word, -half_word,
+		numeric(std::numeric_limits<long>::max()),
+		numeric(std::numeric_limits<long>::min())
+	};
+	const size_t n = sizeof(values)/sizeof(values[0]);
+	for (size_t i = 0; i < n; ++i) {
+		for (size_t j = 0; j < n; ++j) {
+			const numeric & a = values[i];
+			const numeric & b = values[j];
+			// Going through big forces the general code path.
+			if (!a.add(b).is_equal((a + big).add(b) - big) ||
+			    !a.sub(b).is_equal((a + big).sub(b) - big) ||
+			    !a.mul(b).is_equal((a * big).mul(b) / big)) {
+				clog << "arithmetic on " << a << " and " << b << " is inconsistent" << endl;
+				++result;
+			}
+			if (!(ex(a) + ex(b)).is_equal(a.add(b)) || !(ex(a) * ex(b)).is_equal(a.mul(b))) {
+				clog << "arithmetic on " << a << " and " << b << " inside ex is inconsistent" << endl;
+				++result;
+			}
+		}
+	}
+
+	return result;
+}
+
+/* Results of the arithmetic on the heap that are small integers or inverses
+ * of small integers are taken from a table of preallocated numbers, so the
+ * same result computed twice must be the same object. */
+static unsigned exam_numeric8()
+{
+	unsigned result = 0;
+
+	const ex results[][2] = {
+		{ numeric(600).add_dyn(numeric(400)), numeric(1001).sub_dyn(numeric(1)) },
+		{ numeric(-3).mul_dyn(numeric(333)), numeric(-1000).add_dyn(numeric(1)) },
+		{ numeric(3).div_dyn(numeric(-42)), numeric(-1, 2).mul_dyn(numeric(1, 7)) },
+		{ numeric(2).power_dyn(numeric(-4)), numeric(1, 4).mul_dyn(numeric(1, 4)) },
+		{ numeric(1, 3).add_dyn(numeric(2, 3)), 1 }
+	};
+	const ex values[] = { 1000, -999, numeric(-1, 14), numeric(1, 16), 1 };
+	for (size_t i = 0; i < sizeof(values)/sizeof(values[0]); ++i) {
+		if (!results[i][0].is_equal(values[i]) || !results[i][1].is_equal(values[i])) {
+			clog << "arithmetic on the heap returned " << results[i][0] << " and "
+			     << results[i][1] << " instead of " << values[i] << endl;
+			++result;
+		} else if (&ex_to<numeric>(results[i][0]) != &ex_to<numeric>(results[i][1])) {
+			clog << "arithmetic on the heap allocated a new object for " << values[i] << endl;
+			++result;
+		}
+	}
+
+	return result;
+}
+
+/* Decimal integers of any length are read correctly from strings. */
+static unsigned exam_numeric9()
+{
+	unsigned result = 0;
+
+	std::string digits;
+	numeric expected = 0;
+	for (int n = 1; n <= 200; ++n) {
+		const int d = (7*n) % 10;
+		digits += char('0' + d);
+		expected = expected*10 + d;
+		const numeric a(digits.c_str());
+		const numeric b(("-" + digits).c_str());
+		const numeric c(("+" + digits).c_str());
+		if (a != expected || b != -expected || c != expected || !a.is_integer()) {
+			clog << "numeric(\"" << digits << "\") erroneously returned "
+			     << a << ", " << b << " and " << c << endl;
+			++result;
+			break;
+		}
+	}
+	if (numeric("18446744073709551616") != numeric(2).power(64)) {
+		clog << "numeric(\"18446744073709551616\") erroneously returned "
+		     << numeric("18446744073709551616") << endl;
+		++result;
+	}
+
+	return result;
+}
+
+/* Bernoulli numbers satisfy their defining recurrence and, much further up,
+ * the theorem of von Staudt and Clausen: B_n plus the sum of 1/p over the
+ * primes p with p-1 dividing n is an integer for even n. */
+static unsigned exam_numeric10()
+{
+	unsigned result = 0;
+
+	std::vector<numeric> B;
+	for (int n = 0; n <= 40; ++n) {
+		numeric sum = 0;
+		for (int k = 0; k < n; ++k)
+			sum += binomial(numeric(n+1), numeric(k)) * B[k];
+		B.push_back(-sum / (n+1));
+		if (n > 0 && bernoulli(n) != B[n]) {
+			clog << "bernoulli(" << n << ") erroneously returned "
+			     << bernoulli(n) << " instead of " << B[n] << endl;
+			++result;
+		}
+	}
+
+	fill_bernoulli(400);
+	for (int n = 2; n <= 400; n += 2) {
+		numeric sum = bernoulli(n);
+		for (int p = 2; p <= n+1; ++p)
+			if (n % (p-1) == 0 && numeric(p).is_prime())
+				sum += numeric(1, p);
+		if (!sum.is_integer()) {
+			clog << "bernoulli(" << n << ") has the wrong denominator" << endl;
+			++result;
+		}
+	}
+
+	return result;
+}
+
 unsigned exam_numeric()
 {
 	unsigned result = 0;
@@ -393,6 +526,10 @@ unsigned exam_numeric()
 	result += exam_numeric4();  cout << '.' << flush;
 	result += exam_numeric5();  cout << '.' << flush;
 	result += exam_numeric6();  cout << '.' << flush;
+	result += exam_numeric7();  cout << '.' << flush;
+	result += exam_numeric8();  cout << '.' << flush;
+	result += exam_numeric9();  cout << '.' << flush;
+	result += exam_numeric10();  cout << '.' << flush;
 	
 	return result;
 }
@@ -230,6 +230,293 @@ static unsigned poly_gcd7()
 	return 0;
 }
 
+// Many variables of moderate degree, heur_gcd() is not even tried here
+static unsigned poly_gcd8()
+{
+	const int n = 6;
+	symbol v[n];
+	ex s1 = 1, s3 = 1, s2 = 0;
+	for (int i=0; i<n; i++) {
+		s1 += v[i];
+		s3 += pow(v[i], 3);
+		s2 += v[i] * v[(i+1)%n];
+	}
+	ex d = expand(pow(s1, 2));
+	ex f = expand(d * s3);
+	ex g = expand(d * (s2 + 1));
+	ex r = gcd(f, g);
+	if (!(r - d).expand().is_zero() && !(r + d).expand().is_zero()) {
+		clog << "gcd(" << f << "," << g << ") = " << r << " (should be " << d << ")" << endl;
+		return 1;
+	}
+	return 0;
+}
+
+// Exact division of multivariate polynomials
+static unsigned poly_divide()
+{
+	unsigned result = 0;
+	ex b = expand(pow(x + 2*y[0] - z, 3) * (pow(y[1], 2) - x*z + numeric(1, 3)));
+	ex c = expand(pow(x*y[0] + z, 2) - 5*y[1] + 7);
+	ex a = expand(b * c);
+	ex q;
+	if (!divide(a, b, q) || !(q - c).expand().is_zero()) {
+		clog << "divide(" << a << "," << b << ") failed or gave quotient "
+		     << q << " (should be " << c << ")" << endl;
+		++result;
+	}
+	reset_divisibility_check_statistics();
+	if (divide(a + x*pow(y[1], 3), b, q)) {
+		clog << "divide(" << a + x*pow(y[1], 3) << "," << b
+		     << ") found the quotient " << q << endl;
+		++result;
+	}
+	// This one should not even have been tried
+	divisibility_check_statistics stats = get_divisibility_check_statistics();
+	if (stats.rejected == 0) {
+		clog << "divide(" << a + x*pow(y[1], 3) << "," << b
+		     << ") was not rejected modulo a prime: " << stats.checks
+		     << " checks, " << stats.rejected << " rejected" << endl;
+		++result;
+	}
+	// b doesn't even have the right degrees
+	if (divide(c, b, q)) {
+		clog << "divide(" << c << "," << b << ") found the quotient " << q << endl;
+		++result;
+	}
+	return result;
+}
+
+// Division of univariate polynomials with rational coefficients, which is
+// done on vectors of integers, against the same division with a symbolic
+// coefficient substituted afterwards
+static unsigned poly_quo_rem()
+{
+	unsigned result = 0;
+	symbol c("c");
+	const ex a = numeric(3, 2)*pow(x, 7) - 2*pow(x, 5) + c*pow(x, 4) + 5*pow(x, 2) - c*x + numeric(1, 3);
+	const ex b = numeric(2, 3)*pow(x, 3) + c*pow(x, 2) - numeric(7, 4);
+	const ex cval = numeric(-5, 11);
+	const ex au = a.subs(c == cval), bu = b.subs(c == cval);
+
+	const ex q = quo(au, bu, x), r = rem(au, bu, x);
+	if (!(au - bu*q - r).expand().is_zero() || r.degree(x) >= bu.degree(x)) {
+		clog << "quo(" << au << "," << bu << ") = " << q << " and rem(...) = "
+		     << r << " don't satisfy a = b*q + r" << endl;
+		++result;
+	}
+	if (!(q - quo(a, b, x).subs(c == cval)).expand().is_zero()
+	 || !(r - rem(a, b, x).subs(c == cval)).expand().is_zero()) {
+		clog << "quo(" << au << "," << bu << ") = " << q << " and rem(...) = "
+		     << r << " differ from the symbolic computation" << endl;
+		++result;
+	}
+	const ex p = prem(au, bu, x), sp = sprem(au, bu, x);
+	if (!(p - prem(a, b, x).subs(c == cval)).expand().is_zero()
+	 || !(sp - sprem(a, b, x).subs(c == cval)).expand().is_zero()) {
+		clog << "prem(" << au << "," << bu << ") = " << p << " and sprem(...) = "
+		     << sp << " differ from the symbolic computation" << endl;
+		++result;
+	}
+	if (!rem(bu, au, x).is_equal(bu.expand()) || !quo(bu, au, x).is_zero()) {
+		clog << "division of " << bu << " by " << au << " of higher degree failed" << endl;
+		++result;
+	}
+	return result;
+}
+
+// Fingerprints are the same for all forms of a rational function
+static unsigned poly_fingerprint_forms()
+{
+	unsigned result = 0;
+	const ex factored = pow(x - y[0] + 2, 3) * (z + numeric(1, 3)) / pow(x + 1, 2);
+	const ex expanded = expand(numer(factored)) / expand(denom(factored));
+	const ex other = factored + numeric(1, 1000000);
+	poly_fingerprint f1, f2, f3;
+	if (!fingerprint(factored, f1) || !fingerprint(expanded, f2) || f1 != f2) {
+		clog << "fingerprints of " << factored << " and " << expanded << " differ" << endl;
+		++result;
+	}
+	if (!fingerprint(other, f3) || f3 == f1) {
+		clog << "fingerprints of " << factored << " and " << other << " are the same" << endl;
+		++result;
+	}
+	if (fingerprint(sin(x) + 1, f3) || fingerprint(pow(x, numeric(1, 2)), f3)) {
+		clog << "fingerprint of a function which is not rational" << endl;
+		++result;
+	}
+	return result;
+}
+
+// The resultant of two products of linear factors is the product of the
+// differences of their roots
+static unsigned poly_resultant()
+{
+	unsigned result = 0;
+	const ex r1[] = { y[0], -2*z, 3, y[1] + z };
+	const ex r2[] = { z, y[0] - 1, numeric(1, 2), -y[1], 2*y[0] + z };
+	for (int n1 = 1; n1 <= 4; ++n1) {
+		for (int n2 = 1; n2 <= 5; n2 += 2) {
+			ex a = 1, b = 1, ref = 1;
+			for (int i = 0; i < n1; ++i)
+				a *= x - r1[i];
+			for (int j = 0; j < n2; ++j) {
+				b *= 3 * (x - r2[j]);
+				for (int i = 0; i < n1; ++i)
+					ref *= 3 * (r1[i] - r2[j]);
+			}
+			// res(b, a) = (-1)^(n1*n2) res(a, b)
+			const ex res_ab = resultant(a, b, x), res_ba = resultant(b, a, x);
+			const ex ref_ba = (n1 * n2) % 2 ? -ref : ref;
+			if (!(res_ab - ref).expand().is_zero() || !(res_ba - ref_ba).expand().is_zero()) {
+				clog << "resultant(" << a << "," << b << ") = " << res_ab << ", "
+				     << res_ba << " the other way round (should be "
+				     << ref.expand() << ")" << endl;
+				++result;
+			}
+		}
+	}
+
+	// A common factor
+	const ex c = expand((x - y[0]*z) * (pow(x, 3) + y[1]));
+	const ex d = expand((x - y[0]*z) * (pow(x, 5) - z*x + 1));
+	if (!resultant(c, d, x).is_zero()) {
+		clog << "resultant(" << c << "," << d << ") = " << resultant(c, d, x)
+		     << " (should be 0)" << endl;
+		++result;
+	}
+
+	// Constants
+	if (!resultant(7, pow(x, 3) + 1, x).is_equal(343) || !resultant(5, 7, x).is_equal(1)) {
+		clog << "resultant() of a constant polynomial went wrong" << endl;
+		++result;
+	}
+	return result;
+}
+
+// The modular images may be computed concurrently, without changing the result
+static unsigned poly_gcd_threads()
+{
+	unsigned result = 0;
+	ex d = expand(pow(x - 2*y[0] + 3*z, 3) * (y[1]*z - 5));
+	ex f = expand(d * (pow(x, 4) - y[0]*z + 7));
+	ex g = expand(d * (y[1] - 11*x*z + pow(y[0], 2)));
+	const unsigned previous = set_gcd_threads(1);
+	ex r1 = gcd(f, g, 0, 0, false, gcd_options::no_heur_gcd);
+	set_gcd_threads(4);
+	if (get_gcd_threads() != 4) {
+		clog << "set_gcd_threads(4) was not honoured" << endl;
+		++result;
+	}
+	ex r4 = gcd(f, g, 0, 0, false, gcd_options::no_heur_gcd);
+	set_gcd_threads(previous);
+	if (!r1.is_equal(r4) || (!(r1 - d).expand().is_zero() && !(r1 + d).expand().is_zero())) {
+		clog << "gcd(" << f << "," << g << ") = " << r4 << " with 4 threads, "
+		     << r1 << " with one thread (should be " << d << ")" << endl;
+		++result;
+	}
+	return result;
+}
+
+// Cached GCDs and cofactors must agree with freshly computed ones
+static unsigned poly_gcd_cache()
+{
+	symbol y("y");
+	unsigned result = 0;
+	const std::size_t previous = set_gcd_cache_size(2);
+	reset_gcd_cache_statistics();
+
+	ex d = pow(x - y + 2, 2) * (z + 1);
+	ex f = expand(d * (x + pow(z, 3)));
+	ex g = expand(d * (y - x * z));
+	ex ca1, cb1, ca2, cb2;
+	ex r1 = gcd(f, g, &ca1, &cb1);
+	ex r2 = gcd(f, g, &ca2, &cb2);
+	if (!r1.is_equal(r2) || !ca1.is_equal(ca2) || !cb1.is_equal(cb2) ||
+	    !(r1 * ca1 - f).expand().is_zero() || !(r1 * cb1 - g).expand().is_zero()) {
+		clog << "cached gcd(" << f << "," << g << ") = " << r2 << " with cofactors "
+		     << ca2 << ", " << cb2 << " (should be " << r1 << ", " << ca1 << ", " << cb1 << ")" << endl;
+		++result;
+	}
+	gcd_cache_statistics stats = get_gcd_cache_statistics();
+	if (stats.hits == 0 || stats.size == 0) {
+		clog << "gcd cache was not used: " << stats.lookups << " lookups, "
+		     << stats.hits << " hits, size " << stats.size << endl;
+		++result;
+	}
+
+	// The cache must not grow beyond its limit
+	for (int j=1; j<=4; j++)
+		gcd(f, expand(d * (pow(x, j) - z)));
+	stats = get_gcd_cache_statistics();
+	if (stats.size > 2) {
+		clog << "gcd cache holds " << stats.size << " GCDs instead of at most 2" << endl;
+		++result;
+	}
+
+	// Other forms of the operands are found by their fingerprints
+	const ex f2 = d * (x + pow(z, 3)), g2 = expand(d) * (y - x * z);
+	const ex r3 = gcd(f, g);
+	reset_gcd_cache_statistics();
+	const ex r4 = gcd(f2, g2);
+	stats = get_gcd_cache_statistics();
+	if (stats.hits != 1 || !r3.is_equal(r4)) {
+		clog << "gcd cache did not find gcd(" << f2 << "," << g2 << "): "
+		     << stats.hits << " hits, result " << r4 << endl;
+		++result;
+	}
+
+	set_gcd_cache_size(previous);
+	if (get_gcd_cache_statistics().size != 0) {
+		clog << "gcd cache was not emptied when switched off" << endl;
+		++result;
+	}
+	return result;
+}
+
+// The GCD of several polynomials at once must agree with gcd() folded over them
+static unsigned poly_gcd_many()
+{
+	unsigned result = 0;
+	ex d = 6 * pow(x - 2*y[0] + 3, 2) * (y[1]*z - 5);
+	exvector p;
+	p.push_back(expand(d * (pow(x, 4) - y[0]*z + 7)));
+	p.push_back(0);
+	p.push_back(expand(4 * d * (y[1] - 11*x*z + pow(y[0], 2))));
+	p.push_back(expand(-d * (x + z)));
+	p.push_back(expand(10 * d * pow(x + z, 2) * y[1]));
+	ex folded = 0;
+	for (std::size_t i = 0; i < p.size(); ++i)
+		folded = gcd(folded, p[i]);
+	ex r = gcd(p);
+	if ((r - d).expand() != 0 || (!(r - folded).expand().is_zero() && !(r + folded).expand().is_zero())) {
+		clog << "gcd of several polynomials is " << r << " (should be " << d << ")" << endl;
+		++result;
+	}
+
+	// A coprime pair makes the GCD the integer content
+	p.push_back(expand(12 * pow(x, 3) - 18));
+	p.push_back(expand(12 * pow(y[0], 3) + 6));
+	r = gcd(p);
+	if (r != 6) {
+		clog << "gcd of polynomials with a coprime pair is " << r << " (should be 6)" << endl;
+		++result;
+	}
+
+	// Polynomials with rational coefficients are folded
+	exvector q;
+	q.push_back(expand((x + z) * (x - 1) / 2));
+	q.push_back(expand((x + z) * (y[0] + 3) / 3));
+	r = gcd(q);
+	const ex g = gcd(q[0], q[1]);
+	if ((!(r - g).expand().is_zero() && !(r + g).expand().is_zero()) || !gcd(exvector()).is_zero()) {
+		clog << "gcd(" << q[0] << "," << q[1] << ") = " << r
+		     << " (should be " << g << ")" << endl;
+		++result;
+	}
+	return result;
+}
+
 unsigned exam_polygcd()
 {
 	unsigned result = 0;
@@ -245,6 +532,14 @@ unsigned exam_polygcd()
 	result += poly_gcd5p();  cout << '.' << flush;
 	result += poly_gcd6();  cout << '.' << flush;
 	result += poly_gcd7();  cout << '.' << flush;
+	result += poly_gcd8();  cout << '.' << flush;
+	result += poly_divide();  cout << '.' << flush;
+	result += poly_quo_rem();  cout << '.' << flush;
+	result += poly_fingerprint_forms();  cout << '.' << flush;
+	result += poly_resultant();  cout << '.' << flush;
+	result += poly_gcd_threads();  cout << '.' << flush;
+	result += poly_gcd_cache();  cout << '.' << flush;
+	result += poly_gcd_many();  cout << '.' << flush;
 	
 	return result;
 }
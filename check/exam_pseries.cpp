@@ -141,6 +141,12 @@ static unsigned exam_series1()
 	d = pow(a, b) + (pow(a, b)*b/a)*x + (pow(a, b)*b*b/a/a/2 - pow(a, b)*b/a/a/2)*pow(x, 2) + Order(pow(x, 3));
 	result += check_series(e, 0, d, 3);
 
+	// The expansion of psi(1,x) found while looking for its pole is cut
+	// down to the order needed in the product
+	e = psi(1, x) * pow(x, 3);
+	d = x + Order(pow(x, 2));
+	result += check_series(e, 0, d, 2);
+
 	return result;
 }
 
@@ -386,6 +392,215 @@ static unsigned exam_series14()
 	return result;
 }
 
+// Test products and powers of long dense and sparse series.
+static unsigned exam_series15()
+{
+	symbol a("a"), b("b");
+	unsigned result = 0;
+	const int order = 30;
+
+	// dense: 1/(1-a*x)/(1-b*x) has the coefficients (a^(k+1)-b^(k+1))/(a-b)
+	const pseries sa = ex_to<pseries>(pow(1-a*x, -1).series(x==0, order));
+	const pseries sb = ex_to<pseries>(pow(1-b*x, -1).series(x==0, order));
+	ex e = sa.mul_series(sb);
+	ex d = Order(pow(x, order));
+	for (int k=0; k<order; ++k)
+		d += (pow(a, k+1) - pow(b, k+1)).expand() / (a-b) * pow(x, k);
+	ex ep = ex_to<pseries>(e).convert_to_poly();
+	if (!(ep - d).normal().is_zero()) {
+		clog << "product of " << sa << " and " << sb
+		     << " erroneously returned " << e << endl;
+		++result;
+	}
+
+	// dense: 1/(1-a*x)^3 has the coefficients (k+1)*(k+2)/2*a^k
+	e = sa.power_const(3, order);
+	d = Order(pow(x, order));
+	for (int k=0; k<order; ++k)
+		d += numeric((k+1)*(k+2), 2) * pow(a, k) * pow(x, k);
+	ep = ex_to<pseries>(e).convert_to_poly();
+	if (!(ep - d).expand().is_zero()) {
+		clog << "third power of " << sa << " erroneously returned " << e << endl;
+		++result;
+	}
+
+	// sparse: 1/(1-x^5)/(1-x^7) counts the solutions of 5*i+7*j == k
+	const pseries s5 = ex_to<pseries>(pow(1-pow(x, 5), -1).series(x==0, order));
+	const pseries s7 = ex_to<pseries>(pow(1-pow(x, 7), -1).series(x==0, order));
+	e = s5.mul_series(s7);
+	d = Order(pow(x, order));
+	for (int k=0; k<order; ++k)
+		for (int i=0; 5*i<=k; ++i)
+			if ((k - 5*i) % 7 == 0)
+				d += pow(x, k);
+	ep = ex_to<pseries>(e).convert_to_poly();
+	if (!(ep - d).expand().is_zero()) {
+		clog << "product of " << s5 << " and " << s7
+		     << " erroneously returned " << e << endl;
+		++result;
+	}
+
+	return result;
+}
+
+// Test elementary functions of series, expanded by recurrences.
+static unsigned exam_series16()
+{
+	using GiNaC::log;
+
+	symbol a("a");
+	unsigned result = 0;
+	ex e, d;
+
+	e = exp(sin(x));
+	d = 1 + x + pow(x, 2) / 2 - pow(x, 4) / 8 - pow(x, 5) / 15 - pow(x, 6) / 240 + pow(x, 7) / 90 + Order(pow(x, 8));
+	result += check_series(e, 0, d);
+
+	e = exp(a*x);
+	d = Order(pow(x, 8));
+	for (int k=0; k<8; ++k)
+		d += pow(a, k) * pow(x, k) / factorial(k);
+	result += check_series(e, 0, d);
+
+	e = log(pow(1 - x, -1));
+	d = Order(pow(x, 8));
+	for (int k=1; k<8; ++k)
+		d += pow(x, k) / k;
+	result += check_series(e, 0, d);
+
+	e = log(x);
+	d = log(2) + (x-2) / 2 - pow(x-2, 2) / 8 + pow(x-2, 3) / 24 + Order(pow(x-2, 4));
+	result += check_series(e, 2, d, 4);
+
+	// sin and cos against their exponential form
+	const ex arg = x + a*pow(x, 2);
+	e = sin(arg);
+	d = ex_to<pseries>(((exp(I*arg) - exp(-I*arg)) / (2*I)).series(x==0, 8)).convert_to_poly();
+	result += check_series(e, 0, d);
+	e = cos(arg);
+	d = ex_to<pseries>(((exp(I*arg) + exp(-I*arg)) / 2).series(x==0, 8)).convert_to_poly();
+	result += check_series(e, 0, d);
+
+	e = sinh(x);
+	d = x + pow(x, 3) / 6 + pow(x, 5) / 120 + pow(x, 7) / 5040 + Order(pow(x, 8));
+	result += check_series(e, 0, d);
+
+	e = cosh(2*x);
+	d = 1 + 2*pow(x, 2) + 2*pow(x, 4) / 3 + 4*pow(x, 6) / 45 + Order(pow(x, 8));
+	result += check_series(e, 0, d);
+
+	e = atan(x);
+	d = x - pow(x, 3) / 3 + pow(x, 5) / 5 - pow(x, 7) / 7 + Order(pow(x, 8));
+	result += check_series(e, 0, d);
+
+	e = atan(x);
+	d = Pi / 4 + (x-1) / 2 - pow(x-1, 2) / 4 + pow(x-1, 3) / 12 + Order(pow(x-1, 4));
+	result += check_series(e, 1, d, 4);
+
+	return result;
+}
+
+// Test series of nested functions, expanded by composition.
+static unsigned exam_series17()
+{
+	unsigned result = 0;
+	ex e, d;
+
+	e = sin(sin(x));
+	d = x - pow(x, 3) / 3 + pow(x, 5) / 10 - 8 * pow(x, 7) / 315 + Order(pow(x, 8));
+	result += check_series(e, 0, d);
+
+	e = cos(pow(x, 2));
+	d = 1 - pow(x, 4) / 2 + Order(pow(x, 8));
+	result += check_series(e, 0, d);
+
+	// asin has no series function of its own
+	e = asin(sin(x));
+	d = x + Order(pow(x, 8));
+	result += check_series(e, 0, d);
+
+	e = sin(x + pow(x, 2));
+	d = sin(2) + cos(2) * 3 * (x-1) + (cos(2) - sin(2) * 9 / 2) * pow(x-1, 2) + Order(pow(x-1, 3));
+	result += check_series(e, 1, d, 3);
+
+	return result;
+}
+
+// Test series of large sums, expanded by several threads if possible.
+static unsigned exam_series18()
+{
+	symbol a("a");
+	unsigned result = 0;
+	const unsigned previous = set_series_threads(4);
+
+	// sum of the geometric series 1/(1-k*a*x), k=1..40
+	const int n = 40;
+	ex e = 0;
+	for (int k=1; k<=n; ++k)
+		e += pow(1 - k*a*x, -1);
+	ex d = Order(pow(x, 8));
+	for (int j=0; j<8; ++j) {
+		numeric powersum = 0;
+		for (int k=1; k<=n; ++k)
+			powersum += pow(numeric(k), numeric(j));
+		d += powersum * pow(a, j) * pow(x, j);
+	}
+	result += check_series(e, 0, d);
+
+	set_series_threads(previous);
+	return result;
+}
+
+/* Series in two variables by mseries, truncated at a total degree or
+ * separately, against scaled and nested univariate series. */
+static unsigned exam_series19()
+{
+	symbol y("y"), s("s"), a("a");
+	unsigned result = 0;
+
+	// Total degree: the terms of degree below 5 of f(x,y) are those of
+	// f(s*x,s*y) below s^5
+	ex e = exp(x + a*y) * sqrt(1 + x*y) / (1 - x) + log(1 + x - y);
+	ex m = mseries(e, lst(x, y), 5).to_ex();
+	ex d = series_to_poly(e.subs(lst(x == s*x, y == s*y)).series(s == 0, 5)).subs(s == 1);
+	if (!(m - d).expand().is_zero()) {
+		clog << "mseries of " << e << " to total degree 5 erroneously returned "
+		     << m << " (instead of " << d << ")" << endl;
+		++result;
+	}
+
+	// Orders for each variable, with a pole
+	std::vector<int> orders;
+	orders.push_back(3);
+	orders.push_back(2);
+	e = (1 + y) * cos(y) / (x * (1 - x - y));
+	m = mseries(e, lst(x, y), orders).to_ex();
+	d = series_to_poly(series_to_poly(e.series(x == 0, 3)).series(y == 0, 2));
+	if (!(m - d).expand().is_zero()) {
+		clog << "mseries of " << e << " to orders 3 and 2 erroneously returned "
+		     << m << " (instead of " << d << ")" << endl;
+		++result;
+	}
+
+	// Arithmetic
+	mseries p = mseries(pow(1 - x, -1), lst(x, y), 6);
+	mseries q = mseries(1 + x + y, lst(x, y), 6);
+	m = (p * q - q).to_ex();
+	d = mseries((1 + x + y) * x / (1 - x), lst(x, y), 6).to_ex();
+	if (!(m - d).expand().is_zero()) {
+		clog << "product of mseries erroneously returned " << m
+		     << " (instead of " << d << ")" << endl;
+		++result;
+	}
+	if (q.power_const(2).nterms() != 6 || !q.power_const(2).is_exact()) {
+		clog << "square of mseries " << q.to_ex() << " erroneously returned "
+		     << q.power_const(2).to_ex() << endl;
+		++result;
+	}
+
+	return result;
+}
+
 unsigned exam_pseries()
 {
 	unsigned result = 0;
@@ -406,6 +621,11 @@ unsigned exam_pseries()
 	result += exam_series12();  cout << '.' << flush;
 	result += exam_series13();  cout << '.' << flush;
 	result += exam_series14();  cout << '.' << flush;
+	result += exam_series15();  cout << '.' << flush;
+	result += exam_series16();  cout << '.' << flush;
+	result += exam_series17();  cout << '.' << flush;
+	result += exam_series18();  cout << '.' << flush;
+	result += exam_series19();  cout << '.' << flush;
 	
 	return result;
 }
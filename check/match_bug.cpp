@@ -114,6 +114,24 @@ static void expairseq_match_false_negative(int count)
 	}
 }
 
+/*
+ * sin(x) + sin(y) used to fail to match sin($0) + sin(x) when sin($0)
+ * happened to be tried first and took sin(x). Terms of the pattern without
+ * wildcards are now matched first.
+ */
+static void expairseq_match_equal_terms_first()
+{
+	symbol x("x"), y("y");
+	ex e = sin(x) + sin(y);
+	ex patterns[2] = { sin(wild(0)) + sin(x), sin(x) + sin(wild(0)) };
+	for (int i = 0; i < 2; ++i) {
+		exmap repls;
+		bool match_p = e.match(patterns[i], repls);
+		cbug_on(!match_p || !repls[wild(0)].is_equal(y),
+			"false negative: " << e << " did not match " << patterns[i]);
+	}
+}
+
 int main(int argc, char** argv)
 {
 	const int repetitions = 100;
@@ -122,6 +140,7 @@ int main(int argc, char** argv)
 	match_false_negative();
 	expairseq_failed_match_no_side_effect(repetitions);
 	expairseq_match_false_negative(repetitions);
+	expairseq_match_equal_terms_first();
 	std::cout << "not found. ";
 	return 0;
 }
@@ -53,6 +53,37 @@ struct archive_unarchive_check
 	}
 };
 
+// Numbers are only decoded from their archived form after a round trip
+// through a stream
+struct stream_archive_check
+{
+	cl_N operator()(const cl_N& n) const
+	{
+		ex e = numeric(n);
+		archive ar;
+		ar.archive_ex(e, "test");
+		std::stringstream buf;
+		buf << ar;
+		archive ar2;
+		buf >> ar2;
+		lst l;
+		ex check = ar2.unarchive_ex(l, "test");
+		if (!check.is_equal(e) || float_digits_of(check) != float_digits_of(e)) {
+			std::ostringstream s;
+			s << __FILE__ << ':' << __LINE__ << ": expected: " << e << ", got " << check;
+			throw std::logic_error(s.str());
+		}
+		return n;
+	}
+
+	static uintC float_digits_of(const ex& e)
+	{
+		const cl_N z = ex_to<numeric>(e).to_cl_N();
+		const cl_R re = realpart(z);
+		return instanceof(re, cl_F_ring) ? float_digits(the<cl_F>(re)) : 0;
+	}
+};
+
 int main(int argc, char** argv)
 {
 	const cl_I one(1);
@@ -64,5 +95,17 @@ int main(int argc, char** argv)
 	numbers.push_back(complex(three_fp, three_fp));
 	numbers.push_back(complex(one, one));
 	std::for_each(numbers.begin(), numbers.end(), archive_unarchive_check());
+
+	std::cout << "checking if archived numbers survive a round trip through a stream" << std::endl;
+	const cl_I big = expt_pos(cl_I(3), 2000) + 1;
+	numbers.push_back(cl_I(0));
+	numbers.push_back(-big);
+	numbers.push_back(big / expt_pos(cl_I(7), 333));
+	numbers.push_back(cl_float(0, default_float_format));
+	numbers.push_back(cl_float(-big, float_format(200)));
+	numbers.push_back(scale_float(cl_float(one, float_format(40)), -100000));
+	numbers.push_back(cl_float(-2.5, float_format_ffloat));
+	numbers.push_back(complex(big / 3, cl_float(-big, float_format(60))));
+	std::for_each(numbers.begin(), numbers.end(), stream_archive_check());
 	return 0;
 }
@@ -27,6 +27,7 @@ using namespace GiNaC;
 #include <sstream>
 #include <stdexcept>
 #include <string>
+#include <vector>
 
 // - a - b was misparsed as -a + b due to a bug in parser::parse_unary_expr()
 static int check1(std::ostream& err_str)
@@ -96,6 +97,229 @@ static int check4(std::ostream& err_str)
 	}
 }
 
+/// parse_polynomial() must agree with the general parser, also on input
+/// which it hands over to the latter.
+static int check5(std::ostream& err_str)
+{
+	const char* inputs[] = {
+		"1 + 2*x^2*y - 3*y*x^2 + x*x - 5/3*z^-2 - 123456789012345678901*y^0",
+		" -x*2 + x*y*z/4 + 0 - x^3*y^(-1)",
+		"+x - x",
+		"x*x^-1",
+		"2*sin(x) + y",
+		"x^2 + 1.5*y",
+		"Pi*x + I",
+		0
+	};
+	int errors = 0;
+	for (const char** s = inputs; *s; ++s) {
+		parser reader;
+		ex e = reader(*s);
+		ex f = reader.parse_polynomial(*s);
+		if (!e.is_equal(f)) {
+			err_str << "parse_polynomial(\"" << *s << "\") returned " << f
+			        << " instead of " << e << std::endl;
+			++errors;
+		}
+	}
+	const std::string junk("x^2()+1");
+	parser reader;
+	try {
+		reader.parse_polynomial(junk);
+		err_str << "parse_polynomial() accepts junk: \"" << junk << "\"" << std::endl;
+		++errors;
+	} catch (parse_error& err) {
+	}
+	return errors;
+}
+
+/// Parsing large sums with several threads must give the same result.
+static int check6(std::ostream& err_str)
+{
+	std::ostringstream s;
+	s << "1";
+	for (int i = 1; i < 2000; ++i) {
+		s << (i % 3 ? " + " : " - ") << i << "*x^" << i % 7 << "*y";
+		if (i % 5 == 0)
+			s << " - sin(x - " << i << "*y) * (a" << i % 4 << " + 1.5e-3)";
+	}
+	const std::string input = s.str();
+
+	symtab table;
+	const char* names[] = { "x", "y", "a0", "a1", "a2", "a3", 0 };
+	for (const char** n = names; *n; ++n)
+		table[*n] = symbol(*n);
+
+	parser serial_reader(table);
+	ex e = serial_reader(input);
+
+	const unsigned previous = set_parser_threads(4);
+	parser reader(table);
+	ex f = reader(input);
+	ex g = reader.parse_polynomial(input);
+	// Symbols unknown to the parser must be created only once
+	parser new_symbols_reader;
+	ex h = new_symbols_reader(input);
+	set_parser_threads(previous);
+
+	int errors = 0;
+	if (!(e - f).expand().is_zero() || !(e - g).expand().is_zero()) {
+		err_str << "parsing a large sum with several threads went wrong" << std::endl;
+		++errors;
+	}
+	symtab new_symbols = new_symbols_reader.get_syms();
+	lst renaming;
+	for (symtab::const_iterator i = new_symbols.begin(); i != new_symbols.end(); ++i)
+		renaming.append(i->second == table[i->first]);
+	if (new_symbols.size() != table.size() || !(e - h.subs(renaming)).expand().is_zero()) {
+		err_str << "parsing a large sum with several threads created the symbols";
+		for (symtab::const_iterator i = new_symbols.begin(); i != new_symbols.end(); ++i)
+			err_str << ' ' << i->first;
+		err_str << std::endl;
+		++errors;
+	}
+	return errors;
+}
+
+// Parsing from a buffer must give the same result as parsing from a stream,
+// also when the cache of symbols has to grow.
+static int check7(std::ostream& err_str)
+{
+	std::ostringstream s;
+	for (int i = 0; i < 200; ++i)
+		s << "+x" << i << "^2*Pi - 3.5e1*sin(x" << i << ")/y # comment\n";
+	const std::string input = s.str();
+
+	parser reader;
+	ex e = reader(input.data(), input.data() + input.size());
+	std::istringstream stream(input);
+	ex f = reader(stream);
+
+	int errors = 0;
+	if (reader.get_syms().size() != 201 || !(e - f).expand().is_zero()) {
+		err_str << "parsing from a buffer and from a stream differ" << std::endl;
+		++errors;
+	}
+	return errors;
+}
+
+// Sums with differences and products with quotients are read into a single
+// add or mul.
+static int check8(std::ostream& err_str)
+{
+	std::vector<std::string> names;
+	for (int i = 0; i < 1000; ++i) {
+		std::ostringstream name;
+		name << "x" << i;
+		names.push_back(name.str());
+	}
+	std::string sum_input = names[0], product_input = names[0];
+	for (int i = 1; i < 1000; ++i) {
+		sum_input += (i % 3 ? " - " : " + ") + names[i];
+		product_input += (i % 3 ? " / " : " * ") + names[i];
+	}
+	parser reader;
+	ex sum = reader(sum_input);
+	ex product = reader(product_input);
+	symtab syms = reader.get_syms();
+	ex expected_sum = 0, expected_product = 1;
+	for (int i = 0; i < 1000; ++i) {
+		ex x = syms[names[i]];
+		expected_sum += (i % 3 ? -x : x);
+		expected_product *= (i % 3 ? pow(x, -1) : x);
+	}
+
+	int errors = 0;
+	if (!is_a<add>(sum) || sum.nops() != 1000 || !sum.is_equal(expected_sum)) {
+		err_str << "parsing a sum with differences went wrong" << std::endl;
+		++errors;
+	}
+	if (!is_a<mul>(product) || product.nops() != 1000 || !product.is_equal(expected_product)) {
+		err_str << "parsing a product with quotients went wrong" << std::endl;
+		++errors;
+	}
+	ex mixed = reader("x1 - x2/x3*x4 + x5^2 - (x6 - x7)");
+	ex x[8];
+	for (int i = 1; i < 8; ++i)
+		x[i] = syms[names[i]];
+	if (!mixed.is_equal(x[1] - x[2]/x[3]*x[4] + pow(x[5], 2) - (x[6] - x[7]))) {
+		err_str << "parsing a mixed expression gave " << mixed << std::endl;
+		++errors;
+	}
+	return errors;
+}
+
+// Many small expressions can be read with one parser, which keeps its symbols
+// and functions.
+static int check9(std::ostream& err_str)
+{
+	parser reader;
+	exvector results;
+	reader.parse_sequence("x+1; sin(x)*y;; lst(x, y) ;sin(y)^2", results);
+	reader.parse_sequence("2*x, sin(x)", results, ',');
+	symtab syms = reader.get_syms();
+	const ex x = syms["x"], y = syms["y"];
+
+	int errors = 0;
+	if (results.size() != 6 || !results[0].is_equal(x + 1) ||
+	    !results[1].is_equal(sin(x)*y) || !results[2].is_equal(lst(x, y)) ||
+	    !results[3].is_equal(pow(sin(y), 2)) || !results[4].is_equal(2*x) ||
+	    !results[5].is_equal(sin(x)) || syms.size() != 2) {
+		err_str << "parsing a sequence of expressions gave";
+		for (exvector::const_iterator i = results.begin(); i != results.end(); ++i)
+			err_str << ' ' << *i;
+		err_str << std::endl;
+		++errors;
+	}
+	try {
+		reader.parse_sequence("x; y z", results);
+		err_str << "parsing a sequence without separator succeeded" << std::endl;
+		++errors;
+	} catch (parse_error&) {
+	}
+	try {
+		reader("nosuchfunction(x)");
+		err_str << "calling an unknown function succeeded" << std::endl;
+		++errors;
+	} catch (parse_error&) {
+	}
+	return errors;
+}
+
+static int check10(std::ostream& err_str)
+{
+	symbol x("x"), y("y");
+	ex e = 7;
+	for (int i = 1; i <= 200; ++i)
+		e += numeric(i % 2 ? -i : i, 3)*pow(x, i)*y + sin(i*y)*x;
+
+	int errors = 0;
+	for (unsigned n = 1; n <= 5; ++n) {
+		std::vector<std::string> shards;
+		print_shards(e, shards, n);
+		symtab table;
+		table["x"] = x;
+		table["y"] = y;
+		parser reader(table);
+		ex e2 = reader.parse_shards(shards);
+		if (shards.size() != n || !(e2 - e).is_zero()) {
+			err_str << "reading " << n << " shards gave " << e2 << std::endl;
+			++errors;
+		}
+	}
+
+	// Expressions which are not sums go into the first shard.
+	std::vector<std::string> shards;
+	print_shards(sin(x), shards, 3);
+	parser reader;
+	ex e3 = reader.parse_shards(shards);
+	if (shards.size() != 3 || shards[1] != "0" || !e3.is_equal(sin(reader.get_syms()["x"]))) {
+		err_str << "reading the shards of sin(x) gave " << e3 << std::endl;
+		++errors;
+	}
+	return errors;
+}
+
 int main(int argc, char** argv)
 {
 	std::cout << "checking for parser bugs. " << std::flush;
@@ -105,6 +329,12 @@ int main(int argc, char** argv)
 	errors += check2(err_str);
 	errors += check3(err_str);
 	errors += check4(err_str);
+	errors += check5(err_str);
+	errors += check6(err_str);
+	errors += check7(err_str);
+	errors += check8(err_str);
+	errors += check9(err_str);
+	errors += check10(err_str);
 	if (errors) {
 		std::cout << "Yes, unfortunately:" << std::endl;
 		std::cout << err_str.str();
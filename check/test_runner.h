@@ -23,40 +23,33 @@
 #ifndef GINAC_CHECK_TEST_RUNNER_H
 #define GINAC_CHECK_TEST_RUNNER_H
 
-#include "timer.h"
+#include "benchmark.h"
 
 #include <cstdlib>
-#include <ctime>
 #include <iostream>
 #include <string>
 
-template<typename T> static void 
-run_benchmark(T& benchmark,
-	      const unsigned ntests = 10,
-	      const std::clock_t t_annoying = 15*CLOCKS_PER_SEC,
-	      const std::clock_t t_min = CLOCKS_PER_SEC/100)
-{
-	const std::clock_t start(std::clock());
-	std::clock_t elapsed(start);
+/** Adapter of a GCD benchmark, whose result is checked after the timing. */
+template<typename T>
+class checked_benchmark : public benchmark {
+public:
+	checked_benchmark(T& b_) : b(b_) {}
+	unsigned run()
+	{
+		b.run();
+		return 0;
+	}
+private:
+	T& b;
+};
 
-	timer P36;
-	unsigned n = 0;
-	double t = 0;
-	bool go_on = true;
-	do {
-		++n;
-		P36.start();
-		benchmark.run();
-		t += P36.read();
-		go_on = benchmark.check();
-		if (!go_on)
-			break;
-		elapsed = std::clock() - start;
-		if (elapsed > t_annoying)
-			break;
-	} while (n <= ntests || elapsed < t_min);
-	t /= n;
-	benchmark.print_result(t);
+template<typename T> static void
+run_benchmark(const std::string& name, T& b)
+{
+	checked_benchmark<T> adapter(b);
+	const benchmark_result r = run_benchmark(name, static_cast<benchmark&>(adapter));
+	if (!r.skipped && b.check())
+		b.print_result(r.time());
 }
 
 // By default long-running timings are disabled (to not annoy the user).
@@ -34,7 +34,7 @@
  */
 
 #include "ginac.h"
-#include "timer.h"
+#include "benchmark.h"
 using namespace GiNaC;
 
 #include <map>
@@ -481,20 +481,22 @@ static unsigned test_tree(const node tree_generator(unsigned))
 unsigned time_antipode()
 {
 	unsigned result = 0;
-	timer jaeger_le_coultre;
 	
 	cout << "timing computation of antipodes in Yukawa theory" << flush;
 	
 	if (do_test) {
-		jaeger_le_coultre.start();
-		result += test_tree(tree1);  cout << '.' << flush;
-		result += test_tree(tree2);  cout << '.' << flush;
-		result += test_tree(tree3);  cout << '.' << flush;
-		result += test_tree(tree4);  cout << '.' << flush;
-		result += test_tree(tree5);  cout << '.' << flush;
-		result += test_tree(tree6);  cout << '.' << flush;
+		typedef const node tree_generator(unsigned);
+		tree_generator * const trees[] = { tree1, tree2, tree3, tree4, tree5, tree6 };
+		double total = 0;
+		for (unsigned i=0; i<sizeof(trees)/sizeof(*trees); ++i) {
+			const benchmark_result r = run_benchmark(benchmark_name("antipode_tree", i+1),
+			                                         test_tree, trees[i]);
+			result += r.failures;
+			total += r.time();
+			cout << '.' << flush;
+		}
 		
-		cout << jaeger_le_coultre.read() << "s (total)" << endl;
+		cout << total << "s (total)" << endl;
 	} else {
 		cout << " disabled" << endl;
 	}
@@ -505,6 +507,7 @@ extern void randomify_symbol_serials();
 
 int main(int argc, char** argv)
 {
+	parse_benchmark_options(argc, argv);
 	randomify_symbol_serials();
 	cout << setprecision(2) << showpoint;
 	return time_antipode();
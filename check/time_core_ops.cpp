@@ -0,0 +1,265 @@
+/** @file time_core_ops.cpp
+ *
+ *  Timings of the primitive operations on expressions which all algorithms
+ *  are built on: construction of sums and products, eval(), gethash(),
+ *  compare(), is_equal(), subs() of one symbol and copying of ex.  They are
+ *  meant for judging changes of the memory allocation, the hashing or the
+ *  layout of the objects in isolation. */
+
+/*
+ *  GiNaC Copyright (C) 1999-2014 Johannes Gutenberg University Mainz, Germany
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#include "ginac.h"
+#include "benchmark.h"
+using namespace GiNaC;
+
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <vector>
+using namespace std;
+
+/** Number of operations done by one run of every benchmark. */
+static const unsigned operations = 10000;
+
+/** Number of terms of the sums and factors of the products. */
+static const unsigned terms = 8;
+
+/** The operands shared by the benchmarks.  The i-th sum is
+ *  (i+1)*x0 + (i+2)*x1 + ... and the i-th product x0^(i+1)*x1^(i+2)*... */
+struct operands {
+	operands();
+
+	vector<symbol> x;
+	vector<epvector> sum_seqs, product_seqs;
+	vector<add> raw_sums;  ///< neither evaluated nor hashed
+	vector<ex> sums;       ///< evaluated
+	vector<ex> sum_copies; ///< equal to sums, but built separately
+};
+
+operands::operands()
+{
+	x.reserve(terms);
+	for (unsigned j = 0; j < terms; ++j)
+		x.push_back(symbol());
+	sum_seqs.reserve(operations);
+	product_seqs.reserve(operations);
+	for (unsigned i = 0; i < operations; ++i) {
+		epvector s, p;
+		s.reserve(terms);
+		p.reserve(terms);
+		for (unsigned j = 0; j < terms; ++j) {
+			s.push_back(expair(x[j], numeric(i + j + 1)));
+			p.push_back(expair(x[j], numeric(i + j + 1)));
+		}
+		sum_seqs.push_back(s);
+		product_seqs.push_back(p);
+	}
+	raw_sums.reserve(operations);
+	sums.reserve(operations);
+	sum_copies.reserve(operations);
+	for (unsigned i = 0; i < operations; ++i) {
+		raw_sums.push_back(add(sum_seqs[i]));
+		sums.push_back(add(sum_seqs[i]));
+		sum_copies.push_back(add(sum_seqs[i]));
+	}
+}
+
+/** Base of the benchmarks, each run doing one operation on each operand. */
+class core_timing : public benchmark {
+protected:
+	core_timing(const operands & o_) : o(o_) {}
+	const operands & o;
+};
+
+/** Construction and destruction of an add from an epvector, without eval(). */
+class construct_add_timing : public core_timing {
+public:
+	construct_add_timing(const operands & o) : core_timing(o) {}
+	unsigned run()
+	{
+		unsigned result = 0;
+		for (unsigned i = 0; i < operations; ++i) {
+			const add a(o.sum_seqs[i]);
+			if (a.nops() != terms)
+				++result;
+		}
+		return result;
+	}
+};
+
+/** Construction and destruction of a mul from an epvector, without eval(). */
+class construct_mul_timing : public core_timing {
+public:
+	construct_mul_timing(const operands & o) : core_timing(o) {}
+	unsigned run()
+	{
+		unsigned result = 0;
+		for (unsigned i = 0; i < operations; ++i) {
+			const mul m(o.product_seqs[i]);
+			if (m.nops() != terms)
+				++result;
+		}
+		return result;
+	}
+};
+
+/** eval() of sums which were not evaluated before. */
+class eval_timing : public core_timing {
+public:
+	eval_timing(const operands & o) : core_timing(o) {}
+	void prepare() { fresh = o.raw_sums; }
+	unsigned run()
+	{
+		unsigned result = 0;
+		for (unsigned i = 0; i < operations; ++i) {
+			if (fresh[i].eval().nops() != terms)
+				++result;
+		}
+		return result;
+	}
+private:
+	vector<add> fresh;
+};
+
+/** gethash() of sums whose hash value was not computed before. */
+class gethash_timing : public core_timing {
+public:
+	gethash_timing(const operands & o) : core_timing(o) {}
+	void prepare() { fresh = o.raw_sums; }
+	unsigned run()
+	{
+		unsigned distinct = 0;
+		for (unsigned i = 1; i < operations; ++i) {
+			if (fresh[i].gethash() != fresh[i-1].gethash())
+				++distinct;
+		}
+		// Collisions may happen, but not for most of them
+		return distinct < operations / 2;
+	}
+private:
+	vector<add> fresh;
+};
+
+/** compare() of different sums. */
+class compare_timing : public core_timing {
+public:
+	compare_timing(const operands & o) : core_timing(o) {}
+	unsigned run()
+	{
+		unsigned result = 0;
+		for (unsigned i = 1; i < operations; ++i) {
+			if (o.sums[i].compare(o.sums[i-1]) == 0)
+				++result;
+		}
+		return result;
+	}
+};
+
+/** is_equal() of equal sums, which are separate objects. */
+class is_equal_timing : public core_timing {
+public:
+	is_equal_timing(const operands & o) : core_timing(o) {}
+	unsigned run()
+	{
+		unsigned result = 0;
+		for (unsigned i = 0; i < operations; ++i) {
+			if (!o.sums[i].is_equal(o.sum_copies[i]))
+				++result;
+		}
+		return result;
+	}
+};
+
+/** subs() of one symbol in sums. */
+class subs_timing : public core_timing {
+public:
+	subs_timing(const operands & o) : core_timing(o), s(o.x[0] == o.x[terms-1]) {}
+	unsigned run()
+	{
+		unsigned result = 0;
+		for (unsigned i = 0; i < operations; ++i) {
+			if (o.sums[i].subs(s).nops() != terms - 1)
+				++result;
+		}
+		return result;
+	}
+private:
+	const ex s;
+};
+
+/** Copying and destruction of ex, which only changes reference counts. */
+class ex_copy_timing : public core_timing {
+public:
+	ex_copy_timing(const operands & o) : core_timing(o) {}
+	unsigned run()
+	{
+		const vector<ex> copies(o.sums);
+		return copies.size() != operations;
+	}
+};
+
+static unsigned run_core_timing(const string & name, benchmark & b)
+{
+	const benchmark_result r = run_benchmark(name, b);
+	cout << endl << setw(20) << name << ":\t" << r;
+	if (!r.skipped)
+		cout << "\t(" << r.time() / operations * 1e9 << " ns per operation)";
+	if (r.failures)
+		clog << name << " gave wrong results" << endl;
+	return r.failures;
+}
+
+unsigned time_core_ops()
+{
+	unsigned result = 0;
+
+	cout << "timing core operations on expressions" << flush;
+
+	const operands o;
+
+	construct_add_timing construct_add(o);
+	result += run_core_timing("core_construct_add", construct_add);
+	construct_mul_timing construct_mul(o);
+	result += run_core_timing("core_construct_mul", construct_mul);
+	eval_timing eval(o);
+	result += run_core_timing("core_eval", eval);
+	gethash_timing gethash(o);
+	result += run_core_timing("core_gethash", gethash);
+	compare_timing compare(o);
+	result += run_core_timing("core_compare", compare);
+	is_equal_timing is_equal(o);
+	result += run_core_timing("core_is_equal", is_equal);
+	subs_timing subs(o);
+	result += run_core_timing("core_subs", subs);
+	ex_copy_timing ex_copy(o);
+	result += run_core_timing("core_ex_copy", ex_copy);
+	cout << endl;
+
+	return result;
+}
+
+extern void randomify_symbol_serials();
+
+int main(int argc, char** argv)
+{
+	parse_benchmark_options(argc, argv);
+	randomify_symbol_serials();
+	cout << setprecision(2) << showpoint;
+	return time_core_ops();
+}
@@ -25,7 +25,7 @@
  */
 
 #include "ginac.h"
-#include "timer.h"
+#include "benchmark.h"
 using namespace GiNaC;
 
 #include <iostream>
@@ -67,8 +67,7 @@ unsigned time_dennyfliegner()
 	cout << "timing commutative expansion and substitution" << flush;
 	
 	vector<unsigned> sizes;
-	vector<double> times;
-	timer breitling;
+	vector<benchmark_result> times;
 	
 	sizes.push_back(100);
 	sizes.push_back(200);
@@ -76,9 +75,9 @@ unsigned time_dennyfliegner()
 	sizes.push_back(800);
 	
 	for (vector<unsigned>::iterator i=sizes.begin(); i!=sizes.end(); ++i) {
-		breitling.start();
-		result += expand_subs(*i);
-		times.push_back(breitling.read());
+		const benchmark_result r = run_benchmark(benchmark_name("dennyfliegner", *i), expand_subs, *i);
+		result += r.failures;
+		times.push_back(r);
 		cout << '.' << flush;
 	}
 	
@@ -86,8 +85,8 @@ unsigned time_dennyfliegner()
 	cout << endl << "	size:  ";
 	for (vector<unsigned>::iterator i=sizes.begin(); i!=sizes.end(); ++i)
 		cout << '\t' << *i;
-	cout << endl << "	time/s:";
-	for (vector<double>::iterator i=times.begin(); i!=times.end(); ++i)
+	cout << endl << "	time:  ";
+	for (vector<benchmark_result>::iterator i=times.begin(); i!=times.end(); ++i)
 		cout << '\t' << *i;
 	cout << endl;
 	
@@ -98,6 +97,7 @@ extern void randomify_symbol_serials();
 
 int main(int argc, char** argv)
 {
+	parse_benchmark_options(argc, argv);
 	randomify_symbol_serials();
 	cout << setprecision(2) << showpoint;
 	return time_dennyfliegner();
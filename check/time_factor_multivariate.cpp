@@ -0,0 +1,152 @@
+/** @file time_factor_multivariate.cpp
+ *
+ *  Time for factoring multivariate polynomials: products of factors with
+ *  leading coefficients that are polynomials themselves, in the style of the
+ *  examples of Wang's algorithm, and products of random dense and of random
+ *  sparse polynomials. */
+
+/*
+ *  GiNaC Copyright (C) 1999-2014 Johannes Gutenberg University Mainz, Germany
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#include "ginac.h"
+#include "benchmark.h"
+using namespace GiNaC;
+
+#include <iostream>
+#include <string>
+#include <vector>
+using namespace std;
+
+static const symbol x("x"), y("y"), z("z"), u("u"), v("v"), w("w"), t("t");
+
+/** Pseudo random coefficients in [-9,9] \ {0}, the same on every platform. */
+static int random_coefficient()
+{
+	static unsigned long seed = 1;
+	seed = (seed * 1103515245UL + 12345UL) & 0xffffffffUL;
+	const int c = int((seed >> 16) % 18) - 9;
+	return c >= 0 ? c + 1 : c;
+}
+
+/** Random polynomial in x, y, z with all monomials of total degree <= d. */
+static ex random_dense(int d)
+{
+	ex p = 0;
+	for (int i = 0; i <= d; ++i)
+		for (int j = 0; i + j <= d; ++j)
+			for (int k = 0; i + j + k <= d; ++k)
+				p += random_coefficient() * pow(x, i) * pow(y, j) * pow(z, k);
+	return p;
+}
+
+/** Random polynomial with n terms in seven variables, degree <= 2 in each. */
+static ex random_sparse(int n)
+{
+	const ex vars[] = { x, y, z, u, v, w, t };
+	ex p = 0;
+	for (int i = 0; i < n; ++i) {
+		ex m = random_coefficient();
+		for (int j = 0; j < 7; ++j)
+			m *= pow(vars[j], (random_coefficient() + 9) % 3);
+		p += m;
+	}
+	return p + random_coefficient();
+}
+
+struct factor_test {
+	string name;
+	ex poly;
+	size_t nfactors;  // number of distinct irreducible factors
+};
+
+static unsigned check_factors(const factor_test& t)
+{
+	vector<pair<ex, unsigned> > factors;
+	ex prod = factor_list(t.poly, factors);
+	for (size_t i = 0; i < factors.size(); ++i)
+		prod *= pow(factors[i].first, factors[i].second);
+	if (factors.size() != t.nfactors || !(prod.expand() - t.poly).is_zero()) {
+		clog << t.name << " was factored into " << factors.size()
+		     << " factors instead of " << t.nfactors << endl;
+		return 1;
+	}
+	return 0;
+}
+
+unsigned time_factor_multivariate()
+{
+	unsigned result = 0;
+
+	cout << "timing multivariate polynomial factorization" << flush;
+
+	const ex f1 = (pow(y, 2) - z)*pow(x, 3) + (y*z + 1)*x - 2*z;
+	const ex f2 = (y + pow(z, 2))*pow(x, 2) - 3*y*x + pow(z, 3) - 1;
+	const ex f3 = (y - 2*z + 1)*pow(x, 4) + pow(y, 2)*z*pow(x, 2) + 7;
+	vector<factor_test> tests;
+	factor_test wang1 = { "Wang f1*f2", expand(f1*f2), 2 };
+	tests.push_back(wang1);
+	factor_test wang2 = { "Wang f1*f2*f3", expand(f1*f2*f3), 3 };
+	tests.push_back(wang2);
+	factor_test wang3 = { "Wang f1^2*f3", expand(pow(f1, 2)*f3), 2 };
+	tests.push_back(wang3);
+	factor_test dense = { "dense 3 vars", expand(random_dense(3)*random_dense(3)), 2 };
+	tests.push_back(dense);
+	factor_test sparse1 = { "sparse 7 vars", expand(random_sparse(4)*random_sparse(4)), 2 };
+	tests.push_back(sparse1);
+	factor_test sparse2 = { "sparse 7 vars, 3 factors",
+	                        expand(random_sparse(3)*random_sparse(4)*random_sparse(3)), 3 };
+	tests.push_back(sparse2);
+
+	vector<benchmark_result> times;
+	vector<factor_timing_statistics> phases;
+	for (size_t i = 0; i < tests.size(); ++i) {
+		reset_factor_timing_statistics();
+		const benchmark_result r = run_benchmark(benchmark_name("factor_multivariate", i+1), check_factors, tests[i]);
+		result += r.failures;
+		times.push_back(r);
+		// phases per run
+		factor_timing_statistics p = get_factor_timing_statistics();
+		if (const unsigned long runs = r.warmups + r.runs) {
+			p.modular /= runs;
+			p.lifting /= runs;
+			p.recombination /= runs;
+		}
+		phases.push_back(p);
+		cout << '.' << flush;
+	}
+
+	// print the report:
+	cout << endl << "	polynomial\t\ttime\tmodular\tlifting\trecombination" << endl;
+	for (size_t i = 0; i < tests.size(); ++i) {
+		cout << "	" << tests[i].name << (tests[i].name.size() < 16 ? "\t\t" : "\t")
+		     << times[i] << '\t' << phases[i].modular << '\t' << phases[i].lifting
+		     << '\t' << phases[i].recombination << endl;
+	}
+
+	return result;
+}
+
+extern void randomify_symbol_serials();
+
+int main(int argc, char** argv)
+{
+	parse_benchmark_options(argc, argv);
+	randomify_symbol_serials();
+	cout << setprecision(2) << showpoint;
+	return time_factor_multivariate();
+}
@@ -0,0 +1,125 @@
+/** @file time_factor_univariate.cpp
+ *
+ *  Time for factoring univariate polynomials: Swinnerton-Dyer polynomials,
+ *  which are irreducible but split into many factors modulo every prime, and
+ *  products of cyclotomic polynomials. */
+
+/*
+ *  GiNaC Copyright (C) 1999-2014 Johannes Gutenberg University Mainz, Germany
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#include "ginac.h"
+#include "benchmark.h"
+using namespace GiNaC;
+
+#include <iostream>
+#include <string>
+#include <vector>
+using namespace std;
+
+static const symbol x("x");
+
+/** The Swinnerton-Dyer polynomial with the roots sqrt(2)+-sqrt(3)+-...,
+ *  using the first n primes. */
+static ex swinnerton_dyer(unsigned n)
+{
+	static const int primes[] = { 2, 3, 5, 7, 11, 13 };
+	const symbol y("y");
+	ex s = pow(x, 2) - primes[0];
+	for (unsigned i = 1; i < n; ++i)
+		s = resultant(s.subs(x == x - y), pow(y, 2) - primes[i], y).expand();
+	return s;
+}
+
+struct factor_test {
+	string name;
+	ex poly;
+	size_t nfactors;  // number of distinct irreducible factors
+};
+
+static unsigned check_factors(const factor_test& t)
+{
+	vector<pair<ex, unsigned> > factors;
+	ex prod = factor_list(t.poly, factors);
+	for (size_t i = 0; i < factors.size(); ++i)
+		prod *= pow(factors[i].first, factors[i].second);
+	if (factors.size() != t.nfactors || !(prod.expand() - t.poly).is_zero()) {
+		clog << t.name << " was factored into " << factors.size()
+		     << " factors instead of " << t.nfactors << endl;
+		return 1;
+	}
+	return 0;
+}
+
+unsigned time_factor_univariate()
+{
+	unsigned result = 0;
+
+	cout << "timing univariate polynomial factorization" << flush;
+
+	vector<factor_test> tests;
+	for (unsigned n = 3; n <= 5; ++n) {
+		factor_test t = { "Swinnerton-Dyer S_" + string(1, char('0' + n)), swinnerton_dyer(n), 1 };
+		tests.push_back(t);
+	}
+	factor_test c60 = { "x^60-1", pow(x, 60) - 1, 12 };
+	tests.push_back(c60);
+	factor_test c105 = { "x^105-1", pow(x, 105) - 1, 8 };
+	tests.push_back(c105);
+	factor_test c120 = { "x^120-1", pow(x, 120) - 1, 16 };
+	tests.push_back(c120);
+	factor_test c2 = { "(x^30-1)*(x^42+1)", expand((pow(x, 30) - 1)*(pow(x, 42) + 1)), 12 };
+	tests.push_back(c2);
+
+	vector<benchmark_result> times;
+	vector<factor_timing_statistics> phases;
+	for (size_t i = 0; i < tests.size(); ++i) {
+		reset_factor_timing_statistics();
+		const benchmark_result r = run_benchmark(benchmark_name("factor_univariate", i+1), check_factors, tests[i]);
+		result += r.failures;
+		times.push_back(r);
+		// phases per run
+		factor_timing_statistics p = get_factor_timing_statistics();
+		if (const unsigned long runs = r.warmups + r.runs) {
+			p.modular /= runs;
+			p.lifting /= runs;
+			p.recombination /= runs;
+		}
+		phases.push_back(p);
+		cout << '.' << flush;
+	}
+
+	// print the report:
+	cout << endl << "	polynomial\t\ttime\tmodular\tlifting\trecombination" << endl;
+	for (size_t i = 0; i < tests.size(); ++i) {
+		cout << "	" << tests[i].name << (tests[i].name.size() < 16 ? "\t\t" : "\t")
+		     << times[i] << '\t' << phases[i].modular << '\t' << phases[i].lifting
+		     << '\t' << phases[i].recombination << endl;
+	}
+
+	return result;
+}
+
+extern void randomify_symbol_serials();
+
+int main(int argc, char** argv)
+{
+	parse_benchmark_options(argc, argv);
+	randomify_symbol_serials();
+	cout << setprecision(2) << showpoint;
+	return time_factor_univariate();
+}
@@ -24,23 +24,25 @@
  */
 
 #include "ginac.h"
-#include "timer.h"
+#include "benchmark.h"
 using namespace GiNaC;
 
 #include <iostream>
 using namespace std;
 
-static unsigned test()
+static unsigned test(unsigned n)
 {
 	unsigned result = 0;
 	const symbol x("x"), y("y"), z("z");
 
-	const ex p = pow(x+y+z+1, 20);
+	const ex p = pow(x+y+z+1, n);
 
 	const ex hugesum = expand(p * (p+1));
 
-	if (hugesum.nops()!=12341) {
-		clog << "(x+y+z+1)^20 * ((x+y+z+1)^20+1) was miscomputed!" << endl;
+	// all monomials in x, y, z of degree up to 2n
+	const size_t terms = (2*n+3)*(2*n+2)*(2*n+1)/6;
+	if (hugesum.nops()!=terms) {
+		clog << "(x+y+z+1)^" << n << " * ((x+y+z+1)^" << n << "+1) was miscomputed!" << endl;
 		++result;
 	}
 
@@ -49,23 +51,17 @@ static unsigned test()
 
 unsigned time_fateman_expand()
 {
-	unsigned result = 0;
-	unsigned count = 0;
-	timer concord;
-	double time = .0;
-
 	cout << "timing Fateman's polynomial expand benchmark" << flush;
 
-	concord.start();
-	// correct for very small times:
-	do {
-		result = test();
-		++count;
-	} while ((time=concord.read())<0.1 && !result);
+	const benchmark_result r = run_benchmark("fateman_expand", test, 20u);
 	cout << '.' << flush;
+	cout << r << endl;
+	if (r.failures)
+		return r.failures;
 
-	cout << time/count << 's' << endl;
-
+	static const unsigned sizes[] = { 5, 10, 15, 20 };
+	unsigned result = run_scaling("fateman_expand", "n", test, sizes);
+	result += run_thread_sweep("fateman_expand", test, 20u, set_expand_threads);
 	return result;
 }
 
@@ -73,6 +69,7 @@ extern void randomify_symbol_serials();
 
 int main(int argc, char** argv)
 {
+	parse_benchmark_options(argc, argv);
 	randomify_symbol_serials();
 	cout << setprecision(2) << showpoint;
 	return time_fateman_expand();
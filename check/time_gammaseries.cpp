@@ -21,7 +21,7 @@
  */
 
 #include "ginac.h"
-#include "timer.h"
+#include "benchmark.h"
 using namespace GiNaC;
 
 #include <iostream>
@@ -56,8 +56,7 @@ unsigned time_gammaseries()
 	cout << "timing Laurent series expansion of Gamma function" << flush;
 
 	vector<unsigned> sizes;
-	vector<double> times;
-	timer omega;
+	vector<benchmark_result> times;
 
 	sizes.push_back(20);
 	sizes.push_back(25);
@@ -65,9 +64,9 @@ unsigned time_gammaseries()
 	sizes.push_back(35);
 
 	for (vector<unsigned>::iterator i=sizes.begin(); i!=sizes.end(); ++i) {
-		omega.start();
-		result += tgammaseries(*i);
-		times.push_back(omega.read());
+		const benchmark_result r = run_benchmark(benchmark_name("gammaseries", *i), tgammaseries, *i);
+		result += r.failures;
+		times.push_back(r);
 		cout << '.' << flush;
 	}
 
@@ -75,8 +74,8 @@ unsigned time_gammaseries()
 	cout << endl << "	order: ";
 	for (vector<unsigned>::iterator i=sizes.begin(); i!=sizes.end(); ++i)
 		cout << '\t' << *i;
-	cout << endl << "	time/s:";
-	for (vector<double>::iterator i=times.begin(); i!=times.end(); ++i)
+	cout << endl << "	time:  ";
+	for (vector<benchmark_result>::iterator i=times.begin(); i!=times.end(); ++i)
 		cout << '\t' << *i;
 	cout << endl;
 	
@@ -87,6 +86,7 @@ extern void randomify_symbol_serials();
 
 int main(int argc, char** argv)
 {
+	parse_benchmark_options(argc, argv);
 	randomify_symbol_serials();
 	cout << setprecision(2) << showpoint;
 	return time_gammaseries();
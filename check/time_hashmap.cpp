@@ -21,52 +21,97 @@
  */
 
 #include "ginac.h"
-#include "timer.h"
+#include "benchmark.h"
 using namespace GiNaC;
 
 #include <iostream>
 #include <vector>
 using namespace std;
 
+/** Timings of a map of size symbols, each mapped to the next one. */
 template <class T>
-static void run_timing(unsigned size, double &time_insert, double &time_find, double &time_erase)
-{
-	vector<symbol> S;
+class map_timing : public benchmark {
+protected:
+	map_timing(const vector<symbol> &S_) : S(S_) {}
+
+	void fill()
+	{
+		const size_t size = S.size();
+		for (unsigned i=0; i<size; ++i)
+			M[S[i]] = S[(i+1)%size];
+	}
+
+	const vector<symbol> &S;
 	T M;
-	timer t;
+};
 
-	S.reserve(size);
-	for (unsigned i=0; i<size; ++i)
-		S.push_back(symbol());
+template <class T>
+class insert_timing : public map_timing<T> {
+public:
+	insert_timing(const vector<symbol> &S) : map_timing<T>(S) {}
+	void prepare() { this->M.clear(); }
+	unsigned run() { this->fill(); return 0; }
+};
 
-	t.start();
-	for (unsigned i=0; i<size; ++i)
-		M[S[i]] = S[(i+1)%size];
-	time_insert = t.read();
-
-	t.start();
-	for (unsigned i=0; i<size; ++i) {
-		if (!M[S[i]].is_equal(S[(i+1)%size])) {
-			clog << "map lookup failed" << endl;
-			return;
+template <class T>
+class find_timing : public map_timing<T> {
+public:
+	find_timing(const vector<symbol> &S) : map_timing<T>(S) { this->fill(); }
+	unsigned run()
+	{
+		const vector<symbol> &S = this->S;
+		const size_t size = S.size();
+		for (unsigned i=0; i<size; ++i) {
+			if (!this->M[S[i]].is_equal(S[(i+1)%size])) {
+				clog << "map lookup failed" << endl;
+				return 1;
+			}
 		}
+		return 0;
 	}
-	time_find = t.read();
+};
 
-	t.start();
-	for (unsigned i=0; i<size; ++i) {
-		if (M.erase(S[i]) != 1) {
-			clog << "erasing element " << S[i] << " failed" << endl;
-			return;
+template <class T>
+class erase_timing : public map_timing<T> {
+public:
+	erase_timing(const vector<symbol> &S) : map_timing<T>(S) {}
+	void prepare() { this->fill(); }
+	unsigned run()
+	{
+		const vector<symbol> &S = this->S;
+		T &M = this->M;
+		for (unsigned i=0; i<S.size(); ++i) {
+			if (M.erase(S[i]) != 1) {
+				clog << "erasing element " << S[i] << " failed" << endl;
+				return 1;
+			}
 		}
+		if (!M.empty()) {
+			clog << "map not empty (size = " << M.size() << ") after erasing all elements" << endl;
+			return 1;
+		}
+		return 0;
 	}
-	if (!M.empty()) {
-		clog << "map not empty (size = " << M.size() << ") after erasing all elements" << endl;
-		return;
-	}
-	time_erase = t.read();
-}
+};
+
+template <class T>
+static unsigned run_timing(unsigned size, vector<benchmark_result> &times_insert,
+                           vector<benchmark_result> &times_find, vector<benchmark_result> &times_erase)
+{
+	vector<symbol> S;
+	S.reserve(size);
+	for (unsigned i=0; i<size; ++i)
+		S.push_back(symbol());
 
+	insert_timing<T> insert(S);
+	times_insert.push_back(run_benchmark(benchmark_name("hashmap_insert", size), insert));
+	find_timing<T> find(S);
+	times_find.push_back(run_benchmark(benchmark_name("hashmap_find", size), find));
+	erase_timing<T> erase(S);
+	times_erase.push_back(run_benchmark(benchmark_name("hashmap_erase", size), erase));
+
+	return times_insert.back().failures + times_find.back().failures + times_erase.back().failures;
+}
 
 unsigned time_hashmap()
 {
@@ -77,31 +122,26 @@ unsigned time_hashmap()
 	unsigned s[] = {10000, 50000, 100000, 500000};
 	vector<unsigned> sizes(s, s+sizeof(s)/sizeof(*s));
 
-	vector<double> times_insert, times_find, times_erase;
+	vector<benchmark_result> times_insert, times_find, times_erase;
 
 	for (vector<unsigned>::const_iterator i = sizes.begin(); i != sizes.end(); ++i) {
-		double time_insert, time_find, time_erase;
-
-		run_timing< exhashmap<ex> >(*i, time_insert, time_find, time_erase);
+		result += run_timing< exhashmap<ex> >(*i, times_insert, times_find, times_erase);
 
 // If you like, you can compare it with this:
-//		run_timing< std::map<ex, ex, ex_is_less> >(*i, time_insert, time_find, time_erase);
+//		result += run_timing< std::map<ex, ex, ex_is_less> >(*i, times_insert, times_find, times_erase);
 
-		times_insert.push_back(time_insert);
-		times_find.push_back(time_find);
-		times_erase.push_back(time_erase);
 		cout << '.' << flush;
 	}
 
 	// print the report:
 	cout << endl << "          size:\t";
 	copy(sizes.begin(), sizes.end(), ostream_iterator<unsigned>(cout, "\t"));
-	cout << endl << "      insert/s:\t";
-	copy(times_insert.begin(), times_insert.end(), ostream_iterator<double>(cout, "\t"));
-	cout << endl << "        find/s:\t";
-	copy(times_find.begin(), times_find.end(), ostream_iterator<double>(cout, "\t"));
-	cout << endl << "       erase/s:\t";
-	copy(times_erase.begin(), times_erase.end(), ostream_iterator<double>(cout, "\t"));
+	cout << endl << "        insert:\t";
+	copy(times_insert.begin(), times_insert.end(), ostream_iterator<benchmark_result>(cout, "\t"));
+	cout << endl << "          find:\t";
+	copy(times_find.begin(), times_find.end(), ostream_iterator<benchmark_result>(cout, "\t"));
+	cout << endl << "         erase:\t";
+	copy(times_erase.begin(), times_erase.end(), ostream_iterator<benchmark_result>(cout, "\t"));
 	cout << endl;
 
 	return result;
@@ -111,6 +151,7 @@ extern void randomify_symbol_serials();
 
 int main(int argc, char** argv)
 {
+	parse_benchmark_options(argc, argv);
 	randomify_symbol_serials();
 	cout << setprecision(2) << showpoint;
 	return time_hashmap();
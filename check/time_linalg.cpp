@@ -0,0 +1,328 @@
+/** @file time_linalg.cpp
+ *
+ *  Times determinants, linear systems, inverses and ranks of matrices of
+ *  numbers and of uni- and multivariate polynomials with all algorithms,
+ *  sweeping the size and the density of the matrices.  Called without
+ *  arguments, a small sweep is run and the results of the algorithms are
+ *  compared.  Options:
+ *    -sizes 4,8,12     sizes of the square matrices
+ *    -densities 0.2,1  fractions of nonzero entries
+ *    -kinds numeric,univariate,multivariate
+ *    -ops det,solve,inverse,rank
+ *    -budget 2.0       CPU seconds after which an algorithm is not run at
+ *                      larger sizes of the same shape
+ *    -csv              print one line per run as comma separated values
+ */
+
+/*
+ *  GiNaC Copyright (C) 1999-2014 Johannes Gutenberg University Mainz, Germany
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#include "ginac.h"
+#include "benchmark.h"
+using namespace GiNaC;
+
+#include <cstdlib>
+#include <iostream>
+#include <map>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+using namespace std;
+
+static const symbol x("x"), y("y"), z("z");
+
+/** Pseudo random numbers, the same on every platform. */
+static unsigned long random_number()
+{
+	static unsigned long seed = 1;
+	seed = (seed * 1103515245UL + 12345UL) & 0xffffffffUL;
+	return seed >> 16;
+}
+
+/** Pseudo random coefficients in [-9,9] \ {0}. */
+static int random_coefficient()
+{
+	const int c = int(random_number() % 18) - 9;
+	return c >= 0 ? c + 1 : c;
+}
+
+/** A nonzero entry of the given kind. */
+static ex random_entry(const string & kind)
+{
+	if (kind == "univariate")
+		return random_coefficient()*pow(x, 2) + random_coefficient()*x + random_coefficient();
+	if (kind == "multivariate")
+		return random_coefficient()*x + random_coefficient()*y*z + random_coefficient();
+	return random_coefficient();
+}
+
+/** A square matrix with the given fraction of nonzero entries.  The
+ *  diagonal is always populated, which makes singular matrices unlikely. */
+static matrix random_matrix(unsigned n, double density, const string & kind)
+{
+	matrix m(n, n);
+	for (unsigned r=0; r<n; ++r)
+		for (unsigned c=0; c<n; ++c)
+			if (r == c || random_number() % 1000 < density*1000)
+				m(r, c) = random_entry(kind);
+	return m;
+}
+
+struct algorithm {
+	const char * name;
+	unsigned flag;
+	unsigned max_size;  ///< largest size to run it at, 0 for any
+};
+
+static const algorithm determinant_algos[] = {
+	{ "automatic", determinant_algo::automatic, 0 },
+	{ "gauss", determinant_algo::gauss, 0 },
+	{ "divfree", determinant_algo::divfree, 6 },
+	{ "bareiss", determinant_algo::bareiss, 0 },
+	{ "laplace", determinant_algo::laplace, 12 },
+	{ "modular", determinant_algo::modular, 0 },
+	{ 0, 0, 0 }
+};
+
+static const algorithm solve_algos[] = {
+	{ "automatic", solve_algo::automatic, 0 },
+	{ "gauss", solve_algo::gauss, 0 },
+	{ "divfree", solve_algo::divfree, 4 },
+	{ "bareiss", solve_algo::bareiss, 0 },
+	{ "sparse", solve_algo::sparse, 0 },
+	{ 0, 0, 0 }
+};
+
+static const algorithm no_algos[] = {
+	{ "automatic", 0, 0 },
+	{ 0, 0, 0 }
+};
+
+/** Run the operation once, returning its result as an expression. */
+static ex run(const string & op, const matrix & m, unsigned algo)
+{
+	const unsigned n = m.rows();
+	if (op == "det")
+		return m.determinant(algo);
+	if (op == "rank")
+		return m.rank();
+	matrix vars(n, op == "inverse" ? n : 1), rhs(n, vars.cols());
+	for (unsigned r=0; r<n; ++r) {
+		for (unsigned c=0; c<vars.cols(); ++c)
+			vars(r, c) = symbol();
+		if (op == "inverse")
+			rhs(r, r) = 1;
+		else
+			rhs(r, 0) = r+1;
+	}
+	return m.solve(vars, rhs, algo);
+}
+
+/** Check if two results of an operation agree. */
+static bool same_result(const ex & a, const ex & b)
+{
+	if (is_a<matrix>(a) && is_a<matrix>(b)) {
+		const ex d = ex_to<matrix>(a).sub(ex_to<matrix>(b));
+		for (size_t i=0; i<d.nops(); ++i)
+			if (!d.op(i).normal().is_zero())
+				return false;
+		return true;
+	}
+	return (a - b).normal().is_zero();
+}
+
+static vector<string> split_list(const string & s)
+{
+	vector<string> v;
+	istringstream in(s);
+	string item;
+	while (getline(in, item, ','))
+		v.push_back(item);
+	return v;
+}
+
+/** An operation on a matrix with one algorithm, keeping the result. */
+class operation_timing : public benchmark {
+public:
+	operation_timing(const string & op_, const matrix & m_, unsigned algo_)
+	 : op(op_), m(m_), algo(algo_) {}
+	unsigned run()
+	{
+		try {
+			e = ::run(op, m, algo);
+		} catch (const runtime_error &) {
+			// singular system
+			e = 0;
+		}
+		return 0;
+	}
+
+	ex e;
+private:
+	const string & op;
+	const matrix & m;
+	unsigned algo;
+};
+
+struct run_result {
+	string op, kind, algo;
+	double density;
+	unsigned size;
+	double time;
+	bool ok;
+};
+
+unsigned time_linalg(int argc, char** argv)
+{
+	unsigned result = 0;
+
+	vector<unsigned> sizes;
+	sizes.push_back(2);
+	sizes.push_back(4);
+	sizes.push_back(6);
+	vector<double> densities;
+	densities.push_back(0.3);
+	densities.push_back(1.0);
+	vector<string> kinds = split_list("numeric,univariate,multivariate");
+	vector<string> ops = split_list("det,solve,inverse,rank");
+	double budget = 0.5;
+	bool csv = false;
+
+	for (int i=1; i<argc; ++i) {
+		const string arg = argv[i];
+		if (arg == "-csv") {
+			csv = true;
+			continue;
+		}
+		if (i+1 == argc)
+			throw invalid_argument("time_linalg: missing value of option " + arg);
+		const string value = argv[++i];
+		if (arg == "-sizes") {
+			sizes.clear();
+			const vector<string> v = split_list(value);
+			for (size_t k=0; k<v.size(); ++k)
+				sizes.push_back(atoi(v[k].c_str()));
+		} else if (arg == "-densities") {
+			densities.clear();
+			const vector<string> v = split_list(value);
+			for (size_t k=0; k<v.size(); ++k)
+				densities.push_back(atof(v[k].c_str()));
+		} else if (arg == "-kinds") {
+			kinds = split_list(value);
+		} else if (arg == "-ops") {
+			ops = split_list(value);
+		} else if (arg == "-budget") {
+			budget = atof(value.c_str());
+		} else {
+			throw invalid_argument("time_linalg: unknown option " + arg);
+		}
+	}
+
+	if (csv)
+		cout << "op,kind,density,size,algorithm,time,agrees" << endl;
+	else
+		cout << "timing linear algebra algorithms" << flush;
+
+	vector<run_result> runs;
+	for (vector<string>::const_iterator op=ops.begin(); op!=ops.end(); ++op) {
+		const algorithm * algos = (*op == "det" ? determinant_algos :
+		                           *op == "rank" ? no_algos : solve_algos);
+		for (vector<string>::const_iterator kind=kinds.begin(); kind!=kinds.end(); ++kind) {
+			for (vector<double>::const_iterator d=densities.begin(); d!=densities.end(); ++d) {
+				// algorithms which exceeded the budget at a smaller size,
+				// except for the automatic choice (division free elimination
+				// and minor expansion blow up too fast for that, they are
+				// limited to small sizes instead)
+				map<string, bool> exhausted;
+				for (vector<unsigned>::const_iterator n=sizes.begin(); n!=sizes.end(); ++n) {
+					const matrix m = random_matrix(*n, *d, *kind);
+					ex reference;
+					bool have_reference = false;
+					for (const algorithm * a=algos; a->name; ++a) {
+						if (a != algos && (exhausted[a->name] ||
+						                   (a->max_size && *n > a->max_size)))
+							continue;
+						ostringstream name;
+						name << "linalg_" << *op << '_' << *kind << '_' << *d
+						     << '_' << *n << '_' << a->name;
+						operation_timing t(*op, m, a->flag);
+						const benchmark_result b = run_benchmark(name.str(), t);
+						if (b.skipped)
+							continue;
+						const ex & e = t.e;
+						run_result r = { *op, *kind, a->name, *d, *n, b.time(), true };
+						if (!have_reference) {
+							reference = e;
+							have_reference = true;
+						} else if (!same_result(reference, e)) {
+							clog << *op << " of " << m << " with algorithm " << a->name
+							     << " erroneously returned " << e << " instead of "
+							     << reference << endl;
+							r.ok = false;
+							++result;
+						}
+						if (r.time > budget)
+							exhausted[a->name] = true;
+						if (csv)
+							cout << r.op << ',' << r.kind << ',' << r.density << ','
+							     << r.size << ',' << r.algo << ',' << r.time << ','
+							     << (r.ok ? 1 : 0) << endl;
+						runs.push_back(r);
+					}
+				}
+				if (!csv)
+					cout << '.' << flush;
+			}
+		}
+	}
+	if (csv)
+		return result;
+
+	// print the report, flagging shapes where the automatic choice is
+	// slower than twice the best algorithm
+	cout << endl << "	op\tkind\t\tdensity\tdim\tautomatic/s\tbest/s\tbest" << endl;
+	for (size_t i=0; i<runs.size(); ) {
+		size_t j = i + 1;
+		while (j < runs.size() && runs[j].op == runs[i].op && runs[j].kind == runs[i].kind &&
+		       runs[j].density == runs[i].density && runs[j].size == runs[i].size)
+			++j;
+		size_t best = i;
+		for (size_t k=i+1; k<j; ++k)
+			if (runs[k].time < runs[best].time)
+				best = k;
+		cout << "	" << runs[i].op << '\t' << runs[i].kind
+		     << (runs[i].kind.size() < 8 ? "\t\t" : "\t") << runs[i].density << '\t'
+		     << runs[i].size << 'x' << runs[i].size << '\t' << runs[i].time << "\t\t"
+		     << runs[best].time << '\t' << runs[best].algo
+		     << (runs[i].time > 2*runs[best].time + 0.01 ? "\t(!)" : "") << endl;
+		i = j;
+	}
+
+	return result;
+}
+
+extern void randomify_symbol_serials();
+
+int main(int argc, char** argv)
+{
+	parse_benchmark_options(argc, argv);
+	randomify_symbol_serials();
+	cout << setprecision(2) << showpoint;
+	return time_linalg(argc, argv);
+}
@@ -22,44 +22,49 @@
  */
 
 #include "ginac.h"
-#include "timer.h"
+#include "benchmark.h"
 using namespace GiNaC;
 
 #include <iostream>
 #include <vector>
 using namespace std;
 
-static unsigned test()
+static unsigned test(unsigned n)
 {
-	for (int i=1; i<=99; ++i)
-		factorial(1000+i)/factorial(900+i);
-	ex rat(factorial(1100)/factorial(1000));
+	const unsigned m = n/10;
+	for (unsigned i=1; i<m; ++i)
+		factorial(n+i)/factorial(n-m+i);
+	ex rat(factorial(n+m)/factorial(n));
 	
-	if (abs(evalf(rat)-numeric(".13280014101512E303"))>numeric("1.0E289")) {
-		clog << "1100!/1000! erroneously returned " << rat << endl;
-		return 1;
+	if (n == 1000) {
+		if (abs(evalf(rat)-numeric(".13280014101512E303"))>numeric("1.0E289")) {
+			clog << "1100!/1000! erroneously returned " << rat << endl;
+			return 1;
+		}
+	} else {
+		numeric prod = 1;
+		for (unsigned i=1; i<=m; ++i)
+			prod *= n+i;
+		if (rat != prod) {
+			clog << n+m << "!/" << n << "! erroneously returned " << rat << endl;
+			return 1;
+		}
 	}
 	return 0;
 }
 
 unsigned time_lw_A()
 {
-	unsigned result = 0;
-	unsigned count = 0;
-	timer rolex;
-	double time = .0;
-	
 	cout << "timing Lewis-Wester test A (divide factorials)" << flush;
 	
-	rolex.start();
-	// correct for very small times:
-	do {
-		result = test();
-		++count;
-	} while ((time=rolex.read())<0.1 && !result);
+	const benchmark_result r = run_benchmark("lw_A", test, 1000u);
 	cout << '.' << flush;
-	cout << time/count << 's' << endl;
+	cout << r << endl;
+	if (r.failures)
+		return r.failures;
 	
+	static const unsigned sizes[] = { 250, 500, 1000, 2000 };
+	unsigned result = run_scaling("lw_A", "n", test, sizes);
 	return result;
 }
 
@@ -67,6 +72,7 @@ extern void randomify_symbol_serials();
 
 int main(int argc, char** argv)
 {
+	parse_benchmark_options(argc, argv);
 	randomify_symbol_serials();
 	cout << setprecision(2) << showpoint;
 	return time_lw_A();
@@ -22,22 +22,25 @@
  */
 
 #include "ginac.h"
-#include "timer.h"
+#include "benchmark.h"
 using namespace GiNaC;
 
 #include <iostream>
 #include <vector>
 using namespace std;
 
-static unsigned test()
+static unsigned test(unsigned n)
 {
 	numeric s;
 	
-	for (int i=1; i<=1000; ++i)
+	for (unsigned i=1; i<=n; ++i)
 		s += numeric(i).inverse();
 	
-	if (abs(s.evalf()-numeric("7.4854708605503449"))>numeric("2.0E-16")) {
-		clog << "sum(1/i,i=1..1000) erroneously returned " << s << endl;
+	// asymptotic expansion of the harmonic numbers
+	const numeric N(n);
+	const ex approx = evalf(log(N) + Euler + 1/(2*N) - 1/(12*pow(N,2)) + 1/(120*pow(N,4)));
+	if (abs(s.evalf()-ex_to<numeric>(approx))>numeric("1.0E-14")) {
+		clog << "sum(1/i,i=1.." << n << ") erroneously returned " << s << endl;
 		return 1;
 	}
 	return 0;
@@ -45,28 +48,23 @@ static unsigned test()
 
 unsigned time_lw_B()
 {
-	unsigned result = 0;
-	unsigned count = 0;
-	timer rolex;
-	double time = .0;
-	
 	cout << "timing Lewis-Wester test B (sum of rational numbers)" << flush;
 	
-	rolex.start();
-	// correct for very small times:
-	do {
-		result = test();
-		++count;
-	} while ((time=rolex.read())<0.1 && !result);
+	const benchmark_result r = run_benchmark("lw_B", test, 1000u);
 	cout << '.' << flush;
-	cout << time/count << 's' << endl;
+	cout << r << endl;
+	if (r.failures)
+		return r.failures;
 	
+	static const unsigned sizes[] = { 1000, 2000, 4000, 8000 };
+	unsigned result = run_scaling("lw_B", "n", test, sizes);
 	return result;
 }
 extern void randomify_symbol_serials();
 
 int main(int argc, char** argv)
 {
+	parse_benchmark_options(argc, argv);
 	randomify_symbol_serials();
 	cout << setprecision(2) << showpoint;
 	return time_lw_B();
@@ -22,25 +22,34 @@
  */
 
 #include "ginac.h"
-#include "timer.h"
+#include "benchmark.h"
 using namespace GiNaC;
 
+#include <algorithm>
 #include <iostream>
 #include <vector>
 using namespace std;
 
-static unsigned test()
+static unsigned test(unsigned n)
 {
 	numeric x(13*17*31);
 	numeric y(13*19*29);
+	const unsigned a = n+(200%181), b = 2*n/3+(200%183);
 	
 	for (int i=1; i<200; ++i)
-		gcd(pow(x,300+(i%181)),pow(y,200+(i%183)));
+		gcd(pow(x,n+(i%181)),pow(y,2*n/3+(i%183)));
 	
-	ex lastgcd = gcd(pow(x,300+(200%181)),pow(y,200+(200%183)));
-	if (lastgcd != numeric("53174994123961114423610399251974962981084780166115806651505844915220196792416194060680805428433601792982500430324916963290494659936522782673704312949880308677990050199363768068005367578752699785180694630122629259539608472261461289805919741933")) {
-		clog << "gcd(" << x << "^" << 300+(200%181) << ","
-		     << y << "^" << 200+(200%183) << ") erroneously returned "
+	ex lastgcd = gcd(pow(x,a),pow(y,b));
+	if (n != 300) {
+		if (lastgcd != pow(numeric(13),std::min(a,b))) {
+			clog << "gcd(" << x << "^" << a << ","
+			     << y << "^" << b << ") erroneously returned "
+			     << lastgcd << endl;
+			return 1;
+		}
+	} else if (lastgcd != numeric("53174994123961114423610399251974962981084780166115806651505844915220196792416194060680805428433601792982500430324916963290494659936522782673704312949880308677990050199363768068005367578752699785180694630122629259539608472261461289805919741933")) {
+		clog << "gcd(" << x << "^" << a << ","
+		     << y << "^" << b << ") erroneously returned "
 		     << lastgcd << endl;
 		return 1;
 	}
@@ -49,22 +58,16 @@ static unsigned test()
 
 unsigned time_lw_C()
 {
-	unsigned result = 0;
-	unsigned count = 0;
-	timer rolex;
-	double time = .0;
-	
 	cout << "timing Lewis-Wester test C (gcd of big integers)" << flush;
 	
-	rolex.start();
-	// correct for very small times:
-	do {
-		result = test();
-		++count;
-	} while ((time=rolex.read())<0.1 && !result);
+	const benchmark_result r = run_benchmark("lw_C", test, 300u);
 	cout << '.' << flush;
-	cout << time/count << 's' << endl;
+	cout << r << endl;
+	if (r.failures)
+		return r.failures;
 	
+	static const unsigned sizes[] = { 150, 300, 600, 1200 };
+	unsigned result = run_scaling("lw_C", "n", test, sizes);
 	return result;
 }
 
@@ -72,6 +75,7 @@ extern void randomify_symbol_serials();
 
 int main(int argc, char** argv)
 {
+	parse_benchmark_options(argc, argv);
 	randomify_symbol_serials();
 	cout << setprecision(2) << showpoint;
 	return time_lw_C();
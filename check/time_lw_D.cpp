@@ -22,20 +22,20 @@
  */
 
 #include "ginac.h"
-#include "timer.h"
+#include "benchmark.h"
 using namespace GiNaC;
 
 #include <iostream>
 #include <vector>
 using namespace std;
 
-static unsigned test()
+static unsigned test(unsigned n)
 {
 	ex s;
 	symbol y("y");
 	symbol t("t");
 	
-	for (int i=1; i<=10; ++i)
+	for (unsigned i=1; i<=n; ++i)
 		s += i*y*pow(t,i)/pow(y + i*t,i);
 	
 	s = s.normal();
@@ -49,22 +49,17 @@ static unsigned test()
 
 unsigned time_lw_D()
 {
-	unsigned result = 0;
-	unsigned count = 0;
-	timer rolex;
-	double time = .0;
-	
 	cout << "timing Lewis-Wester test D (normalized sum of rational fcns)" << flush;
 	
-	rolex.start();
-	// correct for very small times:
-	do {
-		result = test();
-		++count;
-	} while ((time=rolex.read())<0.1 && !result);
+	const benchmark_result r = run_benchmark("lw_D", test, 10u);
 	cout << '.' << flush;
-	cout << time/count << 's' << endl;
+	cout << r << endl;
+	if (r.failures)
+		return r.failures;
 	
+	static const unsigned sizes[] = { 4, 6, 8, 10 };
+	unsigned result = run_scaling("lw_D", "n", test, sizes);
+	result += run_thread_sweep("lw_D", test, 10u, set_normal_threads);
 	return result;
 }
 
@@ -72,6 +67,7 @@ extern void randomify_symbol_serials();
 
 int main(int argc, char** argv)
 {
+	parse_benchmark_options(argc, argv);
 	randomify_symbol_serials();
 	cout << setprecision(2) << showpoint;
 	return time_lw_D();
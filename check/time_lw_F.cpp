@@ -22,23 +22,23 @@
  */
 
 #include "ginac.h"
-#include "timer.h"
+#include "benchmark.h"
 using namespace GiNaC;
 
 #include <iostream>
 #include <vector>
 using namespace std;
 
-static unsigned test()
+static unsigned test(unsigned k)
 {
 	symbol x("x");
 	symbol y("y");
 
-	ex p = expand(pow(pow(x,2)-3*x*y+pow(y,2),4)*pow(3*x-7*y+2,5));
-	ex q = expand(pow(pow(x,2)-3*x*y+pow(y,2),3)*pow(3*x-7*y-2,6));
+	ex p = expand(pow(pow(x,2)-3*x*y+pow(y,2),k+1)*pow(3*x-7*y+2,5));
+	ex q = expand(pow(pow(x,2)-3*x*y+pow(y,2),k)*pow(3*x-7*y-2,6));
 	ex result = gcd(p,q);
-	if (result!=expand(pow(pow(x,2)-3*x*y+pow(y,2),3))) {
-		clog << "gcd(expand((x^2-3*x*y+y^2)^4*(3*x-7*y+2)^5),expand((x^2-3*x*y+y^2)^3*(3*x-7*y-2)^6)) erroneously returned " << result << endl;
+	if (result!=expand(pow(pow(x,2)-3*x*y+pow(y,2),k))) {
+		clog << "gcd(expand((x^2-3*x*y+y^2)^" << k+1 << "*(3*x-7*y+2)^5),expand((x^2-3*x*y+y^2)^" << k << "*(3*x-7*y-2)^6)) erroneously returned " << result << endl;
 		return 1;
 	}
 	return 0;
@@ -46,22 +46,17 @@ static unsigned test()
 
 unsigned time_lw_F()
 {
-	unsigned result = 0;
-	unsigned count = 0;
-	timer rolex;
-	double time = .0;
-	
 	cout << "timing Lewis-Wester test F (gcd of 2-var polys)" << flush;
 	
-	rolex.start();
-	// correct for very small times:
-	do {
-		result = test();
-		++count;
-	} while ((time=rolex.read())<0.1 && !result);
+	const benchmark_result r = run_benchmark("lw_F", test, 3u);
 	cout << '.' << flush;
-	cout << time/count << 's' << endl;
+	cout << r << endl;
+	if (r.failures)
+		return r.failures;
 	
+	static const unsigned sizes[] = { 1, 2, 3, 4 };
+	unsigned result = run_scaling("lw_F", "k", test, sizes);
+	result += run_thread_sweep("lw_F", test, 3u, set_gcd_threads);
 	return result;
 }
 
@@ -69,6 +64,7 @@ extern void randomify_symbol_serials();
 
 int main(int argc, char** argv)
 {
+	parse_benchmark_options(argc, argv);
 	randomify_symbol_serials();
 	cout << setprecision(2) << showpoint;
 	return time_lw_F();
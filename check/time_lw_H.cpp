@@ -22,7 +22,7 @@
  */
 
 #include "ginac.h"
-#include "timer.h"
+#include "benchmark.h"
 using namespace GiNaC;
 
 #include <iostream>
@@ -61,22 +61,17 @@ static unsigned test(unsigned n)
 
 unsigned time_lw_H()
 {
-	unsigned result = 0;
-	unsigned count = 0;
-	timer rolex;
-	double time = .0;
-
 	cout << "timing Lewis-Wester test H (det of 80x80 Hilbert)" << flush;
 
-	rolex.start();
-	// correct for very small times:
-	do {
-		result = test(80);
-		++count;
-	} while ((time=rolex.read())<0.1 && !result);
+	const benchmark_result r = run_benchmark("lw_H", test, 80u);
 	cout << '.' << flush;
-	cout << time/count << 's' << endl;
+	cout << r << endl;
+	if (r.failures)
+		return r.failures;
 
+	static const unsigned sizes[] = { 20, 40, 60, 80 };
+	unsigned result = run_scaling("lw_H", "n", test, sizes);
+	result += run_thread_sweep("lw_H", test, 80u, set_matrix_threads);
 	return result;
 }
 
@@ -84,6 +79,7 @@ extern void randomify_symbol_serials();
 
 int main(int argc, char** argv)
 {
+	parse_benchmark_options(argc, argv);
 	randomify_symbol_serials();
 	cout << setprecision(2) << showpoint;
 	return time_lw_H();
@@ -22,33 +22,71 @@
  */
 
 #include "ginac.h"
-#include "timer.h"
+#include "benchmark.h"
 using namespace GiNaC;
 
 #include <iostream>
+#include <string>
 #include <vector>
 using namespace std;
 
+/** Inversion of a rank n Hilbert matrix. */
+class hilbert_inversion : public benchmark {
+public:
+	hilbert_inversion(unsigned n) : H(n,n), Hinv(n,n)
+	{
+		for (unsigned r=0; r<n; ++r)
+			for (unsigned c=0; c<n; ++c)
+				H.set(r,c,numeric(1,r+c+1));
+	}
+	unsigned run()
+	{
+		Hinv = H.inverse();
+		return 0;
+	}
+
+	matrix H, Hinv;
+};
+
+/** Check of the inverse by multiplication. */
+class hilbert_check : public benchmark {
+public:
+	hilbert_check(const hilbert_inversion & h) : H(h.H), Hinv(h.Hinv) {}
+	unsigned run()
+	{
+		const unsigned n = H.rows();
+		matrix identity = H.mul(Hinv);
+		for (unsigned r=0; r<n; ++r)
+			for (unsigned c=0; c<n; ++c)
+				if (identity(r,c) != (r==c ? 1 : 0))
+					return 1;
+		return 0;
+	}
+private:
+	const matrix & H, & Hinv;
+};
+
+/** Inversion of Hilbert matrices of several ranks. */
+class hilbert_inversion_scaling : public scalable_benchmark {
+public:
+	hilbert_inversion_scaling() : inversion(0) {}
+	void resize(unsigned n) { inversion = hilbert_inversion(n); }
+	unsigned run() { return inversion.run(); }
+private:
+	hilbert_inversion inversion;
+};
+
 static unsigned test(unsigned n)
 {
-	unsigned result = 0;
-	timer cartier;
 	char name = (n==40?'I':(n==70?'K':'?'));
 	
 	cout << "timing Lewis-Wester test " << name
 	     << " (invert rank " << n << " Hilbert)" << flush;
 	
-	// Create a rank n Hilbert matrix:
-	matrix H(n,n);
-	for (unsigned r=0; r<n; ++r)
-		for (unsigned c=0; c<n; ++c)
-			H.set(r,c,numeric(1,r+c+1));
-	// invert it:
-	cartier.start();
-	matrix Hinv(n,n);
-	Hinv = H.inverse();
+	hilbert_inversion inversion(n);
+	const benchmark_result inverted = run_benchmark(string("lw_") + name, inversion);
 	cout << ". passed ";
-	cout << cartier.read() << 's' << endl;
+	cout << inverted << endl;
 	
 	// check result:
 	name = (n==40?'J':(n==70?'L':'?'));
@@ -56,23 +94,15 @@ static unsigned test(unsigned n)
 	cout << "timing Lewis-Wester test " << name
 	     << " (check rank " << n << " Hilbert)" << flush;
 	
-	cartier.reset();
-	matrix identity = H.mul(Hinv);
-	bool correct = true;
-	for (unsigned r=0; r<n; ++r)
-		for (unsigned c=0; c<n; ++c) {
-			if (r==c) {
-				if (identity(r,c)!=1)
-					correct = false;
-			} else {
-				if (identity(r,c)!=0)
-					correct = false;
-			}
-		}
-	if (!correct)
-		++result;
-	cout << cartier.read() << 's' << endl;
-	return result;
+	if (inverted.skipped) {
+		// nothing to check
+		cout << "skipped" << endl;
+		return 0;
+	}
+	hilbert_check check(inversion);
+	const benchmark_result checked = run_benchmark(string("lw_") + name, check);
+	cout << checked << endl;
+	return checked.failures;
 }
 
 unsigned time_lw_IJKL()
@@ -83,6 +113,12 @@ unsigned time_lw_IJKL()
 	result += test(40);
 	// Tests K and L:
 	result += test(70);
+	if (result)
+		return result;
+	
+	hilbert_inversion_scaling inversions;
+	static const unsigned sizes[] = { 10, 20, 30, 40 };
+	result += run_scaling("lw_I", "n", inversions, vector<unsigned>(sizes, sizes + 4));
 	
 	return result;
 }
@@ -91,6 +127,7 @@ extern void randomify_symbol_serials();
 
 int main(int argc, char** argv)
 {
+	parse_benchmark_options(argc, argv);
 	randomify_symbol_serials();
 	cout << setprecision(2) << showpoint;
 	return time_lw_IJKL();
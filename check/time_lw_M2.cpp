@@ -22,7 +22,7 @@
  */
 
 #include "ginac.h"
-#include "timer.h"
+#include "benchmark.h"
 using namespace GiNaC;
 
 #include <iostream>
@@ -157,21 +157,16 @@ static unsigned test()
 unsigned time_lw_M2()
 {
 	unsigned result = 0;
-	unsigned count = 0;
-	timer piaget;
-	double time = .0;
 	
 	cout << "timing Lewis-Wester test M2 (101x101 sparse, det)" << flush;
 	
 	if (do_test) {
-		piaget.start();
-		// correct for very small times:
-		do {
-			result = test();
-			++count;
-		} while ((time=piaget.read())<0.1 && !result);
+		const benchmark_result r = run_benchmark("lw_M2", test);
 		cout << '.' << flush;
-		cout << time/count << 's' << endl;
+		cout << r << endl;
+		result = r.failures;
+		if (!result)
+			result += run_thread_sweep("lw_M2", test, set_matrix_threads);
 	} else {
 		cout << " disabled" << endl;
 	}
@@ -183,6 +178,7 @@ extern void randomify_symbol_serials();
 
 int main(int argc, char** argv)
 {
+	parse_benchmark_options(argc, argv);
 	randomify_symbol_serials();
 	cout << setprecision(2) << showpoint;
 	return time_lw_M2();
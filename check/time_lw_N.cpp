@@ -23,7 +23,7 @@
  */
 
 #include "ginac.h"
-#include "timer.h"
+#include "benchmark.h"
 using namespace GiNaC;
 
 #include <iostream>
@@ -61,21 +61,16 @@ static unsigned test()
 unsigned time_lw_N()
 {
 	unsigned result = 0;
-	unsigned count = 0;
-	timer tag_heuer;
-	double time = .0;
 	
 	cout << "timing Lewis-Wester test N (poly at rational fcns)" << flush;
 	
 	if (do_test) {
-		tag_heuer.start();
-		// correct for very small times:
-		do {
-			result = test();
-			++count;
-		} while ((time=tag_heuer.read())<0.1 && !result);
+		const benchmark_result r = run_benchmark("lw_N", test);
 		cout << '.' << flush;
-		cout << time/count << 's' << endl;
+		cout << r << endl;
+		result = r.failures;
+		if (!result)
+			result += run_thread_sweep("lw_N", test, set_normal_threads);
 	} else {
 		cout << " disabled" << endl;
 	}
@@ -87,6 +82,7 @@ extern void randomify_symbol_serials();
 
 int main(int argc, char** argv)
 {
+	parse_benchmark_options(argc, argv);
 	randomify_symbol_serials();
 	cout << setprecision(2) << showpoint;
 	return time_lw_N();
@@ -22,7 +22,7 @@
  */
 
 #include "ginac.h"
-#include "timer.h"
+#include "benchmark.h"
 using namespace GiNaC;
 
 #include <iostream>
@@ -133,32 +133,26 @@ static unsigned test_O2()
 
 unsigned time_lw_O()
 {
-	unsigned result = 0;
-	unsigned count = 0;
-	timer rolex;
-	double time = .0;
-
 	cout << "timing Lewis-Wester test O1 (three 15x15 dets)" << flush;
 
-	rolex.start();
-	// correct for very small times:
-	do {
-		result = test_O1();
-		++count;
-	} while ((time=rolex.read())<0.1 && !result);
-
+	const benchmark_result r1 = run_benchmark("lw_O1", test_O1);
+	unsigned result = r1.failures;
 	if (result)
 		return result;
 	
-	cout << time/(3*count) << "s (average)" << endl;
+	if (r1.skipped)
+		cout << r1 << endl;
+	else
+		cout << r1.time()/3 << "s (average)" << endl;
+	result += run_thread_sweep("lw_O1", test_O1, set_matrix_threads);
 
 	cout << "timing Lewis-Wester test O2 (Resultant)" << flush;
 
-	if (do_test2) {
-		rolex.reset();
-		result += test_O2();
+	if (do_test2 && !r1.skipped) {
+		const benchmark_result r2 = run_benchmark("lw_O2", test_O2);
+		result += r2.failures;
 
-		cout << rolex.read() << "s (combined)" << endl;
+		cout << r2 << " (combined)" << endl;
 	} else {
 		cout << " disabled" << endl;
 	}
@@ -170,6 +164,7 @@ extern void randomify_symbol_serials();
 
 int main(int argc, char** argv)
 {
+	parse_benchmark_options(argc, argv);
 	randomify_symbol_serials();
 	cout << setprecision(2) << showpoint;
 	return time_lw_O();
@@ -22,17 +22,16 @@
  */
 
 #include "ginac.h"
-#include "timer.h"
+#include "benchmark.h"
 using namespace GiNaC;
 
 #include <iostream>
 #include <vector>
 using namespace std;
 
-static unsigned test()
+static unsigned test(unsigned n)
 {
 	// This is a pattern that comes up in graph theory:
-	const unsigned n = 10;
 	matrix m(n*n+1,n*n+1);
 	for (unsigned i=1; i<=n*n; ++i)
 		m.set(i-1,i-1,1);
@@ -50,7 +49,7 @@ static unsigned test()
 	
 	ex det = m.determinant();
 	
-	if (det!=numeric("75810815066186520")) {
+	if (n == 10 && det!=numeric("75810815066186520")) {
 		clog << "det of sparse rank 101 matrix erroneously returned " << det << endl;
 		return 1;
 	}
@@ -59,21 +58,17 @@ static unsigned test()
 
 unsigned time_lw_P()
 {
-	unsigned result = 0;
-	unsigned count = 0;
-	timer rolex;
-	double time = .0;
-	
 	cout << "timing Lewis-Wester test P (det of sparse rank 101)" << flush;
 	
-	rolex.start();
-	// correct for very small times:
-	do {
-		result = test();
-		++count;
-	} while ((time=rolex.read())<0.1 && !result);
-	cout << time/count << 's' << endl;
+	const benchmark_result r = run_benchmark("lw_P", test, 10u);
+	cout << '.' << flush;
+	cout << r << endl;
+	if (r.failures)
+		return r.failures;
 	
+	static const unsigned sizes[] = { 4, 6, 8, 10 };
+	unsigned result = run_scaling("lw_P", "n", test, sizes);
+	result += run_thread_sweep("lw_P", test, 10u, set_matrix_threads);
 	return result;
 }
 
@@ -81,6 +76,7 @@ extern void randomify_symbol_serials();
 
 int main(int argc, char** argv)
 {
+	parse_benchmark_options(argc, argv);
 	randomify_symbol_serials();
 	cout << setprecision(2) << showpoint;
 	return time_lw_P();
@@ -22,7 +22,7 @@
  */
 
 #include "ginac.h"
-#include "timer.h"
+#include "benchmark.h"
 using namespace GiNaC;
 
 #include <iostream>
@@ -31,10 +31,9 @@ using namespace std;
 
 static const bool do_test = true;  // set to true in order to run this beast
 
-static unsigned test()
+static unsigned test(unsigned n)
 {
 	// same matrix as in test P':
-	const unsigned n = 10;
 	matrix m(n*n+1,n*n+1);
 	for (unsigned i=1; i<=n*n; ++i)
 		m.set(i-1,i-1,1);
@@ -55,7 +54,7 @@ static unsigned test()
 		a = m2(r,0);
 		for (unsigned c=0; c<n*n; ++c)
 			m2.set(r,c,m2(r,c+1));
-		m2.set(r,100,a);
+		m2.set(r,n*n,a);
 	}
 	for (unsigned r=0; r<=n*n; ++r)
 		for (unsigned c=0; c<=n*n; ++c)
@@ -65,7 +64,8 @@ static unsigned test()
 	symbol lambda("lambda");
 	ex cp = m2.charpoly(lambda);
 	
-	if (cp.coeff(lambda,0) != numeric("140816284877507872414776")) {
+	if (cp.degree(lambda) != int(n*n+1) ||
+	    (n == 10 && cp.coeff(lambda,0) != numeric("140816284877507872414776"))) {
 		clog << "characteristic polynomial miscalculated as " << cp << endl;
 		return 1;
 	}
@@ -75,21 +75,19 @@ static unsigned test()
 unsigned time_lw_Qprime()
 {
 	unsigned result = 0;
-	unsigned count = 0;
-	timer rolex;
-	double time = .0;
 	
 	cout << "timing Lewis-Wester test Q' (charpoly(P'))" << flush;
 	
 	if (do_test) {
-		rolex.start();
-		// correct for very small times:
-		do {
-			result = test();
-			++count;
-		} while ((time=rolex.read())<0.1 && !result);
+		const benchmark_result r = run_benchmark("lw_Qprime", test, 10u);
 		cout << '.' << flush;
-		cout << time/count << 's' << endl;
+		cout << r << endl;
+		result = r.failures;
+		if (!result) {
+			static const unsigned sizes[] = { 4, 6, 8, 10 };
+			result += run_scaling("lw_Qprime", "n", test, sizes);
+			result += run_thread_sweep("lw_Qprime", test, 10u, set_matrix_threads);
+		}
 	} else {
 		cout << " disabled" << endl;
 	}
@@ -101,6 +99,7 @@ extern void randomify_symbol_serials();
 
 int main(int argc, char** argv)
 {
+	parse_benchmark_options(argc, argv);
 	randomify_symbol_serials();
 	cout << setprecision(2) << showpoint;
 	return time_lw_Qprime();
@@ -21,7 +21,7 @@
  */
 
 #include "ginac.h"
-#include "timer.h"
+#include "benchmark.h"
 using namespace GiNaC;
 
 #include <cstddef>
@@ -45,18 +45,22 @@ static string prepare_str(const unsigned n, const char x = 'x')
 	return s.str();
 }
 
-static double benchmark_and_cmp(const string& srep)
-{
+class parse_timing : public benchmark {
+public:
+	parse_timing(const string& srep_) : srep(srep_) {}
+	unsigned run()
+	{
+		ex e = the_parser(srep);
+		return 0;
+	}
+private:
 	parser the_parser;
-	timer RSD10;
-	RSD10.start();
-	ex e = the_parser(srep);
-	const double t = RSD10.read();
-	return t;
-}
+	const string& srep;
+};
 
 int main(int argc, char** argv)
 {
+	parse_benchmark_options(argc, argv);
 	cout << "timing GiNaC parser..." << flush;
 	randomify_symbol_serials();
 	unsigned n_min = 1024;
@@ -64,17 +68,17 @@ int main(int argc, char** argv)
 	if (argc > 1)
 		n_max = atoi(argv[1]);
 
-	vector<double> times;
+	vector<benchmark_result> times;
 	vector<unsigned> ns;
 	for (unsigned n = n_min; n <= n_max; n = n << 1) {
 		string srep = prepare_str(n);
-		const double t = benchmark_and_cmp(srep);
-		times.push_back(t);
+		parse_timing t(srep);
+		times.push_back(run_benchmark(benchmark_name("parser", n), t));
 		ns.push_back(n);
 	}
 
 	cout << "OK" << endl;
-	cout << "# terms  time, s" << endl;
+	cout << "# terms  time" << endl;
 	for (size_t i = 0; i < times.size(); i++)
 		cout << " " << ns[i] << '\t' << times[i] << endl;
 	return 0;
@@ -24,7 +24,7 @@
  */
 
 #include "ginac.h"
-#include "timer.h"
+#include "benchmark.h"
 using namespace GiNaC;
 
 #include <iostream>
@@ -77,8 +77,7 @@ unsigned time_toeplitz()
 	cout << "timing determinant of polyvariate symbolic Toeplitz matrices" << flush;
 
 	vector<unsigned> sizes;
-	vector<double> times;
-	timer longines;
+	vector<benchmark_result> times;
 
 	sizes.push_back(7);
 	sizes.push_back(8);
@@ -86,15 +85,9 @@ unsigned time_toeplitz()
 	sizes.push_back(10);
 
 	for (vector<unsigned>::iterator i=sizes.begin(); i!=sizes.end(); ++i) {
-		int count = 1;
-		longines.start();
-		result += toeplitz_det(*i);
-		// correct for very small times:
-		while (longines.read()<0.1) {
-			toeplitz_det(*i);
-			++count;
-		}
-		times.push_back(longines.read()/count);
+		const benchmark_result r = run_benchmark(benchmark_name("toeplitz", *i), toeplitz_det, *i);
+		result += r.failures;
+		times.push_back(r);
 		cout << '.' << flush;
 	}
 
@@ -102,8 +95,8 @@ unsigned time_toeplitz()
 	cout << endl << "	dim:   ";
 	for (vector<unsigned>::iterator i=sizes.begin(); i!=sizes.end(); ++i)
 		cout << '\t' << *i << 'x' << *i;
-	cout << endl << "	time/s:";
-	for (vector<double>::iterator i=times.begin(); i!=times.end(); ++i)
+	cout << endl << "	time:  ";
+	for (vector<benchmark_result>::iterator i=times.begin(); i!=times.end(); ++i)
 		cout << '\t' << *i;
 	cout << endl;
 
@@ -114,6 +107,7 @@ extern void randomify_symbol_serials();
 
 int main(int argc, char** argv)
 {
+	parse_benchmark_options(argc, argv);
 	randomify_symbol_serials();
 	cout << setprecision(2) << showpoint;
 	return time_toeplitz();
@@ -21,7 +21,6 @@
  */
 
 #include "ginac.h"
-#include "timer.h"
 #include "error_report.h"
 #include "test_runner.h"
 #include "polynomial/remainder.h"
@@ -1838,27 +1837,28 @@ run_test(const std::string& s1, const std::string& s2,
 
 	std::cout << "Non-trivial GCD, degree(a) = " << degree(a) <<
 		", degree(b) = " << degree(b) << std::endl << std::flush;
+	const std::string name = benchmark_name("uvar_gcd", degree(a));
 	
 	mod_gcd_test b_mod_gcd(a, b);
-	run_benchmark(b_mod_gcd);
+	run_benchmark(name + "_mod_gcd", b_mod_gcd);
 
 	heur_gcd_test b_heur_gcd(a, b, b_mod_gcd.g); 
-	run_benchmark(b_heur_gcd);
+	run_benchmark(name + "_heur_gcd", b_heur_gcd);
 
 	// Compute GCD using heuristic algorithm which operates on ex
 	ex_sr_gcd_test b_ex_sr_gcd2(ea, eb, b_mod_gcd.g);
 	b_ex_sr_gcd2.options = 0;
-	run_benchmark(b_ex_sr_gcd2);
+	run_benchmark(name + "_heur_gcd_ex", b_ex_sr_gcd2);
 
 	if (use_sr_gcd) {
 		sr_gcd_test b_sr_gcd(a, b, b_mod_gcd.g);
-		run_benchmark(b_sr_gcd);
+		run_benchmark(name + "_sr_gcd", b_sr_gcd);
 	}
 
 	// GiNaC::sr_gcd (which operates on ex) is way too slow.
 	if (use_ex_sr_gcd) {
 		ex_sr_gcd_test b_ex_sr_gcd(ea, eb, b_mod_gcd.g);
-		run_benchmark(b_ex_sr_gcd);
+		run_benchmark(name + "_sr_gcd_ex", b_ex_sr_gcd);
 	}
 }
 
@@ -1873,16 +1873,42 @@ run_with_random_intputs(const unsigned d1, const unsigned d2)
 		", degree(b) = " << d2 << std::endl << std::flush;
 	upoly a = make_random_upoly(d1);
 	upoly b = make_random_upoly(d2);
+	const std::string name = benchmark_name("uvar_gcd_coprime", d1);
 	mod_gcd_test b_mod(a, b);
-	run_benchmark(b_mod);
+	run_benchmark(name + "_mod_gcd", b_mod);
 	heur_gcd_test b_heur(a, b, b_mod.g);
-	run_benchmark(b_heur);
+	run_benchmark(name + "_heur_gcd", b_heur);
 	sr_gcd_test b_sr(a, b, b_mod.g);
-	run_benchmark(b_sr);
+	run_benchmark(name + "_sr_gcd", b_sr);
+}
+
+// High degree inputs with a common factor, where mod_gcd uses the half-GCD
+// algorithm for the images. Only mod_gcd is timed, the other algorithms
+// are way too slow for such degrees.
+static void
+run_with_high_degree_inputs(const unsigned d1, const unsigned d2, const unsigned dg)
+{
+	std::cout << "GCD of high degree polynomials a and b" <<
+		std::endl << "degree(a) = " << d1 + dg <<
+		", degree(b) = " << d2 + dg << std::endl << std::flush;
+	const upoly g = make_random_upoly(dg);
+	const upoly a = make_random_upoly(d1);
+	const upoly b = make_random_upoly(d2);
+	upoly ag(a.size() + g.size() - 1), bg(b.size() + g.size() - 1);
+	for (std::size_t i = 0; i < g.size(); ++i) {
+		for (std::size_t j = 0; j < a.size(); ++j)
+			ag[i + j] = ag[i + j] + g[i]*a[j];
+		for (std::size_t j = 0; j < b.size(); ++j)
+			bg[i + j] = bg[i + j] + g[i]*b[j];
+	}
+	const std::string name = benchmark_name("uvar_gcd_high", d1 + dg);
+	mod_gcd_test b_mod(ag, bg);
+	run_benchmark(name + "_mod_gcd", b_mod);
 }
 
 int main(int argc, char** argv)
 {
+	parse_benchmark_options(argc, argv);
 	std::cout << "timing univarite GCD" << std::endl << std::flush;
 	run_with_random_intputs(100, 50);
 	// run PRS gcd tests, both with upoly and ex
@@ -1893,6 +1919,8 @@ int main(int argc, char** argv)
 	run_test(q1_srep_1 + q1_srep_2, q2_srep_1 + q2_srep_2, tolerant_p, masochist_p);
 	// ditto
 	run_test(r1_srep_1 + r1_srep_2 + r1_srep_3, r2_srep_1 + r2_srep_2 + r2_srep_3, masochist_p, masochist_p);
+	if (tolerant_p)
+		run_with_high_degree_inputs(1000, 900, 300);
 	std::cout << ". " << std::flush;
 	return 0;
 }
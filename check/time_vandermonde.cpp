@@ -25,7 +25,7 @@
  */
 
 #include "ginac.h"
-#include "timer.h"
+#include "benchmark.h"
 using namespace GiNaC;
 
 #include <iostream>
@@ -74,8 +74,7 @@ unsigned time_vandermonde()
 	cout << "timing determinant of univariate symbolic Vandermonde matrices" << flush;
 	
 	vector<unsigned> sizes;
-	vector<double> times;
-	timer swatch;
+	vector<benchmark_result> times;
 	
 	sizes.push_back(8);
 	sizes.push_back(10);
@@ -83,15 +82,9 @@ unsigned time_vandermonde()
 	sizes.push_back(14);
 	
 	for (vector<unsigned>::iterator i=sizes.begin(); i!=sizes.end(); ++i) {
-		int count = 1;
-		swatch.start();
-		result += vandermonde_det(*i);
-		// correct for very small times:
-		while (swatch.read()<0.02) {
-			vandermonde_det(*i);
-			++count;
-		}
-		times.push_back(swatch.read()/count);
+		const benchmark_result r = run_benchmark(benchmark_name("vandermonde", *i), vandermonde_det, *i);
+		result += r.failures;
+		times.push_back(r);
 		cout << '.' << flush;
 	}
 	
@@ -99,8 +92,8 @@ unsigned time_vandermonde()
 	cout << endl << "	dim:   ";
 	for (vector<unsigned>::iterator i=sizes.begin(); i!=sizes.end(); ++i)
 		cout << '\t' << *i << 'x' << *i;
-	cout << endl << "	time/s:";
-	for (vector<double>::iterator i=times.begin(); i!=times.end(); ++i)
+	cout << endl << "	time:  ";
+	for (vector<benchmark_result>::iterator i=times.begin(); i!=times.end(); ++i)
 		cout << '\t' << *i;
 	cout << endl;
 	
@@ -111,6 +104,7 @@ extern void randomify_symbol_serials();
 
 int main(int argc, char** argv)
 {
+	parse_benchmark_options(argc, argv);
 	randomify_symbol_serials();
 	cout << setprecision(2) << showpoint;
 	return time_vandermonde();
@@ -29,11 +29,23 @@
 #include "clifford.h"
 #include "ncmul.h"
 #include "compiler.h"
+#include "tasks.h"
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
 
+#include <fstream>
 #include <iostream>
 #include <limits>
+#include <sstream>
 #include <stdexcept>
 #include <string>
+#include <vector>
+#if defined(GINAC_THREADSAFE_REFCOUNT) && defined(HAVE_PTHREAD_H)
+// The shards of a sum are only printed concurrently if expressions may be
+// shared between threads at all.
+#define PARALLEL_PRINT 1
+#endif
 
 namespace GiNaC {
 
@@ -90,7 +102,7 @@ add::add(std::auto_ptr<epvector> vp, const ex & oc)
 {
 	GINAC_ASSERT(vp.get()!=0);
 	overall_coeff = oc;
-	construct_from_epvector(*vp);
+	construct_from_epvector(vp);
 	GINAC_ASSERT(is_canonical());
 }
 
@@ -111,19 +123,27 @@ void add::print_add(const print_context & c, const char *openbrace, const char *
 	if (precedence() <= level)
 		c.s << openbrace << '(';
 
-	numeric coeff;
+	print_terms(c, seq.begin(), seq.end(), true, mul_sym);
+
+	if (precedence() <= level)
+		c.s << ')' << closebrace;
+}
+
+/** Print the terms [it, itend) of a sum, which need not be the terms of
+ *  this sum, without parentheses. */
+void add::print_terms(const print_context & c, epvector::const_iterator it, epvector::const_iterator itend, bool with_overall_coeff, const char *mul_sym) const
+{
 	bool first = true;
 
 	// First print the overall numeric coefficient, if present
-	if (!overall_coeff.is_zero()) {
+	if (with_overall_coeff && !overall_coeff.is_zero()) {
 		overall_coeff.print(c, 0);
 		first = false;
 	}
 
 	// Then proceed with the remaining factors
-	epvector::const_iterator it = seq.begin(), itend = seq.end();
 	while (it != itend) {
-		coeff = ex_to<numeric>(it->coeff);
+		const numeric & coeff = ex_to<numeric>(it->coeff);
 		if (!first) {
 			if (coeff.csgn() == -1) c.s << '-'; else c.s << '+';
 		} else {
@@ -149,8 +169,9 @@ void add::print_add(const print_context & c, const char *openbrace, const char *
 		++it;
 	}
 
-	if (precedence() <= level)
-		c.s << ')' << closebrace;
+	// Nothing at all is printed as an empty sum
+	if (first)
+		c.s << '0';
 }
 
 void add::do_print(const print_context & c, unsigned level) const
@@ -272,6 +293,8 @@ bool add::is_polynomial(const ex & var) const
 
 int add::degree(const ex & s) const
 {
+	if (lacks_symbol(ex_to<basic>(s)))
+		return 0;
 	int deg = std::numeric_limits<int>::min();
 	if (!overall_coeff.is_zero())
 		deg = 0;
@@ -289,6 +312,8 @@ int add::degree(const ex & s) const
 
 int add::ldegree(const ex & s) const
 {
+	if (lacks_symbol(ex_to<basic>(s)))
+		return 0;
 	int deg = std::numeric_limits<int>::max();
 	if (!overall_coeff.is_zero())
 		deg = 0;
@@ -306,6 +331,8 @@ int add::ldegree(const ex & s) const
 
 ex add::coeff(const ex & s, int n) const
 {
+	if (lacks_symbol(ex_to<basic>(s)))
+		return n==0 ? ex(*this) : _ex0;
 	std::auto_ptr<epvector> coeffseq(new epvector);
 	std::auto_ptr<epvector> coeffseq_cliff(new epvector);
 	int rl = clifford_max_label(s);
@@ -404,6 +431,18 @@ ex add::eval(int level) const
 	return this->hold();
 }
 
+std::complex<double> add::evalf_double(const evalf_double_map & values) const
+{
+	std::complex<double> result = ex_to<numeric>(overall_coeff).evalf_double(values);
+	for (epvector::const_iterator i = seq.begin(); i != seq.end(); ++i) {
+		if (i->coeff.is_equal(_ex1))
+			result += i->rest.evalf_double(values);
+		else
+			result += i->rest.evalf_double(values) * ex_to<numeric>(i->coeff).evalf_double(values);
+	}
+	return result;
+}
+
 ex add::evalm() const
 {
 	// Evaluate children first and add up all matrices. Stop if there's one
@@ -512,6 +551,8 @@ ex add::eval_ncmul(const exvector & v) const
  *  @see ex::diff */
 ex add::derivative(const symbol & y) const
 {
+	if (lacks_symbol(y))
+		return _ex0;
 	std::auto_ptr<epvector> s(new epvector);
 	s->reserve(seq.size());
 	
@@ -633,4 +674,205 @@ ex add::expand(unsigned options) const
 	return (new add(vp, overall_coeff))->setflag(status_flags::dynallocated | (options == 0 ? status_flags::expanded : 0));
 }
 
+//////////
+// add_builder
+//////////
+
+void add_builder::add_term(const ex & e, const numeric & c)
+{
+	if (c.is_zero())
+		return;
+	if (is_exactly_a<numeric>(e)) {
+		overall_coeff = overall_coeff.add(ex_to<numeric>(e).mul(c));
+		return;
+	}
+	if (is_exactly_a<add>(e)) {
+		const add & s = ex_to<add>(e);
+		for (epvector::const_iterator i = s.seq.begin(); i != s.seq.end(); ++i)
+			add_term(i->rest, ex_to<numeric>(i->coeff).mul(c));
+		overall_coeff = overall_coeff.add(ex_to<numeric>(s.overall_coeff).mul(c));
+		return;
+	}
+
+	ex rest = e;
+	numeric coeff = c;
+	if (is_exactly_a<mul>(e) && !ex_to<mul>(e).overall_coeff.is_equal(_ex1)) {
+		// Split off the numeric factor, like add::split_ex_to_pair()
+		const mul & m = ex_to<mul>(e);
+		mul * p = new mul(m);
+		p->overall_coeff = _ex1;
+		p->clearflag(status_flags::evaluated | status_flags::hash_calculated);
+		p->setflag(status_flags::dynallocated);
+		rest = *p;
+		coeff = coeff.mul(ex_to<numeric>(m.overall_coeff));
+	}
+
+	const std::pair<exhashmap<size_t>::iterator, bool> pos = position.insert(std::make_pair(rest, terms.size()));
+	if (pos.second)
+		terms.push_back(expair(rest, coeff));
+	else {
+		ex & sum = terms[pos.first->second].coeff;
+		sum = ex_to<numeric>(sum).add_dyn(coeff);
+	}
+}
+
+ex add_builder::result() const
+{
+	std::auto_ptr<epvector> vp(new epvector);
+	vp->reserve(terms.size());
+	for (epvector::const_iterator i = terms.begin(); i != terms.end(); ++i)
+		if (!ex_to<numeric>(i->coeff).is_zero())
+			vp->push_back(*i);
+	return (new add(vp, overall_coeff))->setflag(status_flags::dynallocated);
+}
+
+void add_builder::clear()
+{
+	terms.clear();
+	position.clear();
+	overall_coeff = *_num0_p;
+}
+
+//////////
+// utility functions
+//////////
+
+namespace {
+
+/** Printing of a slice of the terms of a sum, to be run as a task.  All but
+ *  the first one print copies of the terms, which share no numbers with the
+ *  sum. */
+struct print_shard_job {
+	const add * sum;
+	epvector terms;
+	epvector::const_iterator begin;
+	epvector::const_iterator end;
+	bool with_overall_coeff;
+	std::ostream * os;
+	bool failed;
+};
+
+void * run_print_shard_job(void * arg)
+{
+	print_shard_job & job = *static_cast<print_shard_job *>(arg);
+	try {
+		print_dflt c(*job.os);
+		job.sum->print_terms(c, job.begin, job.end, job.with_overall_coeff, "*");
+	} catch (...) {
+		job.failed = true;
+	}
+	return 0;
+}
+
+} // anonymous namespace
+
+void print_shards(const ex & e, const std::vector<std::ostream *> & streams)
+{
+	if (streams.empty())
+		throw std::invalid_argument("print_shards(): no shards");
+	if (!is_exactly_a<add>(e)) {
+		e.print(print_dflt(*streams[0]));
+		for (std::size_t k = 1; k < streams.size(); ++k)
+			*streams[k] << '0';
+		return;
+	}
+
+	const add & sum = ex_to<add>(e);
+	const std::size_t nshards = streams.size();
+	const std::size_t nterms = sum.seq.size();
+	std::vector<print_shard_job> jobs(nshards);
+	for (std::size_t k = 0; k < nshards; ++k) {
+		print_shard_job & job = jobs[k];
+		job.sum = &sum;
+		job.begin = sum.seq.begin() + nterms * k / nshards;
+		job.end = sum.seq.begin() + nterms * (k + 1) / nshards;
+		job.with_overall_coeff = (k == 0);
+		job.os = streams[k];
+		job.failed = false;
+	}
+
+#ifdef PARALLEL_PRINT
+	// Shards whose terms can not be copied are printed afterwards
+	std::vector<void *> args(1, &jobs[0]);
+	std::vector<std::size_t> uncopied;
+	for (std::size_t k = 1; k < nshards; ++k) {
+		print_shard_job & job = jobs[k];
+		job.terms.reserve(job.end - job.begin);
+		bool copied = true;
+		for (epvector::const_iterator it = job.begin; it != job.end; ++it) {
+			ex rest, coeff;
+			if (!copy_numbers(it->rest, rest) || !copy_numbers(it->coeff, coeff)) {
+				copied = false;
+				break;
+			}
+			job.terms.push_back(expair(rest, coeff));
+		}
+		if (copied) {
+			job.begin = job.terms.begin();
+			job.end = job.terms.end();
+			args.push_back(&job);
+		} else
+			uncopied.push_back(k);
+	}
+	run_tasks(run_print_shard_job, &args[0], args.size());
+	for (std::size_t i = 0; i < uncopied.size(); ++i)
+		run_print_shard_job(&jobs[uncopied[i]]);
+#else
+	for (std::size_t k = 0; k < nshards; ++k)
+		run_print_shard_job(&jobs[k]);
+#endif
+
+	for (std::size_t k = 0; k < nshards; ++k)
+		if (jobs[k].failed)
+			throw std::runtime_error("print_shards(): printing failed");
+}
+
+void print_shards(const ex & e, std::vector<std::string> & shards, unsigned n)
+{
+	if (n == 0)
+		n = 1;
+	std::vector<std::ostringstream *> buffers(n);
+	std::vector<std::ostream *> streams(n);
+	try {
+		for (unsigned k = 0; k < n; ++k)
+			streams[k] = buffers[k] = new std::ostringstream;
+		print_shards(e, streams);
+		shards.resize(n);
+		for (unsigned k = 0; k < n; ++k)
+			shards[k] = buffers[k]->str();
+	} catch (...) {
+		for (unsigned k = 0; k < n; ++k)
+			delete buffers[k];
+		throw;
+	}
+	for (unsigned k = 0; k < n; ++k)
+		delete buffers[k];
+}
+
+void print_shards(const ex & e, const std::vector<std::string> & filenames)
+{
+	const std::size_t n = filenames.size();
+	std::vector<std::ofstream *> files(n);
+	std::vector<std::ostream *> streams(n);
+	try {
+		for (std::size_t k = 0; k < n; ++k) {
+			streams[k] = files[k] = new std::ofstream(filenames[k].c_str());
+			if (!*files[k])
+				throw std::runtime_error("print_shards(): can not write " + filenames[k]);
+		}
+		print_shards(e, streams);
+		for (std::size_t k = 0; k < n; ++k) {
+			files[k]->close();
+			if (!*files[k])
+				throw std::runtime_error("print_shards(): can not write " + filenames[k]);
+		}
+	} catch (...) {
+		for (std::size_t k = 0; k < n; ++k)
+			delete files[k];
+		throw;
+	}
+	for (std::size_t k = 0; k < n; ++k)
+		delete files[k];
+}
+
 } // namespace GiNaC
@@ -24,6 +24,11 @@
 #define GINAC_ADD_H
 
 #include "expairseq.h"
+#include "hash_map.h"
+
+#include <iosfwd>
+#include <string>
+#include <vector>
 
 namespace GiNaC {
 
@@ -34,6 +39,7 @@ class add : public expairseq
 	
 	friend class mul;
 	friend class power;
+	friend class add_builder;
 	
 	// other constructors
 public:
@@ -52,6 +58,7 @@ public:
 	int ldegree(const ex & s) const;
 	ex coeff(const ex & s, int n=1) const;
 	ex eval(int level=0) const;
+	std::complex<double> evalf_double(const evalf_double_map & values) const;
 	ex evalm() const;
 	ex series(const relational & r, int order, unsigned options = 0) const;
 	ex normal(exmap & repl, exmap & rev_lookup, int level=0) const;
@@ -78,15 +85,77 @@ protected:
 	ex expand(unsigned options=0) const;
 
 	// non-virtual functions in this class
+public:
+	void print_terms(const print_context & c, epvector::const_iterator it, epvector::const_iterator itend, bool with_overall_coeff, const char *mul_sym) const;
 protected:
 	void print_add(const print_context & c, const char *openbrace, const char *closebrace, const char *mul_sym, unsigned level) const;
 	void do_print(const print_context & c, unsigned level) const;
 	void do_print_latex(const print_latex & c, unsigned level) const;
 	void do_print_csrc(const print_csrc & c, unsigned level) const;
 	void do_print_python_repr(const print_python_repr & c, unsigned level) const;
+
+	friend void print_shards(const ex & e, const std::vector<std::ostream *> & streams);
+	friend bool strip_content(const add & a, numeric & c, ex & prim);
 };
 GINAC_DECLARE_UNARCHIVER(add);
 
+/** Accumulates the terms of a large sum and builds it in one go.  Adding
+ *  n terms to an ex one by one with += merges every term into a new sum,
+ *  which costs O(n^2); add_builder combines equal terms by hashing as they
+ *  come in and sorts them once when result() is called.
+ *
+ *  @code
+ *  add_builder b;
+ *  for (int i = 0; i < n; ++i)
+ *      b += pow(x, i) / (i + 1);
+ *  ex e = b.result();
+ *  @endcode */
+class add_builder {
+	friend class disk_add_builder;
+public:
+	add_builder() : overall_coeff(0) { }
+
+	/** Add e.  The terms of sums are added one by one. */
+	add_builder & operator+=(const ex & e) { add_term(e, 1); return *this; }
+
+	/** Subtract e. */
+	add_builder & operator-=(const ex & e) { add_term(e, -1); return *this; }
+
+	/** Add c*e. */
+	void add_term(const ex & e, const numeric & c);
+
+	/** Number of distinct terms which are not numbers. */
+	size_t size() const { return terms.size(); }
+
+	/** The sum of everything added so far. */
+	ex result() const;
+
+	/** Start a new sum. */
+	void clear();
+
+private:
+	epvector terms;                ///< rest and numeric coefficient, some may be zero
+	exhashmap<size_t> position;    ///< index in terms by rest
+	numeric overall_coeff;
+};
+
+// utility functions
+
+/** Print the terms of the sum e into the streams, one shard of about equal
+ *  size into each stream, such that each shard is an expression and the
+ *  shards add up to e (see parser::parse_shards()).  The shards are printed
+ *  concurrently if GiNaC was built with GINAC_THREADSAFE_REFCOUNT and
+ *  pthreads.  If e is not a sum, it goes into the first shard and the other
+ *  ones are "0". */
+extern void print_shards(const ex & e, const std::vector<std::ostream *> & streams);
+
+/** Print the terms of the sum e into n strings, see above. */
+extern void print_shards(const ex & e, std::vector<std::string> & shards, unsigned n);
+
+/** Print the terms of the sum e into the named files, see above.
+ *  @exception std::runtime_error (a file can not be written) */
+extern void print_shards(const ex & e, const std::vector<std::string> & filenames);
+
 } // namespace GiNaC
 
 #endif // ndef GINAC_ADD_H
@@ -24,14 +24,35 @@
 #include "registrar.h"
 #include "ex.h"
 #include "lst.h"
+#include "symbol.h"
 #ifdef HAVE_CONFIG_H
 #include "config.h"
 #endif
 #include "tostring.h"
+#include "tasks.h"
+#include "utils.h"
 #include "version.h"
 
+#include <algorithm>
+#include <cstring>
+#include <fstream>
 #include <iostream>
+#include <sstream>
 #include <stdexcept>
+#ifdef HAVE_ZLIB_H
+#include <zlib.h>
+#endif
+#if defined(GINAC_THREADSAFE_REFCOUNT) && defined(HAVE_PTHREAD_H)
+// The operands of an archived expression are only unarchived concurrently
+// if expressions may be shared between threads at all.
+#define PARALLEL_UNARCHIVE 1
+#endif
+#ifdef HAVE_SYS_MMAN_H
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
 
 namespace GiNaC {
 
@@ -56,22 +77,81 @@ archive_node_id archive::add_node(const archive_node &n)
 	// Look if expression is known to be in some node already.
 	if (n.has_ex()) {
 		mapit i = exprtable.find(n.get_ex());
-		if (i != exprtable.end())
+		if (i != exprtable.end()) {
+			++dedup_hits;
 			return i->second;
-		nodes.push_back(n);
-		exprtable[n.get_ex()] = nodes.size() - 1;
-		return nodes.size() - 1;
+		}
+	}
+
+	// Write node to the stream given to start_indexed()
+	if (out.os) {
+		archive_node_id id = out.node_offsets.size();
+		out.node_offsets.push_back(out.next_offset());
+		write_node(out.block, n);
+		std::size_t file_pos = out.file_pos;
+		out.added();
+		bytes_written += out.file_pos - file_pos;
+		if (n.has_ex())
+			exprtable[n.get_ex()] = id;
+		return id;
 	}
 
-	// Not found, add archive_node to nodes vector
+	// Not found, add archive_node to nodes vector (its IDs follow the
+	// ones of the nodes of a loaded indexed archive)
 	nodes.push_back(n);
-	return nodes.size()-1;
+	archive_node_id id = mapped->num_nodes + nodes.size() - 1;
+	if (n.has_ex())
+		exprtable[n.get_ex()] = id;
+	return id;
 }
 
 
+/** Read unsigned integer quantity from memory, not going past the end. */
+static unsigned read_unsigned(const unsigned char *&p, const unsigned char *end)
+{
+	unsigned char b;
+	unsigned ret = 0;
+	unsigned shift = 0;
+	do {
+		if (p == end)
+			throw (std::runtime_error("archive file is truncated"));
+		b = *p++;
+		ret |= (b & 0x7f) << shift;
+		shift += 7;
+	} while (b & 0x80);
+	return ret;
+}
+
 /** Retrieve archive_node by ID. */
 archive_node &archive::get_node(archive_node_id id)
 {
+	return const_cast<archive_node &>(static_cast<const archive &>(*this).get_node(id));
+}
+
+/** Retrieve archive_node by ID. Nodes of an archive loaded with
+ *  load_indexed() are decoded on first use. */
+const archive_node &archive::get_node(archive_node_id id) const
+{
+	if (id < mapped->num_nodes) {
+		std::map<archive_node_id, archive_node>::const_iterator i = mapped_nodes.find(id);
+		if (i != mapped_nodes.end())
+			return i->second;
+
+		const unsigned char *end;
+		const unsigned char *p = mapped->bytes(mapped->entry(mapped->node_table, id), end);
+		archive_node n(const_cast<archive &>(*this));
+		unsigned num_props = read_unsigned(p, end);
+		n.props.resize(num_props);
+		for (unsigned j=0; j<num_props; j++) {
+			unsigned name_type = read_unsigned(p, end);
+			n.props[j].type = (archive_node::property_type)(name_type & 7);
+			n.props[j].name = name_type >> 3;
+			n.props[j].value = read_unsigned(p, end);
+		}
+		return mapped_nodes.insert(std::make_pair(id, n)).first->second;
+	}
+
+	id -= mapped->num_nodes;
 	if (id >= nodes.size())
 		throw (std::range_error("archive::get_node(): archive node ID out of range"));
 
@@ -79,6 +159,173 @@ archive_node &archive::get_node(archive_node_id id)
 }
 
 
+static unsigned unarchive_threads = 1;
+
+/** Set the number of threads unarchive_ex() uses for the operands of the
+ *  archived expression (e.g. the terms of a sum).  This has an effect only
+ *  if GiNaC was built with GINAC_THREADSAFE_REFCOUNT and pthreads, and
+ *  requires the read_archive() methods of all classes involved to be
+ *  thread-safe (which those of GiNaC's own classes are).
+ *
+ *  @return previous setting */
+unsigned set_unarchive_threads(unsigned n)
+{
+	const unsigned previous = unarchive_threads;
+	unarchive_threads = (n == 0 ? 1 : n);
+	return previous;
+}
+
+/** Get the number of threads used by unarchive_ex(). */
+unsigned get_unarchive_threads()
+{
+	return unarchive_threads;
+}
+
+#ifdef PARALLEL_UNARCHIVE
+
+namespace {
+
+/** Expressions with fewer operands are unarchived by the calling thread
+ *  alone. */
+const std::size_t min_parallel_operands = 16;
+
+typedef std::map<const archive_node *, ex> unarchived_map;
+
+/** Copies of the expressions of nodes shared between threads, which
+ *  archive_node::unarchive() returns instead of the cached ones in all but
+ *  the calling thread, so that no CLN number is shared. */
+__thread const unarchived_map *shared_copies = 0;
+
+/** Unarchiving of a slice of the operands of the root node, to be run as
+ *  a task. */
+struct unarchive_job {
+	const archive *a;
+	std::vector<archive_node_id> operands;
+	unarchived_map copies;
+	lst sym_lst;
+	bool failed;
+};
+
+void * run_unarchive_job(void * arg)
+{
+	unarchive_job & job = *static_cast<unarchive_job *>(arg);
+	shared_copies = job.copies.empty() ? 0 : &job.copies;
+	try {
+		for (std::vector<archive_node_id>::const_iterator i = job.operands.begin(); i != job.operands.end(); ++i)
+			job.a->get_node(*i).unarchive(job.sym_lst);
+	} catch (...) {
+		job.failed = true;
+	}
+	shared_copies = 0;
+	return 0;
+}
+
+} // anonymous namespace
+
+/** Unarchive the operands of the root node concurrently.  All nodes below
+ *  the root are decoded first, and nodes that are referred to more than
+ *  once, as well as symbols (which are merged by name through sym_lst),
+ *  are unarchived by the calling thread, so that every other node belongs
+ *  to exactly one task.  The first slice of operands is done by the
+ *  calling thread.
+ *  @return false if the operands have to be unarchived one by one instead */
+bool archive::unarchive_operands_parallel(const archive_node &root, lst &sym_lst) const
+{
+	std::vector<archive_node_id> operands;
+	for (archive_node::archive_node_cit i = root.props.begin(); i != root.props.end(); ++i)
+		if (i->type == archive_node::PTYPE_NODE)
+			operands.push_back(i->value);
+	if (operands.size() < min_parallel_operands)
+		return false;
+
+	// Decode the nodes below the root and their atoms, and count the
+	// references to each of them
+	std::vector<unsigned> refs(total_nodes(), 0);
+	std::vector<archive_node_id> visited, todo(operands);
+	while (!todo.empty()) {
+		const archive_node_id id = todo.back();
+		todo.pop_back();
+		if (id >= refs.size())
+			throw (std::range_error("archive::get_node(): archive node ID out of range"));
+		if (refs[id]++ > 0)
+			continue;
+		visited.push_back(id);
+		const archive_node &n = get_node(id);
+		if (n.has_expression)
+			continue;
+		for (archive_node::archive_node_cit i = n.props.begin(); i != n.props.end(); ++i) {
+			inverse_atoms[unatomize(i->name)] = i->name;
+			if (i->type == archive_node::PTYPE_STRING || i->type == archive_node::PTYPE_BINARY)
+				unatomize(i->value);
+			else if (i->type == archive_node::PTYPE_NODE)
+				todo.push_back(i->value);
+		}
+	}
+
+	// Unarchive shared nodes and symbols
+	std::vector<const archive_node *> shared;
+	for (std::vector<archive_node_id>::const_iterator i = visited.begin(); i != visited.end(); ++i) {
+		const archive_node &n = get_node(*i);
+		if (!n.has_expression) {
+			std::string class_name;
+			n.find_string("class", class_name);
+			if (refs[*i] > 1 || class_name == "symbol" || class_name == "realsymbol" || class_name == "possymbol")
+				n.unarchive(sym_lst);
+		}
+		if (n.has_expression)
+			shared.push_back(&n);
+	}
+
+	const std::size_t nthreads = std::min<std::size_t>(unarchive_threads, operands.size());
+	std::vector<unarchive_job> jobs(nthreads);
+	for (std::size_t k = 0; k < nthreads; ++k) {
+		unarchive_job & job = jobs[k];
+		job.a = this;
+		const std::size_t first = operands.size() * k / nthreads;
+		const std::size_t last = operands.size() * (k + 1) / nthreads;
+		for (std::size_t i = first; i < last; ++i)
+			if (!get_node(operands[i]).has_expression)
+				job.operands.push_back(operands[i]);
+		if (k > 0) {
+			for (std::vector<const archive_node *>::const_iterator i = shared.begin(); i != shared.end(); ++i) {
+				ex copy;
+				if (!copy_numbers((*i)->e, copy))
+					return false;
+				job.copies.insert(std::make_pair(*i, copy));
+			}
+		}
+		job.sym_lst = sym_lst;
+		job.failed = false;
+	}
+
+	// While the threads run, looking up atoms must not change the archive
+	atoms_frozen = true;
+	run_tasks(run_unarchive_job, jobs);
+	atoms_frozen = false;
+
+	for (std::size_t k = 0; k < nthreads; ++k)
+		if (jobs[k].failed)
+			return false;
+	return true;
+}
+
+#endif // def PARALLEL_UNARCHIVE
+
+/** Unarchive the expression with the given root node, the operands of
+ *  which may be distributed to several threads (see
+ *  set_unarchive_threads()).  Nodes which are unarchived already, e.g.
+ *  because they are shared with other expressions, are not rebuilt. */
+ex archive::unarchive_root(archive_node_id id, lst &sym_lst) const
+{
+	const archive_node &root = get_node(id);
+#ifdef PARALLEL_UNARCHIVE
+	// If a thread fails, the remaining operands are unarchived below
+	if (unarchive_threads > 1 && !root.has_expression)
+		unarchive_operands_parallel(root, sym_lst);
+#endif
+	return root.unarchive(sym_lst);
+}
+
 ex archive::unarchive_ex(const lst &sym_lst, const char *name) const
 {
 	// Find root node
@@ -95,7 +342,7 @@ ex archive::unarchive_ex(const lst &sym_lst, const char *name) const
 found:
 	// Recursively unarchive all nodes, starting at the root node
 	lst sym_lst_copy = sym_lst;
-	return nodes[i->root].unarchive(sym_lst_copy);
+	return unarchive_root(i->root, sym_lst_copy);
 }
 
 ex archive::unarchive_ex(const lst &sym_lst, unsigned index) const
@@ -105,7 +352,7 @@ ex archive::unarchive_ex(const lst &sym_lst, unsigned index) const
 
 	// Recursively unarchive all nodes, starting at the root node
 	lst sym_lst_copy = sym_lst;
-	return nodes[exprs[index].root].unarchive(sym_lst_copy);
+	return unarchive_root(exprs[index].root, sym_lst_copy);
 }
 
 ex archive::unarchive_ex(const lst &sym_lst, std::string &name, unsigned index) const
@@ -118,7 +365,7 @@ ex archive::unarchive_ex(const lst &sym_lst, std::string &name, unsigned index)
 
 	// Recursively unarchive all nodes, starting at the root node
 	lst sym_lst_copy = sym_lst;
-	return nodes[exprs[index].root].unarchive(sym_lst_copy);
+	return unarchive_root(exprs[index].root, sym_lst_copy);
 }
 
 unsigned archive::num_expressions() const
@@ -131,7 +378,71 @@ const archive_node &archive::get_top_node(unsigned index) const
 	if (index >= exprs.size())
 		throw (std::range_error("index of archived expression out of range"));
 
-	return nodes[exprs[index].root];
+	return get_node(exprs[index].root);
+}
+
+std::string archive::get_name(unsigned index) const
+{
+	if (index >= exprs.size())
+		throw (std::range_error("index of archived expression out of range"));
+
+	return unatomize(exprs[index].name);
+}
+
+/** Append the IDs of the nodes that the node with the given ID refers to.
+ *  Nodes of the mapped file which have not been decoded yet are read
+ *  directly from it. */
+void archive::get_operands(archive_node_id id, std::vector<archive_node_id> &ops) const
+{
+	if (id < mapped->num_nodes && mapped_nodes.find(id) == mapped_nodes.end()) {
+		const unsigned char *end;
+		const unsigned char *p = mapped->bytes(mapped->entry(mapped->node_table, id), end);
+		unsigned num_props = read_unsigned(p, end);
+		for (unsigned j=0; j<num_props; j++) {
+			unsigned name_type = read_unsigned(p, end);
+			unsigned value = read_unsigned(p, end);
+			if ((name_type & 7) == archive_node::PTYPE_NODE)
+				ops.push_back(value);
+		}
+		return;
+	}
+
+	const archive_node &n = get_node(id);
+	for (archive_node::archive_node_cit i = n.props.begin(); i != n.props.end(); ++i)
+		if (i->type == archive_node::PTYPE_NODE)
+			ops.push_back(i->value);
+}
+
+unsigned archive::count_nodes(unsigned index) const
+{
+	if (index >= exprs.size())
+		throw (std::range_error("index of archived expression out of range"));
+
+	std::vector<bool> visited(total_nodes(), false);
+	std::vector<archive_node_id> todo(1, exprs[index].root);
+	unsigned count = 0;
+	while (!todo.empty()) {
+		const archive_node_id id = todo.back();
+		todo.pop_back();
+		if (id >= visited.size())
+			throw (std::range_error("archive::get_node(): archive node ID out of range"));
+		if (visited[id])
+			continue;
+		visited[id] = true;
+		++count;
+		get_operands(id, todo);
+	}
+	return count;
+}
+
+unsigned archive::total_atoms() const
+{
+	return mapped->num_atoms + atoms.size();
+}
+
+unsigned archive::total_nodes() const
+{
+	return mapped->num_nodes + nodes.size();
 }
 
 
@@ -141,7 +452,8 @@ const archive_node &archive::get_top_node(unsigned index) const
  *   - 4 bytes signature 'GARC'
  *   - unsigned version number
  *   - unsigned number of atoms
- *      - atom strings (each zero-terminated)
+ *      - unsigned length of atom
+ *      - bytes of atom (up to version 3: zero-terminated atom strings)
  *   - unsigned number of expressions
  *      - unsigned name atom
  *      - unsigned root node ID
@@ -172,16 +484,73 @@ const archive_node &archive::get_top_node(unsigned index) const
  *   0xff 0x7f      = 0x3fff
  *   0x80 0x80 0x01 = 0x4000
  *    ..   ..   ..       ..
+ *
+ *  Indexed archive file format (see archive::save_indexed())
+ *
+ *   - 4 bytes signature 'GARI'
+ *   - unsigned version number
+ *   - unsigned flags (bit 0: nodes and atoms are compressed)
+ *   - nodes, as in the stream format
+ *   - atoms, as in the stream format
+ *   - unsigned number of atoms
+ *   - unsigned number of expressions
+ *      - unsigned name atom
+ *      - unsigned root node ID
+ *   - unsigned number of nodes
+ *   - unsigned number of compressed blocks
+ *   - atom offset table, node offset table and table of atom IDs sorted
+ *     by their strings (for looking up atoms by binary search)
+ *   - block table (uncompressed offset, file offset, size and compressed
+ *     size of each block)
+ *   - file offset of the number of atoms
+ *
+ *  Table entries and the final offset take 8 bytes each, LSB first.
+ *  Offsets count from the signature. The index comes last so that
+ *  archive::start_indexed() can write the nodes as they are created.
+ *  In a compressed archive the nodes and atoms are stored as a sequence
+ *  of zlib-compressed blocks of about 64KB each, which are decompressed
+ *  individually when first accessed; node and atom offsets then refer to
+ *  the uncompressed data. Indexed archives exist from archive version 4 on.
  */
 
-/** Write unsigned integer quantity to stream. */
-static void write_unsigned(std::ostream &os, unsigned val)
+/** Write unsigned integer quantity to stream.
+ *  @return number of bytes written */
+static unsigned write_unsigned(std::ostream &os, unsigned val)
 {
+	unsigned len = 1;
 	while (val >= 0x80) {
 		os.put((val & 0x7f) | 0x80);
 		val >>= 7;
+		++len;
 	}
 	os.put(val);
+	return len;
+}
+
+/** Write atom (length and bytes) to stream.
+ *  @return number of bytes written */
+static std::size_t write_atom(std::ostream &os, const std::string &atom)
+{
+	std::size_t len = write_unsigned(os, atom.size());
+	os.write(atom.data(), atom.size());
+	return len + atom.size();
+}
+
+/** Append unsigned integer quantity to string. */
+static void write_unsigned(std::string &s, unsigned val)
+{
+	while (val >= 0x80) {
+		s += char((val & 0x7f) | 0x80);
+		val >>= 7;
+	}
+	s += char(val);
+}
+
+/** Append atom (length and bytes) to string. */
+static void write_atom(std::string &s, const std::string &atom)
+{
+	write_unsigned(s, atom.size());
+	s += atom;
 }
 
 /** Read unsigned integer quantity from stream. */
@@ -213,6 +582,30 @@ std::ostream &operator<<(std::ostream &os, const archive_node &n)
 	return os;
 }
 
+/** Write archive_node to binary data stream like operator<< does.
+ *  @return number of bytes written */
+std::size_t archive::write_node(std::ostream &os, const archive_node &n) const
+{
+	unsigned num_props = n.props.size();
+	std::size_t len = write_unsigned(os, num_props);
+	for (unsigned i=0; i<num_props; i++) {
+		len += write_unsigned(os, n.props[i].type | (n.props[i].name << 3));
+		len += write_unsigned(os, n.props[i].value);
+	}
+	return len;
+}
+
+/** Append archive_node to string like operator<< does. */
+void archive::write_node(std::string &s, const archive_node &n) const
+{
+	unsigned num_props = n.props.size();
+	write_unsigned(s, num_props);
+	for (unsigned i=0; i<num_props; i++) {
+		write_unsigned(s, n.props[i].type | (n.props[i].name << 3));
+		write_unsigned(s, n.props[i].value);
+	}
+}
+
 /** Write archive to binary data stream. */
 std::ostream &operator<<(std::ostream &os, const archive &ar)
 {
@@ -221,27 +614,29 @@ std::ostream &operator<<(std::ostream &os, const archive &ar)
 	os.put('A');
 	os.put('R');
 	os.put('C');
-	write_unsigned(os, GINACLIB_ARCHIVE_VERSION);
+	std::size_t len = 4 + write_unsigned(os, GINACLIB_ARCHIVE_VERSION);
 
 	// Write atoms
-	unsigned num_atoms = ar.atoms.size();
-	write_unsigned(os, num_atoms);
+	unsigned num_atoms = ar.total_atoms();
+	len += write_unsigned(os, num_atoms);
 	for (unsigned i=0; i<num_atoms; i++)
-		os << ar.atoms[i] << std::ends;
+		len += write_atom(os, ar.unatomize(i));
 
 	// Write expressions
 	unsigned num_exprs = ar.exprs.size();
-	write_unsigned(os, num_exprs);
+	len += write_unsigned(os, num_exprs);
 	for (unsigned i=0; i<num_exprs; i++) {
-		write_unsigned(os, ar.exprs[i].name);
-		write_unsigned(os, ar.exprs[i].root);
+		len += write_unsigned(os, ar.exprs[i].name);
+		len += write_unsigned(os, ar.exprs[i].root);
 	}
 
 	// Write nodes
-	unsigned num_nodes = ar.nodes.size();
-	write_unsigned(os, num_nodes);
+	unsigned num_nodes = ar.total_nodes();
+	len += write_unsigned(os, num_nodes);
 	for (unsigned i=0; i<num_nodes; i++)
-		os << ar.nodes[i];
+		len += ar.write_node(os, ar.get_node(i));
+
+	ar.bytes_written += len;
 	return os;
 }
 
@@ -260,25 +655,41 @@ std::istream &operator>>(std::istream &is, archive_node &n)
 	return is;
 }
 
+/** Check that this library can read archives of a given version.
+ *  @return the version */
+static unsigned check_archive_version(unsigned version)
+{
+	static const unsigned max_version = GINACLIB_ARCHIVE_VERSION;
+	static const unsigned min_version = GINACLIB_ARCHIVE_VERSION - GINACLIB_ARCHIVE_AGE;
+	if ((version > max_version) || (version < min_version))
+		throw (std::runtime_error("archive version " + ToString(version) + " cannot be read by this GiNaC library (which supports versions " + ToString(min_version) + " thru " + ToString(max_version)));
+	return version;
+}
+
 /** Read archive from binary data stream. */
 std::istream &operator>>(std::istream &is, archive &ar)
 {
+	ar.clear();
+
 	// Read header
 	char c1, c2, c3, c4;
 	is.get(c1); is.get(c2); is.get(c3); is.get(c4);
 	if (c1 != 'G' || c2 != 'A' || c3 != 'R' || c4 != 'C')
 		throw (std::runtime_error("not a GiNaC archive (signature not found)"));
-	static const unsigned max_version = GINACLIB_ARCHIVE_VERSION;
-	static const unsigned min_version = GINACLIB_ARCHIVE_VERSION - GINACLIB_ARCHIVE_AGE;
-	unsigned version = read_unsigned(is);
-	if ((version > max_version) || (version < min_version))
-		throw (std::runtime_error("archive version " + ToString(version) + " cannot be read by this GiNaC library (which supports versions " + ToString(min_version) + " thru " + ToString(max_version)));
+	unsigned version = check_archive_version(read_unsigned(is));
 
 	// Read atoms
 	unsigned num_atoms = read_unsigned(is);
 	ar.atoms.resize(num_atoms);
 	for (unsigned i=0; i<num_atoms; i++) {
-		getline(is, ar.atoms[i], '\0');
+		if (version < 4)
+			getline(is, ar.atoms[i], '\0');
+		else {
+			unsigned len = read_unsigned(is);
+			ar.atoms[i].resize(len);
+			if (len)
+				is.read(&ar.atoms[i][0], len);
+		}
 		ar.inverse_atoms[ar.atoms[i]] = i;
 	}
 
@@ -300,6 +711,566 @@ std::istream &operator>>(std::istream &is, archive &ar)
 }
 
 
+/*
+ *  Format of serialize()
+ *
+ *   - unsigned version number
+ *   - unsigned number of atoms
+ *      - atoms, as in the stream format
+ *   - unsigned number of nodes
+ *      - unsigned 0, followed by the node as in the stream format, or
+ *      - unsigned n > 0, standing for the symbol at position n-1 of the
+ *        table of symbols
+ *   - unsigned root node ID
+ *
+ *  There is no signature, and there is only one expression without a name.
+ */
+
+/** Write the nodes of the expression with the given root node to buffer
+ *  in the format of serialize(). */
+void archive::write_serialized(std::string &buf, archive_node_id root, const lst &syms) const
+{
+	write_unsigned(buf, GINACLIB_ARCHIVE_VERSION);
+
+	unsigned num_atoms = atoms.size();
+	write_unsigned(buf, num_atoms);
+	for (unsigned i=0; i<num_atoms; i++)
+		write_atom(buf, atoms[i]);
+
+	unsigned num_nodes = nodes.size();
+	write_unsigned(buf, num_nodes);
+	for (unsigned i=0; i<num_nodes; i++) {
+		const archive_node &n = nodes[i];
+		unsigned index = 0;
+		if (n.has_expression && is_a<symbol>(n.e) && syms.nops()) {
+			unsigned k = 1;
+			for (lst::const_iterator s = syms.begin(); s != syms.end(); ++s, ++k) {
+				if (s->is_equal(n.e)) {
+					index = k;
+					break;
+				}
+			}
+		}
+		write_unsigned(buf, index);
+		if (!index)
+			write_node(buf, n);
+	}
+
+	write_unsigned(buf, root);
+}
+
+/** Read an expression in the format of serialize() from buffer into this
+ *  (empty) archive and unarchive it. */
+ex archive::read_serialized(const std::string &buf, std::size_t &pos, lst &syms)
+{
+	if (pos > buf.size())
+		throw (std::range_error("deserialize(): position out of range"));
+	const unsigned char *start = reinterpret_cast<const unsigned char *>(buf.data());
+	const unsigned char *p = start + pos, *end = start + buf.size();
+
+	if (check_archive_version(read_unsigned(p, end)) < 4)
+		throw (std::runtime_error("deserialize(): serialized expressions exist from archive version 4 on"));
+
+	unsigned num_atoms = read_unsigned(p, end);
+	atoms.resize(num_atoms);
+	for (unsigned i=0; i<num_atoms; i++) {
+		unsigned len = read_unsigned(p, end);
+		if (len > std::size_t(end - p))
+			throw (std::runtime_error("archive file is truncated"));
+		atoms[i].assign(reinterpret_cast<const char *>(p), len);
+		p += len;
+		inverse_atoms[atoms[i]] = i;
+	}
+
+	unsigned num_nodes = read_unsigned(p, end);
+	nodes.resize(num_nodes, *this);
+	exvector table;
+	for (unsigned i=0; i<num_nodes; i++) {
+		archive_node &n = nodes[i];
+		unsigned index = read_unsigned(p, end);
+		if (index) {
+			if (table.empty())
+				table.assign(syms.begin(), syms.end());
+			if (index > table.size())
+				throw (std::range_error("deserialize(): symbol not in table"));
+			n.e = table[index - 1];
+			n.has_expression = true;
+			continue;
+		}
+		unsigned num_props = read_unsigned(p, end);
+		n.props.resize(num_props);
+		for (unsigned j=0; j<num_props; j++) {
+			unsigned name_type = read_unsigned(p, end);
+			n.props[j].type = (archive_node::property_type)(name_type & 7);
+			n.props[j].name = name_type >> 3;
+			n.props[j].value = read_unsigned(p, end);
+		}
+	}
+
+	archive_node_id root = read_unsigned(p, end);
+	pos = p - start;
+	return unarchive_root(root, syms);
+}
+
+/** Append expression to buffer in a compact binary format, which is meant
+ *  for transferring expressions between processes of the same program
+ *  rather than for storing them. Symbols that are in syms are written as
+ *  their position in syms, all others by name.
+ *  @param e the expression
+ *  @param buf buffer to which the expression is appended
+ *  @param syms table of symbols, which the reading side must have in the
+ *         same order
+ *  @see deserialize */
+void serialize(const ex &e, std::string &buf, const lst &syms)
+{
+	archive ar;
+	archive_node_id root = ar.add_node(archive_node(ar, e));
+	ar.write_serialized(buf, root, syms);
+}
+
+/** Append expression to buffer in a compact binary format, writing all
+ *  symbols by name. */
+void serialize(const ex &e, std::string &buf)
+{
+	serialize(e, buf, lst());
+}
+
+/** Read expression written by serialize(). Symbols written by position
+ *  are taken from syms. Symbols written by name are looked up by name in
+ *  syms and appended to it if they are not there, so passing the same list
+ *  to subsequent calls yields the same symbols.
+ *  @param buf buffer holding the expression
+ *  @param pos position of the expression in buf, which is advanced past it
+ *  @param syms table of symbols
+ *  @see serialize */
+ex deserialize(const std::string &buf, std::size_t &pos, lst &syms)
+{
+	archive ar;
+	return ar.read_serialized(buf, pos, syms);
+}
+
+/** Read expression written by serialize() from the start of buffer. */
+ex deserialize(const std::string &buf, lst &syms)
+{
+	std::size_t pos = 0;
+	return deserialize(buf, pos, syms);
+}
+
+
+/** Write an offset table entry to binary data stream. */
+static void write_entry(std::ostream &os, std::size_t val)
+{
+	for (int i=0; i<8; i++) {
+		os.put(val & 0xff);
+		val >>= 8;
+	}
+}
+
+/** Compare the bytes of two atoms lexicographically. */
+static int compare_atoms(const char *a, std::size_t alen, const char *b, std::size_t blen)
+{
+	int c = std::memcmp(a, b, std::min(alen, blen));
+	if (c != 0)
+		return c;
+	return alen < blen ? -1 : (alen > blen ? 1 : 0);
+}
+
+/** Order atom IDs by their strings, like the binary search in
+ *  archive::mapped_file::find_atom() expects. */
+class atom_is_less {
+public:
+	atom_is_less(const archive &a) : ar(a) {}
+	bool operator()(archive_atom x, archive_atom y) const
+	{
+		const std::string &sx = ar.unatomize(x), &sy = ar.unatomize(y);
+		return compare_atoms(sx.data(), sx.size(), sy.data(), sy.size()) < 0;
+	}
+private:
+	const archive &ar;
+};
+
+/** Write the header of an indexed archive to a stream and prepare for
+ *  writing nodes and atoms. */
+void archive::index_output::start(std::ostream &s, bool c)
+{
+#ifndef HAVE_ZLIB_H
+	if (c)
+		throw (std::runtime_error("archive compression is not available (GiNaC was built without zlib)"));
+#endif
+	os = &s;
+	compress = c;
+	node_offsets.clear();
+	blocks.clear();
+	block.clear();
+
+	// Write header
+	os->put('G');	// Signature
+	os->put('A');
+	os->put('R');
+	os->put('I');
+	file_pos = 4 + write_unsigned(*os, GINACLIB_ARCHIVE_VERSION);
+	file_pos += write_unsigned(*os, compress ? 1 : 0);	// Flags
+	pos = file_pos;
+}
+
+/** Write the current block of nodes or atoms to the stream, compressing
+ *  it if requested. */
+void archive::index_output::flush()
+{
+	if (block.empty())
+		return;
+
+	if (compress) {
+#ifdef HAVE_ZLIB_H
+		uLongf len = compressBound(block.size());
+		std::vector<Bytef> buf(len);
+		if (compress2(&buf[0], &len, reinterpret_cast<const Bytef *>(block.data()), block.size(), Z_DEFAULT_COMPRESSION) != Z_OK)
+			throw (std::runtime_error("archive::index_output::flush(): compressing archive block failed"));
+		os->write(reinterpret_cast<const char *>(&buf[0]), len);
+		blocks.push_back(pos);
+		blocks.push_back(file_pos);
+		blocks.push_back(block.size());
+		blocks.push_back(len);
+		file_pos += len;
+#endif
+	} else {
+		os->write(block.data(), block.size());
+		file_pos += block.size();
+	}
+	pos += block.size();
+	block.clear();
+}
+
+/** Write atoms, index of expressions and offset tables of an indexed
+ *  archive, following the nodes. */
+void archive::write_index(index_output &o) const
+{
+	o.flush();
+	std::ostream &os = *o.os;
+
+	// Write atoms
+	unsigned num_atoms = total_atoms();
+	std::vector<std::size_t> atom_offsets(num_atoms);
+	for (unsigned i=0; i<num_atoms; i++) {
+		atom_offsets[i] = o.next_offset();
+		write_atom(o.block, unatomize(i));
+		o.added();
+	}
+	o.flush();
+
+	// Write index of expressions
+	std::size_t index_pos = o.file_pos;
+	std::size_t len = write_unsigned(os, num_atoms);
+	unsigned num_exprs = exprs.size();
+	len += write_unsigned(os, num_exprs);
+	for (unsigned i=0; i<num_exprs; i++) {
+		len += write_unsigned(os, exprs[i].name);
+		len += write_unsigned(os, exprs[i].root);
+	}
+	unsigned num_nodes = o.node_offsets.size();
+	len += write_unsigned(os, num_nodes);
+	unsigned num_blocks = o.blocks.size() / 4;
+	len += write_unsigned(os, num_blocks);
+
+	// Write offset tables
+	for (unsigned i=0; i<num_atoms; i++)
+		write_entry(os, atom_offsets[i]);
+	for (unsigned i=0; i<num_nodes; i++)
+		write_entry(os, o.node_offsets[i]);
+	std::vector<archive_atom> sorted(num_atoms);
+	for (unsigned i=0; i<num_atoms; i++)
+		sorted[i] = i;
+	std::sort(sorted.begin(), sorted.end(), atom_is_less(*this));
+	for (unsigned i=0; i<num_atoms; i++)
+		write_entry(os, sorted[i]);
+	for (unsigned i=0; i<o.blocks.size(); i++)
+		write_entry(os, o.blocks[i]);
+	write_entry(os, index_pos);
+	o.file_pos += len + 8 * (2 * std::size_t(num_atoms) + num_nodes + o.blocks.size() + 1);
+}
+
+void archive::save_indexed(const std::string &filename, bool compress) const
+{
+	if (out.os)
+		throw (std::logic_error("archive::save_indexed(): archive is being written to a stream"));
+
+	std::ofstream os(filename.c_str(), std::ios_base::binary);
+	if (!os)
+		throw (std::runtime_error("cannot create archive file '" + filename + "'"));
+
+	index_output o;
+	o.start(os, compress);
+
+	// Write nodes
+	unsigned num_nodes = total_nodes();
+	o.node_offsets.resize(num_nodes);
+	for (unsigned i=0; i<num_nodes; i++) {
+		o.node_offsets[i] = o.next_offset();
+		write_node(o.block, get_node(i));
+		o.added();
+	}
+
+	write_index(o);
+	bytes_written += o.file_pos;
+	if (!os)
+		throw (std::runtime_error("error writing archive file '" + filename + "'"));
+}
+
+void archive::start_indexed(std::ostream &os, bool compress)
+{
+	if (out.os)
+		throw (std::logic_error("archive::start_indexed(): archive is already being written to a stream"));
+
+	out.start(os, compress);
+
+	// Write the nodes archived so far, their IDs stay the same
+	unsigned num_nodes = total_nodes();
+	out.node_offsets.resize(num_nodes);
+	for (unsigned i=0; i<num_nodes; i++) {
+		out.node_offsets[i] = out.next_offset();
+		write_node(out.block, get_node(i));
+		out.added();
+	}
+	bytes_written += out.file_pos;
+	nodes.clear();
+	mapped_nodes.clear();
+}
+
+void archive::finish_indexed()
+{
+	if (!out.os)
+		throw (std::logic_error("archive::finish_indexed(): archive is not being written to a stream"));
+
+	std::ostream &os = *out.os;
+	std::size_t file_pos = out.file_pos;
+	write_index(out);
+	bytes_written += out.file_pos - file_pos;
+	clear();
+	if (!os)
+		throw (std::runtime_error("error writing indexed archive"));
+}
+
+void archive::load_indexed(const std::string &filename)
+{
+	clear();
+
+	// Check header
+	ptr<mapped_file> f(new mapped_file(filename));
+	const unsigned char *p = f->data, *end = f->data + f->size;
+	if (f->size < 12 || std::memcmp(p, "GARI", 4) != 0)
+		throw (std::runtime_error("not an indexed GiNaC archive (signature not found)"));
+	p += 4;
+	if (check_archive_version(read_unsigned(p, end)) < 4)
+		throw (std::runtime_error("indexed archive file has a version before 4"));
+	unsigned flags = read_unsigned(p, end);
+	if (flags > 1)
+		throw (std::runtime_error("indexed archive file uses unknown features"));
+#ifndef HAVE_ZLIB_H
+	if (flags & 1)
+		throw (std::runtime_error("archive file is compressed, but GiNaC was built without zlib"));
+#endif
+
+	// Read index of expressions, which the last entry points to
+	end -= 8;
+	std::size_t index_pos = f->entry(f->size - 8, 0);
+	if (index_pos >= f->size - 8)
+		throw (std::runtime_error("archive file is corrupt (bad index offset)"));
+	p = f->data + index_pos;
+	f->num_atoms = read_unsigned(p, end);
+	unsigned num_exprs = read_unsigned(p, end);
+	std::vector<archived_ex> index(num_exprs);
+	for (unsigned i=0; i<num_exprs; i++) {
+		archive_atom name = read_unsigned(p, end);
+		archive_node_id root = read_unsigned(p, end);
+		index[i] = archived_ex(name, root);
+	}
+
+	// Locate offset tables, the atoms and nodes themselves are read on demand
+	f->num_nodes = read_unsigned(p, end);
+	f->num_blocks = read_unsigned(p, end);
+	if (!(flags & 1) && f->num_blocks != 0)
+		throw (std::runtime_error("archive file is corrupt (bad number of blocks)"));
+	f->atom_table = p - f->data;
+	f->node_table = f->atom_table + 8 * std::size_t(f->num_atoms);
+	f->sorted_table = f->node_table + 8 * std::size_t(f->num_nodes);
+	f->block_table = f->sorted_table + 8 * std::size_t(f->num_atoms);
+	if (f->block_table + 32 * std::size_t(f->num_blocks) > f->size - 8)
+		throw (std::runtime_error("archive file is truncated"));
+
+	exprs.swap(index);
+	mapped = f;
+}
+
+
+archive::mapped_file::mapped_file()
+  : data(0), size(0), is_mapped(false), num_atoms(0), num_nodes(0),
+    atom_table(0), node_table(0), sorted_table(0), num_blocks(0), block_table(0),
+    next_cache_slot(0)
+{
+}
+
+archive::mapped_file::mapped_file(const std::string &filename)
+  : data(0), size(0), is_mapped(false), num_atoms(0), num_nodes(0),
+    atom_table(0), node_table(0), sorted_table(0), num_blocks(0), block_table(0),
+    next_cache_slot(0)
+{
+#ifdef HAVE_SYS_MMAN_H
+	int fd = open(filename.c_str(), O_RDONLY);
+	if (fd < 0)
+		throw (std::runtime_error("cannot open archive file '" + filename + "'"));
+	struct stat st;
+	if (fstat(fd, &st) == 0 && st.st_size > 0) {
+		void *addr = mmap(0, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+		if (addr != MAP_FAILED) {
+			data = static_cast<const unsigned char *>(addr);
+			size = st.st_size;
+			is_mapped = true;
+		}
+	}
+	close(fd);
+	if (is_mapped)
+		return;
+#endif
+
+	// Without mmap(), read the whole file (nodes are still decoded lazily)
+	std::ifstream is(filename.c_str(), std::ios_base::binary);
+	if (!is)
+		throw (std::runtime_error("cannot open archive file '" + filename + "'"));
+	is.seekg(0, std::ios_base::end);
+	size = is.tellg();
+	is.seekg(0, std::ios_base::beg);
+	unsigned char *buf = new unsigned char[size];
+	is.read(reinterpret_cast<char *>(buf), size);
+	if (!is) {
+		delete[] buf;
+		throw (std::runtime_error("error reading archive file '" + filename + "'"));
+	}
+	data = buf;
+}
+
+archive::mapped_file::~mapped_file()
+{
+#ifdef HAVE_SYS_MMAN_H
+	if (is_mapped) {
+		munmap(const_cast<unsigned char *>(data), size);
+		return;
+	}
+#endif
+	delete[] data;
+}
+
+/** Read the entry with the given index from an offset table. */
+std::size_t archive::mapped_file::entry(std::size_t table, std::size_t index) const
+{
+	const unsigned char *p = data + table + 8 * index;
+	std::size_t val = 0;
+	for (int i=7; i>=0; i--)
+		val = (val << 8) | p[i];
+	return val;
+}
+
+/** Number of decompressed blocks kept in memory. */
+static const unsigned archive_block_cache_size = 16;
+
+/** Locate the data of a node or atom.
+ *  @param offset offset of the node or atom (in the uncompressed data)
+ *  @param end receives the end of the data that can be read
+ *  @return pointer to the data, which is valid until the next call */
+const unsigned char *archive::mapped_file::bytes(std::size_t offset, const unsigned char *&end) const
+{
+	if (num_blocks == 0) {
+		if (offset >= size)
+			throw (std::runtime_error("archive file is corrupt (bad offset)"));
+		end = data + size;
+		return data + offset;
+	}
+
+	// Find block by binary search, its table entry holds the offset and
+	// file position of the block and its uncompressed and compressed size
+	unsigned lo = 0, hi = num_blocks;
+	while (hi - lo > 1) {
+		unsigned mid = lo + (hi - lo) / 2;
+		if (entry(block_table, 4 * std::size_t(mid)) <= offset)
+			lo = mid;
+		else
+			hi = mid;
+	}
+	std::size_t block_offset = entry(block_table, 4 * std::size_t(lo));
+	std::size_t block_size = entry(block_table, 4 * std::size_t(lo) + 2);
+	if (offset < block_offset || offset - block_offset >= block_size)
+		throw (std::runtime_error("archive file is corrupt (bad offset)"));
+
+	// Decompress block unless it was recently used
+	unsigned slot = 0;
+	while (slot < cached_blocks.size() && cached_blocks[slot] != lo)
+		++slot;
+	if (slot == cached_blocks.size()) {
+		std::size_t file_pos = entry(block_table, 4 * std::size_t(lo) + 1);
+		std::size_t compressed_size = entry(block_table, 4 * std::size_t(lo) + 3);
+		if (file_pos > size || compressed_size > size - file_pos)
+			throw (std::runtime_error("archive file is corrupt (bad block)"));
+		if (cached_blocks.size() < archive_block_cache_size) {
+			cached_blocks.push_back(lo);
+			cache.push_back(std::string());
+		} else {
+			slot = next_cache_slot;
+			next_cache_slot = (next_cache_slot + 1) % archive_block_cache_size;
+			cached_blocks[slot] = lo;
+		}
+		std::string &buf = cache[slot];
+		buf.resize(block_size);
+#ifdef HAVE_ZLIB_H
+		uLongf len = block_size;
+		if (uncompress(reinterpret_cast<Bytef *>(&buf[0]), &len, data + file_pos, compressed_size) != Z_OK || len != block_size) {
+			cached_blocks[slot] = num_blocks;
+			throw (std::runtime_error("archive file is corrupt (bad compressed block)"));
+		}
+#endif
+	}
+
+	const unsigned char *block = reinterpret_cast<const unsigned char *>(cache[slot].data());
+	end = block + block_size;
+	return block + (offset - block_offset);
+}
+
+/** Return the bytes of an atom in the file.
+ *  @param len receives the length of the atom */
+const char *archive::mapped_file::atom(archive_atom id, std::size_t &len) const
+{
+	if (id >= num_atoms)
+		throw (std::range_error("archive::unatomize(): atom ID out of range"));
+	const unsigned char *end;
+	const unsigned char *p = bytes(entry(atom_table, id), end);
+	len = read_unsigned(p, end);
+	if (len > std::size_t(end - p))
+		throw (std::runtime_error("archive file is truncated"));
+	return reinterpret_cast<const char *>(p);
+}
+
+/** Look up the ID of an atom in the file by binary search. */
+archive_atom archive::mapped_file::find_atom(const std::string &s, bool &found) const
+{
+	unsigned lo = 0, hi = num_atoms;
+	while (lo < hi) {
+		unsigned mid = lo + (hi - lo) / 2;
+		archive_atom id = entry(sorted_table, mid);
+		std::size_t len;
+		const char *a = atom(id, len);
+		int c = compare_atoms(a, len, s.data(), s.size());
+		if (c == 0) {
+			found = true;
+			return id;
+		}
+		if (c < 0)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+	found = false;
+	return 0;
+}
+
+
 /** Atomize a string (i.e. convert it into an ID number that uniquely
  *  represents the string). */
 archive_atom archive::atomize(const std::string &s) const
@@ -309,9 +1280,20 @@ archive_atom archive::atomize(const std::string &s) const
 	if (i!=inverse_atoms.end())
 		return i->second;
 
+	// While several threads unarchive, strings that are not there yet are
+	// only needed for looking up properties, which can't have that name
+	if (atoms_frozen)
+		return total_atoms();
+
+	// Search for string in loaded indexed archive file
+	bool found;
+	archive_atom id = mapped->find_atom(s, found);
+
 	// Not found, add to atoms vector
-	archive_atom id = atoms.size();
-	atoms.push_back(s);
+	if (!found) {
+		id = total_atoms();
+		atoms.push_back(s);
+	}
 	inverse_atoms[s] = id;
 	return id;
 }
@@ -319,6 +1301,17 @@ archive_atom archive::atomize(const std::string &s) const
 /** Unatomize a string (i.e. convert the ID number back to the string). */
 const std::string &archive::unatomize(archive_atom id) const
 {
+	if (id < mapped->num_atoms) {
+		std::map<archive_atom, std::string>::const_iterator i = mapped_atoms.find(id);
+		if (i == mapped_atoms.end()) {
+			std::size_t len;
+			const char *atom = mapped->atom(id, len);
+			i = mapped_atoms.insert(std::make_pair(id, std::string(atom, len))).first;
+		}
+		return i->second;
+	}
+
+	id -= mapped->num_atoms;
 	if (id >= atoms.size())
 		throw (std::range_error("archive::unatomizee(): atom ID out of range"));
 
@@ -394,6 +1387,11 @@ void archive_node::add_string(const std::string &name, const std::string &value)
 	props.push_back(property(a.atomize(name), PTYPE_STRING, a.atomize(value)));
 }
 
+void archive_node::add_binary(const std::string &name, const std::string &value)
+{
+	props.push_back(property(a.atomize(name), PTYPE_BINARY, a.atomize(value)));
+}
+
 void archive_node::add_ex(const std::string &name, const ex &value)
 {
 	// Recursively create an archive_node and add its ID to the properties of this node
@@ -456,6 +1454,24 @@ bool archive_node::find_string(const std::string &name, std::string &ret, unsign
 	return false;
 }
 
+bool archive_node::find_binary(const std::string &name, std::string &ret, unsigned index) const
+{
+	archive_atom name_atom = a.atomize(name);
+	archive_node_cit i = props.begin(), iend = props.end();
+	unsigned found_index = 0;
+	while (i != iend) {
+		if (i->type == PTYPE_BINARY && i->name == name_atom) {
+			if (found_index == index) {
+				ret = a.unatomize(i->value);
+				return true;
+			}
+			found_index++;
+		}
+		i++;
+	}
+	return false;
+}
+
 void archive_node::find_ex_by_loc(archive_node_cit loc, ex &ret, lst &sym_lst)
 		const
 {
@@ -528,9 +1544,20 @@ static synthesize_func find_factory_fcn(const std::string& name)
 	return ret;
 }
 
-/** Convert archive node to GiNaC expression. */
+/** Convert archive node to GiNaC expression. The expression is remembered
+ *  in the node, so that nodes which are referred to several times (see
+ *  archive::add_node()) are rebuilt only once and shared in memory. */
 ex archive_node::unarchive(lst &sym_lst) const
 {
+#ifdef PARALLEL_UNARCHIVE
+	// Unarchived by another thread? Then return the copy of this thread.
+	if (shared_copies) {
+		unarchived_map::const_iterator i = shared_copies->find(this);
+		if (i != shared_copies->end())
+			return i->second;
+	}
+#endif
+
 	// Already unarchived? Then return cached unarchived expression.
 	if (has_expression)
 		return e;
@@ -547,21 +1574,73 @@ ex archive_node::unarchive(lst &sym_lst) const
 	obj->read_archive(*this, sym_lst);
 	e = ex(*obj);
 	has_expression = true;
+
+	// A symbol which is in sym_lst is shared rather than copied
+	if (is_a<symbol>(e)) {
+		for (lst::const_iterator i = sym_lst.begin(); i != sym_lst.end(); ++i) {
+			if (i->is_equal(e)) {
+				e = *i;
+				break;
+			}
+		}
+	}
 	return e;
 }
 
 int unarchive_table_t::usecount = 0;
 unarchive_map_t* unarchive_table_t::unarch_map = 0;
+unarchive_pending_t* unarchive_table_t::pending = 0;
+
+/** Number of registrations not entered into the map yet. */
+static volatile std::size_t unarchive_pending_count = 0;
+
+#ifdef GINAC_THREADSAFE_REFCOUNT
+static volatile int unarchive_table_mutex = 0;
+
+/** Scoped spin lock around the registration of classes. */
+class unarchive_table_lock {
+public:
+	unarchive_table_lock() { while (__sync_lock_test_and_set(&unarchive_table_mutex, 1)) ; }
+	~unarchive_table_lock() { __sync_lock_release(&unarchive_table_mutex); }
+};
+#else
+class unarchive_table_lock {
+public:
+	unarchive_table_lock() {}
+};
+#endif
 
 unarchive_table_t::unarchive_table_t()
 {
-	if (usecount == 0)
+	if (usecount == 0) {
 		unarch_map = new unarchive_map_t();
+		pending = new unarchive_pending_t();
+	}
 	++usecount;
 }
 
+/** Enter the pending registrations into the map.  The caller must hold the
+ *  lock. */
+void unarchive_table_t::flush_pending()
+{
+	for (std::size_t k = 0; k < pending->size(); ++k) {
+		const std::string classname((*pending)[k].first);
+		if (unarch_map->find(classname) != unarch_map->end())
+			throw std::runtime_error(std::string("Class \"" + classname
+						+ "\" is already registered"));
+		(*unarch_map)[classname] = (*pending)[k].second;
+	}
+	pending->clear();
+	unarchive_pending_count = 0;
+}
+
 synthesize_func unarchive_table_t::find(const std::string& classname) const
 {
+	if (unarchive_pending_count) {
+		unarchive_table_lock lock;
+		if (unarchive_pending_count)
+			flush_pending();
+	}
 	unarchive_map_t::const_iterator i = unarch_map->find(classname);
 	if (i != unarch_map->end())
 		return i->second;
@@ -571,16 +1650,29 @@ synthesize_func unarchive_table_t::find(const std::string& classname) const
 
 void unarchive_table_t::insert(const std::string& classname, synthesize_func f)
 {
+	unarchive_table_lock lock;
+	flush_pending();
 	if (unarch_map->find(classname) != unarch_map->end())
 		throw std::runtime_error(std::string("Class \"" + classname
 					+ "\" is already registered"));
 	unarch_map->operator[](classname) = f;
 }
 
+/** Register a class by a name which lives as long as the program, like a
+ *  string literal.  Duplicates are detected on the next lookup. */
+void unarchive_table_t::insert(const char* classname, synthesize_func f)
+{
+	unarchive_table_lock lock;
+	pending->push_back(std::make_pair(classname, f));
+	unarchive_pending_count = pending->size();
+}
+
 unarchive_table_t::~unarchive_table_t()
 {
-	if (--usecount == 0)
+	if (--usecount == 0) {
+		delete pending;
 		delete unarch_map;
+	}
 }
 
 
@@ -591,6 +1683,27 @@ void archive::clear()
 	exprs.clear();
 	nodes.clear();
 	exprtable.clear();
+	mapped = new mapped_file;
+	mapped_nodes.clear();
+	mapped_atoms.clear();
+	out = index_output();
+}
+
+
+archive_statistics archive::get_statistics() const
+{
+	archive_statistics stats;
+	stats.nodes = out.os ? out.node_offsets.size() : total_nodes();
+	stats.atoms = total_atoms();
+	stats.dedup_hits = dedup_hits;
+	stats.bytes_written = bytes_written;
+	return stats;
+}
+
+void archive::reset_statistics()
+{
+	dedup_hits = 0;
+	bytes_written = 0;
 }
 
 
@@ -598,6 +1711,7 @@ void archive::clear()
 void archive::forget()
 {
 	for_each(nodes.begin(), nodes.end(), std::mem_fun_ref(&archive_node::forget));
+	mapped_nodes.clear();
 }
 
 /** Delete cached unarchived expressions from node (for debugging). */
@@ -613,14 +1727,8 @@ void archive::printraw(std::ostream &os) const
 {
 	// Dump atoms
 	os << "Atoms:\n";
-	{
-		std::vector<std::string>::const_iterator i = atoms.begin(), iend = atoms.end();
-		archive_atom id = 0;
-		while (i != iend) {
-			os << " " << id << " " << *i << std::endl;
-			i++; id++;
-		}
-	}
+	for (archive_atom id=0; id<total_atoms(); id++)
+		os << " " << id << " " << unatomize(id) << std::endl;
 	os << std::endl;
 
 	// Dump expressions
@@ -637,14 +1745,9 @@ void archive::printraw(std::ostream &os) const
 
 	// Dump nodes
 	os << "Nodes:\n";
-	{
-		std::vector<archive_node>::const_iterator i = nodes.begin(), iend = nodes.end();
-		archive_node_id id = 0;
-		while (i != iend) {
-			os << " " << id << " ";
-			i->printraw(os);
-			i++; id++;
-		}
+	for (archive_node_id id=0; id<total_nodes(); id++) {
+		os << " " << id << " ";
+		get_node(id).printraw(os);
 	}
 }
 
@@ -666,6 +1769,7 @@ void archive_node::printraw(std::ostream &os) const
 			case PTYPE_UNSIGNED: os << "unsigned"; break;
 			case PTYPE_STRING: os << "string"; break;
 			case PTYPE_NODE: os << "node"; break;
+			case PTYPE_BINARY: os << "binary"; break;
 			default: os << "<unknown>"; break;
 		}
 		os << " \"" << a.unatomize(i->name) << "\" " << i->value << std::endl;
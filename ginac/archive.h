@@ -24,6 +24,7 @@
 #define GINAC_ARCHIVE_H
 
 #include "ex.h"
+#include "hash_map.h"
 
 #include <iosfwd>
 #include <map>
@@ -47,6 +48,7 @@ typedef unsigned archive_atom;
  *  addressed by its name and data type. */
 class archive_node
 {
+	friend class archive;
 	friend std::ostream &operator<<(std::ostream &os, const archive_node &ar);
 	friend std::istream &operator>>(std::istream &is, archive_node &ar);
 
@@ -56,7 +58,8 @@ public:
 		PTYPE_BOOL,
 		PTYPE_UNSIGNED,
 		PTYPE_STRING,
-		PTYPE_NODE
+		PTYPE_NODE,
+		PTYPE_BINARY
 	};
 
 	/** Information about a stored property. A vector of these structures
@@ -101,6 +104,9 @@ public:
 	/** Add property of type "ex" to node. */
 	void add_ex(const std::string &name, const ex &value);
 
+	/** Add property of type "binary" (arbitrary bytes) to node. */
+	void add_binary(const std::string &name, const std::string &value);
+
 	/** Retrieve property of type "bool" from node.
 	 *  @return "true" if property was found, "false" otherwise */
 	bool find_bool(const std::string &name, bool &ret, unsigned index = 0) const;
@@ -113,6 +119,10 @@ public:
 	 *  @return "true" if property was found, "false" otherwise */
 	bool find_string(const std::string &name, std::string &ret, unsigned index = 0) const;
 
+	/** Retrieve property of type "binary" from node.
+	 *  @return "true" if property was found, "false" otherwise */
+	bool find_binary(const std::string &name, std::string &ret, unsigned index = 0) const;
+
 	/** Find the location in the vector of properties of the first/last
     *  property with a given name. */
 	archive_node_cit find_first(const std::string &name) const;
@@ -160,16 +170,24 @@ private:
 
 typedef basic* (*synthesize_func)();
 typedef std::map<std::string, synthesize_func> unarchive_map_t;
+typedef std::vector<std::pair<const char*, synthesize_func> > unarchive_pending_t;
 
+/** Table of the functions creating the objects of the archivable classes
+ *  by class name.  Classes registered by the name literal are only entered
+ *  into the map (and checked for duplicates) on the first lookup, which
+ *  keeps the construction of strings out of the program startup. */
 class unarchive_table_t
 {
 	static int usecount;
 	static unarchive_map_t* unarch_map;
+	static unarchive_pending_t* pending;
+	static void flush_pending();
 public:
 	unarchive_table_t();
 	~unarchive_table_t();
 	synthesize_func find(const std::string& classname) const;
 	void insert(const std::string& classname, synthesize_func f);
+	void insert(const char* classname, synthesize_func f);
 };
 static unarchive_table_t unarch_table_instance;
 
@@ -227,7 +245,7 @@ classname ## _unarchiver::classname ## _unarchiver()		\
 {								\
 	static GiNaC::unarchive_table_t table;			\
 	if (usecount++ == 0) {					\
-		table.insert(std::string(#classname),		\
+		table.insert(#classname,			\
 			&(classname ## _unarchiver::create));	\
 	}							\
 }								\
@@ -239,6 +257,26 @@ classname ## _unarchiver::~ classname ## _unarchiver() { }	\
 int classname ## _unarchiver::usecount = 0
 
 
+/** Counters describing the size of an archive and the work done in
+ *  building and writing it.
+ *  @see archive::get_statistics */
+struct archive_statistics {
+	unsigned long nodes;          ///< number of nodes in the archive
+	unsigned long atoms;          ///< number of distinct strings in the archive
+	unsigned long dedup_hits;     ///< subexpressions found to be archived already
+	unsigned long bytes_written;  ///< bytes of archive data written to streams and files
+};
+
+
+// Append expression to buffer in a compact binary format for transferring it to another process, the symbols in syms are written by their position
+extern void serialize(const ex &e, std::string &buf, const lst &syms);
+extern void serialize(const ex &e, std::string &buf);
+
+// Read expression written by serialize() from buffer at pos, which is advanced past it, symbols by position or name from syms
+extern ex deserialize(const std::string &buf, std::size_t &pos, lst &syms);
+extern ex deserialize(const std::string &buf, lst &syms);
+
+
 /** This class holds archived versions of GiNaC expressions (class ex).
  *  An archive can be constructed from an expression and then written to
  *  a stream; or it can be read from a stream and then unarchived, yielding
@@ -250,16 +288,18 @@ class archive
 {
 	friend std::ostream &operator<<(std::ostream &os, const archive &ar);
 	friend std::istream &operator>>(std::istream &is, archive &ar);
+	friend void serialize(const ex &e, std::string &buf, const lst &syms);
+	friend ex deserialize(const std::string &buf, std::size_t &pos, lst &syms);
 
 public:
-	archive() {}
+	archive() : mapped(new mapped_file), dedup_hits(0), bytes_written(0), atoms_frozen(false) {}
 	~archive() {}
 
 	/** Construct archive from expression using the default name "ex". */
-	archive(const ex &e) {archive_ex(e, "ex");}
+	archive(const ex &e) : mapped(new mapped_file), dedup_hits(0), bytes_written(0), atoms_frozen(false) {archive_ex(e, "ex");}
 
 	/** Construct archive from expression using the specified name. */
-	archive(const ex &e, const char *n) {archive_ex(e, n);}
+	archive(const ex &e, const char *n) : mapped(new mapped_file), dedup_hits(0), bytes_written(0), atoms_frozen(false) {archive_ex(e, n);}
 
 	/** Archive an expression.
 	 *  @param e the expression to be archived
@@ -290,19 +330,143 @@ public:
 	/** Return reference to top node of an expression specified by index. */
 	const archive_node &get_top_node(unsigned index = 0) const;
 
+	/** Return the name of an expression specified by index. */
+	std::string get_name(unsigned index = 0) const;
+
+	/** Return the number of different nodes of an expression specified by
+	 *  index, without unarchiving it. Nodes of an archive loaded with
+	 *  load_indexed() are read from the file without being kept. */
+	unsigned count_nodes(unsigned index = 0) const;
+
+	/** Write archive to a file in the indexed format. Besides the data of
+	 *  the stream format, the file holds tables of the offsets of all atoms
+	 *  and nodes, so that load_indexed() can decode them one at a time.
+	 *  @param filename name of the file (conventionally ending in ".gar")
+	 *  @param compress whether to compress the nodes and atoms in blocks
+	 *         which are decompressed individually when they are needed
+	 *         (requires GiNaC to be built with zlib) */
+	void save_indexed(const std::string &filename, bool compress = false) const;
+
+	/** Start writing the archive to a stream in the indexed format. The
+	 *  nodes archived so far are written at once, and the nodes of all
+	 *  expressions archived afterwards are written as they are created
+	 *  instead of being kept in memory. Only the atoms, the index of
+	 *  expressions and the node offsets remain in memory until
+	 *  finish_indexed() completes the output.
+	 *  @param os stream, which must stay valid until finish_indexed()
+	 *  @param compress whether to compress blocks, like in save_indexed()
+	 *  @see finish_indexed */
+	void start_indexed(std::ostream &os, bool compress = false);
+
+	/** Write the atoms and the index of expressions to the stream given to
+	 *  start_indexed() and clear the archive. */
+	void finish_indexed();
+
+	/** Replace the contents of the archive by a file written with
+	 *  save_indexed(). The file is mapped into memory (where supported)
+	 *  and only the index of expressions is read; archive nodes and atoms
+	 *  are decoded when an unarchived expression refers to them.
+	 *  @param filename name of the file */
+	void load_indexed(const std::string &filename);
+
 	/** Clear all archived expressions. */
 	void clear();
 
+	/** Return the current number of nodes and atoms, together with the
+	 *  deduplicated subexpressions and the bytes written by operator<<,
+	 *  save_indexed() and start_indexed() since the archive was created
+	 *  or reset_statistics() was called. */
+	archive_statistics get_statistics() const;
+
+	/** Reset the counters of deduplicated subexpressions and written bytes. */
+	void reset_statistics();
+
 	archive_node_id add_node(const archive_node &n);
 	archive_node &get_node(archive_node_id id);
+	const archive_node &get_node(archive_node_id id) const;
 
 	void forget();
 	void printraw(std::ostream &os) const;
 
 private:
+	/** An indexed archive file loaded by load_indexed(). */
+	class mapped_file : public refcounted {
+	public:
+		mapped_file();
+		mapped_file(const std::string &filename);
+		~mapped_file();
+
+		std::size_t entry(std::size_t table, std::size_t index) const;
+		const unsigned char *bytes(std::size_t offset, const unsigned char *&end) const;
+		const char *atom(archive_atom id, std::size_t &len) const;
+		archive_atom find_atom(const std::string &s, bool &found) const;
+
+		const unsigned char *data; /**< Contents of the file. */
+		std::size_t size;          /**< Size of the file in bytes. */
+		bool is_mapped;            /**< Whether data is mapped rather than allocated. */
+		unsigned num_atoms;        /**< Number of atoms in the file. */
+		unsigned num_nodes;        /**< Number of nodes in the file. */
+		std::size_t atom_table;    /**< Position of the atom offset table. */
+		std::size_t node_table;    /**< Position of the node offset table. */
+		std::size_t sorted_table;  /**< Position of the table of atoms sorted by string. */
+		unsigned num_blocks;       /**< Number of compressed blocks (0 if not compressed). */
+		std::size_t block_table;   /**< Position of the table of compressed blocks. */
+	private:
+		/** Recently decompressed blocks and their numbers. */
+		mutable std::vector<std::string> cache;
+		mutable std::vector<unsigned> cached_blocks;
+		mutable unsigned next_cache_slot;
+
+		mapped_file(const mapped_file &);
+		mapped_file &operator=(const mapped_file &);
+	};
+
+	unsigned total_atoms() const;
+	unsigned total_nodes() const;
+	/** Output of nodes and atoms of an indexed archive, in blocks. */
+	struct index_output {
+		index_output() : os(0), compress(false), pos(0), file_pos(0) {}
+		void start(std::ostream &s, bool c);
+		std::size_t next_offset() const { return pos + block.size(); }
+		void added() { if (block.size() >= block_size) flush(); }
+		void flush();
+
+		static const std::size_t block_size = 65536;
+		std::ostream *os;         /**< Stream written to, or 0. */
+		bool compress;            /**< Whether blocks are compressed. */
+		std::size_t pos;          /**< Offset of the current block (uncompressed). */
+		std::size_t file_pos;     /**< Number of bytes written to the stream. */
+		std::string block;        /**< Data of the current block. */
+		std::vector<std::size_t> node_offsets; /**< Offsets of the written nodes. */
+		std::vector<std::size_t> blocks;       /**< Offset, file position, size and compressed size of each written block. */
+	};
+
+	ex unarchive_root(archive_node_id id, lst &sym_lst) const;
+	void get_operands(archive_node_id id, std::vector<archive_node_id> &ops) const;
+	bool unarchive_operands_parallel(const archive_node &root, lst &sym_lst) const;
+	void write_serialized(std::string &buf, archive_node_id root, const lst &syms) const;
+	ex read_serialized(const std::string &buf, std::size_t &pos, lst &syms);
+
+	std::size_t write_node(std::ostream &os, const archive_node &n) const;
+	void write_node(std::string &s, const archive_node &n) const;
+	void write_index(index_output &o) const;
+
+	/** File loaded by load_indexed() (empty otherwise). Its atoms and
+	 *  nodes precede the ones in the atoms and nodes vectors. */
+	ptr<mapped_file> mapped;
+
+	/** Nodes of the mapped file decoded so far. */
+	mutable std::map<archive_node_id, archive_node> mapped_nodes;
+
+	/** Atoms of the mapped file looked up so far. */
+	mutable std::map<archive_atom, std::string> mapped_atoms;
+
 	/** Vector of archived nodes. */
 	std::vector<archive_node> nodes;
 
+	/** Output that new nodes are written to after start_indexed(). */
+	index_output out;
+
 	/** Archived expression descriptor. */
 	struct archived_ex {
 		archived_ex() {}
@@ -328,15 +492,30 @@ private:
 	typedef std::map<std::string, archive_atom>::const_iterator inv_at_cit;
 	mutable std::map<std::string, archive_atom> inverse_atoms;
 
-	/** Map of stored expressions to nodes for faster archiving */
-	typedef std::map<ex, archive_node_id, ex_is_less>::iterator mapit;
-	mutable std::map<ex, archive_node_id, ex_is_less> exprtable;
+	/** Hash table of stored expressions to nodes for faster archiving */
+	typedef exhashmap<archive_node_id>::iterator mapit;
+	mutable exhashmap<archive_node_id> exprtable;
+
+	/** Number of nodes that were not added because their expression was
+	 *  archived already. */
+	unsigned long dedup_hits;
+
+	/** Number of bytes written to streams and files. */
+	mutable unsigned long bytes_written;
+
+	/** Set while several threads unarchive, atomize() then doesn't add
+	 *  atoms. */
+	mutable bool atoms_frozen;
 };
 
 
 std::ostream &operator<<(std::ostream &os, const archive &ar);
 std::istream &operator>>(std::istream &is, archive &ar);
 
+// Number of threads used by unarchive_ex() for the operands of an archived expression (default 1), returns previous setting
+extern unsigned set_unarchive_threads(unsigned n);
+extern unsigned get_unarchive_threads();
+
 } // namespace GiNaC
 
 #endif // ndef GINAC_ARCHIVE_H
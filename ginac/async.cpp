@@ -0,0 +1,345 @@
+/** @file async.cpp
+ *
+ *  Implementation of the computations run in the background. */
+
+/*
+ *  GiNaC Copyright (C) 1999-2014 Johannes Gutenberg University Mainz, Germany
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include "async.h"
+#include "budget.h"
+#include "factor.h"
+#include "normal.h"
+#include "numeric.h"
+#include "tasks.h"
+#include "utils.h"
+
+#include <stdexcept>
+#include <string>
+#if defined(GINAC_THREADSAFE_REFCOUNT) && defined(HAVE_PTHREAD_H)
+// Expressions may only be handed to another thread if their reference
+// counts are updated atomically.
+#define ASYNC_TASKS 1
+#include <pthread.h>
+#endif
+
+namespace GiNaC {
+
+/** A computation of async_normal() and friends, shared by its handles and
+ *  the task doing it. */
+class async_state {
+public:
+	enum operation { op_normal, op_factor, op_gcd, op_series };
+
+	async_state(operation o, const ex & a, const ex & b, int ord, unsigned opts,
+	            progress_callback progress, void * data)
+	 : op(o), arg1(a), arg2(b), order(ord), options(opts), error(no_error),
+	   pole_degree(0), done(false), refs(1), handles(1)
+	{
+		reporter.callback = progress;
+		reporter.data = data;
+#ifdef ASYNC_TASKS
+		pthread_mutex_init(&mutex, 0);
+		pthread_cond_init(&finished, 0);
+#endif
+	}
+	~async_state()
+	{
+#ifdef ASYNC_TASKS
+		pthread_cond_destroy(&finished);
+		pthread_mutex_destroy(&mutex);
+#endif
+	}
+
+	void compute();
+	void finish();
+	bool is_done();
+	void wait();
+	ex get();
+
+	void acquire()
+	{
+		atomic_add(refs, 1);
+	}
+	void acquire_handle()
+	{
+		atomic_add(handles, 1);
+		atomic_add(refs, 1);
+	}
+	void release_handle()
+	{
+		if (atomic_add(handles, -1) == 0)
+			token.cancel();
+		release();
+	}
+	void release()
+	{
+		if (atomic_add(refs, -1) == 0)
+			delete this;
+	}
+
+	/** Make the task the owner of its inputs.  Returns false if they can't
+	 *  be handed to another thread. */
+	bool copy_inputs()
+	{
+		ex a, b;
+		if (!copy_numbers(arg1, a) || !copy_numbers(arg2, b))
+			return false;
+		arg1 = a;
+		arg2 = b;
+		return true;
+	}
+
+	cancellation_token token;
+
+private:
+	static int atomic_add(int & counter, int delta)
+	{
+#ifdef GINAC_THREADSAFE_REFCOUNT
+		return __sync_add_and_fetch(&counter, delta);
+#else
+		return counter += delta;
+#endif
+	}
+
+	enum error_kind { no_error, aborted, pole, invalid, other };
+
+	const operation op;
+	ex arg1, arg2;
+	const int order;
+	const unsigned options;
+	progress_reporter reporter;
+	ex result;
+	error_kind error;
+	computation_aborted::reason_type abort_reason;
+	std::string message;
+	int pole_degree;
+	bool done;
+	int refs;     ///< handles and the task
+	int handles;
+#ifdef ASYNC_TASKS
+	pthread_mutex_t mutex;
+	pthread_cond_t finished;
+#endif
+
+	async_state(const async_state &);
+	async_state & operator=(const async_state &);
+};
+
+void async_state::compute()
+{
+	try {
+		computation_budget budget(&token);
+		progress_scope scope(reporter.callback ? &reporter : 0);
+		switch (op) {
+		case op_normal:
+			result = normal(arg1);
+			break;
+		case op_factor:
+			result = factor(arg1, options);
+			break;
+		case op_gcd:
+			result = gcd(arg1, arg2);
+			break;
+		case op_series:
+			result = series(arg1, arg2, order, options);
+			break;
+		}
+	} catch (const computation_aborted & e) {
+		error = aborted;
+		abort_reason = e.reason();
+		message = e.what();
+	} catch (const pole_error & e) {
+		error = pole;
+		pole_degree = e.degree();
+		message = e.what();
+	} catch (const std::invalid_argument & e) {
+		error = invalid;
+		message = e.what();
+	} catch (const std::exception & e) {
+		error = other;
+		message = e.what();
+	} catch (...) {
+		error = other;
+		message = "unknown exception";
+	}
+	// The inputs' numbers are the task's own, release them here
+	arg1 = arg2 = _ex0;
+}
+
+/** Mark the computation as done.  Called after the worker has released
+ *  its thread-local state, so the result may be used by any thread. */
+void async_state::finish()
+{
+#ifdef ASYNC_TASKS
+	pthread_mutex_lock(&mutex);
+	done = true;
+	pthread_cond_broadcast(&finished);
+	pthread_mutex_unlock(&mutex);
+#else
+	done = true;
+#endif
+}
+
+bool async_state::is_done()
+{
+#ifdef ASYNC_TASKS
+	pthread_mutex_lock(&mutex);
+	const bool d = done;
+	pthread_mutex_unlock(&mutex);
+	return d;
+#else
+	return done;
+#endif
+}
+
+void async_state::wait()
+{
+#ifdef ASYNC_TASKS
+	pthread_mutex_lock(&mutex);
+	while (!done)
+		pthread_cond_wait(&finished, &mutex);
+	pthread_mutex_unlock(&mutex);
+#endif
+}
+
+ex async_state::get()
+{
+	wait();
+	switch (error) {
+	case no_error:
+		break;
+	case aborted:
+		throw computation_aborted(abort_reason, message);
+	case pole:
+		throw pole_error(message, pole_degree);
+	case invalid:
+		throw std::invalid_argument(message);
+	case other:
+		throw std::runtime_error(message);
+	}
+	return result;
+}
+
+static void * run_async(void * arg)
+{
+	static_cast<async_state *>(arg)->compute();
+	return 0;
+}
+
+static void finish_async(void * arg)
+{
+	async_state * s = static_cast<async_state *>(arg);
+	s->finish();
+	s->release();
+}
+
+/** Start the computation, as a task if possible, and return its handle. */
+static async_result start(async_state * s)
+{
+	async_result handle(s);
+#ifdef ASYNC_TASKS
+	if (get_task_threads() > 0 && s->copy_inputs()) {
+		s->acquire();  // the task's reference
+		post_task(run_async, s, finish_async);
+		return handle;
+	}
+#endif
+	s->compute();
+	s->finish();
+	return handle;
+}
+
+async_result::async_result(async_state * s) : state(s)
+{
+}
+
+async_result::async_result(const async_result & other) : state(other.state)
+{
+	if (state)
+		state->acquire_handle();
+}
+
+async_result & async_result::operator=(const async_result & other)
+{
+	if (other.state)
+		other.state->acquire_handle();
+	if (state)
+		state->release_handle();
+	state = other.state;
+	return *this;
+}
+
+async_result::~async_result()
+{
+	if (state)
+		state->release_handle();
+}
+
+bool async_result::ready() const
+{
+	if (!state)
+		throw std::logic_error("async_result::ready(): no computation");
+	return state->is_done();
+}
+
+void async_result::wait() const
+{
+	if (!state)
+		throw std::logic_error("async_result::wait(): no computation");
+	state->wait();
+}
+
+ex async_result::get() const
+{
+	if (!state)
+		throw std::logic_error("async_result::get(): no computation");
+	return state->get();
+}
+
+void async_result::cancel() const
+{
+	if (state)
+		state->token.cancel();
+}
+
+async_result async_normal(const ex & e, progress_callback progress, void * data)
+{
+	return start(new async_state(async_state::op_normal, e, _ex0, 0, 0, progress, data));
+}
+
+async_result async_factor(const ex & p, unsigned options, progress_callback progress, void * data)
+{
+	return start(new async_state(async_state::op_factor, p, _ex0, 0, options, progress, data));
+}
+
+async_result async_gcd(const ex & a, const ex & b, progress_callback progress, void * data)
+{
+	return start(new async_state(async_state::op_gcd, a, b, 0, 0, progress, data));
+}
+
+async_result async_series(const ex & e, const ex & r, int order, unsigned options,
+                          progress_callback progress, void * data)
+{
+	return start(new async_state(async_state::op_series, e, r, order, options, progress, data));
+}
+
+} // namespace GiNaC
@@ -0,0 +1,91 @@
+/** @file async.h
+ *
+ *  Interface to the computations run in the background. */
+
+/*
+ *  GiNaC Copyright (C) 1999-2014 Johannes Gutenberg University Mainz, Germany
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#ifndef GINAC_ASYNC_H
+#define GINAC_ASYNC_H
+
+#include "ex.h"
+#include "profile.h"
+
+namespace GiNaC {
+
+class async_state;
+
+/** Handle of a computation started by async_normal(), async_factor(),
+ *  async_gcd() or async_series().  Copies refer to the same computation,
+ *  which is cancelled when the last of them is destroyed before it is
+ *  done. */
+class async_result {
+public:
+	async_result() : state(0) {}
+	explicit async_result(async_state * s);
+	async_result(const async_result & other);
+	async_result & operator=(const async_result & other);
+	~async_result();
+
+	/** Whether this refers to a computation at all. */
+	bool valid() const { return state != 0; }
+	/** Whether the computation is done, so that get() doesn't block. */
+	bool ready() const;
+	/** Block until the computation is done. */
+	void wait() const;
+	/** Wait for the result and return it.  If the computation threw, an
+	 *  exception of the same kind is thrown here (computation_aborted with
+	 *  its reason, pole_error, std::invalid_argument, or else
+	 *  std::runtime_error with the same message). */
+	ex get() const;
+	/** Ask the computation to stop at its next safe point, after which get()
+	 *  throws computation_aborted. */
+	void cancel() const;
+
+private:
+	async_state * state;
+};
+
+/** Start normal(e) in the background.  If progress is not 0, it is called
+ *  with data when a traced phase of the computation begins (see
+ *  progress_callback), by the thread doing it.
+ *
+ *  The computation runs as a task (see post_task()) under a
+ *  computation_budget with its own cancellation_token.  If GiNaC was built
+ *  without GINAC_THREADSAFE_REFCOUNT and pthreads, there are no task
+ *  workers, or e contains floating point numbers (which can't be copied
+ *  for another thread, see copy_numbers()), it is done before the call
+ *  returns. */
+extern async_result async_normal(const ex & e, progress_callback progress = 0, void * data = 0);
+
+/** Start factor(p, options) in the background, like async_normal(). */
+extern async_result async_factor(const ex & p, unsigned options = 0,
+                                 progress_callback progress = 0, void * data = 0);
+
+/** Start gcd(a, b) in the background, like async_normal(). */
+extern async_result async_gcd(const ex & a, const ex & b,
+                              progress_callback progress = 0, void * data = 0);
+
+/** Start series(e, r, order, options) in the background, like
+ *  async_normal(). */
+extern async_result async_series(const ex & e, const ex & r, int order, unsigned options = 0,
+                                 progress_callback progress = 0, void * data = 0);
+
+} // namespace GiNaC
+
+#endif // ndef GINAC_ASYNC_H
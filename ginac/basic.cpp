@@ -25,6 +25,8 @@
 #include "numeric.h"
 #include "power.h"
 #include "add.h"
+#include "mul.h"
+#include "normal.h"
 #include "symbol.h"
 #include "lst.h"
 #include "ncmul.h"
@@ -35,9 +37,13 @@
 #include "utils.h"
 #include "hash_seed.h"
 #include "inifcns.h"
+#include "profile.h"
+#include "subs_index.h"
 
 #include <iostream>
+#include <map>
 #include <stdexcept>
+#include <string>
 #include <typeinfo>
 
 namespace GiNaC {
@@ -56,22 +62,29 @@ GINAC_IMPLEMENT_REGISTERED_CLASS_OPT(basic, void,
 /** basic copy constructor: implicitly assumes that the other class is of
  *  the exact same type (as it's used by duplicate()), so it can copy the
  *  tinfo_key and the hash value. */
-basic::basic(const basic & other) : flags(other.flags & ~status_flags::dynallocated), hashvalue(other.hashvalue)
+basic::basic(const basic & other) : flags(other.flags & ~(status_flags::dynallocated | status_flags::hash_consed | status_flags::normal_cached)), hashvalue(other.hashvalue), symbolmask(other.symbolmask)
 {
 }
 
 /** basic assignment operator: the other object might be of a derived class. */
 const basic & basic::operator=(const basic & other)
 {
-	unsigned fl = other.flags & ~status_flags::dynallocated;
+	// The contents are about to change, so this object can no longer stand
+	// for its old value in the hash-consing table.
+	if (flags & status_flags::hash_consed)
+		forget_hash_consed();
+	if (flags & status_flags::normal_cached)
+		forget_normal_form();
+	unsigned fl = other.flags & ~(status_flags::dynallocated | status_flags::hash_consed | status_flags::normal_cached);
 	if (typeid(*this) != typeid(other)) {
 		// The other object is of a derived class, so clear the flags as they
 		// might no longer apply (especially hash_calculated). Oh, and don't
 		// copy the tinfo_key: it is already set correctly for this object.
-		fl &= ~(status_flags::evaluated | status_flags::expanded | status_flags::hash_calculated);
+		fl &= ~(status_flags::evaluated | status_flags::expanded | status_flags::hash_calculated | status_flags::symbols_calculated);
 	} else {
 		// The objects are of the exact same class, so copy the hash value.
 		hashvalue = other.hashvalue;
+		symbolmask = other.symbolmask;
 	}
 	flags = fl;
 	set_refcount(0);
@@ -108,6 +121,32 @@ void basic::archive(archive_node &n) const
 
 // public
 
+/** Count b as printed with the print_dag context c, and number it if it has
+ *  more than one reference.
+ *  @return false if b has been printed before, so that only its number is
+ *          printed again */
+static bool enter_dag_node(const basic & b, const print_dag & c, unsigned level)
+{
+	const std::size_t size = b.footprint();
+	const unsigned refs = b.get_refcount();
+	if (refs > 1) {
+		std::map<const basic *, unsigned>::const_iterator i = c.ids.find(&b);
+		if (i != c.ids.end()) {
+			++c.repeats;
+			c.s << std::string(level, ' ') << '#' << i->second << ' ' << b.class_name()
+			    << " @" << &b << " (see above)" << std::endl;
+			return false;
+		}
+		const unsigned id = c.ids.size() + 1;
+		c.ids.insert(std::make_pair(&b, id));
+		c.s << std::string(level, ' ') << '#' << id << ": refcount=" << refs
+		    << ", footprint=" << size << std::endl;
+	}
+	++c.nodes;
+	c.bytes += size;
+	return true;
+}
+
 /** Output to stream. This performs double dispatch on the dynamic type of
  *  *this and the dynamic type of the supplied print context.
  *  @param c print context object that describes the output formatting
@@ -115,19 +154,17 @@ void basic::archive(archive_node &n) const
  *               level for placing parentheses and formatting */
 void basic::print(const print_context & c, unsigned level) const
 {
+	if (is_a<print_dag>(c) && !enter_dag_node(*this, static_cast<const print_dag &>(c), level))
+		return;
 	print_dispatch(get_class_info(), c, level);
 }
 
-/** Like print(), but dispatch to the specified class. Can be used by
- *  implementations of print methods to dispatch to the method of the
- *  superclass.
- *
- *  @see basic::print */
-void basic::print_dispatch(const registered_class_info & ri, const print_context & c, unsigned level) const
+/** Find the print method of class ri for print_context class ci by looking
+ *  at the parent contexts and then at the parent classes. */
+static const print_functor & find_print_func(const registered_class_info & ri, const print_context_class_info & ci)
 {
-	// Double dispatch on object type and print_context type
 	const registered_class_info * reg_info = &ri;
-	const print_context_class_info * pc_info = &c.get_class_info();
+	const print_context_class_info * pc_info = &ci;
 
 next_class:
 	const std::vector<print_functor> & pdt = reg_info->options.get_print_dispatch_table();
@@ -147,7 +184,7 @@ next_context:
 		const registered_class_info * parent_reg_info = reg_info->get_parent();
 		if (parent_reg_info) {
 			reg_info = parent_reg_info;
-			pc_info = &c.get_class_info();
+			pc_info = &ci;
 			goto next_class;
 		}
 
@@ -156,13 +193,63 @@ next_context:
 		// print_context (the base class of the print context hierarchy),
 		// so if we end up here, there's something wrong with the class
 		// registry.
-		throw (std::runtime_error(std::string("basic::print(): method for ") + class_name() + "/" + c.class_name() + " not found"));
+		throw (std::runtime_error(std::string("basic::print(): method for ") + ri.options.get_name() + "/" + ci.options.get_name() + " not found"));
+	}
+	return pdt[id];
+}
 
-	} else {
+/** Add the print method of class ri for print_context class ci to the table
+ *  of resolved print methods of ri, replacing the table if it is outdated. */
+static const registered_class_options::resolved_print_funcs *
+resolve_print_func(const registered_class_info & ri, const print_context_class_info & ci)
+{
+	typedef registered_class_options::resolved_print_funcs table;
+	const unsigned generation = registered_class_options::print_func_generation;
+	const unsigned id = ci.options.get_id();
+
+	// Tables are never modified after they are installed, but copied, since
+	// other threads may be reading them
+	const table * old = ri.options.get_resolved_print_funcs();
+	table * t = new table;
+	t->generation = generation;
+	if (old && old->generation == generation)
+		t->funcs = old->funcs;
+	if (id >= t->funcs.size())
+		t->funcs.resize(next_print_context_id > id ? next_print_context_id : id + 1, 0);
+	t->funcs[id] = &find_print_func(ri, ci);
+
+#ifdef GINAC_THREADSAFE_REFCOUNT
+	// The old table is left to the threads which may still be reading it
+	__sync_synchronize();
+	ri.options.set_resolved_print_funcs(t);
+#else
+	ri.options.set_resolved_print_funcs(t);
+	delete old;
+#endif
+	return t;
+}
 
-		// Call method
-		pdt[id](*this, c, level);
-	}
+/** Like print(), but dispatch to the specified class. Can be used by
+ *  implementations of print methods to dispatch to the method of the
+ *  superclass.
+ *
+ *  The print method for each class and print_context class is looked up in
+ *  the class hierarchies only once and then taken from a table indexed by
+ *  the ID of the print_context class, until print methods are changed.
+ *
+ *  @see basic::print */
+void basic::print_dispatch(const registered_class_info & ri, const print_context & c, unsigned level) const
+{
+	const print_context_class_info & ci = c.get_class_info();
+	const unsigned id = ci.options.get_id();
+	const registered_class_options::resolved_print_funcs * t = ri.options.get_resolved_print_funcs();
+	if (!t || t->generation != registered_class_options::print_func_generation
+	 || id >= t->funcs.size() || !t->funcs[id])
+		t = resolve_print_func(ri, ci);
+
+	// Call method
+	const print_functor & f = *t->funcs[id];
+	f(*this, c, level);
 }
 
 /** Default output to stream. */
@@ -189,6 +276,22 @@ void basic::do_print_python_repr(const print_python_repr & c, unsigned level) co
 	c.s << class_name() << "()";
 }
 
+/** Approximate number of bytes of memory used by this object, not counting
+ *  its subexpressions. */
+std::size_t basic::footprint() const
+{
+	return object_size();
+}
+
+/** Append the subexpressions this object holds in memory to v.  These are
+ *  its operands unless op() constructs them on the fly, in which case the
+ *  parts they are constructed from are appended instead. */
+void basic::stored_operands(exvector & v) const
+{
+	for (size_t i=0; i<nops(); ++i)
+		v.push_back(op(i));
+}
+
 /** Little wrapper around print to be called within a debugger.
  *  This is needed because you cannot call foo.print(cout) from within the
  *  debugger because it might not know what cout is.  This method can be
@@ -279,6 +382,9 @@ ex & basic::operator[](size_t i)
  *  but e.has(x+y) is false. */
 bool basic::has(const ex & pattern, unsigned options) const
 {
+	if (lacks_symbol(ex_to<basic>(pattern)))
+		return false;
+
 	exmap repl_lst;
 	if (match(pattern, repl_lst))
 		return true;
@@ -310,7 +416,7 @@ ex basic::map(map_function & f) const
 
 	if (copy) {
 		copy->setflag(status_flags::dynallocated);
-		copy->clearflag(status_flags::hash_calculated | status_flags::expanded);
+		copy->clearflag(status_flags::hash_calculated | status_flags::symbols_calculated | status_flags::expanded);
 		return *copy;
 	} else
 		return *this;
@@ -364,26 +470,20 @@ ex basic::collect(const ex & s, bool distributed) const
 				return x; 
 			const lst& l(ex_to<lst>(s));
 
-			exmap cmap;
-			cmap[_ex1] = _ex0;
-			for (const_iterator xi=x.begin(); xi!=x.end(); ++xi) {
-				ex key = _ex1;
-				ex pre_coeff = *xi;
-				for (lst::const_iterator li=l.begin(); li!=l.end(); ++li) {
-					int cexp = pre_coeff.degree(*li);
-					pre_coeff = pre_coeff.coeff(*li, cexp);
-					key *= pow(*li, cexp);
-				}
-				exmap::iterator ci = cmap.find(key);
-				if (ci != cmap.end())
-					ci->second += pre_coeff;
-				else
-					cmap.insert(exmap::value_type(key, pre_coeff));
-			}
-
+			// Coefficients by exponent vector, in one pass over the terms
+			const exp_coeff_map cmap = collect_coeffs(x, l);
 			exvector resv;
-			for (exmap::const_iterator mi=cmap.begin(); mi != cmap.end(); ++mi)
-				resv.push_back((mi->first)*(mi->second));
+			resv.reserve(cmap.size());
+			for (exp_coeff_map::const_iterator mi=cmap.begin(); mi != cmap.end(); ++mi) {
+				exvector factors;
+				factors.reserve(l.nops() + 1);
+				size_t i = 0;
+				for (lst::const_iterator li=l.begin(); li!=l.end(); ++li, ++i)
+					if (mi->first[i] != 0)
+						factors.push_back(pow(*li, mi->first[i]));
+				factors.push_back(mi->second);
+				resv.push_back((new mul(factors))->setflag(status_flags::dynallocated));
+			}
 			return (new add(resv))->setflag(status_flags::dynallocated);
 
 		} else {
@@ -441,6 +541,23 @@ ex basic::evalf(int level) const
 	}
 }
 
+/** Evaluate object numerically in hardware double precision, taking the
+ *  values of the symbols from the map.  The classes of sums, products,
+ *  powers and functions do so without creating expressions, this default
+ *  implementation substitutes the values and calls evalf().
+ *
+ *  @exception invalid_argument (object does not evaluate to a number) */
+std::complex<double> basic::evalf_double(const evalf_double_map & values) const
+{
+	exmap m;
+	for (evalf_double_map::const_iterator i = values.begin(); i != values.end(); ++i)
+		m[i->first] = numeric(i->second.real()) + I * numeric(i->second.imag());
+	const ex e = (m.empty() ? ex(*this) : subs(m)).evalf();
+	if (!is_exactly_a<numeric>(e))
+		throw std::invalid_argument("evalf_double(): expression does not evaluate to a number");
+	return ex_to<numeric>(e).evalf_double(values);
+}
+
 /** Function object to be applied by basic::evalm(). */
 struct evalm_map_function : public map_function {
 	ex operator()(const ex & e) { return evalm(e); }
@@ -601,6 +718,15 @@ ex basic::subs_one_level(const exmap & m, unsigned options) const
 		if (it != m.end())
 			return it->second;
 		return thisex;
+	} else if (const subs_index * index = subs_index::find(m)) {
+		// Only try the keys which could match
+		subs_index::key_vector keys;
+		index->match_candidates(*this, keys);
+		for (subs_index::key_vector::const_iterator k = keys.begin(); k != keys.end(); ++k) {
+			exmap repl_lst;
+			if (match(ex_to<basic>((*k)->first), repl_lst))
+				return (*k)->second.subs(repl_lst, options | subs_options::no_pattern);
+		}
 	} else {
 		for (it = m.begin(); it != m.end(); ++it) {
 			exmap repl_lst;
@@ -629,7 +755,7 @@ ex basic::subs(const exmap & m, unsigned options) const
 				// Something changed, clone the object
 				basic *copy = duplicate();
 				copy->setflag(status_flags::dynallocated);
-				copy->clearflag(status_flags::hash_calculated | status_flags::expanded);
+				copy->clearflag(status_flags::hash_calculated | status_flags::symbols_calculated | status_flags::expanded);
 
 				// Substitute the changed operand
 				copy->let_op(i++) = subsed_op;
@@ -796,6 +922,27 @@ unsigned basic::calchash() const
 	return v;
 }
 
+/** Compute the mask returned by get_symbol_mask() and if it makes sense to
+ *  store it in the object, do so.  The method inherited from class basic
+ *  joins the masks of the operands.  An object without operands might hide
+ *  any symbol, so it gets all bits; atomic classes and classes which keep
+ *  expressions outside of their operands should override this. */
+unsigned basic::calc_symbol_mask() const
+{
+	size_t num = nops();
+	unsigned mask = num ? 0 : ~0u;
+	for (size_t i=0; i<num; i++)
+		mask |= this->op(i).get_symbol_mask();
+
+	// store calculated mask only if object is already evaluated
+	if (flags & status_flags::evaluated) {
+		symbolmask = mask;
+		setflag(status_flags::symbols_calculated);
+	}
+
+	return mask;
+}
+
 /** Function object to be applied by basic::expand(). */
 struct expand_map_function : public map_function {
 	unsigned options;
@@ -830,6 +977,7 @@ int basic::compare(const basic & other) const
 #ifdef GINAC_COMPARE_STATISTICS
 	compare_statistics.total_basic_compares++;
 #endif
+	profile_count(profile_compares);
 	const unsigned hash_this = gethash();
 	const unsigned hash_other = other.gethash();
 	if (hash_this<hash_other) return -1;
@@ -854,8 +1002,12 @@ int basic::compare(const basic & other) const
 #ifdef GINAC_COMPARE_STATISTICS
 		compare_statistics.compare_same_type++;
 #endif
-		return compare_same_type(other);
+		const int cmpval = compare_same_type(other);
+		if (cmpval)
+			profile_count(profile_compare_collisions);
+		return cmpval;
 	} else {
+		profile_count(profile_compare_collisions);
 // 		std::cout << "hash collision, different types: " 
 // 		          << *this << " and " << other << std::endl;
 // 		this->print(print_tree(std::cout));
@@ -877,6 +1029,7 @@ bool basic::is_equal(const basic & other) const
 #ifdef GINAC_COMPARE_STATISTICS
 	compare_statistics.total_basic_is_equals++;
 #endif
+	profile_count(profile_is_equals);
 	if (this->gethash()!=other.gethash())
 		return false;
 #ifdef GINAC_COMPARE_STATISTICS
@@ -907,9 +1060,309 @@ void basic::ensure_if_modifiable() const
 {
 	if (get_refcount() > 1)
 		throw(std::runtime_error("cannot modify multiply referenced object"));
-	clearflag(status_flags::hash_calculated | status_flags::evaluated);
+	clearflag(status_flags::hash_calculated | status_flags::symbols_calculated | status_flags::evaluated);
+}
+
+/** Check whether s is a symbol which the object can't contain, because the
+ *  bit of s is missing from its symbol mask (see get_symbol_mask()). */
+bool basic::lacks_symbol(const basic & s) const
+{
+	return is_a<symbol>(s) && !(get_symbol_mask() & s.get_symbol_mask());
+}
+
+//////////
+// memory management
+//////////
+
+#ifdef GINAC_THREADSAFE_REFCOUNT
+#define GINAC_POOL_THREAD_LOCAL __thread
+#else
+#define GINAC_POOL_THREAD_LOCAL
+#endif
+
+namespace {
+
+/** Header in front of each allocated object.  It records the size class
+ *  of the block (0 if it came from the global operator new) and the class
+ *  of the object if its birth was profiled, and keeps the object aligned as
+ *  strictly as the global operator new would. */
+union pool_header {
+	struct {
+		std::size_t size_class;
+		const char * profiled_class;
+	} info;
+	long double align_ld;
+	void * align_p;
+};
+
+const std::size_t pool_granularity = sizeof(pool_header);
+const std::size_t pool_classes = 16;  // blocks of up to 16*pool_granularity bytes
+const std::size_t pool_chunk_size = 64 * 1024;
+
+/** Per-thread pool.  Must be a POD, so it can be thread-local. */
+struct pool_state {
+	bool enabled;
+	void * free_list[pool_classes + 1];  ///< singly linked through the blocks
+	char * chunk_top;                    ///< unused part of the current chunk
+	char * chunk_end;
+};
+
+GINAC_POOL_THREAD_LOCAL pool_state the_pool;
+
+} // anonymous namespace
+
+void * basic::operator new(std::size_t size)
+{
+	profile_count(profile_allocations);
+	pool_state & pool = the_pool;
+	const std::size_t size_class = (size + sizeof(pool_header) + pool_granularity - 1) / pool_granularity;
+
+	pool_header * h;
+	if (!pool.enabled || size_class > pool_classes) {
+		h = static_cast<pool_header *>(::operator new(size + sizeof(pool_header)));
+		h->info.size_class = 0;
+		h->info.profiled_class = 0;
+		return h + 1;
+	}
+
+	void * & head = pool.free_list[size_class];
+	if (head) {
+		h = static_cast<pool_header *>(head);
+		head = *reinterpret_cast<void **>(h + 1);
+	} else {
+		const std::size_t bytes = size_class * pool_granularity;
+		if (pool.chunk_top == 0 || std::size_t(pool.chunk_end - pool.chunk_top) < bytes) {
+			pool.chunk_top = static_cast<char *>(::operator new(pool_chunk_size));
+			pool.chunk_end = pool.chunk_top + pool_chunk_size;
+		}
+		h = reinterpret_cast<pool_header *>(pool.chunk_top);
+		pool.chunk_top += bytes;
+	}
+	h->info.size_class = size_class;
+	h->info.profiled_class = 0;
+	return h + 1;
+}
+
+void basic::operator delete(void * p) throw()
+{
+	if (!p)
+		return;
+	pool_header * h = static_cast<pool_header *>(p) - 1;
+	if (h->info.profiled_class && profiling_enabled)
+		profile_object_died(h->info.profiled_class);
+	if (h->info.size_class == 0) {
+		::operator delete(h);
+		return;
+	}
+	// Pooled blocks go to the free list of the thread releasing them, no
+	// matter whether that thread allocates from its pool right now.
+	void * & head = the_pool.free_list[h->info.size_class];
+	*reinterpret_cast<void **>(p) = head;
+	head = h;
+}
+
+/** Count an object being marked as allocated on the heap in the profile,
+ *  and remember its class for counting its destruction, unless that was
+ *  done before. */
+void basic::profile_birth() const
+{
+	pool_header * h = static_cast<pool_header *>(const_cast<void *>(dynamic_cast<const void *>(this))) - 1;
+	if (h->info.profiled_class)
+		return;
+	h->info.profiled_class = class_name();
+	profile_object_born(h->info.profiled_class, object_size());
+}
+
+bool set_pool_allocation(bool enable)
+{
+	const bool previous = the_pool.enabled;
+	the_pool.enabled = enable;
+	return previous;
+}
+
+bool get_pool_allocation()
+{
+	return the_pool.enabled;
+}
+
+
+//////////
+// hash-consing
+//////////
+
+namespace {
+
+/** The table of unique objects.  It doesn't hold a reference to them: an
+ *  object removes itself in its destructor, see basic::forget_hash_consed().
+ *  Buckets are selected by the low bits of the hash value. */
+struct hash_cons_table {
+	hash_cons_table() : buckets(1024), size(0), lookups(0), hits(0) {}
+
+	std::vector<basic *> & bucket(unsigned hash) { return buckets[hash & (buckets.size() - 1)]; }
+	void grow();
+
+	std::vector<std::vector<basic *> > buckets;
+	std::size_t size;
+	unsigned long lookups;
+	unsigned long hits;
+};
+
+void hash_cons_table::grow()
+{
+	std::vector<std::vector<basic *> > old(buckets.size() * 2);
+	old.swap(buckets);
+	for (std::vector<std::vector<basic *> >::const_iterator i = old.begin(); i != old.end(); ++i)
+		for (std::vector<basic *>::const_iterator j = i->begin(); j != i->end(); ++j)
+			bucket((*j)->gethash()).push_back(*j);
+}
+
+/** The table is never destroyed, because hash-consed objects may still be
+ *  around during static destruction. */
+hash_cons_table & the_hash_cons_table()
+{
+	static hash_cons_table * table = new hash_cons_table;
+	return *table;
 }
 
+bool hash_consing_enabled = false;
+
+#ifdef GINAC_THREADSAFE_REFCOUNT
+int hash_cons_mutex = 0;
+
+/** Scoped spin lock around accesses to the table. */
+class hash_cons_lock {
+public:
+	hash_cons_lock() { while (__sync_lock_test_and_set(&hash_cons_mutex, 1)) ; }
+	~hash_cons_lock() { __sync_lock_release(&hash_cons_mutex); }
+};
+#else
+class hash_cons_lock {
+public:
+	hash_cons_lock() {}
+};
+#endif
+
+} // anonymous namespace
+
+/** Look up an evaluated object in the hash-consing table.  If an equal
+ *  object is already there, return that one, otherwise register p.
+ *  Objects whose hash value is not final yet aren't registered. */
+ptr<basic> basic::hash_cons(const ptr<basic> & p)
+{
+	const basic & obj = *p;
+	if (obj.flags & (status_flags::hash_consed | status_flags::not_shareable))
+		return p;
+	const unsigned hash = obj.gethash();
+	if (!(obj.flags & status_flags::hash_calculated))
+		return p;
+
+	// Candidates which turn out to differ are released after the lock, since
+	// dropping the last reference removes them from the table.
+	std::vector<ptr<basic> > examined;
+	hash_cons_lock lock;
+	hash_cons_table & table = the_hash_cons_table();
+	++table.lookups;
+
+	// is_equal() may share subexpressions and thereby destroy other
+	// objects in the table, so the bucket is re-examined in every step.
+	std::vector<basic *> & b = table.bucket(hash);
+	for (std::size_t i = 0; i < b.size(); ++i) {
+		basic * candidate = b[i];
+		if (candidate->hashvalue != hash)
+			continue;
+		// An object whose last reference is just being dropped by another
+		// thread is partly destroyed already: it must neither be compared
+		// nor resurrected.
+		if (candidate->add_reference() == 1) {
+			candidate->remove_reference();
+			continue;
+		}
+		ptr<basic> held(*candidate);
+		candidate->remove_reference();
+		if (!candidate->is_equal(obj)) {
+			examined.push_back(held);
+			continue;
+		}
+		++table.hits;
+		return held;
+	}
+
+	obj.setflag(status_flags::hash_consed);
+	b.push_back(const_cast<basic *>(&obj));
+	if (++table.size > table.buckets.size())
+		table.grow();
+	return p;
+}
+
+/** Remove this object from the hash-consing table. */
+void basic::forget_hash_consed() const
+{
+	hash_cons_lock lock;
+	hash_cons_table & table = the_hash_cons_table();
+	clearflag(status_flags::hash_consed);
+
+	std::vector<basic *> & b = table.bucket(hashvalue);
+	std::vector<basic *>::iterator i = std::find(b.begin(), b.end(), this);
+	if (i != b.end()) {
+		*i = b.back();
+		b.pop_back();
+		--table.size;
+		return;
+	}
+	// The hash value has changed under our feet, so search everything.
+	for (std::vector<std::vector<basic *> >::iterator j = table.buckets.begin(); j != table.buckets.end(); ++j) {
+		i = std::find(j->begin(), j->end(), this);
+		if (i != j->end()) {
+			*i = j->back();
+			j->pop_back();
+			--table.size;
+			return;
+		}
+	}
+}
+
+bool set_hash_consing(bool enable)
+{
+	hash_cons_lock lock;
+	const bool previous = hash_consing_enabled;
+	hash_consing_enabled = enable;
+	if (!enable) {
+		hash_cons_table & table = the_hash_cons_table();
+		for (std::vector<std::vector<basic *> >::iterator i = table.buckets.begin(); i != table.buckets.end(); ++i) {
+			for (std::vector<basic *>::const_iterator j = i->begin(); j != i->end(); ++j)
+				(*j)->clearflag(status_flags::hash_consed);
+			i->clear();
+		}
+		table.size = 0;
+	}
+	return previous;
+}
+
+bool get_hash_consing()
+{
+	return hash_consing_enabled;
+}
+
+hash_consing_statistics get_hash_consing_statistics()
+{
+	hash_cons_lock lock;
+	const hash_cons_table & table = the_hash_cons_table();
+	hash_consing_statistics stats;
+	stats.lookups = table.lookups;
+	stats.hits = table.hits;
+	stats.size = table.size;
+	return stats;
+}
+
+void reset_hash_consing_statistics()
+{
+	hash_cons_lock lock;
+	hash_cons_table & table = the_hash_cons_table();
+	table.lookups = 0;
+	table.hits = 0;
+}
+
+
 //////////
 // global variables
 //////////
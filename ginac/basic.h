@@ -27,9 +27,11 @@
 #include "ptr.h"
 #include "assertion.h"
 #include "registrar.h"
+#include "profile.h"
 
 // CINT needs <algorithm> to work properly with <vector>
 #include <algorithm>
+#include <complex>
 #include <cstddef> // for size_t
 #include <map>
 #include <set>
@@ -49,6 +51,7 @@ class print_context;
 typedef std::vector<ex> exvector;
 typedef std::set<ex, ex_is_less> exset;
 typedef std::map<ex, ex, ex_is_less> exmap;
+typedef std::map<ex, std::complex<double>, ex_is_less> evalf_double_map;
 
 // Define this to enable some statistical output for comparisons and hashing
 #undef GINAC_COMPARE_STATISTICS
@@ -88,6 +91,10 @@ struct map_function {
 	typedef const ex & argument_type;
 	typedef ex result_type;
 	virtual ex operator()(const ex & e) = 0;
+
+	/** Whether the result only depends on the argument, so that ex::map()
+	 *  may reuse it for subexpressions which occur several times. */
+	virtual bool is_pure() const { return false; }
 };
 
 
@@ -117,10 +124,34 @@ public:
 	virtual ~basic()
 	{
 		GINAC_ASSERT((!(flags & status_flags::dynallocated)) || (get_refcount() == 0));
+		if (flags & status_flags::hash_consed)
+			forget_hash_consed();
+		if (flags & status_flags::normal_cached)
+			forget_normal_form();
 	}
 	basic(const basic & other);
 	const basic & operator=(const basic & other);
 
+	// memory management, see set_pool_allocation()
+	static void * operator new(std::size_t size);
+	static void operator delete(void * p) throw();
+	static void * operator new(std::size_t size, void * where) throw() { return where; }
+	static void operator delete(void * p, void * where) throw() {}
+private:
+	void profile_birth() const;
+public:
+
+	// hash-consing, see set_hash_consing()
+private:
+	static ptr<basic> hash_cons(const ptr<basic> & p);
+	void forget_hash_consed() const;
+
+	// cache of normal forms, see set_normal_caching()
+	void forget_normal_form() const;
+protected:
+	bool lookup_normal_form(ex & nd) const;
+	void remember_normal_form(const ex & nd) const;
+
 protected:
 	// new virtual functions which can be overridden by derived classes
 public: // only const functions please (may break reference counting)
@@ -133,6 +164,7 @@ public: // only const functions please (may break reference counting)
 	// evaluation
 	virtual ex eval(int level = 0) const;
 	virtual ex evalf(int level = 0) const;
+	virtual std::complex<double> evalf_double(const evalf_double_map & values) const;
 	virtual ex evalm() const;
 	virtual ex eval_integ() const;
 protected:
@@ -146,6 +178,10 @@ public:
 	virtual void dbgprinttree() const;
 	virtual unsigned precedence() const;
 
+	// memory use, see print_dag and ex::memory_usage()
+	virtual std::size_t footprint() const;
+	virtual void stored_operands(exvector & v) const;
+
 	// info
 	virtual bool info(unsigned inf) const;
 
@@ -225,6 +261,7 @@ protected:
 	virtual bool is_equal_same_type(const basic & other) const;
 
 	virtual unsigned calchash() const;
+	virtual unsigned calc_symbol_mask() const;
 	
 	// non-virtual functions in this class
 public:
@@ -279,14 +316,49 @@ public:
 		}
 	}
 
+	/** Return a summary of the symbols in the object: the bit
+	 *  serial%32 is set for every symbol in it (and maybe for others), so
+	 *  the object can't contain a symbol whose bit is clear. */
+	unsigned get_symbol_mask() const
+	{
+		if (flags & status_flags::symbols_calculated)
+			return symbolmask;
+		else
+			return calc_symbol_mask();
+	}
+
+#ifdef GINAC_THREADSAFE_REFCOUNT
+	// Flags of shared objects are updated lazily (e.g. hash_calculated), so
+	// the read-modify-write must not lose bits set by another thread.
+
 	/** Set some status_flags. */
-	const basic & setflag(unsigned f) const {flags |= f; return *this;}
+	const basic & setflag(unsigned f) const
+	{
+		if ((f & status_flags::dynallocated) && profiling_enabled)
+			profile_birth();
+		__sync_fetch_and_or(&flags, f);
+		return *this;
+	}
+
+	/** Clear some status_flags. */
+	const basic & clearflag(unsigned f) const {__sync_fetch_and_and(&flags, ~f); return *this;}
+#else
+	/** Set some status_flags. */
+	const basic & setflag(unsigned f) const
+	{
+		if ((f & status_flags::dynallocated) && profiling_enabled)
+			profile_birth();
+		flags |= f;
+		return *this;
+	}
 
 	/** Clear some status_flags. */
 	const basic & clearflag(unsigned f) const {flags &= ~f; return *this;}
+#endif
 
 protected:
 	void ensure_if_modifiable() const;
+	bool lacks_symbol(const basic & s) const;
 
 	void do_print(const print_context & c, unsigned level) const;
 	void do_print_tree(const print_tree & c, unsigned level) const;
@@ -296,6 +368,7 @@ protected:
 protected:
 	mutable unsigned flags;             ///< of type status_flags
 	mutable unsigned hashvalue;         ///< hash value
+	mutable unsigned symbolmask;        ///< summary of the symbols, @see get_symbol_mask()
 };
 
 
@@ -304,6 +377,61 @@ protected:
 extern int max_recursion_level;
 
 
+// pool allocation
+
+/** Switch pool allocation of objects derived from basic on or off for the
+ *  calling thread.  While it is on, small objects are carved out of large
+ *  chunks and recycled through per-thread free lists instead of going
+ *  through the global operator new every time.  Memory obtained that way is
+ *  kept for reuse by the thread and never given back to the system.
+ *
+ *  @return previous setting */
+bool set_pool_allocation(bool enable);
+
+/** Check whether pool allocation is switched on for the calling thread. */
+bool get_pool_allocation();
+
+/** Switches pool allocation on for the calling thread during the lifetime
+ *  of the guard object, e.g. for the duration of a large expand(). */
+class pool_allocation_guard {
+public:
+	pool_allocation_guard() : saved(set_pool_allocation(true)) {}
+	~pool_allocation_guard() { set_pool_allocation(saved); }
+private:
+	pool_allocation_guard(const pool_allocation_guard &);
+	pool_allocation_guard & operator=(const pool_allocation_guard &);
+	bool saved;
+};
+
+
+// hash-consing
+
+/** Switch hash-consing of evaluated expressions on or off.  While it is on,
+ *  every object coming out of eval() is looked up in a global table of
+ *  unique objects and replaced by an equal object already in there, so
+ *  structurally identical subexpressions are stored only once.  Switching
+ *  it off empties the table.
+ *
+ *  @return previous setting */
+bool set_hash_consing(bool enable);
+
+/** Check whether hash-consing is switched on. */
+bool get_hash_consing();
+
+/** Counters describing the effectiveness of hash-consing. */
+struct hash_consing_statistics {
+	unsigned long lookups;  ///< evaluated objects looked up in the table
+	unsigned long hits;     ///< of which were replaced by an existing object
+	std::size_t size;       ///< number of objects currently in the table
+};
+
+/** Get the current hash-consing counters. */
+hash_consing_statistics get_hash_consing_statistics();
+
+/** Reset the lookup and hit counters (not the table itself). */
+void reset_hash_consing_statistics();
+
+
 // convenience type checker template functions
 
 /** Check if obj is a T, including base classes. */
@@ -0,0 +1,127 @@
+/** @file budget.cpp
+ *
+ *  Implementation of the cancellation of long computations and of the
+ *  limits of their time and memory. */
+
+/*
+ *  GiNaC Copyright (C) 1999-2014 Johannes Gutenberg University Mainz, Germany
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#include "budget.h"
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <cstdio>
+#include <ctime>
+#include <sstream>
+#ifdef HAVE_UNISTD_H
+#include <sys/time.h>
+#include <unistd.h>
+#endif
+#ifdef HAVE_RUSAGE
+#include <sys/resource.h>
+#endif
+
+namespace GiNaC {
+
+GINAC_BUDGET_THREAD_LOCAL computation_budget * current_budget = 0;
+
+/** Safe points between two looks at the clock and the memory. */
+static const unsigned budget_check_interval = 256;
+
+computation_aborted::computation_aborted(reason_type r, const std::string & what_arg)
+ : std::runtime_error(what_arg), why(r)
+{
+}
+
+/** Wall clock time in seconds. */
+static double wall_clock()
+{
+#ifdef HAVE_UNISTD_H
+	struct timeval tv;
+	gettimeofday(&tv, 0);
+	return tv.tv_sec + tv.tv_usec * 1e-6;
+#else
+	return double(std::clock()) / CLOCKS_PER_SEC;
+#endif
+}
+
+/** Memory used by the process in bytes: the resident set size if the system
+ *  tells it, or else the peak resident set size, or 0 if unknown. */
+static std::size_t memory_used()
+{
+#ifdef HAVE_UNISTD_H
+	if (std::FILE * f = std::fopen("/proc/self/statm", "r")) {
+		unsigned long size, resident;
+		const int n = std::fscanf(f, "%lu %lu", &size, &resident);
+		std::fclose(f);
+		if (n == 2)
+			return std::size_t(resident) * std::size_t(sysconf(_SC_PAGESIZE));
+	}
+#endif
+#ifdef HAVE_RUSAGE
+	struct rusage usage;
+	if (getrusage(RUSAGE_SELF, &usage) == 0)
+		return std::size_t(usage.ru_maxrss) * 1024;
+#endif
+	return 0;
+}
+
+/** Put limits into effect for the calling thread.
+ *
+ *  @param token  cancellation token to watch, or 0
+ *  @param max_bytes  limit of the memory of the process, or 0
+ *  @param max_seconds  limit of the wall clock time from now on, or 0 */
+computation_budget::computation_budget(const cancellation_token * token_, std::size_t max_bytes_, double max_seconds_)
+ : token(token_), max_bytes(max_bytes_), max_seconds(max_seconds_),
+   start(max_seconds_ > 0 ? wall_clock() : 0), countdown(budget_check_interval),
+   previous(current_budget)
+{
+	current_budget = this;
+}
+
+computation_budget::~computation_budget()
+{
+	current_budget = previous;
+}
+
+void computation_budget::abort_cancelled() const
+{
+	throw computation_aborted(computation_aborted::cancelled, "computation cancelled");
+}
+
+void computation_budget::check_limits()
+{
+	countdown = budget_check_interval;
+	if (max_seconds > 0 && wall_clock() - start > max_seconds) {
+		std::ostringstream msg;
+		msg << "computation exceeded its time limit of " << max_seconds << "s";
+		throw computation_aborted(computation_aborted::time_exceeded, msg.str());
+	}
+	if (max_bytes > 0) {
+		const std::size_t used = memory_used();
+		if (used > max_bytes) {
+			std::ostringstream msg;
+			msg << "computation exceeded its memory limit of " << max_bytes
+			    << " bytes (" << used << " bytes used)";
+			throw computation_aborted(computation_aborted::memory_exceeded, msg.str());
+		}
+	}
+}
+
+} // namespace GiNaC
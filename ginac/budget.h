@@ -0,0 +1,137 @@
+/** @file budget.h
+ *
+ *  Cancellation of long computations and limits of their time and memory. */
+
+/*
+ *  GiNaC Copyright (C) 1999-2014 Johannes Gutenberg University Mainz, Germany
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#ifndef GINAC_BUDGET_H
+#define GINAC_BUDGET_H
+
+#include <csignal>
+#include <cstddef>
+#include <stdexcept>
+#include <string>
+
+namespace GiNaC {
+
+/** Exception thrown at a safe point of a computation which was cancelled or
+ *  ran out of its budget (see computation_budget).  The computation is
+ *  abandoned cleanly: all expressions it built are released, and those
+ *  passed to it are unchanged. */
+class computation_aborted : public std::runtime_error {
+public:
+	enum reason_type {
+		cancelled,        ///< the cancellation_token was set
+		time_exceeded,    ///< the time limit was reached
+		memory_exceeded   ///< the memory limit was reached
+	};
+
+	computation_aborted(reason_type r, const std::string & what_arg);
+	reason_type reason() const { return why; }
+private:
+	reason_type why;
+};
+
+/** Flag telling a computation to stop at its next safe point.  It may be
+ *  set by another thread or by a signal handler. */
+class cancellation_token {
+public:
+	cancellation_token() : flag(0) {}
+
+	void cancel() { flag = 1; }
+	void reset() { flag = 0; }
+	bool is_cancelled() const { return flag != 0; }
+private:
+	volatile std::sig_atomic_t flag;
+
+	cancellation_token(const cancellation_token &);
+	cancellation_token & operator=(const cancellation_token &);
+};
+
+#ifdef GINAC_THREADSAFE_REFCOUNT
+#define GINAC_BUDGET_THREAD_LOCAL __thread
+#else
+#define GINAC_BUDGET_THREAD_LOCAL
+#endif
+
+/** Limits of the computations done by the calling thread while the object
+ *  exists.  The big loops of expand(), gcd(), factor(), series() and the
+ *  elimination of matrices check them at safe points, and throw
+ *  computation_aborted when the token was cancelled, the wall clock time
+ *  since the construction exceeds max_seconds, or the memory used by the
+ *  process exceeds max_bytes (0 meaning no limit).  The time and memory
+ *  are only looked at every few hundred safe points, so a limit may be
+ *  overshot a bit.  Work handed to other threads by the parallel algorithms
+ *  is not checked.  Budgets may be nested; the inner one is checked while
+ *  it exists.
+ *
+ *  Example:
+ *  @code
+ *  cancellation_token stop;  // stop.cancel() may be called elsewhere
+ *  try {
+ *      computation_budget budget(&stop, 1 << 30, 600);
+ *      result = factor(p);
+ *  } catch (const computation_aborted & e) {
+ *      ...
+ *  }
+ *  @endcode */
+class computation_budget {
+public:
+	explicit computation_budget(const cancellation_token * token = 0,
+	                            std::size_t max_bytes = 0, double max_seconds = 0);
+	~computation_budget();
+
+	/** Throw computation_aborted if a limit is exceeded. */
+	void check()
+	{
+		if (token && token->is_cancelled())
+			abort_cancelled();
+		if (--countdown == 0)
+			check_limits();
+	}
+
+private:
+	void abort_cancelled() const;
+	void check_limits();
+
+	const cancellation_token * token;
+	std::size_t max_bytes;
+	double max_seconds;
+	double start;                  ///< wall clock time at the construction
+	unsigned countdown;            ///< safe points until the next look at the limits
+	computation_budget * previous; ///< budget in effect before this one
+
+	computation_budget(const computation_budget &);
+	computation_budget & operator=(const computation_budget &);
+};
+
+// Internal state of the budgets
+extern GINAC_BUDGET_THREAD_LOCAL computation_budget * current_budget;
+
+/** Safe point of a long computation: throw computation_aborted if the
+ *  budget of the calling thread is exceeded. */
+inline void check_budget()
+{
+	if (current_budget)
+		current_budget->check();
+}
+
+} // namespace GiNaC
+
+#endif // ndef GINAC_BUDGET_H
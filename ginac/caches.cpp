@@ -0,0 +1,159 @@
+/** @file caches.cpp
+ *
+ *  Implementation of the saving and restoring of GiNaC's internal
+ *  caches. */
+
+/*
+ *  GiNaC Copyright (C) 1999-2014 Johannes Gutenberg University Mainz, Germany
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#include "caches.h"
+#include "numeric.h"
+#include "remember.h"
+#include "tostring.h"
+#include "version.h"
+
+#include <cstdio>
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+
+namespace GiNaC {
+
+// Defined with the caches in numeric.cpp, inifcns_nstdsums.cpp and factor.cpp
+extern std::string save_bernoulli_table();
+extern void load_bernoulli_table(const std::string & buf);
+extern std::string save_Xn_table();
+extern void load_Xn_table(const std::string & buf);
+extern std::string save_Yn_table();
+extern void load_Yn_table(const std::string & buf);
+extern std::string save_factor_cache(const lst & syms);
+extern void load_factor_cache(const std::string & buf, lst & syms);
+
+namespace {
+
+typedef std::vector<std::pair<std::string, std::string> > section_vector;
+
+const char cache_file_magic[] = "GiNaC caches";
+
+/* A cache file starts with a line holding cache_file_magic.  Then come the
+ * sections, each a line with its name, a line with the number of bytes of
+ * its data and the data.  The first two sections are "version" and
+ * "digits", the GiNaC version and Digits of the writer. */
+
+void write_section(std::ostream & os, const std::string & name, const std::string & data)
+{
+	os << name << '\n' << data.size() << '\n';
+	os.write(data.data(), data.size());
+}
+
+/** Read the next section.  Returns false at the end of the file. */
+bool read_section(std::istream & is, std::string & name, std::string & data)
+{
+	if (!std::getline(is, name))
+		return false;
+	std::string line;
+	std::size_t size;
+	if (!std::getline(is, line) || !(std::istringstream(line) >> size))
+		throw std::runtime_error("load_caches(): cache file is damaged");
+	data.resize(size);
+	if (size > 0 && !is.read(&data[0], size))
+		throw std::runtime_error("load_caches(): cache file is truncated");
+	return true;
+}
+
+} // anonymous namespace
+
+void save_caches(const std::string & filename, const lst & syms)
+{
+	section_vector sections;
+	sections.push_back(std::make_pair("version", std::string(GINACLIB_VERSION)));
+	sections.push_back(std::make_pair("digits", ToString(long(Digits))));
+	sections.push_back(std::make_pair("bernoulli", save_bernoulli_table()));
+	sections.push_back(std::make_pair("Xn", save_Xn_table()));
+	sections.push_back(std::make_pair("Yn", save_Yn_table()));
+	sections.push_back(std::make_pair("factors", save_factor_cache(syms)));
+	remember_table::save_tables(false, syms, sections);
+	remember_table::save_tables(true, syms, sections);
+
+	// A process starting while the file is written finds the old one
+	const std::string tmpname = filename + ".tmp";
+	{
+		std::ofstream os(tmpname.c_str(), std::ios::binary);
+		os << cache_file_magic << '\n';
+		for (section_vector::const_iterator i = sections.begin(); i != sections.end(); ++i)
+			write_section(os, i->first, i->second);
+		os.flush();
+		if (!os) {
+			std::remove(tmpname.c_str());
+			throw std::runtime_error("save_caches(): cannot write " + tmpname);
+		}
+	}
+	if (std::rename(tmpname.c_str(), filename.c_str()) != 0) {
+		std::remove(tmpname.c_str());
+		throw std::runtime_error("save_caches(): cannot replace " + filename);
+	}
+}
+
+bool load_caches(const std::string & filename, const lst & syms)
+{
+	std::ifstream is(filename.c_str(), std::ios::binary);
+	if (!is)
+		return false;
+	std::string line;
+	if (!std::getline(is, line) || line != cache_file_magic)
+		throw std::runtime_error("load_caches(): " + filename + " is not a cache file");
+
+	std::string name, data;
+	if (!read_section(is, name, data) || name != "version")
+		throw std::runtime_error("load_caches(): cache file is damaged");
+	if (data != GINACLIB_VERSION)
+		return false;
+	if (!read_section(is, name, data) || name != "digits")
+		throw std::runtime_error("load_caches(): cache file is damaged");
+	const bool same_digits = data == ToString(long(Digits));
+
+	// Symbols which are not in syms are shared by all sections
+	lst symbols(syms);
+	while (read_section(is, name, data)) {
+		std::istringstream words(name);
+		std::string kind, fname;
+		unsigned nparams;
+		words >> kind;
+		if (kind == "bernoulli")
+			load_bernoulli_table(data);
+		else if (kind == "Xn")
+			load_Xn_table(data);
+		else if (kind == "Yn") {
+			if (same_digits)
+				load_Yn_table(data);
+		} else if (kind == "factors")
+			load_factor_cache(data, symbols);
+		else if (kind == "remember" || kind == "evalf_remember") {
+			if (!(words >> fname >> nparams))
+				throw std::runtime_error("load_caches(): cache file is damaged");
+			if (kind == "remember" || same_digits)
+				remember_table::load_table(kind == "evalf_remember", fname, nparams, data, symbols);
+		}
+		// Sections of later versions are skipped
+	}
+	return true;
+}
+
+} // namespace GiNaC
@@ -0,0 +1,61 @@
+/** @file caches.h
+ *
+ *  Saving and restoring the contents of GiNaC's internal caches. */
+
+/*
+ *  GiNaC Copyright (C) 1999-2014 Johannes Gutenberg University Mainz, Germany
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#ifndef GINAC_CACHES_H
+#define GINAC_CACHES_H
+
+#include "lst.h"
+
+#include <string>
+
+namespace GiNaC {
+
+/** Write the contents of the caches GiNaC fills while it computes to a
+ *  file, so that a later process can start with them:
+ *   - the table of Bernoulli numbers (see fill_bernoulli()),
+ *   - the tables for the numerical evaluation of polylogarithms (see
+ *     prepare_polylog_tables()), those of S(n,p,x) at the current Digits,
+ *   - the irreducible factors remembered by factor() (see
+ *     set_factor_cache_size()),
+ *   - the remember tables of the functions in the calling thread, those of
+ *     evalf() results at the current Digits.
+ *  The expressions are written with serialize(), the symbols in syms by
+ *  position.  The file is replaced when it has been written completely.
+ *
+ *  @exception runtime_error (file can't be written) */
+extern void save_caches(const std::string & filename, const lst & syms = lst());
+
+/** Fill the caches from a file written by save_caches(), with the symbols
+ *  in syms in the same order.  Tables which are already larger than those
+ *  in the file are kept; remember tables only take entries as far as the
+ *  options of their functions allow, and those of functions not known to
+ *  this program are skipped.  The tables which depend on the precision are
+ *  only loaded if Digits is what it was when they were saved.
+ *
+ *  @return false if the file doesn't exist or was written by another
+ *          version of GiNaC, in which case nothing is loaded
+ *  @exception runtime_error (file is damaged) */
+extern bool load_caches(const std::string & filename, const lst & syms = lst());
+
+} // namespace GiNaC
+
+#endif // ndef GINAC_CACHES_H
@@ -36,9 +36,19 @@
 #include "power.h"
 #include "matrix.h"
 #include "archive.h"
+#include "tasks.h"
 #include "utils.h"
 
+#include <algorithm>
+#include <map>
 #include <stdexcept>
+#include <utility>
+#include <vector>
+#if defined(GINAC_THREADSAFE_REFCOUNT) && defined(HAVE_PTHREAD_H)
+// The terms of a sum are only traced concurrently if expressions may be
+// shared between threads at all.
+#define PARALLEL_TRACE 1
+#endif
 
 namespace GiNaC {
 
@@ -118,6 +128,21 @@ return_type_t clifford::return_type_tinfo() const
 	return make_return_type_t<clifford>(representation_label);
 }
 
+/** The metric is not an operand, but subs() substitutes in it. */
+unsigned clifford::calc_symbol_mask() const
+{
+	unsigned mask = metric.get_symbol_mask();
+	for (size_t i=0; i<nops(); i++)
+		mask |= op(i).get_symbol_mask();
+
+	if (flags & status_flags::evaluated) {
+		symbolmask = mask;
+		setflag(status_flags::symbols_calculated);
+	}
+
+	return mask;
+}
+
 //////////
 // archiving
 //////////
@@ -819,17 +844,74 @@ static unsigned char get_representation_label(const return_type_t& ti)
 
 /** Take trace of a string of an even number of Dirac gammas given a vector
  *  of indices. */
-static ex trace_string(exvector::const_iterator ix, size_t num)
+namespace {
+
+/** Traces of strings of Dirac gammas, without the factor trONE, whose
+ *  indices are given by their positions in a vector.  The traces of all
+ *  substrings are remembered, since the recursion meets them many times. */
+class trace_strings {
+public:
+	typedef std::vector<unsigned> string;
+
+	trace_strings(const exvector & ix) : ix(ix) {}
+
+	/** Trace of the string of the indices ix[s[0]], ix[s[1]], ... */
+	ex trace(const string & s);
+
+private:
+	bool contractible(unsigned a, unsigned b) const;
+
+	const exvector & ix;
+	std::map<string, ex> traces;
+};
+
+/** Whether the indices at positions a and b form a dummy pair of the same
+ *  dimension, so that the metric tensor of one can be contracted with the
+ *  gamma of the other. */
+bool trace_strings::contractible(unsigned a, unsigned b) const
 {
+	return is_dummy_pair(ix[a], ix[b])
+	    && ex_to<idx>(ix[a]).get_dim().is_equal(ex_to<idx>(ix[b]).get_dim());
+}
+
+ex trace_strings::trace(const string & s)
+{
+	const size_t num = s.size();
+
+	// Tr ONE = 1 (in units of trONE), and the trace of an odd number of
+	// gammas is zero
+	if (num == 0)
+		return _ex1;
+	if (num & 1)
+		return _ex0;
+
 	// Tr gamma.mu gamma.nu = 4 g.mu.nu
 	if (num == 2)
-		return lorentz_g(ix[0], ix[1]);
+		return lorentz_g(ix[s[0]], ix[s[1]]);
 
 	// Tr gamma.mu gamma.nu gamma.rho gamma.sig = 4 (g.mu.nu g.rho.sig + g.nu.rho g.mu.sig - g.mu.rho g.nu.sig )
-	else if (num == 4)
-		return lorentz_g(ix[0], ix[1]) * lorentz_g(ix[2], ix[3])
-		     + lorentz_g(ix[1], ix[2]) * lorentz_g(ix[0], ix[3])
-		     - lorentz_g(ix[0], ix[2]) * lorentz_g(ix[1], ix[3]);
+	if (num == 4)
+		return lorentz_g(ix[s[0]], ix[s[1]]) * lorentz_g(ix[s[2]], ix[s[3]])
+		     + lorentz_g(ix[s[1]], ix[s[2]]) * lorentz_g(ix[s[0]], ix[s[3]])
+		     - lorentz_g(ix[s[0]], ix[s[2]]) * lorentz_g(ix[s[1]], ix[s[3]]);
+
+	std::map<string, ex>::const_iterator found = traces.find(s);
+	if (found != traces.end())
+		return found->second;
+
+	// If the string contains a contracted pair of indices, rotate it
+	// cyclically so that it starts with one of them, at position 0, and
+	// let the other be at position partner
+	size_t first = 0, partner = num;
+	for (size_t a=0; a<num && partner==num; a++)
+		for (size_t b=a+1; b<num; b++)
+			if (contractible(s[a], s[b])) {
+				first = a;
+				partner = b - a;
+				break;
+			}
+	string r(s.begin() + first, s.end());
+	r.insert(r.end(), s.begin(), s.begin() + first);
 
 	// Traces of 6 or more gammas are computed recursively:
 	// Tr gamma.mu1 gamma.mu2 ... gamma.mun =
@@ -838,21 +920,134 @@ static ex trace_string(exvector::const_iterator ix, size_t num)
 	//   + g.mu1.mu4 * Tr gamma.mu3 gamma.mu3 gamma.mu5 ... gamma.mun
 	//   - ...
 	//   + g.mu1.mun * Tr gamma.mu2 ... gamma.mu(n-1)
-	exvector v(num - 2);
+	// If gamma.mu1 is contracted with gamma.muk, all terms but the k-th
+	// are contracted right away: g.mu1.mui * gamma~mu1 = gamma.mui, so
+	// that gamma.mui takes the place of gamma~mu1 (Kahane).
+	string v(num - 2);
 	int sign = 1;
 	ex result;
 	for (size_t i=1; i<num; i++) {
 		for (size_t n=1, j=0; n<num; n++) {
 			if (n == i)
 				continue;
-			v[j++] = ix[n];
+			v[j++] = (n == partner ? r[i] : r[n]);
 		}
-		result += sign * lorentz_g(ix[0], ix[i]) * trace_string(v.begin(), num-2);
+		if (partner == num || i == partner)
+			result += sign * lorentz_g(ix[r[0]], ix[r[i]]) * trace(v);
+		else
+			result += sign * trace(v);
 		sign = -sign;
 	}
+
+	traces.insert(std::make_pair(s, result));
 	return result;
 }
 
+} // anonymous namespace
+
+static unsigned trace_threads = 1;
+
+/** Set the number of threads dirac_trace() and color_trace() use for the
+ *  terms of large sums.  This has an effect only if GiNaC was built with
+ *  GINAC_THREADSAFE_REFCOUNT and pthreads.
+ *
+ *  @return previous setting */
+unsigned set_trace_threads(unsigned n)
+{
+	const unsigned previous = trace_threads;
+	trace_threads = (n == 0 ? 1 : n);
+	return previous;
+}
+
+/** Get the number of threads used by dirac_trace() and color_trace(). */
+unsigned get_trace_threads()
+{
+	return trace_threads;
+}
+
+#ifdef PARALLEL_TRACE
+
+namespace {
+
+/** Sums with fewer terms are traced by the calling thread alone. */
+const std::size_t min_parallel_trace_terms = 16;
+
+/** Traces of a slice of the terms of a sum, to be run as a task.  The
+ *  traces are summed up in the task already. */
+struct trace_job {
+	exvector terms;
+	trace_function trace;
+	std::set<unsigned char> rls;
+	ex trONE;
+	ex sum;
+	bool failed;
+};
+
+void * run_trace_job(void * arg)
+{
+	trace_job & job = *static_cast<trace_job *>(arg);
+	try {
+		exvector traces;
+		traces.reserve(job.terms.size());
+		for (exvector::const_iterator i = job.terms.begin(); i != job.terms.end(); ++i)
+			traces.push_back(job.trace(*i, job.rls, job.trONE));
+		job.sum = (new add(traces))->setflag(status_flags::dynallocated);
+	} catch (...) {
+		job.failed = true;
+	}
+	return 0;
+}
+
+} // anonymous namespace
+
+#endif // def PARALLEL_TRACE
+
+/** Trace the terms concurrently, in slices run as tasks.  The first slice
+ *  is done by the calling thread. */
+bool trace_terms_parallel(const ex & e, trace_function trace,
+                          const std::set<unsigned char> & rls, const ex & trONE, ex & result)
+{
+#ifdef PARALLEL_TRACE
+	if (trace_threads < 2 || !is_exactly_a<add>(e) || e.nops() < min_parallel_trace_terms)
+		return false;
+
+	const std::size_t nterms = e.nops();
+	const std::size_t nthreads = std::min<std::size_t>(trace_threads, nterms);
+	std::vector<trace_job> jobs(nthreads);
+	for (std::size_t k = 0; k < nthreads; ++k) {
+		trace_job & job = jobs[k];
+		const std::size_t first = nterms * k / nthreads;
+		const std::size_t last = nterms * (k + 1) / nthreads;
+		for (std::size_t i = first; i < last; ++i) {
+			ex term = e.op(i);
+			if (k > 0 && !copy_numbers(e.op(i), term))
+				return false;
+			job.terms.push_back(term);
+		}
+		job.trace = trace;
+		job.rls = rls;
+		job.trONE = trONE;
+		if (k > 0 && !copy_numbers(trONE, job.trONE))
+			return false;
+		job.failed = false;
+	}
+
+	run_tasks(run_trace_job, jobs);
+	for (std::size_t k = 0; k < nthreads; ++k)
+		if (jobs[k].failed)
+			return false;
+
+	exvector sums;
+	sums.reserve(nthreads);
+	for (std::size_t k = 0; k < nthreads; ++k)
+		sums.push_back(jobs[k].sum);
+	result = (new add(sums))->setflag(status_flags::dynallocated);
+	return true;
+#else
+	return false;
+#endif
+}
+
 ex dirac_trace(const ex & e, const std::set<unsigned char> & rls, const ex & trONE)
 {
 	if (is_a<clifford>(e)) {
@@ -931,6 +1126,7 @@ ex dirac_trace(const ex & e, const std::set<unsigned char> & rls, const ex & trO
 				base_and_index(e.op(i), bv[i-1], ix[i-1]);
 			num--;
 			int *iv = new int[num];
+			trace_strings traces(ix);
 			ex result;
 			for (size_t i=0; i<num-3; i++) {
 				ex idx1 = ix[i];
@@ -941,17 +1137,17 @@ ex dirac_trace(const ex & e, const std::set<unsigned char> & rls, const ex & trO
 						for (size_t l=k+1; l<num; l++) {
 							ex idx4 = ix[l];
 							iv[0] = i; iv[1] = j; iv[2] = k; iv[3] = l;
-							exvector v;
+							trace_strings::string v;
 							v.reserve(num - 4);
 							for (size_t n=0, t=4; n<num; n++) {
 								if (n == i || n == j || n == k || n == l)
 									continue;
 								iv[t++] = n;
-								v.push_back(ix[n]);
+								v.push_back(n);
 							}
 							int sign = permutation_sign(iv, iv + num);
 							result += sign * lorentz_eps(ex_to<idx>(idx1).replace_dim(_ex4), ex_to<idx>(idx2).replace_dim(_ex4), ex_to<idx>(idx3).replace_dim(_ex4), ex_to<idx>(idx4).replace_dim(_ex4))
-							        * trace_string(v.begin(), num - 4);
+							        * traces.trace(v);
 						}
 					}
 				}
@@ -974,14 +1170,22 @@ ex dirac_trace(const ex & e, const std::set<unsigned char> & rls, const ex & trO
 			}
 
 			exvector iv(num), bv(num);
-			for (size_t i=0; i<num; i++)
+			trace_strings::string s(num);
+			for (size_t i=0; i<num; i++) {
 				base_and_index(e.op(i), bv[i], iv[i]);
+				s[i] = i;
+			}
 
-			return trONE * (trace_string(iv.begin(), num) * mul(bv)).simplify_indexed();
+			return trONE * (trace_strings(iv).trace(s) * mul(bv)).simplify_indexed();
 		}
 
 	} else if (e.nops() > 0) {
 
+		// Large sums may be traced by several threads
+		ex result;
+		if (trace_terms_parallel(e, dirac_trace, rls, trONE, result))
+			return result;
+
 		// Trace maps to all other container classes (this includes sums)
 		pointer_to_map_function_2args<const std::set<unsigned char> &, const ex &> fcn(dirac_trace, rls, trONE);
 		return e.map(fcn);
@@ -1326,6 +1530,287 @@ lst clifford_to_lst(const ex & e, const ex & c, bool algebraic)
 	return V;
 }
 
+namespace {
+
+/** Clifford numbers over the units of one Clifford unit with a diagonal
+ *  metric in a small numeric dimension, stored as the coefficients of the
+ *  basis blades.  The blade e~i1 e~i2 ... with i1 < i2 < ... is numbered by
+ *  the bit mask 2^i1 + 2^i2 + ..., so that the product of two blades is a
+ *  third one times a sign and the squares of their common units, which are
+ *  both tabulated. */
+class blade_algebra {
+public:
+	typedef exvector multivector;
+
+	/** Larger dimensions are left to canonicalize_clifford(). */
+	static const unsigned max_dim = 8;
+
+	blade_algebra(const ex & cu);
+
+	/** Whether the unit has a metric this class can handle. */
+	bool usable() const { return size > 0; }
+
+	multivector zero() const { return multivector(size, _ex0); }
+
+	/** The vector with the given components along the units. */
+	multivector vector(const ex & scalar, const exvector & components) const;
+
+	/** Convert an expression in the units, return false if it is not
+	 *  (e.g. it involves other Clifford objects or symbolic indices). */
+	bool convert(const ex & e, multivector & r) const;
+
+	multivector product(const multivector & a, const multivector & b) const;
+	void accumulate(multivector & a, const multivector & b) const;
+
+	/** The main anti-automorphism, as clifford_bar(). */
+	multivector bar(const multivector & a) const;
+
+	/** Inverse of a, return false if a * bar(a) is not a non-zero scalar. */
+	bool inverse(const multivector & a, multivector & r) const;
+
+private:
+	bool convert_unit(const ex & e, multivector & r) const;
+
+	ex cu;
+	unsigned dim, size;
+	/** Sign of the reordering of the product of blades a and b, at a * size + b. */
+	std::vector<signed char> signs;
+	/** Product of the squares of the units of each blade. */
+	exvector squares;
+};
+
+const unsigned blade_algebra::max_dim;
+
+blade_algebra::blade_algebra(const ex & cu_) : cu(cu_), dim(0), size(0)
+{
+	const clifford & unit = ex_to<clifford>(cu);
+	if (!is_a<cliffordunit>(cu.op(0)) || unit.get_commutator_sign() != -1)
+		return;
+	const ex & mu = cu.op(1);
+	if (ex_to<idx>(mu).is_numeric() || !ex_to<idx>(mu).get_dim().info(info_flags::posint))
+		return;
+	unsigned n = ex_to<numeric>(ex_to<idx>(mu).get_dim()).to_int();
+	if (n > max_dim)
+		return;
+
+	// The symmetrised metric must be diagonal
+	exvector diagonal(n);
+	for (unsigned i=0; i<n; ++i) {
+		ex mu_i = mu.subs(mu.op(0) == i, subs_options::no_pattern);
+		for (unsigned j=i; j<n; ++j) {
+			ex mu_j = mu.subs(mu.op(0) == j, subs_options::no_pattern);
+			ex g = unit.get_metric(mu_i, mu_j, true).simplify_indexed();
+			if (!g.get_free_indices().empty() || is_a<indexed>(g))
+				return;
+			if (i == j)
+				diagonal[i] = g;
+			else if (!g.is_zero())
+				return;
+		}
+	}
+
+	dim = n;
+	size = 1 << n;
+	squares.resize(size);
+	squares[0] = _ex1;
+	for (unsigned m=1; m<size; ++m) {
+		unsigned low = 0;
+		while (!(m & (1 << low)))
+			++low;
+		squares[m] = squares[m & (m - 1)] * diagonal[low];
+	}
+	signs.resize(size * size);
+	for (unsigned a=0; a<size; ++a) {
+		for (unsigned b=0; b<size; ++b) {
+			// Each unit of b passes the units of a with a larger number
+			unsigned swaps = 0;
+			for (unsigned i=0; i<dim; ++i)
+				if (b & (1 << i))
+					for (unsigned j=i+1; j<dim; ++j)
+						if (a & (1 << j))
+							++swaps;
+			signs[a * size + b] = swaps % 2 ? -1 : 1;
+		}
+	}
+}
+
+blade_algebra::multivector blade_algebra::vector(const ex & scalar, const exvector & components) const
+{
+	multivector r = zero();
+	r[0] = scalar;
+	for (unsigned i=0; i<dim; ++i)
+		r[1 << i] = components[i];
+	return r;
+}
+
+bool blade_algebra::convert_unit(const ex & e, multivector & r) const
+{
+	const clifford & c = ex_to<clifford>(e);
+	if (c.get_representation_label() != ex_to<clifford>(cu).get_representation_label())
+		return false;
+	if (is_a<diracone>(e.op(0))) {
+		r[0] = _ex1;
+		return true;
+	}
+	if (!is_a<cliffordunit>(e.op(0)) || !ex_to<idx>(e.op(1)).is_numeric()
+	 || !ex_to<clifford>(cu).same_metric(e))
+		return false;
+	unsigned i = ex_to<numeric>(ex_to<idx>(e.op(1)).get_value()).to_int();
+	if (i >= dim)
+		return false;
+	r[1 << i] = _ex1;
+	return true;
+}
+
+bool blade_algebra::convert(const ex & e, multivector & r) const
+{
+	r = zero();
+	if (e.return_type() == return_types::commutative) {
+		r[0] = e;
+		return true;
+	} else if (is_a<clifford>(e)) {
+		return convert_unit(e, r);
+	} else if (is_exactly_a<add>(e)) {
+		multivector t;
+		for (size_t i=0; i<e.nops(); ++i) {
+			if (!convert(e.op(i), t))
+				return false;
+			accumulate(r, t);
+		}
+		return true;
+	} else if (is_exactly_a<mul>(e) || is_exactly_a<ncmul>(e)) {
+		multivector t;
+		r[0] = _ex1;
+		for (size_t i=0; i<e.nops(); ++i) {
+			if (!convert(e.op(i), t))
+				return false;
+			r = product(r, t);
+		}
+		return true;
+	} else if (is_exactly_a<power>(e) && e.op(1).info(info_flags::nonnegint)) {
+		multivector t;
+		if (!convert(e.op(0), t))
+			return false;
+		r[0] = _ex1;
+		for (int n = ex_to<numeric>(e.op(1)).to_int(); n > 0; --n)
+			r = product(r, t);
+		return true;
+	}
+	return false;
+}
+
+blade_algebra::multivector blade_algebra::product(const multivector & a, const multivector & b) const
+{
+	std::vector<exvector> terms(size);
+	for (unsigned i=0; i<size; ++i) {
+		if (a[i].is_zero())
+			continue;
+		for (unsigned j=0; j<size; ++j) {
+			if (b[j].is_zero())
+				continue;
+			ex t = a[i] * b[j] * squares[i & j];
+			terms[i ^ j].push_back(signs[i * size + j] < 0 ? -t : t);
+		}
+	}
+	multivector r(size);
+	for (unsigned k=0; k<size; ++k)
+		r[k] = (new add(terms[k]))->setflag(status_flags::dynallocated);
+	return r;
+}
+
+void blade_algebra::accumulate(multivector & a, const multivector & b) const
+{
+	for (unsigned k=0; k<size; ++k)
+		if (!b[k].is_zero())
+			a[k] += b[k];
+}
+
+blade_algebra::multivector blade_algebra::bar(const multivector & a) const
+{
+	// Reversion of a blade of grade g gives the sign (-1)^(g(g-1)/2), the
+	// automorphism clifford_prime() another (-1)^g
+	multivector r(size);
+	for (unsigned k=0; k<size; ++k) {
+		unsigned g = 0;
+		for (unsigned m=k; m; m &= m - 1)
+			++g;
+		r[k] = (g * (g + 1) / 2) % 2 ? -a[k].conjugate() : a[k].conjugate();
+	}
+	return r;
+}
+
+bool blade_algebra::inverse(const multivector & a, multivector & r) const
+{
+	r = bar(a);
+	multivector n = product(a, r);
+	for (unsigned k=1; k<size; ++k)
+		if (!n[k].normal().is_zero())
+			return false;
+	ex norm = n[0].normal();
+	if (norm.is_zero())
+		return false;
+	for (unsigned k=0; k<size; ++k)
+		r[k] = r[k] / norm;
+	return true;
+}
+
+/** Moebius transformation in the blade representation, if the metric and
+ *  the entries of the matrix allow it.  Fills the components of the result
+ *  in the form of clifford_to_lst(). */
+bool blade_moebius_map(const ex & a, const ex & b, const ex & c, const ex & d, const ex & v, const ex & cu, lst & result)
+{
+	blade_algebra algebra(cu);
+	if (!algebra.usable())
+		return false;
+
+	// Components of v as in lst_to_clifford()
+	exvector comps;
+	if (is_a<matrix>(v)) {
+		const matrix & m = ex_to<matrix>(v);
+		if (m.rows() != 1 && m.cols() != 1)
+			return false;
+		for (size_t i=0; i<m.nops(); ++i)
+			comps.push_back(m.op(i));
+	} else
+		comps.assign(ex_to<lst>(v).begin(), ex_to<lst>(v).end());
+	const unsigned dim = ex_to<numeric>(ex_to<idx>(cu.op(1)).get_dim()).to_int();
+	ex scalar = _ex0;
+	if (comps.size() == dim + 1) {
+		scalar = comps[0];
+		comps.erase(comps.begin());
+	} else if (comps.size() != dim)
+		return false;
+	blade_algebra::multivector x = algebra.vector(scalar, comps);
+
+	blade_algebra::multivector ma, mb, mc, md;
+	const ex * entries[] = { &a, &b, &c, &d };
+	blade_algebra::multivector * blades[] = { &ma, &mb, &mc, &md };
+	for (int k=0; k<4; ++k) {
+		if (!algebra.convert(*entries[k], *blades[k])
+		 && !algebra.convert(expand_dummy_sum(*entries[k], true), *blades[k]))
+			return false;
+	}
+
+	blade_algebra::multivector num = algebra.product(ma, x), den = algebra.product(mc, x), inv;
+	algebra.accumulate(num, mb);
+	algebra.accumulate(den, md);
+	if (!algebra.inverse(den, inv))
+		return false;
+	blade_algebra::multivector y = algebra.product(num, inv);
+
+	// The result must be a vector
+	for (unsigned k=1; k<y.size(); ++k)
+		if ((k & (k - 1)) && !y[k].normal().is_zero())
+			return false;
+	ex y0 = y[0].normal();
+	if (!y0.is_zero())
+		result.append(y0);
+	for (unsigned i=0; i<dim; ++i)
+		result.append(y[1 << i].normal());
+	return true;
+}
+
+} // anonymous namespace
 
 ex clifford_moebius_map(const ex & a, const ex & b, const ex & c, const ex & d, const ex & v, const ex & G, unsigned char rl)
 {
@@ -1349,6 +1834,12 @@ ex clifford_moebius_map(const ex & a, const ex & b, const ex & c, const ex & d,
 		
 	}
 	
+	// Diagonal metrics in a few dimensions can be handled without
+	// noncommutative products
+	lst blade_result;
+	if (blade_moebius_map(a, b, c, d, v, cu, blade_result))
+		return (is_a<matrix>(v) ? matrix(ex_to<matrix>(v).rows(), ex_to<matrix>(v).cols(), blade_result) : ex(blade_result));
+
 	x = lst_to_clifford(v, cu); 
 	ex e = clifford_to_lst(simplify_indexed(canonicalize_clifford((a * x + b) * clifford_inverse(c * x + d))), cu, false);
 	return (is_a<matrix>(v) ? matrix(ex_to<matrix>(v).rows(), ex_to<matrix>(v).cols(), ex_to<lst>(e)) : e);
@@ -61,6 +61,7 @@ protected:
 	ex thiscontainer(std::auto_ptr<exvector> vp) const;
 	unsigned return_type() const { return return_types::noncommutative; }
 	return_type_t return_type_tinfo() const;
+	unsigned calc_symbol_mask() const;
 	// non-virtual functions in this class
 public:
 	unsigned char get_representation_label() const { return representation_label; }
@@ -244,7 +245,8 @@ ex dirac_slash(const ex & e, const ex & dim, unsigned char rl = 0);
 /** Calculate dirac traces over the specified set of representation labels.
  *  The computed trace is a linear functional that is equal to the usual
  *  trace only in D = 4 dimensions. In particular, the functional is not
- *  always cyclic in D != 4 dimensions when gamma5 is involved.
+ *  always cyclic in D != 4 dimensions when gamma5 is involved.  The terms
+ *  of large sums may be traced by several threads, see set_trace_threads().
  *
  *  @param e Expression to take the trace of
  *  @param rls Set of representation labels
@@ -272,6 +274,16 @@ ex dirac_trace(const ex & e, const lst & rll, const ex & trONE = 4);
  *  @param trONE Expression to be returned as the trace of the unit matrix */
 ex dirac_trace(const ex & e, unsigned char rl = 0, const ex & trONE = 4);
 
+/** Set the number of threads dirac_trace() and color_trace() may use for
+ *  the terms of large sums.  The default of 1 means that no threads are
+ *  started.
+ *
+ *  @return previous setting */
+unsigned set_trace_threads(unsigned n);
+
+/** Number of threads dirac_trace() and color_trace() may use for terms. */
+unsigned get_trace_threads();
+
 /** Bring all products of clifford objects in an expression into a canonical
  *  order. This is not necessarily the most simple form but it will allow
  *  to check two expressions for equality. */
@@ -346,7 +358,9 @@ lst clifford_to_lst(const ex & e, const ex & c, bool algebraic=true);
  *  @param v Vector to be transformed
  *  @param G Metric of the surrounding space, may be a Clifford unit then the next parameter is ignored
  *  @param rl Representation label 
- *  @return List of components of the transformed vector*/
+ *  @return List of components of the transformed vector (in normal form,
+ *          if the metric is diagonal and in at most eight dimensions, when
+ *          the map is computed with basis blades) */
 ex clifford_moebius_map(const ex & a, const ex & b, const ex & c, const ex & d, const ex & v, const ex & G, unsigned char rl = 0);
 
 /** The second form of Moebius transformations defined by a 2x2 Clifford matrix M
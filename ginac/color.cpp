@@ -32,8 +32,11 @@
 #include "archive.h"
 #include "utils.h"
 
+#include <algorithm>
 #include <iostream>
+#include <map>
 #include <stdexcept>
+#include <utility>
 
 namespace GiNaC {
 
@@ -535,6 +538,100 @@ static unsigned char get_representation_label(const return_type_t& ti)
 	return (unsigned char)ti.rl;
 }
 
+namespace {
+
+/** Lexicographic order of strings of indices. */
+struct index_string_is_less {
+	bool operator()(const exvector & lh, const exvector & rh) const
+	{
+		return std::lexicographical_compare(lh.begin(), lh.end(), rh.begin(), rh.end(), ex_is_less());
+	}
+};
+
+/** Traces of strings of SU(3) generators given by their indices.  The
+ *  traces of all strings met in the recursion are remembered. */
+class trace_strings {
+public:
+	/** Trace of T_ix[0] T_ix[1] ... */
+	ex trace(const exvector & ix);
+
+private:
+	std::map<exvector, ex, index_string_is_less> traces;
+};
+
+ex trace_strings::trace(const exvector & ix)
+{
+	const size_t num = ix.size();
+
+	// Tr ONE = 3, and the generators are traceless
+	if (num == 0)
+		return _ex3;
+	if (num == 1)
+		return _ex0;
+
+	// Tr T_a T_b = 1/2 delta_a_b
+	if (num == 2)
+		return delta_tensor(ix[0], ix[1]) / 2;
+
+	// Tr T_a T_b T_c = 1/4 h_a_b_c
+	if (num == 3)
+		return color_h(ix[0], ix[1], ix[2]) / 4;
+
+	std::map<exvector, ex, index_string_is_less>::const_iterator found = traces.find(ix);
+	if (found != traces.end())
+		return found->second;
+
+	ex result;
+	bool contracted = false;
+	for (size_t i=0; i<num && !contracted; i++) {
+		for (size_t j=i+1; j<num; j++) {
+			if (!is_dummy_pair(ix[i], ix[j]))
+				continue;
+
+			// Generators contracted with each other are removed by the
+			// Fierz identity T_a_ij T_a_kl = 1/2 (delta_il delta_kj - 1/3 delta_ij delta_kl):
+			// Tr A T_a B T_a = 1/2 Tr A Tr B - 1/6 Tr A B
+			// (with A = T_a(j+1) .. T_an T_a1 .. T_a(i-1) by cyclicity)
+			exvector a(ix.begin() + j + 1, ix.end()), b(ix.begin() + i + 1, ix.begin() + j);
+			a.insert(a.end(), ix.begin(), ix.begin() + i);
+			exvector ab(a);
+			ab.insert(ab.end(), b.begin(), b.end());
+			result = trace(a) * trace(b) / 2 - trace(ab) / 6;
+			contracted = true;
+			break;
+		}
+	}
+
+	if (!contracted) {
+
+		// Traces of 4 or more generators are computed recursively:
+		// Tr T_a1 .. T_an =
+		//     1/6 delta_a(n-1)_an Tr T_a1 .. T_a(n-2)
+		//   + 1/2 h_a(n-1)_an_k Tr T_a1 .. T_a(n-2) T_k
+		const ex &last_index = ix[num - 1];
+		const ex &next_to_last_index = ix[num - 2];
+		idx summation_index((new symbol)->setflag(status_flags::dynallocated), 8);
+
+		exvector v1(ix.begin(), ix.end() - 2);
+		exvector v2 = v1;
+		v2.push_back(summation_index);
+
+		result = delta_tensor(next_to_last_index, last_index) * trace(v1) / 6
+		       + color_h(next_to_last_index, last_index, summation_index) * trace(v2) / 2;
+	}
+
+	traces.insert(std::make_pair(ix, result));
+	return result;
+}
+
+} // anonymous namespace
+
+/** color_trace() as a trace_function, for trace_terms_parallel(). */
+static ex color_trace_term(const ex & e, const std::set<unsigned char> & rls, const ex & trONE)
+{
+	return color_trace(e, rls);
+}
+
 ex color_trace(const ex & e, const std::set<unsigned char> & rls)
 {
 	if (is_a<color>(e)) {
@@ -577,42 +674,19 @@ ex color_trace(const ex & e, const std::set<unsigned char> & rls)
 		if (!is_a<ncmul>(e_expanded))
 			return color_trace(e_expanded, rls);
 
-		size_t num = e.nops();
-
-		if (num == 2) {
-
-			// Tr T_a T_b = 1/2 delta_a_b
-			return delta_tensor(e.op(0).op(1), e.op(1).op(1)) / 2;
-
-		} else if (num == 3) {
-
-			// Tr T_a T_b T_c = 1/4 h_a_b_c
-			return color_h(e.op(0).op(1), e.op(1).op(1), e.op(2).op(1)) / 4;
-
-		} else {
-
-			// Traces of 4 or more generators are computed recursively:
-			// Tr T_a1 .. T_an =
-			//     1/6 delta_a(n-1)_an Tr T_a1 .. T_a(n-2)
-			//   + 1/2 h_a(n-1)_an_k Tr T_a1 .. T_a(n-2) T_k
-			const ex &last_index = e.op(num - 1).op(1);
-			const ex &next_to_last_index = e.op(num - 2).op(1);
-			idx summation_index((new symbol)->setflag(status_flags::dynallocated), 8);
-
-			exvector v1;
-			v1.reserve(num - 2);
-			for (size_t i=0; i<num-2; i++)
-				v1.push_back(e.op(i));
-
-			exvector v2 = v1;
-			v2.push_back(color_T(summation_index, rl));
-
-			return delta_tensor(next_to_last_index, last_index) * color_trace(ncmul(v1), rl) / 6
-			       + color_h(next_to_last_index, last_index, summation_index) * color_trace(ncmul(v2), rl) / 2;
-		}
+		exvector iv;
+		iv.reserve(e.nops());
+		for (size_t i=0; i<e.nops(); i++)
+			iv.push_back(e.op(i).op(1));
+		return trace_strings().trace(iv);
 
 	} else if (e.nops() > 0) {
 
+		// Large sums may be traced by several threads
+		ex result;
+		if (trace_terms_parallel(e, color_trace_term, rls, _ex1, result))
+			return result;
+
 		// Trace maps to all other container classes (this includes sums)
 		pointer_to_map_function_1arg<const std::set<unsigned char> &> fcn(color_trace, rls);
 		return e.map(fcn);
@@ -173,6 +173,8 @@ ex color_d(const ex & a, const ex & b, const ex & c);
 ex color_h(const ex & a, const ex & b, const ex & c);
 
 /** Calculate color traces over the specified set of representation labels.
+ *  The terms of large sums may be traced by several threads, see
+ *  set_trace_threads().
  *
  *  @param e Expression to take the trace of
  *  @param rls Set of representation labels */
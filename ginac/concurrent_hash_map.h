@@ -0,0 +1,274 @@
+/** @file concurrent_hash_map.h
+ *
+ *  Hash table with 'ex' keys that may be shared between threads. */
+
+/*
+ *  GiNaC Copyright (C) 1999-2014 Johannes Gutenberg University Mainz, Germany
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#ifndef GINAC_CONCURRENT_HASH_MAP_H
+#define GINAC_CONCURRENT_HASH_MAP_H
+
+#include "hash_map.h"
+
+#include <cstddef>
+#include <utility>
+#include <vector>
+
+namespace GiNaC {
+
+/** Associative container with 'ex' objects as keys, like exhashmap, whose
+ *  member functions may be called by several threads at once if GiNaC is
+ *  built with GINAC_THREADSAFE_REFCOUNT.  It can serve as a cache, because
+ *  the number of entries may be bounded.
+ *
+ *  The keys are distributed over shards by their hash value.  Every shard
+ *  is an exhashmap with a spin lock of its own, so threads only wait for
+ *  each other if they use the same shard.  When a shard is full, entries
+ *  that were not used since the last look at them are evicted (the CLOCK
+ *  algorithm, an approximation of evicting the least recently used ones).
+ *
+ *  Differences to exhashmap:
+ *   - no iterators, and values are copied out, because a reference into
+ *     the table could change under the feet of the caller
+ *   - insert() doesn't return the entry, find() copies the value
+ *   - no operator==() and no swap()
+ *   - expressions replaced, erased or evicted are destroyed after the lock
+ *     is released, so a destructor may use the container again */
+template <typename T, template <class> class A = std::allocator>
+class concurrent_exhashmap {
+public:
+	// Standard types
+	typedef ex key_type;
+	typedef T mapped_type;
+	typedef std::pair<key_type, T> value_type;
+	typedef std::size_t size_type;
+
+	/** Number of shards unless the constructor is told otherwise. */
+	static const unsigned default_num_shards = 16;
+
+	/** Create an empty container.
+	 *
+	 *  @param max_entries  number of entries above which old ones are
+	 *                      evicted (roughly, as the shards are filled
+	 *                      unevenly), or 0 for no limit
+	 *  @param num_shards   number of independently locked parts, rounded
+	 *                      up to a power of 2 */
+	explicit concurrent_exhashmap(size_type max_entries = 0, unsigned num_shards = default_num_shards)
+	 : shards(round_num_shards(num_shards))
+	{
+		set_max_entries(max_entries);
+	}
+
+	// Capacity
+	bool empty() const
+	{
+		return size() == 0;
+	}
+
+	/** Number of entries.  Entries may come and go while it is counted. */
+	size_type size() const
+	{
+		size_type n = 0;
+		for (size_type s = 0; s < shards.size(); ++s) {
+			shard_lock lock(shards[s]);
+			n += shards[s].entries.size();
+		}
+		return n;
+	}
+
+	size_type get_max_entries() const
+	{
+		return max_entries;
+	}
+
+	/** Change the bound on the number of entries (0 for none).  Shards
+	 *  above the new bound shrink at their next insertion. */
+	void set_max_entries(size_type n)
+	{
+		max_entries = n;
+		max_shard_entries = n ? (n + shards.size() - 1) / shards.size() : 0;
+	}
+
+	// Element access
+
+	/** Copy the value of key to value and return true if there is one. */
+	bool find(const key_type &key, mapped_type &value) const
+	{
+		shard &sh = shard_of(key);
+		shard_lock lock(sh);
+		typename table::iterator i = sh.entries.find(key);
+		if (i == sh.entries.end())
+			return false;
+		i->second.used = true;
+		value = i->second.value;
+		return true;
+	}
+
+	size_type count(const key_type &key) const
+	{
+		shard &sh = shard_of(key);
+		shard_lock lock(sh);
+		return sh.entries.count(key);
+	}
+
+	// Modifiers
+
+	/** Insert x unless its key is already there.  Return true if it was
+	 *  inserted. */
+	bool insert(const value_type &x)
+	{
+		std::vector<typename table::value_type> evicted;
+		shard &sh = shard_of(x.first);
+		shard_lock lock(sh);
+		if (sh.entries.count(x.first))
+			return false;
+		make_room(sh, evicted);
+		sh.entries.insert(std::make_pair(x.first, entry(x.second)));
+		return true;
+	}
+
+	/** Insert x, replacing the value of its key if it is already there. */
+	void assign(const value_type &x)
+	{
+		std::vector<typename table::value_type> evicted;
+		shard &sh = shard_of(x.first);
+		shard_lock lock(sh);
+		typename table::iterator i = sh.entries.find(x.first);
+		if (i != sh.entries.end()) {
+			evicted.push_back(*i);
+			i->second = entry(x.second);
+			return;
+		}
+		make_room(sh, evicted);
+		sh.entries.insert(std::make_pair(x.first, entry(x.second)));
+	}
+
+	size_type erase(const key_type &key)
+	{
+		std::vector<typename table::value_type> erased;
+		shard &sh = shard_of(key);
+		shard_lock lock(sh);
+		typename table::iterator i = sh.entries.find(key);
+		if (i == sh.entries.end())
+			return 0;
+		erased.push_back(*i);
+		sh.entries.erase(i);
+		return 1;
+	}
+
+	void clear()
+	{
+		for (size_type s = 0; s < shards.size(); ++s) {
+			table erased;
+			shard_lock lock(shards[s]);
+			shards[s].entries.swap(erased);
+			shards[s].hand = 0;
+		}
+	}
+
+protected:
+	/** A value with the reference bit of the CLOCK algorithm. */
+	struct entry {
+		entry() : used(false) {}
+		explicit entry(const mapped_type &v) : value(v), used(false) {}
+
+		mapped_type value;
+		bool used; ///< used since the clock hand passed it
+	};
+
+	typedef exhashmap<entry, A> table;
+
+	struct shard {
+		shard() : hand(0), mutex(0) {}
+
+		table entries;
+		/** Position of the clock hand among the buckets of entries. */
+		size_type hand;
+		int mutex;
+	};
+
+#ifdef GINAC_THREADSAFE_REFCOUNT
+	/** Scoped spin lock around accesses to a shard. */
+	class shard_lock {
+	public:
+		shard_lock(shard &s) : mutex(s.mutex) { while (__sync_lock_test_and_set(&mutex, 1)) ; }
+		~shard_lock() { __sync_lock_release(&mutex); }
+	private:
+		int &mutex;
+	};
+#else
+	class shard_lock {
+	public:
+		shard_lock(shard &) {}
+	};
+#endif
+
+	static size_type round_num_shards(unsigned n)
+	{
+		size_type r = 1;
+		while (r < n)
+			r *= 2;
+		return r;
+	}
+
+	/** Return the shard of a key.  Its bits are scrambled differently than
+	 *  by exhashmap, so that the keys of a shard still spread over all of
+	 *  its buckets. */
+	shard &shard_of(const key_type &key) const
+	{
+		return shards[internal::mix_hash(key.gethash() ^ 0x9e3779b9U) & (shards.size() - 1)];
+	}
+
+	/** Evict entries from a full shard until there is room for one more.
+	 *  The evicted ones are copied to the vector, to be destroyed when the
+	 *  caller has released the lock. */
+	void make_room(shard &sh, std::vector<typename table::value_type> &evicted)
+	{
+		if (!max_shard_entries)
+			return;
+		table &t = sh.entries;
+		while (t.num_entries >= max_shard_entries) {
+			sh.hand = (sh.hand + 1) % t.num_buckets;
+			if (t.tags[sh.hand] == table::empty_tag)
+				continue;
+			typename table::value_type &v = t.hashtab[sh.hand].second;
+			if (v.second.used) {
+				v.second.used = false;
+				continue;
+			}
+			evicted.push_back(v);
+			t.erase(t.make_iterator(sh.hand));
+		}
+	}
+
+	mutable std::vector<shard> shards;
+	size_type max_entries;       ///< bound on the number of entries, 0 if none
+	size_type max_shard_entries; ///< bound on the number of entries of each shard, 0 if none
+
+private:
+	// Not copyable, because the locks can't be copied along
+	concurrent_exhashmap(const concurrent_exhashmap &);
+	concurrent_exhashmap &operator=(const concurrent_exhashmap &);
+};
+
+template <typename T, template <class> class A>
+const unsigned concurrent_exhashmap<T, A>::default_num_shards;
+
+} // namespace GiNaC
+
+#endif // ndef GINAC_CONCURRENT_HASH_MAP_H
@@ -45,7 +45,7 @@ GINAC_IMPLEMENT_REGISTERED_CLASS_OPT(constant, basic,
 
 // public
 
-constant::constant() : ef(0), serial(next_serial++), domain(domain::complex)
+constant::constant() : ef(0), serial(post_increment(next_serial)), domain(domain::complex)
 {
 	setflag(status_flags::evaluated | status_flags::expanded);
 }
@@ -57,7 +57,7 @@ constant::constant() : ef(0), serial(next_serial++), domain(domain::complex)
 // public
 
 constant::constant(const std::string & initname, evalffunctype efun, const std::string & texname, unsigned dm)
-  : name(initname), ef(efun), serial(next_serial++), domain(dm)
+  : name(initname), ef(efun), serial(post_increment(next_serial)), domain(dm)
 {
 	if (texname.empty())
 		TeX_name = "\\mathrm{" + name + "}";
@@ -67,7 +67,7 @@ constant::constant(const std::string & initname, evalffunctype efun, const std::
 }
 
 constant::constant(const std::string & initname, const numeric & initnumber, const std::string & texname, unsigned dm)
-  : name(initname), ef(0), number(initnumber), serial(next_serial++), domain(dm)
+  : name(initname), ef(0), number(initnumber), serial(post_increment(next_serial)), domain(dm)
 {
 	if (texname.empty())
 		TeX_name = "\\mathrm{" + name + "}";
@@ -158,6 +158,14 @@ ex constant::evalf(int level) const
 	return *this;
 }
 
+std::complex<double> constant::evalf_double(const evalf_double_map & values) const
+{
+	const ex e = evalf();
+	if (!is_exactly_a<numeric>(e))
+		throw std::invalid_argument("evalf_double(): constant " + name + " does not evaluate to a number");
+	return ex_to<numeric>(e).evalf_double(values);
+}
+
 bool constant::is_polynomial(const ex & var) const
 {
 	return true;
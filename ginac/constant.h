@@ -49,6 +49,7 @@ public:
 public:
 	bool info(unsigned inf) const;
 	ex evalf(int level = 0) const;
+	std::complex<double> evalf_double(const evalf_double_map & values) const;
 	bool is_polynomial(const ex & var) const;
 	ex conjugate() const;
 	ex real_part() const;
@@ -59,6 +60,7 @@ protected:
 	ex derivative(const symbol & s) const;
 	bool is_equal_same_type(const basic & other) const;
 	unsigned calchash() const;
+	unsigned calc_symbol_mask() const { return 0; }
 	
 	// non-virtual functions in this class
 protected:
@@ -29,6 +29,7 @@
 #include "assertion.h"
 
 #include <algorithm>
+#include <cstddef>
 #include <iterator>
 #include <list>
 #include <memory>
@@ -52,6 +53,17 @@ protected:
 	void reserve(size_t) {}
 	static void reserve(STLT &, size_t) {}
 
+	/** Iterator to the element at position i. */
+	typename STLT::iterator position(size_t i) const
+	{
+		typename STLT::iterator it = const_cast<STLT &>(seq).begin();
+		std::advance(it, i);
+		return it;
+	}
+
+	/** Tell that elements were inserted or removed other than at the end. */
+	void invalidate_position() {}
+
 	STLT seq;
 
 	// disallow destruction of container through a container_storage*
@@ -65,6 +77,77 @@ inline void container_storage<std::vector>::reserve(size_t n) { seq.reserve(n);
 template <>
 inline void container_storage<std::vector>::reserve(std::vector<ex> & v, size_t n) { v.reserve(n); }
 
+/** Storage of lists.  It remembers the position of the element found last,
+ *  so that op(i) and let_op(i) only walk from there, and going through the
+ *  elements one after the other (forwards or backwards) takes constant time
+ *  per element instead of O(i). */
+template <>
+class container_storage<std::list> {
+protected:
+	typedef std::list<ex> STLT;
+
+	container_storage() : has_cursor(false), cursor_lock(0) {}
+	container_storage(size_t n, const ex & e) : seq(n, e), has_cursor(false), cursor_lock(0) {}
+
+	template <class In>
+	container_storage(In b, In e) : seq(b, e), has_cursor(false), cursor_lock(0) {}
+
+	// The cursor of a copy must point into its own list
+	container_storage(const container_storage & other)
+	 : seq(other.seq), has_cursor(false), cursor_lock(0) {}
+	container_storage & operator=(const container_storage & other)
+	{
+		seq = other.seq;
+		invalidate_position();
+		return *this;
+	}
+
+	void reserve(size_t) {}
+	static void reserve(STLT &, size_t) {}
+
+	STLT::iterator position(size_t i) const
+	{
+		STLT::iterator it = const_cast<STLT &>(seq).begin();
+#ifdef GINAC_THREADSAFE_REFCOUNT
+		// Another thread is looking up an element of the same list, so
+		// walk from the beginning instead of waiting for it
+		if (__sync_lock_test_and_set(&cursor_lock, 1)) {
+			std::advance(it, i);
+			return it;
+		}
+#endif
+		if (has_cursor && (cursor_index > i ? cursor_index - i : i - cursor_index) < i) {
+			it = cursor;
+			if (cursor_index > i)
+				std::advance(it, -static_cast<std::ptrdiff_t>(cursor_index - i));
+			else
+				std::advance(it, i - cursor_index);
+		} else
+			std::advance(it, i);
+		cursor = it;
+		cursor_index = i;
+		has_cursor = true;
+#ifdef GINAC_THREADSAFE_REFCOUNT
+		__sync_lock_release(&cursor_lock);
+#endif
+		return it;
+	}
+
+	void invalidate_position() { has_cursor = false; }
+
+	STLT seq;
+
+private:
+	mutable STLT::iterator cursor; ///< element found last
+	mutable size_t cursor_index;   ///< position of cursor
+	mutable bool has_cursor;       ///< cursor is valid
+	mutable int cursor_lock;
+
+	// disallow destruction of container through a container_storage*
+protected:
+	~container_storage() {}
+};
+
 
 /** Helper template to allow initialization of containers via an overloaded
  *  comma operator (idea stolen from Blitz++). */
@@ -358,6 +441,7 @@ public:
 public:
 	bool info(unsigned inf) const { return inherited::info(inf); }
 	unsigned precedence() const { return 10; }
+	std::size_t footprint() const { return this->object_size() + this->seq.size() * sizeof(ex); }
 	size_t nops() const { return this->seq.size(); }
 	ex op(size_t i) const;
 	ex & let_op(size_t i);
@@ -546,9 +630,7 @@ ex container<C>::op(size_t i) const
 {
 	GINAC_ASSERT(i < nops());
 
-	const_iterator it = this->seq.begin();
-	advance(it, i);
-	return *it;
+	return *this->position(i);
 }
 
 template <template <class T, class = std::allocator<T> > class C>
@@ -557,9 +639,7 @@ ex & container<C>::let_op(size_t i)
 	GINAC_ASSERT(i < nops());
 
 	ensure_if_modifiable();
-	typename STLT::iterator it = this->seq.begin();
-	advance(it, i);
-	return *it;
+	return *this->position(i);
 }
 
 template <template <class T, class = std::allocator<T> > class C>
@@ -642,6 +722,7 @@ container<C> & container<C>::prepend(const ex & b)
 {
 	ensure_if_modifiable();
 	this->seq.push_front(b);
+	this->invalidate_position();
 	return *this;
 }
 
@@ -660,6 +741,7 @@ container<C> & container<C>::remove_first()
 {
 	ensure_if_modifiable();
 	this->seq.pop_front();
+	this->invalidate_position();
 	return *this;
 }
 
@@ -669,6 +751,7 @@ container<C> & container<C>::remove_last()
 {
 	ensure_if_modifiable();
 	this->seq.pop_back();
+	this->invalidate_position();
 	return *this;
 }
 
@@ -678,6 +761,7 @@ container<C> & container<C>::remove_all()
 {
 	ensure_if_modifiable();
 	this->seq.clear();
+	this->invalidate_position();
 	return *this;
 }
 
@@ -687,6 +771,7 @@ container<C> & container<C>::sort()
 {
 	ensure_if_modifiable();
 	sort_(typename std::iterator_traits<typename STLT::iterator>::iterator_category());
+	this->invalidate_position();
 	return *this;
 }
 
@@ -702,6 +787,7 @@ container<C> & container<C>::unique()
 {
 	ensure_if_modifiable();
 	unique_();
+	this->invalidate_position();
 	return *this;
 }
 
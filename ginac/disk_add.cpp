@@ -0,0 +1,285 @@
+/** @file disk_add.cpp
+ *
+ *  Implementation of the accumulation of sums which don't fit into
+ *  memory. */
+
+/*
+ *  GiNaC Copyright (C) 1999-2014 Johannes Gutenberg University Mainz, Germany
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#include "disk_add.h"
+#include "archive.h"
+#include "symbol.h"
+#include "utils.h"
+
+#include <algorithm>
+#include <cstdlib>
+#include <queue>
+#include <stdexcept>
+#include <unistd.h>
+
+namespace GiNaC {
+
+namespace {
+
+/** Number of runs which are merged at once.  More runs are first merged
+ *  in groups of this many into longer ones. */
+const std::size_t max_open_runs = 64;
+
+/** Orders the terms of a run. */
+struct rest_is_less {
+	bool operator()(const expair & a, const expair & b) const { return a.rest.compare(b.rest) < 0; }
+};
+
+/** The current term of a run being merged. */
+struct run_reader {
+	std::FILE * file;
+	std::string data;
+	ex rest;
+	numeric coeff;
+
+	/** Read the next term.  Returns false at the end of the run. */
+	bool next(lst & syms)
+	{
+		unsigned char length[8];
+		const std::size_t got = std::fread(length, 1, 8, file);
+		if (got == 0 && std::feof(file))
+			return false;
+		if (got != 8)
+			throw std::runtime_error("disk_add_builder: run file is truncated");
+		std::size_t n = 0;
+		for (int i = 7; i >= 0; --i)
+			n = (n << 8) | length[i];
+		data.resize(n);
+		if (n > 0 && std::fread(&data[0], 1, n, file) != n)
+			throw std::runtime_error("disk_add_builder: run file is truncated");
+		std::size_t pos = 0;
+		rest = deserialize(data, pos, syms);
+		coeff = ex_to<numeric>(deserialize(data, pos, syms));
+		return true;
+	}
+};
+
+/** Puts the run with the least current term on top of a priority queue. */
+struct run_is_greater {
+	bool operator()(const run_reader * a, const run_reader * b) const { return a->rest.compare(b->rest) > 0; }
+};
+
+/** Where write_to_run() writes. */
+struct run_target {
+	disk_add_builder * builder;
+	std::FILE * file;
+};
+
+/** Collects the terms for result(). */
+struct term_collector {
+	epvector terms;
+	numeric constant;
+};
+
+void collect_term(const ex & rest, const numeric & coeff, void * data)
+{
+	term_collector & c = *static_cast<term_collector *>(data);
+	if (is_exactly_a<numeric>(rest))
+		c.constant = coeff;
+	else
+		c.terms.push_back(expair(rest, coeff));
+}
+
+} // anonymous namespace
+
+disk_add_builder::disk_add_builder(std::size_t max_terms_, const std::string & directory_)
+ : max_terms(max_terms_ ? max_terms_ : 1), directory(directory_), constant(0)
+{
+}
+
+disk_add_builder::~disk_add_builder()
+{
+	for (std::size_t k = 0; k < run_files.size(); ++k)
+		std::fclose(run_files[k]);
+}
+
+void disk_add_builder::add_term(const ex & e, const numeric & c)
+{
+	buffer.add_term(e, c);
+	if (buffer.size() >= max_terms)
+		spill();
+}
+
+/** Create an anonymous temporary file for a run. */
+std::FILE * disk_add_builder::new_run_file()
+{
+	std::string dir = directory;
+	if (dir.empty()) {
+		const char * tmpdir = std::getenv("TMPDIR");
+		dir = (tmpdir && *tmpdir) ? tmpdir : "/tmp";
+	}
+	const std::string pattern = dir + "/ginac-sum-XXXXXX";
+	std::vector<char> name(pattern.begin(), pattern.end());
+	name.push_back('\0');
+	const int fd = mkstemp(&name[0]);
+	if (fd < 0)
+		throw std::runtime_error("disk_add_builder: cannot create a file in " + dir);
+	std::FILE * file = fdopen(fd, "w+b");
+	std::remove(&name[0]);
+	if (!file) {
+		close(fd);
+		throw std::runtime_error("disk_add_builder: cannot open a file in " + dir);
+	}
+	return file;
+}
+
+/** Append a term to a run: its length in 8 bytes (least significant
+ *  first), then rest and coeff as written by serialize().  The symbols are
+ *  written by their position in the table of symbols. */
+void disk_add_builder::write_term(std::FILE * file, const ex & rest, const numeric & coeff)
+{
+	for (const_preorder_iterator i = rest.preorder_begin(); i != rest.preorder_end(); ++i)
+		if (is_a<symbol>(*i) && known_symbols.insert(*i).second)
+			symbols.append(*i);
+
+	record.assign(8, '\0');
+	serialize(rest, record, symbols);
+	serialize(coeff, record, symbols);
+	std::size_t n = record.size() - 8;
+	for (int i = 0; i < 8; ++i) {
+		record[i] = char(n & 0xff);
+		n >>= 8;
+	}
+	if (std::fwrite(record.data(), 1, record.size(), file) != record.size())
+		throw std::runtime_error("disk_add_builder: cannot write a run");
+}
+
+void disk_add_builder::write_to_run(const ex & rest, const numeric & coeff, void * data)
+{
+	run_target & t = *static_cast<run_target *>(data);
+	t.builder->write_term(t.file, rest, coeff);
+}
+
+/** Write the terms in memory as a run. */
+void disk_add_builder::spill()
+{
+	constant = constant.add(buffer.overall_coeff);
+	buffer.overall_coeff = *_num0_p;
+
+	epvector & terms = buffer.terms;
+	std::sort(terms.begin(), terms.end(), rest_is_less());
+	epvector::const_iterator i = terms.begin();
+	while (i != terms.end() && ex_to<numeric>(i->coeff).is_zero())
+		++i;
+	if (i != terms.end()) {
+		run_files.push_back(new_run_file());
+		for (; i != terms.end(); ++i)
+			if (!ex_to<numeric>(i->coeff).is_zero())
+				write_term(run_files.back(), i->rest, ex_to<numeric>(i->coeff));
+		if (std::fflush(run_files.back()) != 0)
+			throw std::runtime_error("disk_add_builder: cannot write a run");
+	}
+	buffer.clear();
+}
+
+/** Merge the runs from first to last (exclusive), passing the combined
+ *  nonzero terms to f. */
+void disk_add_builder::merge_runs(std::size_t first, std::size_t last, term_callback f, void * data)
+{
+	std::vector<run_reader> readers(last - first);
+	std::priority_queue<run_reader *, std::vector<run_reader *>, run_is_greater> heap;
+	for (std::size_t k = 0; k < readers.size(); ++k) {
+		readers[k].file = run_files[first + k];
+		std::rewind(readers[k].file);
+		if (readers[k].next(symbols))
+			heap.push(&readers[k]);
+	}
+
+	while (!heap.empty()) {
+		run_reader * r = heap.top();
+		heap.pop();
+		const ex rest = r->rest;
+		numeric coeff = r->coeff;
+		if (r->next(symbols))
+			heap.push(r);
+		while (!heap.empty() && heap.top()->rest.is_equal(rest)) {
+			run_reader * s = heap.top();
+			heap.pop();
+			coeff = coeff.add(s->coeff);
+			if (s->next(symbols))
+				heap.push(s);
+		}
+		if (!coeff.is_zero())
+			f(rest, coeff, data);
+	}
+}
+
+void disk_add_builder::for_each_term(term_callback f, void * data)
+{
+	if (run_files.empty()) {
+		// Everything is in memory
+		epvector terms(buffer.terms);
+		std::sort(terms.begin(), terms.end(), rest_is_less());
+		for (epvector::const_iterator i = terms.begin(); i != terms.end(); ++i)
+			if (!ex_to<numeric>(i->coeff).is_zero())
+				f(i->rest, ex_to<numeric>(i->coeff), data);
+		const numeric c = constant.add(buffer.overall_coeff);
+		if (!c.is_zero())
+			f(_ex1, c, data);
+		return;
+	}
+
+	spill();
+	while (run_files.size() > max_open_runs) {
+		run_target target;
+		target.builder = this;
+		target.file = new_run_file();
+		try {
+			merge_runs(0, max_open_runs, write_to_run, &target);
+			if (std::fflush(target.file) != 0)
+				throw std::runtime_error("disk_add_builder: cannot write a run");
+		} catch (...) {
+			std::fclose(target.file);
+			throw;
+		}
+		for (std::size_t k = 0; k < max_open_runs; ++k)
+			std::fclose(run_files[k]);
+		run_files.erase(run_files.begin(), run_files.begin() + max_open_runs);
+		run_files.push_back(target.file);
+	}
+	merge_runs(0, run_files.size(), f, data);
+	if (!constant.is_zero())
+		f(_ex1, constant, data);
+}
+
+ex disk_add_builder::result()
+{
+	term_collector c;
+	for_each_term(collect_term, &c);
+	std::auto_ptr<epvector> vp(new epvector);
+	vp->swap(c.terms);
+	return (new add(vp, c.constant))->setflag(status_flags::dynallocated);
+}
+
+void disk_add_builder::clear()
+{
+	for (std::size_t k = 0; k < run_files.size(); ++k)
+		std::fclose(run_files[k]);
+	run_files.clear();
+	buffer.clear();
+	constant = *_num0_p;
+	symbols.remove_all();
+	known_symbols.clear();
+}
+
+} // namespace GiNaC
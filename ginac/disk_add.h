@@ -0,0 +1,109 @@
+/** @file disk_add.h
+ *
+ *  Accumulation of sums which don't fit into memory. */
+
+/*
+ *  GiNaC Copyright (C) 1999-2014 Johannes Gutenberg University Mainz, Germany
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#ifndef GINAC_DISK_ADD_H
+#define GINAC_DISK_ADD_H
+
+#include "add.h"
+#include "lst.h"
+#include "numeric.h"
+
+#include <cstddef>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+namespace GiNaC {
+
+/** Receiver of the terms of a sum, one at a time: the term is coeff*rest. */
+typedef void (*term_callback)(const ex & rest, const numeric & coeff, void * data);
+
+/** Accumulates a sum like add_builder, but writes the terms to temporary
+ *  files when there are too many of them to be kept in memory, like FORM
+ *  does.  At most max_terms distinct terms are combined in memory; then
+ *  they are sorted by ex_is_less and written as a run, in the format of
+ *  serialize().  The runs are merged, combining equal terms, when the sum
+ *  is read with for_each_term() or result().
+ *
+ *  The files are created in the given directory, or in $TMPDIR (/tmp if
+ *  that is unset), and removed at once, so they vanish when the builder
+ *  is destroyed or the program ends.
+ *
+ *  @code
+ *  disk_add_builder b(1000000, "/scratch");
+ *  for (...)
+ *      b += term;
+ *  b.for_each_term(print_term, &out);
+ *  @endcode */
+class disk_add_builder {
+public:
+	explicit disk_add_builder(std::size_t max_terms = 1000000, const std::string & directory = "");
+	~disk_add_builder();
+
+	/** Add e.  The terms of sums are added one by one. */
+	disk_add_builder & operator+=(const ex & e) { add_term(e, 1); return *this; }
+
+	/** Subtract e. */
+	disk_add_builder & operator-=(const ex & e) { add_term(e, -1); return *this; }
+
+	/** Add c*e. */
+	void add_term(const ex & e, const numeric & c);
+
+	/** Number of runs written to disk so far. */
+	std::size_t runs() const { return run_files.size(); }
+
+	/** Pass the nonzero terms of the sum to f in the order of ex_is_less
+	 *  of their rest, and the numeric term last (with rest 1) if it is
+	 *  nonzero.  Only one term of each run is in memory at a time.  More
+	 *  terms may be added afterwards. */
+	void for_each_term(term_callback f, void * data);
+
+	/** The sum of everything added so far, which has to fit into memory. */
+	ex result();
+
+	/** Start a new sum, removing the runs. */
+	void clear();
+
+private:
+	void spill();
+	std::FILE * new_run_file();
+	void merge_runs(std::size_t first, std::size_t last, term_callback f, void * data);
+	void write_term(std::FILE * file, const ex & rest, const numeric & coeff);
+
+	static void write_to_run(const ex & rest, const numeric & coeff, void * data);
+
+	add_builder buffer;
+	std::size_t max_terms;
+	std::string directory;
+	std::vector<std::FILE *> run_files;
+	numeric constant;   ///< numeric term of the spilled parts
+	lst symbols;        ///< symbols in the runs, which are written by position
+	exset known_symbols;
+	std::string record; ///< buffer for writing one term
+
+	disk_add_builder(const disk_add_builder &);
+	disk_add_builder & operator=(const disk_add_builder &);
+};
+
+} // namespace GiNaC
+
+#endif // ndef GINAC_DISK_ADD_H
@@ -0,0 +1,86 @@
+/** @file distributed.cpp
+ *
+ *  Implementation of the term-parallel processing of sums by several
+ *  processes. */
+
+/*
+ *  GiNaC Copyright (C) 1999-2014 Johannes Gutenberg University Mainz, Germany
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#include "distributed.h"
+#include "add.h"
+#include "archive.h"
+#include "utils.h"
+
+#include <stdexcept>
+
+namespace GiNaC {
+
+void serialize_shards(const ex & e, std::size_t n, std::vector<std::string> & shards, const lst & syms)
+{
+	if (n == 0)
+		throw std::invalid_argument("serialize_shards(): no shards");
+	shards.assign(n, std::string());
+	if (!is_exactly_a<add>(e)) {
+		serialize(e, shards[0], syms);
+		for (std::size_t k = 1; k < n; ++k)
+			serialize(_ex0, shards[k], syms);
+		return;
+	}
+
+	const std::size_t nterms = e.nops();
+	add_builder b;
+	for (std::size_t k = 0; k < n; ++k) {
+		b.clear();
+		const std::size_t first = nterms * k / n;
+		const std::size_t last = nterms * (k + 1) / n;
+		for (std::size_t i = first; i < last; ++i)
+			b += e.op(i);
+		serialize(b.result(), shards[k], syms);
+	}
+}
+
+std::string map_shard(const std::string & shard, map_function & f, lst & syms)
+{
+	const ex terms = deserialize(shard, syms);
+	// A shard with one term is that term, not a sum, and 0 has none
+	ex result = terms;
+	if (is_exactly_a<add>(terms))
+		result = terms.parallel_map(f);
+	else if (!terms.is_zero())
+		result = f(terms);
+	std::string buf;
+	serialize(result, buf, syms);
+	return buf;
+}
+
+ex sum_shards(const std::vector<std::string> & shards, lst & syms)
+{
+	add_builder b;
+	for (std::size_t k = 0; k < shards.size(); ++k)
+		b += deserialize(shards[k], syms);
+	return b.result();
+}
+
+std::string combine_shards(const std::vector<std::string> & shards, lst & syms)
+{
+	std::string buf;
+	serialize(sum_shards(shards, syms), buf, syms);
+	return buf;
+}
+
+} // namespace GiNaC
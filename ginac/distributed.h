@@ -0,0 +1,71 @@
+/** @file distributed.h
+ *
+ *  Term-parallel processing of sums by several processes. */
+
+/*
+ *  GiNaC Copyright (C) 1999-2014 Johannes Gutenberg University Mainz, Germany
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#ifndef GINAC_DISTRIBUTED_H
+#define GINAC_DISTRIBUTED_H
+
+#include "ex.h"
+#include "lst.h"
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+namespace GiNaC {
+
+/*
+ *  The functions below do the work of a term-parallel computation spread
+ *  over several processes (like the ranks of an MPI program), which GiNaC
+ *  leaves to the application to send around:
+ *
+ *   1. The root splits a sum into shards with serialize_shards() and sends
+ *      one to each process.
+ *   2. Each process applies a map function to the terms of its shard with
+ *      map_shard().
+ *   3. The results are combined pairwise (or in larger groups) with
+ *      combine_shards() along a reduction tree, and the last combination is
+ *      read with sum_shards().
+ *
+ *  The shards are in the format of serialize(), with the symbols in syms
+ *  written by position, so all processes must pass the same list of
+ *  symbols in the same order.  The result is the same sum as the serial
+ *  e.map(f).
+ */
+
+/** Split the terms of the sum e into n shards of about equal size.  If e
+ *  is not a sum, it is the first shard and the others are 0. */
+extern void serialize_shards(const ex & e, std::size_t n, std::vector<std::string> & shards,
+                             const lst & syms = lst());
+
+/** Apply f to each term of a shard, with ex::parallel_map() (so f must be
+ *  thread-safe), and return the sum of the results as a shard. */
+extern std::string map_shard(const std::string & shard, map_function & f, lst & syms);
+
+/** Add shards, returning the sum as a shard. */
+extern std::string combine_shards(const std::vector<std::string> & shards, lst & syms);
+
+/** Add shards. */
+extern ex sum_shards(const std::vector<std::string> & shards, lst & syms);
+
+} // namespace GiNaC
+
+#endif // ndef GINAC_DISTRIBUTED_H
@@ -20,19 +20,52 @@
  *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
  */
 
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
 #include "ex.h"
 #include "add.h"
+#include "hash_map.h"
+#include "inifcns.h"
 #include "mul.h"
 #include "ncmul.h"
 #include "numeric.h"
+#include "operators.h"
 #include "matrix.h"
 #include "power.h"
+#include "pseries.h"
 #include "lst.h"
 #include "relational.h"
+#include "symbol.h"
+#include "profile.h"
+#include "subs_index.h"
+#include "tasks.h"
+#include "truncation.h"
 #include "utils.h"
 
+#include <algorithm>
 #include <iostream>
+#include <map>
+#include <sstream>
 #include <stdexcept>
+#include <string>
+#include <vector>
+
+#ifdef GINAC_THREADSAFE_REFCOUNT
+#define GINAC_PRINT_THREAD_LOCAL __thread
+#define GINAC_MEMO_THREAD_LOCAL __thread
+#define GINAC_DEFERRAL_THREAD_LOCAL __thread
+#else
+#define GINAC_PRINT_THREAD_LOCAL
+#define GINAC_MEMO_THREAD_LOCAL
+#define GINAC_DEFERRAL_THREAD_LOCAL
+#endif
+#if defined(GINAC_THREADSAFE_REFCOUNT) && defined(HAVE_PTHREAD_H)
+// Operands are only mapped concurrently if expressions may be shared
+// between threads at all.
+#define PARALLEL_MAP 1
+#endif
 
 namespace GiNaC {
 
@@ -46,16 +79,166 @@ namespace GiNaC {
 // non-virtual functions in this class
 //////////
 
+namespace {
+
+/** Nesting depth of print() calls at which the output of subexpressions is
+ *  postponed, so that printing deeply nested expressions does not overflow
+ *  the stack. */
+const unsigned print_depth_limit = 256;
+
+/** Subexpression whose output was postponed, and the output that follows
+ *  it up to the next postponed subexpression. */
+struct postponed_print {
+	ex e;
+	const print_context * c;
+	unsigned level;
+	std::string text;
+};
+
+/** State of the print() call at the top level, which is printing to
+ *  stream.  Must be a POD, so it can be thread-local. */
+struct print_state {
+	std::ostream * stream;
+	const print_context * top;  ///< context passed at the top level
+	unsigned depth;
+	std::vector<postponed_print> * postponed;
+	std::vector<print_context *> * contexts;  ///< copies of other contexts
+	std::stringbuf * buffer;    ///< output after the first postponed subexpression
+	std::streambuf * original;  ///< buffer of stream, while it is redirected
+};
+
+GINAC_PRINT_THREAD_LOCAL print_state the_print_state;
+
+/** Postpone the output of e. Everything printed until the next call goes
+ *  to the text of e. */
+void postpone_print(const ex & e, const print_context & c, unsigned level)
+{
+	print_state & st = the_print_state;
+	if (st.original == 0)
+		st.original = c.s.rdbuf(st.buffer);
+	else {
+		st.postponed->back().text = st.buffer->str();
+		st.buffer->str(std::string());
+	}
+	st.postponed->push_back(postponed_print());
+	postponed_print & p = st.postponed->back();
+	p.e = e;
+	p.level = level;
+	if (&c == st.top)
+		p.c = &c;
+	else {
+		// The context may be a temporary of the caller
+		st.contexts->push_back(c.duplicate());
+		p.c = st.contexts->back();
+	}
+}
+
+/** Print e, except for the subexpressions nested too deeply, which are
+ *  appended to postponed. */
+void print_or_postpone(const ex & e, const print_context & c, unsigned level,
+                       std::vector<postponed_print> & postponed,
+                       std::vector<print_context *> & contexts)
+{
+	print_state & st = the_print_state;
+	std::stringbuf buffer;
+	st.stream = &c.s;
+	st.top = &c;
+	st.depth = 0;
+	st.postponed = &postponed;
+	st.contexts = &contexts;
+	st.buffer = &buffer;
+	st.original = 0;
+	try {
+		e.print(c, level);
+	} catch (...) {
+		if (st.original)
+			c.s.rdbuf(st.original);
+		st.stream = 0;
+		throw;
+	}
+	if (st.original) {
+		postponed.back().text = buffer.str();
+		c.s.rdbuf(st.original);
+	}
+	st.stream = 0;
+}
+
+/** One postponed expression after another, with the ones postponed while
+ *  printing them, in the order of the output. */
+struct print_frame {
+	print_frame() : next(0), printed(false) {}
+	std::vector<postponed_print> postponed;
+	std::size_t next;
+	bool printed;  ///< whether postponed[next].e has been printed
+};
+
+/** Print e at the top level. The subexpressions postponed by the print()
+ *  calls are printed afterwards, using a stack instead of recursion. */
+void print_top(const ex & e, const print_context & c, unsigned level)
+{
+	std::vector<print_context *> contexts;
+	try {
+		std::vector<print_frame> stack(1);
+		print_or_postpone(e, c, level, stack.back().postponed, contexts);
+		while (!stack.empty()) {
+			print_frame & f = stack.back();
+			if (f.next == f.postponed.size()) {
+				stack.pop_back();
+				continue;
+			}
+			postponed_print & p = f.postponed[f.next];
+			if (!f.printed) {
+				f.printed = true;
+				std::vector<postponed_print> inner;
+				print_or_postpone(p.e, *p.c, p.level, inner, contexts);
+				if (!inner.empty()) {
+					stack.push_back(print_frame());
+					stack.back().postponed.swap(inner);
+					continue;
+				}
+			}
+			c.s.write(p.text.data(), p.text.size());
+			++f.next;
+			f.printed = false;
+		}
+	} catch (...) {
+		for (std::vector<print_context *>::iterator i = contexts.begin(); i != contexts.end(); ++i)
+			delete *i;
+		throw;
+	}
+	for (std::vector<print_context *>::iterator i = contexts.begin(); i != contexts.end(); ++i)
+		delete *i;
+}
+
+} // anonymous namespace
+
 // public
 	
 /** Print expression to stream. The formatting of the output is determined
  *  by the kind of print_context object that is passed. Possible formattings
  *  include ginsh-parsable output (the default), tree-like output for
  *  debugging, and C++ source.
+ *
+ *  Subexpressions which are nested too deeply are printed after the
+ *  enclosing expression and spliced into the output, so that the depth of
+ *  the recursion stays bounded.
  *  @see print_context */
 void ex::print(const print_context & c, unsigned level) const
 {
-	bp->print(c, level);
+	print_state & st = the_print_state;
+	if (st.stream == &c.s) {
+		if (st.depth >= print_depth_limit) {
+			postpone_print(*this, c, level);
+			return;
+		}
+		++st.depth;
+		bp->print(c, level);
+		--st.depth;
+	} else if (st.stream != 0) {
+		// printing to another stream meanwhile
+		bp->print(c, level);
+	} else
+		print_top(*this, c, level);
 }
 
 /** Little wrapper arount print to be called within a debugger. */
@@ -70,27 +253,6 @@ void ex::dbgprinttree() const
 	bp->dbgprinttree();
 }
 
-ex ex::expand(unsigned options) const
-{
-	if (options == 0 && (bp->flags & status_flags::expanded)) // The "expanded" flag only covers the standard options; someone might want to re-expand with different options
-		return *this;
-	else
-		return bp->expand(options);
-}
-
-/** Compute partial derivative of an expression.
- *
- *  @param s  symbol by which the expression is derived
- *  @param nth  order of derivative (default 1)
- *  @return partial derivative as a new expression */
-ex ex::diff(const symbol & s, unsigned nth) const
-{
-	if (!nth)
-		return *this;
-	else
-		return bp->diff(s, nth);
-}
-
 /** Check whether expression matches a specified pattern. */
 bool ex::match(const ex & pattern) const
 {
@@ -115,6 +277,729 @@ bool ex::find(const ex & pattern, exset& found) const
 	return any_found;
 }
 
+namespace {
+
+/** Results of subs() with one map and options, of diff() by one symbol,
+ *  or of map() with one map function, for the shared subexpressions, while
+ *  the call at the top level is running.  The originals are kept, so that
+ *  their addresses are not reused. */
+class memo_scope {
+public:
+	enum operation { memo_map, memo_subs, memo_diff, memo_expand, memo_has };
+
+	memo_scope(operation o, const void * w, unsigned opt)
+	 : key_mask(0), deep(false), op(o), owner(w), options(opt), previous(current)
+	{
+		current = this;
+	}
+	~memo_scope() { current = previous; }
+
+	static memo_scope * find(operation o, const void * owner, unsigned options)
+	{
+		for (memo_scope * s = current; s; s = s->previous)
+			if (s->op == o && s->owner == owner && s->options == options)
+				return s;
+		return 0;
+	}
+
+	/** The remembered result for e, or 0. */
+	const ex * lookup(const ex & e) const
+	{
+		result_map::const_iterator i = results.find(&ex_to<basic>(e));
+		return i == results.end() ? 0 : &i->second.second;
+	}
+
+	void remember(const ex & e, const ex & result)
+	{
+		results.insert(std::make_pair(&ex_to<basic>(e), std::make_pair(e, result)));
+	}
+
+	/** Whether results for e are worth remembering. */
+	static bool shared(const ex & e)
+	{
+		const basic & b = ex_to<basic>(e);
+		return b.nops() && b.get_refcount() > 1;
+	}
+
+	typedef std::map<const basic *, std::pair<ex, ex> > result_map;
+	result_map results;
+
+	/** For subs() with only symbols as keys, the symbol mask of the keys
+	 *  (see basic::get_symbol_mask()), otherwise 0. */
+	unsigned key_mask;
+
+	/** Whether the results for all subexpressions are remembered, not
+	 *  only for the shared ones (see fill_bottom_up()). */
+	bool deep;
+
+private:
+	operation op;
+	const void * owner;
+	unsigned options;
+	memo_scope * previous;
+	static GINAC_MEMO_THREAD_LOCAL memo_scope * current;
+
+	memo_scope(const memo_scope &);
+	memo_scope & operator=(const memo_scope &);
+};
+
+GINAC_MEMO_THREAD_LOCAL memo_scope * memo_scope::current = 0;
+
+/** Nesting depth of subs(), diff(), expand() and has() at which the
+ *  subexpressions are done bottom-up first, so that deeply nested
+ *  expressions do not overflow the stack. */
+const unsigned memo_depth_limit = 256;
+
+GINAC_MEMO_THREAD_LOCAL unsigned memo_depth = 0;
+
+/** Counts the nesting of these operations while it exists. */
+struct memo_depth_counter {
+	memo_depth_counter() { ++memo_depth; }
+	~memo_depth_counter() { --memo_depth; }
+};
+
+/** Remember in s the results of compute() for e and its subexpressions.
+ *  They are computed in postorder with an explicit stack, so that the
+ *  operation finds the results for the operands instead of recursing.
+ *  Returns the result for e, which must have operands. */
+template <class F>
+ex fill_bottom_up(const ex & e, memo_scope & s, const F & compute)
+{
+	s.deep = true;
+	std::vector<std::pair<ex, size_t> > stack;
+	stack.push_back(std::make_pair(e, size_t(0)));
+	while (!stack.empty()) {
+		const ex node = stack.back().first;
+		const size_t i = stack.back().second;
+		if (i < node.nops()) {
+			++stack.back().second;
+			const ex child = node.op(i);
+			if (child.nops() && !s.lookup(child))
+				stack.push_back(std::make_pair(child, size_t(0)));
+		} else {
+			stack.pop_back();
+			if (!s.lookup(node))
+				s.remember(node, compute(node));
+		}
+	}
+	return *s.lookup(e);
+}
+
+struct subs_compute {
+	subs_compute(const exmap & mm, unsigned opt) : m(mm), options(opt) {}
+	ex operator()(const ex & e) const { return ex_to<basic>(e).subs(m, options); }
+	const exmap & m;
+	unsigned options;
+};
+
+struct diff_compute {
+	diff_compute(const symbol & sym) : s(sym) {}
+	ex operator()(const ex & e) const { return ex_to<basic>(e).diff(s); }
+	const symbol & s;
+};
+
+struct expand_compute {
+	expand_compute(unsigned opt) : options(opt) {}
+	ex operator()(const ex & e) const { return ex_to<basic>(e).expand(options); }
+	unsigned options;
+};
+
+struct has_compute {
+	has_compute(const ex & p, unsigned opt) : pattern(p), options(opt) {}
+	ex operator()(const ex & e) const { return ex_to<basic>(e).has(pattern, options) ? _ex1 : _ex0; }
+	const ex & pattern;
+	unsigned options;
+};
+
+/** Owner of the memos of expand(). */
+const int expand_owner = 0;
+
+/** Map function which remembers the results of a pure one for shared
+ *  subexpressions. */
+class memo_map_function : public map_function {
+public:
+	memo_map_function(map_function & fn, memo_scope & s) : f(fn), scope(s) {}
+	ex operator()(const ex & e)
+	{
+		if (!memo_scope::shared(e))
+			return f(e);
+		if (const ex * r = scope.lookup(e))
+			return *r;
+		ex result = f(e);
+		scope.remember(e, result);
+		return result;
+	}
+private:
+	map_function & f;
+	memo_scope & scope;
+};
+
+/** A slice of the operands of parallel_map(), and their images. */
+struct map_job {
+	map_function * f;
+	exvector operands;
+	exvector images;
+	bool failed;
+};
+
+void * run_map_job(void * arg)
+{
+	map_job & job = *static_cast<map_job *>(arg);
+	try {
+		job.images.reserve(job.operands.size());
+		for (size_t i = 0; i < job.operands.size(); ++i)
+			job.images.push_back((*job.f)(job.operands[i]));
+	} catch (...) {
+		job.failed = true;
+		job.images.clear();
+	}
+	return 0;
+}
+
+/** Map function which returns the images computed beforehand for the
+ *  operands, in the order map() asks for them. */
+class precomputed_map_function : public map_function {
+public:
+	precomputed_map_function(map_function & fn, const exvector & ops, const exvector & imgs)
+	 : f(fn), operands(ops), images(imgs), next(0) {}
+	ex operator()(const ex & e)
+	{
+		if (next < operands.size() && (are_ex_trivially_equal(e, operands[next]) || e.is_equal(operands[next])))
+			return images[next++];
+		return f(e);
+	}
+private:
+	map_function & f;
+	const exvector & operands;
+	const exvector & images;
+	size_t next;
+};
+
+/** Symbol mask of the keys of m, if they are all symbols, otherwise 0. */
+unsigned symbol_keys_mask(const exmap & m)
+{
+	unsigned mask = 0;
+	for (exmap::const_iterator i = m.begin(); i != m.end(); ++i) {
+		if (!is_a<symbol>(i->first))
+			return 0;
+		mask |= i->first.get_symbol_mask();
+	}
+	return mask;
+}
+
+} // anonymous namespace
+
+/** Apply the map function f to the operands of the expression. If f is
+ *  pure, it is applied only once to each subexpression which occurs
+ *  several times during the call at the top level. */
+ex ex::map(map_function & f) const
+{
+	if (!f.is_pure())
+		return bp->map(f);
+	if (memo_scope * s = memo_scope::find(memo_scope::memo_map, &f, 0)) {
+		memo_map_function memo(f, *s);
+		return bp->map(memo);
+	}
+	memo_scope scope(memo_scope::memo_map, &f, 0);
+	memo_map_function memo(f, scope);
+	return bp->map(memo);
+}
+
+/** Apply the map function f to the operands of the expression like map(),
+ *  but concurrently: the operands are split into slices which are mapped
+ *  as tasks (see run_tasks()), and the result is built from their images
+ *  at once.  f is called by several threads at the same time, so it must
+ *  be thread-safe; the expressions it returns must not share numbers with
+ *  anything but its argument (which is the case for the functions of
+ *  GiNaC).  If f throws, the exception is thrown by the calling thread.
+ *
+ *  The slices are mapped one after the other if GiNaC was built without
+ *  GINAC_THREADSAFE_REFCOUNT and pthreads, or if there are floating point
+ *  numbers among the operands (see copy_numbers()). */
+ex ex::parallel_map(map_function & f) const
+{
+#ifdef PARALLEL_MAP
+	const size_t num = nops();
+	const size_t nslices = std::min<size_t>(num, size_t(get_task_threads()) + 1);
+	if (nslices > 1) {
+		exvector operands;
+		operands.reserve(num);
+		for (size_t i = 0; i < num; ++i)
+			operands.push_back(op(i));
+
+		std::vector<map_job> jobs(nslices);
+		for (size_t k = 0; k < nslices; ++k) {
+			map_job & job = jobs[k];
+			job.f = &f;
+			job.failed = false;
+			const size_t first = num * k / nslices;
+			const size_t last = num * (k + 1) / nslices;
+			job.operands.reserve(last - first);
+			for (size_t i = first; i < last; ++i) {
+				ex operand = operands[i];
+				if (k > 0 && !copy_numbers(operands[i], operand))
+					return map(f);
+				job.operands.push_back(operand);
+			}
+		}
+		run_tasks(run_map_job, jobs);
+
+		exvector images;
+		images.reserve(num);
+		for (size_t k = 0; k < nslices; ++k) {
+			map_job & job = jobs[k];
+			if (job.failed) {
+				// Map again here, so the exception reaches the caller
+				for (size_t i = 0; i < job.operands.size(); ++i)
+					images.push_back(f(job.operands[i]));
+			} else
+				images.insert(images.end(), job.images.begin(), job.images.end());
+		}
+		precomputed_map_function precomputed(f, operands, images);
+		return bp->map(precomputed);
+	}
+#endif
+	return map(f);
+}
+
+/** Substitute objects in an expression (syntactic substitution) and return
+ *  the result as a new expression. The keys of large maps are indexed, so
+ *  that each subexpression is only compared with the keys which could
+ *  match it, and the subexpressions which occur several times are only
+ *  substituted once.  Subexpressions without any of the symbols which are
+ *  the keys are skipped. */
+ex ex::subs(const exmap & m, unsigned options) const
+{
+	memo_scope * s = memo_scope::find(memo_scope::memo_subs, &m, options);
+	if (!s) {
+		// Call at the top level
+		profile_timer timer(profile_subs);
+		const unsigned key_mask = symbol_keys_mask(m);
+		if (key_mask && !(bp->get_symbol_mask() & key_mask))
+			return *this;
+		subs_index_guard guard(m);
+		memo_scope scope(memo_scope::memo_subs, &m, options);
+		scope.key_mask = key_mask;
+		return bp->subs(m, options);
+	}
+	if (s->key_mask && !(bp->get_symbol_mask() & s->key_mask))
+		return *this;
+
+	const bool memo = s->deep || memo_scope::shared(*this);
+	if (memo)
+		if (const ex * r = s->lookup(*this))
+			return *r;
+	if (memo_depth >= memo_depth_limit && bp->nops())
+		return fill_bottom_up(*this, *s, subs_compute(m, options));
+
+	memo_depth_counter depth;
+	ex result = bp->subs(m, options);
+	if (memo)
+		s->remember(*this, result);
+	return result;
+}
+
+/** Compute partial derivative of an expression.  Subexpressions which
+ *  occur several times are only differentiated once during the call at
+ *  the top level.
+ *
+ *  @param s  symbol by which the expression is derived
+ *  @param nth  order of derivative (default 1)
+ *  @return partial derivative as a new expression */
+ex ex::diff(const symbol & s, unsigned nth) const
+{
+	if (!nth)
+		return *this;
+	memo_scope * sc = memo_scope::find(memo_scope::memo_diff, &s, 0);
+	if (!sc) {
+		// Call at the top level
+		memo_scope scope(memo_scope::memo_diff, &s, 0);
+		return bp->diff(s, nth);
+	}
+	if (nth != 1)
+		return bp->diff(s, nth);
+
+	const bool memo = sc->deep || memo_scope::shared(*this);
+	if (memo)
+		if (const ex * r = sc->lookup(*this))
+			return *r;
+	if (memo_depth >= memo_depth_limit && bp->nops())
+		return fill_bottom_up(*this, *sc, diff_compute(s));
+
+	memo_depth_counter depth;
+	ex result = bp->diff(s);
+	if (memo)
+		sc->remember(*this, result);
+	return result;
+}
+
+namespace {
+
+/** expand() below the call at the top level, which owns s. */
+ex expand_with_memo(const ex & e, memo_scope & s, unsigned options)
+{
+	const bool memo = s.deep || memo_scope::shared(e);
+	if (memo)
+		if (const ex * r = s.lookup(e))
+			return *r;
+	if (memo_depth >= memo_depth_limit)
+		return fill_bottom_up(e, s, expand_compute(options));
+
+	memo_depth_counter depth;
+	ex result = ex_to<basic>(e).expand(options);
+	if (memo)
+		s.remember(e, result);
+	return result;
+}
+
+} // anonymous namespace
+
+/** Expand an expression.  Subexpressions which occur several times are
+ *  only expanded once during the call at the top level, which includes
+ *  the arguments of functions under expand_options::expand_function_args.
+ *  Subexpressions nested too deeply are expanded bottom-up first. */
+ex ex::expand(unsigned options) const
+{
+	// Under expand_truncated(), only the terms of sums, products and powers
+	// are terms of the result.  The memos don't know about the bound.
+	if (current_truncation && bp->nops() &&
+	    (memo_depth >= memo_depth_limit ||
+	     !(is_exactly_a<add>(*this) || is_exactly_a<mul>(*this) || is_exactly_a<power>(*this))))
+		return expand_untruncated(*this, options);
+
+	profile_timer timer(profile_expand);
+	if (options == 0 && (bp->flags & status_flags::expanded)) // The "expanded" flag only covers the standard options; someone might want to re-expand with different options
+		return *this;
+	if (!bp->nops() || current_truncation) {
+		memo_depth_counter depth;
+		return bp->expand(options);
+	}
+
+	memo_scope * s = memo_scope::find(memo_scope::memo_expand, &expand_owner, options);
+	if (s)
+		return expand_with_memo(*this, *s, options);
+	// Call at the top level
+	memo_scope scope(memo_scope::memo_expand, &expand_owner, options);
+	return expand_with_memo(*this, scope, options);
+}
+
+/** Test for occurrence of a pattern.  Subexpressions nested too deeply are
+ *  searched bottom-up first. */
+bool ex::has(const ex & pattern, unsigned options) const
+{
+	if (memo_depth < memo_depth_limit || !bp->nops()) {
+		memo_depth_counter depth;
+		return bp->has(pattern, options);
+	}
+
+	memo_scope * s = memo_scope::find(memo_scope::memo_has, &pattern, options);
+	if (s) {
+		if (const ex * r = s->lookup(*this))
+			return !r->is_zero();
+		return !fill_bottom_up(*this, *s, has_compute(pattern, options)).is_zero();
+	}
+	memo_scope scope(memo_scope::memo_has, &pattern, options);
+	return !fill_bottom_up(*this, scope, has_compute(pattern, options)).is_zero();
+}
+
+namespace {
+
+/** Computes the derivatives by several symbols together, going through the
+ *  expression once.  The factors of the product rule are shared by all
+ *  symbols, and the derivatives of shared subexpressions are remembered. */
+class gradient_builder {
+public:
+	gradient_builder(const exvector & s) : syms(s), mask(0)
+	{
+		for (exvector::const_iterator i = syms.begin(); i != syms.end(); ++i)
+			mask |= i->get_symbol_mask();
+	}
+
+	exvector of(const ex & e)
+	{
+		if (!(e.get_symbol_mask() & mask))
+			return exvector(syms.size(), _ex0);
+		if (!memo_scope::shared(e))
+			return compute(e);
+		const basic * key = &ex_to<basic>(e);
+		result_map::const_iterator i = results.find(key);
+		if (i != results.end())
+			return i->second.second;
+		exvector result = compute(e);
+		results.insert(std::make_pair(key, std::make_pair(e, result)));
+		return result;
+	}
+
+private:
+	exvector compute(const ex & e);
+
+	const exvector & syms;
+	unsigned mask;
+	typedef std::map<const basic *, std::pair<ex, exvector> > result_map;
+	result_map results;
+};
+
+exvector gradient_builder::compute(const ex & e)
+{
+	const size_t k = syms.size();
+	exvector result(k, _ex0);
+
+	if (is_a<symbol>(e)) {
+		for (size_t j=0; j<k; ++j)
+			if (e.is_equal(syms[j]))
+				result[j] = _ex1;
+
+	} else if (is_exactly_a<add>(e)) {
+		std::vector<exvector> terms(k);
+		for (size_t i=0; i<e.nops(); ++i) {
+			const exvector g = of(e.op(i));
+			for (size_t j=0; j<k; ++j)
+				if (!g[j].is_zero())
+					terms[j].push_back(g[j]);
+		}
+		for (size_t j=0; j<k; ++j)
+			result[j] = (new add(terms[j]))->setflag(status_flags::dynallocated);
+
+	} else if (is_exactly_a<mul>(e)) {
+		// D(f_0*...*f_n) = sum_i f_0*...*D(f_i)*...*f_n, where the products
+		// of the other factors are built from prefix and suffix products
+		const size_t n = e.nops();
+		std::vector<exvector> g(n);
+		exvector prefix(n + 1), suffix(n + 1);
+		prefix[0] = suffix[n] = _ex1;
+		for (size_t i=0; i<n; ++i) {
+			g[i] = of(e.op(i));
+			prefix[i + 1] = prefix[i] * e.op(i);
+		}
+		for (size_t i=n; i-->0; )
+			suffix[i] = e.op(i) * suffix[i + 1];
+		std::vector<exvector> terms(k);
+		for (size_t i=0; i<n; ++i) {
+			ex others;
+			bool have_others = false;
+			for (size_t j=0; j<k; ++j) {
+				if (g[i][j].is_zero())
+					continue;
+				if (!have_others) {
+					others = prefix[i] * suffix[i + 1];
+					have_others = true;
+				}
+				terms[j].push_back(others * g[i][j]);
+			}
+		}
+		for (size_t j=0; j<k; ++j)
+			result[j] = (new add(terms[j]))->setflag(status_flags::dynallocated);
+
+	} else if (is_exactly_a<power>(e)) {
+		const ex & b = e.op(0);
+		const ex & r = e.op(1);
+		const exvector gb = of(b);
+		if (is_a<numeric>(r)) {
+			// D(b^r) = r * b^(r-1) * D(b)
+			const ex factor = r * pow(b, r - 1);
+			for (size_t j=0; j<k; ++j)
+				if (!gb[j].is_zero())
+					result[j] = factor * gb[j];
+		} else {
+			// D(b^r) = b^r * (D(r)*log(b) + r*D(b)/b)
+			const exvector gr = of(r);
+			for (size_t j=0; j<k; ++j)
+				if (!gb[j].is_zero() || !gr[j].is_zero())
+					result[j] = e * (gr[j] * log(b) + r * gb[j] / b);
+		}
+
+	} else {
+		for (size_t j=0; j<k; ++j)
+			result[j] = e.diff(ex_to<symbol>(syms[j]));
+	}
+
+	return result;
+}
+
+} // anonymous namespace
+
+/** Number of different objects in the expression and the memory they use.
+ *  To count several expressions together, use memory_statistics::add().
+ *
+ *  @see basic::footprint() */
+memory_statistics ex::memory_usage() const
+{
+	memory_statistics s;
+	s.add(*this);
+	return s;
+}
+
+void memory_statistics::add(const ex & e)
+{
+	// Walk the expression with an explicit stack, so that deeply nested
+	// expressions don't overflow the call stack
+	exvector stack(1, e);
+	while (!stack.empty()) {
+		const ex x = stack.back();
+		stack.pop_back();
+		const basic & b = ex_to<basic>(x);
+		if (!counted.insert(std::make_pair(&b, x)).second)
+			continue;
+		const std::size_t size = b.footprint();
+		++total.nodes;
+		total.bytes += size;
+		totals & t = classes[b.class_name()];
+		++t.nodes;
+		t.bytes += size;
+		b.stored_operands(stack);
+	}
+}
+
+namespace {
+
+/** The copies of the objects of an expression made by
+ *  share_common_subexpressions(), by the address of the original.  The
+ *  originals are held as well, so that their addresses stay unique while
+ *  is_equal() shares their operands with other objects. */
+typedef std::map<const basic *, std::pair<ex, ex> > shared_copy_map;
+
+/** Replaces the operands of an object by their copies.  Operands which
+ *  aren't stored (or have been exchanged for equal ones by is_equal() in
+ *  the meantime) are left alone. */
+struct replace_by_shared_copy : public map_function {
+	const shared_copy_map & copies;
+	replace_by_shared_copy(const shared_copy_map & c) : copies(c) {}
+	ex operator()(const ex & e)
+	{
+		shared_copy_map::const_iterator i = copies.find(&ex_to<basic>(e));
+		return i == copies.end() ? e : i->second.second;
+	}
+};
+
+/** Rebuild e from the copies of its operands. */
+ex rebuild_with_shared_operands(const ex & e, const shared_copy_map & copies)
+{
+	// The operands of sums and products are not their stored terms, so
+	// they are rebuilt from these
+	if (is_exactly_a<add>(e) || is_exactly_a<mul>(e)) {
+		exvector ops;
+		ex_to<basic>(e).stored_operands(ops);
+		bool changed = false;
+		replace_by_shared_copy f(copies);
+		for (exvector::iterator i = ops.begin(); i != ops.end(); ++i) {
+			const ex copy = f(*i);
+			if (!are_ex_trivially_equal(copy, *i)) {
+				*i = copy;
+				changed = true;
+			}
+		}
+		if (!changed)
+			return e;
+		std::auto_ptr<epvector> vp(new epvector);
+		vp->reserve(ops.size() / 2);
+		for (std::size_t k = 0; k + 1 < ops.size(); k += 2)
+			vp->push_back(expair(ops[k], ops[k + 1]));
+		if (is_exactly_a<add>(e))
+			return (new add(vp, ops.back()))->setflag(status_flags::dynallocated);
+		return (new mul(vp, ops.back()))->setflag(status_flags::dynallocated);
+	}
+
+	// Neither are those of power series, which are kept as they are
+	if (is_exactly_a<pseries>(e))
+		return e;
+
+	replace_by_shared_copy f(copies);
+	return e.map(f);
+}
+
+} // anonymous namespace
+
+/** Rebuild the expression so that equal subexpressions are stored only
+ *  once.  Subexpressions are shared as far as possible by ex::compare() and
+ *  by hash-consing (see set_hash_consing()), but identical subtrees made
+ *  independently, for instance by subs(), expand() or unarchiving, are
+ *  usually separate copies.  This pass looks up every subexpression in a
+ *  table, bottom up, and replaces it by the first equal one found.
+ *
+ *  @param bytes_saved  if not null, receives the difference of the
+ *                      memory used by the expression and the result, see
+ *                      memory_usage()
+ *  @return an expression equal to this one */
+ex ex::share_common_subexpressions(std::size_t * bytes_saved) const
+{
+	const std::size_t bytes_before = bytes_saved ? memory_usage().total.bytes : 0;
+
+	const basic * root = &ex_to<basic>(*this);
+	shared_copy_map copies;
+	exhashmap<ex> unique;
+
+	// Post-order walk with an explicit stack, where the flag of an entry
+	// tells whether its operands have been pushed
+	std::vector<std::pair<ex, bool> > stack(1, std::make_pair(*this, false));
+	while (!stack.empty()) {
+		const ex x = stack.back().first;
+		const basic * b = &ex_to<basic>(x);
+		if (copies.find(b) != copies.end()) {
+			stack.pop_back();
+			continue;
+		}
+		if (!stack.back().second) {
+			stack.back().second = true;
+			exvector ops;
+			b->stored_operands(ops);
+			for (exvector::const_iterator i = ops.begin(); i != ops.end(); ++i)
+				stack.push_back(std::make_pair(*i, false));
+			continue;
+		}
+		stack.pop_back();
+
+		ex copy = rebuild_with_shared_operands(x, copies);
+		if (!(copy.bp->flags & status_flags::not_shareable)) {
+			std::pair<exhashmap<ex>::iterator, bool> found = unique.insert(std::make_pair(copy, copy));
+			if (!found.second)
+				copy = found.first->second;
+		}
+		copies.insert(std::make_pair(b, std::make_pair(x, copy)));
+	}
+	const ex result = copies.find(root)->second.second;
+
+	if (bytes_saved) {
+		const std::size_t bytes_after = result.memory_usage().total.bytes;
+		*bytes_saved = bytes_before > bytes_after ? bytes_before - bytes_after : 0;
+	}
+	return result;
+}
+
+/** Compute the partial derivatives of an expression by all the symbols in
+ *  l in one pass, which is faster than calling diff() for each of them.
+ *
+ *  @param l  list of symbols
+ *  @return vector of the derivatives, in the order of l
+ *  @exception invalid_argument (l contains an object which is no symbol) */
+exvector ex::gradient(const lst & l) const
+{
+	exvector syms(l.begin(), l.end());
+	for (exvector::const_iterator i = syms.begin(); i != syms.end(); ++i)
+		if (!is_a<symbol>(*i))
+			throw std::invalid_argument("gradient(): argument must be a list of symbols");
+
+	// Keep the derivatives of shared subexpressions by each symbol, which
+	// diff() computes for the other classes
+	std::vector<memo_scope *> scopes;
+	scopes.reserve(syms.size());
+	try {
+		for (exvector::const_iterator i = syms.begin(); i != syms.end(); ++i)
+			scopes.push_back(new memo_scope(memo_scope::memo_diff, &ex_to<symbol>(*i), 0));
+		exvector result = gradient_builder(syms).of(*this);
+		while (!scopes.empty()) {
+			delete scopes.back();
+			scopes.pop_back();
+		}
+		return result;
+	} catch (...) {
+		while (!scopes.empty()) {
+			delete scopes.back();
+			scopes.pop_back();
+		}
+		throw;
+	}
+}
+
 /** Substitute objects in an expression (syntactic substitution) and return
  *  the result as a new expression. */
 ex ex::subs(const lst & ls, const lst & lr, unsigned options) const
@@ -134,7 +1019,7 @@ ex ex::subs(const lst & ls, const lst & lr, unsigned options) const
 	if (!(options & subs_options::pattern_is_product))
 		options |= subs_options::pattern_is_not_product;
 
-	return bp->subs(m, options);
+	return subs(m, options);
 }
 
 /** Substitute objects in an expression (syntactic substitution) and return
@@ -155,7 +1040,7 @@ ex ex::subs(const ex & e, unsigned options) const
 		else
 			options |= subs_options::pattern_is_not_product;
 
-		return bp->subs(m, options);
+		return subs(m, options);
 
 	} else if (e.info(info_flags::list)) {
 
@@ -177,7 +1062,7 @@ ex ex::subs(const ex & e, unsigned options) const
 		if (!(options & subs_options::pattern_is_product))
 			options |= subs_options::pattern_is_not_product;
 
-		return bp->subs(m, options);
+		return subs(m, options);
 
 	} else
 		throw(std::invalid_argument("ex::subs(ex): argument must be a relation_equal or a list"));
@@ -270,14 +1155,29 @@ bool ex::is_zero_matrix() const
 void ex::makewriteable()
 {
 	GINAC_ASSERT(bp->flags & status_flags::dynallocated);
+	if (bp->flags & status_flags::hash_consed) {
+		// Objects in the hash-consing table must never change, even if
+		// we hold the only reference.
+		basic * copy = bp->duplicate();
+		copy->setflag(status_flags::dynallocated);
+		bp = copy;
+	}
 	bp.makewritable();
 	GINAC_ASSERT(bp->get_refcount() == 1);
+	// The remembered normal form is going to be out of date.
+	if (bp->flags & status_flags::normal_cached)
+		bp->forget_normal_form();
 }
 
 /** Share equal objects between expressions.
  *  @see ex::compare(const ex &) */
 void ex::share(const ex & other) const
 {
+#ifdef GINAC_THREADSAFE_REFCOUNT
+	// Either expression may be an operand of an object which is being read
+	// by another thread at the same time, so it must not be rebound.
+	(void)other;
+#else
 	if ((bp->flags | other.bp->flags) & status_flags::not_shareable)
 		return;
 
@@ -285,6 +1185,20 @@ void ex::share(const ex & other) const
 		bp = other.bp;
 	else
 		other.bp = bp;
+#endif
+}
+
+/** Number of eval_deferral objects of the calling thread. */
+static GINAC_DEFERRAL_THREAD_LOCAL unsigned eval_deferrals = 0;
+
+eval_deferral::eval_deferral()
+{
+	++eval_deferrals;
+}
+
+eval_deferral::~eval_deferral()
+{
+	--eval_deferrals;
 }
 
 /** Helper function for the ex-from-basic constructor. This is where GiNaC's
@@ -292,7 +1206,18 @@ void ex::share(const ex & other) const
  *  @see ex::ex(const basic &) */
 ptr<basic> ex::construct_from_basic(const basic & other)
 {
-	if (!(other.flags & status_flags::evaluated)) {
+	if (!(other.flags & status_flags::evaluated) && eval_deferrals) {
+
+		// Evaluation is deferred, see eval_deferral: just make sure the
+		// object is on the heap. It isn't hash-consed, because it may not
+		// be canonical.
+		if (other.flags & status_flags::dynallocated)
+			return ptr<basic>(const_cast<basic &>(other));
+		basic *bp = other.duplicate();
+		bp->setflag(status_flags::dynallocated);
+		return bp;
+
+	} else if (!(other.flags & status_flags::evaluated)) {
 
 		// The object is not yet evaluated, so call eval() to evaluate
 		// the top level. This will return either
@@ -307,6 +1232,7 @@ ptr<basic> ex::construct_from_basic(const basic & other)
 		// apply eval() once more. The recursion stops when eval() calls
 		// hold() or returns an object that already has its "evaluated"
 		// flag set, such as a symbol or a numeric.
+		profile_timer timer(profile_eval);
 		const ex & tmpex = other.eval(1);
 
 		// Eventually, the eval() recursion goes through the "else" branch
@@ -325,6 +1251,8 @@ ptr<basic> ex::construct_from_basic(const basic & other)
 		// We can't return a basic& here because the tmpex is destroyed as
 		// soon as we leave the function, which would deallocate the
 		// evaluated object.
+		if (get_hash_consing())
+			return basic::hash_cons(tmpex.bp);
 		return tmpex.bp;
 
 	} else {
@@ -343,6 +1271,8 @@ ptr<basic> ex::construct_from_basic(const basic & other)
 			basic *bp = other.duplicate();
 			bp->setflag(status_flags::dynallocated);
 			GINAC_ASSERT(bp->get_refcount() == 0);
+			if (get_hash_consing())
+				return basic::hash_cons(bp);
 			return bp;
 		}
 	}
@@ -350,200 +1280,50 @@ ptr<basic> ex::construct_from_basic(const basic & other)
 
 basic & ex::construct_from_int(int i)
 {
-	switch (i) {  // prefer flyweights over new objects
-	case -12:
-		return *const_cast<numeric *>(_num_12_p);
-	case -11:
-		return *const_cast<numeric *>(_num_11_p);
-	case -10:
-		return *const_cast<numeric *>(_num_10_p);
-	case -9:
-		return *const_cast<numeric *>(_num_9_p);
-	case -8:
-		return *const_cast<numeric *>(_num_8_p);
-	case -7:
-		return *const_cast<numeric *>(_num_7_p);
-	case -6:
-		return *const_cast<numeric *>(_num_6_p);
-	case -5:
-		return *const_cast<numeric *>(_num_5_p);
-	case -4:
-		return *const_cast<numeric *>(_num_4_p);
-	case -3:
-		return *const_cast<numeric *>(_num_3_p);
-	case -2:
-		return *const_cast<numeric *>(_num_2_p);
-	case -1:
-		return *const_cast<numeric *>(_num_1_p);
-	case 0:
-		return *const_cast<numeric *>(_num0_p);
-	case 1:
-		return *const_cast<numeric *>(_num1_p);
-	case 2:
-		return *const_cast<numeric *>(_num2_p);
-	case 3:
-		return *const_cast<numeric *>(_num3_p);
-	case 4:
-		return *const_cast<numeric *>(_num4_p);
-	case 5:
-		return *const_cast<numeric *>(_num5_p);
-	case 6:
-		return *const_cast<numeric *>(_num6_p);
-	case 7:
-		return *const_cast<numeric *>(_num7_p);
-	case 8:
-		return *const_cast<numeric *>(_num8_p);
-	case 9:
-		return *const_cast<numeric *>(_num9_p);
-	case 10:
-		return *const_cast<numeric *>(_num10_p);
-	case 11:
-		return *const_cast<numeric *>(_num11_p);
-	case 12:
-		return *const_cast<numeric *>(_num12_p);
-	default:
-		basic *bp = new numeric(i);
-		bp->setflag(status_flags::dynallocated);
-		GINAC_ASSERT(bp->get_refcount() == 0);
-		return *bp;
-	}
+	// prefer preallocated objects over new ones
+	const numeric * n = small_integer_p(i);
+	if (n)
+		return *const_cast<numeric *>(n);
+	basic *bp = new numeric(i);
+	bp->setflag(status_flags::dynallocated);
+	GINAC_ASSERT(bp->get_refcount() == 0);
+	return *bp;
 }
 	
 basic & ex::construct_from_uint(unsigned int i)
 {
-	switch (i) {  // prefer flyweights over new objects
-	case 0:
-		return *const_cast<numeric *>(_num0_p);
-	case 1:
-		return *const_cast<numeric *>(_num1_p);
-	case 2:
-		return *const_cast<numeric *>(_num2_p);
-	case 3:
-		return *const_cast<numeric *>(_num3_p);
-	case 4:
-		return *const_cast<numeric *>(_num4_p);
-	case 5:
-		return *const_cast<numeric *>(_num5_p);
-	case 6:
-		return *const_cast<numeric *>(_num6_p);
-	case 7:
-		return *const_cast<numeric *>(_num7_p);
-	case 8:
-		return *const_cast<numeric *>(_num8_p);
-	case 9:
-		return *const_cast<numeric *>(_num9_p);
-	case 10:
-		return *const_cast<numeric *>(_num10_p);
-	case 11:
-		return *const_cast<numeric *>(_num11_p);
-	case 12:
-		return *const_cast<numeric *>(_num12_p);
-	default:
-		basic *bp = new numeric(i);
-		bp->setflag(status_flags::dynallocated);
-		GINAC_ASSERT(bp->get_refcount() == 0);
-		return *bp;
-	}
+	// prefer preallocated objects over new ones
+	if (i <= static_cast<unsigned long>(small_integer_bound))
+		return *const_cast<numeric *>(small_integer_p(static_cast<long>(i)));
+	basic *bp = new numeric(i);
+	bp->setflag(status_flags::dynallocated);
+	GINAC_ASSERT(bp->get_refcount() == 0);
+	return *bp;
 }
 	
 basic & ex::construct_from_long(long i)
 {
-	switch (i) {  // prefer flyweights over new objects
-	case -12:
-		return *const_cast<numeric *>(_num_12_p);
-	case -11:
-		return *const_cast<numeric *>(_num_11_p);
-	case -10:
-		return *const_cast<numeric *>(_num_10_p);
-	case -9:
-		return *const_cast<numeric *>(_num_9_p);
-	case -8:
-		return *const_cast<numeric *>(_num_8_p);
-	case -7:
-		return *const_cast<numeric *>(_num_7_p);
-	case -6:
-		return *const_cast<numeric *>(_num_6_p);
-	case -5:
-		return *const_cast<numeric *>(_num_5_p);
-	case -4:
-		return *const_cast<numeric *>(_num_4_p);
-	case -3:
-		return *const_cast<numeric *>(_num_3_p);
-	case -2:
-		return *const_cast<numeric *>(_num_2_p);
-	case -1:
-		return *const_cast<numeric *>(_num_1_p);
-	case 0:
-		return *const_cast<numeric *>(_num0_p);
-	case 1:
-		return *const_cast<numeric *>(_num1_p);
-	case 2:
-		return *const_cast<numeric *>(_num2_p);
-	case 3:
-		return *const_cast<numeric *>(_num3_p);
-	case 4:
-		return *const_cast<numeric *>(_num4_p);
-	case 5:
-		return *const_cast<numeric *>(_num5_p);
-	case 6:
-		return *const_cast<numeric *>(_num6_p);
-	case 7:
-		return *const_cast<numeric *>(_num7_p);
-	case 8:
-		return *const_cast<numeric *>(_num8_p);
-	case 9:
-		return *const_cast<numeric *>(_num9_p);
-	case 10:
-		return *const_cast<numeric *>(_num10_p);
-	case 11:
-		return *const_cast<numeric *>(_num11_p);
-	case 12:
-		return *const_cast<numeric *>(_num12_p);
-	default:
-		basic *bp = new numeric(i);
-		bp->setflag(status_flags::dynallocated);
-		GINAC_ASSERT(bp->get_refcount() == 0);
-		return *bp;
-	}
+	// prefer preallocated objects over new ones
+	const numeric * n = small_integer_p(i);
+	if (n)
+		return *const_cast<numeric *>(n);
+	basic *bp = new numeric(i);
+	bp->setflag(status_flags::dynallocated);
+	GINAC_ASSERT(bp->get_refcount() == 0);
+	return *bp;
 }
 	
 basic & ex::construct_from_ulong(unsigned long i)
 {
-	switch (i) {  // prefer flyweights over new objects
-	case 0:
-		return *const_cast<numeric *>(_num0_p);
-	case 1:
-		return *const_cast<numeric *>(_num1_p);
-	case 2:
-		return *const_cast<numeric *>(_num2_p);
-	case 3:
-		return *const_cast<numeric *>(_num3_p);
-	case 4:
-		return *const_cast<numeric *>(_num4_p);
-	case 5:
-		return *const_cast<numeric *>(_num5_p);
-	case 6:
-		return *const_cast<numeric *>(_num6_p);
-	case 7:
-		return *const_cast<numeric *>(_num7_p);
-	case 8:
-		return *const_cast<numeric *>(_num8_p);
-	case 9:
-		return *const_cast<numeric *>(_num9_p);
-	case 10:
-		return *const_cast<numeric *>(_num10_p);
-	case 11:
-		return *const_cast<numeric *>(_num11_p);
-	case 12:
-		return *const_cast<numeric *>(_num12_p);
-	default:
-		basic *bp = new numeric(i);
-		bp->setflag(status_flags::dynallocated);
-		GINAC_ASSERT(bp->get_refcount() == 0);
-		return *bp;
-	}
+	// prefer preallocated objects over new ones
+	if (i <= static_cast<unsigned long>(small_integer_bound))
+		return *const_cast<numeric *>(small_integer_p(static_cast<long>(i)));
+	basic *bp = new numeric(i);
+	bp->setflag(status_flags::dynallocated);
+	GINAC_ASSERT(bp->get_refcount() == 0);
+	return *bp;
 }
-	
+
 basic & ex::construct_from_double(double d)
 {
 	basic *bp = new numeric(d);
@@ -29,7 +29,9 @@
 #include <functional>
 #include <iosfwd>
 #include <iterator>
+#include <map>
 #include <stack>
+#include <string>
 
 namespace GiNaC {
 #ifdef _MSC_VER
@@ -61,6 +63,7 @@ class scalar_products;
 class const_iterator;
 class const_preorder_iterator;
 class const_postorder_iterator;
+struct memory_statistics;
 
 
 /** Lightweight wrapper for GiNaC's symbolic objects.  It holds a pointer to
@@ -116,6 +119,8 @@ public:
 	// evaluation
 	ex eval(int level = 0) const { return bp->eval(level); }
 	ex evalf(int level = 0) const { return bp->evalf(level); }
+	std::complex<double> evalf_double(const evalf_double_map & values) const { return bp->evalf_double(values); }
+	std::complex<double> evalf_double() const;
 	ex evalm() const { return bp->evalm(); }
 	ex eval_ncmul(const exvector & v) const { return bp->eval_ncmul(v); }
 	ex eval_integ() const { return bp->eval_integ(); }
@@ -145,7 +150,7 @@ public:
 	ex imag_part() const { return bp->imag_part(); }
 
 	// pattern matching
-	bool has(const ex & pattern, unsigned options = 0) const { return bp->has(pattern, options); }
+	bool has(const ex & pattern, unsigned options = 0) const;
 	bool find(const ex & pattern, exset& found) const;
 	bool match(const ex & pattern) const;
 	bool match(const ex & pattern, exmap & repls) const { return bp->match(pattern, repls); }
@@ -156,8 +161,10 @@ public:
 	ex subs(const ex & e, unsigned options = 0) const;
 
 	// function mapping
-	ex map(map_function & f) const { return bp->map(f); }
+	ex map(map_function & f) const;
 	ex map(ex (*f)(const ex & e)) const;
+	ex parallel_map(map_function & f) const;
+	ex parallel_map(ex (*f)(const ex & e)) const;
 
 	// visitors and tree traversal
 	void accept(visitor & v) const { bp->accept(v); }
@@ -179,6 +186,7 @@ public:
 
 	// differentiation and series expansion
 	ex diff(const symbol & s, unsigned nth = 1) const;
+	exvector gradient(const lst & l) const;
 	ex series(const ex & r, int order, unsigned options = 0) const;
 
 	// rational functions
@@ -230,6 +238,11 @@ public:
 	return_type_t return_type_tinfo() const { return bp->return_type_tinfo(); }
 
 	unsigned gethash() const { return bp->gethash(); }
+	unsigned get_symbol_mask() const { return bp->get_symbol_mask(); }
+
+	// memory use
+	memory_statistics memory_usage() const;
+	ex share_common_subexpressions(std::size_t * bytes_saved = 0) const;
 
 private:
 	static ptr<basic> construct_from_basic(const basic & other);
@@ -676,6 +689,11 @@ struct ex_is_less : public std::binary_function<ex, ex, bool> {
 	bool operator() (const ex &lh, const ex &rh) const { return lh.compare(rh) < 0; }
 };
 
+inline std::complex<double> ex::evalf_double() const
+{
+	return bp->evalf_double(evalf_double_map());
+}
+
 struct ex_is_equal : public std::binary_function<ex, ex, bool> {
 	bool operator() (const ex &lh, const ex &rh) const { return lh.is_equal(rh); }
 };
@@ -688,6 +706,51 @@ struct ex_swap : public std::binary_function<ex, ex, void> {
 	void operator() (ex &lh, ex &rh) const { lh.swap(rh); }
 };
 
+/** Memory used by expressions, where objects which are shared by several
+ *  subexpressions or expressions are counted only once.
+ *
+ *  @see ex::memory_usage() */
+struct memory_statistics {
+	struct totals {
+		totals() : nodes(0), bytes(0) {}
+		std::size_t nodes; /**< number of different objects */
+		std::size_t bytes; /**< sum of their footprints, see basic::footprint() */
+	};
+
+	/** Count the objects of e which have not been counted before. */
+	void add(const ex & e);
+
+	totals total;                          /**< all objects counted */
+	std::map<std::string, totals> classes; /**< objects counted by class name */
+private:
+	/** The objects counted, held so that their addresses stay unique. */
+	std::map<const basic *, ex> counted;
+};
+
+/** While an object of this class exists, the objects which the calling
+ *  thread turns into expressions are not evaluated, so that large trees can
+ *  be built bottom-up without evaluating every intermediate node.  The
+ *  expressions built are not canonical and must only be combined into
+ *  larger ones, not otherwise computed with.  After the object is gone,
+ *  eval() evaluates each of them completely, top-down, in one pass:
+ *
+ *      ex e;
+ *      {
+ *          eval_deferral defer;
+ *          e = build_large_tree();
+ *      }
+ *      e = e.eval();
+ *
+ *  Deferrals may be nested; evaluation resumes when the outermost ends. */
+class eval_deferral {
+public:
+	eval_deferral();
+	~eval_deferral();
+private:
+	eval_deferral(const eval_deferral &);
+	eval_deferral & operator=(const eval_deferral &);
+};
+
 // Make it possible to print exvectors and exmaps
 std::ostream & operator<<(std::ostream & os, const exvector & e);
 std::ostream & operator<<(std::ostream & os, const exset & e);
@@ -700,6 +763,16 @@ inline size_t nops(const ex & thisex)
 inline ex expand(const ex & thisex, unsigned options = 0)
 { return thisex.expand(options); }
 
+/** Expand e, leaving out the terms of total degree in syms (a symbol or a
+ *  list of symbols) above max_degree. */
+ex expand_truncated(const ex & e, const ex & syms, int max_degree, unsigned options = 0);
+
+/** Expand e with the coefficients reduced modulo the odd prime p < 2^31. */
+ex expand_modular(const ex & e, long p);
+
+inline ex share_common_subexpressions(const ex & thisex, std::size_t * bytes_saved = 0)
+{ return thisex.share_common_subexpressions(bytes_saved); }
+
 inline ex conjugate(const ex & thisex)
 { return thisex.conjugate(); }
 
@@ -760,6 +833,9 @@ inline ex eval(const ex & thisex, int level = 0)
 inline ex evalf(const ex & thisex, int level = 0)
 { return thisex.evalf(level); }
 
+inline std::complex<double> evalf_double(const ex & thisex, const evalf_double_map & values = evalf_double_map())
+{ return thisex.evalf_double(values); }
+
 inline ex evalm(const ex & thisex)
 { return thisex.evalm(); }
 
@@ -769,6 +845,9 @@ inline ex eval_integ(const ex & thisex)
 inline ex diff(const ex & thisex, const symbol & s, unsigned nth = 1)
 { return thisex.diff(s, nth); }
 
+inline exvector gradient(const ex & thisex, const lst & l)
+{ return thisex.gradient(l); }
+
 inline ex series(const ex & thisex, const ex & r, int order, unsigned options = 0)
 { return thisex.series(r, order, options); }
 
@@ -814,11 +893,6 @@ inline bool is_zero(const ex & thisex)
 inline void swap(ex & e1, ex & e2)
 { e1.swap(e2); }
 
-inline ex ex::subs(const exmap & m, unsigned options) const
-{
-	return bp->subs(m, options);
-}
-
 inline ex subs(const ex & thisex, const exmap & m, unsigned options = 0)
 { return thisex.subs(m, options); }
 
@@ -923,6 +997,12 @@ inline ex ex::map(ex f(const ex &)) const
 	return bp->map(fcn);
 }
 
+inline ex ex::parallel_map(ex f(const ex &)) const
+{
+	pointer_to_map_function fcn(f);
+	return parallel_map(fcn);
+}
+
 // convenience type checker template functions
 
 /** Check if ex is a handle to a T, including base classes. */
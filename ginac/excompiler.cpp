@@ -29,26 +29,1168 @@
 #include "config.h"
 #endif
 
+#include "add.h"
+#include "constant.h"
 #include "ex.h"
+#include "function.h"
 #include "lst.h"
+#include "mul.h"
+#include "numeric.h"
 #include "operators.h"
+#include "power.h"
 #include "relational.h"
 #include "symbol.h"
+#include "tasks.h"
+#include "utils.h"
+#include "version.h"
 
 #ifdef HAVE_LIBDL
 #include <dlfcn.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#ifdef HAVE_PTHREAD_H
+// The translation units of large batches are compiled concurrently.
+#define PARALLEL_EXCOMPILER 1
+#endif
 #endif // def HAVE_LIBDL
+#if defined(__x86_64__) && (defined(__linux__) || defined(__FreeBSD__) || defined(__APPLE__))
+#define EXCOMPILER_JIT 1
+#include <sys/mman.h>
+#ifndef MAP_ANONYMOUS
+#define MAP_ANONYMOUS MAP_ANON
+#endif
+#endif
+#include <algorithm>
+#include <cmath>
 #include <fstream>
 #include <ios>
+#include <map>
+#include <set>
 #include <sstream>
 #include <stdexcept>
+#include <stdint.h>
 #include <string>
 #include <vector>
 
 namespace GiNaC {
 
+//////////
+// In-memory compilation
+//////////
+
+static compile_ex_backend compile_ex_mode = compile_ex_jit;
+
+/**
+ * Selects how compile_ex() compiles expressions. If a filename is passed to
+ * compile_ex() or the JIT can not handle an expression, the external compiler
+ * is used anyway.
+ *
+ * @return previous setting
+ */
+compile_ex_backend set_compile_ex_backend(compile_ex_backend b)
+{
+	const compile_ex_backend previous = compile_ex_mode;
+	compile_ex_mode = b;
+	return previous;
+}
+
+compile_ex_backend get_compile_ex_backend()
+{
+	return compile_ex_mode;
+}
+
+namespace {
+
+typedef double (*jit_fn1)(double);
+typedef double (*jit_fn2)(double, double);
+
+/**
+ * Returns the function of the C library computing the GiNaC function of one
+ * argument with the given name, or NULL.
+ */
+jit_fn1 libm_function(const std::string& name)
+{
+	static const struct { const char* name; jit_fn1 fn; } table[] = {
+		{ "exp", ::exp }, { "log", ::log }, { "abs", ::fabs },
+		{ "sin", ::sin }, { "cos", ::cos }, { "tan", ::tan },
+		{ "asin", ::asin }, { "acos", ::acos }, { "atan", ::atan },
+		{ "sinh", ::sinh }, { "cosh", ::cosh }, { "tanh", ::tanh },
+		{ "asinh", ::asinh }, { "acosh", ::acosh }, { "atanh", ::atanh },
+		{ "tgamma", ::tgamma }, { "lgamma", ::lgamma }
+	};
+	for (std::size_t i = 0; i < sizeof(table)/sizeof(table[0]); ++i) {
+		if (name == table[i].name) {
+			return table[i].fn;
+		}
+	}
+	return 0;
+}
+
+/**
+ * Instruction of the stack machine an expression is translated to before
+ * machine code is emitted for it.
+ */
+struct jit_op
+{
+	enum kind_t { constant, argument, add, mul, powi, call1, call2 } kind;
+	double value; /**< constant */
+	long index; /**< argument index or integer exponent */
+	jit_fn1 fn1;
+	jit_fn2 fn2;
+};
+
+/**
+ * Translates expressions into stack machine code. Expressions that can not
+ * be evaluated in double precision by the C library make it throw.
+ */
+class jit_program
+{
+public:
+	std::vector<jit_op> ops;
+	std::size_t max_depth;
+
+	jit_program(const exvector& a) : max_depth(0), args(a), depth(0) {}
+
+	/**
+	 * Appends the code computing e, whose value ends up on top of the stack.
+	 */
+	void compile(const ex& e)
+	{
+		if (is_exactly_a<numeric>(e)) {
+			const numeric& n = ex_to<numeric>(e);
+			if (!n.is_real()) {
+				throw std::invalid_argument("jit_program: complex number");
+			}
+			push_constant(n.to_double());
+		} else if (is_a<symbol>(e)) {
+			for (std::size_t i = 0; i < args.size(); ++i) {
+				if (e.is_equal(args[i])) {
+					jit_op op = make_op(jit_op::argument);
+					op.index = i;
+					push(op, 1);
+					return;
+				}
+			}
+			throw std::invalid_argument("jit_program: free symbol");
+		} else if (is_a<constant>(e)) {
+			compile(e.evalf());
+		} else if (is_exactly_a<add>(e) || is_exactly_a<mul>(e)) {
+			const jit_op::kind_t kind = is_exactly_a<add>(e) ? jit_op::add : jit_op::mul;
+			compile(e.op(0));
+			for (std::size_t i = 1; i < e.nops(); ++i) {
+				compile(e.op(i));
+				push(make_op(kind), -1);
+			}
+		} else if (is_exactly_a<power>(e)) {
+			const ex& expo = e.op(1);
+			compile(e.op(0));
+			if (expo.info(info_flags::integer) && abs(ex_to<numeric>(expo)) < numeric(1L << 30)) {
+				jit_op op = make_op(jit_op::powi);
+				op.index = ex_to<numeric>(expo).to_long();
+				push(op, 0);
+			} else if (expo.is_equal(_ex1_2)) {
+				jit_op op = make_op(jit_op::call1);
+				op.fn1 = ::sqrt;
+				push(op, 0);
+			} else {
+				compile(expo);
+				jit_op op = make_op(jit_op::call2);
+				op.fn2 = ::pow;
+				push(op, -1);
+			}
+		} else if (is_a<function>(e)) {
+			const std::string name = ex_to<function>(e).get_name();
+			jit_op op = make_op(jit_op::call1);
+			if (e.nops() == 1 && (op.fn1 = libm_function(name))) {
+				compile(e.op(0));
+				push(op, 0);
+			} else if (e.nops() == 2 && name == "atan2") {
+				op = make_op(jit_op::call2);
+				op.fn2 = ::atan2;
+				compile(e.op(0));
+				compile(e.op(1));
+				push(op, -1);
+			} else {
+				throw std::invalid_argument("jit_program: unsupported function " + name);
+			}
+		} else {
+			throw std::invalid_argument("jit_program: unsupported expression");
+		}
+	}
+
+private:
+	exvector args;
+	std::size_t depth;
+
+	static jit_op make_op(jit_op::kind_t kind)
+	{
+		jit_op op;
+		op.kind = kind;
+		op.value = 0;
+		op.index = 0;
+		op.fn1 = 0;
+		op.fn2 = 0;
+		return op;
+	}
+
+	void push(const jit_op& op, int growth)
+	{
+		ops.push_back(op);
+		depth += growth;
+		if (depth > max_depth) {
+			max_depth = depth;
+		}
+	}
+
+	void push_constant(double value)
+	{
+		jit_op op = make_op(jit_op::constant);
+		op.value = value;
+		push(op, 1);
+	}
+};
+
+#ifdef EXCOMPILER_JIT
+
+/**
+ * Emits x86-64 machine code (System V calling convention, SSE2) for stack
+ * machine programs. The stack lives in the frame of the generated function,
+ * slot k at [rsp+8*k].
+ */
+class jit_emitter
+{
+public:
+	std::vector<unsigned char> code;
+
+	/**
+	 * Function of nargs doubles returning a double, the arguments are kept in
+	 * the slots following the stack.
+	 */
+	void scalar_function(const jit_program& prog, std::size_t nargs)
+	{
+		const std::size_t frame = frame_size(prog.max_depth + nargs);
+		emit(0x48); emit(0x81); emit(0xEC); emit32(frame);  // sub rsp, frame
+		arg_base = prog.max_depth;
+		for (std::size_t i = 0; i < nargs; ++i) {
+			store_xmm(i, arg_base + i);
+		}
+		program(prog, false);
+		load_xmm(0, 0);
+		emit(0x48); emit(0x81); emit(0xC4); emit32(frame);  // add rsp, frame
+		emit(0xC3);                                         // ret
+	}
+
+	/**
+	 * Function of type FUNCP_CUBA, the arguments are read from a[] through
+	 * rbx, the results are written to f[] through r12.
+	 */
+	void cuba_function(const std::vector<jit_program>& progs)
+	{
+		std::size_t depth = 1;
+		for (std::size_t i = 0; i < progs.size(); ++i) {
+			depth = std::max(depth, progs[i].max_depth);
+		}
+		const std::size_t frame = frame_size(depth);
+		emit(0x53);                                         // push rbx
+		emit(0x41); emit(0x54);                             // push r12
+		emit(0x48); emit(0x89); emit(0xF3);                 // mov rbx, rsi
+		emit(0x49); emit(0x89); emit(0xCC);                 // mov r12, rcx
+		emit(0x48); emit(0x81); emit(0xEC); emit32(frame);  // sub rsp, frame
+		for (std::size_t i = 0; i < progs.size(); ++i) {
+			program(progs[i], true);
+			load_xmm(0, 0);
+			// movsd [r12+8*i], xmm0
+			emit(0xF2); emit(0x41); emit(0x0F); emit(0x11); emit(0x84); emit(0x24); emit32(8*i);
+		}
+		emit(0x48); emit(0x81); emit(0xC4); emit32(frame);  // add rsp, frame
+		emit(0x41); emit(0x5C);                             // pop r12
+		emit(0x5B);                                         // pop rbx
+		emit(0xC3);                                         // ret
+	}
+
+private:
+	std::size_t arg_base;
+
+	void emit(unsigned char c) { code.push_back(c); }
+
+	void emit32(std::size_t v)
+	{
+		for (int i = 0; i < 4; ++i) {
+			emit((v >> (8*i)) & 0xFF);
+		}
+	}
+
+	void emit64(const void* p)
+	{
+		const unsigned char* b = static_cast<const unsigned char*>(p);
+		for (int i = 0; i < 8; ++i) {
+			emit(b[i]);
+		}
+	}
+
+	// keeps rsp 16-byte aligned at calls: it is 8 off on entry and after
+	// the two pushes of cuba_function()
+	static std::size_t frame_size(std::size_t slots)
+	{
+		const std::size_t frame = 8*slots;
+		return frame % 16 ? frame : frame + 8;
+	}
+
+	// movsd xmm{r}, [rsp+8*slot]
+	void load_xmm(int r, std::size_t slot)
+	{
+		emit(0xF2); emit(0x0F); emit(0x10); emit(0x84 | (r << 3)); emit(0x24); emit32(8*slot);
+	}
+
+	// movsd [rsp+8*slot], xmm{r}
+	void store_xmm(int r, std::size_t slot)
+	{
+		emit(0xF2); emit(0x0F); emit(0x11); emit(0x84 | (r << 3)); emit(0x24); emit32(8*slot);
+	}
+
+	// mov rax, imm64
+	void load_rax(const void* p)
+	{
+		emit(0x48); emit(0xB8); emit64(p);
+	}
+
+	// xmm0 = 1.0
+	void load_one()
+	{
+		const double one = 1.0;
+		load_rax(&one);
+		emit(0x66); emit(0x48); emit(0x0F); emit(0x6E); emit(0xC0);  // movq xmm0, rax
+	}
+
+	void call(const void* fn)
+	{
+		load_rax(&fn);
+		emit(0xFF); emit(0xD0);  // call rax
+	}
+
+	void program(const jit_program& prog, bool cuba)
+	{
+		std::size_t depth = 0;
+		for (std::vector<jit_op>::const_iterator it = prog.ops.begin(); it != prog.ops.end(); ++it) {
+			switch (it->kind) {
+			case jit_op::constant:
+				load_rax(&it->value);
+				// mov [rsp+8*depth], rax
+				emit(0x48); emit(0x89); emit(0x84); emit(0x24); emit32(8*depth);
+				++depth;
+				break;
+			case jit_op::argument:
+				if (cuba) {
+					// movsd xmm0, [rbx+8*index]
+					emit(0xF2); emit(0x0F); emit(0x10); emit(0x83); emit32(8*it->index);
+				} else {
+					load_xmm(0, arg_base + it->index);
+				}
+				store_xmm(0, depth);
+				++depth;
+				break;
+			case jit_op::add:
+			case jit_op::mul:
+				load_xmm(0, depth-2);
+				load_xmm(1, depth-1);
+				// addsd/mulsd xmm0, xmm1
+				emit(0xF2); emit(0x0F); emit(it->kind == jit_op::add ? 0x58 : 0x59); emit(0xC1);
+				store_xmm(0, depth-2);
+				--depth;
+				break;
+			case jit_op::powi: {
+				// binary powering, base in xmm1, result in xmm0
+				unsigned long n = it->index < 0 ? -it->index : it->index;
+				load_xmm(1, depth-1);
+				load_one();
+				while (n) {
+					if (n & 1) {
+						emit(0xF2); emit(0x0F); emit(0x59); emit(0xC1);  // mulsd xmm0, xmm1
+					}
+					n >>= 1;
+					if (n) {
+						emit(0xF2); emit(0x0F); emit(0x59); emit(0xC9);  // mulsd xmm1, xmm1
+					}
+				}
+				if (it->index < 0) {
+					emit(0x66); emit(0x0F); emit(0x28); emit(0xC8);  // movapd xmm1, xmm0
+					load_one();
+					emit(0xF2); emit(0x0F); emit(0x5E); emit(0xC1);  // divsd xmm0, xmm1
+				}
+				store_xmm(0, depth-1);
+				break;
+			}
+			case jit_op::call1:
+				load_xmm(0, depth-1);
+				call(reinterpret_cast<const void*>(it->fn1));
+				store_xmm(0, depth-1);
+				break;
+			case jit_op::call2:
+				load_xmm(0, depth-2);
+				load_xmm(1, depth-1);
+				call(reinterpret_cast<const void*>(it->fn2));
+				store_xmm(0, depth-2);
+				--depth;
+				break;
+			}
+		}
+	}
+};
+
+/**
+ * Executable memory holding the generated functions. It is released on
+ * program termination, like the modules of global_excompiler.
+ */
+class jit_memory
+{
+	std::vector<std::pair<void*, std::size_t> > blocks;
+public:
+	~jit_memory()
+	{
+		for (std::size_t i = 0; i < blocks.size(); ++i) {
+			munmap(blocks[i].first, blocks[i].second);
+		}
+	}
+	void* install(const std::vector<unsigned char>& code)
+	{
+		const std::size_t size = code.size();
+		void* p = mmap(0, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+		if (p == MAP_FAILED) {
+			return 0;
+		}
+		std::copy(code.begin(), code.end(), static_cast<unsigned char*>(p));
+		if (mprotect(p, size, PROT_READ | PROT_EXEC)) {
+			munmap(p, size);
+			return 0;
+		}
+		blocks.push_back(std::make_pair(p, size));
+		return p;
+	}
+};
+
+static jit_memory global_jit_memory;
+
+#endif // def EXCOMPILER_JIT
+
+/**
+ * Compiles a function of the given symbols in memory. Returns NULL if the
+ * JIT is not available on this platform, is switched off, or can not handle
+ * the expressions.
+ */
+void* jit_compile(const exvector& exprs, const exvector& syms, bool cuba)
+{
+#ifdef EXCOMPILER_JIT
+	if (compile_ex_mode != compile_ex_jit) {
+		return 0;
+	}
+	std::vector<jit_program> progs;
+	try {
+		for (std::size_t i = 0; i < exprs.size(); ++i) {
+			progs.push_back(jit_program(syms));
+			progs.back().compile(exprs[i]);
+		}
+	} catch (const std::invalid_argument&) {
+		return 0;
+	}
+	jit_emitter em;
+	if (cuba) {
+		em.cuba_function(progs);
+	} else {
+		em.scalar_function(progs[0], syms.size());
+	}
+	return global_jit_memory.install(em.code);
+#else
+	return 0;
+#endif
+}
+
+} // anonymous namespace
+
+//////////
+// Interpreted evaluation
+//////////
+
+/**
+ * Translates the expressions into instructions. Registers 0 to nargs-1 hold
+ * the arguments, constants get registers of their own, loaded here once.
+ */
+bytecode_evaluator::bytecode_evaluator(const lst& exprs, const lst& syms) : nargs(syms.nops())
+{
+	std::map<ex, std::size_t, ex_is_less> reg_of;
+	regs.resize(nargs);
+	for (std::size_t i = 0; i < nargs; ++i) {
+		if (!is_a<symbol>(syms.op(i))) {
+			throw std::invalid_argument("bytecode_evaluator: parameters must be symbols");
+		}
+		reg_of[syms.op(i)] = i;
+	}
+	for (lst::const_iterator it = exprs.begin(); it != exprs.end(); ++it) {
+		outputs.push_back(translate(*it, reg_of));
+	}
+}
+
+/**
+ * Returns the register holding the value of e, appending the instructions
+ * computing it unless it was computed before.
+ */
+std::size_t bytecode_evaluator::translate(const ex& e, std::map<ex, std::size_t, ex_is_less>& reg_of)
+{
+	std::map<ex, std::size_t, ex_is_less>::const_iterator known = reg_of.find(e);
+	if (known != reg_of.end()) {
+		return known->second;
+	}
+
+	instruction in;
+	in.a = in.b = 0;
+	in.n = 0;
+	in.fn1 = 0;
+	in.fn2 = 0;
+	if (is_exactly_a<numeric>(e) || is_a<constant>(e)) {
+		const ex v = e.evalf();
+		if (!is_exactly_a<numeric>(v) || !ex_to<numeric>(v).is_real()) {
+			throw std::invalid_argument("bytecode_evaluator: complex number");
+		}
+		regs.push_back(ex_to<numeric>(v).to_double());
+		return reg_of[e] = regs.size() - 1;
+	} else if (is_a<symbol>(e)) {
+		throw std::invalid_argument("bytecode_evaluator: free symbol");
+	} else if (is_exactly_a<add>(e) || is_exactly_a<mul>(e)) {
+		in.op = is_exactly_a<add>(e) ? instruction::add : instruction::mul;
+		std::size_t acc = translate(e.op(0), reg_of);
+		for (std::size_t i = 1; i < e.nops(); ++i) {
+			in.a = acc;
+			in.b = translate(e.op(i), reg_of);
+			acc = emit(in);
+		}
+		return reg_of[e] = acc;
+	} else if (is_exactly_a<power>(e)) {
+		const ex& expo = e.op(1);
+		in.a = translate(e.op(0), reg_of);
+		if (expo.info(info_flags::integer) && abs(ex_to<numeric>(expo)) < numeric(1L << 30)) {
+			in.op = instruction::powi;
+			in.n = ex_to<numeric>(expo).to_long();
+		} else if (expo.is_equal(_ex1_2)) {
+			in.op = instruction::call1;
+			in.fn1 = ::sqrt;
+		} else {
+			in.op = instruction::call2;
+			in.fn2 = ::pow;
+			in.b = translate(expo, reg_of);
+		}
+	} else if (is_a<function>(e)) {
+		const std::string name = ex_to<function>(e).get_name();
+		if (e.nops() == 1 && (in.fn1 = libm_function(name))) {
+			in.op = instruction::call1;
+			in.a = translate(e.op(0), reg_of);
+		} else if (e.nops() == 2 && name == "atan2") {
+			in.op = instruction::call2;
+			in.fn2 = ::atan2;
+			in.a = translate(e.op(0), reg_of);
+			in.b = translate(e.op(1), reg_of);
+		} else {
+			throw std::invalid_argument("bytecode_evaluator: unsupported function " + name);
+		}
+	} else {
+		throw std::invalid_argument("bytecode_evaluator: unsupported expression");
+	}
+	return reg_of[e] = emit(in);
+}
+
+/**
+ * Appends an instruction writing to a new register.
+ */
+std::size_t bytecode_evaluator::emit(instruction in)
+{
+	in.dst = regs.size();
+	regs.push_back(0);
+	code.push_back(in);
+	return in.dst;
+}
+
+void bytecode_evaluator::evaluate(const double* args, double* results)
+{
+	double* r = regs.empty() ? 0 : &regs[0];
+	std::copy(args, args + nargs, r);
+	for (std::vector<instruction>::const_iterator in = code.begin(); in != code.end(); ++in) {
+		switch (in->op) {
+		case instruction::add:
+			r[in->dst] = r[in->a] + r[in->b];
+			break;
+		case instruction::mul:
+			r[in->dst] = r[in->a] * r[in->b];
+			break;
+		case instruction::powi: {
+			unsigned long n = in->n < 0 ? -in->n : in->n;
+			double x = r[in->a], y = 1;
+			while (n) {
+				if (n & 1) {
+					y *= x;
+				}
+				n >>= 1;
+				x *= x;
+			}
+			r[in->dst] = in->n < 0 ? 1/y : y;
+			break;
+		}
+		case instruction::call1:
+			r[in->dst] = in->fn1(r[in->a]);
+			break;
+		case instruction::call2:
+			r[in->dst] = in->fn2(r[in->a], r[in->b]);
+			break;
+		}
+	}
+	for (std::size_t i = 0; i < outputs.size(); ++i) {
+		results[i] = r[outputs[i]];
+	}
+}
+
+double bytecode_evaluator::operator()(double x)
+{
+	if (nargs != 1 || outputs.size() != 1) {
+		throw std::logic_error("bytecode_evaluator: not a function of one argument");
+	}
+	double result;
+	evaluate(&x, &result);
+	return result;
+}
+
+//////////
+// Common subexpression elimination
+//////////
+
+namespace {
+
+/**
+ * Finds the subexpressions that occur more than once in a set of expressions.
+ * The nodes are looked up by their hash values and kept in the order in
+ * which their evaluation has to be written, operands before their users.
+ */
+class cse_finder
+{
+public:
+	struct node {
+		ex e;
+		std::size_t count;
+	};
+	std::vector<node> nodes;
+	std::size_t ops_before; /**< operations counted with multiplicity */
+	std::size_t ops_after; /**< operations of the distinct nodes */
+
+	cse_finder() : ops_before(0), ops_after(0) {}
+
+	static bool is_operation(const ex& e)
+	{
+		return is_exactly_a<add>(e) || is_exactly_a<mul>(e) || is_exactly_a<power>(e) || is_a<function>(e);
+	}
+
+	/**
+	 * Operations of e itself, integer powers are counted as the
+	 * multiplications (and the division) they are printed as.
+	 */
+	static std::size_t own_ops(const ex& e)
+	{
+		if (is_exactly_a<add>(e) || is_exactly_a<mul>(e)) {
+			return e.nops() - 1;
+		}
+		if (is_exactly_a<power>(e) && e.op(1).info(info_flags::integer)) {
+			const long n = ex_to<numeric>(e.op(1)).to_long();
+			return n > 0 ? n - 1 : -n;
+		}
+		return 1;
+	}
+
+	void visit(const ex& e)
+	{
+		find_shared(e);
+		ops_before += tree_ops(e);
+	}
+
+	/**
+	 * Index of the node equal to e, or nodes.size() if there is none.
+	 */
+	std::size_t find(const ex& e) const
+	{
+		std::map<unsigned, std::vector<std::size_t> >::const_iterator b = buckets.find(e.gethash());
+		if (b != buckets.end()) {
+			for (std::vector<std::size_t>::const_iterator i = b->second.begin(); i != b->second.end(); ++i) {
+				if (nodes[*i].e.is_equal(e)) {
+					return *i;
+				}
+			}
+		}
+		return nodes.size();
+	}
+
+private:
+	std::map<unsigned, std::vector<std::size_t> > buckets;
+	std::vector<std::size_t> node_tree_ops; /**< operations of each node written out as a tree */
+
+
+	/**
+	 * Visits the operands of e before e itself, with an explicit stack so
+	 * that deeply nested expressions can not overflow the call stack.
+	 */
+	void find_shared(const ex& e)
+	{
+		if (!is_operation(e) || seen(e)) {
+			return;
+		}
+		// expressions whose operands are being visited, with the next one
+		std::vector<std::pair<ex, std::size_t> > stack(1, std::make_pair(e, std::size_t(0)));
+		while (!stack.empty()) {
+			const ex top = stack.back().first;
+			const std::size_t k = stack.back().second;
+			if (k < top.nops()) {
+				++stack.back().second;
+				const ex operand = top.op(k);
+				if (is_operation(operand) && !seen(operand)) {
+					stack.push_back(std::make_pair(operand, std::size_t(0)));
+				}
+				continue;
+			}
+			stack.pop_back();
+
+			std::size_t ops = own_ops(top);
+			for (std::size_t k = 0; k < top.nops(); ++k) {
+				ops += tree_ops(top.op(k));
+			}
+			node n;
+			n.e = top;
+			n.count = 1;
+			buckets[top.gethash()].push_back(nodes.size());
+			nodes.push_back(n);
+			node_tree_ops.push_back(ops);
+			ops_after += own_ops(top);
+		}
+	}
+
+	// counts another occurrence of e if it has been visited before
+	bool seen(const ex& e)
+	{
+		const std::size_t i = find(e);
+		if (i == nodes.size()) {
+			return false;
+		}
+		++nodes[i].count;
+		return true;
+	}
+
+	// operations of e written out as a tree, e must have been visited
+	std::size_t tree_ops(const ex& e) const
+	{
+		return is_operation(e) ? node_tree_ops[find(e)] : 0;
+	}
+};
+
+/**
+ * Replaces the subexpressions that have been assigned a temporary by it.
+ */
+struct cse_rewriter : public map_function
+{
+	const exmap& temps;
+	explicit cse_rewriter(const exmap& t) : temps(t) {}
+	ex operator()(const ex& e)
+	{
+		exmap::const_iterator it = temps.find(e);
+		if (it != temps.end()) {
+			return it->second;
+		}
+		return e.map(*this);
+	}
+};
+
+} // anonymous namespace
+
+/**
+ * Rewrites the sums in an expression into multivariate Horner form. The
+ * factor occurring in most terms of a sum is pulled out greedily, then the
+ * same is done for the remaining sums.
+ */
+struct horner_map : public map_function
+{
+	ex operator()(const ex& e)
+	{
+		const ex mapped = e.map(*this);
+		if (!is_exactly_a<add>(mapped)) {
+			return mapped;
+		}
+		return horner_sum(exvector(mapped.begin(), mapped.end()));
+	}
+
+	// the non-numeric factors of a term with their exponents, powers with
+	// other than positive integer exponents are factors of their own
+	static void factors(const ex& term, std::vector<std::pair<ex, long> >& fs)
+	{
+		if (is_exactly_a<mul>(term)) {
+			for (std::size_t i = 0; i < term.nops(); ++i) {
+				factors(term.op(i), fs);
+			}
+		} else if (is_exactly_a<power>(term) && term.op(1).info(info_flags::posint)) {
+			fs.push_back(std::make_pair(term.op(0), ex_to<numeric>(term.op(1)).to_long()));
+		} else if (!is_exactly_a<numeric>(term)) {
+			fs.push_back(std::make_pair(term, 1L));
+		}
+	}
+
+	static ex horner_sum(const exvector& terms)
+	{
+		typedef std::map<ex, std::size_t, ex_is_less> countmap;
+		countmap count;
+		for (exvector::const_iterator t = terms.begin(); t != terms.end(); ++t) {
+			std::vector<std::pair<ex, long> > fs;
+			factors(*t, fs);
+			for (std::size_t i = 0; i < fs.size(); ++i) {
+				++count[fs[i].first];
+			}
+		}
+		countmap::const_iterator best = count.end();
+		for (countmap::const_iterator it = count.begin(); it != count.end(); ++it) {
+			if (best == count.end() || it->second > best->second) {
+				best = it;
+			}
+		}
+		if (best == count.end() || best->second < 2) {
+			return add(terms);
+		}
+
+		// split off the terms containing the factor and divide them by its
+		// lowest power
+		const ex v = best->first;
+		exvector with, without;
+		long k = 0;
+		for (exvector::const_iterator t = terms.begin(); t != terms.end(); ++t) {
+			std::vector<std::pair<ex, long> > fs;
+			factors(*t, fs);
+			long n = 0;
+			for (std::size_t i = 0; i < fs.size(); ++i) {
+				if (fs[i].first.is_equal(v)) {
+					n = fs[i].second;
+				}
+			}
+			if (n == 0) {
+				without.push_back(*t);
+			} else {
+				with.push_back(*t);
+				k = k ? std::min(k, n) : n;
+			}
+		}
+		const ex vk = pow(v, k);
+		for (exvector::iterator t = with.begin(); t != with.end(); ++t) {
+			*t = *t / vk;
+		}
+		const ex factored = vk * horner_sum(with);
+		if (without.empty()) {
+			return factored;
+		}
+		return horner_sum(without) + factored;
+	}
+};
+
+/**
+ * Writes temporaries for the powers of a base with the given exponents,
+ * each computed by one multiplication from lower ones.
+ */
+static void print_power_chain(const ex& base, const std::set<long>& exponents, std::map<long, ex>& chain,
+                              const char* type, std::size_t& temporaries, std::size_t& ops, const print_csrc& c)
+{
+	if (is_a<symbol>(base)) {
+		chain[1] = base;
+	} else {
+		std::ostringstream name;
+		name << "cse" << temporaries++;
+		c.s << type << " " << name.str() << " = ";
+		base.print(c);
+		c.s << ";" << std::endl;
+		chain[1] = symbol(name.str());
+	}
+	for (std::set<long>::const_iterator n = exponents.begin(); n != exponents.end(); ++n) {
+		std::vector<long> todo(1, *n);
+		while (!todo.empty()) {
+			const long m = todo.back();
+			if (chain.count(m)) {
+				todo.pop_back();
+				continue;
+			}
+			// largest power available so far, or half of m
+			long k = (--chain.upper_bound(m))->first;
+			if (2*k < m) {
+				k = m/2;
+			}
+			if (!chain.count(k)) {
+				todo.push_back(k);
+				continue;
+			}
+			if (!chain.count(m-k)) {
+				todo.push_back(m-k);
+				continue;
+			}
+			std::ostringstream name;
+			name << "cse" << temporaries++;
+			c.s << type << " " << name.str() << " = ";
+			c.s << "(";
+			chain[k].print(c);
+			c.s << ")*(";
+			chain[m-k].print(c);
+			c.s << ");" << std::endl;
+			++ops;
+			chain[m] = symbol(name.str());
+			todo.pop_back();
+		}
+	}
+}
+
+/** Expressions are not printed nested deeper than this, see print_csrc_cse(). */
+static const std::size_t max_csrc_depth = 100;
+
+/** Sums with more terms are printed as several partial sums. */
+static const std::size_t max_csrc_sum_terms = 500;
+
+/**
+ * Prints C code that assigns the expressions exprs to lhs. Subexpressions
+ * occurring more than once, within one expression or across several, are
+ * computed once into temporaries named cse0, cse1, ..., which are declared
+ * first. With csrc_options::horner, sums are written in Horner form and the
+ * integer powers of each base are computed by one chain of multiplications.
+ */
+csrc_cse_statistics print_csrc_cse(const lst& exprs, const std::vector<std::string>& lhs, const print_csrc& c,
+                                   unsigned options)
+{
+	if (exprs.nops() != lhs.size()) {
+		throw std::invalid_argument("print_csrc_cse: number of expressions and variables differ");
+	}
+	const char* type = is_a<print_csrc_float>(c) ? "float" : is_a<print_csrc_cl_N>(c) ? "cln::cl_N" : "double";
+	if (options & csrc_options::complex) {
+		type = is_a<print_csrc_float>(c) ? "std::complex<float>" : is_a<print_csrc_cl_N>(c) ? "cln::cl_N" : "std::complex<double>";
+	}
+	const bool horner = options & csrc_options::horner;
+
+	cse_finder original, finder;
+	lst rewritten;
+	horner_map to_horner;
+	for (lst::const_iterator it = exprs.begin(); it != exprs.end(); ++it) {
+		original.visit(*it);
+		rewritten.append(horner ? to_horner(*it) : *it);
+		finder.visit(rewritten.op(rewritten.nops()-1));
+	}
+
+	csrc_cse_statistics stats;
+	stats.temporaries = 0;
+	stats.ops_before = original.ops_before;
+	stats.ops_after = 0;
+
+	// exponents of the integer powers of each base
+	std::map<ex, std::set<long>, ex_is_less> exponents;
+	if (horner) {
+		for (std::vector<cse_finder::node>::const_iterator n = finder.nodes.begin(); n != finder.nodes.end(); ++n) {
+			if (is_exactly_a<power>(n->e) && n->e.op(1).info(info_flags::integer) && !is_exactly_a<numeric>(n->e.op(0))) {
+				const long k = ex_to<numeric>(n->e.op(1)).to_long();
+				if (k < -1 || k > 1) {
+					exponents[n->e.op(0)].insert(k < 0 ? -k : k);
+				}
+			}
+		}
+	}
+	std::map<ex, std::map<long, ex>, ex_is_less> chains;
+
+	exmap temps;
+	cse_rewriter rewrite(temps);
+	// nesting depth of each node when printed, up to the temporaries in it
+	std::vector<std::size_t> depth(finder.nodes.size(), 0);
+	for (std::vector<cse_finder::node>::const_iterator n = finder.nodes.begin(); n != finder.nodes.end(); ++n) {
+		std::size_t& d = depth[n - finder.nodes.begin()];
+		for (std::size_t k = 0; k < n->e.nops(); ++k) {
+			const ex& operand = n->e.op(k);
+			if (cse_finder::is_operation(operand) && !temps.count(operand)) {
+				d = std::max(d, depth[finder.find(operand)] + 1);
+			}
+		}
+
+		if (is_exactly_a<power>(n->e) && exponents.count(n->e.op(0)) && n->e.op(1).info(info_flags::integer)) {
+			const ex base = n->e.op(0);
+			const long k = ex_to<numeric>(n->e.op(1)).to_long();
+			if (k < -1 || k > 1) {
+				std::map<long, ex>& chain = chains[base];
+				if (chain.empty()) {
+					print_power_chain(rewrite(base), exponents[base], chain, type, stats.temporaries, stats.ops_after, c);
+				}
+				temps[n->e] = k > 0 ? chain[k] : pow(chain[-k], -1);
+				stats.ops_after += k < 0;
+				continue;
+			}
+		}
+		stats.ops_after += cse_finder::own_ops(n->e);
+		// deeply nested expressions are broken up by temporaries, so that
+		// printing them can not overflow the call stack, and huge sums are
+		// written as several partial sums
+		const bool huge_sum = is_exactly_a<add>(n->e) && n->e.nops() > max_csrc_sum_terms;
+		if (n->count < 2 && d < max_csrc_depth && !huge_sum) {
+			continue;
+		}
+		std::ostringstream name;
+		name << "cse" << stats.temporaries++;
+		const ex value = n->e.map(rewrite);
+		c.s << type << " " << name.str() << " = ";
+		if (is_exactly_a<add>(value) && value.nops() > max_csrc_sum_terms) {
+			for (std::size_t first = 0; first < value.nops(); first += max_csrc_sum_terms) {
+				if (first) {
+					c.s << name.str() << " += ";
+				}
+				exvector terms;
+				for (std::size_t k = first; k < std::min<std::size_t>(first + max_csrc_sum_terms, value.nops()); ++k) {
+					terms.push_back(value.op(k));
+				}
+				add(terms).print(c);
+				c.s << ";" << std::endl;
+			}
+		} else {
+			value.print(c);
+			c.s << ";" << std::endl;
+		}
+		temps[n->e] = symbol(name.str());
+		d = 0;
+	}
+	for (std::size_t i = 0; i < lhs.size(); ++i) {
+		c.s << lhs[i] << " = ";
+		rewrite(rewritten.op(i)).print(c);
+		c.s << ";" << std::endl;
+	}
+	return stats;
+}
+
+static csrc_cse_statistics compile_ex_stats;
+static unsigned compile_ex_options = 0;
+
+/**
+ * Sets the csrc_options used by compile_ex() for the C code it writes.
+ *
+ * @return previous setting
+ */
+unsigned set_compile_ex_options(unsigned options)
+{
+	const unsigned previous = compile_ex_options;
+	compile_ex_options = options;
+	return previous;
+}
+
+unsigned get_compile_ex_options()
+{
+	return compile_ex_options;
+}
+
+/**
+ * Statistics of the common subexpression elimination in the C code
+ * written by the last call of compile_ex().
+ */
+csrc_cse_statistics get_compile_ex_statistics()
+{
+	return compile_ex_stats;
+}
+
+static std::string compile_ex_cache_dir;
+static compile_ex_cache_statistics compile_ex_cache_stats = { 0, 0 };
+
+/**
+ * Sets the directory where compile_ex() keeps compiled modules across runs.
+ * An empty string disables the cache.
+ *
+ * @return previous setting
+ */
+std::string set_compile_ex_cache_dir(const std::string& dir)
+{
+	const std::string previous = compile_ex_cache_dir;
+	compile_ex_cache_dir = dir;
+	return previous;
+}
+
+std::string get_compile_ex_cache_dir()
+{
+	return compile_ex_cache_dir;
+}
+
+static unsigned compile_ex_jobs = 1;
+
+/**
+ * Sets the number of translation units of a large batch that compile_ex()
+ * compiles concurrently. This has an effect only if GiNaC was built with
+ * pthreads.
+ *
+ * @return previous setting
+ */
+unsigned set_compile_ex_jobs(unsigned n)
+{
+	const unsigned previous = compile_ex_jobs;
+	compile_ex_jobs = (n == 0 ? 1 : n);
+	return previous;
+}
+
+unsigned get_compile_ex_jobs()
+{
+	return compile_ex_jobs;
+}
+
+compile_ex_cache_statistics get_compile_ex_cache_statistics()
+{
+	return compile_ex_cache_stats;
+}
+
+void reset_compile_ex_cache_statistics()
+{
+	compile_ex_cache_stats.lookups = 0;
+	compile_ex_cache_stats.hits = 0;
+}
+
 #ifdef HAVE_LIBDL
-	
+
+/**
+ * Shell commands run by one task of run_commands().
+ */
+struct command_job {
+	std::vector<std::string> commands;
+	bool failed;
+};
+
+static void* run_command_job(void* arg)
+{
+	command_job& job = *static_cast<command_job*>(arg);
+	for (std::vector<std::string>::const_iterator i = job.commands.begin(); i != job.commands.end(); ++i) {
+		if (system(i->c_str())) {
+			job.failed = true;
+		}
+	}
+	return NULL;
+}
+
+/**
+ * Runs shell commands, up to compile_ex_jobs of them at the same time, as
+ * tasks. The calling thread runs the first share.
+ *
+ * @return false if a command failed
+ */
+static bool run_commands(const std::vector<std::string>& commands)
+{
+	std::size_t njobs = 1;
+#ifdef PARALLEL_EXCOMPILER
+	njobs = std::min<std::size_t>(compile_ex_jobs, commands.size());
+#endif
+	std::vector<command_job> jobs(std::max<std::size_t>(njobs, 1));
+	for (std::size_t i = 0; i < commands.size(); ++i) {
+		jobs[i % jobs.size()].commands.push_back(commands[i]);
+	}
+	for (std::size_t k = 0; k < jobs.size(); ++k) {
+		jobs[k].failed = false;
+	}
+
+	run_tasks(run_command_job, jobs);
+
+	for (std::size_t k = 0; k < jobs.size(); ++k) {
+		if (jobs[k].failed) {
+			return false;
+		}
+	}
+	return true;
+}
+
 /**
  * Small class that manages modules opened by libdl. It is used by compile_ex
  * and link_ex in order to have a clean-up of opened modules and their
@@ -71,6 +1213,14 @@ class excompiler
 	};
 	std::vector<filedesc> filelist; /**< List of all opened modules */
 public:
+	/**
+	 * Languages of the produced source files.
+	 */
+	enum language {
+		lang_c,    /**< C, real double or float */
+		lang_cxx,  /**< C++ with std::complex */
+		lang_cln   /**< C++ with CLN numbers, linked against CLN */
+	};
 	/**
 	 * Complete clean-up of opend modules is done on destruction.
 	 */
@@ -102,8 +1252,8 @@ public:
 		}
 	}
 	/**
-	 * Creates a new C source file and adds a standard header. If filename is
-	 * empty, a unique random name is produced and used.
+	 * Creates a new C source file. If filename is empty, a unique random name
+	 * is produced and used.
 	 */
 	void create_src_file(std::string& filename, std::ofstream& ofs)
 	{
@@ -123,29 +1273,227 @@ public:
 			// use parameter as filename
 			ofs.open(filename.c_str(), std::ios::out);
 		}
-		
-		if (!ofs) {
-			throw std::runtime_error("could not create source code file for compilation");
+		
+		if (!ofs) {
+			throw std::runtime_error("could not create source code file for compilation");
+		}
+	}
+	/**
+	 * Returns the standard header of every source file in the language.
+	 */
+	static std::string src_header(language lang)
+	{
+		std::ostringstream ofs;
+		if (lang == lang_cxx) {
+			ofs << "#include <cmath>" << std::endl;
+			ofs << "#include <complex>" << std::endl;
+			ofs << std::endl;
+			// abs() is printed as fabs()
+			ofs << "static inline double fabs(const std::complex<double>& z) { return std::abs(z); }" << std::endl;
+			ofs << std::endl;
+			return ofs.str();
+		}
+		if (lang == lang_cln) {
+			ofs << "#include <cln/cln.h>" << std::endl;
+			ofs << std::endl;
+			ofs << "using namespace cln;" << std::endl;
+			ofs << std::endl;
+			return ofs.str();
+		}
+		ofs << "#include <stddef.h> " << std::endl;
+		ofs << "#include <stdlib.h> " << std::endl;
+		ofs << "#include <math.h> " << std::endl;
+		ofs << std::endl;
+		// provided by libginac, see inifcns.h
+		ofs << "double ginac_Li_double(int, double);" << std::endl;
+		ofs << std::endl;
+		return ofs.str();
+	}
+	/**
+	 * Calls the shell script 'ginac-excompiler' to compile the produced C
+	 * source file into an linkable so-file.  On demand the C source file is
+	 * deleted.
+	 */
+	void compile_src_file(const std::string filename, bool clean_up, language lang = lang_c)
+	{
+		std::string strcompile = "ginac-excompiler ";
+		if (lang == lang_cxx) {
+			strcompile += "-x c++ ";
+		} else if (lang == lang_cln) {
+			strcompile += "-x cln ";
+		}
+		strcompile += filename;
+		if (system(strcompile.c_str())) {
+			throw std::runtime_error("excompiler::compile_src_file: error compiling source file!");
+		}
+		if (clean_up) {
+			remove(filename.c_str());
+		}
+	}
+	/**
+	 * Compiles several C source files, each given without its extension,
+	 * into object files concurrently, and links those into the so-file
+	 * name.so. The object files are deleted, the source files on demand.
+	 */
+	void compile_units(const std::string& name, const std::vector<std::string>& units, bool clean_up)
+	{
+		std::vector<std::string> commands;
+		std::string strlink = "ginac-excompiler -l " + name + ".so";
+		for (std::vector<std::string>::const_iterator i = units.begin(); i != units.end(); ++i) {
+			commands.push_back("ginac-excompiler -c " + *i);
+			strlink += " " + *i + ".o";
+		}
+		const bool compiled = run_commands(commands);
+		const bool linked = compiled && !system(strlink.c_str());
+		for (std::vector<std::string>::const_iterator i = units.begin(); i != units.end(); ++i) {
+			remove((*i + ".o").c_str());
+			if (clean_up) {
+				remove(i->c_str());
+			}
+		}
+		if (!linked) {
+			throw std::runtime_error("excompiler::compile_units: error compiling source files!");
+		}
+	}
+	/**
+	 * Compiles the translation units, already written to the files given,
+	 * into the so-file named after the first one with .so suffix. On demand
+	 * the source files are deleted. Only C code can be split into several
+	 * units.
+	 */
+	void build(const std::vector<std::string>& units, bool clean_up, language lang)
+	{
+		if (units.size() == 1) {
+			compile_src_file(units[0], clean_up, lang);
+		} else {
+			compile_units(units[0], units, clean_up);
+		}
+	}
+	/**
+	 * Returns the cache key of the source code in the files, one after the
+	 * other, as 16 hex digits (64 bit FNV-1a hash of the compiler command,
+	 * the library version and the source). The files are read in chunks.
+	 */
+	static std::string cache_key(const std::vector<std::string>& files)
+	{
+		std::ostringstream salt;
+		salt << "ginac-excompiler " << GINACLIB_MAJOR_VERSION << '.' << GINACLIB_MINOR_VERSION
+		     << '.' << GINACLIB_MICRO_VERSION << '\n';
+		const std::string text = salt.str();
+		uint64_t h = 14695981039346656037ULL;
+		for (std::string::const_iterator i = text.begin(); i != text.end(); ++i) {
+			h ^= static_cast<unsigned char>(*i);
+			h *= 1099511628211ULL;
+		}
+		std::vector<char> chunk(1 << 16);
+		for (std::vector<std::string>::const_iterator f = files.begin(); f != files.end(); ++f) {
+			std::ifstream ifs(f->c_str(), std::ios::in | std::ios::binary);
+			while (ifs.read(&chunk[0], chunk.size()) || ifs.gcount()) {
+				for (std::streamsize i = 0; i < ifs.gcount(); ++i) {
+					h ^= static_cast<unsigned char>(chunk[i]);
+					h *= 1099511628211ULL;
+				}
+			}
+		}
+		std::ostringstream key;
+		key << std::hex;
+		key.width(16);
+		key.fill('0');
+		key << h;
+		return key.str();
+	}
+	static bool file_exists(const std::string& name)
+	{
+		struct stat st;
+		return stat(name.c_str(), &st) == 0;
+	}
+	/**
+	 * Returns true if the file exists and holds the contents of the files,
+	 * one after the other. The files are compared in chunks.
+	 */
+	static bool file_holds(const std::string& name, const std::vector<std::string>& files)
+	{
+		std::ifstream ifs(name.c_str(), std::ios::in | std::ios::binary);
+		if (!ifs) {
+			return false;
+		}
+		std::vector<char> chunk(1 << 16), other(1 << 16);
+		for (std::vector<std::string>::const_iterator f = files.begin(); f != files.end(); ++f) {
+			std::ifstream part(f->c_str(), std::ios::in | std::ios::binary);
+			while (part.read(&chunk[0], chunk.size()) || part.gcount()) {
+				const std::streamsize n = part.gcount();
+				if (!ifs.read(&other[0], n) || !std::equal(chunk.begin(), chunk.begin() + n, other.begin())) {
+					return false;
+				}
+			}
 		}
-
-		ofs << "#include <stddef.h> " << std::endl;
-		ofs << "#include <stdlib.h> " << std::endl;
-		ofs << "#include <math.h> " << std::endl;
-		ofs << std::endl;
+		return ifs.peek() == std::ifstream::traits_type::eof();
 	}
 	/**
-	 * Calls the shell script 'ginac-excompiler' to compile the produced C
-	 * source file into an linkable so-file.  On demand the C source file is
-	 * deleted.
+	 * Compiles and links the translation units, already written to files,
+	 * and returns the address of compiled_ex. The files are deleted.
+	 *
+	 * The module is looked up in the cache directory first. A module
+	 * ginac-KEY.so is only used if ginac-KEY.c holds exactly the same
+	 * source (of all translation units, one after the other), which guards
+	 * against hash collisions. Otherwise it is compiled under the private
+	 * temporary name of the units and then renamed into place, the .so
+	 * before the .c, so concurrent processes never see a partially written
+	 * module. Two processes missing at the same time both compile, and the
+	 * second rename harmlessly replaces the first.
 	 */
-	void compile_src_file(const std::string filename, bool clean_up)
+	void* compile_cached(const std::vector<std::string>& units, language lang)
 	{
-		std::string strcompile = "ginac-excompiler " + filename;
-		if (system(strcompile.c_str())) {
-			throw std::runtime_error("excompiler::compile_src_file: error compiling source file!");
+		const std::string base = compile_ex_cache_dir + "/ginac-" + cache_key(units);
+		++compile_ex_cache_stats.lookups;
+
+		const bool same = file_holds(base + ".c", units);
+		const bool collision = !same && file_exists(base + ".c");
+		if (same) {
+			if (void* module = dlopen((base + ".so").c_str(), RTLD_NOW)) {
+				++compile_ex_cache_stats.hits;
+				add_opened_module(module, base + ".so", false);
+				remove_files(units);
+				return dlsym(module, "compiled_ex");
+			}
 		}
-		if (clean_up) {
-			remove(filename.c_str());
+
+		try {
+			build(units, false, lang);
+		} catch (...) {
+			remove_files(units);
+			throw;
+		}
+		// the record of the source is the first unit, or all of them
+		std::string record = units[0];
+		if (units.size() > 1) {
+			record += ".all";
+			std::ofstream ofs(record.c_str(), std::ios::out | std::ios::binary);
+			for (std::vector<std::string>::const_iterator f = units.begin(); f != units.end(); ++f) {
+				std::ifstream part(f->c_str(), std::ios::in | std::ios::binary);
+				ofs << part.rdbuf();
+			}
+			remove_files(std::vector<std::string>(units.begin() + 1, units.end()));
+		}
+
+		if (!collision && rename((units[0] + ".so").c_str(), (base + ".so").c_str()) == 0) {
+			if (rename(record.c_str(), (base + ".c").c_str()) != 0) {
+				remove(record.c_str());
+			}
+			if (record != units[0]) {
+				remove(units[0].c_str());
+			}
+			return link_so_file(base + ".so", false);
+		}
+		// not published, keep it private to this process
+		remove(record.c_str());
+		remove(units[0].c_str());
+		return link_so_file(units[0] + ".so", true);
+	}
+	static void remove_files(const std::vector<std::string>& files)
+	{
+		for (std::vector<std::string>::const_iterator f = files.begin(); f != files.end(); ++f) {
+			remove(f->c_str());
 		}
 	}
 	/**
@@ -192,57 +1540,169 @@ public:
  */
 static excompiler global_excompiler;
 
+/**
+ * The source code of a module written by compile_ex(). The translation units
+ * are written directly to their files, so that huge expressions never have
+ * to be kept in memory as text, and are then compiled, or found in the cache
+ * directory, and linked.
+ */
+class module_source
+{
+	std::string filename; /**< name given to compile_ex(), or empty */
+	excompiler::language lang;
+	bool cached;
+	std::vector<std::string> units; /**< files of the translation units */
+	std::ofstream ofs;
+	bool linked;
+public:
+	module_source(const std::string& name, excompiler::language l = excompiler::lang_c)
+		: filename(name), lang(l), cached(name.empty() && !compile_ex_cache_dir.empty()), linked(false) {}
+	/**
+	 * Deletes the source files if an exception occurred while writing them.
+	 */
+	~module_source()
+	{
+		if (!linked && filename.empty()) {
+			if (ofs.is_open()) {
+				ofs.close();
+			}
+			for (std::vector<std::string>::const_iterator f = units.begin(); f != units.end(); ++f) {
+				remove(f->c_str());
+			}
+		}
+	}
+	/**
+	 * Starts the next translation unit with the standard header and returns
+	 * the stream to write its code to.
+	 */
+	std::ostream& next_unit()
+	{
+		if (ofs.is_open()) {
+			finish_unit();
+		}
+		if (!units.empty()) {
+			std::ostringstream name;
+			name << units[0] << '.' << units.size();
+			units.push_back(name.str());
+			ofs.open(units.back().c_str(), std::ios::out);
+		} else if (cached) {
+			mkdir(compile_ex_cache_dir.c_str(), 0777);
+			const std::string pattern = compile_ex_cache_dir + "/tmp-XXXXXX";
+			std::vector<char> name(pattern.begin(), pattern.end());
+			name.push_back('\0');
+			const int fd = mkstemp(&name[0]);
+			if (fd == -1) {
+				throw std::runtime_error("module_source: could not create file in cache directory " + compile_ex_cache_dir);
+			}
+			close(fd);
+			units.push_back(&name[0]);
+			ofs.open(units.back().c_str(), std::ios::out);
+		} else {
+			std::string name = filename;
+			global_excompiler.create_src_file(name, ofs);
+			units.push_back(name);
+		}
+		if (!ofs) {
+			throw std::runtime_error("could not create source code file for compilation");
+		}
+		ofs << excompiler::src_header(lang);
+		return ofs;
+	}
+	/**
+	 * Compiles and links the module and returns the address of compiled_ex.
+	 */
+	void* link()
+	{
+		finish_unit();
+		linked = true;
+		if (cached) {
+			return global_excompiler.compile_cached(units, lang);
+		}
+		global_excompiler.build(units, filename.empty(), lang);
+		return global_excompiler.link_so_file(units[0]+".so", filename.empty());
+	}
+private:
+	void finish_unit()
+	{
+		ofs.close();
+		if (!ofs) {
+			throw std::runtime_error("could not write source code file for compilation");
+		}
+	}
+};
+
+/**
+ * A batch of expressions compiled by compile_ex() is split into translation
+ * units of at most max_unit_exprs expressions, because C compilers need
+ * superlinear time for very large functions. With several jobs, batches
+ * are split further, into units of at least min_unit_exprs expressions.
+ */
+static const std::size_t max_unit_exprs = 256;
+static const std::size_t min_unit_exprs = 32;
+
 void compile_ex(const ex& expr, const symbol& sym, FUNCP_1P& fp, const std::string filename)
 {
+	if (filename.empty()) {
+		if (void* f = jit_compile(exvector(1, expr), exvector(1, sym), false)) {
+			fp = (FUNCP_1P) f;
+			return;
+		}
+	}
+
 	symbol x("x");
 	ex expr_with_x = expr.subs(lst(sym==x));
 
-	std::ofstream ofs;
-	std::string unique_filename = filename;
-	global_excompiler.create_src_file(unique_filename, ofs);
+	module_source src(filename);
+	std::ostream& ofs = src.next_unit();
 
 	ofs << "double compiled_ex(double x)" << std::endl;
 	ofs << "{" << std::endl;
-	ofs << "double res = ";
-	expr_with_x.print(GiNaC::print_csrc_double(ofs));
-	ofs << ";" << std::endl;
+	compile_ex_stats = print_csrc_cse(lst(expr_with_x), std::vector<std::string>(1, "double res"),
+	                                  GiNaC::print_csrc_double(ofs), compile_ex_options);
 	ofs << "return(res); " << std::endl;
 	ofs << "}" << std::endl;
 
-	ofs.close();
-
-	global_excompiler.compile_src_file(unique_filename, filename.empty());
 	// This is not standard compliant! ... no conversion between
 	// pointer-to-functions and pointer-to-objects ...
-	fp = (FUNCP_1P) global_excompiler.link_so_file(unique_filename+".so", filename.empty());
+	fp = (FUNCP_1P) src.link();
 }
 
 void compile_ex(const ex& expr, const symbol& sym1, const symbol& sym2, FUNCP_2P& fp, const std::string filename)
 {
+	if (filename.empty()) {
+		exvector syms;
+		syms.push_back(sym1);
+		syms.push_back(sym2);
+		if (void* f = jit_compile(exvector(1, expr), syms, false)) {
+			fp = (FUNCP_2P) f;
+			return;
+		}
+	}
+
 	symbol x("x"), y("y");
 	ex expr_with_xy = expr.subs(lst(sym1==x, sym2==y));
 
-	std::ofstream ofs;
-	std::string unique_filename = filename;
-	global_excompiler.create_src_file(unique_filename, ofs);
+	module_source src(filename);
+	std::ostream& ofs = src.next_unit();
 
 	ofs << "double compiled_ex(double x, double y)" << std::endl;
 	ofs << "{" << std::endl;
-	ofs << "double res = ";
-	expr_with_xy.print(GiNaC::print_csrc_double(ofs));
-	ofs << ";" << std::endl;
+	compile_ex_stats = print_csrc_cse(lst(expr_with_xy), std::vector<std::string>(1, "double res"),
+	                                  GiNaC::print_csrc_double(ofs), compile_ex_options);
 	ofs << "return(res); " << std::endl;
 	ofs << "}" << std::endl;
 
-	ofs.close();
-
-	global_excompiler.compile_src_file(unique_filename, filename.empty());
 	// This is not standard compliant! ... no conversion between
 	// pointer-to-functions and pointer-to-objects ...
-	fp = (FUNCP_2P) global_excompiler.link_so_file(unique_filename+".so", filename.empty());
+	fp = (FUNCP_2P) src.link();
 }
 
-void compile_ex(const lst& exprs, const lst& syms, FUNCP_CUBA& fp, const std::string filename)
+/**
+ * Replaces the symbols in the expressions by the array elements a[0], a[1],
+ * ... and returns the array elements f[0], f[1], ... the expressions are
+ * assigned to.
+ */
+static void subs_array_names(const lst& exprs, const lst& syms, lst& expr_with_cname, std::vector<std::string>& lhs)
 {
 	lst replacements;
 	for (std::size_t count=0; count<syms.nops(); ++count) {
@@ -251,30 +1711,348 @@ void compile_ex(const lst& exprs, const lst& syms, FUNCP_CUBA& fp, const std::st
 		replacements.append(syms.op(count) == symbol(s.str()));
 	}
 
-	std::vector<ex> expr_with_cname;
 	for (std::size_t count=0; count<exprs.nops(); ++count) {
-		expr_with_cname.push_back(exprs.op(count).subs(replacements));
+		expr_with_cname.append(exprs.op(count).subs(replacements));
+		std::ostringstream s;
+		s << "f[" << count << "]";
+		lhs.push_back(s.str());
 	}
+}
 
-	std::ofstream ofs;
-	std::string unique_filename = filename;
-	global_excompiler.create_src_file(unique_filename, ofs);
+void compile_ex(const lst& exprs, const lst& syms, FUNCP_CUBA& fp, const std::string filename)
+{
+	if (filename.empty()) {
+		const exvector ev(exprs.begin(), exprs.end()), sv(syms.begin(), syms.end());
+		if (void* f = jit_compile(ev, sv, true)) {
+			fp = (FUNCP_CUBA) f;
+			return;
+		}
+	}
+
+	lst expr_with_cname;
+	std::vector<std::string> lhs;
+	subs_array_names(exprs, syms, expr_with_cname, lhs);
+
+	// Large batches are split into several translation units, the first
+	// of which defines compiled_ex and calls the functions of the others.
+	const std::size_t nexprs = expr_with_cname.nops();
+	std::size_t nunits = (nexprs + max_unit_exprs - 1) / max_unit_exprs;
+	if (nexprs >= 2*min_unit_exprs) {
+		nunits = std::max<std::size_t>(nunits, std::min<std::size_t>(compile_ex_jobs, nexprs / min_unit_exprs));
+	}
+	nunits = std::max<std::size_t>(nunits, 1);
+
+	module_source src(filename);
+	compile_ex_stats.temporaries = compile_ex_stats.ops_before = compile_ex_stats.ops_after = 0;
+	for (std::size_t k = 0; k < nunits; ++k) {
+		const std::size_t first = nexprs * k / nunits;
+		const std::size_t last = nexprs * (k + 1) / nunits;
+		lst unit_exprs;
+		for (std::size_t i = first; i < last; ++i) {
+			unit_exprs.append(expr_with_cname.op(i));
+		}
+		const std::vector<std::string> unit_lhs(lhs.begin() + first, lhs.begin() + last);
+
+		std::ostream& ofs = src.next_unit();
+		if (k == 0) {
+			for (std::size_t j = 1; j < nunits; ++j) {
+				ofs << "void compiled_ex_part" << j << "(const double a[], double f[]);" << std::endl;
+			}
+			ofs << "void compiled_ex(const int* an, const double a[], const int* fn, double f[])" << std::endl;
+		} else {
+			ofs << "void compiled_ex_part" << k << "(const double a[], double f[])" << std::endl;
+		}
+		ofs << "{" << std::endl;
+		const csrc_cse_statistics stats = print_csrc_cse(unit_exprs, unit_lhs, GiNaC::print_csrc_double(ofs), compile_ex_options);
+		if (k == 0) {
+			for (std::size_t j = 1; j < nunits; ++j) {
+				ofs << "compiled_ex_part" << j << "(a, f);" << std::endl;
+			}
+		}
+		ofs << "}" << std::endl;
+
+		compile_ex_stats.temporaries += stats.temporaries;
+		compile_ex_stats.ops_before += stats.ops_before;
+		compile_ex_stats.ops_after += stats.ops_after;
+	}
+
+	// This is not standard compliant! ... no conversion between
+	// pointer-to-functions and pointer-to-objects ...
+	fp = (FUNCP_CUBA) src.link();
+}
+
+/**
+ * Map function replacing the operands of an expression, in order, by the
+ * given expressions.
+ */
+struct replace_operands : public map_function {
+	const exvector& repl;
+	std::size_t next;
+	replace_operands(const exvector& r) : repl(r), next(0) {}
+	ex operator()(const ex& e) { return repl[next++]; }
+};
+
+/**
+ * Writes C code computing expressions and their derivatives by reverse-mode
+ * differentiation over the expression DAG. Every subexpression is computed
+ * once into a variable v<k>, together with its partial derivatives with
+ * respect to its operands, which are found by diff(). Then the adjoints of
+ * the subexpressions are accumulated from the top down, once for each
+ * expression, so that the derivatives share all the work with the values.
+ */
+class jacobian_writer
+{
+	struct node {
+		ex ref;                          // value: a[j], a number or v<k>
+		bool active;                     // depends on a parameter
+		int param;                       // index of the parameter, or -1
+		std::vector<std::size_t> operands;
+		exvector partials;               // w.r.t. the active operands
+	};
+	std::vector<node> nodes;
+	std::map<ex, std::size_t, ex_is_less> index;
+	const lst& syms;
+	const print_csrc& c;
+
+	std::size_t visit(const ex& e)
+	{
+		std::map<ex, std::size_t, ex_is_less>::const_iterator known = index.find(e);
+		if (known != index.end()) {
+			return known->second;
+		}
+
+		node n;
+		n.active = false;
+		n.param = -1;
+		if (is_a<symbol>(e)) {
+			n.ref = e;
+			for (std::size_t j = 0; j < syms.nops(); ++j) {
+				if (e.is_equal(syms.op(j))) {
+					std::ostringstream name;
+					name << "a[" << j << "]";
+					n.ref = symbol(name.str());
+					n.active = true;
+					n.param = j;
+				}
+			}
+		} else if (is_a<constant>(e)) {
+			n.ref = e.evalf();
+		} else if (e.nops() == 0) {
+			n.ref = e;
+		} else {
+			exvector refs, placeholders;
+			lst to_refs;
+			for (std::size_t i = 0; i < e.nops(); ++i) {
+				const std::size_t k = visit(e.op(i));
+				n.operands.push_back(k);
+				refs.push_back(nodes[k].ref);
+				if (nodes[k].active) {
+					n.active = true;
+					placeholders.push_back(symbol());
+					to_refs.append(placeholders.back() == nodes[k].ref);
+				} else {
+					placeholders.push_back(nodes[k].ref);
+				}
+			}
+
+			replace_operands by_refs(refs);
+			const ex local = e.map(by_refs);
+			std::ostringstream name;
+			name << "v" << nodes.size();
+			n.ref = symbol(name.str());
+			c.s << "double " << name.str() << " = ";
+			local.print(c);
+			c.s << ";" << std::endl;
+
+			if (n.active) {
+				replace_operands by_placeholders(placeholders);
+				const ex f = e.map(by_placeholders);
+				for (std::size_t i = 0; i < n.operands.size(); ++i) {
+					if (nodes[n.operands[i]].active) {
+						ex d = f.diff(ex_to<symbol>(placeholders[i]));
+						d = d.subs(to_refs, subs_options::no_pattern);
+						d = d.subs(local == n.ref, subs_options::no_pattern);
+						n.partials.push_back(d);
+					}
+				}
+			}
+		}
+		nodes.push_back(n);
+		return index[e] = nodes.size() - 1;
+	}
+
+public:
+	jacobian_writer(const lst& s, const print_csrc& ctx) : syms(s), c(ctx) {}
+
+	/**
+	 * Writes the statements assigning the expression values to f[0], ...,
+	 * f[m-1] and the derivative of the i-th expression with respect to the
+	 * j-th symbol to f[m+i*n+j]. The symbols are read from a[].
+	 */
+	void write(const lst& exprs)
+	{
+		const std::size_t m = exprs.nops(), nsyms = syms.nops();
+		std::vector<std::size_t> roots;
+		for (std::size_t i = 0; i < m; ++i) {
+			roots.push_back(visit(exprs.op(i)));
+		}
+		for (std::size_t i = 0; i < m; ++i) {
+			c.s << "f[" << i << "] = ";
+			nodes[roots[i]].ref.print(c);
+			c.s << ";" << std::endl;
+		}
+
+		for (std::size_t i = 0; i < m; ++i) {
+			// adjoints are scoped to the block of their expression
+			c.s << "{" << std::endl;
+			std::vector<exvector> contributions(roots[i] + 1);
+			std::vector<bool> written(nsyms, false);
+			contributions[roots[i]].push_back(_ex1);
+			for (std::size_t k = roots[i] + 1; k-- > 0; ) {
+				const node& n = nodes[k];
+				if (contributions[k].empty() || !n.active) {
+					continue;
+				}
+				ex adjoint = add(contributions[k]);
+				if (n.param >= 0) {
+					c.s << "f[" << m + i*nsyms + n.param << "] = ";
+					adjoint.print(c);
+					c.s << ";" << std::endl;
+					written[n.param] = true;
+					continue;
+				}
+				if (!is_a<symbol>(adjoint) && !is_exactly_a<numeric>(adjoint)) {
+					std::ostringstream name;
+					name << "w" << k;
+					c.s << "double " << name.str() << " = ";
+					adjoint.print(c);
+					c.s << ";" << std::endl;
+					adjoint = symbol(name.str());
+				}
+				std::size_t p = 0;
+				for (std::size_t o = 0; o < n.operands.size(); ++o) {
+					if (nodes[n.operands[o]].active) {
+						contributions[n.operands[o]].push_back(adjoint * n.partials[p++]);
+					}
+				}
+			}
+			for (std::size_t j = 0; j < nsyms; ++j) {
+				if (!written[j]) {
+					c.s << "f[" << m + i*nsyms + j << "] = 0;" << std::endl;
+				}
+			}
+			c.s << "}" << std::endl;
+		}
+	}
+};
+
+void compile_ex_jacobian(const lst& exprs, const lst& syms, FUNCP_CUBA& fp, const std::string filename)
+{
+	module_source src(filename);
+	std::ostream& ofs = src.next_unit();
 
 	ofs << "void compiled_ex(const int* an, const double a[], const int* fn, double f[])" << std::endl;
 	ofs << "{" << std::endl;
-	for (std::size_t count=0; count<exprs.nops(); ++count) {
-		ofs << "f[" << count << "] = ";
-		expr_with_cname[count].print(GiNaC::print_csrc_double(ofs));
-		ofs << ";" << std::endl;
+	jacobian_writer(syms, GiNaC::print_csrc_double(ofs)).write(exprs);
+	ofs << "}" << std::endl;
+
+	// This is not standard compliant! ... no conversion between
+	// pointer-to-functions and pointer-to-objects ...
+	fp = (FUNCP_CUBA) src.link();
+}
+
+/**
+ * Writes a function evaluating expr at n points, whose loop the C compiler
+ * can vectorize. The values of the k-th symbol are read from in[k].
+ */
+static void write_batch_function(std::ostream& ofs, const ex& expr, const lst& syms, bool single)
+{
+	const char* type = single ? "float" : "double";
+
+	lst replacements;
+	for (std::size_t count=0; count<syms.nops(); ++count) {
+		std::ostringstream s;
+		s << "x" << count << "[i]";
+		replacements.append(syms.op(count) == symbol(s.str()));
+	}
+	const ex expr_with_cname = expr.subs(replacements);
+
+	ofs << "void compiled_ex(size_t n, const " << type << "* const* in, " << type << "* __restrict out)" << std::endl;
+	ofs << "{" << std::endl;
+	for (std::size_t count=0; count<syms.nops(); ++count) {
+		ofs << "const " << type << "* __restrict x" << count << " = in[" << count << "];" << std::endl;
 	}
+	ofs << "size_t i;" << std::endl;
+	ofs << "for (i = 0; i < n; ++i) {" << std::endl;
+	const std::vector<std::string> lhs(1, "out[i]");
+	if (single) {
+		compile_ex_stats = print_csrc_cse(lst(expr_with_cname), lhs, GiNaC::print_csrc_float(ofs), compile_ex_options);
+	} else {
+		compile_ex_stats = print_csrc_cse(lst(expr_with_cname), lhs, GiNaC::print_csrc_double(ofs), compile_ex_options);
+	}
+	ofs << "}" << std::endl;
+	ofs << "}" << std::endl;
+}
+
+void compile_ex(const ex& expr, const lst& syms, FUNCP_VEC& fp, const std::string filename)
+{
+	module_source src(filename);
+
+	write_batch_function(src.next_unit(), expr, syms, false);
+
+	// This is not standard compliant! ... no conversion between
+	// pointer-to-functions and pointer-to-objects ...
+	fp = (FUNCP_VEC) src.link();
+}
+
+void compile_ex(const ex& expr, const lst& syms, FUNCP_VEC_FLOAT& fp, const std::string filename)
+{
+	module_source src(filename);
+
+	write_batch_function(src.next_unit(), expr, syms, true);
+
+	// This is not standard compliant! ... no conversion between
+	// pointer-to-functions and pointer-to-objects ...
+	fp = (FUNCP_VEC_FLOAT) src.link();
+}
+
+void compile_ex(const lst& exprs, const lst& syms, FUNCP_COMPLEX& fp, const std::string filename)
+{
+	lst expr_with_cname;
+	std::vector<std::string> lhs;
+	subs_array_names(exprs, syms, expr_with_cname, lhs);
+
+	module_source src(filename, excompiler::lang_cxx);
+	std::ostream& ofs = src.next_unit();
+
+	ofs << "extern \"C\" void compiled_ex(const std::complex<double> a[], std::complex<double> f[])" << std::endl;
+	ofs << "{" << std::endl;
+	compile_ex_stats = print_csrc_cse(expr_with_cname, lhs, GiNaC::print_csrc_double(ofs),
+	                                  compile_ex_options | csrc_options::complex);
 	ofs << "}" << std::endl;
 
-	ofs.close();
+	// This is not standard compliant! ... no conversion between
+	// pointer-to-functions and pointer-to-objects ...
+	fp = (FUNCP_COMPLEX) src.link();
+}
+
+void compile_ex(const lst& exprs, const lst& syms, FUNCP_CL_N& fp, const std::string filename)
+{
+	lst expr_with_cname;
+	std::vector<std::string> lhs;
+	subs_array_names(exprs, syms, expr_with_cname, lhs);
+
+	module_source src(filename, excompiler::lang_cln);
+	std::ostream& ofs = src.next_unit();
+
+	ofs << "extern \"C\" void compiled_ex(const cln::cl_N a[], cln::cl_N f[])" << std::endl;
+	ofs << "{" << std::endl;
+	compile_ex_stats = print_csrc_cse(expr_with_cname, lhs, GiNaC::print_csrc_cl_N(ofs), compile_ex_options);
+	ofs << "}" << std::endl;
 
-	global_excompiler.compile_src_file(unique_filename, filename.empty());
 	// This is not standard compliant! ... no conversion between
 	// pointer-to-functions and pointer-to-objects ...
-	fp = (FUNCP_CUBA) global_excompiler.link_so_file(unique_filename+".so", filename.empty());
+	fp = (FUNCP_CL_N) src.link();
 }
 
 void link_ex(const std::string filename, FUNCP_1P& fp)
@@ -298,6 +2076,34 @@ void link_ex(const std::string filename, FUNCP_CUBA& fp)
 	fp = (FUNCP_CUBA) global_excompiler.link_so_file(filename, false);
 }
 
+void link_ex(const std::string filename, FUNCP_VEC& fp)
+{
+	// This is not standard compliant! ... no conversion between
+	// pointer-to-functions and pointer-to-objects ...
+	fp = (FUNCP_VEC) global_excompiler.link_so_file(filename, false);
+}
+
+void link_ex(const std::string filename, FUNCP_VEC_FLOAT& fp)
+{
+	// This is not standard compliant! ... no conversion between
+	// pointer-to-functions and pointer-to-objects ...
+	fp = (FUNCP_VEC_FLOAT) global_excompiler.link_so_file(filename, false);
+}
+
+void link_ex(const std::string filename, FUNCP_COMPLEX& fp)
+{
+	// This is not standard compliant! ... no conversion between
+	// pointer-to-functions and pointer-to-objects ...
+	fp = (FUNCP_COMPLEX) global_excompiler.link_so_file(filename, false);
+}
+
+void link_ex(const std::string filename, FUNCP_CL_N& fp)
+{
+	// This is not standard compliant! ... no conversion between
+	// pointer-to-functions and pointer-to-objects ...
+	fp = (FUNCP_CL_N) global_excompiler.link_so_file(filename, false);
+}
+
 void unlink_ex(const std::string filename)
 {
 	global_excompiler.unlink(filename);
@@ -307,20 +2113,71 @@ void unlink_ex(const std::string filename)
 
 /*
  * In case no working libdl has been found by configure, the following function
- * stubs preserve the interface. Every function just raises an exception.
+ * stubs preserve the interface. Except for what the JIT can compile, every
+ * function just raises an exception.
  */
 
 void compile_ex(const ex& expr, const symbol& sym, FUNCP_1P& fp, const std::string filename)
 {
+	if (filename.empty()) {
+		if (void* f = jit_compile(exvector(1, expr), exvector(1, sym), false)) {
+			fp = (FUNCP_1P) f;
+			return;
+		}
+	}
+
 	throw std::runtime_error("compile_ex has been disabled because of missing libdl!");
 }
 
 void compile_ex(const ex& expr, const symbol& sym1, const symbol& sym2, FUNCP_2P& fp, const std::string filename)
 {
+	if (filename.empty()) {
+		exvector syms;
+		syms.push_back(sym1);
+		syms.push_back(sym2);
+		if (void* f = jit_compile(exvector(1, expr), syms, false)) {
+			fp = (FUNCP_2P) f;
+			return;
+		}
+	}
+
 	throw std::runtime_error("compile_ex has been disabled because of missing libdl!");
 }
 
 void compile_ex(const lst& exprs, const lst& syms, FUNCP_CUBA& fp, const std::string filename)
+{
+	if (filename.empty()) {
+		const exvector ev(exprs.begin(), exprs.end()), sv(syms.begin(), syms.end());
+		if (void* f = jit_compile(ev, sv, true)) {
+			fp = (FUNCP_CUBA) f;
+			return;
+		}
+	}
+
+	throw std::runtime_error("compile_ex has been disabled because of missing libdl!");
+}
+
+void compile_ex(const ex& expr, const lst& syms, FUNCP_VEC& fp, const std::string filename)
+{
+	throw std::runtime_error("compile_ex has been disabled because of missing libdl!");
+}
+
+void compile_ex(const ex& expr, const lst& syms, FUNCP_VEC_FLOAT& fp, const std::string filename)
+{
+	throw std::runtime_error("compile_ex has been disabled because of missing libdl!");
+}
+
+void compile_ex(const lst& exprs, const lst& syms, FUNCP_COMPLEX& fp, const std::string filename)
+{
+	throw std::runtime_error("compile_ex has been disabled because of missing libdl!");
+}
+
+void compile_ex_jacobian(const lst& exprs, const lst& syms, FUNCP_CUBA& fp, const std::string filename)
+{
+	throw std::runtime_error("compile_ex_jacobian has been disabled because of missing libdl!");
+}
+
+void compile_ex(const lst& exprs, const lst& syms, FUNCP_CL_N& fp, const std::string filename)
 {
 	throw std::runtime_error("compile_ex has been disabled because of missing libdl!");
 }
@@ -340,6 +2197,26 @@ void link_ex(const std::string filename, FUNCP_CUBA& fp)
 	throw std::runtime_error("link_ex has been disabled because of missing libdl!");
 }
 
+void link_ex(const std::string filename, FUNCP_VEC& fp)
+{
+	throw std::runtime_error("link_ex has been disabled because of missing libdl!");
+}
+
+void link_ex(const std::string filename, FUNCP_VEC_FLOAT& fp)
+{
+	throw std::runtime_error("link_ex has been disabled because of missing libdl!");
+}
+
+void link_ex(const std::string filename, FUNCP_COMPLEX& fp)
+{
+	throw std::runtime_error("link_ex has been disabled because of missing libdl!");
+}
+
+void link_ex(const std::string filename, FUNCP_CL_N& fp)
+{
+	throw std::runtime_error("link_ex has been disabled because of missing libdl!");
+}
+
 void unlink_ex(const std::string filename)
 {
 	throw std::runtime_error("unlink_ex has been disabled because of missing libdl!");
@@ -26,11 +26,20 @@
 
 #include "lst.h"
 
+#include <complex>
+#include <cstddef>
+#include <map>
 #include <string>
+#include <vector>
+
+namespace cln {
+class cl_N;
+}
 
 namespace GiNaC {
 
 class ex;
+class print_csrc;
 class symbol;
 
 /**
@@ -48,6 +57,197 @@ typedef double (*FUNCP_2P) (double, double);
  */
 typedef void (*FUNCP_CUBA) (const int*, const double[], const int*, double[]);
 
+/**
+ * Function pointer evaluating an expression at n points per call. The value of
+ * the k-th symbol at the i-th point is read from inputs[k][i], the result is
+ * written to out[i].
+ */
+typedef void (*FUNCP_VEC) (std::size_t n, const double* const* inputs, double* out);
+
+/**
+ * Single precision variant of FUNCP_VEC.
+ */
+typedef void (*FUNCP_VEC_FLOAT) (std::size_t n, const float* const* inputs, float* out);
+
+/**
+ * Function pointer evaluating complex valued expressions of complex
+ * parameters. The value of the k-th symbol is read from a[k], the i-th
+ * expression is written to f[i].
+ */
+typedef void (*FUNCP_COMPLEX) (const std::complex<double> a[], std::complex<double> f[]);
+
+/**
+ * Function pointer evaluating expressions in the arbitrary precision numbers
+ * of CLN, with the same parameters as FUNCP_COMPLEX.
+ */
+typedef void (*FUNCP_CL_N) (const cln::cl_N a[], cln::cl_N f[]);
+
+/**
+ * Expressions translated into the instructions of a register machine over
+ * doubles, which are interpreted without allocating memory. Subexpressions
+ * occurring more than once are computed once. This evaluates expressions much
+ * faster than subs() and evalf(), without needing a compiler at run-time.
+ * Rational numbers, constants, sums, products, powers and the elementary
+ * functions are supported, other expressions make the constructor throw.
+ * Evaluation uses the registers of the object, so threads need copies of
+ * their own.
+ */
+class bytecode_evaluator
+{
+public:
+	/**
+	 * @param exprs Expressions to be evaluated
+	 * @param syms Symbols from the expressions to become the arguments, in order
+	 */
+	bytecode_evaluator(const lst& exprs, const lst& syms);
+
+	/**
+	 * Evaluates the expressions, reading the k-th argument from args[k] and
+	 * writing the i-th result to results[i].
+	 */
+	void evaluate(const double* args, double* results);
+
+	/**
+	 * Value of a single expression of a single argument.
+	 */
+	double operator()(double x);
+
+	std::size_t arguments() const { return nargs; }           ///< number of arguments
+	std::size_t instructions() const { return code.size(); }  ///< length of the program
+	std::size_t registers() const { return regs.size(); }     ///< arguments, constants and intermediate values
+
+private:
+	struct instruction {
+		enum { add, mul, powi, call1, call2 } op;
+		std::size_t dst, a, b;  ///< registers of the result and operands
+		long n;                 ///< integer exponent
+		double (*fn1)(double);
+		double (*fn2)(double, double);
+	};
+
+	std::size_t translate(const ex& e, std::map<ex, std::size_t, ex_is_less>& reg_of);
+	std::size_t emit(instruction in);
+
+	std::size_t nargs;
+	std::vector<instruction> code;
+	std::vector<double> regs;
+	std::vector<std::size_t> outputs;
+};
+
+/**
+ * Statistics of the common subexpression elimination done when printing C code.
+ */
+struct csrc_cse_statistics {
+	std::size_t temporaries;  /**< subexpressions computed once into a temporary */
+	std::size_t ops_before;   /**< arithmetic operations and function calls without elimination */
+	std::size_t ops_after;    /**< the same with elimination */
+};
+
+/**
+ * Flags to control the code written by print_csrc_cse().
+ */
+struct csrc_options {
+	enum {
+		/**
+		 * Write sums in multivariate Horner form, pulling out greedily the
+		 * factor that occurs in most terms, and compute the integer powers
+		 * of each base by one shared chain of multiplications.
+		 */
+		horner = 1,
+		/**
+		 * Declare the temporaries as std::complex<double> (or
+		 * std::complex<float>), for C++ code evaluating complex valued
+		 * expressions.
+		 */
+		complex = 2
+	};
+};
+
+/**
+ * Prints C code assigning the expressions exprs to the variables (or
+ * declarations) lhs. Subexpressions occurring more than once, within one
+ * expression or across several, are computed once into temporaries named
+ * cse0, cse1, ..., which are declared before the assignments.
+ *
+ * @param exprs Expressions to be printed
+ * @param lhs Left-hand sides of the assignments, one per expression
+ * @param c C source print context (print_csrc_double, print_csrc_float, ...)
+ * @param options Combination of csrc_options
+ * @return Statistics of the elimination
+ */
+csrc_cse_statistics print_csrc_cse(const lst& exprs, const std::vector<std::string>& lhs, const print_csrc& c,
+                                   unsigned options = 0);
+
+/**
+ * Sets the csrc_options used by compile_ex() for the C code it writes
+ * (default 0).
+ *
+ * @return Previous setting
+ */
+unsigned set_compile_ex_options(unsigned options);
+unsigned get_compile_ex_options();
+
+/**
+ * Statistics of the common subexpression elimination in the C code written by
+ * the last call of compile_ex() that used the external compiler.
+ */
+csrc_cse_statistics get_compile_ex_statistics();
+
+/**
+ * Sets a directory where compile_ex() keeps the modules it compiles, so that
+ * compiling the same C code again, in this or a later process, only loads the
+ * module. Modules are found by a hash of the C code, the compiler command and
+ * the library version. Several processes may share the directory. Only calls
+ * without a filename that use the external compiler are cached. An empty
+ * string disables the cache (default).
+ *
+ * @param dir Cache directory, created if it does not exist
+ * @return Previous setting
+ */
+std::string set_compile_ex_cache_dir(const std::string& dir);
+std::string get_compile_ex_cache_dir();
+
+/**
+ * Sets the number of translation units that compile_ex() compiles at the same
+ * time (default 1). A batch of many expressions for FUNCP_CUBA is split into
+ * several translation units, which are linked into one so-file afterwards.
+ *
+ * @return Previous setting
+ */
+unsigned set_compile_ex_jobs(unsigned n);
+unsigned get_compile_ex_jobs();
+
+/**
+ * Counters describing the effectiveness of the compile_ex() module cache.
+ */
+struct compile_ex_cache_statistics {
+	unsigned long lookups;  /**< compilations looked up in the cache directory */
+	unsigned long hits;     /**< of which found an already compiled module */
+};
+
+compile_ex_cache_statistics get_compile_ex_cache_statistics();
+void reset_compile_ex_cache_statistics();
+
+/**
+ * Ways of compiling expressions in compile_ex().
+ */
+enum compile_ex_backend {
+	compile_ex_jit,      /**< machine code is generated in memory (x86-64 only), for
+	                          expressions of rational numbers, constants, sums, products,
+	                          powers and the elementary functions (default) */
+	compile_ex_external  /**< C source code is compiled by the 'ginac-excompiler' script */
+};
+
+/**
+ * Selects the backend of compile_ex(). If a filename is passed to compile_ex()
+ * or the JIT can not handle an expression, the external compiler is used anyway.
+ *
+ * @param b Backend to use from now on
+ * @return Previous setting
+ */
+compile_ex_backend set_compile_ex_backend(compile_ex_backend b);
+compile_ex_backend get_compile_ex_backend();
+
 /**
  * Takes an expression and produces a function pointer to the compiled and linked
  * C code equivalent in double precision. The function pointer has type FUNCP_1P.
@@ -84,6 +284,78 @@ void compile_ex(const ex& expr, const symbol& sym1, const symbol& sym2, FUNCP_2P
  */
 void compile_ex(const lst& exprs, const lst& syms, FUNCP_CUBA& fp, const std::string filename = "");
 
+/**
+ * Takes expressions and produces a function pointer to the compiled and linked
+ * C code computing their values and all their first derivatives in one call.
+ * The derivatives are found by reverse-mode differentiation of the expression
+ * DAG, so that they share the subexpressions with the values instead of being
+ * separate symbolic derivatives. The function pointer has type FUNCP_CUBA. For
+ * m expressions and n symbols, f[i] receives the value of the i-th expression
+ * and f[m+i*n+j] its derivative with respect to the j-th symbol.
+ *
+ * @param exprs Expressions to be compiled
+ * @param syms Symbols from the expressions to become the parameters, in order
+ * @param fp Returned function pointer
+ * @param filename Name of the intermediate source code and so-file. If
+ * supplied, these intermediate files will not be deleted
+ */
+void compile_ex_jacobian(const lst& exprs, const lst& syms, FUNCP_CUBA& fp, const std::string filename = "");
+
+/**
+ * Takes an expression and produces a function pointer to the compiled and linked
+ * C code that evaluates it in double precision at many points per call. The
+ * loop over the points is written so that the C compiler can vectorize it. The
+ * function pointer has type FUNCP_VEC.
+ *
+ * @param expr Expression to be compiled
+ * @param syms Symbols from the expression to become the inputs, in order
+ * @param fp Returned function pointer
+ * @param filename Name of the intermediate source code and so-file. If
+ * supplied, these intermediate files will not be deleted
+ */
+void compile_ex(const ex& expr, const lst& syms, FUNCP_VEC& fp, const std::string filename = "");
+
+/**
+ * Like the FUNCP_VEC variant, but evaluates in single precision, with the
+ * expression printed by print_csrc_float. The function pointer has type
+ * FUNCP_VEC_FLOAT.
+ *
+ * @param expr Expression to be compiled
+ * @param syms Symbols from the expression to become the inputs, in order
+ * @param fp Returned function pointer
+ * @param filename Name of the intermediate source code and so-file. If
+ * supplied, these intermediate files will not be deleted
+ */
+void compile_ex(const ex& expr, const lst& syms, FUNCP_VEC_FLOAT& fp, const std::string filename = "");
+
+/**
+ * Takes expressions and produces a function pointer to the compiled and linked
+ * C++ code evaluating them in std::complex<double>, so that complex valued
+ * expressions of complex parameters need not be evaluated by evalf(). The
+ * function pointer has type FUNCP_COMPLEX.
+ *
+ * @param exprs Expressions to be compiled
+ * @param syms Symbols from the expressions to become the parameters, in order
+ * @param fp Returned function pointer
+ * @param filename Name of the intermediate source code and so-file. If
+ * supplied, these intermediate files will not be deleted
+ */
+void compile_ex(const lst& exprs, const lst& syms, FUNCP_COMPLEX& fp, const std::string filename = "");
+
+/**
+ * Takes expressions and produces a function pointer to the compiled and linked
+ * C++ code evaluating them in the numbers of CLN, with the precision of the
+ * arguments. The module is linked against CLN. The function pointer has type
+ * FUNCP_CL_N.
+ *
+ * @param exprs Expressions to be compiled
+ * @param syms Symbols from the expressions to become the parameters, in order
+ * @param fp Returned function pointer
+ * @param filename Name of the intermediate source code and so-file. If
+ * supplied, these intermediate files will not be deleted
+ */
+void compile_ex(const lst& exprs, const lst& syms, FUNCP_CL_N& fp, const std::string filename = "");
+
 /** 
  * Opens an existing so-file and returns a function pointer of type FUNCP_1P to
  * the contained function. The so-file has to be generated by compile_ex in
@@ -114,6 +386,46 @@ void link_ex(const std::string filename, FUNCP_2P& fp);
  */
 void link_ex(const std::string filename, FUNCP_CUBA& fp);
 
+/** 
+ * Opens an existing so-file and returns a function pointer of type FUNCP_VEC to
+ * the contained function. The so-file has to be generated by compile_ex in
+ * advance.
+ *
+ * @param filename Name of the so-file to open and link
+ * @param fp Returned function pointer
+ */
+void link_ex(const std::string filename, FUNCP_VEC& fp);
+
+/** 
+ * Opens an existing so-file and returns a function pointer of type
+ * FUNCP_VEC_FLOAT to the contained function. The so-file has to be generated
+ * by compile_ex in advance.
+ *
+ * @param filename Name of the so-file to open and link
+ * @param fp Returned function pointer
+ */
+void link_ex(const std::string filename, FUNCP_VEC_FLOAT& fp);
+
+/** 
+ * Opens an existing so-file and returns a function pointer of type
+ * FUNCP_COMPLEX to the contained function. The so-file has to be generated
+ * by compile_ex in advance.
+ *
+ * @param filename Name of the so-file to open and link
+ * @param fp Returned function pointer
+ */
+void link_ex(const std::string filename, FUNCP_COMPLEX& fp);
+
+/** 
+ * Opens an existing so-file and returns a function pointer of type
+ * FUNCP_CL_N to the contained function. The so-file has to be generated by
+ * compile_ex in advance.
+ *
+ * @param filename Name of the so-file to open and link
+ * @param fp Returned function pointer
+ */
+void link_ex(const std::string filename, FUNCP_CL_N& fp);
+
 /**
  * Closes all linked .so files that have the supplied filename.
  *
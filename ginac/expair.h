@@ -27,20 +27,27 @@
 #include "numeric.h"
 #include "print.h"
 
+#include <algorithm>
+
 namespace GiNaC {
 
 /** A pair of expressions.
  *  This is similar to STL's pair<>.  It is slightly extended since we need to
  *  account for methods like .compare().  Also, since this is meant for use by
  *  class expairseq it must satisfy the invariance that the member coeff must
- *  be of type numeric. */
+ *  be of type numeric.
+ *
+ *  The hash value of rest is kept next to the two pointers, so that sorting,
+ *  combining and comparing sequences of pairs can tell most different rests
+ *  apart without looking at the objects they point to.  Therefore rest must
+ *  not be changed other than by assigning or swapping whole pairs. */
 class expair
 {
 public:
-	expair() : rest(0), coeff(1) { }
+	expair() : rest(0), coeff(1), resthash(rest.gethash()) { }
 
 	/** Construct an expair from two ex. */
-	expair(const ex & r, const ex & c) : rest(r), coeff(c)
+	expair(const ex & r, const ex & c) : rest(r), coeff(c), resthash(rest.gethash())
 	{
 		GINAC_ASSERT(is_exactly_a<numeric>(coeff));
 	}
@@ -48,13 +55,14 @@ public:
 	/** Member-wise check for canonical ordering equality. */
 	bool is_equal(const expair & other) const
 	{
-		return (rest.is_equal(other.rest) && coeff.is_equal(other.coeff));
+		return (resthash == other.resthash &&
+		        rest.is_equal(other.rest) && coeff.is_equal(other.coeff));
 	}
 	
 	/** Member-wise check for canonical ordering lessness. */
 	bool is_less(const expair & other) const 
 	{
-		int restcmp = rest.compare(other.rest);
+		int restcmp = compare_rest(other);
 		return ((restcmp<0) ||
 		        (!(restcmp>0) && (coeff.compare(other.coeff)<0)));
 	}
@@ -62,12 +70,24 @@ public:
 	/** Member-wise check for canonical ordering. */
 	int compare(const expair & other) const
 	{
-		int restcmp = rest.compare(other.rest);
+		int restcmp = compare_rest(other);
 		if (restcmp!=0)
 			return restcmp;
 		else
 			return coeff.compare(other.coeff);
 	}
+
+	/** Same as rest.compare(other.rest), which orders by the hash values
+	 *  first. */
+	int compare_rest(const expair & other) const
+	{
+		if (resthash != other.resthash)
+			return resthash < other.resthash ? -1 : 1;
+		return rest.compare(other.rest);
+	}
+
+	/** Hash value of rest. */
+	unsigned rest_hash() const { return resthash; }
 	
 	void print(std::ostream & os) const;
 	
@@ -83,12 +103,15 @@ public:
 	{
 		rest.swap(other.rest);
 		coeff.swap(other.coeff);
+		std::swap(resthash, other.resthash);
 	}
 
 	const expair conjugate() const;
 
 	ex rest;    ///< first member of pair, an arbitrary expression
 	ex coeff;   ///< second member of pair, must be numeric
+private:
+	unsigned resthash; ///< rest.gethash()
 };
 
 /** Function object for insertion into third argument of STL's sort() etc. */
@@ -101,7 +124,7 @@ struct expair_is_less : public std::binary_function<expair, expair, bool> {
  *  strict weak ordering since for any symbol x we have neither 3*x<2*x or
  *  2*x<3*x.  Handle with care! */
 struct expair_rest_is_less : public std::binary_function<expair, expair, bool> {
-	bool operator()(const expair &lh, const expair &rh) const { return (lh.rest.compare(rh.rest)<0); }
+	bool operator()(const expair &lh, const expair &rh) const { return (lh.compare_rest(rh)<0); }
 };
 
 struct expair_swap : public std::binary_function<expair, expair, void> {
@@ -34,13 +34,12 @@
 #include "indexed.h"
 
 #include <algorithm>
-#if EXPAIRSEQ_USE_HASHTAB
-#include <cmath>
-#endif // EXPAIRSEQ_USE_HASHTAB
 #include <iostream>
 #include <iterator>
 #include <stdexcept>
 #include <string>
+#include <utility>
+#include <vector>
 
 namespace GiNaC {
 
@@ -54,13 +53,32 @@ GINAC_IMPLEMENT_REGISTERED_CLASS_OPT(expairseq, basic,
 // helper classes
 //////////
 
-class epp_is_less
-{
+/** Minimal number of terms for which construct_from_exvector() and
+ *  construct_from_epvector() combine terms through a hash table instead of
+ *  sorting the whole sequence first, see combine_same_terms_hashed(). */
+static const std::size_t hash_combine_threshold = 128;
+
+/** Minimal number of terms for which canonicalize() sorts the hash values of
+ *  the terms instead of the terms themselves. */
+static const std::size_t hash_sort_threshold = 32;
+
+/** Hash value of the rest of a pair and its position in the sequence. */
+typedef std::pair<unsigned, std::size_t> hash_position;
+
+/** Order of the rests of pairs given by their hash values and positions,
+ *  the same as that of ex::compare() which compares the hash values first,
+ *  but without looking at the objects unless the hash values are equal. */
+class hash_position_is_less {
 public:
-	bool operator()(const epp &lh, const epp &rh) const
+	hash_position_is_less(const epvector & s) : seq(s) {}
+	bool operator()(const hash_position & lh, const hash_position & rh) const
 	{
-		return (*lh).is_less(*rh);
+		if (lh.first != rh.first)
+			return lh.first < rh.first;
+		return seq[lh.second].rest.compare(seq[rh.second].rest) < 0;
 	}
+private:
+	const epvector & seq;
 };
 
 //////////
@@ -69,10 +87,7 @@ public:
 
 // public
 
-expairseq::expairseq() 
-#if EXPAIRSEQ_USE_HASHTAB
-	: hashtabsize(0)
-#endif // EXPAIRSEQ_USE_HASHTAB
+expairseq::expairseq()
 {}
 
 // protected
@@ -83,24 +98,6 @@ void expairseq::copy(const expairseq &other)
 {
 	seq = other.seq;
 	overall_coeff = other.overall_coeff;
-#if EXPAIRSEQ_USE_HASHTAB
-	// copy hashtab
-	hashtabsize = other.hashtabsize;
-	if (hashtabsize!=0) {
-		hashmask = other.hashmask;
-		hashtab.resize(hashtabsize);
-		epvector::const_iterator osb = other.seq.begin();
-		for (unsigned i=0; i<hashtabsize; ++i) {
-			hashtab[i].clear();
-			for (epplist::const_iterator cit=other.hashtab[i].begin();
-			     cit!=other.hashtab[i].end(); ++cit) {
-				hashtab[i].push_back(seq.begin()+((*cit)-osb));
-			}
-		}
-	} else {
-		hashtab.clear();
-	}
-#endif // EXPAIRSEQ_USE_HASHTAB
 }
 #endif
 
@@ -133,7 +130,7 @@ expairseq::expairseq(std::auto_ptr<epvector> vp, const ex &oc, bool do_index_ren
 {
 	GINAC_ASSERT(vp.get()!=0);
 	GINAC_ASSERT(is_a<numeric>(oc));
-	construct_from_epvector(*vp, do_index_renaming);
+	construct_from_epvector(vp, do_index_renaming);
 	GINAC_ASSERT(is_canonical());
 }
 
@@ -208,59 +205,6 @@ void expairseq::do_print_tree(const print_tree & c, unsigned level) const
 		overall_coeff.print(c, level + c.delta_indent);
 	}
 	c.s << std::string(level + c.delta_indent,' ') << "=====" << std::endl;
-#if EXPAIRSEQ_USE_HASHTAB
-	c.s << std::string(level + c.delta_indent,' ')
-	    << "hashtab size " << hashtabsize << std::endl;
-	if (hashtabsize == 0) return;
-#define MAXCOUNT 5
-	unsigned count[MAXCOUNT+1];
-	for (int i=0; i<MAXCOUNT+1; ++i)
-		count[i] = 0;
-	unsigned this_bin_fill;
-	unsigned cum_fill_sq = 0;
-	unsigned cum_fill = 0;
-	for (unsigned i=0; i<hashtabsize; ++i) {
-		this_bin_fill = 0;
-		if (hashtab[i].size() > 0) {
-			c.s << std::string(level + c.delta_indent, ' ')
-			    << "bin " << i << " with entries ";
-			for (epplist::const_iterator it=hashtab[i].begin();
-			     it!=hashtab[i].end(); ++it) {
-				c.s << *it-seq.begin() << " ";
-				++this_bin_fill;
-			}
-			c.s << std::endl;
-			cum_fill += this_bin_fill;
-			cum_fill_sq += this_bin_fill*this_bin_fill;
-		}
-		if (this_bin_fill<MAXCOUNT)
-			++count[this_bin_fill];
-		else
-			++count[MAXCOUNT];
-	}
-	unsigned fact = 1;
-	double cum_prob = 0;
-	double lambda = (1.0*seq.size()) / hashtabsize;
-	for (int k=0; k<MAXCOUNT; ++k) {
-		if (k>0)
-			fact *= k;
-		double prob = std::pow(lambda,k)/fact * std::exp(-lambda);
-		cum_prob += prob;
-		c.s << std::string(level + c.delta_indent, ' ') << "bins with " << k << " entries: "
-		    << int(1000.0*count[k]/hashtabsize)/10.0 << "% (expected: "
-		    << int(prob*1000)/10.0 << ")" << std::endl;
-	}
-	c.s << std::string(level + c.delta_indent, ' ') << "bins with more entries: "
-	    << int(1000.0*count[MAXCOUNT]/hashtabsize)/10.0 << "% (expected: "
-	    << int((1-cum_prob)*1000)/10.0 << ")" << std::endl;
-
-	c.s << std::string(level + c.delta_indent, ' ') << "variance: "
-	    << 1.0/hashtabsize*cum_fill_sq-(1.0/hashtabsize*cum_fill)*(1.0/hashtabsize*cum_fill)
-	    << std::endl;
-	c.s << std::string(level + c.delta_indent, ' ') << "average fill: "
-	    << (1.0*cum_fill)/hashtabsize
-	    << " (should be equal to " << (1.0*seq.size())/hashtabsize << ")" << std::endl;
-#endif // EXPAIRSEQ_USE_HASHTAB
 }
 
 bool expairseq::info(unsigned inf) const
@@ -288,6 +232,18 @@ bool expairseq::info(unsigned inf) const
 	return inherited::info(inf);
 }
 
+/** The rests and coefficients of the pairs and the overall coefficient, from
+ *  which op() constructs the operands. */
+void expairseq::stored_operands(exvector & v) const
+{
+	v.reserve(v.size() + 2 * seq.size() + 1);
+	for (epvector::const_iterator i = seq.begin(); i != seq.end(); ++i) {
+		v.push_back(i->rest);
+		v.push_back(i->coeff);
+	}
+	v.push_back(overall_coeff);
+}
+
 size_t expairseq::nops() const
 {
 	if (overall_coeff.is_equal(default_overall_coeff()))
@@ -400,32 +356,62 @@ bool expairseq::match(const ex & pattern, exmap & repl_lst) const
 		// does. So, save repl_lst in order to not add bogus entries.
 		exmap tmp_repl = repl_lst;
 
-		// Unfortunately, this is an O(N^2) operation because we can't
-		// sort the pattern in a useful way...
-
 		// Chop into terms
 		exvector ops;
 		ops.reserve(nops());
 		for (size_t i=0; i<nops(); i++)
 			ops.push_back(op(i));
-
-		// Now, for every term of the pattern, look for a matching term in
-		// the expression and remove the match
+		std::vector<bool> used(ops.size(), false);
+
+		// Terms of the pattern without wildcards only match equal terms,
+		// which are looked up by their hash values first
+		std::vector<std::pair<unsigned, size_t> > hashes;
+		hashes.reserve(ops.size());
+		for (size_t i=0; i<ops.size(); i++)
+			hashes.push_back(std::make_pair(ops[i].gethash(), i));
+		std::sort(hashes.begin(), hashes.end());
+		exvector wild_terms;
 		for (size_t i=0; i<pattern.nops(); i++) {
 			ex p = pattern.op(i);
 			if (has_global_wildcard && p.is_equal(global_wildcard))
 				continue;
-			exvector::iterator it = ops.begin(), itend = ops.end();
-			while (it != itend) {
-				if (it->match(p, tmp_repl)) {
-					ops.erase(it);
+			if (haswild(p)) {
+				wild_terms.push_back(p);
+				continue;
+			}
+			std::vector<std::pair<unsigned, size_t> >::const_iterator it
+				= std::lower_bound(hashes.begin(), hashes.end(), std::make_pair(p.gethash(), size_t(0)));
+			for (; it != hashes.end() && it->first == p.gethash(); ++it) {
+				if (!used[it->second] && ops[it->second].is_equal(p)) {
+					used[it->second] = true;
+					goto found_equal;
+				}
+			}
+			wild_terms.push_back(p); // try it like the others
+found_equal: ;
+		}
+
+		// Now, for every other term of the pattern, look for a matching
+		// term in the expression and remove the match (this is O(N^2)
+		// because we can't sort the pattern in a useful way...)
+		for (exvector::const_iterator p = wild_terms.begin(); p != wild_terms.end(); ++p) {
+			for (size_t j=0; j<ops.size(); j++) {
+				if (!used[j] && ops[j].match(*p, tmp_repl)) {
+					used[j] = true;
 					goto found;
 				}
-				++it;
 			}
 			return false; // no match found
 found:		;
 		}
+		size_t num_used = 0;
+		for (size_t j=0; j<ops.size(); j++) {
+			if (used[j])
+				++num_used;
+			else
+				ops[j - num_used].swap(ops[j]);
+		}
+		ops.resize(ops.size() - num_used);
 
 		if (has_global_wildcard) {
 
@@ -494,10 +480,6 @@ int expairseq::compare_same_type(const basic &other) const
 	if (cmpval!=0)
 		return cmpval;
 	
-#if EXPAIRSEQ_USE_HASHTAB
-	GINAC_ASSERT(hashtabsize==o.hashtabsize);
-	if (hashtabsize==0) {
-#endif // EXPAIRSEQ_USE_HASHTAB
 		epvector::const_iterator cit1 = seq.begin();
 		epvector::const_iterator cit2 = o.seq.begin();
 		epvector::const_iterator last1 = seq.end();
@@ -512,36 +494,6 @@ int expairseq::compare_same_type(const basic &other) const
 		GINAC_ASSERT(cit2==last2);
 		
 		return 0;
-#if EXPAIRSEQ_USE_HASHTAB
-	}
-	
-	// compare number of elements in each hashtab entry
-	for (unsigned i=0; i<hashtabsize; ++i) {
-		unsigned cursize=hashtab[i].size();
-		if (cursize != o.hashtab[i].size())
-			return (cursize < o.hashtab[i].size()) ? -1 : 1;
-	}
-	
-	// compare individual (sorted) hashtab entries
-	for (unsigned i=0; i<hashtabsize; ++i) {
-		unsigned sz = hashtab[i].size();
-		if (sz>0) {
-			const epplist &eppl1 = hashtab[i];
-			const epplist &eppl2 = o.hashtab[i];
-			epplist::const_iterator it1 = eppl1.begin();
-			epplist::const_iterator it2 = eppl2.begin();
-			while (it1!=eppl1.end()) {
-				cmpval = (*(*it1)).compare(*(*it2));
-				if (cmpval!=0)
-					return cmpval;
-				++it1;
-				++it2;
-			}
-		}
-	}
-	
-	return 0; // equal
-#endif // EXPAIRSEQ_USE_HASHTAB
 }
 
 bool expairseq::is_equal_same_type(const basic &other) const
@@ -556,19 +508,6 @@ bool expairseq::is_equal_same_type(const basic &other) const
 	if (!overall_coeff.is_equal(o.overall_coeff))
 		return false;
 	
-#if EXPAIRSEQ_USE_HASHTAB
-	// compare number of elements in each hashtab entry
-	if (hashtabsize!=o.hashtabsize) {
-		std::cout << "this:" << std::endl;
-		print(print_tree(std::cout));
-		std::cout << "other:" << std::endl;
-		other.print(print_tree(std::cout));
-	}
-		
-	GINAC_ASSERT(hashtabsize==o.hashtabsize);
-	
-	if (hashtabsize==0) {
-#endif // EXPAIRSEQ_USE_HASHTAB
 		epvector::const_iterator cit1 = seq.begin();
 		epvector::const_iterator cit2 = o.seq.begin();
 		epvector::const_iterator last1 = seq.end();
@@ -580,32 +519,6 @@ bool expairseq::is_equal_same_type(const basic &other) const
 		}
 		
 		return true;
-#if EXPAIRSEQ_USE_HASHTAB
-	}
-	
-	for (unsigned i=0; i<hashtabsize; ++i) {
-		if (hashtab[i].size() != o.hashtab[i].size())
-			return false;
-	}
-
-	// compare individual sorted hashtab entries
-	for (unsigned i=0; i<hashtabsize; ++i) {
-		unsigned sz = hashtab[i].size();
-		if (sz>0) {
-			const epplist &eppl1 = hashtab[i];
-			const epplist &eppl2 = o.hashtab[i];
-			epplist::const_iterator it1 = eppl1.begin();
-			epplist::const_iterator it2 = eppl2.begin();
-			while (it1!=eppl1.end()) {
-				if (!(*(*it1)).is_equal(*(*it2))) return false;
-				++it1;
-				++it2;
-			}
-		}
-	}
-	
-	return true;
-#endif // EXPAIRSEQ_USE_HASHTAB
 }
 
 unsigned expairseq::return_type() const
@@ -619,12 +532,10 @@ unsigned expairseq::calchash() const
 	epvector::const_iterator i = seq.begin();
 	const epvector::const_iterator end = seq.end();
 	while (i != end) {
-		v ^= i->rest.gethash();
-#if !EXPAIRSEQ_USE_HASHTAB
+		v ^= i->rest_hash();
 		// rotation spoils commutativity!
 		v = rotate_left(v);
 		v ^= i->coeff.gethash();
-#endif // !EXPAIRSEQ_USE_HASHTAB
 		++i;
 	}
 
@@ -639,6 +550,22 @@ unsigned expairseq::calchash() const
 	return v;
 }
 
+/** The coefficients and the overall coefficient are numeric, so only the
+ *  rests count. */
+unsigned expairseq::calc_symbol_mask() const
+{
+	unsigned mask = 0;
+	for (epvector::const_iterator i = seq.begin(); i != seq.end(); ++i)
+		mask |= i->rest.get_symbol_mask();
+
+	if (flags & status_flags::evaluated) {
+		symbolmask = mask;
+		setflag(status_flags::symbols_calculated);
+	}
+
+	return mask;
+}
+
 ex expairseq::expand(unsigned options) const
 {
 	std::auto_ptr<epvector> vp = expandchildren(options);
@@ -741,9 +668,6 @@ ex expairseq::recombine_pair_to_ex(const expair &p) const
 
 bool expairseq::expair_needs_further_processing(epp it)
 {
-#if EXPAIRSEQ_USE_HASHTAB
-	//#  error "FIXME: expair_needs_further_processing not yet implemented for hashtabs, sorry. A.F."
-#endif // EXPAIRSEQ_USE_HASHTAB
 	return false;
 }
 
@@ -785,23 +709,12 @@ void expairseq::construct_from_2_ex_via_exvector(const ex &lh, const ex &rh)
 	v.push_back(lh);
 	v.push_back(rh);
 	construct_from_exvector(v);
-#if EXPAIRSEQ_USE_HASHTAB
-	GINAC_ASSERT((hashtabsize==0)||(hashtabsize>=minhashtabsize));
-	GINAC_ASSERT(hashtabsize==calc_hashtabsize(seq.size()));
-#endif // EXPAIRSEQ_USE_HASHTAB
 }
 
 void expairseq::construct_from_2_ex(const ex &lh, const ex &rh)
 {
 	if (typeid(ex_to<basic>(lh)) == typeid(*this)) {
 		if (typeid(ex_to<basic>(rh)) == typeid(*this)) {
-#if EXPAIRSEQ_USE_HASHTAB
-			unsigned totalsize = ex_to<expairseq>(lh).seq.size() +
-			                     ex_to<expairseq>(rh).seq.size();
-			if (calc_hashtabsize(totalsize)!=0) {
-				construct_from_2_ex_via_exvector(lh,rh);
-			} else {
-#endif // EXPAIRSEQ_USE_HASHTAB
 				if (is_a<mul>(lh) && lh.info(info_flags::has_indices) && 
 					rh.info(info_flags::has_indices)) {
 					ex newrh=rename_dummy_indices_uniquely(lh, rh);
@@ -811,44 +724,16 @@ void expairseq::construct_from_2_ex(const ex &lh, const ex &rh)
 				else
 					construct_from_2_expairseq(ex_to<expairseq>(lh),
 					                           ex_to<expairseq>(rh));
-#if EXPAIRSEQ_USE_HASHTAB
-			}
-#endif // EXPAIRSEQ_USE_HASHTAB
 			return;
 		} else {
-#if EXPAIRSEQ_USE_HASHTAB
-			unsigned totalsize = ex_to<expairseq>(lh).seq.size()+1;
-			if (calc_hashtabsize(totalsize)!=0) {
-				construct_from_2_ex_via_exvector(lh, rh);
-			} else {
-#endif // EXPAIRSEQ_USE_HASHTAB
 				construct_from_expairseq_ex(ex_to<expairseq>(lh), rh);
-#if EXPAIRSEQ_USE_HASHTAB
-			}
-#endif // EXPAIRSEQ_USE_HASHTAB
 			return;
 		}
 	} else if (typeid(ex_to<basic>(rh)) == typeid(*this)) {
-#if EXPAIRSEQ_USE_HASHTAB
-		unsigned totalsize=ex_to<expairseq>(rh).seq.size()+1;
-		if (calc_hashtabsize(totalsize)!=0) {
-			construct_from_2_ex_via_exvector(lh,rh);
-		} else {
-#endif // EXPAIRSEQ_USE_HASHTAB
 			construct_from_expairseq_ex(ex_to<expairseq>(rh),lh);
-#if EXPAIRSEQ_USE_HASHTAB
-		}
-#endif // EXPAIRSEQ_USE_HASHTAB
 		return;
 	}
 	
-#if EXPAIRSEQ_USE_HASHTAB
-	if (calc_hashtabsize(2)!=0) {
-		construct_from_2_ex_via_exvector(lh,rh);
-		return;
-	}
-	hashtabsize = 0;
-#endif // EXPAIRSEQ_USE_HASHTAB
 	
 	if (is_exactly_a<numeric>(lh)) {
 		if (is_exactly_a<numeric>(rh)) {
@@ -866,7 +751,7 @@ void expairseq::construct_from_2_ex(const ex &lh, const ex &rh)
 			expair p1 = split_ex_to_pair(lh);
 			expair p2 = split_ex_to_pair(rh);
 			
-			int cmpval = p1.rest.compare(p2.rest);
+			int cmpval = p1.compare_rest(p2);
 			if (cmpval==0) {
 				p1.coeff = ex_to<numeric>(p1.coeff).add_dyn(ex_to<numeric>(p2.coeff));
 				if (!ex_to<numeric>(p1.coeff).is_zero()) {
@@ -904,7 +789,7 @@ void expairseq::construct_from_2_expairseq(const expairseq &s1,
 	bool needs_further_processing=false;
 	
 	while (first1!=last1 && first2!=last2) {
-		int cmpval = (*first1).rest.compare((*first2).rest);
+		int cmpval = first1->compare_rest(*first2);
 
 		if (cmpval==0) {
 			// combine terms
@@ -937,9 +822,9 @@ void expairseq::construct_from_2_expairseq(const expairseq &s1,
 	}
 	
 	if (needs_further_processing) {
-		epvector v = seq;
-		seq.clear();
-		construct_from_epvector(v);
+		std::auto_ptr<epvector> vp(new epvector);
+		vp->swap(seq);
+		construct_from_epvector(vp);
 	}
 }
 
@@ -964,7 +849,7 @@ void expairseq::construct_from_expairseq_ex(const expairseq &s,
 	
 	// merge p into s.seq
 	while (first!=last) {
-		int cmpval = (*first).rest.compare(p.rest);
+		int cmpval = first->compare_rest(p);
 		if (cmpval==0) {
 			// combine terms
 			const numeric &newcoeff = ex_to<numeric>(first->coeff).
@@ -999,9 +884,9 @@ void expairseq::construct_from_expairseq_ex(const expairseq &s,
 	}
 
 	if (needs_further_processing) {
-		epvector v = seq;
-		seq.clear();
-		construct_from_epvector(v);
+		std::auto_ptr<epvector> vp(new epvector);
+		vp->swap(seq);
+		construct_from_epvector(vp);
 	}
 }
 
@@ -1013,12 +898,12 @@ void expairseq::construct_from_exvector(const exvector &v)
 	//                  (same for (+,*) -> (*,^)
 
 	make_flat(v);
-#if EXPAIRSEQ_USE_HASHTAB
-	combine_same_terms();
-#else
-	canonicalize();
-	combine_same_terms_sorted_seq();
-#endif // EXPAIRSEQ_USE_HASHTAB
+	if (seq.size() >= hash_combine_threshold) {
+		combine_same_terms_hashed();
+	} else {
+		canonicalize();
+		combine_same_terms_sorted_seq();
+	}
 }
 
 void expairseq::construct_from_epvector(const epvector &v, bool do_index_renaming)
@@ -1029,12 +914,24 @@ void expairseq::construct_from_epvector(const epvector &v, bool do_index_renamin
 	//                  same for (+,*) -> (*,^)
 
 	make_flat(v, do_index_renaming);
-#if EXPAIRSEQ_USE_HASHTAB
-	combine_same_terms();
-#else
-	canonicalize();
-	combine_same_terms_sorted_seq();
-#endif // EXPAIRSEQ_USE_HASHTAB
+	if (seq.size() >= hash_combine_threshold) {
+		combine_same_terms_hashed();
+	} else {
+		canonicalize();
+		combine_same_terms_sorted_seq();
+	}
+}
+
+/** Same as above, but the epvector pointed to by vp may be consumed. */
+void expairseq::construct_from_epvector(std::auto_ptr<epvector> vp, bool do_index_renaming)
+{
+	make_flat(vp, do_index_renaming);
+	if (seq.size() >= hash_combine_threshold) {
+		combine_same_terms_hashed();
+	} else {
+		canonicalize();
+		combine_same_terms_sorted_seq();
+	}
 }
 
 /** Combine this expairseq with argument exvector.
@@ -1151,10 +1048,44 @@ void expairseq::make_flat(const epvector &v, bool do_index_renaming)
 	}
 }
 
+/** Combine this expairseq with the epvector pointed to by vp, which may be
+ *  consumed.  If none of its elements needs to be flattened or to have its
+ *  dummy indices renamed, the vector is taken over instead of copied. */
+void expairseq::make_flat(std::auto_ptr<epvector> vp, bool do_index_renaming)
+{
+	GINAC_ASSERT(seq.empty());
+	for (epvector::const_iterator cit = vp->begin(); cit != vp->end(); ++cit) {
+		if (typeid(ex_to<basic>(cit->rest)) == typeid(*this) ||
+		    cit->is_canonical_numeric() ||
+		    (do_index_renaming && is_a<mul>(*this) &&
+		     cit->rest.info(info_flags::has_indices))) {
+			make_flat(*vp, do_index_renaming);
+			return;
+		}
+	}
+	seq.swap(*vp);
+}
+
 /** Brings this expairseq into a sorted (canonical) form. */
 void expairseq::canonicalize()
 {
-	std::sort(seq.begin(), seq.end(), expair_rest_is_less());
+	if (seq.size() < hash_sort_threshold) {
+		std::sort(seq.begin(), seq.end(), expair_rest_is_less());
+		return;
+	}
+
+	// Sort a compact array of the hash values, so that the objects are only
+	// looked at for terms with the same hash value
+	std::vector<hash_position> keys;
+	keys.reserve(seq.size());
+	for (std::size_t i = 0; i < seq.size(); ++i)
+		keys.push_back(hash_position(seq[i].rest_hash(), i));
+	std::sort(keys.begin(), keys.end(), hash_position_is_less(seq));
+
+	epvector sorted(seq.size());
+	for (std::size_t i = 0; i < keys.size(); ++i)
+		sorted[i].swap(seq[keys[i].second]);
+	seq.swap(sorted);
 }
 
 
@@ -1176,7 +1107,7 @@ void expairseq::combine_same_terms_sorted_seq()
 	// possible from then on the sequence has changed and must be compacted
 	bool must_copy = false;
 	while (itin2!=last) {
-		if (itin1->rest.compare(itin2->rest)==0) {
+		if (itin1->compare_rest(*itin2)==0) {
 			itin1->coeff = ex_to<numeric>(itin1->coeff).
 			               add_dyn(ex_to<numeric>(itin2->coeff));
 			if (expair_needs_further_processing(itin1))
@@ -1201,321 +1132,74 @@ void expairseq::combine_same_terms_sorted_seq()
 		seq.erase(itout,last);
 
 	if (needs_further_processing) {
-		epvector v = seq;
-		seq.clear();
-		construct_from_epvector(v);
+		std::auto_ptr<epvector> vp(new epvector);
+		vp->swap(seq);
+		construct_from_epvector(vp);
 	}
 }
 
-#if EXPAIRSEQ_USE_HASHTAB
-
-unsigned expairseq::calc_hashtabsize(unsigned sz) const
-{
-	unsigned size;
-	unsigned nearest_power_of_2 = 1 << log2(sz);
-	// if (nearest_power_of_2 < maxhashtabsize/hashtabfactor) {
-	//  size = nearest_power_of_2*hashtabfactor;
-	size = nearest_power_of_2/hashtabfactor;
-	if (size<minhashtabsize)
-		return 0;
-
-	// hashtabsize must be a power of 2
-	GINAC_ASSERT((1U << log2(size))==size);
-	return size;
-}
 
-unsigned expairseq::calc_hashindex(const ex &e) const
+/** Combine all matching expairs to one each, like
+ *  combine_same_terms_sorted_seq(), but without presorting the sequence.
+ *  Each term is looked up in an open addressing hash table holding the
+ *  positions of the distinct terms seen so far, which are compacted at the
+ *  front of seq.  Only the distinct terms are sorted afterwards, which pays
+ *  off for long sequences with many terms to combine. */
+void expairseq::combine_same_terms_hashed()
 {
-	// calculate hashindex
-	unsigned hashindex;
-	if (is_a<numeric>(e)) {
-		hashindex = hashmask;
-	} else {
-		hashindex = e.gethash() & hashmask;
-		// last hashtab entry is reserved for numerics
-		if (hashindex==hashmask) hashindex = 0;
-	}
-	GINAC_ASSERT((hashindex<hashtabsize)||(hashtabsize==0));
-	return hashindex;
-}
+	const std::size_t n = seq.size();
+	std::size_t tabsize = 1;
+	while (tabsize < 2*n)
+		tabsize <<= 1;
+	const std::size_t mask = tabsize - 1;
 
-void expairseq::shrink_hashtab()
-{
-	unsigned new_hashtabsize;
-	while (hashtabsize!=(new_hashtabsize=calc_hashtabsize(seq.size()))) {
-		GINAC_ASSERT(new_hashtabsize<hashtabsize);
-		if (new_hashtabsize==0) {
-			hashtab.clear();
-			hashtabsize = 0;
-			canonicalize();
-			return;
-		}
-		
-		// shrink by a factor of 2
-		unsigned half_hashtabsize = hashtabsize/2;
-		for (unsigned i=0; i<half_hashtabsize-1; ++i)
-			hashtab[i].merge(hashtab[i+half_hashtabsize],epp_is_less());
-		// special treatment for numeric hashes
-		hashtab[0].merge(hashtab[half_hashtabsize-1],epp_is_less());
-		hashtab[half_hashtabsize-1] = hashtab[hashtabsize-1];
-		hashtab.resize(half_hashtabsize);
-		hashtabsize = half_hashtabsize;
-		hashmask = hashtabsize-1;
-	}
-}
+	// position + 1 of a distinct term in seq, 0 if the slot is empty
+	std::vector<std::size_t> tab(tabsize, 0);
 
-void expairseq::remove_hashtab_entry(epvector::const_iterator element)
-{
-	if (hashtabsize==0)
-		return; // nothing to do
-	
-	// calculate hashindex of element to be deleted
-	unsigned hashindex = calc_hashindex((*element).rest);
-
-	// find it in hashtab and remove it
-	epplist &eppl = hashtab[hashindex];
-	epplist::iterator epplit = eppl.begin();
-	bool erased = false;
-	while (epplit!=eppl.end()) {
-		if (*epplit == element) {
-			eppl.erase(epplit);
-			erased = true;
-			break;
-		}
-		++epplit;
-	}
-	if (!erased) {
-		std::cout << "tried to erase " << element-seq.begin() << std::endl;
-		std::cout << "size " << seq.end()-seq.begin() << std::endl;
-
-		unsigned hashindex = calc_hashindex(element->rest);
-		epplist &eppl = hashtab[hashindex];
-		epplist::iterator epplit = eppl.begin();
-		bool erased = false;
-		while (epplit!=eppl.end()) {
-			if (*epplit == element) {
-				eppl.erase(epplit);
-				erased = true;
+	bool needs_further_processing = false;
+	std::size_t distinct = 0;
+	for (std::size_t i = 0; i < n; ++i) {
+		std::size_t slot = seq[i].rest_hash() & mask;
+		while (true) {
+			const std::size_t pos = tab[slot];
+			if (pos == 0) {
+				if (i != distinct)
+					seq[distinct].swap(seq[i]);
+				tab[slot] = ++distinct;
 				break;
 			}
-			++epplit;
-		}
-		GINAC_ASSERT(erased);
-	}
-	GINAC_ASSERT(erased);
-}
-
-void expairseq::move_hashtab_entry(epvector::const_iterator oldpos,
-                                   epvector::iterator newpos)
-{
-	GINAC_ASSERT(hashtabsize!=0);
-	
-	// calculate hashindex of element which was moved
-	unsigned hashindex=calc_hashindex((*newpos).rest);
-
-	// find it in hashtab and modify it
-	epplist &eppl = hashtab[hashindex];
-	epplist::iterator epplit = eppl.begin();
-	while (epplit!=eppl.end()) {
-		if (*epplit == oldpos) {
-			*epplit = newpos;
-			break;
-		}
-		++epplit;
-	}
-	GINAC_ASSERT(epplit!=eppl.end());
-}
-
-void expairseq::sorted_insert(epplist &eppl, epvector::const_iterator elem)
-{
-	epplist::const_iterator current = eppl.begin();
-	while ((current!=eppl.end()) && ((*current)->is_less(*elem))) {
-		++current;
-	}
-	eppl.insert(current,elem);
-}    
-
-void expairseq::build_hashtab_and_combine(epvector::iterator &first_numeric,
-                                          epvector::iterator &last_non_zero,
-                                          std::vector<bool> &touched,
-                                          unsigned &number_of_zeroes)
-{
-	epp current = seq.begin();
-
-	while (current!=first_numeric) {
-		if (is_exactly_a<numeric>(current->rest)) {
-			--first_numeric;
-			iter_swap(current,first_numeric);
-		} else {
-			// calculate hashindex
-			unsigned currenthashindex = calc_hashindex(current->rest);
-
-			// test if there is already a matching expair in the hashtab-list
-			epplist &eppl=hashtab[currenthashindex];
-			epplist::iterator epplit = eppl.begin();
-			while (epplit!=eppl.end()) {
-				if (current->rest.is_equal((*epplit)->rest))
-					break;
-				++epplit;
-			}
-			if (epplit==eppl.end()) {
-				// no matching expair found, append this to end of list
-				sorted_insert(eppl,current);
-				++current;
-			} else {
-				// epplit points to a matching expair, combine it with current
-				(*epplit)->coeff = ex_to<numeric>((*epplit)->coeff).
-				                   add_dyn(ex_to<numeric>(current->coeff));
-				
-				// move obsolete current expair to end by swapping with last_non_zero element
-				// if this was a numeric, it is swapped with the expair before first_numeric 
-				iter_swap(current,last_non_zero);
-				--first_numeric;
-				if (first_numeric!=last_non_zero) iter_swap(first_numeric,current);
-				--last_non_zero;
-				++number_of_zeroes;
-				// test if combined term has coeff 0 and can be removed is done later
-				touched[(*epplit)-seq.begin()] = true;
+			epvector::iterator it = seq.begin() + (pos - 1);
+			if (it->rest_hash() == seq[i].rest_hash() && it->rest.is_equal(seq[i].rest)) {
+				it->coeff = ex_to<numeric>(it->coeff).
+				            add_dyn(ex_to<numeric>(seq[i].coeff));
+				if (expair_needs_further_processing(it))
+					needs_further_processing = true;
+				break;
 			}
+			slot = (slot + 1) & mask;
 		}
 	}
-}
-
-void expairseq::drop_coeff_0_terms(epvector::iterator &first_numeric,
-                                   epvector::iterator &last_non_zero,
-                                   std::vector<bool> &touched,
-                                   unsigned &number_of_zeroes)
-{
-	// move terms with coeff 0 to end and remove them from hashtab
-	// check only those elements which have been touched
-	epp current = seq.begin();
-	size_t i = 0;
-	while (current!=first_numeric) {
-		if (!touched[i]) {
-			++current;
-			++i;
-		} else if (!ex_to<numeric>((*current).coeff).is_zero()) {
-			++current;
-			++i;
-		} else {
-			remove_hashtab_entry(current);
-			
-			// move element to the end, unless it is already at the end
-			if (current!=last_non_zero) {
-				iter_swap(current,last_non_zero);
-				--first_numeric;
-				bool numeric_swapped = first_numeric!=last_non_zero;
-				if (numeric_swapped)
-					iter_swap(first_numeric,current);
-				epvector::iterator changed_entry;
-
-				if (numeric_swapped)
-					changed_entry = first_numeric;
-				else
-					changed_entry = last_non_zero;
-				
-				--last_non_zero;
-				++number_of_zeroes;
 
-				if (first_numeric!=current) {
-
-					// change entry in hashtab which referred to first_numeric or last_non_zero to current
-					move_hashtab_entry(changed_entry,current);
-					touched[current-seq.begin()] = touched[changed_entry-seq.begin()];
-				}
-			} else {
-				--first_numeric;
-				--last_non_zero;
-				++number_of_zeroes;
-			}
+	// drop the terms which cancelled
+	epvector::iterator itout = seq.begin();
+	const epvector::iterator last = seq.begin() + distinct;
+	for (epvector::iterator it = seq.begin(); it != last; ++it) {
+		if (!ex_to<numeric>(it->coeff).is_zero()) {
+			if (itout != it)
+				itout->swap(*it);
+			++itout;
 		}
 	}
-	GINAC_ASSERT(i==current-seq.begin());
-}
+	seq.erase(itout, seq.end());
 
-/** True if one of the coeffs vanishes, otherwise false.
- *  This would be an invariant violation, so this should only be used for
- *  debugging purposes. */
-bool expairseq::has_coeff_0() const
-{
-	epvector::const_iterator i = seq.begin(), end = seq.end();
-	while (i != end) {
-		if (i->coeff.is_zero())
-			return true;
-		++i;
-	}
-	return false;
-}
-
-void expairseq::add_numerics_to_hashtab(epvector::iterator first_numeric,
-                                        epvector::const_iterator last_non_zero)
-{
-	if (first_numeric == seq.end()) return; // no numerics
-	
-	epvector::const_iterator current = first_numeric, last = last_non_zero + 1;
-	while (current != last) {
-		sorted_insert(hashtab[hashmask], current);
-		++current;
-	}
-}
-
-void expairseq::combine_same_terms()
-{
-	// combine same terms, drop term with coeff 0, move numerics to end
-	
-	// calculate size of hashtab
-	hashtabsize = calc_hashtabsize(seq.size());
-	
-	// hashtabsize is a power of 2
-	hashmask = hashtabsize-1;
-	
-	// allocate hashtab
-	hashtab.clear();
-	hashtab.resize(hashtabsize);
-	
-	if (hashtabsize==0) {
+	if (needs_further_processing) {
+		std::auto_ptr<epvector> vp(new epvector);
+		vp->swap(seq);
+		construct_from_epvector(vp);
+	} else
 		canonicalize();
-		combine_same_terms_sorted_seq();
-		GINAC_ASSERT(!has_coeff_0());
-		return;
-	}
-	
-	// iterate through seq, move numerics to end,
-	// fill hashtab and combine same terms
-	epvector::iterator first_numeric = seq.end();
-	epvector::iterator last_non_zero = seq.end()-1;
-	
-	size_t num = seq.size();
-	std::vector<bool> touched(num);
-	
-	unsigned number_of_zeroes = 0;
-	
-	GINAC_ASSERT(!has_coeff_0());
-	build_hashtab_and_combine(first_numeric,last_non_zero,touched,number_of_zeroes);
-	
-	// there should not be any terms with coeff 0 from the beginning,
-	// so it should be safe to skip this step
-	if (number_of_zeroes!=0) {
-		drop_coeff_0_terms(first_numeric,last_non_zero,touched,number_of_zeroes);
-	}
-	
-	add_numerics_to_hashtab(first_numeric,last_non_zero);
-	
-	// pop zero elements
-	for (unsigned i=0; i<number_of_zeroes; ++i) {
-		seq.pop_back();
-	}
-	
-	// shrink hashtabsize to calculated value
-	GINAC_ASSERT(!has_coeff_0());
-	
-	shrink_hashtab();
-	
-	GINAC_ASSERT(!has_coeff_0());
 }
 
-#endif // EXPAIRSEQ_USE_HASHTAB
-
 /** Check if this expairseq is in sorted (canonical) form.  Useful mainly for
  *  debugging or in assertions since being sorted is an invariance. */
 bool expairseq::is_canonical() const
@@ -1523,9 +1207,6 @@ bool expairseq::is_canonical() const
 	if (seq.size() <= 1)
 		return 1;
 	
-#if EXPAIRSEQ_USE_HASHTAB
-	if (hashtabsize > 0) return 1; // not canoncalized
-#endif // EXPAIRSEQ_USE_HASHTAB
 	
 	epvector::const_iterator it = seq.begin(), itend = seq.end();
 	epvector::const_iterator it_last = it;
@@ -1744,14 +1425,4 @@ std::auto_ptr<epvector> expairseq::subschildren(const exmap & m, unsigned option
 	return std::auto_ptr<epvector>(0);
 }
 
-//////////
-// static member variables
-//////////
-
-#if EXPAIRSEQ_USE_HASHTAB
-unsigned expairseq::maxhashtabsize = 0x4000000U;
-unsigned expairseq::minhashtabsize = 0x1000U;
-unsigned expairseq::hashtabfactor = 1;
-#endif // EXPAIRSEQ_USE_HASHTAB
-
 } // namespace GiNaC
@@ -34,21 +34,8 @@
 
 namespace GiNaC {
 
-/** Using hash tables can potentially enhance the asymptotic behaviour of
- *  combining n terms into one large sum (or n terms into one large product)
- *  from O(n*log(n)) to about O(n).  There are, however, several drawbacks.
- *  The constant in front of O(n) is quite large, when copying such an object
- *  one also has to copy the has table, comparison is quite expensive because
- *  there is no ordering any more, it doesn't help at all when combining two
- *  expairseqs because due to the presorted nature the behaviour would be
- *  O(n) anyways, the code is quite messy, etc, etc.  The code is here as
- *  an example for following generations to tinker with. */
-#define EXPAIRSEQ_USE_HASHTAB 0
-
 typedef std::vector<expair> epvector;       ///< expair-vector
 typedef epvector::iterator epp;             ///< expair-vector pointer
-typedef std::list<epp> epplist;             ///< list of expair-vector pointers
-typedef std::vector<epplist> epplistvector; ///< vector of epplist
 
 /** Complex conjugate every element of an epvector. Returns zero if this
  *  does not change anything. */
@@ -77,6 +64,8 @@ public:
 	// functions overriding virtual functions from base classes
 public:
 	unsigned precedence() const {return 10;}
+	std::size_t footprint() const { return object_size() + seq.capacity() * sizeof(expair); }
+	void stored_operands(exvector & v) const;
 	bool info(unsigned inf) const;
 	size_t nops() const;
 	ex op(size_t i) const;
@@ -94,6 +83,7 @@ protected:
 	bool is_equal_same_type(const basic & other) const;
 	unsigned return_type() const;
 	unsigned calchash() const;
+	unsigned calc_symbol_mask() const;
 	ex expand(unsigned options=0) const;
 	
 	// new virtual functions which can be overridden by derived classes
@@ -129,31 +119,13 @@ protected:
 	                                 const ex & e);
 	void construct_from_exvector(const exvector & v);
 	void construct_from_epvector(const epvector & v, bool do_index_renaming = false);
+	void construct_from_epvector(std::auto_ptr<epvector> vp, bool do_index_renaming = false);
 	void make_flat(const exvector & v);
 	void make_flat(const epvector & v, bool do_index_renaming = false);
+	void make_flat(std::auto_ptr<epvector> vp, bool do_index_renaming = false);
 	void canonicalize();
 	void combine_same_terms_sorted_seq();
-#if EXPAIRSEQ_USE_HASHTAB
-	void combine_same_terms();
-	unsigned calc_hashtabsize(unsigned sz) const;
-	unsigned calc_hashindex(const ex & e) const;
-	void shrink_hashtab();
-	void remove_hashtab_entry(epvector::const_iterator element);
-	void move_hashtab_entry(epvector::const_iterator oldpos,
-	                        epvector::iterator newpos);
-	void sorted_insert(epplist & eppl, epvector::const_iterator elem);
-	void build_hashtab_and_combine(epvector::iterator & first_numeric,
-	                               epvector::iterator & last_non_zero,
-	                               vector<bool> & touched,
-	                               unsigned & number_of_zeroes);
-	void drop_coeff_0_terms(epvector::iterator & first_numeric,
-	                        epvector::iterator & last_non_zero,
-	                        vector<bool> & touched,
-	                        unsigned & number_of_zeroes);
-	bool has_coeff_0() const;
-	void add_numerics_to_hashtab(epvector::iterator first_numeric,
-	                             epvector::const_iterator last_non_zero);
-#endif // EXPAIRSEQ_USE_HASHTAB
+	void combine_same_terms_hashed();
 	bool is_canonical() const;
 	std::auto_ptr<epvector> expandchildren(unsigned options) const;
 	std::auto_ptr<epvector> evalchildren(int level) const;
@@ -164,14 +136,6 @@ protected:
 protected:
 	epvector seq;
 	ex overall_coeff;
-#if EXPAIRSEQ_USE_HASHTAB
-	epplistvector hashtab;
-	unsigned hashtabsize;
-	unsigned hashmask;
-	static unsigned maxhashtabsize;
-	static unsigned minhashtabsize;
-	static unsigned hashtabfactor;
-#endif // EXPAIRSEQ_USE_HASHTAB
 };
 
 /** Class to handle the renaming of dummy indices. It holds a vector of
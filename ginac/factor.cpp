@@ -10,9 +10,10 @@
  *  coefficients integer. Then, depending on the number of free variables it
  *  proceeds either in dedicated univariate or multivariate factorization code.
  *
- *  Univariate factorization does a modular factorization via Berlekamp's
- *  algorithm and distinct degree factorization. Hensel lifting is used at the
- *  end.
+ *  Univariate factorization does a modular factorization via distinct degree
+ *  factorization followed by the Cantor-Zassenhaus algorithm or (for small
+ *  degrees) Berlekamp's algorithm. Hensel lifting is used at the end. Many
+ *  modular factors are recombined by lattice reduction.
  *  
  *  Multivariate factorization uses the univariate factorization (applying a
  *  evaluation homomorphism first) and Hensel lifting raises the answer to the
@@ -30,6 +31,15 @@
  *          M.Mignotte, 
  *          In "Computer Algebra, Symbolic and Algebraic Computation" (B.Buchberger et al., eds.),
  *          pp. 259-263, Springer-Verlag, New York, 1982.
+ *    [vzGG] Modern Computer Algebra,
+ *          J.von zur Gathen, J.Gerhard,
+ *          Cambridge University Press, 1999.
+ *    [vH]  Factoring polynomials and the knapsack problem,
+ *          M.van Hoeij,
+ *          J. Number Theory 95 (2002) 167--189.
+ *    [Zip] Probabilistic algorithms for sparse polynomials,
+ *          R.Zippel,
+ *          Proc. EUROSAM '79, LNCS 72, pp. 216-226, Springer-Verlag, 1979.
  */
 
 /*
@@ -52,6 +62,10 @@
 
 //#define DEBUGFACTOR
 
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
 #include "factor.h"
 
 #include "ex.h"
@@ -64,15 +78,33 @@
 #include "mul.h"
 #include "normal.h"
 #include "add.h"
+#include "archive.h"
+#include "budget.h"
+#include "lst.h"
+#include "profile.h"
+#include "utils.h"
+#include "polynomial/karatsuba.h"
+#include "polynomial/half_gcd.h"
+#include "polynomial/sparse_poly.h"
+#include "polynomial/zp_word.h"
 
 #include <algorithm>
 #include <cmath>
+#include <ctime>
 #include <limits>
 #include <list>
+#include <map>
+#include <stdexcept>
+#include <string>
 #include <vector>
 #ifdef DEBUGFACTOR
 #include <ostream>
 #endif
+#if defined(GINAC_THREADSAFE_REFCOUNT) && defined(HAVE_PTHREAD_H)
+// The trials are only run concurrently if expressions may be shared
+// between threads at all.
+#define PARALLEL_TRIALS 1
+#endif
 using namespace std;
 
 #include <cln/cln.h>
@@ -132,6 +164,85 @@ ostream& operator<<(ostream& o, const vector< vector<cl_MI> >& v)
 #define DCOUT2(str,var)
 #endif // def DEBUGFACTOR
 
+static unsigned factor_threads = 1;
+
+/** Set the number of threads factor() uses for trying several primes and
+ *  several evaluation points at once.  This has an effect only if GiNaC was
+ *  built with GINAC_THREADSAFE_REFCOUNT and pthreads.
+ *
+ *  @return previous setting */
+unsigned set_factor_threads(unsigned n)
+{
+	const unsigned previous = factor_threads;
+	factor_threads = (n == 0 ? 1 : n);
+	return previous;
+}
+
+/** Get the number of threads used by factor(). */
+unsigned get_factor_threads()
+{
+	return factor_threads;
+}
+
+// processor time spent in the phases of factor(), in clock ticks
+static long modular_ticks = 0;
+static long lifting_ticks = 0;
+static long recombination_ticks = 0;
+
+static void add_ticks(long& counter, long ticks)
+{
+#ifdef GINAC_THREADSAFE_REFCOUNT
+	__sync_fetch_and_add(&counter, ticks);
+#else
+	counter += ticks;
+#endif
+}
+
+/** Adds the processor time of its lifetime to one of the phase counters.
+ */
+class phase_timer {
+public:
+	phase_timer(long& counter_) : counter(counter_), start(clock()) { }
+	~phase_timer() { add_ticks(counter, clock() - start); }
+private:
+	long& counter;
+	clock_t start;
+};
+
+/** Adds the processor time of its lifetime to the recombination counter,
+ *  except for the lifting done meanwhile, which goes to the lifting counter.
+ */
+class recombination_timer {
+public:
+	recombination_timer() : start(clock()), lifting(0) { }
+	~recombination_timer()
+	{
+		add_ticks(lifting_ticks, lifting);
+		add_ticks(recombination_ticks, clock() - start - lifting);
+	}
+	void start_lifting() { lifting_start = clock(); }
+	void stop_lifting() { lifting += clock() - lifting_start; }
+private:
+	clock_t start, lifting_start;
+	long lifting;
+};
+
+/** Get the processor time factor() has spent in its phases. */
+factor_timing_statistics get_factor_timing_statistics()
+{
+	factor_timing_statistics stats;
+	stats.modular = double(modular_ticks) / CLOCKS_PER_SEC;
+	stats.lifting = double(lifting_ticks) / CLOCKS_PER_SEC;
+	stats.recombination = double(recombination_ticks) / CLOCKS_PER_SEC;
+	return stats;
+}
+
+/** Reset the phase timings of factor(). */
+void reset_factor_timing_statistics()
+{
+	modular_ticks = lifting_ticks = recombination_ticks = 0;
+}
+
 // anonymous namespace to hide all utility functions
 namespace {
 
@@ -313,14 +424,9 @@ static upoly operator*(const upoly& a, const upoly& b)
 	upoly c;
 	if ( a.empty() || b.empty() ) return c;
 
-	int n = degree(a) + degree(b);
-	c.resize(n+1, 0);
-	for ( int i=0 ; i<=n; ++i ) {
-		for ( int j=0 ; j<=i; ++j ) {
-			if ( j > degree(a) || (i-j) > degree(b) ) continue;
-			c[i] = c[i] + a[j] * b[i-j];
-		}
-	}
+	const cl_I zero = 0;
+	c.resize(a.size() + b.size() - 1, zero);
+	mul_add(&a[0], a.size(), &b[0], b.size(), &c[0], zero);
 	canonicalize(c);
 	return c;
 }
@@ -330,14 +436,9 @@ static umodpoly operator*(const umodpoly& a, const umodpoly& b)
 	umodpoly c;
 	if ( a.empty() || b.empty() ) return c;
 
-	int n = degree(a) + degree(b);
-	c.resize(n+1, a[0].ring()->zero());
-	for ( int i=0 ; i<=n; ++i ) {
-		for ( int j=0 ; j<=i; ++j ) {
-			if ( j > degree(a) || (i-j) > degree(b) ) continue;
-			c[i] = c[i] + a[j] * b[i-j];
-		}
-	}
+	const cl_MI zero = a[0].ring()->zero();
+	c.resize(a.size() + b.size() - 1, zero);
+	mul_add(&a[0], a.size(), &b[0], b.size(), &c[0], zero);
 	canonicalize(c);
 	return c;
 }
@@ -506,6 +607,79 @@ static void reduce_coeff(umodpoly& a, const cl_I& x)
 	}
 }
 
+/** Divisions a/b where both the quotient and the divisor have at least
+ *  this degree are done by Newton iteration. The inverse is recomputed for
+ *  every division, so this pays off for really large degrees only. */
+static int fast_division_threshold = 2048;
+
+/** Set the degree from which factor() divides polynomials modulo primes
+ *  by Newton iteration instead of classical division (default 2048).
+ *
+ *  @return previous setting */
+unsigned set_factor_division_threshold(unsigned n)
+{
+	const unsigned previous = fast_division_threshold;
+	fast_division_threshold = (n == 0 ? 1 : n);
+	return previous;
+}
+
+/** Calculates the power series inverse of f modulo x^m by Newton
+ *  iteration, g <- g - g*(f*g - 1). Assertion: f[0] is not zero.
+ */
+static void series_inverse(const umodpoly& f, int m, umodpoly& g)
+{
+	const cl_MI zero = f[0].ring()->zero();
+	g.assign(1, recip(f[0]));
+	for ( int l=1; l<m; ) {
+		l = min(2*l, m);
+		umodpoly fl(f.begin(), f.begin() + min<size_t>(f.size(), l));
+		umodpoly e(fl.size() + g.size() - 1, zero);
+		mul_add(&fl[0], fl.size(), &g[0], g.size(), &e[0], zero);
+		// The lower coefficients of f*g - 1 vanish already
+		const size_t done = g.size();
+		e.resize(l, zero);
+		umodpoly eh(e.begin() + done, e.end());
+		umodpoly ge(g.size() + eh.size() - 1, zero);
+		mul_add(&g[0], g.size(), &eh[0], eh.size(), &ge[0], zero);
+		g.resize(l, zero);
+		for ( size_t i=done; i<(size_t)l; ++i ) {
+			g[i] = g[i] - ge[i-done];
+		}
+	}
+}
+
+/** Calculates quotient q and (if r is not null) remainder of a/b via the
+ *  reversed polynomials, rev(q) = rev(a)/rev(b) mod x^(deg(a)-deg(b)+1).
+ *  Assertion: deg(a) >= deg(b).
+ */
+static void fast_remdiv(const umodpoly& a, const umodpoly& b, umodpoly* r, umodpoly& q)
+{
+	const cl_MI zero = a[0].ring()->zero();
+	const int n = degree(b);
+	const int k = degree(a) - n;
+	umodpoly revb(b.rbegin(), b.rend());
+	umodpoly inv;
+	series_inverse(revb, k+1, inv);
+	umodpoly reva(a.rbegin(), a.rbegin() + k + 1);
+	umodpoly revq(reva.size() + inv.size() - 1, zero);
+	mul_add(&reva[0], reva.size(), &inv[0], inv.size(), &revq[0], zero);
+	q.assign(revq.rend() - (k + 1), revq.rend());
+	canonicalize(q);
+	if ( r ) {
+		// only the coefficients below x^n of a - q*b survive
+		*r = a;
+		r->resize(n, zero);
+		if ( !q.empty() ) {
+			umodpoly qb(q.size() + b.size() - 1, zero);
+			mul_add(&q[0], q.size(), &b[0], b.size(), &qb[0], zero);
+			for ( int i=0; i<n; ++i ) {
+				(*r)[i] = (*r)[i] - qb[i];
+			}
+		}
+		canonicalize(*r);
+	}
+}
+
 /** Calculates remainder of a/b.
  *  Assertion: a and b not empty.
  *
@@ -515,6 +689,12 @@ static void reduce_coeff(umodpoly& a, const cl_I& x)
  */
 static void rem(const umodpoly& a, const umodpoly& b, umodpoly& r)
 {
+	if ( degree(b) >= fast_division_threshold && degree(a) - degree(b) >= fast_division_threshold ) {
+		umodpoly q;
+		fast_remdiv(a, b, &r, q);
+		return;
+	}
+
 	int k, n;
 	n = degree(b);
 	k = degree(a) - n;
@@ -544,6 +724,11 @@ static void rem(const umodpoly& a, const umodpoly& b, umodpoly& r)
  */
 static void div(const umodpoly& a, const umodpoly& b, umodpoly& q)
 {
+	if ( degree(b) >= fast_division_threshold && degree(a) - degree(b) >= fast_division_threshold ) {
+		fast_remdiv(a, b, 0, q);
+		return;
+	}
+
 	int k, n;
 	n = degree(b);
 	k = degree(a) - n;
@@ -576,6 +761,11 @@ static void div(const umodpoly& a, const umodpoly& b, umodpoly& q)
  */
 static void remdiv(const umodpoly& a, const umodpoly& b, umodpoly& r, umodpoly& q)
 {
+	if ( degree(b) >= fast_division_threshold && degree(a) - degree(b) >= fast_division_threshold ) {
+		fast_remdiv(a, b, &r, q);
+		return;
+	}
+
 	int k, n;
 	n = degree(b);
 	k = degree(a) - n;
@@ -610,6 +800,11 @@ static void gcd(const umodpoly& a, const umodpoly& b, umodpoly& c)
 {
 	if ( degree(a) < degree(b) ) return gcd(b, a, c);
 
+	if ( degree(b) >= half_gcd_threshold ) {
+		half_gcd(c, a, b);
+		return;
+	}
+
 	c = a;
 	normalize_in_field(c);
 	umodpoly d = b;
@@ -808,9 +1003,117 @@ ostream& operator<<(ostream& o, const modular_matrix& m)
 }
 #endif // def DEBUGFACTOR
 
+/** Dense square matrix over Z/p for a word sized prime p, see zp_word_ring.
+ *  The entries are kept in Montgomery representation, row by row. All
+ *  operations work on whole rows, the inner loops are plain loops over words
+ *  without branches, so that the compiler can vectorize them.
+ */
+class word_matrix
+{
+public:
+	word_matrix(size_t n_, const zp_word_ring& R_) : n(n_), R(R_), m(n_*n_, 0) { }
+	size_t size() const { return n; }
+	const zp_word_ring& ring() const { return R; }
+	uint32_t& operator()(size_t row, size_t col) { return m[row*n + col]; }
+	uint32_t operator()(size_t row, size_t col) const { return m[row*n + col]; }
+	uint32_t* row(size_t r) { return &m[r*n]; }
+	void mul_row(size_t row, uint32_t x)
+	{
+		uint32_t* a = &m[row*n];
+		for ( size_t j=0; j<n; ++j ) {
+			a[j] = R.reduce(uint64_t(a[j])*x);
+		}
+	}
+	/** row1 = row1 - fac*row2 */
+	void sub_row(size_t row1, size_t row2, uint32_t fac)
+	{
+		sub_mul(&m[row1*n], &m[row2*n], fac, n, R);
+	}
+	void switch_row(size_t row1, size_t row2)
+	{
+		std::swap_ranges(m.begin() + row1*n, m.begin() + (row1+1)*n, m.begin() + row2*n);
+	}
+	void sub_identity()
+	{
+		const uint32_t one = R.to_repr(1);
+		for ( size_t i=0; i<n; ++i ) {
+			uint32_t& x = m[i*n + i];
+			x = (x >= one ? x - one : x + (R.modulus - one));
+		}
+	}
+	void transpose()
+	{
+		for ( size_t i=0; i<n; ++i ) {
+			for ( size_t j=0; j<i; ++j ) {
+				std::swap(m[i*n + j], m[j*n + i]);
+			}
+		}
+	}
+	bool is_col_zero(size_t col) const
+	{
+		uint32_t x = 0;
+		for ( size_t rr=0; rr<n; ++rr ) {
+			x |= m[rr*n + col];
+		}
+		return x == 0;
+	}
+
+	/** a[j] = a[j] - fac*b[j] for j < len */
+	static void sub_mul(uint32_t* a, const uint32_t* b, uint32_t fac, size_t len, const zp_word_ring& R)
+	{
+		const uint32_t p = R.modulus;
+		for ( size_t j=0; j<len; ++j ) {
+			const uint32_t t = R.reduce(uint64_t(b[j])*fac);
+			const uint32_t d = a[j] - t;
+			a[j] = d + (p & (0U - uint32_t(a[j] < t)));
+		}
+	}
+private:
+	size_t n;
+	const zp_word_ring& R;
+	vector<uint32_t> m;
+};
+
 // END modular matrix
 ////////////////////////////////////////////////////////////////////////////////
 
+/** Checks if the modulus of R is a prime which word_matrix can work with.
+ */
+static bool fits_word(const cl_modint_ring& R)
+{
+	return R->modulus <= 0x7fffffffL && zp_word_ring::fits(cl_I_to_long(R->modulus));
+}
+
+/** Calculates the Q matrix for a polynomial over Z/p, p a word sized prime.
+ *
+ *  @param[in]  a  monic modular polynomial
+ *  @param[out] Q  Q matrix
+ */
+static void q_matrix(const umodpoly& a, word_matrix& Q)
+{
+	const zp_word_ring& R = Q.ring();
+	const size_t n = degree(a);
+	const unsigned int q = R.modulus;
+	vector<uint32_t> aw(n);
+	for ( size_t i=0; i<n; ++i ) {
+		aw[i] = R.to_repr(cl_I_to_uint(a[0].ring()->retract(a[i])));
+	}
+	// r runs through x^m mod a
+	vector<uint32_t> r(n, 0);
+	r[0] = R.to_repr(1);
+	std::copy(r.begin(), r.end(), Q.row(0));
+	const unsigned int max = (n-1) * q;
+	for ( unsigned int m=1; m<=max; ++m ) {
+		const uint32_t rn_1 = r.back();
+		std::copy_backward(r.begin(), r.end()-1, r.end());
+		r[0] = 0;
+		word_matrix::sub_mul(&r[0], &aw[0], rn_1, n, R);
+		if ( (m % q) == 0 ) {
+			std::copy(r.begin(), r.end(), Q.row(m/q));
+		}
+	}
+}
+
 /** Calculates the Q matrix for a polynomial. Used by Berlekamp's algorithm.
  *
  *  @param[in]  a_  modular polynomial
@@ -822,9 +1125,22 @@ static void q_matrix(const umodpoly& a_, modular_matrix& Q)
 	normalize_in_field(a);
 
 	int n = degree(a);
-	unsigned int q = cl_I_to_uint(a[0].ring()->modulus);
-	umodpoly r(n, a[0].ring()->zero());
-	r[0] = a[0].ring()->one();
+	cl_modint_ring R = a[0].ring();
+	if ( fits_word(R) ) {
+		const zp_word_ring Rw(cl_I_to_long(R->modulus));
+		word_matrix Qw(n, Rw);
+		q_matrix(a, Qw);
+		for ( int i=0; i<n; ++i ) {
+			for ( int j=0; j<n; ++j ) {
+				Q(i,j) = R->canonhom(Rw.from_repr(Qw(i,j)));
+			}
+		}
+		return;
+	}
+
+	unsigned int q = cl_I_to_uint(R->modulus);
+	umodpoly r(n, R->zero());
+	r[0] = R->one();
 	Q.set_row(0, r);
 	unsigned int max = (n-1) * q;
 	for ( size_t m=1; m<=max; ++m ) {
@@ -888,6 +1204,59 @@ static void nullspace(modular_matrix& M, vector<mvec>& basis)
 	}
 }
 
+/** Determine the nullspace of a matrix M-1 over Z/p, p a word sized prime.
+ *  This is the same elimination as for modular_matrix, but with the matrix
+ *  transposed, so that the column operations become row operations.
+ *
+ *  @param[in,out] T      transpose of the matrix, will be modified
+ *  @param[in]     R      ring of the basis vectors (modulo the same prime)
+ *  @param[out]    basis  calculated nullspace of M-1
+ */
+static void nullspace(word_matrix& T, const cl_modint_ring& R, vector<mvec>& basis)
+{
+	const zp_word_ring& Rw = T.ring();
+	const size_t n = T.size();
+	T.sub_identity();
+	for ( size_t r=0; r<n; ++r ) {
+		size_t cc = 0;
+		for ( ; cc<n; ++cc ) {
+			if ( T(cc,r) != 0 ) {
+				if ( cc < r ) {
+					if ( T(cc,cc) != 0 ) {
+						continue;
+					}
+					T.switch_row(cc, r);
+				}
+				else if ( cc > r ) {
+					T.switch_row(cc, r);
+				}
+				break;
+			}
+		}
+		if ( cc < n ) {
+			const zp_word pivot(Rw, long(Rw.from_repr(T(r,r))));
+			T.mul_row(r, Rw.to_repr(recip(pivot).retract()));
+			for ( cc=0; cc<n; ++cc ) {
+				const uint32_t fac = T(cc,r);
+				if ( cc != r && fac != 0 ) {
+					T.sub_row(cc, r, fac);
+				}
+			}
+		}
+	}
+
+	T.sub_identity();
+	for ( size_t i=0; i<n; ++i ) {
+		if ( !T.is_col_zero(i) ) {
+			mvec nu(n);
+			for ( size_t j=0; j<n; ++j ) {
+				nu[j] = R->canonhom(Rw.from_repr(T(j,i)));
+			}
+			basis.push_back(nu);
+		}
+	}
+}
+
 /** Berlekamp's modular factorization.
  *  
  *  The implementation follows the algorithm in chapter 8 of [GCL].
@@ -902,10 +1271,21 @@ static void berlekamp(const umodpoly& a, upvec& upv)
 	umodpoly one(1, R->one());
 
 	// find nullspace of Q matrix
-	modular_matrix Q(degree(a), degree(a), R->zero());
-	q_matrix(a, Q);
 	vector<mvec> nu;
-	nullspace(Q, nu);
+	if ( fits_word(R) ) {
+		const zp_word_ring Rw(cl_I_to_long(R->modulus));
+		umodpoly monic = a;
+		normalize_in_field(monic);
+		word_matrix Q(degree(a), Rw);
+		q_matrix(monic, Q);
+		Q.transpose();
+		nullspace(Q, R, nu);
+	}
+	else {
+		modular_matrix Q(degree(a), degree(a), R->zero());
+		q_matrix(a, Q);
+		nullspace(Q, nu);
+	}
 
 	const unsigned int k = nu.size();
 	if ( k == 1 ) {
@@ -1034,23 +1414,54 @@ static void modsqrfree(const umodpoly& a, upvec& factors, vector<int>& mult)
 
 #endif // deactivation of square free factorization
 
+/** Applies the Frobenius map w -> w^q mod a, q the modulus, by a
+ *  vector-matrix product with the Q matrix of a polynomial divisible by a.
+ *  Since w^q = w(x^q) in characteristic q, this is the modular composition
+ *  of w with x^q, which costs O(n^2) operations instead of the O(q n^2) of
+ *  reducing w(x^q).
+ *
+ *  @param[in]  w  polynomial of degree less than the dimension of Q
+ *  @param[in]  Q  Q matrix of a multiple of a
+ *  @param[in]  a  modulus
+ *  @param[out] r  w^q mod a
+ */
+static void frobenius(const umodpoly& w, const modular_matrix& Q, const umodpoly& a, umodpoly& r)
+{
+	const size_t n = Q.colsize();
+	r.assign(n, a[0].ring()->zero());
+	for ( size_t j=0; j<w.size(); ++j ) {
+		if ( zerop(w[j]) ) continue;
+		for ( size_t k=0; k<n; ++k ) {
+			r[k] = r[k] + w[j]*Q(j,k);
+		}
+	}
+	canonicalize(r);
+	if ( degree(r) >= degree(a) ) {
+		umodpoly buf;
+		rem(r, a, buf);
+		r.swap(buf);
+	}
+}
+
 /** Distinct degree factorization (DDF).
  *  
- *  The implementation follows the algorithm in chapter 8 of [GCL].
+ *  The implementation follows the algorithm in chapter 8 of [GCL]. The powers
+ *  x^(q^i) are computed by the Frobenius map.
  *
  *  @param[in]  a_         modular polynomial
  *  @param[out] degrees    vector containing the degrees of the factors of the
  *                         corresponding polynomials in ddfactors.
  *  @param[out] ddfactors  vector containing polynomials which factors have the
  *                         degree given in degrees.
+ *  @param[out] Q          Q matrix of a_
  */
-static void distinct_degree_factor(const umodpoly& a_, vector<int>& degrees, upvec& ddfactors)
+static void distinct_degree_factor(const umodpoly& a_, vector<int>& degrees, upvec& ddfactors, modular_matrix& Q)
 {
 	umodpoly a = a_;
 
 	cl_modint_ring R = a[0].ring();
-	int q = cl_I_to_int(R->modulus);
 	int nhalf = degree(a)/2;
+	q_matrix(a, Q);
 
 	int i = 1;
 	umodpoly w(2);
@@ -1059,9 +1470,8 @@ static void distinct_degree_factor(const umodpoly& a_, vector<int>& degrees, upv
 	umodpoly x = w;
 
 	while ( i <= nhalf ) {
-		expt_pos(w, q);
 		umodpoly buf;
-		rem(w, a, buf);
+		frobenius(w, Q, a, buf);
 		w = buf;
 		umodpoly wx = w - x;
 		gcd(a, wx, buf);
@@ -1085,11 +1495,109 @@ static void distinct_degree_factor(const umodpoly& a_, vector<int>& degrees, upv
 	}
 }
 
+/** Calculates b^e mod a by repeated squaring.
+ *
+ *  @param[in]  b  polynomial of degree less than degree(a)
+ *  @param[in]  e  positive exponent
+ *  @param[in]  a  modulus
+ *  @param[out] r  result
+ */
+static void expt_mod(const umodpoly& b, cl_I e, const umodpoly& a, umodpoly& r)
+{
+	r.assign(1, a[0].ring()->one());
+	umodpoly s = b, buf;
+	while ( true ) {
+		if ( oddp(e) ) {
+			rem(r*s, a, buf);
+			r.swap(buf);
+		}
+		e = e >> 1;
+		if ( zerop(e) ) break;
+		rem(s*s, a, buf);
+		s.swap(buf);
+	}
+}
+
+/** Equal degree factorization by the probabilistic algorithm of Cantor and
+ *  Zassenhaus, see chapter 14 of [vzGG]. For a random polynomial r,
+ *  gcd(a, r^((q^d-1)/2) - 1) is a proper factor of a with probability at
+ *  least 1/2. The power is computed as N^((q-1)/2) where N is the product
+ *  r r^q ... r^(q^(d-1)) of Frobenius images. This needs O(d n^2) instead of
+ *  the O(n^3) operations of Berlekamp's algorithm. The modulus q must be odd.
+ *
+ *  @param[in]  a    monic square free polynomial whose irreducible factors
+ *                   all have degree d
+ *  @param[in]  d    degree of the irreducible factors
+ *  @param[in]  Q    Q matrix of a multiple of a
+ *  @param[out] upv  vector containing modular factors. if upv was not empty the
+ *                   new elements are added at the end
+ */
+static void equal_degree_factor(const umodpoly& a, int d, const modular_matrix& Q, upvec& upv)
+{
+	cl_modint_ring R = a[0].ring();
+	const cl_I e = (R->modulus - 1) >> 1;
+	// The random polynomials come from a generator of our own and not from
+	// rand(), so the modular factors don't depend on what ran before and the
+	// factorization may run in any thread.
+	unsigned long seed = 1;
+
+	list<umodpoly> tosplit;
+	tosplit.push_back(a);
+	while ( !tosplit.empty() ) {
+		umodpoly u = tosplit.front();
+		tosplit.pop_front();
+		const int n = degree(u);
+		if ( n == d ) {
+			upv.push_back(u);
+			continue;
+		}
+		while ( true ) {
+			umodpoly r(n);
+			for ( int i=0; i<n; ++i ) {
+				seed = (seed * 1103515245UL + 12345UL) & 0xffffffffUL;
+				r[i] = R->canonhom(cl_I(long(seed >> 1)));
+			}
+			canonicalize(r);
+			if ( degree(r) < 1 ) continue;
+
+			umodpoly t = r, N = r, buf;
+			for ( int i=1; i<d; ++i ) {
+				frobenius(t, Q, u, buf);
+				t.swap(buf);
+				rem(N*t, u, buf);
+				N.swap(buf);
+			}
+			expt_mod(N, e, u, t);
+			if ( t.empty() ) {
+				continue;
+			}
+			t[0] = t[0] - R->one();
+			canonicalize(t);
+			if ( t.empty() ) {
+				continue;
+			}
+			umodpoly g;
+			gcd(u, t, g);
+			if ( degree(g) > 0 && degree(g) < n ) {
+				div(u, g, buf);
+				tosplit.push_back(g);
+				tosplit.push_back(buf);
+				break;
+			}
+		}
+	}
+}
+
+/** Blocks of factors of the same degree of at least this degree are split by
+ *  the Cantor-Zassenhaus algorithm, smaller ones by Berlekamp's algorithm.
+ */
+static const int equal_degree_threshold = 16;
+
 /** Modular same degree factorization.
  *  Same degree factorization is a kind of misnomer. It performs distinct degree
- *  factorization, but instead of using the Cantor-Zassenhaus algorithm it
- *  (sub-optimally) uses Berlekamp's algorithm for the factors of the same
- *  degree.
+ *  factorization, and then splits the factors of the same degree by the
+ *  Cantor-Zassenhaus algorithm, or for small degrees by Berlekamp's
+ *  algorithm.
  *
  *  @param[in]  a    modular polynomial
  *  @param[out] upv  vector containing modular factors. if upv was not empty the
@@ -1101,12 +1609,16 @@ static void same_degree_factor(const umodpoly& a, upvec& upv)
 
 	vector<int> degrees;
 	upvec ddfactors;
-	distinct_degree_factor(a, degrees, ddfactors);
+	modular_matrix Q(degree(a), degree(a), R->zero());
+	distinct_degree_factor(a, degrees, ddfactors, Q);
 
 	for ( size_t i=0; i<degrees.size(); ++i ) {
 		if ( degrees[i] == degree(ddfactors[i]) ) {
 			upv.push_back(ddfactors[i]);
 		}
+		else if ( degree(ddfactors[i]) >= equal_degree_threshold && oddp(R->modulus) ) {
+			equal_degree_factor(ddfactors[i], degrees[i], Q, upv);
+		}
 		else {
 			berlekamp(ddfactors[i], upv);
 		}
@@ -1233,72 +1745,226 @@ static inline cl_I calc_bound(const upoly& a, int maxdeg)
 	return ( B > maxcoeff ) ? B : maxcoeff;
 }
 
-/** Hensel lifting as used by factor_univariate().
- *
- *  The implementation follows the algorithm in chapter 6 of [GCL].
- *
- *  @param[in]  a_   primitive univariate polynomials
- *  @param[in]  p    prime number that does not divide lcoeff(a)
- *  @param[in]  u1_  modular factor of a (mod p)
- *  @param[in]  w1_  modular factor of a (mod p), relatively prime to u1_,
- *                   fulfilling  u1_*w1_ == a mod p
- *  @param[out] u    lifted factor
- *  @param[out] w    lifted factor, u*w = a
+/** Reduces the coefficients of a into the range [0, P).
  */
-static void hensel_univar(const upoly& a_, unsigned int p, const umodpoly& u1_, const umodpoly& w1_, upoly& u, upoly& w)
+static void reduce_coeffs(upoly& a, const cl_I& P)
 {
-	upoly a = a_;
-	const cl_modint_ring& R = u1_[0].ring();
-
-	// calc bound B
-	int maxdeg = (degree(u1_) > degree(w1_)) ? degree(u1_) : degree(w1_);
-	cl_I maxmodulus = 2*calc_bound(a, maxdeg);
+	for ( size_t i=0; i<a.size(); ++i ) {
+		a[i] = mod(a[i], P);
+	}
+	canonicalize(a);
+}
 
-	// step 1
-	cl_I alpha = lcoeff(a);
-	a = a * alpha;
-	umodpoly nu1 = u1_;
-	normalize_in_field(nu1);
-	umodpoly nw1 = w1_;
-	normalize_in_field(nw1);
-	upoly phi;
-	phi = umodpoly_to_upoly(nu1) * alpha;
-	umodpoly u1;
-	umodpoly_from_upoly(u1, phi, R);
-	phi = umodpoly_to_upoly(nw1) * alpha;
-	umodpoly w1;
-	umodpoly_from_upoly(w1, phi, R);
+/** Symmetric representative of x modulo P.
+ */
+static cl_I symmetric_mod(const cl_I& x, const cl_I& P)
+{
+	cl_I r = mod(x, P);
+	return ( r > (P >> 1) ) ? r - P : r;
+}
 
-	// step 2
-	umodpoly s;
-	umodpoly t;
-	exteuclid(u1, w1, s, t);
-
-	// step 3
-	u = replace_lc(umodpoly_to_upoly(u1), alpha);
-	w = replace_lc(umodpoly_to_upoly(w1), alpha);
-	upoly e = a - u * w;
-	cl_I modulus = p;
+/** Replaces the coefficients of a by their symmetric representatives modulo P.
+ */
+static void to_symmetric(upoly& a, const cl_I& P)
+{
+	for ( size_t i=0; i<a.size(); ++i ) {
+		a[i] = symmetric_mod(a[i], P);
+	}
+	canonicalize(a);
+}
 
-	// step 4
-	while ( !e.empty() && modulus < maxmodulus ) {
-		upoly c = e / modulus;
-		phi = umodpoly_to_upoly(s) * c;
-		umodpoly sigmatilde;
-		umodpoly_from_upoly(sigmatilde, phi, R);
-		phi = umodpoly_to_upoly(t) * c;
-		umodpoly tautilde;
-		umodpoly_from_upoly(tautilde, phi, R);
-		umodpoly r, q;
-		remdiv(sigmatilde, w1, r, q);
-		umodpoly sigma = r;
-		phi = umodpoly_to_upoly(tautilde) + umodpoly_to_upoly(q) * umodpoly_to_upoly(u1);
-		umodpoly tau;
-		umodpoly_from_upoly(tau, phi, R);
-		u = u + umodpoly_to_upoly(tau) * modulus;
-		w = w + umodpoly_to_upoly(sigma) * modulus;
-		e = a - u * w;
-		modulus = modulus * p;
+/** Calculates remainder and quotient of a/b modulo M for a monic polynomial b.
+ *
+ *  @param[in]  a  polynomial dividend
+ *  @param[in]  b  monic polynomial divisor
+ *  @param[in]  M  modulus
+ *  @param[out] r  polynomial remainder
+ *  @param[out] q  polynomial quotient
+ */
+static void remdiv_monic(const upoly& a, const upoly& b, const cl_I& M, upoly& r, upoly& q)
+{
+	const int n = degree(b);
+	int k = degree(a) - n;
+	r = a;
+	q.clear();
+	if ( k < 0 ) {
+		reduce_coeffs(r, M);
+		return;
+	}
+
+	q.resize(k+1);
+	for ( ; k>=0; --k ) {
+		const cl_I qk = mod(r[n+k], M);
+		q[k] = qk;
+		if ( !zerop(qk) ) {
+			for ( int i=0; i<n; ++i ) {
+				r[i+k] = r[i+k] - qk*b[i];
+			}
+		}
+	}
+	r.resize(n);
+	reduce_coeffs(r, M);
+	canonicalize(q);
+}
+
+/** One step of quadratic Hensel lifting, see chapter 15 of [vzGG]. Given
+ *  f == g*h and s*g + t*h == 1 modulo m, with h monic, the factors and the
+ *  cofactors are updated such that these equations hold modulo M.
+ *
+ *  @param[in]     f  polynomial
+ *  @param[in]     M  new modulus, a divisor of m^2 and a multiple of m
+ *  @param[in,out] g  factor with lcoeff(g) == lcoeff(f)
+ *  @param[in,out] h  monic factor
+ *  @param[in,out] s  cofactor of g
+ *  @param[in,out] t  cofactor of h
+ */
+static void hensel_step(const upoly& f, const cl_I& M, upoly& g, upoly& h, upoly& s, upoly& t)
+{
+	upoly e = f - g * h;
+	reduce_coeffs(e, M);
+	upoly se = s * e, q, r;
+	remdiv_monic(se, h, M, r, q);
+	g = g + t * e + q * g;
+	reduce_coeffs(g, M);
+	h = h + r;
+	reduce_coeffs(h, M);
+
+	upoly b = s * g + t * h;
+	if ( b.empty() ) {
+		b.push_back(cl_I(-1));
+	}
+	else {
+		b[0] = b[0] - 1;
+	}
+	reduce_coeffs(b, M);
+	upoly sb = s * b, c, d;
+	remdiv_monic(sb, h, M, d, c);
+	s = s - d;
+	reduce_coeffs(s, M);
+	t = t - t * b - c * g;
+	reduce_coeffs(t, M);
+}
+
+/** Sets up quadratic Hensel lifting of the factorization f == g*h mod p.
+ *
+ *  @param[in]  f   polynomial
+ *  @param[in]  g1  modular factor of f
+ *  @param[in]  h1  monic modular factor of f, relatively prime to g1,
+ *                  fulfilling g1*h1 == f mod p
+ *  @param[out] g   g1 with lcoeff(f) as leading coefficient
+ *  @param[out] h   h1
+ *  @param[out] s   cofactor of g modulo p
+ *  @param[out] t   cofactor of h modulo p
+ */
+static void hensel_start(const upoly& f, const umodpoly& g1, const umodpoly& h1, upoly& g, upoly& h, upoly& s, upoly& t)
+{
+	const cl_modint_ring& R = g1[0].ring();
+	umodpoly gm = g1;
+	normalize_in_field(gm);
+	gm = gm * R->canonhom(lcoeff(f));
+	umodpoly sm, tm;
+	exteuclid(gm, h1, sm, tm);
+	g = umodpoly_to_upoly(gm);
+	h = umodpoly_to_upoly(h1);
+	s = umodpoly_to_upoly(sm);
+	t = umodpoly_to_upoly(tm);
+}
+
+/** Next modulus of quadratic Hensel lifting: m^2, but not more than P.
+ */
+static cl_I hensel_next_modulus(const cl_I& m, const cl_I& P)
+{
+	const cl_I m2 = m * m;
+	return ( m2 < P ) ? m2 : P;
+}
+
+/** Lifts the monic modular factors of the monic polynomial f to the modulus
+ *  P by a factor tree, see chapter 15 of [vzGG]: the products of the two
+ *  halves of the factors are lifted by quadratic Hensel lifting, and then
+ *  each half recursively.
+ *
+ *  @param[in]  f        monic polynomial with coefficients modulo P
+ *  @param[in]  P        power of the prime p
+ *  @param[in]  factors  monic modular factors of f (mod p)
+ *  @param[in]  lo, hi   range of factors to lift
+ *  @param[out] lifted   monic lifted factors are appended
+ */
+static void hensel_tree(const upoly& f, const cl_I& P, const upvec& factors, size_t lo, size_t hi, vector<upoly>& lifted)
+{
+	if ( hi - lo == 1 ) {
+		lifted.push_back(f);
+		return;
+	}
+	const size_t mid = (lo + hi)/2;
+	umodpoly g1 = factors[lo], h1 = factors[mid];
+	for ( size_t i=lo+1; i<mid; ++i ) {
+		g1 = g1 * factors[i];
+	}
+	for ( size_t i=mid+1; i<hi; ++i ) {
+		h1 = h1 * factors[i];
+	}
+
+	upoly g, h, s, t;
+	hensel_start(f, g1, h1, g, h, s, t);
+	for ( cl_I m = g1[0].ring()->modulus; m < P; ) {
+		m = hensel_next_modulus(m, P);
+		hensel_step(f, m, g, h, s, t);
+	}
+	hensel_tree(g, P, factors, lo, mid, lifted);
+	hensel_tree(h, P, factors, mid, hi, lifted);
+}
+
+/** Hensel lifting as used by factor_univariate().
+ *
+ *  The implementation follows the algorithm in chapter 6 of [GCL], except that
+ *  the factors are lifted quadratically, see hensel_step().
+ *
+ *  @param[in]  a_   primitive univariate polynomials
+ *  @param[in]  p    prime number that does not divide lcoeff(a)
+ *  @param[in]  u1_  modular factor of a (mod p)
+ *  @param[in]  w1_  modular factor of a (mod p), relatively prime to u1_,
+ *                   fulfilling  u1_*w1_ == a mod p
+ *  @param[out] u    lifted factor
+ *  @param[out] w    lifted factor, u*w = a
+ */
+static void hensel_univar(const upoly& a_, unsigned int p, const umodpoly& u1_, const umodpoly& w1_, upoly& u, upoly& w)
+{
+	upoly a = a_;
+
+	// calc bound B
+	int maxdeg = (degree(u1_) > degree(w1_)) ? degree(u1_) : degree(w1_);
+	cl_I maxmodulus = 2*calc_bound(a, maxdeg);
+
+	// step 1
+	cl_I alpha = lcoeff(a);
+	a = a * alpha;
+	umodpoly nu1 = u1_;
+	normalize_in_field(nu1);
+	umodpoly nw1 = w1_;
+	normalize_in_field(nw1);
+
+	// step 2
+	upoly ul, wl, s, t;
+	hensel_start(a_, nu1, nw1, ul, wl, s, t);
+	cl_I P = p;
+	while ( P < maxmodulus ) {
+		P = P * p;
+	}
+
+	// steps 3 and 4, with quadratic lifting of ul == alpha*u1 and wl == w1
+	cl_I modulus = p;
+	upoly e;
+	while ( true ) {
+		u = ul;
+		to_symmetric(u, modulus);
+		u = replace_lc(u, alpha);
+		w = wl * alpha;
+		to_symmetric(w, modulus);
+		w = replace_lc(w, alpha);
+		e = a - u * w;
+		if ( e.empty() || modulus >= maxmodulus ) break;
+		modulus = hensel_next_modulus(modulus, P);
+		hensel_step(a_, modulus, ul, wl, s, t);
 	}
 
 	// step 5
@@ -1486,6 +2152,565 @@ struct ModFactors
 	upvec factors;
 };
 
+////////////////////////////////////////////////////////////////////////////////
+// lattice based recombination of modular factors
+
+/** If there are more modular factors than this, they are recombined by
+ *  lattice reduction instead of trying all subsets.
+ */
+static const unsigned int lattice_recombination_threshold = 10;
+
+/** Number of power sums of roots added to the lattice in each step of the
+ *  lattice recombination.
+ */
+static const int lattice_power_sums = 4;
+
+typedef vector<cl_I> ivec;
+
+/** x/2^s rounded to the nearest integer.
+ */
+static cl_I scale_down(const cl_I& x, uintC s)
+{
+	if ( s == 0 ) return x;
+	return ash(x + ash(cl_I(1), s-1), -long(s));
+}
+
+/** Lifts all modular factors of the polynomial a at once.
+ *
+ *  @param[in]  a        primitive polynomial
+ *  @param[in]  P        power of the prime modulus of the factors
+ *  @param[in]  factors  modular factors of a, a == lcoeff(a)*prod(factors)
+ *  @param[out] lifted   monic factors modulo P, a == lcoeff(a)*prod(lifted)
+ */
+static void hensel_lift_factors(const upoly& a, const cl_I& P, const upvec& factors, vector<upoly>& lifted)
+{
+	upvec monic(factors);
+	for ( size_t i=0; i<monic.size(); ++i ) {
+		normalize_in_field(monic[i]);
+	}
+
+	const cl_modint_ring RP = find_modint_ring(P);
+	const cl_I lc_1 = RP->retract(recip(RP->canonhom(lcoeff(a))));
+	upoly f = a * lc_1;
+	reduce_coeffs(f, P);
+
+	lifted.clear();
+	hensel_tree(f, P, monic, 0, monic.size(), lifted);
+}
+
+/** Power sums of the roots of the monic polynomial g modulo P, computed by
+ *  Newton's identities. The j-th sum is multiplied by l^j.
+ */
+static void power_sums(const upoly& g, const cl_I& l, const cl_I& P, int N, ivec& sums)
+{
+	const int d = degree(g);
+	ivec raw(N+1);
+	sums.resize(N);
+	cl_I lj = 1;
+	for ( int k=1; k<=N; ++k ) {
+		cl_I s = ( k <= d ) ? -k * g[d-k] : cl_I(0);
+		for ( int i=1; i<k && i<=d; ++i ) {
+			s = s - g[d-i] * raw[k-i];
+		}
+		raw[k] = mod(s, P);
+		lj = mod(lj * l, P);
+		sums[k-1] = symmetric_mod(raw[k] * lj, P);
+	}
+}
+
+/** Scalar product of integer vectors.
+ */
+static cl_I dot_product(const ivec& x, const ivec& y)
+{
+	cl_I s = 0;
+	for ( size_t i=0; i<x.size(); ++i ) {
+		s = s + x[i]*y[i];
+	}
+	return s;
+}
+
+/** Size reduction of b[k] against b[l], as used by lll_reduce().
+ */
+static void size_reduce(vector<ivec>& b, vector< vector<cl_RA> >& mu, size_t k, size_t l)
+{
+	if ( 2*abs(mu[k][l]) <= 1 ) return;
+	const cl_I q = round1(mu[k][l]);
+	for ( size_t i=0; i<b[k].size(); ++i ) {
+		b[k][i] = b[k][i] - q*b[l][i];
+	}
+	mu[k][l] = mu[k][l] - q;
+	for ( size_t i=0; i<l; ++i ) {
+		mu[k][i] = mu[k][i] - q*mu[l][i];
+	}
+}
+
+/** LLL reduction (with parameter 3/4) of the linearly independent integer
+ *  vectors b. Follows the textbook algorithm with exact rational Gram-Schmidt
+ *  coefficients.
+ *
+ *  @param[in,out] b   basis, replaced by the reduced basis
+ *  @param[out]    bb  squared norms of the Gram-Schmidt vectors of the result
+ */
+static void lll_reduce(vector<ivec>& b, vector<cl_RA>& bb)
+{
+	const size_t n = b.size();
+	vector< vector<cl_RA> > mu(n, vector<cl_RA>(n));
+	bb.assign(n, cl_RA(0));
+
+	bb[0] = dot_product(b[0], b[0]);
+	size_t k = 1, kmax = 0;
+	while ( k < n ) {
+		if ( k > kmax ) {
+			kmax = k;
+			cl_RA bk = dot_product(b[k], b[k]);
+			for ( size_t j=0; j<k; ++j ) {
+				cl_RA m = dot_product(b[k], b[j]);
+				for ( size_t i=0; i<j; ++i ) {
+					m = m - mu[j][i]*mu[k][i]*bb[i];
+				}
+				mu[k][j] = m / bb[j];
+				bk = bk - mu[k][j]*m;
+			}
+			bb[k] = bk;
+		}
+		size_reduce(b, mu, k, k-1);
+		if ( 4*bb[k] < (3 - 4*square(mu[k][k-1]))*bb[k-1] ) {
+			// swap b[k] and b[k-1]
+			b[k].swap(b[k-1]);
+			for ( size_t j=0; j+1<k; ++j ) {
+				std::swap(mu[k][j], mu[k-1][j]);
+			}
+			const cl_RA m = mu[k][k-1];
+			const cl_RA bn = bb[k] + square(m)*bb[k-1];
+			mu[k][k-1] = m*bb[k-1] / bn;
+			bb[k] = bb[k-1]*bb[k] / bn;
+			bb[k-1] = bn;
+			for ( size_t i=k+1; i<=kmax; ++i ) {
+				const cl_RA t = mu[i][k];
+				mu[i][k] = mu[i][k-1] - m*t;
+				mu[i][k-1] = t + mu[k][k-1]*mu[i][k];
+			}
+			if ( k > 1 ) --k;
+		}
+		else {
+			for ( size_t l=k-1; l-- != 0; ) {
+				size_reduce(b, mu, k, l);
+			}
+			++k;
+		}
+	}
+}
+
+/** Extracts a partition of the modular factors from the basis vectors of the
+ *  lattice spanned by the found factor combinations: the reduced row echelon
+ *  form has to consist of 0/1 rows with disjoint supports.
+ *
+ *  @param[in]  m       basis vectors, restricted to the modular factors
+ *  @param[out] groups  indices of the modular factors of each combination
+ *  @return             false if the basis is not of the expected form
+ */
+static bool partition_from_basis(const vector<ivec>& m, vector< vector<size_t> >& groups)
+{
+	const size_t s = m.size();
+	const size_t r = m[0].size();
+	vector< vector<cl_RA> > e(s, vector<cl_RA>(r));
+	for ( size_t i=0; i<s; ++i ) {
+		for ( size_t j=0; j<r; ++j ) {
+			e[i][j] = m[i][j];
+		}
+	}
+
+	// Gauss-Jordan elimination
+	size_t row = 0;
+	for ( size_t col=0; col<r && row<s; ++col ) {
+		size_t piv = row;
+		while ( piv < s && zerop(e[piv][col]) ) ++piv;
+		if ( piv == s ) continue;
+		e[row].swap(e[piv]);
+		const cl_RA inv = recip(e[row][col]);
+		for ( size_t j=col; j<r; ++j ) {
+			e[row][j] = e[row][j]*inv;
+		}
+		for ( size_t i=0; i<s; ++i ) {
+			if ( i == row || zerop(e[i][col]) ) continue;
+			const cl_RA f = e[i][col];
+			for ( size_t j=col; j<r; ++j ) {
+				e[i][j] = e[i][j] - f*e[row][j];
+			}
+		}
+		++row;
+	}
+	if ( row < s ) {
+		return false;
+	}
+
+	groups.assign(s, vector<size_t>());
+	for ( size_t j=0; j<r; ++j ) {
+		size_t owner = s;
+		for ( size_t i=0; i<s; ++i ) {
+			if ( zerop(e[i][j]) ) continue;
+			if ( e[i][j] != 1 || owner != s ) {
+				return false;
+			}
+			owner = i;
+		}
+		if ( owner == s ) {
+			return false;
+		}
+		groups[owner].push_back(j);
+	}
+	return true;
+}
+
+/** Exact division in Z[x].
+ *
+ *  @param[in]  a  dividend
+ *  @param[in]  b  divisor, not zero
+ *  @param[out] q  quotient if b divides a
+ *  @return        true if b divides a
+ */
+static bool divide_in_z(const upoly& a, const upoly& b, upoly& q)
+{
+	const int n = degree(b);
+	int k = degree(a) - n;
+	q.clear();
+	if ( k < 0 ) return false;
+
+	upoly r = a;
+	q.resize(k+1);
+	for ( ; k>=0; --k ) {
+		if ( !zerop(rem(r[n+k], b[n])) ) return false;
+		const cl_I qk = exquo(r[n+k], b[n]);
+		q[k] = qk;
+		for ( int i=0; i<=n; ++i ) {
+			r[i+k] = r[i+k] - qk*b[i];
+		}
+	}
+	for ( int i=0; i<n; ++i ) {
+		if ( !zerop(r[i]) ) return false;
+	}
+	return true;
+}
+
+/** Checks if the partition of the lifted modular factors gives a
+ *  factorization of a.
+ *
+ *  @param[in]  a       primitive polynomial
+ *  @param[in]  P       modulus of the lifted factors
+ *  @param[in]  lifted  monic factors of a modulo P
+ *  @param[in]  groups  indices of the lifted factors of each factor of a
+ *  @param[out] result  factors of a, their product is a
+ *  @return             true if all the factors divide a
+ */
+static bool check_partition(const upoly& a, const cl_I& P, const vector<upoly>& lifted,
+                            const vector< vector<size_t> >& groups, vector<upoly>& result)
+{
+	vector<upoly> found;
+	upoly rest = a;
+	for ( size_t g=0; g+1<groups.size(); ++g ) {
+		upoly h(1, lcoeff(a));
+		for ( size_t i=0; i<groups[g].size(); ++i ) {
+			h = h * lifted[groups[g][i]];
+			reduce_coeffs(h, P);
+		}
+		to_symmetric(h, P);
+		cl_I c = h[0];
+		for ( size_t i=1; i<h.size(); ++i ) {
+			c = gcd(c, h[i]);
+		}
+		if ( minusp(c) != minusp(lcoeff(h)) ) {
+			c = -c;
+		}
+		h = h / c;
+		upoly q;
+		if ( !divide_in_z(rest, h, q) ) {
+			return false;
+		}
+		found.push_back(h);
+		rest.swap(q);
+	}
+	found.push_back(rest);
+	result.swap(found);
+	return true;
+}
+
+/** Recombination of modular factors by lattice reduction, see [vH].
+ *
+ *  The modular factors are lifted to a high power P of p. For a subset S of
+ *  them which corresponds to a true factor, the sums over S of the (scaled)
+ *  power sums of the roots of the lifted factors are small integers modulo P.
+ *  The 0/1 vectors of such subsets are short in a lattice built from the
+ *  leading digits of the power sums, so LLL reduction gives a basis of a
+ *  lattice which contains them all. This is repeated with further power sums
+ *  until the basis reveals the partition of the modular factors into the
+ *  irreducible factors. The result is verified by trial division.
+ *
+ *  @param[in]  a        primitive square free polynomial
+ *  @param[in]  p        prime not dividing lcoeff(a) for which a is square free
+ *  @param[in]  factors  modular factors of a (mod p)
+ *  @param[out] result   irreducible factors of a, their product is a
+ *  @return              false if no verifiable partition was found, the
+ *                       exhaustive search has to be used then
+ */
+static bool lattice_recombination(const upoly& a, unsigned int p, const upvec& factors, vector<upoly>& result)
+{
+	const int n = degree(a);
+	const int r = factors.size();
+	const cl_I l = lcoeff(a);
+
+	// l times the roots of a are bounded by lrho (Cauchy's bound), so the
+	// j-th power sum of a factor is an integer bounded by n*lrho^j
+	cl_I lrho = 0;
+	for ( int i=0; i<n; ++i ) {
+		if ( abs(a[i]) > lrho ) lrho = abs(a[i]);
+	}
+	lrho = lrho + abs(l);
+	cl_I bound = n;
+
+	// modulus needed to reconstruct the factors from the lifted ones
+	const uintC cbits = integer_length(2*abs(l)*calc_bound(a, n)) + 1;
+	const uintC rbits = integer_length(cl_I(r));
+
+	// basis of a lattice containing the vectors of the true factors
+	vector<ivec> m(r, ivec(r, cl_I(0)));
+	for ( int i=0; i<r; ++i ) {
+		m[i][i] = 1;
+	}
+
+	cl_I P = 1;
+	vector<upoly> lifted;
+	recombination_timer timer;
+	for ( int j=0; j<n; ) {
+		const int N = min(lattice_power_sums, n-j);
+		const size_t s = m.size();
+		const size_t dim = s + N;
+
+		// Scaled down by 2^shift[k], the power sums of true factors are
+		// < 2r, with the rounding errors the entries of their vectors are
+		// < 4r. The modulus is chosen such that this is much smaller than
+		// the length of other vectors, the extra bits per column making up
+		// for the approximation factor of LLL.
+		vector<uintC> shift(N);
+		uintC topbits = 0;
+		for ( int k=0; k<N; ++k ) {
+			bound = bound * lrho;
+			topbits = integer_length(bound);
+			shift[k] = ( topbits > rbits ) ? topbits - rbits : 0;
+		}
+		const cl_I maxnorm = r + N*16*r*r;
+		const uintC extra = (dim*(dim + integer_length(maxnorm)))/(2*N) + 10;
+		const uintC pbits = topbits + extra;
+		cl_I Pk = p;
+		while ( integer_length(Pk) <= pbits ) {
+			Pk = Pk * p;
+		}
+		if ( Pk > P ) {
+			// lift a bit further than needed, so this isn't repeated for
+			// every new set of power sums
+			const uintC liftbits = max(pbits + pbits/2, cbits);
+			P = p;
+			while ( integer_length(P) <= liftbits ) {
+				P = P * p;
+			}
+			timer.start_lifting();
+			{
+				trace_scope trace("factor lifting", "factors", factors.size());
+				hensel_lift_factors(a, P, factors, lifted);
+			}
+			timer.stop_lifting();
+		}
+
+		// lattice basis, modulo Pk which divides P
+		vector<ivec> sums(r);
+		for ( int i=0; i<r; ++i ) {
+			power_sums(lifted[i], l, Pk, j+N, sums[i]);
+		}
+		vector<ivec> b(dim, ivec(r+N, cl_I(0)));
+		for ( size_t i=0; i<s; ++i ) {
+			copy(m[i].begin(), m[i].end(), b[i].begin());
+			for ( int k=0; k<N; ++k ) {
+				cl_I c = 0;
+				for ( int t=0; t<r; ++t ) {
+					if ( !zerop(m[i][t]) ) {
+						c = c + m[i][t] * scale_down(sums[t][j+k], shift[k]);
+					}
+				}
+				b[i][r+k] = c;
+			}
+		}
+		for ( int k=0; k<N; ++k ) {
+			b[s+k][r+k] = scale_down(Pk, shift[k]);
+		}
+		j += N;
+
+		vector<cl_RA> bb;
+		lll_reduce(b, bb);
+
+		// the short vectors lie in the span of the leading basis vectors
+		size_t snew = dim;
+		while ( snew > 0 && bb[snew-1] > maxnorm ) --snew;
+		if ( snew == 0 ) {
+			return false;
+		}
+		m.resize(snew);
+		for ( size_t i=0; i<snew; ++i ) {
+			m[i].assign(b[i].begin(), b[i].begin()+r);
+		}
+
+		vector< vector<size_t> > groups;
+		if ( partition_from_basis(m, groups) && check_partition(a, P, lifted, groups, result) ) {
+			return true;
+		}
+	}
+	return false;
+}
+
+// END lattice based recombination of modular factors
+////////////////////////////////////////////////////////////////////////////////
+
+////////////////////////////////////////////////////////////////////////////////
+// concurrent trials of primes and evaluation points
+
+#ifdef PARALLEL_TRIALS
+
+/** Runs a trial as a task. An exception marks the trial as failed.
+ */
+template<typename T> void* run_trial_thread(void* arg)
+{
+	T& trial = *static_cast<T*>(arg);
+	try {
+		run_trial(trial);
+	}
+	catch ( ... ) {
+		trial.failed = true;
+	}
+	return 0;
+}
+
+/** Runs the trials concurrently as tasks, the first one in the calling
+ *  thread.
+ */
+template<typename T> void run_trials(vector<T>& trials)
+{
+	run_tasks(run_trial_thread<T>, trials);
+}
+
+#endif // def PARALLEL_TRIALS
+
+/** Returns a copy of a whose coefficients don't share any CLN heap object with
+ *  those of a. CLN doesn't update its reference counts atomically, so every
+ *  thread needs its own numbers.
+ */
+static upoly copy_coefficients(const upoly& a)
+{
+	upoly c(a.size());
+	for ( size_t i=0; i<a.size(); ++i ) {
+		c[i] = (a[i] + 1) - 1;
+	}
+	return c;
+}
+
+/** Modular factorization of a primitive polynomial, one trial of
+ *  factor_univariate().
+ */
+struct prime_trial
+{
+	upoly prim;
+	unsigned int prime;
+	cl_modint_ring R;
+	bool squarefree;  // prim is square free modulo prime
+	upvec factors;    // modular factors of prim if it is square free
+	bool failed;
+};
+
+static void run_trial(prime_trial& t)
+{
+	umodpoly modpoly;
+	umodpoly_from_upoly(modpoly, t.prim, t.R);
+	t.squarefree = squarefree(modpoly);
+	if ( t.squarefree ) {
+		factor_modular(modpoly, t.factors);
+	}
+}
+
+/** Supplies the modular factors of a primitive polynomial for successive
+ *  primes which don't divide its leading coefficient and modulo which it stays
+ *  square free. With several threads, the factorizations modulo a batch of
+ *  primes are computed at once and then handed out one by one in the order of
+ *  the primes, so the choice of the prime does not depend on the number of
+ *  threads. The rings are set up by the calling thread, and every prime is
+ *  used by one thread only.
+ */
+class prime_trials
+{
+	const upoly& prim;
+	const cl_I& lc;
+	unsigned int prime;
+#ifdef PARALLEL_TRIALS
+	vector<prime_trial> batch;
+	size_t next;
+#endif
+
+	void next_trial(prime_trial& t, bool copy)
+	{
+		do {
+			prime = next_prime(prime);
+		} while ( zerop(rem(lc, prime)) );
+		t.prime = prime;
+		t.R = find_modint_ring(prime);
+		t.prim = copy ? copy_coefficients(prim) : prim;
+		t.factors.clear();
+		t.failed = false;
+	}
+public:
+	prime_trials(const upoly& prim_, const cl_I& lc_)
+	  : prim(prim_), lc(lc_), prime(3)
+#ifdef PARALLEL_TRIALS
+	  , next(0)
+#endif
+	{ }
+
+	/** Get the next prime and the modular factors of the polynomial. */
+	void operator()(unsigned int& p, upvec& factors)
+	{
+#ifdef PARALLEL_TRIALS
+		if ( factor_threads > 1 ) {
+			while ( true ) {
+				if ( next == batch.size() ) {
+					batch.resize(factor_threads);
+					for ( size_t i=0; i<batch.size(); ++i ) {
+						next_trial(batch[i], i > 0);
+					}
+					run_trials(batch);
+					next = 0;
+				}
+				prime_trial& t = batch[next++];
+				if ( t.failed ) {
+					// repeat it here to get the exception
+					t.factors.clear();
+					run_trial(t);
+				}
+				if ( t.squarefree ) {
+					p = t.prime;
+					factors.swap(t.factors);
+					return;
+				}
+			}
+		}
+#endif
+		prime_trial t;
+		do {
+			next_trial(t, false);
+			run_trial(t);
+		} while ( !t.squarefree );
+		p = t.prime;
+		factors.swap(t.factors);
+	}
+};
+
+// END concurrent trials of primes and evaluation points
+////////////////////////////////////////////////////////////////////////////////
+
 /** Univariate polynomial factorization.
  *
  *  Modular factorization is tried for several primes to minimize the number of
@@ -1504,8 +2729,7 @@ static ex factor_univariate(const ex& poly, const ex& x, unsigned int& prime)
 	upoly_from_ex(prim, prim_ex, x);
 
 	// determine proper prime and minimize number of modular factors
-	prime = 3;
-	unsigned int lastp = prime;
+	unsigned int lastp = 3;
 	cl_modint_ring R;
 	unsigned int trials = 0;
 	unsigned int minfactors = 0;
@@ -1521,20 +2745,16 @@ static ex factor_univariate(const ex& poly, const ex& x, unsigned int& prime)
 	}
 	cl_I lc = lcoeff(prim)*i_cont;
 	upvec factors;
+	prime_trials next_trial(prim, lc);
 	while ( trials < 2 ) {
-		umodpoly modpoly;
-		while ( true ) {
-			prime = next_prime(prime);
-			if ( !zerop(rem(lc, prime)) ) {
-				R = find_modint_ring(prime);
-				umodpoly_from_upoly(modpoly, prim, R);
-				if ( squarefree(modpoly) ) break;
-			}
-		}
-
+		check_budget();
 		// do modular factorization
 		upvec trialfactors;
-		factor_modular(modpoly, trialfactors);
+		{
+			phase_timer timer(modular_ticks);
+			trace_scope trace("factor modular", "degree", degree(prim));
+			next_trial(prime, trialfactors);
+		}
 		if ( trialfactors.size() <= 1 ) {
 			// irreducible for sure
 			return poly;
@@ -1553,6 +2773,18 @@ static ex factor_univariate(const ex& poly, const ex& x, unsigned int& prime)
 	prime = lastp;
 	R = find_modint_ring(prime);
 
+	// for many modular factors the exhaustive search below takes too long
+	if ( factors.size() > lattice_recombination_threshold ) {
+		vector<upoly> irreducibles;
+		if ( lattice_recombination(prim, prime, factors, irreducibles) ) {
+			ex result = 1;
+			for ( size_t i=0; i<irreducibles.size(); ++i ) {
+				result *= upoly_to_ex(irreducibles[i], x);
+			}
+			return unit * cont * result;
+		}
+	}
+
 	// lift all factor combinations
 	stack<ModFactors> tocheck;
 	ModFactors mf;
@@ -1561,12 +2793,20 @@ static ex factor_univariate(const ex& poly, const ex& x, unsigned int& prime)
 	tocheck.push(mf);
 	upoly f1, f2;
 	ex result = 1;
+	recombination_timer timer;
+	trace_scope trace("factor recombination", "factors", factors.size());
 	while ( tocheck.size() ) {
 		const size_t n = tocheck.top().factors.size();
 		factor_partition part(tocheck.top().factors);
 		while ( true ) {
+			check_budget();
 			// call Hensel lifting
-			hensel_univar(tocheck.top().poly, prime, part.left(), part.right(), f1, f2);
+			timer.start_lifting();
+			{
+				trace_scope trace("factor lifting", "factors", n);
+				hensel_univar(tocheck.top().poly, prime, part.left(), part.right(), f1, f2);
+			}
+			timer.stop_lifting();
 			if ( !f1.empty() ) {
 				// successful, update the stack and the result
 				if ( part.size_left() == 1 ) {
@@ -1730,7 +2970,8 @@ static void change_modulus(const cl_modint_ring& R, umodpoly& a)
  *
  *  Solves  s*a + t*b == 1 mod p^k  given a,b.
  *
- *  The implementation follows the algorithm in chapter 6 of [GCL].
+ *  The solution modulo p is lifted quadratically, doubling the number of
+ *  correct p-adic digits in each step.
  *
  *  @param[in]  a   polynomial
  *  @param[in]  b   polynomial
@@ -1758,26 +2999,15 @@ static void eea_lift(const umodpoly& a, const umodpoly& b, const ex& x, unsigned
 	umodpoly t = tmod;
 	change_modulus(Rpk, t);
 
-	cl_I modulus(p);
+	// Newton iteration, squaring the error e = 1 - a*s - b*t in each step
 	umodpoly one(1, Rpk->one());
-	for ( size_t j=1; j<k; ++j ) {
+	for ( unsigned int j=1; j<k; j*=2 ) {
 		umodpoly e = one - a * s - b * t;
-		reduce_coeff(e, modulus);
-		umodpoly c = e;
-		change_modulus(R, c);
-		umodpoly sigmabar = smod * c;
-		umodpoly taubar = tmod * c;
+		if ( e.empty() ) break;
 		umodpoly sigma, q;
-		remdiv(sigmabar, bmod, sigma, q);
-		umodpoly tau = taubar + q * amod;
-		umodpoly sadd = sigma;
-		change_modulus(Rpk, sadd);
-		cl_MI modmodulus(Rpk, modulus);
-		s = s + sadd * modmodulus;
-		umodpoly tadd = tau;
-		change_modulus(Rpk, tadd);
-		t = t + tadd * modmodulus;
-		modulus = modulus * p;
+		remdiv(s * e, b, sigma, q);
+		t = t + t * e + q * a;
+		s = s + sigma;
 	}
 
 	s_ = s; t_ = t;
@@ -1975,17 +3205,208 @@ static vector<ex> multivar_diophant(const vector<ex>& a_, const ex& x, const ex&
 				delta_s[j] = delta_s[j] * modcm;
 				sigma[j] = sigma[j] + umodpoly_to_ex(delta_s[j], x);
 			}
-			if ( nterms > 1 ) {
-				z = c.op(i+1);
+			if ( nterms > 1 ) {
+				z = c.op(i+1);
+			}
+		}
+	}
+
+	for ( size_t i=0; i<sigma.size(); ++i ) {
+		sigma[i] = make_modular(sigma[i], R);
+	}
+
+	return sigma;
+}
+
+/** Maximal number of unknown coefficients sparse_diophant() is willing to
+ *  determine by solving a linear system.
+ */
+static const size_t sparse_diophant_max_unknowns = 256;
+
+/** Returns the coefficient c as an element of R, if its denominator is
+ *  invertible modulo p.
+ */
+static bool modular_coefficient(const cl_RA& c, const cl_modint_ring& R, unsigned int p, cl_MI& m)
+{
+	const cl_I den = denominator(c);
+	if ( zerop(mod(den, cl_I(p))) ) {
+		return false;
+	}
+	m = R->canonhom(numerator(c));
+	if ( den != 1 ) {
+		m = m / R->canonhom(den);
+	}
+	return true;
+}
+
+/** Utility function for multivariate Hensel lifting.
+ *
+ *  Solves the same Diophantine equation s_1*b_1 + ... + s_r*b_r == c as
+ *  multivar_diophant(), with b_i the product of all a_j but a_i, assuming
+ *  that the monomials of every s_i in x and in the variables already lifted
+ *  occur in a_i already (the skeleton of a_i), which holds with high
+ *  probability for sparse polynomials [Zip].  Instead of recursing over the
+ *  variables the unknown coefficients of the s_i are then determined by
+ *  comparing the coefficients of c and of the s_i*b_i modulo p^k.
+ *
+ *  @param[in]  a      vector of modular polynomials a_i, primitive in x
+ *  @param[in]  x      symbol
+ *  @param[in]  c      modular polynomial
+ *  @param[in]  R      ring Z/p^k
+ *  @param[in]  p      prime number
+ *  @param[out] sigma  solution s_i (modulo p^k)
+ *  @return            true if a solution with the assumed skeletons exists,
+ *                     false if multivar_diophant() has to be used instead
+ */
+static bool sparse_diophant(const vector<ex>& a, const ex& x, const ex& c,
+                            const cl_modint_ring& R, unsigned int p, vector<ex>& sigma)
+{
+	const size_t r = a.size();
+
+	// the exponents of the products s_i*b_i are bounded by the sums of the
+	// exponents of the a_i
+	var_index_map vi;
+	vector<unsigned> maxdeg;
+	for ( size_t i=0; i<r; ++i ) {
+		if ( !collect_degrees(a[i], vi, maxdeg) ) {
+			return false;
+		}
+	}
+	if ( !collect_degrees(c, vi, maxdeg) ) {
+		return false;
+	}
+	vector<unsigned> sumdeg(vi.size(), 0);
+	for ( size_t i=0; i<r; ++i ) {
+		vector<unsigned> deg(vi.size(), 0);
+		collect_degrees(a[i], vi, deg);
+		for ( size_t v=0; v<deg.size(); ++v ) {
+			sumdeg[v] += deg[v];
+		}
+	}
+	for ( size_t v=0; v<sumdeg.size(); ++v ) {
+		sumdeg[v] = std::max(sumdeg[v], maxdeg[v]);
+	}
+	packing pk;
+	if ( vi.find(x) == vi.end() || !pk.init(vi, sumdeg) ) {
+		return false;
+	}
+	const unsigned xv = vi.find(x)->second;
+
+	vector<sparse_poly> ap(r);
+	vector<unsigned> xdeg(r);
+	size_t unknowns = 0;
+	for ( size_t i=0; i<r; ++i ) {
+		ap[i] = to_polynomial(a[i], pk);
+		xdeg[i] = a[i].degree(x);
+		for ( size_t t=0; t<ap[i].size(); ++t ) {
+			if ( pk.degree(ap[i][t].exponents, xv) < xdeg[i] ) {
+				++unknowns;
+			}
+		}
+	}
+	if ( unknowns == 0 || unknowns > sparse_diophant_max_unknowns ) {
+		return false;
+	}
+
+	// one column per monomial of the skeletons, one row per monomial of the
+	// products and of c, the right hand side is the last column
+	map<packed_exponents, size_t> row_of;
+	vector< vector<cl_MI> > M;
+	vector< pair<size_t, size_t> > unknown;  // (i, term of a_i)
+	size_t col = 0;
+	for ( size_t i=0; i<r; ++i ) {
+		sparse_poly b(1, sparse_term(0, 1));
+		for ( size_t j=0; j<r; ++j ) {
+			if ( j != i ) {
+				b = sparse_multiply(b, ap[j]);
+			}
+		}
+		for ( size_t t=0; t<ap[i].size(); ++t ) {
+			if ( pk.degree(ap[i][t].exponents, xv) >= xdeg[i] ) {
+				continue;
+			}
+			unknown.push_back(make_pair(i, t));
+			for ( size_t s=0; s<b.size(); ++s ) {
+				const packed_exponents e = b[s].exponents + ap[i][t].exponents;
+				map<packed_exponents, size_t>::iterator it = row_of.find(e);
+				if ( it == row_of.end() ) {
+					it = row_of.insert(make_pair(e, M.size())).first;
+					M.push_back(vector<cl_MI>(unknowns + 1, R->zero()));
+				}
+				cl_MI m;
+				if ( !modular_coefficient(b[s].coeff, R, p, m) ) {
+					return false;
+				}
+				M[it->second][col] = m;
+			}
+			++col;
+			if ( M.size() * (unknowns + 1) > (size_t(1) << 20) ) {
+				return false;
+			}
+		}
+	}
+	const sparse_poly cp = to_polynomial(c, pk);
+	for ( size_t s=0; s<cp.size(); ++s ) {
+		map<packed_exponents, size_t>::iterator it = row_of.find(cp[s].exponents);
+		if ( it == row_of.end() ) {
+			// c has a monomial no product of the skeletons can produce
+			return false;
+		}
+		cl_MI m;
+		if ( !modular_coefficient(cp[s].coeff, R, p, m) ) {
+			return false;
+		}
+		M[it->second][unknowns] = m;
+	}
+
+	// Gaussian elimination modulo p^k with pivots that are units, they exist
+	// since the solution is unique modulo p
+	const cl_I prime = p;
+	const size_t rows = M.size();
+	for ( size_t j=0; j<unknowns; ++j ) {
+		size_t piv = j;
+		while ( piv < rows && zerop(mod(R->retract(M[piv][j]), prime)) ) {
+			++piv;
+		}
+		if ( piv == rows ) {
+			return false;
+		}
+		M[j].swap(M[piv]);
+		const cl_MI inv = recip(M[j][j]);
+		for ( size_t k=j; k<=unknowns; ++k ) {
+			M[j][k] = M[j][k] * inv;
+		}
+		for ( size_t i=0; i<rows; ++i ) {
+			if ( i == j || zerop(M[i][j]) ) {
+				continue;
+			}
+			const cl_MI f = M[i][j];
+			for ( size_t k=j; k<=unknowns; ++k ) {
+				if ( !zerop(M[j][k]) ) {
+					M[i][k] = M[i][k] - f * M[j][k];
+				}
 			}
 		}
 	}
-
-	for ( size_t i=0; i<sigma.size(); ++i ) {
-		sigma[i] = make_modular(sigma[i], R);
+	for ( size_t i=unknowns; i<rows; ++i ) {
+		if ( !zerop(M[i][unknowns]) ) {
+			// inconsistent, the skeleton is wrong
+			return false;
+		}
 	}
 
-	return sigma;
+	vector<sparse_poly> sp(r);
+	for ( size_t j=0; j<unknowns; ++j ) {
+		if ( !zerop(M[j][unknowns]) ) {
+			const size_t i = unknown[j].first;
+			sp[i].push_back(sparse_term(ap[i][unknown[j].second].exponents, R->retract(M[j][unknowns])));
+		}
+	}
+	sigma.resize(r);
+	for ( size_t i=0; i<r; ++i ) {
+		sigma[i] = make_modular(from_polynomial(sp[i], pk), R);
+	}
+	return true;
 }
 
 /** Multivariate Hensel lifting.
@@ -2001,11 +3422,15 @@ static vector<ex> multivar_diophant(const vector<ex>& a_, const ex& x, const ex&
  *  @param l    p^l is the modulus of the lifted univariate field
  *  @param u    vector of modular (mod p^l) factors of a mod I
  *  @param lcU  correct leading coefficient of the univariate factors of a mod I
+ *  @param sparse  if true, the corrections of every variable but the first
+ *                 lifted one are first sought within the skeletons of the
+ *                 factors found so far (sparse_diophant())
  *  @return     list GiNaC::lst with lifted factors (multivariate factors of a),
  *              empty if Hensel lifting did not succeed
  */
 static ex hensel_multivar(const ex& a, const ex& x, const vector<EvalPoint>& I,
-                          unsigned int p, const cl_I& l, const upvec& u, const vector<ex>& lcU)
+                          unsigned int p, const cl_I& l, const upvec& u, const vector<ex>& lcU,
+                          bool sparse)
 {
 	const size_t nu = I.size() + 1;
 	const cl_modint_ring R = find_modint_ring(expt_pos(cl_I(p),l));
@@ -2067,7 +3492,10 @@ static ex hensel_multivar(const ex& a, const ex& x, const vector<EvalPoint>& I,
 				ex dif = e.diff(ex_to<symbol>(xj), k);
 				ex c = dif.subs(xj==alphaj) / factorial(k);
 				if ( !c.is_zero() ) {
-					vector<ex> deltaU = multivar_diophant(U1, x, c, newI, maxdeg, p, cl_I_to_uint(l));
+					vector<ex> deltaU;
+					if ( !sparse || j == 2 || !sparse_diophant(U1, x, c, R, p, deltaU) ) {
+						deltaU = multivar_diophant(U1, x, c, newI, maxdeg, p, cl_I_to_uint(l));
+					}
 					for ( size_t i=0; i<n; ++i ) {
 						deltaU[i] *= monomial;
 						U[i] += deltaU[i];
@@ -2172,6 +3600,65 @@ static bool checkdivisors(const lst& f)
 	return false;
 }
 
+/** Draws random evaluation points a_i with |a_i| < modulus for the symbols in
+ *  syms except the first one, such that the leading coefficient vn does not
+ *  vanish.
+ */
+static void draw_set(const ex& vn, const exset& syms, const numeric& modulus, vector<numeric>& a)
+{
+	ex vna = vn;
+	ex vnatry;
+	exset::const_iterator s = syms.begin();
+	++s;
+	for ( size_t i=0; i<a.size(); ++i ) {
+		do {
+			a[i] = mod(numeric(rand()), 2*modulus) - modulus;
+			vnatry = vna.subs(*s == a[i]);
+			// ... for which the leading coefficient doesn't vanish ...
+		} while ( vnatry == 0 );
+		vna = vnatry;
+		++s;
+	}
+}
+
+/** Checks the remaining conditions of generate_set() for the evaluation
+ *  points a and returns the evaluated polynomial in u0.
+ */
+static bool check_set(const ex& u, const ex& vn, const exset& syms, const lst& f,
+                      const vector<numeric>& a, ex& u0)
+{
+	const ex& x = *syms.begin();
+	u0 = u;
+	exset::const_iterator s = syms.begin();
+	++s;
+	for ( size_t i=0; i<a.size(); ++i, ++s ) {
+		u0 = u0.subs(*s == a[i]);
+	}
+	// ... for which u0 is square free ...
+	ex g = gcd(u0, u0.diff(ex_to<symbol>(x)));
+	if ( !is_a<numeric>(g) ) {
+		return false;
+	}
+	if ( !is_a<numeric>(vn) ) {
+		// ... and for which the evaluated factors have each an unique prime factor
+		lst fnum = f;
+		fnum.let_op(0) = fnum.op(0) * u0.content(x);
+		for ( size_t i=1; i<fnum.nops(); ++i ) {
+			if ( !is_a<numeric>(fnum.op(i)) ) {
+				s = syms.begin();
+				++s;
+				for ( size_t j=0; j<a.size(); ++j, ++s ) {
+					fnum.let_op(i) = fnum.op(i).subs(*s == a[j]);
+				}
+			}
+		}
+		if ( checkdivisors(fnum) ) {
+			return false;
+		}
+	}
+	return true;
+}
+
 /** Generates a set of evaluation points for a multivariate polynomial.
  *  The set fulfills the following conditions:
  *  1. lcoeff(evaluated_polynomial) does not vanish
@@ -2191,55 +3678,146 @@ static bool checkdivisors(const lst& f)
 static void generate_set(const ex& u, const ex& vn, const exset& syms, const lst& f,
                          numeric& modulus, ex& u0, vector<numeric>& a)
 {
-	const ex& x = *syms.begin();
 	while ( true ) {
 		++modulus;
 		// generate a set of integers ...
-		u0 = u;
-		ex vna = vn;
-		ex vnatry;
-		exset::const_iterator s = syms.begin();
-		++s;
-		for ( size_t i=0; i<a.size(); ++i ) {
-			do {
-				a[i] = mod(numeric(rand()), 2*modulus) - modulus;
-				vnatry = vna.subs(*s == a[i]);
-				// ... for which the leading coefficient doesn't vanish ...
-			} while ( vnatry == 0 );
-			vna = vnatry;
-			u0 = u0.subs(*s == a[i]);
-			++s;
-		}
-		// ... for which u0 is square free ...
-		ex g = gcd(u0, u0.diff(ex_to<symbol>(x)));
-		if ( !is_a<numeric>(g) ) {
-			continue;
+		draw_set(vn, syms, modulus, a);
+		if ( check_set(u, vn, syms, f, a, u0) ) {
+			// ok, we have a valid set now
+			return;
 		}
-		if ( !is_a<numeric>(vn) ) {
-			// ... and for which the evaluated factors have each an unique prime factor
-			lst fnum = f;
-			fnum.let_op(0) = fnum.op(0) * u0.content(x);
-			for ( size_t i=1; i<fnum.nops(); ++i ) {
-				if ( !is_a<numeric>(fnum.op(i)) ) {
-					s = syms.begin();
-					++s;
-					for ( size_t j=0; j<a.size(); ++j, ++s ) {
-						fnum.let_op(i) = fnum.op(i).subs(*s == a[j]);
+	}
+}
+
+/** Test of a set of evaluation points, one trial of factor_multivariate(). */
+struct set_trial
+{
+	ex u, vn, f;
+	const exset* syms;
+	vector<numeric> a;
+	numeric modulus;
+	bool valid;  // a fulfills the conditions of generate_set()
+	ex u0;       // evaluated polynomial if a is valid
+	bool failed;
+};
+
+static void run_trial(set_trial& t)
+{
+	t.valid = check_set(t.u, t.vn, *t.syms, ex_to<lst>(t.f), t.a, t.u0);
+}
+
+/** Supplies sets of evaluation points like generate_set(). With several
+ *  threads, a batch of sets is drawn at once by the calling thread and the
+ *  sets are tested concurrently. They are handed out in the order they were
+ *  drawn in, so the result is the same as with one thread. The threads work
+ *  on copies of the polynomials.
+ */
+class evaluation_sets
+{
+	const ex& u;
+	const ex& vn;
+	const exset& syms;
+	const lst& f;
+#ifdef PARALLEL_TRIALS
+	vector<set_trial> batch;
+	size_t next;
+	bool parallel;
+
+	/** Set up a trial for every thread, with numbers of its own. */
+	void init_batch(const numeric& modulus, const vector<numeric>& a)
+	{
+		batch.resize(factor_threads);
+		for ( size_t i=0; i<batch.size(); ++i ) {
+			set_trial& t = batch[i];
+			t.u = u;
+			t.vn = vn;
+			t.f = f;
+			if ( i > 0 && !(copy_numbers(u, t.u) && copy_numbers(vn, t.vn) && copy_numbers(f, t.f)) ) {
+				parallel = false;
+			}
+			t.syms = &syms;
+			t.a = a;
+			t.modulus = modulus;
+		}
+		next = batch.size();
+	}
+#endif
+public:
+	evaluation_sets(const ex& u_, const ex& vn_, const exset& syms_, const lst& f_)
+	  : u(u_), vn(vn_), syms(syms_), f(f_)
+#ifdef PARALLEL_TRIALS
+	  , next(0), parallel(factor_threads > 1)
+#endif
+	{ }
+
+	/** Get the next valid set, parameters as for generate_set(). */
+	void operator()(numeric& modulus, ex& u0, vector<numeric>& a)
+	{
+#ifdef PARALLEL_TRIALS
+		if ( parallel && batch.empty() ) {
+			init_batch(modulus, a);
+		}
+		if ( parallel ) {
+			while ( true ) {
+				if ( next == batch.size() ) {
+					// continue after the last set drawn
+					numeric m = batch.back().modulus;
+					for ( size_t i=0; i<batch.size(); ++i ) {
+						++m;
+						draw_set(vn, syms, m, batch[i].a);
+						batch[i].modulus = m;
+						batch[i].failed = false;
 					}
+					run_trials(batch);
+					next = 0;
+				}
+				set_trial& t = batch[next++];
+				if ( t.failed ) {
+					// repeat it here to get the exception
+					t.valid = check_set(u, vn, syms, f, t.a, t.u0);
+				}
+				if ( t.valid ) {
+					modulus = t.modulus;
+					u0 = t.u0;
+					a = t.a;
+					return;
 				}
-			}
-			if ( checkdivisors(fnum) ) {
-				continue;
 			}
 		}
-		// ok, we have a valid set now
-		return;
+#endif
+		generate_set(u, vn, syms, f, modulus, u0, a);
 	}
-}
+};
 
 // forward declaration
 static ex factor_sqrfree(const ex& poly);
 
+/** Polynomials with at most this fraction of the terms of a dense polynomial
+ *  of the same degrees are lifted sparsely.
+ */
+static const double sparse_lifting_density = 1.0/16;
+
+/** Decides by the density of its terms whether the factors of a are lifted
+ *  using the skeletons of the factors (see sparse_diophant()).
+ *
+ *  @param[in] a     multivariate polynomial
+ *  @param[in] syms  set of symbols in a
+ *  @return          true if sparse lifting should be tried
+ */
+static bool use_sparse_lifting(const ex& a, const exset& syms)
+{
+	// the first variable lifted provides the skeletons and is lifted densely
+	if ( syms.size() < 3 ) {
+		return false;
+	}
+	double dense = 1;
+	for ( exset::const_iterator s=syms.begin(); s!=syms.end(); ++s ) {
+		dense *= a.degree(*s) + 1;
+	}
+	const size_t nterms = is_a<add>(a) ? a.nops() : 1;
+	return nterms <= sparse_lifting_density * dense;
+}
+
 /** Multivariate factorization.
  *  
  *  The implementation is based on the algorithm described in [Wan].
@@ -2278,9 +3856,11 @@ static ex factor_multivariate(const ex& poly, const exset& syms)
 		vnlst = put_factors_into_lst(vnfactors);
 	}
 
+	const bool sparse = use_sparse_lifting(pp, syms);
 	const unsigned int maxtrials = 3;
 	numeric modulus = (vnlst.nops() > 3) ? vnlst.nops() : 3;
 	vector<numeric> a(syms.size()-1, 0);
+	evaluation_sets next_set(pp, vn, syms, ex_to<lst>(vnlst));
 
 	// try now to factorize until we are successful
 	while ( true ) {
@@ -2294,9 +3874,10 @@ static ex factor_multivariate(const ex& poly, const exset& syms)
 
 		// try several evaluation points to reduce the number of factors
 		while ( trialcount < maxtrials ) {
+			check_budget();
 
 			// generate a set of valid evaluation points
-			generate_set(pp, vn, syms, ex_to<lst>(vnlst), modulus, u, a);
+			next_set(modulus, u, a);
 
 			ufac = factor_univariate(u, x, prime);
 			ufaclst = put_factors_into_lst(ufac);
@@ -2444,7 +4025,11 @@ static ex factor_multivariate(const ex& poly, const exset& syms)
 		}
 
 		// try Hensel lifting
-		ex res = hensel_multivar(pp, x, epv, prime, l, modfactors, C);
+		ex res;
+		{
+			phase_timer timer(lifting_ticks);
+			res = hensel_multivar(pp, x, epv, prime, l, modfactors, C, sparse);
+		}
 		if ( res != lst() ) {
 			ex result = cont * unit;
 			for ( size_t i=0; i<res.nops(); ++i ) {
@@ -2470,10 +4055,228 @@ struct find_symbols_map : public map_function {
 	}
 };
 
+////////////////////////////////////////////////////////////////////////////////
+// cache of irreducible factors
+
+#ifdef GINAC_THREADSAFE_REFCOUNT
+int factor_cache_mutex = 0;
+
+/** Scoped spin lock around accesses to the cache of irreducible factors. No
+ *  polynomial arithmetic is done while it is held.
+ */
+class factor_cache_lock {
+public:
+	factor_cache_lock() { while ( __sync_lock_test_and_set(&factor_cache_mutex, 1) ) ; }
+	~factor_cache_lock() { __sync_lock_release(&factor_cache_mutex); }
+};
+#else
+class factor_cache_lock {
+public:
+	factor_cache_lock() {}
+};
+#endif
+
+/** An irreducible polynomial found by factor(), normalized by
+ *  canonical_factor().
+ */
+struct known_factor
+{
+	unsigned key;  // hash value of f
+	ex f;
+	exset syms;    // symbols in f
+};
+
+typedef list<known_factor> known_factor_list;
+
+/** The irreducible factors remembered by factor(), the most recently used
+ *  first. The index maps the hash values of the factors to the entries,
+ *  which are then compared with is_equal().
+ */
+struct factor_cache
+{
+	known_factor_list factors;
+	size_t size;
+	multimap<unsigned, known_factor_list::iterator> index;
+	factor_cache_statistics stats;
+
+	factor_cache() : size(0)
+	{
+		stats.lookups = stats.hits = stats.divisions = stats.factorizations = 0;
+		stats.size = 0;
+	}
+
+	known_factor_list::iterator find(unsigned key, const ex& f)
+	{
+		typedef multimap<unsigned, known_factor_list::iterator>::const_iterator index_iterator;
+		pair<index_iterator, index_iterator> r = index.equal_range(key);
+		for ( index_iterator i=r.first; i!=r.second; ++i ) {
+			if ( i->second->f.is_equal(f) ) {
+				return i->second;
+			}
+		}
+		return factors.end();
+	}
+
+	void trim(size_t limit)
+	{
+		while ( size > limit ) {
+			known_factor_list::iterator last = --factors.end();
+			typedef multimap<unsigned, known_factor_list::iterator>::iterator index_iterator;
+			pair<index_iterator, index_iterator> r = index.equal_range(last->key);
+			for ( index_iterator i=r.first; i!=r.second; ++i ) {
+				if ( i->second == last ) {
+					index.erase(i);
+					break;
+				}
+			}
+			factors.erase(last);
+			--size;
+		}
+		stats.size = size;
+	}
+};
+
+size_t factor_cache_limit = 0;
+
+/** The cache is shared by all threads and never destroyed. */
+factor_cache& the_factor_cache()
+{
+	static factor_cache* cache = new factor_cache;
+	return *cache;
+}
+
+/** Returns the associate of the polynomial e with integer content 1 and
+ *  positive leading coefficient in the first symbol of syms.
+ */
+static ex canonical_factor(const ex& e, const exset& syms)
+{
+	return (e / (e.integer_content() * e.unit(*syms.begin()))).expand();
+}
+
+/** Checks if poly is a known irreducible polynomial (up to a constant factor).
+ */
+static bool known_irreducible(const ex& poly, const exset& syms)
+{
+	const ex f = canonical_factor(poly, syms);
+	const unsigned key = f.gethash();
+	factor_cache_lock lock;
+	factor_cache& cache = the_factor_cache();
+	known_factor_list::iterator i = cache.find(key, f);
+	if ( i == cache.factors.end() ) {
+		return false;
+	}
+	cache.factors.splice(cache.factors.begin(), cache.factors, i);
+	return true;
+}
+
+/** Divides poly by all known irreducible polynomials which divide it.
+ *
+ *  @param[in]  poly   square free polynomial
+ *  @param[in]  syms   symbols in poly
+ *  @param[out] known  product of the known factors of poly
+ *  @param[out] rest   poly divided by known
+ *  @return            true if any known factor was found
+ */
+static bool divide_known_factors(const ex& poly, const exset& syms, ex& known, ex& rest)
+{
+	// Only the candidates are picked under the lock, the divisions are done
+	// without it.
+	vector<known_factor> candidates;
+	{
+		factor_cache_lock lock;
+		factor_cache& cache = the_factor_cache();
+		for ( known_factor_list::const_iterator i=cache.factors.begin(); i!=cache.factors.end(); ++i ) {
+			if ( includes(syms.begin(), syms.end(), i->syms.begin(), i->syms.end(), ex_is_less()) ) {
+				candidates.push_back(*i);
+			}
+		}
+		cache.stats.divisions += candidates.size();
+	}
+
+	known = 1;
+	rest = poly;
+	vector<known_factor> found;
+	for ( size_t i=0; i<candidates.size(); ++i ) {
+		ex q;
+		if ( divide(rest, candidates[i].f, q, false) ) {
+			known *= candidates[i].f;
+			rest = q;
+			found.push_back(candidates[i]);
+			if ( is_a<numeric>(rest) ) {
+				break;
+			}
+		}
+	}
+	if ( found.empty() ) {
+		return false;
+	}
+
+	factor_cache_lock lock;
+	factor_cache& cache = the_factor_cache();
+	for ( size_t i=0; i<found.size(); ++i ) {
+		known_factor_list::iterator k = cache.find(found[i].key, found[i].f);
+		if ( k != cache.factors.end() ) {
+			cache.factors.splice(cache.factors.begin(), cache.factors, k);
+		}
+	}
+	return true;
+}
+
+/** Remembers the irreducible polynomials fs, the last one as the most
+ *  recently used.
+ */
+static void remember_irreducibles(const exvector& fs)
+{
+	vector<known_factor> factors;
+	for ( size_t i=0; i<fs.size(); ++i ) {
+		const ex& f = fs[i];
+		find_symbols_map findsymbols;
+		findsymbols(f);
+		known_factor k;
+		k.f = canonical_factor(f, findsymbols.syms);
+		k.key = k.f.gethash();
+		k.syms.swap(findsymbols.syms);
+		factors.push_back(k);
+	}
+
+	factor_cache_lock lock;
+	factor_cache& cache = the_factor_cache();
+	for ( size_t i=0; i<factors.size(); ++i ) {
+		if ( factor_cache_limit == 0 ) {
+			break;
+		}
+		if ( cache.find(factors[i].key, factors[i].f) != cache.factors.end() ) {
+			continue;
+		}
+		cache.factors.push_front(factors[i]);
+		cache.index.insert(make_pair(factors[i].key, cache.factors.begin()));
+		++cache.size;
+	}
+	cache.trim(factor_cache_limit);
+}
+
+/** Remembers the irreducible factors in the factorization res.
+ */
+static void remember_factors(const ex& res)
+{
+	exvector fs;
+	const size_t n = is_a<mul>(res) ? res.nops() : 1;
+	for ( size_t i=0; i<n; ++i ) {
+		const ex& f = is_a<mul>(res) ? res.op(i) : res;
+		if ( is_a<add>(f) ) {
+			fs.push_back(f);
+		}
+	}
+	remember_irreducibles(fs);
+}
+
+// END cache of irreducible factors
+////////////////////////////////////////////////////////////////////////////////
+
 /** Factorizes a polynomial that is square free. It calls either the univariate
  *  or the multivariate factorization functions.
  */
-static ex factor_sqrfree(const ex& poly)
+static ex factor_sqrfree_uncached(const ex& poly)
 {
 	// determine all symbols in poly
 	find_symbols_map findsymbols;
@@ -2502,6 +4305,49 @@ static ex factor_sqrfree(const ex& poly)
 	return res;
 }
 
+/** Factorizes a polynomial that is square free. If set_factor_cache_size() has
+ *  set up a cache, the known irreducible factors are divided out first, and
+ *  only the remaining cofactor is factorized. Its irreducible factors are
+ *  remembered.
+ */
+static ex factor_sqrfree(const ex& poly)
+{
+	if ( factor_cache_limit == 0 ) {
+		return factor_sqrfree_uncached(poly);
+	}
+
+	find_symbols_map findsymbols;
+	findsymbols(poly);
+	if ( findsymbols.syms.size() == 0 ) {
+		return poly;
+	}
+	const bool irreducible = known_irreducible(poly, findsymbols.syms);
+	ex known = 1, rest = poly;
+	bool hit = irreducible || divide_known_factors(poly, findsymbols.syms, known, rest);
+	{
+		factor_cache_lock lock;
+		factor_cache& cache = the_factor_cache();
+		++cache.stats.lookups;
+		if ( hit ) {
+			++cache.stats.hits;
+		}
+	}
+	if ( irreducible ) {
+		return poly;
+	}
+	if ( hit && is_a<numeric>(rest) ) {
+		return known * rest;
+	}
+
+	{
+		factor_cache_lock lock;
+		++the_factor_cache().stats.factorizations;
+	}
+	ex res = factor_sqrfree_uncached(rest);
+	remember_factors(res);
+	return known * res;
+}
+
 /** Map used by factor() when factor_options::all is given to access all
  *  subexpressions and to call factor() on them.
  */
@@ -2531,14 +4377,115 @@ struct apply_factor_map : public map_function {
 	}
 };
 
+/** Appends the factors of f, the factorization of a square free polynomial or
+ *  a monomial, to factors with multiplicity m. Numeric factors go into content.
+ */
+static void collect_factors(const ex& f, unsigned m, numeric& content, vector<pair<ex, unsigned> >& factors)
+{
+	const size_t n = is_a<mul>(f) ? f.nops() : 1;
+	for ( size_t i=0; i<n; ++i ) {
+		const ex& t = is_a<mul>(f) ? f.op(i) : f;
+		if ( is_a<numeric>(t) ) {
+			content *= ex_to<numeric>(t).power(m);
+		}
+		else if ( is_a<power>(t) && t.op(1).info(info_flags::posint) ) {
+			factors.push_back(make_pair(t.op(0), m * ex_to<numeric>(t.op(1)).to_int()));
+		}
+		else {
+			factors.push_back(make_pair(t, m));
+		}
+	}
+}
+
 } // anonymous namespace
 
+/** Set the maximum number of irreducible factors remembered by factor(). The
+ *  cache is shared by all threads and evicts the least recently used factor
+ *  when it is full. A limit of 0 (the default) switches caching off and
+ *  empties the cache.
+ *
+ *  @return previous limit */
+size_t set_factor_cache_size(size_t n)
+{
+	known_factor_list factors;
+	size_t previous;
+	{
+		factor_cache_lock lock;
+		previous = factor_cache_limit;
+		factor_cache_limit = n;
+		factor_cache& cache = the_factor_cache();
+		if ( n == 0 ) {
+			factors.swap(cache.factors);
+			cache.index.clear();
+			cache.size = 0;
+		}
+		cache.trim(n);
+	}
+	// the factors are destroyed here, outside of the lock
+	return previous;
+}
+
+/** Get the factor cache counters. */
+factor_cache_statistics get_factor_cache_statistics()
+{
+	factor_cache_lock lock;
+	return the_factor_cache().stats;
+}
+
+/** Reset the lookup, hit, division and factorization counters (not the cache itself). */
+void reset_factor_cache_statistics()
+{
+	factor_cache_lock lock;
+	factor_cache& cache = the_factor_cache();
+	cache.stats.lookups = cache.stats.hits = cache.stats.divisions = 0;
+	cache.stats.factorizations = 0;
+}
+
+/** The remembered irreducible factors, the most recently used first, as a
+ *  list written by serialize(), see save_caches().
+ */
+std::string save_factor_cache(const lst& syms)
+{
+	lst factors;
+	{
+		factor_cache_lock lock;
+		const factor_cache& cache = the_factor_cache();
+		for ( known_factor_list::const_iterator i=cache.factors.begin(); i!=cache.factors.end(); ++i ) {
+			factors.append(i->f);
+		}
+	}
+	std::string buf;
+	serialize(factors, buf, syms);
+	return buf;
+}
+
+/** Remembers the factors written by save_factor_cache(), as far as the
+ *  cache size allows.
+ */
+void load_factor_cache(const std::string& buf, lst& syms)
+{
+	const ex factors = deserialize(buf, syms);
+	if ( !is_a<lst>(factors) ) {
+		throw runtime_error("load_caches(): invalid factor cache");
+	}
+	exvector fs;
+	for ( size_t i=factors.nops(); i-->0; ) {
+		if ( !is_a<add>(factors.op(i)) ) {
+			throw runtime_error("load_caches(): invalid factor cache");
+		}
+		fs.push_back(factors.op(i));
+	}
+	remember_irreducibles(fs);
+}
+
 /** Interface function to the outside world. It checks the arguments, tries a
  *  square free factorization, and then calls factor_sqrfree to do the hard
  *  work.
  */
 ex factor(const ex& poly, unsigned options)
 {
+	profile_timer timer(profile_factor);
+	trace_scope trace("factor", "nops", poly.nops());
 	// check arguments
 	if ( !poly.info(info_flags::polynomial) ) {
 		if ( options & factor_options::all ) {
@@ -2608,6 +4555,49 @@ ex factor(const ex& poly, unsigned options)
 	return f;
 }
 
+/** Interface function returning the factors of a polynomial without
+ *  multiplying them. The square free factorization is traversed like in
+ *  factor(), the factorizations of its components are taken apart directly.
+ */
+ex factor_list(const ex& poly, vector<pair<ex, unsigned> >& factors)
+{
+	factors.clear();
+	if ( is_a<numeric>(poly) ) {
+		return poly;
+	}
+
+	// determine all symbols in poly
+	find_symbols_map findsymbols;
+	findsymbols(poly);
+	if ( !poly.info(info_flags::polynomial) || findsymbols.syms.size() == 0 ) {
+		factors.push_back(make_pair(poly, 1u));
+		return _ex1;
+	}
+	lst syms;
+	exset::const_iterator i=findsymbols.syms.begin(), end=findsymbols.syms.end();
+	for ( ; i!=end; ++i ) {
+		syms.append(*i);
+	}
+
+	// make poly square free and factorize its components
+	numeric content = 1;
+	ex sfpoly = sqrfree(poly.expand(), syms);
+	const size_t n = is_a<mul>(sfpoly) ? sfpoly.nops() : 1;
+	for ( size_t k=0; k<n; ++k ) {
+		const ex& t = is_a<mul>(sfpoly) ? sfpoly.op(k) : sfpoly;
+		const ex& base = is_a<power>(t) ? t.op(0) : t;
+		if ( is_a<add>(base) ) {
+			const unsigned m = is_a<power>(t) ? ex_to<numeric>(t.op(1)).to_int() : 1;
+			collect_factors(factor_sqrfree(base), m, content, factors);
+		}
+		else {
+			// monomials and numbers
+			collect_factors(t, 1, content, factors);
+		}
+	}
+	return content;
+}
+
 } // namespace GiNaC
 
 #ifdef DEBUGFACTOR
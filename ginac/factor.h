@@ -23,6 +23,10 @@
 #ifndef GINAC_FACTOR_H
 #define GINAC_FACTOR_H
 
+#include <cstddef>
+#include <utility>
+#include <vector>
+
 namespace GiNaC {
 
 class ex;
@@ -41,6 +45,60 @@ class ex;
  */
 extern ex factor(const ex& poly, unsigned options = 0);
 
+/** Factorizes a polynomial like factor(), but returns the irreducible factors
+ *  and their multiplicities instead of their product.
+ *
+ *  A polynomial is decomposed into its numeric content times the product of
+ *  the factors raised to their multiplicities. Expressions which are not
+ *  polynomials are returned as a single factor of multiplicity 1.
+ *
+ *  @param[in]  poly     expression to factorize
+ *  @param[out] factors  list of (factor, multiplicity) pairs
+ *  @return              numeric content of poly
+ */
+extern ex factor_list(const ex& poly, std::vector<std::pair<ex, unsigned> >& factors);
+
+// Number of threads factor() uses for its trials of primes and evaluation
+// points (default 1), returns previous setting
+extern unsigned set_factor_threads(unsigned n);
+extern unsigned get_factor_threads();
+
+// Degree of quotient and divisor from which factor() divides polynomials
+// modulo primes by Newton iteration (default 2048), returns previous setting
+extern unsigned set_factor_division_threshold(unsigned n);
+
+// Processor time in seconds spent by factor() in its phases
+struct factor_timing_statistics {
+	double modular;        ///< factoring modulo primes
+	double lifting;        ///< Hensel lifting
+	double recombination;  ///< combining modular factors, except the lifting
+};
+
+// Get the phase timings of factor()
+extern factor_timing_statistics get_factor_timing_statistics();
+
+// Reset the phase timings of factor()
+extern void reset_factor_timing_statistics();
+
+// Maximum number of irreducible factors remembered by factor() and divided
+// out of later polynomials first (0 = no caching, the default), returns previous limit
+extern std::size_t set_factor_cache_size(std::size_t n);
+
+// Counters describing the effectiveness of the factor cache
+struct factor_cache_statistics {
+	unsigned long lookups;    ///< square free polynomials looked up in the cache
+	unsigned long hits;       ///< of which were known or had known factors
+	unsigned long divisions;  ///< trial divisions by known factors
+	unsigned long factorizations;  ///< lookups which left a polynomial to factor
+	std::size_t size;         ///< number of factors currently remembered
+};
+
+// Get the factor cache counters
+extern factor_cache_statistics get_factor_cache_statistics();
+
+// Reset the lookup, hit, division and factorization counters (not the cache itself)
+extern void reset_factor_cache_statistics();
+
 } // namespace GiNaC
 
 #endif // ndef GINAC_FACTOR_H
@@ -133,7 +133,16 @@ public:
 		 *  division.  The determinant can then be read of from the lower
 		 *  right entry.  This algorithm is rarely fast for computing
 		 *  determinants. */
-		bareiss
+		bareiss,
+		/** Evaluation and interpolation modulo primes.  The variables are
+		 *  replaced by the points of a grid, the numeric determinants are
+		 *  computed modulo word sized primes and the polynomial determinant
+		 *  is reconstructed by interpolation and Chinese remaindering.  This
+		 *  only works for polynomial entries with rational coefficients;
+		 *  for other matrices the automatic choice is used instead.  It is
+		 *  the algorithm of choice for larger matrices of polynomials in
+		 *  few variables. */
+		modular
 	};
 };
 
@@ -182,7 +191,38 @@ public:
 		 *  linear systems.  In contrast to division-free elimination it only
 		 *  has a linear expression swell.  For two-dimensional systems, the
 		 *  two algorithms are equivalent, however. */
-		bareiss
+		bareiss,
+		/** Gauss elimination on a sparse_matrix, which only stores the
+		 *  nonzero entries and chooses the pivots such that few new ones
+		 *  are created (Markowitz' criterion).  This is the algorithm of
+		 *  choice for large systems most coefficients of which vanish. */
+		sparse
+	};
+};
+
+/** Switch to control how the elimination schemes of class matrix choose
+ *  their pivots among the nonzero elements of the pivot column, if the
+ *  elements are symbolic.  The choice mostly decides how large the
+ *  intermediate expressions grow.
+ *  @see set_pivot_strategy() */
+class pivot_strategy {
+public:
+	enum {
+		/** The first nonzero element, as found going down the column.
+		 *  This is the default. */
+		first_nonzero,
+		/** The element with the fewest terms, so that the expressions it
+		 *  is multiplied with or divided by grow the least. */
+		min_terms,
+		/** The element whose row has the fewest nonzero elements right of
+		 *  the pivot column, following Markowitz' criterion, which is the
+		 *  product of that number and of the nonzero elements in the pivot
+		 *  column.  Ties are broken by the number of terms. */
+		markowitz,
+		/** The element whose row creates the fewest new nonzero elements
+		 *  in the other rows of the step, counted exactly.  Ties are broken
+		 *  by the number of terms. */
+		min_fill
 	};
 };
 
@@ -200,7 +240,10 @@ public:
 		has_no_indices	= 0x0040, // ! (has_indices || has_no_indices) means "don't know"
 		is_positive	= 0x0080,
 		is_negative	= 0x0100,
-		purely_indefinite = 0x0200  // If set in a mul, then it does not contains any terms with determined signs, used in power::expand()
+		purely_indefinite = 0x0200, // If set in a mul, then it does not contains any terms with determined signs, used in power::expand()
+		hash_consed     = 0x0400, ///< object is registered in the hash-consing table, @see set_hash_consing()
+		normal_cached   = 0x0800, ///< .normal() has remembered the normal form of the object, @see set_normal_caching()
+		symbols_calculated = 0x1000 ///< .calc_symbol_mask() has already done its job
 	};
 };
 
@@ -297,6 +340,31 @@ public:
 	};
 };
 
+/** Flags to control zero_test(). */
+class zero_test_options {
+public:
+	enum {
+		modular         = 0x0000, ///< evaluate modulo random primes
+		rational_points = 0x0001  ///< evaluate with exact rational arithmetic
+	};
+};
+
+/** Switch to control the multiplication of large polynomials in expand()
+ *  and the exact division in divide(), see set_polynomial_backend(). */
+class polynomial_backend {
+public:
+	enum {
+		/** Kronecker substitution for dense polynomials, the heap
+		 *  algorithm for the others. */
+		automatic,
+		/** Always the heap algorithm on sparse distributed polynomials. */
+		heap,
+		/** Kronecker substitution whenever the univariate images are not
+		 *  too long, however sparse the polynomials are. */
+		kronecker
+	};
+};
+
 } // namespace GiNaC
 
 #endif // ndef GINAC_FLAGS_H
@@ -30,25 +30,31 @@
 #include "ex.h"
 #include "normal.h"
 #include "archive.h"
+#include "distributed.h"
+#include "caches.h"
 #include "print.h"
 
 #include "constant.h"
 #include "fail.h"
 #include "integral.h"
 #include "lst.h"
+#include "lu_decomposition.h"
 #include "matrix.h"
+#include "sparse_matrix.h"
 #include "numeric.h"
 #include "power.h"
 #include "relational.h"
 #include "structure.h"
 #include "symbol.h"
 #include "pseries.h"
+#include "mseries.h"
 #include "wildcard.h"
 #include "symmetry.h"
 
 #include "expair.h"
 #include "expairseq.h"
 #include "add.h"
+#include "disk_add.h"
 #include "mul.h"
 
 #include "exprseq.h"
@@ -59,6 +65,7 @@
 #include "fderivative.h"
 #include "operators.h"
 #include "hash_map.h"
+#include "concurrent_hash_map.h"
 
 #include "idx.h"
 #include "indexed.h"
@@ -67,6 +74,11 @@
 #include "clifford.h"
 
 #include "factor.h"
+#include "zero_test.h"
+#include "profile.h"
+#include "budget.h"
+#include "tasks.h"
+#include "async.h"
 
 #include "excompiler.h"
 
@@ -28,35 +28,64 @@
 #include <iterator>
 #include <list>
 #include <utility>
+#include <vector>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
 
 namespace GiNaC {
 
 /*
- *  "Hashmap Light" - buckets only contain one value, quadratic probing,
- *  grows automatically
+ *  "Hashmap Light" - buckets only contain one value, buckets are probed in
+ *  groups whose tags are compared at once, grows automatically
  */
 
 namespace internal {
 
-// List of prime numbers shamelessly stolen from GCC STL
-enum { num_primes = 29 };
+/** Number of buckets in a group.  Their tags are compared at once. */
+enum { hash_group_size = 16 };
 
-static const unsigned long prime_list[num_primes] =
+/** Bit mask of the tags among the hash_group_size ones at p equal to tag. */
+inline unsigned match_hash_tags(const unsigned char *p, unsigned char tag)
 {
-	31ul,        53ul,         97ul,         193ul,       389ul,
-	769ul,       1543ul,       3079ul,       6151ul,      12289ul,
-	24593ul,     49157ul,      98317ul,      196613ul,    393241ul,
-	786433ul,    1572869ul,    3145739ul,    6291469ul,   12582917ul,
-	25165843ul,  50331653ul,   100663319ul,  201326611ul, 402653189ul,
-	805306457ul, 1610612741ul, 3221225473ul, 4294967291ul
-};
+#ifdef __SSE2__
+	const __m128i group = _mm_loadu_si128(reinterpret_cast<const __m128i *>(p));
+	return _mm_movemask_epi8(_mm_cmpeq_epi8(group, _mm_set1_epi8(static_cast<char>(tag))));
+#else
+	unsigned mask = 0;
+	for (unsigned i = 0; i < hash_group_size; ++i)
+		if (p[i] == tag)
+			mask |= 1u << i;
+	return mask;
+#endif
+}
+
+/** Position of the lowest bit set in a nonzero mask. */
+inline unsigned lowest_bit(unsigned mask)
+{
+#ifdef __GNUC__
+	return __builtin_ctz(mask);
+#else
+	unsigned i = 0;
+	while (!(mask & 1)) {
+		mask >>= 1;
+		++i;
+	}
+	return i;
+#endif
+}
 
-inline unsigned long next_prime(unsigned long n)
+/** Scramble the bits of a hash value, which are poorly distributed for
+ *  some classes, so that all of them depend on all bits of the argument. */
+inline unsigned mix_hash(unsigned h)
 {
-	const unsigned long *first = prime_list;
-	const unsigned long *last = prime_list + num_primes;
-	const unsigned long *pos = std::lower_bound(first, last, n);
-	return pos == last ? *(last - 1) : *pos;
+	h ^= h >> 16;
+	h *= 0x85ebca6bU;
+	h ^= h >> 13;
+	h *= 0xc2b2ae35U;
+	h ^= h >> 16;
+	return h;
 }
 
 } // namespace internal
@@ -66,10 +95,25 @@ inline unsigned long next_prime(unsigned long n)
 template <typename T, template <class> class A = std::allocator>
 class exhashmap;
 
+template <typename T, template <class> class A>
+class concurrent_exhashmap;
+
 
 /** Pair Associative Container with 'ex' objects as keys, that is implemented
  *  with a hash table and can be used as a replacement for map<> in many cases.
  *
+ *  The buckets are split into groups of hash_group_size.  A key is looked
+ *  for in a sequence of groups starting from its home group, and in each
+ *  group only in the buckets whose one-byte tag, taken from the hash value,
+ *  matches.  The tags of a group are compared at once, with SSE2 if
+ *  available.  The full hash value of every key is stored, so that keys
+ *  are only compared with is_equal() if their hash values are equal and
+ *  the table grows without calling gethash().  Every group counts the keys
+ *  stored beyond it in their sequence because it was full (a count that
+ *  reached 255 stays there).  Where that count is zero, the search for a
+ *  key ends, so that erasing a key frees its bucket for good rather than
+ *  leaving a marker behind.
+ *
  *  Differences to map<>:
  *   - no lower_bound()/upper_bound()
  *   - no reverse iterators, no rbegin()/rend()
@@ -81,7 +125,7 @@ class exhashmap;
 template <typename T, template <class> class A>
 class exhashmap {
 public:
-	static const unsigned min_num_buckets = 31; // must be prime
+	static const unsigned min_num_buckets = 32; // must be a power of 2 times hash_group_size
 
 	// Standard types
 	typedef ex key_type;
@@ -96,12 +140,7 @@ public:
 
 protected:
 	// Private types
-	enum bucket_state {
-		EMPTY,  ///< bucket empty (never used)
-		USED,   ///< bucket in use
-		ERASED  ///< bucket empty (element deleted), but may be part of a search chain
-	};
-	typedef std::pair<bucket_state, value_type> Bucket;
+	typedef std::pair<unsigned, value_type> Bucket; ///< hash value and value
 
 public:
 	// More standard types
@@ -114,6 +153,12 @@ protected:
 	typedef typename Table::iterator table_iterator;
 	typedef typename Table::const_iterator table_const_iterator;
 
+	/** Tag of an empty bucket.  The tags of used buckets have the high bit set. */
+	static const unsigned char empty_tag = 0;
+
+	/** Overflow count that sticks, because it may be short of the true one. */
+	static const unsigned char max_overflow = 255;
+
 public:
 	// Iterators
 	template <typename Pointer, typename Reference, class TableIterator>
@@ -123,13 +168,13 @@ public:
 
 	public:
 		exhashmap_iterator() {}
-		exhashmap_iterator(TableIterator t, TableIterator te)
-		 : it(t), table_end(te) {}
+		exhashmap_iterator(TableIterator t, TableIterator te, const unsigned char *tg)
+		 : it(t), table_end(te), tag(tg) {}
 
 		// Allow iterator to const_iterator conversion
 		template <typename P, typename R, class TI>
 		exhashmap_iterator(const exhashmap_iterator<P, R, TI> &other)
-		 : it(other.get_it_()), table_end(other.get_table_end_()) {}
+		 : it(other.get_it_()), table_end(other.get_table_end_()), tag(other.get_tag_()) {}
 
 		typename exhashmap_iterator::reference operator*() const
 		{
@@ -169,19 +214,25 @@ public:
 		// Private access function
 		TableIterator get_it_() const { return it; }
 		TableIterator get_table_end_() const { return table_end; }
+		const unsigned char *get_tag_() const { return tag; }
 
 	protected:
-		TableIterator it;        ///< Pointer to current bucket
-		TableIterator table_end; ///< Pointer to one-past-last bucket
+		TableIterator it;         ///< Pointer to current bucket
+		TableIterator table_end;  ///< Pointer to one-past-last bucket
+		const unsigned char *tag; ///< Pointer to the tag of the current bucket
 
 		void increment()
 		{
-			if (it != table_end)
+			if (it != table_end) {
 				++it;
+				++tag;
+			}
 
-			// Skip empty and erased buckets
-			while (it != table_end && it->first != USED)
+			// Skip empty buckets
+			while (it != table_end && *tag == empty_tag) {
 				++it;
+				++tag;
+			}
 		}
 	};
 
@@ -215,57 +266,89 @@ protected:
 	// Private data
 	size_type num_entries; ///< Number of values stored in container (cached for faster operation of size())
 	size_type num_buckets; ///< Number of buckets (= hashtab.size())
-	Table hashtab;         ///< Vector of buckets, each bucket is kept sorted
+	Table hashtab;         ///< Vector of buckets
+	std::vector<unsigned char> tags;  ///< Tag of each bucket, empty_tag if it is empty
+	std::vector<unsigned char> overflows; ///< Number of keys stored beyond each group, up to max_overflow
 
-	/** Return index of key in hash table. */
-	static size_type hash_index(const key_type &x, size_type nbuckets)
+	/** Return the tag of keys with the given mixed hash value. */
+	static unsigned char hash_tag(unsigned mixed)
 	{
-		return x.gethash() % nbuckets;
+		return static_cast<unsigned char>(0x80 | (mixed >> 25));
 	}
 
-	static table_iterator find_bucket(const key_type &x, table_iterator tab, size_type nbuckets);
-	static table_const_iterator find_bucket(const key_type &x, table_const_iterator tab, size_type nbuckets);
-	static table_iterator find_bucket_for_insertion(const key_type &x, table_iterator tab, size_type nbuckets);
+	/** Return the first group in the probe sequence of a mixed hash value. */
+	size_type home_group(unsigned mixed) const
+	{
+		return mixed & (num_buckets / internal::hash_group_size - 1);
+	}
 
-	/** Return pointer to bucket corresponding to key (or first empty bucket). */
-	table_iterator find_bucket(const key_type &x)
+	/** Return the group following g in the probe sequence, which visits
+	 *  every group once in the first number-of-groups steps. */
+	size_type next_group(size_type g, size_type step) const
 	{
-		return find_bucket(x, hashtab.begin(), num_buckets);
+		return (g + step) & (num_buckets / internal::hash_group_size - 1);
 	}
 
-	/** Return pointer to bucket corresponding to key (or first empty bucket). */
-	table_const_iterator find_bucket(const key_type &x) const
+	size_type find_index(const key_type &x, unsigned h) const;
+	size_type place(unsigned h);
+
+	/** Make an empty table with the given number of buckets. */
+	void init(size_type nbuckets)
+	{
+		num_entries = 0;
+		num_buckets = nbuckets;
+		hashtab.assign(num_buckets, Bucket(0, value_type()));
+		tags.assign(num_buckets, empty_tag);
+		overflows.assign(num_buckets / internal::hash_group_size, 0);
+	}
+
+	/** Return the smallest valid number of buckets not below n. */
+	static size_type round_num_buckets(size_type n)
 	{
-		return find_bucket(x, hashtab.begin(), num_buckets);
+		size_type nbuckets = min_num_buckets;
+		while (nbuckets < n)
+			nbuckets *= 2;
+		return nbuckets;
 	}
 
-	/** Return pointer to bucket corresponding to key (or first empty or erased bucket). */
-	table_iterator find_bucket_for_insertion(const key_type &x)
+	iterator make_iterator(size_type i)
 	{
-		return find_bucket_for_insertion(x, hashtab.begin(), num_buckets);
+		return iterator(hashtab.begin() + i, hashtab.end(), &tags[0] + i);
+	}
+
+	const_iterator make_iterator(size_type i) const
+	{
+		return const_iterator(hashtab.begin() + i, hashtab.end(), &tags[0] + i);
 	}
 
 	/** Return number of entries above which the table will grow. */
 	size_type hwm() const
 	{
-		// Try to keep at least 25% of the buckets free
-		return num_buckets - (num_buckets >> 2);
+		// Try to keep at least 12.5% of the buckets free
+		return num_buckets - (num_buckets >> 3);
 	}
 
 	void grow();
 
+	template <typename U, template <class> class B>
+	friend class concurrent_exhashmap;
+
 public:
 	// 23.3.1.1 Construct/copy/destroy
 	exhashmap()
-	 : num_entries(0), num_buckets(min_num_buckets), hashtab(num_buckets, std::make_pair(EMPTY, std::make_pair(0, mapped_type()))) {}
+	{
+		init(min_num_buckets);
+	}
 
 	explicit exhashmap(size_type nbuckets)
-	 : num_entries(0), num_buckets(internal::next_prime(nbuckets)), hashtab(num_buckets, std::make_pair(EMPTY, std::make_pair(0, mapped_type()))) {}
+	{
+		init(round_num_buckets(nbuckets));
+	}
 
 	template <class InputIterator>
 	exhashmap(InputIterator first, InputIterator last)
-	 : num_entries(0), num_buckets(min_num_buckets), hashtab(num_buckets, std::make_pair(EMPTY, std::make_pair(0, mapped_type())))
 	{
+		init(min_num_buckets);
 		insert(first, last);
 	}
 
@@ -279,29 +362,29 @@ public:
 	iterator begin()
 	{
 		// Find first used bucket
-		table_iterator bucket = hashtab.begin();
-		while (bucket != hashtab.end() && bucket->first != USED)
-			++bucket;
-		return iterator(bucket, hashtab.end());
+		size_type i = 0;
+		while (i < num_buckets && tags[i] == empty_tag)
+			++i;
+		return make_iterator(i);
 	}
 
 	const_iterator begin() const
 	{
 		// Find first used bucket
-		table_const_iterator bucket = hashtab.begin();
-		while (bucket != hashtab.end() && bucket->first != USED)
-			++bucket;
-		return const_iterator(bucket, hashtab.end());
+		size_type i = 0;
+		while (i < num_buckets && tags[i] == empty_tag)
+			++i;
+		return make_iterator(i);
 	}
 
 	iterator end()
 	{
-		return iterator(hashtab.end(), hashtab.end());
+		return make_iterator(num_buckets);
 	}
 
 	const_iterator end() const
 	{
-		return const_iterator(hashtab.end(), hashtab.end());
+		return make_iterator(num_buckets);
 	}
 
 	// Capacity
@@ -346,19 +429,15 @@ public:
 			insert(*first);
 	}
 
-	void erase(iterator position)
-	{
-		table_iterator bucket = position.get_it_();
-		bucket->first = ERASED;
-		bucket->second.first = 0;
-		--num_entries;
-	}
+	void erase(iterator position);
 
 	size_type erase(const key_type &x);
 
 	void swap(exhashmap &other)
 	{
 		hashtab.swap(other.hashtab);
+		tags.swap(other.tags);
+		overflows.swap(other.overflows);
 		std::swap(num_buckets, other.num_buckets);
 		std::swap(num_entries, other.num_entries);
 	}
@@ -377,8 +456,15 @@ public:
 	}
 
 	// 23.3.1.3 Map operations
-	iterator find(const key_type &x);
-	const_iterator find(const key_type &x) const;
+	iterator find(const key_type &x)
+	{
+		return make_iterator(find_index(x, x.gethash()));
+	}
+
+	const_iterator find(const key_type &x) const
+	{
+		return make_iterator(find_index(x, x.gethash()));
+	}
 
 	size_type count(const key_type &x) const
 	{
@@ -435,107 +521,124 @@ public:
 	{
 		std::clog << "num_entries = " << num_entries << std::endl;
 		std::clog << "num_buckets = " << num_buckets << std::endl;
-		size_type t = 0;
-		for (table_const_iterator it = hashtab.begin(); it != hashtab.end(); ++it, ++t) {
+		for (size_type t = 0; t < num_buckets; ++t) {
+			if (t % internal::hash_group_size == 0)
+				std::clog << "group " << t / internal::hash_group_size << ": " << unsigned(overflows[t / internal::hash_group_size]) << " overflowing" << std::endl;
 			std::clog << " bucket " << t << ": ";
-			std::clog << (it->first == EMPTY ? "free" : (it->first == USED ? "used" : "erased")) << ", " << it->second.first << " -> " << it->second.second << std::endl;
+			if (tags[t] == empty_tag)
+				std::clog << "free" << std::endl;
+			else
+				std::clog << "used, hash " << hashtab[t].first << ", " << hashtab[t].second.first << " -> " << hashtab[t].second.second << std::endl;
 		}
 	}
 #endif
 };
 
-/** Return pointer to bucket corresponding to key (or first empty bucket). */
 template <typename T, template <class> class A>
-inline typename exhashmap<T, A>::table_iterator exhashmap<T, A>::find_bucket(const key_type &x, table_iterator tab, size_type nbuckets)
-{
-	// Quadratic probing
-	size_type h = hash_index(x, nbuckets);
-	size_type d = 1;
-	table_iterator it = tab + h;
-	while (it->first != EMPTY && !(it->first == USED && key_equal()(it->second.first, x))) {
-		h = (h + d) % nbuckets;
-		d += 2;
-		it = tab + h;
-	}
-	return it;
-}
+const unsigned exhashmap<T, A>::min_num_buckets;
+
+template <typename T, template <class> class A>
+const unsigned char exhashmap<T, A>::empty_tag;
+
+template <typename T, template <class> class A>
+const unsigned char exhashmap<T, A>::max_overflow;
 
-/** Return pointer to bucket corresponding to key (or first empty bucket). */
+/** Return index of the bucket holding the key with hash value h (or
+ *  num_buckets if there is none). */
 template <typename T, template <class> class A>
-inline typename exhashmap<T, A>::table_const_iterator exhashmap<T, A>::find_bucket(const key_type &x, table_const_iterator tab, size_type nbuckets)
+typename exhashmap<T, A>::size_type exhashmap<T, A>::find_index(const key_type &x, unsigned h) const
 {
-	// Quadratic probing
-	size_type h = hash_index(x, nbuckets);
-	size_type d = 1;
-	table_const_iterator it = tab + h;
-	while (it->first != EMPTY && !(it->first == USED && key_equal()(it->second.first, x))) {
-		h = (h + d) % nbuckets;
-		d += 2;
-		it = tab + h;
-	}
-	return it;
+	const unsigned mixed = internal::mix_hash(h);
+	const unsigned char tag = hash_tag(mixed);
+	const size_type num_groups = num_buckets / internal::hash_group_size;
+	size_type g = home_group(mixed);
+	for (size_type step = 1; step <= num_groups; ++step) {
+		const size_type first = g * internal::hash_group_size;
+		for (unsigned match = internal::match_hash_tags(&tags[first], tag); match; match &= match - 1) {
+			const size_type i = first + internal::lowest_bit(match);
+			if (hashtab[i].first == h && key_equal()(hashtab[i].second.first, x))
+				return i;
+		}
+		if (!overflows[g])
+			break;
+		g = next_group(g, step);
+	}
+	return num_buckets;
 }
 
-/** Return pointer to bucket corresponding to key (or first empty or erased bucket). */
+/** Claim an empty bucket for a new key with hash value h and return its
+ *  index.  The table must have an empty bucket. */
 template <typename T, template <class> class A>
-inline typename exhashmap<T, A>::table_iterator exhashmap<T, A>::find_bucket_for_insertion(const key_type &x, table_iterator tab, size_type nbuckets)
+typename exhashmap<T, A>::size_type exhashmap<T, A>::place(unsigned h)
 {
-	// Quadratic probing
-	size_type h = hash_index(x, nbuckets);
-	size_type d = 1;
-	table_iterator it = tab + h;
-	while (it->first != EMPTY && !key_equal()(it->second.first, x)) {
-		h = (h + d) % nbuckets;
-		d += 2;
-		it = tab + h;
-	}
-	return it;
+	const unsigned mixed = internal::mix_hash(h);
+	size_type g = home_group(mixed);
+	for (size_type step = 1; ; ++step) {
+		const size_type first = g * internal::hash_group_size;
+		const unsigned free = internal::match_hash_tags(&tags[first], empty_tag);
+		if (free) {
+			const size_type i = first + internal::lowest_bit(free);
+			tags[i] = hash_tag(mixed);
+			hashtab[i].first = h;
+			++num_entries;
+			return i;
+		}
+		if (overflows[g] != max_overflow)
+			++overflows[g];
+		g = next_group(g, step);
+	}
 }
 
 /** Grow hash table */
 template <typename T, template <class> class A>
 void exhashmap<T, A>::grow()
 {
-	// Allocate new empty hash table
-	size_type new_num_buckets = internal::next_prime(num_buckets + 1);
-	Table new_hashtab;
-	new_hashtab.resize(new_num_buckets);
-	for (table_iterator it = new_hashtab.begin(); it != new_hashtab.end(); ++it)
-		it->first = EMPTY;
-
-	// Re-insert all elements into new table
-	for (table_const_iterator it = hashtab.begin(); it != hashtab.end(); ++it) {
-		if (it->first == USED) {
-			table_iterator bucket = find_bucket(it->second.first, new_hashtab.begin(), new_num_buckets);
-			*bucket = *it;
-		}
-	}
-
-	// Swap with the old table
-	hashtab.swap(new_hashtab);
-	num_buckets = new_num_buckets;
+	// Re-insert all elements into a new table with twice the buckets
+	exhashmap bigger(num_buckets * 2);
+	for (size_type i = 0; i < num_buckets; ++i)
+		if (tags[i] != empty_tag)
+			bigger.hashtab[bigger.place(hashtab[i].first)].second = hashtab[i].second;
+	swap(bigger);
 }
 
 template <typename T, template <class> class A>
 std::pair<typename exhashmap<T, A>::iterator, bool> exhashmap<T, A>::insert(const value_type &x)
 {
-	table_iterator bucket = find_bucket_for_insertion(x.first);
-	if (bucket->first == USED) {
+	const unsigned h = x.first.gethash();
+	size_type i = find_index(x.first, h);
+	if (i != num_buckets) {
 		// Value already in map
-		return std::make_pair(iterator(bucket, hashtab.end()), false);
+		return std::make_pair(make_iterator(i), false);
 	} else {
 		// Insert new value
-		bucket->first = USED;
-		bucket->second = x;
-		++num_entries;
-		if (num_entries >= hwm()) {
+		if (num_entries + 1 >= hwm())
 			grow();
-			bucket = find_bucket(x.first);
-		}
-		return std::make_pair(iterator(bucket, hashtab.end()), true);
+		i = place(h);
+		hashtab[i].second = x;
+		return std::make_pair(make_iterator(i), true);
 	}
 }
 
+template <typename T, template <class> class A>
+void exhashmap<T, A>::erase(iterator position)
+{
+	const size_type i = position.get_it_() - hashtab.begin();
+
+	// The groups passed on the way to the bucket no longer overflow with it
+	const size_type last = i / internal::hash_group_size;
+	size_type g = home_group(internal::mix_hash(hashtab[i].first));
+	for (size_type step = 1; g != last; ++step) {
+		if (overflows[g] != max_overflow)
+			--overflows[g];
+		g = next_group(g, step);
+	}
+
+	tags[i] = empty_tag;
+	hashtab[i].second.first = 0;
+	hashtab[i].second.second = mapped_type();
+	--num_entries;
+}
+
 template <typename T, template <class> class A>
 typename exhashmap<T, A>::size_type exhashmap<T, A>::erase(const key_type &x)
 {
@@ -547,35 +650,10 @@ typename exhashmap<T, A>::size_type exhashmap<T, A>::erase(const key_type &x)
 		return 0;
 }
 
-template <typename T, template <class> class A>
-typename exhashmap<T, A>::iterator exhashmap<T, A>::find(const key_type &x)
-{
-	table_iterator bucket = find_bucket(x);
-	if (bucket->first == USED)
-		return iterator(bucket, hashtab.end());
-	else
-		return end();
-}
-
-template <typename T, template <class> class A>
-typename exhashmap<T, A>::const_iterator exhashmap<T, A>::find(const key_type &x) const
-{
-	table_const_iterator bucket = find_bucket(x);
-	if (bucket->first == USED)
-		return const_iterator(bucket, hashtab.end());
-	else
-		return end();
-}
-
 template <typename T, template <class> class A>
 void exhashmap<T, A>::clear()
 {
-	for (table_iterator i = hashtab.begin(); i != hashtab.end(); ++i) {
-		i->first = EMPTY;
-		i->second.first = 0;
-		i->second.second = mapped_type();
-	}
-	num_entries = 0;
+	init(num_buckets);
 }
 
 } // namespace GiNaC
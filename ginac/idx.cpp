@@ -261,7 +261,7 @@ ex idx::map(map_function & f) const
 	else {
 		idx *copy = duplicate();
 		copy->setflag(status_flags::dynallocated);
-		copy->clearflag(status_flags::hash_calculated);
+		copy->clearflag(status_flags::hash_calculated | status_flags::symbols_calculated);
 		copy->value = mapped_value;
 		return *copy;
 	}
@@ -384,7 +384,7 @@ ex idx::subs(const exmap & m, unsigned options) const
 		// Otherwise substitute value
 		idx *i_copy = duplicate();
 		i_copy->value = it->second;
-		i_copy->clearflag(status_flags::hash_calculated);
+		i_copy->clearflag(status_flags::hash_calculated | status_flags::symbols_calculated);
 		return i_copy->setflag(status_flags::dynallocated);
 	}
 
@@ -395,7 +395,7 @@ ex idx::subs(const exmap & m, unsigned options) const
 
 	idx *i_copy = duplicate();
 	i_copy->value = subsed_value;
-	i_copy->clearflag(status_flags::hash_calculated);
+	i_copy->clearflag(status_flags::hash_calculated | status_flags::symbols_calculated);
 	return i_copy->setflag(status_flags::dynallocated);
 }
 
@@ -36,11 +36,15 @@
 #include "integral.h"
 #include "matrix.h"
 #include "inifcns.h"
+#include "tensor.h"
 
+#include <algorithm>
 #include <iostream>
 #include <limits>
+#include <map>
 #include <sstream>
 #include <stdexcept>
+#include <vector>
 
 namespace GiNaC {
 
@@ -768,6 +772,41 @@ static void product_to_exvector(const ex & e, exvector & v, bool & non_commutati
 	}
 }
 
+/** Positions of the indexed factors of a product by the values of their
+ *  indices, so that the factors which may share a dummy index with a given
+ *  one are found without looking at all others. */
+typedef std::map<ex, std::vector<size_t>, ex_is_less> index_positions;
+
+static void map_index_values(const exvector & v, index_positions & positions)
+{
+	positions.clear();
+	for (size_t i=0; i<v.size(); i++) {
+		if (!is_a<indexed>(v[i]))
+			continue;
+		for (size_t j=1; j<v[i].nops(); j++) {
+			std::vector<size_t> & p = positions[ex_to<idx>(v[i].op(j)).get_value()];
+			if (p.empty() || p.back() != i)
+				p.push_back(i);
+		}
+	}
+}
+
+/** Positions after i of the factors with an index value of the factor f at
+ *  position i, in increasing order. */
+static void contraction_candidates(const ex & f, size_t i, const index_positions & positions, std::vector<size_t> & candidates)
+{
+	candidates.clear();
+	for (size_t j=1; j<f.nops(); j++) {
+		index_positions::const_iterator p = positions.find(ex_to<idx>(f.op(j)).get_value());
+		if (p == positions.end())
+			continue;
+		std::vector<size_t>::const_iterator k = std::upper_bound(p->second.begin(), p->second.end(), i);
+		candidates.insert(candidates.end(), k, p->second.end());
+	}
+	std::sort(candidates.begin(), candidates.end());
+	candidates.erase(std::unique(candidates.begin(), candidates.end()), candidates.end());
+}
+
 template<class T> ex idx_symmetrization(const ex& r,const exvector& local_dummy_indices)
 {	exvector dummy_syms;
 	dummy_syms.reserve(r.nops());
@@ -795,10 +834,14 @@ ex simplify_indexed_product(const ex & e, exvector & free_indices, exvector & du
 	bool non_commutative;
 	product_to_exvector(e, v, non_commutative);
 
-	// Perform contractions
+	// Perform contractions.  Only the factors sharing an index value with
+	// the first one are tried as the second one.
 	bool something_changed = false;
 	bool has_nonsymmetric = false;
 	GINAC_ASSERT(v.size() > 1);
+	index_positions positions;
+	map_index_values(v, positions);
+	std::vector<size_t> candidates;
 	exvector::iterator it1, itend = v.end(), next_to_last = itend - 1;
 	for (it1 = v.begin(); it1 != next_to_last; it1++) {
 
@@ -814,9 +857,10 @@ try_again:
 		exvector free1, dummy1;
 		find_free_and_dummy(ex_to<indexed>(*it1).seq.begin() + 1, ex_to<indexed>(*it1).seq.end(), free1, dummy1);
 
-		exvector::iterator it2;
-		for (it2 = it1 + 1; it2 != itend; it2++) {
+		contraction_candidates(*it1, it1 - v.begin(), positions, candidates);
+		for (std::vector<size_t>::const_iterator c = candidates.begin(); c != candidates.end(); ++c) {
 
+			exvector::iterator it2 = v.begin() + *c;
 			if (!is_a<indexed>(*it2))
 				continue;
 
@@ -845,10 +889,11 @@ try_again:
 				);
 
 				// User-defined scalar product?
-				if (sp.is_defined(*it1, *it2, dim)) {
+				ex value;
+				if (sp.lookup(*it1, *it2, dim, value)) {
 
 					// Yes, substitute it
-					*it1 = sp.evaluate(*it1, *it2, dim);
+					*it1 = value;
 					*it2 = _ex1;
 					goto contraction_done;
 				}
@@ -882,6 +927,7 @@ contraction_done:
 				// even not be indexed objects any more, so we have to
 				// start over
 				something_changed = true;
+				map_index_values(v, positions);
 				goto try_again;
 			}
 			else if (!has_nonsymmetric &&
@@ -1041,6 +1087,93 @@ bool hasindex(const ex &x, const ex &sym)
 	return false;
 }
 
+/** Terms of sums with more dummy indices are combined by symmetrizing them
+ *  instead of by their canonical_dummy_form(). */
+static const size_t max_canonical_dummies = 6;
+
+/** Terms of a sum with the same canonical_dummy_form(): the first of them,
+ *  which is kept in the result, its numeric factor in canonical form, and
+ *  the sum of the factors of all of them. */
+struct canonical_terms {
+	canonical_terms(const ex & t, const ex & c) : first(t), first_coeff(c), coeff(c) {}
+	ex first;
+	ex first_coeff;
+	ex coeff;
+};
+
+/** Split a term into its numeric factor and the rest. */
+static void split_numeric_factor(const ex & t, ex & rest, ex & coeff)
+{
+	if (is_exactly_a<numeric>(t)) {
+		rest = _ex1;
+		coeff = t;
+	} else if (is_exactly_a<mul>(t) && is_exactly_a<numeric>(t.op(t.nops() - 1))) {
+		coeff = t.op(t.nops() - 1);
+		rest = t / coeff;
+	} else {
+		rest = t;
+		coeff = _ex1;
+	}
+}
+
+/** Canonical form of a term of a sum under renaming of its dummy indices.
+ *  The dummy index symbols of the term are replaced by the first ones of
+ *  syms in all possible ways, and the replacement giving the smallest term
+ *  (apart from its numeric factor) is taken; the slot symmetries of the
+ *  indexed objects are taken care of by their automatic evaluation.  Terms
+ *  which differ only in the names of dummy indices and the order of
+ *  symmetric slots get the same canonical form.
+ *
+ *  @param syms Sorted symbols of the dummy indices available
+ *  @param rest Canonical form without its numeric factor
+ *  @param coeff Numeric factor, zero if the term vanishes by symmetry
+ *  @return false if the term has too many dummy indices */
+static bool canonical_dummy_form(const ex & term, const exvector & syms, ex & rest, ex & coeff)
+{
+	exvector own;
+	for (exvector::const_iterator i = syms.begin(); i != syms.end(); ++i)
+		if (hasindex(term, *i))
+			own.push_back(*i);
+	if (own.size() > max_canonical_dummies)
+		return false;
+
+	const lst from(own.begin(), own.end());
+	std::vector<size_t> perm(own.size());
+	for (size_t k=0; k<perm.size(); k++)
+		perm[k] = k;
+
+	bool first = true;
+	do {
+		lst to;
+		for (size_t k=0; k<perm.size(); k++)
+			to.append(syms[perm[k]]);
+		ex r, c;
+		split_numeric_factor(term.subs(from, to, subs_options::no_pattern), r, c);
+		if (c.is_zero()) {
+			rest = term;
+			coeff = _ex0;
+			return true;
+		}
+
+		const int cmp = first ? -1 : r.compare(rest);
+		if (cmp < 0) {
+			rest = r;
+			coeff = c;
+			first = false;
+		} else if (cmp == 0 && !c.is_equal(coeff)) {
+
+			// Renaming the dummy indices changes the sign only, so the
+			// term is zero
+			if (!c.is_equal(-coeff))
+				return false;
+			coeff = _ex0;
+			return true;
+		}
+	} while (std::next_permutation(perm.begin(), perm.end()));
+
+	return true;
+}
+
 /** Simplify indexed expression, return list of free indices. */
 ex simplify_indexed(const ex & e, exvector & free_indices, exvector & dummy_indices, const scalar_products & sp)
 {
@@ -1116,6 +1249,50 @@ ex simplify_indexed(const ex & e, exvector & free_indices, exvector & dummy_indi
 		if (num_terms_orig < 2 || dummy_indices.size() < 2)
 			return sum;
 
+		// Combine the terms with the same canonical form under renaming of
+		// dummy indices, unless there are too many of them
+		exvector syms;
+		for (exvector::const_iterator i = dummy_indices.begin(); i != dummy_indices.end(); ++i) {
+			bool is_free = false;
+			for (exvector::const_iterator j = free_indices.begin(); j != free_indices.end(); ++j)
+				if (j->op(0).is_equal(i->op(0)))
+					is_free = true;
+			if (!is_free)
+				syms.push_back(i->op(0));
+		}
+		std::sort(syms.begin(), syms.end(), ex_is_less());
+		syms.erase(std::unique(syms.begin(), syms.end(), ex_is_equal()), syms.end());
+
+		typedef std::map<ex, canonical_terms, ex_is_less> canonical_map;
+		canonical_map canonical;
+		bool ok = true;
+		for (size_t i=0; i<sum.nops() && ok; i++) {
+			ex rest, coeff;
+			ok = canonical_dummy_form(sum.op(i), syms, rest, coeff);
+			if (ok && !coeff.is_zero()) {
+				canonical_map::iterator found = canonical.find(rest);
+				if (found == canonical.end())
+					canonical.insert(std::make_pair(rest, canonical_terms(sum.op(i), coeff)));
+				else
+					found->second.coeff += coeff;
+			}
+		}
+		if (ok) {
+			exvector result;
+			result.reserve(canonical.size());
+			for (canonical_map::const_iterator i = canonical.begin(); i != canonical.end(); ++i) {
+				const canonical_terms & t = i->second;
+				if (t.coeff.is_equal(t.first_coeff))
+					result.push_back(t.first);
+				else if (!t.coeff.is_zero())
+					result.push_back(t.coeff / t.first_coeff * t.first);
+			}
+			ex sum_canonical = (new add(result))->setflag(status_flags::dynallocated);
+			if (sum_canonical.is_zero())
+				free_indices.clear();
+			return sum_canonical;
+		}
+
 		// Chop the sum into terms and symmetrize each one over the dummy
 		// indices
 		std::vector<terminfo> terms;
@@ -1341,6 +1518,11 @@ bool spmapkey::operator<(const spmapkey &other) const
 		return dim.compare(other.dim) < 0;
 }
 
+unsigned spmapkey::hash() const
+{
+	return rotate_left(v1.gethash()) ^ v2.gethash();
+}
+
 void spmapkey::debugprint() const
 {
 	std::cerr << "(" << v1 << "," << v2 << "," << dim << ")";
@@ -1348,12 +1530,39 @@ void spmapkey::debugprint() const
 
 void scalar_products::add(const ex & v1, const ex & v2, const ex & sp)
 {
-	spm[spmapkey(v1, v2)] = sp;
+	insert(spmapkey(v1, v2), sp);
 }
 
 void scalar_products::add(const ex & v1, const ex & v2, const ex & dim, const ex & sp)
 {
-	spm[spmapkey(v1, v2, dim)] = sp;
+	insert(spmapkey(v1, v2, dim), sp);
+}
+
+/** Register the value of a pair in both tables.  Like the map, the hash
+ *  table keeps the first one of several equal keys. */
+void scalar_products::insert(const spmapkey & key, const ex & sp)
+{
+	spm[key] = sp;
+
+	unsigned h = key.hash();
+	std::pair<sphashmap::iterator, sphashmap::iterator> range = sph.equal_range(h);
+	for (sphashmap::iterator i = range.first; i != range.second; ++i) {
+		if (i->second.first == key) {
+			i->second.second = sp;
+			return;
+		}
+	}
+	sph.insert(range.second, std::make_pair(h, std::make_pair(key, sp)));
+}
+
+/** Value of a pair, found by its hash value, or 0 if it is not defined. */
+const ex * scalar_products::find(const spmapkey & key) const
+{
+	std::pair<sphashmap::const_iterator, sphashmap::const_iterator> range = sph.equal_range(key.hash());
+	for (sphashmap::const_iterator i = range.first; i != range.second; ++i)
+		if (i->second.first == key)
+			return &i->second.second;
+	return 0;
 }
 
 void scalar_products::add_vectors(const lst & l, const ex & dim)
@@ -1367,18 +1576,28 @@ void scalar_products::add_vectors(const lst & l, const ex & dim)
 void scalar_products::clear()
 {
 	spm.clear();
+	sph.clear();
 }
 
 /** Check whether scalar product pair is defined. */
 bool scalar_products::is_defined(const ex & v1, const ex & v2, const ex & dim) const
 {
-	return spm.find(spmapkey(v1, v2, dim)) != spm.end();
+	return find(spmapkey(v1, v2, dim)) != 0;
 }
 
 /** Return value of defined scalar product pair. */
 ex scalar_products::evaluate(const ex & v1, const ex & v2, const ex & dim) const
 {
-	return spm.find(spmapkey(v1, v2, dim))->second;
+	return *find(spmapkey(v1, v2, dim));
+}
+
+bool scalar_products::lookup(const ex & v1, const ex & v2, const ex & dim, ex & value) const
+{
+	const ex * sp = find(spmapkey(v1, v2, dim));
+	if (!sp)
+		return false;
+	value = *sp;
+	return true;
 }
 
 void scalar_products::debugprint() const
@@ -1585,4 +1804,357 @@ ex expand_dummy_sum(const ex & e, bool subs_idx)
 	}
 }
 
+/** Components of a (sub)expression for all values of its free indices, as
+ *  used by indexed_components().  The values are stored with the first
+ *  index varying slowest. */
+struct component_table {
+	exvector indices;            ///< free indices, one per axis
+	std::vector<unsigned> dims;  ///< number of values of each index
+	exvector values;
+};
+
+/** Number of numeric values of the index i. */
+static unsigned component_dim(const ex & i, unsigned dim)
+{
+	const ex & d = ex_to<idx>(i).get_dim();
+	if (d.info(info_flags::nonnegint))
+		return ex_to<numeric>(d).to_int();
+	if (dim == 0)
+		throw std::invalid_argument("indexed_components(): dimension of index is not numeric");
+	return dim;
+}
+
+/** Advance the values in counter, with the last one varying fastest, to the
+ *  next combination below the dims.  Returns false after the last one. */
+static bool next_combination(std::vector<unsigned> & counter, const std::vector<unsigned> & dims)
+{
+	for (size_t k = counter.size(); k-- > 0; ) {
+		if (++counter[k] < dims[k])
+			return true;
+		counter[k] = 0;
+	}
+	return false;
+}
+
+static size_t table_size(const std::vector<unsigned> & dims)
+{
+	size_t n = 1;
+	for (size_t k = 0; k < dims.size(); ++k)
+		n *= dims[k];
+	return n;
+}
+
+/** Set up the axes of t for the free indices of e. */
+static void init_table(component_table & t, const exvector & free, unsigned dim)
+{
+	t.indices = free;
+	t.dims.resize(free.size());
+	for (size_t k = 0; k < free.size(); ++k)
+		t.dims[k] = component_dim(free[k], dim);
+	t.values.assign(table_size(t.dims), _ex0);
+}
+
+/** Components of an indexed object by substituting the values of its
+ *  indices, summing over the values of the dummy indices. */
+static void generic_components(component_table & t, const indexed & e, unsigned dim)
+{
+	init_table(t, e.get_free_indices(), dim);
+	const exvector dummies = e.get_dummy_indices();
+	std::vector<unsigned> ddims(dummies.size());
+	for (size_t k = 0; k < dummies.size(); ++k)
+		ddims[k] = component_dim(dummies[k], dim);
+
+	std::vector<unsigned> counter(t.dims.size(), 0), dcounter(dummies.size(), 0);
+	for (size_t n = 0; n < t.values.size(); ++n) {
+		exmap m;
+		for (size_t k = 0; k < counter.size(); ++k)
+			m[t.indices[k].op(0)] = counter[k];
+		exvector terms;
+		do {
+			for (size_t k = 0; k < dcounter.size(); ++k)
+				m[dummies[k].op(0)] = dcounter[k];
+			terms.push_back(e.subs(m, subs_options::no_pattern));
+		} while (next_combination(dcounter, ddims));
+		t.values[n] = (new add(terms))->setflag(status_flags::dynallocated);
+		next_combination(counter, t.dims);
+	}
+}
+
+/** Components of an indexed object.  Matrices are read directly, delta and
+ *  metric tensors only evaluated on the diagonal and epsilon tensors only
+ *  for distinct index values, everything else by generic_components(). */
+static void indexed_table(component_table & t, const indexed & e, unsigned dim)
+{
+	const ex & base = e.op(0);
+	if (e.get_free_indices().size() + 1 != e.nops() ||
+	    !(is_a<matrix>(base) || is_exactly_a<tensdelta>(base) ||
+	      is_a<minkmetric>(base) || is_a<tensepsilon>(base))) {
+		generic_components(t, e, dim);
+		return;
+	}
+
+	// All indices are free, in the order of their slots
+	const exvector free = e.get_indices();
+	init_table(t, free, dim);
+	std::vector<unsigned> counter(t.dims.size(), 0);
+
+	if (is_a<matrix>(base)) {
+		const matrix & m = ex_to<matrix>(base);
+		const unsigned rows = m.rows(), cols = m.cols();
+		bool fits;
+		if (free.size() == 1)
+			fits = (rows == 1 || cols == 1) && t.dims[0] == rows * cols;
+		else
+			fits = free.size() == 2 && t.dims[0] == rows && t.dims[1] == cols;
+		if (!fits) {
+			// Let matrix::eval_indexed() complain
+			generic_components(t, e, dim);
+			return;
+		}
+		for (size_t n = 0; n < t.values.size(); ++n)
+			t.values[n] = free.size() == 1 ? (rows == 1 ? m(0, n) : m(n, 0)) : m(n / cols, n % cols);
+		return;
+	}
+
+	exmap m;
+	if (is_a<tensepsilon>(base)) {
+		for (size_t n = 0; n < t.values.size(); ++n) {
+			std::vector<unsigned> sorted(counter);
+			std::sort(sorted.begin(), sorted.end());
+			if (std::adjacent_find(sorted.begin(), sorted.end()) == sorted.end()) {
+				for (size_t k = 0; k < counter.size(); ++k)
+					m[free[k].op(0)] = counter[k];
+				t.values[n] = e.subs(m, subs_options::no_pattern);
+			}
+			next_combination(counter, t.dims);
+		}
+		return;
+	}
+
+	// Delta and metric tensors, which vanish off the diagonal
+	GINAC_ASSERT(free.size() == 2);
+	const unsigned d = std::min(t.dims[0], t.dims[1]);
+	for (unsigned k = 0; k < d; ++k) {
+		m[free[0].op(0)] = k;
+		m[free[1].op(0)] = k;
+		t.values[k * t.dims[1] + k] = e.subs(m, subs_options::no_pattern);
+	}
+}
+
+static void components_of(component_table & t, const ex & e, unsigned dim);
+
+/** Bring the axes of t into the order of the indices in order, which must
+ *  have the same values. */
+static void reorder_table(component_table & t, const exvector & order)
+{
+	if (order.size() != t.indices.size())
+		throw std::invalid_argument("indexed_components(): inconsistent free indices");
+	std::vector<size_t> from(order.size());
+	bool identity = true;
+	for (size_t k = 0; k < order.size(); ++k) {
+		const ex & v = ex_to<idx>(order[k]).get_value();
+		size_t j = 0;
+		while (j < t.indices.size() && !ex_to<idx>(t.indices[j]).get_value().is_equal(v))
+			++j;
+		if (j == t.indices.size())
+			throw std::invalid_argument("indexed_components(): inconsistent free indices");
+		from[k] = j;
+		if (j != k)
+			identity = false;
+	}
+	if (identity)
+		return;
+
+	std::vector<unsigned> dims(order.size());
+	std::vector<size_t> strides(t.dims.size());
+	size_t s = 1;
+	for (size_t j = t.dims.size(); j-- > 0; ) {
+		strides[j] = s;
+		s *= t.dims[j];
+	}
+	for (size_t k = 0; k < order.size(); ++k)
+		dims[k] = t.dims[from[k]];
+	exvector values(t.values.size());
+	std::vector<unsigned> counter(order.size(), 0);
+	for (size_t n = 0; n < values.size(); ++n) {
+		size_t offset = 0;
+		for (size_t k = 0; k < counter.size(); ++k)
+			offset += counter[k] * strides[from[k]];
+		values[n] = t.values[offset];
+		next_combination(counter, dims);
+	}
+	exvector indices(order.size());
+	for (size_t k = 0; k < order.size(); ++k)
+		indices[k] = t.indices[from[k]];
+	t.indices.swap(indices);
+	t.dims.swap(dims);
+	t.values.swap(values);
+}
+
+/** Product of the components in a and b, contracted over the index pairs
+ *  they share, as one loop over all values of the remaining and the
+ *  contracted indices. */
+static void multiply_tables(component_table & result, const component_table & a, const component_table & b)
+{
+	// Axes of the loop: the free ones of a, those of b, then the contracted
+	// ones, with the strides of each in a and b
+	std::vector<int> partner(b.indices.size(), -1);
+	std::vector<bool> contracted(a.indices.size(), false);
+	for (size_t i = 0; i < a.indices.size(); ++i) {
+		for (size_t j = 0; j < b.indices.size(); ++j) {
+			if (partner[j] < 0 && is_dummy_pair(a.indices[i], b.indices[j])) {
+				partner[j] = i;
+				contracted[i] = true;
+				break;
+			}
+		}
+	}
+	std::vector<size_t> astrides(a.dims.size()), bstrides(b.dims.size());
+	size_t s = 1;
+	for (size_t i = a.dims.size(); i-- > 0; ) {
+		astrides[i] = s;
+		s *= a.dims[i];
+	}
+	s = 1;
+	for (size_t j = b.dims.size(); j-- > 0; ) {
+		bstrides[j] = s;
+		s *= b.dims[j];
+	}
+
+	std::vector<unsigned> dims;
+	std::vector<size_t> ainc, binc;
+	result.indices.clear();
+	for (size_t i = 0; i < a.indices.size(); ++i) {
+		if (contracted[i])
+			continue;
+		result.indices.push_back(a.indices[i]);
+		dims.push_back(a.dims[i]);
+		ainc.push_back(astrides[i]);
+		binc.push_back(0);
+	}
+	for (size_t j = 0; j < b.indices.size(); ++j) {
+		if (partner[j] >= 0)
+			continue;
+		result.indices.push_back(b.indices[j]);
+		dims.push_back(b.dims[j]);
+		ainc.push_back(0);
+		binc.push_back(bstrides[j]);
+	}
+	const size_t nfree = dims.size();
+	result.dims = dims;
+	for (size_t j = 0; j < b.indices.size(); ++j) {
+		if (partner[j] < 0)
+			continue;
+		dims.push_back(std::min(a.dims[partner[j]], b.dims[j]));
+		ainc.push_back(astrides[partner[j]]);
+		binc.push_back(bstrides[j]);
+	}
+
+	const size_t ncontracted = table_size(std::vector<unsigned>(dims.begin() + nfree, dims.end()));
+	result.values.resize(table_size(result.dims));
+	std::vector<unsigned> counter(dims.size(), 0);
+	exvector terms;
+	for (size_t n = 0; n < result.values.size(); ++n) {
+		terms.clear();
+		for (size_t c = 0; c < ncontracted; ++c) {
+			size_t aoff = 0, boff = 0;
+			for (size_t k = 0; k < counter.size(); ++k) {
+				aoff += counter[k] * ainc[k];
+				boff += counter[k] * binc[k];
+			}
+			const ex & x = a.values[aoff];
+			const ex & y = b.values[boff];
+			if (!x.is_zero() && !y.is_zero())
+				terms.push_back(x * y);
+			next_combination(counter, dims);
+		}
+		result.values[n] = (new add(terms))->setflag(status_flags::dynallocated);
+	}
+}
+
+/** Components of a product of the factors in v.  For commutative products
+ *  the next factor is one sharing indices with the ones before, if there
+ *  is one, to avoid large intermediate tables. */
+static void product_components(component_table & t, const exvector & v, bool commutative, unsigned dim)
+{
+	std::vector<component_table> factors(v.size());
+	for (size_t i = 0; i < v.size(); ++i)
+		components_of(factors[i], v[i], dim);
+
+	t = factors[0];
+	std::vector<bool> used(v.size(), false);
+	used[0] = true;
+	for (size_t done = 1; done < v.size(); ++done) {
+		size_t next = 0;
+		while (used[next])
+			++next;
+		if (commutative) {
+			for (size_t i = 0; i < v.size(); ++i) {
+				if (used[i])
+					continue;
+				bool shares = false;
+				for (size_t j = 0; j < factors[i].indices.size() && !shares; ++j)
+					for (size_t k = 0; k < t.indices.size() && !shares; ++k)
+						shares = is_dummy_pair(factors[i].indices[j], t.indices[k]);
+				if (shares) {
+					next = i;
+					break;
+				}
+			}
+		}
+		used[next] = true;
+		component_table p;
+		multiply_tables(p, t, factors[next]);
+		std::swap(t, p);
+	}
+}
+
+static void components_of(component_table & t, const ex & e, unsigned dim)
+{
+	if (is_a<indexed>(e)) {
+		indexed_table(t, ex_to<indexed>(e), dim);
+	} else if (is_exactly_a<add>(e)) {
+		components_of(t, e.op(0), dim);
+		for (size_t i = 1; i < e.nops(); ++i) {
+			component_table s;
+			components_of(s, e.op(i), dim);
+			reorder_table(s, t.indices);
+			if (s.dims != t.dims)
+				throw std::invalid_argument("indexed_components(): inconsistent dimensions of free indices");
+			for (size_t n = 0; n < t.values.size(); ++n)
+				t.values[n] += s.values[n];
+		}
+	} else if (is_exactly_a<mul>(e) || is_exactly_a<ncmul>(e)) {
+		exvector v(e.begin(), e.end());
+		product_components(t, v, is_exactly_a<mul>(e), dim);
+	} else if (is_exactly_a<power>(e) && !e.op(0).get_free_indices().empty()) {
+		// Only squares may have free indices in the basis, a.i^2 = a.i*a.i
+		if (!e.op(1).is_equal(_ex2))
+			throw std::invalid_argument("indexed_components(): power of an object with free indices");
+		exvector v(2, e.op(0));
+		product_components(t, v, true, dim);
+	} else if (is_exactly_a<power>(e)) {
+		components_of(t, e.op(0), dim);
+		t.values[0] = pow(t.values[0], e.op(1));
+	} else {
+		// Scalar
+		if (!e.get_free_indices().empty())
+			throw std::invalid_argument("indexed_components(): free indices in a function or other object");
+		t.indices.clear();
+		t.dims.clear();
+		t.values.assign(1, e);
+	}
+}
+
+exvector indexed_components(const ex & e, const exvector & free, unsigned dim)
+{
+	component_table t;
+	components_of(t, e, dim);
+	reorder_table(t, free);
+	for (size_t k = 0; k < free.size(); ++k)
+		if (t.dims[k] != component_dim(free[k], dim))
+			throw std::invalid_argument("indexed_components(): inconsistent dimensions of free indices");
+	return t.values;
+}
+
 } // namespace GiNaC
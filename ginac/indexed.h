@@ -212,6 +212,10 @@ public:
 	bool operator==(const spmapkey &other) const;
 	bool operator<(const spmapkey &other) const;
 
+	/** Hash value of the pair, which does not depend on the dimension
+	 *  (keys with a wildcard dimension equal keys of any dimension). */
+	unsigned hash() const;
+
 	void debugprint() const;
 
 protected:
@@ -219,6 +223,7 @@ protected:
 };
 
 typedef std::map<spmapkey, ex> spmap;
+typedef std::multimap<unsigned, std::pair<spmapkey, ex> > sphashmap;
 
 /** Helper class for storing information about known scalar products which
  *  are to be automatically replaced by simplify_indexed().
@@ -242,10 +247,19 @@ public:
 
 	bool is_defined(const ex & v1, const ex & v2, const ex & dim) const;
 	ex evaluate(const ex & v1, const ex & v2, const ex & dim) const;
+
+	/** Look up the value of a scalar product pair.
+	 *  @return false if the pair is not defined */
+	bool lookup(const ex & v1, const ex & v2, const ex & dim, ex & value) const;
+
 	void debugprint() const;
 
 protected:
+	void insert(const spmapkey & key, const ex & sp);
+	const ex * find(const spmapkey & key) const;
+
 	spmap spm; /*< Map from defined scalar product pairs to their values */
+	sphashmap sph; /*< The same pairs and values by the hash values of the pairs */
 };
 
 
@@ -283,6 +297,22 @@ lst rename_dummy_indices_uniquely(const exvector & va, const exvector & vb);
  */
 ex expand_dummy_sum(const ex & e, bool subs_idx = false);
 
+/** Components of an indexed expression for all numeric values of its free
+ *  indices, like those of e.subs(lst(i == 0, j == 0)), e.subs(lst(i == 0,
+ *  j == 1)) and so on, but computed as dense arrays: the components of each
+ *  indexed object are found once (directly for matrices, delta, metric and
+ *  epsilon tensors) and contractions become loops over them.
+ *
+ *  @param e the expression
+ *  @param free its free indices, in the order of the result
+ *  @param dim the number of values of indices whose dimension is not a
+ *         nonnegative integer
+ *  @return the components, with the values of the first free index varying
+ *          slowest
+ *  @exception invalid_argument (free indices don't match, dimension of an
+ *             index not numeric) */
+exvector indexed_components(const ex & e, const exvector & free, unsigned dim = 0);
+
 } // namespace GiNaC
 
 #endif // ndef GINAC_INDEXED_H
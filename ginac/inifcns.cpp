@@ -21,10 +21,12 @@
  */
 
 #include "inifcns.h"
+#include "add.h"
 #include "ex.h"
 #include "constant.h"
 #include "lst.h"
 #include "matrix.h"
+#include "sparse_matrix.h"
 #include "mul.h"
 #include "power.h"
 #include "operators.h"
@@ -32,10 +34,24 @@
 #include "pseries.h"
 #include "symbol.h"
 #include "symmetry.h"
+#include "tasks.h"
 #include "utils.h"
-
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <complex>
+#include <map>
 #include <stdexcept>
 #include <vector>
+#ifdef HAVE_PTHREAD_H
+// The threads only evaluate bytecode on doubles, so they don't share any
+// expressions and need no GINAC_THREADSAFE_REFCOUNT.
+#define PARALLEL_FSOLVE 1
+#endif
 
 namespace GiNaC {
 
@@ -51,6 +67,12 @@ static ex conjugate_evalf(const ex & arg)
 	return conjugate_function(arg).hold();
 }
 
+static bool conjugate_evalf_double(const std::complex<double> args[], std::complex<double> & result)
+{
+	result = std::conj(args[0]);
+	return true;
+}
+
 static ex conjugate_eval(const ex & arg)
 {
 	return arg.conjugate();
@@ -115,6 +137,7 @@ static bool conjugate_info(const ex & arg, unsigned inf)
 
 REGISTER_FUNCTION(conjugate_function, eval_func(conjugate_eval).
                                       evalf_func(conjugate_evalf).
+                                      evalf_double_func(conjugate_evalf_double).
                                       info_func(conjugate_info).
                                       print_func<print_latex>(conjugate_print_latex).
                                       conjugate_func(conjugate_conjugate).
@@ -134,6 +157,12 @@ static ex real_part_evalf(const ex & arg)
 	return real_part_function(arg).hold();
 }
 
+static bool real_part_evalf_double(const std::complex<double> args[], std::complex<double> & result)
+{
+	result = args[0].real();
+	return true;
+}
+
 static ex real_part_eval(const ex & arg)
 {
 	return arg.real_part();
@@ -161,6 +190,7 @@ static ex real_part_imag_part(const ex & arg)
 
 REGISTER_FUNCTION(real_part_function, eval_func(real_part_eval).
                                       evalf_func(real_part_evalf).
+                                      evalf_double_func(real_part_evalf_double).
                                       print_func<print_latex>(real_part_print_latex).
                                       conjugate_func(real_part_conjugate).
                                       real_part_func(real_part_real_part).
@@ -179,6 +209,12 @@ static ex imag_part_evalf(const ex & arg)
 	return imag_part_function(arg).hold();
 }
 
+static bool imag_part_evalf_double(const std::complex<double> args[], std::complex<double> & result)
+{
+	result = args[0].imag();
+	return true;
+}
+
 static ex imag_part_eval(const ex & arg)
 {
 	return arg.imag_part();
@@ -206,6 +242,7 @@ static ex imag_part_imag_part(const ex & arg)
 
 REGISTER_FUNCTION(imag_part_function, eval_func(imag_part_eval).
                                       evalf_func(imag_part_evalf).
+                                      evalf_double_func(imag_part_evalf_double).
                                       print_func<print_latex>(imag_part_print_latex).
                                       conjugate_func(imag_part_conjugate).
                                       real_part_func(imag_part_real_part).
@@ -224,6 +261,12 @@ static ex abs_evalf(const ex & arg)
 	return abs(arg).hold();
 }
 
+static bool abs_evalf_double(const std::complex<double> args[], std::complex<double> & result)
+{
+	result = args[0].imag() == 0 ? std::fabs(args[0].real()) : std::abs(args[0]);
+	return true;
+}
+
 static ex abs_eval(const ex & arg)
 {
 	if (is_exactly_a<numeric>(arg))
@@ -336,8 +379,9 @@ bool abs_info(const ex & arg, unsigned inf)
 	return false;
 }
 
-REGISTER_FUNCTION(abs, eval_func(abs_eval).
+REGISTER_LAZY_FUNCTION(abs, eval_func(abs_eval).
                        evalf_func(abs_evalf).
+                       evalf_double_func(abs_evalf_double).
                        expand_func(abs_expand).
                        info_func(abs_info).
                        print_func<print_latex>(abs_print_latex).
@@ -360,6 +404,15 @@ static ex step_evalf(const ex & arg)
 	return step(arg).hold();
 }
 
+static bool step_evalf_double(const std::complex<double> args[], std::complex<double> & result)
+{
+	const std::complex<double> & x = args[0];
+	if (x.imag() != 0)
+		return false;
+	result = x.real() < 0 ? 0.0 : x.real() > 0 ? 1.0 : 0.5;
+	return true;
+}
+
 static ex step_eval(const ex & arg)
 {
 	if (is_exactly_a<numeric>(arg))
@@ -420,8 +473,9 @@ static ex step_imag_part(const ex& arg)
 	return 0;
 }
 
-REGISTER_FUNCTION(step, eval_func(step_eval).
+REGISTER_LAZY_FUNCTION(step, eval_func(step_eval).
                         evalf_func(step_evalf).
+                        evalf_double_func(step_evalf_double).
                         series_func(step_series).
                         conjugate_func(step_conjugate).
                         real_part_func(step_real_part).
@@ -439,6 +493,14 @@ static ex csgn_evalf(const ex & arg)
 	return csgn(arg).hold();
 }
 
+static bool csgn_evalf_double(const std::complex<double> args[], std::complex<double> & result)
+{
+	const std::complex<double> & x = args[0];
+	const double s = x.real() != 0 ? x.real() : x.imag();
+	result = s < 0 ? -1.0 : s > 0 ? 1.0 : 0.0;
+	return true;
+}
+
 static ex csgn_eval(const ex & arg)
 {
 	if (is_exactly_a<numeric>(arg))
@@ -511,8 +573,9 @@ static ex csgn_power(const ex & arg, const ex & exp)
 }
 
 
-REGISTER_FUNCTION(csgn, eval_func(csgn_eval).
+REGISTER_LAZY_FUNCTION(csgn, eval_func(csgn_eval).
                         evalf_func(csgn_evalf).
+                        evalf_double_func(csgn_evalf_double).
                         series_func(csgn_series).
                         conjugate_func(csgn_conjugate).
                         real_part_func(csgn_real_part).
@@ -607,7 +670,7 @@ static ex eta_imag_part(const ex & x, const ex & y)
 	return -I*eta(x, y).hold();
 }
 
-REGISTER_FUNCTION(eta, eval_func(eta_eval).
+REGISTER_LAZY_FUNCTION(eta, eval_func(eta_eval).
                        evalf_func(eta_evalf).
                        series_func(eta_series).
                        latex_name("\\eta").
@@ -762,7 +825,7 @@ static ex Li2_conjugate(const ex & x)
 	return conjugate_function(Li2(x)).hold();
 }
 
-REGISTER_FUNCTION(Li2, eval_func(Li2_eval).
+REGISTER_LAZY_FUNCTION(Li2, eval_func(Li2_eval).
                        evalf_func(Li2_evalf).
                        derivative_func(Li2_deriv).
                        series_func(Li2_series).
@@ -780,7 +843,7 @@ static ex Li3_eval(const ex & x)
 	return Li3(x).hold();
 }
 
-REGISTER_FUNCTION(Li3, eval_func(Li3_eval).
+REGISTER_LAZY_FUNCTION(Li3, eval_func(Li3_eval).
                        latex_name("\\mathrm{Li}_3"));
 
 //////////
@@ -810,7 +873,7 @@ static ex zetaderiv_deriv(const ex & n, const ex & x, unsigned deriv_param)
 	return zetaderiv(n+1,x);
 }
 
-REGISTER_FUNCTION(zetaderiv, eval_func(zetaderiv_eval).
+REGISTER_LAZY_FUNCTION(zetaderiv, eval_func(zetaderiv_eval).
 	                       	 derivative_func(zetaderiv_deriv).
   	                         latex_name("\\zeta^\\prime"));
 
@@ -857,7 +920,7 @@ static ex factorial_imag_part(const ex & x)
 	return 0;
 }
 
-REGISTER_FUNCTION(factorial, eval_func(factorial_eval).
+REGISTER_LAZY_FUNCTION(factorial, eval_func(factorial_eval).
                              evalf_func(factorial_evalf).
                              print_func<print_dflt>(factorial_print_dflt_latex).
                              print_func<print_latex>(factorial_print_dflt_latex).
@@ -921,7 +984,7 @@ static ex binomial_imag_part(const ex & x, const ex & y)
 	return 0;
 }
 
-REGISTER_FUNCTION(binomial, eval_func(binomial_eval).
+REGISTER_LAZY_FUNCTION(binomial, eval_func(binomial_eval).
                             evalf_func(binomial_evalf).
                             conjugate_func(binomial_conjugate).
                             real_part_func(binomial_real_part).
@@ -977,7 +1040,7 @@ static ex Order_imag_part(const ex & x)
 
 // Differentiation is handled in function::derivative because of its special requirements
 
-REGISTER_FUNCTION(Order, eval_func(Order_eval).
+REGISTER_LAZY_FUNCTION(Order, eval_func(Order_eval).
                          series_func(Order_series).
                          latex_name("\\mathcal{O}").
                          conjugate_func(Order_conjugate).
@@ -988,6 +1051,58 @@ REGISTER_FUNCTION(Order, eval_func(Order_eval).
 // Solve linear system
 //////////
 
+/** Systems with at least this many coefficients, at most a tenth of which
+ *  don't vanish, are solved as sparse systems if lsolve() decides. */
+static const size_t lsolve_sparse_min_size = 2500;
+
+/** Set up the sparse coefficient matrix and the right hand side of the
+ *  equations, expanding them and sorting their terms by the symbols they
+ *  contain instead of extracting every coefficient for every symbol.
+ *
+ *  @exception logic_error (system is not linear) */
+static void sparse_linear_system(const ex & eqns, const ex & symbols, sparse_matrix & sys, matrix & rhs)
+{
+	std::map<ex, unsigned, ex_is_less> index;
+	for (size_t c=0; c<symbols.nops(); c++)
+		index[symbols.op(c)] = c;
+
+	for (size_t r=0; r<eqns.nops(); r++) {
+		const ex eq = (eqns.op(r).op(0)-eqns.op(r).op(1)).expand(); // lhs-rhs==0
+		std::map<unsigned, ex> coeffs;
+		ex linpart = 0;
+		const size_t nterms = is_exactly_a<add>(eq) ? eq.nops() : 1;
+		for (size_t k=0; k<nterms; k++) {
+			const ex & t = is_exactly_a<add>(eq) ? eq.op(k) : eq;
+			// the term must contain at most one of the symbols, as a factor
+			unsigned found = 0;
+			std::map<ex, unsigned, ex_is_less>::const_iterator sym;
+			for (const_preorder_iterator i=t.preorder_begin(); i!=t.preorder_end(); ++i) {
+				if (is_exactly_a<symbol>(*i)) {
+					std::map<ex, unsigned, ex_is_less>::const_iterator j = index.find(*i);
+					if (j != index.end()) {
+						++found;
+						sym = j;
+					}
+				}
+			}
+			if (found == 0) {
+				linpart += t;
+				continue;
+			}
+			bool linear = (found == 1 && t.is_equal(sym->first));
+			if (found == 1 && is_exactly_a<mul>(t))
+				for (size_t i=0; i<t.nops() && !linear; i++)
+					linear = t.op(i).is_equal(sym->first);
+			if (!linear)
+				throw(std::logic_error("lsolve: system is not linear"));
+			coeffs[sym->second] += t/sym->first;
+		}
+		for (std::map<unsigned, ex>::const_iterator i=coeffs.begin(); i!=coeffs.end(); ++i)
+			sys.set(r, i->first, i->second);
+		rhs(r,0) = -linpart;
+	}
+}
+
 ex lsolve(const ex &eqns, const ex &symbols, unsigned options)
 {
 	// solve a system of linear equations
@@ -1020,6 +1135,30 @@ ex lsolve(const ex &eqns, const ex &symbols, unsigned options)
 		}
 	}
 	
+	// large sparse systems are never stored densely
+	const size_t size = eqns.nops()*symbols.nops();
+	if (options == solve_algo::sparse ||
+	    (options == solve_algo::automatic && size >= lsolve_sparse_min_size)) {
+		sparse_matrix sys(eqns.nops(),symbols.nops());
+		matrix rhs(eqns.nops(),1);
+		sparse_linear_system(eqns, symbols, sys, rhs);
+		if (options == solve_algo::sparse || 10*sys.nonzeros() <= size) {
+			matrix vars(symbols.nops(),1);
+			for (size_t i=0; i<symbols.nops(); i++)
+				vars(i,0) = symbols.op(i);
+			matrix solution;
+			try {
+				solution = sys.solve(vars,rhs);
+			} catch (const std::runtime_error & e) {
+				return lst();
+			}
+			lst sollist;
+			for (size_t i=0; i<symbols.nops(); i++)
+				sollist.append(symbols.op(i)==solution(i,0));
+			return sollist;
+		}
+	}
+
 	// build matrix from equation system
 	matrix sys(eqns.nops(),symbols.nops());
 	matrix rhs(eqns.nops(),1);
@@ -1048,7 +1187,7 @@ ex lsolve(const ex &eqns, const ex &symbols, unsigned options)
 	
 	matrix solution;
 	try {
-		solution = sys.solve(vars,rhs,options);
+		solution = sys.solve_in_place(vars,rhs,options);
 	} catch (const std::runtime_error & e) {
 		// Probably singular matrix or otherwise overdetermined system:
 		// It is consistent to return an empty list
@@ -1191,6 +1330,359 @@ fsolve(const ex& f_in, const symbol& x, const numeric& x1, const numeric& x2)
 }
 
 
+//////////
+// Find all real roots of f(x) numerically, with compiled f and f'
+//////////
+
+namespace {
+
+/** More iterations are never needed to bisect an interval of doubles. */
+const int max_fsolve_iterations = 1100;
+
+inline bool is_finite(double d)
+{
+	return d - d == 0;
+}
+
+/** Refine the root bracketed by a and b, f(a) and f(b) having opposite
+ *  signs, as fsolve() does, but with a Newton step from the last point
+ *  evaluated and a bisection whenever it leaves the bracket.  args holds
+ *  the values of the parameters after the slot for x.
+ *  @return false if f or f' are not finite on the way */
+bool refine_root(bytecode_evaluator & e, double * args, double a, double b, double fa, double fb,
+                 double & root)
+{
+	double xx = a - fa * (b - a) / (fb - fa);
+	if (!(xx > a && xx < b))
+		xx = 0.5 * (a + b);
+	for (int i = 0; i < max_fsolve_iterations; ++i) {
+		double fd[2];
+		args[0] = xx;
+		e.evaluate(args, fd);
+		if (!is_finite(fd[0]))
+			return false;
+		if (fd[0] == 0) {
+			root = xx;
+			return true;
+		}
+		if ((fd[0] < 0) == (fa < 0)) {
+			a = xx;
+			fa = fd[0];
+		} else {
+			b = xx;
+			fb = fd[0];
+		}
+		double next = xx - fd[0] / fd[1];
+		if (!(next > a && next < b))
+			next = 0.5 * (a + b);
+		if (next == xx || !(next > a && next < b))
+			break;
+		xx = next;
+	}
+	root = std::fabs(fa) < std::fabs(fb) ? a : b;
+	return true;
+}
+
+/** Scan [x1, x2] on the grid and refine the roots found. */
+void find_roots(bytecode_evaluator & e, std::size_t nparams, unsigned grid,
+                double x1, double x2, const double * values, std::vector<double> & result)
+{
+	result.clear();
+	std::vector<double> args(nparams + 1);
+	std::copy(values, values + nparams, args.begin() + 1);
+	double prev_x = 0, prev_f = 0;
+	for (unsigned i = 0; i <= grid; ++i) {
+		double fd[2];
+		args[0] = (i == grid ? x2 : x1 + (x2 - x1) * i / grid);
+		e.evaluate(&args[0], fd);
+		const double xx = args[0], fx = fd[0];
+		if (fx == 0)
+			result.push_back(xx);
+		else if (i > 0 && is_finite(fx) && is_finite(prev_f) && prev_f != 0
+		      && (fx < 0) != (prev_f < 0)) {
+			double root;
+			if (refine_root(e, &args[0], prev_x, xx, prev_f, fx, root)) {
+				// A sign change at a pole is no root
+				args[0] = root;
+				e.evaluate(&args[0], fd);
+				if (std::fabs(fd[0]) <= std::min(std::fabs(prev_f), std::fabs(fx)))
+					result.push_back(root);
+			}
+		}
+		prev_x = xx;
+		prev_f = fx;
+	}
+}
+
+/** Sets of values for which one thread finds the roots. */
+struct fsolve_job {
+	bytecode_evaluator * e;
+	std::size_t nparams;
+	unsigned grid;
+	double x1, x2;
+	const std::vector<std::vector<double> > * values;
+	std::vector<std::vector<double> > * roots;
+	std::size_t first, last;
+};
+
+void * run_fsolve_job(void * arg)
+{
+	fsolve_job & job = *static_cast<fsolve_job *>(arg);
+	for (std::size_t i = job.first; i != job.last; ++i)
+		find_roots(*job.e, job.nparams, job.grid, job.x1, job.x2,
+		           (*job.values)[i].empty() ? 0 : &(*job.values)[i][0], (*job.roots)[i]);
+	return 0;
+}
+
+unsigned fsolve_threads = 1;
+
+} // anonymous namespace
+
+/** Set the number of threads prepared_fsolve uses.  This has an effect only
+ *  if GiNaC was built with pthreads.
+ *
+ *  @return previous setting */
+unsigned set_fsolve_threads(unsigned n)
+{
+	const unsigned previous = fsolve_threads;
+	fsolve_threads = (n == 0 ? 1 : n);
+	return previous;
+}
+
+/** Get the number of threads used by prepared_fsolve. */
+unsigned get_fsolve_threads()
+{
+	return fsolve_threads;
+}
+
+prepared_fsolve::prepared_fsolve(const ex & f_in, const symbol & x, const lst & params, unsigned grid_)
+  : nparams(params.nops()), grid(grid_ == 0 ? 1 : grid_)
+{
+	const ex f = is_a<relational>(f_in) ? f_in.lhs() - f_in.rhs() : f_in;
+	lst args(x);
+	for (lst::const_iterator i = params.begin(); i != params.end(); ++i)
+		args.append(*i);
+	// evalf() folds the numbers and constants of the expressions
+	evaluators.push_back(bytecode_evaluator(lst(f.evalf(), f.diff(x).evalf()), args));
+}
+
+lst prepared_fsolve::roots(const numeric & x1, const numeric & x2, const lst & values)
+{
+	if (!x1.is_real() || !x2.is_real())
+		throw std::invalid_argument("prepared_fsolve::roots(): interval not bounded by real numbers");
+	if (values.nops() != nparams)
+		throw std::invalid_argument("prepared_fsolve::roots(): wrong number of values");
+	std::vector<double> v;
+	v.reserve(nparams);
+	for (lst::const_iterator i = values.begin(); i != values.end(); ++i) {
+		const ex e = i->evalf();
+		if (!is_exactly_a<numeric>(e) || !ex_to<numeric>(e).is_real())
+			throw std::invalid_argument("prepared_fsolve::roots(): values must be real numbers");
+		v.push_back(ex_to<numeric>(e).to_double());
+	}
+	std::vector<double> found;
+	roots(x1.to_double(), x2.to_double(), v.empty() ? 0 : &v[0], found);
+	lst result;
+	for (std::vector<double>::const_iterator i = found.begin(); i != found.end(); ++i)
+		result.append(numeric(*i));
+	return result;
+}
+
+void prepared_fsolve::roots(double x1, double x2, const double * values, std::vector<double> & result)
+{
+	if (!is_finite(x1) || !is_finite(x2))
+		throw std::invalid_argument("prepared_fsolve::roots(): interval not bounded by finite numbers");
+	if (x1 > x2)
+		std::swap(x1, x2);
+	find_roots(evaluators[0], nparams, grid, x1, x2, values, result);
+}
+
+std::vector<std::vector<double> >
+prepared_fsolve::roots(double x1, double x2, const std::vector<std::vector<double> > & values)
+{
+	if (!is_finite(x1) || !is_finite(x2))
+		throw std::invalid_argument("prepared_fsolve::roots(): interval not bounded by finite numbers");
+	if (x1 > x2)
+		std::swap(x1, x2);
+	for (std::size_t i = 0; i < values.size(); ++i)
+		if (values[i].size() != nparams)
+			throw std::invalid_argument("prepared_fsolve::roots(): wrong number of values");
+
+	std::vector<std::vector<double> > result(values.size());
+	const std::size_t nthreads = std::max<std::size_t>(std::min<std::size_t>(fsolve_threads, values.size()), 1);
+	if (evaluators.size() < nthreads) {
+		const bytecode_evaluator first = evaluators[0];
+		evaluators.resize(nthreads, first);
+	}
+	std::vector<fsolve_job> jobs(nthreads);
+	for (std::size_t k = 0; k < nthreads; ++k) {
+		fsolve_job & job = jobs[k];
+		job.e = &evaluators[k];
+		job.nparams = nparams;
+		job.grid = grid;
+		job.x1 = x1;
+		job.x2 = x2;
+		job.values = &values;
+		job.roots = &result;
+		job.first = values.size() * k / nthreads;
+		job.last = values.size() * (k + 1) / nthreads;
+	}
+#ifdef PARALLEL_FSOLVE
+	run_tasks(run_fsolve_job, jobs);
+#else
+	for (std::size_t k = 0; k < nthreads; ++k)
+		run_fsolve_job(&jobs[k]);
+#endif
+	return result;
+}
+
+lst fsolve_all(const ex & f, const symbol & x, const numeric & x1, const numeric & x2, unsigned grid)
+{
+	return prepared_fsolve(f, x, lst(), grid).roots(x1, x2);
+}
+
+
+//////////
+// Numerical evaluation with adaptive working precision
+//////////
+
+namespace {
+
+/** Sets Digits for the lifetime of the object. */
+class digits_setter {
+	long saved;
+public:
+	explicit digits_setter(long digits) : saved(Digits)
+	{
+		if (digits != saved)
+			Digits = digits;
+	}
+	~digits_setter()
+	{
+		if (long(Digits) != saved)
+			Digits = saved;
+	}
+};
+
+/** Digits added to the requested precision at the top level. */
+const long adaptive_guard_digits = 3;
+
+/** Approximately log10(|x|) for a nonzero number. */
+long decimal_exponent(const numeric & x)
+{
+	digits_setter low(17);
+	return long(std::floor(log(abs(x)).to_double() / std::log(10.0)));
+}
+
+ex adaptive_evalf(const ex & e, long prec, long max_prec);
+
+/** Evaluates the operands of a product, power or function.  Relative
+ *  errors of the operands just add up, so one more digit is enough. */
+struct adaptive_evalf_operands : public map_function {
+	long prec, max_prec;
+	adaptive_evalf_operands(long p, long m) : prec(p), max_prec(m) {}
+	ex operator()(const ex & e)
+	{
+		// exact exponents and arguments stay exact
+		if (is_exactly_a<numeric>(e) && ex_to<numeric>(e).is_crational())
+			return e;
+		return adaptive_evalf(e, std::min(prec + 1, max_prec), max_prec);
+	}
+};
+
+/** Arguments of functions and exponents are needed to a fixed absolute
+ *  accuracy, which takes as many more digits as they have before the
+ *  decimal point. */
+long absolute_accuracy_digits(const ex & e)
+{
+	if (is_exactly_a<mul>(e))
+		return 0;
+	long extra = 0;
+	for (size_t i = is_exactly_a<power>(e) ? 1 : 0; i<e.nops(); ++i) {
+		ex v;
+		{
+			digits_setter low(17);
+			v = e.op(i).evalf();
+		}
+		if (is_exactly_a<numeric>(v) && !v.is_zero())
+			extra = std::max(extra, decimal_exponent(ex_to<numeric>(v)));
+	}
+	return extra;
+}
+
+/** Numerical value of e with about prec correct digits, working at higher
+ *  precision only inside sums whose terms cancel.  Gives up raising the
+ *  precision at max_prec digits. */
+ex adaptive_evalf(const ex & e, long prec, long max_prec)
+{
+	if (is_exactly_a<add>(e)) {
+		long work = prec;
+		while (true) {
+			exvector terms;
+			terms.reserve(e.nops());
+			bool all_numeric = true;
+			for (size_t i=0; i<e.nops(); ++i) {
+				terms.push_back(adaptive_evalf(e.op(i), work, max_prec));
+				if (!is_exactly_a<numeric>(terms.back()))
+					all_numeric = false;
+			}
+			digits_setter working(work);
+			if (!all_numeric)
+				return add(terms).evalf();
+			numeric sum, largest;
+			for (exvector::const_iterator i=terms.begin(); i!=terms.end(); ++i) {
+				const numeric & t = ex_to<numeric>(*i);
+				sum += t;
+				if (abs(t) > largest)
+					largest = abs(t);
+			}
+			if (work >= max_prec)
+				return sum;
+			// digits lost by cancellation
+			long lost;
+			if (sum.is_zero())
+				lost = work;
+			else
+				lost = decimal_exponent(largest) - decimal_exponent(sum);
+			if (work - lost >= prec)
+				return sum;
+			work = std::min(std::max(prec + lost + adaptive_guard_digits, 2*work), max_prec);
+		}
+	}
+	if (is_exactly_a<mul>(e) || is_exactly_a<power>(e) || is_a<function>(e)) {
+		const long work = std::min(prec + absolute_accuracy_digits(e), max_prec);
+		adaptive_evalf_operands f(work, max_prec);
+		const ex mapped = e.map(f);
+		digits_setter working(work);
+		return mapped.evalf();
+	}
+	digits_setter working(prec);
+	return e.evalf();
+}
+
+} // anonymous namespace
+
+/** Numerically evaluate an expression to the given number of digits.
+ *  Unlike evalf(), which uses the precision given by Digits everywhere,
+ *  this evaluates at little more than the requested precision and raises
+ *  it only for the sums that lose digits by cancellation, and only as far
+ *  as needed.  Arguments of functions are evaluated to the absolute
+ *  accuracy their magnitude calls for.
+ *
+ *  @param e  expression to evaluate
+ *  @param digits  number of correct decimal digits requested
+ *  @param max_digits  upper limit of the working precision (0 means ten times digits)
+ *  @return numerical value of e, exact zeros are returned as zero at max_digits */
+ex evalf_adaptive(const ex & e, long digits, long max_digits)
+{
+	if (digits <= 0)
+		throw std::invalid_argument("evalf_adaptive(): number of digits must be positive");
+	if (max_digits <= 0)
+		max_digits = 10 * digits;
+	return adaptive_evalf(e, std::min(digits + adaptive_guard_digits, max_digits), max_digits);
+}
+
+
 /* Force inclusion of functions from inifcns_gamma and inifcns_zeta
  * for static lib (so ginsh will see them). */
 unsigned force_include_tgamma = tgamma_SERIAL::serial;
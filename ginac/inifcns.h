@@ -26,6 +26,10 @@
 #include "numeric.h"
 #include "function.h"
 #include "ex.h"
+#include "excompiler.h"
+#include "lst.h"
+
+#include <vector>
 
 namespace GiNaC {
 
@@ -199,6 +203,67 @@ ex lsolve(const ex &eqns, const ex &symbols, unsigned options = solve_algo::auto
  *  @exception runtime_error (if interval is invalid). */
 const numeric fsolve(const ex& f, const symbol& x, const numeric& x1, const numeric& x2);
 
+/** The real roots of a function f(x) depending on parameters, prepared for
+ *  being found for many values of them.  The function and its derivative
+ *  are compiled only once with bytecode_evaluator.  An interval is scanned
+ *  on a grid of equidistant points, and each root between two points where
+ *  f changes sign is refined in double precision by the Newton-Raphson
+ *  method combined with bisection, like fsolve() does.  Roots where f does
+ *  not change sign, and several roots between two points of the grid, can
+ *  not be found.  Evaluation changes the state of the object, so threads
+ *  need copies of their own. */
+class prepared_fsolve
+{
+public:
+	/**
+	 * @param f Function f(x), or an equation
+	 * @param x Symbol f(x)
+	 * @param params Symbols in f whose values are passed to roots()
+	 * @param grid Number of subintervals scanned for sign changes
+	 * @exception invalid_argument (f or its derivative can not be compiled)
+	 */
+	prepared_fsolve(const ex& f, const symbol& x, const lst& params = lst(), unsigned grid = 100);
+
+	/** The roots within [x1, x2] in ascending order, for the given values
+	 *  of the parameters. */
+	lst roots(const numeric& x1, const numeric& x2, const lst& values = lst());
+
+	/** The roots within [x1, x2] in ascending order, reading the value of
+	 *  the k-th parameter from values[k]. */
+	void roots(double x1, double x2, const double* values, std::vector<double>& result);
+
+	/** The roots within [x1, x2] for each set of values of the parameters.
+	 *  The sets are distributed to several threads if so requested with
+	 *  set_fsolve_threads(). */
+	std::vector<std::vector<double> > roots(double x1, double x2,
+	                                        const std::vector<std::vector<double> >& values);
+
+private:
+	std::size_t nparams;
+	unsigned grid;
+	std::vector<bytecode_evaluator> evaluators;  ///< of f and f', one per thread
+};
+
+/** Find all real roots of f(x) within an interval where f changes sign,
+ *  in double precision.  See prepared_fsolve for the method.
+ *
+ *  @param f  Function f(x)
+ *  @param x  Symbol f(x)
+ *  @param x1  lower interval limit
+ *  @param x2  upper interval limit
+ *  @param grid  number of subintervals scanned for sign changes
+ *  @exception invalid_argument (f can not be compiled or interval is invalid) */
+lst fsolve_all(const ex& f, const symbol& x, const numeric& x1, const numeric& x2, unsigned grid = 100);
+
+// Number of threads used by prepared_fsolve for many sets of values
+// (default 1), returns previous setting
+unsigned set_fsolve_threads(unsigned n);
+unsigned get_fsolve_threads();
+
+/** Numerically evaluate e to the given number of digits, raising the working
+ *  precision only for the subexpressions that lose digits by cancellation. */
+ex evalf_adaptive(const ex& e, long digits, long max_digits = 0);
+
 /** Check whether a function is the Order (O(n)) function. */
 inline bool is_order_function(const ex & e)
 {
@@ -210,6 +275,46 @@ inline bool is_order_function(const ex & e)
  */
 ex convert_H_to_Li(const ex& parameterlst, const ex& arg);
 
+/** Precompute the lookup tables for the numerical evaluation of Li(m,x) up
+ *  to weight n and of S(m,q,x) up to depth p at the current precision.
+ */
+void prepare_polylog_tables(int n, int p);
+
+/** Numerically evaluate the polylogarithm f (G, Li, S or H) at many values
+ *  of its last argument.
+ */
+exvector polylog_evalf(const ex& f, const exvector& points);
+
+// Number of threads used by polylog_evalf() (default 1), returns previous setting
+unsigned set_polylog_threads(unsigned n);
+unsigned get_polylog_threads();
+
+// Counters describing the effectiveness of the tables of symbolic polylogarithm reductions
+struct polylog_reduction_statistics {
+	unsigned long lookups;  ///< reductions looked up
+	unsigned long hits;     ///< of which had been remembered
+	std::size_t size;       ///< number of reductions currently remembered
+};
+
+// Get the counters of the polylogarithm reduction tables
+polylog_reduction_statistics get_polylog_reduction_statistics();
+
+// Reset the lookup and hit counters (not the tables themselves)
+void reset_polylog_reduction_statistics();
+
+/** Evaluate the classical polylogarithm Li(n,x) for real x in hardware
+ *  double precision.  Returns false if the value is not real or if its
+ *  estimated relative error would exceed 1e-14, otherwise the estimated
+ *  absolute error is stored in error.
+ */
+bool Li_double(int n, double x, double& result, double& error);
+
+/** Li(n,x) in double precision with a fallback to the arbitrary precision
+ *  routines, returns NaN for complex values.  This is the function called
+ *  by expressions compiled with compile_ex().
+ */
+extern "C" double ginac_Li_double(int n, double x);
+
 } // namespace GiNaC
 
 #endif // ndef GINAC_INIFCNS_H
@@ -32,6 +32,8 @@
 #include "symmetry.h"
 #include "utils.h"
 
+#include <cmath>
+#include <complex>
 #include <stdexcept>
 #include <vector>
 
@@ -57,6 +59,15 @@ static ex lgamma_evalf(const ex & x)
  *  Handles integer arguments as a special case.
  *
  *  @exception GiNaC::pole_error("lgamma_eval(): logarithmic pole",0) */
+static bool lgamma_evalf_double(const std::complex<double> args[], std::complex<double> & result)
+{
+	// Elsewhere lgamma is complex, on a branch left to evalf()
+	if (args[0].imag() != 0 || !(args[0].real() > 0))
+		return false;
+	result = ::lgamma(args[0].real());
+	return true;
+}
+
 static ex lgamma_eval(const ex & x)
 {
 	if (x.info(info_flags::numeric)) {
@@ -125,8 +136,9 @@ static ex lgamma_conjugate(const ex & x)
 }
 
 
-REGISTER_FUNCTION(lgamma, eval_func(lgamma_eval).
+REGISTER_LAZY_FUNCTION(lgamma, eval_func(lgamma_eval).
                           evalf_func(lgamma_evalf).
+                          evalf_double_func(lgamma_evalf_double).
                           derivative_func(lgamma_deriv).
                           series_func(lgamma_series).
                           conjugate_func(lgamma_conjugate).
@@ -154,6 +166,17 @@ static ex tgamma_evalf(const ex & x)
  *  some good numerical evaluation some day...
  *
  *  @exception pole_error("tgamma_eval(): simple pole",0) */
+static bool tgamma_evalf_double(const std::complex<double> args[], std::complex<double> & result)
+{
+	if (args[0].imag() != 0)
+		return false;
+	const double value = ::tgamma(args[0].real());
+	if (value - value != 0)
+		return false;  // let evalf() raise the pole error
+	result = value;
+	return true;
+}
+
 static ex tgamma_eval(const ex & x)
 {
 	if (x.info(info_flags::numeric)) {
@@ -230,8 +253,10 @@ static ex tgamma_conjugate(const ex & x)
 }
 
 
-REGISTER_FUNCTION(tgamma, eval_func(tgamma_eval).
+REGISTER_LAZY_FUNCTION(tgamma, eval_func(tgamma_eval).
                           evalf_func(tgamma_evalf).
+                          evalf_double_func(tgamma_evalf_double).
+                          remember_evalf(256, 4, remember_strategies::delete_lru).
                           derivative_func(tgamma_deriv).
                           series_func(tgamma_series).
                           conjugate_func(tgamma_conjugate).
@@ -348,7 +373,7 @@ static ex beta_series(const ex & arg1,
 }
 
 
-REGISTER_FUNCTION(beta, eval_func(beta_eval).
+REGISTER_LAZY_FUNCTION(beta, eval_func(beta_eval).
                         evalf_func(beta_evalf).
                         derivative_func(beta_deriv).
                         series_func(beta_series).
@@ -371,8 +396,7 @@ static ex psi1_evalf(const ex & x)
 	return psi(x).hold();
 }
 
-/** Evaluation of digamma-function psi(x).
- *  Somebody ought to provide some good numerical evaluation some day... */
+/** Evaluation of digamma-function psi(x). */
 static ex psi1_eval(const ex & x)
 {
 	if (x.info(info_flags::numeric)) {
@@ -410,7 +434,8 @@ static ex psi1_eval(const ex & x)
 				return recur+psi(_ex1_2);
 			}
 		}
-		//  psi1_evalf should be called here once it becomes available
+		if (!nx.is_rational())
+			return psi1_evalf(x);
 	}
 	
 	return psi(x).hold();
@@ -472,8 +497,7 @@ static ex psi2_evalf(const ex & n, const ex & x)
 	return psi(n,x).hold();
 }
 
-/** Evaluation of polygamma-function psi(n,x). 
- *  Somebody ought to provide some good numerical evaluation some day... */
+/** Evaluation of polygamma-function psi(n,x). */
 static ex psi2_eval(const ex & n, const ex & x)
 {
 	// psi(0,x) -> psi(x)
@@ -531,7 +555,8 @@ static ex psi2_eval(const ex & n, const ex & x)
 				return recur+psi(n,_ex1_2);
 			}
 		}
-		//  psi2_evalf should be called here once it becomes available
+		if (!nx.is_rational())
+			return psi2_evalf(n, x);
 	}
 	
 	return psi(n, x).hold();
@@ -64,9 +64,14 @@
  *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
  */
 
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
 #include "inifcns.h"
 
 #include "add.h"
+#include "archive.h"
 #include "constant.h"
 #include "lst.h"
 #include "mul.h"
@@ -76,13 +81,23 @@
 #include "pseries.h"
 #include "relational.h"
 #include "symbol.h"
+#include "tasks.h"
 #include "utils.h"
 #include "wildcard.h"
 
+#include <algorithm>
 #include <cln/cln.h>
+#include <cmath>
+#include <limits>
+#include <map>
 #include <sstream>
 #include <stdexcept>
 #include <vector>
+#if defined(GINAC_THREADSAFE_REFCOUNT) && defined(HAVE_PTHREAD_H)
+// The points of polylog_evalf() are only evaluated concurrently if
+// expressions may be shared between threads at all.
+#define PARALLEL_POLYLOG 1
+#endif
 
 namespace GiNaC {
 
@@ -100,8 +115,32 @@ namespace GiNaC {
 namespace {
 
 
+// The lookup tables Xn and Yn below grow on demand.  CLN doesn't update its
+// reference counts atomically, so the numbers in the tables must not be
+// touched by several threads at once.  All uses of the tables are therefore
+// serialized by this lock, the rest of the evaluation runs concurrently.
+#ifdef GINAC_THREADSAFE_REFCOUNT
+int polylog_table_mutex = 0;
+
+/** Scoped spin lock around accesses to the tables Xn and Yn.  It is not
+ *  recursive, so nothing holding it may evaluate a polylogarithm. */
+class polylog_table_lock {
+public:
+	polylog_table_lock() { while (__sync_lock_test_and_set(&polylog_table_mutex, 1)) ; }
+	~polylog_table_lock() { __sync_lock_release(&polylog_table_mutex); }
+};
+#else
+class polylog_table_lock {
+public:
+	polylog_table_lock() {}
+};
+#endif
+
+
 // lookup table for factors built from Bernoulli numbers
 // see fill_Xn()
+// The entries are exact rational numbers, so the table is valid for any
+// precision and is never cleared.
 std::vector<std::vector<cln::cl_N> > Xn;
 // initial size of Xn that should suffice for 32bit machines (must be even)
 const int xninitsizestep = 26;
@@ -253,6 +292,10 @@ cln::cl_N Li2_do_sum(const cln::cl_N& x)
 // calculates Li(2,x) with Xn
 cln::cl_N Li2_do_sum_Xn(const cln::cl_N& x)
 {
+	polylog_table_lock lock;
+	if (xnsize == 0) {
+		fill_Xn(0);
+	}
 	std::vector<cln::cl_N>::const_iterator it = Xn[0].begin();
 	std::vector<cln::cl_N>::const_iterator xend = Xn[0].end();
 	cln::cl_N u = -cln::log(1-x);
@@ -296,6 +339,13 @@ cln::cl_N Lin_do_sum(int n, const cln::cl_N& x)
 // calculates Li(n,x), n>2 with Xn
 cln::cl_N Lin_do_sum_Xn(int n, const cln::cl_N& x)
 {
+	polylog_table_lock lock;
+	// check if precalculated Xn exist
+	if (n > xnsize+1) {
+		for (int i=xnsize; i<n-1; i++) {
+			fill_Xn(i);
+		}
+	}
 	std::vector<cln::cl_N>::const_iterator it = Xn[n-2].begin();
 	std::vector<cln::cl_N>::const_iterator xend = Xn[n-2].end();
 	cln::cl_N u = -cln::log(1-x);
@@ -327,11 +377,6 @@ cln::cl_N Li_projection(int n, const cln::cl_N& x, const cln::float_format_t& pr
 {
 	// treat n=2 as special case
 	if (n == 2) {
-		// check if precalculated X0 exists
-		if (xnsize == 0) {
-			fill_Xn(0);
-		}
-
 		if (cln::realpart(x) < 0.5) {
 			// choose the faster algorithm
 			// the switching point was empirically determined. the optimal point
@@ -356,13 +401,6 @@ cln::cl_N Li_projection(int n, const cln::cl_N& x, const cln::float_format_t& pr
 			}
 		}
 	} else {
-		// check if precalculated Xn exist
-		if (n > xnsize+1) {
-			for (int i=xnsize; i<n-1; i++) {
-				fill_Xn(i);
-			}
-		}
-
 		if (cln::realpart(x) < 0.5) {
 			// choose the faster algorithm
 			// with n>=12 the "normal" summation always wins against the method with Xn
@@ -685,8 +723,112 @@ Gparameter prepare_pending_integrals(const Gparameter& pending_integrals, int sc
 }
 
 
+#ifdef GINAC_THREADSAFE_REFCOUNT
+int G_trafo_mutex = 0;
+
+/** Scoped spin lock around accesses to the remembered symbolic reductions. */
+class G_trafo_lock {
+public:
+	G_trafo_lock() { while (__sync_lock_test_and_set(&G_trafo_mutex, 1)) ; }
+	~G_trafo_lock() { __sync_lock_release(&G_trafo_mutex); }
+};
+#else
+class G_trafo_lock {
+public:
+	G_trafo_lock() {}
+};
+#endif
+
+// counters of get_polylog_reduction_statistics()
+unsigned long polylog_reduction_lookups = 0;
+unsigned long polylog_reduction_hits = 0;
+
+
+// The recursion of G_transform() and trailing_zeros_G() meets the same
+// parameters over and over again for higher weights.  Their results are
+// remembered.  The dummy symbols are part of the key, so the entries stay
+// valid from one transformation to the next.
+struct G_reduction_key {
+	enum { transform, trailing_zeros } kind;
+	Gparameter pendint;
+	Gparameter a;
+	int scale;
+	bool flag_trailing_zeros_only;
+	exvector gsyms;
+
+	bool operator<(const G_reduction_key& other) const
+	{
+		if (kind != other.kind)
+			return kind < other.kind;
+		if (scale != other.scale)
+			return scale < other.scale;
+		if (flag_trailing_zeros_only != other.flag_trailing_zeros_only)
+			return other.flag_trailing_zeros_only;
+		if (a != other.a)
+			return a < other.a;
+		if (pendint != other.pendint)
+			return pendint < other.pendint;
+		return std::lexicographical_compare(gsyms.begin(), gsyms.end(),
+		                                    other.gsyms.begin(), other.gsyms.end(),
+		                                    ex_is_less());
+	}
+};
+
+std::map<G_reduction_key, ex> G_reduction_memo;
+// the remembered reductions are discarded when there are more
+const std::size_t max_G_reduction_memo = 4096;
+
+
+// look up a remembered reduction, the result shares no numbers with it
+bool G_reduction_lookup(const G_reduction_key& key, ex& result)
+{
+	G_trafo_lock lock;
+	++polylog_reduction_lookups;
+	std::map<G_reduction_key, ex>::const_iterator it = G_reduction_memo.find(key);
+	if (it == G_reduction_memo.end() || !copy_numbers(it->second, result)) {
+		return false;
+	}
+	++polylog_reduction_hits;
+	return true;
+}
+
+
+// remember a reduction, if it can be handed out again
+void G_reduction_store(const G_reduction_key& key, const ex& result)
+{
+	ex copy;
+	G_trafo_lock lock;
+	if (!copy_numbers(result, copy)) {
+		return;
+	}
+	if (G_reduction_memo.size() >= max_G_reduction_memo) {
+		G_reduction_memo.clear();
+	}
+	G_reduction_memo.insert(std::make_pair(key, copy));
+}
+
+
 // handles trailing zeroes for an otherwise convergent integral
+ex trailing_zeros_G_do(const Gparameter& a, int scale, const exvector& gsyms);
+
 ex trailing_zeros_G(const Gparameter& a, int scale, const exvector& gsyms)
+{
+	G_reduction_key key;
+	key.kind = G_reduction_key::trailing_zeros;
+	key.a = a;
+	key.scale = scale;
+	key.flag_trailing_zeros_only = false;
+	key.gsyms = gsyms;
+	ex result;
+	if (!G_reduction_lookup(key, result)) {
+		result = trailing_zeros_G_do(a, scale, gsyms);
+		G_reduction_store(key, result);
+	}
+	return result;
+}
+
+
+ex trailing_zeros_G_do(const Gparameter& a, int scale, const exvector& gsyms)
 {
 	bool convergent;
 	int depth, trailing_zeros;
@@ -807,8 +949,30 @@ ex shuffle_G(const Gparameter & a0, const Gparameter & a1, const Gparameter & a2
 
 
 // G transformation [VSW]
+ex G_transform_do(const Gparameter& pendint, const Gparameter& a, int scale,
+		  const exvector& gsyms, bool flag_trailing_zeros_only);
+
 ex G_transform(const Gparameter& pendint, const Gparameter& a, int scale,
 	       const exvector& gsyms, bool flag_trailing_zeros_only)
+{
+	G_reduction_key key;
+	key.kind = G_reduction_key::transform;
+	key.pendint = pendint;
+	key.a = a;
+	key.scale = scale;
+	key.flag_trailing_zeros_only = flag_trailing_zeros_only;
+	key.gsyms = gsyms;
+	ex result;
+	if (!G_reduction_lookup(key, result)) {
+		result = G_transform_do(pendint, a, scale, gsyms, flag_trailing_zeros_only);
+		G_reduction_store(key, result);
+	}
+	return result;
+}
+
+
+ex G_transform_do(const Gparameter& pendint, const Gparameter& a, int scale,
+		  const exvector& gsyms, bool flag_trailing_zeros_only)
 {
 	// main recursion routine
 	//
@@ -1062,6 +1226,85 @@ public:
 };
 
 
+// The symbolic part of the convergence transformation only depends on the
+// order of the absolute values of the parameters and on which of them are
+// equal.  It is remembered for each such pattern, so evaluating G with the
+// same parameters at many points does it only once.  All patterns use the
+// same dummy symbols.
+struct G_trafo_key {
+	Gparameter a;
+	std::vector<std::size_t> symidx;  // dummy symbol of each position
+	int scale;
+	bool flag_trailing_zeros_only;
+
+	bool operator<(const G_trafo_key& other) const
+	{
+		if (scale != other.scale)
+			return scale < other.scale;
+		if (flag_trailing_zeros_only != other.flag_trailing_zeros_only)
+			return other.flag_trailing_zeros_only;
+		if (a != other.a)
+			return a < other.a;
+		return symidx < other.symidx;
+	}
+};
+
+std::map<G_trafo_key, ex> G_trafo_memo;
+// the remembered transformations are discarded when there are more
+const std::size_t max_G_trafo_memo = 512;
+// the dummy symbols, G_trafo_syms[0] is a placeholder that must not occur
+exvector G_trafo_syms;
+
+
+// the dummy symbols used by G_do_trafo(), gsyms[k] is the symidx[k]-th one
+void G_trafo_symbols(std::size_t n, const std::vector<std::size_t>& symidx, exvector& gsyms)
+{
+	G_trafo_lock lock;
+	if (G_trafo_syms.empty()) {
+		G_trafo_syms.push_back(symbol("GSYMS_ERROR"));
+	}
+	while (G_trafo_syms.size() < n) {
+		std::ostringstream os;
+		os << "a" << G_trafo_syms.size();
+		G_trafo_syms.push_back(symbol(os.str()));
+	}
+	gsyms.clear();
+	gsyms.reserve(symidx.size());
+	for (std::size_t k = 0; k < symidx.size(); ++k) {
+		gsyms.push_back(G_trafo_syms[symidx[k]]);
+	}
+}
+
+
+// look up a remembered transformation, the result shares no numbers with it
+bool G_trafo_lookup(const G_trafo_key& key, ex& result)
+{
+	G_trafo_lock lock;
+	++polylog_reduction_lookups;
+	std::map<G_trafo_key, ex>::const_iterator it = G_trafo_memo.find(key);
+	if (it == G_trafo_memo.end() || !copy_numbers(it->second, result)) {
+		return false;
+	}
+	++polylog_reduction_hits;
+	return true;
+}
+
+
+// remember a transformation, if it can be handed out again
+void G_trafo_store(const G_trafo_key& key, const ex& result)
+{
+	ex copy;
+	G_trafo_lock lock;
+	if (!copy_numbers(result, copy)) {
+		return;
+	}
+	if (G_trafo_memo.size() >= max_G_trafo_memo) {
+		G_trafo_memo.clear();
+	}
+	G_trafo_memo.insert(std::make_pair(key, copy));
+}
+
+
 // convergence transformation, used for numerical evaluation of G function.
 // the parameter x, s and y must only contain numerics
 static cln::cl_N
@@ -1081,29 +1324,26 @@ G_do_trafo(const std::vector<cln::cl_N>& x, const std::vector<int>& s,
 	// include upper limit (scale)
 	sortmap.insert(std::make_pair(y, x.size()));
 
-	// generate missing dummy-symbols
-	int i = 1;
-	// holding dummy-symbols for the G/Li transformations
-	exvector gsyms;
-	gsyms.push_back(symbol("GSYMS_ERROR"));
+	// generate missing dummy-symbols, equal values share a symbol
+	std::vector<std::size_t> symidx;
+	symidx.push_back(0);
+	std::size_t i = 1;
 	cln::cl_N lastentry(0);
 	for (sortmap_t::const_iterator it = sortmap.begin(); it != sortmap.end(); ++it) {
 		if (it != sortmap.begin()) {
 			if (it->second < x.size()) {
 				if (x[it->second] == lastentry) {
-					gsyms.push_back(gsyms.back());
+					symidx.push_back(symidx.back());
 					continue;
 				}
 			} else {
 				if (y == lastentry) {
-					gsyms.push_back(gsyms.back());
+					symidx.push_back(symidx.back());
 					continue;
 				}
 			}
 		}
-		std::ostringstream os;
-		os << "a" << i;
-		gsyms.push_back(symbol(os.str()));
+		symidx.push_back(i);
 		++i;
 		if (it->second < x.size()) {
 			lastentry = x[it->second];
@@ -1111,6 +1351,9 @@ G_do_trafo(const std::vector<cln::cl_N>& x, const std::vector<int>& s,
 			lastentry = y;
 		}
 	}
+	// holding dummy-symbols for the G/Li transformations
+	exvector gsyms;
+	G_trafo_symbols(i, symidx, gsyms);
 
 	// fill position data according to sorted indices and prepare substitution list
 	Gparameter a(x.size());
@@ -1132,11 +1375,20 @@ G_do_trafo(const std::vector<cln::cl_N>& x, const std::vector<int>& s,
 		++pos;
 	}
 
-	// do transformation
-	Gparameter pendint;
-	ex result = G_transform(pendint, a, scale, gsyms, flag_trailing_zeros_only);
+	// do transformation, or look it up if it was done for the same pattern
+	G_trafo_key key;
+	key.a = a;
+	key.symidx = symidx;
+	key.scale = scale;
+	key.flag_trailing_zeros_only = flag_trailing_zeros_only;
+	ex result;
+	if (!G_trafo_lookup(key, result)) {
+		Gparameter pendint;
+		result = G_transform(pendint, a, scale, gsyms, flag_trailing_zeros_only);
+		result = result.eval().expand();
+		G_trafo_store(key, result);
+	}
 	// replace dummy symbols with their values
-	result = result.eval().expand();
 	result = result.subs(subslst).evalf();
 	if (!is_a<numeric>(result))
 		throw std::logic_error("G_do_trafo: G_transform returned non-numeric result");
@@ -1247,24 +1499,15 @@ ex mLi_numeric(const lst& m, const lst& x)
 //////////////////////////////////////////////////////////////////////
 
 
-static ex G2_evalf(const ex& x_, const ex& y)
+// Prepare the numerical evaluation of G(x,y): the parameters x as numbers
+// and their signs.  Returns false if they are not all numeric.
+static bool G2_prepare(const lst& x, std::vector<cln::cl_N>& xv, std::vector<int>& s, bool& all_zero)
 {
-	if (!y.info(info_flags::positive)) {
-		return G(x_, y).hold();
-	}
-	lst x = is_a<lst>(x_) ? ex_to<lst>(x_) : lst(x_);
-	if (x.nops() == 0) {
-		return _ex1;
-	}
-	if (x.op(0) == y) {
-		return G(x_, y).hold();
-	}
-	std::vector<int> s;
 	s.reserve(x.nops());
-	bool all_zero = true;
+	all_zero = true;
 	for (lst::const_iterator it = x.begin(); it != x.end(); ++it) {
 		if (!(*it).info(info_flags::numeric)) {
-			return G(x_, y).hold();
+			return false;
 		}
 		if (*it != _ex0) {
 			all_zero = false;
@@ -1276,13 +1519,34 @@ static ex G2_evalf(const ex& x_, const ex& y)
 			s.push_back(1);
 		}
 	}
-	if (all_zero) {
-		return pow(log(y), x.nops()) / factorial(x.nops());
-	}
-	std::vector<cln::cl_N> xv;
 	xv.reserve(x.nops());
 	for (lst::const_iterator it = x.begin(); it != x.end(); ++it)
 		xv.push_back(ex_to<numeric>(*it).to_cl_N());
+	return true;
+}
+
+
+static ex G2_evalf(const ex& x_, const ex& y)
+{
+	if (!y.info(info_flags::positive)) {
+		return G(x_, y).hold();
+	}
+	lst x = is_a<lst>(x_) ? ex_to<lst>(x_) : lst(x_);
+	if (x.nops() == 0) {
+		return _ex1;
+	}
+	if (x.op(0) == y) {
+		return G(x_, y).hold();
+	}
+	std::vector<cln::cl_N> xv;
+	std::vector<int> s;
+	bool all_zero;
+	if (!G2_prepare(x, xv, s, all_zero)) {
+		return G(x_, y).hold();
+	}
+	if (all_zero) {
+		return pow(log(y), x.nops()) / factorial(x.nops());
+	}
 	cln::cl_N result = G_numeric(xv, s, ex_to<numeric>(y).to_cl_N());
 	return numeric(result);
 }
@@ -1343,6 +1607,7 @@ static ex G2_eval(const ex& x_, const ex& y)
 
 unsigned G2_SERIAL::serial = function::register_new(function_options("G", 2).
                                 evalf_func(G2_evalf).
+                                remember_evalf(256, 4, remember_strategies::delete_lru).
                                 eval_func(G2_eval).
                                 do_not_evalf_params().
                                 overloaded(2));
@@ -1351,31 +1616,19 @@ unsigned G2_SERIAL::serial = function::register_new(function_options("G", 2).
 //                                print_func<print_latex>(G2_print_latex).
 
 
-static ex G3_evalf(const ex& x_, const ex& s_, const ex& y)
+// Prepare the numerical evaluation of G(x,s,y): the parameters x as numbers
+// and the signs of their imaginary parts.  Returns false if they are not all
+// numeric or the signs are not real.
+static bool G3_prepare(const lst& x, const lst& s, std::vector<cln::cl_N>& xn, std::vector<int>& sn, bool& all_zero)
 {
-	if (!y.info(info_flags::positive)) {
-		return G(x_, s_, y).hold();
-	}
-	lst x = is_a<lst>(x_) ? ex_to<lst>(x_) : lst(x_);
-	lst s = is_a<lst>(s_) ? ex_to<lst>(s_) : lst(s_);
-	if (x.nops() != s.nops()) {
-		return G(x_, s_, y).hold();
-	}
-	if (x.nops() == 0) {
-		return _ex1;
-	}
-	if (x.op(0) == y) {
-		return G(x_, s_, y).hold();
-	}
-	std::vector<int> sn;
 	sn.reserve(s.nops());
-	bool all_zero = true;
+	all_zero = true;
 	for (lst::const_iterator itx = x.begin(), its = s.begin(); itx != x.end(); ++itx, ++its) {
 		if (!(*itx).info(info_flags::numeric)) {
-			return G(x_, y).hold();
+			return false;
 		}
 		if (!(*its).info(info_flags::real)) {
-			return G(x_, y).hold();
+			return false;
 		}
 		if (*itx != _ex0) {
 			all_zero = false;
@@ -1401,13 +1654,38 @@ static ex G3_evalf(const ex& x_, const ex& s_, const ex& y)
 			}
 		}
 	}
-	if (all_zero) {
-		return pow(log(y), x.nops()) / factorial(x.nops());
-	}
-	std::vector<cln::cl_N> xn;
 	xn.reserve(x.nops());
 	for (lst::const_iterator it = x.begin(); it != x.end(); ++it)
 		xn.push_back(ex_to<numeric>(*it).to_cl_N());
+	return true;
+}
+
+
+static ex G3_evalf(const ex& x_, const ex& s_, const ex& y)
+{
+	if (!y.info(info_flags::positive)) {
+		return G(x_, s_, y).hold();
+	}
+	lst x = is_a<lst>(x_) ? ex_to<lst>(x_) : lst(x_);
+	lst s = is_a<lst>(s_) ? ex_to<lst>(s_) : lst(s_);
+	if (x.nops() != s.nops()) {
+		return G(x_, s_, y).hold();
+	}
+	if (x.nops() == 0) {
+		return _ex1;
+	}
+	if (x.op(0) == y) {
+		return G(x_, s_, y).hold();
+	}
+	std::vector<cln::cl_N> xn;
+	std::vector<int> sn;
+	bool all_zero;
+	if (!G3_prepare(x, s, xn, sn, all_zero)) {
+		return G(x_, y).hold();
+	}
+	if (all_zero) {
+		return pow(log(y), x.nops()) / factorial(x.nops());
+	}
 	cln::cl_N result = G_numeric(xn, sn, ex_to<numeric>(y).to_cl_N());
 	return numeric(result);
 }
@@ -1489,6 +1767,7 @@ static ex G3_eval(const ex& x_, const ex& s_, const ex& y)
 
 unsigned G3_SERIAL::serial = function::register_new(function_options("G", 3).
                                 evalf_func(G3_evalf).
+                                remember_evalf(256, 4, remember_strategies::delete_lru).
                                 eval_func(G3_eval).
                                 do_not_evalf_params().
                                 overloaded(2));
@@ -1560,6 +1839,19 @@ static ex Li_evalf(const ex& m_, const ex& x_)
 }
 
 
+static bool Li_evalf_double(const std::complex<double> args[], std::complex<double> & result)
+{
+	// Li(n,x) with real x <= 1 by Li_double(), all else by evalf()
+	const double n = args[0].real();
+	if (args[0].imag() != 0 || args[1].imag() != 0 || n != std::floor(n) || n < 1 || n > 1000)
+		return false;
+	double value, error;
+	if (!Li_double(int(n), args[1].real(), value, error))
+		return false;
+	result = value;
+	return true;
+}
+
 static ex Li_eval(const ex& m_, const ex& x_)
 {
 	if (is_a<lst>(m_)) {
@@ -1755,15 +2047,263 @@ static void Li_print_latex(const ex& m_, const ex& x_, const print_context& c)
 }
 
 
-REGISTER_FUNCTION(Li,
+static void Li_print_csrc(const ex& m_, const ex& x_, const print_context& c)
+{
+	// classical polylogs are evaluated by the double precision routine
+	// ginac_Li_double() in compiled expressions
+	if (m_.info(info_flags::posint) && !is_a<lst>(x_)) {
+		c.s << "ginac_Li_double(";
+	} else {
+		c.s << "Li(";
+	}
+	m_.print(c);
+	c.s << ",";
+	x_.print(c);
+	c.s << ")";
+}
+
+
+REGISTER_LAZY_FUNCTION(Li,
                   evalf_func(Li_evalf).
+                  evalf_double_func(Li_evalf_double).
+                  remember_evalf(256, 4, remember_strategies::delete_lru).
                   eval_func(Li_eval).
                   series_func(Li_series).
                   derivative_func(Li_deriv).
                   print_func<print_latex>(Li_print_latex).
+                  print_func<print_csrc_float>(Li_print_csrc).
+                  print_func<print_csrc_double>(Li_print_csrc).
                   do_not_evalf_params());
 
 
+//////////////////////////////////////////////////////////////////////
+//
+// Classical polylogarithm  Li(n,x)  in hardware double precision
+//
+// helper functions
+//
+//////////////////////////////////////////////////////////////////////
+
+
+// anonymous namespace for helper functions
+namespace {
+
+
+const double Li_double_eps = std::numeric_limits<double>::epsilon();
+
+
+// zeta(s) for integer s>=2 by the accelerated alternating series of
+// Borwein, the truncation error is below 3*(3+sqrt(8))^(-22) < 1e-16
+double zeta_double(int s)
+{
+	const int n = 22;
+	double d[n+1];
+	double t = 1.0/n;
+	double sum = t;
+	d[0] = n*sum;
+	for (int i=0; i<n; i++) {
+		t *= 4.0*(n+i)*(n-i) / ((2*i+1)*(2*i+2));
+		sum += t;
+		d[i+1] = n*sum;
+	}
+	double eta = 0;
+	for (int k=0; k<n; k++) {
+		const double term = (d[k]-d[n]) / std::pow(double(k+1), s);
+		eta += (k & 1) ? -term : term;
+	}
+	eta = -eta / d[n];
+	return eta / (1.0 - std::pow(2.0, 1-s));
+}
+
+
+// zeta(s) for any integer s != 1, the values at negative odd integers are
+// obtained from the functional equation
+double zeta_double_all(int s)
+{
+	if (s >= 2) {
+		return zeta_double(s);
+	}
+	if (s == 0) {
+		return -0.5;
+	}
+	const int m = -s;
+	if ((m & 1) == 0) {
+		return 0;
+	}
+	// zeta(1-2j) = (-1)^j 2 (2j-1)! zeta(2j) / (2 pi)^(2j)
+	const int j = (m+1)/2;
+	const double twopi = 2*std::acos(-1.0);
+	double f = 2;
+	for (int i=1; i<2*j; i++) {
+		f *= i / twopi;
+	}
+	f *= zeta_double(2*j) / twopi;
+	return (j & 1) ? -f : f;
+}
+
+
+// Li(n,x) for 0 <= x <= 1 and n >= 2, err accumulates the estimated
+// absolute rounding and truncation error
+bool Li_double_pos(int n, double x, double& res, double& err)
+{
+	if (x == 0) {
+		res = 0;
+		return true;
+	}
+	if (x == 1) {
+		res = zeta_double(n);
+		err += 4*Li_double_eps*res;
+		return true;
+	}
+	if (x <= 0.5) {
+		// [Kol] (2.13), the tail is bounded by the geometric series
+		double sum = 0, abssum = 0, xk = 1;
+		for (int k=1; k<1000; k++) {
+			xk *= x;
+			const double term = xk / std::pow(double(k), n);
+			sum += term;
+			abssum += term;
+			if (term * x / (1-x) < Li_double_eps * sum) {
+				res = sum;
+				err += 2*Li_double_eps*abssum;
+				return true;
+			}
+		}
+		return false;
+	}
+	// expansion in mu = log(x) around x=1, converges for |mu| < 2 pi
+	// Li(n,e^mu) = sum_{k!=n-1} zeta(n-k) mu^k/k! + mu^(n-1)/(n-1)! (H_{n-1} - log(-mu))
+	const double mu = std::log(x);
+	double sum = 0, abssum = 0, muk = 1;
+	for (int k=0; k<200; k++) {
+		if (k > 0) {
+			muk *= mu / k;
+		}
+		double term;
+		if (k == n-1) {
+			double harmonic = 0;
+			for (int i=1; i<n; i++) {
+				harmonic += 1.0/i;
+			}
+			term = muk * (harmonic - std::log(-mu));
+		} else {
+			term = zeta_double_all(n-k) * muk;
+		}
+		sum += term;
+		abssum += std::abs(term);
+		// the nonvanishing terms beyond k=n decrease like (mu/(2 pi))^k
+		if (k > n && term != 0 && std::abs(term) < Li_double_eps * std::abs(sum)) {
+			res = sum;
+			err += 4*Li_double_eps*abssum;
+			return true;
+		}
+	}
+	return false;
+}
+
+
+// Li(n,x) for -1 <= x < 0 and n >= 2 by the duplication formula
+// Li(n,-x) = 2^(1-n) Li(n,x^2) - Li(n,x)
+bool Li_double_neg(int n, double x, double& res, double& err)
+{
+	double li_sq, li_abs;
+	if (!Li_double_pos(n, x*x, li_sq, err) || !Li_double_pos(n, -x, li_abs, err)) {
+		return false;
+	}
+	res = std::ldexp(li_sq, 1-n) - li_abs;
+	err += Li_double_eps * std::abs(res);
+	return true;
+}
+
+
+} // end of anonymous namespace
+
+
+//////////////////////////////////////////////////////////////////////
+//
+// Classical polylogarithm  Li(n,x)  in hardware double precision
+//
+// GiNaC function
+//
+//////////////////////////////////////////////////////////////////////
+
+
+bool Li_double(int n, double x, double& result, double& error)
+{
+	if (n < 1 || !(x <= 1)) {
+		// Li(n,x) is complex for x > 1, NaN is rejected here as well
+		return false;
+	}
+	double res;
+	double err = 0;
+	if (n == 1) {
+		if (x == 1) {
+			return false;
+		}
+		res = -log1p(-x);
+		err = 2*Li_double_eps*std::abs(res);
+	} else if (x >= 0) {
+		if (!Li_double_pos(n, x, res, err)) {
+			return false;
+		}
+	} else if (x >= -1) {
+		if (!Li_double_neg(n, x, res, err)) {
+			return false;
+		}
+	} else {
+		// inversion [Kol] (5.15) for real x < -1:
+		// Li(n,x) = -(-1)^n Li(n,1/x) - log(-x)^n/n!
+		//           + 2 sum_{k=1}^{n/2} Li(2k,-1) log(-x)^(n-2k)/(n-2k)!
+		double li_inv;
+		if (!Li_double_neg(n, 1/x, li_inv, err)) {
+			return false;
+		}
+		const double l = std::log(-x);
+		// powers l^j/j! for j=0..n
+		std::vector<double> lpow(n+1);
+		lpow[0] = 1;
+		for (int j=1; j<=n; j++) {
+			lpow[j] = lpow[j-1] * l / j;
+		}
+		res = (n & 1) ? li_inv : -li_inv;
+		double abssum = std::abs(li_inv) + lpow[n];
+		res -= lpow[n];
+		for (int k=1; 2*k<=n; k++) {
+			const double li_minus_one = -(1 - std::ldexp(1.0, 1-2*k)) * zeta_double(2*k);
+			const double term = 2 * li_minus_one * lpow[n-2*k];
+			res += term;
+			abssum += std::abs(term);
+		}
+		err += 4*Li_double_eps*abssum;
+	}
+	// refuse results that lost too many digits by cancellation
+	if (err > 1e-14 * std::abs(res) && res != 0) {
+		return false;
+	}
+	result = res;
+	error = err;
+	return true;
+}
+
+
+double ginac_Li_double(int n, double x)
+{
+	double result, error;
+	if (Li_double(n, x, result, error)) {
+		return result;
+	}
+	// fall back to CLN, the result is only returned if it is real
+	try {
+		const ex val = Li(n, numeric(x)).evalf();
+		if (is_a<numeric>(val) && ex_to<numeric>(val).is_real()) {
+			return ex_to<numeric>(val).to_double();
+		}
+	} catch (const std::exception&) {
+	}
+	return std::numeric_limits<double>::quiet_NaN();
+}
+
+
 //////////////////////////////////////////////////////////////////////
 //
 // Nielsen's generalized polylogarithm  S(n,p,x)
@@ -1782,6 +2322,49 @@ namespace {
 std::vector<std::vector<cln::cl_N> > Yn;
 int ynsize = 0; // number of Yn[]
 int ynlength = 100; // initial length of all Yn[i]
+cln::float_format_t ynprec = cln::default_float_format; // precision of Yn
+
+
+// The Yn depend on the precision.  The tables for the precisions used before
+// are kept, so that switching Digits back and forth doesn't recompute them.
+struct Yn_table {
+	std::vector<std::vector<cln::cl_N> > Yn;
+	int ynsize;
+	int ynlength;
+};
+std::map<cln::float_format_t, Yn_table> Yn_tables;
+// maximum number of tables kept besides Yn
+const std::size_t max_Yn_tables = 4;
+
+
+// Make Yn the table for the given precision, keeping the current one.
+void select_Yn(const cln::float_format_t& prec)
+{
+	if (prec == ynprec) {
+		return;
+	}
+	if (ynsize > 0) {
+		Yn_table& old = Yn_tables[ynprec];
+		old.Yn.swap(Yn);
+		old.ynsize = ynsize;
+		old.ynlength = ynlength;
+	}
+	std::map<cln::float_format_t, Yn_table>::iterator it = Yn_tables.find(prec);
+	if (it != Yn_tables.end()) {
+		Yn.swap(it->second.Yn);
+		ynsize = it->second.ynsize;
+		ynlength = it->second.ynlength;
+		Yn_tables.erase(it);
+	} else {
+		Yn.clear();
+		ynsize = 0;
+		ynlength = 100;
+	}
+	ynprec = prec;
+	while (Yn_tables.size() > max_Yn_tables) {
+		Yn_tables.erase(Yn_tables.begin());
+	}
+}
 
 
 // This function calculates the Y_n. The Y_n are needed for the evaluation of S_{n,p}(x).
@@ -1959,19 +2542,14 @@ cln::cl_N b_k(int k)
 // helper function for S(n,p,x)
 cln::cl_N S_do_sum(int n, int p, const cln::cl_N& x, const cln::float_format_t& prec)
 {
-	static cln::float_format_t oldprec = cln::default_float_format;
-
 	if (p==1) {
 		return Li_projection(n+1, x, prec);
 	}
 
-	// precision has changed, we need to clear lookup table Yn
-	if ( oldprec != prec ) {
-		Yn.clear();
-		ynsize = 0;
-		ynlength = 100;
-		oldprec = prec;
-	}
+	polylog_table_lock lock;
+
+	// lookup table Yn depends on the precision
+	select_Yn(prec);
 		
 	// check if precalculated values are sufficient
 	if (p > ynsize+1) {
@@ -2137,6 +2715,142 @@ const cln::cl_N S_num(int n, int p, const cln::cl_N& x)
 } // end of anonymous namespace
 
 
+/** Precompute the lookup tables used for the numerical evaluation of the
+ *  classical polylogarithms Li(m,x) with m<=n and of the Nielsen
+ *  polylogarithms S(m,q,x) with q<=p, the latter at the current Digits.
+ *  The tables are kept when Digits changes, so they can be prepared once
+ *  at startup.  Evaluations only extend them if they need more terms. */
+void prepare_polylog_tables(int n, int p)
+{
+	polylog_table_lock lock;
+	if (n > xnsize+1) {
+		for (int i=xnsize; i<n-1; i++) {
+			fill_Xn(i);
+		}
+	}
+	select_Yn(cln::float_format(Digits));
+	if (p > ynsize+1) {
+		for (int i=ynsize; i<p-1; i++) {
+			fill_Yn(i, ynprec);
+		}
+	}
+}
+
+
+/** Write a lookup table as a list of lists.  The caller must hold the lock. */
+static std::string save_table(const std::vector<std::vector<cln::cl_N> >& table)
+{
+	std::string buf;
+	lst rows;
+	for (std::size_t n=0; n<table.size(); ++n) {
+		lst row;
+		for (std::size_t i=0; i<table[n].size(); ++i) {
+			row.append(numeric(table[n][i]));
+		}
+		rows.append(row);
+	}
+	serialize(rows, buf);
+	return buf;
+}
+
+
+/** Read a lookup table written by save_table().  The caller must hold the
+ *  lock, the numbers read must not outlive it. */
+static void load_table(const std::string& buf, std::vector<std::vector<cln::cl_N> >& table, bool exact)
+{
+	lst syms;
+	const ex rows = deserialize(buf, syms);
+	if (!is_a<lst>(rows)) {
+		throw std::runtime_error("load_caches(): invalid polylogarithm table");
+	}
+	table.resize(rows.nops());
+	for (std::size_t n=0; n<rows.nops(); ++n) {
+		const ex& row = rows.op(n);
+		if (!is_a<lst>(row)) {
+			throw std::runtime_error("load_caches(): invalid polylogarithm table");
+		}
+		table[n].resize(row.nops());
+		for (std::size_t i=0; i<row.nops(); ++i) {
+			if (!is_a<numeric>(row.op(i)) || !ex_to<numeric>(row.op(i)).is_real()
+			 || exact != ex_to<numeric>(row.op(i)).is_rational()) {
+				throw std::runtime_error("load_caches(): invalid polylogarithm table");
+			}
+			table[n][i] = ex_to<numeric>(row.op(i)).to_cl_N();
+		}
+	}
+}
+
+
+/** The table Xn for the classical polylogarithms, see save_caches(). */
+std::string save_Xn_table()
+{
+	polylog_table_lock lock;
+	return save_table(Xn);
+}
+
+
+/** Replace the table Xn by one written by save_Xn_table() if that is
+ *  larger. */
+void load_Xn_table(const std::string& buf)
+{
+	polylog_table_lock lock;
+	std::vector<std::vector<cln::cl_N> > table;
+	load_table(buf, table, true);
+	if (table.empty()) {
+		return;
+	}
+	// X_0 holds half as many numbers as the others
+	const int size = 2 * table[0].size();
+	for (std::size_t n=1; n<table.size(); ++n) {
+		if (table[n].size() != std::size_t(size)) {
+			throw std::runtime_error("load_caches(): invalid polylogarithm table");
+		}
+	}
+	if (int(table.size()) >= xnsize && size >= xninitsize
+	    && (int(table.size()) > xnsize || size > xninitsize)) {
+		Xn.swap(table);
+		xnsize = Xn.size();
+		xninitsize = size;
+	}
+}
+
+
+/** The table Yn for the Nielsen polylogarithms at the current Digits, see
+ *  save_caches(). */
+std::string save_Yn_table()
+{
+	polylog_table_lock lock;
+	select_Yn(cln::float_format(Digits));
+	return save_table(Yn);
+}
+
+
+/** Replace the table Yn at the current Digits by one written by
+ *  save_Yn_table() if that is larger. */
+void load_Yn_table(const std::string& buf)
+{
+	polylog_table_lock lock;
+	std::vector<std::vector<cln::cl_N> > table;
+	load_table(buf, table, false);
+	if (table.empty()) {
+		return;
+	}
+	const int length = table[0].size();
+	for (std::size_t n=0; n<table.size(); ++n) {
+		if (table[n].size() != std::size_t(length) || length == 0) {
+			throw std::runtime_error("load_caches(): invalid polylogarithm table");
+		}
+	}
+	select_Yn(cln::float_format(Digits));
+	if (int(table.size()) >= ynsize && length >= ynlength
+	    && (int(table.size()) > ynsize || length > ynlength)) {
+		Yn.swap(table);
+		ynsize = Yn.size();
+		ynlength = length;
+	}
+}
+
+
 //////////////////////////////////////////////////////////////////////
 //
 // Nielsen's generalized polylogarithm  S(n,p,x)
@@ -2273,8 +2987,9 @@ static void S_print_latex(const ex& n, const ex& p, const ex& x, const print_con
 }
 
 
-REGISTER_FUNCTION(S,
+REGISTER_LAZY_FUNCTION(S,
                   evalf_func(S_evalf).
+                  remember_evalf(256, 4, remember_strategies::delete_lru).
                   eval_func(S_eval).
                   series_func(S_series).
                   derivative_func(S_deriv).
@@ -2302,7 +3017,72 @@ symbol H_polesign("IMSIGN");
 // convert parameters from H to Li representation
 // parameters are expected to be in expanded form, i.e. only 0, 1 and -1
 // returns true if some parameters are negative
+bool convert_parameter_H_to_Li_do(const lst& l, lst& m, lst& s, ex& pf);
+
+// the conversions done by convert_parameter_H_to_Li()
+struct H_conversion {
+	lst m;
+	lst s;
+	ex pf;
+	bool has_negative_parameters;
+};
+
+std::map<ex, H_conversion, ex_is_less> H_conversion_memo;
+// the remembered conversions are discarded when there are more
+const std::size_t max_H_conversion_memo = 1024;
+
+
+// copy of a conversion that shares no numbers with it
+bool copy_H_conversion(const H_conversion& from, H_conversion& to)
+{
+	ex m, s;
+	if (!copy_numbers(from.m, m) || !copy_numbers(from.s, s) || !copy_numbers(from.pf, to.pf)) {
+		return false;
+	}
+	to.m = ex_to<lst>(m);
+	to.s = ex_to<lst>(s);
+	to.has_negative_parameters = from.has_negative_parameters;
+	return true;
+}
+
+
 bool convert_parameter_H_to_Li(const lst& l, lst& m, lst& s, ex& pf)
+{
+	H_conversion conv;
+	bool found = false;
+	{
+		G_trafo_lock lock;
+		++polylog_reduction_lookups;
+		std::map<ex, H_conversion, ex_is_less>::const_iterator it = H_conversion_memo.find(l);
+		if (it != H_conversion_memo.end() && copy_H_conversion(it->second, conv)) {
+			++polylog_reduction_hits;
+			found = true;
+		}
+	}
+	if (!found) {
+		conv.has_negative_parameters = convert_parameter_H_to_Li_do(l, conv.m, conv.s, conv.pf);
+		ex key;
+		H_conversion copy;
+		if (copy_numbers(l, key) && copy_H_conversion(conv, copy)) {
+			G_trafo_lock lock;
+			if (H_conversion_memo.size() >= max_H_conversion_memo) {
+				H_conversion_memo.clear();
+			}
+			H_conversion_memo.insert(std::make_pair(key, copy));
+		}
+	}
+	for (lst::const_iterator it = conv.m.begin(); it != conv.m.end(); ++it) {
+		m.append(*it);
+	}
+	for (lst::const_iterator it = conv.s.begin(); it != conv.s.end(); ++it) {
+		s.append(*it);
+	}
+	pf = conv.pf;
+	return conv.has_negative_parameters;
+}
+
+
+bool convert_parameter_H_to_Li_do(const lst& l, lst& m, lst& s, ex& pf)
 {
 	// expand parameter list
 	lst mexp;
@@ -3488,8 +4268,9 @@ static void H_print_latex(const ex& m_, const ex& x, const print_context& c)
 }
 
 
-REGISTER_FUNCTION(H,
+REGISTER_LAZY_FUNCTION(H,
                   evalf_func(H_evalf).
+                  remember_evalf(256, 4, remember_strategies::delete_lru).
                   eval_func(H_eval).
                   series_func(H_series).
                   derivative_func(H_deriv).
@@ -3983,6 +4764,7 @@ static void zeta1_print_latex(const ex& m_, const print_context& c)
 
 unsigned zeta1_SERIAL::serial = function::register_new(function_options("zeta", 1).
                                 evalf_func(zeta1_evalf).
+                                remember_evalf(256, 4, remember_strategies::delete_lru).
                                 eval_func(zeta1_eval).
                                 derivative_func(zeta1_deriv).
                                 print_func<print_latex>(zeta1_print_latex).
@@ -4120,6 +4902,7 @@ static void zeta2_print_latex(const ex& m_, const ex& s_, const print_context& c
 
 unsigned zeta2_SERIAL::serial = function::register_new(function_options("zeta", 2).
                                 evalf_func(zeta2_evalf).
+                                remember_evalf(256, 4, remember_strategies::delete_lru).
                                 eval_func(zeta2_eval).
                                 derivative_func(zeta2_deriv).
                                 print_func<print_latex>(zeta2_print_latex).
@@ -4127,5 +4910,265 @@ unsigned zeta2_SERIAL::serial = function::register_new(function_options("zeta",
                                 overloaded(2));
 
 
+//////////////////////////////////////////////////////////////////////
+//
+// Statistics of the remembered symbolic reductions
+//
+//////////////////////////////////////////////////////////////////////
+
+
+/** Get the counters of the tables remembering the symbolic reductions of
+ *  G (in its numerical evaluation) and the conversions of H to Li. */
+polylog_reduction_statistics get_polylog_reduction_statistics()
+{
+	G_trafo_lock lock;
+	polylog_reduction_statistics stats;
+	stats.lookups = polylog_reduction_lookups;
+	stats.hits = polylog_reduction_hits;
+	stats.size = G_trafo_memo.size() + G_reduction_memo.size() + H_conversion_memo.size();
+	return stats;
+}
+
+/** Reset the lookup and hit counters (not the tables themselves). */
+void reset_polylog_reduction_statistics()
+{
+	G_trafo_lock lock;
+	polylog_reduction_lookups = 0;
+	polylog_reduction_hits = 0;
+}
+
+
+//////////////////////////////////////////////////////////////////////
+//
+// Numerical evaluation of polylogarithms at many points
+//
+//////////////////////////////////////////////////////////////////////
+
+
+static unsigned polylog_threads = 1;
+
+/** Set the number of threads polylog_evalf() uses.  This has an effect only
+ *  if GiNaC was built with GINAC_THREADSAFE_REFCOUNT and pthreads.
+ *
+ *  @return previous setting */
+unsigned set_polylog_threads(unsigned n)
+{
+	const unsigned previous = polylog_threads;
+	polylog_threads = (n == 0 ? 1 : n);
+	return previous;
+}
+
+/** Get the number of threads used by polylog_evalf(). */
+unsigned get_polylog_threads()
+{
+	return polylog_threads;
+}
+
+
+// anonymous namespace for helper functions
+namespace {
+
+
+// Numerical evaluation of one polylogarithm at many values of its last
+// argument.  Everything depending only on the other arguments is done once
+// by the constructor, the transformations of G are remembered by
+// G_do_trafo().
+class polylog_batch {
+public:
+	explicit polylog_batch(const ex& f);
+	ex evalf_at(const ex& y) const;
+private:
+	ex generic_evalf_at(const ex& y) const;
+
+	enum { generic_kind, G_kind, Li_kind, S_kind } kind;
+	ex f;
+	std::vector<cln::cl_N> x;  // parameters of G as numbers
+	std::vector<int> s;        // signs of the parameters of G
+	bool all_zero;             // all parameters of G are zero
+	int n, p;                  // indices of Li and S
+};
+
+
+polylog_batch::polylog_batch(const ex& f_)
+  : kind(generic_kind), f(f_), all_zero(false), n(0), p(0)
+{
+	if (is_the_function<G2_SERIAL>(f)) {
+		const lst xl = is_a<lst>(f.op(0)) ? ex_to<lst>(f.op(0)) : lst(f.op(0));
+		if (xl.nops() > 0 && G2_prepare(xl, x, s, all_zero)) {
+			kind = G_kind;
+		}
+	} else if (is_the_function<G3_SERIAL>(f)) {
+		const lst xl = is_a<lst>(f.op(0)) ? ex_to<lst>(f.op(0)) : lst(f.op(0));
+		const lst sl = is_a<lst>(f.op(1)) ? ex_to<lst>(f.op(1)) : lst(f.op(1));
+		if (xl.nops() > 0 && xl.nops() == sl.nops() && G3_prepare(xl, sl, x, s, all_zero)) {
+			kind = G_kind;
+		}
+	} else if (is_ex_the_function(f, Li)) {
+		if (f.op(0).info(info_flags::posint)) {
+			n = ex_to<numeric>(f.op(0)).to_int();
+			kind = Li_kind;
+		}
+	} else if (is_ex_the_function(f, S)) {
+		if (f.op(0).info(info_flags::posint) && f.op(1).info(info_flags::posint)) {
+			n = ex_to<numeric>(f.op(0)).to_int();
+			p = ex_to<numeric>(f.op(1)).to_int();
+			kind = S_kind;
+		}
+	} else if (!is_ex_the_function(f, H)) {
+		throw std::invalid_argument("polylog_evalf(): not a polylogarithm G, Li, S or H");
+	}
+}
+
+
+// the polylogarithm with y as its last argument, evaluated as usual
+ex polylog_batch::generic_evalf_at(const ex& y) const
+{
+	ex e = f;
+	e.let_op(e.nops()-1) = y;
+	return e.evalf();
+}
+
+
+ex polylog_batch::evalf_at(const ex& y) const
+{
+	switch (kind) {
+		case G_kind:
+			// as in G2_evalf() and G3_evalf()
+			if (!is_a<numeric>(y) || !y.info(info_flags::positive) || y == numeric(x[0])) {
+				break;
+			}
+			if (all_zero) {
+				return pow(log(y), x.size()) / factorial(x.size());
+			}
+			return numeric(G_numeric(x, s, ex_to<numeric>(y).to_cl_N()));
+		case Li_kind:
+		case S_kind: {
+			// as in Li_evalf() and S_evalf()
+			const ex y_val = is_a<numeric>(y) ? y : y.evalf();
+			if (!is_a<numeric>(y_val)) {
+				break;
+			}
+			const cln::cl_N y_ = ex_to<numeric>(y_val).to_cl_N();
+			return numeric(kind == Li_kind ? Lin_numeric(n, y_) : S_num(n, p, y_));
+		}
+		default:
+			break;
+	}
+	return generic_evalf_at(y);
+}
+
+
+#ifdef PARALLEL_POLYLOG
+
+/** Batches with fewer points are evaluated by the calling thread alone. */
+const std::size_t min_parallel_points = 8;
+
+/** Evaluation at a slice of the points, to be run as a task. */
+struct polylog_job {
+	ex f;
+	exvector points;
+	exvector values;
+	bool failed;
+};
+
+void * run_polylog_job(void * arg)
+{
+	polylog_job & job = *static_cast<polylog_job *>(arg);
+	try {
+		const polylog_batch batch(job.f);
+		for (exvector::const_iterator i = job.points.begin(); i != job.points.end(); ++i)
+			job.values.push_back(batch.evalf_at(*i));
+	} catch (...) {
+		job.failed = true;
+	}
+	return 0;
+}
+
+/** CLN computes pi, log(2), e, Euler's and Catalan's constant at a new
+ *  precision once and caches the result without synchronization.  They are
+ *  computed here, in the calling thread, at twice the working precision,
+ *  which covers the guard digits CLN adds in its intermediate results, so
+ *  the tasks only read the caches. */
+void prepare_cln_constants()
+{
+	const cln::float_format_t prec = cln::float_format(2*Digits);
+	cln::pi(prec);
+	cln::pi(cln::default_float_format);
+	cln::log(cln::cl_float(2, prec));
+	cln::exp1(prec);
+	cln::eulerconst(prec);
+	cln::catalanconst(prec);
+}
+
+/** Evaluate at the points concurrently, each task working on copies of
+ *  the polylogarithm and its points.  The first slice is done by the
+ *  calling thread.
+ *  @return false if the points have to be evaluated one by one instead */
+bool polylog_evalf_parallel(const ex& f, const exvector& points, exvector& values)
+{
+	const std::size_t nthreads = std::min<std::size_t>(polylog_threads, points.size());
+	std::vector<polylog_job> jobs(nthreads);
+	for (std::size_t k = 0; k < nthreads; ++k) {
+		polylog_job & job = jobs[k];
+		const std::size_t first = points.size() * k / nthreads;
+		const std::size_t last = points.size() * (k + 1) / nthreads;
+		job.f = f;
+		if (k > 0 && !copy_numbers(f, job.f))
+			return false;
+		for (std::size_t i = first; i < last; ++i) {
+			ex point = points[i];
+			if (k > 0 && !copy_numbers(points[i], point))
+				return false;
+			job.points.push_back(point);
+		}
+		job.values.reserve(last - first);
+		job.failed = false;
+	}
+
+	prepare_cln_constants();
+	run_tasks(run_polylog_job, jobs);
+	for (std::size_t k = 0; k < nthreads; ++k)
+		if (jobs[k].failed)
+			return false;
+
+	for (std::size_t k = 0; k < nthreads; ++k)
+		values.insert(values.end(), jobs[k].values.begin(), jobs[k].values.end());
+	return true;
+}
+
+#endif // def PARALLEL_POLYLOG
+
+
+} // end of anonymous namespace
+
+
+/** Numerically evaluate the polylogarithm f, one of G(a,y), G(a,s,y),
+ *  Li(m,x), S(n,p,x) and H(m,x), with its last argument replaced by each of
+ *  the points.  The result is the same as that of evalf() one by one, but
+ *  the work depending only on the other arguments is done once.  Several
+ *  threads are used if so requested (see set_polylog_threads()).
+ *
+ *  @param f  polylogarithm whose last argument is to be replaced
+ *  @param points  values of the last argument
+ *  @return vector of the values at the points
+ *  @exception invalid_argument (f is not a polylogarithm) */
+exvector polylog_evalf(const ex& f, const exvector& points)
+{
+	const polylog_batch batch(f);
+	exvector values;
+	values.reserve(points.size());
+#ifdef PARALLEL_POLYLOG
+	if (polylog_threads > 1 && points.size() >= min_parallel_points) {
+		if (polylog_evalf_parallel(f, points, values))
+			return values;
+		values.clear();
+	}
+#endif
+	for (exvector::const_iterator i = points.begin(); i != points.end(); ++i)
+		values.push_back(batch.evalf_at(*i));
+	return values;
+}
+
+
 } // namespace GiNaC
 
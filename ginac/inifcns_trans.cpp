@@ -34,11 +34,45 @@
 #include "pseries.h"
 #include "utils.h"
 
+#include <cmath>
+#include <complex>
 #include <stdexcept>
 #include <vector>
 
 namespace GiNaC {
 
+//////////
+// helpers of the double precision kernels for evalf_double()
+//////////
+
+/** Values of magnitude below this are evaluated by series, where the
+ *  logarithmic formulas of the inverse functions would cancel. */
+static const double series_radius = 1e-3;
+
+/** The logarithm on the principal branch.  GiNaC's numbers have no signed
+ *  zero, so an imaginary part of -0.0 must not select the other side of
+ *  the branch cut. */
+static std::complex<double> log_double(const std::complex<double> & x)
+{
+	return std::log(x.imag() == 0 ? std::complex<double>(x.real()) : x);
+}
+
+/** The square root on the principal branch, see log_double(). */
+static std::complex<double> sqrt_double(const std::complex<double> & x)
+{
+	return std::sqrt(x.imag() == 0 ? std::complex<double>(x.real()) : x);
+}
+
+/** asin(x) = -I*log(I*x+sqrt(1-x^2)) for complex x. */
+static std::complex<double> asin_double(const std::complex<double> & x)
+{
+	if (std::abs(x) < series_radius)
+		return x * (1.0 + x*x * (1.0/6 + x*x * (3.0/40 + x*x * (5.0/112))));
+	const std::complex<double> ix(-x.imag(), x.real());
+	const std::complex<double> l = log_double(ix + sqrt_double(1.0 - x*x));
+	return std::complex<double>(l.imag(), -l.real());
+}
+
 //////////
 // exponential function
 //////////
@@ -51,6 +85,13 @@ static ex exp_evalf(const ex & x)
 	return exp(x).hold();
 }
 
+static bool exp_evalf_double(const std::complex<double> args[], std::complex<double> & result)
+{
+	const std::complex<double> & x = args[0];
+	result = x.imag() == 0 ? std::complex<double>(::exp(x.real())) : std::exp(x);
+	return true;
+}
+
 static ex exp_eval(const ex & x)
 {
 	// exp(0) -> 1
@@ -112,6 +153,35 @@ static ex exp_deriv(const ex & x, unsigned deriv_param)
 	return exp(x);
 }
 
+/** Series expansion of the argument of a function whose series is computed
+ *  from that of its argument by a coefficient recurrence of pseries.  This
+ *  avoids the growing derivatives of the Taylor expansion in basic::series().
+ *  Arguments which are constant or have a pole are left to the Taylor
+ *  expansion. */
+static pseries regular_arg_series(const ex & arg,
+                                  const relational & rel,
+                                  int order,
+                                  unsigned options)
+{
+	if (arg.diff(ex_to<symbol>(rel.lhs())).is_zero())
+		throw do_taylor();  // caught by function::series()
+	const ex argser = arg.series(rel, order, options);
+	if (!is_a<pseries>(argser) || argser.ldegree(rel.lhs()) < 0)
+		throw do_taylor();  // caught by function::series()
+	return ex_to<pseries>(argser);
+}
+
+static ex exp_series(const ex & arg,
+                     const relational & rel,
+                     int order,
+                     unsigned options)
+{
+	// method:
+	// Series expand the argument first and compute the exponential of that
+	// series by the recurrence in pseries::exp_series().
+	return regular_arg_series(arg, rel, order, options).exp_series(order);
+}
+
 static ex exp_real_part(const ex & x)
 {
 	return exp(GiNaC::real_part(x))*cos(GiNaC::imag_part(x));
@@ -128,10 +198,12 @@ static ex exp_conjugate(const ex & x)
 	return exp(x.conjugate());
 }
 
-REGISTER_FUNCTION(exp, eval_func(exp_eval).
+REGISTER_LAZY_FUNCTION(exp, eval_func(exp_eval).
                        evalf_func(exp_evalf).
+                       evalf_double_func(exp_evalf_double).
                        expand_func(exp_expand).
                        derivative_func(exp_deriv).
+                       series_func(exp_series).
                        real_part_func(exp_real_part).
                        imag_part_func(exp_imag_part).
                        conjugate_func(exp_conjugate).
@@ -149,6 +221,18 @@ static ex log_evalf(const ex & x)
 	return log(x).hold();
 }
 
+static bool log_evalf_double(const std::complex<double> args[], std::complex<double> & result)
+{
+	const std::complex<double> & x = args[0];
+	if (x == 0.0)
+		return false;  // let evalf() raise the pole error
+	if (x.imag() == 0 && x.real() > 0)
+		result = ::log(x.real());
+	else
+		result = log_double(x);
+	return true;
+}
+
 static ex log_eval(const ex & x)
 {
 	if (x.info(info_flags::numeric)) {
@@ -276,7 +360,15 @@ static ex log_series(const ex &arg,
 		seq.push_back(expair(Order(_ex1), order));
 		return series(replarg - I*Pi + pseries(rel, seq), rel, order);
 	}
-	throw do_taylor();  // caught by function::series()
+	// method:
+	// This is a regular point: Series expand the argument and compute the
+	// logarithm of that series by the recurrence in pseries::log_series().
+	const ex argser = arg.series(rel, order, options);
+	if (!is_a<pseries>(argser) || argser.nops() == 0 ||
+	    argser.ldegree(rel.lhs()) != 0 ||
+	    is_order_function(ex_to<pseries>(argser).coeffop(0)))
+		throw do_taylor();  // caught by function::series()
+	return ex_to<pseries>(argser).log_series(order);
 }
 
 static ex log_real_part(const ex & x)
@@ -354,8 +446,9 @@ static ex log_conjugate(const ex & x)
 	return conjugate_function(log(x)).hold();
 }
 
-REGISTER_FUNCTION(log, eval_func(log_eval).
+REGISTER_LAZY_FUNCTION(log, eval_func(log_eval).
                        evalf_func(log_evalf).
+                       evalf_double_func(log_evalf_double).
                        expand_func(log_expand).
                        derivative_func(log_deriv).
                        series_func(log_series).
@@ -376,6 +469,13 @@ static ex sin_evalf(const ex & x)
 	return sin(x).hold();
 }
 
+static bool sin_evalf_double(const std::complex<double> args[], std::complex<double> & result)
+{
+	const std::complex<double> & x = args[0];
+	result = x.imag() == 0 ? std::complex<double>(::sin(x.real())) : std::sin(x);
+	return true;
+}
+
 static ex sin_eval(const ex & x)
 {
 	// sin(n/d*Pi) -> { all known non-nested radicals }
@@ -447,6 +547,17 @@ static ex sin_deriv(const ex & x, unsigned deriv_param)
 	return cos(x);
 }
 
+static ex sin_series(const ex & arg,
+                    const relational & rel,
+                    int order,
+                    unsigned options)
+{
+	// method:
+	// Series expand the argument first and compute the sine of that
+	// series by the recurrence in pseries::sin_series().
+	return regular_arg_series(arg, rel, order, options).sin_series(order);
+}
+
 static ex sin_real_part(const ex & x)
 {
 	return cosh(GiNaC::imag_part(x))*sin(GiNaC::real_part(x));
@@ -463,9 +574,11 @@ static ex sin_conjugate(const ex & x)
 	return sin(x.conjugate());
 }
 
-REGISTER_FUNCTION(sin, eval_func(sin_eval).
+REGISTER_LAZY_FUNCTION(sin, eval_func(sin_eval).
                        evalf_func(sin_evalf).
+                       evalf_double_func(sin_evalf_double).
                        derivative_func(sin_deriv).
+                       series_func(sin_series).
                        real_part_func(sin_real_part).
                        imag_part_func(sin_imag_part).
                        conjugate_func(sin_conjugate).
@@ -483,6 +596,13 @@ static ex cos_evalf(const ex & x)
 	return cos(x).hold();
 }
 
+static bool cos_evalf_double(const std::complex<double> args[], std::complex<double> & result)
+{
+	const std::complex<double> & x = args[0];
+	result = x.imag() == 0 ? std::complex<double>(::cos(x.real())) : std::cos(x);
+	return true;
+}
+
 static ex cos_eval(const ex & x)
 {
 	// cos(n/d*Pi) -> { all known non-nested radicals }
@@ -554,6 +674,17 @@ static ex cos_deriv(const ex & x, unsigned deriv_param)
 	return -sin(x);
 }
 
+static ex cos_series(const ex & arg,
+                    const relational & rel,
+                    int order,
+                    unsigned options)
+{
+	// method:
+	// Series expand the argument first and compute the cosine of that
+	// series by the recurrence in pseries::cos_series().
+	return regular_arg_series(arg, rel, order, options).cos_series(order);
+}
+
 static ex cos_real_part(const ex & x)
 {
 	return cosh(GiNaC::imag_part(x))*cos(GiNaC::real_part(x));
@@ -570,9 +701,11 @@ static ex cos_conjugate(const ex & x)
 	return cos(x.conjugate());
 }
 
-REGISTER_FUNCTION(cos, eval_func(cos_eval).
+REGISTER_LAZY_FUNCTION(cos, eval_func(cos_eval).
                        evalf_func(cos_evalf).
+                       evalf_double_func(cos_evalf_double).
                        derivative_func(cos_deriv).
+                       series_func(cos_series).
                        real_part_func(cos_real_part).
                        imag_part_func(cos_imag_part).
                        conjugate_func(cos_conjugate).
@@ -590,6 +723,13 @@ static ex tan_evalf(const ex & x)
 	return tan(x).hold();
 }
 
+static bool tan_evalf_double(const std::complex<double> args[], std::complex<double> & result)
+{
+	const std::complex<double> & x = args[0];
+	result = x.imag() == 0 ? std::complex<double>(::tan(x.real())) : std::tan(x);
+	return true;
+}
+
 static ex tan_eval(const ex & x)
 {
 	// tan(n/d*Pi) -> { all known non-nested radicals }
@@ -694,8 +834,9 @@ static ex tan_conjugate(const ex & x)
 	return tan(x.conjugate());
 }
 
-REGISTER_FUNCTION(tan, eval_func(tan_eval).
+REGISTER_LAZY_FUNCTION(tan, eval_func(tan_eval).
                        evalf_func(tan_evalf).
+                       evalf_double_func(tan_evalf_double).
                        derivative_func(tan_deriv).
                        series_func(tan_series).
                        real_part_func(tan_real_part).
@@ -715,6 +856,19 @@ static ex asin_evalf(const ex & x)
 	return asin(x).hold();
 }
 
+static bool asin_evalf_double(const std::complex<double> args[], std::complex<double> & result)
+{
+	const std::complex<double> & x = args[0];
+	if (x.imag() == 0) {
+		// The branch cuts are left to evalf()
+		if (std::fabs(x.real()) > 1)
+			return false;
+		result = ::asin(x.real());
+	} else
+		result = asin_double(x);
+	return true;
+}
+
 static ex asin_eval(const ex & x)
 {
 	if (x.info(info_flags::numeric)) {
@@ -770,8 +924,9 @@ static ex asin_conjugate(const ex & x)
 	return conjugate_function(asin(x)).hold();
 }
 
-REGISTER_FUNCTION(asin, eval_func(asin_eval).
+REGISTER_LAZY_FUNCTION(asin, eval_func(asin_eval).
                         evalf_func(asin_evalf).
+                        evalf_double_func(asin_evalf_double).
                         derivative_func(asin_deriv).
                         conjugate_func(asin_conjugate).
                         latex_name("\\arcsin"));
@@ -788,6 +943,18 @@ static ex acos_evalf(const ex & x)
 	return acos(x).hold();
 }
 
+static bool acos_evalf_double(const std::complex<double> args[], std::complex<double> & result)
+{
+	const std::complex<double> & x = args[0];
+	if (x.imag() == 0) {
+		if (std::fabs(x.real()) > 1)
+			return false;
+		result = ::acos(x.real());
+	} else
+		result = 1.5707963267948966 - asin_double(x);
+	return true;
+}
+
 static ex acos_eval(const ex & x)
 {
 	if (x.info(info_flags::numeric)) {
@@ -843,8 +1010,9 @@ static ex acos_conjugate(const ex & x)
 	return conjugate_function(acos(x)).hold();
 }
 
-REGISTER_FUNCTION(acos, eval_func(acos_eval).
+REGISTER_LAZY_FUNCTION(acos, eval_func(acos_eval).
                         evalf_func(acos_evalf).
+                        evalf_double_func(acos_evalf_double).
                         derivative_func(acos_deriv).
                         conjugate_func(acos_conjugate).
                         latex_name("\\arccos"));
@@ -861,6 +1029,23 @@ static ex atan_evalf(const ex & x)
 	return atan(x).hold();
 }
 
+static bool atan_evalf_double(const std::complex<double> args[], std::complex<double> & result)
+{
+	const std::complex<double> & x = args[0];
+	if (x.imag() == 0)
+		result = ::atan(x.real());
+	else if (x.real() == 0 && std::fabs(x.imag()) >= 1)
+		return false;  // branch cut or pole
+	else if (std::abs(x) < series_radius)
+		result = x * (1.0 - x*x * (1.0/3 - x*x * (1.0/5 - x*x / 7.0)));
+	else {
+		const std::complex<double> ix(-x.imag(), x.real());
+		const std::complex<double> d = log_double(1.0 + ix) - log_double(1.0 - ix);
+		result = std::complex<double>(d.imag(), -d.real()) / 2.0;
+	}
+	return true;
+}
+
 static ex atan_eval(const ex & x)
 {
 	if (x.info(info_flags::numeric)) {
@@ -907,7 +1092,9 @@ static ex atan_series(const ex &arg,
 {
 	GINAC_ASSERT(is_a<symbol>(rel.lhs()));
 	// method:
-	// Taylor series where there is no pole or cut falls back to atan_deriv.
+	// Where there is no pole or cut, the argument is expanded first and the
+	// arc tangent of that series is computed by the recurrence in
+	// pseries::atan_series().
 	// There are two branch cuts, one runnig from I up the imaginary axis and
 	// one running from -I down the imaginary axis.  The points I and -I are
 	// poles.
@@ -915,10 +1102,10 @@ static ex atan_series(const ex &arg,
 	//     (log(1+I*x)-log(1-I*x))/(2*I)
 	// instead.
 	const ex arg_pt = arg.subs(rel, subs_options::no_pattern);
-	if (!(I*arg_pt).info(info_flags::real))
-		throw do_taylor();     // Re(x) != 0
-	if ((I*arg_pt).info(info_flags::real) && abs(I*arg_pt)<_ex1)
-		throw do_taylor();     // Re(x) == 0, but abs(x)<1
+	if (!(I*arg_pt).info(info_flags::real))  // Re(x) != 0
+		return regular_arg_series(arg, rel, order, options).atan_series(order);
+	if ((I*arg_pt).info(info_flags::real) && abs(I*arg_pt)<_ex1)  // Re(x) == 0, but abs(x)<1
+		return regular_arg_series(arg, rel, order, options).atan_series(order);
 	// care for the poles, using the defining formula for atan()...
 	if (arg_pt.is_equal(I) || arg_pt.is_equal(-I))
 		return ((log(1+I*arg)-log(1-I*arg))/(2*I)).series(rel, order, options);
@@ -959,8 +1146,9 @@ static ex atan_conjugate(const ex & x)
 	return conjugate_function(atan(x)).hold();
 }
 
-REGISTER_FUNCTION(atan, eval_func(atan_eval).
+REGISTER_LAZY_FUNCTION(atan, eval_func(atan_eval).
                         evalf_func(atan_evalf).
+                        evalf_double_func(atan_evalf_double).
                         derivative_func(atan_deriv).
                         series_func(atan_series).
                         conjugate_func(atan_conjugate).
@@ -978,6 +1166,15 @@ static ex atan2_evalf(const ex &y, const ex &x)
 	return atan2(y, x).hold();
 }
 
+static bool atan2_evalf_double(const std::complex<double> args[], std::complex<double> & result)
+{
+	if (args[0].imag() != 0 || args[1].imag() != 0)
+		return false;
+	// There is no signed zero in GiNaC
+	result = ::atan2(args[0].real() == 0 ? 0.0 : args[0].real(), args[1].real());
+	return true;
+}
+
 static ex atan2_eval(const ex & y, const ex & x)
 {
 	if (y.is_zero()) {
@@ -1061,8 +1258,9 @@ static ex atan2_deriv(const ex & y, const ex & x, unsigned deriv_param)
 	return -y*power(power(x,_ex2)+power(y,_ex2),_ex_1);
 }
 
-REGISTER_FUNCTION(atan2, eval_func(atan2_eval).
+REGISTER_LAZY_FUNCTION(atan2, eval_func(atan2_eval).
                          evalf_func(atan2_evalf).
+                         evalf_double_func(atan2_evalf_double).
                          derivative_func(atan2_deriv));
 
 //////////
@@ -1077,6 +1275,13 @@ static ex sinh_evalf(const ex & x)
 	return sinh(x).hold();
 }
 
+static bool sinh_evalf_double(const std::complex<double> args[], std::complex<double> & result)
+{
+	const std::complex<double> & x = args[0];
+	result = x.imag() == 0 ? std::complex<double>(::sinh(x.real())) : std::sinh(x);
+	return true;
+}
+
 static ex sinh_eval(const ex & x)
 {
 	if (x.info(info_flags::numeric)) {
@@ -1125,6 +1330,17 @@ static ex sinh_deriv(const ex & x, unsigned deriv_param)
 	return cosh(x);
 }
 
+static ex sinh_series(const ex & arg,
+                     const relational & rel,
+                     int order,
+                     unsigned options)
+{
+	// method:
+	// Series expand the argument first and compute the hyperbolic sine of that
+	// series by the recurrence in pseries::sinh_series().
+	return regular_arg_series(arg, rel, order, options).sinh_series(order);
+}
+
 static ex sinh_real_part(const ex & x)
 {
 	return sinh(GiNaC::real_part(x))*cos(GiNaC::imag_part(x));
@@ -1141,9 +1357,11 @@ static ex sinh_conjugate(const ex & x)
 	return sinh(x.conjugate());
 }
 
-REGISTER_FUNCTION(sinh, eval_func(sinh_eval).
+REGISTER_LAZY_FUNCTION(sinh, eval_func(sinh_eval).
                         evalf_func(sinh_evalf).
+                        evalf_double_func(sinh_evalf_double).
                         derivative_func(sinh_deriv).
+                        series_func(sinh_series).
                         real_part_func(sinh_real_part).
                         imag_part_func(sinh_imag_part).
                         conjugate_func(sinh_conjugate).
@@ -1161,6 +1379,13 @@ static ex cosh_evalf(const ex & x)
 	return cosh(x).hold();
 }
 
+static bool cosh_evalf_double(const std::complex<double> args[], std::complex<double> & result)
+{
+	const std::complex<double> & x = args[0];
+	result = x.imag() == 0 ? std::complex<double>(::cosh(x.real())) : std::cosh(x);
+	return true;
+}
+
 static ex cosh_eval(const ex & x)
 {
 	if (x.info(info_flags::numeric)) {
@@ -1209,6 +1434,17 @@ static ex cosh_deriv(const ex & x, unsigned deriv_param)
 	return sinh(x);
 }
 
+static ex cosh_series(const ex & arg,
+                     const relational & rel,
+                     int order,
+                     unsigned options)
+{
+	// method:
+	// Series expand the argument first and compute the hyperbolic cosine of that
+	// series by the recurrence in pseries::cosh_series().
+	return regular_arg_series(arg, rel, order, options).cosh_series(order);
+}
+
 static ex cosh_real_part(const ex & x)
 {
 	return cosh(GiNaC::real_part(x))*cos(GiNaC::imag_part(x));
@@ -1225,9 +1461,11 @@ static ex cosh_conjugate(const ex & x)
 	return cosh(x.conjugate());
 }
 
-REGISTER_FUNCTION(cosh, eval_func(cosh_eval).
+REGISTER_LAZY_FUNCTION(cosh, eval_func(cosh_eval).
                         evalf_func(cosh_evalf).
+                        evalf_double_func(cosh_evalf_double).
                         derivative_func(cosh_deriv).
+                        series_func(cosh_series).
                         real_part_func(cosh_real_part).
                         imag_part_func(cosh_imag_part).
                         conjugate_func(cosh_conjugate).
@@ -1245,6 +1483,13 @@ static ex tanh_evalf(const ex & x)
 	return tanh(x).hold();
 }
 
+static bool tanh_evalf_double(const std::complex<double> args[], std::complex<double> & result)
+{
+	const std::complex<double> & x = args[0];
+	result = x.imag() == 0 ? std::complex<double>(::tanh(x.real())) : std::tanh(x);
+	return true;
+}
+
 static ex tanh_eval(const ex & x)
 {
 	if (x.info(info_flags::numeric)) {
@@ -1329,8 +1574,9 @@ static ex tanh_conjugate(const ex & x)
 	return tanh(x.conjugate());
 }
 
-REGISTER_FUNCTION(tanh, eval_func(tanh_eval).
+REGISTER_LAZY_FUNCTION(tanh, eval_func(tanh_eval).
                         evalf_func(tanh_evalf).
+                        evalf_double_func(tanh_evalf_double).
                         derivative_func(tanh_deriv).
                         series_func(tanh_series).
                         real_part_func(tanh_real_part).
@@ -1350,6 +1596,20 @@ static ex asinh_evalf(const ex & x)
 	return asinh(x).hold();
 }
 
+static bool asinh_evalf_double(const std::complex<double> args[], std::complex<double> & result)
+{
+	const std::complex<double> & x = args[0];
+	if (x.imag() == 0)
+		result = ::asinh(x.real());
+	else if (x.real() == 0 && std::fabs(x.imag()) > 1)
+		return false;  // branch cut
+	else if (std::abs(x) < series_radius)
+		result = x * (1.0 - x*x * (1.0/6 - x*x * (3.0/40 - x*x * (5.0/112))));
+	else
+		result = log_double(x + sqrt_double(1.0 + x*x));
+	return true;
+}
+
 static ex asinh_eval(const ex & x)
 {
 	if (x.info(info_flags::numeric)) {
@@ -1394,8 +1654,9 @@ static ex asinh_conjugate(const ex & x)
 	return conjugate_function(asinh(x)).hold();
 }
 
-REGISTER_FUNCTION(asinh, eval_func(asinh_eval).
+REGISTER_LAZY_FUNCTION(asinh, eval_func(asinh_eval).
                          evalf_func(asinh_evalf).
+                         evalf_double_func(asinh_evalf_double).
                          derivative_func(asinh_deriv).
                          conjugate_func(asinh_conjugate));
 
@@ -1411,6 +1672,18 @@ static ex acosh_evalf(const ex & x)
 	return acosh(x).hold();
 }
 
+static bool acosh_evalf_double(const std::complex<double> args[], std::complex<double> & result)
+{
+	const std::complex<double> & x = args[0];
+	if (x.imag() == 0) {
+		if (x.real() < 1)
+			return false;  // branch cut
+		result = ::acosh(x.real());
+	} else
+		result = 2.0 * log_double(sqrt_double((x + 1.0) / 2.0) + sqrt_double((x - 1.0) / 2.0));
+	return true;
+}
+
 static ex acosh_eval(const ex & x)
 {
 	if (x.info(info_flags::numeric)) {
@@ -1458,8 +1731,9 @@ static ex acosh_conjugate(const ex & x)
 	return conjugate_function(acosh(x)).hold();
 }
 
-REGISTER_FUNCTION(acosh, eval_func(acosh_eval).
+REGISTER_LAZY_FUNCTION(acosh, eval_func(acosh_eval).
                          evalf_func(acosh_evalf).
+                         evalf_double_func(acosh_evalf_double).
                          derivative_func(acosh_deriv).
                          conjugate_func(acosh_conjugate));
 
@@ -1475,6 +1749,20 @@ static ex atanh_evalf(const ex & x)
 	return atanh(x).hold();
 }
 
+static bool atanh_evalf_double(const std::complex<double> args[], std::complex<double> & result)
+{
+	const std::complex<double> & x = args[0];
+	if (x.imag() == 0) {
+		if (std::fabs(x.real()) >= 1)
+			return false;  // branch cut or pole
+		result = ::atanh(x.real());
+	} else if (std::abs(x) < series_radius)
+		result = x * (1.0 + x*x * (1.0/3 + x*x * (1.0/5 + x*x / 7.0)));
+	else
+		result = (log_double(1.0 + x) - log_double(1.0 - x)) / 2.0;
+	return true;
+}
+
 static ex atanh_eval(const ex & x)
 {
 	if (x.info(info_flags::numeric)) {
@@ -1561,8 +1849,9 @@ static ex atanh_conjugate(const ex & x)
 	return conjugate_function(atanh(x)).hold();
 }
 
-REGISTER_FUNCTION(atanh, eval_func(atanh_eval).
+REGISTER_LAZY_FUNCTION(atanh, eval_func(atanh_eval).
                          evalf_func(atanh_evalf).
+                         evalf_double_func(atanh_evalf_double).
                          derivative_func(atanh_deriv).
                          series_func(atanh_series).
                          conjugate_func(atanh_conjugate));
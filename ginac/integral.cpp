@@ -33,6 +33,18 @@
 #include "utils.h"
 #include "operators.h"
 #include "relational.h"
+#include "excompiler.h"
+#include "tasks.h"
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <queue>
+#include <stdexcept>
+#include <vector>
 
 using namespace std;
 
@@ -188,7 +200,18 @@ ex integral::evalf(int level) const
 	// results after subsituting a number for the integration variable.
 	if (is_exactly_a<numeric>(ea) && is_exactly_a<numeric>(eb) 
 			&& is_exactly_a<numeric>(ef.subs(x==12.34).evalf())) {
-			return adaptivesimpson(x, ea, eb, ef);
+		// Accuracies within reach of doubles are obtained much faster by
+		// compiling the integrand, if it is real and can be compiled
+		if (is_exactly_a<numeric>(relative_integration_error)
+		    && ex_to<numeric>(relative_integration_error).is_real()
+		    && ex_to<numeric>(relative_integration_error) >= numeric(min_compiled_integration_error)) {
+			try {
+				return gauss_kronrod(x, ea, eb, ef);
+			} catch (std::invalid_argument &) {
+			} catch (std::runtime_error &) {
+			}
+		}
+		return adaptivesimpson(x, ea, eb, ef);
 	}
 
 	if (are_ex_trivially_equal(a, ea) && are_ex_trivially_equal(b, eb)
@@ -202,6 +225,10 @@ ex integral::evalf(int level) const
 int integral::max_integration_level = 15;
 ex integral::relative_integration_error = 1e-8;
 
+/** Smallest relative error for which integral::evalf() integrates in
+ *  doubles with gauss_kronrod(). */
+const double integral::min_compiled_integration_error = 1e-13;
+
 ex subsvalue(const ex & var, const ex & value, const ex & fun)
 {
 	ex result = fun.subs(var==value).evalf();
@@ -323,6 +350,321 @@ ex adaptivesimpson(const ex & x, const ex & a_in, const ex & b_in, const ex & f,
 	return app;
 }
 
+namespace {
+
+// Nodes of the 15-point Kronrod rule on [-1,1] (the ones with odd index
+// and 0 are those of the 7-point Gauss rule) and the weights of both rules,
+// from QUADPACK's qk15
+const double kronrod_nodes[8] = {
+	0.991455371120812639206854697526329, 0.949107912342758524526189684047851,
+	0.864864423359769072789712788640926, 0.741531185599394439863864773280788,
+	0.586087235467691130294144845693013, 0.405845151377397166906606412076961,
+	0.207784955007898467600689403773245, 0.0
+};
+const double kronrod_weights[8] = {
+	0.022935322010529224963732008058970, 0.063092092629978553290700663189204,
+	0.104790010322250183839876322541518, 0.140653259715525918745189590510238,
+	0.169004726639267902826583426598550, 0.190350578064785409913256402421014,
+	0.204432940075298892414161999234649, 0.209482141084727828012999174891714
+};
+const double gauss_weights[4] = {
+	0.129484966168869693270611432679082, 0.279705391489276667901467771423780,
+	0.381830050505118944950369775488975, 0.417959183673469387755102040816327
+};
+
+/** A subinterval with the estimates of the 15-point Kronrod rule. */
+struct gk_interval {
+	double a, b;
+	double integral;   ///< Kronrod estimate
+	double error;      ///< difference to the Gauss estimate
+	double magnitude;  ///< Kronrod estimate of the integral of |f|
+	int level;         ///< number of halvings of the whole interval
+
+	bool operator<(const gk_interval & other) const { return error < other.error; }
+};
+
+/** The integrand as a function of the integration variable, which is the
+ *  first argument of the compiled expression.  The others are fixed. */
+struct gk_integrand {
+	bytecode_evaluator * code;
+	std::vector<double> args;
+
+	double operator()(double x)
+	{
+		args[0] = x;
+		double result;
+		code->evaluate(&args[0], &result);
+		return result;
+	}
+};
+
+/** Apply the rules to the interval.  Returns false if the integrand is not
+ *  finite at one of the nodes. */
+bool apply_gauss_kronrod(gk_integrand & f, gk_interval & iv)
+{
+	const double center = (iv.a + iv.b) / 2, half = (iv.b - iv.a) / 2;
+	const double fc = f(center);
+	double kronrod = kronrod_weights[7] * fc;
+	double gauss = gauss_weights[3] * fc;
+	double magnitude = kronrod_weights[7] * std::fabs(fc);
+	for (int j = 0; j < 7; ++j) {
+		const double dx = half * kronrod_nodes[j];
+		const double f1 = f(center - dx), f2 = f(center + dx);
+		kronrod += kronrod_weights[j] * (f1 + f2);
+		magnitude += kronrod_weights[j] * (std::fabs(f1) + std::fabs(f2));
+		if (j % 2 == 1)
+			gauss += gauss_weights[j / 2] * (f1 + f2);
+	}
+	iv.integral = kronrod * half;
+	iv.error = std::fabs((kronrod - gauss) * half);
+	iv.magnitude = std::fabs(magnitude * half);
+	return iv.integral - iv.integral == 0 && iv.magnitude - iv.magnitude == 0;
+}
+
+/** Intervals to which one thread applies the rules. */
+struct gk_job {
+	gk_integrand * f;
+	std::vector<gk_interval>::iterator first, last;
+	bool failed;
+};
+
+void * run_gk_job(void * arg)
+{
+	gk_job & job = *static_cast<gk_job *>(arg);
+	for (std::vector<gk_interval>::iterator i = job.first; i != job.last; ++i)
+		if (!apply_gauss_kronrod(*job.f, *i))
+			job.failed = true;
+	return 0;
+}
+
+/** Apply the rules to all intervals, distributing them to nthreads tasks
+ *  with an integrand each.  The tasks only evaluate bytecode on doubles, so
+ *  they don't share any expressions and need no GINAC_THREADSAFE_REFCOUNT.  Returns false if the integrand is not finite
+ *  somewhere. */
+bool apply_gauss_kronrod(std::vector<gk_integrand> & integrands, std::size_t nthreads,
+                         std::vector<gk_interval> & intervals)
+{
+	nthreads = std::min(nthreads, intervals.size());
+	std::vector<gk_job> jobs(std::max(nthreads, std::size_t(1)));
+	for (std::size_t k = 0; k < jobs.size(); ++k) {
+		jobs[k].f = &integrands[k];
+		jobs[k].first = intervals.begin() + intervals.size() * k / jobs.size();
+		jobs[k].last = intervals.begin() + intervals.size() * (k + 1) / jobs.size();
+		jobs[k].failed = false;
+	}
+	run_tasks(run_gk_job, jobs);
+	for (std::size_t k = 0; k < jobs.size(); ++k)
+		if (jobs[k].failed)
+			return false;
+	return true;
+}
+
+/** Fewer intervals per round are refined by the calling thread alone. */
+const std::size_t min_parallel_intervals = 64;
+
+/** Number of intervals refined per round and thread. */
+const std::size_t intervals_per_thread = 32;
+
+unsigned integration_threads = 1;
+
+/** Integrate the first expression of the evaluators (one per thread) over
+ *  their first argument from a to b, with the values of the further
+ *  arguments from params.  Exceptions as for gauss_kronrod(). */
+double integrate_gauss_kronrod(std::vector<bytecode_evaluator> & evaluators, const double * params,
+                               double a, double b, double rel_error)
+{
+	if (a == b)
+		return 0;
+	std::vector<gk_integrand> integrands(evaluators.size());
+	for (std::size_t k = 0; k < integrands.size(); ++k) {
+		integrands[k].code = &evaluators[k];
+		integrands[k].args.resize(1);
+		if (params)
+			integrands[k].args.insert(integrands[k].args.end(), params, params + evaluators[k].arguments() - 1);
+	}
+
+	std::vector<gk_interval> batch(1);
+	batch[0].a = a;
+	batch[0].b = b;
+	batch[0].level = 0;
+	if (!apply_gauss_kronrod(integrands, 1, batch))
+		throw std::invalid_argument("gauss_kronrod(): integrand is not a finite real number");
+
+	std::priority_queue<gk_interval> intervals;
+	intervals.push(batch[0]);
+	double total = batch[0].integral, total_error = batch[0].error, total_magnitude = batch[0].magnitude;
+	const std::size_t batch_size = intervals_per_thread * integrands.size();
+
+	for (;;) {
+		const double tolerance = std::max(rel_error * std::fabs(total), 50 * DBL_EPSILON * total_magnitude);
+		if (total_error <= tolerance)
+			break;
+
+		// Halve the worst intervals, as many as are needed to get below the
+		// tolerance if their errors vanished
+		batch.clear();
+		double remaining_error = total_error;
+		while (!intervals.empty() && batch.size() < 2 * batch_size && remaining_error > tolerance) {
+			const gk_interval worst = intervals.top();
+			intervals.pop();
+			if (worst.level >= integral::max_integration_level)
+				throw std::runtime_error("max integration level reached");
+			remaining_error -= worst.error;
+			total -= worst.integral;
+			total_error -= worst.error;
+			total_magnitude -= worst.magnitude;
+			gk_interval left = worst, right = worst;
+			left.b = right.a = (worst.a + worst.b) / 2;
+			left.level = right.level = worst.level + 1;
+			batch.push_back(left);
+			batch.push_back(right);
+		}
+
+		const std::size_t nthreads = batch.size() >= min_parallel_intervals ? integrands.size() : 1;
+		if (!apply_gauss_kronrod(integrands, nthreads, batch))
+			throw std::invalid_argument("gauss_kronrod(): integrand is not a finite real number");
+
+		for (std::vector<gk_interval>::const_iterator i = batch.begin(); i != batch.end(); ++i) {
+			total += i->integral;
+			total_error += i->error;
+			total_magnitude += i->magnitude;
+			intervals.push(*i);
+		}
+	}
+
+	// Sum up again, without the rounding errors of the updates
+	total = 0;
+	for (; !intervals.empty(); intervals.pop())
+		total += intervals.top().integral;
+	return total;
+}
+
+} // anonymous namespace
+
+/** Set the number of threads gauss_kronrod() uses.  This has an effect only
+ *  if GiNaC was built with pthreads.
+ *
+ *  @return previous setting */
+unsigned set_integration_threads(unsigned n)
+{
+	const unsigned previous = integration_threads;
+	integration_threads = (n == 0 ? 1 : n);
+	return previous;
+}
+
+/** Get the number of threads used by gauss_kronrod(). */
+unsigned get_integration_threads()
+{
+	return integration_threads;
+}
+
+/** Numeric integration in double precision with the 7-point Gauss and
+ *  15-point Kronrod rules.  The integrand is compiled once with
+ *  bytecode_evaluator.  The intervals with the largest error estimates are
+ *  kept in a priority queue, and in every round a batch of them is halved.
+ *  The halves are evaluated by several threads if so requested with
+ *  set_integration_threads().  Parameters are the same as for
+ *  adaptivesimpson(); the integrand must be a real function of the
+ *  integration variable which the bytecode_evaluator supports, and the
+ *  error should not be much smaller than 1e-13.  The integrand is not
+ *  evaluated at the boundaries.
+ *
+ *  @exception invalid_argument (integrand can not be compiled or is not
+ *             finite and real somewhere)
+ *  @exception runtime_error (max integration level reached) */
+ex gauss_kronrod(const ex & x, const ex & a_in, const ex & b_in, const ex & f, const ex & error)
+{
+	const ex ea = a_in.evalf(), eb = b_in.evalf();
+	if (!is_exactly_a<numeric>(ea) || !ex_to<numeric>(ea).is_real()
+	 || !is_exactly_a<numeric>(eb) || !ex_to<numeric>(eb).is_real())
+		throw std::invalid_argument("gauss_kronrod(): boundaries must be real numbers");
+	if (!is_exactly_a<numeric>(error) || !ex_to<numeric>(error).is_real())
+		throw std::invalid_argument("gauss_kronrod(): error must be a real number");
+	const double a = ex_to<numeric>(ea).to_double(), b = ex_to<numeric>(eb).to_double();
+	const double rel_error = std::max(ex_to<numeric>(error).to_double(), 50 * DBL_EPSILON);
+	if (a == b)
+		return _ex0;
+
+	const lst integrand(f), variable(x);
+	std::vector<bytecode_evaluator> evaluators(integration_threads, bytecode_evaluator(integrand, variable));
+	return numeric(integrate_gauss_kronrod(evaluators, 0, a, b, rel_error));
+}
+
+//////////
+// class prepared_integral
+//////////
+
+prepared_integral::prepared_integral(const ex & x, const ex & a, const ex & b, const ex & f,
+                                     const lst & params_, const ex & error_)
+  : whole(integral(x, a, b, f)), params(params_), error(error_)
+{
+	if (!is_exactly_a<numeric>(error) || !ex_to<numeric>(error).is_real())
+		throw std::invalid_argument("prepared_integral: error must be a real number");
+	if (ex_to<numeric>(error) < numeric(integral::min_compiled_integration_error))
+		return;
+
+	// evalf() folds the numbers and constants of the expressions
+	lst args(x);
+	for (lst::const_iterator i = params.begin(); i != params.end(); ++i)
+		args.append(*i);
+	try {
+		const bytecode_evaluator integrand(lst(f.evalf()), args);
+		bounds.push_back(bytecode_evaluator(lst(a.evalf(), b.evalf()), params));
+		integrands.assign(integration_threads, integrand);
+	} catch (std::invalid_argument &) {
+		bounds.clear();
+	}
+}
+
+ex prepared_integral::evaluate(const lst & values)
+{
+	if (values.nops() != params.nops())
+		throw std::invalid_argument("prepared_integral::evaluate(): wrong number of values");
+
+	if (is_compiled()) {
+		std::vector<double> v;
+		v.reserve(values.nops());
+		for (lst::const_iterator i = values.begin(); i != values.end(); ++i) {
+			const ex e = i->evalf();
+			if (!is_exactly_a<numeric>(e) || !ex_to<numeric>(e).is_real())
+				break;
+			v.push_back(ex_to<numeric>(e).to_double());
+		}
+		if (v.size() == values.nops()) {
+			try {
+				return numeric(evaluate(v.empty() ? 0 : &v[0]));
+			} catch (std::invalid_argument &) {
+			} catch (std::runtime_error &) {
+			}
+		}
+	}
+
+	exmap m;
+	lst::const_iterator v = values.begin();
+	for (lst::const_iterator p = params.begin(); p != params.end(); ++p, ++v)
+		m[*p] = *v;
+	const ex e = whole.subs(m);
+	if (!is_a<integral>(e))
+		return e.evalf();
+	return adaptivesimpson(e.op(0), e.op(1), e.op(2), e.op(3), error);
+}
+
+double prepared_integral::evaluate(const double * values)
+{
+	if (!is_compiled())
+		throw std::invalid_argument("prepared_integral::evaluate(): integral could not be compiled");
+	double ab[2];
+	bounds[0].evaluate(values, ab);
+	if (ab[0] - ab[0] != 0 || ab[1] - ab[1] != 0)
+		throw std::invalid_argument("prepared_integral::evaluate(): boundaries are not finite");
+	if (integrands.size() != integration_threads) {
+		const bytecode_evaluator first = integrands[0];
+		integrands.assign(integration_threads, first);
+	}
+	return integrate_gauss_kronrod(integrands, values, ab[0], ab[1],
+	                               std::max(ex_to<numeric>(error).to_double(), 50 * DBL_EPSILON));
+}
+
 int integral::degree(const ex & s) const
 {
 	return ((b-a)*f).degree(s);
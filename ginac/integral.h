@@ -26,6 +26,10 @@
 #include "basic.h"
 #include "ex.h"
 #include "archive.h"
+#include "excompiler.h"
+#include "lst.h"
+
+#include <vector>
 
 namespace GiNaC {
 
@@ -73,6 +77,7 @@ protected:
 public:
 	static int max_integration_level;
 	static ex relative_integration_error;
+	static const double min_compiled_integration_error;
 private:
 	ex x;
 	ex a;
@@ -91,6 +96,61 @@ GiNaC::ex adaptivesimpson(
 	const GiNaC::ex &error = integral::relative_integration_error
 );
 
+GiNaC::ex gauss_kronrod(
+	const GiNaC::ex &x,
+	const GiNaC::ex &a,
+	const GiNaC::ex &b,
+	const GiNaC::ex &f,
+	const GiNaC::ex &error = integral::relative_integration_error
+);
+
+/** An integral depending on parameters, prepared for being evaluated
+ *  numerically at many values of them.  The integrand and the boundaries
+ *  are evalf()ed and compiled only once, and then integrated with the rules
+ *  of gauss_kronrod() for each set of values.  If the integral can not be
+ *  compiled, or the integrand is not real for some values, the values are
+ *  substituted into the integral for adaptivesimpson() instead.  Evaluation
+ *  changes the state of the object, so threads need copies of their own. */
+class prepared_integral
+{
+public:
+	/**
+	 * @param x Integration variable
+	 * @param a Left boundary, may depend on the parameters
+	 * @param b Right boundary, may depend on the parameters
+	 * @param f Integrand
+	 * @param params Symbols in f, a and b whose values are passed to evaluate()
+	 * @param error Relative integration error
+	 */
+	prepared_integral(const ex & x, const ex & a, const ex & b, const ex & f, const lst & params,
+	                  const ex & error = integral::relative_integration_error);
+
+	/** Value of the integral for the given values of the parameters. */
+	ex evaluate(const lst & values);
+
+	/**
+	 * Value of the integral in double precision, reading the value of the
+	 * k-th parameter from values[k].
+	 * @exception invalid_argument (not compiled, or integrand not real)
+	 */
+	double evaluate(const double * values);
+
+	/** Whether the integral could be compiled. */
+	bool is_compiled() const { return !integrands.empty(); }
+
+private:
+	ex whole;      ///< the integral, for evaluation without compiling
+	lst params;
+	ex error;
+	std::vector<bytecode_evaluator> integrands;  ///< of x and the parameters, one per thread
+	std::vector<bytecode_evaluator> bounds;      ///< boundaries from the parameters
+};
+
+// Number of threads gauss_kronrod() uses for the intervals it refines
+// at the same time (default 1), returns previous setting
+extern unsigned set_integration_threads(unsigned n);
+extern unsigned get_integration_threads();
+
 } // namespace GiNaC
 
 #endif // ndef GINAC_INTEGRAL_H
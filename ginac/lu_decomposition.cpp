@@ -0,0 +1,288 @@
+/** @file lu_decomposition.cpp
+ *
+ *  Implementation of the LU decomposition of square matrices */
+
+/*
+ *  GiNaC Copyright (C) 1999-2014 Johannes Gutenberg University Mainz, Germany
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#include "lu_decomposition.h"
+#include "matrix.h"
+#include "numeric.h"
+#include "operators.h"
+#include "normal.h"
+#include "utils.h"
+
+#include <algorithm>
+#include <stdexcept>
+
+namespace GiNaC {
+
+namespace {
+
+/** Normalize a new entry the way matrix::gauss_elimination() does. */
+inline void normalize_entry(ex & e)
+{
+	if (!e.info(info_flags::numeric))
+		e = e.normal();
+}
+
+} // anonymous namespace
+
+
+/** Decompose a nonsingular square matrix.  Matrices of numbers containing
+ *  floating point numbers are pivoted by the largest absolute value in the
+ *  column, all others by the first nonzero element.
+ *
+ *  @exception logic_error (matrix not square)
+ *  @exception runtime_error (singular matrix) */
+lu_decomposition::lu_decomposition(const matrix & m) : n(m.rows()), lu(n*n), perm(n), sign(1), fraction_free(false)
+{
+	if (m.cols() != n)
+		throw (std::logic_error("lu_decomposition::lu_decomposition(): matrix not square"));
+
+	bool float_flag = false;
+	for (unsigned r=0; r<n; ++r) {
+		perm[r] = r;
+		for (unsigned c=0; c<n; ++c) {
+			lu[r*n+c] = m(r,c);
+			if (!is_exactly_a<numeric>(m(r,c)))
+				fraction_free = true;
+			else if (!ex_to<numeric>(m(r,c)).is_crational())
+				float_flag = true;
+		}
+	}
+	if (fraction_free)
+		eliminate_fraction_free();
+	else
+		eliminate_numeric(float_flag);
+}
+
+
+/** Solve the linear system A*X == rhs for X by forward and back
+ *  substitution.
+ *
+ *  @param rhs n x p matrix
+ *  @return n x p solution matrix
+ *  @exception logic_error (incompatible matrices) */
+matrix lu_decomposition::solve(const matrix & rhs) const
+{
+	if (rhs.rows() != n)
+		throw (std::logic_error("lu_decomposition::solve(): incompatible matrices"));
+
+	const unsigned p = rhs.cols();
+	matrix sol(n, p);
+	exvector x(n);
+	for (unsigned co=0; co<p; ++co) {
+		for (unsigned r=0; r<n; ++r)
+			x[r] = rhs(perm[r], co);
+		if (fraction_free)
+			substitute_fraction_free(x);
+		else
+			substitute_numeric(x);
+		for (unsigned r=0; r<n; ++r)
+			sol(r, co) = x[r];
+	}
+	return sol;
+}
+
+
+/** Determinant of the decomposed matrix. */
+ex lu_decomposition::determinant() const
+{
+	if (n == 0)
+		return _ex1;
+	if (fraction_free) {
+		// the last pivot of Bareiss' elimination is the determinant
+		ex scales = _ex1;
+		for (unsigned r=0; r<n; ++r)
+			scales *= scale[r];
+		return (sign*lu[n*n-1]/scales).normal().subs(srl, subs_options::no_pattern).normal();
+	}
+	ex det = sign;
+	for (unsigned k=0; k<n; ++k)
+		det *= lu[k*n+k];
+	return det;
+}
+
+
+/** Gauss elimination of a matrix of numbers, keeping the multipliers below
+ *  the diagonal. */
+void lu_decomposition::eliminate_numeric(bool float_flag)
+{
+	for (unsigned k=0; k<n; ++k) {
+		unsigned p = k;
+		if (float_flag) {
+			numeric max = abs(ex_to<numeric>(lu[k*n+k]));
+			for (unsigned r=k+1; r<n; ++r) {
+				const numeric t = abs(ex_to<numeric>(lu[r*n+k]));
+				if (t > max) {
+					max = t;
+					p = r;
+				}
+			}
+		} else {
+			while (p<n && lu[p*n+k].is_zero())
+				++p;
+		}
+		if (p==n || lu[p*n+k].is_zero())
+			throw (std::runtime_error("lu_decomposition::lu_decomposition(): singular matrix"));
+		swap_rows(k, p);
+		const numeric & piv = ex_to<numeric>(lu[k*n+k]);
+		for (unsigned r=k+1; r<n; ++r) {
+			if (lu[r*n+k].is_zero())
+				continue;
+			const numeric f = ex_to<numeric>(lu[r*n+k]).div(piv);
+			for (unsigned c=k+1; c<n; ++c)
+				lu[r*n+c] = ex_to<numeric>(lu[r*n+c]).sub(f.mul(ex_to<numeric>(lu[k*n+c])));
+			lu[r*n+k] = f;
+		}
+	}
+}
+
+
+/** Bareiss' fraction free elimination of a matrix multiplied by the common
+ *  denominators of its rows, keeping the entries below the diagonal as they
+ *  were when their column was eliminated.  Like in matrix::fraction_free_elimination() the
+ *  entries are polynomials in the symbols of srl, which stand for all
+ *  non-polynomial subexpressions. */
+void lu_decomposition::eliminate_fraction_free()
+{
+	scale.resize(n);
+	exvector den(n);
+	for (unsigned r=0; r<n; ++r) {
+		ex l = _ex1;
+		for (unsigned c=0; c<n; ++c) {
+			const ex nd = lu[r*n+c].normal().to_rational(srl).numer_denom();
+			lu[r*n+c] = nd.op(0);
+			den[c] = nd.op(1);
+			l = lcm(l, den[c]);
+		}
+		for (unsigned c=0; c<n; ++c) {
+			ex q;
+			divide(l, den[c], q);
+			lu[r*n+c] = (lu[r*n+c]*q).expand();
+		}
+		scale[r] = l;
+	}
+
+	ex divisor = _ex1;
+	for (unsigned k=0; k<n; ++k) {
+		unsigned p = k;
+		while (p<n && lu[p*n+k].subs(srl, subs_options::no_pattern).expand().is_zero())
+			++p;
+		if (p==n)
+			throw (std::runtime_error("lu_decomposition::lu_decomposition(): singular matrix"));
+		swap_rows(k, p);
+		for (unsigned r=k+1; r<n; ++r) {
+			for (unsigned c=k+1; c<n; ++c) {
+				const ex dividend = (lu[k*n+k]*lu[r*n+c] - lu[r*n+k]*lu[k*n+c]).expand();
+				bool check = divide(dividend, divisor, lu[r*n+c]);
+				GINAC_ASSERT(check);
+			}
+		}
+		divisor = lu[k*n+k];
+	}
+}
+
+
+/** Interchange the rows k and p, if they differ. */
+void lu_decomposition::swap_rows(unsigned k, unsigned p)
+{
+	if (p == k)
+		return;
+	for (unsigned c=0; c<n; ++c)
+		lu[p*n+c].swap(lu[k*n+c]);
+	std::swap(perm[p], perm[k]);
+	if (fraction_free)
+		scale[p].swap(scale[k]);
+	sign = -sign;
+}
+
+
+/** Replace the permuted right hand side x by the solution, for a matrix of
+ *  numbers. */
+void lu_decomposition::substitute_numeric(exvector & x) const
+{
+	// L*y == P*rhs
+	for (unsigned r=0; r<n; ++r) {
+		ex e = x[r];
+		for (unsigned c=0; c<r; ++c)
+			if (!lu[r*n+c].is_zero())
+				e -= lu[r*n+c] * x[c];
+		normalize_entry(e);
+		x[r] = e;
+	}
+	// U*x == y
+	for (unsigned r=n; r-- != 0; ) {
+		ex e = x[r];
+		for (unsigned c=r+1; c<n; ++c)
+			if (!lu[r*n+c].is_zero())
+				e -= lu[r*n+c] * x[c];
+		e /= lu[r*n+r];
+		normalize_entry(e);
+		x[r] = e;
+	}
+}
+
+
+/** Replace the permuted right hand side x by the solution, for a fraction
+ *  free decomposition.  The right hand side is scaled to polynomials and
+ *  eliminated like a further column of the matrix.  Then the back
+ *  substitution computes the solution times the determinant d of the scaled
+ *  matrix, which is polynomial by Cramer's rule. */
+void lu_decomposition::substitute_fraction_free(exvector & x) const
+{
+	exmap repl = srl;
+	exvector den(n);
+	ex l = _ex1;
+	for (unsigned r=0; r<n; ++r) {
+		const ex nd = x[r].normal().to_rational(repl).numer_denom();
+		x[r] = nd.op(0)*scale[r];
+		den[r] = nd.op(1);
+		l = lcm(l, den[r]);
+	}
+	for (unsigned r=0; r<n; ++r) {
+		ex q;
+		divide(l, den[r], q);
+		x[r] = (x[r]*q).expand();
+	}
+
+	ex divisor = _ex1;
+	for (unsigned k=0; k+1<n; ++k) {
+		for (unsigned r=k+1; r<n; ++r) {
+			const ex dividend = (lu[k*n+k]*x[r] - lu[r*n+k]*x[k]).expand();
+			bool check = divide(dividend, divisor, x[r]);
+			GINAC_ASSERT(check);
+		}
+		divisor = lu[k*n+k];
+	}
+
+	const ex & d = lu[n*n-1];
+	for (unsigned r=n; r-- != 0; ) {
+		ex e = d*x[r];
+		for (unsigned c=r+1; c<n; ++c)
+			e -= lu[r*n+c]*x[c];
+		bool check = divide(e.expand(), lu[r*n+r], x[r]);
+		GINAC_ASSERT(check);
+	}
+	const ex dl = d*l;
+	for (unsigned r=0; r<n; ++r)
+		x[r] = (x[r]/dl).normal().subs(repl, subs_options::no_pattern);
+}
+
+} // namespace GiNaC
@@ -0,0 +1,72 @@
+/** @file lu_decomposition.h
+ *
+ *  Interface to the LU decomposition of square matrices. */
+
+/*
+ *  GiNaC Copyright (C) 1999-2014 Johannes Gutenberg University Mainz, Germany
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#ifndef GINAC_LU_DECOMPOSITION_H
+#define GINAC_LU_DECOMPOSITION_H
+
+#include "ex.h"
+
+#include <vector>
+
+namespace GiNaC {
+
+class matrix;
+
+/** The decomposition of a nonsingular square matrix A by Gauss elimination,
+ *  computed once to solve linear systems with the coefficient matrix A for
+ *  any number of right hand sides by forward and back substitution only.
+ *
+ *  Matrices of numbers are decomposed as P*A == L*U, with a permutation P, a
+ *  unit lower triangular L and an upper triangular U.  All other matrices
+ *  have their rows multiplied by the common denominators of their entries
+ *  first and are decomposed by Bareiss' fraction free elimination, which
+ *  keeps the multipliers of the rows and the factor U polynomial.  Then the
+ *  substitutions get along with exact polynomial divisions, too. */
+class lu_decomposition
+{
+public:
+	explicit lu_decomposition(const matrix & m);
+
+	unsigned rows() const        /// Get number of rows (and columns).
+		{ return n; }
+	matrix solve(const matrix & rhs) const;
+	ex determinant() const;
+
+private:
+	void eliminate_numeric(bool float_flag);
+	void eliminate_fraction_free();
+	void swap_rows(unsigned k, unsigned p);
+	void substitute_numeric(exvector & x) const;
+	void substitute_fraction_free(exvector & x) const;
+
+	unsigned n;                  ///< number of rows and columns
+	exvector lu;                 ///< multipliers below and U on and above the diagonal, rows first
+	std::vector<unsigned> perm;  ///< row perm[i] of A became row i
+	int sign;                    ///< sign of the permutation
+	bool fraction_free;          ///< decomposed by fraction free elimination
+	exvector scale;              ///< factor of row i, if fraction free
+	exmap srl;                   ///< symbol replacement list, if fraction free
+};
+
+} // namespace GiNaC
+
+#endif // ndef GINAC_LU_DECOMPOSITION_H
@@ -21,24 +21,41 @@
  */
 
 #include "matrix.h"
+#include "sparse_matrix.h"
+#include "lu_decomposition.h"
 #include "numeric.h"
 #include "lst.h"
 #include "idx.h"
 #include "indexed.h"
 #include "add.h"
+#include "mul.h"
 #include "power.h"
 #include "symbol.h"
 #include "operators.h"
 #include "normal.h"
 #include "archive.h"
 #include "utils.h"
+#include "budget.h"
+#include "profile.h"
+#include "tasks.h"
+#include "polynomial/modular_det.h"
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
 
 #include <algorithm>
+#include <cln/complex.h>
 #include <iostream>
 #include <map>
 #include <sstream>
 #include <stdexcept>
 #include <string>
+#if defined(GINAC_THREADSAFE_REFCOUNT) && defined(HAVE_PTHREAD_H)
+// Parts of matrix products are only computed concurrently if expressions
+// may be shared between threads at all.
+#define PARALLEL_MATRIX 1
+#endif
 
 namespace GiNaC {
 
@@ -587,26 +604,456 @@ matrix matrix::sub(const matrix & other) const
 }
 
 
-/** Product of matrices.
+static unsigned matrix_threads = 1;
+
+/** Set the number of threads the matrix operations use for independent
+ *  parts of their results.  This has an effect only if GiNaC was built with
+ *  GINAC_THREADSAFE_REFCOUNT and pthreads.
+ *
+ *  @return previous setting */
+unsigned set_matrix_threads(unsigned n)
+{
+	const unsigned previous = matrix_threads;
+	matrix_threads = (n == 0 ? 1 : n);
+	return previous;
+}
+
+/** Get the number of threads used by the matrix operations. */
+unsigned get_matrix_threads()
+{
+	return matrix_threads;
+}
+
+static unsigned pivot_strategy_setting = pivot_strategy::first_nonzero;
+
+/** Set the strategy of the elimination schemes for choosing pivots among
+ *  symbolic elements.
+ *
+ *  @return previous setting
+ *  @see pivot_strategy */
+unsigned set_pivot_strategy(unsigned s)
+{
+	const unsigned previous = pivot_strategy_setting;
+	pivot_strategy_setting = s;
+	return previous;
+}
+
+/** Get the strategy of the elimination schemes for choosing pivots. */
+unsigned get_pivot_strategy()
+{
+	return pivot_strategy_setting;
+}
+
+static bool record_elimination = false;
+static elimination_statistics last_elimination;
+
+/** Switch the recording of the sizes of intermediate expressions in the
+ *  elimination schemes on or off.
+ *
+ *  @return previous setting */
+bool set_elimination_statistics(bool record)
+{
+	const bool previous = record_elimination;
+	record_elimination = record;
+	return previous;
+}
+
+/** Get the sizes of the intermediate expressions of the last elimination
+ *  run while recording was switched on. */
+elimination_statistics get_elimination_statistics()
+{
+	return last_elimination;
+}
+
+namespace {
+
+/** Number of terms of an expanded or normalized element, counting those of
+ *  numerator and denominator. */
+std::size_t term_count(const ex & e)
+{
+	if (is_exactly_a<GiNaC::add>(e))
+		return e.nops();
+	if (is_exactly_a<GiNaC::mul>(e)) {
+		std::size_t n = 0;
+		for (size_t i=0; i<e.nops(); ++i)
+			n += term_count(e.op(i));
+		return n;
+	}
+	if (is_exactly_a<power>(e))
+		return term_count(e.op(0));
+	return 1;
+}
+
+/** Start recording the sizes of a new elimination. */
+void start_elimination_statistics()
+{
+	if (record_elimination) {
+		last_elimination.terms.clear();
+		last_elimination.nonzeros.clear();
+	}
+}
+
+/** Record the sizes of the rows r0+1 and below of the rows x cols matrix of
+ *  numerators n and, unless null, denominators d after a step. */
+void record_elimination_step(const exvector & n, const exvector * d,
+                             unsigned rows, unsigned cols, unsigned r0)
+{
+	if (!record_elimination)
+		return;
+	std::size_t terms = 0, nonzeros = 0;
+	for (unsigned i=(r0+1)*cols; i<rows*cols; ++i) {
+		if (n[i].is_zero())
+			continue;
+		++nonzeros;
+		terms += term_count(n[i]);
+		if (d && !(*d)[i].is_equal(_ex1))
+			terms += term_count((*d)[i]);
+	}
+	last_elimination.terms.push_back(terms);
+	last_elimination.nonzeros.push_back(nonzeros);
+}
+
+/** Cost of the pivot in row r and column c0 of the rows x cols matrix m
+ *  under the current pivot strategy.  The pivot can be chosen among the
+ *  rows r0 and below. */
+std::pair<std::size_t, std::size_t> pivot_cost(const exvector & m, unsigned rows, unsigned cols,
+                                               unsigned r0, unsigned r, unsigned c0)
+{
+	std::size_t count = 0;
+	if (pivot_strategy_setting == pivot_strategy::markowitz) {
+		for (unsigned c=c0+1; c<cols; ++c)
+			if (!m[r*cols+c].is_zero())
+				++count;
+	} else if (pivot_strategy_setting == pivot_strategy::min_fill) {
+		for (unsigned r2=r0; r2<rows; ++r2) {
+			if (r2 == r || m[r2*cols+c0].is_zero())
+				continue;
+			for (unsigned c=c0+1; c<cols; ++c)
+				if (!m[r*cols+c].is_zero() && m[r2*cols+c].is_zero())
+					++count;
+		}
+	}
+	return std::make_pair(count, term_count(m[r*cols+c0]));
+}
+
+/** Choose the pivot in column c0 of the rows x cols matrix m among the rows
+ *  r0 and below whose element relevant() accepts as nonzero, according to
+ *  the pivot strategy.
+ *  @return the row of the pivot, or rows if there is none */
+template <class NonzeroTest>
+unsigned choose_pivot(const exvector & m, unsigned rows, unsigned cols,
+                      unsigned r0, unsigned c0, NonzeroTest nonzero)
+{
+	unsigned best = rows;
+	std::pair<std::size_t, std::size_t> best_cost;
+	for (unsigned r=r0; r<rows; ++r) {
+		if (m[r*cols+c0].is_zero() || !nonzero(m[r*cols+c0]))
+			continue;
+		if (pivot_strategy_setting == pivot_strategy::first_nonzero)
+			return r;
+		const std::pair<std::size_t, std::size_t> cost = pivot_cost(m, rows, cols, r0, r, c0);
+		if (best == rows || cost < best_cost) {
+			best = r;
+			best_cost = cost;
+		}
+	}
+	return best;
+}
+
+/** An element is nonzero if it doesn't vanish when expanded. */
+struct expanded_nonzero {
+	bool operator()(const ex & e) const { return !e.expand().is_zero(); }
+};
+
+/** An element of a matrix with some subexpressions replaced by symbols is
+ *  nonzero if it doesn't vanish when they are substituted back. */
+struct substituted_nonzero {
+	explicit substituted_nonzero(const exmap & s) : srl(s) { }
+	bool operator()(const ex & e) const
+	{
+		return !e.subs(srl, subs_options::no_pattern).expand().is_zero();
+	}
+	const exmap & srl;
+};
+
+} // anonymous namespace
+
+namespace {
+
+/** Matrices with no side longer than this have closed-form determinants
+ *  and inverses, and are multiplied without the setup of the blocks. */
+const unsigned small_matrix_max = 4;
+
+/** Minor of the N x N submatrix with the given rows and columns of the
+ *  n x n matrix a, by Laplace expansion along its first row, which the
+ *  compiler unrolls for the small N.  Vanishing entries are skipped. */
+template <unsigned N>
+struct closed_minor {
+	static ex compute(const exvector & a, unsigned n, const unsigned * rows, const unsigned * cols)
+	{
+		exvector terms;
+		terms.reserve(N);
+		unsigned sub[N - 1];
+		for (unsigned j = 0; j < N; ++j) {
+			const ex & e = a[rows[0]*n + cols[j]];
+			if (e.is_zero())
+				continue;
+			for (unsigned k = 0, l = 0; k < N; ++k)
+				if (k != j)
+					sub[l++] = cols[k];
+			const ex minor = closed_minor<N - 1>::compute(a, n, rows + 1, sub);
+			terms.push_back(j % 2 ? -e * minor : e * minor);
+		}
+		return (new add(terms))->setflag(status_flags::dynallocated);
+	}
+};
+
+template <>
+struct closed_minor<1> {
+	static ex compute(const exvector & a, unsigned n, const unsigned * rows, const unsigned * cols)
+	{
+		return a[rows[0]*n + cols[0]];
+	}
+};
+
+/** Minor of size k of the n x n matrix a, for k <= small_matrix_max. */
+ex small_minor(const exvector & a, unsigned n, unsigned k, const unsigned * rows, const unsigned * cols)
+{
+	switch (k) {
+	case 1:
+		return closed_minor<1>::compute(a, n, rows, cols);
+	case 2:
+		return closed_minor<2>::compute(a, n, rows, cols);
+	case 3:
+		return closed_minor<3>::compute(a, n, rows, cols);
+	case 4:
+		return closed_minor<4>::compute(a, n, rows, cols);
+	}
+	throw std::logic_error("small_minor(): matrix too large");
+}
+
+/** Unexpanded determinant of the n x n matrix a, n <= small_matrix_max. */
+ex small_determinant(const exvector & a, unsigned n)
+{
+	static const unsigned all[small_matrix_max] = { 0, 1, 2, 3 };
+	return small_minor(a, n, n, all, all);
+}
+
+/** Unexpanded cofactor of row i and column j of the n x n matrix a, with
+ *  2 <= n <= small_matrix_max. */
+ex small_cofactor(const exvector & a, unsigned n, unsigned i, unsigned j)
+{
+	unsigned rows[small_matrix_max - 1], cols[small_matrix_max - 1];
+	for (unsigned k = 0, l = 0; k < n; ++k)
+		if (k != i)
+			rows[l++] = k;
+	for (unsigned k = 0, l = 0; k < n; ++k)
+		if (k != j)
+			cols[l++] = k;
+	const ex minor = small_minor(a, n, n - 1, rows, cols);
+	return (i + j) % 2 ? -minor : minor;
+}
+
+/** Product of the r x n matrix a and the n x c matrix b, all sides at most
+ *  small_matrix_max, entry by entry. */
+void multiply_small(const exvector & a, const exvector & b, unsigned r, unsigned n, unsigned c,
+                    exvector & prod)
+{
+	prod.resize(r * c);
+	exvector terms;
+	terms.reserve(n);
+	for (unsigned i = 0; i < r; ++i) {
+		for (unsigned j = 0; j < c; ++j) {
+			terms.clear();
+			for (unsigned k = 0; k < n; ++k)
+				if (!a[i*n+k].is_zero() && !b[k*c+j].is_zero())
+					terms.push_back(a[i*n+k] * b[k*c+j]);
+			prod[i*c+j] = (new add(terms))->setflag(status_flags::dynallocated);
+		}
+	}
+}
+
+/** Edge length of the blocks of the product computed together.  The terms
+ *  of a block's entries are collected while running once over the
+ *  corresponding rows of the factors. */
+const unsigned mul_block = 16;
+
+/** Factor of the products of entries.  Sums are split into their integer
+ *  content and primitive part once, as mul::eval() would split them in
+ *  every product.  That is most of the work for multiplying two sums. */
+struct mul_factor {
+	ex e, prim;
+	numeric content;
+	bool split;
+	explicit mul_factor(const ex & x);
+};
+
+mul_factor::mul_factor(const ex & x) : e(x), prim(x), content(*_num1_p), split(false)
+{
+	if (!is_exactly_a<add>(x) || x.return_type() != return_types::commutative)
+		return;
+	strip_content(ex_to<add>(x), content, prim);
+	split = true;
+}
+
+/** Product of two entries.  The product of two different primitive sums
+ *  is a canonical mul, it needs no evaluation. */
+ex multiply(const mul_factor & x, const mul_factor & y)
+{
+	if (x.split && y.split && !x.prim.is_equal(y.prim)) {
+		epvector v;
+		v.reserve(2);
+		v.push_back(expair(x.prim, _ex1));
+		v.push_back(expair(y.prim, _ex1));
+		return (new mul(v, x.content.mul(y.content)))->setflag(status_flags::dynallocated |
+		                                                        status_flags::evaluated);
+	}
+	return x.e * y.e;
+}
+
+/** Rows first to last-1 of the product of the r x n matrix a and the n x c
+ *  matrix b, stored in prod. */
+struct mul_job {
+	exvector a, b;
+	unsigned first, last, n, c;
+	exvector prod;
+	bool failed;
+};
+
+void multiply_rows(mul_job & job)
+{
+	const unsigned n = job.n, c = job.c;
+	job.prod.resize((job.last - job.first) * c);
+	std::vector<mul_factor> a, b;
+	a.reserve(job.a.size());
+	for (exvector::const_iterator i = job.a.begin(); i != job.a.end(); ++i)
+		a.push_back(mul_factor(*i));
+	b.reserve(job.b.size());
+	for (exvector::const_iterator i = job.b.begin(); i != job.b.end(); ++i)
+		b.push_back(mul_factor(*i));
+	std::vector<exvector> terms(mul_block * mul_block);
+	for (unsigned r0=job.first; r0<job.last; r0+=mul_block) {
+		const unsigned r1 = std::min(r0+mul_block, job.last);
+		for (unsigned c0=0; c0<c; c0+=mul_block) {
+			const unsigned c1 = std::min(c0+mul_block, c);
+			for (unsigned k=0; k<n; ++k) {
+				for (unsigned r=r0; r<r1; ++r) {
+					const mul_factor & x = a[r*n+k];
+					// Quick test: can we shortcut?
+					if (x.e.is_zero())
+						continue;
+					for (unsigned co=c0; co<c1; ++co) {
+						const mul_factor & y = b[k*c+co];
+						if (!y.e.is_zero())
+							terms[(r-r0)*mul_block+(co-c0)].push_back(multiply(x, y));
+					}
+				}
+			}
+			// Every entry is canonicalized once, as a single sum
+			for (unsigned r=r0; r<r1; ++r) {
+				for (unsigned co=c0; co<c1; ++co) {
+					exvector & t = terms[(r-r0)*mul_block+(co-c0)];
+					job.prod[(r-job.first)*c+co] = (new add(t))->setflag(status_flags::dynallocated);
+					t.clear();
+				}
+			}
+		}
+	}
+}
+
+#ifdef PARALLEL_MATRIX
+
+/** Products with fewer multiplications of entries are computed by the
+ *  calling thread alone. */
+const std::size_t min_parallel_mul = 1 << 12;
+
+void * run_mul_job(void * arg)
+{
+	mul_job & job = *static_cast<mul_job *>(arg);
+	try {
+		multiply_rows(job);
+	} catch (...) {
+		job.failed = true;
+	}
+	return 0;
+}
+
+/** Distribute slices of rows of the product to tasks.  The first slice is
+ *  done by the calling thread.
+ *  @return false if the product has to be computed by one thread instead */
+bool multiply_parallel(std::vector<mul_job> & jobs)
+{
+	// All but the first thread work on copies without shared numbers
+	for (std::size_t k = 1; k < jobs.size(); ++k) {
+		for (exvector::iterator i = jobs[k].a.begin(); i != jobs[k].a.end(); ++i)
+			if (!copy_numbers(*i, *i))
+				return false;
+		for (exvector::iterator i = jobs[k].b.begin(); i != jobs[k].b.end(); ++i)
+			if (!copy_numbers(*i, *i))
+				return false;
+	}
+	run_tasks(run_mul_job, jobs);
+	for (std::size_t k = 0; k < jobs.size(); ++k)
+		if (jobs[k].failed)
+			return false;
+	return true;
+}
+
+#endif // def PARALLEL_MATRIX
+
+} // anonymous namespace
+
+/** Product of matrices.  The product is computed in blocks, the row slices
+ *  of which may be distributed to several threads (see set_matrix_threads()).
+ *  Products of matrices up to 4 x 4 are computed entry by entry.
  *
  *  @exception logic_error (incompatible matrices) */
 matrix matrix::mul(const matrix & other) const
 {
 	if (this->cols() != other.rows())
 		throw std::logic_error("matrix::mul(): incompatible matrices");
+
+	if (row <= small_matrix_max && col <= small_matrix_max && other.col <= small_matrix_max) {
+		exvector prod;
+		multiply_small(m, other.m, row, col, other.col, prod);
+		return matrix(row, other.col, prod);
+	}
 	
-	exvector prod(this->rows()*other.cols());
-	
-	for (unsigned r1=0; r1<this->rows(); ++r1) {
-		for (unsigned c=0; c<this->cols(); ++c) {
-			// Quick test: can we shortcut?
-			if (m[r1*col+c].is_zero())
-				continue;
-			for (unsigned r2=0; r2<other.cols(); ++r2)
-				prod[r1*other.col+r2] += (m[r1*col+c] * other.m[c*other.col+r2]);
+	mul_job whole;
+	whole.first = 0;
+	whole.last = row;
+	whole.n = col;
+	whole.c = other.col;
+	whole.failed = false;
+
+#ifdef PARALLEL_MATRIX
+	const std::size_t work = std::size_t(row) * col * other.col;
+	const unsigned nthreads = std::min(matrix_threads, row);
+	if (nthreads > 1 && work >= min_parallel_mul) {
+		std::vector<mul_job> jobs(nthreads, whole);
+		for (unsigned k=0; k<nthreads; ++k) {
+			mul_job & job = jobs[k];
+			job.first = row * k / nthreads;
+			job.last = row * (k + 1) / nthreads;
+			job.a.assign(m.begin() + job.first*col, m.begin() + job.last*col);
+			job.b = other.m;
+			job.last -= job.first;
+			job.first = 0;
+		}
+		if (multiply_parallel(jobs)) {
+			exvector prod;
+			prod.reserve(row * other.col);
+			for (unsigned k=0; k<nthreads; ++k)
+				prod.insert(prod.end(), jobs[k].prod.begin(), jobs[k].prod.end());
+			return matrix(row, other.col, prod);
 		}
 	}
-	return matrix(row, other.col, prod);
+#endif
+
+	whole.a = m;
+	whole.b = other.m;
+	multiply_rows(whole);
+	return matrix(row, other.col, whole.prod);
 }
 
 
@@ -724,6 +1171,103 @@ matrix matrix::transpose() const
 	return matrix(this->cols(),this->rows(),trans);
 }
 
+/** Check if all elements are numbers and some of them are floating point
+ *  numbers.  Such matrices are eliminated on an array of CLN numbers with
+ *  partial pivoting instead of exact arithmetic on expressions. */
+static bool is_float_matrix(const exvector & m)
+{
+	bool inexact = false;
+	for (exvector::const_iterator i = m.begin(); i != m.end(); ++i) {
+		if (!is_exactly_a<numeric>(*i))
+			return false;
+		if (!ex_to<numeric>(*i).is_crational())
+			inexact = true;
+	}
+	return inexact;
+}
+
+/** The elements of a matrix of numbers as CLN numbers. */
+static std::vector<cln::cl_N> to_cl_N_vector(const exvector & m)
+{
+	std::vector<cln::cl_N> a;
+	a.reserve(m.size());
+	for (exvector::const_iterator i = m.begin(); i != m.end(); ++i)
+		a.push_back(ex_to<numeric>(*i).to_cl_N());
+	return a;
+}
+
+/** Gauss elimination with partial pivoting of the r x c matrix a of numbers
+ *  into upper echelon form, choosing pivots in the first n columns only.
+ *
+ *  @param sign is negated for each interchange of rows
+ *  @return the number of pivots found */
+static unsigned float_elimination(std::vector<cln::cl_N> & a, unsigned r, unsigned c,
+                                  unsigned n, int & sign)
+{
+	unsigned rank = 0;
+	for (unsigned k = 0; k < n && rank < r; ++k) {
+		unsigned pivot = rank;
+		cln::cl_R max = cln::abs(a[rank*c + k]);
+		for (unsigned i = rank + 1; i < r; ++i) {
+			const cln::cl_R t = cln::abs(a[i*c + k]);
+			if (t > max) {
+				max = t;
+				pivot = i;
+			}
+		}
+		if (cln::zerop(max))
+			continue;
+		if (pivot != rank) {
+			std::swap_ranges(a.begin() + rank*c + k, a.begin() + rank*c + c,
+			                 a.begin() + pivot*c + k);
+			sign = -sign;
+		}
+		for (unsigned i = rank + 1; i < r; ++i) {
+			if (cln::zerop(a[i*c + k]))
+				continue;
+			const cln::cl_N f = a[i*c + k] / a[rank*c + k];
+			a[i*c + k] = 0;
+			for (unsigned j = k + 1; j < c; ++j)
+				a[i*c + j] = a[i*c + j] - f*a[rank*c + j];
+		}
+		++rank;
+	}
+	return rank;
+}
+
+/** Dense grids of evaluation points larger than this make the automatic
+ *  choice of determinant() prefer elimination or minor expansion to the
+ *  modular algorithm. */
+static const double modular_determinant_max_grid = 65536;
+
+/** Number of points of the dense grid on which the modular algorithm would
+ *  evaluate the determinant of the polynomial n x n matrix m: the product
+ *  over its symbols of one plus the sum over the rows of the highest degree
+ *  in the row, which bounds the degree of the determinant. */
+static double determinant_grid_size(const exvector & m, unsigned n)
+{
+	exset syms;
+	for (exvector::const_iterator i = m.begin(); i != m.end(); ++i)
+		for (const_preorder_iterator j = i->preorder_begin(); j != i->preorder_end(); ++j)
+			if (is_a<symbol>(*j))
+				syms.insert(*j);
+
+	double grid = 1;
+	for (exset::const_iterator s = syms.begin(); s != syms.end(); ++s) {
+		unsigned deg = 0;
+		for (unsigned r = 0; r < n; ++r) {
+			int row_deg = 0;
+			for (unsigned c = 0; c < n; ++c)
+				row_deg = std::max(row_deg, m[r*n + c].degree(*s));
+			deg += row_deg;
+		}
+		grid *= deg + 1;
+		if (grid > modular_determinant_max_grid)
+			break;
+	}
+	return grid;
+}
+
 /** Determinant of square matrix.  This routine doesn't actually calculate the
  *  determinant, it only implements some heuristics about which algorithm to
  *  run.  If all the elements of the matrix are elements of an integral domain
@@ -739,19 +1283,49 @@ matrix matrix::transpose() const
  *  @exception logic_error (matrix not square)
  *  @see       determinant_algo */
 ex matrix::determinant(unsigned algo) const
+{
+	if (row!=col)
+		throw (std::logic_error("matrix::determinant(): matrix not square"));
+
+	matrix tmp(*this);
+	return tmp.determinant_in_place(algo);
+}
+
+
+/** Determinant of square matrix, like determinant(), but the elimination
+ *  schemes work on this matrix itself instead of a copy and release the
+ *  entries they no longer need.  This matrix is left with unspecified
+ *  entries.
+ *
+ *  @param     algo allows to chose an algorithm
+ *  @return    the determinant as a new expression
+ *  @exception logic_error (matrix not square)
+ *  @see       determinant_algo */
+ex matrix::determinant_in_place(unsigned algo)
 {
 	if (row!=col)
 		throw (std::logic_error("matrix::determinant(): matrix not square"));
 	GINAC_ASSERT(row*col==m.capacity());
+	ensure_if_modifiable();
 	
 	// Gather some statistical information about this matrix:
 	bool numeric_flag = true;
+	bool rational_flag = true;
 	bool normal_flag = false;
 	unsigned sparse_count = 0;  // counts non-zero elements
 	exvector::const_iterator r = m.begin(), rend = m.end();
 	while (r != rend) {
 		if (!r->info(info_flags::numeric))
 			numeric_flag = false;
+		if (!r->info(info_flags::rational))
+			rational_flag = false;
+		if (r->info(info_flags::crational_polynomial)) {
+			// to_rational() wouldn't change anything that matters here
+			if (!r->is_zero())
+				++sparse_count;
+			++r;
+			continue;
+		}
 		exmap srl;  // symbol replacement list
 		ex rtest = r->to_rational(srl);
 		if (!rtest.is_zero())
@@ -763,17 +1337,29 @@ ex matrix::determinant(unsigned algo) const
 	}
 	
 	// Here is the heuristics in case this routine has to decide:
+	// Minor expansion is generally a good guess:
+	unsigned fallback = determinant_algo::laplace;
+	// Does anybody know when a matrix is really sparse?
+	// Maybe <~row/2.236 nonzero elements average in a row?
+	if (row>3 && 5*sparse_count<=row*col)
+		fallback = determinant_algo::bareiss;
+	// Purely numeric matrix can be handled by Gauss elimination.
+	// This overrides any prior decisions.
+	if (numeric_flag)
+		fallback = determinant_algo::gauss;
 	if (algo == determinant_algo::automatic) {
-		// Minor expansion is generally a good guess:
-		algo = determinant_algo::laplace;
-		// Does anybody know when a matrix is really sparse?
-		// Maybe <~row/2.236 nonzero elements average in a row?
-		if (row>3 && 5*sparse_count<=row*col)
-			algo = determinant_algo::bareiss;
-		// Purely numeric matrix can be handled by Gauss elimination.
-		// This overrides any prior decisions.
-		if (numeric_flag)
-			algo = determinant_algo::gauss;
+		algo = fallback;
+		// Larger polynomial matrices are best done modulo primes, if
+		// their entries turn out to be polynomials in symbols and the
+		// number of symbols and their degrees don't make the grid of
+		// evaluation points too large, as for sparse matrices in many
+		// symbols.  So are rational ones, avoiding the growth of the
+		// intermediate numbers.
+		if (row>3 && rational_flag)
+			algo = determinant_algo::modular;
+		else if (row>3 && !numeric_flag && !normal_flag &&
+		         determinant_grid_size(m, row) <= modular_determinant_max_grid)
+			algo = determinant_algo::modular;
 	}
 	
 	// Trap the trivial case here, since some algorithms don't like it
@@ -785,39 +1371,64 @@ ex matrix::determinant(unsigned algo) const
 			return m[0].expand();
 	}
 
+	// Small matrices have a closed form, which is faster than any of the
+	// algorithms with their setup
+	if (algo == determinant_algo::automatic && row <= small_matrix_max) {
+		const ex det = small_determinant(m, row);
+		if (normal_flag)
+			return det.normal();
+		else
+			return det.expand();
+	}
+
+	if (algo == determinant_algo::modular) {
+		ex det;
+		if (modular_determinant(det, m, row))
+			return det;
+		algo = fallback;
+	}
+
 	// Compute the determinant
 	switch(algo) {
 		case determinant_algo::gauss: {
+			if (is_float_matrix(m)) {
+				std::vector<cln::cl_N> a = to_cl_N_vector(m);
+				std::fill(m.begin(), m.end(), _ex0);
+				int sign = 1;
+				if (float_elimination(a, row, col, col, sign) < row)
+					return _ex0;
+				cln::cl_N det = sign;
+				for (unsigned d=0; d<row; ++d)
+					det = det * a[d*col+d];
+				return numeric(det);
+			}
 			ex det = 1;
-			matrix tmp(*this);
-			int sign = tmp.gauss_elimination(true);
+			int sign = gauss_elimination(true);
 			for (unsigned d=0; d<row; ++d)
-				det *= tmp.m[d*col+d];
+				det *= m[d*col+d];
 			if (normal_flag)
 				return (sign*det).normal();
 			else
 				return (sign*det).normal().expand();
 		}
 		case determinant_algo::bareiss: {
-			matrix tmp(*this);
 			int sign;
-			sign = tmp.fraction_free_elimination(true);
+			sign = fraction_free_elimination(true);
 			if (normal_flag)
-				return (sign*tmp.m[row*col-1]).normal();
+				return (sign*m[row*col-1]).normal();
 			else
-				return (sign*tmp.m[row*col-1]).expand();
+				return (sign*m[row*col-1]).expand();
 		}
 		case determinant_algo::divfree: {
-			matrix tmp(*this);
 			int sign;
-			sign = tmp.division_free_elimination(true);
+			sign = division_free_elimination(true);
 			if (sign==0)
 				return _ex0;
-			ex det = tmp.m[row*col-1];
+			ex det = m[row*col-1];
 			// factor out accumulated bogus slag
 			for (unsigned d=0; d<row-2; ++d)
 				for (unsigned j=0; j<row-d-2; ++j)
-					det = (det/tmp.m[d*col+d]).normal();
+					det = (det/m[d*col+d]).normal();
 			return (sign*det);
 		}
 		case determinant_algo::laplace:
@@ -852,13 +1463,14 @@ ex matrix::determinant(unsigned algo) const
 				 i!=pre_sort.end();
 				 ++i,++c) {
 				for (unsigned r=0; r<row; ++r)
-					result[r*col+c] = m[r*col+(*i)];
+					result[r*col+c].swap(m[r*col+(*i)]);
 			}
+			m.swap(result);
 			
 			if (normal_flag)
-				return (sign*matrix(row,col,result).determinant_minor()).normal();
+				return (sign*determinant_minor()).normal();
 			else
-				return sign*matrix(row,col,result).determinant_minor();
+				return sign*determinant_minor();
 		}
 	}
 }
@@ -887,6 +1499,143 @@ ex matrix::trace() const
 }
 
 
+namespace {
+
+/** The vector (1, -a_kk, -R*C, -R*A*C, ..., -R*A^(k-1)*C) of Berkowitz'
+ *  algorithm for the leading (k+1) x (k+1) submatrix of the n x n matrix m
+ *  (row by row), where A is its leading k x k submatrix, R is the part of
+ *  row k left of the diagonal and C the part of column k above it. */
+exvector berkowitz_vector(const exvector & m, unsigned n, unsigned k)
+{
+	exvector t(k+2);
+	t[0] = _ex1;
+	t[1] = -m[k*n+k];
+	exvector w(k), v(k), terms;
+	for (unsigned i=0; i<k; ++i)
+		w[i] = m[i*n+k];
+	for (unsigned i=0; i<k; ++i) {
+		terms.clear();
+		for (unsigned j=0; j<k; ++j)
+			if (!m[k*n+j].is_zero() && !w[j].is_zero())
+				terms.push_back(m[k*n+j] * w[j]);
+		t[i+2] = (-(new add(terms))->setflag(status_flags::dynallocated)).expand();
+		if (i+1 == k)
+			break;
+		// w = A*w
+		for (unsigned r=0; r<k; ++r) {
+			terms.clear();
+			for (unsigned c=0; c<k; ++c)
+				if (!m[r*n+c].is_zero() && !w[c].is_zero())
+					terms.push_back(m[r*n+c] * w[c]);
+			v[r] = ((new add(terms))->setflag(status_flags::dynallocated)).expand();
+		}
+		w.swap(v);
+	}
+	return t;
+}
+
+/** The vectors of Berkowitz' algorithm for the leading submatrices of sizes
+ *  k+1 with k = first, first+step, ... < n. */
+struct berkowitz_job {
+	exvector m;
+	unsigned n, first, step;
+	std::vector<exvector> t;
+	bool failed;
+};
+
+void berkowitz_vectors(berkowitz_job & job)
+{
+	for (unsigned k=job.first; k<job.n; k+=job.step)
+		job.t[k] = berkowitz_vector(job.m, job.n, k);
+}
+
+#ifdef PARALLEL_MATRIX
+
+void * run_berkowitz_job(void * arg)
+{
+	berkowitz_job & job = *static_cast<berkowitz_job *>(arg);
+	try {
+		berkowitz_vectors(job);
+	} catch (...) {
+		job.failed = true;
+	}
+	return 0;
+}
+
+/** Compute the vectors in several threads, interleaving the sizes of the
+ *  submatrices since the work grows with them.
+ *  @return false if they have to be computed by one thread instead */
+bool berkowitz_parallel(std::vector<berkowitz_job> & jobs)
+{
+	for (std::size_t k = 1; k < jobs.size(); ++k)
+		for (exvector::iterator i = jobs[k].m.begin(); i != jobs[k].m.end(); ++i)
+			if (!copy_numbers(*i, *i))
+				return false;
+	run_tasks(run_berkowitz_job, jobs);
+	for (std::size_t k = 0; k < jobs.size(); ++k)
+		if (jobs[k].failed)
+			return false;
+	return true;
+}
+
+#endif // def PARALLEL_MATRIX
+
+} // anonymous namespace
+
+/** Coefficients of det(lambda*1 - M) in Berkowitz' division free algorithm,
+ *  starting with the one of lambda^n.  The vectors for the leading
+ *  submatrices are independent, they may be computed by several threads
+ *  (see set_matrix_threads()).  They are then multiplied as lower
+ *  triangular Toeplitz matrices.
+ *
+ *  @see matrix::charpoly() */
+exvector matrix::charpoly_berkowitz() const
+{
+	berkowitz_job whole;
+	whole.m = m;
+	whole.n = row;
+	whole.first = 0;
+	whole.step = 1;
+	whole.t.resize(row);
+	whole.failed = false;
+	std::vector<exvector> t;
+
+#ifdef PARALLEL_MATRIX
+	const unsigned nthreads = std::min(matrix_threads, row);
+	if (nthreads > 1) {
+		std::vector<berkowitz_job> jobs(nthreads, whole);
+		for (unsigned k=0; k<nthreads; ++k) {
+			jobs[k].first = k;
+			jobs[k].step = nthreads;
+		}
+		if (berkowitz_parallel(jobs)) {
+			t.resize(row);
+			for (unsigned k=0; k<row; ++k)
+				t[k] = jobs[k % nthreads].t[k];
+		}
+	}
+#endif
+	if (t.empty()) {
+		berkowitz_vectors(whole);
+		t.swap(whole.t);
+	}
+
+	exvector c(1, _ex1), next, terms;
+	for (unsigned k=0; k<row; ++k) {
+		next.resize(k+2);
+		for (unsigned i=0; i<=k+1; ++i) {
+			terms.clear();
+			for (unsigned j=0; j<=std::min(i,k); ++j)
+				if (!t[k][i-j].is_zero() && !c[j].is_zero())
+					terms.push_back(t[k][i-j] * c[j]);
+			next[i] = ((new GiNaC::add(terms))->setflag(status_flags::dynallocated)).expand();
+		}
+		c.swap(next);
+	}
+	return c;
+}
+
+
 /** Characteristic Polynomial.  Following mathematica notation the
  *  characteristic polynomial of a matrix M is defined as the determiant of
  *  (M - lambda * 1) where 1 stands for the unit matrix of the same dimension
@@ -931,14 +1680,36 @@ ex matrix::charpoly(const ex & lambda) const
 		else
 			return poly;
 
-	} else {
-	
-		matrix M(*this);
-		for (unsigned r=0; r<col; ++r)
-			M.m[r*col+r] -= lambda;
-	
+	}
+
+	matrix M(*this);
+	for (unsigned r=0; r<col; ++r)
+		M.m[r*col+r] -= lambda;
+
+	// Polynomial matrices are best done modulo primes, as determinants,
+	// and rational functions by normalizing minors.  Where minor expansion
+	// of expanded polynomials (in functions, say) would be needed instead,
+	// Berkowitz' algorithm avoids dragging lambda through the computation.
+	if (!lambda.info(info_flags::symbol) || has(lambda))
 		return M.determinant().collect(lambda);
+	ex det;
+	if (row>3 && modular_determinant(det, M.m, row))
+		return det.collect(lambda);
+	for (r=m.begin(); r!=rend; ++r) {
+		exmap srl;  // symbol replacement list
+		ex rtest = r->to_rational(srl);
+		if (!rtest.info(info_flags::crational_polynomial) &&
+			 rtest.info(info_flags::rational_function))
+			return M.determinant().collect(lambda);
 	}
+
+	exvector c = charpoly_berkowitz();
+	exvector terms;
+	for (unsigned i=0; i<=row; ++i) {
+		if (!c[i].is_zero())
+			terms.push_back((row%2 ? -c[i] : c[i]) * power(lambda, row-i));
+	}
+	return (new GiNaC::add(terms))->setflag(status_flags::dynallocated);
 }
 
 
@@ -951,6 +1722,34 @@ matrix matrix::inverse() const
 {
 	if (row != col)
 		throw (std::logic_error("matrix::inverse(): matrix not square"));
+
+	matrix tmp(*this);
+	return tmp.inverse_in_place();
+}
+
+
+/** Inverse of this matrix, like inverse(), but eliminating this matrix
+ *  itself instead of a copy.  This matrix is left with unspecified entries.
+ *
+ *  @return    the inverted matrix
+ *  @exception logic_error (matrix not square)
+ *  @exception runtime_error (singular matrix) */
+matrix matrix::inverse_in_place()
+{
+	if (row != col)
+		throw (std::logic_error("matrix::inverse(): matrix not square"));
+
+	// Small matrices are inverted by the adjugate
+	if (row >= 2 && row <= small_matrix_max) {
+		const ex det = small_determinant(m, row).normal();
+		if (det.is_zero())
+			throw (std::runtime_error("matrix::inverse(): singular matrix"));
+		matrix inv(row, col);
+		for (unsigned r=0; r<row; ++r)
+			for (unsigned c=0; c<col; ++c)
+				inv.m[c*col+r] = (small_cofactor(m, row, r, c) / det).normal();
+		return inv;
+	}
 	
 	// This routine actually doesn't do anything fancy at all.  We compute the
 	// inverse of the matrix A by solving the system A * A^{-1} == Id.
@@ -970,7 +1769,7 @@ matrix matrix::inverse() const
 	
 	matrix sol(row,col);
 	try {
-		sol = this->solve(vars,identity);
+		sol = solve_in_place(vars,identity);
 	} catch (const std::runtime_error & e) {
 	    if (e.what()==std::string("matrix::solve(): inconsistent linear system"))
 			throw (std::runtime_error("matrix::inverse(): singular matrix"));
@@ -995,6 +1794,29 @@ matrix matrix::inverse() const
 matrix matrix::solve(const matrix & vars,
                      const matrix & rhs,
                      unsigned algo) const
+{
+	matrix tmp(*this), tmp_rhs(rhs);
+	return tmp.solve_in_place(vars, tmp_rhs, algo);
+}
+
+
+/** Solve a linear system like solve(), but moving the entries of this matrix
+ *  and of rhs into the augmented matrix instead of copying them.  Each row
+ *  of the eliminated augmented matrix is released as soon as its part of
+ *  the solution has been assembled.  This matrix and rhs are left with
+ *  unspecified entries.
+ *
+ *  @param vars n x p matrix, all elements must be symbols 
+ *  @param rhs m x p matrix
+ *  @param algo selects the solving algorithm
+ *  @return n x p solution matrix
+ *  @exception logic_error (incompatible matrices)
+ *  @exception invalid_argument (1st argument must be matrix of symbols)
+ *  @exception runtime_error (inconsistent linear system)
+ *  @see       solve_algo */
+matrix matrix::solve_in_place(const matrix & vars,
+                              matrix & rhs,
+                              unsigned algo)
 {
 	const unsigned m = this->rows();
 	const unsigned n = this->cols();
@@ -1007,14 +1829,19 @@ matrix matrix::solve(const matrix & vars,
 		for (unsigned co=0; co<p; ++co)
 			if (!vars(ro,co).info(info_flags::symbol))
 				throw (std::invalid_argument("matrix::solve(): 1st argument must be matrix of symbols"));
+
+	if (algo == solve_algo::sparse)
+		return sparse_matrix(*this).solve(vars, rhs);
 	
 	// build the augmented matrix of *this with rhs attached to the right
+	ensure_if_modifiable();
+	rhs.ensure_if_modifiable();
 	matrix aug(m,n+p);
 	for (unsigned r=0; r<m; ++r) {
 		for (unsigned c=0; c<n; ++c)
-			aug.m[r*(n+p)+c] = this->m[r*n+c];
+			aug.m[r*(n+p)+c].swap(this->m[r*n+c]);
 		for (unsigned c=0; c<p; ++c)
-			aug.m[r*(n+p)+c+n] = rhs.m[r*p+c];
+			aug.m[r*(n+p)+c+n].swap(rhs.m[r*p+c]);
 	}
 	
 	// Gather some statistical information about the augmented matrix:
@@ -1026,6 +1853,31 @@ matrix matrix::solve(const matrix & vars,
 		++r;
 	}
 	
+	// Nonsingular square systems of numbers have a unique solution, which
+	// we get without expression arithmetic, modulo primes if the
+	// coefficients are rational and else by partial pivoting.
+	if (algo == solve_algo::automatic && numeric_flag && m == n) {
+		exvector x;
+		if (modular_solve(x, aug.m, n, p))
+			return matrix(n, p, x);
+		if (is_float_matrix(aug.m)) {
+			std::vector<cln::cl_N> a = to_cl_N_vector(aug.m);
+			int sign = 1;
+			if (float_elimination(a, n, n+p, n, sign) == n) {
+				matrix sol(n,p);
+				for (unsigned co=0; co<p; ++co) {
+					for (unsigned ro=n; ro-- != 0; ) {
+						cln::cl_N e = a[ro*(n+p)+n+co];
+						for (unsigned c=ro+1; c<n; ++c)
+							e = e - a[ro*(n+p)+c] * ex_to<numeric>(sol.m[c*p+co]).to_cl_N();
+						sol.m[ro*p+co] = numeric(e / a[ro*(n+p)+ro]);
+					}
+				}
+				return sol;
+			}
+		}
+	}
+	
 	// Here is the heuristics in case this routine has to decide:
 	if (algo == solve_algo::automatic) {
 		// Bareiss (fraction-free) elimination is generally a good guess:
@@ -1052,14 +1904,15 @@ matrix matrix::solve(const matrix & vars,
 			aug.fraction_free_elimination();
 	}
 	
-	// assemble the solution matrix:
+	// assemble the solution matrix, from the last row upwards, releasing
+	// every row of aug when done with it
 	matrix sol(n,p);
-	for (unsigned co=0; co<p; ++co) {
-		unsigned last_assigned_sol = n+1;
-		for (int r=m-1; r>=0; --r) {
-			unsigned fnz = 1;    // first non-zero in row
-			while ((fnz<=n) && (aug.m[r*(n+p)+(fnz-1)].is_zero()))
-				++fnz;
+	unsigned last_assigned_sol = n+1;
+	for (int r=m-1; r>=0; --r) {
+		unsigned fnz = 1;    // first non-zero in row
+		while ((fnz<=n) && (aug.m[r*(n+p)+(fnz-1)].is_zero()))
+			++fnz;
+		for (unsigned co=0; co<p; ++co) {
 			if (fnz>n) {
 				// row consists only of zeros, corresponding rhs must be 0, too
 				if (!aug.m[r*(n+p)+n+co].is_zero()) {
@@ -1074,14 +1927,17 @@ matrix matrix::solve(const matrix & vars,
 				for (unsigned c=fnz; c<n; ++c)
 					e -= aug.m[r*(n+p)+c]*sol.m[c*p+co];
 				sol(fnz-1,co) = (e/(aug.m[r*(n+p)+(fnz-1)])).normal();
-				last_assigned_sol = fnz;
 			}
 		}
-		// assign solutions for vars between 1 and
-		// last_assigned_sol-1: free parameters
+		if (fnz<=n)
+			last_assigned_sol = fnz;
+		std::fill(aug.m.begin() + r*(n+p), aug.m.begin() + (r+1)*(n+p), _ex0);
+	}
+	// assign solutions for vars between 1 and
+	// last_assigned_sol-1: free parameters
+	for (unsigned co=0; co<p; ++co)
 		for (unsigned ro=0; ro<last_assigned_sol-1; ++ro)
 			sol(ro,co) = vars(ro,co);
-	}
 	
 	return sol;
 }
@@ -1096,12 +1952,22 @@ unsigned matrix::rank() const
 
 	GINAC_ASSERT(row*col==m.capacity());
 
+	// Matrices of numbers are eliminated without expression arithmetic.
+	unsigned r;
+	if (modular_rank(r, m, row, col))
+		return r;
+	if (is_float_matrix(m)) {
+		std::vector<cln::cl_N> a = to_cl_N_vector(m);
+		int sign = 1;
+		return float_elimination(a, row, col, col, sign);
+	}
+
 	// Actually, any elimination scheme will do since we are only
 	// interested in the echelon matrix' zeros.
 	matrix to_eliminate = *this;
 	to_eliminate.fraction_free_elimination();
 
-	unsigned r = row*col;  // index of last non-zero element
+	r = row*col;  // index of last non-zero element
 	while (r--) {
 		if (!to_eliminate.m[r].is_zero())
 			return 1+r/col;
@@ -1110,6 +1976,18 @@ unsigned matrix::rank() const
 }
 
 
+/** LU decomposition of this matrix, for solving linear systems with it as
+ *  coefficient matrix for many right hand sides.
+ *
+ *  @exception logic_error (matrix not square)
+ *  @exception runtime_error (singular matrix)
+ *  @see       lu_decomposition */
+lu_decomposition matrix::lu_decompose() const
+{
+	return lu_decomposition(*this);
+}
+
+
 // protected
 
 /** Recursive determinant for small matrices having at least one symbolic
@@ -1249,9 +2127,13 @@ int matrix::gauss_elimination(const bool det)
 	const unsigned n = this->cols();
 	GINAC_ASSERT(!det || n==m);
 	int sign = 1;
+	start_elimination_statistics();
+	trace_scope trace("gauss_elimination", "rows", m, "columns", n);
 	
 	unsigned r0 = 0;
 	for (unsigned c0=0; c0<n && r0<m-1; ++c0) {
+		trace_scope step("elimination step", "column", c0);
+		check_budget();
 		int indx = pivot(r0, c0, true);
 		if (indx == -1) {
 			sign = 0;
@@ -1275,6 +2157,7 @@ int matrix::gauss_elimination(const bool det)
 				for (unsigned c=r0; c<=c0; ++c)
 					this->m[r2*n+c] = _ex0;
 			}
+			record_elimination_step(this->m, 0, m, n, r0);
 			if (det) {
 				// save space by deleting no longer needed elements
 				for (unsigned c=r0+1; c<n; ++c)
@@ -1308,9 +2191,13 @@ int matrix::division_free_elimination(const bool det)
 	const unsigned n = this->cols();
 	GINAC_ASSERT(!det || n==m);
 	int sign = 1;
+	start_elimination_statistics();
+	trace_scope trace("division_free_elimination", "rows", m, "columns", n);
 	
 	unsigned r0 = 0;
 	for (unsigned c0=0; c0<n && r0<m-1; ++c0) {
+		trace_scope step("elimination step", "column", c0);
+		check_budget();
 		int indx = pivot(r0, c0, true);
 		if (indx==-1) {
 			sign = 0;
@@ -1327,6 +2214,7 @@ int matrix::division_free_elimination(const bool det)
 				for (unsigned c=r0; c<=c0; ++c)
 					this->m[r2*n+c] = _ex0;
 			}
+			record_elimination_step(this->m, 0, m, n, r0);
 			if (det) {
 				// save space by deleting no longer needed elements
 				for (unsigned c=r0+1; c<n; ++c)
@@ -1345,6 +2233,132 @@ int matrix::division_free_elimination(const bool det)
 }
 
 
+namespace {
+
+/** One step of fraction free elimination for the rows first to last-1 of
+ *  the matrix with the numerators n and denominators d of its entries.  The
+ *  rows are read from the pivot column on, width entries each, and so is
+ *  the pivot row: in the matrix itself, stride entries apart, or, for a
+ *  job run by another thread, in copies of them.  The new entries of the
+ *  rows are stored in new_n and new_d, without the pivot column. */
+struct elimination_job {
+	const ex * pivot_n, * pivot_d, * rows_n, * rows_d;
+	unsigned stride;
+	exvector copies;  ///< pivot row and rows, if they are copied
+	ex divisor_n, divisor_d;
+	unsigned first, last, width;
+	exvector new_n, new_d;
+	bool failed;
+};
+
+void eliminate_rows(elimination_job & job)
+{
+	const unsigned w = job.width;
+	const unsigned rows = job.last - job.first;
+	job.new_n.resize(rows*(w-1));
+	job.new_d.resize(rows*(w-1));
+	const ex * pn = job.pivot_n, * pd = job.pivot_d;
+	for (unsigned r=0; r<rows; ++r) {
+		const ex * rn = job.rows_n + r*job.stride, * rd = job.rows_d + r*job.stride;
+		for (unsigned c=1; c<w; ++c) {
+			const ex dividend_n = (pn[0]*rn[c]*rd[0]*pd[c]
+			                      -rn[0]*pn[c]*pd[0]*rd[c]).expand();
+			const ex dividend_d = (rd[0]*pd[c]*pd[0]*rd[c]).expand();
+			bool check = divide(dividend_n, job.divisor_n,
+			                    job.new_n[r*(w-1)+c-1], true);
+			check &= divide(dividend_d, job.divisor_d,
+			                job.new_d[r*(w-1)+c-1], true);
+			GINAC_ASSERT(check);
+		}
+	}
+}
+
+#ifdef PARALLEL_MATRIX
+
+/** Steps of the elimination updating fewer entries are done by the calling
+ *  thread alone. */
+const unsigned min_parallel_elimination = 64;
+
+void * run_elimination_job(void * arg)
+{
+	elimination_job & job = *static_cast<elimination_job *>(arg);
+	try {
+		eliminate_rows(job);
+	} catch (...) {
+		job.failed = true;
+	}
+	return 0;
+}
+
+/** Distribute slices of the rows to tasks, each working on copies of its
+ *  rows and the pivot row.  The first slice is done by the calling thread.
+ *  @return false if the step has to be done by one thread instead */
+bool eliminate_parallel(std::vector<elimination_job> & jobs)
+{
+	for (std::size_t k = 1; k < jobs.size(); ++k) {
+		elimination_job & job = jobs[k];
+		exvector & c = job.copies;
+		for (exvector::iterator j = c.begin(); j != c.end(); ++j)
+			if (!copy_numbers(*j, *j))
+				return false;
+		// The copies don't move any more
+		const unsigned w = job.width, rows = job.last - job.first;
+		job.pivot_n = &c[0];
+		job.pivot_d = &c[w];
+		job.rows_n = &c[2*w];
+		job.rows_d = &c[2*w + rows*w];
+		job.stride = w;
+		if (!copy_numbers(job.divisor_n, job.divisor_n) ||
+		    !copy_numbers(job.divisor_d, job.divisor_d))
+			return false;
+	}
+	run_tasks(run_elimination_job, jobs);
+	for (std::size_t k = 0; k < jobs.size(); ++k)
+		if (jobs[k].failed)
+			return false;
+	return true;
+}
+
+#endif // def PARALLEL_MATRIX
+
+/** Set up the job for rows first to last-1 of the step with pivot (r0, c0).
+ *  The job reads the matrix itself, unless copy is set, which is needed
+ *  for jobs run by other threads.  Their copies of the pivot row and the
+ *  rows (numerators, then denominators) are made here and attached by
+ *  eliminate_parallel(). */
+elimination_job make_elimination_job(const exvector & tmp_n, const exvector & tmp_d,
+                                     unsigned n, unsigned r0, unsigned c0,
+                                     unsigned first, unsigned last,
+                                     const ex & divisor_n, const ex & divisor_d,
+                                     bool copy = false)
+{
+	elimination_job job;
+	job.width = n - c0;
+	job.first = first;
+	job.last = last;
+	job.pivot_n = &tmp_n[r0*n + c0];
+	job.pivot_d = &tmp_d[r0*n + c0];
+	job.rows_n = &tmp_n[first*n + c0];
+	job.rows_d = &tmp_d[first*n + c0];
+	job.stride = n;
+	if (copy) {
+		exvector & c = job.copies;
+		c.reserve((2 + 2*(last - first)) * job.width);
+		c.insert(c.end(), tmp_n.begin() + r0*n + c0, tmp_n.begin() + r0*n + n);
+		c.insert(c.end(), tmp_d.begin() + r0*n + c0, tmp_d.begin() + r0*n + n);
+		for (unsigned r=first; r<last; ++r)
+			c.insert(c.end(), tmp_n.begin() + r*n + c0, tmp_n.begin() + r*n + n);
+		for (unsigned r=first; r<last; ++r)
+			c.insert(c.end(), tmp_d.begin() + r*n + c0, tmp_d.begin() + r*n + n);
+	}
+	job.divisor_n = divisor_n;
+	job.divisor_d = divisor_d;
+	job.failed = false;
+	return job;
+}
+
+} // anonymous namespace
+
 /** Perform the steps of Bareiss' one-step fraction free elimination to bring
  *  the matrix into an upper echelon form.  Fraction free elimination means
  *  that divide is used straightforwardly, without computing GCDs first.  This
@@ -1386,12 +2400,12 @@ int matrix::fraction_free_elimination(const bool det)
 	const unsigned n = this->cols();
 	GINAC_ASSERT(!det || n==m);
 	int sign = 1;
+	start_elimination_statistics();
+	trace_scope trace("fraction_free_elimination", "rows", m, "columns", n);
 	if (m==1)
 		return 1;
 	ex divisor_n = 1;
 	ex divisor_d = 1;
-	ex dividend_n;
-	ex dividend_d;
 	
 	// We populate temporary matrices to subsequently operate on.  There is
 	// one holding numerators and another holding denominators of entries.
@@ -1399,29 +2413,28 @@ int matrix::fraction_free_elimination(const bool det)
 	// might cancel some trivial element which causes divide() to fail.  The
 	// elements are normalized first (yes, even though this algorithm doesn't
 	// need GCDs) since the elements of *this might be unnormalized, which
-	// makes things more complicated than they need to be.
-	matrix tmp_n(*this);
+	// makes things more complicated than they need to be.  The elements of
+	// *this are released on the way, they are only replaced in the end.
+	matrix tmp_n(m,n);
 	matrix tmp_d(m,n);  // for denominators, if needed
 	exmap srl;  // symbol replacement list
-	exvector::const_iterator cit = this->m.begin(), citend = this->m.end();
+	exvector::iterator cit = this->m.begin(), citend = this->m.end();
 	exvector::iterator tmp_n_it = tmp_n.m.begin(), tmp_d_it = tmp_d.m.begin();
 	while (cit != citend) {
 		ex nd = cit->normal().to_rational(srl).numer_denom();
-		++cit;
+		*cit++ = _ex0;
 		*tmp_n_it++ = nd.op(0);
 		*tmp_d_it++ = nd.op(1);
 	}
 	
 	unsigned r0 = 0;
 	for (unsigned c0=0; c0<n && r0<m-1; ++c0) {
+		trace_scope step("elimination step", "column", c0);
+		check_budget();
 		// When trying to find a pivot, we should try a bit harder than expand().
-		// Searching the first non-zero element in-place here instead of calling
-		// pivot() allows us to do no more substitutions and back-substitutions
+		// Choosing the pivot here instead of calling pivot() allows us to do no more substitutions and back-substitutions
 		// than are actually necessary.
-		unsigned indx = r0;
-		while ((indx<m) &&
-		       (tmp_n[indx*n+c0].subs(srl, subs_options::no_pattern).expand().is_zero()))
-			++indx;
+		unsigned indx = choose_pivot(tmp_n.m, m, n, r0, c0, substituted_nonzero(srl));
 		if (indx==m) {
 			// all elements in column c0 below row r0 vanish
 			sign = 0;
@@ -1436,24 +2449,40 @@ int matrix::fraction_free_elimination(const bool det)
 					tmp_d.m[n*indx+c].swap(tmp_d.m[n*r0+c]);
 				}
 			}
-			for (unsigned r2=r0+1; r2<m; ++r2) {
-				for (unsigned c=c0+1; c<n; ++c) {
-					dividend_n = (tmp_n.m[r0*n+c0]*tmp_n.m[r2*n+c]*
-					              tmp_d.m[r2*n+c0]*tmp_d.m[r0*n+c]
-					             -tmp_n.m[r2*n+c0]*tmp_n.m[r0*n+c]*
-					              tmp_d.m[r0*n+c0]*tmp_d.m[r2*n+c]).expand();
-					dividend_d = (tmp_d.m[r2*n+c0]*tmp_d.m[r0*n+c]*
-					              tmp_d.m[r0*n+c0]*tmp_d.m[r2*n+c]).expand();
-					bool check = divide(dividend_n, divisor_n,
-					                    tmp_n.m[r2*n+c], true);
-					check &= divide(dividend_d, divisor_d,
-					                tmp_d.m[r2*n+c], true);
-					GINAC_ASSERT(check);
+			// The rows below the pivot are updated independently, by
+			// several threads if so requested (see set_matrix_threads()).
+			std::vector<elimination_job> jobs;
+#ifdef PARALLEL_MATRIX
+			const unsigned below = m - r0 - 1;
+			const unsigned threads = std::min(matrix_threads, below);
+			if (threads > 1 && below*(n-c0-1) >= min_parallel_elimination) {
+				for (unsigned k=0; k<threads; ++k)
+					jobs.push_back(make_elimination_job(tmp_n.m, tmp_d.m, n, r0, c0,
+					                                    r0+1 + below*k/threads,
+					                                    r0+1 + below*(k+1)/threads,
+					                                    divisor_n, divisor_d, k > 0));
+				if (!eliminate_parallel(jobs))
+					jobs.clear();
+			}
+#endif
+			if (jobs.empty()) {
+				jobs.push_back(make_elimination_job(tmp_n.m, tmp_d.m, n, r0, c0, r0+1, m,
+				                                    divisor_n, divisor_d));
+				eliminate_rows(jobs[0]);
+			}
+			for (std::vector<elimination_job>::iterator j=jobs.begin(); j!=jobs.end(); ++j) {
+				const unsigned w = j->width - 1;
+				for (unsigned r2=j->first; r2<j->last; ++r2) {
+					for (unsigned c=c0+1; c<n; ++c) {
+						tmp_n.m[r2*n+c].swap(j->new_n[(r2-j->first)*w+c-c0-1]);
+						tmp_d.m[r2*n+c].swap(j->new_d[(r2-j->first)*w+c-c0-1]);
+					}
+					// fill up left hand side with zeros
+					for (unsigned c=r0; c<=c0; ++c)
+						tmp_n.m[r2*n+c] = _ex0;
 				}
-				// fill up left hand side with zeros
-				for (unsigned c=r0; c<=c0; ++c)
-					tmp_n.m[r2*n+c] = _ex0;
 			}
+			record_elimination_step(tmp_n.m, &tmp_d.m, m, n, r0);
 			if (c0<n && r0<m-1) {
 				// compute next iteration's divisor
 				divisor_n = tmp_n.m[r0*n+c0].expand();
@@ -1479,8 +2508,11 @@ int matrix::fraction_free_elimination(const bool det)
 	exvector::iterator it = this->m.begin(), itend = this->m.end();
 	tmp_n_it = tmp_n.m.begin();
 	tmp_d_it = tmp_d.m.begin();
-	while (it != itend)
-		*it++ = ((*tmp_n_it++)/(*tmp_d_it++)).subs(srl, subs_options::no_pattern);
+	while (it != itend) {
+		*it++ = ((*tmp_n_it)/(*tmp_d_it)).subs(srl, subs_options::no_pattern);
+		*tmp_n_it++ = _ex0;
+		*tmp_d_it++ = _ex0;
+	}
 	
 	return sign;
 }
@@ -1490,7 +2522,8 @@ int matrix::fraction_free_elimination(const bool det)
  *  Usual pivoting (symbolic==false) returns the index to the element with the
  *  largest absolute value in column ro and swaps the current row with the one
  *  where the element was found.  With (symbolic==true) it does the same thing
- *  with the first non-zero element.
+ *  with the first non-zero element, or with the one preferred by the pivot
+ *  strategy (see set_pivot_strategy()).
  *
  *  @param ro is the row from where to begin
  *  @param co is the column to be inspected
@@ -1503,9 +2536,9 @@ int matrix::pivot(unsigned ro, unsigned co, bool symbolic)
 {
 	unsigned k = ro;
 	if (symbolic) {
-		// search first non-zero element in column co beginning at row ro
-		while ((k<row) && (this->m[k*col+co].expand().is_zero()))
-			++k;
+		// search a non-zero element in column co beginning at row ro, the
+		// first one unless another pivot strategy is set
+		k = choose_pivot(this->m, row, col, ro, co, expanded_nonzero());
 	} else {
 		// search largest element in column co beginning at row ro
 		GINAC_ASSERT(is_exactly_a<numeric>(this->m[k*col+co]));
@@ -27,11 +27,14 @@
 #include "ex.h"
 #include "archive.h"
 
+#include <cstddef>
 #include <string>
 #include <vector>
 
 namespace GiNaC {
 
+class lu_decomposition;
+
 /** Helper template to allow initialization of matrices via an overloaded
  *  comma operator (idea stolen from Blitz++). */
 template <typename T, typename It>
@@ -150,15 +153,21 @@ public:
 	matrix & set(unsigned ro, unsigned co, const ex & value) { (*this)(ro, co) = value; return *this; }
 	matrix transpose() const;
 	ex determinant(unsigned algo = determinant_algo::automatic) const;
+	ex determinant_in_place(unsigned algo = determinant_algo::automatic);
 	ex trace() const;
 	ex charpoly(const ex & lambda) const;
 	matrix inverse() const;
+	matrix inverse_in_place();
 	matrix solve(const matrix & vars, const matrix & rhs,
 	             unsigned algo = solve_algo::automatic) const;
+	matrix solve_in_place(const matrix & vars, matrix & rhs,
+	                      unsigned algo = solve_algo::automatic);
 	unsigned rank() const;
+	lu_decomposition lu_decompose() const;
 	bool is_zero_matrix() const;
 protected:
 	ex determinant_minor() const;
+	exvector charpoly_berkowitz() const;
 	int gauss_elimination(const bool det = false);
 	int division_free_elimination(const bool det = false);
 	int fraction_free_elimination(const bool det = false);
@@ -216,6 +225,31 @@ inline matrix inverse(const matrix & m)
 inline unsigned rank(const matrix & m)
 { return m.rank(); }
 
+// Number of threads used by matrix operations for independent parts of
+// their results (default 1), returns previous setting
+extern unsigned set_matrix_threads(unsigned n);
+extern unsigned get_matrix_threads();
+
+// Strategy for choosing the pivots of the elimination schemes with
+// symbolic elements (default pivot_strategy::first_nonzero), returns
+// previous setting
+extern unsigned set_pivot_strategy(unsigned s);
+extern unsigned get_pivot_strategy();
+
+// Sizes of the intermediate expressions of an elimination scheme, one
+// entry per step, for the rows below the pivot
+struct elimination_statistics {
+	std::vector<std::size_t> terms;     ///< number of terms of the elements
+	std::vector<std::size_t> nonzeros;  ///< number of nonzero elements
+};
+
+// Record the sizes in the elimination schemes (default false), returns
+// previous setting
+extern bool set_elimination_statistics(bool record);
+
+// Get the sizes recorded in the last elimination
+extern elimination_statistics get_elimination_statistics();
+
 // utility functions
 
 /** Convert list of lists to matrix. */
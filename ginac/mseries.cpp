@@ -0,0 +1,552 @@
+/** @file mseries.cpp
+ *
+ *  Implementation of class mseries, truncated power series in several
+ *  variables. */
+
+/*
+ *  GiNaC Copyright (C) 1999-2014 Johannes Gutenberg University Mainz, Germany
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+
+#include "mseries.h"
+#include "add.h"
+#include "mul.h"
+#include "numeric.h"
+#include "operators.h"
+#include "power.h"
+#include "pseries.h"
+#include "relational.h"
+#include "symbol.h"
+#include "utils.h"
+
+#include <algorithm>
+#include <limits>
+#include <map>
+#include <stdexcept>
+
+namespace GiNaC {
+
+namespace {
+
+/** Order of a series which is exact in some respect. */
+const int no_order = std::numeric_limits<int>::max();
+
+/** Order o shifted by d, where either may be no_order. */
+int shift_order(int o, int d)
+{
+	return o == no_order || d == no_order ? no_order : o + d;
+}
+
+} // anonymous namespace
+
+/** Sort order of the terms: by degree, then by exponents. */
+static bool term_less(const mseries::exponent_vector & a, int adeg,
+                      const mseries::exponent_vector & b, int bdeg)
+{
+	return adeg != bdeg ? adeg < bdeg : a < b;
+}
+
+static int exponent_sum(const mseries::exponent_vector & e)
+{
+	int d = 0;
+	for (size_t v = 0; v < e.size(); ++v)
+		d += e[v];
+	return d;
+}
+
+static void check_vars(const lst & vars)
+{
+	for (lst::const_iterator i = vars.begin(); i != vars.end(); ++i)
+		if (!is_a<symbol>(*i))
+			throw std::invalid_argument("mseries::mseries(): variables must be symbols");
+}
+
+//////////
+// constructors
+//////////
+
+/** An exact zero in the variables of like, truncated at the given orders. */
+mseries::mseries(const mseries & like, int max_total_, const std::vector<int> & max_orders_)
+ : vars(like.vars), total(no_order), orders(like.vars.nops(), no_order),
+   max_total(max_total_), max_orders(max_orders_)
+{
+}
+
+mseries::mseries(const ex & e, const lst & vars_, int order)
+ : vars(vars_), total(no_order), orders(vars_.nops(), no_order),
+   max_total(order), max_orders(vars_.nops(), no_order)
+{
+	check_vars(vars);
+	*this = from_ex(e);
+}
+
+mseries::mseries(const ex & e, const lst & vars_, const std::vector<int> & orders_)
+ : vars(vars_), total(no_order), orders(vars_.nops(), no_order),
+   max_total(no_order), max_orders(orders_)
+{
+	check_vars(vars);
+	if (max_orders.size() != vars.nops())
+		throw std::invalid_argument("mseries::mseries(): need one order for each variable");
+	*this = from_ex(e);
+}
+
+//////////
+// conversion
+//////////
+
+/** The coefficient of the term with the given exponents, 0 if there is
+ *  none. */
+ex mseries::coeff(const exponent_vector & exponents) const
+{
+	if (exponents.size() != vars.nops())
+		throw std::invalid_argument("mseries::coeff(): need one exponent for each variable");
+	const int degree = exponent_sum(exponents);
+	size_t lo = 0, hi = terms.size();
+	while (lo < hi) {
+		const size_t mid = (lo + hi) / 2;
+		if (term_less(terms[mid].exponents, terms[mid].degree, exponents, degree))
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+	if (lo < terms.size() && terms[lo].exponents == exponents)
+		return terms[lo].coeff;
+	return _ex0;
+}
+
+/** The series as an expression, without order terms. */
+ex mseries::to_ex() const
+{
+	exvector sum;
+	sum.reserve(terms.size());
+	for (std::vector<term>::const_iterator i = terms.begin(); i != terms.end(); ++i) {
+		exvector factors;
+		factors.reserve(vars.nops() + 1);
+		factors.push_back(i->coeff);
+		for (size_t v = 0; v < vars.nops(); ++v)
+			if (i->exponents[v])
+				factors.push_back(pow(vars.op(v), i->exponents[v]));
+		sum.push_back((new mul(factors))->setflag(status_flags::dynallocated));
+	}
+	return (new add(sum))->setflag(status_flags::dynallocated);
+}
+
+/** Whether no terms were truncated away, so that to_ex() is the value. */
+bool mseries::is_exact() const
+{
+	if (total != no_order)
+		return false;
+	for (size_t v = 0; v < orders.size(); ++v)
+		if (orders[v] != no_order)
+			return false;
+	return true;
+}
+
+/** The exact constant c, truncated like this series. */
+mseries mseries::constant(const ex & c) const
+{
+	mseries s(*this, max_total, max_orders);
+	if (!c.is_zero()) {
+		term t;
+		t.exponents.assign(vars.nops(), 0);
+		t.degree = 0;
+		t.coeff = c;
+		s.terms.push_back(t);
+		s.truncate();
+	}
+	return s;
+}
+
+/** Expansion of e, truncated like this series. */
+mseries mseries::from_ex(const ex & e) const
+{
+	if (is_a<pseries>(e))
+		return from_ex(series_to_poly(e));
+
+	bool depends = false;
+	for (size_t v = 0; v < vars.nops() && !depends; ++v)
+		depends = e.has(vars.op(v));
+	if (!depends)
+		return constant(e);
+
+	if (is_a<symbol>(e)) {
+		mseries s(*this, max_total, max_orders);
+		term t;
+		t.exponents.assign(vars.nops(), 0);
+		for (size_t v = 0; v < vars.nops(); ++v)
+			if (e.is_equal(vars.op(v)))
+				t.exponents[v] = 1;
+		t.degree = 1;
+		t.coeff = _ex1;
+		s.terms.push_back(t);
+		s.truncate();
+		return s;
+	}
+
+	if (is_exactly_a<add>(e)) {
+		mseries s = from_ex(e.op(0));
+		for (size_t i = 1; i < e.nops(); ++i)
+			s = s.add_series(from_ex(e.op(i)));
+		return s;
+	}
+
+	if (is_exactly_a<mul>(e))
+		return from_product(e);
+
+	if (is_exactly_a<power>(e)) {
+		bool in_exponent = false;
+		for (size_t v = 0; v < vars.nops() && !in_exponent; ++v)
+			in_exponent = e.op(1).has(vars.op(v));
+		if (!in_exponent)
+			return from_ex(e.op(0)).power_const(e.op(1));
+	}
+
+	// Functions and the like (and powers with the variables in the exponent
+	// only), of a single argument with the variables
+	size_t arg = e.nops();
+	for (size_t i = 0; i < e.nops(); ++i) {
+		bool has_var = false;
+		for (size_t v = 0; v < vars.nops() && !has_var; ++v)
+			has_var = e.op(i).has(vars.op(v));
+		if (has_var) {
+			if (arg != e.nops())
+				throw std::invalid_argument("mseries::mseries(): variables in several arguments");
+			arg = i;
+		}
+	}
+	if (arg == e.nops())
+		throw std::invalid_argument("mseries::mseries(): cannot expand in the variables");
+
+	const mseries a = from_ex(e.op(arg));
+	for (std::vector<term>::const_iterator i = a.terms.begin(); i != a.terms.end(); ++i)
+		for (size_t v = 0; v < vars.nops(); ++v)
+			if (i->exponents[v] < 0)
+				throw pole_error("mseries::mseries(): pole in the argument of a function", 0);
+	const ex c0 = a.coeff(exponent_vector(vars.nops(), 0));
+	symbol t;
+	exmap m;
+	m[e.op(arg)] = c0 + t;
+	return a.sub_series(a.constant(c0)).compose(e.subs(m, subs_options::no_pattern), t);
+}
+
+/** Expansion of a product.  Factors with poles lower the orders up to which
+ *  the product of the others is correct, so those others are expanded to
+ *  correspondingly higher orders, like mul::series() does. */
+mseries mseries::from_product(const ex & e) const
+{
+	std::vector<mseries> factors;
+	factors.reserve(e.nops());
+	for (size_t i = 0; i < e.nops(); ++i)
+		factors.push_back(from_ex(e.op(i)));
+
+	int pole_total = 0;
+	std::vector<int> pole_orders(vars.nops(), 0);
+	for (size_t i = 0; i < factors.size(); ++i) {
+		const std::vector<term> & t = factors[i].terms;
+		if (t.empty())
+			continue;
+		pole_total += std::min(t[0].degree, 0);
+		for (size_t v = 0; v < vars.nops(); ++v) {
+			int low = 0;
+			for (std::vector<term>::const_iterator j = t.begin(); j != t.end(); ++j)
+				low = std::min(low, j->exponents[v]);
+			pole_orders[v] += low;
+		}
+	}
+	bool poles = pole_total < 0;
+	for (size_t v = 0; v < vars.nops(); ++v)
+		poles = poles || pole_orders[v] < 0;
+	if (poles) {
+		std::vector<int> raised(vars.nops());
+		for (size_t v = 0; v < vars.nops(); ++v)
+			raised[v] = shift_order(max_orders[v], -pole_orders[v]);
+		const mseries like(*this, shift_order(max_total, -pole_total), raised);
+		for (size_t i = 0; i < factors.size(); ++i)
+			if (!factors[i].is_exact())
+				factors[i] = like.from_ex(e.op(i));
+	}
+
+	mseries s = factors[0];
+	for (size_t i = 1; i < factors.size(); ++i)
+		s = s.mul_series(factors[i]);
+	s.max_total = max_total;
+	s.max_orders = max_orders;
+	s.truncate();
+	return s;
+}
+
+/** The series of f(h), where this series is h, without a constant term and
+ *  without negative exponents, and f is given as an expression in t. */
+mseries mseries::compose(const ex & f, const symbol & t) const
+{
+	// The terms of h^k have degree k or more
+	int max_k = 0;
+	if (!terms.empty()) {
+		const int cut = std::min(total, max_total);
+		if (cut != no_order)
+			max_k = cut - 1;
+		else
+			for (size_t v = 0; v < vars.nops(); ++v) {
+				const int cut_v = std::min(orders[v], max_orders[v]);
+				if (cut_v == no_order)
+					throw std::invalid_argument("mseries::mseries(): variable without order");
+				max_k += cut_v - 1;
+			}
+		max_k = std::max(max_k, 0);
+	}
+
+	const ex p = series_to_poly(f.series(t == 0, max_k + 1));
+	if (p.ldegree(t) < 0)
+		throw pole_error("mseries::mseries(): pole of a function", -p.ldegree(t));
+	exvector c(max_k + 1);
+	for (int k = 0; k <= max_k; ++k) {
+		c[k] = p.coeff(t, k);
+		if (c[k].has(t))
+			throw pole_error("mseries::mseries(): logarithmic singularity of a function", 0);
+	}
+
+	// Horner's scheme
+	mseries s = constant(c[max_k]);
+	for (int k = max_k - 1; k >= 0; --k)
+		s = s.mul_series(*this).add_series(constant(c[k]));
+	return s;
+}
+
+//////////
+// arithmetic
+//////////
+
+mseries mseries::add_series(const mseries & other) const
+{
+	check_compatible(other);
+	std::vector<int> max_o(vars.nops());
+	for (size_t v = 0; v < vars.nops(); ++v)
+		max_o[v] = std::min(max_orders[v], other.max_orders[v]);
+	mseries s(*this, std::min(max_total, other.max_total), max_o);
+	s.total = std::min(total, other.total);
+	for (size_t v = 0; v < vars.nops(); ++v)
+		s.orders[v] = std::min(orders[v], other.orders[v]);
+
+	std::vector<term>::const_iterator a = terms.begin(), b = other.terms.begin();
+	while (a != terms.end() || b != other.terms.end()) {
+		if (b == other.terms.end() ||
+		    (a != terms.end() && term_less(a->exponents, a->degree, b->exponents, b->degree))) {
+			s.terms.push_back(*a++);
+		} else if (a == terms.end() || a->exponents != b->exponents) {
+			s.terms.push_back(*b++);
+		} else {
+			term t = *a;
+			t.coeff = a->coeff + b->coeff;
+			if (!t.coeff.is_zero())
+				s.terms.push_back(t);
+			++a;
+			++b;
+		}
+	}
+	s.truncate();
+	return s;
+}
+
+mseries mseries::sub_series(const mseries & other) const
+{
+	mseries neg(other);
+	for (std::vector<term>::iterator i = neg.terms.begin(); i != neg.terms.end(); ++i)
+		i->coeff = -i->coeff;
+	return add_series(neg);
+}
+
+/** Product of two series.  The terms of the factors are sorted by degree,
+ *  so with a total order the products which are truncated away are never
+ *  formed.  The products with the same exponents are collected and summed
+ *  once. */
+mseries mseries::mul_series(const mseries & other) const
+{
+	check_compatible(other);
+	std::vector<int> max_o(vars.nops());
+	for (size_t v = 0; v < vars.nops(); ++v)
+		max_o[v] = std::min(max_orders[v], other.max_orders[v]);
+	mseries s(*this, std::min(max_total, other.max_total), max_o);
+
+	// Orders up to which the product is correct, from the orders and the
+	// lowest exponents of the factors
+	const int low = terms.empty() ? total : terms[0].degree;
+	const int other_low = other.terms.empty() ? other.total : other.terms[0].degree;
+	s.total = std::min(shift_order(total, other_low), shift_order(other.total, low));
+	for (size_t v = 0; v < vars.nops(); ++v) {
+		int low_v = orders[v], other_low_v = other.orders[v];
+		if (!terms.empty()) {
+			low_v = terms[0].exponents[v];
+			for (std::vector<term>::const_iterator i = terms.begin(); i != terms.end(); ++i)
+				low_v = std::min(low_v, i->exponents[v]);
+		}
+		if (!other.terms.empty()) {
+			other_low_v = other.terms[0].exponents[v];
+			for (std::vector<term>::const_iterator i = other.terms.begin(); i != other.terms.end(); ++i)
+				other_low_v = std::min(other_low_v, i->exponents[v]);
+		}
+		s.orders[v] = std::min(shift_order(orders[v], other_low_v), shift_order(other.orders[v], low_v));
+	}
+
+	typedef std::map<exponent_vector, exvector> product_map;
+	product_map products;
+	exponent_vector e(vars.nops());
+	for (std::vector<term>::const_iterator a = terms.begin(); a != terms.end(); ++a) {
+		for (std::vector<term>::const_iterator b = other.terms.begin(); b != other.terms.end(); ++b) {
+			const int degree = a->degree + b->degree;
+			if (degree >= s.total)
+				break;
+			if (s.max_total != no_order && degree >= s.max_total) {
+				s.total = s.max_total;
+				break;
+			}
+			for (size_t v = 0; v < e.size(); ++v)
+				e[v] = a->exponents[v] + b->exponents[v];
+			if (s.admit(e, degree))
+				products[e].push_back(a->coeff * b->coeff);
+		}
+	}
+
+	for (product_map::const_iterator i = products.begin(); i != products.end(); ++i) {
+		term t;
+		t.exponents = i->first;
+		t.degree = exponent_sum(t.exponents);
+		t.coeff = (new add(i->second))->setflag(status_flags::dynallocated);
+		if (!t.coeff.is_zero())
+			s.terms.push_back(t);
+	}
+	std::sort(s.terms.begin(), s.terms.end(), term_before);
+	return s;
+}
+
+/** The series raised to a power which doesn't depend on the variables.
+ *  Powers other than positive integers need a series whose lowest
+ *  monomial, the one with the lowest exponents of each variable, has a
+ *  nonvanishing coefficient.  This monomial is split off, and the rest is
+ *  expanded by composition with the power series of (c+t)^exponent. */
+mseries mseries::power_const(const ex & exponent) const
+{
+	if (exponent.info(info_flags::posint)) {
+		mseries result = constant(_ex1);
+		mseries base(*this);
+		for (unsigned n = ex_to<numeric>(exponent).to_int(); n; n >>= 1) {
+			if (n & 1)
+				result = result.mul_series(base);
+			if (n > 1)
+				base = base.mul_series(base);
+		}
+		return result;
+	}
+
+	if (terms.empty())
+		throw pole_error("mseries::power_const(): division by zero", 1);
+	exponent_vector low(terms[0].exponents);
+	for (std::vector<term>::const_iterator i = terms.begin(); i != terms.end(); ++i)
+		for (size_t v = 0; v < low.size(); ++v)
+			low[v] = std::min(low[v], i->exponents[v]);
+	exponent_vector low_power(low.size(), 0);
+	for (size_t v = 0; v < low.size(); ++v) {
+		if (low[v] == 0)
+			continue;
+		const ex p = exponent * low[v];
+		if (!p.info(info_flags::integer))
+			throw std::domain_error("mseries::power_const(): branch point of the power");
+		low_power[v] = ex_to<numeric>(p).to_int();
+	}
+
+	// Split off the lowest monomial, and expand the rest so far that the
+	// product with the power of the monomial reaches the orders
+	mseries rest(*this);
+	rest.shift(low, -1);
+	rest.max_total = shift_order(max_total, -exponent_sum(low_power));
+	for (size_t v = 0; v < low.size(); ++v)
+		rest.max_orders[v] = shift_order(max_orders[v], -low_power[v]);
+	rest.truncate();
+	const ex c0 = rest.coeff(exponent_vector(vars.nops(), 0));
+	if (c0.is_zero())
+		throw pole_error("mseries::power_const(): no leading term", 1);
+	symbol t;
+	mseries result = rest.sub_series(rest.constant(c0)).compose(pow(c0 + t, exponent), t);
+	result.shift(low_power, 1);
+	result.max_total = max_total;
+	result.max_orders = max_orders;
+	result.truncate();
+	return result;
+}
+
+//////////
+// helpers
+//////////
+
+bool mseries::term_before(const term & a, const term & b)
+{
+	return term_less(a.exponents, a.degree, b.exponents, b.degree);
+}
+
+/** Multiply the series by the monomial with exponents n*m. */
+void mseries::shift(const exponent_vector & m, int n)
+{
+	const int d = n * exponent_sum(m);
+	total = shift_order(total, d);
+	for (size_t v = 0; v < m.size(); ++v)
+		orders[v] = shift_order(orders[v], n * m[v]);
+	for (std::vector<term>::iterator i = terms.begin(); i != terms.end(); ++i) {
+		for (size_t v = 0; v < m.size(); ++v)
+			i->exponents[v] += n * m[v];
+		i->degree += d;
+	}
+}
+
+/** Whether a term with these exponents and degree belongs to the series.
+ *  Terms beyond the orders up to which it is correct are left out, and
+ *  those beyond the truncation lower these orders. */
+bool mseries::admit(const exponent_vector & exponents, int degree)
+{
+	if (degree >= total)
+		return false;
+	for (size_t v = 0; v < exponents.size(); ++v)
+		if (exponents[v] >= orders[v])
+			return false;
+	if (degree >= max_total) {
+		total = max_total;
+		return false;
+	}
+	for (size_t v = 0; v < exponents.size(); ++v) {
+		if (exponents[v] >= max_orders[v]) {
+			orders[v] = max_orders[v];
+			return false;
+		}
+	}
+	return true;
+}
+
+/** Remove the terms which don't belong to the series. */
+void mseries::truncate()
+{
+	std::vector<term>::iterator out = terms.begin();
+	for (std::vector<term>::iterator i = terms.begin(); i != terms.end(); ++i)
+		if (admit(i->exponents, i->degree))
+			*out++ = *i;
+	terms.erase(out, terms.end());
+}
+
+void mseries::check_compatible(const mseries & other) const
+{
+	if (!vars.is_equal(other.vars))
+		throw std::invalid_argument("mseries: series in different variables");
+}
+
+} // namespace GiNaC
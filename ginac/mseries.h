@@ -0,0 +1,113 @@
+/** @file mseries.h
+ *
+ *  Interface to class mseries, truncated power series in several variables. */
+
+/*
+ *  GiNaC Copyright (C) 1999-2014 Johannes Gutenberg University Mainz, Germany
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+
+#ifndef GINAC_MSERIES_H
+#define GINAC_MSERIES_H
+
+#include "ex.h"
+#include "lst.h"
+
+#include <vector>
+
+namespace GiNaC {
+
+/** Truncated power series in several variables, like the expansion of an
+ *  expression in two small parameters.  Unlike nested series() calls, whose
+ *  outer pseries has inner ones as coefficients, the terms are stored
+ *  flat as monomials with coefficients free of the variables, and products
+ *  never form the terms which are truncated away.
+ *
+ *  A series is truncated either at a total degree, dropping the terms whose
+ *  degree in all variables together reaches the order, or at a separate
+ *  order for each variable.  Exponents may be negative (poles).  As for
+ *  pseries, a series also knows up to which orders its terms are correct,
+ *  which may be less than the truncation after divisions by the variables,
+ *  and polynomials within the truncation are exact. */
+class mseries
+{
+public:
+	typedef std::vector<int> exponent_vector;
+
+	/** Expand e in the variables vars, up to but not including the total
+	 *  degree order. */
+	mseries(const ex & e, const lst & vars, int order);
+	/** Expand e in the variables vars, up to but not including the power
+	 *  orders[i] of the variable vars.op(i). */
+	mseries(const ex & e, const lst & vars, const std::vector<int> & orders);
+
+	size_t nterms() const        /// Get number of nonvanishing terms.
+		{ return terms.size(); }
+	ex coeff(const exponent_vector & exponents) const;
+	ex to_ex() const;
+	bool is_exact() const;
+
+	mseries add_series(const mseries & other) const;
+	mseries sub_series(const mseries & other) const;
+	mseries mul_series(const mseries & other) const;
+	mseries power_const(const ex & exponent) const;
+
+private:
+	struct term {
+		exponent_vector exponents;
+		int degree;  ///< sum of the exponents
+		ex coeff;
+	};
+
+	static bool term_before(const term & a, const term & b);
+
+	mseries(const mseries & like, int max_total, const std::vector<int> & max_orders);
+	mseries from_ex(const ex & e) const;
+	mseries from_product(const ex & e) const;
+	mseries constant(const ex & c) const;
+	mseries compose(const ex & f, const symbol & t) const;
+	void shift(const exponent_vector & m, int n);
+	bool admit(const exponent_vector & exponents, int degree);
+	void truncate();
+	void check_compatible(const mseries & other) const;
+
+	lst vars;                    ///< the variables
+	int total;                   ///< order of the total degree up to which the terms are correct, or no_order
+	std::vector<int> orders;     ///< the same for the degree in each variable
+	int max_total;               ///< order of the total degree where terms are dropped, or no_order
+	std::vector<int> max_orders; ///< the same for the degree in each variable
+	std::vector<term> terms;     ///< sorted by degree, then exponents
+};
+
+inline mseries operator+(const mseries & lh, const mseries & rh)
+{
+	return lh.add_series(rh);
+}
+
+inline mseries operator-(const mseries & lh, const mseries & rh)
+{
+	return lh.sub_series(rh);
+}
+
+inline mseries operator*(const mseries & lh, const mseries & rh)
+{
+	return lh.mul_series(rh);
+}
+
+} // namespace GiNaC
+
+#endif // ndef GINAC_MSERIES_H
@@ -31,7 +31,12 @@
 #include "utils.h"
 #include "symbol.h"
 #include "compiler.h"
+#include "subs_index.h"
+#include "budget.h"
+#include "truncation.h"
+#include "polynomial/sparse_mul.h"
 
+#include <algorithm>
 #include <iostream>
 #include <limits>
 #include <stdexcept>
@@ -93,7 +98,7 @@ mul::mul(std::auto_ptr<epvector> vp, const ex & oc, bool do_index_renaming)
 {
 	GINAC_ASSERT(vp.get()!=0);
 	overall_coeff = oc;
-	construct_from_epvector(*vp, do_index_renaming);
+	construct_from_epvector(vp, do_index_renaming);
 	GINAC_ASSERT(is_canonical());
 }
 
@@ -153,7 +158,13 @@ void mul::do_print(const print_context & c, unsigned level) const
 			c.s << '*';
 		else
 			first = false;
-		recombine_pair_to_ex(*it).print(c, precedence());
+		// Avoid putting the factor on the heap in the common cases
+		if (it->coeff.is_equal(_ex1))
+			it->rest.print(c, precedence());
+		else if (is_a<symbol>(it->rest))
+			power(it->rest, it->coeff).print(c, precedence());
+		else
+			recombine_pair_to_ex(*it).print(c, precedence());
 		++it;
 	}
 
@@ -415,6 +426,8 @@ bool mul::is_polynomial(const ex & var) const
 
 int mul::degree(const ex & s) const
 {
+	if (lacks_symbol(ex_to<basic>(s)))
+		return 0;
 	// Sum up degrees of factors
 	int deg_sum = 0;
 	epvector::const_iterator i = seq.begin(), end = seq.end();
@@ -432,6 +445,8 @@ int mul::degree(const ex & s) const
 
 int mul::ldegree(const ex & s) const
 {
+	if (lacks_symbol(ex_to<basic>(s)))
+		return 0;
 	// Sum up degrees of factors
 	int deg_sum = 0;
 	epvector::const_iterator i = seq.begin(), end = seq.end();
@@ -449,6 +464,8 @@ int mul::ldegree(const ex & s) const
 
 ex mul::coeff(const ex & s, int n) const
 {
+	if (lacks_symbol(ex_to<basic>(s)))
+		return n==0 ? ex(*this) : _ex0;
 	exvector coeffseq;
 	coeffseq.reserve(seq.size()+1);
 	
@@ -485,6 +502,37 @@ ex mul::coeff(const ex & s, int n) const
 	return _ex0;
 }
 
+bool strip_content(const add & a, numeric & c, ex & prim)
+{
+	// XXX: What is the best way to check if the polynomial is a primitive? 
+	numeric content = a.integer_content();
+	const numeric lead_coeff = ex_to<numeric>(a.seq.begin()->coeff).div(content);
+	const bool canonicalizable = lead_coeff.is_integer();
+
+	// XXX: The main variable is chosen in a random way, so this code 
+	// does NOT transform the term into the canonical form (thus, in some
+	// very unlucky event it can even loop forever). Hopefully the main
+	// variable will be the same for all terms in *this
+	const bool unit_normal = lead_coeff.is_pos_integer();
+	if (likely((content == *_num1_p) && ((! canonicalizable) || unit_normal)))
+		return false;
+
+	if (! unit_normal)
+		content = content.mul(*_num_1_p);
+
+	// divide add by the number in place to save at least 2 .eval() calls
+	add* primitive = new add(a);
+	primitive->setflag(status_flags::dynallocated);
+	primitive->clearflag(status_flags::hash_calculated);
+	primitive->overall_coeff = ex_to<numeric>(primitive->overall_coeff).div_dyn(content);
+	for (epvector::iterator ai = primitive->seq.begin(); ai != primitive->seq.end(); ++ai)
+		ai->coeff = ex_to<numeric>(ai->coeff).div_dyn(content);
+
+	c = content;
+	prim = *primitive;
+	return true;
+}
+
 /** Perform automatic term rewriting rules in this class.  In the following
  *  x, x1, x2,... stand for a symbolic variables of type ex and c, c1, c2...
  *  stand for such expressions that contain a plain number.
@@ -552,18 +600,9 @@ ex mul::eval(int level) const
 				continue;
 			}
 
-			// XXX: What is the best way to check if the polynomial is a primitive? 
-			numeric c = i->rest.integer_content();
-			const numeric lead_coeff =
-				ex_to<numeric>(ex_to<add>(i->rest).seq.begin()->coeff).div(c);
-			const bool canonicalizable = lead_coeff.is_integer();
-
-			// XXX: The main variable is chosen in a random way, so this code 
-			// does NOT transform the term into the canonical form (thus, in some
-			// very unlucky event it can even loop forever). Hopefully the main
-			// variable will be the same for all terms in *this
-			const bool unit_normal = lead_coeff.is_pos_integer();
-			if (likely((c == *_num1_p) && ((! canonicalizable) || unit_normal))) {
+			numeric c;
+			ex primitive;
+			if (likely(! strip_content(ex_to<add>(i->rest), c, primitive))) {
 				++i;
 				continue;
 			}
@@ -578,21 +617,8 @@ ex mul::eval(int level) const
 				++j;
 			}
 
-			if (! unit_normal)
-				c = c.mul(*_num_1_p);
-
 			oc = oc.mul(c);
-
-			// divide add by the number in place to save at least 2 .eval() calls
-			const add& addref = ex_to<add>(i->rest);
-			add* primitive = new add(addref);
-			primitive->setflag(status_flags::dynallocated);
-			primitive->clearflag(status_flags::hash_calculated);
-			primitive->overall_coeff = ex_to<numeric>(primitive->overall_coeff).div_dyn(c);
-			for (epvector::iterator ai = primitive->seq.begin(); ai != primitive->seq.end(); ++ai)
-				ai->coeff = ex_to<numeric>(ai->coeff).div_dyn(c);
-			
-			s->push_back(expair(*primitive, _ex1));
+			s->push_back(expair(primitive, _ex1));
 
 			++i;
 			++j;
@@ -631,6 +657,16 @@ ex mul::evalf(int level) const
 	return mul(s, overall_coeff.evalf(level));
 }
 
+std::complex<double> mul::evalf_double(const evalf_double_map & values) const
+{
+	std::complex<double> result = ex_to<numeric>(overall_coeff).evalf_double(values);
+	for (epvector::const_iterator i = seq.begin(); i != seq.end(); ++i) {
+		const std::complex<double> b = i->rest.evalf_double(values);
+		result *= i->coeff.is_equal(_ex1) ? b : power::evalf_double_power(b, i->coeff, values);
+	}
+	return result;
+}
+
 void mul::find_real_imag(ex & rp, ex & ip) const
 {
 	rp = overall_coeff.real_part();
@@ -825,7 +861,16 @@ ex mul::algebraic_subs_mul(const exmap & m, unsigned options) const
 	ex divide_by = 1;
 	ex multiply_by = 1;
 
-	for (exmap::const_iterator it = m.begin(); it != m.end(); ++it) {
+	// The keys to try, only the ones which could match if m is indexed
+	subs_index::key_vector keys;
+	if (const subs_index * index = subs_index::find(m))
+		index->product_candidates(*this, keys);
+	else
+		for (exmap::const_iterator it = m.begin(); it != m.end(); ++it)
+			keys.push_back(it);
+
+	for (subs_index::key_vector::const_iterator k = keys.begin(); k != keys.end(); ++k) {
+		const exmap::const_iterator it = *k;
 
 		if (is_exactly_a<mul>(it->first)) {
 retry1:
@@ -916,6 +961,8 @@ ex mul::conjugate() const
  *  @see ex::diff */
 ex mul::derivative(const symbol & s) const
 {
+	if (lacks_symbol(s))
+		return _ex0;
 	size_t num = seq.size();
 	exvector addseq;
 	addseq.reserve(num);
@@ -1109,6 +1156,111 @@ bool mul::can_be_further_expanded(const ex & e)
 	return false;
 }
 
+/** Check if e is a monomial, a product of symbols with integer exponents and
+ *  no numeric factor, like the terms of expanded polynomials.  If so, the
+ *  range [first, last) is set to its factors as they would appear in a mul,
+ *  which for a single factor are stored in single. */
+bool mul::monomial_factors(const ex & e, expair & single, const expair * & first, const expair * & last)
+{
+	if (is_a<symbol>(e)) {
+		single = expair(e, _ex1);
+	} else if (is_exactly_a<power>(e)) {
+		if (!is_a<symbol>(e.op(0)) || !e.op(1).info(info_flags::integer))
+			return false;
+		single = expair(e.op(0), e.op(1));
+	} else if (is_exactly_a<mul>(e)) {
+		const mul & m = ex_to<mul>(e);
+		if (!m.overall_coeff.is_equal(_ex1))
+			return false;
+		for (epvector::const_iterator i = m.seq.begin(); i != m.seq.end(); ++i)
+			if (!is_a<symbol>(i->rest) || !i->coeff.info(info_flags::integer))
+				return false;
+		first = &*m.seq.begin();
+		last = first + m.seq.size();
+		return true;
+	} else
+		return false;
+	first = &single;
+	last = first + 1;
+	return true;
+}
+
+/** Products with fewer factors are sorted by comparing the factors (see
+ *  expairseq::canonicalize()), so merging sorted factor lists keeps them
+ *  canonical. */
+static const std::size_t monomial_merge_limit = 32;
+
+/** Multiply two terms of expanded sums.  Products of monomials are built by
+ *  merging their sorted lists of factors and adding the exponents of equal
+ *  symbols, with the small integers taken from the flyweights, instead of
+ *  sorting and combining the factors of a general product and evaluating
+ *  it. */
+ex mul::multiply_monomials(const ex & a, const ex & b)
+{
+	expair single_a, single_b;
+	const expair *ai, *aend, *bi, *bend;
+	if (!monomial_factors(a, single_a, ai, aend) || !monomial_factors(b, single_b, bi, bend) ||
+	    std::size_t((aend - ai) + (bend - bi)) >= monomial_merge_limit)
+		return (new mul(a, b))->setflag(status_flags::dynallocated);
+
+	std::auto_ptr<epvector> factors(new epvector);
+	factors->reserve((aend - ai) + (bend - bi));
+	while (ai != aend && bi != bend) {
+		const int cmpval = ai->rest.compare(bi->rest);
+		if (cmpval < 0)
+			factors->push_back(*ai++);
+		else if (cmpval > 0)
+			factors->push_back(*bi++);
+		else {
+			const numeric & exponent = ex_to<numeric>(ai->coeff).add_dyn(ex_to<numeric>(bi->coeff));
+			if (!exponent.is_zero())
+				factors->push_back(expair(ai->rest, exponent));
+			++ai;
+			++bi;
+		}
+	}
+	factors->insert(factors->end(), ai, aend);
+	factors->insert(factors->end(), bi, bend);
+
+	if (factors->empty())
+		return _ex1;
+	if (factors->size() == 1) {
+		const expair & p = factors->front();
+		if (p.coeff.is_equal(_ex1))
+			return p.rest;
+		return (new power(p.rest, p.coeff))->setflag(status_flags::dynallocated);
+	}
+	mul * m = new mul;
+	m->seq.swap(*factors);
+	m->overall_coeff = _ex1;
+	m->setflag(status_flags::dynallocated | status_flags::evaluated | status_flags::expanded);
+	GINAC_ASSERT(m->is_canonical());
+	return *m;
+}
+
+/** Smallest degree of the terms of a sum under expand_truncated(). */
+static int min_term_degree(const ex & a, const degree_truncation & t)
+{
+	int d = std::numeric_limits<int>::max();
+	for (size_t i = 0; i < a.nops() && d > 0; ++i)
+		d = std::min(d, t.degree(a.op(i)));
+	return d;
+}
+
+/** Collect the dummy indices of the terms of a sum, sorted and without
+ *  duplicates.  Terms without any indices are not inspected. */
+static void collect_dummy_indices(epvector::const_iterator first, epvector::const_iterator last, exvector & v)
+{
+	for (; first != last; ++first) {
+		if (!first->rest.info(info_flags::has_indices))
+			continue;
+		exvector dummies = get_all_dummy_indices_safely(first->rest);
+		v.insert(v.end(), dummies.begin(), dummies.end());
+	}
+	std::sort(v.begin(), v.end(), ex_is_less());
+	v.erase(std::unique(v.begin(), v.end(), ex_is_equal()), v.end());
+}
+
 ex mul::expand(unsigned options) const
 {
 	{
@@ -1141,98 +1293,143 @@ ex mul::expand(unsigned options) const
 	epvector non_adds;
 	non_adds.reserve(expanded_seq.size());
 
-	for (epvector::const_iterator cit = expanded_seq.begin(); cit != expanded_seq.end(); ++cit) {
-		if (is_exactly_a<add>(cit->rest) &&
-			(cit->coeff.is_equal(_ex1))) {
-			if (is_exactly_a<add>(last_expanded)) {
-
-				// Expand a product of two sums, aggressive version.
-				// Caring for the overall coefficients in separate loops can
-				// sometimes give a performance gain of up to 15%!
-
-				const int sizedifference = ex_to<add>(last_expanded).seq.size()-ex_to<add>(cit->rest).seq.size();
-				// add2 is for the inner loop and should be the bigger of the two sums
-				// in the presence of asymptotically good sorting:
-				const add& add1 = (sizedifference<0 ? ex_to<add>(last_expanded) : ex_to<add>(cit->rest));
-				const add& add2 = (sizedifference<0 ? ex_to<add>(cit->rest) : ex_to<add>(last_expanded));
-				const epvector::const_iterator add1begin = add1.seq.begin();
-				const epvector::const_iterator add1end   = add1.seq.end();
-				const epvector::const_iterator add2begin = add2.seq.begin();
-				const epvector::const_iterator add2end   = add2.seq.end();
-				epvector distrseq;
-				distrseq.reserve(add1.seq.size()+add2.seq.size());
-
-				// Multiply add2 with the overall coefficient of add1 and append it to distrseq:
-				if (!add1.overall_coeff.is_zero()) {
-					if (add1.overall_coeff.is_equal(_ex1))
-						distrseq.insert(distrseq.end(),add2begin,add2end);
-					else
-						for (epvector::const_iterator i=add2begin; i!=add2end; ++i)
-							distrseq.push_back(expair(i->rest, ex_to<numeric>(i->coeff).mul_dyn(ex_to<numeric>(add1.overall_coeff))));
-				}
-
-				// Multiply add1 with the overall coefficient of add2 and append it to distrseq:
-				if (!add2.overall_coeff.is_zero()) {
-					if (add2.overall_coeff.is_equal(_ex1))
-						distrseq.insert(distrseq.end(),add1begin,add1end);
-					else
-						for (epvector::const_iterator i=add1begin; i!=add1end; ++i)
-							distrseq.push_back(expair(i->rest, ex_to<numeric>(i->coeff).mul_dyn(ex_to<numeric>(add2.overall_coeff))));
-				}
+	// Under expand_truncated(), the products of terms whose degree exceeds
+	// the bound even when multiplied by the terms of least degree of the
+	// remaining sums and by the other factors are left out
+	const degree_truncation * trunc = current_truncation;
+	int other_degree = 0, remaining_min_degree = 0;
+	if (trunc) {
+		for (epvector::const_iterator cit = expanded_seq.begin(); cit != expanded_seq.end(); ++cit) {
+			if (is_exactly_a<add>(cit->rest) && cit->coeff.is_equal(_ex1))
+				remaining_min_degree += min_term_degree(cit->rest, *trunc);
+			else
+				other_degree += trunc->factor_degree(*cit);
+		}
+	}
 
-				// Compute the new overall coefficient and put it together:
-				ex tmp_accu = (new add(distrseq, add1.overall_coeff*add2.overall_coeff))->setflag(status_flags::dynallocated);
+	// Products of polynomials in symbols with rational coefficients are
+	// handed over to the sparse polynomial multiplication in one go (which
+	// knows nothing about truncation)
+	bool sums_multiplied = false;
+	if (skip_idx_rename && !trunc) {
+		exvector sums;
+		for (epvector::const_iterator cit = expanded_seq.begin(); cit != expanded_seq.end(); ++cit) {
+			if (is_exactly_a<add>(cit->rest) && cit->coeff.is_equal(_ex1))
+				sums.push_back(cit->rest);
+		}
+		if (sums.size() > 1 && sparse_poly_mul(last_expanded, sums)) {
+			for (epvector::const_iterator cit = expanded_seq.begin(); cit != expanded_seq.end(); ++cit) {
+				if (!is_exactly_a<add>(cit->rest) || !cit->coeff.is_equal(_ex1))
+					non_adds.push_back(*cit);
+			}
+			sums_multiplied = true;
+		}
+	}
 
-				exvector add1_dummy_indices, add2_dummy_indices, add_indices;
-				lst dummy_subs;
+	if (!sums_multiplied) {
+		for (epvector::const_iterator cit = expanded_seq.begin(); cit != expanded_seq.end(); ++cit) {
+			if (is_exactly_a<add>(cit->rest) &&
+				(cit->coeff.is_equal(_ex1))) {
+				if (trunc)
+					remaining_min_degree -= min_term_degree(cit->rest, *trunc);
+				if (is_exactly_a<add>(last_expanded)) {
+
+					// Expand a product of two sums, aggressive version.
+					// Caring for the overall coefficients in separate loops can
+					// sometimes give a performance gain of up to 15%!
+
+					const int sizedifference = ex_to<add>(last_expanded).seq.size()-ex_to<add>(cit->rest).seq.size();
+					// add2 is for the inner loop and should be the bigger of the two sums
+					// in the presence of asymptotically good sorting:
+					const add& add1 = (sizedifference<0 ? ex_to<add>(last_expanded) : ex_to<add>(cit->rest));
+					const add& add2 = (sizedifference<0 ? ex_to<add>(cit->rest) : ex_to<add>(last_expanded));
+					const epvector::const_iterator add1begin = add1.seq.begin();
+					const epvector::const_iterator add1end   = add1.seq.end();
+					const epvector::const_iterator add2begin = add2.seq.begin();
+					const epvector::const_iterator add2end   = add2.seq.end();
+					std::auto_ptr<epvector> distrseq(new epvector);
+					distrseq->reserve(add1.seq.size()+add2.seq.size());
+
+					// Largest degree of the products of terms kept, and the degrees of the terms of add1
+					const int bound = trunc ? trunc->max_degree - other_degree - remaining_min_degree : 0;
+					std::vector<int> add1_degrees;
+					int add1_min_degree = 0;
+					if (trunc) {
+						add1_degrees.reserve(add1.seq.size());
+						add1_min_degree = std::numeric_limits<int>::max();
+						for (epvector::const_iterator i=add1begin; i!=add1end; ++i) {
+							add1_degrees.push_back(trunc->degree(i->rest));
+							add1_min_degree = std::min(add1_min_degree, add1_degrees.back());
+						}
+					}
 
-				if (!skip_idx_rename) {
-					for (epvector::const_iterator i=add1begin; i!=add1end; ++i) {
-						add_indices = get_all_dummy_indices_safely(i->rest);
-						add1_dummy_indices.insert(add1_dummy_indices.end(), add_indices.begin(), add_indices.end());
+					// Multiply add2 with the overall coefficient of add1 and append it to distrseq:
+					if (!add1.overall_coeff.is_zero()) {
+						if (add1.overall_coeff.is_equal(_ex1) && !trunc)
+							distrseq->insert(distrseq->end(),add2begin,add2end);
+						else
+							for (epvector::const_iterator i=add2begin; i!=add2end; ++i)
+								if (!trunc || trunc->degree(i->rest) <= bound)
+									distrseq->push_back(expair(i->rest, ex_to<numeric>(i->coeff).mul_dyn(ex_to<numeric>(add1.overall_coeff))));
 					}
-					for (epvector::const_iterator i=add2begin; i!=add2end; ++i) {
-						add_indices = get_all_dummy_indices_safely(i->rest);
-						add2_dummy_indices.insert(add2_dummy_indices.end(), add_indices.begin(), add_indices.end());
+
+					// Multiply add1 with the overall coefficient of add2 and append it to distrseq:
+					if (!add2.overall_coeff.is_zero()) {
+						if (add2.overall_coeff.is_equal(_ex1) && !trunc)
+							distrseq->insert(distrseq->end(),add1begin,add1end);
+						else
+							for (epvector::const_iterator i=add1begin; i!=add1end; ++i)
+								if (!trunc || add1_degrees[i - add1begin] <= bound)
+									distrseq->push_back(expair(i->rest, ex_to<numeric>(i->coeff).mul_dyn(ex_to<numeric>(add2.overall_coeff))));
 					}
 
-					sort(add1_dummy_indices.begin(), add1_dummy_indices.end(), ex_is_less());
-					sort(add2_dummy_indices.begin(), add2_dummy_indices.end(), ex_is_less());
-					dummy_subs = rename_dummy_indices_uniquely(add1_dummy_indices, add2_dummy_indices);
-				}
+					// Compute the new overall coefficient and put it together:
+					add_builder tmp_accu;
+					tmp_accu += (new add(distrseq, add1.overall_coeff*add2.overall_coeff))->setflag(status_flags::dynallocated);
 
-				// Multiply explicitly all non-numeric terms of add1 and add2:
-				for (epvector::const_iterator i2=add2begin; i2!=add2end; ++i2) {
-					// We really have to combine terms here in order to compactify
-					// the result.  Otherwise it would become waayy tooo bigg.
-					numeric oc(*_num0_p);
-					epvector distrseq2;
-					distrseq2.reserve(add1.seq.size());
-					const ex i2_new = (skip_idx_rename || (dummy_subs.op(0).nops() == 0) ?
-							i2->rest :
-							i2->rest.subs(ex_to<lst>(dummy_subs.op(0)), 
-								ex_to<lst>(dummy_subs.op(1)), subs_options::no_pattern));
-					for (epvector::const_iterator i1=add1begin; i1!=add1end; ++i1) {
-						// Don't push_back expairs which might have a rest that evaluates to a numeric,
-						// since that would violate an invariant of expairseq:
-						const ex rest = (new mul(i1->rest, i2_new))->setflag(status_flags::dynallocated);
-						if (is_exactly_a<numeric>(rest)) {
-							oc += ex_to<numeric>(rest).mul(ex_to<numeric>(i1->coeff).mul(ex_to<numeric>(i2->coeff)));
-						} else {
-							distrseq2.push_back(expair(rest, ex_to<numeric>(i1->coeff).mul_dyn(ex_to<numeric>(i2->coeff))));
-						}
+					exvector add1_dummy_indices, add2_dummy_indices;
+					lst dummy_subs;
+
+					// Only indices that are dummies in both sums need to be renamed
+					if (!skip_idx_rename) {
+						collect_dummy_indices(add1begin, add1end, add1_dummy_indices);
+						if (!add1_dummy_indices.empty())
+							collect_dummy_indices(add2begin, add2end, add2_dummy_indices);
 					}
-					tmp_accu += (new add(distrseq2, oc))->setflag(status_flags::dynallocated);
-				} 
-				last_expanded = tmp_accu;
+					if (!add2_dummy_indices.empty())
+						dummy_subs = rename_dummy_indices_uniquely(add1_dummy_indices, add2_dummy_indices);
+
+					// Multiply explicitly all non-numeric terms of add1 and add2:
+					for (epvector::const_iterator i2=add2begin; i2!=add2end; ++i2) {
+						check_budget();
+						const int i2_degree = trunc ? trunc->degree(i2->rest) : 0;
+						if (trunc && i2_degree + add1_min_degree > bound)
+							continue;
+						// We really have to combine terms here in order to compactify
+						// the result.  Otherwise it would become waayy tooo bigg.
+						const ex i2_new = (add2_dummy_indices.empty() || (dummy_subs.op(0).nops() == 0) ?
+								i2->rest :
+								i2->rest.subs(ex_to<lst>(dummy_subs.op(0)), 
+									ex_to<lst>(dummy_subs.op(1)), subs_options::no_pattern));
+						for (epvector::const_iterator i1=add1begin; i1!=add1end; ++i1) {
+							if (trunc && i2_degree + add1_degrees[i1 - add1begin] > bound)
+								continue;
+							// The rest may evaluate to a numeric, which the builder
+							// takes care of
+							const ex rest = multiply_monomials(i1->rest, i2_new);
+							tmp_accu.add_term(rest, ex_to<numeric>(i1->coeff).mul(ex_to<numeric>(i2->coeff)));
+						}
+					} 
+					last_expanded = tmp_accu.result();
+				} else {
+					if (!last_expanded.is_equal(_ex1))
+						non_adds.push_back(split_ex_to_pair(last_expanded));
+					last_expanded = cit->rest;
+				}
+
 			} else {
-				if (!last_expanded.is_equal(_ex1))
-					non_adds.push_back(split_ex_to_pair(last_expanded));
-				last_expanded = cit->rest;
+				non_adds.push_back(*cit);
 			}
-
-		} else {
-			non_adds.push_back(*cit);
 		}
 	}
 
@@ -1247,13 +1444,22 @@ ex mul::expand(unsigned options) const
 			va = get_all_dummy_indices_safely(mul(non_adds));
 			sort(va.begin(), va.end(), ex_is_less());
 		}
+		int non_adds_degree = 0;
+		if (trunc)
+			for (epvector::const_iterator cit = non_adds.begin(); cit != non_adds.end(); ++cit)
+				non_adds_degree += trunc->factor_degree(*cit);
 
 		for (size_t i=0; i<n; ++i) {
-			epvector factors = non_adds;
-			if (skip_idx_rename)
-				factors.push_back(split_ex_to_pair(last_expanded.op(i)));
+			check_budget();
+			if (trunc && trunc->degree(last_expanded.op(i)) + non_adds_degree > trunc->max_degree)
+				continue;
+			std::auto_ptr<epvector> factors(new epvector);
+			factors->reserve(non_adds.size() + 1);
+			factors->insert(factors->end(), non_adds.begin(), non_adds.end());
+			if (va.empty() || !last_expanded.op(i).info(info_flags::has_indices))
+				factors->push_back(split_ex_to_pair(last_expanded.op(i)));
 			else
-				factors.push_back(split_ex_to_pair(rename_dummy_indices_uniquely(va, last_expanded.op(i))));
+				factors->push_back(split_ex_to_pair(rename_dummy_indices_uniquely(va, last_expanded.op(i))));
 			ex term = (new mul(factors, overall_coeff))->setflag(status_flags::dynallocated);
 			if (can_be_further_expanded(term)) {
 				distrseq.push_back(term.expand());
@@ -1268,8 +1474,10 @@ ex mul::expand(unsigned options) const
 		        setflag(status_flags::dynallocated | (options == 0 ? status_flags::expanded : 0)));
 	}
 
-	non_adds.push_back(split_ex_to_pair(last_expanded));
-	ex result = (new mul(non_adds, overall_coeff))->setflag(status_flags::dynallocated);
+	std::auto_ptr<epvector> factors(new epvector);
+	factors->swap(non_adds);
+	factors->push_back(split_ex_to_pair(last_expanded));
+	ex result = (new mul(factors, overall_coeff))->setflag(status_flags::dynallocated);
 	if (can_be_further_expanded(result)) {
 		return result.expand();
 	} else {
@@ -1337,4 +1545,60 @@ std::auto_ptr<epvector> mul::expandchildren(unsigned options) const
 
 GINAC_BIND_UNARCHIVER(mul);
 
+//////////
+// mul_builder
+//////////
+
+mul_builder & mul_builder::operator*=(const ex & e)
+{
+	if (is_exactly_a<numeric>(e))
+		overall_coeff = overall_coeff.mul(ex_to<numeric>(e));
+	else if (is_exactly_a<mul>(e)) {
+		const mul & m = ex_to<mul>(e);
+		for (epvector::const_iterator i = m.seq.begin(); i != m.seq.end(); ++i)
+			multiply_pair(i->rest, i->coeff);
+		overall_coeff = overall_coeff.mul(ex_to<numeric>(m.overall_coeff));
+	} else if (is_exactly_a<power>(e) && is_exactly_a<numeric>(e.op(1)))
+		multiply_pair(e.op(0), e.op(1));
+	else
+		multiply_pair(e, _ex1);
+	return *this;
+}
+
+void mul_builder::multiply_pair(const ex & basis, const ex & exponent)
+{
+	// Powers of numbers and products may simplify when they are combined
+	// (see mul::expair_needs_further_processing()), which is left to the
+	// constructor of mul
+	if (is_exactly_a<numeric>(basis) || is_exactly_a<mul>(basis)) {
+		factors.push_back(expair(basis, exponent));
+		return;
+	}
+
+	const std::pair<exhashmap<size_t>::iterator, bool> pos = position.insert(std::make_pair(basis, factors.size()));
+	if (pos.second)
+		factors.push_back(expair(basis, exponent));
+	else {
+		ex & sum = factors[pos.first->second].coeff;
+		sum = ex_to<numeric>(sum).add_dyn(ex_to<numeric>(exponent));
+	}
+}
+
+ex mul_builder::result() const
+{
+	std::auto_ptr<epvector> vp(new epvector);
+	vp->reserve(factors.size());
+	for (epvector::const_iterator i = factors.begin(); i != factors.end(); ++i)
+		if (!ex_to<numeric>(i->coeff).is_zero())
+			vp->push_back(*i);
+	return (new mul(vp, overall_coeff))->setflag(status_flags::dynallocated);
+}
+
+void mul_builder::clear()
+{
+	factors.clear();
+	position.clear();
+	overall_coeff = *_num1_p;
+}
+
 } // namespace GiNaC
@@ -33,6 +33,8 @@ class mul : public expairseq
 	GINAC_DECLARE_REGISTERED_CLASS(mul, expairseq)
 	
 	friend class add;
+	friend class add_builder;
+	friend class mul_builder;
 	friend class ncmul;
 	friend class power;
 	
@@ -56,6 +58,7 @@ public:
 	bool has(const ex & other, unsigned options = 0) const;
 	ex eval(int level=0) const;
 	ex evalf(int level=0) const;
+	std::complex<double> evalf_double(const evalf_double_map & values) const;
 	ex real_part() const;
 	ex imag_part() const;
 	ex evalm() const;
@@ -98,10 +101,63 @@ protected:
 	void do_print_csrc(const print_csrc & c, unsigned level) const;
 	void do_print_python_repr(const print_python_repr & c, unsigned level) const;
 	static bool can_be_further_expanded(const ex & e);
+	static bool monomial_factors(const ex & e, expair & single, const expair * & first, const expair * & last);
+	static ex multiply_monomials(const ex & a, const ex & b);
 	std::auto_ptr<epvector> expandchildren(unsigned options) const;
 };
 GINAC_DECLARE_UNARCHIVER(mul);
 
+/** Accumulates the factors of a large product and builds it in one go, the
+ *  counterpart of add_builder.  Powers of the same basis with numeric
+ *  exponents are combined by hashing as they come in.  Like the
+ *  constructors of mul, it is meant for commutative factors. */
+class mul_builder {
+public:
+	mul_builder() : overall_coeff(1) { }
+
+	/** Multiply by e.  The factors of products are taken one by one. */
+	mul_builder & operator*=(const ex & e);
+
+	/** Number of distinct factors which are not numbers. */
+	size_t size() const { return factors.size(); }
+
+	/** The product of everything multiplied so far. */
+	ex result() const;
+
+	/** Start a new product. */
+	void clear();
+
+private:
+	void multiply_pair(const ex & basis, const ex & exponent);
+
+	epvector factors;              ///< basis and exponent
+	exhashmap<size_t> position;    ///< index in factors by basis
+	numeric overall_coeff;
+};
+
+/** Set the number of threads mul::expand() may use for multiplying large
+ *  polynomials.  The default of 1 means that no threads are started.
+ *  Threads are only available if the library was built with pthreads.
+ *
+ *  @return previous setting */
+unsigned set_expand_threads(unsigned n);
+
+/** Number of threads mul::expand() may use for multiplying polynomials. */
+unsigned get_expand_threads();
+
+/** Select how mul::expand() multiplies large polynomials and divide()
+ *  divides them, one of polynomial_backend.  Dense multivariate polynomials
+ *  are mapped to univariate ones by Kronecker substitution, x_i = t^(s_i),
+ *  which are multiplied by Karatsuba's method, the others are multiplied
+ *  term by term through a heap.  Only the heap algorithm uses the threads
+ *  of set_expand_threads().
+ *
+ *  @return previous setting */
+unsigned set_polynomial_backend(unsigned b);
+
+/** The setting of set_polynomial_backend(). */
+unsigned get_polynomial_backend();
+
 } // namespace GiNaC
 
 #endif // ndef GINAC_MUL_H
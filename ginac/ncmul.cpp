@@ -112,11 +112,69 @@ void ncmul::do_print_csrc(const print_context & c, unsigned level) const
 
 bool ncmul::info(unsigned inf) const
 {
+	switch (inf) {
+		case info_flags::has_indices: {
+			if (flags & status_flags::has_indices)
+				return true;
+			else if (flags & status_flags::has_no_indices)
+				return false;
+			for (exvector::const_iterator i = seq.begin(); i != seq.end(); ++i) {
+				if (i->info(info_flags::has_indices)) {
+					this->setflag(status_flags::has_indices);
+					this->clearflag(status_flags::has_no_indices);
+					return true;
+				}
+			}
+			this->clearflag(status_flags::has_indices);
+			this->setflag(status_flags::has_no_indices);
+			return false;
+		}
+	}
 	return inherited::info(inf);
 }
 
 typedef std::vector<std::size_t> uintvector;
 
+/** Split a factor of a noncommutative product into its commutative
+ *  coefficients and its noncommutative factors, flattening nested
+ *  products. */
+static void split_factor(const ex & e, exvector & coeffs, exvector & word)
+{
+	if (e.return_type() == return_types::commutative) {
+		if (!e.is_equal(_ex1))
+			coeffs.push_back(e);
+	} else if (is_exactly_a<ncmul>(e) || is_exactly_a<mul>(e)) {
+		for (size_t i=0; i<e.nops(); i++)
+			split_factor(e.op(i), coeffs, word);
+	} else
+		word.push_back(e);
+}
+
+namespace {
+
+/** One term of a factor of a noncommutative product, split for expansion. */
+struct split_term {
+	ex term;
+	exvector coeffs;
+	exvector word;
+	bool has_dummies;
+
+	void set(const ex & e)
+	{
+		term = e;
+		split_factor(e, coeffs, word);
+		has_dummies = !get_all_dummy_indices_safely(e).empty();
+	}
+
+	void append_to(exvector & c, exvector & w) const
+	{
+		c.insert(c.end(), coeffs.begin(), coeffs.end());
+		w.insert(w.end(), word.begin(), word.end());
+	}
+};
+
+} // anonymous namespace
+
 ex ncmul::expand(unsigned options) const
 {
 	// First, expand the children
@@ -126,7 +184,6 @@ ex ncmul::expand(unsigned options) const
 	// Now, look for all the factors that are sums and remember their
 	// position and number of terms.
 	uintvector positions_of_adds(expanded_seq.size());
-	uintvector number_of_add_operands(expanded_seq.size());
 
 	size_t number_of_adds = 0;
 	size_t number_of_expanded_terms = 1;
@@ -136,9 +193,7 @@ ex ncmul::expand(unsigned options) const
 	for (exvector::const_iterator cit=expanded_seq.begin(); cit!=last; ++cit) {
 		if (is_exactly_a<add>(*cit)) {
 			positions_of_adds[number_of_adds] = current_position;
-			size_t num_ops = cit->nops();
-			number_of_add_operands[number_of_adds] = num_ops;
-			number_of_expanded_terms *= num_ops;
+			number_of_expanded_terms *= cit->nops();
 			number_of_adds++;
 		}
 		++current_position;
@@ -153,39 +208,62 @@ ex ncmul::expand(unsigned options) const
 			return *this;
 	}
 
-	// Now, form all possible products of the terms of the sums with the
-	// remaining factors, and add them together
-	exvector distrseq;
-	distrseq.reserve(number_of_expanded_terms);
-
-	uintvector k(number_of_adds);
-
-	/* Rename indices in the static members of the product */
-	exvector expanded_seq_mod;
-	size_t j = 0;
+	// Split all terms once into commutative coefficients and noncommutative
+	// words, so that each product of terms can be formed by concatenation
+	// and needs to be evaluated only once
+	std::vector<std::vector<split_term> > terms(expanded_seq.size());
 	exvector va;
-
-	for (size_t i=0; i<expanded_seq.size(); i++) {
-		if (i == positions_of_adds[j]) {
-			expanded_seq_mod.push_back(_ex1);
+	for (size_t i=0, j=0; i<expanded_seq.size(); i++) {
+		if (j < number_of_adds && i == positions_of_adds[j]) {
+			const ex & s = expanded_seq[i];
+			terms[i].resize(s.nops());
+			for (size_t t=0; t<s.nops(); ++t)
+				terms[i][t].set(rename_dummy_indices_uniquely(va, s.op(t), true));
 			j++;
 		} else {
-			expanded_seq_mod.push_back(rename_dummy_indices_uniquely(va, expanded_seq[i], true));
+			terms[i].resize(1);
+			terms[i][0].set(rename_dummy_indices_uniquely(va, expanded_seq[i], true));
 		}
 	}
 
+	// Now, form all possible products of the terms of the sums with the
+	// remaining factors, and add them together
+	exvector distrseq;
+	distrseq.reserve(number_of_expanded_terms);
+
+	uintvector k(expanded_seq.size());
+	exvector pieces(expanded_seq.size());
+
 	while (true) {
-		exvector term = expanded_seq_mod;
-		for (size_t i=0; i<number_of_adds; i++) {
-			term[positions_of_adds[i]] = rename_dummy_indices_uniquely(va, expanded_seq[positions_of_adds[i]].op(k[i]), true);
+		exvector coeffs, word;
+		bool renaming = false;
+		for (size_t i=0; i<terms.size(); i++)
+			renaming |= terms[i][k[i]].has_dummies;
+
+		if (renaming) {
+			// Rename the dummy indices of the factors apart, as eval() would
+			for (size_t i=0; i<terms.size(); i++)
+				pieces[i] = terms[i][k[i]].term;
+			make_flat_inserter mf(pieces, true);
+			for (size_t i=0; i<terms.size(); i++) {
+				const split_term & t = terms[i][k[i]];
+				if (t.has_dummies)
+					split_factor(mf.handle_factor(t.term, _ex1), coeffs, word);
+				else
+					t.append_to(coeffs, word);
+			}
+		} else {
+			for (size_t i=0; i<terms.size(); i++)
+				terms[i][k[i]].append_to(coeffs, word);
 		}
 
-		distrseq.push_back((new ncmul(term, true))->
-		                    setflag(status_flags::dynallocated | (options == 0 ? status_flags::expanded : 0)));
+		if (!word.empty())
+			coeffs.push_back((new ncmul(word))->setflag(status_flags::dynallocated));
+		distrseq.push_back((new mul(coeffs))->setflag(status_flags::dynallocated));
 
 		// increment k[]
-		int l = number_of_adds-1;
-		while ((l>=0) && ((++k[l]) >= number_of_add_operands[l])) {
+		int l = terms.size()-1;
+		while ((l>=0) && ((++k[l]) >= terms[l].size())) {
 			k[l] = 0;
 			l--;
 		}
@@ -23,6 +23,10 @@
  *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
  */
 
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
 #include "normal.h"
 #include "basic.h"
 #include "ex.h"
@@ -30,6 +34,7 @@
 #include "constant.h"
 #include "expairseq.h"
 #include "fail.h"
+#include "hash_map.h"
 #include "inifcns.h"
 #include "lst.h"
 #include "mul.h"
@@ -40,11 +45,27 @@
 #include "matrix.h"
 #include "pseries.h"
 #include "symbol.h"
+#include "budget.h"
+#include "profile.h"
+#include "tasks.h"
 #include "utils.h"
 #include "polynomial/chinrem_gcd.h"
+#include "polynomial/modular_det.h"
+#include "polynomial/pgcd.h"
+#include "polynomial/prem_uvar.h"
+#include "polynomial/sparse_poly.h"
+#include "polynomial/upoly.h"
+#include "polynomial/zp_word.h"
 
 #include <algorithm>
+#include <list>
 #include <map>
+#include <stdint.h> // for uint64_t
+#if defined(GINAC_THREADSAFE_REFCOUNT) && defined(HAVE_PTHREAD_H)
+// The terms of a sum are only normalized concurrently if expressions may
+// be shared between threads at all.
+#define PARALLEL_NORMAL 1
+#endif
 
 namespace GiNaC {
 
@@ -61,30 +82,6 @@ namespace GiNaC {
 // polynomials)
 #define USE_TRIAL_DIVISION 0
 
-// Set this to enable some statistical output for the GCD routines
-#define STATISTICS 0
-
-
-#if STATISTICS
-// Statistics variables
-static int gcd_called = 0;
-static int sr_gcd_called = 0;
-static int heur_gcd_called = 0;
-static int heur_gcd_failed = 0;
-
-// Print statistics at end of program
-static struct _stat_print {
-	_stat_print() {}
-	~_stat_print() {
-		std::cout << "gcd() called " << gcd_called << " times\n";
-		std::cout << "sr_gcd() called " << sr_gcd_called << " times\n";
-		std::cout << "heur_gcd() called " << heur_gcd_called << " times\n";
-		std::cout << "heur_gcd() failed " << heur_gcd_failed << " times\n";
-	}
-} stat_print;
-#endif
-
-
 /** Return pointer to first symbol found in expression.  Due to GiNaC's
  *  internal ordering of terms, it may not be obvious which symbol this
  *  function returns for a given expression.
@@ -356,6 +353,129 @@ numeric mul::integer_content() const
  *  Polynomial quotients and remainders
  */
 
+/** Largest degree of polynomials divided as dense vectors of integers by
+ *  univariate_division(). */
+static const int upoly_division_max_degree = 1 << 20;
+
+/** Split a term of an expanded polynomial into its rational coefficient c
+ *  and the exponent deg of x.  Returns false if the term is not of the form
+ *  c*x^deg. */
+static bool univariate_term(int &deg, cln::cl_RA &c, const ex &t, const ex &x)
+{
+	if (is_exactly_a<numeric>(t)) {
+		if (!t.info(info_flags::rational))
+			return false;
+		c = cln::the<cln::cl_RA>(ex_to<numeric>(t).to_cl_N());
+		deg = 0;
+		return true;
+	}
+	if (t.is_equal(x)) {
+		c = 1;
+		deg = 1;
+		return true;
+	}
+	if (is_exactly_a<power>(t)) {
+		if (!t.op(0).is_equal(x) || !t.op(1).info(info_flags::posint))
+			return false;
+		const numeric &e = ex_to<numeric>(t.op(1));
+		if (e > upoly_division_max_degree)
+			return false;
+		c = 1;
+		deg = e.to_int();
+		return true;
+	}
+	if (is_exactly_a<mul>(t) && t.nops() == 2 && is_exactly_a<numeric>(t.op(1))) {
+		// The numeric coefficient comes last
+		int zero_deg;
+		cln::cl_RA one;
+		return univariate_term(zero_deg, c, t.op(1), x)
+		    && univariate_term(deg, one, t.op(0), x);
+	}
+	return false;
+}
+
+/** Convert the expanded polynomial e in Q[x] into the integer polynomial p
+ *  with e = p/den.  Returns false if e is not a polynomial in x alone with
+ *  rational coefficients. */
+static bool upoly_from_ex(upoly &p, cln::cl_I &den, const ex &e, const ex &x)
+{
+	const std::size_t nterms = is_exactly_a<add>(e) ? e.nops() : 1;
+	std::vector<int> degs(nterms);
+	std::vector<cln::cl_RA> coeffs(nterms);
+	int deg = 0;
+	den = 1;
+	for (std::size_t i = 0; i < nterms; ++i) {
+		if (!univariate_term(degs[i], coeffs[i], nterms > 1 ? e.op(i) : e, x))
+			return false;
+		deg = std::max(deg, degs[i]);
+		den = cln::lcm(den, cln::denominator(coeffs[i]));
+	}
+	p.assign(deg + 1, cln::cl_I(0));
+	for (std::size_t i = 0; i < nterms; ++i)
+		p[degs[i]] = p[degs[i]] + cln::numerator(coeffs[i]*den);
+	canonicalize(p);
+	return true;
+}
+
+/** The polynomial p/den in x as an expression. */
+static ex upoly_to_ex(const upoly &p, const cln::cl_RA &den, const ex &x)
+{
+	exvector terms;
+	for (std::size_t i = 0; i < p.size(); ++i) {
+		if (cln::zerop(p[i]))
+			continue;
+		terms.push_back(numeric(p[i]/den) * power(x, i));
+	}
+	return (new add(terms))->setflag(status_flags::dynallocated);
+}
+
+enum univariate_division_result {
+	uvar_quo,
+	uvar_rem,
+	uvar_prem,
+	uvar_sprem
+};
+
+/** Quotient, remainder, pseudo-remainder or sparse pseudo-remainder, as
+ *  computed by quo(), rem(), prem() and sprem(), of the expanded
+ *  polynomials a and b in x alone.  The division is done once on vectors
+ *  of integer coefficients (by sparse_pseudo_divide()) instead of
+ *  extracting coefficients and expanding products term by term.  Returns
+ *  false if a or b involve other symbols or irrational coefficients. */
+static bool univariate_division(ex &result, const ex &a, const ex &b, const ex &x,
+                                univariate_division_result what)
+{
+	if (!is_a<symbol>(x))
+		return false;
+	upoly ua, ub;
+	cln::cl_I da, db;
+	if (!upoly_from_ex(ua, da, a, x) || !upoly_from_ex(ub, db, b, x) || ub.empty())
+		return false;
+
+	// With beta the leading coefficient of ub, beta^steps*ua = ub*q + r
+	upoly q, r;
+	const std::size_t steps = sparse_pseudo_divide(q, r, ua, ub);
+	const cln::cl_I beta_steps = cln::expt_pos(lcoeff(ub), steps);
+	switch (what) {
+	case uvar_quo:
+		result = upoly_to_ex(q, (da*beta_steps)/db, x);
+		break;
+	case uvar_rem:
+		result = upoly_to_ex(r, da*beta_steps, x);
+		break;
+	case uvar_prem: {
+		const std::size_t delta = ua.size() < ub.size() ? 0 : ua.size() - ub.size() + 1;
+		const cln::cl_I scale = cln::expt_pos(lcoeff(ub), delta - steps);
+		result = upoly_to_ex(r, (da*cln::expt_pos(db, delta))/scale, x);
+		break;
+	}
+	case uvar_sprem:
+		result = upoly_to_ex(r, da*cln::expt_pos(db, steps), x);
+		break;
+	}
+	return true;
+}
+
 /** Quotient q(x) of polynomials a(x) and b(x) in Q[x].
  *  It satisfies a(x)=b(x)*q(x)+r(x).
  *
@@ -382,6 +502,9 @@ ex quo(const ex &a, const ex &b, const ex &x, bool check_args)
 	ex r = a.expand();
 	if (r.is_zero())
 		return r;
+	ex q;
+	if (univariate_division(q, r, b.expand(), x, uvar_quo))
+		return q;
 	int bdeg = b.degree(x);
 	int rdeg = r.degree(x);
 	ex blcoeff = b.expand().coeff(x, bdeg);
@@ -436,6 +559,9 @@ ex rem(const ex &a, const ex &b, const ex &x, bool check_args)
 	ex r = a.expand();
 	if (r.is_zero())
 		return r;
+	ex ur;
+	if (univariate_division(ur, r, b.expand(), x, uvar_rem))
+		return ur;
 	int bdeg = b.degree(x);
 	int rdeg = r.degree(x);
 	ex blcoeff = b.expand().coeff(x, bdeg);
@@ -500,6 +626,9 @@ ex prem(const ex &a, const ex &b, const ex &x, bool check_args)
 	// Polynomial long division
 	ex r = a.expand();
 	ex eb = b.expand();
+	ex ur;
+	if (univariate_division(ur, r, eb, x, uvar_prem))
+		return ur;
 	int rdeg = r.degree(x);
 	int bdeg = eb.degree(x);
 	ex blcoeff;
@@ -552,6 +681,9 @@ ex sprem(const ex &a, const ex &b, const ex &x, bool check_args)
 	// Polynomial long division
 	ex r = a.expand();
 	ex eb = b.expand();
+	ex ur;
+	if (univariate_division(ur, r, eb, x, uvar_sprem))
+		return ur;
 	int rdeg = r.degree(x);
 	int bdeg = eb.degree(x);
 	ex blcoeff;
@@ -688,9 +820,18 @@ bool divide(const ex &a, const ex &b, ex &q, bool check_args)
 		q = _ex0;
 		return true;
 	}
+	const ex eb = b.expand();
+
+	// Polynomials in symbols with rational coefficients are divided in
+	// the packed sparse representation, which doesn't need all the
+	// intermediate expressions of the recursive algorithm below
+	const int divisible = sparse_poly_divide(q, r, eb);
+	if (divisible >= 0)
+		return divisible > 0;
+
 	int bdeg = b.degree(x);
 	int rdeg = r.degree(x);
-	ex blcoeff = b.expand().coeff(x, bdeg);
+	ex blcoeff = eb.coeff(x, bdeg);
 	bool blcoeff_is_numeric = is_exactly_a<numeric>(blcoeff);
 	exvector v; v.reserve(std::max(rdeg - bdeg + 1, 0));
 	while (rdeg >= bdeg) {
@@ -879,7 +1020,10 @@ static bool divide_in_z(const ex &a, const ex &b, ex &q, sym_desc_vec::const_ite
 	ex eb = b.expand();
 	ex blcoeff = eb.coeff(x, bdeg);
 	exvector v; v.reserve(std::max(rdeg - bdeg + 1, 0));
-	while (rdeg >= bdeg) {
+	// Most trial divisions fail, which is much cheaper to find out
+	// modulo a prime
+	const bool may_be_exact = may_divide(r, eb);
+	while (may_be_exact && rdeg >= bdeg) {
 		ex term, rcoeff = r.coeff(x, rdeg);
 		if (!divide_in_z(rcoeff, blcoeff, term, var+1))
 			break;
@@ -959,10 +1103,11 @@ ex ex::content(const ex &x) const
 	int ldeg = r.ldegree(x);
 	if (deg == ldeg)
 		return lcoeff * c / lcoeff.unit(x);
-	ex cont = _ex0;
+	exvector coeffs;
+	coeffs.reserve(deg - ldeg + 1);
 	for (int i=ldeg; i<=deg; i++)
-		cont = gcd(r.coeff(x, i), cont, NULL, NULL, false);
-	return cont * c;
+		coeffs.push_back(r.coeff(x, i));
+	return gcd(coeffs, false) * c;
 }
 
 
@@ -1075,9 +1220,8 @@ void ex::unitcontprim(const ex &x, ex &u, ex &c, ex &p) const
 
 static ex sr_gcd(const ex &a, const ex &b, sym_desc_vec::const_iterator var)
 {
-#if STATISTICS
-	sr_gcd_called++;
-#endif
+	profile_count(profile_sr_gcd_called);
+	trace_scope trace("sr_gcd", "degree_a", var->deg_a, "degree_b", var->deg_b);
 
 	// The first symbol is our main variable
 	const ex &x = var->sym;
@@ -1112,6 +1256,7 @@ static ex sr_gcd(const ex &a, const ex &b, sym_desc_vec::const_iterator var)
 	int delta = cdeg - ddeg;
 
 	for (;;) {
+		check_budget();
 
 		// Calculate polynomial pseudo-remainder
 		r = prem(c, d, x, false);
@@ -1284,9 +1429,8 @@ class gcdheu_failed {};
 static bool heur_gcd_z(ex& res, const ex &a, const ex &b, ex *ca, ex *cb,
 	               sym_desc_vec::const_iterator var)
 {
-#if STATISTICS
-	heur_gcd_called++;
-#endif
+	profile_count(profile_heur_gcd_called);
+	trace_scope trace("heur_gcd", "degree_a", var->deg_a, "degree_b", var->deg_b);
 
 	// Algorithm only works for non-vanishing input polynomials
 	if (a.is_zero() || b.is_zero())
@@ -1324,6 +1468,7 @@ static bool heur_gcd_z(ex& res, const ex &a, const ex &b, ex *ca, ex *cb,
 
 	// 6 tries maximum
 	for (int t=0; t<6; t++) {
+		check_budget();
 		if (xi.int_length() * maxdeg > 100000) {
 			throw gcdheu_failed();
 		}
@@ -1358,6 +1503,38 @@ static bool heur_gcd_z(ex& res, const ex &a, const ex &b, ex *ca, ex *cb,
 	return false;
 }
 
+/** Size limit in bits for the integers heur_gcd() maps the polynomials to.
+ *  Beyond that, the integer arithmetic is more expensive than a modular GCD,
+ *  and heur_gcd_z() would mostly give up anyway. */
+static const double heur_gcd_max_image_bits = 100000;
+
+/** Estimate whether heur_gcd() stands a chance with the polynomials a and b.
+ *  The heuristic algorithm substitutes integers for all variables, and the
+ *  resulting integers have about as many bits as the evaluation point, times
+ *  the size of a dense polynomial of the same degrees.  This gets very large
+ *  with many variables, high degrees or large coefficients.  The modular
+ *  algorithm only deals with the terms actually present, so it is
+ *  preferable then.
+ *
+ *  @param a  first rational multivariate polynomial (expanded)
+ *  @param b  second rational multivariate polynomial (expanded)
+ *  @param sym_stats  symbol statistics of a and b from get_symbol_stats()
+ *  @see gcd */
+static bool heur_gcd_promising(const ex &a, const ex &b, const sym_desc_vec &sym_stats)
+{
+	const numeric ma = a.max_coefficient(), mb = b.max_coefficient();
+	const numeric & m = (ma < mb ? ma : mb);
+	double bits = m.numer().int_length() + m.denom().int_length() + 2;
+	for (sym_desc_vec::const_iterator i = sym_stats.begin(); i != sym_stats.end(); ++i) {
+		bits *= i->max_deg + 1;
+		if (bits > heur_gcd_max_image_bits) {
+			profile_count(profile_heur_gcd_skipped);
+			return false;
+		}
+	}
+	return true;
+}
+
 /** Compute GCD of multivariate polynomials using the heuristic GCD algorithm.
  *  get_symbol_stats() must have been called previously with the input
  *  polynomials and an iterator to the first element of the sym_desc vector
@@ -1425,10 +1602,255 @@ static ex gcd_pf_pow(const ex& a, const ex& b, ex* ca, ex* cb);
 // large expressions). At least one of the arguments should be a product.
 static ex gcd_pf_mul(const ex& a, const ex& b, ex* ca, ex* cb);
 
+// Fingerprints
+
+namespace {
+
+/** The prime modulo which fingerprints are computed, 2^31-1. */
+const long fingerprint_prime = 0x7fffffffL;
+
+zp_word zp_power(zp_word x, unsigned long e)
+{
+	zp_word r = the_one(x);
+	while (e) {
+		if (e & 1)
+			r = r*x;
+		x = x*x;
+		e >>= 1;
+	}
+	return r;
+}
+
+/** Evaluation of rational functions modulo fingerprint_prime at the two
+ *  points of fingerprint(), bottom-up in one pass, remembering the values
+ *  of shared subexpressions. */
+class fingerprint_evaluator {
+public:
+	fingerprint_evaluator() : R(fingerprint_prime) { }
+
+	/** Values of e at both points.  Returns false if e is not a rational
+	 *  function with rational coefficients, or a denominator vanishes. */
+	bool eval(const ex & e, zp_word * v);
+
+private:
+	const zp_word_ring R;
+	std::map<const basic *, std::pair<zp_word, zp_word> > shared_values;
+};
+
+bool fingerprint_evaluator::eval(const ex & e, zp_word * v)
+{
+	const basic & b = ex_to<basic>(e);
+	const bool shared = b.nops() && b.get_refcount() > 1;
+	if (shared) {
+		std::map<const basic *, std::pair<zp_word, zp_word> >::const_iterator i = shared_values.find(&b);
+		if (i != shared_values.end()) {
+			v[0] = i->second.first;
+			v[1] = i->second.second;
+			return true;
+		}
+	}
+
+	if (is_exactly_a<numeric>(e)) {
+		if (!e.info(info_flags::rational))
+			return false;
+		const cln::cl_RA q = cln::the<cln::cl_RA>(ex_to<numeric>(e).to_cl_N());
+		const zp_word d(R, cln::denominator(q));
+		if (zerop(d))
+			return false;
+		v[0] = v[1] = zp_word(R, cln::numerator(q))*recip(d);
+	} else if (is_a<symbol>(e)) {
+		// Pseudo-random values from the hash, which depends on the serial
+		// number of the symbol
+		for (int k = 0; k < 2; ++k) {
+			uint64_t s = e.gethash() + k*0x9e3779b97f4a7c15ULL;
+			s = s*6364136223846793005ULL + 1442695040888963407ULL;
+			s = s*6364136223846793005ULL + 1442695040888963407ULL;
+			v[k] = zp_word(R, static_cast<long>(s >> 33));
+		}
+	} else if (is_exactly_a<add>(e) || is_exactly_a<mul>(e)) {
+		const bool sum = is_exactly_a<add>(e);
+		v[0] = v[1] = zp_word(R, sum ? 0L : 1L);
+		zp_word w[2];
+		for (size_t i = 0; i < e.nops(); ++i) {
+			if (!eval(e.op(i), w))
+				return false;
+			for (int k = 0; k < 2; ++k)
+				v[k] = sum ? v[k] + w[k] : v[k]*w[k];
+		}
+	} else if (is_exactly_a<power>(e)) {
+		const ex & exponent = e.op(1);
+		if (!exponent.info(info_flags::integer) || !(abs(ex_to<numeric>(exponent)) < fingerprint_prime))
+			return false;
+		const long n = ex_to<numeric>(exponent).to_long();
+		if (!eval(e.op(0), v))
+			return false;
+		for (int k = 0; k < 2; ++k) {
+			if (n < 0) {
+				if (zerop(v[k]))
+					return false;
+				v[k] = recip(v[k]);
+			}
+			v[k] = zp_power(v[k], n < 0 ? -n : n);
+		}
+	} else
+		return false;
+
+	if (shared)
+		shared_values.insert(std::make_pair(&b, std::make_pair(v[0], v[1])));
+	return true;
+}
+
+} // anonymous namespace
+
+/** Compute a fingerprint of the rational function e: its values modulo the
+ *  prime 2^31-1 at two fixed pseudo-random points, which depend on the
+ *  symbols only.  It is computed from the tree of e without expanding it,
+ *  with the values of shared subexpressions taken only once, and it is the
+ *  same for all forms of the same function, like factored and expanded
+ *  ones.  Different functions of degree d have the same fingerprint with a
+ *  probability of about (d/2^31)^2.  So fingerprints are cache keys
+ *  for polynomials and a fast test for inequality: if they differ, the
+ *  functions do.
+ *
+ *  The points are fixed for the lifetime of the symbols, but differ
+ *  between runs of a program.
+ *
+ *  @param e  rational function in symbols with rational coefficients
+ *  @param fp  the fingerprint (returned)
+ *  @return false if e is not such a function, or one of its denominators
+ *          vanishes at the points (fp is left untouched in that case) */
+bool fingerprint(const ex & e, poly_fingerprint & fp)
+{
+	fingerprint_evaluator f;
+	zp_word v[2];
+	if (!f.eval(e, v))
+		return false;
+	fp.value[0] = v[0].retract();
+	fp.value[1] = v[1].retract();
+	return true;
+}
+
+// GCD cache
+
+#ifdef GINAC_THREADSAFE_REFCOUNT
+#define GINAC_GCD_CACHE_THREAD_LOCAL __thread
+#else
+#define GINAC_GCD_CACHE_THREAD_LOCAL
+#endif
+
+namespace {
+
+/** A remembered GCD together with its cofactors. */
+struct gcd_cache_entry {
+	unsigned key;
+	unsigned options;
+	ex a, b;
+	ex g, ca, cb;
+	bool by_value;               ///< whether the key is from fingerprints
+	poly_fingerprint fa, fb;     ///< fingerprints of a and b if by_value
+};
+
+typedef std::list<gcd_cache_entry> gcd_cache_list;
+
+/** Remembered GCDs of one thread, the most recently used first.  The index
+ *  maps the fingerprints of the operands (see fingerprint()) to the
+ *  entries, or their hash values if they have none.  Entries are then
+ *  compared with is_equal(), or by expanding the difference if the
+ *  fingerprints match, so a GCD is found for other forms of its operands
+ *  as well. */
+struct gcd_cache {
+	gcd_cache_list entries;
+	std::size_t size;
+	std::multimap<unsigned, gcd_cache_list::iterator> index;
+	gcd_cache_statistics stats;
+
+	gcd_cache() : size(0)
+	{
+		stats.lookups = stats.hits = 0;
+		stats.size = 0;
+	}
+
+	void trim(std::size_t limit)
+	{
+		while (size > limit) {
+			gcd_cache_list::iterator last = --entries.end();
+			typedef std::multimap<unsigned, gcd_cache_list::iterator>::iterator index_iterator;
+			std::pair<index_iterator, index_iterator> r = index.equal_range(last->key);
+			for (index_iterator i = r.first; i != r.second; ++i) {
+				if (i->second == last) {
+					index.erase(i);
+					break;
+				}
+			}
+			entries.erase(last);
+			--size;
+		}
+		stats.size = size;
+	}
+};
+
+std::size_t gcd_cache_limit = 0;
+
+// The cache is private to each thread, which never releases it, except
+// for workers after each task.
+GINAC_GCD_CACHE_THREAD_LOCAL gcd_cache * the_gcd_cache = 0;
+
+void release_gcd_cache()
+{
+	delete the_gcd_cache;
+	the_gcd_cache = 0;
+}
+
+gcd_cache & get_gcd_cache()
+{
+	if (!the_gcd_cache) {
+		the_gcd_cache = new gcd_cache;
+		at_task_end(release_gcd_cache);
+	}
+	return *the_gcd_cache;
+}
+
+} // anonymous namespace
+
+/** Set the maximum number of GCDs remembered by gcd().  The cache is private
+ *  to each thread and evicts the least recently used GCD when it is full.
+ *  A limit of 0 (the default) switches caching off and empties the cache of
+ *  the calling thread; other threads drop their surplus GCDs on their next
+ *  call of gcd().
+ *
+ *  @return previous limit */
+std::size_t set_gcd_cache_size(std::size_t n)
+{
+	const std::size_t previous = gcd_cache_limit;
+	gcd_cache_limit = n;
+	if (the_gcd_cache)
+		the_gcd_cache->trim(n);
+	return previous;
+}
+
+/** Get the GCD cache counters of the calling thread. */
+gcd_cache_statistics get_gcd_cache_statistics()
+{
+	return get_gcd_cache().stats;
+}
+
+/** Reset the lookup and hit counters of the calling thread. */
+void reset_gcd_cache_statistics()
+{
+	gcd_cache & cache = get_gcd_cache();
+	cache.stats.lookups = cache.stats.hits = 0;
+}
+
+static ex gcd_uncached(const ex &a, const ex &b, ex *ca, ex *cb, bool check_args, unsigned options);
+
 /** Compute GCD (Greatest Common Divisor) of multivariate polynomials a(X)
  *  and b(X) in Z[X]. Optionally also compute the cofactors of a and b,
  *  defined by a = ca * gcd(a, b) and b = cb * gcd(a, b).
  *
+ *  If set_gcd_cache_size() has set up a cache, the GCD is looked up there
+ *  first, and in case of a miss the GCD and both cofactors are computed and
+ *  remembered.
+ *
  *  @param a  first multivariate polynomial
  *  @param b  second multivariate polynomial
  *  @param ca pointer to expression that will receive the cofactor of a, or NULL
@@ -1438,9 +1860,64 @@ static ex gcd_pf_mul(const ex& a, const ex& b, ex* ca, ex* cb);
  *  @return the GCD as a new expression */
 ex gcd(const ex &a, const ex &b, ex *ca, ex *cb, bool check_args, unsigned options)
 {
-#if STATISTICS
-	gcd_called++;
-#endif
+	profile_timer timer(profile_gcd);
+	trace_scope trace("gcd", "nops_a", a.nops(), "nops_b", b.nops());
+	check_budget();
+	if (gcd_cache_limit == 0 || (is_exactly_a<numeric>(a) && is_exactly_a<numeric>(b)))
+		return gcd_uncached(a, b, ca, cb, check_args, options);
+
+	gcd_cache & cache = get_gcd_cache();
+	++cache.stats.lookups;
+	poly_fingerprint fa = { { 0, 0 } }, fb = fa;
+	const bool by_value = fingerprint(a, fa) && fingerprint(b, fb);
+	const unsigned key = (by_value ? rotate_left(fa.value[0] ^ fa.value[1]) ^ fb.value[0] ^ fb.value[1]
+	                               : rotate_left(a.gethash()) ^ b.gethash()) ^ options;
+	typedef std::multimap<unsigned, gcd_cache_list::iterator>::const_iterator index_iterator;
+	std::pair<index_iterator, index_iterator> r = cache.index.equal_range(key);
+	for (index_iterator i = r.first; i != r.second; ++i) {
+		const gcd_cache_list::iterator e = i->second;
+		if (e->options != options)
+			continue;
+		bool same = e->a.is_equal(a) && e->b.is_equal(b);
+		if (!same && by_value && e->by_value && e->fa == fa && e->fb == fb)
+			same = (e->a - a).expand().is_zero() && (e->b - b).expand().is_zero();
+		if (same) {
+			++cache.stats.hits;
+			cache.entries.splice(cache.entries.begin(), cache.entries, e);
+			if (ca)
+				*ca = e->ca;
+			if (cb)
+				*cb = e->cb;
+			return e->g;
+		}
+	}
+
+	gcd_cache_entry e;
+	e.key = key;
+	e.options = options;
+	e.a = a;
+	e.b = b;
+	e.by_value = by_value;
+	e.fa = fa;
+	e.fb = fb;
+	e.g = gcd_uncached(a, b, &e.ca, &e.cb, check_args, options);
+	cache.entries.push_front(e);
+	cache.index.insert(std::make_pair(key, cache.entries.begin()));
+	++cache.size;
+	cache.trim(gcd_cache_limit);
+	if (ca)
+		*ca = e.ca;
+	if (cb)
+		*cb = e.cb;
+	return e.g;
+}
+
+/** Compute GCD (Greatest Common Divisor) of multivariate polynomials a(X)
+ *  and b(X) in Z[X], bypassing the cache.
+ *  @see gcd */
+static ex gcd_uncached(const ex &a, const ex &b, ex *ca, ex *cb, bool check_args, unsigned options)
+{
+	profile_count(profile_gcd_called);
 
 	// GCD of numerics -> CLN
 	if (is_exactly_a<numeric>(a) && is_exactly_a<numeric>(b)) {
@@ -1603,9 +2080,10 @@ ex gcd(const ex &a, const ex &b, ex *ca, ex *cb, bool check_args, unsigned optio
 		return g;
 	}
 
-	// Try heuristic algorithm first, fall back to PRS if that failed
+	// Try heuristic algorithm first, unless it is bound to fail, and fall
+	// back to the modular algorithm or to PRS
 	ex g;
-	if (!(options & gcd_options::no_heur_gcd)) {
+	if (!(options & gcd_options::no_heur_gcd) && heur_gcd_promising(aex, bex, sym_stats)) {
 		bool found = heur_gcd(g, aex, bex, ca, cb, var);
 		if (found) {
 			// heur_gcd have already computed cofactors...
@@ -1618,20 +2096,26 @@ ex gcd(const ex &a, const ex &b, ex *ca, ex *cb, bool check_args, unsigned optio
 			}
 			return g;
 		}
-#if STATISTICS
-		else {
-			heur_gcd_failed++;
-		}
-#endif
+		profile_count(profile_heur_gcd_failed);
 	}
-	if (options & gcd_options::use_sr_gcd) {
-		g = sr_gcd(aex, bex, var);
-	} else {
+	bool found = false;
+	if (!(options & gcd_options::use_sr_gcd)) {
 		exvector vars;
 		for (std::size_t n = sym_stats.size(); n-- != 0; )
 			vars.push_back(sym_stats[n].sym);
-		g = chinrem_gcd(aex, bex, vars);
+		profile_count(profile_chinrem_gcd_called);
+		try {
+			trace_scope trace("chinrem_gcd", "variables", vars.size());
+			g = chinrem_gcd(aex, bex, vars);
+			found = true;
+		} catch (const chinrem_gcd_failed &) {
+			profile_count(profile_chinrem_gcd_gave_up);
+		} catch (const pgcd_failed &) {
+			profile_count(profile_chinrem_gcd_gave_up);
+		}
 	}
+	if (!found)
+		g = sr_gcd(aex, bex, var);
 
 	if (g.is_equal(_ex1)) {
 		// Keep cofactors factored if possible
@@ -1762,6 +2246,103 @@ static ex gcd_pf_mul(const ex& a, const ex& b, ex* ca, ex* cb)
 	return (new mul(g))->setflag(status_flags::dynallocated);
 }
 
+/** Make a polynomial unit normal, i.e. the leading coefficient in the first
+ *  symbol as defined by get_first_symbol() positive. */
+static ex make_unit_normal(const ex &e)
+{
+	ex x;
+	if (is_exactly_a<numeric>(e))
+		return ex_to<numeric>(e).is_negative() ? -e : e;
+	if (get_first_symbol(e, x) && ex_to<numeric>(e.unit(x)).is_negative())
+		return -e;
+	return e;
+}
+
+/** Compute the GCD of the multivariate polynomials p[0], p[1], ... in Z[X]
+ *  at once.  Instead of folding gcd() over them one by one, their integer
+ *  contents are split off and the GCD of the smallest primitive part and a
+ *  linear combination of the others with pseudo-random coefficients is
+ *  computed.  That is the GCD of all of them with high probability, which
+ *  is checked by trial divisions; the rare polynomials failing the check
+ *  are folded in.  The computation stops as soon as the GCD is known to be
+ *  a number.  Polynomials with non-integer coefficients are folded with
+ *  gcd(), stopping when the GCD becomes 1.
+ *
+ *  @param p  multivariate polynomials
+ *  @param check_args  check whether the p[i] are polynomials with rational
+ *         coefficients (defaults to "true")
+ *  @return the GCD as a new expression, unit normal (0 if all p[i] are 0) */
+ex gcd(const exvector &p, bool check_args, unsigned options)
+{
+	trace_scope trace("gcd", "polynomials", p.size());
+	exvector polys;
+	bool integer = true;
+	for (exvector::const_iterator i = p.begin(); i != p.end(); ++i) {
+		if (check_args && !i->info(info_flags::rational_polynomial))
+			throw(std::invalid_argument("gcd: arguments must be polynomials over the rationals"));
+		const ex e = i->expand();
+		if (e.is_zero())
+			continue;
+		polys.push_back(e);
+		integer = integer && e.info(info_flags::integer_polynomial);
+	}
+	if (polys.empty())
+		return _ex0;
+
+	if (!integer) {
+		ex g = polys[0];
+		for (std::size_t i = 1; i < polys.size() && !g.is_equal(_ex1); ++i)
+			g = gcd(g, polys[i], NULL, NULL, false, options);
+		return make_unit_normal(g);
+	}
+
+	// gcd(a, b) = gcd(content(a), content(b)) * gcd(pp(a), pp(b))
+	numeric content = *_num0_p;
+	exvector prim;
+	prim.reserve(polys.size());
+	std::size_t smallest = 0;
+	bool constant = false;
+	for (std::size_t i = 0; i < polys.size(); ++i) {
+		const numeric c = polys[i].integer_content();
+		content = gcd(content, c);
+		prim.push_back((polys[i] * c.inverse()).expand());
+		constant = constant || is_exactly_a<numeric>(prim[i]);
+		if (prim[i].nops() < prim[smallest].nops())
+			smallest = i;
+	}
+	if (constant)
+		return content;
+
+	ex g = prim[smallest];
+	if (prim.size() > 1) {
+		// A fixed sequence of multipliers keeps the results reproducible
+		unsigned long seed = 12345;
+		exvector terms;
+		for (std::size_t i = 0; i < prim.size(); ++i) {
+			if (i == smallest)
+				continue;
+			seed = (seed * 1103515245UL + 12345UL) & 0x7fffffffUL;
+			terms.push_back(prim[i] * numeric(long(1 + (seed >> 8) % 1000)));
+		}
+		const ex combination = (new add(terms))->setflag(status_flags::dynallocated);
+		g = gcd(g, combination.expand(), NULL, NULL, false, options);
+		if (is_exactly_a<numeric>(g))
+			return content;
+		g = (g * g.integer_content().inverse()).expand();
+
+		for (std::size_t i = 0; i < prim.size(); ++i) {
+			ex q;
+			if (i == smallest || divide(prim[i], g, q, false))
+				continue;
+			g = gcd(g, prim[i], NULL, NULL, false, options);
+			if (is_exactly_a<numeric>(g))
+				return content;
+			g = (g * g.integer_content().inverse()).expand();
+		}
+	}
+	return make_unit_normal(g) * content;
+}
+
 /** Compute LCM (Least Common Multiple) of multivariate polynomials in Z[X].
  *
  *  @param a  first multivariate polynomial
@@ -1796,19 +2377,26 @@ ex lcm(const ex &a, const ex &b, bool check_args)
 static exvector sqrfree_yun(const ex &a, const symbol &x)
 {
 	exvector res;
+	// Most polynomials are square free, and a modular image usually proves
+	// that much faster than the GCD with the derivative.  The GCD then
+	// doesn't depend on x, so it is 1 unless a has a nontrivial content.
+	if (squarefree_in(a, x) && a.content(x).is_equal(_ex1)) {
+		res.push_back(a);
+		return res;
+	}
 	ex w = a;
 	ex z = w.diff(x);
-	ex g = gcd(w, z);
+	// The cofactors w/g and z/g come with the GCD, no divisions needed
+	ex cw, cz;
+	ex g = gcd(w, z, &cw, &cz);
 	if (g.is_equal(_ex1)) {
 		res.push_back(a);
 		return res;
 	}
-	ex y;
 	do {
-		w = quo(w, g, x);
-		y = quo(z, g, x);
-		z = y - w.diff(x);
-		g = gcd(w, z);
+		w = cw;
+		z = cz - w.diff(x);
+		g = gcd(w, z, &cw, &cz);
 		res.push_back(g);
 	} while (!z.is_zero());
 	return res;
@@ -1917,8 +2505,152 @@ ex sqrfree(const ex &a, const lst &l)
 }
 
 
+namespace {
+
+/** e as a polynomial in x, with the coefficients of the powers of x in
+ *  normal form.  Keeps the coefficients of the extended Euclidean
+ *  algorithm, which are rational functions of the other symbols, small. */
+ex normal_coeffs(const ex & e, const symbol & x)
+{
+	const ex p = e.expand();
+	if (p.is_zero())
+		return p;
+	const int deg = p.degree(x), ldeg = p.ldegree(x);
+	exvector terms;
+	terms.reserve(deg - ldeg + 1);
+	for (int k = ldeg; k <= deg; ++k) {
+		const ex c = p.coeff(x, k).normal();
+		if (!c.is_zero())
+			terms.push_back(c * pow(x, k));
+	}
+	return (new add(terms))->setflag(status_flags::dynallocated);
+}
+
+/** The inverse of a modulo b, two coprime polynomials in x, by the extended
+ *  Euclidean algorithm over the rational functions in the other symbols.
+ *  Only the cofactors of a are computed: s*a is r modulo b at each step. */
+ex inverse_mod(const ex & a, const ex & b, const symbol & x)
+{
+	ex r_prev = b, r = normal_coeffs(rem(a, b, x, false), x);
+	ex s_prev = _ex0, s = _ex1;
+	while (!r.is_zero() && r.degree(x) > 0) {
+		const ex q = quo(r_prev, r, x, false);
+		const ex r_next = normal_coeffs(r_prev - q * r, x);
+		const ex s_next = normal_coeffs(s_prev - q * s, x);
+		r_prev = r;
+		r = r_next;
+		s_prev = s;
+		s = s_next;
+	}
+	if (r.is_zero())
+		throw std::logic_error("sqrfree_parfrac(): factors are not coprime");
+	return normal_coeffs(s / r, x);
+}
+
+/** The numerators of the partial fractions of the square-free factor
+ *  factors[i] of multiplicity mult[i] in the decomposition of numer divided
+ *  by the product of all factors.  numerators[j] belongs to the power j+1
+ *  of the factor.  The numerator for its largest power, numer divided by
+ *  the product of the other factors modulo this one, is expanded in powers
+ *  of the factor. */
+void parfrac_numerators(const exvector & factors, const std::vector<unsigned> & mult, size_t i,
+                        const ex & numer, const symbol & x, exvector & numerators)
+{
+	const ex & y = factors[i];
+	const ex p = pow(y, mult[i]).expand();
+	ex cofactor = _ex1;
+	for (size_t k = 0; k < factors.size(); ++k)
+		if (k != i)
+			cofactor *= pow(factors[k], mult[k]);
+	const ex inv = inverse_mod(cofactor.expand(), p, x);
+	ex r = normal_coeffs(rem(normal_coeffs(numer * inv, x), p, x, false), x);
+	numerators.resize(mult[i]);
+	for (size_t j = mult[i]; j-- > 0; ) {
+		numerators[j] = normal_coeffs(rem(r, y, x, false), x);
+		r = normal_coeffs(quo(r, y, x, false), x);
+	}
+}
+
+#ifdef PARALLEL_NORMAL
+
+/** Partial fractions of some of the factors, to be run as a task. */
+struct parfrac_job {
+	exvector factors;
+	std::vector<unsigned> mult;
+	ex numer;
+	ex x;
+	std::vector<size_t> which;
+	std::vector<exvector> numerators;
+	bool failed;
+};
+
+void * run_parfrac_job(void * arg)
+{
+	parfrac_job & job = *static_cast<parfrac_job *>(arg);
+	try {
+		job.numerators.resize(job.which.size());
+		for (size_t n = 0; n < job.which.size(); ++n)
+			parfrac_numerators(job.factors, job.mult, job.which[n], job.numer,
+			                   ex_to<symbol>(job.x), job.numerators[n]);
+	} catch (...) {
+		job.failed = true;
+	}
+	return 0;
+}
+
+#endif // def PARALLEL_NORMAL
+
+} // anonymous namespace
+
+#ifdef PARALLEL_NORMAL
+
+/** Compute the numerators of the factors concurrently, in slices run as
+ *  tasks (the first one by the calling thread).
+ *  @return false if they have to be computed one by one instead */
+static bool parfrac_numerators_parallel(const exvector & factors, const std::vector<unsigned> & mult,
+                                        const ex & numer, const symbol & x,
+                                        std::vector<exvector> & numerators)
+{
+	const std::size_t nthreads = std::min<std::size_t>(get_normal_threads(), factors.size());
+	std::vector<parfrac_job> jobs(nthreads);
+	for (std::size_t k = 0; k < nthreads; ++k) {
+		parfrac_job & job = jobs[k];
+		if (k == 0) {
+			job.factors = factors;
+			job.numer = numer;
+		} else {
+			job.factors.resize(factors.size());
+			for (std::size_t i = 0; i < factors.size(); ++i)
+				if (!copy_numbers(factors[i], job.factors[i]))
+					return false;
+			if (!copy_numbers(numer, job.numer))
+				return false;
+		}
+		job.mult = mult;
+		job.x = x;
+		for (std::size_t i = factors.size() * k / nthreads; i < factors.size() * (k + 1) / nthreads; ++i)
+			job.which.push_back(i);
+		job.failed = false;
+	}
+
+	run_tasks(run_parfrac_job, jobs);
+	for (std::size_t k = 0; k < nthreads; ++k) {
+		if (jobs[k].failed)
+			return false;
+		for (std::size_t n = 0; n < jobs[k].which.size(); ++n)
+			numerators[jobs[k].which[n]].swap(jobs[k].numerators[n]);
+	}
+	return true;
+}
+
+#endif // def PARALLEL_NORMAL
+
 /** Compute square-free partial fraction decomposition of rational function
- *  a(x).
+ *  a(x).  The numerators for each square-free factor of the denominator
+ *  come from the inverse of the other factors modulo this one, by the
+ *  extended Euclidean algorithm, and are independent of each other, so
+ *  they are computed by as many threads as normal() uses (see
+ *  set_normal_threads()).
  *
  *  @param a rational function over Z[x], treated as univariate polynomial
  *           in x
@@ -1929,61 +2661,46 @@ ex sqrfree_parfrac(const ex & a, const symbol & x)
 	// Find numerator and denominator
 	ex nd = numer_denom(a);
 	ex numer = nd.op(0), denom = nd.op(1);
-//clog << "numer = " << numer << ", denom = " << denom << endl;
 
 	// Convert N(x)/D(x) -> Q(x) + R(x)/D(x), so degree(R) < degree(D)
 	ex red_poly = quo(numer, denom, x), red_numer = rem(numer, denom, x).expand();
-//clog << "red_poly = " << red_poly << ", red_numer = " << red_numer << endl;
+	if (red_numer.is_zero())
+		return red_poly;
 
-	// Factorize denominator and compute cofactors
+	// Factorize denominator, the factors of degree 0 in x go into a
+	// constant along with what sqrfree_yun() leaves out
 	exvector yun = sqrfree_yun(denom, x);
-//clog << "yun factors: " << exprseq(yun) << endl;
-	size_t num_yun = yun.size();
-	exvector factor; factor.reserve(num_yun);
-	exvector cofac; cofac.reserve(num_yun);
-	for (size_t i=0; i<num_yun; i++) {
-		if (!yun[i].is_equal(_ex1)) {
-			for (size_t j=0; j<=i; j++) {
-				factor.push_back(pow(yun[i], j+1));
-				ex prod = _ex1;
-				for (size_t k=0; k<num_yun; k++) {
-					if (k == i)
-						prod *= pow(yun[k], i-j);
-					else
-						prod *= pow(yun[k], k+1);
-				}
-				cofac.push_back(prod.expand());
-			}
+	exvector factors;
+	std::vector<unsigned> mult;
+	ex lcoeff = _ex1;
+	for (size_t i=0; i<yun.size(); i++) {
+		if (yun[i].degree(x) > 0) {
+			factors.push_back(yun[i]);
+			mult.push_back(i + 1);
+			lcoeff *= pow(yun[i].lcoeff(x), i + 1);
 		}
 	}
-	size_t num_factors = factor.size();
-//clog << "factors  : " << exprseq(factor) << endl;
-//clog << "cofactors: " << exprseq(cofac) << endl;
-
-	// Construct coefficient matrix for decomposition
-	int max_denom_deg = denom.degree(x);
-	matrix sys(max_denom_deg + 1, num_factors);
-	matrix rhs(max_denom_deg + 1, 1);
-	for (int i=0; i<=max_denom_deg; i++) {
-		for (size_t j=0; j<num_factors; j++)
-			sys(i, j) = cofac[j].coeff(x, i);
-		rhs(i, 0) = red_numer.coeff(x, i);
-	}
-//clog << "coeffs: " << sys << endl;
-//clog << "rhs   : " << rhs << endl;
+	const ex unit = (denom.lcoeff(x) / lcoeff).normal();
+	red_numer = normal_coeffs(red_numer / unit, x);
 
-	// Solve resulting linear system
-	matrix vars(num_factors, 1);
-	for (size_t i=0; i<num_factors; i++)
-		vars(i, 0) = symbol();
-	matrix sol = sys.solve(vars, rhs);
+	std::vector<exvector> numerators(factors.size());
+	bool done = false;
+#ifdef PARALLEL_NORMAL
+	if (get_normal_threads() > 1 && factors.size() > 1)
+		done = parfrac_numerators_parallel(factors, mult, red_numer, x, numerators);
+#endif
+	if (!done)
+		for (size_t i=0; i<factors.size(); i++)
+			parfrac_numerators(factors, mult, i, red_numer, x, numerators[i]);
 
 	// Sum up decomposed fractions
-	ex sum = 0;
-	for (size_t i=0; i<num_factors; i++)
-		sum += sol(i, 0) / factor[i];
-
-	return red_poly + sum;
+	exvector sum;
+	sum.push_back(red_poly);
+	for (size_t i=0; i<factors.size(); i++)
+		for (size_t j=0; j<numerators[i].size(); j++)
+			if (!numerators[i][j].is_zero())
+				sum.push_back(numerators[i][j] / pow(factors[i], j + 1));
+	return (new add(sum))->setflag(status_flags::dynallocated);
 }
 
 
@@ -2000,12 +2717,187 @@ ex sqrfree_parfrac(const ex & a, const symbol & x)
  */
 
 
+// Cache of normal forms
+
+#ifdef GINAC_THREADSAFE_REFCOUNT
+#define GINAC_NORMAL_CACHE_THREAD_LOCAL __thread
+#else
+#define GINAC_NORMAL_CACHE_THREAD_LOCAL
+#endif
+
+namespace {
+
+typedef std::map<const basic *, ex> normal_form_map;
+
+/** Normal forms {numerator, denominator} remembered by normal().  The
+ *  objects are not referenced by the cache, an object flagged with
+ *  status_flags::normal_cached removes its entry in its destructor, see
+ *  basic::forget_normal_form(). */
+struct normal_cache {
+	normal_form_map forms;
+	normal_cache_statistics stats;
+
+	normal_cache()
+	{
+		stats.lookups = stats.hits = 0;
+		stats.size = 0;
+	}
+};
+
+/** The cache is never destroyed, because objects with remembered normal
+ *  forms may still be around during static destruction. */
+normal_cache & the_normal_cache()
+{
+	static normal_cache * cache = new normal_cache;
+	return *cache;
+}
+
+bool normal_caching_enabled = false;
+
+#ifdef GINAC_THREADSAFE_REFCOUNT
+int normal_cache_mutex = 0;
+
+/** Scoped spin lock around accesses to the cache.  No expression may be
+ *  destroyed while it is held, because that might call forget_normal_form(). */
+class normal_cache_lock {
+public:
+	normal_cache_lock() { while (__sync_lock_test_and_set(&normal_cache_mutex, 1)) ; }
+	~normal_cache_lock() { __sync_lock_release(&normal_cache_mutex); }
+};
+#else
+class normal_cache_lock {
+public:
+	normal_cache_lock() {}
+};
+#endif
+
+/** Number of temporary symbols handed out by replace_with_symbol() in this
+ *  thread.  A normal form computed without any of them doesn't depend on
+ *  the rest of the expression, so it can be remembered. */
+GINAC_NORMAL_CACHE_THREAD_LOCAL unsigned long symbols_replaced = 0;
+
+/** Check if e contains the object p itself (not just an equal one). */
+bool contains_object(const ex & e, const basic * p)
+{
+	if (&ex_to<basic>(e) == p)
+		return true;
+	for (size_t i = 0; i < e.nops(); ++i)
+		if (contains_object(e.op(i), p))
+			return true;
+	return false;
+}
+
+} // anonymous namespace
+
+/** Look up the normal form {numerator, denominator} of this object. */
+bool basic::lookup_normal_form(ex & nd) const
+{
+	if (!normal_caching_enabled)
+		return false;
+	normal_cache_lock lock;
+	normal_cache & cache = the_normal_cache();
+	++cache.stats.lookups;
+	if (!(flags & status_flags::normal_cached))
+		return false;
+	normal_form_map::const_iterator i = cache.forms.find(this);
+	if (i == cache.forms.end())
+		return false;
+	nd = i->second;
+	++cache.stats.hits;
+	return true;
+}
+
+/** Remember the normal form {numerator, denominator} of this object. */
+void basic::remember_normal_form(const ex & nd) const
+{
+	// An object may be shared with its own normal form (e.g. by hash-consing),
+	// and the cache entry would then keep it alive forever.
+	if (!normal_caching_enabled || contains_object(nd, this))
+		return;
+	normal_cache_lock lock;
+	if (!normal_caching_enabled)
+		return;
+	normal_cache & cache = the_normal_cache();
+	if (cache.forms.insert(std::make_pair(this, nd)).second)
+		++cache.stats.size;
+	setflag(status_flags::normal_cached);
+}
+
+/** Remove the normal form of this object from the cache. */
+void basic::forget_normal_form() const
+{
+	ex nd;
+	{
+		normal_cache_lock lock;
+		clearflag(status_flags::normal_cached);
+		normal_cache & cache = the_normal_cache();
+		normal_form_map::iterator i = cache.forms.find(this);
+		if (i == cache.forms.end())
+			return;
+		nd = i->second;
+		cache.forms.erase(i);
+		--cache.stats.size;
+	}
+	// nd is destroyed here, outside of the lock
+}
+
+/** Switch the cache of normal forms on or off.  While it is on, add::normal(),
+ *  mul::normal() and power::normal() remember the normal form of every object
+ *  they have been called on (unless it contains temporary symbols, see
+ *  ex::normal()), and the next call on the same object just returns it.
+ *  Repeated normalization of slightly modified expressions only recomputes
+ *  the modified parts then.  Switching the cache off empties it.  Objects
+ *  which are modified in place forget their normal form, see
+ *  ex::makewriteable().
+ *
+ *  @return previous setting */
+bool set_normal_caching(bool enable)
+{
+	normal_form_map forms;
+	bool previous;
+	{
+		normal_cache_lock lock;
+		previous = normal_caching_enabled;
+		normal_caching_enabled = enable;
+		if (!enable) {
+			normal_cache & cache = the_normal_cache();
+			for (normal_form_map::const_iterator i = cache.forms.begin(); i != cache.forms.end(); ++i)
+				i->first->clearflag(status_flags::normal_cached);
+			forms.swap(cache.forms);
+			cache.stats.size = 0;
+		}
+	}
+	// the normal forms are destroyed here, outside of the lock
+	return previous;
+}
+
+bool get_normal_caching()
+{
+	return normal_caching_enabled;
+}
+
+normal_cache_statistics get_normal_cache_statistics()
+{
+	normal_cache_lock lock;
+	return the_normal_cache().stats;
+}
+
+void reset_normal_cache_statistics()
+{
+	normal_cache_lock lock;
+	normal_cache & cache = the_normal_cache();
+	cache.stats.lookups = cache.stats.hits = 0;
+}
+
+
 /** Create a symbol for replacing the expression "e" (or return a previously
  *  assigned symbol). The symbol and expression are appended to repl, for
  *  a later application of subs().
  *  @see ex::normal */
 static ex replace_with_symbol(const ex & e, exmap & repl, exmap & rev_lookup)
 {
+	++symbols_replaced;
+
 	// Expression already replaced? Then return the assigned symbol
 	exmap::const_iterator it = rev_lookup.find(e);
 	if (it != rev_lookup.end())
@@ -2014,7 +2906,7 @@ static ex replace_with_symbol(const ex & e, exmap & repl, exmap & rev_lookup)
 	// Otherwise create new symbol and add to list, taking care that the
 	// replacement expression doesn't itself contain symbols from repl,
 	// because subs() is not recursive
-	ex es = (new symbol)->setflag(status_flags::dynallocated);
+	ex es = symbol::temporary();
 	ex e_replaced = e.subs(repl, subs_options::no_pattern);
 	repl.insert(std::make_pair(es, e_replaced));
 	rev_lookup.insert(std::make_pair(e_replaced, es));
@@ -2036,7 +2928,7 @@ static ex replace_with_symbol(const ex & e, exmap & repl)
 	// Otherwise create new symbol and add to list, taking care that the
 	// replacement expression doesn't itself contain symbols from repl,
 	// because subs() is not recursive
-	ex es = (new symbol)->setflag(status_flags::dynallocated);
+	ex es = symbol::temporary();
 	ex e_replaced = e.subs(repl, subs_options::no_pattern);
 	repl.insert(std::make_pair(es, e_replaced));
 	return es;
@@ -2163,6 +3055,205 @@ static ex frac_cancel(const ex &n, const ex &d)
 }
 
 
+static unsigned normal_threads = 1;
+
+/** Set the number of threads add::normal() uses for normalizing the terms
+ *  of large sums.  This has an effect only if GiNaC was built with
+ *  GINAC_THREADSAFE_REFCOUNT and pthreads.
+ *
+ *  @return previous setting */
+unsigned set_normal_threads(unsigned n)
+{
+	const unsigned previous = normal_threads;
+	normal_threads = (n == 0 ? 1 : n);
+	return previous;
+}
+
+/** Get the number of threads used by add::normal(). */
+unsigned get_normal_threads()
+{
+	return normal_threads;
+}
+
+namespace {
+
+/** Map function making copies of all the numbers in an expression which
+ *  don't share any CLN heap object with the original.  CLN doesn't update
+ *  its reference counts atomically, so every thread needs its own numbers.
+ *  Only rational numbers can be copied that way, ok is cleared if there
+ *  are others. */
+struct number_copier : public map_function {
+	bool ok;
+	number_copier() : ok(true) {}
+
+	static cln::cl_RA copy(const cln::cl_RA & x)
+	{
+		const cln::cl_I num = cln::numerator(x) + 1;
+		const cln::cl_I den = cln::denominator(x) + 1;
+		return (num - 1) / (den - 1);
+	}
+
+	ex operator()(const ex & e)
+	{
+		if (!is_exactly_a<numeric>(e))
+			return e.map(*this);
+		const numeric & n = ex_to<numeric>(e);
+		if (n.is_rational())
+			return numeric(copy(cln::the<cln::cl_RA>(n.to_cl_N())));
+		if (!n.is_crational()) {
+			ok = false;
+			return e;
+		}
+		const numeric re = n.real(), im = n.imag();
+		return numeric(cln::complex(copy(cln::the<cln::cl_RA>(re.to_cl_N())),
+		                            copy(cln::the<cln::cl_RA>(im.to_cl_N()))));
+	}
+};
+
+} // anonymous namespace
+
+/** Copy of e in which no number shares a CLN heap object with e.
+ *  @return false if e contains numbers which are not (complex) rational */
+bool copy_numbers(const ex & e, ex & copy)
+{
+	number_copier copier;
+	copy = copier(e);
+	return copier.ok;
+}
+
+#ifdef PARALLEL_NORMAL
+
+namespace {
+
+/** Sums with fewer terms are normalized by the calling thread alone. */
+const std::size_t min_parallel_terms = 16;
+
+/** Normalization of a slice of the terms of a sum, to be run as a task.
+ *  It works on copies of the replacement maps, which are
+ *  merged into the original ones afterwards. */
+struct normal_job {
+	exvector terms;
+	exmap repl, rev_lookup;
+	int level;
+	exvector nums, dens;
+	unsigned long replaced;
+	bool failed;
+};
+
+void * run_normal_job(void * arg)
+{
+	normal_job & job = *static_cast<normal_job *>(arg);
+	const unsigned long before = symbols_replaced;
+	try {
+		for (exvector::const_iterator i = job.terms.begin(); i != job.terms.end(); ++i) {
+			ex n = ex_to<basic>(*i).normal(job.repl, job.rev_lookup, job.level);
+			job.nums.push_back(n.op(0));
+			job.dens.push_back(n.op(1));
+		}
+	} catch (...) {
+		job.failed = true;
+	}
+	job.replaced = symbols_replaced - before;
+	symbols_replaced = before;
+	return 0;
+}
+
+/** Normalize the terms concurrently, in slices run as tasks (the first
+ *  one by the calling thread).
+ *  @return false if the terms have to be normalized one by one instead */
+bool normal_terms_parallel(const exvector & terms, exvector & nums, exvector & dens,
+                           exmap & repl, exmap & rev_lookup, int level)
+{
+	const std::size_t nthreads = std::min<std::size_t>(normal_threads, terms.size());
+	std::vector<normal_job> jobs(nthreads);
+	for (std::size_t k = 0; k < nthreads; ++k) {
+		normal_job & job = jobs[k];
+		const std::size_t first = terms.size() * k / nthreads;
+		const std::size_t last = terms.size() * (k + 1) / nthreads;
+		for (std::size_t i = first; i < last; ++i) {
+			ex term = terms[i];
+			if (k > 0 && !copy_numbers(terms[i], term))
+				return false;
+			job.terms.push_back(term);
+		}
+		job.repl = repl;
+		job.rev_lookup = rev_lookup;
+		job.level = level;
+		job.failed = false;
+	}
+
+	run_tasks(run_normal_job, jobs);
+	for (std::size_t k = 0; k < nthreads; ++k) {
+		symbols_replaced += jobs[k].replaced;
+		if (jobs[k].failed)
+			return false;
+	}
+
+	// The threads may have replaced the same subexpression by different
+	// symbols, use the first one throughout.
+	for (std::size_t k = 0; k < nthreads; ++k) {
+		normal_job & job = jobs[k];
+		exmap rename;
+		for (exmap::const_iterator i = job.repl.begin(); i != job.repl.end(); ++i) {
+			if (repl.find(i->first) != repl.end())
+				continue;
+			exmap::const_iterator known = rev_lookup.find(i->second);
+			if (known != rev_lookup.end())
+				rename.insert(std::make_pair(i->first, known->second));
+			else {
+				repl.insert(*i);
+				rev_lookup.insert(std::make_pair(i->second, i->first));
+			}
+		}
+		for (std::size_t i = 0; i < job.nums.size(); ++i) {
+			nums.push_back(rename.empty() ? job.nums[i] : job.nums[i].subs(rename, subs_options::no_pattern));
+			dens.push_back(rename.empty() ? job.dens[i] : job.dens[i].subs(rename, subs_options::no_pattern));
+		}
+	}
+	return true;
+}
+
+} // anonymous namespace
+
+#endif // def PARALLEL_NORMAL
+
+/** Sum of the fractions nums[i]/dens[i], returned in nums[0]/dens[0].
+ *  Neighbouring fractions are added pairwise until one is left, so the
+ *  common denominators grow in a balanced tree instead of one by one. */
+static void add_fractions(exvector & nums, exvector & dens)
+{
+	GINAC_ASSERT(!nums.empty() && nums.size() == dens.size());
+
+	// Trivially add sequences of fractions with identical denominators
+	std::size_t n = 0;
+	for (std::size_t i = 0; i < nums.size(); ++n) {
+		const std::size_t first = i;
+		ex num = nums[i], den = dens[i];
+		for (++i; i < nums.size() && dens[i].is_equal(den); ++i)
+			num += nums[i];
+		nums[n] = (i - first > 1 ? num.expand() : num);
+		dens[n] = den;
+	}
+
+	while (n > 1) {
+		std::size_t m = 0;
+		for (std::size_t i = 0; i < n; i += 2, ++m) {
+			if (i + 1 == n) {
+				nums[m] = nums[i];
+				dens[m] = dens[i];
+				continue;
+			}
+			// Addition of two fractions, taking advantage of the fact that
+			// the heuristic GCD algorithm computes the cofactors at no extra cost
+			ex co_den1, co_den2;
+			gcd(dens[i], dens[i+1], &co_den1, &co_den2, false);
+			nums[m] = ((nums[i] * co_den2) + (nums[i+1] * co_den1)).expand();
+			dens[m] = dens[i] * co_den2;	// this is the lcm(den, next_den)
+		}
+		n = m;
+	}
+}
+
 /** Implementation of ex::normal() for a sum. It expands terms and performs
  *  fractional addition.
  *  @see ex::normal */
@@ -2173,16 +3264,35 @@ ex add::normal(exmap & repl, exmap & rev_lookup, int level) const
 	else if (level == -max_recursion_level)
 		throw(std::runtime_error("max recursion level reached"));
 
+	ex cached;
+	if (level <= 0 && lookup_normal_form(cached))
+		return cached;
+	const unsigned long replaced = symbols_replaced;
+
 	// Normalize children and split each one into numerator and denominator
 	exvector nums, dens;
 	nums.reserve(seq.size()+1);
 	dens.reserve(seq.size()+1);
-	epvector::const_iterator it = seq.begin(), itend = seq.end();
-	while (it != itend) {
-		ex n = ex_to<basic>(recombine_pair_to_ex(*it)).normal(repl, rev_lookup, level-1);
-		nums.push_back(n.op(0));
-		dens.push_back(n.op(1));
-		it++;
+	bool done = false;
+#ifdef PARALLEL_NORMAL
+	if (normal_threads > 1 && seq.size() >= min_parallel_terms) {
+		exvector terms;
+		terms.reserve(seq.size());
+		for (epvector::const_iterator it = seq.begin(); it != seq.end(); ++it)
+			terms.push_back(recombine_pair_to_ex(*it));
+		done = normal_terms_parallel(terms, nums, dens, repl, rev_lookup, level-1);
+	}
+#endif
+	if (!done) {
+		nums.clear();
+		dens.clear();
+		epvector::const_iterator it = seq.begin(), itend = seq.end();
+		while (it != itend) {
+			ex n = ex_to<basic>(recombine_pair_to_ex(*it)).normal(repl, rev_lookup, level-1);
+			nums.push_back(n.op(0));
+			dens.push_back(n.op(1));
+			it++;
+		}
 	}
 	ex n = ex_to<numeric>(overall_coeff).normal(repl, rev_lookup, level-1);
 	nums.push_back(n.op(0));
@@ -2193,32 +3303,14 @@ ex add::normal(exmap & repl, exmap & rev_lookup, int level) const
 	// all denominators
 //std::clog << "add::normal uses " << nums.size() << " summands:\n";
 
-	// Add fractions sequentially
-	exvector::const_iterator num_it = nums.begin(), num_itend = nums.end();
-	exvector::const_iterator den_it = dens.begin(), den_itend = dens.end();
-//std::clog << " num = " << *num_it << ", den = " << *den_it << std::endl;
-	ex num = *num_it++, den = *den_it++;
-	while (num_it != num_itend) {
-//std::clog << " num = " << *num_it << ", den = " << *den_it << std::endl;
-		ex next_num = *num_it++, next_den = *den_it++;
-
-		// Trivially add sequences of fractions with identical denominators
-		while ((den_it != den_itend) && next_den.is_equal(*den_it)) {
-			next_num += *num_it;
-			num_it++; den_it++;
-		}
-
-		// Additiion of two fractions, taking advantage of the fact that
-		// the heuristic GCD algorithm computes the cofactors at no extra cost
-		ex co_den1, co_den2;
-		ex g = gcd(den, next_den, &co_den1, &co_den2, false);
-		num = ((num * co_den2) + (next_num * co_den1)).expand();
-		den *= co_den2;		// this is the lcm(den, next_den)
-	}
-//std::clog << " common denominator = " << den << std::endl;
+	add_fractions(nums, dens);
+//std::clog << " common denominator = " << dens[0] << std::endl;
 
 	// Cancel common factors from num/den
-	return frac_cancel(num, den);
+	ex result = frac_cancel(nums[0], dens[0]);
+	if (level <= 0 && symbols_replaced == replaced)
+		remember_normal_form(result);
+	return result;
 }
 
 
@@ -2232,6 +3324,11 @@ ex mul::normal(exmap & repl, exmap & rev_lookup, int level) const
 	else if (level == -max_recursion_level)
 		throw(std::runtime_error("max recursion level reached"));
 
+	ex cached;
+	if (level <= 0 && lookup_normal_form(cached))
+		return cached;
+	const unsigned long replaced = symbols_replaced;
+
 	// Normalize children, separate into numerator and denominator
 	exvector num; num.reserve(seq.size());
 	exvector den; den.reserve(seq.size());
@@ -2248,8 +3345,11 @@ ex mul::normal(exmap & repl, exmap & rev_lookup, int level) const
 	den.push_back(n.op(1));
 
 	// Perform fraction cancellation
-	return frac_cancel((new mul(num))->setflag(status_flags::dynallocated),
-	                   (new mul(den))->setflag(status_flags::dynallocated));
+	ex result = frac_cancel((new mul(num))->setflag(status_flags::dynallocated),
+	                        (new mul(den))->setflag(status_flags::dynallocated));
+	if (level <= 0 && symbols_replaced == replaced)
+		remember_normal_form(result);
+	return result;
 }
 
 
@@ -2264,6 +3364,11 @@ ex power::normal(exmap & repl, exmap & rev_lookup, int level) const
 	else if (level == -max_recursion_level)
 		throw(std::runtime_error("max recursion level reached"));
 
+	ex cached;
+	if (level <= 0 && lookup_normal_form(cached))
+		return cached;
+	const unsigned long replaced = symbols_replaced;
+
 	// Normalize basis and exponent (exponent gets reassembled)
 	ex n_basis = ex_to<basic>(basis).normal(repl, rev_lookup, level-1);
 	ex n_exponent = ex_to<basic>(exponent).normal(repl, rev_lookup, level-1);
@@ -2274,12 +3379,18 @@ ex power::normal(exmap & repl, exmap & rev_lookup, int level) const
 		if (n_exponent.info(info_flags::positive)) {
 
 			// (a/b)^n -> {a^n, b^n}
-			return (new lst(power(n_basis.op(0), n_exponent), power(n_basis.op(1), n_exponent)))->setflag(status_flags::dynallocated);
+			ex result = (new lst(power(n_basis.op(0), n_exponent), power(n_basis.op(1), n_exponent)))->setflag(status_flags::dynallocated);
+			if (level <= 0 && symbols_replaced == replaced)
+				remember_normal_form(result);
+			return result;
 
 		} else if (n_exponent.info(info_flags::negative)) {
 
 			// (a/b)^-n -> {b^n, a^n}
-			return (new lst(power(n_basis.op(1), -n_exponent), power(n_basis.op(0), -n_exponent)))->setflag(status_flags::dynallocated);
+			ex result = (new lst(power(n_basis.op(1), -n_exponent), power(n_basis.op(0), -n_exponent)))->setflag(status_flags::dynallocated);
+			if (level <= 0 && symbols_replaced == replaced)
+				remember_normal_form(result);
+			return result;
 		}
 
 	} else {
@@ -2337,10 +3448,16 @@ ex pseries::normal(exmap & repl, exmap & rev_lookup, int level) const
  *  expression can be treated as a rational function). normal() is applied
  *  recursively to arguments of functions etc.
  *
+ *  With set_normal_caching() switched on, the normal forms of subexpressions
+ *  not involving temporary symbols are remembered and reused.
+ *
  *  @param level maximum depth of recursion
  *  @return normalized expression */
 ex ex::normal(int level) const
 {
+	profile_timer timer(profile_normal);
+	trace_scope trace("normal", "nops", nops());
+	check_budget();
 	exmap repl, rev_lookup;
 
 	ex e = bp->normal(repl, rev_lookup, level);
@@ -2611,15 +3728,54 @@ ex expairseq::to_polynomial(exmap & repl) const
 /** Remove the common factor in the terms of a sum 'e' by calculating the GCD,
  *  and multiply it into the expression 'factor' (which needs to be initialized
  *  to 1, unless you're accumulating factors). */
+/** Exponents of the factors of a product, by their bases. */
+typedef exhashmap<numeric> factor_exponents;
+
+/** Add the factors of the term t of a polynomial to f, leaving out its
+ *  numeric coefficient. */
+static void collect_term_factors(const ex & t, factor_exponents & f)
+{
+	if (is_exactly_a<mul>(t)) {
+		for (size_t i=0; i<t.nops(); i++)
+			collect_term_factors(t.op(i), f);
+	} else if (is_exactly_a<power>(t) && t.op(1).info(info_flags::posint)) {
+		numeric & n = f[t.op(0)];
+		n = n + ex_to<numeric>(t.op(1));
+	} else if (!is_exactly_a<numeric>(t)) {
+		numeric & n = f[t];
+		n = n + *_num1_p;
+	}
+}
+
+/** Divide the term t of a polynomial by the factors in common, all of which
+ *  it has. */
+static ex divide_term_factors(const ex & t, const factor_exponents & common)
+{
+	const size_t num = is_exactly_a<mul>(t) ? t.nops() : 1;
+	exvector v; v.reserve(num);
+	for (size_t i=0; i<num; i++) {
+		const ex f = is_exactly_a<mul>(t) ? t.op(i) : t;
+		const bool is_pow = is_exactly_a<power>(f) && f.op(1).info(info_flags::posint);
+		const ex b = is_pow ? f.op(0) : f;
+		factor_exponents::const_iterator c = is_exactly_a<numeric>(f) ? common.end() : common.find(b);
+		if (c == common.end()) {
+			v.push_back(f);
+			continue;
+		}
+		const numeric n = (is_pow ? ex_to<numeric>(f.op(1)) : *_num1_p) - c->second;
+		if (!n.is_zero())
+			v.push_back(pow(b, n));
+	}
+	return (new mul(v))->setflag(status_flags::dynallocated);
+}
+
 static ex find_common_factor(const ex & e, ex & factor, exmap & repl)
 {
 	if (is_exactly_a<add>(e)) {
 
 		size_t num = e.nops();
 		exvector terms; terms.reserve(num);
-		ex gc;
 
-		// Find the common GCD
 		for (size_t i=0; i<num; i++) {
 			ex x = e.op(i).to_polynomial(repl);
 
@@ -2629,16 +3785,42 @@ static ex find_common_factor(const ex & e, ex & factor, exmap & repl)
 				x *= f;
 			}
 
-			if (i == 0)
-				gc = x;
-			else
-				gc = gcd(gc, x);
-
 			terms.push_back(x);
 		}
 
-		if (gc.is_equal(_ex1))
-			return e;
+		// The factors which literally appear in all terms are pulled out
+		// first, which is much cheaper than the GCDs
+		factor_exponents common;
+		collect_term_factors(terms[0], common);
+		for (size_t i=1; i<num && !common.empty(); i++) {
+			factor_exponents f, shared;
+			collect_term_factors(terms[i], f);
+			for (factor_exponents::const_iterator c = common.begin(); c != common.end(); ++c) {
+				factor_exponents::const_iterator j = f.find(c->first);
+				if (j != f.end())
+					shared[c->first] = j->second < c->second ? j->second : c->second;
+			}
+			common.swap(shared);
+		}
+		if (!common.empty()) {
+			exvector v; v.reserve(common.size());
+			for (factor_exponents::const_iterator c = common.begin(); c != common.end(); ++c)
+				v.push_back(pow(c->first, c->second));
+			factor *= (new mul(v))->setflag(status_flags::dynallocated);
+			for (size_t i=0; i<num; i++)
+				terms[i] = divide_term_factors(terms[i], common);
+		}
+
+		// Find the common GCD of the rest
+		ex gc = terms[0];
+		for (size_t i=1; i<num && !gc.is_equal(_ex1); i++)
+			gc = gcd(gc, terms[i]);
+
+		if (gc.is_equal(_ex1)) {
+			if (common.empty())
+				return e;
+			return (new add(terms))->setflag(status_flags::dynallocated);
+		}
 
 		// The GCD is the factor we pull out
 		factor *= gc;
@@ -2714,8 +3896,60 @@ ex collect_common_factors(const ex & e)
 }
 
 
+/** Resultant of the expanded polynomials a and b in x by the subresultant
+ *  PRS algorithm, see H. Cohen, "A Course in Computational Algebraic Number
+ *  Theory", Algorithm 3.3.7.  All divisions are exact. */
+static ex sr_resultant(ex a, ex b, const ex & x)
+{
+	int adeg = a.degree(x), bdeg = b.degree(x);
+	int s = 1;
+	if (adeg < bdeg) {
+		std::swap(a, b);
+		std::swap(adeg, bdeg);
+		if (adeg & bdeg & 1)
+			s = -1;
+	}
+	if (bdeg == 0)
+		return pow(b, adeg).expand();
+
+	ex g = _ex1, h = _ex1;
+	for (;;) {
+		check_budget();
+		const int delta = adeg - bdeg;
+		if (adeg & bdeg & 1)
+			s = -s;
+		const ex r = prem(a, b, x, false).expand();
+		a = b;
+		adeg = bdeg;
+		if (r.is_zero())
+			return _ex0;
+		if (!divide(r, g * pow(h, delta), b, false))
+			throw std::runtime_error("resultant(): division failed");
+		b = b.expand();
+		bdeg = b.degree(x);
+		g = a.lcoeff(x);
+		if (delta == 1)
+			h = g;
+		else if (delta > 1 && !divide(pow(g, delta), pow(h, delta - 1), h, false))
+			throw std::runtime_error("resultant(): division failed");
+		if (bdeg == 0)
+			break;
+	}
+
+	// b is the last subresultant, of degree 0
+	ex res;
+	if (adeg == 1)
+		res = b;
+	else if (!divide(pow(b, adeg), pow(h, adeg - 1), res, false))
+		throw std::runtime_error("resultant(): division failed");
+	return (s * res).expand();
+}
+
 /** Resultant of two expressions e1,e2 with respect to symbol s.
- *  Method: Compute determinant of Sylvester matrix of e1,e2,s.  */
+ *  Method: for polynomials with rational coefficients in several variables
+ *  and of higher degree in s, the determinant of the Sylvester matrix is
+ *  computed by evaluation and interpolation modulo primes.  Otherwise, and
+ *  if the degrees are too high for that, the subresultant PRS is used. */
 ex resultant(const ex & e1, const ex & e2, const ex & s)
 {
 	const ex ee1 = e1.expand();
@@ -2723,27 +3957,38 @@ ex resultant(const ex & e1, const ex & e2, const ex & s)
 	if (!ee1.info(info_flags::polynomial) ||
 	    !ee2.info(info_flags::polynomial))
 		throw(std::runtime_error("resultant(): arguments must be polynomials"));
+	if (ee1.is_zero() || ee2.is_zero())
+		return _ex0;
 
 	const int h1 = ee1.degree(s);
 	const int l1 = ee1.ldegree(s);
 	const int h2 = ee2.degree(s);
 	const int l2 = ee2.ldegree(s);
 
+	// For small Sylvester matrices, or without other variables, the
+	// coefficients of the subresultants don't grow enough to make the
+	// modular method pay off.
+	const int min_modular_size = 8;
 	const int msize = h1 + h2;
-	matrix m(msize, msize);
-
-	for (int l = h1; l >= l1; --l) {
-		const ex e = ee1.coeff(s, l);
-		for (int k = 0; k < h2; ++k)
-			m(k, k+h1-l) = e;
-	}
-	for (int l = h2; l >= l2; --l) {
-		const ex e = ee2.coeff(s, l);
-		for (int k = 0; k < h1; ++k)
-			m(k+h2, k+h2-l) = e;
+	if (msize >= min_modular_size && h1 > 0 && h2 > 0 &&
+	    (ee1.get_symbol_mask() | ee2.get_symbol_mask()) != s.get_symbol_mask()) {
+		exvector m(msize * msize, _ex0);
+		for (int l = h1; l >= l1; --l) {
+			const ex e = ee1.coeff(s, l);
+			for (int k = 0; k < h2; ++k)
+				m[k*msize + k+h1-l] = e;
+		}
+		for (int l = h2; l >= l2; --l) {
+			const ex e = ee2.coeff(s, l);
+			for (int k = 0; k < h1; ++k)
+				m[(k+h2)*msize + k+h2-l] = e;
+		}
+		ex det;
+		if (modular_determinant(det, m, msize))
+			return det;
 	}
 
-	return m.determinant();
+	return sr_resultant(ee1, ee2, s);
 }
 
 
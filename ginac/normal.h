@@ -28,6 +28,9 @@
 
 #include "lst.h"
 
+#include <map>
+#include <vector>
+
 namespace GiNaC {
 
 /**
@@ -84,10 +87,79 @@ extern ex sprem(const ex &a, const ex &b, const ex &x, bool check_args = true);
 // Exact polynomial division of a(X) by b(X) in Q[X] (quotient returned in q), returns false when exact division fails
 extern bool divide(const ex &a, const ex &b, ex &q, bool check_args = true);
 
+// Counters of the modular test which rejects most inexact divisions early
+struct divisibility_check_statistics {
+	unsigned long checks;    ///< divisions tested modulo a prime
+	unsigned long rejected;  ///< of which were found to be inexact that way
+};
+
+// Get the counters of the divisibility test in divide() and gcd()
+extern divisibility_check_statistics get_divisibility_check_statistics();
+
+// Reset the counters of the divisibility test
+extern void reset_divisibility_check_statistics();
+
+// Values of a rational function modulo a word prime at two fixed pseudo-random points, the same for all forms of the function
+struct poly_fingerprint {
+	unsigned value[2];
+	bool operator==(const poly_fingerprint & other) const
+	{ return value[0] == other.value[0] && value[1] == other.value[1]; }
+	bool operator!=(const poly_fingerprint & other) const
+	{ return !(*this == other); }
+};
+
+// Compute the fingerprint of a rational function with rational coefficients without expanding it, returns false if it has none
+extern bool fingerprint(const ex & e, poly_fingerprint & fp);
+
 // Polynomial GCD in Z[X], cofactors are returned in ca and cb, if desired
 extern ex gcd(const ex &a, const ex &b, ex *ca = NULL, ex *cb = NULL,
 	      bool check_args = true, unsigned options = 0);
 
+// Polynomial GCD of several polynomials in Z[X] at once
+extern ex gcd(const exvector &p, bool check_args = true, unsigned options = 0);
+
+// Maximum number of GCDs remembered by gcd() (0 = no caching, the default), returns previous limit
+extern std::size_t set_gcd_cache_size(std::size_t n);
+
+// Counters describing the effectiveness of the GCD cache
+struct gcd_cache_statistics {
+	unsigned long lookups;  ///< calls of gcd() that consulted the cache
+	unsigned long hits;     ///< of which were answered from the cache
+	std::size_t size;       ///< number of GCDs currently remembered
+};
+
+// Get the GCD cache counters of the calling thread
+extern gcd_cache_statistics get_gcd_cache_statistics();
+
+// Reset the lookup and hit counters of the calling thread (not the cache itself)
+extern void reset_gcd_cache_statistics();
+
+// Remember the normal forms of sums, products and powers computed by normal(), so that later calls only work on new subexpressions (off by default), returns previous setting
+extern bool set_normal_caching(bool enable);
+extern bool get_normal_caching();
+
+// Counters describing the effectiveness of the normal form cache
+struct normal_cache_statistics {
+	unsigned long lookups;  ///< subexpressions looked up by normal()
+	unsigned long hits;     ///< of which had a remembered normal form
+	std::size_t size;       ///< number of normal forms currently remembered
+};
+
+// Get the normal form cache counters
+extern normal_cache_statistics get_normal_cache_statistics();
+
+// Reset the lookup and hit counters (not the cache itself)
+extern void reset_normal_cache_statistics();
+
+// Number of threads used for computing modular GCD images (default 1), returns previous setting
+extern unsigned set_gcd_threads(unsigned n);
+extern unsigned get_gcd_threads();
+
+// Number of threads used by normal() for the terms of large sums and by
+// sqrfree_parfrac() for the square-free factors (default 1), returns previous setting
+extern unsigned set_normal_threads(unsigned n);
+extern unsigned get_normal_threads();
+
 // Polynomial LCM in Z[X]
 extern ex lcm(const ex &a, const ex &b, bool check_args = true);
 
@@ -100,6 +172,12 @@ extern ex sqrfree_parfrac(const ex & a, const symbol & x);
 // Collect common factors in sums.
 extern ex collect_common_factors(const ex & e);
 
+// Coefficients of a polynomial, indexed by the exponents of the objects it is a polynomial in
+typedef std::map<std::vector<int>, ex> exp_coeff_map;
+
+// All coefficients of the expanded e in the objects of l, found in one pass over the terms
+extern exp_coeff_map collect_coeffs(const ex & e, const lst & l);
+
 // Resultant of two polynomials e1,e2 with respect to symbol s.
 extern ex resultant(const ex & e1, const ex & e2, const ex & s);
 
@@ -32,10 +32,16 @@
 #include "ex.h"
 #include "operators.h"
 #include "archive.h"
+#include "lst.h"
 #include "tostring.h"
+#include "tasks.h"
 #include "utils.h"
 
+#include <algorithm>
+#include <cmath>
+#include <cstring>
 #include <limits>
+#include <map>
 #include <sstream>
 #include <stdexcept>
 #include <string>
@@ -59,6 +65,17 @@
 #include <cln/complex_io.h>
 #include <cln/complex_ring.h>
 #include <cln/numtheory.h>
+#include <cln/dfloat.h>
+
+#if defined(GINAC_THREADSAFE_REFCOUNT) && defined(HAVE_PTHREAD_H)
+#include <pthread.h>
+#endif
+
+#ifdef GINAC_THREADSAFE_REFCOUNT
+#define GINAC_GAMMA_THREAD_LOCAL __thread
+#else
+#define GINAC_GAMMA_THREAD_LOCAL
+#endif
 
 namespace GiNaC {
 
@@ -165,10 +182,60 @@ numeric::numeric(double d)
 }
 
 
+/** Integer with the n decimal digits starting at s.  The digits are split
+ *  into a lower part of 9*2^k digits and the rest, recursively, so that
+ *  the multiplications are balanced and the powers of ten can be reused.
+ *
+ *  @param pow10 cache of the powers 10^(9*2^k) */
+static cln::cl_I decimal_digits_to_I(const char *s, std::size_t n, std::vector<cln::cl_I> &pow10)
+{
+	const std::size_t chunk = 9;
+	if (n <= chunk) {
+		long v = 0;
+		for (std::size_t i = 0; i < n; ++i)
+			v = 10*v + (s[i] - '0');
+		return cln::cl_I(v);
+	}
+	std::size_t low = chunk, k = 0;
+	while (2*low < n) {
+		low *= 2;
+		++k;
+	}
+	while (pow10.size() <= k)
+		pow10.push_back(pow10.empty() ? cln::cl_I(1000000000L) : pow10.back() * pow10.back());
+	return decimal_digits_to_I(s, n - low, pow10) * pow10[k]
+	     + decimal_digits_to_I(s + n - low, low, pow10);
+}
+
 /** ctor from C-style string.  It also accepts complex numbers in GiNaC
  *  notation like "2+5*I". */
 numeric::numeric(const char *s)
 {
+	// Plain decimal integers, which is what most input consists of, are
+	// converted without going through CLN's general reader.
+	const char *digits = s;
+	bool negative = false;
+	if (*digits == '+' || *digits == '-') {
+		negative = (*digits == '-');
+		++digits;
+	}
+	const std::size_t n = std::strspn(digits, "0123456789");
+	if (n > 0 && digits[n] == '\0') {
+		cln::cl_I i;
+		if (n <= std::size_t(std::numeric_limits<unsigned long>::digits10)) {
+			unsigned long v = 0;
+			for (std::size_t k = 0; k < n; ++k)
+				v = 10*v + (digits[k] - '0');
+			i = cln::cl_I(v);
+		} else {
+			std::vector<cln::cl_I> pow10;
+			i = decimal_digits_to_I(digits, n, pow10);
+		}
+		value = negative ? cln::cl_I(-i) : i;
+		setflag(status_flags::evaluated | status_flags::expanded);
+		return;
+	}
+
 	cln::cl_N ctorval = 0;
 	// parse complex numbers (functional but not completely safe, unfortunately
 	// std::string does not understand regexpese):
@@ -280,13 +347,109 @@ static const cln::cl_F read_real_float(std::istream& s)
 	return x;
 }
 
+/*
+ *  Binary format of archived numbers
+ *
+ *   - 'i' integer
+ *   - 'q' integer numerator, integer denominator
+ *   - 'f' unsigned number of mantissa bits (the float format), integer
+ *     exponent, integer mantissa (with the sign of the number)
+ *   - 'c' real part, imaginary part (each one of the above)
+ *
+ *  Integers are stored as an unsigned holding twice the number of bytes
+ *  of the absolute value plus one if negative, followed by these bytes,
+ *  LSB first. Unsigned quantities use the compressed format of archives.
+ */
+
+/** Read unsigned quantity from a binary archived number. */
+static unsigned read_binary_unsigned(const std::string &s, std::size_t &pos)
+{
+	unsigned ret = 0;
+	unsigned shift = 0;
+	unsigned char b;
+	do {
+		if (pos >= s.size())
+			throw std::runtime_error("archived number is truncated");
+		b = s[pos++];
+		ret |= (b & 0x7f) << shift;
+		shift += 7;
+	} while (b & 0x80);
+	return ret;
+}
+
+/** Construct the integer of len bytes, LSB first. The halves are combined
+ *  recursively, which takes O(n log(n)) instead of the O(n^2) of adding
+ *  one byte after the other. */
+static const cln::cl_I read_binary_magnitude(const unsigned char *p, std::size_t len)
+{
+	if (len <= 4) {
+		unsigned long val = 0;
+		for (std::size_t i=len; i>0; --i)
+			val = (val << 8) | p[i-1];
+		return cln::cl_I(val);
+	}
+	std::size_t low = len / 2;
+	return cln::ash(read_binary_magnitude(p + low, len - low), 8 * low)
+	     + read_binary_magnitude(p, low);
+}
+
+static const cln::cl_I read_binary_integer(const std::string &s, std::size_t &pos)
+{
+	unsigned len_sign = read_binary_unsigned(s, pos);
+	std::size_t len = len_sign >> 1;
+	if (len > s.size() - pos)
+		throw std::runtime_error("archived number is truncated");
+	cln::cl_I x = read_binary_magnitude(reinterpret_cast<const unsigned char *>(s.data()) + pos, len);
+	pos += len;
+	return (len_sign & 1) ? cln::cl_I(-x) : x;
+}
+
+static const cln::cl_R read_binary_real(const std::string &s, std::size_t &pos)
+{
+	if (pos >= s.size())
+		throw std::runtime_error("archived number is truncated");
+	switch (s[pos++]) {
+		case 'i':
+			return read_binary_integer(s, pos);
+		case 'q': {
+			const cln::cl_I num = read_binary_integer(s, pos);
+			const cln::cl_I den = read_binary_integer(s, pos);
+			if (cln::zerop(den))
+				throw std::runtime_error("archived number has a zero denominator");
+			return num / den;
+		}
+		case 'f': {
+			cln::float_format_t format = cln::float_format_t(read_binary_unsigned(s, pos));
+			const cln::cl_I exponent = read_binary_integer(s, pos);
+			const cln::cl_I mantissa = read_binary_integer(s, pos);
+			return cln::scale_float(cln::cl_float(mantissa, format), exponent);
+		}
+		default:
+			throw std::runtime_error("archived number has an unknown format");
+	}
+}
+
 void numeric::read_archive(const archive_node &n, lst &sym_lst)
 {
 	inherited::read_archive(n, sym_lst);
 	value = 0;
-	
-	// Read number as string
+
+	// Read number in binary format
 	std::string str;
+	if (n.find_binary("number", str)) {
+		std::size_t pos = 0;
+		if (!str.empty() && str[0] == 'c') {
+			++pos;
+			const cln::cl_R re = read_binary_real(str, pos);
+			const cln::cl_R im = read_binary_real(str, pos);
+			value = cln::complex(re, im);
+		} else
+			value = read_binary_real(str, pos);
+		setflag(status_flags::evaluated | status_flags::expanded);
+		return;
+	}
+	
+	// Read number as string (archives up to version 3)
 	if (n.find_string("number", str)) {
 		std::istringstream s(str);
 		cln::cl_R re, im;
@@ -329,52 +492,75 @@ void numeric::read_archive(const archive_node &n, lst &sym_lst)
 }
 GINAC_BIND_UNARCHIVER(numeric);
 
-static void write_real_float(std::ostream& s, const cln::cl_R& n)
+static void write_binary_unsigned(std::string &s, unsigned val)
+{
+	while (val >= 0x80) {
+		s += char((val & 0x7f) | 0x80);
+		val >>= 7;
+	}
+	s += char(val);
+}
+
+/** Append the len bytes of the non-negative integer x to s, LSB first.
+ *  Like read_binary_magnitude(), this works on halves recursively. */
+static void write_binary_magnitude(std::string &s, const cln::cl_I &x, std::size_t len)
+{
+	if (len <= 4) {
+		unsigned long val = cln::cl_I_to_UL(x);
+		for (std::size_t i=0; i<len; ++i) {
+			s += char(val & 0xff);
+			val >>= 8;
+		}
+		return;
+	}
+	std::size_t low = len / 2;
+	write_binary_magnitude(s, cln::ldb(x, cln::cl_byte(8 * low, 0)), low);
+	write_binary_magnitude(s, cln::ash(x, -8 * (long)low), len - low);
+}
+
+static void write_binary_integer(std::string &s, const cln::cl_I &x)
 {
-	const cln::cl_idecoded_float dec = cln::integer_decode_float(cln::the<cln::cl_F>(n));
-	s << dec.sign << ' ' << dec.mantissa << ' ' << dec.exponent;
+	const cln::cl_I a = cln::abs(x);
+	std::size_t len = (cln::integer_length(a) + 7) / 8;
+	write_binary_unsigned(s, (len << 1) | (cln::minusp(x) ? 1 : 0));
+	write_binary_magnitude(s, a, len);
+}
+
+static void write_binary_real(std::string &s, const cln::cl_R &x)
+{
+	if (cln::instanceof(x, cln::cl_I_ring)) {
+		s += 'i';
+		write_binary_integer(s, cln::the<cln::cl_I>(x));
+	} else if (cln::instanceof(x, cln::cl_RA_ring)) {
+		s += 'q';
+		write_binary_integer(s, cln::numerator(cln::the<cln::cl_RA>(x)));
+		write_binary_integer(s, cln::denominator(cln::the<cln::cl_RA>(x)));
+	} else {
+		// Floating point numbers are written exactly, in their precision
+		const cln::cl_F f = cln::the<cln::cl_F>(x);
+		const cln::cl_idecoded_float dec = cln::integer_decode_float(f);
+		s += 'f';
+		write_binary_unsigned(s, cln::float_digits(f));
+		write_binary_integer(s, dec.exponent);
+		write_binary_integer(s, dec.sign * dec.mantissa);
+	}
 }
 
 void numeric::archive(archive_node &n) const
 {
 	inherited::archive(n);
 
-	// Write number as string
-	
-	const cln::cl_R re = cln::realpart(value);
-	const cln::cl_R im = cln::imagpart(value);
-	const bool re_rationalp = cln::instanceof(re, cln::cl_RA_ring);
-	const bool im_rationalp = cln::instanceof(im, cln::cl_RA_ring);
-
-	// Non-rational numbers are written in an integer-decoded format
-	// to preserve the precision
-	std::ostringstream s;
-	if (re_rationalp && im_rationalp)
-		s << value;
-	else if (zerop(im)) {
-		// real FP (floating point) number
-		s << 'R';
-		write_real_float(s, re);
-	} else if (re_rationalp) {
-		s << 'H'; // just any unique character
-		// real part is a rational number,
-		// imaginary part is a FP number
-		s << re << ' ';
-		write_real_float(s, im);
-	} else if (im_rationalp) {
-		s << 'J';
-		// real part is a FP number,
-		// imaginary part is a rational number
-		write_real_float(s, re);
-		s << ' ' << im;
-	} else  {
-		// both real and imaginary parts are floating point
-		s << 'C';
-		write_real_float(s, re);
-		s << ' ';
-		write_real_float(s, im);
+	// Write number in binary format, which avoids the conversion of
+	// large numbers to and from decimal digits
+	std::string s;
+	if (cln::instanceof(value, cln::cl_R_ring))
+		write_binary_real(s, cln::the<cln::cl_R>(value));
+	else {
+		s += 'c';
+		write_binary_real(s, cln::realpart(value));
+		write_binary_real(s, cln::imagpart(value));
 	}
-	n.add_string("number", s.str());
+	n.add_binary("number", s);
 }
 
 //////////
@@ -495,6 +681,52 @@ inline bool coerce<unsigned int, cln::cl_I>(unsigned int& dst, const cln::cl_I&
 	return false;
 }
 
+/** Check whether x is an integer small enough that the sum and the product
+ *  of two such numbers can be computed in a long without overflow.  If so,
+ *  store its value in dst.  The arithmetic methods below use this to bypass
+ *  CLN's generic dispatch on complex numbers for the common case of small
+ *  integer coefficients. */
+static inline bool coerce_small_integer(long & dst, const cln::cl_N & x)
+{
+	if (!cln::instanceof(x, cln::cl_I_ring))
+		return false;
+	const cln::cl_I & i = cln::the<cln::cl_I>(x);
+	if (cln::integer_length(i) >= std::numeric_limits<long>::digits/2)
+		return false;
+	dst = cln::cl_I_to_long(i);
+	return true;
+}
+
+/** Wrap a number into a numeric object on the heap, unless it is one of the
+ *  preallocated small numbers.  Used for the results of the _dyn methods. */
+static inline const numeric & dyn_numeric(long i)
+{
+	const numeric * n = small_integer_p(i);
+	if (n)
+		return *n;
+	return static_cast<const numeric &>((new numeric(i))->
+	                                    setflag(status_flags::dynallocated));
+}
+
+static const numeric & dyn_numeric(const cln::cl_N & x)
+{
+	long i;
+	if (coerce_small_integer(i, x))
+		return dyn_numeric(i);
+	if (cln::instanceof(x, cln::cl_RA_ring)) {
+		const cln::cl_RA & r = cln::the<cln::cl_RA>(x);
+		const cln::cl_I num = cln::numerator(r);
+		if ((num == 1 || num == -1) &&
+		    cln::integer_length(cln::denominator(r)) < std::numeric_limits<long>::digits) {
+			const numeric * n = small_inverse_p(cln::cl_I_to_long(num * cln::denominator(r)));
+			if (n)
+				return *n;
+		}
+	}
+	return static_cast<const numeric &>((new numeric(x))->
+	                                    setflag(status_flags::dynallocated));
+}
+
 /** Helper function to print real number in C++ source format using cl_N types.
  *
  *  @see numeric::print() */
@@ -797,6 +1029,13 @@ ex numeric::evalf(int level) const
 	return numeric(cln::cl_float(1.0, cln::default_float_format) * value);
 }
 
+std::complex<double> numeric::evalf_double(const evalf_double_map & values) const
+{
+	if (is_real())
+		return to_double();
+	return std::complex<double>(real().to_double(), imag().to_double());
+}
+
 ex numeric::conjugate() const
 {
 	if (is_real()) {
@@ -815,6 +1054,37 @@ ex numeric::imag_part() const
 	return numeric(cln::imagpart(value));
 }
 
+/** Approximate number of bytes CLN allocates for an integer; small integers
+ *  are stored in the object pointer itself. */
+static std::size_t integer_footprint(const cln::cl_I & x)
+{
+	const std::size_t len = cln::integer_length(x);
+	if (len < cl_value_len)
+		return 0;
+	return 2 * sizeof(void *) + (len / 8 + sizeof(void *)) / sizeof(void *) * sizeof(void *);
+}
+
+static std::size_t real_footprint(const cln::cl_R & x)
+{
+	if (cln::instanceof(x, cln::cl_I_ring))
+		return integer_footprint(cln::the<cln::cl_I>(x));
+	if (cln::instanceof(x, cln::cl_RA_ring))
+		return 2 * sizeof(void *)
+		     + integer_footprint(cln::numerator(cln::the<cln::cl_RA>(x)))
+		     + integer_footprint(cln::denominator(cln::the<cln::cl_RA>(x)));
+	return 4 * sizeof(void *) + cln::float_digits(cln::the<cln::cl_F>(x)) / 8;
+}
+
+/** The object and the memory CLN allocates for its value. */
+std::size_t numeric::footprint() const
+{
+	std::size_t size = object_size();
+	if (cln::instanceof(value, cln::cl_R_ring))
+		return size + real_footprint(cln::the<cln::cl_R>(value));
+	return size + 2 * sizeof(void *)
+	     + real_footprint(cln::realpart(value)) + real_footprint(cln::imagpart(value));
+}
+
 // protected
 
 int numeric::compare_same_type(const basic &other) const
@@ -863,6 +1133,9 @@ unsigned numeric::calchash() const
  *  a numeric object. */
 const numeric numeric::add(const numeric &other) const
 {
+	long a, b;
+	if (coerce_small_integer(a, value) && coerce_small_integer(b, other.value))
+		return numeric(a + b);
 	return numeric(value + other.value);
 }
 
@@ -871,6 +1144,9 @@ const numeric numeric::add(const numeric &other) const
  *  result as a numeric object. */
 const numeric numeric::sub(const numeric &other) const
 {
+	long a, b;
+	if (coerce_small_integer(a, value) && coerce_small_integer(b, other.value))
+		return numeric(a - b);
 	return numeric(value - other.value);
 }
 
@@ -879,6 +1155,9 @@ const numeric numeric::sub(const numeric &other) const
  *  result as a numeric object. */
 const numeric numeric::mul(const numeric &other) const
 {
+	long a, b;
+	if (coerce_small_integer(a, value) && coerce_small_integer(b, other.value))
+		return numeric(a * b);
 	return numeric(value * other.value);
 }
 
@@ -931,8 +1210,10 @@ const numeric &numeric::add_dyn(const numeric &other) const
 	else if (&other==_num0_p)
 		return *this;
 	
-	return static_cast<const numeric &>((new numeric(value + other.value))->
-	                                    setflag(status_flags::dynallocated));
+	long a, b;
+	if (coerce_small_integer(a, value) && coerce_small_integer(b, other.value))
+		return dyn_numeric(a + b);
+	return dyn_numeric(value + other.value);
 }
 
 
@@ -947,8 +1228,10 @@ const numeric &numeric::sub_dyn(const numeric &other) const
 	if (&other==_num0_p || cln::zerop(other.value))
 		return *this;
 	
-	return static_cast<const numeric &>((new numeric(value - other.value))->
-	                                    setflag(status_flags::dynallocated));
+	long a, b;
+	if (coerce_small_integer(a, value) && coerce_small_integer(b, other.value))
+		return dyn_numeric(a - b);
+	return dyn_numeric(value - other.value);
 }
 
 
@@ -965,8 +1248,10 @@ const numeric &numeric::mul_dyn(const numeric &other) const
 	else if (&other==_num1_p)
 		return *this;
 	
-	return static_cast<const numeric &>((new numeric(value * other.value))->
-	                                    setflag(status_flags::dynallocated));
+	long a, b;
+	if (coerce_small_integer(a, value) && coerce_small_integer(b, other.value))
+		return dyn_numeric(a * b);
+	return dyn_numeric(value * other.value);
 }
 
 
@@ -984,8 +1269,7 @@ const numeric &numeric::div_dyn(const numeric &other) const
 		return *this;
 	if (cln::zerop(cln::the<cln::cl_N>(other.value)))
 		throw std::overflow_error("division by zero");
-	return static_cast<const numeric &>((new numeric(value / other.value))->
-	                                    setflag(status_flags::dynallocated));
+	return dyn_numeric(value / other.value);
 }
 
 
@@ -1011,8 +1295,7 @@ const numeric &numeric::power_dyn(const numeric &other) const
 		else
 			return *_num0_p;
 	}
-	return static_cast<const numeric &>((new numeric(cln::expt(value, other.value)))->
-	                                     setflag(status_flags::dynallocated));
+	return dyn_numeric(cln::expt(value, other.value));
 }
 
 
@@ -1738,7 +2021,7 @@ class lanczos_coeffs
 		lanczos_coeffs();
 		bool sufficiently_accurate(int digits);
 		int get_order() const { return current_vector->size(); }
-		cln::cl_N calc_lanczos_A(const cln::cl_N &) const;
+		const cln::cl_N & get_coeff(int i) const { return (*current_vector)[i]; }
 	private:
 		// coeffs[0] is used in case Digits <= 20.
 		// coeffs[1] is used in case Digits <= 50.
@@ -1771,15 +2054,6 @@ bool lanczos_coeffs::sufficiently_accurate(int digits)
 	return false;
 }
 
-cln::cl_N lanczos_coeffs::calc_lanczos_A(const cln::cl_N &x) const
-{
-	cln::cl_N A = (*current_vector)[0];
-	int size = current_vector->size();
-  	for (int i=1; i<size; ++i)
-     	A = A + (*current_vector)[i]/(x+cln::cl_I(-1+i));
-	return A;
-}
-
 // The values in this function have been calculated using the program
 // lanczos.cpp in the directory doc/examples. If you want to add more
 // digits, be sure to read the comments in that file.
@@ -2034,27 +2308,163 @@ static const cln::float_format_t guess_precision(const cln::cl_N& x)
 	return prec;
 }
 
+namespace {
+
+/** Number of decimal digits of floats of the given format, which is the
+ *  number of bits of their mantissa. */
+inline int decimal_digits(cln::float_format_t prec)
+{
+	return int(int(prec) * 0.30102999566398119521);
+}
+
+/** The constants needed by the gamma and psi functions at one precision,
+ *  computed once.  The Bernoulli numbers are added on demand. */
+struct gamma_constants {
+	gamma_constants(cln::float_format_t prec);
+
+	/** The sum A(x) of the Lanczos approximation. */
+	cln::cl_N lanczos_A(const cln::cl_N & x) const;
+	/** The Bernoulli number B_{2k}, k >= 1, as a float. */
+	const cln::cl_N & bernoulli_2k(std::size_t k);
+
+	cln::float_format_t prec;
+	/** Whether there are Lanczos coefficients accurate enough. */
+	bool has_lanczos;
+	std::vector<cln::cl_N> lanczos;
+	cln::cl_N pi, log_pi, sqrt_2pi, log_sqrt_2pi;
+	cln::cl_R epsilon;
+	std::vector<cln::cl_N> bernoulli_numbers;
+};
+
+gamma_constants::gamma_constants(cln::float_format_t prec_) : prec(prec_)
+{
+	pi = cln::pi(prec);
+	log_pi = cln::log(pi);
+	sqrt_2pi = cln::sqrt(2 * pi);
+	log_sqrt_2pi = cln::log(sqrt_2pi);
+	epsilon = cln::float_epsilon(prec);
+	lanczos_coeffs lc;
+	has_lanczos = lc.sufficiently_accurate(decimal_digits(prec));
+	if (has_lanczos) {
+		lanczos.reserve(lc.get_order());
+		for (int i=0; i<lc.get_order(); ++i)
+			lanczos.push_back(cln::cl_float(cln::the<cln::cl_R>(lc.get_coeff(i)), prec));
+	}
+}
+
+cln::cl_N gamma_constants::lanczos_A(const cln::cl_N & x) const
+{
+	cln::cl_N A = lanczos[0];
+	for (std::size_t i=1; i<lanczos.size(); ++i)
+		A = A + lanczos[i]/(x+cln::cl_I(long(i)-1));
+	return A;
+}
+
+const cln::cl_N & gamma_constants::bernoulli_2k(std::size_t k)
+{
+	while (bernoulli_numbers.size() < k) {
+		const numeric b = bernoulli(numeric(2*(bernoulli_numbers.size()+1)));
+		bernoulli_numbers.push_back(cln::cl_float(cln::the<cln::cl_RA>(b.to_cl_N()), prec));
+	}
+	return bernoulli_numbers[k-1];
+}
+
+// CLN doesn't update its reference counts atomically, so every thread
+// keeps constants of its own.
+typedef std::map<cln::float_format_t, gamma_constants> gamma_constants_map;
+
+GINAC_GAMMA_THREAD_LOCAL gamma_constants_map * the_gamma_constants = 0;
+
+#if defined(GINAC_THREADSAFE_REFCOUNT) && defined(HAVE_PTHREAD_H)
+pthread_key_t gamma_constants_key;
+pthread_once_t gamma_constants_key_once = PTHREAD_ONCE_INIT;
+
+void delete_gamma_constants(void * p)
+{
+	delete static_cast<gamma_constants_map *>(p);
+	the_gamma_constants = 0;
+}
+
+void create_gamma_constants_key()
+{
+	pthread_key_create(&gamma_constants_key, delete_gamma_constants);
+}
+
+void release_gamma_constants()
+{
+	delete_gamma_constants(the_gamma_constants);
+	pthread_setspecific(gamma_constants_key, 0);
+}
+#endif
+
+/** The constants of the calling thread at the given precision.  Those of
+ *  other threads are deleted when the thread exits (workers: when the task
+ *  is done), those of the main
+ *  thread never, because numbers may still be evaluated during static
+ *  destruction. */
+gamma_constants & gamma_constants_of(cln::float_format_t prec)
+{
+	if (!the_gamma_constants) {
+		the_gamma_constants = new gamma_constants_map;
+#if defined(GINAC_THREADSAFE_REFCOUNT) && defined(HAVE_PTHREAD_H)
+		pthread_once(&gamma_constants_key_once, create_gamma_constants_key);
+		pthread_setspecific(gamma_constants_key, the_gamma_constants);
+		at_task_end(release_gamma_constants);
+#endif
+	}
+	gamma_constants_map::iterator i = the_gamma_constants->find(prec);
+	if (i == the_gamma_constants->end())
+		i = the_gamma_constants->insert(std::make_pair(prec, gamma_constants(prec))).first;
+	return i->second;
+}
+
+/** Whether x is real and its gamma functions can be computed by the C
+ *  library instead, because the precision is that of a double at most. */
+inline bool double_suffices(const cln::cl_N & x, cln::float_format_t prec, double & d)
+{
+	if (prec > cln::float_format_dfloat || !cln::zerop(cln::imagpart(x)))
+		return false;
+	d = cln::double_approx(cln::the<cln::cl_R>(cln::realpart(x)));
+	return true;
+}
+
+/** The value of the C library function in the precision of the result, or
+ *  false if it is not finite. */
+inline bool from_double(double d, cln::float_format_t prec, cln::cl_N & result)
+{
+	if (d - d != 0)
+		return false;
+	result = cln::cl_float(cln::cl_DF(d), prec);
+	return true;
+}
+
+} // anonymous namespace
+
 /** The Gamma function.
  *  Use the Lanczos approximation. If the coefficients used here are not
  *  sufficiently many or sufficiently accurate, more can be calculated
  *  using the program doc/examples/lanczos.cpp. In that case, be sure to
- *  read the comments in that file. */
+ *  read the comments in that file.  Real arguments in double precision
+ *  are left to the C library. */
 const cln::cl_N lgamma(const cln::cl_N &x)
 {
 	cln::float_format_t prec = guess_precision(x);
-	lanczos_coeffs lc;
-	if (lc.sufficiently_accurate(prec)) {
-		cln::cl_N pi_val = cln::pi(prec);
+	double d;
+	cln::cl_N result;
+	if (double_suffices(x, prec, d) && d > 0 && from_double(::lgamma(d), prec, result))
+		return result;
+	const gamma_constants & c = gamma_constants_of(prec);
+	if (c.has_lanczos) {
 		if (realpart(x) < 0.5)
-			return cln::log(pi_val) - cln::log(sin(pi_val*x))
+			return c.log_pi - cln::log(sin(c.pi*x))
 				- lgamma(1 - x);
-		cln::cl_N A = lc.calc_lanczos_A(x);
-		cln::cl_N temp = x + lc.get_order() - cln::cl_N(1)/2;
-   	cln::cl_N result = log(cln::cl_I(2)*pi_val)/2
-		              + (x-cln::cl_N(1)/2)*log(temp)
-		              - temp
-		              + log(A);
-   	return result;
+		cln::cl_N A = c.lanczos_A(x);
+		cln::cl_N temp = x + cln::cl_I(long(c.lanczos.size())) - cln::cl_N(1)/2;
+		result = c.log_sqrt_2pi
+		         + (x-cln::cl_N(1)/2)*log(temp)
+		         - temp
+		         + log(A);
+		return result;
 	}
 	else 
 		throw dunno();
@@ -2070,17 +2480,20 @@ const numeric lgamma(const numeric &x)
 const cln::cl_N tgamma(const cln::cl_N &x)
 {
 	cln::float_format_t prec = guess_precision(x);
-	lanczos_coeffs lc;
-	if (lc.sufficiently_accurate(prec)) {
-		cln::cl_N pi_val = cln::pi(prec);
+	double d;
+	cln::cl_N result;
+	if (double_suffices(x, prec, d) && !(d <= 0 && d == std::floor(d))
+	 && from_double(::tgamma(d), prec, result))
+		return result;
+	const gamma_constants & c = gamma_constants_of(prec);
+	if (c.has_lanczos) {
 		if (realpart(x) < 0.5)
-			return pi_val/(cln::sin(pi_val*x))/tgamma(1 - x);
-		cln::cl_N A = lc.calc_lanczos_A(x);
-		cln::cl_N temp = x + lc.get_order() - cln::cl_N(1)/2;
-   	cln::cl_N result
-			= sqrt(cln::cl_I(2)*pi_val) * expt(temp, x - cln::cl_N(1)/2)
-			  * exp(-temp) * A;
-   	return result;
+			return c.pi/(cln::sin(c.pi*x))/tgamma(1 - x);
+		cln::cl_N A = c.lanczos_A(x);
+		cln::cl_N temp = x + cln::cl_I(long(c.lanczos.size())) - cln::cl_N(1)/2;
+		result = c.sqrt_2pi * expt(temp, x - cln::cl_N(1)/2)
+		         * exp(-temp) * A;
+		return result;
 	}
 	else
 		throw dunno();
@@ -2093,19 +2506,91 @@ const numeric tgamma(const numeric &x)
 	return numeric(result);
 }
 
-/** The psi function (aka polygamma function).
- *  This is only a stub! */
+namespace {
+
+/** Largest number of steps of the recurrence in polygamma(). */
+const long max_polygamma_shift = 100000;
+
+/** The polygamma function psi(n,x) at the precision prec.  The recurrence
+ *  psi(n,x) == psi(n,x+1) + (-1)^(n+1)*n!/x^(n+1) shifts x far enough from
+ *  the origin for the asymptotic series
+ *    psi(x) ~ log(x) - 1/(2*x) - sum_k B_2k/(2*k*x^(2*k)),
+ *    psi(n,x) ~ (-1)^(n+1) * ((n-1)!/x^n + n!/(2*x^(n+1))
+ *                            + sum_k B_2k*(2*k+n-1)!/((2*k)!*x^(2*k+n))),
+ *  the digamma function of arguments with negative real part is reflected
+ *  with psi(x) == psi(1-x) - Pi*cot(Pi*x). */
+cln::cl_N polygamma(long n, const cln::cl_N & x_in, cln::float_format_t prec)
+{
+	gamma_constants & c = gamma_constants_of(prec);
+	cln::cl_N x = cln::cl_float(cln::cl_I(1), prec) * x_in;
+	if (n == 0 && cln::realpart(x) < 0.5)
+		return polygamma(0, 1 - x, prec) - c.pi * cln::cos(c.pi*x) / cln::sin(c.pi*x);
+
+	const cln::cl_I nfact = cln::factorial(n);
+	const cln::cl_I radius = decimal_digits(prec) + n;
+	cln::cl_N shift = 0;
+	long steps = 0;
+	while (cln::realpart(x) < 0 || cln::abs(x) < radius) {
+		if (cln::zerop(x) || ++steps > max_polygamma_shift)
+			throw dunno();
+		shift = shift + nfact / cln::expt(x, n+1);
+		x = x + 1;
+	}
+
+	const cln::cl_N x2inv = 1 / (x*x);
+	cln::cl_N sum, p;
+	cln::cl_RA f;
+	if (n == 0) {
+		sum = cln::log(x) - 1 / (cln::cl_I(2)*x);
+		p = cln::cl_I(1);
+	} else {
+		p = 1 / cln::expt(x, n);
+		f = cln::factorial(n-1);
+		sum = f * p + nfact * p / (cln::cl_I(2)*x);
+	}
+	const long max_terms = 4 * (decimal_digits(prec) + n) + 10;
+	for (long k = 1; k <= max_terms; ++k) {
+		p = p * x2inv;
+		cln::cl_N term;
+		if (n == 0) {
+			term = -c.bernoulli_2k(k) * p / cln::cl_I(2*k);
+		} else {
+			// f == (2*k+n-1)!/(2*k)!
+			f = f * cln::cl_I((2*k+n-2) * (2*k+n-1)) / cln::cl_I((2*k-1) * (2*k));
+			term = c.bernoulli_2k(k) * f * p;
+		}
+		sum = sum + term;
+		if (cln::abs(term) <= c.epsilon * cln::abs(sum))
+			break;
+	}
+
+	if (n == 0)
+		return sum - shift;
+	return (n & 1) ? sum + shift : -(sum + shift);
+}
+
+} // anonymous namespace
+
+/** The psi function (aka digamma function).
+ *
+ *  @exception dunno (x is a pole) */
 const numeric psi(const numeric &x)
 {
-	throw dunno();
+	const cln::cl_N x_ = x.to_cl_N();
+	return numeric(polygamma(0, x_, guess_precision(x_)));
 }
 
 
-/** The psi functions (aka polygamma functions).
- *  This is only a stub! */
+/** The psi functions (aka polygamma functions), the n-th derivative of the
+ *  digamma function.
+ *
+ *  @exception dunno (n is not a nonnegative integer or x is a pole) */
 const numeric psi(const numeric &n, const numeric &x)
 {
-	throw dunno();
+	if (!n.is_nonneg_integer())
+		throw dunno();
+	const cln::cl_N x_ = x.to_cl_N();
+	return numeric(polygamma(n.to_long(), x_, guess_precision(x_)));
 }
 
 
@@ -2161,6 +2646,89 @@ const numeric binomial(const numeric &n, const numeric &k)
 }
 
 
+namespace {
+
+// The nonvanishing Bernoulli numbers B_2, B_4, ... are computed in bulk and
+// remembered for all threads.  CLN doesn't update its reference counts
+// atomically, so the table is only touched while holding this lock and the
+// numbers handed out are copies not sharing any storage with it.
+#ifdef GINAC_THREADSAFE_REFCOUNT
+int bernoulli_table_mutex = 0;
+
+/** Scoped spin lock around accesses to the table of Bernoulli numbers. */
+class bernoulli_table_lock {
+public:
+	bernoulli_table_lock() { while (__sync_lock_test_and_set(&bernoulli_table_mutex, 1)) ; }
+	~bernoulli_table_lock() { __sync_lock_release(&bernoulli_table_mutex); }
+};
+#else
+class bernoulli_table_lock {
+public:
+	bernoulli_table_lock() {}
+};
+#endif
+
+/** B_2, B_4, ..., B_{2*size()}. */
+std::vector<cln::cl_RA> bernoulli_table;
+
+/** Make the table hold B_2, ..., B_n at least.  The caller must hold the
+ *  lock.
+ *
+ *  Method:
+ *
+ *  The defining relation
+ *
+ *      B_n = - 1/(n+1) * sum_{k=0}^{n-1}(binomial(n+1,k)*B_k)
+ *
+ *  makes every number depend on all previous ones with ever longer
+ *  fractions, so a table of N numbers costs O(N^2) rational operations on
+ *  huge numbers.  Instead, the tangent numbers T_k, the coefficients of
+ *  x^(2*k-1)/(2*k-1)! in tan(x), are computed by the integer algorithm of
+ *  R. P. Brent and D. Harvey, "Fast computation of Bernoulli, Tangent and
+ *  Secant numbers" (2011),
+ *
+ *      T_k = (k-1)*T_{k-1},                 k = 2..N, T_1 = 1,
+ *      T_j = (j-k)*T_{j-1} + (j-k+2)*T_j,   k = 2..N, j = k..N,
+ *
+ *  which only multiplies integers by small numbers, and
+ *
+ *      B_{2*k} = (-1)^(k-1) * 2*k * T_k / (4^k * (4^k-1)).
+ *
+ *  The algorithm can't be resumed, so the table is rebuilt at least twice
+ *  as long whenever it is too short. */
+void fill_bernoulli_table(unsigned n)
+{
+	const std::size_t old_size = bernoulli_table.size();
+	if (n/2 <= old_size)
+		return;
+	const std::size_t N = std::max<std::size_t>(n/2, 2*old_size);
+
+	std::vector<cln::cl_I> T(N+1);
+	T[1] = 1;
+	for (std::size_t k=2; k<=N; ++k)
+		T[k] = cln::cl_I(long(k-1)) * T[k-1];
+	for (std::size_t k=2; k<=N; ++k)
+		for (std::size_t j=k; j<=N; ++j)
+			T[j] = cln::cl_I(long(j-k)) * T[j-1] + cln::cl_I(long(j-k+2)) * T[j];
+
+	bernoulli_table.reserve(N);
+	for (std::size_t k=old_size+1; k<=N; ++k) {
+		const cln::cl_I four_k = cln::ash(1, long(2*k));
+		const cln::cl_RA b = cln::cl_I(long(2*k)) * T[k] / (four_k * (four_k - 1));
+		bernoulli_table.push_back((k & 1) ? b : -b);
+	}
+}
+
+/** A copy of x sharing no storage with it. */
+inline cln::cl_RA unshared_copy(const cln::cl_RA & x)
+{
+	// Negation always allocates a new bignum
+	return cln::cl_RA(-(-cln::numerator(x))) / (-(-cln::denominator(x)));
+}
+
+} // anonymous namespace
+
+
 /** Bernoulli number.  The nth Bernoulli number is the coefficient of x^n/n!
  *  in the expansion of the function x/(e^x-1).
  *
@@ -2171,84 +2739,63 @@ const numeric bernoulli(const numeric &nn)
 	if (!nn.is_integer() || nn.is_negative())
 		throw std::range_error("numeric::bernoulli(): argument must be integer >= 0");
 
-	// Method:
-	//
-	// The Bernoulli numbers are rational numbers that may be computed using
-	// the relation
-	//
-	//     B_n = - 1/(n+1) * sum_{k=0}^{n-1}(binomial(n+1,k)*B_k)
-	//
-	// with B(0) = 1.  Since the n'th Bernoulli number depends on all the
-	// previous ones, the computation is necessarily very expensive.  There are
-	// several other ways of computing them, a particularly good one being
-	// cl_I s = 1;
-	// cl_I c = n+1;
-	// cl_RA Bern = 0;
-	// for (unsigned i=0; i<n; i++) {
-	//     c = exquo(c*(i-n),(i+2));
-	//     Bern = Bern + c*s/(i+2);
-	//     s = s + expt_pos(cl_I(i+2),n);
-	// }
-	// return Bern;
-	// 
-	// But if somebody works with the n'th Bernoulli number she is likely to
-	// also need all previous Bernoulli numbers. So we need a complete remember
-	// table and above divide and conquer algorithm is not suited to build one
-	// up.  The formula below accomplishes this.  It is a modification of the
-	// defining formula above but the computation of the binomial coefficients
-	// is carried along in an inline fashion.  It also honors the fact that
-	// B_n is zero when n is odd and greater than 1.
-	// 
-	// (There is an interesting relation with the tangent polynomials described
-	// in `Concrete Mathematics', which leads to a program a little faster as
-	// our implementation below, but it requires storing one such polynomial in
-	// addition to the remember table.  This doubles the memory footprint so
-	// we don't use it.)
-
 	const unsigned n = nn.to_int();
 
-	// the special cases not covered by the algorithm below
+	// the special cases not covered by the table
 	if (n & 1)
 		return (n==1) ? (*_num_1_2_p) : (*_num0_p);
 	if (!n)
 		return *_num1_p;
 
-	// store nonvanishing Bernoulli numbers here
-	static std::vector< cln::cl_RA > results;
-	static unsigned next_r = 0;
+	bernoulli_table_lock lock;
+	fill_bernoulli_table(n);
+	return numeric(unshared_copy(bernoulli_table[n/2-1]));
+}
 
-	// algorithm not applicable to B(2), so just store it
-	if (!next_r) {
-		results.push_back(cln::recip(cln::cl_RA(6)));
-		next_r = 4;
-	}
-	if (n<next_r)
-		return numeric(results[n/2-1]);
-
-	results.reserve(n/2);
-	for (unsigned p=next_r; p<=n;  p+=2) {
-		cln::cl_I  c = 1;  // seed for binonmial coefficients
-		cln::cl_RA b = cln::cl_RA(p-1)/-2;
-		// The CLN manual says: "The conversion from `unsigned int' works only
-		// if the argument is < 2^29" (This is for 32 Bit machines. More
-		// generally, cl_value_len is the limiting exponent of 2. We must make
-		// sure that no intermediates are created which exceed this value. The
-		// largest intermediate is (p+3-2*k)*(p/2-k+1) <= (p^2+p)/2.
-		if (p < (1UL<<cl_value_len/2)) {
-			for (unsigned k=1; k<=p/2-1; ++k) {
-				c = cln::exquo(c * ((p+3-2*k) * (p/2-k+1)), (2*k-1)*k);
-				b = b + c*results[k-1];
-			}
-		} else {
-			for (unsigned k=1; k<=p/2-1; ++k) {
-				c = cln::exquo((c * (p+3-2*k)) * (p/2-k+1), cln::cl_I(2*k-1)*k);
-				b = b + c*results[k-1];
-			}
- 		}
-		results.push_back(-b/(p+1));
+
+/** Compute the Bernoulli numbers up to B_n at once, so that bernoulli()
+ *  just looks them up.  This is faster than letting the table grow with the
+ *  arguments of bernoulli() when many of them are going to be needed. */
+void fill_bernoulli(unsigned n)
+{
+	bernoulli_table_lock lock;
+	fill_bernoulli_table(n);
+}
+
+
+/** The table of Bernoulli numbers as a list written by serialize(), see
+ *  save_caches().  The numbers only exist while the lock is held. */
+std::string save_bernoulli_table()
+{
+	std::string buf;
+	bernoulli_table_lock lock;
+	lst l;
+	for (std::size_t k=0; k<bernoulli_table.size(); ++k)
+		l.append(numeric(bernoulli_table[k]));
+	serialize(l, buf);
+	return buf;
+}
+
+
+/** Replace the table of Bernoulli numbers by one written by
+ *  save_bernoulli_table() if that is longer. */
+void load_bernoulli_table(const std::string & buf)
+{
+	lst syms;
+	bernoulli_table_lock lock;
+	const ex l = deserialize(buf, syms);
+	if (!is_a<lst>(l))
+		throw std::runtime_error("load_caches(): invalid table of Bernoulli numbers");
+	if (l.nops() <= bernoulli_table.size())
+		return;
+	std::vector<cln::cl_RA> table;
+	table.reserve(l.nops());
+	for (std::size_t k=0; k<l.nops(); ++k) {
+		if (!is_a<numeric>(l.op(k)) || !ex_to<numeric>(l.op(k)).is_rational())
+			throw std::runtime_error("load_caches(): invalid table of Bernoulli numbers");
+		table.push_back(cln::the<cln::cl_RA>(ex_to<numeric>(l.op(k)).to_cl_N()));
 	}
-	next_r = n+2;
-	return numeric(results[n/2-1]);
+	bernoulli_table.swap(table);
 }
 
 
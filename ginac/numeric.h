@@ -103,6 +103,7 @@ public:
 	// functions overriding virtual functions from base classes
 public:
 	unsigned precedence() const {return 30;}
+	std::size_t footprint() const;
 	bool info(unsigned inf) const;
 	bool is_polynomial(const ex & var) const;
 	int degree(const ex & s) const;
@@ -111,6 +112,7 @@ public:
 	bool has(const ex &other, unsigned options = 0) const;
 	ex eval(int level = 0) const;
 	ex evalf(int level = 0) const;
+	std::complex<double> evalf_double(const evalf_double_map & values) const;
 	ex subs(const exmap & m, unsigned options = 0) const { return subs_one_level(m, options); } // overwrites basic::subs() for performance reasons
 	ex normal(exmap & repl, exmap & rev_lookup, int level = 0) const;
 	ex to_rational(exmap & repl) const;
@@ -131,6 +133,7 @@ protected:
 	ex derivative(const symbol &s) const { return 0; }
 	bool is_equal_same_type(const basic &other) const;
 	unsigned calchash() const;
+	unsigned calc_symbol_mask() const { return 0; }
 	
 	// new virtual functions which can be overridden by derived classes
 	// (none)
@@ -238,6 +241,7 @@ const numeric factorial(const numeric &n);
 const numeric doublefactorial(const numeric &n);
 const numeric binomial(const numeric &n, const numeric &k);
 const numeric bernoulli(const numeric &n);
+void fill_bernoulli(unsigned n);
 const numeric fibonacci(const numeric &n);
 const numeric isqrt(const numeric &x);
 const numeric sqrt(const numeric &x);
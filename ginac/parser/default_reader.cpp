@@ -64,7 +64,7 @@ static ex lst_reader(const exvector& ev)
 class registered_functions_hack : public function
 {
 public:
-	static const std::vector<function_options>& get_registered_functions()
+	static const function_registry& get_registered_functions()
 	{
 		return function::registered_functions();
 	}
@@ -96,15 +96,11 @@ const prototype_table& get_default_reader()
 		reader[make_pair("pow", 2)] = pow_reader;
 		reader[make_pair("power", 2)] = power_reader;
 		reader[make_pair("lst", 0)] = lst_reader;
-		std::vector<function_options>::const_iterator it =
-			registered_functions_hack::get_registered_functions().begin();
-		std::vector<function_options>::const_iterator end =
-			registered_functions_hack::get_registered_functions().end();
-		unsigned serial = 0;
-		for (; it != end; ++it) {
-			prototype proto = make_pair(it->get_name(), it->get_nparams());
+		const function_registry& rf =
+			registered_functions_hack::get_registered_functions();
+		for (unsigned serial = 0; serial < rf.size(); ++serial) {
+			prototype proto = make_pair(std::string(rf.name(serial)), rf.nparams(serial));
 			reader[proto] = encode_serial_as_reader_func(serial);
-			++serial;
 		}
 		initialized = true;
 	}
@@ -152,11 +148,10 @@ const prototype_table& get_builtin_reader()
 			Order,
 			NFUNCTIONS
 		};
-		std::vector<function_options>::const_iterator it =
-			registered_functions_hack::get_registered_functions().begin();
-		unsigned serial = 0;
-		for ( ; serial<NFUNCTIONS; ++it, ++serial ) {
-			prototype proto = make_pair(it->get_name(), it->get_nparams());
+		const function_registry& rf =
+			registered_functions_hack::get_registered_functions();
+		for (unsigned serial = 0; serial<NFUNCTIONS; ++serial) {
+			prototype proto = make_pair(std::string(rf.name(serial)), rf.nparams(serial));
 			reader[proto] = encode_serial_as_reader_func(serial);
 		}
 		initialized = true;
@@ -27,35 +27,52 @@
 #include <sstream>
 #include <string>
 #include <cstdio>
+#include <cstring>
 
 namespace GiNaC {
 
-/// Skip to the end of line
-static int skipline(std::istream* s);
-/// Skip to the next non-whitespace character
-static int skipspace(std::istream* s, int c, std::size_t& line);
 /// Check if the identifier is predefined literal
-static bool literal_p(const std::string& name);
+static bool literal_p(const char* name, std::size_t len);
+
+inline int lexer::get()
+{
+	if (next)
+		return next != limit ? static_cast<unsigned char>(*next++) : EOF;
+	return input->get();
+}
 
 /// gettok - Return the next token from standard input.
 int lexer::gettok()
 {
 	// Skip any whitespace.
-	c = skipspace(input, c, line_num);
+	skipspace();
 
 	// identifier: [a-zA-Z][a-zA-Z0-9_]*
 	if (isalpha(c)) { 
-		str = c;
-		do {
-			c = input->get();
-			if ( isalnum(c) || c=='_' )
-				str += c;
-			else
-				break;
-		} while (true);
-		if (unlikely(literal_p(str)))
+		if (next) {
+			// Point to the identifier in the buffer
+			tok = next - 1;
+			do {
+				c = get();
+			} while (isalnum(c) || c=='_');
+			tok_len = (c == EOF ? next : next - 1) - tok;
+		} else {
+			str = c;
+			do {
+				c = get();
+				if ( isalnum(c) || c=='_' )
+					str += c;
+				else
+					break;
+			} while (true);
+			tok = str.data();
+			tok_len = str.size();
+		}
+		if (unlikely(literal_p(tok, tok_len))) {
+			if (next)
+				str.assign(tok, tok_len);
 			return token_type::literal;
-		else
+		} else
 			return token_type::identifier;
 	}
 
@@ -64,16 +81,16 @@ int lexer::gettok()
 		str = "";
 		do {
 			str += c;
-			c = input->get();
+			c = get();
 		} while (isdigit(c) || c == '.');
 		if (c == 'E' || c == 'e') {
 			str += 'E';
-			c = input->get();
+			c = get();
 			if (isdigit(c))
 				str += '+';
 			do {
 				str += c;
-				c = input->get();
+				c = get();
 			} while (isdigit(c));
 		}
 		return token_type::number;
@@ -81,7 +98,7 @@ int lexer::gettok()
 
 	// Comment until end of line.
 	if (c == '#') {
-		c = skipline(input);
+		skipline();
 		++line_num;
 		if (c != EOF)
 			return gettok();
@@ -93,41 +110,42 @@ int lexer::gettok()
 
 	// Otherwise, just return the character as its ascii value.
 	int current = c;
-	c = input->get();
+	c = get();
 	return current;
 }
 
-static int skipline(std::istream* s)
+/// Skip to the end of line
+void lexer::skipline()
 {
-	int c;
 	do {
-		c = s->get();
+		c = get();
 	} while (c != EOF && c != '\n' && c != '\r');
-	return c;
 }
 
-static int skipspace(std::istream* s, int c, std::size_t& line)
+/// Skip to the next non-whitespace character
+void lexer::skipspace()
 {
 	while (isspace(c)) {
 		if (c == '\n')
-			++line;
-		c = s->get();
+			++line_num;
+		c = get();
 	}
-	return c;
 }
 
-static bool literal_p(const std::string& name)
+static bool literal_p(const char* name, std::size_t len)
 {
-	if (name == "I")
-		return true;
-	else if (name == "Pi")
-		return true;
-	else if (name == "Euler")
-		return true;
-	else if (name == "Catalan")
-		return true;
-	else
-		return false; 
+	switch (len) {
+		case 1:
+			return name[0] == 'I';
+		case 2:
+			return std::memcmp(name, "Pi", 2) == 0;
+		case 5:
+			return std::memcmp(name, "Euler", 5) == 0;
+		case 7:
+			return std::memcmp(name, "Catalan", 7) == 0;
+		default:
+			return false;
+	}
 }
 
 lexer::lexer(std::istream* in, std::ostream* out, std::ostream* err)
@@ -147,8 +165,11 @@ lexer::lexer(std::istream* in, std::ostream* out, std::ostream* err)
 	else
 		error = &std::cerr;
 
+	next = limit = 0;
 	c = ' ';
 	str = "";
+	tok = str.data();
+	tok_len = 0;
 	line_num = 0;
 	column = 0;
 }
@@ -158,6 +179,16 @@ lexer::~lexer() { }
 void lexer::switch_input(std::istream* in)
 {
 	input = in;
+	next = limit = 0;
+	line_num = 0;
+	column = 0;
+	c = ' ';
+}
+
+void lexer::switch_input(const char* begin, const char* end)
+{
+	next = begin;
+	limit = end;
 	line_num = 0;
 	column = 0;
 	c = ' ';
@@ -168,6 +199,7 @@ std::string lexer::tok2str(const int tok) const
 {
 	switch (tok) {
 		case lexer::token_type::identifier:
+			return std::string("\"") + std::string(tok, tok_len) + "\"";
 		case lexer::token_type::number:
 			return std::string("\"") + str + "\"";
 		case lexer::token_type::eof:
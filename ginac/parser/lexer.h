@@ -34,13 +34,25 @@ class lexer
 	std::istream* input;
 	std::ostream* output;
 	std::ostream* error;
+	/// next character of the buffer and its end, if not reading from stream
+	const char* next;
+	const char* limit;
 	/// last character read from stream
 	int c;
-	/// identifier and number tokens are stored here
+	/// number and literal tokens are stored here, identifiers too when
+	/// reading from a stream
 	std::string str;
+	/// identifier token, points into the buffer or to str
+	const char* tok;
+	std::size_t tok_len;
 	std::size_t line_num;
 	std::size_t column;
 	friend class parser;
+
+	/// read the next character, EOF at the end of input
+	int get();
+	void skipline();
+	void skipspace();
 public:
 
 	lexer(std::istream* in = 0, std::ostream* out = 0, std::ostream* err = 0);
@@ -48,6 +60,11 @@ public:
 
 	int gettok();
 	void switch_input(std::istream* in);
+	/// read the characters [@a begin, @a end) instead of a stream,
+	/// without copying them
+	void switch_input(const char* begin, const char* end);
+	/// whether tokens point into a buffer which outlives them
+	bool buffered() const { return next != 0; }
 
 	struct token_type
 	{
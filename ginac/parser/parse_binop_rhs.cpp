@@ -35,44 +35,56 @@
 
 namespace GiNaC {
 
-/// Make a sum or a product.
-static ex make_binop_expr(const int binop, const exvector& args);
+/// Make a sum, a product or a power of the operands of a run.
+static ex make_binop_expr(const int run, const exvector& args);
+/// Make the operand of a run from the operand after a binary operator.
+static ex make_operand(const int binop, const ex& rhs);
 /// Check if the token is a binary operator. 
 static inline bool is_binop(const int c);
 /// Get the precedence of the pending binary operator.
 static int get_tok_prec(const int c);
+/// Get the kind of run the binary operator belongs to: '+' for sums and
+/// differences, '*' for products and quotients, '^' for powers.
+static inline int get_run(const int c);
 
 /// binoprhs: ([+*/^-] primary)*
 ex parser::parse_binop_rhs(int expr_prec, ex& lhs)
 {
+	// Minimize the number of eval() and ctor calls. This is crucial for
+	// a reasonable performance. Operands of consecutive operators of the
+	// same kind are collected, with differences and quotients turned into
+	// sums of negated operands and products of inverted ones, and the
+	// expression is only created when the run ends.
 	exvector args;
 	args.push_back(lhs);
-	int binop = -1, orig_binop = -1;
-	bool need_sign_flip = false;
+	int run = -1;
 	while (1) {
 		// check if this is a binop
 		if (!is_binop(token)) {
 			if (args.size() > 1)
-				return make_binop_expr(orig_binop, args);
+				return make_binop_expr(run, args);
 			else
-				return lhs;
+				return args[0];
 		}
-		
-		// Okay, we know this is a binop.
-		if (args.size() == 1)
-			orig_binop = token;
-
-		binop = token;
 
 		// If this is a binop that binds at least as tightly as
 		// the current binop, consume it, otherwise we are done.
 		int tok_prec = get_tok_prec(token);
 		if (tok_prec < expr_prec) {
 			if (args.size() > 1)
-				return make_binop_expr(orig_binop, args);
+				return make_binop_expr(run, args);
 			else 
-				return lhs;
+				return args[0];
+		}
+
+		// An operator of another kind ends the pending run.
+		const int binop = token;
+		if (args.size() > 1 && get_run(binop) != run) {
+			lhs = make_binop_expr(run, args);
+			args.clear();
+			args.push_back(lhs);
 		}
+		run = get_run(binop);
 
 		get_next_tok();  // eat binop
 
@@ -85,69 +97,31 @@ ex parser::parse_binop_rhs(int expr_prec, ex& lhs)
 		if (tok_prec < next_prec)
 			rhs = parse_binop_rhs(tok_prec + 1, rhs);
 
-		// previous operator was '+', and current one is '-'
-		// (or vice a versa).
-		if (need_sign_flip)
-			rhs = - rhs;
-
-		args.push_back(rhs);
-
-		// Minimize the number of eval() and ctor calls. This is
-		// crucial for a reasonable performance. If the next operator
-		// is compatible with the pending one (or the same) don't create
-		// the expression and continue collecting operands instead.
-		if (binop == token)
-			continue;
-		else if (binop == '+' && token == '-') {
-			need_sign_flip = token != orig_binop;
-			continue;
-		} else if (binop == '-' && token == '+') {
-			need_sign_flip = token != orig_binop;
-			continue;
-		} else { 
-			if (args.size() <= 1)
-				bug("binop has " << args.size() << " arguments, expected >= 2");
-			lhs = make_binop_expr(orig_binop, args);
-			args.clear();
-			args.push_back(lhs);
-		}
+		args.push_back(make_operand(binop, rhs));
 	}
 }
 
 extern const numeric* _num_1_p;
 
-static ex make_minus_expr(const exvector& args)
+static ex make_operand(const int binop, const ex& rhs)
 {
-	exvector rest_args;
-	rest_args.reserve(args.size() - 1);
-	std::copy(args.begin() + 1, args.end(), std::back_inserter(rest_args));
-	ex rest_base = (new add(rest_args))->setflag(status_flags::dynallocated);
-	ex rest = (new mul(rest_base, *_num_1_p))->setflag(status_flags::dynallocated);
-	ex ret = (new add(args[0], rest))->setflag(status_flags::dynallocated);
-	return ret;
-}
-
-static ex make_divide_expr(const exvector& args)
-{
-	exvector rest_args;
-	rest_args.reserve(args.size() - 1);
-	std::copy(args.begin() + 1, args.end(), std::back_inserter(rest_args));
-	ex rest_base = (new mul(rest_args))->setflag(status_flags::dynallocated);
-	ex rest = pow(rest_base, *_num_1_p);
-	return (new mul(args[0], rest))->setflag(status_flags::dynallocated);
+	switch (binop) {
+		case '-':
+			return (new mul(rhs, *_num_1_p))->setflag(status_flags::dynallocated);
+		case '/':
+			return pow(rhs, *_num_1_p);
+		default:
+			return rhs;
+	}
 }
 
-static ex make_binop_expr(const int binop, const exvector& args)
+static ex make_binop_expr(const int run, const exvector& args)
 {
-	switch (binop) {
+	switch (run) {
 		case '+':
 			return (new add(args))->setflag(status_flags::dynallocated);
-		case '-':
-			return make_minus_expr(args);
 		case '*':
 			return (new mul(args))->setflag(status_flags::dynallocated);
-		case '/':
-			return make_divide_expr(args);
 		case '^':
 			if (args.size() != 2)
 				throw std::invalid_argument(
@@ -158,7 +132,21 @@ static ex make_binop_expr(const int binop, const exvector& args)
 			throw std::invalid_argument(
 					std::string(__func__) 
 					+ ": invalid binary operation: " 
-					+ char(binop));
+					+ char(run));
+	}
+}
+
+static inline int get_run(const int c)
+{
+	switch (c) {
+		case '+':
+		case '-':
+			return '+';
+		case '*':
+		case '/':
+			return '*';
+		default:
+			return c;
 	}
 }
 
@@ -0,0 +1,295 @@
+/** @file parse_parallel.cpp
+ *
+ *  Parsing of large sums by several threads. */
+
+/*
+ *  GiNaC Copyright (C) 1999-2014 Johannes Gutenberg University Mainz, Germany
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#include "parser.h"
+#include "add.h"
+#include "tasks.h"
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <algorithm>
+#include <cctype>
+#include <fstream>
+#include <iterator>
+#include <stdexcept>
+#include <string>
+#include <vector>
+#if defined(GINAC_THREADSAFE_REFCOUNT) && defined(HAVE_PTHREAD_H)
+// The terms of a sum are only parsed concurrently if expressions may be
+// shared between threads at all.
+#define PARALLEL_PARSER 1
+#endif
+
+namespace GiNaC {
+
+static unsigned parser_threads = 1;
+
+/** Set the number of threads the parser uses for the terms of large sums.
+ *  This has an effect only if GiNaC was built with
+ *  GINAC_THREADSAFE_REFCOUNT and pthreads.
+ *
+ *  @return previous setting */
+unsigned set_parser_threads(unsigned n)
+{
+	const unsigned previous = parser_threads;
+	parser_threads = (n == 0 ? 1 : n);
+	return previous;
+}
+
+/** Get the number of threads used by the parser. */
+unsigned get_parser_threads()
+{
+	return parser_threads;
+}
+
+#ifdef PARALLEL_PARSER
+
+namespace {
+
+/** Shorter input is parsed by the calling thread alone. */
+const std::size_t min_parallel_size = 1 << 12;
+
+/** Parsing of a slice of the terms of a sum, to be run as a task.  The symbol table is only read, since all symbols of the input
+ *  are in it already. */
+struct parse_job {
+	const char* begin;
+	const char* end;
+	bool polynomial;
+	const symtab* syms;
+	const prototype_table* funcs;
+	ex result;
+	bool failed;
+};
+
+void * run_parse_job(void * arg)
+{
+	parse_job & job = *static_cast<parse_job *>(arg);
+	try {
+		parser reader(*job.syms, true, *job.funcs);
+		reader.split_input = false;
+		if (job.polynomial)
+			job.result = reader.parse_polynomial(job.begin, job.end);
+		else
+			job.result = reader(job.begin, job.end);
+	} catch (...) {
+		job.failed = true;
+	}
+	return 0;
+}
+
+inline bool is_literal(const std::string& name)
+{
+	return name == "I" || name == "Pi" || name == "Euler" || name == "Catalan";
+}
+
+} // anonymous namespace
+
+/// Find the '+' and '-' signs outside of parentheses which separate the
+/// terms of a sum, and put all symbols of the input into the symbol table.
+/// Tokens are recognized like the lexer does.
+/// @return false if the input is not a sum at its top level
+bool parser::scan_terms(const char* p, const char* end, std::vector<const char*>& signs)
+{
+	int depth = 0;
+	bool operand = false;	// whether the previous token ends an operand
+	std::string name;
+	while (p != end) {
+		const unsigned char c = *p;
+		if (std::isspace(c)) {
+			++p;
+		} else if (c == '#') {
+			while (p != end && *p != '\n' && *p != '\r')
+				++p;
+		} else if (std::isalpha(c)) {
+			const char* start = p;
+			do {
+				++p;
+			} while (p != end && (std::isalnum(static_cast<unsigned char>(*p)) || *p == '_'));
+			name.assign(start, p);
+			const char* q = p;
+			while (q != end && std::isspace(static_cast<unsigned char>(*q)))
+				++q;
+			if ((q == end || *q != '(') && !is_literal(name))
+				find_or_insert_symbol(name, syms, strict);
+			operand = true;
+		} else if (std::isdigit(c) || c == '.') {
+			do {
+				++p;
+			} while (p != end && (std::isdigit(static_cast<unsigned char>(*p)) || *p == '.'));
+			if (p != end && (*p == 'E' || *p == 'e')) {
+				++p;
+				if (p != end)
+					++p;	// sign or first digit of the exponent
+				while (p != end && std::isdigit(static_cast<unsigned char>(*p)))
+					++p;
+			}
+			operand = true;
+		} else if (c == '(' || c == '{' || c == '[') {
+			++depth;
+			operand = false;
+			++p;
+		} else if (c == ')' || c == '}' || c == ']') {
+			--depth;
+			operand = true;
+			++p;
+		} else if (c == '+' || c == '-') {
+			if (depth == 0 && operand)
+				signs.push_back(p);
+			operand = false;
+			++p;
+		} else if (depth == 0 && (c == ',' || c == '=' || c == '<' || c == '>' || c == '!')) {
+			return false;
+		} else {
+			operand = false;
+			++p;
+		}
+	}
+	return depth == 0;
+}
+
+/// Parse the terms of a large sum in [@a begin, @a end) concurrently (see
+/// set_parser_threads()).  The input is split at the signs between terms
+/// into slices of about equal length, which are parsed by parsers of their
+/// own and added up.  The slices are run as tasks, the first one by the
+/// calling thread.
+/// @return false if the input has to be parsed by one thread instead
+bool parser::parse_parallel(const char* begin, const char* end, bool polynomial, ex& result)
+{
+	if (!split_input || parser_threads < 2 || std::size_t(end - begin) < min_parallel_size)
+		return false;
+	std::vector<const char*> signs;
+	if (!scan_terms(begin, end, signs) || signs.empty())
+		return false;
+
+	const std::size_t nthreads = std::min<std::size_t>(parser_threads, signs.size() + 1);
+	std::vector<parse_job> jobs(nthreads);
+	const char* first = begin;
+	std::vector<const char*>::const_iterator s = signs.begin();
+	for (std::size_t k = 0; k < nthreads; ++k) {
+		parse_job & job = jobs[k];
+		const char* last = end;
+		if (k + 1 < nthreads) {
+			const char* target = begin + (end - begin) * (k + 1) / nthreads;
+			while (s != signs.end() && *s <= first)
+				++s;
+			while (s != signs.end() && *s < target)
+				++s;
+			if (s != signs.end())
+				last = *s;
+		}
+		job.begin = first;
+		job.end = last;
+		job.polynomial = polynomial;
+		job.syms = &syms;
+		job.funcs = &funcs;
+		job.failed = false;
+		first = last;
+	}
+
+	std::vector<void *> args;
+	for (std::size_t k = 0; k < nthreads; ++k)
+		if (k == 0 || jobs[k].begin != jobs[k].end)
+			args.push_back(&jobs[k]);
+	run_tasks(run_parse_job, &args[0], args.size());
+
+	exvector terms;
+	for (std::size_t k = 0; k < nthreads; ++k) {
+		if (jobs[k].failed)
+			return false;
+		if (jobs[k].begin != jobs[k].end)
+			terms.push_back(jobs[k].result);
+	}
+	result = (new add(terms))->setflag(status_flags::dynallocated);
+	return true;
+}
+
+#else // def PARALLEL_PARSER
+
+bool parser::scan_terms(const char* p, const char* end, std::vector<const char*>& signs)
+{
+	return false;
+}
+
+bool parser::parse_parallel(const char* begin, const char* end, bool polynomial, ex& result)
+{
+	return false;
+}
+
+#endif // def PARALLEL_PARSER
+
+/// Parse the shards of a sum, one task for each shard, and add them up.
+/// The shards are parsed one after the other if one of them is
+/// not a sum at its top level, or if parsing one of them fails.
+ex parser::parse_shards(const std::vector<std::string>& shards)
+{
+	exvector terms;
+	terms.reserve(shards.size());
+#ifdef PARALLEL_PARSER
+	std::vector<const char*> signs;
+	bool parallel = shards.size() > 1;
+	for (std::size_t k = 0; parallel && k < shards.size(); ++k) {
+		signs.clear();
+		const char* begin = shards[k].data();
+		parallel = scan_terms(begin, begin + shards[k].size(), signs);
+	}
+	if (parallel) {
+		const std::size_t nthreads = shards.size();
+		std::vector<parse_job> jobs(nthreads);
+		for (std::size_t k = 0; k < nthreads; ++k) {
+			parse_job & job = jobs[k];
+			job.begin = shards[k].data();
+			job.end = job.begin + shards[k].size();
+			job.polynomial = true;
+			job.syms = &syms;
+			job.funcs = &funcs;
+			job.failed = false;
+		}
+
+		run_tasks(run_parse_job, jobs);
+
+		for (std::size_t k = 0; k < nthreads && !jobs[k].failed; ++k)
+			terms.push_back(jobs[k].result);
+		if (terms.size() == nthreads)
+			return (new add(terms))->setflag(status_flags::dynallocated);
+		terms.clear();
+	}
+#endif // def PARALLEL_PARSER
+	for (std::size_t k = 0; k < shards.size(); ++k)
+		terms.push_back(parse_polynomial(shards[k]));
+	return (new add(terms))->setflag(status_flags::dynallocated);
+}
+
+ex parser::parse_shard_files(const std::vector<std::string>& filenames)
+{
+	std::vector<std::string> shards(filenames.size());
+	for (std::size_t k = 0; k < filenames.size(); ++k) {
+		std::ifstream file(filenames[k].c_str(), std::ios::in | std::ios::binary);
+		if (!file)
+			throw std::runtime_error("parse_shard_files(): can not read " + filenames[k]);
+		shards[k].assign(std::istreambuf_iterator<char>(file),
+		                 std::istreambuf_iterator<char>());
+	}
+	return parse_shards(shards);
+}
+
+} // namespace GiNaC
@@ -0,0 +1,237 @@
+/** @file parse_polynomial.cpp
+ *
+ *  Fast path of the parser for polynomials which are written out as sums
+ *  of monomials. */
+
+/*
+ *  GiNaC Copyright (C) 1999-2014 Johannes Gutenberg University Mainz, Germany
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#include "parser.h"
+#include "lexer.h"
+#include "add.h"
+#include "mul.h"
+#include "numeric.h"
+#include "symbol.h"
+#include "utils.h"
+
+#include <cctype>
+#include <string>
+
+namespace GiNaC {
+
+namespace {
+
+/**
+ * Reader of sums of monomials c*x1^n1*...*xk^nk (in any order of the
+ * factors), where c is a product of integers and inverse integers and the
+ * exponents n1...nk are integers.  The characters are scanned in place and
+ * the terms are collected in a single sequence, instead of building and
+ * flattening a tree of binary sums and products.  Anything else makes
+ * read() fail, so that the input can be handed to the general parser.
+ */
+class polynomial_reader
+{
+public:
+	polynomial_reader(const char* b, const char* e, symtab& s, bool st)
+		: p(b), end(e), syms(s), strict(st) { }
+
+	bool read(ex& result);
+private:
+	void skip_space()
+	{
+		while (p != end && std::isspace(static_cast<unsigned char>(*p)))
+			++p;
+	}
+	bool read_integer(numeric& n);
+	bool read_factor(numeric& coeff, epvector& factors);
+	bool read_term(numeric& coeff, epvector& factors);
+
+	const char* p;
+	const char* const end;
+	symtab& syms;
+	const bool strict;
+	/// buffer for identifiers and long numbers
+	std::string str;
+};
+
+/// integer: [0-9]+
+bool polynomial_reader::read_integer(numeric& n)
+{
+	const char* start = p;
+	unsigned long value = 0;
+	while (p != end && std::isdigit(static_cast<unsigned char>(*p))) {
+		value = 10*value + (*p - '0');
+		++p;
+	}
+	if (p == start)
+		return false;
+	// Floating point numbers and such are left to the general parser.
+	if (p != end && (std::isalpha(static_cast<unsigned char>(*p)) || *p == '.' || *p == '_'))
+		return false;
+	if (p - start <= 9)
+		n = numeric(static_cast<long>(value));
+	else {
+		str.assign(start, p);
+		n = numeric(str.c_str());
+	}
+	return true;
+}
+
+/// factor: integer | identifier [ '^' ['-'] integer ]
+bool polynomial_reader::read_factor(numeric& coeff, epvector& factors)
+{
+	if (p == end)
+		return false;
+	if (std::isdigit(static_cast<unsigned char>(*p))) {
+		numeric n;
+		if (!read_integer(n))
+			return false;
+		coeff = coeff.mul(n);
+		return true;
+	}
+	if (!std::isalpha(static_cast<unsigned char>(*p)))
+		return false;
+
+	const char* start = p;
+	do {
+		++p;
+	} while (p != end && (std::isalnum(static_cast<unsigned char>(*p)) || *p == '_'));
+	str.assign(start, p);
+	if (str == "I" || str == "Pi" || str == "Euler" || str == "Catalan")
+		return false;
+	if (strict && syms.find(str) == syms.end())
+		return false;
+	ex s = find_or_insert_symbol(str, syms, strict);
+	if (!is_a<symbol>(s))
+		return false;
+
+	skip_space();
+	if (p != end && *p == '(')
+		return false;	// function call
+	numeric exponent = *_num1_p;
+	if (p != end && *p == '^') {
+		++p;
+		skip_space();
+		bool negative = false;
+		if (p != end && *p == '-') {
+			negative = true;
+			++p;
+		}
+		if (!read_integer(exponent))
+			return false;
+		if (negative)
+			exponent = exponent.mul(*_num_1_p);
+	}
+	if (!exponent.is_zero())
+		factors.push_back(expair(s, exponent));
+	return true;
+}
+
+/// term: factor ([*/] factor)*, where only integers may follow '/'
+bool polynomial_reader::read_term(numeric& coeff, epvector& factors)
+{
+	coeff = *_num1_p;
+	factors.clear();
+	skip_space();
+	if (!read_factor(coeff, factors))
+		return false;
+	while (true) {
+		skip_space();
+		if (p == end)
+			return true;
+		if (*p == '*') {
+			++p;
+			skip_space();
+			if (!read_factor(coeff, factors))
+				return false;
+		} else if (*p == '/') {
+			++p;
+			skip_space();
+			numeric n;
+			if (!read_integer(n) || n.is_zero())
+				return false;
+			coeff = coeff.div(n);
+		} else
+			return true;
+	}
+}
+
+/// polynomial: ['+'|'-'] term (('+'|'-') term)*
+bool polynomial_reader::read(ex& result)
+{
+	epvector terms;
+	numeric overall_coeff;
+	numeric coeff;
+	epvector factors;
+	skip_space();
+	do {
+		bool negative = false;
+		if (p != end && (*p == '+' || *p == '-')) {
+			negative = (*p == '-');
+			++p;
+		}
+		if (!read_term(coeff, factors))
+			return false;
+		if (negative)
+			coeff = coeff.mul(*_num_1_p);
+
+		if (factors.empty())
+			overall_coeff = overall_coeff.add(coeff);
+		else if (factors.size() == 1 && factors[0].coeff.is_equal(*_num1_p))
+			terms.push_back(expair(factors[0].rest, coeff));
+		else {
+			ex monomial = (new mul(factors))->setflag(status_flags::dynallocated);
+			if (is_exactly_a<numeric>(monomial))	// factors cancelled
+				overall_coeff = overall_coeff.add(coeff.mul(ex_to<numeric>(monomial)));
+			else
+				terms.push_back(expair(monomial, coeff));
+		}
+
+		skip_space();
+	} while (p != end && (*p == '+' || *p == '-'));
+
+	if (p != end)
+		return false;
+	result = (new add(terms, overall_coeff))->setflag(status_flags::dynallocated);
+	return true;
+}
+
+} // anonymous namespace
+
+/// Parse the polynomial in [@a begin, @a end). If the input is not a sum
+/// of monomials with integer or rational coefficients and integer
+/// exponents, it is parsed like operator() does.
+ex parser::parse_polynomial(const char* begin, const char* end)
+{
+	ex ret;
+	if (parse_parallel(begin, end, true, ret))
+		return ret;
+	polynomial_reader reader(begin, end, syms, strict);
+	if (reader.read(ret))
+		return ret;
+	scanner->switch_input(begin, end);
+	return parse_input();
+}
+
+ex parser::parse_polynomial(const std::string& input)
+{
+	const char* begin = input.data();
+	return parse_polynomial(begin, begin + input.size());
+}
+
+} // namespace GiNaC
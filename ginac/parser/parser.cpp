@@ -34,6 +34,7 @@
 #ifdef HAVE_STDINT_H
 #include <stdint.h> // for uintptr_t
 #endif
+#include <cstring>
 #include <sstream>
 #include <stdexcept>
 
@@ -69,16 +70,143 @@ static ex dispatch_reader_fcn(const reader_func ptr, const exvector& args)
 // </KLUDGE>
 
 
+/// Hash of the bytes of a name (FNV-1a)
+static inline std::size_t hash_name(const char* name, std::size_t len)
+{
+	std::size_t h = 2166136261u;
+	for (std::size_t i = 0; i < len; ++i) {
+		h ^= static_cast<unsigned char>(name[i]);
+		h *= 16777619u;
+	}
+	return h;
+}
+
+/// Look up the symbol (or abbreviation) with the given name like
+/// find_or_insert_symbol() does, but only construct a string for names
+/// which are not in the cache of symbols found in this parse.
+ex parser::find_symbol(const char* name, std::size_t len)
+{
+	if (symbol_cache.empty())
+		symbol_cache.resize(64);
+	std::size_t mask = symbol_cache.size() - 1;
+	std::size_t i = hash_name(name, len) & mask;
+	while (!symbol_cache[i].name.empty()) {
+		const std::string& n = symbol_cache[i].name;
+		if (n.size() == len && std::memcmp(n.data(), name, len) == 0)
+			return symbol_cache[i].value;
+		i = (i + 1) & mask;
+	}
+
+	std::string s(name, len);
+	ex value = find_or_insert_symbol(s, syms, strict);
+
+	// Keep the table at most half full
+	if (2 * (symbol_cache_used + 1) > symbol_cache.size()) {
+		std::vector<symbol_cache_entry> old(2 * symbol_cache.size());
+		old.swap(symbol_cache);
+		mask = symbol_cache.size() - 1;
+		for (std::vector<symbol_cache_entry>::iterator e = old.begin(); e != old.end(); ++e) {
+			if (e->name.empty())
+				continue;
+			std::size_t j = hash_name(e->name.data(), e->name.size()) & mask;
+			while (!symbol_cache[j].name.empty())
+				j = (j + 1) & mask;
+			symbol_cache[j].name.swap(e->name);
+			symbol_cache[j].value = e->value;
+		}
+		i = hash_name(name, len) & mask;
+		while (!symbol_cache[i].name.empty())
+			i = (i + 1) & mask;
+	}
+	symbol_cache[i].name.swap(s);
+	symbol_cache[i].value = value;
+	++symbol_cache_used;
+	return value;
+}
+
+void parser::reset_symbol_cache()
+{
+	if (symbol_cache_used == 0)
+		return;
+	for (std::vector<symbol_cache_entry>::iterator e = symbol_cache.begin(); e != symbol_cache.end(); ++e) {
+		if (!e->name.empty()) {
+			e->name.clear();
+			e->value = ex();
+		}
+	}
+	symbol_cache_used = 0;
+}
+
+/// Look up the prototype of a function with the given name and number of
+/// arguments in funcs, remembering the result so that repeated calls of
+/// the same function cost one hash computation.
+prototype_table::const_iterator
+parser::find_prototype(const char* name, std::size_t len, std::size_t nargs)
+{
+	if (prototype_cache.empty())
+		prototype_cache.resize(64);
+	std::size_t mask = prototype_cache.size() - 1;
+	const std::size_t h = hash_name(name, len) + 31 * nargs;
+	std::size_t i = h & mask;
+	while (!prototype_cache[i].name.empty()) {
+		const prototype_cache_entry& e = prototype_cache[i];
+		if (e.nargs == nargs && e.name.size() == len && std::memcmp(e.name.data(), name, len) == 0)
+			return e.reader;
+		i = (i + 1) & mask;
+	}
+
+	std::string s(name, len);
+	prototype_table::const_iterator reader = funcs.find(make_pair(s, nargs));
+	if (reader == funcs.end())
+		return reader;
+
+	// Keep the table at most half full
+	if (2 * (prototype_cache_used + 1) > prototype_cache.size()) {
+		std::vector<prototype_cache_entry> old(2 * prototype_cache.size());
+		old.swap(prototype_cache);
+		mask = prototype_cache.size() - 1;
+		for (std::vector<prototype_cache_entry>::iterator e = old.begin(); e != old.end(); ++e) {
+			if (e->name.empty())
+				continue;
+			std::size_t j = (hash_name(e->name.data(), e->name.size()) + 31 * e->nargs) & mask;
+			while (!prototype_cache[j].name.empty())
+				j = (j + 1) & mask;
+			prototype_cache[j].name.swap(e->name);
+			prototype_cache[j].nargs = e->nargs;
+			prototype_cache[j].reader = e->reader;
+		}
+		i = h & mask;
+		while (!prototype_cache[i].name.empty())
+			i = (i + 1) & mask;
+	}
+	prototype_cache[i].name.swap(s);
+	prototype_cache[i].nargs = nargs;
+	prototype_cache[i].reader = reader;
+	++prototype_cache_used;
+	return reader;
+}
+
 /// identifier_expr:  identifier |  identifier '(' expression* ')'
 ex parser::parse_identifier_expr()
 {
-	std::string name = scanner->str;
+	// The name stays valid in the buffer, but not in the scanner
+	const char* name_ptr = scanner->tok;
+	const std::size_t name_len = scanner->tok_len;
+	if (!scanner->buffered()) {
+		identifier.assign(name_ptr, name_len);
+		name_ptr = identifier.data();
+	}
 	get_next_tok();  // eat identifier.
 
 	if (token != '(') // symbol
-		return find_or_insert_symbol(name, syms, strict);
+		return find_symbol(name_ptr, name_len);
 
-	// function/ctor call.
+	// function/ctor call. The arguments may contain identifiers, too.
+	std::string name;
+	if (!scanner->buffered()) {
+		name.swap(identifier);
+		name_ptr = name.data();
+	}
 	get_next_tok();  // eat (
 	exvector args;
 	if (token != ')') {
@@ -97,10 +225,9 @@ ex parser::parse_identifier_expr()
 	}
 	// Eat the ')'.
 	get_next_tok();
-	prototype the_prototype = make_pair(name, args.size());
-	prototype_table::const_iterator reader = funcs.find(the_prototype);
+	prototype_table::const_iterator reader = find_prototype(name_ptr, name_len, args.size());
 	if (reader == funcs.end()) {
-		Parse_error_("no function \"" << name << "\" with " <<
+		Parse_error_("no function \"" << std::string(name_ptr, name_len) << "\" with " <<
 			     args.size() << " arguments");
 	}
 	// reader->second might be a pointer to a C++ function or a specially
@@ -227,6 +354,21 @@ ex parser::parse_literal_expr()
 ex parser::operator()(std::istream& input)
 {
 	scanner->switch_input(&input);
+	return parse_input();
+}
+
+ex parser::operator()(const char* begin, const char* end)
+{
+	ex ret;
+	if (parse_parallel(begin, end, false, ret))
+		return ret;
+	scanner->switch_input(begin, end);
+	return parse_input();
+}
+
+ex parser::parse_input()
+{
+	reset_symbol_cache();
 	get_next_tok();
 	ex ret = parse_expression();
 	// parse_expression() stops if it encounters an unknown token.
@@ -241,9 +383,32 @@ ex parser::operator()(std::istream& input)
 
 ex parser::operator()(const std::string& input)
 {
-	std::istringstream is(input);
-	ex ret = operator()(is);
-	return ret;
+	const char* begin = input.data();
+	return operator()(begin, begin + input.size());
+}
+
+void parser::parse_sequence(const char* begin, const char* end, exvector& results,
+                            const char separator)
+{
+	scanner->switch_input(begin, end);
+	reset_symbol_cache();
+	get_next_tok();
+	while (token != lexer::token_type::eof) {
+		if (token == separator) {
+			get_next_tok();
+			continue;
+		}
+		results.push_back(parse_expression());
+		if (token != separator && token != lexer::token_type::eof)
+			Parse_error("expected '" << separator << "' or EOF");
+	}
+}
+
+void parser::parse_sequence(const std::string& input, exvector& results,
+                            const char separator)
+{
+	const char* begin = input.data();
+	parse_sequence(begin, begin + input.size(), results, separator);
 }
 
 int parser::get_next_tok()
@@ -254,7 +419,8 @@ int parser::get_next_tok()
 
 parser::parser(const symtab& syms_, const bool strict_,
 	       const prototype_table& funcs_) : strict(strict_),
-	funcs(funcs_), syms(syms_)
+	split_input(true), funcs(funcs_), syms(syms_), symbol_cache_used(0),
+	prototype_cache_used(0)
 {
 	scanner = new lexer();
 }
@@ -27,6 +27,7 @@
 #include "ex.h"
 
 #include <stdexcept>
+#include <vector>
 
 namespace GiNaC {
 
@@ -95,6 +96,32 @@ public:
 	ex operator()(std::istream& input);
 	/// parse the string @a input
 	ex operator()(const std::string& input);
+	/// parse the characters [@a begin, @a end), e.g. of a file mapped
+	/// into memory, without copying them
+	ex operator()(const char* begin, const char* end);
+
+	/// parse the expressions in [@a begin, @a end) which are separated
+	/// by @a separator and append them to @a results, e.g. for reading
+	/// many small expressions with one parser
+	void parse_sequence(const char* begin, const char* end, exvector& results,
+	                    const char separator = ';');
+	/// parse the expressions in the string @a input, see above
+	void parse_sequence(const std::string& input, exvector& results,
+	                    const char separator = ';');
+
+	/// parse the characters [@a begin, @a end) much faster if they form
+	/// a sum of monomials with rational coefficients and integer
+	/// exponents, like operator() otherwise
+	ex parse_polynomial(const char* begin, const char* end);
+	/// parse the string @a input, see above
+	ex parse_polynomial(const std::string& input);
+
+	/// parse the shards of a sum, e.g. as printed by print_shards(),
+	/// concurrently if GiNaC was built with thread-safe reference counts,
+	/// and add them up
+	ex parse_shards(const std::vector<std::string>& shards);
+	/// read and parse the shards of a sum in the named files, see above
+	ex parse_shard_files(const std::vector<std::string>& filenames);
 
 	/// report the symbol table used by parser
 	symtab get_syms() const 
@@ -109,6 +136,9 @@ public:
 
 	/// If true, throw an exception if an unknown symbol is encountered.
 	bool strict;
+	/// If true (the default), large sums may be split among several
+	/// threads, see set_parser_threads().
+	bool split_input;
 private:
 	/**
 	 * Function/ctor table, maps a prototype (which is a name and number
@@ -130,8 +160,46 @@ private:
 	int token;
 	/// read the next token from the scanner
 	int get_next_tok();
+	/// parse the input the scanner was switched to
+	ex parse_input();
+
+	/// Symbols looked up during the current parse, by hash of their name
+	/// (open addressing, an empty name marks a free slot)
+	struct symbol_cache_entry {
+		std::string name;
+		ex value;
+	};
+	std::vector<symbol_cache_entry> symbol_cache;
+	std::size_t symbol_cache_used;
+	/// name of the current identifier if the scanner reads from a stream
+	std::string identifier;
+	/// find or insert the symbol with the given name, see symbol_cache
+	ex find_symbol(const char* name, std::size_t len);
+	/// forget the symbols of the previous parse, keeping the memory
+	void reset_symbol_cache();
+
+	/// Prototypes looked up so far, by hash of their name and number of
+	/// arguments. Unlike symbol_cache this stays valid for the lifetime
+	/// of the parser, since funcs can not change.
+	struct prototype_cache_entry {
+		std::string name;
+		std::size_t nargs;
+		prototype_table::const_iterator reader;
+	};
+	std::vector<prototype_cache_entry> prototype_cache;
+	std::size_t prototype_cache_used;
+	/// find the prototype for a call of the given function, or funcs.end()
+	prototype_table::const_iterator find_prototype(const char* name, std::size_t len, std::size_t nargs);
+	/// find the signs between the terms of a sum, see parse_parallel.cpp
+	bool scan_terms(const char* p, const char* end, std::vector<const char*>& signs);
+	/// parse the terms of a sum concurrently, see parse_parallel.cpp
+	bool parse_parallel(const char* begin, const char* end, bool polynomial, ex& result);
 };
 
+// Number of threads used by the parser for the terms of large sums (default 1), returns previous setting
+extern unsigned set_parser_threads(unsigned n);
+extern unsigned get_parser_threads();
+
 } // namespace GiNaC
 
 #endif // ndef GINAC_PARSER_H
@@ -21,7 +21,9 @@
  */
 
 #include "add.h"
+#include "lst.h"
 #include "mul.h"
+#include "normal.h"
 #include "operators.h"
 #include "power.h"
 #include "collect_vargs.h"
@@ -85,6 +87,21 @@ void collect_vargs(ex_collect_t& ec, const ex& e, const exvector& vars)
 		  make_compare_terms(*ec.begin(), ex_is_less()));
 }
 
+/**
+ * Coefficients of the expanded polynomial e in the objects of l, indexed
+ * by their exponents: the coefficient of l[0]^k[0]*...*l[n]^k[n] has the
+ * key k. The exponent of an object in a term is its degree in that term,
+ * so that the terms are scanned only once, instead of once per coefficient
+ * as with coeff(). Zero coefficients are left out.
+ */
+exp_coeff_map collect_coeffs(const ex& e, const lst& l)
+{
+	const exvector vars(l.begin(), l.end());
+	exp_coeff_map ec;
+	collect_vargs(ec, e, vars);
+	return ec;
+}
+
 static void 
 collect_vargs(ex_collect_priv_t& ec, ex e, const exvector& vars)
 {
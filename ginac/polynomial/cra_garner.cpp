@@ -25,6 +25,7 @@
 
 #include <cln/integer.h>
 #include <cln/modinteger.h>
+#include <cln/rational.h>
 #include <cstddef>
 #include <vector>
 
@@ -110,4 +111,78 @@ cl_I integer_cra(const vector<cl_I>& residues,
 	return result;
 }
 
+bool rational_reconstruct(cl_RA& result, const cl_I& u, const cl_I& m,
+	                  const cl_I& num_bound, const cl_I& den_bound)
+{
+	// Invariant: r0 = s0*u and r1 = s1*u modulo m
+	cl_I r0 = m, r1 = mod(u, m);
+	cl_I s0 = 0, s1 = 1;
+	while (r1 > num_bound) {
+		const cl_I_div_t qr = floor2(r0, r1);
+		r0 = r1;
+		r1 = qr.remainder;
+		const cl_I s = s0 - qr.quotient*s1;
+		s0 = s1;
+		s1 = s;
+	}
+	if (abs(s1) > den_bound || gcd(r1, s1) != 1)
+		return false;
+	if (minusp(s1))
+		result = (-r1)/(-s1);
+	else
+		result = r1/s1;
+	return true;
+}
+
+bool rational_reconstruct(cl_RA& result, const cl_I& u, const cl_I& m)
+{
+	const cl_I bound = isqrt(m >> 1);
+	return rational_reconstruct(result, u, m, bound, bound);
+}
+
+rational_cra::rational_cra(size_t n)
+  : combined(n), candidate(n), product(1), has_candidate(false), is_stable(false)
+{
+	for (size_t i = 0; i < n; ++i)
+		combined[i] = 0;
+}
+
+bool rational_cra::add_image(const vector<cl_I>& residues, const cl_I& p)
+{
+	const cl_modint_ring R = find_modint_ring(p);
+
+	// Does the last reconstruction agree with the new images?
+	if (has_candidate) {
+		is_stable = true;
+		for (size_t i = 0; i < candidate.size(); ++i) {
+			const cl_MI d = R->canonhom(denominator(candidate[i]));
+			if (zerop(d) || R->canonhom(numerator(candidate[i])) != d*R->canonhom(residues[i])) {
+				is_stable = false;
+				break;
+			}
+		}
+	}
+
+	// Combine with the previous images (Garner's step for one more modulus)
+	const cl_MI inv = recip(R->canonhom(product));
+	for (size_t i = 0; i < combined.size(); ++i) {
+		const cl_MI t = (R->canonhom(residues[i]) - R->canonhom(combined[i]))*inv;
+		combined[i] = combined[i] + product*R->retract(t);
+	}
+	product = product*p;
+
+	// Reconstruct again, giving up at the first entry which fails.  A
+	// stable result stays as it is, being the reconstruction still.
+	if (!is_stable) {
+		has_candidate = true;
+		for (size_t i = 0; i < combined.size(); ++i) {
+			if (!rational_reconstruct(candidate[i], combined[i], product)) {
+				has_candidate = false;
+				break;
+			}
+		}
+	}
+	return is_stable;
+}
+
 } // namespace cln
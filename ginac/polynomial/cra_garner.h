@@ -24,6 +24,8 @@
 #define CL_INTEGER_CRA
 
 #include <cln/integer.h>
+#include <cln/rational.h>
+#include <cstddef>
 #include <vector>
 
 namespace cln {
@@ -31,6 +33,62 @@ namespace cln {
 extern cl_I integer_cra(const std::vector<cl_I>& residues,
 	                const std::vector<cl_I>& moduli);
 
+/**
+ * Rational reconstruction: find the fraction n/d with |n| <= num_bound,
+ * 0 < d <= den_bound and n = d*u modulo m, by the half-extended Euclidean
+ * algorithm on m and u (only the cofactors of u are kept).  The fraction
+ * is unique if 2*num_bound*den_bound < m.
+ *
+ * @return false if there is no such fraction
+ */
+extern bool rational_reconstruct(cl_RA& result, const cl_I& u, const cl_I& m,
+	                         const cl_I& num_bound, const cl_I& den_bound);
+
+/** Rational reconstruction with both bounds sqrt(m/2), for fractions of
+ *  unknown shape. */
+extern bool rational_reconstruct(cl_RA& result, const cl_I& u, const cl_I& m);
+
+/**
+ * Chinese remaindering of a vector of rational numbers with early
+ * termination, for modular algorithms over Q.  The images modulo primes
+ * are added one after the other; after each one the fractions are
+ * reconstructed (with bounds sqrt(m/2)), and once they agree with the
+ * images modulo a further prime they are most likely the result.  Thus
+ * the number of primes depends on the size of the result, not on an a
+ * priori bound, and denominators need not be cleared before.  Where the
+ * result must be certain, callers either check it (e.g. by substituting a
+ * solution into its equations), or continue until the product of the
+ * primes exceeds the bound of rational_reconstruct().
+ */
+class rational_cra {
+public:
+	explicit rational_cra(std::size_t n);
+
+	/** Add the images modulo the prime p, which must not divide any
+	 *  denominator of the result.  Returns stable(). */
+	bool add_image(const std::vector<cl_I>& residues, const cl_I& p);
+
+	/** Whether the last reconstruction agreed with the images modulo the
+	 *  prime added after it. */
+	bool stable() const { return is_stable; }
+
+	/** The last reconstruction, valid once stable(). */
+	const std::vector<cl_RA>& result() const { return candidate; }
+
+	/** The product of the primes so far. */
+	const cl_I& modulus() const { return product; }
+
+	/** The integers in [0, modulus()) with the images added so far. */
+	const std::vector<cl_I>& images() const { return combined; }
+
+private:
+	std::vector<cl_I> combined;
+	std::vector<cl_RA> candidate;
+	cl_I product;
+	bool has_candidate;
+	bool is_stable;
+};
+
 } // namespace cln
 
 #endif // CL_INTEGER_CRA
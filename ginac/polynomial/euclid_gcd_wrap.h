@@ -49,6 +49,18 @@ static void ex2upoly(umodpoly& u, ex e, const ex& var, const long p)
 	}
 }
 
+static void ex2upoly(uwordpoly& u, ex e, const ex& var, const zp_word_ring& R)
+{
+	e = e.expand();
+	u.resize(e.degree(var) + 1);
+	for (int i = 0; i <= e.degree(var); ++i) {
+		ex ce = e.coeff(var, i);
+		bug_on(!is_a<numeric>(ce), "i = " << i << ", " <<
+			"coefficient is not a number: " << ce);
+		u[i] = zp_word(R, to_cl_I(ce));
+	}
+}
+
 static ex umodpoly2ex(const umodpoly& a, const ex& var, const long p)
 {
 	cln::cl_modint_ring R = cln::find_modint_ring(cln::cl_I(p));
@@ -63,11 +75,36 @@ static ex umodpoly2ex(const umodpoly& a, const ex& var, const long p)
 	return ret;
 }
 	
+static ex uwordpoly2ex(const uwordpoly& a, const ex& var, const long p)
+{
+	exvector ev(a.size());
+	for (std::size_t i = a.size(); i-- != 0; ) {
+		long c = a[i].retract();
+		if (c > (p >> 1))
+			c -= p;
+		const ex term = numeric(c)*power(var, i);
+		ev.push_back(term);
+	}
+	ex ret = (new add(ev))->setflag(status_flags::dynallocated);
+	return ret;
+}
+
 static ex euclid_gcd(ex A, ex B, const ex& var, const long p)
 {
 	A = A.expand();
 	B = B.expand();
 
+	if (zp_word_ring::fits(p)) {
+		// Small modulus, avoid the overhead of cln::cl_modint_ring
+		const zp_word_ring R(p);
+		uwordpoly a, b;
+		ex2upoly(a, A, var, R);
+		ex2upoly(b, B, var, R);
+		uwordpoly g;
+		gcd_euclid(g, a, b);
+		return uwordpoly2ex(g, var, p);
+	}
+
 	umodpoly a, b;
 	ex2upoly(a, A, var, p);
 	ex2upoly(b, B, var, p);
@@ -38,7 +38,7 @@ struct eval_point_finder
 	typedef long value_type;
 	const value_type p;
 	std::set<value_type> points;
-	const random_modint modint_generator;
+	random_modint modint_generator;
 	bool operator()(value_type& b, const ex& g, const ex& x);
 	eval_point_finder(const value_type& p_) : p(p_), modint_generator(p)
 	{ }
@@ -46,7 +46,6 @@ struct eval_point_finder
 
 bool eval_point_finder::operator()(value_type& b, const ex& lc, const ex& x)
 {
-	random_modint modint_generator(p);
 	// Search for a new element of field
 	while (points.size() < p - 1) {
 		value_type b_ = modint_generator();
@@ -0,0 +1,460 @@
+/** @file expand_mod.cpp
+ *
+ *  Expansion of polynomials with the coefficients reduced modulo a word
+ *  prime, see expand_modular(). */
+
+/*
+ *  GiNaC Copyright (C) 1999-2014 Johannes Gutenberg University Mainz, Germany
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#include "sparse_poly.h"
+#include "add.h"
+#include "mul.h"
+#include "power.h"
+#include "numeric.h"
+#include "symbol.h"
+#include "operators.h"
+#include "budget.h"
+#include "utils.h"
+
+#include <algorithm>
+#include <cln/integer.h>
+#include <cln/numtheory.h>
+#include <cln/rational.h>
+#include <map>
+#include <memory>
+#include <stdexcept>
+#include <stdint.h> // for uint32_t, uint64_t
+#include <vector>
+
+namespace GiNaC {
+
+namespace {
+
+/** Term of a polynomial in Z/p[x1, ..., xn], the coefficient in [1, p). */
+struct mod_term {
+	mod_term(packed_exponents e, uint32_t c) : exponents(e), coeff(c) { }
+	packed_exponents exponents;
+	uint32_t coeff;
+};
+
+struct mod_term_is_greater {
+	bool operator()(const mod_term & t1, const mod_term & t2) const
+	{
+		return t1.exponents > t2.exponents;
+	}
+};
+
+/** Polynomial in Z/p[x1, ..., xn] as a list of terms sorted by decreasing
+ *  exponents.  The zero polynomial has no terms. */
+typedef std::vector<mod_term> mod_poly;
+
+/** Heap entries of the product: the term a[i] * b[j]. */
+struct mod_heap_entry {
+	mod_heap_entry(packed_exponents e, size_t i_, size_t j_) : exponents(e), i(i_), j(j_) { }
+	packed_exponents exponents;
+	size_t i, j;
+};
+
+struct mod_heap_entry_is_less {
+	bool operator()(const mod_heap_entry & h1, const mod_heap_entry & h2) const
+	{
+		return h1.exponents < h2.exponents;
+	}
+};
+
+/** The residue of a rational number modulo p. */
+uint32_t residue(const numeric & c, uint32_t p)
+{
+	if (!c.is_rational())
+		throw std::invalid_argument("expand_modular(): coefficients must be rational");
+	const cln::cl_RA q = cln::the<cln::cl_RA>(c.to_cl_N());
+	const cln::cl_I modulus = cln::cl_I(static_cast<long>(p));
+	const long num = cln::cl_I_to_long(cln::mod(cln::numerator(q), modulus));
+	const long den = cln::cl_I_to_long(cln::mod(cln::denominator(q), modulus));
+	if (den == 0)
+		throw pole_error("expand_modular(): denominator divisible by the modulus", 1);
+	if (den == 1)
+		return uint32_t(num);
+
+	// Extended Euclid for 1/den
+	long r0 = p, r1 = den, s0 = 0, s1 = 1;
+	while (r1 != 0) {
+		const long t = r0 / r1;
+		long u = r0 - t*r1; r0 = r1; r1 = u;
+		u = s0 - t*s1; s0 = s1; s1 = u;
+	}
+	if (s0 < 0)
+		s0 += p;
+	return uint32_t((uint64_t(num) * uint64_t(s0)) % p);
+}
+
+/** Reduce the coefficients of the expanded polynomial e modulo p. */
+ex reduce_coefficients(const ex & e, uint32_t p)
+{
+	exvector terms;
+	const size_t n = is_exactly_a<add>(e) ? e.nops() : 1;
+	terms.reserve(n);
+	for (size_t i = 0; i < n; ++i) {
+		const ex t = is_exactly_a<add>(e) ? e.op(i) : e;
+		ex c = _ex1, m = t;
+		if (is_exactly_a<numeric>(t)) {
+			c = t;
+			m = _ex1;
+		} else if (is_exactly_a<mul>(t) && is_exactly_a<numeric>(t.op(t.nops() - 1))) {
+			c = t.op(t.nops() - 1);
+			m = t / c;
+		}
+		const uint32_t r = residue(ex_to<numeric>(c), p);
+		if (r != 0)
+			terms.push_back(numeric(long(r)) * m);
+	}
+	return (new add(terms))->setflag(status_flags::dynallocated);
+}
+
+/** Expansion of an expression in Z/p[x1, ..., xn].  The variables are the
+ *  symbols and all other objects which are not sums, products, positive
+ *  integer powers or rational numbers. */
+class modular_expander {
+public:
+	explicit modular_expander(uint32_t p) : modulus(p), square(uint64_t(p) * p), power_atoms(false) { }
+
+	/** Find the variables of e and set up the packing.  Returns false if
+	 *  the degrees may not fit into the exponent words. */
+	bool prepare(const ex & e);
+
+	/** The expanded polynomial e. */
+	mod_poly expand(const ex & e);
+
+	/** The polynomial as an expression, the coefficients in [1, p). */
+	ex to_ex(const mod_poly & a) const;
+
+	/** Whether some variables are powers, whose products may simplify when
+	 *  the result is built. */
+	bool has_power_atoms() const { return power_atoms; }
+
+private:
+	enum kind { number, variable, sum, product, posint_power };
+	static kind classify(const ex & e);
+
+	void collect_variables(const ex & e);
+	const std::vector<double> & degree_bounds(const ex & e);
+
+	mod_poly constant(uint32_t c) const;
+	mod_poly combine(mod_poly & terms) const;
+	mod_poly multiply(const mod_poly & a, const mod_poly & b) const;
+	mod_poly raise(const mod_poly & a, unsigned n) const;
+
+	const uint32_t modulus;
+	const uint64_t square;  ///< modulus^2, up to which sums of products are accumulated
+	bool power_atoms;
+	var_index_map var_index;
+	packing pk;
+
+	// The originals are kept, so that their addresses are not reused
+	std::map<const basic *, std::pair<ex, std::vector<double> > > bound_memo;
+	std::map<const basic *, std::pair<ex, mod_poly> > poly_memo;
+};
+
+modular_expander::kind modular_expander::classify(const ex & e)
+{
+	if (is_exactly_a<numeric>(e))
+		return number;
+	if (is_exactly_a<add>(e))
+		return sum;
+	if (is_exactly_a<mul>(e))
+		return product;
+	if (is_exactly_a<power>(e) && e.op(1).info(info_flags::posint) &&
+	    ex_to<numeric>(e.op(1)).int_length() <= 31)
+		return posint_power;
+	return variable;
+}
+
+void modular_expander::collect_variables(const ex & e)
+{
+	switch (classify(e)) {
+	case number:
+		return;
+	case variable:
+		if (var_index.find(e) == var_index.end()) {
+			var_index.insert(std::make_pair(e, unsigned(var_index.size())));
+			if (is_exactly_a<power>(e))
+				power_atoms = true;
+		}
+		return;
+	default:
+		if (ex_to<basic>(e).get_refcount() > 1 && bound_memo.count(&ex_to<basic>(e)))
+			return;
+		for (size_t i = 0; i < e.nops(); ++i)
+			collect_variables(e.op(i));
+		if (ex_to<basic>(e).get_refcount() > 1)
+			bound_memo[&ex_to<basic>(e)].first = e;
+	}
+}
+
+/** Bounds of the degrees of e in all variables. */
+const std::vector<double> & modular_expander::degree_bounds(const ex & e)
+{
+	std::pair<ex, std::vector<double> > & m = bound_memo[&ex_to<basic>(e)];
+	if (!m.second.empty() || var_index.empty())
+		return m.second;
+	m.first = e;
+	std::vector<double> d(var_index.size(), 0.0);
+	switch (classify(e)) {
+	case number:
+		break;
+	case variable:
+		d[var_index.find(e)->second] = 1;
+		break;
+	case sum:
+		for (size_t i = 0; i < e.nops(); ++i) {
+			const std::vector<double> & t = degree_bounds(e.op(i));
+			for (size_t v = 0; v < d.size(); ++v)
+				d[v] = std::max(d[v], t[v]);
+		}
+		break;
+	case product:
+		for (size_t i = 0; i < e.nops(); ++i) {
+			const std::vector<double> & f = degree_bounds(e.op(i));
+			for (size_t v = 0; v < d.size(); ++v)
+				d[v] += f[v];
+		}
+		break;
+	case posint_power: {
+		const double n = ex_to<numeric>(e.op(1)).to_double();
+		const std::vector<double> & b = degree_bounds(e.op(0));
+		for (size_t v = 0; v < d.size(); ++v)
+			d[v] = n * b[v];
+		break;
+	}
+	}
+	m.second.swap(d);
+	return m.second;
+}
+
+bool modular_expander::prepare(const ex & e)
+{
+	collect_variables(e);
+	bound_memo.clear();
+	const std::vector<double> d = degree_bounds(e);
+	bound_memo.clear();
+	std::vector<unsigned> max_deg(d.size());
+	for (size_t v = 0; v < d.size(); ++v) {
+		if (d[v] >= double(1u << 31))
+			return false;
+		max_deg[v] = unsigned(d[v]);
+	}
+	return pk.init(var_index, max_deg);
+}
+
+mod_poly modular_expander::constant(uint32_t c) const
+{
+	mod_poly r;
+	if (c != 0)
+		r.push_back(mod_term(0, c));
+	return r;
+}
+
+/** Sort the terms and add the coefficients of equal monomials. */
+mod_poly modular_expander::combine(mod_poly & terms) const
+{
+	std::sort(terms.begin(), terms.end(), mod_term_is_greater());
+	mod_poly r;
+	r.reserve(terms.size());
+	for (mod_poly::const_iterator i = terms.begin(); i != terms.end(); ) {
+		const packed_exponents e = i->exponents;
+		uint64_t c = 0;
+		for (; i != terms.end() && i->exponents == e; ++i)
+			c += i->coeff;
+		c %= modulus;
+		if (c != 0)
+			r.push_back(mod_term(e, uint32_t(c)));
+	}
+	return r;
+}
+
+/** Product of two polynomials, merging the rows a[i]*b through a heap like
+ *  sparse_multiply().  The products of the coefficients are accumulated in
+ *  a machine word, which is only reduced modulo p^2 until the coefficient
+ *  of a monomial is complete. */
+mod_poly modular_expander::multiply(const mod_poly & a, const mod_poly & b) const
+{
+	if (a.size() > b.size())
+		return multiply(b, a);
+
+	mod_poly r;
+	if (a.empty())
+		return r;
+
+	std::vector<mod_heap_entry> heap;
+	heap.reserve(a.size());
+	heap.push_back(mod_heap_entry(a[0].exponents + b[0].exponents, 0, 0));
+	const mod_heap_entry_is_less cmp;
+
+	while (!heap.empty()) {
+		check_budget();
+		const packed_exponents e = heap.front().exponents;
+		uint64_t c = 0;
+		do {
+			std::pop_heap(heap.begin(), heap.end(), cmp);
+			mod_heap_entry & h = heap.back();
+			c += uint64_t(a[h.i].coeff) * b[h.j].coeff;
+			if (c >= square)
+				c -= square;
+			if (h.j == 0 && h.i + 1 < a.size()) {
+				const size_t i = h.i + 1;
+				if (h.j + 1 < b.size()) {
+					h.exponents = a[h.i].exponents + b[h.j + 1].exponents;
+					++h.j;
+					std::push_heap(heap.begin(), heap.end(), cmp);
+				} else
+					heap.pop_back();
+				heap.push_back(mod_heap_entry(a[i].exponents + b[0].exponents, i, 0));
+				std::push_heap(heap.begin(), heap.end(), cmp);
+			} else if (h.j + 1 < b.size()) {
+				h.exponents = a[h.i].exponents + b[h.j + 1].exponents;
+				++h.j;
+				std::push_heap(heap.begin(), heap.end(), cmp);
+			} else
+				heap.pop_back();
+		} while (!heap.empty() && heap.front().exponents == e);
+		c %= modulus;
+		if (c != 0)
+			r.push_back(mod_term(e, uint32_t(c)));
+	}
+	return r;
+}
+
+mod_poly modular_expander::raise(const mod_poly & a, unsigned n) const
+{
+	mod_poly r = constant(1), s = a;
+	while (true) {
+		if (n & 1)
+			r = multiply(r, s);
+		n >>= 1;
+		if (n == 0)
+			return r;
+		s = multiply(s, s);
+	}
+}
+
+mod_poly modular_expander::expand(const ex & e)
+{
+	const bool shared = ex_to<basic>(e).get_refcount() > 1 && e.nops();
+	if (shared) {
+		std::map<const basic *, std::pair<ex, mod_poly> >::const_iterator i = poly_memo.find(&ex_to<basic>(e));
+		if (i != poly_memo.end())
+			return i->second.second;
+	}
+
+	mod_poly r;
+	switch (classify(e)) {
+	case number:
+		r = constant(residue(ex_to<numeric>(e), modulus));
+		break;
+	case variable:
+		r.push_back(mod_term(packed_exponents(1) << pk.shift[var_index.find(e)->second], 1));
+		break;
+	case sum: {
+		mod_poly terms;
+		for (size_t i = 0; i < e.nops(); ++i) {
+			const mod_poly t = expand(e.op(i));
+			terms.insert(terms.end(), t.begin(), t.end());
+		}
+		r = combine(terms);
+		break;
+	}
+	case product:
+		r = constant(1);
+		for (size_t i = 0; i < e.nops() && !r.empty(); ++i)
+			r = multiply(r, expand(e.op(i)));
+		break;
+	case posint_power:
+		r = raise(expand(e.op(0)), ex_to<numeric>(e.op(1)).to_int());
+		break;
+	}
+
+	if (shared)
+		poly_memo.insert(std::make_pair(&ex_to<basic>(e), std::make_pair(e, r)));
+	return r;
+}
+
+ex modular_expander::to_ex(const mod_poly & a) const
+{
+	std::auto_ptr<epvector> terms(new epvector);
+	terms->reserve(a.size());
+	numeric oc;
+	epvector factors;
+	exvector others;  // terms whose monomials may have simplified
+	for (mod_poly::const_iterator i = a.begin(); i != a.end(); ++i) {
+		if (i->exponents == 0) {
+			oc = numeric(long(i->coeff));
+			continue;
+		}
+		factors.clear();
+		for (size_t v = 0; v < pk.vars.size(); ++v) {
+			const unsigned d = pk.degree(i->exponents, v);
+			if (d != 0)
+				factors.push_back(expair(pk.vars[v], ex(d)));
+		}
+		const ex m = (factors.size() == 1 && factors[0].coeff.is_equal(_ex1))
+		             ? factors[0].rest
+		             : (new mul(factors))->setflag(status_flags::dynallocated);
+		if (power_atoms)
+			others.push_back(numeric(long(i->coeff)) * m);
+		else
+			terms->push_back(expair(m, numeric(long(i->coeff))));
+	}
+	const ex r = (new add(terms, oc))->setflag(status_flags::dynallocated);
+	if (others.empty())
+		return r;
+	others.push_back(r);
+	return (new add(others))->setflag(status_flags::dynallocated);
+}
+
+} // anonymous namespace
+
+/** Expand e with all coefficients reduced modulo the prime p.  Objects that
+ *  are not polynomials in the symbols (functions, powers with other
+ *  exponents than positive integers...) are treated as variables and not
+ *  looked into.
+ *
+ *  @param e  expression with rational numbers as coefficients
+ *  @param p  odd prime below 2^31
+ *  @return expanded e with coefficients in [1, p)
+ *  @exception invalid_argument  p is not an odd prime below 2^31, or e has
+ *             coefficients which are not rational
+ *  @exception pole_error  some denominator is divisible by p */
+ex expand_modular(const ex & e, long p)
+{
+	if (p <= 2 || p > 0x7fffffffL || !cln::isprobprime(cln::cl_I(p)))
+		throw std::invalid_argument("expand_modular(): modulus must be an odd prime below 2^31");
+
+	modular_expander x(static_cast<uint32_t>(p));
+	ex r;
+	if (x.prepare(e))
+		r = x.to_ex(x.expand(e));
+	else
+		r = reduce_coefficients(e.expand(), static_cast<uint32_t>(p));
+	// Products of powers like x^(-1)*x may have simplified, so that
+	// coefficients were added or multiplied
+	if (x.has_power_atoms())
+		r = reduce_coefficients(r, static_cast<uint32_t>(p));
+	return r;
+}
+
+} // namespace GiNaC
@@ -26,13 +26,14 @@
 #include "upoly.h"
 #include "remainder.h"
 #include "normalize.h"
+#include "half_gcd.h"
 #include "debug.h"
 #include "upoly_io.h"
 
 namespace GiNaC {
 
-static bool
-gcd_euclid(umodpoly& c, umodpoly /* passed by value */ a, umodpoly b)
+template<typename T> static bool
+gcd_euclid(T& c, T /* passed by value */ a, T b)
 {
 	if (a.size() == 0) {
 		c.clear();
@@ -49,8 +50,12 @@ gcd_euclid(umodpoly& c, umodpoly /* passed by value */ a, umodpoly b)
 	normalize_in_field(b);
 	if (degree(a) < degree(b))
 		std::swap(a, b);
+	if (degree(b) >= std::size_t(half_gcd_threshold)) {
+		half_gcd(c, a, b);
+		return false;
+	}
 
-	umodpoly r;
+	T r;
 	while (b.size() != 0) {
 		remainder_in_field(r, a, b); 
 		a = b;
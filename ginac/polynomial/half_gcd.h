@@ -0,0 +1,292 @@
+/** @file half_gcd.h
+ *
+ *  Subquadratic GCD of univariate polynomials over Z/p (half-GCD). */
+
+/*
+ *  GiNaC Copyright (C) 1999-2014 Johannes Gutenberg University Mainz, Germany
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#ifndef GINAC_POLYNOMIAL_HALF_GCD_H
+#define GINAC_POLYNOMIAL_HALF_GCD_H
+
+#include "karatsuba.h"
+#include "zp_word.h"
+
+#include <cln/modinteger.h>
+#include <cstddef>
+#include <vector>
+
+namespace GiNaC {
+
+/** GCDs of polynomials of at least this degree are computed by half_gcd(),
+ *  smaller ones by the Euclidean algorithm. */
+static const long half_gcd_threshold = 600;
+
+/**
+ * Half-GCD algorithm (Thull, Yap: A unified approach to HGCD algorithms
+ * for polynomials and integers) for polynomials over a field. T is a
+ * std::vector of field elements (cln::cl_MI, zp_word), the coefficient
+ * of x^i being stored at index i, without leading zeros.
+ *
+ * This class only bundles the helper functions, so they don't interfere
+ * with the univariate polynomial code in upoly.h and factor.cpp.
+ */
+template<typename T> class half_gcd_engine
+{
+	typedef typename T::value_type field_t;
+
+	/// Transformation (a, b) -> (m00 a + m01 b, m10 a + m11 b)
+	struct matrix {
+		T m00, m01, m10, m11;
+	};
+
+	const field_t zero, one;
+
+	/// Degrees of polynomials below this are treated by Euclid's algorithm
+	static const long base_threshold = 48;
+
+	static long deg(const T& p)
+	{
+		return static_cast<long>(p.size()) - 1;
+	}
+
+	static void trim(T& p)
+	{
+		std::size_t n = p.size();
+		while (n != 0 && zerop(p[n - 1]))
+			--n;
+		p.erase(p.begin() + n, p.end());
+	}
+
+	T mul(const T& a, const T& b) const
+	{
+		if (a.empty() || b.empty())
+			return T();
+		T c(a.size() + b.size() - 1, zero);
+		mul_add(&a[0], a.size(), &b[0], b.size(), &c[0], zero);
+		trim(c);
+		return c;
+	}
+
+	/// a - q*b
+	T sub_mul(const T& a, const T& q, const T& b) const
+	{
+		T c = mul(q, b);
+		if (c.size() < a.size())
+			c.resize(a.size(), zero);
+		for (std::size_t i = 0; i < c.size(); ++i)
+			c[i] = (i < a.size() ? a[i] : zero) - c[i];
+		trim(c);
+		return c;
+	}
+
+	T add(const T& a, const T& b) const
+	{
+		T c(a.size() > b.size() ? a : b);
+		const T& s = a.size() > b.size() ? b : a;
+		for (std::size_t i = 0; i < s.size(); ++i)
+			c[i] = c[i] + s[i];
+		trim(c);
+		return c;
+	}
+
+	/// a quo x^k
+	static T shift_down(const T& a, long k)
+	{
+		if (deg(a) < k)
+			return T();
+		return T(a.begin() + k, a.end());
+	}
+
+	void divrem(const T& a, const T& b, T& q, T& r) const
+	{
+		r = a;
+		q.clear();
+		const long n = deg(b);
+		long k = deg(a) - n;
+		if (k < 0)
+			return;
+		q.resize(k + 1, zero);
+		const field_t lc_1 = recip(b[n]);
+		do {
+			const field_t qk = r[n + k]*lc_1;
+			q[k] = qk;
+			if (zerop(qk))
+				continue;
+			for (long i = 0; i <= n; ++i)
+				r[i + k] = r[i + k] - qk*b[i];
+		} while (k--);
+		r.resize(n, zero);
+		trim(r);
+		trim(q);
+	}
+
+	matrix identity() const
+	{
+		matrix M;
+		M.m00.assign(1, one);
+		M.m11.assign(1, one);
+		return M;
+	}
+
+	/// A*B
+	matrix mul(const matrix& A, const matrix& B) const
+	{
+		matrix M;
+		M.m00 = add(mul(A.m00, B.m00), mul(A.m01, B.m10));
+		M.m01 = add(mul(A.m00, B.m01), mul(A.m01, B.m11));
+		M.m10 = add(mul(A.m10, B.m00), mul(A.m11, B.m10));
+		M.m11 = add(mul(A.m10, B.m01), mul(A.m11, B.m11));
+		return M;
+	}
+
+	/// (0 1; 1 -q) M, i.e. one step of the remainder sequence
+	void step(matrix& M, const T& q) const
+	{
+		T m10 = sub_mul(M.m00, q, M.m10);
+		T m11 = sub_mul(M.m01, q, M.m11);
+		M.m00.swap(M.m10);
+		M.m01.swap(M.m11);
+		M.m10.swap(m10);
+		M.m11.swap(m11);
+	}
+
+	void apply(const matrix& M, T& a, T& b) const
+	{
+		T c = add(mul(M.m00, a), mul(M.m01, b));
+		T d = add(mul(M.m10, a), mul(M.m11, b));
+		a.swap(c);
+		b.swap(d);
+	}
+
+	/**
+	 * Returns M such that (c, d) = M (a, b) are consecutive remainders of
+	 * a, b with deg(c) >= m > deg(d), m = ceil(deg(a)/2).
+	 * Assertion: deg(a) > deg(b).
+	 */
+	matrix hgcd(const T& a, const T& b) const
+	{
+		const long n = deg(a);
+		const long m = (n + 1)/2;
+		if (deg(b) < m)
+			return identity();
+
+		if (n < base_threshold) {
+			matrix M = identity();
+			T c = a, d = b, q, r;
+			while (deg(d) >= m) {
+				divrem(c, d, q, r);
+				step(M, q);
+				c.swap(d);
+				d.swap(r);
+			}
+			return M;
+		}
+
+		// The quotients of the first half of the remainder sequence only
+		// depend on the leading coefficients
+		matrix R = hgcd(shift_down(a, m), shift_down(b, m));
+		T c = a, d = b;
+		apply(R, c, d);
+		if (deg(d) < m)
+			return R;
+
+		T q, r;
+		divrem(c, d, q, r);
+		step(R, q);
+		if (deg(r) < m)
+			return R;
+
+		const long k = 2*m - deg(d);
+		const matrix S = hgcd(shift_down(d, k), shift_down(r, k));
+		return mul(S, R);
+	}
+
+public:
+	explicit half_gcd_engine(const field_t& sample)
+	  : zero(sample - sample), one(recip(sample)*sample)
+	{ }
+
+	/// Monic GCD of a and b. Assertion: a and b are not zero.
+	void gcd(T& g, T a, T b) const
+	{
+		if (deg(a) < deg(b))
+			a.swap(b);
+		T q, r;
+		while (deg(b) >= half_gcd_threshold) {
+			apply(hgcd(a, b), a, b);
+			if (b.empty())
+				break;
+			divrem(a, b, q, r);
+			a.swap(b);
+			b.swap(r);
+		}
+		while (!b.empty()) {
+			divrem(a, b, q, r);
+			a.swap(b);
+			b.swap(r);
+		}
+		const field_t lc_1 = recip(a[deg(a)]);
+		for (std::size_t i = 0; i < a.size(); ++i)
+			a[i] = a[i]*lc_1;
+		g.swap(a);
+	}
+};
+
+/**
+ * Computes the monic GCD g of the univariate polynomials a, b over Z/p by
+ * the half-GCD algorithm, in O(M(n) log(n)) operations instead of the
+ * O(n^2) of the Euclidean algorithm. Assertion: a and b are not zero.
+ */
+template<typename T> static void
+half_gcd(T& g, const T& a, const T& b)
+{
+	const half_gcd_engine<T> engine(a[a.size() - 1]);
+	engine.gcd(g, a, b);
+}
+
+/**
+ * Same as above for polynomials over cln::cl_modint_ring. If the modulus
+ * fits into a word, the computation is done with zp_word coefficients.
+ */
+static inline void
+half_gcd(std::vector<cln::cl_MI>& g, const std::vector<cln::cl_MI>& a,
+	 const std::vector<cln::cl_MI>& b)
+{
+	const cln::cl_modint_ring R = a[0].ring();
+	const cln::cl_I& p = R->modulus;
+	if (p > cln::cl_I(0x7fffffffL) || !zp_word_ring::fits(cln::cl_I_to_long(p))) {
+		const half_gcd_engine< std::vector<cln::cl_MI> > engine(a[a.size() - 1]);
+		engine.gcd(g, a, b);
+		return;
+	}
+
+	const zp_word_ring W(cln::cl_I_to_long(p));
+	std::vector<zp_word> aw(a.size()), bw(b.size()), gw;
+	for (std::size_t i = 0; i < a.size(); ++i)
+		aw[i] = zp_word(W, R->retract(a[i]));
+	for (std::size_t i = 0; i < b.size(); ++i)
+		bw[i] = zp_word(W, R->retract(b[i]));
+	half_gcd(gw, aw, bw);
+	g.resize(gw.size());
+	for (std::size_t i = 0; i < gw.size(); ++i)
+		g[i] = R->canonhom(cln::cl_I(gw[i].retract()));
+}
+
+} // namespace GiNaC
+
+#endif // ndef GINAC_POLYNOMIAL_HALF_GCD_H
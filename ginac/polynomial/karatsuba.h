@@ -0,0 +1,90 @@
+/** @file karatsuba.h
+ *
+ *  Multiplication of dense univariate polynomials. */
+
+/*
+ *  GiNaC Copyright (C) 1999-2014 Johannes Gutenberg University Mainz, Germany
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#ifndef GINAC_POLYNOMIAL_KARATSUBA_H
+#define GINAC_POLYNOMIAL_KARATSUBA_H
+
+#include <algorithm>
+#include <cstddef>
+#include <vector>
+
+namespace GiNaC {
+
+/** Polynomials with fewer coefficients than this are multiplied by the
+ *  schoolbook method, larger ones by Karatsuba's method. */
+static const std::size_t karatsuba_threshold = 32;
+
+/**
+ * Adds the product of a[0..na) and b[0..nb) to c[0..na+nb-1). The
+ * coefficients can be of any ring type (cln::cl_I, cln::cl_MI, zp_word),
+ * zero is the zero of that ring.
+ */
+template<typename E> static void
+mul_add(const E* a, std::size_t na, const E* b, std::size_t nb, E* c, const E& zero)
+{
+	if (na < karatsuba_threshold || nb < karatsuba_threshold) {
+		for (std::size_t i = 0; i < na; ++i) {
+			if (zerop(a[i]))
+				continue;
+			for (std::size_t j = 0; j < nb; ++j)
+				c[i + j] = c[i + j] + a[i]*b[j];
+		}
+		return;
+	}
+	if (na != nb) {
+		// Cut the longer operand into pieces as long as the shorter one
+		if (na < nb) {
+			std::swap(a, b);
+			std::swap(na, nb);
+		}
+		for (std::size_t i = 0; i < na; i += nb)
+			mul_add(a + i, std::min(nb, na - i), b, nb, c + i, zero);
+		return;
+	}
+
+	// a = a0 + x^h a1, b = b0 + x^h b1,
+	// a b = a0 b0 + x^h ((a0 + a1)(b0 + b1) - a0 b0 - a1 b1) + x^(2h) a1 b1
+	const std::size_t h = na/2, l = na - h;
+	std::vector<E> z0(2*h - 1, zero), z2(2*l - 1, zero), z1(2*l - 1, zero);
+	mul_add(a, h, b, h, &z0[0], zero);
+	mul_add(a + h, l, b + h, l, &z2[0], zero);
+	std::vector<E> as(a + h, a + na), bs(b + h, b + na);
+	for (std::size_t i = 0; i < h; ++i) {
+		as[i] = as[i] + a[i];
+		bs[i] = bs[i] + b[i];
+	}
+	mul_add(&as[0], l, &bs[0], l, &z1[0], zero);
+	for (std::size_t i = 0; i < z0.size(); ++i) {
+		z1[i] = z1[i] - z0[i];
+		c[i] = c[i] + z0[i];
+	}
+	for (std::size_t i = 0; i < z2.size(); ++i) {
+		z1[i] = z1[i] - z2[i];
+		c[2*h + i] = c[2*h + i] + z2[i];
+	}
+	for (std::size_t i = 0; i < z1.size(); ++i)
+		c[h + i] = c[h + i] + z1[i];
+}
+
+} // namespace GiNaC
+
+#endif // ndef GINAC_POLYNOMIAL_KARATSUBA_H
@@ -0,0 +1,230 @@
+/** @file kronecker.cpp
+ *
+ *  Multiplication and division of dense multivariate polynomials by
+ *  Kronecker substitution. */
+
+/*
+ *  GiNaC Copyright (C) 1999-2014 Johannes Gutenberg University Mainz, Germany
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#include "kronecker.h"
+#include "karatsuba.h"
+#include "upoly.h"
+#include "budget.h"
+#include "flags.h"
+#include "mul.h"
+
+#include <algorithm>
+#include <cln/integer.h>
+#include <cln/rational.h>
+#include <cmath>
+#include <vector>
+
+namespace GiNaC {
+
+namespace {
+
+/** See set_polynomial_backend(). */
+unsigned backend = polynomial_backend::automatic;
+
+/** Univariate images with more coefficients than this are never built. */
+const std::size_t max_image_length = std::size_t(1) << 20;
+
+/** Highest exponent of every variable in p. */
+std::vector<unsigned> degrees(const sparse_poly & p, const packing & pk)
+{
+	std::vector<unsigned> d(pk.vars.size(), 0);
+	for (sparse_poly::const_iterator i = p.begin(); i != p.end(); ++i)
+		for (unsigned v = 0; v < d.size(); ++v)
+			d[v] = std::max(d[v], pk.degree(i->exponents, v));
+	return d;
+}
+
+/** The strides s of the substitution x_v = t^(s_v) for monomials whose
+ *  exponents are bounded by bound.  The variables are taken in the order
+ *  of their bit fields, so the order of the monomials is kept.  Returns
+ *  false if the images could have more than max_image_length coefficients. */
+bool substitution(std::vector<std::size_t> & s, const std::vector<unsigned> & bound)
+{
+	s.resize(bound.size());
+	std::size_t n = 1;
+	for (size_t v = 0; v < bound.size(); ++v) {
+		s[v] = n;
+		if (double(n) * (double(bound[v]) + 1) > double(max_image_length))
+			return false;
+		n *= bound[v] + 1;
+	}
+	return true;
+}
+
+/** Exponent of t which the monomial e is mapped to. */
+std::size_t image_exponent(packed_exponents e, const packing & pk, const std::vector<std::size_t> & s)
+{
+	std::size_t k = 0;
+	for (unsigned v = 0; v < s.size(); ++v)
+		k += pk.degree(e, v) * s[v];
+	return k;
+}
+
+/** The monomial which is mapped to t^k. */
+packed_exponents preimage(std::size_t k, const packing & pk, const std::vector<unsigned> & bound)
+{
+	packed_exponents e = 0;
+	for (size_t v = 0; v < bound.size(); ++v) {
+		e |= packed_exponents(k % (bound[v] + 1)) << pk.shift[v];
+		k /= bound[v] + 1;
+	}
+	return e;
+}
+
+/** The univariate image of den*p, den the common denominator of the
+ *  coefficients of p (not zero). */
+upoly integer_image(cln::cl_I & den, const sparse_poly & p, const packing & pk, const std::vector<std::size_t> & s)
+{
+	den = 1;
+	for (sparse_poly::const_iterator i = p.begin(); i != p.end(); ++i)
+		den = cln::lcm(den, cln::denominator(i->coeff));
+	// The first term has the highest exponent of t
+	upoly u(image_exponent(p.front().exponents, pk, s) + 1, cln::cl_I(0));
+	for (sparse_poly::const_iterator i = p.begin(); i != p.end(); ++i)
+		u[image_exponent(i->exponents, pk, s)] = cln::the<cln::cl_I>(i->coeff * den);
+	return u;
+}
+
+} // anonymous namespace
+
+bool kronecker_multiply(sparse_poly & r, const sparse_poly & a, const sparse_poly & b, const packing & pk)
+{
+	if (backend == polynomial_backend::heap || a.empty() || b.empty())
+		return false;
+
+	const std::vector<unsigned> da = degrees(a, pk), db = degrees(b, pk);
+	std::vector<unsigned> bound(da.size());
+	for (size_t v = 0; v < bound.size(); ++v)
+		bound[v] = da[v] + db[v];
+	std::vector<std::size_t> s;
+	if (!substitution(s, bound))
+		return false;
+
+	if (backend == polynomial_backend::automatic) {
+		const double na = double(image_exponent(a.front().exponents, pk, s)) + 1;
+		const double nb = double(image_exponent(b.front().exponents, pk, s)) + 1;
+		const double m = std::min(na, nb), n = std::max(na, nb);
+		// Below the threshold, mul_add() is the schoolbook method on the
+		// zeros of the images, too.  Above, Karatsuba's method takes
+		// about (n/m)*m^log2(3) multiplications of coefficients, the heap
+		// one for every pair of terms.
+		if (m < double(karatsuba_threshold) ||
+		    n / m * std::pow(m, 1.585) > double(a.size()) * double(b.size()))
+			return false;
+	}
+
+	cln::cl_I den_a, den_b;
+	const upoly ua = integer_image(den_a, a, pk, s);
+	const upoly ub = integer_image(den_b, b, pk, s);
+	upoly uc(ua.size() + ub.size() - 1, cln::cl_I(0));
+	check_budget();
+	mul_add(&ua[0], ua.size(), &ub[0], ub.size(), &uc[0], cln::cl_I(0));
+
+	const cln::cl_I den = den_a * den_b;
+	sparse_poly p;
+	for (std::size_t k = uc.size(); k-- != 0; )
+		if (!cln::zerop(uc[k]))
+			p.push_back(sparse_term(preimage(k, pk, bound), uc[k] / den));
+	r.swap(p);
+	return true;
+}
+
+int kronecker_divide(sparse_poly & q, const sparse_poly & a, const sparse_poly & b, const packing & pk)
+{
+	if (backend == polynomial_backend::heap || a.empty() || b.empty())
+		return -1;
+
+	// The substitution is injective on the polynomials of at most the
+	// degrees of a, which include b and the quotient if b divides a.
+	const std::vector<unsigned> da = degrees(a, pk), db = degrees(b, pk);
+	for (size_t v = 0; v < da.size(); ++v)
+		if (db[v] > da[v])
+			return 0;
+	std::vector<std::size_t> s;
+	if (!substitution(s, da))
+		return -1;
+	const std::size_t na = image_exponent(a.front().exponents, pk, s) + 1;
+	const std::size_t nb = image_exponent(b.front().exponents, pk, s) + 1;
+	if (nb > na)
+		return 0;
+	// The dense division costs b.size() operations for every coefficient
+	// of the image of the quotient, the heap one as many for every term
+	// of the quotient, which is about as dense as a.
+	if (backend == polynomial_backend::automatic && 4 * a.size() < na)
+		return -1;
+
+	cln::cl_I den_a, den_b;
+	const upoly ua = integer_image(den_a, a, pk, s);
+	const upoly ub = integer_image(den_b, b, pk, s);
+	std::vector<std::size_t> nonzero;
+	for (std::size_t i = 0; i < nb; ++i)
+		if (!cln::zerop(ub[i]))
+			nonzero.push_back(i);
+
+	// a = q*b means ua/den_a = q(t)*ub/den_b
+	std::vector<cln::cl_RA> rem(ua.begin(), ua.end()), quo(na - nb + 1, cln::cl_RA(0));
+	const cln::cl_I & lc = ub[nb - 1];
+	for (std::size_t k = na; k-- >= nb; ) {
+		check_budget();
+		if (cln::zerop(rem[k]))
+			continue;
+		const cln::cl_RA c = rem[k] / lc;
+		const std::size_t shift = k - (nb - 1);
+		quo[shift] = c;
+		for (std::vector<std::size_t>::const_iterator i = nonzero.begin(); i != nonzero.end(); ++i)
+			rem[shift + *i] = rem[shift + *i] - c * ub[*i];
+	}
+	for (std::size_t k = 0; k + 1 < nb; ++k)
+		if (!cln::zerop(rem[k]))
+			return 0;
+
+	// The preimage of the quotient times b has the image ua/den_a, so it
+	// is a if its degrees are within those of a.
+	const cln::cl_RA scale = cln::cl_RA(den_b) / den_a;
+	sparse_poly p;
+	for (std::size_t k = quo.size(); k-- != 0; ) {
+		if (cln::zerop(quo[k]))
+			continue;
+		const packed_exponents e = preimage(k, pk, da);
+		for (unsigned v = 0; v < da.size(); ++v)
+			if (pk.degree(e, v) + db[v] > da[v])
+				return 0;
+		p.push_back(sparse_term(e, quo[k] * scale));
+	}
+	q.swap(p);
+	return 1;
+}
+
+unsigned set_polynomial_backend(unsigned b)
+{
+	const unsigned previous = backend;
+	backend = b;
+	return previous;
+}
+
+unsigned get_polynomial_backend()
+{
+	return backend;
+}
+
+} // namespace GiNaC
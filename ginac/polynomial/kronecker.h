@@ -0,0 +1,53 @@
+/** @file kronecker.h
+ *
+ *  Multiplication and division of dense multivariate polynomials by
+ *  Kronecker substitution. */
+
+/*
+ *  GiNaC Copyright (C) 1999-2014 Johannes Gutenberg University Mainz, Germany
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#ifndef GINAC_POLYNOMIAL_KRONECKER_H
+#define GINAC_POLYNOMIAL_KRONECKER_H
+
+#include "sparse_poly.h"
+
+namespace GiNaC {
+
+/** Product of two packed polynomials by Kronecker substitution: the
+ *  variables are replaced by powers of one variable, x_i = t^(s_i), with
+ *  strides s_i large enough that no two monomials of the product meet, and
+ *  the dense univariate images are multiplied by Karatsuba's method.
+ *
+ *  This is only done if get_polynomial_backend() permits it, and with
+ *  polynomial_backend::automatic only if the images are dense enough to
+ *  make it cheaper than sparse_multiply().
+ *
+ *  @return false if the product was not computed */
+extern bool kronecker_multiply(sparse_poly & r, const sparse_poly & a, const sparse_poly & b, const packing & pk);
+
+/** Exact division of packed polynomials by Kronecker substitution, with the
+ *  strides given by the degrees of a, and dense univariate division.
+ *
+ *  @param q  quotient, if b divides a
+ *  @return 1 if b divides a, 0 if not, -1 if the division was not done
+ *          (see kronecker_multiply()) */
+extern int kronecker_divide(sparse_poly & q, const sparse_poly & a, const sparse_poly & b, const packing & pk);
+
+} // namespace GiNaC
+
+#endif // ndef GINAC_POLYNOMIAL_KRONECKER_H
@@ -20,7 +20,13 @@
  *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
  */
 
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
 #include "operators.h"
+#include "normal.h"
+#include "tasks.h"
 #include "chinrem_gcd.h"
 #include "pgcd.h"
 #include "collect_vargs.h"
@@ -34,8 +40,133 @@
 #include <cln/rational.h>
 #include <cln/rational_ring.h>
 
+#if defined(GINAC_THREADSAFE_REFCOUNT) && defined(HAVE_PTHREAD_H)
+// The images are only computed concurrently if expressions may be shared
+// between threads at all.
+#define PARALLEL_IMAGES 1
+#endif
+
 namespace GiNaC {
 
+static unsigned gcd_threads = 1;
+
+/** Set the number of threads chinrem_gcd() uses for computing the images
+ *  modulo different primes.  This has an effect only if GiNaC was built
+ *  with GINAC_THREADSAFE_REFCOUNT and pthreads.
+ *
+ *  @return previous setting */
+unsigned set_gcd_threads(unsigned n)
+{
+	const unsigned previous = gcd_threads;
+	gcd_threads = (n == 0 ? 1 : n);
+	return previous;
+}
+
+/** Get the number of threads used by chinrem_gcd(). */
+unsigned get_gcd_threads()
+{
+	return gcd_threads;
+}
+
+namespace {
+
+#ifdef PARALLEL_IMAGES
+
+/** Computation of one GCD image, to be run as a task. */
+struct image_job {
+	ex Ap, Bp;
+	const exvector * vars;
+	long p;
+	ex Cp;
+	bool failed;
+};
+
+void * run_image_job(void * arg)
+{
+	image_job & job = *static_cast<image_job *>(arg);
+	try {
+		job.Cp = pgcd(job.Ap, job.Bp, *job.vars, job.p);
+	} catch (...) {
+		job.failed = true;
+	}
+	return 0;
+}
+
+/** Run the jobs concurrently as tasks, the first one in the calling
+ *  thread. */
+void run_image_jobs(std::vector<image_job> & jobs)
+{
+	run_tasks(run_image_job, jobs);
+}
+
+#endif // def PARALLEL_IMAGES
+
+/** Supplies the GCD images of A and B modulo successive primes p, for which
+ *  the leading coefficient lc does not vanish.  With several threads, the
+ *  images modulo a batch of primes are computed at once and then handed
+ *  out one by one in the order of the primes, so the result of the
+ *  reconstruction does not depend on the number of threads. */
+class gcd_images
+{
+	const ex & A;
+	const ex & B;
+	const exvector & vars;
+	const cln::cl_I & lc;
+	primes_factory pfactory;
+#ifdef PARALLEL_IMAGES
+	std::vector<image_job> batch;
+	std::size_t next;
+#endif
+public:
+	gcd_images(const ex & A_, const ex & B_, const exvector & vars_, const cln::cl_I & lc_)
+	  : A(A_), B(B_), vars(vars_), lc(lc_)
+#ifdef PARALLEL_IMAGES
+	  , next(0)
+#endif
+	{ }
+
+	/** Get the next prime and the GCD image modulo it.
+	 *  @return false if there are no more primes */
+	bool operator()(long & p, ex & Cp)
+	{
+#ifdef PARALLEL_IMAGES
+		if (gcd_threads > 1) {
+			if (next == batch.size()) {
+				// The polynomials are reduced here, so that the threads
+				// only see coefficients which are immediate CLN integers.
+				batch.clear();
+				next = 0;
+				image_job job;
+				job.vars = &vars;
+				job.failed = false;
+				while (batch.size() < gcd_threads && pfactory(job.p, lc)) {
+					const numeric pnum(job.p);
+					job.Ap = A.smod(pnum);
+					job.Bp = B.smod(pnum);
+					batch.push_back(job);
+				}
+				if (batch.empty())
+					return false;
+				run_image_jobs(batch);
+			}
+			const image_job & job = batch[next++];
+			if (job.failed)
+				throw pgcd_failed();
+			p = job.p;
+			Cp = job.Cp;
+			return true;
+		}
+#endif
+		if (!pfactory(p, lc))
+			return false;
+		const numeric pnum(p);
+		Cp = pgcd(A.smod(pnum), B.smod(pnum), vars, p);
+		return true;
+	}
+};
+
+} // anonymous namespace
+
 static cln::cl_I extract_integer_content(ex& Apr, const ex& A)
 {
 	static const cln::cl_I n1(1);
@@ -83,16 +214,14 @@ ex chinrem_gcd(const ex& A_, const ex& B_, const exvector& vars)
 	ex H = 0;
 
 	long p;
-	primes_factory pfactory;
+	ex Cp;
+	gcd_images images(A, B, vars, g_lc);
 	while (true) {
-		bool has_primes = pfactory(p, g_lc);
+		bool has_primes = images(p, Cp);
 		if (!has_primes)
 			throw chinrem_gcd_failed();
 
 		const numeric pnum(p);
-		ex Ap = A.smod(pnum);
-		ex Bp = B.smod(pnum);
-		ex Cp = pgcd(Ap, Bp, vars, p);
 
 		const cln::cl_I g_lcp = smod(g_lc, p); 
 		const cln::cl_I Cp_lc = integer_lcoeff(Cp, vars);
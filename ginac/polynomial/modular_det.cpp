@@ -0,0 +1,777 @@
+/** @file modular_det.cpp
+ *
+ *  Linear algebra modulo word sized primes: determinants of matrices with
+ *  polynomial entries by evaluation and interpolation, and linear systems and
+ *  ranks of rational matrices. */
+
+/*
+ *  GiNaC Copyright (C) 1999-2014 Johannes Gutenberg University Mainz, Germany
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#include "modular_det.h"
+#include "cra_garner.h"
+#include "sparse_interp.h"
+#include "sparse_poly.h"
+#include "subproduct_tree.h"
+#include "zp_word.h"
+#include "primes_factory.h"
+#include "add.h"
+#include "mul.h"
+#include "numeric.h"
+#include "power.h"
+#include "operators.h"
+#include "utils.h"
+#include "flags.h"
+
+#include <algorithm>
+#include <cln/integer.h>
+#include <cln/rational.h>
+#include <stdint.h> // for uint32_t, uint64_t
+#include <vector>
+
+namespace GiNaC {
+
+namespace {
+
+/** Largest number of points of the dense grid of evaluation points.  For
+ *  larger ones, the determinant is interpolated sparsely, with a number of
+ *  evaluations which depends on its number of terms instead. */
+const std::size_t modular_det_max_points = 1 << 20;
+
+/** Entry of the matrix with integer coefficients, the exponents of term i
+ *  being exponents[i*nvars] ... exponents[i*nvars + nvars-1]. */
+struct det_entry {
+	std::vector<cln::cl_I> coeffs;
+	std::vector<unsigned> exponents;
+};
+
+/** Determinant of the n x n matrix a modulo p by Gauss elimination, a is
+ *  destroyed. */
+zp_word zp_determinant(std::vector<zp_word> & a, unsigned n, const zp_word_ring & R)
+{
+	zp_word det(R, 1L);
+	for (unsigned k = 0; k < n; ++k) {
+		unsigned pivot = k;
+		while (pivot < n && zerop(a[pivot*n + k]))
+			++pivot;
+		if (pivot == n)
+			return zp_word(R, 0L);
+		if (pivot != k) {
+			std::swap_ranges(a.begin() + k*n + k, a.begin() + k*n + n,
+			                 a.begin() + pivot*n + k);
+			det = -det;
+		}
+		det = det*a[k*n + k];
+		const zp_word inv = recip(a[k*n + k]);
+		for (unsigned i = k + 1; i < n; ++i) {
+			if (zerop(a[i*n + k]))
+				continue;
+			const zp_word f = a[i*n + k]*inv;
+			for (unsigned j = k + 1; j < n; ++j)
+				a[i*n + j] = a[i*n + j] - f*a[k*n + j];
+		}
+	}
+	return det;
+}
+
+/** Replace the values v[0], v[stride], ... v[(len-1)*stride] at the points
+ *  0, 1, ... len-1 by the coefficients of the interpolating polynomial of
+ *  degree < len, using Newton's divided differences.  inv[k] is 1/k. */
+void interpolate_line(std::vector<zp_word> & v, std::size_t start, std::size_t stride,
+                      unsigned len, const std::vector<zp_word> & inv,
+                      std::vector<zp_word> & c, const zp_word_ring & R)
+{
+	for (unsigned i = 0; i < len; ++i)
+		c[i] = v[start + i*stride];
+	// The points are consecutive integers, so x_i - x_(i-j) = j
+	for (unsigned j = 1; j < len; ++j)
+		for (unsigned i = len - 1; i >= j; --i)
+			c[i] = (c[i] - c[i-1])*inv[j];
+	// Horner scheme on the Newton form, c[len-1] + (x - (len-2))*(...)
+	const zp_word zero(R, 0L);
+	std::vector<zp_word> q(len, zero);
+	q[0] = c[len-1];
+	for (unsigned k = len - 1; k-- != 0; ) {
+		const zp_word xk(R, static_cast<long>(k));
+		for (unsigned i = len - 1 - k; i > 0; --i)
+			q[i] = q[i-1] - xk*q[i];
+		q[0] = c[k] - xk*q[0];
+	}
+	for (unsigned i = 0; i < len; ++i)
+		v[start + i*stride] = q[i];
+}
+
+/** The points 0, 1, ... len-1 of the grid in one variable. */
+std::vector<zp_word> grid_points(unsigned len, const zp_word_ring & R)
+{
+	std::vector<zp_word> points;
+	points.reserve(len);
+	for (unsigned k = 0; k < len; ++k)
+		points.push_back(zp_word(R, static_cast<long>(k)));
+	return points;
+}
+
+/** Image of the determinant modulo p as dense array of coefficients, the
+ *  coefficient of prod(x_v^e_v) stored at sum(e_v*stride[v]). */
+void determinant_image(std::vector<uint32_t> & image, const std::vector<det_entry> & a,
+                       unsigned n, const std::vector<unsigned> & len,
+                       const std::vector<std::size_t> & stride, long p)
+{
+	const zp_word_ring R(p);
+	const zp_word zero(R, 0L);
+	const std::size_t nvars = len.size();
+	const std::size_t npoints = nvars ? stride[nvars-1]*len[nvars-1] : 1;
+
+	// Reduce the coefficients once
+	std::vector<std::vector<zp_word> > coeffs(a.size());
+	for (std::size_t i = 0; i < a.size(); ++i)
+		for (std::size_t t = 0; t < a[i].coeffs.size(); ++t)
+			coeffs[i].push_back(zp_word(R, a[i].coeffs[t]));
+
+	// With a single variable and many points, the entries are evaluated at
+	// all points at once through a subproduct tree
+	std::vector<std::vector<zp_word> > entry_values;
+	if (nvars == 1 && len[0] >= subproduct_tree_threshold) {
+		const subproduct_tree<zp_word> tree(grid_points(len[0], R), zero);
+		entry_values.resize(a.size());
+		std::vector<zp_word> f;
+		for (std::size_t i = 0; i < a.size(); ++i) {
+			f.assign(len[0], zero);
+			for (std::size_t t = 0; t < coeffs[i].size(); ++t)
+				f[a[i].exponents[t]] = f[a[i].exponents[t]] + coeffs[i][t];
+			tree.evaluate(f, entry_values[i]);
+		}
+	}
+
+	// Evaluate at all points of the grid
+	std::vector<zp_word> values(npoints);
+	std::vector<zp_word> m(n*n);
+	std::vector<std::vector<zp_word> > powers(nvars);
+	std::vector<unsigned> point(nvars, 0);
+	for (std::size_t k = 0; k < npoints; ++k) {
+		if (!entry_values.empty()) {
+			for (std::size_t i = 0; i < a.size(); ++i)
+				m[i] = entry_values[i][k];
+		} else {
+			for (std::size_t v = 0; v < nvars; ++v) {
+				powers[v].assign(len[v], zp_word(R, 1L));
+				const zp_word x(R, static_cast<long>(point[v]));
+				for (unsigned e = 1; e < len[v]; ++e)
+					powers[v][e] = powers[v][e-1]*x;
+			}
+			for (std::size_t i = 0; i < a.size(); ++i) {
+				zp_word s(R, 0L);
+				const unsigned * e = a[i].exponents.empty() ? 0 : &a[i].exponents[0];
+				for (std::size_t t = 0; t < coeffs[i].size(); ++t, e += nvars) {
+					zp_word term = coeffs[i][t];
+					for (std::size_t v = 0; v < nvars; ++v)
+						if (e[v])
+							term = term*powers[v][e[v]];
+					s = s + term;
+				}
+				m[i] = s;
+			}
+		}
+		values[k] = zp_determinant(m, n, R);
+		// next point, with the first variable running fastest
+		for (std::size_t v = 0; v < nvars; ++v) {
+			if (++point[v] < len[v])
+				break;
+			point[v] = 0;
+		}
+	}
+
+	// Interpolate one variable after the other
+	for (std::size_t v = 0; v < nvars; ++v) {
+		if (len[v] == 1)
+			continue;
+		const std::size_t block = stride[v]*len[v];
+		if (len[v] >= subproduct_tree_threshold) {
+			const subproduct_tree<zp_word> tree(grid_points(len[v], R), zero);
+			std::vector<zp_word> line(len[v]), c;
+			for (std::size_t b = 0; b < npoints; b += block)
+				for (std::size_t s = 0; s < stride[v]; ++s) {
+					for (unsigned k = 0; k < len[v]; ++k)
+						line[k] = values[b + s + k*stride[v]];
+					tree.interpolate(line, c);
+					for (unsigned k = 0; k < len[v]; ++k)
+						values[b + s + k*stride[v]] = c[k];
+				}
+			continue;
+		}
+		std::vector<zp_word> inv(len[v], zp_word(R, 1L));
+		for (unsigned j = 2; j < len[v]; ++j)
+			inv[j] = recip(zp_word(R, static_cast<long>(j)));
+		std::vector<zp_word> c(len[v]);
+		for (std::size_t b = 0; b < npoints; b += block)
+			for (std::size_t s = 0; s < stride[v]; ++s)
+				interpolate_line(values, b + s, stride[v], len[v], inv, c, R);
+	}
+
+	image.resize(npoints);
+	for (std::size_t k = 0; k < npoints; ++k)
+		image[k] = values[k].retract();
+}
+
+/** Multiply the rows of the r x c matrix m of rational numbers by the lcm of
+ *  the denominators in the row.  Returns false if some entry is not a
+ *  rational number. */
+bool integer_rows(std::vector<cln::cl_I> & a, const exvector & m, unsigned r, unsigned c)
+{
+	std::vector<cln::cl_RA> q(m.size());
+	for (std::size_t i = 0; i < m.size(); ++i) {
+		if (!m[i].info(info_flags::rational))
+			return false;
+		q[i] = cln::the<cln::cl_RA>(ex_to<numeric>(m[i]).to_cl_N());
+	}
+	a.resize(m.size());
+	for (unsigned i = 0; i < r; ++i) {
+		cln::cl_I d = 1;
+		for (unsigned j = 0; j < c; ++j)
+			d = cln::lcm(d, cln::denominator(q[i*c + j]));
+		for (unsigned j = 0; j < c; ++j)
+			a[i*c + j] = cln::numerator(q[i*c + j]*d);
+	}
+	return true;
+}
+
+/** Sum of squares of the first c entries of row i of the integer matrix a
+ *  with stride columns. */
+cln::cl_I row_square(const std::vector<cln::cl_I> & a, unsigned i, unsigned c, unsigned stride)
+{
+	cln::cl_I s = 0;
+	for (unsigned j = 0; j < c; ++j)
+		s = s + cln::square(a[i*stride + j]);
+	return s;
+}
+
+/** Upper bound of the square root of s. */
+cln::cl_I sqrt_bound(const cln::cl_I & s)
+{
+	return cln::isqrt(s) + 1;
+}
+
+/** Reduce the integer matrix a modulo p. */
+void reduce_matrix(std::vector<zp_word> & b, const std::vector<cln::cl_I> & a, const zp_word_ring & R)
+{
+	b.resize(a.size());
+	for (std::size_t i = 0; i < a.size(); ++i)
+		b[i] = zp_word(R, a[i]);
+}
+
+/** Check that x (n x p, row by row) solves the system with the integer
+ *  n x (n+p) augmented matrix a. */
+bool solves(const std::vector<cln::cl_I> & a, const std::vector<cln::cl_RA> & x, unsigned n, unsigned p)
+{
+	const unsigned c = n + p;
+	for (unsigned i = 0; i < n; ++i) {
+		for (unsigned k = 0; k < p; ++k) {
+			cln::cl_RA s = 0;
+			for (unsigned j = 0; j < n; ++j)
+				s = s + a[i*c + j]*x[j*p + k];
+			if (s != a[i*c + n + k])
+				return false;
+		}
+	}
+	return true;
+}
+
+/** Gauss-Jordan elimination of the n x (n+p) matrix a modulo p.  On success
+ *  the last p columns hold the solution of the system given by the first n
+ *  columns and det its determinant.  Returns false if it is singular. */
+bool zp_solve(std::vector<zp_word> & a, unsigned n, unsigned p, zp_word & det, const zp_word_ring & R)
+{
+	const unsigned c = n + p;
+	det = zp_word(R, 1L);
+	for (unsigned k = 0; k < n; ++k) {
+		unsigned pivot = k;
+		while (pivot < n && zerop(a[pivot*c + k]))
+			++pivot;
+		if (pivot == n)
+			return false;
+		if (pivot != k) {
+			std::swap_ranges(a.begin() + k*c + k, a.begin() + k*c + c,
+			                 a.begin() + pivot*c + k);
+			det = -det;
+		}
+		det = det*a[k*c + k];
+		const zp_word inv = recip(a[k*c + k]);
+		for (unsigned j = k + 1; j < c; ++j)
+			a[k*c + j] = a[k*c + j]*inv;
+		for (unsigned i = 0; i < n; ++i) {
+			if (i == k || zerop(a[i*c + k]))
+				continue;
+			const zp_word f = a[i*c + k];
+			for (unsigned j = k + 1; j < c; ++j)
+				a[i*c + j] = a[i*c + j] - f*a[k*c + j];
+		}
+	}
+	return true;
+}
+
+/** Rank of the r x c matrix a modulo p, a is destroyed. */
+unsigned zp_rank(std::vector<zp_word> & a, unsigned r, unsigned c)
+{
+	unsigned rank = 0;
+	for (unsigned k = 0; k < c && rank < r; ++k) {
+		unsigned pivot = rank;
+		while (pivot < r && zerop(a[pivot*c + k]))
+			++pivot;
+		if (pivot == r)
+			continue;
+		if (pivot != rank)
+			std::swap_ranges(a.begin() + rank*c + k, a.begin() + rank*c + c,
+			                 a.begin() + pivot*c + k);
+		const zp_word inv = recip(a[rank*c + k]);
+		for (unsigned i = rank + 1; i < r; ++i) {
+			if (zerop(a[i*c + k]))
+				continue;
+			const zp_word f = a[i*c + k]*inv;
+			for (unsigned j = k + 1; j < c; ++j)
+				a[i*c + j] = a[i*c + j] - f*a[rank*c + j];
+		}
+		++rank;
+	}
+	return rank;
+}
+
+/** Next prime for the word arithmetic, false if there are no more. */
+bool next_word_prime(primes_factory & pf, long & p)
+{
+	return pf(p, cln::cl_I(1)) && zp_word_ring::fits(p);
+}
+
+/** Chinese remaindering of many residues modulo the same word sized primes,
+ *  by Garner's algorithm.  The mixed radix digits are computed on machine
+ *  words, with the constants depending on the primes only precomputed. */
+class word_cra {
+	std::vector<uint64_t> moduli;
+	std::vector<uint64_t> inverses;             ///< 1/(q[0]*...*q[k-1]) mod q[k]
+	std::vector<std::vector<uint64_t> > reduced; ///< q[j] mod q[k] for j < k
+	cln::cl_I product;
+public:
+	explicit word_cra(const std::vector<long> & q)
+	  : moduli(q.begin(), q.end()), inverses(q.size()), reduced(q.size()), product(1)
+	{
+		for (std::size_t k = 0; k < q.size(); ++k) {
+			const zp_word_ring R(q[k]);
+			zp_word prod(R, 1L);
+			for (std::size_t j = 0; j < k; ++j) {
+				reduced[k].push_back(moduli[j] % moduli[k]);
+				prod = prod*zp_word(R, q[j]);
+			}
+			inverses[k] = k ? recip(prod).retract() : 1;
+			product = product*q[k];
+		}
+	}
+
+	/** The integer in the symmetric range which is r[k] modulo q[k]. */
+	cln::cl_I operator()(const std::vector<uint32_t> & r) const
+	{
+		const std::size_t n = moduli.size();
+		std::vector<uint64_t> digits(n);
+		bool zero = true;
+		for (std::size_t k = 0; k < n; ++k) {
+			const uint64_t q = moduli[k];
+			uint64_t t = 0;
+			for (std::size_t j = k; j-- != 0; )
+				t = (t*reduced[k][j] + digits[j]) % q;
+			digits[k] = ((r[k] + q - t) % q) * inverses[k] % q;
+			if (digits[k])
+				zero = false;
+		}
+		if (zero)
+			return 0;
+		cln::cl_I u = 0;
+		for (std::size_t k = n; k-- != 0; )
+			u = u*cln::cl_I(static_cast<unsigned long>(moduli[k])) + static_cast<unsigned long>(digits[k]);
+		if (u > (product >> 1))
+			u = u - product;
+		return u;
+	}
+};
+
+/** The term c/d*prod(vars[v]^e[v]). */
+ex make_term(const cln::cl_I & c, const numeric & d, const exvector & vars, const exponent_vector & e)
+{
+	exvector factors;
+	factors.reserve(vars.size() + 1);
+	factors.push_back(numeric(c).div(d));
+	for (std::size_t v = 0; v < vars.size(); ++v)
+		if (e[v])
+			factors.push_back(pow(vars[v], e[v]));
+	return (new mul(factors))->setflag(status_flags::dynallocated);
+}
+
+/** The determinant of a matrix with polynomial entries modulo p at a
+ *  point, for the sparse interpolation. */
+class determinant_box : public zp_black_box {
+public:
+	determinant_box(const std::vector<det_entry> & a_, unsigned n_,
+	                const std::vector<unsigned> & len_, const zp_word_ring & R_)
+	 : a(a_), n(n_), len(len_), R(R_), coeffs(a_.size()), m(n_*n_), powers(len_.size())
+	{
+		for (std::size_t i = 0; i < a.size(); ++i)
+			for (std::size_t t = 0; t < a[i].coeffs.size(); ++t)
+				coeffs[i].push_back(zp_word(R, a[i].coeffs[t]));
+	}
+
+	zp_word value(const std::vector<zp_word> & point)
+	{
+		const std::size_t nvars = len.size();
+		for (std::size_t v = 0; v < nvars; ++v) {
+			powers[v].assign(len[v], zp_word(R, 1L));
+			for (unsigned e = 1; e < len[v]; ++e)
+				powers[v][e] = powers[v][e-1]*point[v];
+		}
+		for (std::size_t i = 0; i < a.size(); ++i) {
+			zp_word s(R, 0L);
+			const unsigned * e = a[i].exponents.empty() ? 0 : &a[i].exponents[0];
+			for (std::size_t t = 0; t < coeffs[i].size(); ++t, e += nvars) {
+				zp_word term = coeffs[i][t];
+				for (std::size_t v = 0; v < nvars; ++v)
+					if (e[v])
+						term = term*powers[v][e[v]];
+				s = s + term;
+			}
+			m[i] = s;
+		}
+		return zp_determinant(m, n, R);
+	}
+
+private:
+	const std::vector<det_entry> & a;
+	const unsigned n;
+	const std::vector<unsigned> & len;
+	const zp_word_ring & R;
+	std::vector<std::vector<zp_word> > coeffs;
+	std::vector<zp_word> m;
+	std::vector<std::vector<zp_word> > powers;
+};
+
+/** The determinant by sparse interpolation, for when the dense grid of
+ *  evaluation points is too large: the monomials are found by Zippel's
+ *  algorithm modulo the first prime, the coefficients modulo the other
+ *  primes from these monomials.  Another prime checks the result.  Returns
+ *  false if the interpolation failed. */
+bool sparse_determinant(ex & result, const std::vector<det_entry> & a, unsigned n,
+                        const std::vector<unsigned> & len, const exvector & vars,
+                        const cln::cl_I & bound, const cln::cl_I & denom)
+{
+	std::vector<unsigned> deg(len.size());
+	for (std::size_t v = 0; v < len.size(); ++v)
+		deg[v] = len[v] - 1;
+
+	primes_factory pf;
+	long p;
+	if (!next_word_prime(pf, p))
+		return false;
+	zp_sparse_poly first;
+	{
+		const zp_word_ring R(p);
+		determinant_box f(a, n, len, R);
+		if (!zippel_interpolate(first, f, deg, R, 1))
+			return false;
+	}
+	const std::size_t nterms = first.monomials.size();
+	std::vector<std::vector<uint32_t> > images(1);
+	for (std::size_t j = 0; j < nterms; ++j)
+		images[0].push_back(first.coeffs[j].retract());
+	std::vector<long> moduli(1, p);
+	cln::cl_I modulus = p;
+
+	// One more image than needed for the bound checks the others
+	std::vector<zp_word> c;
+	while (modulus <= 2*bound || images.size() == moduli.size()) {
+		if (!next_word_prime(pf, p))
+			return false;
+		const zp_word_ring R(p);
+		determinant_box f(a, n, len, R);
+		if (!skeleton_interpolate(c, f, first.monomials, R, 1))
+			return false;
+		images.push_back(std::vector<uint32_t>());
+		for (std::size_t j = 0; j < nterms; ++j)
+			images.back().push_back(c[j].retract());
+		if (modulus <= 2*bound) {
+			moduli.push_back(p);
+			modulus = modulus*p;
+		}
+	}
+
+	// Chinese remaindering of the coefficients, checked modulo the last
+	// prime
+	exvector terms;
+	const word_cra cra(moduli);
+	const zp_word_ring check_ring(p);
+	std::vector<uint32_t> residues(moduli.size());
+	const numeric d(denom);
+	for (std::size_t j = 0; j < nterms; ++j) {
+		for (std::size_t i = 0; i < moduli.size(); ++i)
+			residues[i] = images[i][j];
+		const cln::cl_I coeff = cra(residues);
+		if (zp_word(check_ring, coeff).retract() != images.back()[j])
+			return false;
+		if (!cln::zerop(coeff))
+			terms.push_back(make_term(coeff, d, vars, first.monomials[j]));
+	}
+	result = (new add(terms))->setflag(status_flags::dynallocated);
+	return true;
+}
+
+} // anonymous namespace
+
+bool modular_determinant(ex & result, const exvector & m, unsigned n)
+{
+	// Convert the entries to polynomials in a common set of variables
+	exvector expanded(m.size());
+	var_index_map var_index;
+	std::vector<unsigned> deg;
+	for (std::size_t i = 0; i < m.size(); ++i) {
+		expanded[i] = m[i].expand();
+		if (!collect_degrees(expanded[i], var_index, deg))
+			return false;
+	}
+	packing pk;
+	if (!pk.init(var_index, deg))
+		return false;
+	const std::size_t nvars = var_index.size();
+
+	// Make the coefficients integers by scaling the rows, and bound the
+	// degrees and the coefficients of the determinant: it is a sum of
+	// products of one entry from each row (and column), so its degree in
+	// a variable is at most the sum of the highest degrees in the rows
+	// (columns) and the 1-norm at most the product of the row (column)
+	// sums of the 1-norms of the entries.
+	std::vector<det_entry> a(m.size());
+	std::vector<unsigned> row_deg(nvars, 0), col_deg(nvars, 0);
+	std::vector<std::vector<unsigned> > entry_deg(m.size(), std::vector<unsigned>(nvars, 0));
+	std::vector<cln::cl_I> col_norm(n, 0);
+	cln::cl_I row_bound = 1, denom = 1;
+	for (unsigned r = 0; r < n; ++r) {
+		std::vector<sparse_poly> row(n);
+		cln::cl_I d = 1;
+		for (unsigned c = 0; c < n; ++c) {
+			row[c] = to_polynomial(expanded[r*n + c], pk);
+			for (std::size_t t = 0; t < row[c].size(); ++t)
+				d = cln::lcm(d, cln::denominator(row[c][t].coeff));
+		}
+		denom = denom*d;
+		cln::cl_I row_norm = 0;
+		for (unsigned c = 0; c < n; ++c) {
+			det_entry & e = a[r*n + c];
+			for (std::size_t t = 0; t < row[c].size(); ++t) {
+				const cln::cl_I coeff = cln::numerator(row[c][t].coeff*d);
+				e.coeffs.push_back(coeff);
+				row_norm = row_norm + cln::abs(coeff);
+				col_norm[c] = col_norm[c] + cln::abs(coeff);
+				for (std::size_t v = 0; v < nvars; ++v) {
+					const unsigned k = pk.degree(row[c][t].exponents, v);
+					e.exponents.push_back(k);
+					entry_deg[r*n + c][v] = std::max(entry_deg[r*n + c][v], k);
+				}
+			}
+		}
+		row_bound = row_bound*row_norm;
+	}
+	cln::cl_I col_bound = 1;
+	for (unsigned c = 0; c < n; ++c)
+		col_bound = col_bound*col_norm[c];
+	cln::cl_I bound = std::min(row_bound, col_bound);
+	if (nvars == 0) {
+		// A matrix of numbers, where Hadamard's bound is better
+		cln::cl_I hadamard = 1;
+		for (unsigned r = 0; r < n; ++r) {
+			cln::cl_I s = 0;
+			for (unsigned c = 0; c < n; ++c)
+				if (!a[r*n + c].coeffs.empty())
+					s = s + cln::square(a[r*n + c].coeffs[0]);
+			hadamard = hadamard*sqrt_bound(s);
+		}
+		bound = std::min(bound, hadamard);
+	}
+	if (cln::zerop(bound)) {
+		result = _ex0;
+		return true;
+	}
+	for (std::size_t v = 0; v < nvars; ++v) {
+		for (unsigned r = 0; r < n; ++r) {
+			unsigned max_r = 0, max_c = 0;
+			for (unsigned c = 0; c < n; ++c) {
+				max_r = std::max(max_r, entry_deg[r*n + c][v]);
+				max_c = std::max(max_c, entry_deg[c*n + r][v]);
+			}
+			row_deg[v] += max_r;
+			col_deg[v] += max_c;
+		}
+	}
+
+	// Layout of the grid of evaluation points and of the coefficients
+	std::vector<unsigned> len(nvars);
+	for (std::size_t v = 0; v < nvars; ++v)
+		len[v] = std::min(row_deg[v], col_deg[v]) + 1;
+	std::vector<std::size_t> stride(nvars);
+	std::size_t npoints = 1;
+	for (std::size_t v = 0; v < nvars; ++v) {
+		stride[v] = npoints;
+		if (npoints > modular_det_max_points/len[v])
+			return sparse_determinant(result, a, n, len, pk.vars, bound, denom);
+		npoints *= len[v];
+	}
+
+	// Images of the determinant until the product of the primes exceeds
+	// twice the bound, so we can reconstruct in the symmetric range
+	std::vector<std::vector<uint32_t> > images;
+	std::vector<long> moduli;
+	cln::cl_I modulus = 1;
+	primes_factory pf;
+	while (modulus <= 2*bound) {
+		long p;
+		if (!next_word_prime(pf, p))
+			return false;
+		images.push_back(std::vector<uint32_t>());
+		determinant_image(images.back(), a, n, len, stride, p);
+		moduli.push_back(p);
+		modulus = modulus*p;
+	}
+
+	// Chinese remaindering of the coefficients
+	exvector terms;
+	const word_cra cra(moduli);
+	std::vector<uint32_t> residues(moduli.size());
+	const numeric d(denom);
+	exponent_vector e(nvars);
+	for (std::size_t k = 0; k < npoints; ++k) {
+		for (std::size_t i = 0; i < moduli.size(); ++i)
+			residues[i] = images[i][k];
+		const cln::cl_I c = cra(residues);
+		if (cln::zerop(c))
+			continue;
+		std::size_t idx = k;
+		for (std::size_t v = 0; v < nvars; ++v) {
+			e[v] = idx % len[v];
+			idx /= len[v];
+		}
+		terms.push_back(make_term(c, d, pk.vars, e));
+	}
+	result = (new add(terms))->setflag(status_flags::dynallocated);
+	return true;
+}
+
+bool modular_solve(exvector & x, const exvector & aug, unsigned n, unsigned p)
+{
+	const unsigned c = n + p;
+	std::vector<cln::cl_I> a;
+	if (!integer_rows(a, aug, n, c))
+		return false;
+
+	// Bound the determinant, and by Cramer's rule the numerators of the
+	// solution, which are determinants with one column replaced by the
+	// right hand side
+	cln::cl_I det_bound = 1, num_bound = 1;
+	for (unsigned i = 0; i < n; ++i) {
+		const cln::cl_I s = row_square(a, i, n, c);
+		cln::cl_I b = 0;
+		for (unsigned j = n; j < c; ++j)
+			b = std::max(b, cln::abs(a[i*c + j]));
+		det_bound = det_bound*sqrt_bound(s);
+		num_bound = num_bound*sqrt_bound(s + cln::square(b));
+	}
+
+	// Images of the solution modulo primes which don't divide the
+	// determinant, reconstructed as fractions after each prime.  Once these
+	// agree with the next image they are checked against the system.  By
+	// Cramer's rule the denominators are bounded by det_bound and the
+	// numerators by num_bound, so beyond twice their product the
+	// reconstruction with these bounds is the solution.  If the product of
+	// the primes dividing the determinant exceeds its bound it is zero.
+	const cln::cl_I limit = 2*num_bound*det_bound;
+	cln::rational_cra cra(n*p);
+	std::vector<cln::cl_I> residues(n*p);
+	cln::cl_I unlucky = 1;
+	bool checked = false;
+	primes_factory pf;
+	while (!checked && cra.modulus() <= limit) {
+		long q;
+		if (!next_word_prime(pf, q))
+			return false;
+		const zp_word_ring R(q);
+		std::vector<zp_word> b;
+		reduce_matrix(b, a, R);
+		zp_word det;
+		if (!zp_solve(b, n, p, det, R)) {
+			unlucky = unlucky*q;
+			if (unlucky > det_bound)
+				return false;
+			continue;
+		}
+		for (unsigned i = 0; i < n; ++i)
+			for (unsigned j = 0; j < p; ++j)
+				residues[i*p + j] = b[i*c + n + j].retract();
+		if (cra.add_image(residues, q))
+			checked = solves(a, cra.result(), n, p);
+	}
+
+	std::vector<cln::cl_RA> solution(cra.result());
+	if (!checked) {
+		for (unsigned k = 0; k < n*p; ++k)
+			if (!cln::rational_reconstruct(solution[k], cra.images()[k], cra.modulus(), num_bound, det_bound))
+				return false;
+	}
+	x.resize(n*p);
+	for (unsigned k = 0; k < n*p; ++k)
+		x[k] = numeric(solution[k]);
+	return true;
+}
+
+bool modular_rank(unsigned & result, const exvector & m, unsigned r, unsigned c)
+{
+	std::vector<cln::cl_I> a;
+	if (!integer_rows(a, m, r, c))
+		return false;
+
+	// The rank modulo p is at most the rank, and smaller only if p divides
+	// a nonzero minor of maximal size, all of which are bounded by the
+	// product of the row norms.  Once the primes giving the highest rank
+	// seen have a product above that bound, not all of them can divide it.
+	cln::cl_I bound = 1;
+	for (unsigned i = 0; i < r; ++i)
+		bound = bound*sqrt_bound(row_square(a, i, c, c));
+	unsigned rank = 0;
+	cln::cl_I modulus = 1;
+	primes_factory pf;
+	while (modulus <= bound) {
+		long q;
+		if (!next_word_prime(pf, q))
+			return false;
+		const zp_word_ring R(q);
+		std::vector<zp_word> b;
+		reduce_matrix(b, a, R);
+		const unsigned rank_q = zp_rank(b, r, c);
+		if (rank_q > rank) {
+			rank = rank_q;
+			modulus = 1;
+		}
+		if (rank_q == rank)
+			modulus = modulus*q;
+		if (rank == std::min(r, c))
+			break;
+	}
+	result = rank;
+	return true;
+}
+
+} // namespace GiNaC
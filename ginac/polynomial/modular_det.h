@@ -0,0 +1,73 @@
+/** @file modular_det.h
+ *
+ *  Interface to linear algebra modulo primes: the determinant of polynomial
+ *  matrices, linear systems and ranks of rational matrices. */
+
+/*
+ *  GiNaC Copyright (C) 1999-2014 Johannes Gutenberg University Mainz, Germany
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#ifndef GINAC_POLYNOMIAL_MODULAR_DET_H
+#define GINAC_POLYNOMIAL_MODULAR_DET_H
+
+#include "ex.h"
+
+namespace GiNaC {
+
+/**
+ * Expanded determinant of a square matrix with polynomial entries, computed
+ * by evaluating the variables at points modulo word sized primes, taking the
+ * numeric determinants, interpolating and Chinese remaindering.
+ * If the dense grid of points would be too large, the determinant is
+ * reconstructed by sparse interpolation (see zippel_interpolate()).
+ *
+ * @param result  on success, the expanded determinant
+ * @param m  entries of the matrix, row by row
+ * @param n  number of rows (and columns)
+ * @return false if some entry is not a polynomial in symbols with rational
+ *         coefficients, or the sparse interpolation failed.  result is left
+ *         untouched in that case.
+ */
+extern bool modular_determinant(ex & result, const exvector & m, unsigned n);
+
+/**
+ * Solution of a nonsingular linear system with rational coefficients,
+ * computed modulo word sized primes.  The fractions are reconstructed
+ * directly from the images, and primes are added until they no longer
+ * change and solve the system, or until Cramer's rule bounds their size.
+ *
+ * @param result  on success, the n x p solution, row by row
+ * @param aug  entries of the augmented n x (n+p) matrix, row by row
+ * @param n  number of equations and unknowns
+ * @param p  number of right hand sides
+ * @return false if some entry is not a rational number or the system is
+ *         singular.  result is left untouched in that case.
+ */
+extern bool modular_solve(exvector & result, const exvector & aug, unsigned n, unsigned p);
+
+/**
+ * Rank of a matrix of rational numbers, computed modulo word sized primes.
+ *
+ * @param result  on success, the rank
+ * @param m  entries of the r x c matrix, row by row
+ * @return false if some entry is not a rational number.
+ */
+extern bool modular_rank(unsigned & result, const exvector & m, unsigned r, unsigned c);
+
+} // namespace GiNaC
+
+#endif // ndef GINAC_POLYNOMIAL_MODULAR_DET_H
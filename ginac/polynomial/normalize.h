@@ -30,10 +30,11 @@
 namespace GiNaC {
 
 /// Make the univariate polynomial @a a \in F[x] unit normal.
-/// F should be a field.
+/// F should be a field (umodpoly or uwordpoly).
 /// Returns true if the polynomial @x is already unit normal, and false
 /// otherwise.
-static bool normalize_in_field(umodpoly& a, cln::cl_MI* content_ = 0)
+template<typename T> static bool
+normalize_in_field(T& a, typename T::value_type* content_ = 0)
 {
 	if (a.size() == 0)
 		return true;
@@ -43,7 +44,7 @@ static bool normalize_in_field(umodpoly& a, cln::cl_MI* content_ = 0)
 		return true;
 	}
 
-	const cln::cl_MI lc_1 = recip(lcoeff(a));
+	const typename T::value_type lc_1 = recip(lcoeff(a));
 	for (std::size_t k = a.size(); k-- != 0; )
 		a[k] = a[k]*lc_1;
 	if (content_)
@@ -63,6 +63,54 @@ template<typename T> bool pseudoremainder(T& r, const T& a, const T& b)
 	return remainder_in_ring(r, a_, b);
 }
 
+/// Sparse pseudo-division of univariate polynomials @a a and @a b: computes
+/// \f$q(x)\f$ and \f$r(x)\f$ with \f$\beta^i a(x) = b(x) q(x) + r(x)\f$
+/// and degree(r) < degree(b), where \f$\beta\f$ is the leading coefficient
+/// of \f$b(x)\f$ and \f$i\f$ the number of nonzero leading coefficients
+/// eliminated, which is returned. No division of ring elements is needed.
+template<typename T> std::size_t
+sparse_pseudo_divide(T& q, T& r, const T& a, const T& b)
+{
+	typedef typename T::value_type ring_t;
+	bug_on(b.empty(), "division by zero");
+	r = a;
+	q.clear();
+	if (a.size() < b.size())
+		return 0;
+
+	const ring_t blcoeff = lcoeff(b);
+	const ring_t zero = get_ring_elt(blcoeff, 0);
+	const bool unit_lcoeff = blcoeff == the_one(blcoeff);
+	const std::size_t n = b.size() - 1;
+	q.assign(a.size() - n, zero);
+	std::size_t steps = 0;
+	for (std::size_t k = a.size(); k-- > n; ) {
+		if (zerop(r[k]))
+			continue;
+
+		// beta r -= r_k x^{k - n} b(x), beta q += r_k x^{k - n}
+		const ring_t c = r[k];
+		if (!unit_lcoeff) {
+			for (std::size_t j = 0; j < k; ++j)
+				r[j] = r[j]*blcoeff;
+			for (std::size_t j = k - n + 1; j < q.size(); ++j)
+				q[j] = q[j]*blcoeff;
+		}
+		q[k - n] = c;
+		for (std::size_t i = 0; i < n; ++i) {
+			if (zerop(b[i]))
+				continue;
+			r[k - n + i] = r[k - n + i] - c*b[i];
+		}
+		r[k] = zero;
+		++steps;
+	}
+	r.resize(n);
+	canonicalize(r);
+	canonicalize(q);
+	return steps;
+}
+
 } // namespace GiNaC
 
 #endif // GINAC_POLYNOMIAL_PREM_H
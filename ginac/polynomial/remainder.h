@@ -38,10 +38,10 @@ namespace GiNaC {
  * defined as \f$a = b q + r\f$. Returns true if the remainder is zero
  * and false otherwise.
  */
-static bool
-remainder_in_field(umodpoly& r, const umodpoly& a, const umodpoly& b)
+template<typename T> static bool
+remainder_in_field(T& r, const T& a, const T& b)
 {
-	typedef cln::cl_MI field_t;
+	typedef typename T::value_type field_t;
 
 	if (degree(a) < degree(b)) {
 		r = a;
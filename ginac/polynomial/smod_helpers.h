@@ -28,6 +28,7 @@
 #include "debug.h"
 
 #include <cln/integer.h>
+#include <stdint.h> // for uint64_t
 #include <cln/integer_io.h>
 
 namespace GiNaC {
@@ -69,23 +70,25 @@ static inline cln::cl_I to_cl_I(const ex& e)
 	return cln::the<cln::cl_I>(ex_to<numeric>(e).to_cl_N());
 }
 
+/// Pseudo-random elements of Z_p in symmetric representation. Each
+/// generator has a state of its own, seeded by p, instead of CLN's global
+/// random state, so that it can be used in several threads at a time.
 struct random_modint
 {
 	typedef long value_type;
 	const value_type p;
 	const value_type p_2;
+	uint64_t state;
 
-	random_modint(const value_type& p_) : p(p_), p_2((p >> 1))
+	random_modint(const value_type& p_) : p(p_), p_2((p >> 1)), state(p_)
 	{ }
-	value_type operator()() const
+	value_type operator()()
 	{
-		do {
-			cln::cl_I tmp_ = cln::random_I(p);
-			value_type tmp = cln::cl_I_to_long(tmp_);
-			if (tmp > p_2)
-				tmp -= p;
-			return tmp;
-		} while (true);
+		state = state * 6364136223846793005ULL + 1442695040888963407ULL;
+		value_type tmp = static_cast<value_type>((state >> 16) % static_cast<uint64_t>(p));
+		if (tmp > p_2)
+			tmp -= p;
+		return tmp;
 	}
 
 };
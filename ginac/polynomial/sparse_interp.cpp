@@ -0,0 +1,322 @@
+/** @file sparse_interp.cpp
+ *
+ *  Interpolation of sparse multivariate polynomials over Z/p. */
+
+/*
+ *  GiNaC Copyright (C) 1999-2014 Johannes Gutenberg University Mainz, Germany
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#include "sparse_interp.h"
+#include "subproduct_tree.h"
+
+#include <algorithm>
+#include <cstddef>
+#include <stdint.h> // for uint32_t, uint64_t
+
+namespace GiNaC {
+
+namespace {
+
+/** Number of random points tried before giving up on finding one where the
+ *  monomials take distinct values. */
+const int max_point_attempts = 4;
+
+/** Pseudo-random elements of Z/p, from the same generator as the points of
+ *  sparse_may_divide(). */
+class zp_random {
+	uint64_t state;
+	const zp_word_ring & R;
+public:
+	zp_random(unsigned seed, const zp_word_ring & R_) : state(seed), R(R_) { }
+
+	zp_word operator()()
+	{
+		state = state * 6364136223846793005ULL + 1442695040888963407ULL;
+		return zp_word(R, static_cast<long>(state >> 33));
+	}
+};
+
+zp_word power(zp_word x, unsigned e)
+{
+	zp_word r = the_one(x);
+	while (e) {
+		if (e & 1)
+			r = r*x;
+		x = x*x;
+		e >>= 1;
+	}
+	return r;
+}
+
+/** Value of the monomial e at y, where y may have fewer coordinates than e
+ *  has exponents (the others must be zero). */
+zp_word monomial_value(const exponent_vector & e, const std::vector<zp_word> & y, const zp_word & one)
+{
+	zp_word r = one;
+	for (std::size_t v = 0; v < y.size(); ++v)
+		if (e[v])
+			r = r*power(y[v], e[v]);
+	return r;
+}
+
+/** Check that the values are distinct. */
+bool all_distinct(const std::vector<zp_word> & k)
+{
+	std::vector<uint32_t> r;
+	r.reserve(k.size());
+	for (std::size_t j = 0; j < k.size(); ++j)
+		r.push_back(k[j].retract());
+	std::sort(r.begin(), r.end());
+	return std::adjacent_find(r.begin(), r.end()) == r.end();
+}
+
+/** Solver of the transposed Vandermonde systems sum_j c_j k_j^i = v_i,
+ *  i = 0 ... t-1, for fixed distinct nodes k_0 ... k_(t-1), in O(t^2) each.
+ *  With P(z) the product of all z - k_j and P_j(z) = P(z)/(z - k_j), the
+ *  solution is c_j = (sum_i P_j[i] v_i) / P_j(k_j). */
+class vandermonde_solver {
+public:
+	explicit vandermonde_solver(const std::vector<zp_word> & nodes_)
+	 : nodes(nodes_), zero(nodes_[0] - nodes_[0])
+	{
+		const std::size_t t = nodes.size();
+		master.assign(t + 1, zero);
+		master[0] = the_one(zero);
+		for (std::size_t j = 0; j < t; ++j) {
+			for (std::size_t i = j + 1; i > 0; --i)
+				master[i] = master[i - 1] - nodes[j]*master[i];
+			master[0] = -nodes[j]*master[0];
+		}
+		inv_deriv.resize(t);
+		std::vector<zp_word> q;
+		for (std::size_t j = 0; j < t; ++j) {
+			quotient(j, q);
+			zp_word s = zero;
+			for (std::size_t i = t; i-- > 0; )
+				s = s*nodes[j] + q[i];
+			inv_deriv[j] = recip(s);
+		}
+	}
+
+	void solve(const std::vector<zp_word> & v, std::vector<zp_word> & c) const
+	{
+		const std::size_t t = nodes.size();
+		c.resize(t);
+		std::vector<zp_word> q;
+		for (std::size_t j = 0; j < t; ++j) {
+			quotient(j, q);
+			zp_word s = zero;
+			for (std::size_t i = 0; i < t; ++i)
+				s = s + q[i]*v[i];
+			c[j] = s*inv_deriv[j];
+		}
+	}
+
+private:
+	/** q = P(z)/(z - k_j) by synthetic division. */
+	void quotient(std::size_t j, std::vector<zp_word> & q) const
+	{
+		const std::size_t t = nodes.size();
+		q.resize(t);
+		q[t - 1] = master[t];
+		for (std::size_t i = t - 1; i > 0; --i)
+			q[i - 1] = master[i] + nodes[j]*q[i];
+	}
+
+	const std::vector<zp_word> nodes;
+	const zp_word zero;
+	std::vector<zp_word> master;     ///< P, lowest degree first
+	std::vector<zp_word> inv_deriv;  ///< 1/P_j(k_j) = 1/P'(k_j)
+};
+
+/** Find a point y of the first nvars variables where the monomials take
+ *  distinct values, which are the nodes of the Vandermonde systems. */
+bool find_distinct_point(std::vector<zp_word> & y, std::vector<zp_word> & nodes,
+                         const std::vector<exponent_vector> & monomials,
+                         std::size_t nvars, zp_random & rnd, const zp_word & one)
+{
+	for (int attempt = 0; attempt < max_point_attempts; ++attempt) {
+		y.resize(nvars);
+		for (std::size_t v = 0; v < nvars; ++v)
+			y[v] = rnd();
+		nodes.resize(monomials.size());
+		for (std::size_t j = 0; j < monomials.size(); ++j)
+			nodes[j] = monomial_value(monomials[j], y, one);
+		if (all_distinct(nodes))
+			return true;
+	}
+	return false;
+}
+
+/** Values of f at the points (y^i, rest) for i = 0 ... count-1, where y^i
+ *  is taken coordinatewise. */
+void power_values(std::vector<zp_word> & values, zp_black_box & f, const std::vector<zp_word> & y,
+                  const std::vector<zp_word> & rest, std::size_t count, const zp_word & one)
+{
+	std::vector<zp_word> point(y.size(), one);
+	point.insert(point.end(), rest.begin(), rest.end());
+	values.resize(count);
+	for (std::size_t i = 0; i < count; ++i) {
+		values[i] = f.value(point);
+		for (std::size_t v = 0; v < y.size(); ++v)
+			point[v] = point[v]*y[v];
+	}
+}
+
+/** Check that the coefficients c of the monomials with values k give the
+ *  last of the values (which was not used to compute them). */
+bool check_last_value(const std::vector<zp_word> & c, const std::vector<zp_word> & k,
+                      const std::vector<zp_word> & values)
+{
+	const std::size_t t = c.size();
+	zp_word s = values[t] - values[t];
+	for (std::size_t j = 0; j < t; ++j)
+		s = s + c[j]*power(k[j], static_cast<unsigned>(t));
+	return s == values[t];
+}
+
+} // anonymous namespace
+
+bool zippel_interpolate(zp_sparse_poly & result, zp_black_box & f,
+                        const std::vector<unsigned> & deg,
+                        const zp_word_ring & R, unsigned seed)
+{
+	const std::size_t nvars = deg.size();
+	const zp_word zero(R, 0L), one(R, 1L);
+	zp_random rnd(seed, R);
+	zp_sparse_poly p;
+
+	// The remaining variables are fixed at this point while the first ones
+	// are interpolated
+	std::vector<zp_word> anchor(nvars);
+	for (std::size_t v = 0; v < nvars; ++v)
+		anchor[v] = rnd();
+
+	if (nvars == 0) {
+		const zp_word c = f.value(anchor);
+		if (!zerop(c)) {
+			p.monomials.push_back(exponent_vector());
+			p.coeffs.push_back(c);
+		}
+		result = p;
+		return true;
+	}
+
+	// The first variable is interpolated densely
+	{
+		std::vector<zp_word> xs(deg[0] + 1), values(deg[0] + 1), c;
+		std::vector<zp_word> point(anchor);
+		for (unsigned i = 0; i <= deg[0]; ++i) {
+			xs[i] = anchor[0] + zp_word(R, static_cast<long>(i));
+			point[0] = xs[i];
+			values[i] = f.value(point);
+		}
+		subproduct_tree<zp_word>(xs, zero).interpolate(values, c);
+		for (unsigned e = 0; e <= deg[0]; ++e) {
+			if (zerop(c[e]))
+				continue;
+			exponent_vector m(nvars, 0);
+			m[0] = e;
+			p.monomials.push_back(m);
+			p.coeffs.push_back(c[e]);
+		}
+	}
+
+	// Add the other variables one after the other, keeping the monomials
+	// in the ones before
+	for (std::size_t v = 1; v < nvars; ++v) {
+		const std::size_t t = p.monomials.size();
+		if (t == 0)
+			break;  // the final check tells if f is really zero
+		std::vector<zp_word> y, nodes;
+		if (!find_distinct_point(y, nodes, p.monomials, v, rnd, one))
+			return false;
+		const vandermonde_solver solver(nodes);
+
+		// coeffs[i][j] is the coefficient of monomial j for x_v = xs[i]
+		std::vector<zp_word> xs(deg[v] + 1);
+		std::vector<std::vector<zp_word> > coeffs(deg[v] + 1);
+		xs[0] = anchor[v];
+		coeffs[0] = p.coeffs;
+		std::vector<zp_word> rest(anchor.begin() + v, anchor.end()), values;
+		for (unsigned i = 1; i <= deg[v]; ++i) {
+			xs[i] = anchor[v] + zp_word(R, static_cast<long>(i));
+			rest[0] = xs[i];
+			power_values(values, f, y, rest, t + 1, one);
+			solver.solve(values, coeffs[i]);
+			if (!check_last_value(coeffs[i], nodes, values))
+				return false;
+		}
+
+		// Interpolate the coefficient of each monomial in x_v
+		const subproduct_tree<zp_word> tree(xs, zero);
+		zp_sparse_poly next;
+		std::vector<zp_word> c_values(deg[v] + 1), c;
+		for (std::size_t j = 0; j < t; ++j) {
+			for (unsigned i = 0; i <= deg[v]; ++i)
+				c_values[i] = coeffs[i][j];
+			tree.interpolate(c_values, c);
+			for (unsigned e = 0; e <= deg[v]; ++e) {
+				if (zerop(c[e]))
+					continue;
+				exponent_vector m(p.monomials[j]);
+				m[v] = e;
+				next.monomials.push_back(m);
+				next.coeffs.push_back(c[e]);
+			}
+		}
+		std::swap(p, next);
+	}
+
+	// Check at a random point
+	std::vector<zp_word> z(nvars);
+	for (std::size_t v = 0; v < nvars; ++v)
+		z[v] = rnd();
+	zp_word s = zero;
+	for (std::size_t j = 0; j < p.monomials.size(); ++j)
+		s = s + p.coeffs[j]*monomial_value(p.monomials[j], z, one);
+	if (s != f.value(z))
+		return false;
+
+	std::swap(result, p);
+	return true;
+}
+
+bool skeleton_interpolate(std::vector<zp_word> & coeffs, zp_black_box & f,
+                          const std::vector<exponent_vector> & skeleton,
+                          const zp_word_ring & R, unsigned seed)
+{
+	const zp_word one(R, 1L);
+	zp_random rnd(seed, R);
+	if (skeleton.empty()) {
+		coeffs.clear();
+		return true;
+	}
+	const std::size_t nvars = skeleton[0].size();
+
+	std::vector<zp_word> y, nodes, values, c;
+	if (!find_distinct_point(y, nodes, skeleton, nvars, rnd, one))
+		return false;
+	power_values(values, f, y, std::vector<zp_word>(), skeleton.size() + 1, one);
+	vandermonde_solver(nodes).solve(values, c);
+	if (!check_last_value(c, nodes, values))
+		return false;
+	coeffs.swap(c);
+	return true;
+}
+
+} // namespace GiNaC
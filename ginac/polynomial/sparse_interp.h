@@ -0,0 +1,93 @@
+/** @file sparse_interp.h
+ *
+ *  Interpolation of sparse multivariate polynomials over Z/p, after
+ *  R. Zippel, "Interpolating Polynomials from their Values", J. Symbolic
+ *  Computation 9 (1990). */
+
+/*
+ *  GiNaC Copyright (C) 1999-2014 Johannes Gutenberg University Mainz, Germany
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#ifndef GINAC_POLYNOMIAL_SPARSE_INTERP_H
+#define GINAC_POLYNOMIAL_SPARSE_INTERP_H
+
+#include "zp_word.h"
+
+#include <vector>
+
+namespace GiNaC {
+
+/** Exponents of the variables in a monomial. */
+typedef std::vector<unsigned> exponent_vector;
+
+/** Polynomial over Z/p: the monomials of its terms and their coefficients. */
+struct zp_sparse_poly {
+	std::vector<exponent_vector> monomials;
+	std::vector<zp_word> coeffs;
+};
+
+/** A polynomial over Z/p which is only known by its values, like the
+ *  determinant of a matrix of polynomials or the GCD of images. */
+class zp_black_box {
+public:
+	virtual ~zp_black_box() { }
+	/** The value at a point, one coordinate per variable. */
+	virtual zp_word value(const std::vector<zp_word> & point) = 0;
+};
+
+/**
+ * Reconstruct the polynomial of a black box with Zippel's algorithm.  The
+ * variables are added one after the other: the values of the terms found
+ * so far, with the remaining variables fixed at random numbers, are
+ * interpolated densely in the next variable, where the coefficients for
+ * each of its values come from a transposed Vandermonde system.  With t
+ * terms this needs about t*(deg[v]+1) evaluations per variable v, instead
+ * of the product of all deg[v]+1 of a dense interpolation.
+ *
+ * The algorithm is probabilistic: terms are lost if the random numbers
+ * chosen are a zero of their coefficient.  That is unlikely for large p,
+ * and the result is checked at a random point.
+ *
+ * @param result  on success, the polynomial
+ * @param f  the black box
+ * @param deg  bound of the degree of the polynomial in each variable
+ * @param R  the ring, p must be larger than every deg[v]
+ * @param seed  for the pseudo-random choices
+ * @return false if the interpolation failed, which a different seed may fix
+ */
+extern bool zippel_interpolate(zp_sparse_poly & result, zp_black_box & f,
+                               const std::vector<unsigned> & deg,
+                               const zp_word_ring & R, unsigned seed);
+
+/**
+ * Compute the coefficients of the polynomial of a black box whose terms are
+ * known to have the given monomials, with a single transposed Vandermonde
+ * system of skeleton.size() evaluations.  This is how further images of a
+ * polynomial over Z are computed, with the monomials of the first image
+ * (from zippel_interpolate()) modulo other primes.
+ *
+ * @param coeffs  on success, the coefficients of the monomials, possibly 0
+ * @return false if the values are not those of a polynomial with these
+ *         monomials, or no suitable point was found
+ */
+extern bool skeleton_interpolate(std::vector<zp_word> & coeffs, zp_black_box & f,
+                                 const std::vector<exponent_vector> & skeleton,
+                                 const zp_word_ring & R, unsigned seed);
+
+} // namespace GiNaC
+
+#endif // ndef GINAC_POLYNOMIAL_SPARSE_INTERP_H
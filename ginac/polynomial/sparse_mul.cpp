@@ -0,0 +1,172 @@
+/** @file sparse_mul.cpp
+ *
+ *  Multiplication of sparse distributed polynomials, after M. Monagan and
+ *  R. Pearce, "Polynomial Division using Dynamic Arrays, Heaps, and Packed
+ *  Exponent Vectors", CASC 2007. */
+
+/*
+ *  GiNaC Copyright (C) 1999-2014 Johannes Gutenberg University Mainz, Germany
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#include "sparse_mul.h"
+#include "sparse_poly.h"
+#include "kronecker.h"
+#include "add.h"
+#include "tasks.h"
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <cln/rational.h>
+#include <vector>
+
+namespace GiNaC {
+
+namespace {
+
+/** Number of threads multiply_parallel() may use, see set_expand_threads(). */
+unsigned expand_threads = 1;
+
+#ifdef HAVE_PTHREAD_H
+
+/** Products of fewer term pairs are not worth starting threads for. */
+const std::size_t min_parallel_work = 1 << 16;
+
+/** Copy a coefficient without sharing any CLN heap object with the
+ *  original.  CLN doesn't update its reference counts atomically, so each
+ *  worker thread needs private copies of its input, and assigning only
+ *  adds a reference; arithmetic creates new objects. */
+cln::cl_RA private_copy(const cln::cl_RA & x)
+{
+	const cln::cl_I num = cln::numerator(x) + 1;
+	const cln::cl_I den = cln::denominator(x) + 1;
+	return (num - 1) / (den - 1);
+}
+
+sparse_poly private_copy(sparse_poly::const_iterator first, sparse_poly::const_iterator last)
+{
+	sparse_poly p;
+	p.reserve(last - first);
+	for (; first != last; ++first)
+		p.push_back(sparse_term(first->exponents, private_copy(first->coeff)));
+	return p;
+}
+
+/** Part of a product computed by one task. */
+struct multiply_job {
+	sparse_poly a, b;
+	sparse_poly result;
+	bool failed;
+};
+
+void * run_multiply_job(void * arg)
+{
+	multiply_job & job = *static_cast<multiply_job *>(arg);
+	try {
+		job.result = sparse_multiply(job.a, job.b);
+	} catch (...) {
+		job.failed = true;
+	}
+	return 0;
+}
+
+/** Product of two packed polynomials, computed by up to nthreads threads.
+ *  The smaller factor is cut into slices which are multiplied with the
+ *  other factor simultaneously, then the partial products are added. */
+sparse_poly multiply_parallel(const sparse_poly & a, const sparse_poly & b, unsigned nthreads)
+{
+	if (a.size() > b.size())
+		return multiply_parallel(b, a, nthreads);
+	if (nthreads > a.size())
+		nthreads = a.size();
+	if (nthreads < 2 || a.size() * b.size() < min_parallel_work)
+		return sparse_multiply(a, b);
+
+	std::vector<multiply_job> jobs(nthreads);
+	for (unsigned k = 0; k < nthreads; ++k) {
+		jobs[k].a = private_copy(a.begin() + a.size() * k / nthreads,
+		                         a.begin() + a.size() * (k + 1) / nthreads);
+		jobs[k].b = private_copy(b.begin(), b.end());
+		jobs[k].failed = false;
+	}
+
+	run_tasks(run_multiply_job, jobs);
+
+	sparse_poly r;
+	for (unsigned k = 0; k < nthreads; ++k) {
+		if (jobs[k].failed)
+			return sparse_multiply(a, b);
+		r = sparse_add(r, jobs[k].result);
+	}
+	return r;
+}
+
+#else // def HAVE_PTHREAD_H
+
+sparse_poly multiply_parallel(const sparse_poly & a, const sparse_poly & b, unsigned nthreads)
+{
+	return sparse_multiply(a, b);
+}
+
+#endif // def HAVE_PTHREAD_H
+
+} // anonymous namespace
+
+bool sparse_poly_mul(ex & result, const exvector & v)
+{
+	// Find the variables and the degree of the product in each of them.
+	var_index_map var_index;
+	std::vector<unsigned> total_deg;
+	for (exvector::const_iterator s = v.begin(); s != v.end(); ++s) {
+		if (!is_exactly_a<add>(*s))
+			return false;
+		std::vector<unsigned> deg(total_deg.size(), 0);
+		if (!collect_degrees(*s, var_index, deg))
+			return false;
+		total_deg.resize(deg.size(), 0);
+		for (size_t i = 0; i < deg.size(); ++i)
+			total_deg[i] += deg[i];
+	}
+
+	packing pk;
+	if (!pk.init(var_index, total_deg))
+		return false;
+
+	sparse_poly product = to_polynomial(v[0], pk);
+	for (size_t i = 1; i < v.size(); ++i) {
+		const sparse_poly factor = to_polynomial(v[i], pk);
+		if (!kronecker_multiply(product, product, factor, pk))
+			product = multiply_parallel(product, factor, expand_threads);
+	}
+
+	result = from_polynomial(product, pk);
+	return true;
+}
+
+unsigned set_expand_threads(unsigned n)
+{
+	const unsigned previous = expand_threads;
+	expand_threads = (n > 0 ? n : 1);
+	return previous;
+}
+
+unsigned get_expand_threads()
+{
+	return expand_threads;
+}
+
+} // namespace GiNaC
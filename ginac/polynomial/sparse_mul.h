@@ -0,0 +1,44 @@
+/** @file sparse_mul.h
+ *
+ *  Interface to multiplication of sparse distributed polynomials. */
+
+/*
+ *  GiNaC Copyright (C) 1999-2014 Johannes Gutenberg University Mainz, Germany
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#ifndef GINAC_POLYNOMIAL_SPARSE_MUL_H
+#define GINAC_POLYNOMIAL_SPARSE_MUL_H
+
+#include "ex.h"
+
+namespace GiNaC {
+
+/**
+ * Expanded product of the sums in v, computed by converting them to sparse
+ * distributed polynomials with packed exponent vectors.
+ *
+ * @param result  on success, the expanded product
+ * @param v  sums to multiply (must be objects of class add)
+ * @return false if some sum is not a polynomial in symbols with rational
+ *         coefficients, or the degrees are too high for the packed
+ *         representation.  result is left untouched in that case.
+ */
+extern bool sparse_poly_mul(ex & result, const exvector & v);
+
+} // namespace GiNaC
+
+#endif // ndef GINAC_POLYNOMIAL_SPARSE_MUL_H
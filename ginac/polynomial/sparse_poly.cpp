@@ -0,0 +1,521 @@
+/** @file sparse_poly.cpp
+ *
+ *  Arithmetic of sparse distributed polynomials, after M. Monagan and
+ *  R. Pearce, "Polynomial Division using Dynamic Arrays, Heaps, and Packed
+ *  Exponent Vectors", CASC 2007. */
+
+/*
+ *  GiNaC Copyright (C) 1999-2014 Johannes Gutenberg University Mainz, Germany
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#include "sparse_poly.h"
+#include "kronecker.h"
+#include "add.h"
+#include "budget.h"
+#include "mul.h"
+#include "numeric.h"
+#include "power.h"
+#include "normal.h"
+#include "symbol.h"
+#include "utils.h"
+#include "remainder.h"
+#include "gcd_euclid.h"
+#include "zp_word.h"
+
+#include <algorithm>
+#include <cln/rational.h>
+#include <memory>
+#include <stdint.h> // for uint64_t
+#include <vector>
+
+namespace GiNaC {
+
+namespace {
+
+/** Call f(var, degree) for every variable of the term t and store its
+ *  coefficient in c.  Returns false if t is not a monomial in symbols with
+ *  positive integer exponents times a rational number. */
+template<typename F>
+bool for_each_var(const ex & t, F & f, cln::cl_RA & c)
+{
+	if (is_exactly_a<symbol>(t)) {
+		f(t, 1);
+		return true;
+	}
+	if (is_exactly_a<numeric>(t)) {
+		if (!t.info(info_flags::rational))
+			return false;
+		c = c * cln::the<cln::cl_RA>(ex_to<numeric>(t).to_cl_N());
+		return true;
+	}
+	if (is_exactly_a<power>(t)) {
+		const ex & b = t.op(0);
+		const ex & e = t.op(1);
+		if (!is_exactly_a<symbol>(b) || !e.info(info_flags::posint) ||
+		    ex_to<numeric>(e).int_length() > 16)
+			return false;
+		f(b, ex_to<numeric>(e).to_int());
+		return true;
+	}
+	if (is_exactly_a<mul>(t)) {
+		for (size_t i = 0; i < t.nops(); ++i)
+			if (!for_each_var(t.op(i), f, c))
+				return false;
+		return true;
+	}
+	return false;
+}
+
+struct degree_collector {
+	degree_collector(var_index_map & vi, std::vector<unsigned> & d) : var_index(vi), deg(d) { }
+	void operator()(const ex & var, unsigned e)
+	{
+		var_index_map::iterator i = var_index.find(var);
+		if (i == var_index.end()) {
+			i = var_index.insert(std::make_pair(var, unsigned(deg.size()))).first;
+			deg.push_back(0);
+		}
+		deg[i->second] = std::max(deg[i->second], e);
+	}
+	var_index_map & var_index;
+	std::vector<unsigned> & deg;
+};
+
+struct exponent_packer {
+	exponent_packer(const packing & p) : pk(p), exponents(0) { }
+	void operator()(const ex & var, unsigned e)
+	{
+		const unsigned i = pk.var_index.find(var)->second;
+		exponents += packed_exponents(e) << pk.shift[i];
+	}
+	const packing & pk;
+	packed_exponents exponents;
+};
+
+/** Heap entries of the product: the term a[i] * b[j]. */
+struct heap_entry {
+	heap_entry(packed_exponents e, size_t i_, size_t j_) : exponents(e), i(i_), j(j_) { }
+	packed_exponents exponents;
+	size_t i, j;
+};
+
+struct heap_entry_is_less {
+	bool operator()(const heap_entry & h1, const heap_entry & h2) const
+	{
+		return h1.exponents < h2.exponents;
+	}
+};
+
+} // anonymous namespace
+
+bool packing::init(const var_index_map & vi, const std::vector<unsigned> & max_deg)
+{
+	unsigned max = 0;
+	for (size_t i = 0; i < max_deg.size(); ++i)
+		max = std::max(max, max_deg[i]);
+	unsigned bits = 1;
+	while ((packed_exponents(1) << bits) <= max)
+		++bits;
+	// one more bit for the guard
+	if ((bits + 1) * vi.size() > 8 * sizeof(packed_exponents))
+		return false;
+
+	var_index = vi;
+	vars.resize(vi.size());
+	shift.resize(vi.size());
+	mask = (packed_exponents(1) << bits) - 1;
+	guards = 0;
+	for (var_index_map::const_iterator i = vi.begin(); i != vi.end(); ++i) {
+		vars[i->second] = i->first;
+		shift[i->second] = (bits + 1) * i->second;
+		guards |= packed_exponents(1) << (shift[i->second] + bits);
+	}
+	return true;
+}
+
+bool collect_degrees(const ex & e, var_index_map & vi, std::vector<unsigned> & deg)
+{
+	degree_collector collector(vi, deg);
+	cln::cl_RA c;
+	if (!is_exactly_a<add>(e))
+		return for_each_var(e, collector, c);
+	for (size_t i = 0; i < e.nops(); ++i)
+		if (!for_each_var(e.op(i), collector, c))
+			return false;
+	return true;
+}
+
+sparse_poly to_polynomial(const ex & e, const packing & pk)
+{
+	sparse_poly p;
+	const size_t n = is_exactly_a<add>(e) ? e.nops() : 1;
+	p.reserve(n);
+	for (size_t i = 0; i < n; ++i) {
+		exponent_packer packer(pk);
+		cln::cl_RA c = 1;
+		for_each_var(is_exactly_a<add>(e) ? e.op(i) : e, packer, c);
+		if (!cln::zerop(c))
+			p.push_back(sparse_term(packer.exponents, c));
+	}
+	std::sort(p.begin(), p.end(), sparse_term_is_greater());
+	return p;
+}
+
+/** Sum of two packed polynomials. */
+sparse_poly sparse_add(const sparse_poly & p, const sparse_poly & q)
+{
+	sparse_poly r;
+	r.reserve(p.size() + q.size());
+	sparse_poly::const_iterator i = p.begin(), j = q.begin();
+	while (i != p.end() && j != q.end()) {
+		if (i->exponents > j->exponents)
+			r.push_back(*i++);
+		else if (i->exponents < j->exponents)
+			r.push_back(*j++);
+		else {
+			const cln::cl_RA c = i->coeff + j->coeff;
+			if (!cln::zerop(c))
+				r.push_back(sparse_term(i->exponents, c));
+			++i;
+			++j;
+		}
+	}
+	r.insert(r.end(), i, p.end());
+	r.insert(r.end(), j, q.end());
+	return r;
+}
+
+/** Product of two packed polynomials.  The terms are generated in
+ *  decreasing order by merging the n = a.size() sorted rows a[i]*b through a
+ *  heap, so equal monomials meet one after the other and the intermediate
+ *  storage is O(n) instead of O(a.size() * b.size()). */
+sparse_poly sparse_multiply(const sparse_poly & a, const sparse_poly & b)
+{
+	if (a.size() > b.size())
+		return sparse_multiply(b, a);
+
+	sparse_poly r;
+	if (a.empty())
+		return r;
+
+	std::vector<heap_entry> heap;
+	heap.reserve(a.size());
+	heap.push_back(heap_entry(a[0].exponents + b[0].exponents, 0, 0));
+	const heap_entry_is_less cmp;
+
+	while (!heap.empty()) {
+		check_budget();
+		const packed_exponents e = heap.front().exponents;
+		cln::cl_RA c = 0;
+		do {
+			std::pop_heap(heap.begin(), heap.end(), cmp);
+			heap_entry & h = heap.back();
+			c = c + a[h.i].coeff * b[h.j].coeff;
+			// The next row enters the heap when the current one starts its
+			// descent, which keeps the heap as small as possible.
+			if (h.j == 0 && h.i + 1 < a.size()) {
+				const size_t i = h.i + 1;
+				if (h.j + 1 < b.size()) {
+					h.exponents = a[h.i].exponents + b[h.j + 1].exponents;
+					++h.j;
+					std::push_heap(heap.begin(), heap.end(), cmp);
+				} else
+					heap.pop_back();
+				heap.push_back(heap_entry(a[i].exponents + b[0].exponents, i, 0));
+				std::push_heap(heap.begin(), heap.end(), cmp);
+			} else if (h.j + 1 < b.size()) {
+				h.exponents = a[h.i].exponents + b[h.j + 1].exponents;
+				++h.j;
+				std::push_heap(heap.begin(), heap.end(), cmp);
+			} else
+				heap.pop_back();
+		} while (!heap.empty() && heap.front().exponents == e);
+		if (!cln::zerop(c))
+			r.push_back(sparse_term(e, c));
+	}
+	return r;
+}
+
+/** Exact division by a heap of the products q[i]*b[j], j > 0, merged with
+ *  the terms of a in decreasing order.  Every term of the difference whose
+ *  monomial is divisible by the leading one of b gives a term of the
+ *  quotient, any other term is a term of the remainder, so the division
+ *  can stop at the first one of them. */
+int sparse_divide(sparse_poly & q, const sparse_poly & a, const sparse_poly & b, const packing & pk)
+{
+	sparse_poly quo;
+	const sparse_term & lt = b[0];
+	std::vector<heap_entry> heap;
+	const heap_entry_is_less cmp;
+	sparse_poly::const_iterator ai = a.begin();
+
+	while (ai != a.end() || !heap.empty()) {
+		check_budget();
+		packed_exponents e;
+		if (heap.empty() || (ai != a.end() && ai->exponents > heap.front().exponents))
+			e = ai->exponents;
+		else
+			e = heap.front().exponents;
+		cln::cl_RA c = 0;
+		if (ai != a.end() && ai->exponents == e) {
+			c = ai->coeff;
+			++ai;
+		}
+		while (!heap.empty() && heap.front().exponents == e) {
+			std::pop_heap(heap.begin(), heap.end(), cmp);
+			heap_entry & h = heap.back();
+			c = c - quo[h.i].coeff * b[h.j].coeff;
+			if (h.j + 1 < b.size()) {
+				++h.j;
+				h.exponents = quo[h.i].exponents + b[h.j].exponents;
+				if (pk.overflow(h.exponents))
+					return -1;
+				std::push_heap(heap.begin(), heap.end(), cmp);
+			} else
+				heap.pop_back();
+		}
+		if (cln::zerop(c))
+			continue;
+		if (!pk.divides(lt.exponents, e))
+			return 0;
+		quo.push_back(sparse_term(e - lt.exponents, c / lt.coeff));
+		if (b.size() > 1) {
+			const packed_exponents next = quo.back().exponents + b[1].exponents;
+			if (pk.overflow(next))
+				return -1;
+			heap.push_back(heap_entry(next, quo.size() - 1, 1));
+			std::push_heap(heap.begin(), heap.end(), cmp);
+		}
+	}
+	q.swap(quo);
+	return 1;
+}
+
+ex from_polynomial(const sparse_poly & p, const packing & pk)
+{
+	std::auto_ptr<epvector> terms(new epvector);
+	terms->reserve(p.size());
+	numeric oc;
+	epvector factors;
+	for (sparse_poly::const_iterator i = p.begin(); i != p.end(); ++i) {
+		if (i->exponents == 0) {
+			oc = numeric(i->coeff);
+			continue;
+		}
+		factors.clear();
+		for (size_t v = 0; v < pk.vars.size(); ++v) {
+			const unsigned e = pk.degree(i->exponents, v);
+			if (e != 0)
+				factors.push_back(expair(pk.vars[v], ex(e)));
+		}
+		const ex m = (factors.size() == 1 && factors[0].coeff.is_equal(_ex1))
+		             ? factors[0].rest
+		             : (new mul(factors))->setflag(status_flags::dynallocated);
+		terms->push_back(expair(m, numeric(i->coeff)));
+	}
+	return (new add(terms, oc))->setflag(status_flags::dynallocated);
+}
+
+namespace {
+
+/** Prime used by sparse_may_divide(), 2^31 - 1. */
+const long check_prime = 0x7fffffffL;
+
+unsigned divisibility_checks = 0;
+unsigned divisibility_rejections = 0;
+
+/** Image of p in Z/p[x] with the other variables substituted by point[].
+ *  @return false if some denominator vanishes modulo the prime */
+bool univariate_image(uwordpoly & u, const sparse_poly & p, const packing & pk,
+                      unsigned x, const std::vector<zp_word> & point)
+{
+	const zp_word_ring & R = *point[0].ring();
+	const zp_word zero(R, 0L);
+	for (sparse_poly::const_iterator i = p.begin(); i != p.end(); ++i) {
+		const zp_word den(R, cln::denominator(i->coeff));
+		if (zerop(den))
+			return false;
+		zp_word c = zp_word(R, cln::numerator(i->coeff)) * recip(den);
+		for (unsigned v = 0; v < pk.vars.size(); ++v) {
+			if (v == x)
+				continue;
+			// c *= point[v]^e by repeated squaring
+			zp_word b = point[v];
+			for (unsigned e = pk.degree(i->exponents, v); e != 0; e >>= 1) {
+				if (e & 1)
+					c = c * b;
+				b = b * b;
+			}
+		}
+		const unsigned d = pk.degree(i->exponents, x);
+		if (u.size() <= d)
+			u.resize(d + 1, zero);
+		u[d] = u[d] + c;
+	}
+	canonicalize(u);
+	return true;
+}
+
+} // anonymous namespace
+
+bool sparse_may_divide(const sparse_poly & a, const sparse_poly & b, const packing & pk, unsigned seed)
+{
+	// Take the variable of highest degree in b, to keep the image of b as
+	// large as possible.
+	unsigned x = 0, deg_b = 0;
+	for (sparse_poly::const_iterator i = b.begin(); i != b.end(); ++i) {
+		for (unsigned v = 0; v < pk.vars.size(); ++v) {
+			if (pk.degree(i->exponents, v) > deg_b) {
+				deg_b = pk.degree(i->exponents, v);
+				x = v;
+			}
+		}
+	}
+	if (deg_b == 0 || a.empty())
+		return true;
+
+	post_increment(divisibility_checks);
+	const zp_word_ring R(check_prime);
+	std::vector<zp_word> point(pk.vars.size());
+	uint64_t s = seed;
+	for (unsigned v = 0; v < point.size(); ++v) {
+		s = s * 6364136223846793005ULL + 1442695040888963407ULL;
+		point[v] = zp_word(R, static_cast<long>(s >> 33));
+	}
+
+	// b = c*b' with an integer c and a primitive b', and b'|a in Q[X]
+	// means b'|a in Z[X] (Gauss), so the images in Z/p[x] of b' and b
+	// divide the one of a, unless c vanishes modulo p (and so the image
+	// of b).
+	uwordpoly ua, ub, r;
+	if (!univariate_image(ua, a, pk, x, point) ||
+	    !univariate_image(ub, b, pk, x, point) || ub.empty() || ua.empty())
+		return true;
+	if (ua.size() >= ub.size() && remainder_in_field(r, ua, ub))
+		return true;
+	post_increment(divisibility_rejections);
+	return false;
+}
+
+bool sparse_squarefree(const sparse_poly & a, const packing & pk, unsigned x, unsigned seed)
+{
+	unsigned deg = 0;
+	for (sparse_poly::const_iterator i = a.begin(); i != a.end(); ++i)
+		deg = std::max(deg, pk.degree(i->exponents, x));
+	if (deg == 0)
+		return false;
+
+	const zp_word_ring R(check_prime);
+	std::vector<zp_word> point(pk.vars.size());
+	uint64_t s = seed;
+	for (unsigned v = 0; v < point.size(); ++v) {
+		s = s * 6364136223846793005ULL + 1442695040888963407ULL;
+		point[v] = zp_word(R, static_cast<long>(s >> 33));
+	}
+
+	// If the image keeps its degree in x, the image of the GCD of a and
+	// its derivative (in the rational functions of the other variables)
+	// keeps its degree, too, and divides the GCD of the images.  So the
+	// images being coprime proves that the GCD doesn't depend on x.
+	uwordpoly u;
+	if (!univariate_image(u, a, pk, x, point) || degree(u) != deg)
+		return false;
+	uwordpoly du(deg);
+	for (unsigned d = 1; d <= deg; ++d)
+		du[d - 1] = zp_word(R, static_cast<long>(d)) * u[d];
+	canonicalize(du);
+	if (du.empty())
+		return false;
+	uwordpoly g;
+	gcd_euclid(g, u, du);
+	return degree(g) == 0;
+}
+
+bool squarefree_in(const ex & a, const ex & x)
+{
+	var_index_map var_index;
+	std::vector<unsigned> deg;
+	if (!collect_degrees(a, var_index, deg))
+		return false;
+	var_index_map::const_iterator xi = var_index.find(x);
+	if (xi == var_index.end())
+		return false;
+	packing pk;
+	if (!pk.init(var_index, deg))
+		return false;
+	return sparse_squarefree(to_polynomial(a, pk), pk, xi->second, a.gethash());
+}
+
+bool may_divide(const ex & a, const ex & b)
+{
+	var_index_map var_index;
+	std::vector<unsigned> deg;
+	if (!collect_degrees(a, var_index, deg) || !collect_degrees(b, var_index, deg))
+		return true;
+	packing pk;
+	if (!pk.init(var_index, deg))
+		return true;
+	return sparse_may_divide(to_polynomial(a, pk), to_polynomial(b, pk), pk,
+	                         a.gethash() ^ rotate_left(b.gethash()));
+}
+
+divisibility_check_statistics get_divisibility_check_statistics()
+{
+	divisibility_check_statistics stats;
+	stats.checks = divisibility_checks;
+	stats.rejected = divisibility_rejections;
+	return stats;
+}
+
+void reset_divisibility_check_statistics()
+{
+	divisibility_checks = divisibility_rejections = 0;
+}
+
+int sparse_poly_divide(ex & q, const ex & a, const ex & b)
+{
+	var_index_map var_index;
+	std::vector<unsigned> deg_a, deg_b;
+	if (!collect_degrees(a, var_index, deg_a))
+		return -1;
+	deg_b.resize(deg_a.size(), 0);
+	if (!collect_degrees(b, var_index, deg_b))
+		return -1;
+	// A variable which doesn't occur in a (deg_a is shorter then), or a
+	// higher degree in b, means that b can't divide a.
+	if (deg_b.size() > deg_a.size())
+		return 0;
+	for (size_t i = 0; i < deg_b.size(); ++i)
+		if (deg_b[i] > deg_a[i])
+			return 0;
+
+	packing pk;
+	if (!pk.init(var_index, deg_a))
+		return -1;
+	const sparse_poly pa = to_polynomial(a, pk), pb = to_polynomial(b, pk);
+	if (!sparse_may_divide(pa, pb, pk, a.gethash() ^ rotate_left(b.gethash())))
+		return 0;
+	sparse_poly quo;
+	int divisible = kronecker_divide(quo, pa, pb, pk);
+	if (divisible == -1)
+		divisible = sparse_divide(quo, pa, pb, pk);
+	if (divisible == 1)
+		q = from_polynomial(quo, pk);
+	return divisible;
+}
+
+} // namespace GiNaC
@@ -0,0 +1,151 @@
+/** @file sparse_poly.h
+ *
+ *  Sparse distributed polynomials with packed exponent vectors, the
+ *  common representation of polynomial products and exact divisions. */
+
+/*
+ *  GiNaC Copyright (C) 1999-2014 Johannes Gutenberg University Mainz, Germany
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#ifndef GINAC_POLYNOMIAL_SPARSE_POLY_H
+#define GINAC_POLYNOMIAL_SPARSE_POLY_H
+
+#include "ex.h"
+
+#include <cln/rational.h>
+#include <map>
+#include <stdint.h> // for uint64_t
+#include <vector>
+
+namespace GiNaC {
+
+/** All exponents of a monomial packed into one machine word, each variable
+ *  taking a fixed bit field.  The top bit of every field is a guard bit
+ *  which is never set in a valid exponent word, so monomials are multiplied
+ *  by adding the words, overflows can be detected, and the word order is
+ *  the lexicographic monomial order. */
+typedef uint64_t packed_exponents;
+
+struct sparse_term {
+	sparse_term(packed_exponents e, const cln::cl_RA & c) : exponents(e), coeff(c) { }
+	packed_exponents exponents;
+	cln::cl_RA coeff;
+};
+
+struct sparse_term_is_greater {
+	bool operator()(const sparse_term & t1, const sparse_term & t2) const
+	{
+		return t1.exponents > t2.exponents;
+	}
+};
+
+/** Polynomial with rational coefficients as a list of terms sorted by
+ *  decreasing exponents.  The zero polynomial has no terms. */
+typedef std::vector<sparse_term> sparse_poly;
+
+typedef std::map<ex, unsigned, ex_is_less> var_index_map;
+
+/** Layout of the packed exponent words, shared by all polynomials which
+ *  take part in one computation. */
+struct packing {
+	var_index_map var_index;
+	exvector vars;
+	std::vector<unsigned> shift;
+	packed_exponents mask;   ///< of one bit field, without the guard bit
+	packed_exponents guards; ///< all guard bits
+
+	/** Set up the bit fields such that variable i may have exponents up
+	 *  to max_deg[i].  Returns false if they don't fit into a word. */
+	bool init(const var_index_map & vi, const std::vector<unsigned> & max_deg);
+
+	/** The exponent of variable v in e. */
+	unsigned degree(packed_exponents e, unsigned v) const
+	{
+		return unsigned((e >> shift[v]) & mask);
+	}
+
+	/** Check if the result of adding exponent words overflowed. */
+	bool overflow(packed_exponents e) const
+	{
+		return (e & guards) != 0;
+	}
+
+	/** Check if the monomial d divides the monomial e. */
+	bool divides(packed_exponents d, packed_exponents e) const
+	{
+		return (((e | guards) - d) & guards) == guards;
+	}
+};
+
+/** Find the variables of the polynomial e and the highest exponent of each
+ *  of them.  New variables are added to vi, deg is extended accordingly.
+ *  Returns false if e is not an expanded polynomial in symbols with
+ *  rational coefficients. */
+extern bool collect_degrees(const ex & e, var_index_map & vi, std::vector<unsigned> & deg);
+
+/** Convert the expanded polynomial e to packed form.  All variables of e
+ *  must be known to pk. */
+extern sparse_poly to_polynomial(const ex & e, const packing & pk);
+
+/** Convert a packed polynomial back to an (expanded) expression. */
+extern ex from_polynomial(const sparse_poly & p, const packing & pk);
+
+/** Sum of two packed polynomials. */
+extern sparse_poly sparse_add(const sparse_poly & a, const sparse_poly & b);
+
+/** Product of two packed polynomials.  The bit fields must be wide enough
+ *  for the degrees of the product. */
+extern sparse_poly sparse_multiply(const sparse_poly & a, const sparse_poly & b);
+
+/** Exact division of packed polynomials.
+ *  @param q  quotient, if b divides a
+ *  @return 1 if b divides a, 0 if not, -1 if this could not be decided
+ *          because the exponents overflowed the bit fields */
+extern int sparse_divide(sparse_poly & q, const sparse_poly & a, const sparse_poly & b, const packing & pk);
+
+/** Necessary condition for b dividing a: the images of a and b in Z/p[x]
+ *  for a word prime p, x the variable of highest degree in b and the other
+ *  variables replaced by (pseudo-random) numbers determined by seed.  This
+ *  costs about as much as reading the polynomials.
+ *  @return false if b certainly doesn't divide a, true if it may */
+extern bool sparse_may_divide(const sparse_poly & a, const sparse_poly & b, const packing & pk, unsigned seed);
+
+/** The same test for expanded polynomials a and b, true if they are not
+ *  polynomials in symbols with rational coefficients. */
+extern bool may_divide(const ex & a, const ex & b);
+
+/** Sufficient condition for a being square free as a polynomial in the
+ *  variable x with coefficients in the other variables: the image of a in
+ *  Z/p[x] for a word prime p and the other variables replaced by
+ *  (pseudo-random) numbers determined by seed keeps its degree and is coprime
+ *  to its derivative.
+ *  @return true if a is certainly square free in x, false if it may not be */
+extern bool sparse_squarefree(const sparse_poly & a, const packing & pk, unsigned x, unsigned seed);
+
+/** The same test for an expanded polynomial a and a symbol x, false if a is
+ *  not a polynomial in symbols with rational coefficients. */
+extern bool squarefree_in(const ex & a, const ex & x);
+
+/** Exact division of expanded polynomials a and b (not zero) by converting
+ *  them to packed form once.
+ *  @return 1 if b divides a (q is set to the quotient), 0 if not, -1 if
+ *          a or b can't be handled this way */
+extern int sparse_poly_divide(ex & q, const ex & a, const ex & b);
+
+} // namespace GiNaC
+
+#endif // ndef GINAC_POLYNOMIAL_SPARSE_POLY_H
@@ -0,0 +1,246 @@
+/** @file subproduct_tree.h
+ *
+ *  Evaluation of dense univariate polynomials at many points and
+ *  interpolation through many points. */
+
+/*
+ *  GiNaC Copyright (C) 1999-2014 Johannes Gutenberg University Mainz, Germany
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#ifndef GINAC_POLYNOMIAL_SUBPRODUCT_TREE_H
+#define GINAC_POLYNOMIAL_SUBPRODUCT_TREE_H
+
+#include "karatsuba.h"
+
+#include <algorithm>
+#include <cstddef>
+#include <vector>
+
+namespace GiNaC {
+
+/** Below this many points, evaluating at each point by Horner's scheme and
+ *  Newton interpolation are faster than going through a subproduct tree. */
+static const std::size_t subproduct_tree_threshold = 64;
+
+/**
+ * The products of the linear factors x - u_i for a set of points u_0 ...
+ * u_(n-1) in a field, arranged as a binary tree: the leaves are the linear
+ * factors, every other node is the product of its two children, the root is
+ * the product of all of them.  With the tree, a polynomial is evaluated at
+ * all points, or the polynomial through given values at the points is
+ * computed, with O(log n) multiplications of the size of the polynomial
+ * (by mul_add()) instead of the O(n^2) operations point by point.
+ *
+ * The coefficients are of a field type like zp_word or cln::cl_MI, and the
+ * polynomials are dense vectors of them, lowest degree first.  The tree is
+ * built once and may be used for any number of polynomials.
+ */
+template<typename E>
+class subproduct_tree {
+public:
+	typedef std::vector<E> poly;
+
+	/** Build the tree.  The points must be distinct for interpolate(). */
+	subproduct_tree(const std::vector<E> & points, const E & zero_)
+	 : zero(zero_), one(the_one(zero_)), npoints(points.size())
+	{
+		levels.push_back(std::vector<poly>());
+		for (std::size_t i = 0; i < npoints; ++i) {
+			poly factor(2, one);
+			factor[0] = -points[i];
+			levels.back().push_back(factor);
+		}
+		while (levels.back().size() > 1) {
+			const std::vector<poly> & below = levels.back();
+			std::vector<poly> above;
+			for (std::size_t j = 0; j + 1 < below.size(); j += 2)
+				above.push_back(product(below[j], below[j + 1]));
+			if (below.size() % 2)
+				above.push_back(below.back());
+			levels.push_back(above);
+		}
+	}
+
+	std::size_t size() const { return npoints; }
+
+	/** Product of all x - u_i. */
+	const poly & root() const { return levels.back()[0]; }
+
+	/** Replace values by f(u_0) ... f(u_(n-1)). */
+	void evaluate(const poly & f, std::vector<E> & values) const
+	{
+		values.assign(npoints, zero);
+		if (npoints == 0)
+			return;
+		poly r;
+		remainder(f, root(), r);
+		evaluate_node(levels.size() - 1, 0, r, values);
+	}
+
+	/** Replace f by the polynomial of degree < n with f(u_i) = values[i]. */
+	void interpolate(const std::vector<E> & values, poly & f) const
+	{
+		if (weights.size() != npoints) {
+			// 1/M'(u_i), where M is the product of all x - u_i
+			const poly & m = root();
+			poly dm(m.size() - 1, zero);
+			E k = zero;
+			for (std::size_t i = 1; i < m.size(); ++i) {
+				k = k + one;
+				dm[i - 1] = k*m[i];
+			}
+			evaluate(dm, weights);
+			for (std::size_t i = 0; i < npoints; ++i)
+				weights[i] = recip(weights[i]);
+		}
+		// Going up the tree, the polynomial of a node is the sum of
+		// w_i v_i M/(x - u_i) over the points below it, with M the
+		// product of their factors
+		std::vector<poly> sums(npoints);
+		for (std::size_t i = 0; i < npoints; ++i)
+			sums[i].assign(1, weights[i]*values[i]);
+		for (std::size_t k = 0; k + 1 < levels.size(); ++k) {
+			const std::vector<poly> & below = levels[k];
+			std::vector<poly> above;
+			for (std::size_t j = 0; j + 1 < below.size(); j += 2) {
+				poly s = product(sums[j], below[j + 1]);
+				const poly t = product(sums[j + 1], below[j]);
+				s.resize(std::max(s.size(), t.size()), zero);
+				for (std::size_t i = 0; i < t.size(); ++i)
+					s[i] = s[i] + t[i];
+				above.push_back(s);
+			}
+			if (below.size() % 2)
+				above.push_back(sums.back());
+			sums.swap(above);
+		}
+		f = npoints ? sums[0] : poly();
+		f.resize(npoints, zero);
+	}
+
+private:
+	poly product(const poly & a, const poly & b) const
+	{
+		poly c(a.size() + b.size() - 1, zero);
+		mul_add(&a[0], a.size(), &b[0], b.size(), &c[0], zero);
+		return c;
+	}
+
+	/** r = a mod m, for a monic m. */
+	void remainder(const poly & a, const poly & m, poly & r) const
+	{
+		const std::size_t d = m.size() - 1;
+		if (a.size() <= d) {
+			r = a;
+			return;
+		}
+		const std::size_t k = a.size() - d;  // number of coefficients of the quotient
+		if (d < subproduct_tree_threshold || k < subproduct_tree_threshold) {
+			// Schoolbook division
+			r = a;
+			for (std::size_t i = a.size(); i-- > d; ) {
+				const E q = r[i];
+				if (zerop(q))
+					continue;
+				for (std::size_t j = 0; j < d; ++j)
+					r[i - d + j] = r[i - d + j] - q*m[j];
+			}
+			r.resize(d, zero);
+			return;
+		}
+
+		// The reversed quotient is rev(a)/rev(m) modulo x^k
+		const poly revm(m.rbegin(), m.rend());
+		poly inv;
+		series_inverse(revm, k, inv);
+		const poly reva(a.rbegin(), a.rbegin() + k);
+		poly revq = product(reva, inv);
+		poly q(revq.rend() - k, revq.rend());
+		// Only the coefficients below x^d of a - q*m survive
+		const poly qm = product(q, m);
+		r.assign(a.begin(), a.begin() + d);
+		for (std::size_t i = 0; i < d; ++i)
+			r[i] = r[i] - qm[i];
+	}
+
+	/** g = 1/f modulo x^l by Newton iteration, g <- g - g*(f*g - 1), for f
+	 *  with f[0] = 1. */
+	void series_inverse(const poly & f, std::size_t l, poly & g) const
+	{
+		g.assign(1, one);
+		for (std::size_t done = 1; done < l; ) {
+			const std::size_t next = std::min(2*done, l);
+			const poly fl(f.begin(), f.begin() + std::min(f.size(), next));
+			poly e = product(fl, g);
+			// The lower coefficients of f*g - 1 vanish already
+			e.resize(next, zero);
+			const poly eh(e.begin() + done, e.end());
+			const poly ge = product(g, eh);
+			g.resize(next, zero);
+			for (std::size_t i = done; i < next; ++i)
+				g[i] = g[i] - ge[i - done];
+			done = next;
+		}
+	}
+
+	/** Evaluate r, already reduced modulo the node, at the points below it. */
+	void evaluate_node(std::size_t k, std::size_t j, const poly & r, std::vector<E> & values) const
+	{
+		if (k == 0) {
+			values[j] = r.empty() ? zero : r[0];
+			return;
+		}
+		const std::vector<poly> & below = levels[k - 1];
+		if (2*j + 1 == below.size()) {
+			// Carried up unchanged
+			evaluate_node(k - 1, 2*j, r, values);
+			return;
+		}
+		if (below[2*j].size() + below[2*j + 1].size() < 2*subproduct_tree_threshold) {
+			// Horner's scheme at the points below
+			const std::size_t first = j << k;
+			const std::size_t last = std::min(npoints, (j + 1) << k);
+			for (std::size_t i = first; i < last; ++i) {
+				const E u = -levels[0][i][0];
+				E s = zero;
+				for (std::size_t c = r.size(); c-- > 0; )
+					s = s*u + r[c];
+				values[i] = s;
+			}
+			return;
+		}
+		poly rr;
+		remainder(r, below[2*j], rr);
+		evaluate_node(k - 1, 2*j, rr, values);
+		remainder(r, below[2*j + 1], rr);
+		evaluate_node(k - 1, 2*j + 1, rr, values);
+	}
+
+	const E zero;
+	const E one;
+	const std::size_t npoints;
+	/** levels[0] holds the linear factors, levels[k][j] is the product of
+	 *  levels[k-1][2j] and levels[k-1][2j+1], or the last node of level k-1
+	 *  carried up if it has no partner. */
+	std::vector<std::vector<poly> > levels;
+	/** 1/M'(u_i), computed by the first interpolate(). */
+	mutable std::vector<E> weights;
+};
+
+} // namespace GiNaC
+
+#endif // ndef GINAC_POLYNOMIAL_SUBPRODUCT_TREE_H
@@ -24,6 +24,7 @@
 #define GINAC_UPOLY_H
 
 #include "ring_traits.h"
+#include "zp_word.h"
 #include "debug.h"
 #include "compiler.h"
 
@@ -40,6 +41,8 @@ namespace GiNaC {
 
 typedef std::vector<cln::cl_I> upoly;
 typedef std::vector<cln::cl_MI> umodpoly;
+/// Same as umodpoly for small primes, see zp_word_ring::fits()
+typedef std::vector<zp_word> uwordpoly;
 
 template<typename T> static std::size_t degree(const T& p)
 {
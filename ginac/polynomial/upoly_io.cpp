@@ -70,6 +70,7 @@ void dbgprint(const type& p)                              \
 
 DEFINE_OPERATOR_OUT(upoly);
 DEFINE_OPERATOR_OUT(umodpoly);
+DEFINE_OPERATOR_OUT(uwordpoly);
 #undef DEFINE_OPERATOR_OUT
 
 } // namespace GiNaC
@@ -31,6 +31,7 @@ namespace GiNaC {
 
 extern std::ostream& operator<<(std::ostream&, const upoly& );
 extern std::ostream& operator<<(std::ostream&, const umodpoly& );
+extern std::ostream& operator<<(std::ostream&, const uwordpoly& );
 
 } // namespace GiNaC
 
@@ -0,0 +1,187 @@
+/** @file zp_word.h
+ *
+ *  Arithmetic in Z/p for primes p which fit into a machine word. */
+
+/*
+ *  GiNaC Copyright (C) 1999-2014 Johannes Gutenberg University Mainz, Germany
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#ifndef GINAC_ZP_WORD_H
+#define GINAC_ZP_WORD_H
+
+#include <cln/integer.h>
+#include <ostream>
+#include <stdexcept>
+#include <stdint.h> // for uint32_t, uint64_t
+
+namespace GiNaC {
+
+/**
+ * Z/p for an odd prime p < 2^31. The elements are kept in Montgomery
+ * representation x*2^32 mod p, so products are reduced by shifts and
+ * multiplications only (no division). This is (much) cheaper than going
+ * through the generic cln::cl_modint_ring.
+ */
+class zp_word_ring
+{
+public:
+	const uint32_t modulus;
+private:
+	uint32_t neg_inverse;	///< -1/p mod 2^32
+	uint32_t r2;		///< 2^64 mod p
+public:
+	/// Check if p can be used as a modulus of this ring.
+	static bool fits(long p)
+	{
+		return p > 2 && p <= 0x7fffffffL && (p & 1);
+	}
+
+	explicit zp_word_ring(long p) : modulus(static_cast<uint32_t>(p))
+	{
+		// Newton iteration for 1/p mod 2^32, each step doubles the
+		// number of correct bits (p*p = 1 mod 8, so we start with 3)
+		uint32_t inv = modulus;
+		for (int i = 0; i < 4; ++i)
+			inv *= 2 - modulus*inv;
+		neg_inverse = -inv;
+		const uint64_t r = (uint64_t(1) << 32) % modulus;
+		r2 = static_cast<uint32_t>((r*r) % modulus);
+	}
+
+	/// Montgomery reduction: t*2^(-32) mod p, for t < p^2
+	uint32_t reduce(uint64_t t) const
+	{
+		const uint32_t m = static_cast<uint32_t>(t)*neg_inverse;
+		const uint32_t u = static_cast<uint32_t>((t + uint64_t(m)*modulus) >> 32);
+		return u >= modulus ? u - modulus : u;
+	}
+
+	uint32_t to_repr(uint32_t x) const
+	{
+		return reduce(uint64_t(x)*r2);
+	}
+
+	uint32_t from_repr(uint32_t x) const
+	{
+		return reduce(x);
+	}
+};
+
+/// Element of zp_word_ring, the counterpart of cln::cl_MI.
+class zp_word
+{
+	uint32_t v;
+	const zp_word_ring * R;
+	zp_word(uint32_t v_, const zp_word_ring * R_) : v(v_), R(R_) { }
+public:
+	zp_word() : v(0), R(0) { }
+
+	/// Map an integer onto Z/p
+	zp_word(const zp_word_ring & R_, long x) : R(&R_)
+	{
+		long r = x % static_cast<long>(R_.modulus);
+		if (r < 0)
+			r += R_.modulus;
+		v = R_.to_repr(static_cast<uint32_t>(r));
+	}
+
+	/// Map an integer onto Z/p
+	zp_word(const zp_word_ring & R_, const cln::cl_I & x) : R(&R_)
+	{
+		v = R_.to_repr(static_cast<uint32_t>(cln::cl_I_to_ulong(cln::mod(x, R_.modulus))));
+	}
+
+	const zp_word_ring * ring() const { return R; }
+
+	/// The representative in [0, p)
+	uint32_t retract() const { return R->from_repr(v); }
+
+	friend zp_word operator+(const zp_word & a, const zp_word & b)
+	{
+		const uint32_t s = a.v + b.v;
+		return zp_word(s >= a.R->modulus ? s - a.R->modulus : s, a.R);
+	}
+
+	friend zp_word operator-(const zp_word & a, const zp_word & b)
+	{
+		return zp_word(a.v >= b.v ? a.v - b.v : a.v + (a.R->modulus - b.v), a.R);
+	}
+
+	friend zp_word operator-(const zp_word & a)
+	{
+		return zp_word(a.v ? a.R->modulus - a.v : 0, a.R);
+	}
+
+	friend zp_word operator*(const zp_word & a, const zp_word & b)
+	{
+		return zp_word(a.R->reduce(uint64_t(a.v)*b.v), a.R);
+	}
+
+	friend bool operator==(const zp_word & a, const zp_word & b)
+	{
+		return a.v == b.v;
+	}
+
+	friend bool operator!=(const zp_word & a, const zp_word & b)
+	{
+		return a.v != b.v;
+	}
+
+	friend bool zerop(const zp_word & a)
+	{
+		return a.v == 0;
+	}
+
+	friend zp_word recip(const zp_word & a)
+	{
+		// Extended Euclid on the plain representative
+		long r0 = a.R->modulus, r1 = a.retract();
+		long s0 = 0, s1 = 1;
+		if (r1 == 0)
+			throw std::overflow_error("zp_word: division by zero");
+		while (r1 != 0) {
+			const long q = r0/r1;
+			long t = r0 - q*r1; r0 = r1; r1 = t;
+			t = s0 - q*s1; s0 = s1; s1 = t;
+		}
+		return zp_word(*a.R, s0);
+	}
+
+	friend zp_word div(const zp_word & a, const zp_word & b)
+	{
+		return a*recip(b);
+	}
+
+	friend zp_word get_ring_elt(const zp_word & sample, const int val)
+	{
+		return zp_word(*sample.R, static_cast<long>(val));
+	}
+
+	friend zp_word the_one(const zp_word & sample)
+	{
+		return get_ring_elt(sample, 1);
+	}
+
+	friend std::ostream & operator<<(std::ostream & os, const zp_word & a)
+	{
+		return os << a.retract() << " mod " << a.R->modulus;
+	}
+};
+
+} // namespace GiNaC
+
+#endif // ndef GINAC_ZP_WORD_H
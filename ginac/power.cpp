@@ -36,6 +36,9 @@
 #include "archive.h"
 #include "utils.h"
 #include "relational.h"
+#include "subs_index.h"
+#include "budget.h"
+#include "truncation.h"
 #include "compiler.h"
 
 #include <iostream>
@@ -303,6 +306,8 @@ bool power::is_polynomial(const ex & var) const
 
 int power::degree(const ex & s) const
 {
+	if (lacks_symbol(ex_to<basic>(s)))
+		return 0;
 	if (is_equal(ex_to<basic>(s)))
 		return 1;
 	else if (is_exactly_a<numeric>(exponent) && ex_to<numeric>(exponent).is_integer()) {
@@ -318,6 +323,8 @@ int power::degree(const ex & s) const
 
 int power::ldegree(const ex & s) const 
 {
+	if (lacks_symbol(ex_to<basic>(s)))
+		return 0;
 	if (is_equal(ex_to<basic>(s)))
 		return 1;
 	else if (is_exactly_a<numeric>(exponent) && ex_to<numeric>(exponent).is_integer()) {
@@ -333,6 +340,8 @@ int power::ldegree(const ex & s) const
 
 ex power::coeff(const ex & s, int n) const
 {
+	if (lacks_symbol(ex_to<basic>(s)))
+		return n==0 ? ex(*this) : _ex0;
 	if (is_equal(ex_to<basic>(s)))
 		return n==1 ? _ex1 : _ex0;
 	else if (!basis.is_equal(s)) {
@@ -605,6 +614,46 @@ ex power::evalf(int level) const
 	return power(ebasis,eexponent);
 }
 
+std::complex<double> power::evalf_double(const evalf_double_map & values) const
+{
+	return evalf_double_power(basis.evalf_double(values), exponent, values);
+}
+
+/** The power b^e in double precision, on the principal branch like
+ *  evalf(). */
+std::complex<double> power::evalf_double_power(const std::complex<double> & b_in, const ex & e,
+                                               const evalf_double_map & values)
+{
+	// Zero has no sign in GiNaC, so -0.0 must not select another branch
+	const std::complex<double> b = b_in.imag() == 0 ? std::complex<double>(b_in.real()) : b_in;
+	if (is_exactly_a<numeric>(e)) {
+		const numeric & n = ex_to<numeric>(e);
+		if (n.is_integer() && n.int_length() < 31) {
+			long k = n.to_long();
+			unsigned long m = k < 0 ? -k : k;
+			std::complex<double> x = b, y = 1;
+			while (m) {
+				if (m & 1)
+					y *= x;
+				m >>= 1;
+				if (m)
+					x *= x;
+			}
+			return k < 0 ? 1.0 / y : y;
+		}
+		if (n.is_equal(*_num1_2_p))
+			return std::sqrt(b);
+		if (n.is_equal(*_num_1_2_p))
+			return 1.0 / std::sqrt(b);
+	}
+	const std::complex<double> x = e.evalf_double(values);
+	if (b.imag() == 0 && b.real() >= 0 && x.imag() == 0)
+		return std::pow(b.real(), x.real());
+	if (b == 0.0 && x.real() > 0)
+		return 0.0;
+	return std::pow(b, x);
+}
+
 ex power::evalm() const
 {
 	const ex ebasis = basis.evalm();
@@ -656,7 +705,16 @@ ex power::subs(const exmap & m, unsigned options) const
 	if (!(options & subs_options::algebraic))
 		return subs_one_level(m, options);
 
-	for (exmap::const_iterator it = m.begin(); it != m.end(); ++it) {
+	// The keys to try, only the ones which could match if m is indexed
+	subs_index::key_vector keys;
+	if (const subs_index * index = subs_index::find(m))
+		index->factor_candidates(*this, keys);
+	else
+		for (exmap::const_iterator it = m.begin(); it != m.end(); ++it)
+			keys.push_back(it);
+
+	for (subs_index::key_vector::const_iterator k = keys.begin(); k != keys.end(); ++k) {
+		const exmap::const_iterator it = *k;
 		int nummatches = std::numeric_limits<int>::max();
 		exmap repls;
 		if (tryfactsubs(*this, it->first, nummatches, repls)) {
@@ -754,6 +812,8 @@ ex power::imag_part() const
  *  @see ex::diff */
 ex power::derivative(const symbol & s) const
 {
+	if (lacks_symbol(s))
+		return _ex0;
 	if (is_a<numeric>(exponent)) {
 		// D(b^r) = r * b^(r-1) * D(b) (faster than the formula below)
 		epvector newseq;
@@ -799,8 +859,13 @@ ex power::expand(unsigned options) const
 		return *this;
 	}
 
-	const ex expanded_basis = basis.expand(options);
-	const ex expanded_exponent = exponent.expand(options);
+	// Under expand_truncated(), the terms of the exponent and those of a
+	// basis raised to anything else than a positive integer are not terms
+	// of the result
+	const ex expanded_basis = (current_truncation && !exponent.info(info_flags::posint)) ?
+	                          expand_untruncated(basis, options) : basis.expand(options);
+	const ex expanded_exponent = current_truncation ?
+	                             expand_untruncated(exponent, options) : exponent.expand(options);
 	
 	// x^(a+b) -> x^a * x^b
 	if (is_exactly_a<add>(expanded_exponent)) {
@@ -868,6 +933,23 @@ ex power::expand(unsigned options) const
 // non-virtual functions in this class
 //////////
 
+/** Check whether e is a product of integer powers of symbols, so that
+ *  products of such expressions never need to be expanded. */
+static bool is_monomial_in_symbols(const ex & e)
+{
+	if (is_exactly_a<symbol>(e))
+		return true;
+	if (is_exactly_a<power>(e))
+		return is_exactly_a<symbol>(e.op(0)) && e.op(1).info(info_flags::integer);
+	if (is_exactly_a<mul>(e)) {
+		for (size_t i = 0; i < e.nops(); ++i)
+			if (!is_exactly_a<mul>(e.op(i)) && !is_monomial_in_symbols(e.op(i)))
+				return false;
+		return true;
+	}
+	return false;
+}
+
 /** expand a^n where a is an add and n is a positive integer.
  *  @see power::expand */
 ex power::expand_add(const add & a, int n, unsigned options) const
@@ -875,6 +957,12 @@ ex power::expand_add(const add & a, int n, unsigned options) const
 	if (n==2)
 		return expand_add_2(a, options);
 
+	bool monomials = (a.seq.size() + (a.overall_coeff.is_zero() ? 0 : 1) >= 2);
+	for (epvector::const_iterator i = a.seq.begin(); i != a.seq.end() && monomials; ++i)
+		monomials = is_monomial_in_symbols(i->rest);
+	if (monomials)
+		return expand_add_monomials(a, n);
+
 	const size_t m = a.nops();
 	exvector result;
 	// The number of terms will be the number of combinatorial compositions,
@@ -892,11 +980,40 @@ ex power::expand_add(const add & a, int n, unsigned options) const
 		upper_limit[l] = n;
 	}
 
+	// Under expand_truncated(), the terms of too high degree are left out
+	const degree_truncation * trunc = current_truncation;
+	intvector degrees;
+	if (trunc)
+		for (size_t l=0; l<m; ++l)
+			degrees.push_back(trunc->degree(a.op(l)));
+
 	while (true) {
-		exvector term;
-		term.reserve(m+1);
-		for (std::size_t l = 0; l < m - 1; ++l) {
-			const ex & b = a.op(l);
+		check_budget();
+		int term_degree = 0;
+		if (trunc) {
+			for (size_t l=0; l<m-1; ++l)
+				term_degree += k[l]*degrees[l];
+			term_degree += (n-k_cum[m-2])*degrees[m-1];
+		}
+		if (!trunc || term_degree <= trunc->max_degree) {
+			exvector term;
+			term.reserve(m+1);
+			for (std::size_t l = 0; l < m - 1; ++l) {
+				const ex & b = a.op(l);
+				GINAC_ASSERT(!is_exactly_a<add>(b));
+				GINAC_ASSERT(!is_exactly_a<power>(b) ||
+				             !is_exactly_a<numeric>(ex_to<power>(b).exponent) ||
+				             !ex_to<numeric>(ex_to<power>(b).exponent).is_pos_integer() ||
+				             !is_exactly_a<add>(ex_to<power>(b).basis) ||
+				             !is_exactly_a<mul>(ex_to<power>(b).basis) ||
+				             !is_exactly_a<power>(ex_to<power>(b).basis));
+				if (is_exactly_a<mul>(b))
+					term.push_back(expand_mul(ex_to<mul>(b), numeric(k[l]), options, true));
+				else
+					term.push_back(power(b,k[l]));
+			}
+
+			const ex & b = a.op(m - 1);
 			GINAC_ASSERT(!is_exactly_a<add>(b));
 			GINAC_ASSERT(!is_exactly_a<power>(b) ||
 			             !is_exactly_a<numeric>(ex_to<power>(b).exponent) ||
@@ -905,31 +1022,18 @@ ex power::expand_add(const add & a, int n, unsigned options) const
 			             !is_exactly_a<mul>(ex_to<power>(b).basis) ||
 			             !is_exactly_a<power>(ex_to<power>(b).basis));
 			if (is_exactly_a<mul>(b))
-				term.push_back(expand_mul(ex_to<mul>(b), numeric(k[l]), options, true));
+				term.push_back(expand_mul(ex_to<mul>(b), numeric(n-k_cum[m-2]), options, true));
 			else
-				term.push_back(power(b,k[l]));
-		}
+				term.push_back(power(b,n-k_cum[m-2]));
 
-		const ex & b = a.op(m - 1);
-		GINAC_ASSERT(!is_exactly_a<add>(b));
-		GINAC_ASSERT(!is_exactly_a<power>(b) ||
-		             !is_exactly_a<numeric>(ex_to<power>(b).exponent) ||
-		             !ex_to<numeric>(ex_to<power>(b).exponent).is_pos_integer() ||
-		             !is_exactly_a<add>(ex_to<power>(b).basis) ||
-		             !is_exactly_a<mul>(ex_to<power>(b).basis) ||
-		             !is_exactly_a<power>(ex_to<power>(b).basis));
-		if (is_exactly_a<mul>(b))
-			term.push_back(expand_mul(ex_to<mul>(b), numeric(n-k_cum[m-2]), options, true));
-		else
-			term.push_back(power(b,n-k_cum[m-2]));
-
-		numeric f = binomial(numeric(n),numeric(k[0]));
-		for (std::size_t l = 1; l < m - 1; ++l)
-			f *= binomial(numeric(n-k_cum[l-1]),numeric(k[l]));
+			numeric f = binomial(numeric(n),numeric(k[0]));
+			for (std::size_t l = 1; l < m - 1; ++l)
+				f *= binomial(numeric(n-k_cum[l-1]),numeric(k[l]));
 
-		term.push_back(f);
+			term.push_back(f);
 
-		result.push_back(ex((new mul(term))->setflag(status_flags::dynallocated)).expand(options));
+			result.push_back(ex((new mul(term))->setflag(status_flags::dynallocated)).expand(options));
+		}
 
 		// increment k[]
 		bool done = false;
@@ -961,20 +1065,124 @@ ex power::expand_add(const add & a, int n, unsigned options) const
 }
 
 
+/** Special case of power::expand_add.  Expands a^n where all terms of a are
+ *  monomials in symbols, so products of them are monomials again and never
+ *  need to be expanded.  The compositions of n are enumerated such that the
+ *  multinomial coefficients, the powers of the coefficients and the
+ *  products of the monomials can all be updated incrementally, and the
+ *  terms are collected in one epvector which is canonicalized once.
+ *  @see power::expand_add */
+ex power::expand_add_monomials(const add & a, int n) const
+{
+	// The terms of a as monomials and coefficients, the overall coefficient
+	// counting as a term with monomial 1.  Precompute all their powers.
+	const size_t m = a.seq.size() + (a.overall_coeff.is_zero() ? 0 : 1);
+	std::vector<exvector> mono_pow(m);
+	std::vector<std::vector<numeric> > coeff_pow(m);
+	for (size_t l = 0; l < m; ++l) {
+		const bool last = (l == a.seq.size());
+		const ex & rest = last ? _ex1 : a.seq[l].rest;
+		const numeric & c = ex_to<numeric>(last ? a.overall_coeff : a.seq[l].coeff);
+		mono_pow[l].reserve(n + 1);
+		coeff_pow[l].reserve(n + 1);
+		mono_pow[l].push_back(_ex1);
+		coeff_pow[l].push_back(*_num1_p);
+		for (int j = 1; j <= n; ++j) {
+			mono_pow[l].push_back(last ? _ex1 : (new mul(mono_pow[l][j-1], rest))->setflag(status_flags::dynallocated));
+			coeff_pow[l].push_back(coeff_pow[l][j-1].mul(c));
+		}
+	}
+
+	// k[l] is the exponent of term l, the one of the last term being
+	// n-k_cum[m-2].  For the l-th prefix of the terms, binom[l] is
+	// binomial(n-k_cum[l-1],k[l]), and multinomial[l], coeff[l] and mono[l]
+	// are the partial products of these binomials, coefficient powers and
+	// monomial powers.
+	std::vector<int> k(m-1, 0), k_cum(m-1, 0);
+	std::vector<cln::cl_I> binom(m-1, 1), multinomial(m-1, 1);
+	std::vector<numeric> coeff(m-1, *_num1_p);
+	exvector mono(m-1, _ex1);
+
+	// Under expand_truncated(), the terms of too high degree are left out.
+	// degrees[l] is the degree of term l and deg[l] the one of mono[l].
+	const degree_truncation * trunc = current_truncation;
+	intvector degrees(m, 0), deg(m-1, 0);
+	if (trunc)
+		for (size_t l = 0; l < a.seq.size(); ++l)
+			degrees[l] = trunc->degree(a.seq[l].rest);
+
+	std::auto_ptr<epvector> terms(new epvector);
+	terms->reserve(binomial(numeric(n+m-1), numeric(m-1)).to_int());
+	numeric oc;
+
+	while (true) {
+		check_budget();
+		const int k_last = n - k_cum[m-2];
+		if (!trunc || deg[m-2] + k_last*degrees[m-1] <= trunc->max_degree) {
+			const numeric c = numeric(multinomial[m-2]).mul(coeff[m-2]).mul(coeff_pow[m-1][k_last]);
+			const ex & last_mono = mono_pow[m-1][k_last];
+			const ex term = last_mono.is_equal(_ex1) ? mono[m-2] :
+			                mono[m-2].is_equal(_ex1) ? last_mono :
+			                (new mul(mono[m-2], last_mono))->setflag(status_flags::dynallocated);
+			if (is_exactly_a<numeric>(term))
+				oc = oc.add(c.mul(ex_to<numeric>(term)));
+			else
+				terms->push_back(expair(term, c));
+		}
+
+		// increment k[]
+		size_t l = m - 2;
+		while (k_cum[l] == n) {  // no room left for k[l]
+			if (l == 0)
+				return (new add(terms, oc))->setflag(status_flags::dynallocated |
+				                                     status_flags::expanded);
+			--l;
+		}
+		const int rest = (l == 0 ? n : n - k_cum[l-1]);
+		++k[l];
+		++k_cum[l];
+		binom[l] = cln::exquo(binom[l] * (rest - k[l] + 1), k[l]);
+		multinomial[l] = (l == 0 ? binom[l] : multinomial[l-1] * binom[l]);
+		coeff[l] = (l == 0 ? coeff_pow[l][k[l]] : coeff[l-1].mul(coeff_pow[l][k[l]]));
+		deg[l] = (l == 0 ? 0 : deg[l-1]) + k[l]*degrees[l];
+		const ex & prev_mono = (l == 0 ? _ex1 : mono[l-1]);
+		mono[l] = prev_mono.is_equal(_ex1) ? mono_pow[l][k[l]] :
+		          (new mul(prev_mono, mono_pow[l][k[l]]))->setflag(status_flags::dynallocated);
+		for (size_t i = l + 1; i < m - 1; ++i) {
+			k[i] = 0;
+			k_cum[i] = k_cum[l];
+			binom[i] = 1;
+			multinomial[i] = multinomial[l];
+			coeff[i] = coeff[l];
+			mono[i] = mono[l];
+			deg[i] = deg[l];
+		}
+	}
+}
+
 /** Special case of power::expand_add. Expands a^2 where a is an add.
  *  @see power::expand_add */
 ex power::expand_add_2(const add & a, unsigned options) const
 {
-	epvector sum;
+	std::auto_ptr<epvector> sum(new epvector);
 	size_t a_nops = a.nops();
-	sum.reserve((a_nops*(a_nops+1))/2);
+	sum->reserve((a_nops*(a_nops+1))/2);
 	epvector::const_iterator last = a.seq.end();
 
+	// Under expand_truncated(), the terms of too high degree are left out
+	const degree_truncation * trunc = current_truncation;
+	intvector degrees;
+	if (trunc)
+		for (epvector::const_iterator cit = a.seq.begin(); cit != last; ++cit)
+			degrees.push_back(trunc->degree(cit->rest));
+
 	// power(+(x,...,z;c),2)=power(+(x,...,z;0),2)+2*c*+(x,...,z;0)+c*c
 	// first part: ignore overall_coeff and expand other terms
 	for (epvector::const_iterator cit0=a.seq.begin(); cit0!=last; ++cit0) {
+		check_budget();
 		const ex & r = cit0->rest;
 		const ex & c = cit0->coeff;
+		const int d0 = trunc ? degrees[cit0 - a.seq.begin()] : 0;
 		
 		GINAC_ASSERT(!is_exactly_a<add>(r));
 		GINAC_ASSERT(!is_exactly_a<power>(r) ||
@@ -984,47 +1192,52 @@ ex power::expand_add_2(const add & a, unsigned options) const
 		             !is_exactly_a<mul>(ex_to<power>(r).basis) ||
 		             !is_exactly_a<power>(ex_to<power>(r).basis));
 		
-		if (c.is_equal(_ex1)) {
-			if (is_exactly_a<mul>(r)) {
-				sum.push_back(expair(expand_mul(ex_to<mul>(r), *_num2_p, options, true),
-				                     _ex1));
-			} else {
-				sum.push_back(expair((new power(r,_ex2))->setflag(status_flags::dynallocated),
-				                     _ex1));
-			}
-		} else {
-			if (is_exactly_a<mul>(r)) {
-				sum.push_back(a.combine_ex_with_coeff_to_pair(expand_mul(ex_to<mul>(r), *_num2_p, options, true),
-				                     ex_to<numeric>(c).power_dyn(*_num2_p)));
+		if (!trunc || d0 + d0 <= trunc->max_degree) {
+			if (c.is_equal(_ex1)) {
+				if (is_exactly_a<mul>(r)) {
+					sum->push_back(expair(expand_mul(ex_to<mul>(r), *_num2_p, options, true),
+					                     _ex1));
+				} else {
+					sum->push_back(expair((new power(r,_ex2))->setflag(status_flags::dynallocated),
+					                     _ex1));
+				}
 			} else {
-				sum.push_back(a.combine_ex_with_coeff_to_pair((new power(r,_ex2))->setflag(status_flags::dynallocated),
-				                     ex_to<numeric>(c).power_dyn(*_num2_p)));
+				if (is_exactly_a<mul>(r)) {
+					sum->push_back(a.combine_ex_with_coeff_to_pair(expand_mul(ex_to<mul>(r), *_num2_p, options, true),
+					                     ex_to<numeric>(c).power_dyn(*_num2_p)));
+				} else {
+					sum->push_back(a.combine_ex_with_coeff_to_pair((new power(r,_ex2))->setflag(status_flags::dynallocated),
+					                     ex_to<numeric>(c).power_dyn(*_num2_p)));
+				}
 			}
 		}
 
 		for (epvector::const_iterator cit1=cit0+1; cit1!=last; ++cit1) {
+			if (trunc && d0 + degrees[cit1 - a.seq.begin()] > trunc->max_degree)
+				continue;
 			const ex & r1 = cit1->rest;
 			const ex & c1 = cit1->coeff;
-			sum.push_back(a.combine_ex_with_coeff_to_pair((new mul(r,r1))->setflag(status_flags::dynallocated),
+			sum->push_back(a.combine_ex_with_coeff_to_pair((new mul(r,r1))->setflag(status_flags::dynallocated),
 			                                              _num2_p->mul(ex_to<numeric>(c)).mul_dyn(ex_to<numeric>(c1))));
 		}
 	}
 	
-	GINAC_ASSERT(sum.size()==(a.seq.size()*(a.seq.size()+1))/2);
+	GINAC_ASSERT(trunc || sum->size()==(a.seq.size()*(a.seq.size()+1))/2);
 	
 	// second part: add terms coming from overall_factor (if != 0)
 	if (!a.overall_coeff.is_zero()) {
 		epvector::const_iterator i = a.seq.begin(), end = a.seq.end();
 		while (i != end) {
-			sum.push_back(a.combine_pair_with_coeff_to_pair(*i, ex_to<numeric>(a.overall_coeff).mul_dyn(*_num2_p)));
+			if (!trunc || degrees[i - a.seq.begin()] <= trunc->max_degree)
+				sum->push_back(a.combine_pair_with_coeff_to_pair(*i, ex_to<numeric>(a.overall_coeff).mul_dyn(*_num2_p)));
 			++i;
 		}
-		sum.push_back(expair(ex_to<numeric>(a.overall_coeff).power_dyn(*_num2_p),_ex1));
+		sum->push_back(expair(ex_to<numeric>(a.overall_coeff).power_dyn(*_num2_p),_ex1));
 	}
 	
-	GINAC_ASSERT(sum.size()==(a_nops*(a_nops+1))/2);
+	GINAC_ASSERT(trunc || sum->size()==(a_nops*(a_nops+1))/2);
 	
-	return (new add(sum))->setflag(status_flags::dynallocated | status_flags::expanded);
+	return (new add(sum, _ex0))->setflag(status_flags::dynallocated | status_flags::expanded);
 }
 
 /** Expand factors of m in m^n where m is a mul and n is an integer.
@@ -1053,8 +1266,8 @@ ex power::expand_mul(const mul & m, const numeric & n, unsigned options, bool fr
 		return result;
 	}
 
-	epvector distrseq;
-	distrseq.reserve(m.seq.size());
+	std::auto_ptr<epvector> distrseq(new epvector);
+	distrseq->reserve(m.seq.size());
 	bool need_reexpand = false;
 
 	epvector::const_iterator last = m.seq.end();
@@ -1066,7 +1279,7 @@ ex power::expand_mul(const mul & m, const numeric & n, unsigned options, bool fr
 			// the resulting product needs to be reexpanded
 			need_reexpand = true;
 		}
-		distrseq.push_back(p);
+		distrseq->push_back(p);
 		++cit;
 	}
 
@@ -61,6 +61,7 @@ public:
 	ex coeff(const ex & s, int n = 1) const;
 	ex eval(int level=0) const;
 	ex evalf(int level=0) const;
+	std::complex<double> evalf_double(const evalf_double_map & values) const;
 	ex evalm() const;
 	ex series(const relational & s, int order, unsigned options = 0) const;
 	ex subs(const exmap & m, unsigned options = 0) const;
@@ -95,8 +96,12 @@ protected:
 	void do_print_python_repr(const print_python_repr & c, unsigned level) const;
 	void do_print_csrc_cl_N(const print_csrc_cl_N & c, unsigned level) const;
 
+	static std::complex<double> evalf_double_power(const std::complex<double> & b, const ex & e,
+	                                               const evalf_double_map & values);
+
 	ex expand_add(const add & a, int n, unsigned options) const;
 	ex expand_add_2(const add & a, unsigned options) const;
+	ex expand_add_monomials(const add & a, int n) const;
 	ex expand_mul(const mul & m, const numeric & n, unsigned options, bool from_expand = false) const;
 	
 // member variables
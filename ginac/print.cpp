@@ -36,6 +36,7 @@ GINAC_IMPLEMENT_PRINT_CONTEXT(print_latex, print_context)
 GINAC_IMPLEMENT_PRINT_CONTEXT(print_python, print_context)
 GINAC_IMPLEMENT_PRINT_CONTEXT(print_python_repr, print_context)
 GINAC_IMPLEMENT_PRINT_CONTEXT(print_tree, print_context)
+GINAC_IMPLEMENT_PRINT_CONTEXT(print_dag, print_tree)
 GINAC_IMPLEMENT_PRINT_CONTEXT(print_csrc, print_context)
 GINAC_IMPLEMENT_PRINT_CONTEXT(print_csrc_float, print_csrc)
 GINAC_IMPLEMENT_PRINT_CONTEXT(print_csrc_double, print_csrc)
@@ -73,6 +74,19 @@ print_tree::print_tree(unsigned d)
 print_tree::print_tree(std::ostream & os, unsigned opt, unsigned d)
 	: print_context(os, opt), delta_indent(d) {}
 
+print_dag::print_dag()
+	: print_tree(std::cout), nodes(0), repeats(0), bytes(0) {}
+print_dag::print_dag(unsigned d)
+	: print_tree(std::cout, 0, d), nodes(0), repeats(0), bytes(0) {}
+print_dag::print_dag(std::ostream & os, unsigned opt, unsigned d)
+	: print_tree(os, opt, d), nodes(0), repeats(0), bytes(0) {}
+
+void print_dag::print_summary() const
+{
+	s << nodes << " objects (" << ids.size() << " shared, "
+	  << repeats << " repeated occurrences), " << bytes << " bytes" << std::endl;
+}
+
 print_csrc::print_csrc()
 	: print_context(std::cout) {}
 print_csrc::print_csrc(std::ostream & os, unsigned opt)
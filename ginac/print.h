@@ -25,12 +25,16 @@
 
 #include "class_info.h"
 
+#include <cstddef>
 #include <iosfwd>
+#include <map>
 #include <memory>
 #include <string>
 
 namespace GiNaC {
 
+class basic;
+
 /** This class stores information about a registered print_context class. */
 class print_context_options {
 public:
@@ -144,6 +148,27 @@ public:
 	const unsigned delta_indent; /**< size of indentation step */
 };
 
+/** Context for tree-like output in which every object is printed only once,
+ *  for debugging huge expressions with many shared subexpressions.  Objects
+ *  with more than one reference are numbered and shown with their reference
+ *  count and memory footprint; where they occur again, only their number is
+ *  printed. */
+class print_dag : public print_tree
+{
+	GINAC_DECLARE_PRINT_CONTEXT(print_dag, print_tree)
+public:
+	print_dag(unsigned d);
+	print_dag(std::ostream &, unsigned options = 0, unsigned d = 4);
+
+	/** Print the numbers of objects and bytes printed so far. */
+	void print_summary() const;
+
+	mutable std::map<const basic *, unsigned> ids; /**< numbers of the shared objects printed so far */
+	mutable std::size_t nodes;   /**< number of different objects printed */
+	mutable std::size_t repeats; /**< number of occurrences of objects printed before */
+	mutable std::size_t bytes;   /**< sum of the footprints of the objects printed */
+};
+
 /** Base context for C source output. */
 class print_csrc : public print_context
 {
@@ -182,8 +207,6 @@ inline bool is_a(const print_context & obj)
 { return dynamic_cast<const T *>(&obj) != 0; }
 
 
-class basic;
-
 /** Base class for print_functor handlers */
 class print_functor_impl {
 public:
@@ -0,0 +1,426 @@
+/** @file profile.cpp
+ *
+ *  Implementation of the profiling of the main operations. */
+
+/*
+ *  GiNaC Copyright (C) 1999-2014 Johannes Gutenberg University Mainz, Germany
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#include "profile.h"
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+#include <map>
+#include <vector>
+#ifdef HAVE_UNISTD_H
+#include <sys/time.h>
+#endif
+#if defined(GINAC_THREADSAFE_REFCOUNT) && defined(HAVE_PTHREAD_H)
+#define RECYCLE_PROFILES 1
+#include <pthread.h>
+#endif
+
+namespace GiNaC {
+
+bool profiling_enabled = false;
+bool tracing_enabled = false;
+GINAC_PROFILE_THREAD_LOCAL profile_thread_data * profile_local = 0;
+GINAC_PROFILE_THREAD_LOCAL const progress_reporter * current_progress = 0;
+
+/** Objects of a class created and destroyed by a thread, by operation. */
+struct class_allocations {
+	class_allocations() : size(0)
+	{
+		std::fill(born, born + profile_num_phases + 1, 0);
+		std::fill(died, died + profile_num_phases + 1, 0);
+	}
+
+	std::size_t size;  ///< of the objects
+	unsigned long born[profile_num_phases + 1];
+	unsigned long died[profile_num_phases + 1];
+};
+
+/** The objects created and destroyed by a thread, by the names of their
+ *  classes.  Only the thread adds classes, while holding profiles_lock. */
+struct profile_allocation_table {
+	std::map<const char *, class_allocations> classes;
+};
+
+namespace {
+
+/** The profiles of all threads, including those whose thread has ended. */
+profile_thread_data * all_profiles = 0;
+unsigned num_profiles = 0;
+
+#ifdef GINAC_THREADSAFE_REFCOUNT
+int profiles_mutex = 0;
+
+class profiles_lock {
+public:
+	profiles_lock() { while (__sync_lock_test_and_set(&profiles_mutex, 1)) ; }
+	~profiles_lock() { __sync_lock_release(&profiles_mutex); }
+};
+#else
+class profiles_lock {
+public:
+	profiles_lock() {}
+};
+#endif
+
+#ifdef RECYCLE_PROFILES
+pthread_key_t profile_key;
+pthread_once_t profile_key_once = PTHREAD_ONCE_INIT;
+
+/** Called when a thread ends, to pass its profile on.  Its counts stay
+ *  part of the sum of all profiles. */
+extern "C" void release_profile(void * p)
+{
+	profiles_lock lock;
+	profile_thread_data * profile = static_cast<profile_thread_data *>(p);
+	std::memset(profile->depth, 0, sizeof(profile->depth));
+	profile->timers = 0;
+	profile->in_use = false;
+}
+
+extern "C" void create_profile_key()
+{
+	pthread_key_create(&profile_key, release_profile);
+}
+#endif
+
+} // anonymous namespace
+
+/** Assign a profile to the calling thread, when it counts something for the
+ *  first time. */
+profile_thread_data & profile_register_thread()
+{
+	profile_thread_data * profile;
+	{
+		profiles_lock lock;
+		profile = all_profiles;
+		while (profile && profile->in_use)
+			profile = profile->next;
+		if (!profile) {
+			profile = new profile_thread_data;
+			std::memset(profile, 0, sizeof(profile_thread_data));
+			profile->next = all_profiles;
+			profile->id = ++num_profiles;
+			all_profiles = profile;
+		}
+		profile->in_use = true;
+	}
+#ifdef RECYCLE_PROFILES
+	pthread_once(&profile_key_once, create_profile_key);
+	pthread_setspecific(profile_key, profile);
+#endif
+	profile_local = profile;
+	return *profile;
+}
+
+namespace {
+
+/** A span of time, or an instant if end is negative. */
+struct trace_record {
+	const char * name;
+	double start, end;  ///< in microseconds since tracing was enabled
+	unsigned thread;
+	const char * arg1, * arg2;
+	long value1, value2;
+};
+
+/** Events after this many are dropped, to bound the memory used. */
+const std::size_t max_trace_records = 1 << 20;
+
+std::vector<trace_record> & trace_records()
+{
+	static std::vector<trace_record> records;
+	return records;
+}
+
+unsigned long dropped_trace_records = 0;
+double trace_epoch = 0;
+
+/** Wall clock time in microseconds. */
+double wall_clock()
+{
+#ifdef HAVE_UNISTD_H
+	struct timeval tv;
+	gettimeofday(&tv, 0);
+	return tv.tv_sec * 1e6 + tv.tv_usec;
+#else
+	return double(std::clock()) * 1e6 / CLOCKS_PER_SEC;
+#endif
+}
+
+} // anonymous namespace
+
+/** Time in microseconds since tracing was enabled. */
+double trace_clock()
+{
+	return wall_clock() - trace_epoch;
+}
+
+/** Record an event of the calling thread. */
+void trace_event(const char * name, double start, double end,
+                 const char * arg1, long value1, const char * arg2, long value2)
+{
+	trace_record r;
+	r.name = name;
+	r.start = start;
+	r.end = end;
+	r.thread = profile_thread().id;
+	r.arg1 = arg1;
+	r.value1 = value1;
+	r.arg2 = arg2;
+	r.value2 = value2;
+	profiles_lock lock;
+	if (trace_records().size() < max_trace_records)
+		trace_records().push_back(r);
+	else
+		++dropped_trace_records;
+}
+
+/** Enable or disable the recording of trace events.  Events are recorded
+ *  at the begin and end of the main algorithms and their phases, with the
+ *  sizes of their operands.
+ *
+ *  @return previous setting */
+bool set_tracing(bool enable)
+{
+	const bool previous = tracing_enabled;
+	if (enable && !previous && trace_records().empty())
+		trace_epoch = wall_clock();
+	tracing_enabled = enable;
+	return previous;
+}
+
+bool get_tracing()
+{
+	return tracing_enabled;
+}
+
+static void write_trace_args(std::ostream & os, const trace_record & r)
+{
+	if (!r.arg1)
+		return;
+	os << ",\"args\":{\"" << r.arg1 << "\":" << r.value1;
+	if (r.arg2)
+		os << ",\"" << r.arg2 << "\":" << r.value2;
+	os << '}';
+}
+
+/** Write the trace events as a JSON object with the list of events, one
+ *  per line.  Spans become complete ("X") events and instants "i" events,
+ *  with times in microseconds. */
+void write_trace(std::ostream & os)
+{
+	std::vector<trace_record> records;
+	unsigned long dropped;
+	{
+		profiles_lock lock;
+		records.swap(trace_records());
+		dropped = dropped_trace_records;
+		dropped_trace_records = 0;
+	}
+	const std::streamsize old_precision = os.precision(15);
+	os << "{\"traceEvents\":[";
+	for (std::size_t i = 0; i < records.size(); ++i) {
+		const trace_record & r = records[i];
+		os << (i ? ",\n" : "\n") << "{\"name\":\"" << r.name << "\",\"pid\":1,\"tid\":" << r.thread
+		   << ",\"ts\":" << r.start;
+		if (r.end < 0)
+			os << ",\"ph\":\"i\",\"s\":\"t\"";
+		else
+			os << ",\"ph\":\"X\",\"dur\":" << r.end - r.start;
+		write_trace_args(os, r);
+		os << '}';
+	}
+	os << "\n],\"displayTimeUnit\":\"ms\",\"otherData\":{\"dropped_events\":\"" << dropped << "\"}}" << std::endl;
+	os.precision(old_precision);
+}
+
+void clear_trace()
+{
+	profiles_lock lock;
+	std::vector<trace_record>().swap(trace_records());
+	dropped_trace_records = 0;
+}
+
+/** Enable or disable the profiling of the operations listed in
+ *  profile_phase and the counting of the events listed in profile_event.
+ *
+ *  @return previous setting */
+bool set_profiling(bool enable)
+{
+	const bool previous = profiling_enabled;
+	profiling_enabled = enable;
+	return previous;
+}
+
+bool get_profiling()
+{
+	return profiling_enabled;
+}
+
+/** The counts of the objects of a class in the profile of the calling
+ *  thread. */
+static class_allocations & allocations_of(const char * class_name)
+{
+	profile_thread_data & profile = profile_thread();
+	if (profile.allocations) {
+		std::map<const char *, class_allocations>::iterator i = profile.allocations->classes.find(class_name);
+		if (i != profile.allocations->classes.end())
+			return i->second;
+	}
+	profiles_lock lock;
+	if (!profile.allocations)
+		profile.allocations = new profile_allocation_table;
+	return profile.allocations->classes[class_name];
+}
+
+/** Called by basic::setflag() when an object is marked as allocated on the
+ *  heap while profiling is enabled. */
+void profile_object_born(const char * class_name, std::size_t size)
+{
+	class_allocations & c = allocations_of(class_name);
+	const profile_thread_data & profile = *profile_local;
+	c.size = size;
+	++c.born[profile.timers ? profile.outer_phase : int(profile_num_phases)];
+}
+
+/** Called by basic::operator delete() for objects whose birth was counted,
+ *  while profiling is enabled. */
+void profile_object_died(const char * class_name)
+{
+	class_allocations & c = allocations_of(class_name);
+	const profile_thread_data & profile = *profile_local;
+	++c.died[profile.timers ? profile.outer_phase : int(profile_num_phases)];
+}
+
+/** Sum of the profiles of all threads.  The counts of threads which are
+ *  still running may be a little behind. */
+profile_statistics get_profile_statistics()
+{
+	profile_statistics sum;
+	std::memset(&sum, 0, sizeof(sum));
+	profiles_lock lock;
+	for (const profile_thread_data * profile = all_profiles; profile; profile = profile->next) {
+		for (int p = 0; p < profile_num_phases; ++p) {
+			sum.seconds[p] += profile->data.seconds[p];
+			sum.calls[p] += profile->data.calls[p];
+		}
+		for (int e = 0; e < profile_num_events; ++e)
+			sum.events[e] += profile->data.events[e];
+	}
+	return sum;
+}
+
+static bool by_class_and_phase(const allocation_statistics & a, const allocation_statistics & b)
+{
+	const int c = std::strcmp(a.class_name, b.class_name);
+	return c < 0 || (c == 0 && a.phase < b.phase);
+}
+
+/** Objects created and destroyed by all threads, sorted by the names of
+ *  their classes and by the operations. */
+std::vector<allocation_statistics> get_allocation_statistics()
+{
+	std::map<const char *, class_allocations> sum;
+	{
+		profiles_lock lock;
+		for (const profile_thread_data * profile = all_profiles; profile; profile = profile->next) {
+			if (!profile->allocations)
+				continue;
+			const std::map<const char *, class_allocations> & classes = profile->allocations->classes;
+			for (std::map<const char *, class_allocations>::const_iterator i = classes.begin(); i != classes.end(); ++i) {
+				class_allocations & c = sum[i->first];
+				if (i->second.size)
+					c.size = i->second.size;
+				for (int p = 0; p <= profile_num_phases; ++p) {
+					c.born[p] += i->second.born[p];
+					c.died[p] += i->second.died[p];
+				}
+			}
+		}
+	}
+
+	std::vector<allocation_statistics> result;
+	for (std::map<const char *, class_allocations>::const_iterator i = sum.begin(); i != sum.end(); ++i) {
+		for (int p = 0; p <= profile_num_phases; ++p) {
+			if (!i->second.born[p] && !i->second.died[p])
+				continue;
+			allocation_statistics s;
+			s.class_name = i->first;
+			s.phase = p;
+			s.born = i->second.born[p];
+			s.died = i->second.died[p];
+			s.bytes_born = s.born * i->second.size;
+			s.bytes_died = s.died * i->second.size;
+			result.push_back(s);
+		}
+	}
+	std::sort(result.begin(), result.end(), by_class_and_phase);
+	return result;
+}
+
+void reset_profile_statistics()
+{
+	profiles_lock lock;
+	for (profile_thread_data * profile = all_profiles; profile; profile = profile->next) {
+		std::memset(&profile->data, 0, sizeof(profile->data));
+		if (!profile->allocations)
+			continue;
+		// The entries stay, as their threads may be counting into them
+		std::map<const char *, class_allocations> & classes = profile->allocations->classes;
+		for (std::map<const char *, class_allocations>::iterator i = classes.begin(); i != classes.end(); ++i) {
+			std::fill(i->second.born, i->second.born + profile_num_phases + 1, 0);
+			std::fill(i->second.died, i->second.died + profile_num_phases + 1, 0);
+		}
+	}
+}
+
+const char * profile_phase_name(profile_phase p)
+{
+	static const char * const names[profile_num_phases] = {
+		"eval", "expand", "normal", "gcd", "factor", "series", "subs"
+	};
+	return names[p];
+}
+
+const char * profile_event_name(profile_event e)
+{
+	static const char * const names[profile_num_events] = {
+		"objects allocated",
+		"gcd() called",
+		"sr_gcd() called",
+		"heur_gcd() called",
+		"heur_gcd() failed",
+		"heur_gcd() skipped",
+		"chinrem_gcd() called",
+		"chinrem_gcd() gave up",
+		"compare() called",
+		"compare() hash collisions",
+		"is_equal() called"
+	};
+	return names[e];
+}
+
+} // namespace GiNaC
@@ -0,0 +1,265 @@
+/** @file profile.h
+ *
+ *  Interface to the profiling of the main operations. */
+
+/*
+ *  GiNaC Copyright (C) 1999-2014 Johannes Gutenberg University Mainz, Germany
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#ifndef GINAC_PROFILE_H
+#define GINAC_PROFILE_H
+
+#include <cstddef>
+#include <ctime>
+#include <iosfwd>
+#include <vector>
+
+namespace GiNaC {
+
+/** Operations whose processor time is measured while profiling is enabled. */
+enum profile_phase {
+	profile_eval,      ///< automatic evaluation
+	profile_expand,    ///< ex::expand()
+	profile_normal,    ///< ex::normal()
+	profile_gcd,       ///< gcd()
+	profile_factor,    ///< factor()
+	profile_series,    ///< ex::series()
+	profile_subs,      ///< ex::subs()
+	profile_num_phases
+};
+
+/** Events which are counted while profiling is enabled. */
+enum profile_event {
+	profile_allocations,          ///< expression objects allocated on the heap
+	profile_gcd_called,           ///< gcd() computations, including recursive ones
+	profile_sr_gcd_called,        ///< subresultant GCD computations
+	profile_heur_gcd_called,      ///< heuristic GCD computations
+	profile_heur_gcd_failed,      ///< failed heuristic GCD computations
+	profile_heur_gcd_skipped,     ///< heuristic GCD skipped as too large
+	profile_chinrem_gcd_called,   ///< modular GCD computations
+	profile_chinrem_gcd_gave_up,  ///< modular GCD computations given up
+	profile_compares,             ///< basic::compare() calls
+	profile_compare_collisions,   ///< basic::compare() of different objects with the same hash value
+	profile_is_equals,            ///< basic::is_equal() calls
+	profile_num_events
+};
+
+/** Processor time in seconds and number of calls of the operations, and
+ *  counts of the events since the profile was last reset.  The time of an
+ *  operation includes the operations it calls, e.g. the evaluation done
+ *  by expand() counts for both.  Recursive calls of an operation are only
+ *  counted once. */
+struct profile_statistics {
+	double seconds[profile_num_phases];
+	unsigned long calls[profile_num_phases];
+	unsigned long events[profile_num_events];
+};
+
+/** Objects of a class created and destroyed on the heap while profiling was
+ *  enabled, during an operation.  The operation is the outermost one being
+ *  profiled at the time, e.g. the evaluation done by expand() counts for
+ *  expand(), or profile_num_phases outside of all operations.  The bytes
+ *  are those of the objects themselves, without memory they manage like
+ *  the terms of sums.  Objects created while profiling was disabled are not
+ *  counted when they are destroyed. */
+struct allocation_statistics {
+	const char * class_name;
+	int phase;
+	unsigned long born;
+	unsigned long died;
+	unsigned long bytes_born;
+	unsigned long bytes_died;
+};
+
+// Enable or disable profiling (default disabled), returns previous setting.
+// Profiling slows down the computations a bit.  When it is disabled, each
+// timer and counter only costs a test of a flag.
+extern bool set_profiling(bool enable);
+extern bool get_profiling();
+
+// Get the profile collected so far, by all threads
+extern profile_statistics get_profile_statistics();
+
+// Get the objects created and destroyed so far, by class and operation
+extern std::vector<allocation_statistics> get_allocation_statistics();
+
+// Reset the profile of all threads
+extern void reset_profile_statistics();
+
+// Names of the phases and events, for printing the profile
+extern const char * profile_phase_name(profile_phase p);
+extern const char * profile_event_name(profile_event e);
+
+// Record trace events of the main algorithms (default disabled), returns
+// previous setting.  Tracing and profiling are independent of each other.
+extern bool set_tracing(bool enable);
+extern bool get_tracing();
+
+// Write the trace events recorded so far in the Trace Event Format read by
+// chrome://tracing and Perfetto, and discard them
+extern void write_trace(std::ostream & os);
+
+// Discard the trace events recorded so far
+extern void clear_trace();
+
+#ifdef GINAC_THREADSAFE_REFCOUNT
+#define GINAC_PROFILE_THREAD_LOCAL __thread
+#else
+#define GINAC_PROFILE_THREAD_LOCAL
+#endif
+
+/** Profile collected by one thread.  The profiles of all threads which
+ *  profiled something are linked in a list, and their sum is the profile
+ *  returned by get_profile_statistics().  When a thread ends, its profile
+ *  is taken over by the next thread that starts profiling. */
+struct profile_allocation_table;
+
+struct profile_thread_data {
+	profile_statistics data;
+	profile_allocation_table * allocations;
+	unsigned depth[profile_num_phases];  ///< nesting of the timers of each phase
+	unsigned timers;                     ///< number of running timers
+	int outer_phase;                     ///< phase of the outermost running timer
+	unsigned id;                         ///< thread number in the trace
+	bool in_use;                         ///< false once the thread has ended
+	profile_thread_data * next;
+};
+
+// Internal state of the profiling and tracing
+extern bool profiling_enabled;
+extern bool tracing_enabled;
+extern GINAC_PROFILE_THREAD_LOCAL profile_thread_data * profile_local;
+extern profile_thread_data & profile_register_thread();
+extern void profile_object_born(const char * class_name, std::size_t size);
+extern void profile_object_died(const char * class_name);
+extern double trace_clock();
+extern void trace_event(const char * name, double start, double end,
+                        const char * arg1, long value1, const char * arg2, long value2);
+
+/** The profile of the calling thread. */
+inline profile_thread_data & profile_thread()
+{
+	return profile_local ? *profile_local : profile_register_thread();
+}
+
+/** Count an event if profiling is enabled. */
+inline void profile_count(profile_event e)
+{
+	if (profiling_enabled)
+		++profile_thread().data.events[e];
+}
+
+/** Adds the processor time of its lifetime to a phase of the profile if
+ *  profiling is enabled and it is not nested in another timer of the same
+ *  phase. */
+class profile_timer {
+public:
+	explicit profile_timer(profile_phase p) : phase(p), profile(0)
+	{
+		if (profiling_enabled) {
+			profile = &profile_thread();
+			if (profile->timers++ == 0)
+				profile->outer_phase = phase;
+			if (profile->depth[phase]++ == 0)
+				start = std::clock();
+		}
+	}
+	~profile_timer()
+	{
+		if (!profile)
+			return;
+		--profile->timers;
+		if (--profile->depth[phase] == 0) {
+			profile->data.seconds[phase] += double(std::clock() - start) / CLOCKS_PER_SEC;
+			++profile->data.calls[phase];
+		}
+	}
+private:
+	profile_phase phase;
+	profile_thread_data * profile;  ///< 0 if profiling was disabled
+	std::clock_t start;
+};
+
+/** Receiver of the phases of the main algorithms as they begin: the name of
+ *  the phase, as in the trace, and up to two sizes of its operands (with
+ *  names 0 if absent).  Called by the thread doing the computation. */
+typedef void (*progress_callback)(const char * phase, const char * size1_name, long size1,
+                                  const char * size2_name, long size2, void * data);
+
+struct progress_reporter {
+	progress_callback callback;
+	void * data;
+};
+
+// The reporter of the calling thread, 0 if none
+extern GINAC_PROFILE_THREAD_LOCAL const progress_reporter * current_progress;
+
+/** Report the beginning of a phase to the reporter of the calling thread. */
+inline void report_progress(const char * name, const char * arg1, long value1,
+                            const char * arg2, long value2)
+{
+	if (current_progress)
+		current_progress->callback(name, arg1, value1, arg2, value2, current_progress->data);
+}
+
+/** Puts a reporter into effect while it exists. */
+class progress_scope {
+public:
+	explicit progress_scope(const progress_reporter * r) : saved(current_progress) { current_progress = r; }
+	~progress_scope() { current_progress = saved; }
+private:
+	const progress_reporter * saved;
+};
+
+/** Records the span of its lifetime as a trace event if tracing is enabled.
+ *  The optional arguments are the names and values of the sizes of the
+ *  operands (which should be cheap to compute, as they are computed even
+ *  if tracing is disabled).  Its beginning is also reported as progress. */
+class trace_scope {
+public:
+	explicit trace_scope(const char * name_, const char * arg1_ = 0, long value1_ = 0,
+	                     const char * arg2_ = 0, long value2_ = 0)
+	 : name(name_), arg1(arg1_), arg2(arg2_), value1(value1_), value2(value2_),
+	   start(tracing_enabled ? trace_clock() : -1)
+	{
+		report_progress(name, arg1, value1, arg2, value2);
+	}
+	~trace_scope()
+	{
+		if (start >= 0)
+			trace_event(name, start, trace_clock(), arg1, value1, arg2, value2);
+	}
+private:
+	const char * name;
+	const char * arg1, * arg2;
+	long value1, value2;
+	double start;  ///< -1 if tracing was disabled
+};
+
+/** Records an instant, like the choice of an algorithm, if tracing is
+ *  enabled, and reports it as progress. */
+inline void trace_mark(const char * name, const char * arg1 = 0, long value1 = 0,
+                       const char * arg2 = 0, long value2 = 0)
+{
+	report_progress(name, arg1, value1, arg2, value2);
+	if (tracing_enabled)
+		trace_event(name, trace_clock(), -1, arg1, value1, arg2, value2);
+}
+
+} // namespace GiNaC
+
+#endif // ndef GINAC_PROFILE_H
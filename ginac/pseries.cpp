@@ -21,6 +21,10 @@
  *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
  */
 
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
 #include "pseries.h"
 #include "add.h"
 #include "inifcns.h" // for Order function
@@ -32,11 +36,20 @@
 #include "symbol.h"
 #include "integral.h"
 #include "archive.h"
+#include "budget.h"
+#include "profile.h"
+#include "tasks.h"
 #include "utils.h"
 
 #include <limits>
+#include <map>
 #include <numeric>
 #include <stdexcept>
+#if defined(GINAC_THREADSAFE_REFCOUNT) && defined(HAVE_PTHREAD_H)
+// The terms of a sum are only expanded concurrently if expressions may be
+// shared between threads at all.
+#define PARALLEL_SERIES 1
+#endif
 
 namespace GiNaC {
 
@@ -261,6 +274,19 @@ int pseries::compare_same_type(const basic & other) const
 	return 0;
 }
 
+/** The coefficients and exponents of the terms, the expansion variable and
+ *  the expansion point, from which op() constructs the terms. */
+void pseries::stored_operands(exvector & v) const
+{
+	v.reserve(v.size() + 2 * seq.size() + 2);
+	for (epvector::const_iterator i = seq.begin(); i != seq.end(); ++i) {
+		v.push_back(i->rest);
+		v.push_back(i->coeff);
+	}
+	v.push_back(var);
+	v.push_back(point);
+}
+
 /** Return the number of operands including a possible order term. */
 size_t pseries::nops() const
 {
@@ -592,7 +618,7 @@ ex pseries::derivative(const symbol & s) const
 
 ex pseries::convert_to_poly(bool no_order) const
 {
-	ex e;
+	add_builder e;
 	epvector::const_iterator it = seq.begin(), itend = seq.end();
 	
 	while (it != itend) {
@@ -603,7 +629,7 @@ ex pseries::convert_to_poly(bool no_order) const
 			e += it->rest * power(var - point, it->coeff);
 		++it;
 	}
-	return e;
+	return e.result();
 }
 
 bool pseries::is_terminating() const
@@ -770,32 +796,174 @@ ex pseries::add_series(const pseries &other) const
 }
 
 
+static unsigned series_threads = 1;
+
+/** Set the number of threads add::series() uses for expanding the terms of
+ *  large sums.  This has an effect only if GiNaC was built with
+ *  GINAC_THREADSAFE_REFCOUNT and pthreads.
+ *
+ *  @return previous setting */
+unsigned set_series_threads(unsigned n)
+{
+	const unsigned previous = series_threads;
+	series_threads = (n == 0 ? 1 : n);
+	return previous;
+}
+
+/** Get the number of threads used by add::series(). */
+unsigned get_series_threads()
+{
+	return series_threads;
+}
+
+/** Series expansion of one term of a sum. */
+static ex term_series(const expair & term, const relational & r, int order, unsigned options)
+{
+	ex op;
+	if (is_exactly_a<pseries>(term.rest))
+		op = term.rest;
+	else
+		op = term.rest.series(r, order, options);
+	if (!term.coeff.is_equal(_ex1))
+		op = ex_to<pseries>(op).mul_const(ex_to<numeric>(term.coeff));
+	return op;
+}
+
+/** Sum of the series in v, returned in v[0].  Neighbouring series are added
+ *  pairwise until one is left, so the partial sums grow in a balanced tree
+ *  instead of one by one. */
+static void add_series_tree(exvector & v)
+{
+	GINAC_ASSERT(!v.empty());
+	std::size_t n = v.size();
+	while (n > 1) {
+		std::size_t m = 0;
+		for (std::size_t i = 0; i < n; i += 2, ++m)
+			v[m] = (i + 1 == n) ? v[i] : ex_to<pseries>(v[i]).add_series(ex_to<pseries>(v[i+1]));
+		n = m;
+	}
+}
+
+#ifdef PARALLEL_SERIES
+
+namespace {
+
+/** Sums with fewer terms are expanded by the calling thread alone. */
+const std::size_t min_parallel_series_terms = 16;
+
+/** Whether this thread is expanding a slice of a sum, in which case sums
+ *  inside the terms are expanded without starting more tasks. */
+__thread bool in_series_job = false;
+
+/** Marks the thread as expanding a slice during its lifetime. */
+class series_job_guard {
+public:
+	series_job_guard() : previous(in_series_job) { in_series_job = true; }
+	~series_job_guard() { in_series_job = previous; }
+private:
+	bool previous;
+};
+
+/** Series expansion of a slice of the terms of a sum, to be run as a task.
+ *  The expansions are summed up in the task already. */
+struct series_job {
+	epvector terms;
+	relational r;
+	int order;
+	unsigned options;
+	ex sum;
+	bool failed;
+};
+
+void * run_series_job(void * arg)
+{
+	series_job & job = *static_cast<series_job *>(arg);
+	series_job_guard guard;
+	try {
+		exvector ops;
+		ops.reserve(job.terms.size());
+		for (epvector::const_iterator i = job.terms.begin(); i != job.terms.end(); ++i)
+			ops.push_back(term_series(*i, job.r, job.order, job.options));
+		add_series_tree(ops);
+		job.sum = ops[0];
+	} catch (...) {
+		job.failed = true;
+	}
+	return 0;
+}
+
+/** Expand the terms concurrently, in slices run as tasks.  The first slice
+ *  is done by the calling thread.
+ *  @return false if the terms have to be expanded one by one instead */
+bool series_terms_parallel(const epvector & terms, const relational & r, int order,
+                           unsigned options, exvector & sums)
+{
+	const std::size_t nthreads = std::min<std::size_t>(series_threads, terms.size());
+	std::vector<series_job> jobs(nthreads);
+	for (std::size_t k = 0; k < nthreads; ++k) {
+		series_job & job = jobs[k];
+		const std::size_t first = terms.size() * k / nthreads;
+		const std::size_t last = terms.size() * (k + 1) / nthreads;
+		for (std::size_t i = first; i < last; ++i) {
+			ex rest = terms[i].rest, coeff = terms[i].coeff;
+			if (k > 0 && !(copy_numbers(terms[i].rest, rest) && copy_numbers(terms[i].coeff, coeff)))
+				return false;
+			job.terms.push_back(expair(rest, coeff));
+		}
+		ex rel = r;
+		if (k > 0 && !copy_numbers(r, rel))
+			return false;
+		job.r = ex_to<relational>(rel);
+		job.order = order;
+		job.options = options;
+		job.failed = false;
+	}
+
+	run_tasks(run_series_job, jobs);
+	for (std::size_t k = 0; k < nthreads; ++k)
+		if (jobs[k].failed)
+			return false;
+
+	for (std::size_t k = 0; k < nthreads; ++k)
+		sums.push_back(jobs[k].sum);
+	return true;
+}
+
+} // anonymous namespace
+
+#endif // def PARALLEL_SERIES
+
 /** Implementation of ex::series() for sums. This performs series addition when
- *  adding pseries objects.
+ *  adding pseries objects.  The series of the terms are added in a balanced
+ *  tree, and large sums may be expanded by several threads (see
+ *  set_series_threads()).
  *  @see ex::series */
 ex add::series(const relational & r, int order, unsigned options) const
 {
-	ex acc; // Series accumulator
-	
+	exvector ops;
+	ops.reserve(seq.size()+1);
+
 	// Get first term from overall_coeff
-	acc = overall_coeff.series(r, order, options);
-	
-	// Add remaining terms
-	epvector::const_iterator it = seq.begin();
-	epvector::const_iterator itend = seq.end();
-	for (; it!=itend; ++it) {
-		ex op;
-		if (is_exactly_a<pseries>(it->rest))
-			op = it->rest;
-		else
-			op = it->rest.series(r, order, options);
-		if (!it->coeff.is_equal(_ex1))
-			op = ex_to<pseries>(op).mul_const(ex_to<numeric>(it->coeff));
-		
-		// Series addition
-		acc = ex_to<pseries>(acc).add_series(ex_to<pseries>(op));
+	ops.push_back(overall_coeff.series(r, order, options));
+
+	// Expand remaining terms
+	bool done = false;
+#ifdef PARALLEL_SERIES
+	if (series_threads > 1 && seq.size() >= min_parallel_series_terms && !in_series_job)
+		done = series_terms_parallel(seq, r, order, options, ops);
+	if (!done)
+		ops.resize(1);
+#endif
+	if (!done) {
+		epvector::const_iterator it = seq.begin();
+		epvector::const_iterator itend = seq.end();
+		for (; it!=itend; ++it)
+			ops.push_back(term_series(*it, r, order, options));
 	}
-	return acc;
+
+	// Series addition
+	add_series_tree(ops);
+	return ops[0];
 }
 
 
@@ -821,6 +989,36 @@ ex pseries::mul_const(const numeric &other) const
 }
 
 
+/** Check whether at least half of the powers between the lowest and the
+ *  highest one have a nonzero coefficient.  The order term is not counted. */
+bool pseries::is_dense() const
+{
+	size_t terms = seq.size();
+	if (terms && is_order_function(seq.back().rest))
+		--terms;
+	if (terms < 2)
+		return true;
+	const int lo = ex_to<numeric>(seq.front().coeff).to_int();
+	const int hi = ex_to<numeric>(seq[terms-1].coeff).to_int();
+	return 2*terms > size_t(hi - lo);
+}
+
+
+/** Unpack the coefficients into an array indexed by the power minus the
+ *  lowest power, with zeros in between.  The order term becomes zero, too. */
+void pseries::dense_coeffs(exvector & c) const
+{
+	c.clear();
+	if (seq.empty())
+		return;
+	const int lo = ex_to<numeric>(seq.front().coeff).to_int();
+	c.resize(ex_to<numeric>(seq.back().coeff).to_int() - lo + 1);
+	for (epvector::const_iterator it=seq.begin(); it!=seq.end(); ++it)
+		if (!is_order_function(it->rest))
+			c[ex_to<numeric>(it->coeff).to_int() - lo] = it->rest;
+}
+
+
 /** Multiply one pseries object to another, producing a pseries object that
  *  represents the product.
  *
@@ -860,17 +1058,49 @@ ex pseries::mul_series(const pseries &other) const
 	if (cdeg_max >= higher_order_c)
 		cdeg_max = higher_order_c - 1;
 	
-	for (int cdeg=cdeg_min; cdeg<=cdeg_max; ++cdeg) {
-		ex co = _ex0;
-		// c(i)=a(0)b(i)+...+a(i)b(0)
-		for (int i=a_min; cdeg-i>=b_min; ++i) {
-			ex a_coeff = coeff(var, i);
-			ex b_coeff = other.coeff(var, cdeg-i);
-			if (!is_order_function(a_coeff) && !is_order_function(b_coeff))
-				co += a_coeff * b_coeff;
+	if (is_dense() && other.is_dense()) {
+		// c(i)=a(0)b(i)+...+a(i)b(0), with the coefficients unpacked into
+		// arrays indexed by the power
+		exvector a_coeffs, b_coeffs;
+		dense_coeffs(a_coeffs);
+		other.dense_coeffs(b_coeffs);
+		exvector terms;
+		for (int cdeg=cdeg_min; cdeg<=cdeg_max; ++cdeg) {
+			check_budget();
+			terms.clear();
+			const int i_max = std::min(a_max, cdeg-b_min);
+			for (int i=std::max(a_min, cdeg-b_max); i<=i_max; ++i) {
+				const ex & a_coeff = a_coeffs[i-a_min];
+				const ex & b_coeff = b_coeffs[cdeg-i-b_min];
+				if (!a_coeff.is_zero() && !b_coeff.is_zero())
+					terms.push_back(a_coeff * b_coeff);
+			}
+			ex co = (new add(terms))->setflag(status_flags::dynallocated);
+			if (!co.is_zero())
+				new_seq.push_back(expair(co, numeric(cdeg)));
+		}
+	} else {
+		// multiply all pairs of terms and collect the products by power
+		std::map<int, exvector> terms;
+		for (epvector::const_iterator a=seq.begin(); a!=seq.end(); ++a) {
+			if (is_order_function(a->rest))
+				break;
+			check_budget();
+			const int a_deg = ex_to<numeric>(a->coeff).to_int();
+			for (epvector::const_iterator b=other.seq.begin(); b!=other.seq.end(); ++b) {
+				if (is_order_function(b->rest))
+					break;
+				const int cdeg = a_deg + ex_to<numeric>(b->coeff).to_int();
+				if (cdeg > cdeg_max)
+					break;
+				terms[cdeg].push_back(a->rest * b->rest);
+			}
+		}
+		for (std::map<int, exvector>::const_iterator it=terms.begin(); it!=terms.end(); ++it) {
+			ex co = (new add(it->second))->setflag(status_flags::dynallocated);
+			if (!co.is_zero())
+				new_seq.push_back(expair(co, numeric(it->first)));
 		}
-		if (!co.is_zero())
-			new_seq.push_back(expair(co, numeric(cdeg)));
 	}
 	if (higher_order_c < std::numeric_limits<int>::max())
 		new_seq.push_back(expair(Order(_ex1), numeric(higher_order_c)));
@@ -878,6 +1108,49 @@ ex pseries::mul_series(const pseries &other) const
 }
 
 
+/** Memo of the series expansions of one factor in mul::series().  Only the
+ *  expansion to the highest order requested so far is computed and kept,
+ *  expansions to lower orders are obtained by truncating it. */
+class series_memo {
+public:
+	series_memo(const ex & e_, const relational & r_, unsigned options_)
+	  : e(e_), r(r_), options(options_), order(std::numeric_limits<int>::min()) {}
+	ex get(int n);
+private:
+	ex e;
+	relational r;
+	unsigned options;
+	int order;  ///< order of the cached expansion
+	ex cached;  ///< series expansion of e to the given order
+};
+
+ex series_memo::get(int n)
+{
+	if (n > order) {
+		cached = e.series(r, n, options);
+		order = n;
+	}
+	if (n == order)
+		return cached;
+	if (!is_a<pseries>(cached))
+		return e.series(r, n, options);
+	const pseries & s = ex_to<pseries>(cached);
+	epvector new_seq;
+	bool truncated = false;
+	for (size_t i=0; i<s.nops(); ++i) {
+		const int deg = ex_to<numeric>(s.exponop(i)).to_int();
+		if (deg >= n) {
+			truncated = true;
+			break;
+		}
+		new_seq.push_back(expair(s.coeffop(i), s.exponop(i)));
+	}
+	if (truncated)
+		new_seq.push_back(expair(Order(_ex1), numeric(n)));
+	return (new pseries(r, new_seq))->setflag(status_flags::dynallocated);
+}
+
+
 /** Implementation of ex::series() for product. This performs series
  *  multiplication when multiplying series.
  *  @see ex::series */
@@ -891,6 +1164,9 @@ ex mul::series(const relational & r, int order, unsigned options) const
 	// holds ldegrees of the series of individual factors
 	std::vector<int> ldegrees;
 	std::vector<bool> ldegree_redo;
+	// holds the expansions of the individual factors computed so far
+	std::vector<series_memo> memos;
+	memos.reserve(seq.size());
 
 	// find minimal degrees
 	const epvector::const_iterator itbeg = seq.begin();
@@ -908,6 +1184,8 @@ ex mul::series(const relational & r, int order, unsigned options) const
 		} else {
 			buf = recombine_pair_to_ex(*it);
 		}
+		memos.push_back(series_memo(buf, r, options));
+		series_memo & memo = memos.back();
 
 		int real_ldegree = 0;
 		bool flag_redo = false;
@@ -922,13 +1200,13 @@ ex mul::series(const relational & r, int order, unsigned options) const
 				int orderloop = 0;
 				do {
 					orderloop++;
-					real_ldegree = buf.series(r, orderloop, options).ldegree(sym);
+					real_ldegree = memo.get(orderloop).ldegree(sym);
 				} while (real_ldegree == orderloop);
 			} else {
 				// Here it is possible that buf does not have a ldegree, therefore
 				// check only if ldegree is negative, otherwise reconsider the case
 				// in the second round.
-				real_ldegree = buf.series(r, 0, options).ldegree(sym);
+				real_ldegree = memo.get(0).ldegree(sym);
 				if (real_ldegree == 0)
 					flag_redo = true;
 			}
@@ -947,18 +1225,13 @@ ex mul::series(const relational & r, int order, unsigned options) const
 		if ( ldegree_redo[j] ) {
 			ex expon = it->coeff;
 			int factor = 1;
-			ex buf;
-			if (expon.info(info_flags::integer)) {
-				buf = it->rest;
+			if (expon.info(info_flags::integer))
 				factor = ex_to<numeric>(expon).to_int();
-			} else {
-				buf = recombine_pair_to_ex(*it);
-			}
 			int real_ldegree = 0;
 			int orderloop = 0;
 			do {
 				orderloop++;
-				real_ldegree = buf.series(r, orderloop, options).ldegree(sym);
+				real_ldegree = memos[j].get(orderloop).ldegree(sym);
 			} while ((real_ldegree == orderloop)
 					&& ( factor*real_ldegree < degbound));
 			ldegrees[j] = factor * real_ldegree;
@@ -977,10 +1250,16 @@ ex mul::series(const relational & r, int order, unsigned options) const
 
 	// Multiply with remaining terms
 	std::vector<int>::const_iterator itd = ldegrees.begin();
-	for (epvector::const_iterator it=itbeg; it!=itend; ++it, ++itd) {
+	j = 0;
+	for (epvector::const_iterator it=itbeg; it!=itend; ++it, ++itd, ++j) {
 
-		// do series expansion with adjusted order
-		ex op = recombine_pair_to_ex(*it).series(r, order-degsum+(*itd), options);
+		// do series expansion with adjusted order, reusing the expansion
+		// from the rounds above if the factor was expanded as a whole
+		ex op;
+		if (it->coeff.is_equal(_ex1))
+			op = memos[j].get(order-degsum+(*itd));
+		else
+			op = recombine_pair_to_ex(*it).series(r, order-degsum+(*itd), options);
 
 		// Series multiplication
 		if (it == itbeg)
@@ -1049,27 +1328,44 @@ ex pseries::power_const(const numeric &p, int deg) const
 	if (seq.size() == 1 && is_order_function(seq[0].rest) && p.real().is_negative())
 		throw pole_error("pseries::power_const(): division by zero",1);
 	
+	// Unpack the coefficients a_0,...,a_{numcoeff-1} of A(x)
+	exvector a(numcoeff);
+	for (epvector::const_iterator it=seq.begin(); it!=seq.end(); ++it) {
+		const int i = ex_to<numeric>(it->coeff).to_int() - ldeg;
+		if (i >= numcoeff)
+			break;
+		a[i] = it->rest;
+	}
+
 	// Compute coefficients of the powered series
 	exvector co;
 	co.reserve(numcoeff);
-	co.push_back(power(coeff(var, ldeg), p));
+	co.push_back(power(a[0], p));
+	exvector terms;
 	for (int i=1; i<numcoeff; ++i) {
-		ex sum = _ex0;
+		check_budget();
+		terms.clear();
+		bool order_found = false;
 		for (int j=1; j<=i; ++j) {
-			ex c = coeff(var, j + ldeg);
+			const ex & c = a[j];
 			if (is_order_function(c)) {
-				co.push_back(Order(_ex1));
+				order_found = true;
 				break;
-			} else
-				sum += (p * j - (i - j)) * co[i - j] * c;
+			} else if (!c.is_zero())
+				terms.push_back((p * j - (i - j)) * co[i - j] * c);
 		}
-		co.push_back(sum / coeff(var, ldeg) / i);
+		if (order_found) {
+			co.push_back(Order(_ex1));
+			break;
+		}
+		ex sum = (new add(terms))->setflag(status_flags::dynallocated);
+		co.push_back(sum / a[0] / i);
 	}
 	
 	// Construct new series (of non-zero coefficients)
 	epvector new_seq;
 	bool higher_order = false;
-	for (int i=0; i<numcoeff; ++i) {
+	for (int i=0; i<int(co.size()); ++i) {
 		if (!co[i].is_zero())
 			new_seq.push_back(expair(co[i], p * ldeg + i));
 		if (is_order_function(co[i])) {
@@ -1084,6 +1380,283 @@ ex pseries::power_const(const numeric &p, int deg) const
 }
 
 
+/** Unpack the coefficients a_0,...,a_{n-1} of a series without negative
+ *  powers, where n is the truncation order deg or the order of the order
+ *  term, whichever is lower.
+ *
+ *  @param a  vector to receive the coefficients
+ *  @param deg  truncation order of series calculation
+ *  @return the number n of coefficients */
+int pseries::taylor_coeffs(exvector & a, int deg) const
+{
+	int numcoeff = deg;
+	for (epvector::const_iterator it=seq.begin(); it!=seq.end(); ++it) {
+		if (is_order_function(it->rest)) {
+			numcoeff = std::min(numcoeff, ex_to<numeric>(it->coeff).to_int());
+			break;
+		}
+	}
+	a.assign(std::max(numcoeff, 0), _ex0);
+	for (epvector::const_iterator it=seq.begin(); it!=seq.end(); ++it) {
+		const int i = ex_to<numeric>(it->coeff).to_int();
+		if (i >= numcoeff)
+			break;
+		a[i] = it->rest;
+	}
+	return numcoeff;
+}
+
+
+/** Compute the exponential of a series without negative powers.
+ *
+ *  @param deg  truncation order of series calculation */
+ex pseries::exp_series(int deg) const
+{
+	// method:
+	// let A(x) = a_0 + a_1*x + a_2*x^2 + ... and C(x) = exp(A(x)).  Then
+	//     C'(x) = A'(x)*C(x)
+	// and comparing coefficients we get the recurrence formula
+	//     c_i = (a_1*c_{i-1} + 2*a_2*c_{i-2} + ... + i*a_i*c_0)/i
+	// starting with c_0 = exp(a_0).
+	if (ldegree(var) < 0)
+		throw std::runtime_error("pseries::exp_series(): essential singularity");
+
+	exvector a;
+	const int numcoeff = taylor_coeffs(a, deg);
+	epvector new_seq;
+	if (numcoeff > 0) {
+		if (is_terminating() && degree(var) == 0) {
+			// a constant, there are no higher orders
+			new_seq.push_back(expair(exp(a[0]), _ex0));
+			return pseries(relational(var,point), new_seq);
+		}
+		exvector co;
+		co.reserve(numcoeff);
+		co.push_back(exp(a[0]));
+		exvector terms;
+		for (int i=1; i<numcoeff; ++i) {
+			terms.clear();
+			for (int j=1; j<=i; ++j)
+				if (!a[j].is_zero())
+					terms.push_back(j * a[j] * co[i - j]);
+			ex sum = (new add(terms))->setflag(status_flags::dynallocated);
+			co.push_back(sum / i);
+		}
+		for (int i=0; i<numcoeff; ++i)
+			if (!co[i].is_zero())
+				new_seq.push_back(expair(co[i], numeric(i)));
+	}
+	new_seq.push_back(expair(Order(_ex1), numeric(numcoeff)));
+	return pseries(relational(var,point), new_seq);
+}
+
+
+/** Compute the logarithm of a series with a nonzero constant term.
+ *
+ *  @param deg  truncation order of series calculation */
+ex pseries::log_series(int deg) const
+{
+	// method:
+	// let A(x) = a_0 + a_1*x + a_2*x^2 + ... and C(x) = log(A(x)).  Then
+	//     C'(x)*A(x) = A'(x)
+	// and comparing coefficients we get the recurrence formula
+	//     c_i = (a_i - (c_1*a_{i-1} + 2*c_2*a_{i-2} + ... + (i-1)*c_{i-1}*a_1)/i)/a_0
+	// starting with c_0 = log(a_0).
+	if (seq.empty() || ldegree(var) != 0 || is_order_function(seq[0].rest))
+		throw std::runtime_error("pseries::log_series(): logarithmic singularity");
+
+	exvector a;
+	const int numcoeff = taylor_coeffs(a, deg);
+	epvector new_seq;
+	if (numcoeff > 0) {
+		if (is_terminating() && degree(var) == 0) {
+			// a constant, there are no higher orders
+			new_seq.push_back(expair(log(a[0]), _ex0));
+			return pseries(relational(var,point), new_seq);
+		}
+		exvector co;
+		co.reserve(numcoeff);
+		co.push_back(log(a[0]));
+		exvector terms;
+		for (int i=1; i<numcoeff; ++i) {
+			terms.clear();
+			for (int j=1; j<i; ++j)
+				if (!a[i - j].is_zero() && !co[j].is_zero())
+					terms.push_back(j * co[j] * a[i - j]);
+			ex sum = (new add(terms))->setflag(status_flags::dynallocated);
+			co.push_back((a[i] - sum / i) / a[0]);
+		}
+		for (int i=0; i<numcoeff; ++i)
+			if (!co[i].is_zero())
+				new_seq.push_back(expair(co[i], numeric(i)));
+	}
+	new_seq.push_back(expair(Order(_ex1), numeric(numcoeff)));
+	return pseries(relational(var,point), new_seq);
+}
+
+
+/** Assemble a series from the coefficients c_0,...,c_{n-1} of a function of
+ *  this series, with an order term at n. */
+ex pseries::from_taylor_coeffs(const exvector & co, int numcoeff) const
+{
+	epvector new_seq;
+	for (int i=0; i<numcoeff; ++i)
+		if (!co[i].is_zero())
+			new_seq.push_back(expair(co[i], numeric(i)));
+	new_seq.push_back(expair(Order(_ex1), numeric(numcoeff)));
+	return pseries(relational(var,point), new_seq);
+}
+
+
+/** Compute the coefficients of sin(A(x)) and cos(A(x)), or of sinh(A(x))
+ *  and cosh(A(x)), for a series A(x) without negative powers.
+ *
+ *  @param s  vector to receive the coefficients of the sine
+ *  @param c  vector to receive the coefficients of the cosine
+ *  @param deg  truncation order of series calculation
+ *  @param hyperbolic  whether to compute sinh and cosh instead
+ *  @return the number of coefficients */
+int pseries::sincos_coeffs(exvector & s, exvector & c, int deg, bool hyperbolic) const
+{
+	// method:
+	// let S(x) = sin(A(x)) and C(x) = cos(A(x)).  Then
+	//     S'(x) = A'(x)*C(x),  C'(x) = -A'(x)*S(x)
+	// and comparing coefficients we get the coupled recurrences
+	//     s_i = (a_1*c_{i-1} + 2*a_2*c_{i-2} + ... + i*a_i*c_0)/i
+	//     c_i = -(a_1*s_{i-1} + 2*a_2*s_{i-2} + ... + i*a_i*s_0)/i
+	// starting with s_0 = sin(a_0) and c_0 = cos(a_0).  For sinh and cosh,
+	// the sign of c_i is positive.
+	exvector a;
+	const int numcoeff = taylor_coeffs(a, deg);
+	s.clear();
+	c.clear();
+	if (numcoeff <= 0)
+		return numcoeff;
+	s.reserve(numcoeff);
+	c.reserve(numcoeff);
+	s.push_back(hyperbolic ? sinh(a[0]) : sin(a[0]));
+	c.push_back(hyperbolic ? cosh(a[0]) : cos(a[0]));
+	exvector sterms, cterms;
+	for (int i=1; i<numcoeff; ++i) {
+		sterms.clear();
+		cterms.clear();
+		for (int j=1; j<=i; ++j) {
+			if (a[j].is_zero())
+				continue;
+			if (!c[i - j].is_zero())
+				sterms.push_back(j * a[j] * c[i - j]);
+			if (!s[i - j].is_zero())
+				cterms.push_back(j * a[j] * s[i - j]);
+		}
+		ex ssum = (new add(sterms))->setflag(status_flags::dynallocated);
+		ex csum = (new add(cterms))->setflag(status_flags::dynallocated);
+		s.push_back(ssum / i);
+		c.push_back(hyperbolic ? csum / i : -csum / i);
+	}
+	return numcoeff;
+}
+
+
+/** Compute the sine of a series without negative powers.
+ *
+ *  @param deg  truncation order of series calculation */
+ex pseries::sin_series(int deg) const
+{
+	if (ldegree(var) < 0)
+		throw std::runtime_error("pseries::sin_series(): essential singularity");
+	exvector s, c;
+	const int numcoeff = sincos_coeffs(s, c, deg, false);
+	return from_taylor_coeffs(s, numcoeff);
+}
+
+
+/** Compute the cosine of a series without negative powers.
+ *
+ *  @param deg  truncation order of series calculation */
+ex pseries::cos_series(int deg) const
+{
+	if (ldegree(var) < 0)
+		throw std::runtime_error("pseries::cos_series(): essential singularity");
+	exvector s, c;
+	const int numcoeff = sincos_coeffs(s, c, deg, false);
+	return from_taylor_coeffs(c, numcoeff);
+}
+
+
+/** Compute the hyperbolic sine of a series without negative powers.
+ *
+ *  @param deg  truncation order of series calculation */
+ex pseries::sinh_series(int deg) const
+{
+	if (ldegree(var) < 0)
+		throw std::runtime_error("pseries::sinh_series(): essential singularity");
+	exvector s, c;
+	const int numcoeff = sincos_coeffs(s, c, deg, true);
+	return from_taylor_coeffs(s, numcoeff);
+}
+
+
+/** Compute the hyperbolic cosine of a series without negative powers.
+ *
+ *  @param deg  truncation order of series calculation */
+ex pseries::cosh_series(int deg) const
+{
+	if (ldegree(var) < 0)
+		throw std::runtime_error("pseries::cosh_series(): essential singularity");
+	exvector s, c;
+	const int numcoeff = sincos_coeffs(s, c, deg, true);
+	return from_taylor_coeffs(c, numcoeff);
+}
+
+
+/** Compute the arc tangent of a series without negative powers whose
+ *  constant term is not I or -I.
+ *
+ *  @param deg  truncation order of series calculation */
+ex pseries::atan_series(int deg) const
+{
+	// method:
+	// let A(x) = a_0 + a_1*x + a_2*x^2 + ..., B(x) = 1 + A(x)^2 and
+	// C(x) = atan(A(x)).  Then
+	//     C'(x)*B(x) = A'(x)
+	// and comparing coefficients we get the recurrence formula
+	//     c_i = (i*a_i - (c_1*b_{i-1} + 2*c_2*b_{i-2} + ... + (i-1)*c_{i-1}*b_1))/(i*b_0)
+	// starting with c_0 = atan(a_0).
+	if (ldegree(var) < 0)
+		throw std::runtime_error("pseries::atan_series(): pole");
+
+	exvector a;
+	const int numcoeff = taylor_coeffs(a, deg);
+	exvector b(std::max(numcoeff, 0));
+	exvector terms;
+	for (int k=0; k<numcoeff; ++k) {
+		terms.clear();
+		if (k == 0)
+			terms.push_back(_ex1);
+		for (int j=0; j<=k; ++j)
+			if (!a[j].is_zero() && !a[k - j].is_zero())
+				terms.push_back(a[j] * a[k - j]);
+		b[k] = (new add(terms))->setflag(status_flags::dynallocated);
+	}
+	if (numcoeff > 0 && b[0].expand().is_zero())
+		throw std::runtime_error("pseries::atan_series(): pole");
+
+	exvector co;
+	co.reserve(numcoeff);
+	if (numcoeff > 0)
+		co.push_back(atan(a[0]));
+	for (int i=1; i<numcoeff; ++i) {
+		terms.clear();
+		for (int j=1; j<i; ++j)
+			if (!b[i - j].is_zero() && !co[j].is_zero())
+				terms.push_back(j * co[j] * b[i - j]);
+		ex sum = (new add(terms))->setflag(status_flags::dynallocated);
+		co.push_back((i * a[i] - sum) / (i * b[0]));
+	}
+	return from_taylor_coeffs(co, numcoeff);
+}
+
+
 /** Return a new pseries object with the powers shifted by deg. */
 pseries pseries::shift_exponents(int deg) const
 {
@@ -1291,6 +1864,9 @@ ex integral::series(const relational & r, int order, unsigned options) const
  *  @return an expression holding a pseries object */
 ex ex::series(const ex & r, int order, unsigned options) const
 {
+	profile_timer timer(profile_series);
+	trace_scope trace("series", "order", order);
+	check_budget();
 	ex e;
 	relational rel_;
 	
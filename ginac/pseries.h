@@ -43,6 +43,8 @@ public:
 	// functions overriding virtual functions from base classes
 public:
 	unsigned precedence() const {return 38;} // for clarity just below add::precedence
+	std::size_t footprint() const { return object_size() + seq.capacity() * sizeof(expair); }
+	void stored_operands(exvector & v) const;
 	size_t nops() const;
 	ex op(size_t i) const;
 	int degree(const ex &s) const;
@@ -99,6 +101,13 @@ public:
 	ex mul_const(const numeric &other) const;
 	ex mul_series(const pseries &other) const;
 	ex power_const(const numeric &p, int deg) const;
+	ex exp_series(int deg) const;
+	ex log_series(int deg) const;
+	ex sin_series(int deg) const;
+	ex cos_series(int deg) const;
+	ex sinh_series(int deg) const;
+	ex cosh_series(int deg) const;
+	ex atan_series(int deg) const;
 	pseries shift_exponents(int deg) const;
 
 protected:
@@ -108,6 +117,11 @@ protected:
 	void do_print_tree(const print_tree & c, unsigned level) const;
 	void do_print_python(const print_python & c, unsigned level) const;
 	void do_print_python_repr(const print_python_repr & c, unsigned level) const;
+	bool is_dense() const;
+	void dense_coeffs(exvector & c) const;
+	int taylor_coeffs(exvector & a, int deg) const;
+	int sincos_coeffs(exvector & s, exvector & c, int deg, bool hyperbolic) const;
+	ex from_taylor_coeffs(const exvector & co, int numcoeff) const;
 
 protected:
 	/** Vector of {coefficient, power} pairs */
@@ -142,6 +156,15 @@ inline bool is_terminating(const pseries & s)
 	return s.is_terminating();
 }
 
+/** Set the number of threads add::series() may use for expanding the terms
+ *  of large sums.  The default of 1 means that no threads are started.
+ *
+ *  @return previous setting */
+unsigned set_series_threads(unsigned n);
+
+/** Number of threads add::series() may use for expanding terms. */
+unsigned get_series_threads();
+
 } // namespace GiNaC
 
 #endif // ndef GINAC_SERIES_H
@@ -29,16 +29,30 @@
 #include <functional>
 #include <iosfwd>
 
+#if defined(GINAC_THREADSAFE_REFCOUNT) && !defined(__GNUC__)
+#error "GINAC_THREADSAFE_REFCOUNT requires a compiler with GCC-style __sync builtins"
+#endif
+
 namespace GiNaC {
 
-/** Base class for reference-counted objects. */
+/** Base class for reference-counted objects.
+ *
+ *  If GINAC_THREADSAFE_REFCOUNT is defined (both when building the library
+ *  and when compiling code using it) the reference counter is updated with
+ *  atomic instructions, so objects may be shared between threads. */
 class refcounted {
 public:
 	refcounted() throw() : refcount(0) {}
 
+#ifdef GINAC_THREADSAFE_REFCOUNT
+	unsigned int add_reference() throw() { return __sync_add_and_fetch(&refcount, 1); }
+	unsigned int remove_reference() throw() { return __sync_sub_and_fetch(&refcount, 1); }
+	unsigned int get_refcount() const throw() { return __sync_add_and_fetch(const_cast<unsigned int *>(&refcount), 0); }
+#else
 	unsigned int add_reference() throw() { return ++refcount; }
 	unsigned int remove_reference() throw() { return --refcount; }
 	unsigned int get_refcount() const throw() { return refcount; }
+#endif
 	void set_refcount(unsigned int r) throw() { refcount = r; }
 
 private:
@@ -56,9 +70,10 @@ private:
 template <class T> class ptr {
 	friend class std::less< ptr<T> >;
 
-	// NB: This implementation of reference counting is not thread-safe.
-	// The reference counter needs to be incremented/decremented atomically,
-	// and makewritable() requires locking.
+	// NB: Unless GINAC_THREADSAFE_REFCOUNT is defined, this implementation
+	// of reference counting is not thread-safe.  Even then, a single ptr
+	// object must not be modified by several threads at once; it is only
+	// the pointee which may be shared.
 
 public:
     // no default ctor: a ptr is never unbound
@@ -102,7 +117,10 @@ public:
 		if (p->get_refcount() > 1) {
 			T *p2 = p->duplicate();
 			p2->set_refcount(1);
-			p->remove_reference();
+			// NB: Other owners may have dropped their references while we
+			// were copying, so we might have been the last one after all.
+			if (p->remove_reference() == 0)
+				delete p;
 			p = p2;
 		}
 	}
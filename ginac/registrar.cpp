@@ -28,4 +28,6 @@
 
 namespace GiNaC {
 
+unsigned registered_class_options::print_func_generation = 0;
+
 } // namespace GiNaC
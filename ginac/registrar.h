@@ -81,7 +81,20 @@ class registered_class_options {
 public:
 	registered_class_options(const char *n, const char *p, 
 		                 const std::type_info& ti)
-	 : name(n), parent_name(p), tinfo_key(&ti) { }
+	 : name(n), parent_name(p), tinfo_key(&ti), resolved_print_table(0) { }
+
+	/** Print methods of a class for all print_context classes, by their
+	 *  ID, found by looking up the print methods of the parent contexts
+	 *  and parent classes where necessary (see basic::print_dispatch()).
+	 *  The table is valid while no print method of any class is changed,
+	 *  i.e. while generation equals print_func_generation. */
+	struct resolved_print_funcs {
+		unsigned generation;
+		std::vector<const print_functor *> funcs;
+	};
+
+	/** Number of changes of print methods of all classes so far. */
+	static unsigned print_func_generation;
 
 	const char *get_name() const { return name; }
 	const char *get_parent_name() const { return parent_name; }
@@ -114,13 +127,18 @@ public:
 		if (id >= print_dispatch_table.size())
 			print_dispatch_table.resize(id + 1);
 		print_dispatch_table[id] = f;
+		++print_func_generation;
 	}
 
+	const resolved_print_funcs *get_resolved_print_funcs() const { return resolved_print_table; }
+	void set_resolved_print_funcs(const resolved_print_funcs *t) const { resolved_print_table = t; }
+
 private:
 	const char *name;         /**< Class name. */
 	const char *parent_name;  /**< Name of superclass. */
 	std::type_info const* tinfo_key;        /**< Type information key. */
 	std::vector<print_functor> print_dispatch_table; /**< Method table for print() dispatch */
+	mutable const resolved_print_funcs *resolved_print_table; /**< Cached lookups of print_dispatch_table */
 };
 
 typedef class_info<registered_class_options> registered_class_info;
@@ -137,6 +155,7 @@ public: \
 	virtual const GiNaC::registered_class_info &get_class_info() const { return classname::get_class_info_static(); } \
 	virtual GiNaC::registered_class_info &get_class_info() { return classname::get_class_info_static(); } \
 	virtual const char *class_name() const { return classname::get_class_info_static().options.get_name(); } \
+	virtual std::size_t object_size() const { return sizeof(classname); } \
 	class visitor { \
 	public: \
 		virtual void visit(const classname &) = 0; \
@@ -22,13 +22,90 @@
  */
 
 #include "function.h"
+#include "archive.h"
+#include "lst.h"
+#include "numeric.h"
+#include "tasks.h"
+#include "tostring.h"
 #include "utils.h"
 #include "remember.h"
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
 
+#include <ostream>
 #include <stdexcept>
+#if defined(GINAC_THREADSAFE_REFCOUNT) && defined(HAVE_PTHREAD_H)
+#include <pthread.h>
+#endif
+
+#ifdef GINAC_THREADSAFE_REFCOUNT
+#define GINAC_REMEMBER_THREAD_LOCAL __thread
+#else
+#define GINAC_REMEMBER_THREAD_LOCAL
+#endif
 
 namespace GiNaC {
 
+namespace {
+
+/** The remember tables of one thread, by function serial.  Must be a POD,
+ *  so it can be thread-local. */
+struct thread_tables {
+	std::vector<remember_table> * eval_tables;
+	std::vector<remember_table> * evalf_tables;
+	/** Estimated number of bytes held by the tables. */
+	std::size_t memory;
+	/** Table in which the memory limit evicts the next entry. */
+	std::size_t next_eviction;
+};
+
+GINAC_REMEMBER_THREAD_LOCAL thread_tables the_tables;
+
+#if defined(GINAC_THREADSAFE_REFCOUNT) && defined(HAVE_PTHREAD_H)
+pthread_key_t tables_key;
+pthread_once_t tables_key_once = PTHREAD_ONCE_INIT;
+
+void delete_tables(void * p)
+{
+	thread_tables * t = static_cast<thread_tables *>(p);
+	delete t->eval_tables;
+	delete t->evalf_tables;
+	t->eval_tables = t->evalf_tables = 0;
+	t->memory = 0;
+}
+
+void create_tables_key()
+{
+	pthread_key_create(&tables_key, delete_tables);
+}
+
+void release_tables()
+{
+	delete_tables(&the_tables);
+}
+#endif
+
+/** The tables of the calling thread.  Those of other threads are deleted
+ *  when the thread exits (workers: when the task is done), those of the main thread never, because
+ *  functions may still be evaluated during static destruction. */
+thread_tables & tables()
+{
+	thread_tables & t = the_tables;
+	if (!t.eval_tables) {
+		t.eval_tables = new std::vector<remember_table>;
+		t.evalf_tables = new std::vector<remember_table>;
+#if defined(GINAC_THREADSAFE_REFCOUNT) && defined(HAVE_PTHREAD_H)
+		pthread_once(&tables_key_once, create_tables_key);
+		pthread_setspecific(tables_key, &t);
+		at_task_end(release_tables);
+#endif
+	}
+	return t;
+}
+
+} // anonymous namespace
+
 //////////
 // class remember_table_entry
 //////////
@@ -36,7 +113,7 @@ namespace GiNaC {
 remember_table_entry::remember_table_entry(function const & f, ex const & r)
   : hashvalue(f.gethash()), seq(f.seq), result(r)
 {
-	++last_access = access_counter;
+	last_access = ++access_counter;
 	successful_hits = 0;
 }
 
@@ -47,11 +124,21 @@ bool remember_table_entry::is_equal(function const & f) const
 	size_t num = seq.size();
 	for (size_t i=0; i<num; ++i)
 		if (!seq[i].is_equal(f.seq[i])) return false;
-	++last_access = access_counter;
+	last_access = ++access_counter;
 	++successful_hits;
 	return true;
 }
 
+/** Estimate of the bytes held by the entry in a remember_table_list: the
+ *  entry, its list and index nodes and its arguments (but not the
+ *  expressions, which are shared). */
+std::size_t remember_table_entry::memory_used() const
+{
+	return sizeof(remember_table_entry) + 2*sizeof(void *)
+	     + sizeof(std::pair<const unsigned, std::list<remember_table_entry>::iterator>) + 4*sizeof(void *)
+	     + seq.capacity()*sizeof(ex);
+}
+
 unsigned long remember_table_entry::access_counter = 0;
 
 //////////
@@ -62,8 +149,114 @@ remember_table_list::remember_table_list(unsigned as, unsigned strat)
 {
 	max_assoc_size = as;
 	remember_strategy = strat;
+	memory = 0;
+}
+
+remember_table_list::remember_table_list(const remember_table_list & other)
+  : std::list<remember_table_entry>(other),
+    max_assoc_size(other.max_assoc_size), remember_strategy(other.remember_strategy)
+{
+	rebuild_index();
 }
 
+remember_table_list & remember_table_list::operator=(const remember_table_list & other)
+{
+	if (this != &other) {
+		std::list<remember_table_entry>::operator=(other);
+		max_assoc_size = other.max_assoc_size;
+		remember_strategy = other.remember_strategy;
+		rebuild_index();
+	}
+	return *this;
+}
+
+/** Recreate the index and the groups of hits after copying the entries. */
+void remember_table_list::rebuild_index()
+{
+	index.clear();
+	hits_groups.clear();
+	memory = 0;
+	for (iterator it = begin(); it != end(); ++it) {
+		index.insert(std::make_pair(it->hashvalue, it));
+		memory += it->memory_used();
+		if (remember_strategy == remember_strategies::delete_lfu) {
+			if (hits_groups.empty() || hits_groups.back().hits != it->successful_hits) {
+				remember_table_hits_group g;
+				g.hits = it->successful_hits;
+				hits_groups.push_back(g);
+			}
+			hits_groups.back().last = it;
+			it->hits_group = --hits_groups.end();
+		}
+	}
+}
+
+/** Delete the first entry, which is the one the strategy discards. */
+void remember_table_list::remove_first()
+{
+	iterator victim = begin();
+	std::multimap<unsigned, iterator>::iterator i = index.lower_bound(victim->hashvalue);
+	while (i->second != victim)
+		++i;
+	index.erase(i);
+	memory -= victim->memory_used();
+	if (remember_strategy == remember_strategies::delete_lfu && victim->hits_group->last == victim)
+		hits_groups.erase(victim->hits_group);
+	erase(victim);
+}
+
+/** Move an entry that was found to its new place. */
+void remember_table_list::record_hit(iterator it) const
+{
+	remember_table_list & self = const_cast<remember_table_list &>(*this);
+
+	switch (remember_strategy) {
+	case remember_strategies::delete_lru:
+		self.splice(self.end(), self, it);
+		break;
+	case remember_strategies::delete_lfu: {
+		std::list<remember_table_hits_group>::iterator g = it->hits_group, next = g;
+		++next;
+
+		// Take the entry out of its group
+		bool alone = false;
+		if (g->last == it) {
+			if (it == self.begin()) {
+				alone = true;
+			} else {
+				iterator prev = it;
+				--prev;
+				if (prev->hits_group == g)
+					g->last = prev;
+				else
+					alone = true;
+			}
+		}
+
+		// Put it at the end of the group of the next number of hits
+		if (next != hits_groups.end() && next->hits == it->successful_hits) {
+			iterator pos = next->last;
+			self.splice(++pos, self, it);
+			next->last = it;
+			it->hits_group = next;
+		} else {
+			remember_table_hits_group ng;
+			ng.hits = it->successful_hits;
+			ng.last = it;
+			if (!alone) {
+				iterator pos = g->last;
+				self.splice(++pos, self, it);
+			}
+			it->hits_group = hits_groups.insert(next, ng);
+		}
+		if (alone)
+			hits_groups.erase(g);
+		break;
+	}
+	default:
+		break;
+	}
+}
 
 void remember_table_list::add_entry(function const & f, ex const & result)
 {
@@ -74,60 +267,52 @@ void remember_table_list::add_entry(function const & f, ex const & result)
 		GINAC_ASSERT(size()>0); // there must be at least one entry
 		
 		switch (remember_strategy) {
-		case remember_strategies::delete_cyclic: {
-			// delete oldest entry (first in list)
-			erase(begin());
-			break;
-		}
-		case remember_strategies::delete_lru: {
-			// delete least recently used entry
-			iterator it = begin();
-			iterator lowest_access_it = it;
-			unsigned long lowest_access = (*it).get_last_access();
-			++it;
-			while (it!=end()) {
-				if ((*it).get_last_access()<lowest_access) {
-					lowest_access = (*it).get_last_access();
-					lowest_access_it = it;
-				}
-				++it;
-			}
-			erase(lowest_access_it);
-			break;
-		}
-		case remember_strategies::delete_lfu: {
-			// delete least frequently used entry
-			iterator it = begin();
-			iterator lowest_hits_it = it;
-			unsigned lowest_hits = (*it).get_successful_hits();
-			++it;
-			while (it!=end()) {
-				if ((*it).get_successful_hits()<lowest_hits) {
-					lowest_hits = (*it).get_successful_hits();
-					lowest_hits_it = it;
-				}
-				++it;
-			}
-			erase(lowest_hits_it);
+		case remember_strategies::delete_cyclic:
+		case remember_strategies::delete_lru:
+		case remember_strategies::delete_lfu:
+			// the oldest, least recently or least frequently used
+			// entry comes first
+			remove_first();
 			break;
-		}
 		default:
 			throw(std::logic_error("remember_table_list::add_entry(): invalid remember_strategy"));
         }
 		GINAC_ASSERT(size()==max_assoc_size-1);
 	}
-	push_back(remember_table_entry(f,result));
+
+	// New entries have no hits and go to the end of the first group
+	iterator pos = end();
+	std::list<remember_table_hits_group>::iterator g = hits_groups.begin();
+	if (remember_strategy == remember_strategies::delete_lfu) {
+		if (g == hits_groups.end() || g->hits != 0) {
+			remember_table_hits_group ng;
+			ng.hits = 0;
+			g = hits_groups.insert(g, ng);
+			pos = begin();
+		} else {
+			pos = g->last;
+			++pos;
+		}
+	}
+	iterator it = insert(pos, remember_table_entry(f,result));
+	index.insert(std::make_pair(it->hashvalue, it));
+	memory += it->memory_used();
+	if (remember_strategy == remember_strategies::delete_lfu) {
+		g->last = it;
+		it->hits_group = g;
+	}
 }
 
 bool remember_table_list::lookup_entry(function const & f, ex & result) const
 {
-	const_iterator i = begin(), iend = end();
-	while (i != iend) {
-		if (i->is_equal(f)) {
-			result = i->get_result();
+	typedef std::multimap<unsigned, iterator>::const_iterator index_iterator;
+	std::pair<index_iterator, index_iterator> range = index.equal_range(f.gethash());
+	for (index_iterator i = range.first; i != range.second; ++i) {
+		if (i->second->is_equal(f)) {
+			result = i->second->get_result();
+			record_hit(i->second);
 			return true;
 		}
-		++i;
 	}
 	return false;
 }
@@ -137,6 +322,8 @@ bool remember_table_list::lookup_entry(function const & f, ex & result) const
 //////////
 
 remember_table::remember_table()
+  : lookups(0), hits(0), evictions(0), entries(0), memory(0), next_eviction(0),
+    generation(0)
 {
 	table_size=0;
 	max_assoc_size=0;
@@ -144,7 +331,9 @@ remember_table::remember_table()
 }
 
 remember_table::remember_table(unsigned s, unsigned as, unsigned strat)
-  : max_assoc_size(as), remember_strategy(strat)
+  : max_assoc_size(as), remember_strategy(strat),
+    lookups(0), hits(0), evictions(0), entries(0), memory(0), next_eviction(0),
+    generation(0)
 {
 	// we keep max_assoc_size and remember_strategy if we need to clear
 	// all entries
@@ -158,22 +347,204 @@ bool remember_table::lookup_entry(function const & f, ex & result) const
 {
 	unsigned entry = f.gethash() & (table_size-1);
 	GINAC_ASSERT(entry<size());
-	return operator[](entry).lookup_entry(f,result);
+	++lookups;
+	if (!operator[](entry).lookup_entry(f,result))
+		return false;
+	++hits;
+	return true;
 }
 
 void remember_table::add_entry(function const & f, ex const & result)
 {
 	unsigned entry = f.gethash() & (table_size-1);
 	GINAC_ASSERT(entry<size());
-	operator[](entry).add_entry(f,result);
+	remember_table_list & l = operator[](entry);
+	const std::size_t old_size = l.size(), old_memory = l.memory_used();
+	l.add_entry(f,result);
+	evictions += old_size + 1 - l.size();
+	entries += l.size() - old_size;
+	memory = memory - old_memory + l.memory_used();
+	std::size_t & total_memory = tables().memory;
+	total_memory = total_memory - old_memory + l.memory_used();
+	if (memory_limit != 0 && total_memory > memory_limit)
+		enforce_memory_limit();
 }        
 
 void remember_table::clear_all_entries()
 {
-	clear();
+	discard_entries();
+	init_table();
+}
+
+/** Change the geometry of the table (as in the constructor), which
+ *  discards all entries but keeps the statistics.  A size of 0 leaves no
+ *  slots at all, so that nothing can be stored. */
+void remember_table::reorganize(unsigned s, unsigned as, unsigned strat)
+{
+	discard_entries();
+	table_size = s ? 1 << log2(s) : 0;
+	max_assoc_size = as;
+	remember_strategy = strat;
 	init_table();
 }
 
+remember_table_statistics remember_table::statistics() const
+{
+	remember_table_statistics s;
+	s.lookups = lookups;
+	s.hits = hits;
+	s.evictions = evictions;
+	s.entries = entries;
+	s.memory = memory;
+	return s;
+}
+
+void remember_table::show_statistics(std::ostream & os, unsigned level) const
+{
+	os << "lookups: " << lookups << ", hits: " << hits
+	   << ", evictions: " << evictions << ", entries: " << entries
+	   << ", memory: " << memory << " bytes" << std::endl;
+	if (level > 0) {
+		for (unsigned i=0; i<size(); ++i)
+			os << "slot " << i << ": " << operator[](i).size() << " entries" << std::endl;
+	}
+}
+
+void remember_table::discard_entries()
+{
+	tables().memory -= memory;
+	memory = 0;
+	entries = 0;
+	next_eviction = 0;
+	clear();
+}
+
+/** Delete the entry that the strategy discards first in the next slot
+ *  (from next_eviction on, cyclically) that has one.  Returns false if the
+ *  table is empty. */
+bool remember_table::evict_one()
+{
+	if (entries == 0)
+		return false;
+	for (unsigned i=0; i<table_size; ++i) {
+		unsigned slot = (next_eviction + i) & (table_size-1);
+		remember_table_list & l = operator[](slot);
+		if (l.empty())
+			continue;
+		const std::size_t old_memory = l.memory_used();
+		l.remove_first();
+		++evictions;
+		--entries;
+		memory -= old_memory - l.memory_used();
+		tables().memory -= old_memory - l.memory_used();
+		next_eviction = (slot + 1) & (table_size-1);
+		return true;
+	}
+	return false;
+}
+
+/** Evict entries from all tables (of eval() and evalf() results) of the
+ *  calling thread in turn until the memory used by them is within the
+ *  limit. */
+void remember_table::enforce_memory_limit()
+{
+	thread_tables & tt = tables();
+	std::size_t & next_table = tt.next_eviction;
+	std::vector<remember_table> & rt = *tt.eval_tables;
+	std::vector<remember_table> & et = *tt.evalf_tables;
+	const std::size_t num_tables = rt.size() + et.size();
+	std::size_t idle = 0;
+	while (tt.memory > memory_limit && idle < num_tables) {
+		if (next_table >= num_tables)
+			next_table = 0;
+		remember_table & t = next_table < rt.size() ? rt[next_table] : et[next_table - rt.size()];
+		++next_table;
+		if (t.evict_one())
+			idle = 0;
+		else
+			++idle;
+	}
+}
+
+/** Limit the memory held by all remember tables together to about the
+ *  given number of bytes, evicting entries if necessary (0 means no
+ *  limit). */
+void remember_table::set_memory_limit(std::size_t bytes)
+{
+	memory_limit = bytes;
+	if (memory_limit != 0 && tables().memory > memory_limit)
+		enforce_memory_limit();
+}
+
+std::size_t remember_table::get_memory_used()
+{
+	return tables().memory;
+}
+
+/** Append the entries of the tables of eval() or evalf() results of the
+ *  calling thread to sections, one section "remember <name> <nparams>" or
+ *  "evalf_remember <name> <nparams>" per function, holding a list of
+ *  lst(lst(arguments), result) written by serialize(), see save_caches(). */
+void remember_table::save_tables(bool evalf, const lst & syms,
+                                 std::vector<std::pair<std::string, std::string> > & sections)
+{
+	std::vector<remember_table> & rt = evalf ? evalf_remember_tables() : remember_tables();
+	const function_registry & rf = function::registered_functions();
+	for (unsigned serial=0; serial<rt.size(); ++serial) {
+		if (rt[serial].entries == 0)
+			continue;
+		// Entries of tables for outdated options are discarded here
+		const remember_table & t = evalf ? evalf_remember_table_of(serial) : remember_table_of(serial);
+		if (t.entries == 0)
+			continue;
+		lst entries;
+		for (const_iterator i=t.begin(); i!=t.end(); ++i) {
+			for (remember_table_list::const_iterator j=i->begin(); j!=i->end(); ++j) {
+				const exvector & args = j->get_arguments();
+				entries.append(lst(lst(args.begin(), args.end()), j->get_result()));
+			}
+		}
+		std::string buf;
+		serialize(entries, buf, syms);
+		sections.push_back(std::make_pair((evalf ? "evalf_remember " : "remember ")
+		                                  + std::string(rf.name(serial)) + " "
+		                                  + ToString(rf.nparams(serial)), buf));
+	}
+}
+
+/** Add the entries written by save_tables() for the function with the given
+ *  name and number of parameters to the table of the calling thread, as
+ *  far as the table takes them.  Unknown functions are ignored. */
+void remember_table::load_table(bool evalf, const std::string & name, unsigned nparams,
+                                const std::string & buf, lst & syms)
+{
+	unsigned serial;
+	try {
+		serial = function::find_function(name, nparams);
+	} catch (const std::runtime_error &) {
+		return;
+	}
+	const ex entries = deserialize(buf, syms);
+	if (!is_a<lst>(entries))
+		throw std::runtime_error("load_caches(): invalid remember table of " + name);
+	remember_table & t = evalf ? evalf_remember_table_of(serial) : remember_table_of(serial);
+	if (t.table_size == 0)
+		return;
+	for (std::size_t i=0; i<entries.nops(); ++i) {
+		const ex & e = entries.op(i);
+		if (!is_a<lst>(e) || e.nops() != 2 || !is_a<lst>(e.op(0)) || e.op(0).nops() != nparams)
+			throw std::runtime_error("load_caches(): invalid remember table of " + name);
+		const ex arglist = e.op(0);
+		const exvector args(arglist.begin(), arglist.end());
+		const function f(serial, args);
+		ex result;
+		if (!t[f.gethash() & (t.table_size-1)].lookup_entry(f, result))
+			t.add_entry(f, e.op(1));
+	}
+}
+
+std::size_t remember_table::memory_limit = 0;
+
 void remember_table::init_table()
 {
 	reserve(table_size);
@@ -181,10 +552,75 @@ void remember_table::init_table()
 		push_back(remember_table_list(max_assoc_size,remember_strategy));
 }
 
+/** Tables of the results of function::eval() of the calling thread, by
+ *  function serial (only as far as they have been used). */
 std::vector<remember_table> & remember_table::remember_tables()
 {
-	static std::vector<remember_table> rt = std::vector<remember_table>();
-	return rt;
+	return *tables().eval_tables;
+}
+
+/** Tables of the results of function::evalf() of the calling thread, by
+ *  function serial (only as far as they have been used). */
+std::vector<remember_table> & remember_table::evalf_remember_tables()
+{
+	return *tables().evalf_tables;
+}
+
+/** The table of function::eval() results of a function in the calling
+ *  thread, (re)built from its options if necessary. */
+remember_table & remember_table::remember_table_of(unsigned serial)
+{
+	std::vector<remember_table> & rt = remember_tables();
+	if (serial >= rt.size())
+		rt.resize(serial + 1);
+	remember_table & t = rt[serial];
+	const function_options & opt = function::registered_functions()[serial];
+	if (t.generation != opt.remember_generation) {
+		t.reorganize(opt.use_remember ? opt.remember_size : 0,
+		             opt.remember_assoc_size, opt.remember_strategy);
+		t.generation = opt.remember_generation;
+	}
+	return t;
+}
+
+/** The table of function::evalf() results of a function in the calling
+ *  thread, (re)built from its options if necessary. */
+remember_table & remember_table::evalf_remember_table_of(unsigned serial)
+{
+	// Digits may not exist yet while functions are registered, so the
+	// callback is only added when the first table is used
+	static bool callback_added = false;
+	if (!callback_added) {
+		Digits.add_callback(forget_evalf_results);
+		callback_added = true;
+	}
+
+	std::vector<remember_table> & rt = evalf_remember_tables();
+	if (serial >= rt.size())
+		rt.resize(serial + 1);
+	remember_table & t = rt[serial];
+	const function_options & opt = function::registered_functions()[serial];
+	if (t.generation != opt.evalf_remember_generation) {
+		t.reorganize(opt.use_evalf_remember ? opt.evalf_remember_size : 0,
+		             opt.evalf_remember_assoc_size, opt.evalf_remember_strategy);
+		t.generation = opt.evalf_remember_generation;
+	}
+	return t;
+}
+
+/** Digits callback which makes the tables of evalf() results of all threads
+ *  forget their entries. */
+void remember_table::forget_evalf_results(long digitsdiff)
+{
+	if (digitsdiff == 0)
+		return;
+	function_registry & rf = function::registered_functions();
+	// Options which haven't been built yet have no remembered results
+	for (std::size_t i=0; i<rf.size(); ++i) {
+		function_options * opt = rf.built(i);
+		if (opt && opt->use_evalf_remember)
+			++opt->evalf_remember_generation;
+	}
 }
 
 } // namespace GiNaC
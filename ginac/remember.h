@@ -24,14 +24,28 @@
 #ifndef GINAC_REMEMBER_H
 #define GINAC_REMEMBER_H
 
+#include <cstddef>
 #include <iosfwd>
 #include <list>
+#include <map>
+#include <string>
+#include <utility>
 #include <vector>
 
 namespace GiNaC {
 
 class function;
 class ex;
+class remember_table_entry;
+struct remember_table_statistics;
+
+/** Entries of one remember table list with the same number of successful
+ *  hits (used for the least frequently used strategy). */
+struct remember_table_hits_group {
+	unsigned hits;
+	/** Last entry of the group in the list. */
+	std::list<remember_table_entry>::iterator last;
+};
 	
 /** A single entry in the remember table of a function.
  *  Needs to be a friend of class function to access 'seq'.
@@ -41,29 +55,61 @@ class remember_table_entry {
 public:
 	remember_table_entry(function const & f, ex const & r);
 	bool is_equal(function const & f) const;
+	const exvector & get_arguments() const { return seq; }
 	ex get_result() const { return result; }
 	unsigned long get_last_access() const { return last_access; }
 	unsigned long get_successful_hits() const { return successful_hits; };
 
 protected:
+	friend class remember_table_list;
+
+	std::size_t memory_used() const;
+
 	unsigned hashvalue;
 	exvector seq;
 	ex result;
 	mutable unsigned long last_access;
 	mutable unsigned successful_hits;
 	static unsigned long access_counter;
+	/** Group of entries with the same number of hits, for delete_lfu. */
+	std::list<remember_table_hits_group>::iterator hits_group;
 };    
 
 /** A list of entries in the remember table having some least
- *  significant bits of the hashvalue in common. */
+ *  significant bits of the hashvalue in common.  The entries are found by
+ *  their full hash value, and they are kept in the order in which the
+ *  remember strategy discards them, so that the entry to be deleted is
+ *  always the first one:
+ *   - delete_cyclic: in the order of insertion,
+ *   - delete_lru: in the order of their last access (a hit moves an entry
+ *     to the end),
+ *   - delete_lfu: by their number of successful hits, and within the same
+ *     number in the order in which they reached it (a hit moves an entry
+ *     to the end of the next group).
+ *  All of this takes constant time, except for the search of the hash
+ *  value.  The list also keeps an estimate of the memory its entries hold. */
 class remember_table_list : public std::list<remember_table_entry> {
 public:
 	remember_table_list(unsigned as, unsigned strat);
+	remember_table_list(const remember_table_list & other);
+	remember_table_list & operator=(const remember_table_list & other);
 	void add_entry(function const & f, ex const & result);
 	bool lookup_entry(function const & f, ex & result) const;
+	void remove_first();
+	std::size_t memory_used() const { return memory; }
 protected:
+	void rebuild_index();
+	void record_hit(iterator it) const;
+
 	unsigned max_assoc_size;
 	unsigned remember_strategy;
+	/** Estimated number of bytes held by the entries. */
+	std::size_t memory;
+	/** The entries by their hash values. */
+	std::multimap<unsigned, iterator> index;
+	/** Groups of entries by their number of hits, in ascending order
+	 *  (only for delete_lfu). */
+	mutable std::list<remember_table_hits_group> hits_groups;
 };
 
 /** The remember table is organized like an n-fold associative cache
@@ -79,7 +125,18 @@ protected:
  *   - oldest entry (the first one in the list)
  *   - least recently used (the one with the lowest 'last_access')
  *   - least frequently used (the one with the lowest 'successful_hits')
- *  or all entries are kept which means that the table grows indefinitely. */
+ *  or all entries are kept which means that the table grows indefinitely.
+ *
+ *  Every table counts its lookups, hits and evicted entries.  The memory
+ *  held by all tables together can be limited with set_memory_limit(); the
+ *  oldest entries of all tables are then discarded as new ones come in.
+ *
+ *  If GiNaC is built with GINAC_THREADSAFE_REFCOUNT, every thread has
+ *  tables of its own, so that they need no locking.  They are created on
+ *  first use from the options of the function, and rebuilt when its
+ *  remember_generation changes (by function::set_remember() or
+ *  function::clear_remember()).  Statistics and the memory used are those
+ *  of the calling thread, the memory limit applies to every thread. */
 class remember_table : public std::vector<remember_table_list> {
 public:
 	remember_table();
@@ -87,13 +144,41 @@ public:
 	bool lookup_entry(function const & f, ex & result) const;
 	void add_entry(function const & f, ex const & result);
 	void clear_all_entries();
+	void reorganize(unsigned s, unsigned as, unsigned strat);
+	remember_table_statistics statistics() const;
 	void show_statistics(std::ostream & os, unsigned level) const;
 	static std::vector<remember_table> & remember_tables();
+	static std::vector<remember_table> & evalf_remember_tables();
+	static remember_table & remember_table_of(unsigned serial);
+	static remember_table & evalf_remember_table_of(unsigned serial);
+	static void set_memory_limit(std::size_t bytes);
+	static std::size_t get_memory_limit() { return memory_limit; }
+	static std::size_t get_memory_used();
+	static void save_tables(bool evalf, const lst & syms,
+	                        std::vector<std::pair<std::string, std::string> > & sections);
+	static void load_table(bool evalf, const std::string & name, unsigned nparams,
+	                       const std::string & buf, lst & syms);
 protected:
 	void init_table();
+	void discard_entries();
+	bool evict_one();
+	static void enforce_memory_limit();
+	static void forget_evalf_results(long digitsdiff);
+
 	unsigned table_size;
 	unsigned max_assoc_size;
 	unsigned remember_strategy;
+	mutable unsigned long lookups;
+	mutable unsigned long hits;
+	unsigned long evictions;
+	unsigned long entries;
+	std::size_t memory;
+	/** Slot in which the memory limit evicts the next entry. */
+	unsigned next_eviction;
+	/** Generation of the function options the table was built for. */
+	unsigned generation;
+	/** Limit for the memory of the tables of a thread (0 means no limit). */
+	static std::size_t memory_limit;
 };      
 
 } // namespace GiNaC
@@ -0,0 +1,341 @@
+/** @file sparse_matrix.cpp
+ *
+ *  Implementation of sparse symbolic matrices */
+
+/*
+ *  GiNaC Copyright (C) 1999-2014 Johannes Gutenberg University Mainz, Germany
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#include "sparse_matrix.h"
+#include "matrix.h"
+#include "numeric.h"
+#include "operators.h"
+#include "normal.h"
+#include "utils.h"
+
+#include <algorithm>
+#include <stdexcept>
+
+namespace GiNaC {
+
+namespace {
+
+struct column_is_less {
+	bool operator()(const sparse_matrix::entry & e, unsigned c) const
+	{
+		return e.first < c;
+	}
+};
+
+/** Number of rows with the fewest entries among which the Markowitz pivot
+ *  search looks for the cheapest pivot. */
+const size_t markowitz_search_rows = 4;
+
+/** The bookkeeping of the elimination: the number of entries of every active
+ *  row and column of the left hand side, and for every column the rows which
+ *  may contain an entry in it.  The latter lists may contain rows which have
+ *  become inactive or lost the entry since. */
+struct elimination_counts {
+	elimination_counts(unsigned r, unsigned c) : row_count(r, 0), col_count(c, 0), col_rows(c) { }
+	std::vector<unsigned> row_count;
+	std::vector<unsigned> col_count;
+	std::vector< std::vector<unsigned> > col_rows;
+};
+
+/** Normalize a new entry the way matrix::gauss_elimination() does. */
+inline void normalize_entry(ex & e)
+{
+	if (!e.info(info_flags::numeric))
+		e = e.normal();
+}
+
+/** Subtract f times the pivot row from row ro, removing its entry in the
+ *  pivot column co.  Columns >= n are right hand sides. */
+void eliminate_row(std::vector<sparse_matrix::sparse_row> & a, unsigned ro, unsigned pr,
+                   unsigned co, const ex & f, unsigned n, elimination_counts & counts)
+{
+	const sparse_matrix::sparse_row & src = a[pr];
+	sparse_matrix::sparse_row & dst = a[ro];
+	sparse_matrix::sparse_row result;
+	result.reserve(dst.size() + src.size());
+	sparse_matrix::sparse_row::const_iterator i = dst.begin(), j = src.begin();
+	while (i != dst.end() || j != src.end()) {
+		if (j == src.end() || (i != dst.end() && i->first < j->first)) {
+			if (i->first == co) {
+				--counts.row_count[ro];
+				--counts.col_count[co];
+			} else {
+				result.push_back(*i);
+			}
+			++i;
+		} else if (i == dst.end() || j->first < i->first) {
+			ex e = -f * j->second;
+			normalize_entry(e);
+			if (!e.is_zero()) {
+				result.push_back(sparse_matrix::entry(j->first, e));
+				if (j->first < n) {
+					// fill-in
+					++counts.row_count[ro];
+					++counts.col_count[j->first];
+					counts.col_rows[j->first].push_back(ro);
+				}
+			}
+			++j;
+		} else {
+			if (i->first == co) {
+				--counts.row_count[ro];
+				--counts.col_count[co];
+			} else {
+				ex e = i->second - f * j->second;
+				normalize_entry(e);
+				if (!e.is_zero()) {
+					result.push_back(sparse_matrix::entry(i->first, e));
+				} else if (i->first < n) {
+					--counts.row_count[ro];
+					--counts.col_count[i->first];
+				}
+			}
+			++i;
+			++j;
+		}
+	}
+	dst.swap(result);
+}
+
+} // anonymous namespace
+
+
+/** Construct an empty (all zero) sparse matrix with r rows and c columns. */
+sparse_matrix::sparse_matrix(unsigned r, unsigned c) : row(r), col(c), m(r)
+{
+}
+
+/** Construct a sparse matrix from the nonzero entries of a matrix. */
+sparse_matrix::sparse_matrix(const matrix & mat) : row(mat.rows()), col(mat.cols()), m(mat.rows())
+{
+	for (unsigned r=0; r<row; ++r)
+		for (unsigned c=0; c<col; ++c)
+			if (!mat(r,c).is_zero())
+				m[r].push_back(entry(c, mat(r,c)));
+}
+
+
+/** Number of nonzero entries. */
+size_t sparse_matrix::nonzeros() const
+{
+	size_t n = 0;
+	for (std::vector<sparse_row>::const_iterator r=m.begin(); r!=m.end(); ++r)
+		n += r->size();
+	return n;
+}
+
+
+/** operator() to access elements for reading.
+ *
+ *  @param ro row of element
+ *  @param co column of element
+ *  @exception range_error (index out of range) */
+ex sparse_matrix::operator() (unsigned ro, unsigned co) const
+{
+	if (ro>=row || co>=col)
+		throw (std::range_error("sparse_matrix::operator(): index out of range"));
+
+	sparse_row::const_iterator i = std::lower_bound(m[ro].begin(), m[ro].end(), co, column_is_less());
+	if (i != m[ro].end() && i->first == co)
+		return i->second;
+	return _ex0;
+}
+
+
+/** Set an element, storing it only if it doesn't vanish.
+ *
+ *  @param ro row of element
+ *  @param co column of element
+ *  @param value new value of the element
+ *  @exception range_error (index out of range) */
+sparse_matrix & sparse_matrix::set(unsigned ro, unsigned co, const ex & value)
+{
+	if (ro>=row || co>=col)
+		throw (std::range_error("sparse_matrix::set(): index out of range"));
+
+	sparse_row::iterator i = std::lower_bound(m[ro].begin(), m[ro].end(), co, column_is_less());
+	const bool found = (i != m[ro].end() && i->first == co);
+	if (value.is_zero()) {
+		if (found)
+			m[ro].erase(i);
+	} else if (found) {
+		i->second = value;
+	} else {
+		m[ro].insert(i, entry(co, value));
+	}
+	return *this;
+}
+
+
+/** Convert to a (dense) matrix. */
+matrix sparse_matrix::to_matrix() const
+{
+	matrix mat(row, col);
+	for (unsigned r=0; r<row; ++r)
+		for (sparse_row::const_iterator i=m[r].begin(); i!=m[r].end(); ++i)
+			mat(r, i->first) = i->second;
+	return mat;
+}
+
+
+/** Solve a linear system consisting of a m x n sparse matrix and a m x p
+ *  right hand side by Gaussian elimination which only ever stores the
+ *  nonzero entries.  The pivots are chosen by Markowitz' criterion from the
+ *  rows with the fewest entries, to keep the fill-in small.  Like
+ *  matrix::solve(), this returns the solution in terms of the free
+ *  variables if the system is underdetermined.
+ *
+ *  @param vars n x p matrix, all elements must be symbols 
+ *  @param rhs m x p matrix
+ *  @return n x p solution matrix
+ *  @exception logic_error (incompatible matrices)
+ *  @exception invalid_argument (1st argument must be matrix of symbols)
+ *  @exception runtime_error (inconsistent linear system)
+ *  @see       solve_algo */
+matrix sparse_matrix::solve(const matrix & vars, const matrix & rhs) const
+{
+	const unsigned n = col;
+	const unsigned p = rhs.cols();
+
+	// syntax checks
+	if ((rhs.rows() != row) || (vars.rows() != n) || (vars.cols() != p))
+		throw (std::logic_error("sparse_matrix::solve(): incompatible matrices"));
+	for (unsigned ro=0; ro<n; ++ro)
+		for (unsigned co=0; co<p; ++co)
+			if (!vars(ro,co).info(info_flags::symbol))
+				throw (std::invalid_argument("sparse_matrix::solve(): 1st argument must be matrix of symbols"));
+
+	// the augmented matrix, the right hand sides are in columns n,...,n+p-1
+	std::vector<sparse_row> a(m);
+	for (unsigned r=0; r<row; ++r)
+		for (unsigned co=0; co<p; ++co)
+			if (!rhs(r,co).is_zero())
+				a[r].push_back(entry(n+co, rhs(r,co)));
+
+	elimination_counts counts(row, n);
+	std::vector<unsigned> active_rows;
+	for (unsigned r=0; r<row; ++r) {
+		for (sparse_row::const_iterator i=m[r].begin(); i!=m[r].end(); ++i) {
+			++counts.row_count[r];
+			++counts.col_count[i->first];
+			counts.col_rows[i->first].push_back(r);
+		}
+		active_rows.push_back(r);
+	}
+	std::vector<bool> active(row, true);
+
+	// pivot positions in the order of elimination
+	std::vector< std::pair<unsigned, unsigned> > pivots;
+	while (true) {
+		// the active rows with the fewest entries
+		unsigned min_count = n + 1;
+		for (size_t k=0; k<active_rows.size(); ++k) {
+			const unsigned c = counts.row_count[active_rows[k]];
+			if (c > 0 && c < min_count)
+				min_count = c;
+		}
+		if (min_count > n)
+			break;
+
+		// the cheapest pivot in them, preferring numbers
+		size_t best_k = 0;
+		unsigned pc = n;
+		unsigned long best_cost = 0;
+		bool best_numeric = false;
+		size_t searched = 0;
+		for (size_t k=0; k<active_rows.size() && searched<markowitz_search_rows; ++k) {
+			const unsigned r = active_rows[k];
+			if (counts.row_count[r] != min_count)
+				continue;
+			++searched;
+			for (sparse_row::const_iterator i=a[r].begin(); i!=a[r].end() && i->first<n; ++i) {
+				const unsigned long cost = (unsigned long)(min_count - 1) * (counts.col_count[i->first] - 1);
+				const bool is_numeric = i->second.info(info_flags::numeric);
+				if (pc == n || cost < best_cost || (cost == best_cost && is_numeric && !best_numeric)) {
+					best_k = k;
+					pc = i->first;
+					best_cost = cost;
+					best_numeric = is_numeric;
+				}
+			}
+		}
+		const unsigned pr = active_rows[best_k];
+
+		// the pivot row leaves the active part
+		active_rows[best_k] = active_rows.back();
+		active_rows.pop_back();
+		active[pr] = false;
+		for (sparse_row::const_iterator i=a[pr].begin(); i!=a[pr].end() && i->first<n; ++i)
+			--counts.col_count[i->first];
+		pivots.push_back(std::make_pair(pr, pc));
+
+		const ex pv = (*std::lower_bound(a[pr].begin(), a[pr].end(), pc, column_is_less())).second;
+		std::vector<unsigned> targets;
+		targets.swap(counts.col_rows[pc]);
+		for (std::vector<unsigned>::const_iterator t=targets.begin(); t!=targets.end(); ++t) {
+			if (!active[*t])
+				continue;
+			sparse_row::const_iterator i = std::lower_bound(a[*t].begin(), a[*t].end(), pc, column_is_less());
+			if (i == a[*t].end() || i->first != pc)
+				continue;
+			ex f = i->second / pv;
+			normalize_entry(f);
+			eliminate_row(a, *t, pr, pc, f, n, counts);
+		}
+	}
+
+	// rows without left hand side must not have a right hand side either
+	for (size_t k=0; k<active_rows.size(); ++k)
+		if (!a[active_rows[k]].empty())
+			throw (std::runtime_error("sparse_matrix::solve(): inconsistent linear system"));
+
+	// back substitution, columns without pivot are free parameters
+	matrix sol(n, p);
+	std::vector<bool> pivoted(n, false);
+	for (size_t k=0; k<pivots.size(); ++k)
+		pivoted[pivots[k].second] = true;
+	for (unsigned c=0; c<n; ++c)
+		if (!pivoted[c])
+			for (unsigned co=0; co<p; ++co)
+				sol(c,co) = vars(c,co);
+	for (size_t k=pivots.size(); k-->0; ) {
+		const sparse_row & r = a[pivots[k].first];
+		const unsigned pc = pivots[k].second;
+		for (unsigned co=0; co<p; ++co) {
+			ex e = 0;
+			ex pv;
+			for (sparse_row::const_iterator i=r.begin(); i!=r.end(); ++i) {
+				if (i->first == pc)
+					pv = i->second;
+				else if (i->first < n)
+					e -= i->second * sol(i->first, co);
+				else if (i->first == n+co)
+					e += i->second;
+			}
+			sol(pc,co) = (e/pv).normal();
+		}
+	}
+
+	return sol;
+}
+
+} // namespace GiNaC
@@ -0,0 +1,69 @@
+/** @file sparse_matrix.h
+ *
+ *  Interface to sparse symbolic matrices */
+
+/*
+ *  GiNaC Copyright (C) 1999-2014 Johannes Gutenberg University Mainz, Germany
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#ifndef GINAC_SPARSE_MATRIX_H
+#define GINAC_SPARSE_MATRIX_H
+
+#include "ex.h"
+
+#include <utility>
+#include <vector>
+
+namespace GiNaC {
+
+class matrix;
+
+/** Symbolic matrices most entries of which vanish, as they arise from large
+ *  linear systems.  Only the nonzero entries are stored, those of every row
+ *  sorted by their column.  Unlike class matrix this is not an algebraic
+ *  object: it serves to set up and solve linear systems without ever
+ *  storing the vanishing entries. */
+class sparse_matrix
+{
+public:
+	typedef std::pair<unsigned, ex> entry;      ///< column and value
+	typedef std::vector<entry> sparse_row;      ///< sorted by column
+
+	sparse_matrix(unsigned r, unsigned c);
+	explicit sparse_matrix(const matrix & m);
+
+	unsigned rows() const        /// Get number of rows.
+		{ return row; }
+	unsigned cols() const        /// Get number of columns.
+		{ return col; }
+	size_t nonzeros() const;
+	const sparse_row & row_entries(unsigned ro) const  /// Get the nonzero entries of a row.
+		{ return m[ro]; }
+	ex operator() (unsigned ro, unsigned co) const;
+	sparse_matrix & set(unsigned ro, unsigned co, const ex & value);
+	matrix to_matrix() const;
+	matrix solve(const matrix & vars, const matrix & rhs) const;
+
+protected:
+	unsigned row;                ///< number of rows
+	unsigned col;                ///< number of columns
+	std::vector<sparse_row> m;   ///< nonzero entries of the rows
+};
+
+} // namespace GiNaC
+
+#endif // ndef GINAC_SPARSE_MATRIX_H
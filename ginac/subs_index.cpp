@@ -0,0 +1,201 @@
+/** @file subs_index.cpp
+ *
+ *  Index of the keys of large substitution maps. */
+
+/*
+ *  GiNaC Copyright (C) 1999-2014 Johannes Gutenberg University Mainz, Germany
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#include "subs_index.h"
+#include "function.h"
+#include "mul.h"
+#include "power.h"
+#include "wildcard.h"
+
+#include <algorithm>
+
+#ifdef GINAC_THREADSAFE_REFCOUNT
+#define GINAC_SUBS_THREAD_LOCAL __thread
+#else
+#define GINAC_SUBS_THREAD_LOCAL
+#endif
+
+namespace GiNaC {
+
+/** Innermost index built by ex::subs() in this thread. */
+static GINAC_SUBS_THREAD_LOCAL const subs_index * current_index = 0;
+
+namespace {
+
+/** Append the positions of the entries with hash value h. */
+inline void append_hash(const std::vector<std::pair<unsigned, unsigned> > & table,
+                        unsigned h, std::vector<unsigned> & positions)
+{
+	std::vector<std::pair<unsigned, unsigned> >::const_iterator i
+		= std::lower_bound(table.begin(), table.end(), std::make_pair(h, 0u));
+	for (; i != table.end() && i->first == h; ++i)
+		positions.push_back(i->second);
+}
+
+} // anonymous namespace
+
+const std::size_t subs_index::min_size;
+
+subs_index::subs_index(const exmap & m_) : m(m_), previous(0)
+{
+	keys.reserve(m.size());
+	product_factors.resize(m.size());
+	unsigned pos = 0;
+	for (exmap::const_iterator it = m.begin(); it != m.end(); ++it, ++pos) {
+		keys.push_back(it);
+		const ex & key = it->first;
+
+		if (is_exactly_a<wildcard>(key))
+			wildcards.push_back(pos);
+		else if (haswild(key))
+			patterns[head(ex_to<basic>(key))].push_back(pos);
+		else
+			exact.push_back(std::make_pair(key.gethash(), pos));
+
+		const ex basis = factor_basis(key);
+		if (haswild(basis))
+			wild_bases.push_back(pos);
+		else
+			bases.push_back(std::make_pair(basis.gethash(), pos));
+
+		if (is_exactly_a<mul>(key)) {
+			std::vector<unsigned> & factors = product_factors[pos];
+			for (size_t i=0; i<key.nops(); ++i) {
+				const ex b = factor_basis(key.op(i));
+				if (!haswild(b))
+					factors.push_back(b.gethash());
+			}
+			std::sort(factors.begin(), factors.end());
+			factors.erase(std::unique(factors.begin(), factors.end()), factors.end());
+			if (factors.empty())
+				wild_products.push_back(pos);
+			else
+				products.push_back(std::make_pair(factors[0], pos));
+		}
+	}
+	std::sort(exact.begin(), exact.end());
+	std::sort(bases.begin(), bases.end());
+	std::sort(products.begin(), products.end());
+}
+
+const subs_index * subs_index::find(const exmap & m)
+{
+	for (const subs_index * i = current_index; i; i = i->previous)
+		if (&i->m == &m)
+			return i;
+	return 0;
+}
+
+/** Class of b, and the serial of functions, which basic::match() requires
+ *  a pattern to have. */
+subs_index::head_type subs_index::head(const basic & b)
+{
+	unsigned serial = 0;
+	if (is_a<function>(b))
+		serial = static_cast<const function &>(b).get_serial();
+	return head_type(&b.get_class_info(), serial);
+}
+
+/** Basis of e as split off by tryfactsubs(). */
+ex subs_index::factor_basis(const ex & e)
+{
+	if (is_exactly_a<power>(e) && e.op(1).info(info_flags::integer))
+		return e.op(0);
+	return e;
+}
+
+/** Turn the positions into keys, in the order of the map. */
+void subs_index::collect(std::vector<unsigned> & positions, key_vector & result) const
+{
+	std::sort(positions.begin(), positions.end());
+	positions.erase(std::unique(positions.begin(), positions.end()), positions.end());
+	result.reserve(result.size() + positions.size());
+	for (std::vector<unsigned>::const_iterator i = positions.begin(); i != positions.end(); ++i)
+		result.push_back(keys[*i]);
+}
+
+void subs_index::match_candidates(const basic & b, key_vector & result) const
+{
+	std::vector<unsigned> positions(wildcards);
+	append_hash(exact, b.gethash(), positions);
+	std::map<head_type, std::vector<unsigned> >::const_iterator i = patterns.find(head(b));
+	if (i != patterns.end())
+		positions.insert(positions.end(), i->second.begin(), i->second.end());
+	collect(positions, result);
+}
+
+void subs_index::product_candidates(const ex & e, key_vector & result) const
+{
+	std::vector<unsigned> hashes;
+	hashes.reserve(e.nops());
+	for (size_t i=0; i<e.nops(); ++i)
+		hashes.push_back(factor_basis(e.op(i)).gethash());
+	std::sort(hashes.begin(), hashes.end());
+	hashes.erase(std::unique(hashes.begin(), hashes.end()), hashes.end());
+
+	std::vector<unsigned> positions(wild_products), found;
+	for (std::vector<unsigned>::const_iterator h = hashes.begin(); h != hashes.end(); ++h) {
+		found.clear();
+		append_hash(products, *h, found);
+		for (std::vector<unsigned>::const_iterator p = found.begin(); p != found.end(); ++p) {
+			const std::vector<unsigned> & factors = product_factors[*p];
+			if (std::includes(hashes.begin(), hashes.end(), factors.begin(), factors.end()))
+				positions.push_back(*p);
+		}
+	}
+
+	// Other keys are substituted for single factors
+	found = wild_bases;
+	for (std::vector<unsigned>::const_iterator h = hashes.begin(); h != hashes.end(); ++h)
+		append_hash(bases, *h, found);
+	for (std::vector<unsigned>::const_iterator p = found.begin(); p != found.end(); ++p)
+		if (!is_exactly_a<mul>(keys[*p]->first))
+			positions.push_back(*p);
+
+	collect(positions, result);
+}
+
+void subs_index::factor_candidates(const ex & e, key_vector & result) const
+{
+	std::vector<unsigned> positions(wild_bases);
+	append_hash(bases, factor_basis(e).gethash(), positions);
+	collect(positions, result);
+}
+
+subs_index_guard::subs_index_guard(const exmap & m) : index(0)
+{
+	if (m.size() < subs_index::min_size || subs_index::find(m))
+		return;
+	index = new subs_index(m);
+	index->previous = current_index;
+	current_index = index;
+}
+
+subs_index_guard::~subs_index_guard()
+{
+	if (index) {
+		current_index = index->previous;
+		delete index;
+	}
+}
+
+} // namespace GiNaC
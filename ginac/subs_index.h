@@ -0,0 +1,120 @@
+/** @file subs_index.h
+ *
+ *  Index of the keys of large substitution maps. */
+
+/*
+ *  GiNaC Copyright (C) 1999-2014 Johannes Gutenberg University Mainz, Germany
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#ifndef GINAC_SUBS_INDEX_H
+#define GINAC_SUBS_INDEX_H
+
+#include "ex.h"
+#include "registrar.h"
+
+#include <map>
+#include <utility>
+#include <vector>
+
+namespace GiNaC {
+
+/** Index of the keys of a substitution map, which tells for an object the
+ *  keys that could match it, in the order of the map.  All other keys are
+ *  sure not to match, so that subs() need not try them:
+ *
+ *  - a key without wildcards only matches objects equal to it, so these
+ *    keys are found by their hash value;
+ *  - a key with wildcards only matches objects of the same class (and
+ *    functions of the same serial), unless it is a wildcard itself;
+ *  - for algebraic substitutions, a key only matches a factor whose basis
+ *    has the hash value of the basis of the key (unless that basis has
+ *    wildcards), and a product only matches a product which has all
+ *    factors of the key without wildcards.
+ *
+ *  While ex::subs() is called with a map of at least min_size keys, an
+ *  index of it is built and can be found with find(). */
+class subs_index {
+public:
+	typedef std::vector<exmap::const_iterator> key_vector;
+
+	/** Maps with fewer keys are searched linearly. */
+	static const std::size_t min_size = 32;
+
+	subs_index(const exmap & m);
+
+	/** Return the index of m, if ex::subs() has built one. */
+	static const subs_index * find(const exmap & m);
+
+	/** Keys that could match the object b with basic::match(). */
+	void match_candidates(const basic & b, key_vector & keys) const;
+
+	/** Keys that could be substituted algebraically for the factors of the
+	 *  product e (see mul::algebraic_subs_mul()). */
+	void product_candidates(const ex & e, key_vector & keys) const;
+
+	/** Keys that could be substituted algebraically for the power or other
+	 *  factor e (see power::subs()). */
+	void factor_candidates(const ex & e, key_vector & keys) const;
+
+private:
+	typedef std::pair<const registered_class_info *, unsigned> head_type;
+	typedef std::vector<std::pair<unsigned, unsigned> > hash_table;
+
+	static head_type head(const basic & b);
+	static ex factor_basis(const ex & e);
+	void collect(std::vector<unsigned> & positions, key_vector & keys) const;
+
+	const exmap & m;
+	/** The keys in the order of the map. */
+	key_vector keys;
+	/** Hash values and positions of the keys without wildcards, sorted. */
+	hash_table exact;
+	/** Positions of the keys with wildcards, by their class. */
+	std::map<head_type, std::vector<unsigned> > patterns;
+	/** Positions of the keys which are wildcards. */
+	std::vector<unsigned> wildcards;
+	/** Hash values of the bases of the keys and their positions, sorted. */
+	hash_table bases;
+	/** Positions of the keys whose basis has wildcards. */
+	std::vector<unsigned> wild_bases;
+	/** Hash value of one factor of each product key and its position. */
+	hash_table products;
+	/** Positions of the product keys whose factors all have wildcards. */
+	std::vector<unsigned> wild_products;
+	/** Sorted hash values of the factor bases without wildcards of the
+	 *  product keys, by position (empty for other keys). */
+	std::vector<std::vector<unsigned> > product_factors;
+
+	friend class subs_index_guard;
+	const subs_index * previous;
+};
+
+/** Makes the index of a large map available to subs() while it exists. */
+class subs_index_guard {
+public:
+	subs_index_guard(const exmap & m);
+	~subs_index_guard();
+private:
+	subs_index * index;
+
+	subs_index_guard(const subs_index_guard &);
+	subs_index_guard & operator=(const subs_index_guard &);
+};
+
+} // namespace GiNaC
+
+#endif // ndef GINAC_SUBS_INDEX_H
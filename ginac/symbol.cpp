@@ -31,6 +31,7 @@
 #include <map>
 #include <stdexcept>
 #include <string>
+#include <vector>
 
 namespace GiNaC {
 
@@ -46,7 +47,7 @@ GINAC_IMPLEMENT_REGISTERED_CLASS_OPT(symbol, basic,
 
 // symbol
 
-symbol::symbol() : serial(next_serial++), name(""), TeX_name("")
+symbol::symbol() : serial(post_increment(next_serial))
 {
 	setflag(status_flags::evaluated | status_flags::expanded);
 }
@@ -67,14 +68,14 @@ possymbol::possymbol() : realsymbol() { }
 
 // symbol
 
-symbol::symbol(const std::string & initname) : serial(next_serial++),
-	name(initname), TeX_name("")
+symbol::symbol(const std::string & initname) : serial(post_increment(next_serial)),
+	name(initname)
 {
 	setflag(status_flags::evaluated | status_flags::expanded);
 }
 
 symbol::symbol(const std::string & initname, const std::string & texname) :
-	serial(next_serial++), name(initname), TeX_name(texname)
+	serial(post_increment(next_serial)), name(initname), TeX_name(texname)
 {
 	setflag(status_flags::evaluated | status_flags::expanded);
 }
@@ -101,7 +102,7 @@ possymbol::possymbol(const std::string & initname, const std::string & texname)
 void symbol::read_archive(const archive_node &n, lst &sym_lst)
 {
 	inherited::read_archive(n, sym_lst);
-	serial = next_serial++;
+	serial = post_increment(next_serial);
 	std::string tmp_name;
 	n.find_string("name", tmp_name);
 
@@ -150,16 +151,75 @@ static const std::string& get_default_TeX_name(const std::string& name);
 
 // public
 
+/** Return the name of the symbol.  For an anonymous symbol, "symbol"
+ *  followed by the serial number is made up each time, so that such symbols
+ *  don't keep a string around. */
 std::string symbol::get_name() const
 {
 	if (name.empty()) {
 		std::ostringstream s;
 		s << "symbol" << serial;
-		name = s.str();
+		return s.str();
 	}
 	return name;
 }
 
+namespace {
+
+/** Anonymous symbols kept for reuse by symbol::temporary(). */
+std::vector<ex> & temporary_pool()
+{
+	static std::vector<ex> * pool = new std::vector<ex>;
+	return *pool;
+}
+
+/** Maximum number of symbols kept by symbol::temporary(). */
+const size_t temporary_pool_size = 64;
+
+#ifdef GINAC_THREADSAFE_REFCOUNT
+int temporary_pool_mutex = 0;
+
+class temporary_pool_lock {
+public:
+	temporary_pool_lock() { while (__sync_lock_test_and_set(&temporary_pool_mutex, 1)) ; }
+	~temporary_pool_lock() { __sync_lock_release(&temporary_pool_mutex); }
+};
+#else
+class temporary_pool_lock {
+public:
+	temporary_pool_lock() {}
+};
+#endif
+
+} // anonymous namespace
+
+/** Return an anonymous symbol for temporary use by an algorithm, like the
+ *  symbols which replace non-rational subexpressions in normal().  It
+ *  behaves exactly like a newly created symbol (it compares greater than all
+ *  existing symbols), but its memory is recycled: once nothing but the pool
+ *  refers to a symbol handed out earlier, it is given a new serial number
+ *  and handed out again. */
+ex symbol::temporary()
+{
+	temporary_pool_lock lock;
+	std::vector<ex> & pool = temporary_pool();
+	for (std::vector<ex>::iterator i = pool.begin(); i != pool.end(); ++i) {
+		const symbol & s = ex_to<symbol>(*i);
+		if (s.get_refcount() == 1) {
+			// Nobody else sees it, so it may change its identity
+			symbol & t = const_cast<symbol &>(s);
+			t.serial = post_increment(next_serial);
+			t.clearflag(status_flags::hash_calculated | status_flags::symbols_calculated);
+			return *i;
+		}
+	}
+
+	const ex s = (new symbol)->setflag(status_flags::dynallocated);
+	if (pool.size() < temporary_pool_size)
+		pool.push_back(s);
+	return s;
+}
+
 // protected
 
 void symbol::do_print(const print_context & c, unsigned level) const
@@ -179,7 +239,7 @@ void symbol::do_print_latex(const print_latex & c, unsigned level) const
 
 void symbol::do_print_tree(const print_tree & c, unsigned level) const
 {
-	c.s << std::string(level, ' ') << name << " (" << class_name() << ")" << " @" << this
+	c.s << std::string(level, ' ') << get_name() << " (" << class_name() << ")" << " @" << this
 	    << ", serial=" << serial
 	    << std::hex << ", hash=0x" << hashvalue << ", flags=0x" << flags << std::dec
 	    << ", domain=" << get_domain()
@@ -221,6 +281,17 @@ bool symbol::info(unsigned inf) const
 	return inherited::info(inf);
 }
 
+/** The value of the symbol from the map.
+ *
+ *  @exception invalid_argument (no value given) */
+std::complex<double> symbol::evalf_double(const evalf_double_map & values) const
+{
+	evalf_double_map::const_iterator i = values.find(*this);
+	if (i == values.end())
+		throw std::invalid_argument("evalf_double(): no value for symbol " + get_name());
+	return i->second;
+}
+
 ex symbol::conjugate() const
 {
 	return conjugate_function(*this).hold();
@@ -48,6 +48,7 @@ public:
 	bool info(unsigned inf) const;
 	ex eval(int level = 0) const { return *this; } // for performance reasons
 	ex evalf(int level = 0) const { return *this; } // overwrites basic::evalf() for performance reasons
+	std::complex<double> evalf_double(const evalf_double_map & values) const;
 	ex series(const relational & s, int order, unsigned options = 0) const;
 	ex subs(const exmap & m, unsigned options = 0) const { return subs_one_level(m, options); } // overwrites basic::subs() for performance reasons
 	ex normal(exmap & repl, exmap & rev_lookup, int level = 0) const;
@@ -65,6 +66,7 @@ protected:
 	ex derivative(const symbol & s) const;
 	bool is_equal_same_type(const basic & other) const;
 	unsigned calchash() const;
+	unsigned calc_symbol_mask() const { return 1u << (serial % 32); }
 	
 	// non-virtual functions in this class
 public:
@@ -72,6 +74,8 @@ public:
 	void set_TeX_name(const std::string & n) { TeX_name = n; }
 	std::string get_name() const;
 	virtual unsigned get_domain() const { return domain::complex; }
+
+	static ex temporary();
 protected:
 	void do_print(const print_context & c, unsigned level) const;
 	void do_print_latex(const print_latex & c, unsigned level) const;
@@ -82,7 +86,7 @@ protected:
 
 protected:
 	unsigned serial;                 ///< unique serial number for comparison
-	mutable std::string name;        ///< printname of this symbol
+	std::string name;                ///< printname of this symbol, empty if anonymous
 	std::string TeX_name;            ///< LaTeX name of this symbol
 private:
 	static unsigned next_serial;
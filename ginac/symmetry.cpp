@@ -314,6 +314,7 @@ symmetry &symmetry::add(const symmetry &c)
 
 	// Add child node
 	children.push_back(c);
+	compile();
 	return *this;
 }
 
@@ -327,6 +328,33 @@ void symmetry::validate(unsigned n)
 	}
 }
 
+void symmetry::compile()
+{
+	steps.clear();
+	append_steps(steps);
+}
+
+void symmetry::append_steps(std::vector<sort_step> & s) const
+{
+	if (indices.size() < 2)
+		return;
+
+	for (exvector::const_iterator i=children.begin(); i!=children.end(); ++i)
+		ex_to<symmetry>(*i).append_steps(s);
+
+	if (type == none || children.size() < 2)
+		return;
+	s.push_back(sort_step());
+	sort_step & step = s.back();
+	step.type = type;
+	step.width = ex_to<symmetry>(children[0]).indices.size();
+	step.indices.reserve(indices.size());
+	for (exvector::const_iterator i=children.begin(); i!=children.end(); ++i) {
+		const std::set<unsigned> & ci = ex_to<symmetry>(*i).indices;
+		step.indices.insert(step.indices.end(), ci.begin(), ci.end());
+	}
+}
+
 //////////
 // global functions
 //////////
@@ -397,44 +425,56 @@ const symmetry & antisymmetric4()
 	return ex_to<symmetry>(s);
 }
 
-class sy_is_less : public std::binary_function<ex, ex, bool> {
+namespace {
+
+/** Sorting networks for two to eight elements: the network for n elements
+ *  consists of the compare-exchange operations network_pairs[k] with
+ *  network_begin[n] <= k < network_begin[n+1]. */
+const unsigned max_network_size = 8;
+const unsigned char network_pairs[][2] = {
+	{0,1},
+	{0,1}, {1,2}, {0,1},
+	{0,1}, {2,3}, {0,2}, {1,3}, {1,2},
+	{0,1}, {3,4}, {2,4}, {2,3}, {0,3}, {0,2}, {1,4}, {1,3}, {1,2},
+	{1,2}, {4,5}, {0,2}, {3,5}, {0,1}, {3,4}, {2,5}, {0,3}, {1,4}, {2,4},
+	{1,3}, {2,3},
+	{1,2}, {3,4}, {5,6}, {0,2}, {3,5}, {4,6}, {0,1}, {4,5}, {2,6}, {0,4},
+	{1,5}, {0,3}, {2,5}, {1,3}, {2,4}, {2,3},
+	{0,2}, {1,3}, {4,6}, {5,7}, {0,4}, {1,5}, {2,6}, {3,7}, {0,1}, {2,3},
+	{4,5}, {6,7}, {2,4}, {3,5}, {1,4}, {3,6}, {1,2}, {3,4}, {5,6}
+};
+const unsigned network_begin[] = {0, 0, 0, 1, 4, 9, 18, 30, 46, 65};
+
+/** Compares and swaps the children of one node of a symmetry tree, given
+ *  by their positions in the sorted index list of the node. */
+class sy_children {
 	exvector::iterator v;
+	const std::vector<unsigned> & indices;
+	unsigned width;
 
 public:
-	sy_is_less(exvector::iterator v_) : v(v_) {}
+	bool & swapped;
 
-	bool operator() (const ex &lh, const ex &rh) const
+	sy_children(exvector::iterator v_, const std::vector<unsigned> & i, unsigned w, bool & s)
+	 : v(v_), indices(i), width(w), swapped(s) {}
+
+	unsigned size() const { return indices.size() / width; }
+
+	int compare(unsigned a, unsigned b) const
 	{
-		GINAC_ASSERT(is_exactly_a<symmetry>(lh));
-		GINAC_ASSERT(is_exactly_a<symmetry>(rh));
-		GINAC_ASSERT(ex_to<symmetry>(lh).indices.size() == ex_to<symmetry>(rh).indices.size());
-		std::set<unsigned>::const_iterator ait = ex_to<symmetry>(lh).indices.begin(), aitend = ex_to<symmetry>(lh).indices.end(), bit = ex_to<symmetry>(rh).indices.begin();
+		const unsigned *ait = &indices[a * width], *aitend = ait + width, *bit = &indices[b * width];
 		while (ait != aitend) {
 			int cmpval = v[*ait].compare(v[*bit]);
-			if (cmpval < 0)
-				return true;
-			else if (cmpval > 0)
-				return false;
+			if (cmpval)
+				return cmpval;
 			++ait; ++bit;
 		}
-		return false;
+		return 0;
 	}
-};
 
-class sy_swap : public std::binary_function<ex, ex, void> {
-	exvector::iterator v;
-
-public:
-	bool &swapped;
-
-	sy_swap(exvector::iterator v_, bool &s) : v(v_), swapped(s) {}
-
-	void operator() (const ex &lh, const ex &rh)
+	void swap(unsigned a, unsigned b)
 	{
-		GINAC_ASSERT(is_exactly_a<symmetry>(lh));
-		GINAC_ASSERT(is_exactly_a<symmetry>(rh));
-		GINAC_ASSERT(ex_to<symmetry>(lh).indices.size() == ex_to<symmetry>(rh).indices.size());
-		std::set<unsigned>::const_iterator ait = ex_to<symmetry>(lh).indices.begin(), aitend = ex_to<symmetry>(lh).indices.end(), bit = ex_to<symmetry>(rh).indices.begin();
+		const unsigned *ait = &indices[a * width], *aitend = ait + width, *bit = &indices[b * width];
 		while (ait != aitend) {
 			v[*ait].swap(v[*bit]);
 			++ait; ++bit;
@@ -443,47 +483,105 @@ public:
 	}
 };
 
+class sy_is_less : public std::binary_function<unsigned, unsigned, bool> {
+	const sy_children & c;
+
+public:
+	sy_is_less(const sy_children & c_) : c(c_) {}
+
+	bool operator() (unsigned a, unsigned b) const { return c.compare(a, b) < 0; }
+};
+
+class sy_swap : public std::binary_function<unsigned, unsigned, void> {
+	sy_children & c;
+
+public:
+	sy_swap(sy_children & c_) : c(c_) {}
+
+	void operator() (unsigned a, unsigned b) { c.swap(a, b); }
+};
+
+/** Sort the children in ascending order and return the signum of the
+ *  permutation, or 0 if two children are equal and the signum is wanted. */
+int sort_children(sy_children & c, bool want_sign)
+{
+	unsigned num = c.size();
+
+	if (num > max_network_size) {
+		std::vector<unsigned> pos(num);
+		for (unsigned i=0; i<num; ++i)
+			pos[i] = i;
+		if (want_sign)
+			return permutation_sign(pos.begin(), pos.end(), sy_is_less(c), sy_swap(c));
+		shaker_sort(pos.begin(), pos.end(), sy_is_less(c), sy_swap(c));
+		return 1;
+	}
+
+	int sign = 1;
+	bool equal = false;
+	for (unsigned k=network_begin[num]; k<network_begin[num+1]; ++k) {
+		int cmpval = c.compare(network_pairs[k][0], network_pairs[k][1]);
+		if (cmpval > 0) {
+			c.swap(network_pairs[k][0], network_pairs[k][1]);
+			sign = -sign;
+		} else if (cmpval == 0)
+			equal = true;
+	}
+	if (!want_sign)
+		return 1;
+	if (equal)
+		return 0;
+
+	// The network need not have compared all neighbours in the result
+	for (unsigned i=1; i<num; ++i)
+		if (c.compare(i - 1, i) == 0)
+			return 0;
+	return sign;
+}
+
+} // anonymous namespace
+
 int canonicalize(exvector::iterator v, const symmetry &symm)
 {
 	// Less than two elements? Then do nothing
 	if (symm.indices.size() < 2)
 		return std::numeric_limits<int>::max();
 
-	// Canonicalize children first
+	// The steps of the tree come children first, so that each node
+	// reorders canonicalized children
 	bool something_changed = false;
 	int sign = 1;
-	exvector::const_iterator first = symm.children.begin(), last = symm.children.end();
-	while (first != last) {
-		GINAC_ASSERT(is_exactly_a<symmetry>(*first));
-		int child_sign = canonicalize(v, ex_to<symmetry>(*first));
-		if (child_sign == 0)
-			return 0;
-		if (child_sign != std::numeric_limits<int>::max()) {
-			something_changed = true;
-			sign *= child_sign;
+	std::vector<symmetry::sort_step>::const_iterator first = symm.steps.begin(), last = symm.steps.end();
+	for (; first != last; ++first) {
+		sy_children c(v, first->indices, first->width, something_changed);
+		switch (first->type) {
+			case symmetry::symmetric:
+				// Sort the children in ascending order
+				sort_children(c, false);
+				break;
+			case symmetry::antisymmetric:
+				// Sort the children in ascending order, keeping track of the signum
+				sign *= sort_children(c, true);
+				if (sign == 0)
+					return 0;
+				break;
+			case symmetry::cyclic: {
+				// Permute the smallest child to the front
+				unsigned num = c.size(), smallest = 0;
+				for (unsigned i=1; i<num; ++i)
+					if (c.compare(i, smallest) < 0)
+						smallest = i;
+				if (smallest) {
+					std::vector<unsigned> pos(num);
+					for (unsigned i=0; i<num; ++i)
+						pos[i] = i;
+					cyclic_permutation(pos.begin(), pos.end(), pos.begin() + smallest, sy_swap(c));
+				}
+				break;
+			}
+			default:
+				break;
 		}
-		first++;
-	}
-
-	// Now reorder the children
-	first = symm.children.begin();
-	switch (symm.type) {
-		case symmetry::symmetric:
-			// Sort the children in ascending order
-			shaker_sort(first, last, sy_is_less(v), sy_swap(v, something_changed));
-			break;
-		case symmetry::antisymmetric:
-			// Sort the children in ascending order, keeping track of the signum
-			sign *= permutation_sign(first, last, sy_is_less(v), sy_swap(v, something_changed));
-			if (sign == 0)
-				return 0;
-			break;
-		case symmetry::cyclic:
-			// Permute the smallest child to the front
-			cyclic_permutation(first, last, min_element(first, last, sy_is_less(v)), sy_swap(v, something_changed));
-			break;
-		default:
-			break;
 	}
 	return something_changed ? sign : std::numeric_limits<int>::max();
 }
@@ -27,18 +27,15 @@
 #include "archive.h"
 
 #include <set>
+#include <vector>
 
 namespace GiNaC {
 
-class sy_is_less;
-class sy_swap;
 
 /** This class describes the symmetry of a group of indices. These objects
  *  can be grouped into a tree to form complex mixed symmetries. */
 class symmetry : public basic
 {
-	friend class sy_is_less;
-	friend class sy_swap;
 	friend int canonicalize(exvector::iterator v, const symmetry &symm);
 
 	GINAC_DECLARE_REGISTERED_CLASS(symmetry, basic)
@@ -67,7 +64,7 @@ public:
 	symmetry_type get_type() const {return type;}
 
 	/** Set symmetry type. */
-	void set_type(symmetry_type t) {type = t;}
+	void set_type(symmetry_type t) {type = t; compile();}
 
 	/** Add child node, check index sets for consistency. */
 	symmetry &add(const symmetry &c);
@@ -94,6 +91,21 @@ protected:
 	void do_print_tree(const print_tree & c, unsigned level) const;
 	unsigned calchash() const;
 
+	// non-virtual functions in this class
+private:
+	/** One node of the tree that permutes its children, in the flattened
+	 *  form used by canonicalize(). */
+	struct sort_step {
+		symmetry_type type;
+		/** Number of indices of each child. */
+		unsigned width;
+		/** Sorted indices of the children, one child after the other. */
+		std::vector<unsigned> indices;
+	};
+
+	void compile();
+	void append_steps(std::vector<sort_step> & s) const;
+
 	// member variables
 private:
 	/** Type of symmetry described by this node. */
@@ -104,6 +116,10 @@ private:
 
 	/** Vector of child nodes. */
 	exvector children;
+
+	/** The nodes with two or more children and a type != none, children
+	 *  before their parents (rebuilt whenever the tree changes). */
+	std::vector<sort_step> steps;
 };
 GINAC_DECLARE_UNARCHIVER(symmetry); 
 
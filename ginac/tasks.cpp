@@ -0,0 +1,320 @@
+/** @file tasks.cpp
+ *
+ *  Implementation of the worker threads shared by the parallel algorithms. */
+
+/*
+ *  GiNaC Copyright (C) 1999-2014 Johannes Gutenberg University Mainz, Germany
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include "tasks.h"
+
+#include <algorithm>
+#include <deque>
+#ifdef HAVE_PTHREAD_H
+#define TASK_WORKERS 1
+#include <pthread.h>
+#define GINAC_TASK_THREAD_LOCAL __thread
+#else
+#define GINAC_TASK_THREAD_LOCAL
+#endif
+
+namespace GiNaC {
+
+namespace {
+
+unsigned task_threads = 64;
+
+const std::size_t max_task_cleanups = 16;
+
+/** What a thread knows about the tasks it runs.  Must be a POD, so it can
+ *  be thread-local. */
+struct task_state {
+	bool worker;
+	unsigned depth;  ///< number of tasks being run, nested ones included
+	std::size_t num_cleanups;
+	void (*cleanups[max_task_cleanups])();
+};
+
+GINAC_TASK_THREAD_LOCAL task_state the_task_state;
+
+void run_task(task_function f, void * arg)
+{
+	task_state & s = the_task_state;
+	++s.depth;
+	f(arg);
+	if (--s.depth == 0 && s.worker) {
+		for (std::size_t i = 0; i < s.num_cleanups; ++i)
+			s.cleanups[i]();
+		s.num_cleanups = 0;
+	}
+}
+
+#ifdef TASK_WORKERS
+
+/** The tasks submitted by one call of run_tasks().  Task 0 is run by the
+ *  caller, the others by whoever takes them first.  A task of post_task()
+ *  is the only one of its submission. */
+struct task_work {
+	task_work(task_function f_, void * const * args_, std::size_t n_, int refs_)
+	 : f(f_), args(args_), n(n_), next(1), done(0), refs(refs_), posted_done(0)
+	{
+		pthread_mutex_init(&mutex, 0);
+		pthread_cond_init(&finished, 0);
+	}
+	task_work(task_function f_, void * arg, void (*done_)(void *))
+	 : f(f_), args(&posted_arg), n(1), next(0), done(0), refs(1), posted_arg(arg), posted_done(done_)
+	{
+		pthread_mutex_init(&mutex, 0);
+		pthread_cond_init(&finished, 0);
+	}
+	~task_work()
+	{
+		pthread_cond_destroy(&finished);
+		pthread_mutex_destroy(&mutex);
+	}
+
+	task_function f;
+	void * const * args;
+	std::size_t n;
+	std::size_t next;  ///< first task nobody has taken
+	std::size_t done;  ///< number of finished tasks except task 0
+	int refs;          ///< the caller and the helpers which may still look at this
+	void * posted_arg;
+	void (*posted_done)(void *);
+	pthread_mutex_t mutex;
+	pthread_cond_t finished;
+};
+
+/** Take the next task of w and run it.  Returns false if there was none. */
+bool run_next(task_work & w)
+{
+	const std::size_t k = __sync_fetch_and_add(&w.next, 1);
+	if (k >= w.n)
+		return false;
+	run_task(w.f, w.args[k]);
+	if (w.posted_done) {
+		w.posted_done(w.posted_arg);
+		return true;
+	}
+	pthread_mutex_lock(&w.mutex);
+	if (++w.done == w.n - 1)
+		pthread_cond_signal(&w.finished);
+	pthread_mutex_unlock(&w.mutex);
+	return true;
+}
+
+void release(task_work * w, int refs = 1)
+{
+	if (__sync_sub_and_fetch(&w->refs, refs) == 0)
+		delete w;
+}
+
+/** Run tasks of a submission until there are none left, as a worker.  This
+ *  is what is handed to the task_executor. */
+void help(void * work)
+{
+	task_work * w = static_cast<task_work *>(work);
+	task_state & s = the_task_state;
+	const bool was_worker = s.worker;
+	s.worker = true;
+	while (run_next(*w))
+		;
+	s.worker = was_worker;
+	release(w);
+}
+
+task_executor executor = 0;
+
+// The workers and their queue are never destroyed, because workers may
+// still be waiting during static destruction.
+pthread_mutex_t pool_mutex = PTHREAD_MUTEX_INITIALIZER;
+pthread_cond_t pool_wakeup = PTHREAD_COND_INITIALIZER;
+std::deque<task_work *> * pool_queue = 0;
+unsigned num_workers = 0;
+unsigned idle_workers = 0;
+
+void * worker_main(void *)
+{
+	the_task_state.worker = true;
+	pthread_mutex_lock(&pool_mutex);
+	while (true) {
+		while (pool_queue->empty() && num_workers <= task_threads) {
+			++idle_workers;
+			pthread_cond_wait(&pool_wakeup, &pool_mutex);
+			--idle_workers;
+		}
+		// Surplus workers only retire when the queue is empty, since posted
+		// tasks have nobody else to run them
+		if (pool_queue->empty())
+			break;
+		task_work * w = pool_queue->front();
+		pool_queue->pop_front();
+		pthread_mutex_unlock(&pool_mutex);
+		help(w);
+		pthread_mutex_lock(&pool_mutex);
+	}
+	--num_workers;
+	pthread_mutex_unlock(&pool_mutex);
+	return 0;
+}
+
+/** Queue w for the workers, helpers times, starting workers as needed.
+ *  Since workers don't retire before the queue is empty, each entry is
+ *  eventually taken if there is any worker.  Returns false, without
+ *  queueing w, if there is none (e.g. because no thread could be created). */
+bool submit(task_work * w, std::size_t helpers)
+{
+	pthread_mutex_lock(&pool_mutex);
+	if (!pool_queue)
+		pool_queue = new std::deque<task_work *>;
+	std::size_t available = idle_workers;
+	while (available < helpers && num_workers < task_threads) {
+		pthread_t t;
+		if (pthread_create(&t, 0, worker_main, 0) != 0)
+			break;
+		pthread_detach(t);
+		++num_workers;
+		++available;
+	}
+	const bool queued = num_workers > 0;
+	if (queued) {
+		pool_queue->insert(pool_queue->end(), helpers, w);
+		pthread_cond_broadcast(&pool_wakeup);
+	}
+	pthread_mutex_unlock(&pool_mutex);
+	return queued;
+}
+
+/** Remove the entries of w which no worker has taken yet from the queue.
+ *  Returns their number. */
+int withdraw(task_work * w)
+{
+	pthread_mutex_lock(&pool_mutex);
+	const std::size_t before = pool_queue->size();
+	pool_queue->erase(std::remove(pool_queue->begin(), pool_queue->end(), w), pool_queue->end());
+	const std::size_t removed = before - pool_queue->size();
+	pthread_mutex_unlock(&pool_mutex);
+	return int(removed);
+}
+
+#endif // def TASK_WORKERS
+
+} // anonymous namespace
+
+void run_tasks(task_function f, void * const * args, std::size_t n)
+{
+	if (n == 0)
+		return;
+#ifdef TASK_WORKERS
+	const task_executor e = executor;
+	const std::size_t helpers = e ? n - 1 : std::min<std::size_t>(n - 1, task_threads);
+	if (helpers > 0) {
+		task_work * w = new task_work(f, args, n, int(helpers) + 1);
+		bool queued = true;
+		if (e) {
+			for (std::size_t i = 0; i < helpers; ++i)
+				e(help, w);
+		} else
+			queued = submit(w, helpers);
+		if (queued) {
+			run_task(f, args[0]);
+			while (run_next(*w))
+				;
+			// Entries which no worker has taken would only hold w
+			const int unused = e ? 0 : withdraw(w);
+			pthread_mutex_lock(&w->mutex);
+			while (w->done < n - 1)
+				pthread_cond_wait(&w->finished, &w->mutex);
+			pthread_mutex_unlock(&w->mutex);
+			release(w, unused + 1);
+			return;
+		}
+		delete w;
+	}
+#endif
+	for (std::size_t k = 0; k < n; ++k)
+		run_task(f, args[k]);
+}
+
+void post_task(task_function f, void * arg, void (*done)(void * arg))
+{
+#ifdef TASK_WORKERS
+	const task_executor e = executor;
+	if (e || task_threads > 0) {
+		task_work * w = new task_work(f, arg, done);
+		if (e) {
+			e(help, w);
+			return;
+		}
+		if (submit(w, 1))
+			return;
+		// No worker could be started, so nobody else would run it
+		delete w;
+	}
+#endif
+	run_task(f, arg);
+	done(arg);
+}
+
+unsigned set_task_threads(unsigned n)
+{
+#ifdef TASK_WORKERS
+	pthread_mutex_lock(&pool_mutex);
+	const unsigned previous = task_threads;
+	task_threads = n;
+	// Surplus workers end when they wake up and find the queue empty
+	pthread_cond_broadcast(&pool_wakeup);
+	pthread_mutex_unlock(&pool_mutex);
+	return previous;
+#else
+	const unsigned previous = task_threads;
+	task_threads = n;
+	return previous;
+#endif
+}
+
+unsigned get_task_threads()
+{
+	return task_threads;
+}
+
+task_executor set_task_executor(task_executor e)
+{
+#ifdef TASK_WORKERS
+	return __sync_lock_test_and_set(&executor, e);
+#else
+	return 0;
+#endif
+}
+
+void at_task_end(void (*release)())
+{
+	task_state & s = the_task_state;
+	if (!s.worker)
+		return;
+	for (std::size_t i = 0; i < s.num_cleanups; ++i)
+		if (s.cleanups[i] == release)
+			return;
+	if (s.num_cleanups < max_task_cleanups)
+		s.cleanups[s.num_cleanups++] = release;
+}
+
+} // namespace GiNaC
@@ -0,0 +1,104 @@
+/** @file tasks.h
+ *
+ *  Worker threads shared by all algorithms which run parts of their work
+ *  concurrently. */
+
+/*
+ *  GiNaC Copyright (C) 1999-2014 Johannes Gutenberg University Mainz, Germany
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#ifndef GINAC_TASKS_H
+#define GINAC_TASKS_H
+
+#include <cstddef>
+#include <vector>
+
+namespace GiNaC {
+
+/** A task, with the signature of the start routine of a thread.  Its
+ *  result is ignored. */
+typedef void * (*task_function)(void * arg);
+
+/** Run f(args[0]), ..., f(args[n-1]) concurrently and return when all of
+ *  them are done.  The first task is run by the calling thread, the others
+ *  by the worker threads or, whichever gets to them first, by the calling
+ *  thread as well.  So the call never waits for a task which nobody works
+ *  on, even if it is made from within a task, and the tasks are simply run
+ *  one after the other if there are no workers.
+ *
+ *  A task run by a worker starts without the thread-local state of the
+ *  caller (like the computation_budget), as in a thread of its own.
+ *  Tasks must not throw. */
+extern void run_tasks(task_function f, void * const * args, std::size_t n);
+
+/** Run f on each element of jobs as a task. */
+template <class Job>
+inline void run_tasks(task_function f, std::vector<Job> & jobs)
+{
+	if (jobs.empty())
+		return;
+	std::vector<void *> args(jobs.size());
+	for (std::size_t k = 0; k < jobs.size(); ++k)
+		args[k] = &jobs[k];
+	run_tasks(f, &args[0], args.size());
+}
+
+/** Run f(arg) as a task in the background and return at once.  When the
+ *  task is done and the worker has released its thread-local state (see
+ *  at_task_end()), done(arg) is called in the same thread.  Without workers
+ *  (see set_task_threads()), or if no worker thread can be started, both
+ *  are called by the calling thread before post_task() returns.  Lowering
+ *  the number of workers doesn't drop tasks which are still waiting. */
+extern void post_task(task_function f, void * arg, void (*done)(void * arg));
+
+/** Set the maximum number of worker threads.  They are started when tasks
+ *  are waiting for them and then kept for later tasks.  The algorithms
+ *  decide themselves how many parts they split their work into (like
+ *  set_normal_threads()), this only bounds how many threads work on them.
+ *  With 0, all tasks are run by the threads which submit them.  Workers
+ *  are only started if GiNaC was built with pthreads.
+ *
+ *  @return previous setting */
+extern unsigned set_task_threads(unsigned n);
+
+/** Get the maximum number of worker threads. */
+extern unsigned get_task_threads();
+
+/** Function running the tasks of a submission on a thread of the
+ *  application: it must call run(work) once, at some time, in some thread.
+ *  See set_task_executor(). */
+typedef void (*task_executor)(void (*run)(void * work), void * work);
+
+/** Hand the tasks over to the application's own threads instead of
+ *  GiNaC's workers, or back to the workers with 0.  Since the submitting
+ *  thread runs whatever tasks have not been started, the executor may
+ *  queue the work as long as it likes.
+ *
+ *  @return previous executor */
+extern task_executor set_task_executor(task_executor e);
+
+/** Register a function which releases thread-local state of the calling
+ *  thread after the task it runs is done, if the thread is a worker (or a
+ *  thread of the task_executor).  Persistent workers use this in place of
+ *  the destructors which run when a thread ends: a task's numbers must not
+ *  be referenced by a worker after the task, since CLN doesn't update
+ *  reference counts atomically.  In other threads, this does nothing. */
+extern void at_task_end(void (*release)());
+
+} // namespace GiNaC
+
+#endif // ndef GINAC_TASKS_H
@@ -38,6 +38,7 @@ class tensor : public basic
 	// functions overriding virtual functions from base classes
 protected:
 	unsigned return_type() const { return return_types::noncommutative_composite; }
+	unsigned calc_symbol_mask() const { return 0; }
 
 	// non-virtual functions in this class
 public:
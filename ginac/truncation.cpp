@@ -0,0 +1,150 @@
+/** @file truncation.cpp
+ *
+ *  Implementation of expand_truncated(). */
+
+/*
+ *  GiNaC Copyright (C) 1999-2014 Johannes Gutenberg University Mainz, Germany
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#include "truncation.h"
+#include "add.h"
+#include "mul.h"
+#include "power.h"
+#include "symbol.h"
+#include "numeric.h"
+#include "lst.h"
+#include "utils.h"
+
+#include <stdexcept>
+
+namespace GiNaC {
+
+GINAC_TRUNCATION_THREAD_LOCAL const degree_truncation * current_truncation = 0;
+
+degree_truncation::degree_truncation(const ex & syms, int max_degree_)
+ : max_degree(max_degree_), mask(0)
+{
+	if (is_a<symbol>(syms))
+		symbols.push_back(syms);
+	else if (is_a<lst>(syms)) {
+		for (lst::const_iterator i = ex_to<lst>(syms).begin(); i != ex_to<lst>(syms).end(); ++i) {
+			if (!is_a<symbol>(*i))
+				throw std::invalid_argument("expand_truncated(): 2nd argument must be a symbol or a list of symbols");
+			symbols.push_back(*i);
+		}
+	} else
+		throw std::invalid_argument("expand_truncated(): 2nd argument must be a symbol or a list of symbols");
+
+	for (exvector::const_iterator i = symbols.begin(); i != symbols.end(); ++i)
+		mask |= i->get_symbol_mask();
+}
+
+bool degree_truncation::contains(const ex & s) const
+{
+	if (!(s.get_symbol_mask() & mask))
+		return false;
+	for (exvector::const_iterator i = symbols.begin(); i != symbols.end(); ++i)
+		if (i->is_equal(s))
+			return true;
+	return false;
+}
+
+int degree_truncation::degree(const ex & term) const
+{
+	if (!(term.get_symbol_mask() & mask))
+		return 0;
+	if (is_exactly_a<symbol>(term))
+		return contains(term) ? 1 : 0;
+	if (is_exactly_a<power>(term)) {
+		const ex & b = term.op(0), & e = term.op(1);
+		if (is_exactly_a<symbol>(b) && e.info(info_flags::integer) && contains(b))
+			return ex_to<numeric>(e).to_int();
+		return 0;
+	}
+	if (is_exactly_a<mul>(term)) {
+		int d = 0;
+		for (size_t i = 0; i < term.nops(); ++i)
+			d += degree(term.op(i));
+		return d;
+	}
+	return 0;
+}
+
+int degree_truncation::factor_degree(const expair & p) const
+{
+	if (is_exactly_a<symbol>(p.rest) && p.coeff.info(info_flags::integer) && contains(p.rest))
+		return ex_to<numeric>(p.coeff).to_int();
+	return 0;
+}
+
+bool degree_truncation::may_prune(const ex & e) const
+{
+	if (!(e.get_symbol_mask() & mask))
+		return true;
+	for (const_preorder_iterator i = e.preorder_begin(); i != e.preorder_end(); ++i) {
+		if (is_exactly_a<power>(*i) && is_exactly_a<symbol>(i->op(0)) &&
+		    !i->op(1).info(info_flags::posint) && contains(i->op(0)))
+			return false;
+	}
+	return true;
+}
+
+ex degree_truncation::truncate(const ex & e) const
+{
+	if (!is_exactly_a<add>(e))
+		return degree(e) <= max_degree ? e : _ex0;
+
+	exvector terms;
+	terms.reserve(e.nops());
+	for (size_t i = 0; i < e.nops(); ++i)
+		if (degree(e.op(i)) <= max_degree)
+			terms.push_back(e.op(i));
+	if (terms.size() == e.nops())
+		return e;
+	return (new add(terms))->setflag(status_flags::dynallocated);
+}
+
+namespace {
+
+/** Puts a bound into effect while it exists. */
+class truncation_scope {
+public:
+	truncation_scope(const degree_truncation * t) : saved(current_truncation) { current_truncation = t; }
+	~truncation_scope() { current_truncation = saved; }
+private:
+	const degree_truncation * saved;
+};
+
+} // anonymous namespace
+
+/** Expand e, leaving out the terms whose total degree in syms exceeds
+ *  max_degree.  The terms are left out while the products are multiplied
+ *  out, if all powers of the symbols of syms in e are positive integers.
+ *
+ *  @param e  expression to expand
+ *  @param syms  symbol or list of symbols
+ *  @param max_degree  largest total degree of the terms kept
+ *  @param options  options of expand()
+ *  @see degree_truncation */
+ex expand_truncated(const ex & e, const ex & syms, int max_degree, unsigned options)
+{
+	const degree_truncation t(syms, max_degree);
+	const truncation_scope scope(t.may_prune(e) ? &t : 0);
+	return t.truncate(e.expand(options));
+}
+
+} // namespace GiNaC
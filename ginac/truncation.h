@@ -0,0 +1,98 @@
+/** @file truncation.h
+ *
+ *  Bound on the degree of the terms of expand_truncated(). */
+
+/*
+ *  GiNaC Copyright (C) 1999-2014 Johannes Gutenberg University Mainz, Germany
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#ifndef GINAC_TRUNCATION_H
+#define GINAC_TRUNCATION_H
+
+#include "ex.h"
+#include "expair.h"
+
+namespace GiNaC {
+
+/** Bound on the total degree in a set of symbols of the terms kept by
+ *  expand_truncated().  The degree of a term is the sum of the integer
+ *  exponents of the symbols of the set which are its factors; symbols in
+ *  functions, in powers of sums or with other exponents don't count.
+ *
+ *  While expand_truncated() runs, mul::expand() and power::expand_add()
+ *  leave out the products whose degree exceeds the bound, which is safe
+ *  as long as no factor can lower the degree again.  Therefore this is
+ *  only done if no symbol of the set is raised to anything but a positive
+ *  integer anywhere in the expression, and while the terms being expanded
+ *  are terms of the result, which are not inside functions or the like
+ *  (see truncation_suspender). */
+class degree_truncation {
+public:
+	degree_truncation(const ex & syms, int max_degree);
+
+	/** Degree of a term. */
+	int degree(const ex & term) const;
+
+	/** Degree of a factor of a product, given as a pair of a mul. */
+	int factor_degree(const expair & p) const;
+
+	/** Whether expanding e may leave out terms: all exponents of the
+	 *  symbols of the set in it are positive integers. */
+	bool may_prune(const ex & e) const;
+
+	/** Leave out the terms of e whose degree exceeds the bound. */
+	ex truncate(const ex & e) const;
+
+	const int max_degree;
+
+private:
+	bool contains(const ex & s) const;
+
+	exvector symbols;
+	unsigned mask;  ///< symbol mask of the symbols
+};
+
+#ifdef GINAC_THREADSAFE_REFCOUNT
+#define GINAC_TRUNCATION_THREAD_LOCAL __thread
+#else
+#define GINAC_TRUNCATION_THREAD_LOCAL
+#endif
+
+/** The bound of expand_truncated() by which the terms being expanded may be
+ *  pruned, 0 if none. */
+extern GINAC_TRUNCATION_THREAD_LOCAL const degree_truncation * current_truncation;
+
+/** Lift the bound while expanding something whose terms are not terms of
+ *  the result, like the arguments of a function. */
+class truncation_suspender {
+public:
+	truncation_suspender() : saved(current_truncation) { current_truncation = 0; }
+	~truncation_suspender() { current_truncation = saved; }
+private:
+	const degree_truncation * saved;
+};
+
+/** Expand e without the bound. */
+inline ex expand_untruncated(const ex & e, unsigned options)
+{
+	const truncation_suspender suspend;
+	return e.expand(options);
+}
+
+} // namespace GiNaC
+
+#endif // ndef GINAC_TRUNCATION_H
@@ -259,6 +259,10 @@ const ex _ex60 = _ex60;
 const numeric *_num120_p;
 const ex _ex120 = _ex120;
 
+// tables of preallocated small integers and their inverses
+const numeric *_num_small_integer_p[2*small_integer_bound + 1];
+const numeric *_num_small_inverse_p[2*small_inverse_bound + 1];
+
 /** Ctor of static initialization helpers.  The fist call to this is going
  *  to initialize the library, the others do nothing. */
 library_init::library_init()
@@ -365,6 +369,41 @@ library_init::library_init()
 		new((void*)&_ex60) ex(*_num60_p);
 		new((void*)&_ex120) ex(*_num120_p);
 
+		// Fill the tables of small numbers, starting with the flyweights.
+		// Every entry holds a reference of its own, so that it lives as
+		// long as the library.
+		const numeric * const flyweights[] = {
+			_num_120_p, _num_60_p, _num_48_p, _num_30_p, _num_25_p, _num_24_p,
+			_num_20_p, _num_18_p, _num_15_p, _num_12_p, _num_11_p, _num_10_p,
+			_num_9_p, _num_8_p, _num_7_p, _num_6_p, _num_5_p, _num_4_p,
+			_num_3_p, _num_2_p, _num_1_p, _num_1_2_p, _num_1_3_p, _num_1_4_p,
+			_num0_p, _num1_4_p, _num1_3_p, _num1_2_p, _num1_p, _num2_p,
+			_num3_p, _num4_p, _num5_p, _num6_p, _num7_p, _num8_p, _num9_p,
+			_num10_p, _num11_p, _num12_p, _num15_p, _num18_p, _num20_p,
+			_num24_p, _num25_p, _num30_p, _num48_p, _num60_p, _num120_p
+		};
+		for (size_t i = 0; i < sizeof(flyweights)/sizeof(flyweights[0]); ++i) {
+			const numeric * n = flyweights[i];
+			if (n->is_integer())
+				_num_small_integer_p[n->to_long() + small_integer_bound] = n;
+			else
+				_num_small_inverse_p[n->numer().mul(n->denom()).to_long() + small_inverse_bound] = n;
+		}
+		for (long i = -small_integer_bound; i <= small_integer_bound; ++i) {
+			const numeric *& n = _num_small_integer_p[i + small_integer_bound];
+			if (!n)
+				(n = new numeric(i))->setflag(status_flags::dynallocated);
+			const_cast<numeric *>(n)->add_reference();
+		}
+		for (long q = -small_inverse_bound; q <= small_inverse_bound; ++q) {
+			if (q >= -1 && q <= 1)
+				continue;
+			const numeric *& n = _num_small_inverse_p[q + small_inverse_bound];
+			if (!n)
+				(n = new numeric(1, q))->setflag(status_flags::dynallocated);
+			const_cast<numeric *>(n)->add_reference();
+		}
+
 		// Initialize print context class info (this is not strictly necessary
 		// but we do it anyway to make print_context_class_info::dump_hierarchy()
 		// output the whole hierarchy whether or not the classes are actually
@@ -392,6 +431,19 @@ library_init::~library_init()
 		// lifetime might not be the same as libginac.{so,dll} one
 		// (e.g. consider // dlopen/dlsym/dlclose sequence).
 		// Let the ex dtors care for deleting the numerics!
+		// The tables of small numbers release their references first.
+		for (long i = 0; i < 2*small_integer_bound + 1; ++i) {
+			numeric * n = const_cast<numeric *>(_num_small_integer_p[i]);
+			if (n->remove_reference() == 0)
+				delete n;
+			_num_small_integer_p[i] = 0;
+		}
+		for (long i = 0; i < 2*small_inverse_bound + 1; ++i) {
+			numeric * n = const_cast<numeric *>(_num_small_inverse_p[i]);
+			if (n && n->remove_reference() == 0)
+				delete n;
+			_num_small_inverse_p[i] = 0;
+		}
 		_ex120.~ex();
 		_ex_120.~ex();
 		_ex60.~ex();
@@ -33,6 +33,7 @@
 #ifdef HAVE_STDINT_H
 #include <stdint.h> // for uintptr_t
 #endif
+#include <set>
 #include <string>
 
 namespace GiNaC {
@@ -55,6 +56,17 @@ inline unsigned rotate_left(unsigned n)
 	return (n & 0x80000000U) ? (n << 1 | 0x00000001U) : (n << 1);
 }
 
+/** Increment a counter and return its previous value.  The increment is
+ *  atomic if GINAC_THREADSAFE_REFCOUNT is defined. */
+inline unsigned post_increment(unsigned & counter)
+{
+#ifdef GINAC_THREADSAFE_REFCOUNT
+	return __sync_fetch_and_add(&counter, 1);
+#else
+	return counter++;
+#endif
+}
+
 /** Compare two pointers (just to establish some sort of canonical order).
  *  @return -1, 0, or 1 */
 template <class T>
@@ -412,6 +424,57 @@ extern const ex _ex60;
 extern const numeric *_num120_p;
 extern const ex _ex120;
 
+/** Range of the preallocated numeric objects for small integers and for
+ *  the inverses of small integers.  The arithmetic in class numeric returns
+ *  these instead of allocating new objects for results that fall into the
+ *  range.  The flyweights above are part of the tables. */
+const long small_integer_bound = 1024;
+const long small_inverse_bound = 16;
+extern const numeric *_num_small_integer_p[2*small_integer_bound + 1];
+extern const numeric *_num_small_inverse_p[2*small_inverse_bound + 1];
+
+/** Preallocated numeric object with value i, or 0 if there is none. */
+inline const numeric *small_integer_p(long i)
+{
+	if (i < -small_integer_bound || i > small_integer_bound)
+		return 0;
+	return _num_small_integer_p[i + small_integer_bound];
+}
+
+/** Preallocated numeric object with value 1/q, or 0 if there is none. */
+inline const numeric *small_inverse_p(long q)
+{
+	if (q < -small_inverse_bound || q > small_inverse_bound)
+		return 0;
+	return _num_small_inverse_p[q + small_inverse_bound];
+}
+
+/** Make a copy of e in which no number shares a CLN heap object with e, so
+ *  that the copy may be handed to another thread.  CLN doesn't update its
+ *  reference counts atomically.  Only rational and complex rational numbers
+ *  can be copied.
+ *  @return false if e contains other numbers */
+extern bool copy_numbers(const ex & e, ex & copy);
+
+class add;
+
+/** Split a sum into its integer content c and its primitive part, the way
+ *  mul::eval() does it for every sum in a product.  The sign of c is chosen
+ *  so that the leading coefficient of the primitive part is positive.
+ *  @return false if mul::eval() leaves the sum alone, then c and prim are
+ *  not touched */
+extern bool strip_content(const add & a, numeric & c, ex & prim);
+
+/** Function taking the trace of an expression over a set of representation
+ *  labels, like dirac_trace(). */
+typedef ex (*trace_function)(const ex & e, const std::set<unsigned char> & rls, const ex & trONE);
+
+/** Sum of the traces of the terms of the sum e, computed by several threads
+ *  (see set_trace_threads()).
+ *  @return false if the terms have to be traced one by one instead */
+extern bool trace_terms_parallel(const ex & e, trace_function trace,
+                                 const std::set<unsigned char> & rls, const ex & trONE, ex & result);
+
 
 // Helper macros for class implementations (mostly useful for trivial classes)
 
@@ -22,10 +22,14 @@
 
 #include "wildcard.h"
 #include "archive.h"
+#include "expairseq.h"
+#include "function.h"
 #include "utils.h"
 #include "hash_seed.h"
 
+#include <algorithm>
 #include <iostream>
+#include <map>
 
 namespace GiNaC {
 
@@ -131,4 +135,179 @@ bool haswild(const ex & x)
 	return false;
 }
 
+//////////
+// pattern_net
+//////////
+
+namespace {
+
+/** What the net checks of an expression before it goes on with the next
+ *  one, in the order of a depth-first traversal. */
+struct pattern_test {
+	enum kind_type {
+		equal,    ///< same class and hash value (pattern without wildcards)
+		whole,    ///< same class (sum or product with wildcards)
+		operands  ///< same class, serial and number of operands, which follow
+	};
+
+	kind_type kind;
+	const registered_class_info * cls;
+	unsigned value;  ///< hash value, or serial of functions
+	size_t num;      ///< number of operands
+
+	pattern_test(kind_type k, const basic & b, unsigned v, size_t n)
+	 : kind(k), cls(&b.get_class_info()), value(v), num(n) {}
+
+	bool operator<(const pattern_test & other) const
+	{
+		if (kind != other.kind)
+			return kind < other.kind;
+		if (cls != other.cls)
+			return cls < other.cls;
+		if (value != other.value)
+			return value < other.value;
+		return num < other.num;
+	}
+};
+
+unsigned serial_of(const basic & b)
+{
+	if (is_a<function>(b))
+		return static_cast<const function &>(b).get_serial();
+	return 0;
+}
+
+} // anonymous namespace
+
+struct pattern_net::node {
+	typedef std::map<pattern_test, node *> test_map;
+
+	node() : any(0) {}
+	~node()
+	{
+		delete any;
+		for (test_map::iterator i = next.begin(); i != next.end(); ++i)
+			delete i->second;
+	}
+
+	/** Follows for any expression (a wildcard in the patterns). */
+	node * any;
+	/** Follows for the expressions which pass a test. */
+	test_map next;
+	/** Patterns which end here. */
+	std::vector<unsigned> patterns;
+
+	/** Add the tests of pattern p and return the node after them. */
+	node * insert(const ex & p);
+	/** Append the patterns of all nodes which the expressions in pending
+	 *  (the next one at the back) lead to. */
+	void collect(exvector & pending, std::vector<unsigned> & found) const;
+
+	node * follow(const pattern_test & t)
+	{
+		node * & n = next[t];
+		if (!n)
+			n = new node;
+		return n;
+	}
+	const node * find(const pattern_test & t) const
+	{
+		test_map::const_iterator i = next.find(t);
+		return i == next.end() ? 0 : i->second;
+	}
+};
+
+pattern_net::node * pattern_net::node::insert(const ex & p)
+{
+	const basic & b = ex_to<basic>(p);
+	if (is_exactly_a<wildcard>(p)) {
+		if (!any)
+			any = new node;
+		return any;
+	}
+	if (!haswild(p))
+		return follow(pattern_test(pattern_test::equal, b, b.gethash(), 0));
+	if (is_a<expairseq>(p))
+		return follow(pattern_test(pattern_test::whole, b, 0, 0));
+
+	node * n = follow(pattern_test(pattern_test::operands, b, serial_of(b), b.nops()));
+	for (size_t i=0; i<b.nops(); ++i)
+		n = n->insert(b.op(i));
+	return n;
+}
+
+void pattern_net::node::collect(exvector & pending, std::vector<unsigned> & found) const
+{
+	if (pending.empty()) {
+		found.insert(found.end(), patterns.begin(), patterns.end());
+		return;
+	}
+
+	const ex e = pending.back();
+	pending.pop_back();
+	const basic & b = ex_to<basic>(e);
+
+	if (any)
+		any->collect(pending, found);
+	if (!next.empty()) {
+		if (const node * n = find(pattern_test(pattern_test::equal, b, b.gethash(), 0)))
+			n->collect(pending, found);
+		if (is_a<expairseq>(e))
+			if (const node * n = find(pattern_test(pattern_test::whole, b, 0, 0)))
+				n->collect(pending, found);
+		const size_t num = b.nops();
+		if (num) {
+			if (const node * n = find(pattern_test(pattern_test::operands, b, serial_of(b), num))) {
+				for (size_t i=num; i-->0; )
+					pending.push_back(b.op(i));
+				n->collect(pending, found);
+				pending.resize(pending.size() - num);
+			}
+		}
+	}
+
+	pending.push_back(e);
+}
+
+pattern_net::pattern_net() : root(new node)
+{
+}
+
+pattern_net::~pattern_net()
+{
+	delete root;
+}
+
+unsigned pattern_net::add(const ex & pattern)
+{
+	const unsigned number = patterns.size();
+	patterns.push_back(pattern);
+	root->insert(pattern)->patterns.push_back(number);
+	return number;
+}
+
+void pattern_net::candidates(const ex & e, std::vector<unsigned> & found) const
+{
+	std::vector<unsigned> result;
+	exvector pending(1, e);
+	root->collect(pending, result);
+	std::sort(result.begin(), result.end());
+	result.erase(std::unique(result.begin(), result.end()), result.end());
+	found.insert(found.end(), result.begin(), result.end());
+}
+
+unsigned pattern_net::match(const ex & e, exmap & repls) const
+{
+	std::vector<unsigned> found;
+	candidates(e, found);
+	for (std::vector<unsigned>::const_iterator i = found.begin(); i != found.end(); ++i) {
+		exmap r;
+		if (e.match(patterns[*i], r)) {
+			repls.swap(r);
+			return *i;
+		}
+	}
+	return size();
+}
+
 } // namespace GiNaC
@@ -26,6 +26,8 @@
 #include "ex.h"
 #include "archive.h"
 
+#include <vector>
+
 namespace GiNaC {
 
 /** This class acts as a wildcard for subs(), match(), has() and find(). An
@@ -49,6 +51,7 @@ public:
 	void read_archive(const archive_node& n, lst& syms);
 protected:
 	unsigned calchash() const;
+	unsigned calc_symbol_mask() const { return 0; }
 
 	// non-virtual functions in this class
 public:
@@ -77,6 +80,45 @@ inline ex wild(unsigned label = 0)
 /** Check whether x has a wildcard anywhere as a subexpression. */
 bool haswild(const ex & x);
 
+/** A set of patterns compiled into a discrimination net, which finds the
+ *  patterns that an expression could match in one pass over it instead of
+ *  trying them one after the other.  The net checks the classes, function
+ *  serials and numbers of operands of the expression and its operands, and
+ *  the hash values of the parts of the patterns without wildcards.  Sums
+ *  and products with wildcards are only checked for their class, since
+ *  their operands may match in any order.  Only the patterns which pass are
+ *  tried with ex::match(). */
+class pattern_net {
+public:
+	pattern_net();
+	~pattern_net();
+
+	/** Add a pattern and return its number. */
+	unsigned add(const ex & pattern);
+
+	/** Number of patterns. */
+	unsigned size() const { return patterns.size(); }
+
+	/** The pattern with number i. */
+	const ex & pattern(unsigned i) const { return patterns[i]; }
+
+	/** Append the numbers of the patterns which e could match, in
+	 *  increasing order. */
+	void candidates(const ex & e, std::vector<unsigned> & found) const;
+
+	/** Return the number of the first pattern which e matches, with the
+	 *  matches of its wildcards in repls, or size() if e matches none. */
+	unsigned match(const ex & e, exmap & repls) const;
+
+private:
+	struct node;
+	node * root;
+	exvector patterns;
+
+	pattern_net(const pattern_net &);
+	pattern_net & operator=(const pattern_net &);
+};
+
 } // namespace GiNaC
 
 #endif // ndef GINAC_WILDCARD_H
@@ -0,0 +1,355 @@
+/** @file zero_test.cpp
+ *
+ *  Implementation of the probabilistic test whether an expression is zero. */
+
+/*
+ *  GiNaC Copyright (C) 1999-2014 Johannes Gutenberg University Mainz, Germany
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#include "zero_test.h"
+#include "ex.h"
+#include "add.h"
+#include "mul.h"
+#include "power.h"
+#include "numeric.h"
+#include "symbol.h"
+#include "constant.h"
+#include "normal.h"
+#include "operators.h"
+#include "flags.h"
+#include "budget.h"
+#include "utils.h"
+#include "polynomial/zp_word.h"
+
+#include <algorithm>
+#include <cln/integer.h>
+#include <cln/numtheory.h>
+#include <cmath>
+#include <map>
+#include <stdexcept>
+#include <stdint.h> // for uint64_t
+
+namespace GiNaC {
+
+namespace {
+
+/** Bounds of the total degrees of the numerator and the denominator of a
+ *  rational function as the result of to_rational(). */
+struct degree_bounds {
+	degree_bounds(double n = 0, double d = 0) : num(n), den(d) {}
+	double num, den;
+};
+
+degree_bounds rational_degree_bounds(const ex & e)
+{
+	if (is_a<symbol>(e))
+		return degree_bounds(1, 0);
+	if (is_exactly_a<add>(e)) {
+		// a/b + c/d = (a*d + c*b)/(b*d)
+		std::vector<degree_bounds> t;
+		t.reserve(e.nops());
+		double den = 0;
+		for (size_t i = 0; i < e.nops(); ++i) {
+			t.push_back(rational_degree_bounds(e.op(i)));
+			den += t.back().den;
+		}
+		double num = 0;
+		for (size_t i = 0; i < t.size(); ++i)
+			num = std::max(num, t[i].num + den - t[i].den);
+		return degree_bounds(num, den);
+	}
+	if (is_exactly_a<mul>(e)) {
+		degree_bounds b;
+		for (size_t i = 0; i < e.nops(); ++i) {
+			const degree_bounds f = rational_degree_bounds(e.op(i));
+			b.num += f.num;
+			b.den += f.den;
+		}
+		return b;
+	}
+	if (is_exactly_a<power>(e) && e.op(1).info(info_flags::integer)) {
+		const degree_bounds b = rational_degree_bounds(e.op(0));
+		const double n = ex_to<numeric>(e.op(1)).to_double();
+		return n >= 0 ? degree_bounds(n*b.num, n*b.den) : degree_bounds(-n*b.den, -n*b.num);
+	}
+	return degree_bounds();
+}
+
+/** Pseudo-random numbers, the same for every call. */
+class random_source {
+public:
+	random_source() : s(0x9e3779b97f4a7c15ULL) {}
+
+	/** Uniform in [0, n), n <= 2^31. */
+	long below(long n)
+	{
+		const uint64_t limit = ((uint64_t(1) << 31) / n) * n;
+		uint64_t x;
+		do {
+			s = s * 6364136223846793005ULL + 1442695040888963407ULL;
+			x = s >> 33;
+		} while (x >= limit);
+		return static_cast<long>(x % n);
+	}
+private:
+	uint64_t s;
+};
+
+/** Z/p for a prime p = 1 mod 4, in which -1 has a square root that stands
+ *  for the imaginary unit. */
+class modular_field {
+public:
+	typedef zp_word value_type;
+
+	explicit modular_field(long p) : R(p), zero_(R, 0L), one_(R, 1L)
+	{
+		const zp_word minus_one = -one_;
+		for (long c = 2; ; ++c) {
+			const zp_word r = power(zp_word(R, c), (p - 1) / 4);
+			if (r * r == minus_one) {
+				imag_unit = r;
+				break;
+			}
+		}
+	}
+
+	const zp_word & zero() const { return zero_; }
+	const zp_word & one() const { return one_; }
+	zp_word random_element(random_source & rnd) const { return zp_word(R, rnd.below(R.modulus)); }
+
+	zp_word constant(const numeric & c, bool & pole) const
+	{
+		if (!c.is_rational())
+			throw std::invalid_argument("zero_test(): cannot evaluate an irrational number");
+		const zp_word num(R, cln::the<cln::cl_I>(c.numer().to_cl_N()));
+		const zp_word den(R, cln::the<cln::cl_I>(c.denom().to_cl_N()));
+		if (zerop(den)) {
+			pole = true;
+			return zero_;
+		}
+		return num * recip(den);
+	}
+
+	zp_word imaginary_unit() const { return imag_unit; }
+
+	zp_word power(const zp_word & b, const numeric & n, bool & pole) const
+	{
+		if (zerop(b)) {
+			if (n.is_negative())
+				pole = true;
+			return n.is_zero() ? one_ : zero_;
+		}
+		// b^(p-1) = 1
+		const long e = cln::cl_I_to_long(cln::mod(cln::the<cln::cl_I>(n.to_cl_N()), cln::cl_I(long(R.modulus) - 1)));
+		return power(b, e);
+	}
+
+private:
+	zp_word power(zp_word b, long e) const
+	{
+		zp_word r = one_;
+		while (e) {
+			if (e & 1)
+				r = r * b;
+			b = b * b;
+			e >>= 1;
+		}
+		return r;
+	}
+
+	const zp_word_ring R;
+	const zp_word zero_, one_;
+	zp_word imag_unit;
+};
+
+/** The (complex) rational numbers with exact arithmetic. */
+class rational_field {
+public:
+	typedef numeric value_type;
+
+	numeric zero() const { return *_num0_p; }
+	numeric one() const { return *_num1_p; }
+	numeric random_element(random_source & rnd) const { return numeric(rnd.below(range) - range / 2); }
+
+	numeric constant(const numeric & c, bool & pole) const
+	{
+		if (!c.is_crational())
+			throw std::invalid_argument("zero_test(): cannot evaluate an irrational number");
+		return c;
+	}
+
+	numeric imaginary_unit() const { return I; }
+
+	/** Number of values of random_element(). */
+	static const long range = 1L << 25;
+
+	numeric power(const numeric & b, const numeric & n, bool & pole) const
+	{
+		if (b.is_zero() && n.is_negative()) {
+			pole = true;
+			return *_num0_p;
+		}
+		return b.power(n);
+	}
+};
+
+/** Evaluates the result of to_rational() at a point, in a Field. */
+template <class Field>
+class point_evaluator {
+public:
+	typedef typename Field::value_type value_type;
+	typedef std::map<ex, value_type, ex_is_less> point_type;
+
+	point_evaluator(const Field & f, const point_type & p) : F(f), point(p), pole(false) {}
+
+	/** The value, if no denominator vanished. */
+	bool evaluate(const ex & e, value_type & v)
+	{
+		v = value_at(e);
+		return !pole;
+	}
+
+private:
+	value_type value_at(const ex & e)
+	{
+		if (is_exactly_a<numeric>(e))
+			return F.constant(ex_to<numeric>(e), pole);
+		if (is_a<symbol>(e)) {
+			typename point_type::const_iterator i = point.find(e);
+			if (i == point.end())
+				throw std::logic_error("zero_test(): symbol without a value");
+			return i->second;
+		}
+
+		// Shared subexpressions are evaluated once
+		const bool shared = ex_to<basic>(e).get_refcount() > 1;
+		if (shared) {
+			typename memo_type::const_iterator i = memo.find(&ex_to<basic>(e));
+			if (i != memo.end())
+				return i->second.second;
+		}
+
+		value_type v;
+		if (is_exactly_a<add>(e)) {
+			v = F.zero();
+			for (size_t i = 0; i < e.nops(); ++i)
+				v = v + value_at(e.op(i));
+		} else if (is_exactly_a<mul>(e)) {
+			v = F.one();
+			for (size_t i = 0; i < e.nops(); ++i)
+				v = v * value_at(e.op(i));
+		} else if (is_exactly_a<power>(e) && e.op(1).info(info_flags::integer)) {
+			v = F.power(value_at(e.op(0)), ex_to<numeric>(e.op(1)), pole);
+		} else
+			throw std::invalid_argument("zero_test(): cannot evaluate a " + std::string(ex_to<basic>(e).class_name()));
+
+		if (shared)
+			memo.insert(std::make_pair(&ex_to<basic>(e), std::make_pair(e, v)));
+		return v;
+	}
+
+	// The originals are kept, so that their addresses are not reused
+	typedef std::map<const basic *, std::pair<ex, value_type> > memo_type;
+
+	const Field & F;
+	const point_type & point;
+	memo_type memo;
+	bool pole;
+};
+
+/** Random prime p = 1 mod 4 with 2^30 < p < 2^31. */
+long random_prime(random_source & rnd)
+{
+	cln::cl_I p = cln::nextprobprime(cln::cl_I((1L << 30) + rnd.below(1L << 30)));
+	while (true) {
+		if (p >= cln::cl_I(0x7fffffffL))
+			p = cln::nextprobprime(cln::cl_I(1L << 30));
+		else if (cln::mod(p, 4) == 1)
+			return cln::cl_I_to_long(p);
+		else
+			p = cln::nextprobprime(p + 1);
+	}
+}
+
+enum point_value { value_zero, value_nonzero, value_undefined };
+
+/** Evaluate r at a random point of Field.  The symbols which replaced the
+ *  imaginary unit (see repl) take the value of a square root of -1. */
+template <class Field>
+point_value value_at_random_point(const ex & r, const exmap & repl, const exset & syms,
+                                  const Field & F, random_source & rnd)
+{
+	typename point_evaluator<Field>::point_type point;
+	for (exset::const_iterator i = syms.begin(); i != syms.end(); ++i) {
+		exmap::const_iterator j = repl.find(*i);
+		if (j != repl.end() && j->second.is_equal(I))
+			point[*i] = F.imaginary_unit();
+		else
+			point[*i] = F.random_element(rnd);
+	}
+	point_evaluator<Field> evaluator(F, point);
+	typename Field::value_type v;
+	if (!evaluator.evaluate(r, v))
+		return value_undefined;
+	return v == F.zero() ? value_zero : value_nonzero;
+}
+
+} // anonymous namespace
+
+bool zero_test(const ex & e, double error_probability, unsigned options)
+{
+	if (!(error_probability > 0 && error_probability < 1))
+		throw std::invalid_argument("zero_test(): error probability must be between 0 and 1");
+
+	exmap repl;
+	const ex r = e.to_rational(repl);
+	if (is_exactly_a<numeric>(r))
+		return r.is_zero();
+
+	exset syms;
+	for (const_preorder_iterator i = r.preorder_begin(); i != r.preorder_end(); ++i)
+		if (is_a<symbol>(*i))
+			syms.insert(*i);
+
+	// A nonzero numerator of degree d vanishes at a random point of S^n
+	// with a probability of at most d/|S|
+	const bool rational = options & zero_test_options::rational_points;
+	const double set_size = rational ? double(rational_field::range) : double(1L << 30);
+	const double miss = rational_degree_bounds(r).num / set_size;
+	if (miss >= 0.5)
+		return normal(e).is_zero();
+	const unsigned rounds = miss > 0 ? unsigned(std::ceil(std::log(error_probability) / std::log(miss))) : 1;
+
+	random_source rnd;
+	const unsigned max_attempts = 4 * rounds + 16;
+	unsigned passed = 0;
+	for (unsigned attempt = 0; attempt < max_attempts; ++attempt) {
+		check_budget();
+		point_value v;
+		if (rational)
+			v = value_at_random_point(r, repl, syms, rational_field(), rnd);
+		else
+			v = value_at_random_point(r, repl, syms, modular_field(random_prime(rnd)), rnd);
+		if (v == value_nonzero)
+			return false;
+		if (v == value_zero && ++passed == rounds)
+			return true;
+	}
+	throw pole_error("zero_test(): denominator vanishes at all points tried", 1);
+}
+
+} // namespace GiNaC
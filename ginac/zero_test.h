@@ -0,0 +1,64 @@
+/** @file zero_test.h
+ *
+ *  Probabilistic test whether an expression is zero. */
+
+/*
+ *  GiNaC Copyright (C) 1999-2014 Johannes Gutenberg University Mainz, Germany
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#ifndef GINAC_ZERO_TEST_H
+#define GINAC_ZERO_TEST_H
+
+namespace GiNaC {
+
+class ex;
+
+/** Tests whether e is zero by evaluating it at random points, which is much
+ *  cheaper than normal() for large rational functions.
+ *
+ *  The objects which are not rational functions (functions, non-integer
+ *  powers, floating point numbers and so on) are replaced by symbols with
+ *  to_rational(), so they are treated as independent of each other: an
+ *  expression which is only zero by an identity between them, like
+ *  sin(x)^2+cos(x)^2-1, is not recognized.  The imaginary unit is handled
+ *  exactly.
+ *
+ *  By default, e is evaluated modulo random primes below 2^31 at random
+ *  points.  With zero_test_options::rational_points, it is evaluated at
+ *  random integer points with exact rational arithmetic, which is slower
+ *  but does not depend on the prime factors of the coefficients.  Points
+ *  at which a denominator vanishes are skipped.
+ *
+ *  If e is zero, true is returned.  If it is not, false is returned except
+ *  with a probability below error_probability, as bounded by the degree of
+ *  the numerator (Schwartz-Zippel lemma).  With the modular evaluation, the
+ *  bound assumes that the primes don't divide all coefficients of the
+ *  numerator, which is only likely for coefficients with thousands of
+ *  digits.  If the degree is too large for the bound, normal() decides.
+ *  The points are drawn from a fixed seed, so the result is reproducible.
+ *
+ *  @param e  expression to test
+ *  @param error_probability  bound of the probability of a wrong answer,
+ *                            between 0 and 1
+ *  @param options  see zero_test_options
+ *  @return true if e is zero (with high probability)
+ *  @exception pole_error  the denominator vanished at all points tried */
+extern bool zero_test(const ex & e, double error_probability = 1e-20, unsigned options = 0);
+
+} // namespace GiNaC
+
+#endif // ndef GINAC_ZERO_TEST_H
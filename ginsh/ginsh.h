@@ -64,6 +64,11 @@ extern FILE *yyin;
 // List of input files to be processed
 extern int num_files;
 extern char **file_list;
+// Name of the file being processed ("-" for stdin)
+extern const char *current_file;
+
+// Non-interactive mode: no banner, no readline, no fallback to stdin
+extern bool batch_mode;
 
 // Table of all used symbols
 typedef map<string, ex> sym_tab;
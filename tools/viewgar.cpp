@@ -23,38 +23,73 @@
 #include "ginac.h"
 using namespace GiNaC;
 
+#include <algorithm>
 #include <cstdlib>
+#include <cstring>
 #include <fstream>
 #include <iostream>
 #include <stdexcept>
+#include <string>
+#include <vector>
 using namespace std;
 
 int main(int argc, char **argv)
 {
 	if (argc < 2) {
-		cerr << "Usage: " << argv[0] << " [-d] file..." << endl;
+		cerr << "Usage: " << argv[0] << " [-d | -l] [-e name]... file..." << endl;
 		exit(1);
 	}
 	--argc; ++argv;
 
-	bool dump_mode = false;
+	bool dump_mode = false, list_mode = false;
+	std::vector<std::string> selected;
 	try {
 		lst l;
 		while (argc) {
 			if (strcmp(*argv, "-d") == 0) {
 				dump_mode = true;
 				--argc; ++argv;
+				continue;
+			}
+			if (strcmp(*argv, "-l") == 0) {
+				list_mode = true;
+				--argc; ++argv;
+				continue;
+			}
+			if (strcmp(*argv, "-e") == 0 && argc > 1) {
+				selected.push_back(argv[1]);
+				argc -= 2; argv += 2;
+				continue;
 			}
 			std::ifstream f(*argv, std::ios_base::binary);
 			archive ar;
-			f >> ar;
+			char sig[4] = {0, 0, 0, 0};
+			f.read(sig, 4);
+			if (memcmp(sig, "GARI", 4) == 0) {
+				// Indexed (possibly compressed) archive
+				f.close();
+				ar.load_indexed(*argv);
+			} else {
+				f.seekg(0);
+				f >> ar;
+			}
 			if (dump_mode) {
 				ar.printraw(std::cout);
 				std::cout << std::endl;
+			} else if (list_mode) {
+				// Names and sizes only, nothing is unarchived
+				for (unsigned int i=0; i<ar.num_expressions(); ++i) {
+					std::string name = ar.get_name(i);
+					if (!selected.empty() && std::find(selected.begin(), selected.end(), name) == selected.end())
+						continue;
+					std::cout << name << ": " << ar.count_nodes(i) << " nodes" << std::endl;
+				}
 			} else {
 				for (unsigned int i=0; i<ar.num_expressions(); ++i) {
-					std::string name;
-					ex e = ar.unarchive_ex(l, name, i);
+					std::string name = ar.get_name(i);
+					if (!selected.empty() && std::find(selected.begin(), selected.end(), name) == selected.end())
+						continue;
+					ex e = ar.unarchive_ex(l, i);
 					std::cout << name << " = " << e << std::endl;
 				}
 			}